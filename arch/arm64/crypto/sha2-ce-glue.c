@@ -32,6 +32,9 @@ extern const u32 sha256_ce_offsetof_finalize;
 
 asmlinkage int sha2_ce_transform(struct sha256_ce_state *sst, u8 const *src,
 				 int blocks);
+asmlinkage int sha2_ce_transform_2x(u32 *state1, u32 *state2,
+				    u8 const *src1, u8 const *src2,
+				    int blocks);
 
 static void __sha2_ce_transform(struct sha256_state *sst, u8 const *src,
 				int blocks)
@@ -48,6 +51,22 @@ static void __sha2_ce_transform(struct sha256_state *sst, u8 const *src,
 	}
 }
 
+static void __sha2_ce_transform_2x(u32 state[2][SHA256_DIGEST_SIZE / 4],
+				   u8 const *src1, u8 const *src2, int blocks)
+{
+	while (blocks) {
+		int rem;
+
+		kernel_neon_begin();
+		rem = sha2_ce_transform_2x(state[0], state[1], src1, src2,
+					   blocks);
+		kernel_neon_end();
+		src1 += (blocks - rem) * SHA256_BLOCK_SIZE;
+		src2 += (blocks - rem) * SHA256_BLOCK_SIZE;
+		blocks = rem;
+	}
+}
+
 const u32 sha256_ce_offsetof_count = offsetof(struct sha256_ce_state,
 					      sst.count);
 const u32 sha256_ce_offsetof_finalize = offsetof(struct sha256_ce_state,
@@ -102,6 +121,55 @@ static int sha256_ce_finup(struct shash_desc *desc, const u8 *data,
 	return sha256_base_finish(desc, out);
 }
 
+/*
+ * Finish two messages of equal length sharing the state of @desc, e.g. two
+ * data blocks hashed with the same salt, by interleaving both streams in the
+ * 2x transform. The padding blocks are built here rather than in the asm so
+ * that both tails can be run through the 2x transform as well.
+ */
+static int sha256_ce_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			      unsigned int len, u8 * const outs[],
+			      unsigned int num_msgs)
+{
+	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
+	unsigned int ds = crypto_shash_digestsize(desc->tfm);
+	unsigned int partial = len % SHA256_BLOCK_SIZE;
+	u32 state[2][SHA256_DIGEST_SIZE / 4];
+	u8 buf[2][2 * SHA256_BLOCK_SIZE];
+	unsigned int tail;
+	u64 bits;
+	int i, j;
+
+	if (num_msgs != 2 || !crypto_simd_usable() ||
+	    sctx->sst.count % SHA256_BLOCK_SIZE)
+		return -EOPNOTSUPP;
+
+	memcpy(state[0], sctx->sst.state, sizeof(state[0]));
+	memcpy(state[1], sctx->sst.state, sizeof(state[1]));
+	__sha2_ce_transform_2x(state, data[0], data[1],
+			       len / SHA256_BLOCK_SIZE);
+
+	bits = (sctx->sst.count + len) << 3;
+	tail = partial < SHA256_BLOCK_SIZE - sizeof(__be64) ? 1 : 2;
+	tail *= SHA256_BLOCK_SIZE;
+	for (i = 0; i < 2; i++) {
+		memcpy(buf[i], data[i] + len - partial, partial);
+		buf[i][partial] = 0x80;
+		memset(buf[i] + partial + 1, 0,
+		       tail - partial - 1 - sizeof(__be64));
+		put_unaligned_be64(bits, buf[i] + tail - sizeof(__be64));
+	}
+	__sha2_ce_transform_2x(state, buf[0], buf[1], tail / SHA256_BLOCK_SIZE);
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < ds / sizeof(__be32); j++)
+			put_unaligned_be32(state[i][j], outs[i] + j * 4);
+
+	memzero_explicit(buf, sizeof(buf));
+	memzero_explicit(state, sizeof(state));
+	return 0;
+}
+
 static int sha256_ce_final(struct shash_desc *desc, u8 *out)
 {
 	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
@@ -138,6 +206,8 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
+	.mb_max_msgs		= 2,
 	.export			= sha256_ce_export,
 	.import			= sha256_ce_import,
 	.descsize		= sizeof(struct sha256_ce_state),
@@ -155,6 +225,8 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
+	.mb_max_msgs		= 2,
 	.export			= sha256_ce_export,
 	.import			= sha256_ce_import,
 	.descsize		= sizeof(struct sha256_ce_state),
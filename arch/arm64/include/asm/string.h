@@ -29,6 +29,9 @@ extern int memcmp(const void *, const void *, size_t);
 
 #define __HAVE_ARCH_MEMCHR
 extern void *memchr(const void *, int, __kernel_size_t);
+
+#define __HAVE_ARCH_MEMCPY_NT
+extern void *memcpy_nt(void *, const void *, __kernel_size_t);
 #endif
 
 #define __HAVE_ARCH_MEMCPY
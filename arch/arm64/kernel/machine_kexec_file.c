@@ -13,6 +13,7 @@
 #include <linux/ioport.h>
 #include <linux/kernel.h>
 #include <linux/kexec.h>
+#include <linux/kexec_preserve.h>
 #include <linux/libfdt.h>
 #include <linux/memblock.h>
 #include <linux/of.h>
@@ -32,6 +33,9 @@ int arch_kimage_file_post_load_cleanup(struct kimage *image)
 	kvfree(image->arch.dtb);
 	image->arch.dtb = NULL;
 
+	kvfree(image->arch.preserve_table);
+	image->arch.preserve_table = NULL;
+
 	vfree(image->elf_headers);
 	image->elf_headers = NULL;
 	image->elf_headers_sz = 0;
@@ -93,8 +97,9 @@ int load_other_segments(struct kimage *image,
 			char *cmdline)
 {
 	struct kexec_buf kbuf;
-	void *headers, *dtb = NULL;
+	void *headers, *dtb = NULL, *table = NULL;
 	unsigned long headers_sz, initrd_load_addr = 0, dtb_len,
+		      table_sz = 0, table_load_addr = 0,
 		      orig_segments = image->nr_segments;
 	int ret = 0;
 
@@ -152,15 +157,56 @@ int load_other_segments(struct kimage *image,
 				initrd_load_addr, kbuf.bufsz, kbuf.memsz);
 	}
 
-	/* load dtb */
+	/* load the table of the memory regions handed over */
+	if (image->type != KEXEC_TYPE_CRASH)
+		table = kexec_preserve_build_table(&table_sz);
+	if (table) {
+		/* freed by arch_kimage_file_post_load_cleanup() */
+		image->arch.preserve_table = table;
+
+		kbuf.buffer = table;
+		kbuf.bufsz = table_sz;
+		kbuf.mem = KEXEC_BUF_MEM_UNKNOWN;
+		kbuf.memsz = table_sz;
+		kbuf.buf_align = PAGE_SIZE;
+		kbuf.buf_max = ULONG_MAX;
+		kbuf.top_down = true;
+
+		ret = kexec_add_buffer(&kbuf);
+		if (ret)
+			goto out_err;
+		table_load_addr = kbuf.mem;
+
+		pr_debug("Loaded preserved memory table at 0x%lx bufsz=0x%lx memsz=0x%lx\n",
+			 table_load_addr, kbuf.bufsz, kbuf.memsz);
+	}
+
+	/* load dtb, with room for the preserved memory table property */
 	dtb = of_kexec_alloc_and_setup_fdt(image, initrd_load_addr,
-					   initrd_len, cmdline, 0);
+					   initrd_len, cmdline,
+					   table ? 64 : 0);
 	if (!dtb) {
 		pr_err("Preparing for new dtb failed\n");
 		ret = -EINVAL;
 		goto out_err;
 	}
 
+	if (table) {
+		__be64 prop[2] = {
+			cpu_to_be64(table_load_addr),
+			cpu_to_be64(table_sz),
+		};
+		int chosen = fdt_path_offset(dtb, "/chosen");
+
+		if (chosen < 0 ||
+		    fdt_setprop(dtb, chosen, KEXEC_PRESERVE_FDT_PROP, prop,
+				sizeof(prop))) {
+			pr_err("Passing the preserved memory table failed\n");
+			ret = -EINVAL;
+			goto out_err;
+		}
+	}
+
 	/* trim it */
 	fdt_pack(dtb);
 	dtb_len = fdt_totalsize(dtb);
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Selects between the serial and the 3-way interleaved CRC32(C) routines
+ * of crc32.S
+ */
+
+#include <linux/crc32.h>
+#include <linux/linkage.h>
+#include <linux/minmax.h>
+#include <linux/math.h>
+
+#include <asm/cpufeature.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* Must match 3 * CRC32_3WAY_LANE in crc32.S */
+#define CRC32_3WAY_CHUNK	(3 * 512)
+
+/* Bounds the time spent with preemption disabled in kernel_neon_begin() */
+#define CRC32_3WAY_MAX		(32 * CRC32_3WAY_CHUNK)
+
+asmlinkage u32 crc32_le_arm64(u32 crc, unsigned char const *p, size_t len);
+asmlinkage u32 crc32c_le_arm64(u32 crc, unsigned char const *p, size_t len);
+asmlinkage u32 crc32_le_arm64_3way(u32 crc, unsigned char const *p, size_t len);
+asmlinkage u32 crc32c_le_arm64_3way(u32 crc, unsigned char const *p, size_t len);
+
+static bool crc32_use_3way(size_t len)
+{
+	return len >= CRC32_3WAY_CHUNK &&
+	       cpus_have_const_cap(ARM64_HAS_CRC32) &&
+	       cpu_have_named_feature(PMULL) && may_use_simd();
+}
+
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (crc32_use_3way(len)) {
+		do {
+			size_t n = min_t(size_t, round_down(len, CRC32_3WAY_CHUNK),
+					 CRC32_3WAY_MAX);
+
+			kernel_neon_begin();
+			crc = crc32_le_arm64_3way(crc, p, n);
+			kernel_neon_end();
+			p += n;
+			len -= n;
+		} while (len >= CRC32_3WAY_CHUNK);
+	}
+	return crc32_le_arm64(crc, p, len);
+}
+
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (crc32_use_3way(len)) {
+		do {
+			size_t n = min_t(size_t, round_down(len, CRC32_3WAY_CHUNK),
+					 CRC32_3WAY_MAX);
+
+			kernel_neon_begin();
+			crc = crc32c_le_arm64_3way(crc, p, n);
+			kernel_neon_end();
+			p += n;
+			len -= n;
+		} while (len >= CRC32_3WAY_CHUNK);
+	}
+	return crc32c_le_arm64(crc, p, len);
+}
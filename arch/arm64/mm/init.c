@@ -27,6 +27,7 @@
 #include <linux/vmalloc.h>
 #include <linux/mm.h>
 #include <linux/kexec.h>
+#include <linux/kexec_preserve.h>
 #include <linux/crash_dump.h>
 #include <linux/hugetlb.h>
 #include <linux/acpi_iort.h>
@@ -434,6 +435,7 @@ void __init arm64_memblock_init(void)
 	}
 
 	early_init_fdt_scan_reserved_mem();
+	kexec_preserved_scan_fdt();
 
 	high_memory = __va(memblock_end_of_DRAM() - 1) + 1;
 }
@@ -16,63 +16,25 @@
 #include <linux/types.h>
 #include <linux/slab.h>
 
-/**
- * badblocks_check() - check a given range for bad sectors
- * @bb:		the badblocks structure that holds all badblock information
- * @s:		sector (start) at which to check for badblocks
- * @sectors:	number of sectors to check for badblocks
- * @first_bad:	pointer to store location of the first badblock
- * @bad_sectors: pointer to store number of badblocks after @first_bad
- *
- * We can record which blocks on each device are 'bad' and so just
- * fail those blocks, or that stripe, rather than the whole device.
- * Entries in the bad-block table are 64bits wide.  This comprises:
- * Length of bad-range, in sectors: 0-511 for lengths 1-512
- * Start of bad-range, sector offset, 54 bits (allows 8 exbibytes)
- *  A 'shift' can be set so that larger blocks are tracked and
- *  consequently larger devices can be covered.
- * 'Acknowledged' flag - 1 bit. - the most significant bit.
- *
- * Locking of the bad-block table uses a seqlock so badblocks_check
- * might need to retry if it is very unlucky.
- * We will sometimes want to check for bad blocks in a bi_end_io function,
- * so we use the write_seqlock_irq variant.
- *
- * When looking for a bad block we specify a range and want to
- * know if any block in the range is bad.  So we binary-search
- * to the last range that starts at-or-before the given endpoint,
- * (or "before the sector after the target range")
- * then see if it ends after the given start.
- *
- * Return:
- *  0: there are no known bad blocks in the range
- *  1: there are known bad block which are all acknowledged
- * -1: there are bad blocks which have not yet been acknowledged in metadata.
- * plus the start/length of the first bad section we overlap.
+/*
+ * Look for the ranges of @p overlapping blocks [@s, @target). The table is
+ * sorted by start and its ranges do not overlap, so a range outside of the
+ * span of the table is answered without searching.
  */
-int badblocks_check(struct badblocks *bb, sector_t s, int sectors,
-			sector_t *first_bad, int *bad_sectors)
+static int __badblocks_check(const u64 *p, int count, sector_t s,
+			     sector_t target, sector_t *first_bad,
+			     int *bad_sectors)
 {
 	int hi;
 	int lo;
-	u64 *p = bb->page;
-	int rv;
-	sector_t target = s + sectors;
-	unsigned seq;
+	int rv = 0;
 
-	if (bb->shift > 0) {
-		/* round the start down, and the end up */
-		s >>= bb->shift;
-		target += (1<<bb->shift) - 1;
-		target >>= bb->shift;
-	}
-	/* 'target' is now the first block after the bad range */
+	if (!count || target <= BB_OFFSET(p[0]) ||
+	    s >= BB_OFFSET(p[count - 1]) + BB_LEN(p[count - 1]))
+		return 0;
 
-retry:
-	seq = read_seqbegin(&bb->lock);
 	lo = 0;
-	rv = 0;
-	hi = bb->count;
+	hi = count;
 
 	/* Binary search between lo and hi for 'target'
 	 * i.e. for the last range that starts before 'target'
@@ -117,8 +79,81 @@ int badblocks_check(struct badblocks *bb, sector_t s, int sectors,
 		}
 	}
 
-	if (read_seqretry(&bb->lock, seq))
-		goto retry;
+	return rv;
+}
+
+/**
+ * badblocks_check() - check a given range for bad sectors
+ * @bb:		the badblocks structure that holds all badblock information
+ * @s:		sector (start) at which to check for badblocks
+ * @sectors:	number of sectors to check for badblocks
+ * @first_bad:	pointer to store location of the first badblock
+ * @bad_sectors: pointer to store number of badblocks after @first_bad
+ *
+ * We can record which blocks on each device are 'bad' and so just
+ * fail those blocks, or that stripe, rather than the whole device.
+ * Entries in the bad-block table are 64bits wide.  This comprises:
+ * Length of bad-range, in sectors: 0-511 for lengths 1-512
+ * Start of bad-range, sector offset, 54 bits (allows 8 exbibytes)
+ *  A 'shift' can be set so that larger blocks are tracked and
+ *  consequently larger devices can be covered.
+ * 'Acknowledged' flag - 1 bit. - the most significant bit.
+ *
+ * Updates of the bad-block table are serialized by a seqlock, and each
+ * one publishes a copy of the table that badblocks_check searches under
+ * RCU, without ever waiting for a writer. Only if that copy could not be
+ * allocated does badblocks_check fall back to the seqlock read side.
+ * We will sometimes want to check for bad blocks in a bi_end_io function,
+ * so we use the write_seqlock_irq variant.
+ *
+ * When looking for a bad block we specify a range and want to
+ * know if any block in the range is bad.  So we binary-search
+ * to the last range that starts at-or-before the given endpoint,
+ * (or "before the sector after the target range")
+ * then see if it ends after the given start.
+ *
+ * Return:
+ *  0: there are no known bad blocks in the range
+ *  1: there are known bad block which are all acknowledged
+ * -1: there are bad blocks which have not yet been acknowledged in metadata.
+ * plus the start/length of the first bad section we overlap.
+ */
+int badblocks_check(struct badblocks *bb, sector_t s, int sectors,
+			sector_t *first_bad, int *bad_sectors)
+{
+	struct badblocks_snap *snap;
+	sector_t target = s + sectors;
+	unsigned seq;
+	int rv;
+
+	/* Nothing to search, which is the common case */
+	if (!READ_ONCE(bb->count))
+		return 0;
+
+	if (bb->shift > 0) {
+		/* round the start down, and the end up */
+		s >>= bb->shift;
+		target += (1<<bb->shift) - 1;
+		target >>= bb->shift;
+	}
+	/* 'target' is now the first block after the bad range */
+
+	rcu_read_lock();
+	snap = rcu_dereference(bb->snap);
+	if (snap) {
+		rv = __badblocks_check(snap->entries, snap->count, s, target,
+				       first_bad, bad_sectors);
+		rcu_read_unlock();
+		return rv;
+	}
+	rcu_read_unlock();
+
+	/* The last update could not publish a copy, search the table itself */
+	do {
+		seq = read_seqbegin(&bb->lock);
+		rv = __badblocks_check(bb->page, bb->count, s, target,
+				       first_bad, bad_sectors);
+	} while (read_seqretry(&bb->lock, seq));
 
 	return rv;
 }
@@ -144,6 +179,29 @@ static void badblocks_update_acked(struct badblocks *bb)
 		bb->unacked_exist = 0;
 }
 
+static void badblocks_free_snap(struct badblocks_snap *snap)
+{
+	if (snap)
+		kfree_rcu(snap, rcu);
+}
+
+/*
+ * Publish a copy of the table for badblocks_check(), must be called with the
+ * seqlock write side held. Writers may run in interrupt context, so the copy
+ * is allocated atomically; if that fails readers use the seqlock instead.
+ */
+static void badblocks_publish(struct badblocks *bb)
+{
+	struct badblocks_snap *snap;
+
+	snap = kmalloc(struct_size(snap, entries, bb->count), GFP_ATOMIC);
+	if (snap) {
+		snap->count = bb->count;
+		memcpy(snap->entries, bb->page, bb->count * sizeof(u64));
+	}
+	badblocks_free_snap(rcu_replace_pointer(bb->snap, snap, true));
+}
+
 /**
  * badblocks_set() - Add a range of bad blocks to the table.
  * @bb:		the badblocks structure that holds all badblock information
@@ -307,6 +365,7 @@ int badblocks_set(struct badblocks *bb, sector_t s, int sectors,
 		bb->unacked_exist = 1;
 	else
 		badblocks_update_acked(bb);
+	badblocks_publish(bb);
 	write_sequnlock_irqrestore(&bb->lock, flags);
 
 	return rv;
@@ -415,6 +474,7 @@ int badblocks_clear(struct badblocks *bb, sector_t s, int sectors)
 
 	badblocks_update_acked(bb);
 	bb->changed = 1;
+	badblocks_publish(bb);
 out:
 	write_sequnlock_irq(&bb->lock);
 	return rv;
@@ -448,6 +508,7 @@ void ack_all_badblocks(struct badblocks *bb)
 			}
 		}
 		bb->unacked_exist = 0;
+		badblocks_publish(bb);
 	}
 	write_sequnlock_irq(&bb->lock);
 }
@@ -539,11 +600,19 @@ ssize_t badblocks_store(struct badblocks *bb, const char *page, size_t len,
 }
 EXPORT_SYMBOL_GPL(badblocks_store);
 
+static void badblocks_devm_free_snap(void *data)
+{
+	struct badblocks *bb = data;
+
+	badblocks_free_snap(rcu_replace_pointer(bb->snap, NULL, true));
+}
+
 static int __badblocks_init(struct device *dev, struct badblocks *bb,
 		int enable)
 {
 	bb->dev = dev;
 	bb->count = 0;
+	RCU_INIT_POINTER(bb->snap, NULL);
 	if (enable)
 		bb->shift = 0;
 	else
@@ -558,6 +627,9 @@ static int __badblocks_init(struct device *dev, struct badblocks *bb,
 	}
 	seqlock_init(&bb->lock);
 
+	if (dev)
+		return devm_add_action_or_reset(dev, badblocks_devm_free_snap,
+						bb);
 	return 0;
 }
 
@@ -592,6 +664,7 @@ void badblocks_exit(struct badblocks *bb)
 {
 	if (!bb)
 		return;
+	badblocks_free_snap(rcu_replace_pointer(bb->snap, NULL, true));
 	if (bb->dev)
 		devm_kfree(bb->dev, bb->page);
 	else
@@ -1145,13 +1145,20 @@ EXPORT_SYMBOL(bio_add_folio);
 
 void __bio_release_pages(struct bio *bio, bool mark_dirty)
 {
-	struct bvec_iter_all iter_all;
-	struct bio_vec *bvec;
+	struct folio_iter fi;
 
-	bio_for_each_segment_all(bvec, bio, iter_all) {
-		if (mark_dirty && !PageCompound(bvec->bv_page))
-			set_page_dirty_lock(bvec->bv_page);
-		bio_release_page(bio, bvec->bv_page);
+	/* every page of a bvec holds its own pin, drop them a folio at a time */
+	bio_for_each_folio_all(fi, bio) {
+		unsigned long nr_pages;
+
+		if (mark_dirty) {
+			folio_lock(fi.folio);
+			folio_mark_dirty(fi.folio);
+			folio_unlock(fi.folio);
+		}
+		nr_pages = (fi.offset + fi.length - 1) / PAGE_SIZE -
+			   fi.offset / PAGE_SIZE + 1;
+		bio_release_folio(bio, fi.folio, nr_pages);
 	}
 }
 EXPORT_SYMBOL_GPL(__bio_release_pages);
@@ -1212,6 +1219,33 @@ static int bio_iov_add_zone_append_page(struct bio *bio, struct page *page,
 
 #define PAGE_PTRS_PER_BVEC     (sizeof(struct bio_vec) / sizeof(struct page *))
 
+/*
+ * Return the number of bytes, up to @left, starting at @offset into @pages[0]
+ * that are backed by consecutive pages of the same folio, and the number of
+ * pages they span in @nr_run.  THP and hugetlb backed buffers can then be
+ * added as one multi-page bvec per folio instead of one page at a time.
+ */
+static size_t bio_iov_folio_run(struct page **pages, unsigned int nr_pages,
+		size_t offset, size_t left, unsigned int *nr_run)
+{
+	struct folio *folio = page_folio(pages[0]);
+	size_t len = min_t(size_t, PAGE_SIZE - offset, left);
+	unsigned int i = 1;
+
+	if (!IS_ENABLED(CONFIG_KMSAN) && folio_test_large(folio)) {
+		left = min(left, folio_size(folio) - offset -
+			   folio_page_idx(folio, pages[0]) * PAGE_SIZE);
+		while (len < left && i < nr_pages &&
+		       pages[i] == nth_page(pages[0], i)) {
+			len += min_t(size_t, PAGE_SIZE, left - len);
+			i++;
+		}
+	}
+
+	*nr_run = i;
+	return len;
+}
+
 /**
  * __bio_iov_iter_get_pages - pin user or kernel pages and add them to a bio
  * @bio: bio to add pages to
@@ -1230,7 +1264,7 @@ static int __bio_iov_iter_get_pages(struct bio *bio, struct iov_iter *iter)
 	struct bio_vec *bv = bio->bi_io_vec + bio->bi_vcnt;
 	struct page **pages = (struct page **)bv;
 	ssize_t size, left;
-	unsigned len, i = 0;
+	unsigned len, i = 0, nr_run;
 	size_t offset;
 	int ret = 0;
 
@@ -1271,17 +1305,21 @@ static int __bio_iov_iter_get_pages(struct bio *bio, struct iov_iter *iter)
 		goto out;
 	}
 
-	for (left = size, i = 0; left > 0; left -= len, i++) {
+	for (left = size, i = 0; left > 0; left -= len, i += nr_run) {
 		struct page *page = pages[i];
 
-		len = min_t(size_t, PAGE_SIZE - offset, left);
 		if (bio_op(bio) == REQ_OP_ZONE_APPEND) {
+			len = min_t(size_t, PAGE_SIZE - offset, left);
+			nr_run = 1;
 			ret = bio_iov_add_zone_append_page(bio, page, len,
 					offset);
 			if (ret)
 				break;
-		} else
+		} else {
+			len = bio_iov_folio_run(pages + i, nr_pages - i,
+						offset, left, &nr_run);
 			bio_iov_add_page(bio, page, len, offset);
+		}
 
 		offset = 0;
 	}
@@ -1577,12 +1615,16 @@ void bio_endio(struct bio *bio)
 		return;
 
 	rq_qos_done_bio(bio);
+	blk_cgroup_bio_done(bio);
 
 	if (bio->bi_bdev && bio_flagged(bio, BIO_TRACE_COMPLETION)) {
 		trace_block_bio_complete(bdev_get_queue(bio->bi_bdev), bio);
 		bio_clear_flag(bio, BIO_TRACE_COMPLETION);
 	}
 
+	if (bio_flagged(bio, BIO_ZONE_WRITE_PLUGGING))
+		blk_zone_write_plug_bio_endio(bio);
+
 	/*
 	 * Need to have a real endio function for chained bios, otherwise
 	 * various corner cases will break (like stacking block devices that
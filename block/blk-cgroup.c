@@ -57,6 +57,7 @@ static struct blkcg_policy *blkcg_policy[BLKCG_MAX_POLS];
 static LIST_HEAD(all_blkcgs);		/* protected by blkcg_pol_mutex */
 
 bool blkcg_debug_stats = false;
+bool blkcg_lat_hist = false;
 
 static DEFINE_RAW_SPINLOCK(blkg_stat_lock);
 
@@ -142,6 +143,7 @@ static void blkg_free_workfn(struct work_struct *work)
 	mutex_unlock(&q->blkcg_mutex);
 
 	blk_put_queue(q);
+	free_percpu(blkg->lat_hist);
 	free_percpu(blkg->iostat_cpu);
 	percpu_ref_exit(&blkg->refcnt);
 	kfree(blkg);
@@ -1089,6 +1091,50 @@ static void blkcg_fill_root_iostats(void)
 	}
 }
 
+static u64 blkg_lat_bucket_us(int idx)
+{
+	int group = idx >> BLKG_LAT_SUB_SHIFT;
+	int sub = idx & ((1 << BLKG_LAT_SUB_SHIFT) - 1);
+
+	if (!group)
+		return sub;
+	return (u64)((1 << BLKG_LAT_SUB_SHIFT) + sub) << (group - 1);
+}
+
+/*
+ * Print the non-empty latency buckets as "<lat>=<lower bound in us>:<count>,...".
+ * The counts are cumulative, percentiles over a window can be computed from
+ * the difference between two reads.
+ */
+static void blkcg_print_lat_hist(struct blkcg_gq *blkg, struct seq_file *s)
+{
+	static const char * const names[BLKG_IOSTAT_NR] = {
+		[BLKG_IOSTAT_READ]	= "rlat",
+		[BLKG_IOSTAT_WRITE]	= "wlat",
+		[BLKG_IOSTAT_DISCARD]	= "dlat",
+	};
+	int rwd, i, cpu;
+
+	for (rwd = 0; rwd < BLKG_IOSTAT_NR; rwd++) {
+		char sep = '=';
+
+		for (i = 0; i < BLKG_LAT_NR_BUCKETS; i++) {
+			u64 nr = 0;
+
+			for_each_possible_cpu(cpu)
+				nr += READ_ONCE(per_cpu_ptr(blkg->lat_hist,
+							    cpu)->nr[rwd][i]);
+			if (!nr)
+				continue;
+			if (sep == '=')
+				seq_printf(s, " %s", names[rwd]);
+			seq_printf(s, "%c%llu:%llu", sep, blkg_lat_bucket_us(i),
+				   nr);
+			sep = ',';
+		}
+	}
+}
+
 static void blkcg_print_one_stat(struct blkcg_gq *blkg, struct seq_file *s)
 {
 	struct blkg_iostat_set *bis = &blkg->iostat;
@@ -1123,6 +1169,9 @@ static void blkcg_print_one_stat(struct blkcg_gq *blkg, struct seq_file *s)
 			dbytes, dios);
 	}
 
+	if (blkg->lat_hist)
+		blkcg_print_lat_hist(blkg, s);
+
 	if (blkcg_debug_stats && atomic_read(&blkg->use_delay)) {
 		seq_printf(s, " use_delay=%d delay_nsec=%llu",
 			atomic_read(&blkg->use_delay),
@@ -2085,6 +2134,43 @@ static int blk_cgroup_io_type(struct bio *bio)
 	return BLKG_IOSTAT_READ;
 }
 
+static void blkg_alloc_lat_hist(struct blkcg_gq *blkg)
+{
+	struct blkg_lat_hist __percpu *hist;
+
+	/* this can be called from atomic context, retried on the next IO */
+	hist = alloc_percpu_gfp(struct blkg_lat_hist, GFP_NOWAIT | __GFP_NOWARN);
+	if (hist && cmpxchg(&blkg->lat_hist, NULL, hist))
+		free_percpu(hist);
+}
+
+static int blkg_lat_bucket(u64 us)
+{
+	int msb;
+
+	if (us < (1 << BLKG_LAT_SUB_SHIFT))
+		return us;
+
+	msb = fls64(us) - 1;
+	return min_t(int, ((msb - BLKG_LAT_SUB_SHIFT + 1) << BLKG_LAT_SUB_SHIFT) +
+			  ((us >> (msb - BLKG_LAT_SUB_SHIFT)) &
+			   ((1 << BLKG_LAT_SUB_SHIFT) - 1)),
+		     BLKG_LAT_NR_BUCKETS - 1);
+}
+
+void __blk_cgroup_bio_done(struct bio *bio)
+{
+	u64 now = __bio_issue_time(ktime_get_ns());
+	u64 start = bio_issue_time(&bio->bi_issue);
+	int idx;
+
+	if (now <= start)
+		return;
+
+	idx = blkg_lat_bucket(div_u64(now - start, NSEC_PER_USEC));
+	this_cpu_inc(bio->bi_blkg->lat_hist->nr[blk_cgroup_io_type(bio)][idx]);
+}
+
 void blk_cgroup_bio_start(struct bio *bio)
 {
 	struct blkcg *blkcg = bio->bi_blkg->blkcg;
@@ -2099,6 +2185,9 @@ void blk_cgroup_bio_start(struct bio *bio)
 	if (!cgroup_parent(blkcg->css.cgroup))
 		return;
 
+	if (unlikely(READ_ONCE(blkcg_lat_hist) && !bio->bi_blkg->lat_hist))
+		blkg_alloc_lat_hist(bio->bi_blkg);
+
 	cpu = get_cpu();
 	bis = per_cpu_ptr(bio->bi_blkg->iostat_cpu, cpu);
 	flags = u64_stats_update_begin_irqsave(&bis->sync);
@@ -2147,3 +2236,5 @@ bool blk_cgroup_congested(void)
 
 module_param(blkcg_debug_stats, bool, 0644);
 MODULE_PARM_DESC(blkcg_debug_stats, "True if you want debug stats, false if not");
+module_param(blkcg_lat_hist, bool, 0644);
+MODULE_PARM_DESC(blkcg_lat_hist, "Add per-cgroup completion latency histograms to io.stat");
@@ -42,6 +42,18 @@ struct blkg_iostat {
 	u64				ios[BLKG_IOSTAT_NR];
 };
 
+/*
+ * Log-linear completion latency histogram.  Latencies below 4us get a bucket
+ * per microsecond, above that each power of two is split into four linear
+ * buckets.  The last bucket starts at 2s and collects everything slower.
+ */
+#define BLKG_LAT_SUB_SHIFT	2
+#define BLKG_LAT_NR_BUCKETS	(21 << BLKG_LAT_SUB_SHIFT)
+
+struct blkg_lat_hist {
+	u64				nr[BLKG_IOSTAT_NR][BLKG_LAT_NR_BUCKETS];
+};
+
 struct blkg_iostat_set {
 	struct u64_stats_sync		sync;
 	struct blkcg_gq		       *blkg;
@@ -71,6 +83,9 @@ struct blkcg_gq {
 	struct blkg_iostat_set __percpu	*iostat_cpu;
 	struct blkg_iostat_set		iostat;
 
+	/* allocated on first IO once blkcg_lat_hist is enabled */
+	struct blkg_lat_hist __percpu	*lat_hist;
+
 	struct blkg_policy_data		*pd[BLKCG_MAX_POLS];
 #ifdef CONFIG_BLK_CGROUP_PUNT_BIO
 	spinlock_t			async_bio_lock;
@@ -187,6 +202,7 @@ struct blkcg_policy {
 
 extern struct blkcg blkcg_root;
 extern bool blkcg_debug_stats;
+extern bool blkcg_lat_hist;
 
 int blkcg_init_disk(struct gendisk *disk);
 void blkcg_exit_disk(struct gendisk *disk);
@@ -466,7 +482,15 @@ static inline bool blk_cgroup_mergeable(struct request *rq, struct bio *bio)
 }
 
 void blk_cgroup_bio_start(struct bio *bio);
+void __blk_cgroup_bio_done(struct bio *bio);
 void blkcg_add_delay(struct blkcg_gq *blkg, u64 now, u64 delta);
+
+/* Only bios accounted by blk_cgroup_bio_start() have a valid ->bi_issue */
+static inline void blk_cgroup_bio_done(struct bio *bio)
+{
+	if (bio_flagged(bio, BIO_CGROUP_ACCT) && bio->bi_blkg->lat_hist)
+		__blk_cgroup_bio_done(bio);
+}
 #else	/* CONFIG_BLK_CGROUP */
 
 struct blkg_policy_data {
@@ -499,6 +523,7 @@ static inline void blkg_get(struct blkcg_gq *blkg) { }
 static inline void blkg_put(struct blkcg_gq *blkg) { }
 static inline void blkcg_bio_issue_init(struct bio *bio) { }
 static inline void blk_cgroup_bio_start(struct bio *bio) { }
+static inline void blk_cgroup_bio_done(struct bio *bio) { }
 static inline bool blk_cgroup_mergeable(struct request *rq, struct bio *bio) { return true; }
 
 #define blk_queue_for_each_rl(rl, q)	\
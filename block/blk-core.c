@@ -883,7 +883,7 @@ int bio_poll(struct bio *bio, struct io_comp_batch *iob, unsigned int flags)
 	if (!percpu_ref_tryget(&q->q_usage_counter))
 		return 0;
 	if (queue_is_mq(q)) {
-		ret = blk_mq_poll(q, cookie, iob, flags);
+		ret = blk_mq_poll(q, bio, cookie, iob, flags);
 	} else {
 		struct gendisk *disk = q->disk;
 
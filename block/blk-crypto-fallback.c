@@ -18,6 +18,7 @@
 #include <linux/module.h>
 #include <linux/random.h>
 #include <linux/scatterlist.h>
+#include <linux/sizes.h>
 
 #include "blk-cgroup.h"
 #include "blk-crypto-internal.h"
@@ -37,6 +38,11 @@ module_param(num_prealloc_fallback_crypt_ctxs, uint, 0);
 MODULE_PARM_DESC(num_prealloc_crypt_fallback_ctxs,
 		 "Number of preallocated bio fallback crypto contexts for blk-crypto to use during crypto API fallback");
 
+static unsigned int crypt_chunk_size = SZ_64K;
+module_param(crypt_chunk_size, uint, 0644);
+MODULE_PARM_DESC(crypt_chunk_size,
+		 "Minimum number of bytes of a bio en/decrypted per CPU, 0 to en/decrypt each bio on a single CPU");
+
 struct bio_fallback_crypt_ctx {
 	struct bio_crypt_ctx crypt_ctx;
 	/*
@@ -80,6 +86,7 @@ static struct blk_crypto_fallback_keyslot {
 
 static struct blk_crypto_profile *blk_crypto_fallback_profile;
 static struct workqueue_struct *blk_crypto_wq;
+static struct workqueue_struct *blk_crypto_chunk_wq;
 static mempool_t *blk_crypto_bounce_page_pool;
 static struct bio_set crypto_bio_split;
 
@@ -251,6 +258,180 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 		iv->dun[i] = cpu_to_le64(dun[i]);
 }
 
+/*
+ * A range of data units of a bio. Large bios are cut into several chunks that
+ * are en/decrypted in parallel, the first one by the caller and the others by
+ * blk_crypto_chunk_wq workers. Those never wait on anything but the crypto API,
+ * which keeps them from deadlocking against the blk_crypto_wq work items that
+ * wait for them.
+ */
+struct blk_crypto_fallback_chunk {
+	struct work_struct work;
+	struct blk_crypto_keyslot *slot;
+	struct bio *src_bio;
+	struct bvec_iter src_iter;
+	struct bio *dst_bio;
+	struct bvec_iter dst_iter;
+	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	unsigned int data_unit_size;
+	bool encrypt;
+	blk_status_t status;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+/*
+ * Each data unit is a single skcipher request covering all of its cipher
+ * blocks, which multi-block implementations such as bit-sliced AES process in
+ * parallel. Data units cannot be combined as each one has its own IV.
+ */
+static void blk_crypto_fallback_crypt_chunk(struct blk_crypto_fallback_chunk *c)
+{
+	const unsigned int data_unit_size = c->data_unit_size;
+	struct skcipher_request *ciph_req = NULL;
+	DECLARE_CRYPTO_WAIT(wait);
+	struct scatterlist src, dst;
+	union blk_crypto_iv iv;
+	unsigned int i;
+	int err;
+
+	c->status = BLK_STS_OK;
+
+	if (!blk_crypto_fallback_alloc_cipher_req(c->slot, &ciph_req, &wait)) {
+		c->status = BLK_STS_RESOURCE;
+		return;
+	}
+
+	sg_init_table(&src, 1);
+	sg_init_table(&dst, 1);
+	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
+				   iv.bytes);
+
+	while (c->src_iter.bi_size) {
+		struct bio_vec src_bv = bio_iter_iovec(c->src_bio, c->src_iter);
+		struct bio_vec dst_bv = bio_iter_iovec(c->dst_bio, c->dst_iter);
+
+		sg_set_page(&src, src_bv.bv_page, data_unit_size,
+			    src_bv.bv_offset);
+		sg_set_page(&dst, dst_bv.bv_page, data_unit_size,
+			    dst_bv.bv_offset);
+
+		/* En/decrypt each data unit in the segment */
+		for (i = 0; i < src_bv.bv_len; i += data_unit_size) {
+			blk_crypto_dun_to_iv(c->dun, &iv);
+			if (c->encrypt)
+				err = crypto_skcipher_encrypt(ciph_req);
+			else
+				err = crypto_skcipher_decrypt(ciph_req);
+			if (crypto_wait_req(err, &wait)) {
+				c->status = BLK_STS_IOERR;
+				goto out;
+			}
+			bio_crypt_dun_increment(c->dun, 1);
+			src.offset += data_unit_size;
+			dst.offset += data_unit_size;
+		}
+
+		bio_advance_iter_single(c->src_bio, &c->src_iter,
+					src_bv.bv_len);
+		bio_advance_iter_single(c->dst_bio, &c->dst_iter,
+					src_bv.bv_len);
+	}
+
+out:
+	skcipher_request_free(ciph_req);
+}
+
+static void blk_crypto_fallback_chunk_work(struct work_struct *work)
+{
+	struct blk_crypto_fallback_chunk *c =
+		container_of(work, struct blk_crypto_fallback_chunk, work);
+
+	blk_crypto_fallback_crypt_chunk(c);
+	if (atomic_dec_and_test(c->pending))
+		complete(c->done);
+}
+
+/*
+ * En/decrypt the data described by @src_iter into the data described by
+ * @dst_iter, which may be the same. Both must be made of identical segments.
+ */
+static blk_status_t
+blk_crypto_fallback_crypt(struct blk_crypto_keyslot *slot,
+			  struct bio *src_bio, struct bvec_iter src_iter,
+			  struct bio *dst_bio, struct bvec_iter dst_iter,
+			  const struct bio_crypt_ctx *bc, bool encrypt)
+{
+	const unsigned int data_unit_size = bc->bc_key->crypto_cfg.data_unit_size;
+	const unsigned int chunk_size = READ_ONCE(crypt_chunk_size);
+	struct blk_crypto_fallback_chunk onstack, *chunks = &onstack;
+	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned int nr_chunks = 1, chunk_bytes, i;
+	blk_status_t status = BLK_STS_OK;
+	atomic_t pending;
+
+	if (chunk_size && src_iter.bi_size > chunk_size)
+		nr_chunks = min(DIV_ROUND_UP(src_iter.bi_size, chunk_size),
+				num_online_cpus());
+	chunk_bytes = round_up(DIV_ROUND_UP(src_iter.bi_size, nr_chunks),
+			       data_unit_size);
+	nr_chunks = DIV_ROUND_UP(src_iter.bi_size, chunk_bytes);
+	if (nr_chunks > 1) {
+		chunks = kmalloc_array(nr_chunks, sizeof(*chunks), GFP_NOIO);
+		if (!chunks) {
+			chunks = &onstack;
+			nr_chunks = 1;
+			chunk_bytes = src_iter.bi_size;
+		}
+	}
+
+	memcpy(dun, bc->bc_dun, sizeof(dun));
+	atomic_set(&pending, nr_chunks - 1);
+
+	for (i = 0; i < nr_chunks; i++) {
+		struct blk_crypto_fallback_chunk *c = &chunks[i];
+		unsigned int bytes = min(chunk_bytes, src_iter.bi_size);
+
+		c->slot = slot;
+		c->src_bio = src_bio;
+		c->src_iter = src_iter;
+		c->src_iter.bi_size = bytes;
+		c->dst_bio = dst_bio;
+		c->dst_iter = dst_iter;
+		c->dst_iter.bi_size = bytes;
+		memcpy(c->dun, dun, sizeof(dun));
+		c->data_unit_size = data_unit_size;
+		c->encrypt = encrypt;
+		c->pending = &pending;
+		c->done = &done;
+
+		bio_advance_iter(src_bio, &src_iter, bytes);
+		bio_advance_iter(dst_bio, &dst_iter, bytes);
+		bio_crypt_dun_increment(dun, bytes / data_unit_size);
+
+		if (i) {
+			INIT_WORK(&c->work, blk_crypto_fallback_chunk_work);
+			queue_work(blk_crypto_chunk_wq, &c->work);
+		}
+	}
+
+	blk_crypto_fallback_crypt_chunk(&chunks[0]);
+	if (nr_chunks > 1)
+		wait_for_completion(&done);
+
+	for (i = 0; i < nr_chunks; i++) {
+		if (chunks[i].status != BLK_STS_OK) {
+			status = chunks[i].status;
+			break;
+		}
+	}
+
+	if (chunks != &onstack)
+		kfree(chunks);
+	return status;
+}
+
 /*
  * The crypto API fallback's encryption routine.
  * Allocate a bounce bio for encryption, encrypt the input bio using crypto API,
@@ -263,13 +444,7 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 	struct bio *src_bio, *enc_bio;
 	struct bio_crypt_ctx *bc;
 	struct blk_crypto_keyslot *slot;
-	int data_unit_size;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	struct scatterlist src, dst;
-	union blk_crypto_iv iv;
-	unsigned int i, j;
+	unsigned int i;
 	bool ret = false;
 	blk_status_t blk_st;
 
@@ -279,7 +454,6 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 
 	src_bio = *bio_ptr;
 	bc = src_bio->bi_crypt_context;
-	data_unit_size = bc->bc_key->crypto_cfg.data_unit_size;
 
 	/* Allocate bounce bio for encryption */
 	enc_bio = blk_crypto_fallback_clone_bio(src_bio);
@@ -299,51 +473,23 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 		goto out_put_enc_bio;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	if (!blk_crypto_fallback_alloc_cipher_req(slot, &ciph_req, &wait)) {
-		src_bio->bi_status = BLK_STS_RESOURCE;
-		goto out_release_keyslot;
-	}
-
-	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&src, 1);
-	sg_init_table(&dst, 1);
-
-	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
-				   iv.bytes);
-
-	/* Encrypt each page in the bounce bio */
+	/* Replace the plaintext pages of the bounce bio with bounce pages */
 	for (i = 0; i < enc_bio->bi_vcnt; i++) {
-		struct bio_vec *enc_bvec = &enc_bio->bi_io_vec[i];
-		struct page *plaintext_page = enc_bvec->bv_page;
 		struct page *ciphertext_page =
 			mempool_alloc(blk_crypto_bounce_page_pool, GFP_NOIO);
 
-		enc_bvec->bv_page = ciphertext_page;
-
 		if (!ciphertext_page) {
 			src_bio->bi_status = BLK_STS_RESOURCE;
 			goto out_free_bounce_pages;
 		}
+		enc_bio->bi_io_vec[i].bv_page = ciphertext_page;
+	}
 
-		sg_set_page(&src, plaintext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-		sg_set_page(&dst, ciphertext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-
-		/* Encrypt each data unit in this page */
-		for (j = 0; j < enc_bvec->bv_len; j += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_encrypt(ciph_req),
-					    &wait)) {
-				i++;
-				src_bio->bi_status = BLK_STS_IOERR;
-				goto out_free_bounce_pages;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			src.offset += data_unit_size;
-			dst.offset += data_unit_size;
-		}
+	blk_st = blk_crypto_fallback_crypt(slot, src_bio, src_bio->bi_iter,
+					   enc_bio, enc_bio->bi_iter, bc, true);
+	if (blk_st != BLK_STS_OK) {
+		src_bio->bi_status = blk_st;
+		goto out_free_bounce_pages;
 	}
 
 	enc_bio->bi_private = src_bio;
@@ -352,14 +498,12 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 	ret = true;
 
 	enc_bio = NULL;
-	goto out_free_ciph_req;
+	goto out_release_keyslot;
 
 out_free_bounce_pages:
 	while (i > 0)
 		mempool_free(enc_bio->bi_io_vec[--i].bv_page,
 			     blk_crypto_bounce_page_pool);
-out_free_ciph_req:
-	skcipher_request_free(ciph_req);
 out_release_keyslot:
 	blk_crypto_put_keyslot(slot);
 out_put_enc_bio:
@@ -380,15 +524,6 @@ static void blk_crypto_fallback_decrypt_bio(struct work_struct *work)
 	struct bio *bio = f_ctx->bio;
 	struct bio_crypt_ctx *bc = &f_ctx->crypt_ctx;
 	struct blk_crypto_keyslot *slot;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist sg;
-	struct bio_vec bv;
-	struct bvec_iter iter;
-	const int data_unit_size = bc->bc_key->crypto_cfg.data_unit_size;
-	unsigned int i;
 	blk_status_t blk_st;
 
 	/*
@@ -402,38 +537,11 @@ static void blk_crypto_fallback_decrypt_bio(struct work_struct *work)
 		goto out_no_keyslot;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	if (!blk_crypto_fallback_alloc_cipher_req(slot, &ciph_req, &wait)) {
-		bio->bi_status = BLK_STS_RESOURCE;
-		goto out;
-	}
-
-	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&sg, 1);
-	skcipher_request_set_crypt(ciph_req, &sg, &sg, data_unit_size,
-				   iv.bytes);
-
-	/* Decrypt each segment in the bio */
-	__bio_for_each_segment(bv, bio, iter, f_ctx->crypt_iter) {
-		struct page *page = bv.bv_page;
-
-		sg_set_page(&sg, page, data_unit_size, bv.bv_offset);
-
-		/* Decrypt each data unit in the segment */
-		for (i = 0; i < bv.bv_len; i += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_decrypt(ciph_req),
-					    &wait)) {
-				bio->bi_status = BLK_STS_IOERR;
-				goto out;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			sg.offset += data_unit_size;
-		}
-	}
+	blk_st = blk_crypto_fallback_crypt(slot, bio, f_ctx->crypt_iter,
+					   bio, f_ctx->crypt_iter, bc, false);
+	if (blk_st != BLK_STS_OK)
+		bio->bi_status = blk_st;
 
-out:
-	skcipher_request_free(ciph_req);
 	blk_crypto_put_keyslot(slot);
 out_no_keyslot:
 	mempool_free(f_ctx, bio_fallback_crypt_ctx_pool);
@@ -572,11 +680,17 @@ static int blk_crypto_fallback_init(void)
 	if (!blk_crypto_wq)
 		goto fail_destroy_profile;
 
+	blk_crypto_chunk_wq = alloc_workqueue("blk_crypto_chunk_wq",
+					      WQ_UNBOUND | WQ_HIGHPRI |
+					      WQ_MEM_RECLAIM, 0);
+	if (!blk_crypto_chunk_wq)
+		goto fail_free_wq;
+
 	blk_crypto_keyslots = kcalloc(blk_crypto_num_keyslots,
 				      sizeof(blk_crypto_keyslots[0]),
 				      GFP_KERNEL);
 	if (!blk_crypto_keyslots)
-		goto fail_free_wq;
+		goto fail_free_chunk_wq;
 
 	blk_crypto_bounce_page_pool =
 		mempool_create_page_pool(num_prealloc_bounce_pg, 0);
@@ -602,6 +716,8 @@ static int blk_crypto_fallback_init(void)
 	mempool_destroy(blk_crypto_bounce_page_pool);
 fail_free_keyslots:
 	kfree(blk_crypto_keyslots);
+fail_free_chunk_wq:
+	destroy_workqueue(blk_crypto_chunk_wq);
 fail_free_wq:
 	destroy_workqueue(blk_crypto_wq);
 fail_destroy_profile:
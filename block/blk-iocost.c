@@ -44,7 +44,10 @@
  * /sys/fs/cgroup/io.cost.model.
  *
  * If needed, tools/cgroup/iocost_coef_gen.py can be used to generate
- * device-specific coefficients.
+ * device-specific coefficients.  Alternatively, "ctrl=calib" fits the
+ * coefficients online: the cost of the IOs issued in each period is compared
+ * against the length of the period while the device is saturated, and each
+ * coefficient is nudged by its share of the error.
  *
  * 2. Control Strategy
  *
@@ -294,6 +297,20 @@ enum {
 	MIN_DELAY		= 250,
 	MAX_DELAY		= 250 * USEC_PER_MSEC,
 
+	/*
+	 * Online cost model calibration.  Periods with fewer IOs than
+	 * CALIB_MIN_IOS are ignored.  Each step corrects 1/2^CALIB_GAIN_SHIFT
+	 * of the error and the coefficients stay within CALIB_RANGE times of
+	 * where calibration started.  The model in effect is only replaced
+	 * once a coefficient drifted by more than CALIB_HYST_PCT and at least
+	 * CALIB_COMMIT_PERIODS periods passed since the last replacement.
+	 */
+	CALIB_MIN_IOS		= 64,
+	CALIB_GAIN_SHIFT	= 3,
+	CALIB_RANGE		= 4,
+	CALIB_HYST_PCT		= 10,
+	CALIB_COMMIT_PERIODS	= 16,
+
 	/* halve debts if avg usage over 100ms is under 50% */
 	DFGV_USAGE_PCT		= 50,
 	DFGV_PERIOD		= 100 * USEC_PER_MSEC,
@@ -400,6 +417,10 @@ struct ioc_pcpu_stat {
 
 	local64_t			rq_wait_ns;
 	u64				last_rq_wait_ns;
+
+	/* issued pages and IOs per LCOEF_*, for cost model calibration */
+	local64_t			calib_nr[NR_LCOEFS];
+	u64				last_calib_nr[NR_LCOEFS];
 };
 
 /* per device */
@@ -445,6 +466,12 @@ struct ioc {
 	int				autop_idx;
 	bool				user_qos_params:1;
 	bool				user_cost_model:1;
+	bool				calib_cost_model:1;
+
+	/* online cost model calibration, see ioc_calib_cost_model() */
+	u64				calib_lcoefs[NR_LCOEFS];
+	u64				calib_base[NR_LCOEFS];
+	u32				calib_periods;
 };
 
 struct iocg_pcpu_stat {
@@ -905,6 +932,15 @@ static void ioc_refresh_lcoefs(struct ioc *ioc)
 		    &c[LCOEF_WPAGE], &c[LCOEF_WSEQIO], &c[LCOEF_WRANDIO]);
 }
 
+/* the inverse of calc_lcoefs() */
+static void calc_i_lcoefs(u64 page, u64 seqio, u64 randio,
+			  u64 *bps, u64 *seqiops, u64 *randiops)
+{
+	*bps = page ? div64_u64(VTIME_PER_SEC * IOC_PAGE_SIZE, page) : 0;
+	*seqiops = div64_u64(VTIME_PER_SEC, max(seqio + page, 1ULL));
+	*randiops = div64_u64(VTIME_PER_SEC, max(randio + page, 1ULL));
+}
+
 /*
  * struct gendisk is required as an argument because ioc->rqos.disk
  * is not properly initialized when called from the init path.
@@ -2220,6 +2256,107 @@ static int ioc_check_iocgs(struct ioc *ioc, struct ioc_now *now)
 	return nr_debtors;
 }
 
+static void ioc_calib_start(struct ioc *ioc)
+{
+	lockdep_assert_held(&ioc->lock);
+
+	memcpy(ioc->calib_lcoefs, ioc->params.lcoefs, sizeof(ioc->calib_lcoefs));
+	memcpy(ioc->calib_base, ioc->params.lcoefs, sizeof(ioc->calib_base));
+	ioc->calib_periods = 0;
+}
+
+/*
+ * Fit the linear cost model to the IOs issued during the period.  When the
+ * device is saturated, the device time the issued IOs cost should add up to
+ * the length of the period.  When the QoS targets are met with margin, it
+ * can't add up to more than that.  Each coefficient is corrected by its share
+ * of the predicted cost, so the ones which dominate the period's cost move
+ * the most.  Called with ioc->lock held at the end of each period.
+ */
+static void ioc_calib_cost_model(struct ioc *ioc, struct ioc_now *now)
+{
+	u64 nr[NR_LCOEFS] = { };
+	u64 *c = ioc->calib_lcoefs;
+	u64 *u = ioc->params.i_lcoefs;
+	u64 period_vtime, pred = 0, nr_ios = 0;
+	bool changed = false;
+	s64 err;
+	int cpu, i;
+
+	lockdep_assert_held(&ioc->lock);
+
+	for_each_online_cpu(cpu) {
+		struct ioc_pcpu_stat *stat = per_cpu_ptr(ioc->pcpu_stat, cpu);
+
+		for (i = 0; i < NR_LCOEFS; i++) {
+			u64 this_nr = local64_read(&stat->calib_nr[i]);
+
+			nr[i] += this_nr - stat->last_calib_nr[i];
+			stat->last_calib_nr[i] = this_nr;
+		}
+	}
+
+	if (!ioc->calib_cost_model)
+		return;
+
+	for (i = 0; i < NR_LCOEFS; i++) {
+		if (i != LCOEF_RPAGE && i != LCOEF_WPAGE)
+			nr_ios += nr[i];
+		pred += nr[i] * c[i];
+	}
+	if (nr_ios < CALIB_MIN_IOS || !pred)
+		return;
+
+	/*
+	 * Saturated, the period's cost should match its length.  With spare
+	 * capacity, only a cost exceeding the period tells us anything.
+	 */
+	period_vtime = (now->now - ioc->period_at) * VTIME_PER_USEC;
+	if (!ioc->busy_level ||
+	    (ioc->busy_level < 0 && pred <= period_vtime))
+		return;
+
+	/* relative error in 1/1024, correct at most by -50% and +100% */
+	err = div64_s64(((s64)period_vtime - (s64)pred) * 1024, pred);
+	err = clamp_t(s64, err, -512, 1024);
+
+	for (i = 0; i < NR_LCOEFS; i++) {
+		s64 share, step;
+
+		if (!nr[i] || !c[i])
+			continue;
+
+		share = mul_u64_u64_div_u64(nr[i] * c[i], 1024, pred);
+		step = div_s64((s64)c[i] * div_s64(err * share, 1024), 1024);
+		step >>= CALIB_GAIN_SHIFT;
+		c[i] = clamp_t(u64, (s64)c[i] + step,
+			       max_t(u64, ioc->calib_base[i] / CALIB_RANGE, 1),
+			       ioc->calib_base[i] * CALIB_RANGE);
+	}
+
+	/* hysteresis, don't churn the model in effect over small changes */
+	if (++ioc->calib_periods < CALIB_COMMIT_PERIODS)
+		return;
+
+	for (i = 0; i < NR_LCOEFS; i++) {
+		u64 cur = ioc->params.lcoefs[i];
+
+		if (abs_diff(c[i], cur) * 100 > cur * CALIB_HYST_PCT)
+			changed = true;
+	}
+	if (!changed)
+		return;
+
+	calc_i_lcoefs(c[LCOEF_RPAGE], c[LCOEF_RSEQIO], c[LCOEF_RRANDIO],
+		      &u[I_LCOEF_RBPS], &u[I_LCOEF_RSEQIOPS],
+		      &u[I_LCOEF_RRANDIOPS]);
+	calc_i_lcoefs(c[LCOEF_WPAGE], c[LCOEF_WSEQIO], c[LCOEF_WRANDIO],
+		      &u[I_LCOEF_WBPS], &u[I_LCOEF_WSEQIOPS],
+		      &u[I_LCOEF_WRANDIOPS]);
+	ioc_refresh_lcoefs(ioc);
+	ioc->calib_periods = 0;
+}
+
 static void ioc_timer_fn(struct timer_list *timer)
 {
 	struct ioc *ioc = container_of(timer, struct ioc, timer);
@@ -2418,6 +2555,8 @@ static void ioc_timer_fn(struct timer_list *timer)
 
 	ioc->busy_level = clamp(ioc->busy_level, -1000, 1000);
 
+	ioc_calib_cost_model(ioc, &now);
+
 	ioc_adjust_base_vrate(ioc, rq_wait_pct, nr_lagging, nr_shortages,
 			      prev_busy_level, missed_ppm);
 
@@ -2515,6 +2654,7 @@ static void calc_vtime_cost_builtin(struct bio *bio, struct ioc_gq *iocg,
 	u64 pages = max_t(u64, bio_sectors(bio) >> IOC_SECT_TO_PAGE_SHIFT, 1);
 	u64 seek_pages = 0;
 	u64 cost = 0;
+	int lidx = -1;
 
 	/* Can't calculate cost for empty bio */
 	if (!bio->bi_iter.bi_size)
@@ -2525,11 +2665,13 @@ static void calc_vtime_cost_builtin(struct bio *bio, struct ioc_gq *iocg,
 		coef_seqio	= ioc->params.lcoefs[LCOEF_RSEQIO];
 		coef_randio	= ioc->params.lcoefs[LCOEF_RRANDIO];
 		coef_page	= ioc->params.lcoefs[LCOEF_RPAGE];
+		lidx		= LCOEF_RPAGE;
 		break;
 	case REQ_OP_WRITE:
 		coef_seqio	= ioc->params.lcoefs[LCOEF_WSEQIO];
 		coef_randio	= ioc->params.lcoefs[LCOEF_WRANDIO];
 		coef_page	= ioc->params.lcoefs[LCOEF_WPAGE];
+		lidx		= LCOEF_WPAGE;
 		break;
 	default:
 		goto out;
@@ -2548,6 +2690,16 @@ static void calc_vtime_cost_builtin(struct bio *bio, struct ioc_gq *iocg,
 		}
 	}
 	cost += pages * coef_page;
+
+	if (ioc->calib_cost_model) {
+		struct ioc_pcpu_stat *ccs = get_cpu_ptr(ioc->pcpu_stat);
+
+		local64_add(pages, &ccs->calib_nr[lidx]);
+		if (!is_merge)
+			local64_inc(&ccs->calib_nr[seek_pages > LCOEF_RANDIO_PAGES ?
+						   lidx + 2 : lidx + 1]);
+		put_cpu_ptr(ccs);
+	}
 out:
 	*costp = cost;
 }
@@ -2883,6 +3035,8 @@ static int blk_iocost_init(struct gendisk *disk)
 			local_set(&ccs->missed[i].nr_missed, 0);
 		}
 		local64_set(&ccs->rq_wait_ns, 0);
+		for (i = 0; i < NR_LCOEFS; i++)
+			local64_set(&ccs->calib_nr[i], 0);
 	}
 
 	spin_lock_init(&ioc->lock);
@@ -3357,7 +3511,8 @@ static u64 ioc_cost_model_prfill(struct seq_file *sf,
 	seq_printf(sf, "%s ctrl=%s model=linear "
 		   "rbps=%llu rseqiops=%llu rrandiops=%llu "
 		   "wbps=%llu wseqiops=%llu wrandiops=%llu\n",
-		   dname, ioc->user_cost_model ? "user" : "auto",
+		   dname, ioc->calib_cost_model ? "calib" :
+		   ioc->user_cost_model ? "user" : "auto",
 		   u[I_LCOEF_RBPS], u[I_LCOEF_RSEQIOPS], u[I_LCOEF_RRANDIOPS],
 		   u[I_LCOEF_WBPS], u[I_LCOEF_WSEQIOPS], u[I_LCOEF_WRANDIOPS]);
 	spin_unlock_irq(&ioc->lock);
@@ -3396,7 +3551,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	struct request_queue *q;
 	struct ioc *ioc;
 	u64 u[NR_I_LCOEFS];
-	bool user;
+	bool user, calib;
 	char *body, *p;
 	int ret;
 
@@ -3427,6 +3582,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	spin_lock_irq(&ioc->lock);
 	memcpy(u, ioc->params.i_lcoefs, sizeof(u));
 	user = ioc->user_cost_model;
+	calib = ioc->calib_cost_model;
 
 	while ((p = strsep(&body, " \t\n"))) {
 		substring_t args[MAX_OPT_ARGS];
@@ -3440,12 +3596,18 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 		switch (match_token(p, cost_ctrl_tokens, args)) {
 		case COST_CTRL:
 			match_strlcpy(buf, &args[0], sizeof(buf));
-			if (!strcmp(buf, "auto"))
+			if (!strcmp(buf, "auto")) {
 				user = false;
-			else if (!strcmp(buf, "user"))
+				calib = false;
+			} else if (!strcmp(buf, "user")) {
 				user = true;
-			else
+				calib = false;
+			} else if (!strcmp(buf, "calib")) {
+				user = true;
+				calib = true;
+			} else {
 				goto einval;
+			}
 			continue;
 		case COST_MODEL:
 			match_strlcpy(buf, &args[0], sizeof(buf));
@@ -3469,7 +3631,11 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	} else {
 		ioc->user_cost_model = false;
 	}
+	ioc->calib_cost_model = calib;
 	ioc_refresh_params(ioc, true);
+	/* (re)start calibration from the model just configured */
+	if (calib)
+		ioc_calib_start(ioc);
 	spin_unlock_irq(&ioc->lock);
 
 	blk_mq_unquiesce_queue(q);
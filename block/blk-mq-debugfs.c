@@ -155,12 +155,83 @@ static ssize_t queue_state_write(void *data, const char __user *buf,
 	return count;
 }
 
+static int queue_lat_stats_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+
+	seq_printf(m, "%d\n", q->lat_stats);
+	return 0;
+}
+
+/*
+ * Writing 1 allocates the per-hctx latency breakdown and turns on request
+ * timestamps, writing 0 frees it again.  Hardware queues added afterwards by
+ * a change of nr_hw_queues are only covered after writing 1 again.
+ *
+ * This can't use ->debugfs_mutex, which is held while removing the files.
+ */
+static DEFINE_MUTEX(blk_mq_lat_stats_lock);
+
+static ssize_t queue_lat_stats_write(void *data, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct request_queue *q = data;
+	struct blk_mq_lat_stats __percpu *stats;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long i;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(buf, count, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&blk_mq_lat_stats_lock);
+	if (enable) {
+		queue_for_each_hw_ctx(q, hctx, i) {
+			if (hctx->lat_stats)
+				continue;
+			stats = alloc_percpu(struct blk_mq_lat_stats);
+			if (!stats) {
+				ret = -ENOMEM;
+				break;
+			}
+			WRITE_ONCE(hctx->lat_stats, stats);
+		}
+		if (!q->lat_stats) {
+			blk_stat_enable_accounting(q);
+			if (IS_ENABLED(CONFIG_BLK_RQ_ALLOC_TIME))
+				blk_queue_flag_set(QUEUE_FLAG_RQ_ALLOC_TIME, q);
+			WRITE_ONCE(q->lat_stats, true);
+		}
+	} else if (q->lat_stats) {
+		/* no request or dispatch may be looking at the stats */
+		blk_mq_freeze_queue(q);
+		blk_mq_quiesce_queue(q);
+		/* the hctx files check ->lat_stats under the RCU read lock */
+		WRITE_ONCE(q->lat_stats, false);
+		synchronize_rcu();
+		queue_for_each_hw_ctx(q, hctx, i) {
+			stats = hctx->lat_stats;
+			WRITE_ONCE(hctx->lat_stats, NULL);
+			free_percpu(stats);
+		}
+		blk_stat_disable_accounting(q);
+		blk_mq_unquiesce_queue(q);
+		blk_mq_unfreeze_queue(q);
+	}
+	mutex_unlock(&blk_mq_lat_stats_lock);
+
+	return ret ?: count;
+}
+
 static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
 	{ "poll_stat", 0400, queue_poll_stat_show },
 	{ "requeue_list", 0400, .seq_ops = &queue_requeue_list_seq_ops },
 	{ "pm_only", 0600, queue_pm_only_show, NULL },
 	{ "state", 0600, queue_state_show, queue_state_write },
 	{ "zone_wlock", 0400, queue_zone_wlock_show, NULL },
+	{ "lat_stats", 0600, queue_lat_stats_show, queue_lat_stats_write },
 	{ },
 };
 
@@ -497,6 +568,129 @@ static ssize_t hctx_run_write(void *data, const char __user *buf, size_t count,
 	return count;
 }
 
+static void blk_mq_lat_add(struct blk_mq_lat_stats __percpu *stats,
+			   enum blk_mq_lat_phase phase, u64 start, u64 end)
+{
+	u64 us;
+
+	/* timestamps can be missing for requests started before enabling */
+	if (!start || end < start)
+		return;
+
+	us = div_u64(end - start, NSEC_PER_USEC);
+	this_cpu_inc(stats->nr[phase]);
+	this_cpu_add(stats->total_ns[phase], end - start);
+	this_cpu_inc(stats->hist[phase][us ? min_t(int, ilog2(us) + 1,
+						   BLK_MQ_LAT_BUCKETS - 1) : 0]);
+}
+
+void __blk_mq_debugfs_rq_done(struct request *rq, u64 now)
+{
+	struct blk_mq_lat_stats __percpu *stats = READ_ONCE(rq->mq_hctx->lat_stats);
+	u64 issue = rq->io_start_time_ns;
+	/* ->queue_rqs() hands plugged requests straight to the driver */
+	u64 dispatch = rq->dispatch_time_ns ?: issue;
+
+	if (!stats)
+		return;
+
+#ifdef CONFIG_BLK_RQ_ALLOC_TIME
+	if (rq->alloc_time_ns != rq->start_time_ns)
+		blk_mq_lat_add(stats, BLK_MQ_LAT_TAG, rq->alloc_time_ns,
+			       rq->start_time_ns);
+#endif
+	blk_mq_lat_add(stats, BLK_MQ_LAT_QUEUE, rq->start_time_ns, dispatch);
+	blk_mq_lat_add(stats, BLK_MQ_LAT_DISPATCH, dispatch, issue);
+	blk_mq_lat_add(stats, BLK_MQ_LAT_DEVICE, issue, now);
+}
+
+static const char *const blk_mq_lat_phase_name[BLK_MQ_LAT_NR] = {
+	[BLK_MQ_LAT_TAG]	= "tag",
+	[BLK_MQ_LAT_QUEUE]	= "queue",
+	[BLK_MQ_LAT_DISPATCH]	= "dispatch",
+	[BLK_MQ_LAT_DEVICE]	= "device",
+};
+
+static const char *const blk_mq_busy_reason_name[BLK_MQ_BUSY_NR] = {
+	[BLK_MQ_BUSY_NO_BUDGET]		= "no_budget",
+	[BLK_MQ_BUSY_NO_TAG]		= "no_tag",
+	[BLK_MQ_BUSY_RESOURCE]		= "resource",
+	[BLK_MQ_BUSY_DEV_RESOURCE]	= "dev_resource",
+	[BLK_MQ_BUSY_ZONE_RESOURCE]	= "zone_resource",
+	[BLK_MQ_BUSY_REQUEUE]		= "requeue",
+};
+
+static u64 blk_mq_lat_sum(struct blk_mq_lat_stats __percpu *stats,
+			  size_t offset)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += READ_ONCE(*(u64 *)((void *)per_cpu_ptr(stats, cpu) +
+					  offset));
+	return sum;
+}
+
+static int hctx_lat_stats_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	struct blk_mq_lat_stats __percpu *stats;
+	int phase, i;
+
+	rcu_read_lock();
+	stats = READ_ONCE(hctx->queue->lat_stats) ? hctx->lat_stats : NULL;
+	if (!stats)
+		goto out;
+
+	for (phase = 0; phase < BLK_MQ_LAT_NR; phase++) {
+		u64 nr = blk_mq_lat_sum(stats, offsetof(struct blk_mq_lat_stats,
+							nr[phase]));
+		u64 total = blk_mq_lat_sum(stats,
+				offsetof(struct blk_mq_lat_stats,
+					 total_ns[phase]));
+
+		seq_printf(m, "%s nr=%llu avg_us=%llu hist_log2_us=",
+			   blk_mq_lat_phase_name[phase], nr,
+			   nr ? div64_u64(total, nr) / NSEC_PER_USEC : 0);
+		for (i = 0; i < BLK_MQ_LAT_BUCKETS; i++) {
+			u64 cnt = blk_mq_lat_sum(stats,
+					offsetof(struct blk_mq_lat_stats,
+						 hist[phase][i]));
+
+			if (cnt)
+				seq_printf(m, " %d:%llu", i, cnt);
+		}
+		seq_putc(m, '\n');
+	}
+
+	seq_puts(m, "busy");
+	for (i = 0; i < BLK_MQ_BUSY_NR; i++)
+		seq_printf(m, " %s=%llu", blk_mq_busy_reason_name[i],
+			   blk_mq_lat_sum(stats,
+				offsetof(struct blk_mq_lat_stats, busy[i])));
+	seq_putc(m, '\n');
+out:
+	rcu_read_unlock();
+	return 0;
+}
+
+static ssize_t hctx_lat_stats_write(void *data, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	struct blk_mq_lat_stats __percpu *stats;
+	int cpu;
+
+	rcu_read_lock();
+	stats = READ_ONCE(hctx->queue->lat_stats) ? hctx->lat_stats : NULL;
+	if (stats)
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(stats, cpu), 0, sizeof(*stats));
+	rcu_read_unlock();
+	return count;
+}
+
 static int hctx_active_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -629,6 +823,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_hctx_attrs[] = {
 	{"active", 0400, hctx_active_show},
 	{"dispatch_busy", 0400, hctx_dispatch_busy_show},
 	{"type", 0400, hctx_type_show},
+	{"lat_stats", 0600, hctx_lat_stats_show, hctx_lat_stats_write},
 	{},
 };
 
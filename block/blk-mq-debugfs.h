@@ -2,6 +2,26 @@
 #ifndef INT_BLK_MQ_DEBUGFS_H
 #define INT_BLK_MQ_DEBUGFS_H
 
+/* Phases of the life of a request tracked by the hctx "lat_stats" file */
+enum blk_mq_lat_phase {
+	BLK_MQ_LAT_TAG,		/* waiting for a tag, needs RQ_ALLOC_TIME */
+	BLK_MQ_LAT_QUEUE,	/* inserted until handed to the dispatch path */
+	BLK_MQ_LAT_DISPATCH,	/* dispatch path until issued to the driver */
+	BLK_MQ_LAT_DEVICE,	/* issued until completed */
+	BLK_MQ_LAT_NR,
+};
+
+/* Reasons why a request could not be issued when dispatched */
+enum blk_mq_busy_reason {
+	BLK_MQ_BUSY_NO_BUDGET,
+	BLK_MQ_BUSY_NO_TAG,
+	BLK_MQ_BUSY_RESOURCE,
+	BLK_MQ_BUSY_DEV_RESOURCE,
+	BLK_MQ_BUSY_ZONE_RESOURCE,
+	BLK_MQ_BUSY_REQUEUE,
+	BLK_MQ_BUSY_NR,
+};
+
 #ifdef CONFIG_BLK_DEBUG_FS
 
 #include <linux/seq_file.h>
@@ -35,6 +55,51 @@ void blk_mq_debugfs_unregister_sched_hctx(struct blk_mq_hw_ctx *hctx);
 
 void blk_mq_debugfs_register_rqos(struct rq_qos *rqos);
 void blk_mq_debugfs_unregister_rqos(struct rq_qos *rqos);
+
+/* log2 of microseconds, the last bucket collects everything from 4s */
+#define BLK_MQ_LAT_BUCKETS	24
+
+struct blk_mq_lat_stats {
+	u64	nr[BLK_MQ_LAT_NR];
+	u64	total_ns[BLK_MQ_LAT_NR];
+	u64	hist[BLK_MQ_LAT_NR][BLK_MQ_LAT_BUCKETS];
+	u64	busy[BLK_MQ_BUSY_NR];
+};
+
+void __blk_mq_debugfs_rq_done(struct request *rq, u64 now);
+
+static inline void blk_mq_debugfs_rq_dispatch(struct request *rq)
+{
+	if (unlikely(READ_ONCE(rq->mq_hctx->lat_stats)) &&
+	    !rq->dispatch_time_ns)
+		rq->dispatch_time_ns = ktime_get_ns();
+}
+
+static inline void blk_mq_debugfs_rq_done(struct request *rq, u64 now)
+{
+	if (rq->mq_hctx && unlikely(READ_ONCE(rq->mq_hctx->lat_stats)))
+		__blk_mq_debugfs_rq_done(rq, now);
+}
+
+static inline void blk_mq_debugfs_busy(struct blk_mq_hw_ctx *hctx,
+				       enum blk_mq_busy_reason reason)
+{
+	struct blk_mq_lat_stats __percpu *stats = READ_ONCE(hctx->lat_stats);
+
+	if (unlikely(stats))
+		this_cpu_inc(stats->busy[reason]);
+}
+
+static inline void blk_mq_debugfs_queue_rq_busy(struct blk_mq_hw_ctx *hctx,
+						blk_status_t ret)
+{
+	if (ret == BLK_STS_RESOURCE)
+		blk_mq_debugfs_busy(hctx, BLK_MQ_BUSY_RESOURCE);
+	else if (ret == BLK_STS_DEV_RESOURCE)
+		blk_mq_debugfs_busy(hctx, BLK_MQ_BUSY_DEV_RESOURCE);
+	else if (ret == BLK_STS_ZONE_RESOURCE)
+		blk_mq_debugfs_busy(hctx, BLK_MQ_BUSY_ZONE_RESOURCE);
+}
 #else
 static inline void blk_mq_debugfs_register(struct request_queue *q)
 {
@@ -81,6 +146,24 @@ static inline void blk_mq_debugfs_register_rqos(struct rq_qos *rqos)
 static inline void blk_mq_debugfs_unregister_rqos(struct rq_qos *rqos)
 {
 }
+
+static inline void blk_mq_debugfs_rq_dispatch(struct request *rq)
+{
+}
+
+static inline void blk_mq_debugfs_rq_done(struct request *rq, u64 now)
+{
+}
+
+static inline void blk_mq_debugfs_busy(struct blk_mq_hw_ctx *hctx,
+				       enum blk_mq_busy_reason reason)
+{
+}
+
+static inline void blk_mq_debugfs_queue_rq_busy(struct blk_mq_hw_ctx *hctx,
+						blk_status_t ret)
+{
+}
 #endif
 
 #ifdef CONFIG_BLK_DEBUG_FS_ZONED
@@ -130,6 +130,129 @@ unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
 	return ret;
 }
 
+/*
+ * Without a plug every allocation goes to the sbitmap, and with fewer hardware
+ * queues than CPUs its words bounce between all CPUs sharing the hctx.  So each
+ * software queue borrows a small batch of tags and hands them out one by one.
+ * Unused tags go back once somebody has to wait for a tag, when the hctx goes
+ * offline, and on freeze.  Cached tags keep their sbitmap bits set and look
+ * like requests in flight to the tag iterators until they are given back.
+ */
+#define BLK_MQ_TAG_CACHE_BATCH	8
+
+static unsigned int blk_mq_tag_cache_batch(struct blk_mq_hw_ctx *hctx,
+					   struct sbitmap_queue *bt)
+{
+	unsigned int depth = bt->sb.depth;
+	unsigned int users;
+
+	/* with shared tags, only borrow out of this queue's fair share */
+	if (hctx->flags & BLK_MQ_F_TAG_QUEUE_SHARED) {
+		users = READ_ONCE(hctx->tags->active_queues);
+		if (users > 1)
+			depth /= users;
+	}
+
+	/* and leave at least half of it outside of the caches */
+	return min_t(unsigned int, BLK_MQ_TAG_CACHE_BATCH,
+		     depth / (2 * max_t(unsigned int, hctx->nr_ctx, 1)));
+}
+
+static int blk_mq_tag_cache_get(struct blk_mq_alloc_data *data)
+{
+	struct blk_mq_tags *tags = data->hctx->tags;
+	struct blk_mq_tag_cache *tc = &data->ctx->tag_cache[data->hctx->type];
+	int tag = BLK_MQ_NO_TAG;
+	unsigned int nr, offset;
+	unsigned long mask;
+
+	if (data->shallow_depth || data->flags & BLK_MQ_REQ_RESERVED ||
+	    data->rq_flags & RQF_SCHED_TAGS)
+		return BLK_MQ_NO_TAG;
+	if (!hctx_may_queue(data->hctx, &tags->bitmap_tags))
+		return BLK_MQ_NO_TAG;
+	/* don't refill behind blk_mq_hctx_notify_offline() draining the caches */
+	if (test_bit(BLK_MQ_S_INACTIVE, &data->hctx->state))
+		return BLK_MQ_NO_TAG;
+
+	spin_lock(&tc->lock);
+	if (!tc->mask) {
+		nr = blk_mq_tag_cache_batch(data->hctx, &tags->bitmap_tags);
+		if (nr < 2)
+			goto out;
+		mask = __sbitmap_queue_get_batch(&tags->bitmap_tags, nr,
+						 &offset);
+		if (!mask)
+			goto out;
+		tc->mask = mask;
+		tc->offset = offset;
+	}
+	tag = __ffs(tc->mask);
+	__clear_bit(tag, &tc->mask);
+	tag += tc->offset;
+out:
+	spin_unlock(&tc->lock);
+	return tag;
+}
+
+/*
+ * Give the tags borrowed by @ctx for @hctx back to the sbitmap.
+ */
+void blk_mq_tag_cache_flush(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx)
+{
+	struct blk_mq_tag_cache *tc = &ctx->tag_cache[hctx->type];
+	unsigned int offset, bit;
+	unsigned long mask;
+
+	spin_lock(&tc->lock);
+	mask = tc->mask;
+	offset = tc->offset;
+	tc->mask = 0;
+	spin_unlock(&tc->lock);
+
+	for_each_set_bit(bit, &mask, BITS_PER_LONG)
+		sbitmap_queue_clear(&hctx->tags->bitmap_tags, offset + bit,
+				    ctx->cpu);
+}
+
+void blk_mq_tag_cache_drain(struct blk_mq_hw_ctx *hctx)
+{
+	struct blk_mq_ctx *ctx;
+	unsigned int i;
+
+	hctx_for_each_ctx(hctx, ctx, i)
+		blk_mq_tag_cache_flush(hctx, ctx);
+}
+
+/*
+ * Give back the tags cached for @hctx->tags by every queue of the tag set.
+ * With shared tags the other queues' software queues borrow from the same
+ * sbitmap, and nothing else makes them return what they don't use.
+ *
+ * The tag set lock is only tried: it is held across queue freezes, which
+ * wait for the very requests a caller of this may be holding.  Callers are
+ * retry loops, so a contended lock only delays the drain to the next round.
+ */
+void blk_mq_tag_cache_drain_shared(struct blk_mq_hw_ctx *hctx)
+{
+	struct blk_mq_tag_set *set = hctx->queue->tag_set;
+	struct blk_mq_hw_ctx *other;
+	struct request_queue *q;
+	unsigned long i;
+
+	blk_mq_tag_cache_drain(hctx);
+
+	if (!(hctx->flags & BLK_MQ_F_TAG_QUEUE_SHARED) ||
+	    !mutex_trylock(&set->tag_list_lock))
+		return;
+	list_for_each_entry(q, &set->tag_list, tag_set_list) {
+		queue_for_each_hw_ctx(q, other, i)
+			if (other != hctx && other->tags == hctx->tags)
+				blk_mq_tag_cache_drain(other);
+	}
+	mutex_unlock(&set->tag_list_lock);
+}
+
 unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 {
 	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
@@ -151,7 +274,9 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 		tag_offset = tags->nr_reserved_tags;
 	}
 
-	tag = __blk_mq_get_tag(data, bt);
+	tag = blk_mq_tag_cache_get(data);
+	if (tag == BLK_MQ_NO_TAG)
+		tag = __blk_mq_get_tag(data, bt);
 	if (tag != BLK_MQ_NO_TAG)
 		goto found_tag;
 
@@ -169,6 +294,14 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 		 */
 		blk_mq_run_hw_queue(data->hctx, false);
 
+		/*
+		 * The missing tags may be sitting in the caches of other
+		 * CPUs or other queues of a shared tag set, which won't hand
+		 * them out until they submit again.
+		 */
+		if (!(data->rq_flags & RQF_SCHED_TAGS))
+			blk_mq_tag_cache_drain_shared(data->hctx);
+
 		/*
 		 * Retry tag allocation after running the hardware queue,
 		 * as running the queue may also have found completions.
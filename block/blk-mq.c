@@ -135,18 +135,39 @@ void blk_freeze_queue_start(struct request_queue *q)
 }
 EXPORT_SYMBOL_GPL(blk_freeze_queue_start);
 
+/*
+ * Nothing can allocate from a frozen queue, so return the tags cached by the
+ * software queues before the tag maps or queue mapping change under them.
+ */
+static void blk_mq_drain_tag_caches(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long i;
+
+	if (!queue_is_mq(q))
+		return;
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_tag_cache_drain(hctx);
+}
+
 void blk_mq_freeze_queue_wait(struct request_queue *q)
 {
 	wait_event(q->mq_freeze_wq, percpu_ref_is_zero(&q->q_usage_counter));
+	blk_mq_drain_tag_caches(q);
 }
 EXPORT_SYMBOL_GPL(blk_mq_freeze_queue_wait);
 
 int blk_mq_freeze_queue_wait_timeout(struct request_queue *q,
 				     unsigned long timeout)
 {
-	return wait_event_timeout(q->mq_freeze_wq,
+	int ret;
+
+	ret = wait_event_timeout(q->mq_freeze_wq,
 					percpu_ref_is_zero(&q->q_usage_counter),
 					timeout);
+	if (ret)
+		blk_mq_drain_tag_caches(q);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(blk_mq_freeze_queue_wait_timeout);
 
@@ -375,6 +396,9 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 
 	rq->part = NULL;
 	rq->io_start_time_ns = 0;
+#ifdef CONFIG_BLK_DEBUG_FS
+	rq->dispatch_time_ns = 0;
+#endif
 	rq->stats_sectors = 0;
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -1020,10 +1044,45 @@ static inline void blk_account_io_start(struct request *req)
 	}
 }
 
+static unsigned int blk_mq_poll_class(unsigned int sectors)
+{
+	if (sectors <= 1)
+		return 0;
+	return min_t(unsigned int, order_base_2(sectors), BLK_MQ_POLL_CLASSES - 1);
+}
+
+/*
+ * Track the service time of polled reads and writes per hardware queue and per
+ * size class for adaptive hybrid polling. A single mean over all sizes makes
+ * the sleep far too long for small requests mixed with large ones.
+ */
+static void blk_mq_poll_stats_add(struct request *rq, u64 now)
+{
+	struct blk_mq_poll_stats *ps = &rq->mq_hctx->poll_stats;
+	u32 *mean, old, val;
+
+	if (READ_ONCE(rq->q->poll_nsec) != BLK_MQ_POLL_ADAPTIVE ||
+	    !blk_rq_is_poll(rq))
+		return;
+	if (req_op(rq) != REQ_OP_READ && req_op(rq) != REQ_OP_WRITE)
+		return;
+	if (now <= rq->io_start_time_ns)
+		return;
+
+	val = min_t(u64, now - rq->io_start_time_ns, U32_MAX);
+	mean = &ps->mean_ns[op_is_write(req_op(rq))]
+			   [blk_mq_poll_class(blk_rq_stats_sectors(rq))];
+	old = READ_ONCE(*mean);
+	WRITE_ONCE(*mean, old ? old - (old >> 3) + (val >> 3) : val);
+}
+
 static inline void __blk_mq_end_request_acct(struct request *rq, u64 now)
 {
-	if (rq->rq_flags & RQF_STATS)
+	if (rq->rq_flags & RQF_STATS) {
 		blk_stat_add(rq, now);
+		blk_mq_poll_stats_add(rq, now);
+		blk_mq_debugfs_rq_done(rq, now);
+	}
 
 	blk_mq_sched_completed_request(rq, now);
 	blk_account_io_done(rq, now);
@@ -1445,6 +1504,7 @@ void blk_mq_requeue_request(struct request *rq, bool kick_requeue_list)
 	unsigned long flags;
 
 	__blk_mq_requeue_request(rq);
+	blk_mq_debugfs_busy(rq->mq_hctx, BLK_MQ_BUSY_REQUEUE);
 
 	/* this request will be re-inserted to io scheduler queue */
 	blk_mq_sched_requeue_request(rq);
@@ -2031,9 +2091,14 @@ bool blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx, struct list_head *list,
 		rq = list_first_entry(list, struct request, queuelist);
 
 		WARN_ON_ONCE(hctx != rq->mq_hctx);
+		blk_mq_debugfs_rq_dispatch(rq);
 		prep = blk_mq_prep_dispatch_rq(rq, !nr_budgets);
-		if (prep != PREP_DISPATCH_OK)
+		if (prep != PREP_DISPATCH_OK) {
+			blk_mq_debugfs_busy(hctx, prep == PREP_DISPATCH_NO_TAG ?
+					    BLK_MQ_BUSY_NO_TAG :
+					    BLK_MQ_BUSY_NO_BUDGET);
 			break;
+		}
 
 		list_del_init(&rq->queuelist);
 
@@ -2047,6 +2112,7 @@ bool blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx, struct list_head *list,
 		if (nr_budgets)
 			nr_budgets--;
 		ret = q->mq_ops->queue_rq(hctx, &bd);
+		blk_mq_debugfs_queue_rq_busy(hctx, ret);
 		switch (ret) {
 		case BLK_STS_OK:
 			queued++;
@@ -2582,12 +2648,15 @@ static blk_status_t __blk_mq_issue_directly(struct blk_mq_hw_ctx *hctx,
 	};
 	blk_status_t ret;
 
+	blk_mq_debugfs_rq_dispatch(rq);
+
 	/*
 	 * For OK queue, we are done. For error, caller may kill it.
 	 * Any other error (busy), just add it to our list as we
 	 * previously would have done.
 	 */
 	ret = q->mq_ops->queue_rq(hctx, &bd);
+	blk_mq_debugfs_queue_rq_busy(hctx, ret);
 	switch (ret) {
 	case BLK_STS_OK:
 		blk_mq_update_dispatch_busy(hctx, false);
@@ -2977,6 +3046,9 @@ void blk_mq_submit_bio(struct bio *bio)
 			return;
 	}
 
+	if (blk_queue_is_zoned(q) && blk_zone_plug_bio(bio))
+		return;
+
 	if (!bio_integrity_prep(bio))
 		return;
 
@@ -3509,10 +3581,17 @@ static int blk_mq_hctx_notify_offline(unsigned int cpu, struct hlist_node *node)
 	 * Try to grab a reference to the queue and wait for any outstanding
 	 * requests.  If we could not grab a reference the queue has been
 	 * frozen and there are no requests.
+	 *
+	 * Tags sitting in the software queue caches count as busy, so hand
+	 * them back first, and again on every round for those an allocator
+	 * racing with the INACTIVE bit may still have cached.
 	 */
 	if (percpu_ref_tryget(&hctx->queue->q_usage_counter)) {
-		while (blk_mq_hctx_has_requests(hctx))
+		blk_mq_tag_cache_drain_shared(hctx);
+		while (blk_mq_hctx_has_requests(hctx)) {
 			msleep(5);
+			blk_mq_tag_cache_drain_shared(hctx);
+		}
 		percpu_ref_put(&hctx->queue->q_usage_counter);
 	}
 
@@ -3548,6 +3627,8 @@ static int blk_mq_hctx_notify_dead(unsigned int cpu, struct hlist_node *node)
 	ctx = __blk_mq_get_ctx(hctx->queue, cpu);
 	type = hctx->type;
 
+	blk_mq_tag_cache_flush(hctx, ctx);
+
 	spin_lock(&ctx->lock);
 	if (!list_empty(&ctx->rq_lists[type])) {
 		list_splice_init(&ctx->rq_lists[type], &tmp);
@@ -3760,8 +3841,10 @@ static void blk_mq_init_cpu_queues(struct request_queue *q,
 
 		__ctx->cpu = i;
 		spin_lock_init(&__ctx->lock);
-		for (k = HCTX_TYPE_DEFAULT; k < HCTX_MAX_TYPES; k++)
+		for (k = HCTX_TYPE_DEFAULT; k < HCTX_MAX_TYPES; k++) {
 			INIT_LIST_HEAD(&__ctx->rq_lists[k]);
+			spin_lock_init(&__ctx->tag_cache[k].lock);
+		}
 
 		__ctx->queue = q;
 
@@ -4270,6 +4353,7 @@ int blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 	spin_lock_init(&q->requeue_lock);
 
 	q->nr_requests = set->queue_depth;
+	q->poll_nsec = BLK_MQ_POLL_CLASSIC;
 
 	blk_mq_init_cpu_queues(q, set->nr_hw_queues);
 	blk_mq_add_queue_tag_set(set, q);
@@ -4819,10 +4903,100 @@ static int blk_hctx_poll(struct request_queue *q, struct blk_mq_hw_ctx *hctx,
 	return 0;
 }
 
-int blk_mq_poll(struct request_queue *q, blk_qc_t cookie,
+/* Bounds of the adaptive sleep, in percent of the mean service time */
+#define BLK_MQ_POLL_SLEEP_MIN	50U
+#define BLK_MQ_POLL_SLEEP_MAX	95U
+/* Below this the timer costs more than spinning */
+#define BLK_MQ_POLL_MIN_SLEEP_NS	(5 * NSEC_PER_USEC)
+
+/*
+ * Sleep for most of the expected service time of @bio before polling for it,
+ * instead of spinning on the CPU for the whole duration. Returns true if we
+ * slept.
+ */
+static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
+				     struct blk_mq_hw_ctx *hctx,
+				     struct bio *bio)
+{
+	struct blk_mq_poll_stats *ps = &hctx->poll_stats;
+	enum hrtimer_mode mode = HRTIMER_MODE_REL;
+	int poll_nsec = READ_ONCE(q->poll_nsec);
+	struct hrtimer_sleeper hs;
+	unsigned int pct;
+	u64 nsecs;
+
+	if (poll_nsec == BLK_MQ_POLL_CLASSIC || bio_flagged(bio, BIO_POLL_SLEPT))
+		return false;
+
+	if (poll_nsec > 0) {
+		nsecs = poll_nsec;
+	} else {
+		pct = clamp(READ_ONCE(ps->sleep_pct), BLK_MQ_POLL_SLEEP_MIN,
+			    BLK_MQ_POLL_SLEEP_MAX);
+		nsecs = READ_ONCE(ps->mean_ns[op_is_write(bio_op(bio))]
+					     [blk_mq_poll_class(bio_sectors(bio))]);
+		nsecs = div_u64(nsecs * pct, 100);
+	}
+	if (nsecs < BLK_MQ_POLL_MIN_SLEEP_NS)
+		return false;
+
+	/* only sleep once per bio, later calls go straight to polling */
+	bio_set_flag(bio, BIO_POLL_SLEPT);
+
+	hrtimer_init_sleeper_on_stack(&hs, CLOCK_MONOTONIC, mode);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+	do {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		hrtimer_sleeper_start_expires(&hs, mode);
+		if (hs.task)
+			io_schedule();
+		hrtimer_cancel(&hs.timer);
+		mode = HRTIMER_MODE_ABS;
+	} while (hs.task && !signal_pending(current));
+
+	__set_current_state(TASK_RUNNING);
+	destroy_hrtimer_on_stack(&hs.timer);
+	return true;
+}
+
+/*
+ * A completion already waiting for us after the sleep means we may have
+ * overslept, an empty poll means we woke up early and have to spin. Nudge the
+ * sleep so that about half of the wakeups are early, which keeps the added
+ * latency small while still skipping most of the spinning.
+ */
+static void blk_mq_poll_hybrid_adjust(struct blk_mq_hw_ctx *hctx, bool hit)
+{
+	struct blk_mq_poll_stats *ps = &hctx->poll_stats;
+	unsigned int pct;
+
+	pct = clamp(READ_ONCE(ps->sleep_pct), BLK_MQ_POLL_SLEEP_MIN,
+		    BLK_MQ_POLL_SLEEP_MAX);
+	if (hit)
+		pct = max(pct - 1, BLK_MQ_POLL_SLEEP_MIN);
+	else
+		pct = min(pct + 1, BLK_MQ_POLL_SLEEP_MAX);
+	WRITE_ONCE(ps->sleep_pct, pct);
+}
+
+int blk_mq_poll(struct request_queue *q, struct bio *bio, blk_qc_t cookie,
 		struct io_comp_batch *iob, unsigned int flags)
 {
 	struct blk_mq_hw_ctx *hctx = xa_load(&q->hctx_table, cookie);
+	int ret;
+
+	/*
+	 * Only sleep when the caller is willing to wait for a completion, a
+	 * task that is not running is waiting for a wakeup we must not eat.
+	 */
+	if (!(flags & BLK_POLL_ONESHOT) && task_is_running(current) &&
+	    blk_mq_poll_hybrid_sleep(q, hctx, bio)) {
+		ret = q->mq_ops->poll(hctx, iob);
+		if (READ_ONCE(q->poll_nsec) == BLK_MQ_POLL_ADAPTIVE)
+			blk_mq_poll_hybrid_adjust(hctx, ret > 0);
+		if (ret)
+			return max(ret, 0);
+	}
 
 	return blk_hctx_poll(q, hctx, iob, flags);
 }
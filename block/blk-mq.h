@@ -12,6 +12,18 @@ struct blk_mq_ctxs {
 	struct blk_mq_ctx __percpu	*queue_ctx;
 };
 
+/**
+ * struct blk_mq_tag_cache - Driver tags borrowed by a software queue
+ * @lock: Protects @offset and @mask.
+ * @offset: Tag of bit 0 in @mask, not counting reserved tags.
+ * @mask: Borrowed tags that have not been handed out yet.
+ */
+struct blk_mq_tag_cache {
+	spinlock_t		lock;
+	unsigned int		offset;
+	unsigned long		mask;
+};
+
 /**
  * struct blk_mq_ctx - State for a software queue facing the submitting CPUs
  */
@@ -24,6 +36,7 @@ struct blk_mq_ctx {
 	unsigned int		cpu;
 	unsigned short		index_hw[HCTX_MAX_TYPES];
 	struct blk_mq_hw_ctx 	*hctxs[HCTX_MAX_TYPES];
+	struct blk_mq_tag_cache	tag_cache[HCTX_MAX_TYPES];
 
 	struct request_queue	*queue;
 	struct blk_mq_ctxs      *ctxs;
@@ -36,12 +49,19 @@ enum {
 	BLK_MQ_TAG_MAX		= BLK_MQ_NO_TAG - 1,
 };
 
+/*
+ * Values of request_queue->poll_nsec other than these are a fixed hybrid
+ * polling sleep in nanoseconds.
+ */
+#define BLK_MQ_POLL_CLASSIC	-1	/* spin from the start */
+#define BLK_MQ_POLL_ADAPTIVE	0	/* sleep based on completion stats */
+
 typedef unsigned int __bitwise blk_insert_t;
 #define BLK_MQ_INSERT_AT_HEAD		((__force blk_insert_t)0x01)
 
 void blk_mq_submit_bio(struct bio *bio);
-int blk_mq_poll(struct request_queue *q, blk_qc_t cookie, struct io_comp_batch *iob,
-		unsigned int flags);
+int blk_mq_poll(struct request_queue *q, struct bio *bio, blk_qc_t cookie,
+		struct io_comp_batch *iob, unsigned int flags);
 void blk_mq_exit_queue(struct request_queue *q);
 int blk_mq_update_nr_requests(struct request_queue *q, unsigned int nr);
 void blk_mq_wake_waiters(struct request_queue *q);
@@ -173,6 +193,9 @@ unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
 void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 		unsigned int tag);
 void blk_mq_put_tags(struct blk_mq_tags *tags, int *tag_array, int nr_tags);
+void blk_mq_tag_cache_flush(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx);
+void blk_mq_tag_cache_drain(struct blk_mq_hw_ctx *hctx);
+void blk_mq_tag_cache_drain_shared(struct blk_mq_hw_ctx *hctx);
 int blk_mq_tag_update_depth(struct blk_mq_hw_ctx *hctx,
 		struct blk_mq_tags **tags, unsigned int depth, bool can_grow);
 void blk_mq_tag_resize_shared_tags(struct blk_mq_tag_set *set,
@@ -394,12 +394,47 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 
 static ssize_t queue_poll_delay_show(struct request_queue *q, char *page)
 {
-	return sprintf(page, "%d\n", -1);
+	int val;
+
+	if (q->poll_nsec == BLK_MQ_POLL_CLASSIC)
+		val = BLK_MQ_POLL_CLASSIC;
+	else
+		val = q->poll_nsec / 1000;
+
+	return sprintf(page, "%d\n", val);
 }
 
+/*
+ * -1 spins for completions right away, 0 first sleeps for most of the expected
+ * service time of the bio and anything else sleeps that many microseconds.
+ */
 static ssize_t queue_poll_delay_store(struct request_queue *q, const char *page,
 				size_t count)
 {
+	int err, val;
+
+	if (!q->mq_ops || !q->mq_ops->poll)
+		return -EINVAL;
+
+	err = kstrtoint(page, 10, &val);
+	if (err < 0)
+		return err;
+
+	if (val == BLK_MQ_POLL_CLASSIC)
+		val = BLK_MQ_POLL_CLASSIC;
+	else if (val >= 0 && val <= INT_MAX / 1000)
+		val *= 1000;
+	else
+		return -EINVAL;
+
+	/* adaptive polling needs the issue time of every request */
+	if (q->poll_nsec != BLK_MQ_POLL_ADAPTIVE && val == BLK_MQ_POLL_ADAPTIVE)
+		blk_stat_enable_accounting(q);
+	else if (q->poll_nsec == BLK_MQ_POLL_ADAPTIVE &&
+		 val != BLK_MQ_POLL_ADAPTIVE)
+		blk_stat_disable_accounting(q);
+	WRITE_ONCE(q->poll_nsec, val);
+
 	return count;
 }
 
@@ -15,6 +15,13 @@
  *   scaling step of 0 if reads show up or the heavy writers finish. Unlike
  *   positive scaling steps where we shrink the monitoring window, a negative
  *   scaling step retains the default step==0 window size.
+ * - Keep a smoothed minimum read latency and its per-window gradient. If the
+ *   latency is still within target but the gradient says it will exceed it
+ *   within a couple of windows, scale down early instead of waiting for the
+ *   violation.
+ * - When page writeback has just kicked off a background flush while reads
+ *   are around, halve the window and don't boost writes, so the controller
+ *   is already watching closely when the burst of writes arrives.
  *
  * Copyright (C) 2016 Jens Axboe
  *
@@ -89,6 +96,10 @@ struct rq_wb {
 	unsigned long last_issue;		/* last non-throttled issue */
 	unsigned long last_comp;		/* last non-throttled comp */
 	unsigned long min_lat_nsec;
+
+	u64 lat_avg;				/* smoothed read min latency */
+	s64 lat_grad;				/* smoothed change per window */
+
 	struct rq_qos rqos;
 	struct rq_wait rq_wait[WBT_NUM_RWQ];
 	struct rq_depth rq_depth;
@@ -141,6 +152,17 @@ enum {
 	 * information to scale up or down, scale up.
 	 */
 	RWB_UNKNOWN_BUMP	= 5,
+
+	/*
+	 * Weight of a new window in the smoothed latency and gradient, as
+	 * 1 / 2^RWB_LAT_SHIFT
+	 */
+	RWB_LAT_SHIFT		= 2,
+
+	/*
+	 * How many windows ahead the latency gradient is extrapolated
+	 */
+	RWB_PREDICT_WINDOWS	= 2,
 };
 
 static inline bool rwb_enabled(struct rq_wb *rwb)
@@ -170,6 +192,25 @@ static bool wb_recent_wait(struct rq_wb *rwb)
 	return time_before(jiffies, wb->dirty_sleep + HZ);
 }
 
+/*
+ * If balance_dirty_pages() kicked off background writeback within the last
+ * second or so, a flush is starting and writes are about to pile up.
+ */
+static bool wb_recent_flush(struct rq_wb *rwb)
+{
+	struct bdi_writeback *wb = &rwb->rqos.disk->bdi->wb;
+
+	return time_before(jiffies, READ_ONCE(wb->dirty_flush) + HZ);
+}
+
+static bool close_io(struct rq_wb *rwb)
+{
+	const unsigned long now = jiffies;
+
+	return time_before(now, rwb->last_issue + HZ / 10) ||
+		time_before(now, rwb->last_comp + HZ / 10);
+}
+
 static inline struct rq_wait *get_rq_wait(struct rq_wb *rwb,
 					  enum wbt_flags wb_acct)
 {
@@ -299,8 +340,39 @@ enum {
 	LAT_UNKNOWN,
 	LAT_UNKNOWN_WRITES,
 	LAT_EXCEEDED,
+	LAT_PREDICTED,
 };
 
+/*
+ * Fold the minimum read latency of this window into the smoothed latency and
+ * its gradient, and return whether the trend will cross the target within
+ * RWB_PREDICT_WINDOWS windows.
+ */
+static bool latency_trend_exceeds(struct rq_wb *rwb, u64 lat)
+{
+	s64 delta;
+
+	if (!rwb->lat_avg) {
+		rwb->lat_avg = lat;
+		return false;
+	}
+
+	delta = div_s64((s64)(lat - rwb->lat_avg), 1 << RWB_LAT_SHIFT);
+	rwb->lat_avg += delta;
+	rwb->lat_grad += div_s64(delta - rwb->lat_grad, 1 << RWB_LAT_SHIFT);
+
+	if (rwb->lat_grad <= 0)
+		return false;
+	return rwb->lat_avg + RWB_PREDICT_WINDOWS * rwb->lat_grad >
+		rwb->min_lat_nsec;
+}
+
+static void latency_trend_reset(struct rq_wb *rwb)
+{
+	rwb->lat_avg = 0;
+	rwb->lat_grad = 0;
+}
+
 static int latency_exceeded(struct rq_wb *rwb, struct blk_rq_stat *stat)
 {
 	struct backing_dev_info *bdi = rwb->rqos.disk->bdi;
@@ -343,11 +415,22 @@ static int latency_exceeded(struct rq_wb *rwb, struct blk_rq_stat *stat)
 	 * If the 'min' latency exceeds our target, step down.
 	 */
 	if (stat[READ].min > rwb->min_lat_nsec) {
+		latency_trend_reset(rwb);
 		trace_wbt_lat(bdi, stat[READ].min);
 		trace_wbt_stat(bdi, stat);
 		return LAT_EXCEEDED;
 	}
 
+	/*
+	 * Still within target, but heading for it. A flush that was just
+	 * kicked off will only make it worse, so any growth counts then.
+	 */
+	if (latency_trend_exceeds(rwb, stat[READ].min) ||
+	    (rwb->lat_grad > 0 && wb_recent_flush(rwb))) {
+		trace_wbt_stat(bdi, stat);
+		return LAT_PREDICTED;
+	}
+
 	if (rqd->scale_step)
 		trace_wbt_stat(bdi, stat);
 
@@ -416,6 +499,13 @@ static void rwb_arm_timer(struct rq_wb *rwb)
 		rwb->cur_win_nsec = rwb->win_nsec;
 	}
 
+	/*
+	 * A flush is starting and reads are competing with it, sample more
+	 * often so a latency violation is caught before it builds up.
+	 */
+	if (wb_recent_flush(rwb) && close_io(rwb))
+		rwb->cur_win_nsec = min(rwb->cur_win_nsec, rwb->win_nsec >> 1);
+
 	blk_stat_activate_nsecs(rwb->cb, rwb->cur_win_nsec);
 }
 
@@ -442,6 +532,9 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	case LAT_EXCEEDED:
 		scale_down(rwb, true);
 		break;
+	case LAT_PREDICTED:
+		scale_down(rwb, false);
+		break;
 	case LAT_OK:
 		scale_up(rwb);
 		break;
@@ -449,11 +542,16 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 		/*
 		 * We started a the center step, but don't have a valid
 		 * read/write sample, but we do have writes going on.
-		 * Allow step to go negative, to increase write perf.
+		 * Allow step to go negative, to increase write perf,
+		 * unless a flush is starting while reads are still around.
 		 */
+		if (rqd->scale_step <= 0 && wb_recent_flush(rwb) &&
+		    close_io(rwb))
+			break;
 		scale_up(rwb);
 		break;
 	case LAT_UNKNOWN:
+		latency_trend_reset(rwb);
 		if (++rwb->unknown_cnt < RWB_UNKNOWN_BUMP)
 			break;
 		/*
@@ -486,6 +584,7 @@ static void wbt_update_limits(struct rq_wb *rwb)
 
 	rq_depth_calc_max_depth(rqd);
 	calc_wb_limits(rwb);
+	latency_trend_reset(rwb);
 
 	rwb_wake_all(rwb);
 }
@@ -521,14 +620,6 @@ void wbt_set_min_lat(struct request_queue *q, u64 val)
 }
 
 
-static bool close_io(struct rq_wb *rwb)
-{
-	const unsigned long now = jiffies;
-
-	return time_before(now, rwb->last_issue + HZ / 10) ||
-		time_before(now, rwb->last_comp + HZ / 10);
-}
-
 #define REQ_HIPRIO	(REQ_SYNC | REQ_META | REQ_PRIO)
 
 static inline unsigned int get_limit(struct rq_wb *rwb, blk_opf_t opf)
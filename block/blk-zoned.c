@@ -17,8 +17,11 @@
 #include <linux/mm.h>
 #include <linux/vmalloc.h>
 #include <linux/sched/mm.h>
+#include <linux/hash.h>
+#include <linux/mempool.h>
 
 #include "blk.h"
+#include "blk-mq.h"
 
 #define ZONE_COND_NAME(name) [BLK_ZONE_COND_##name] = #name
 static const char *const zone_cond_name[] = {
@@ -98,6 +101,284 @@ void __blk_req_zone_write_unlock(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(__blk_req_zone_write_unlock);
 
+/*
+ * Zone write plugging.
+ *
+ * Writes to a sequential zone must reach the device in order. Instead of
+ * serializing write requests in the I/O scheduler with the zone write lock,
+ * write BIOs are plugged per zone before a request is allocated for them: while
+ * a write BIO is in flight for a zone, any further write BIO for the same zone
+ * is added to the zone write plug BIO list and issued, in submission order,
+ * only once the previous one completed. This works with any I/O scheduler,
+ * including none, and lets writes to different zones proceed in parallel.
+ *
+ * A zone write plug only exists while a write BIO is in flight for its zone.
+ * Plugs are kept in a small hash table indexed by zone number, and all plug
+ * state is protected by disk->zone_wplugs_lock.
+ */
+#define BLK_ZONE_WPLUG_HASH_BITS	8
+#define BLK_ZONE_WPLUG_POOL_SIZE	128
+
+struct blk_zone_wplug {
+	struct hlist_node	node;
+	struct gendisk		*disk;
+	unsigned int		zone_no;
+	struct bio_list		bio_list;
+	struct work_struct	bio_work;
+};
+
+static struct blk_zone_wplug *disk_lookup_zone_wplug(struct gendisk *disk,
+						     unsigned int zno)
+{
+	struct blk_zone_wplug *zwplug;
+	unsigned int idx = hash_32(zno, BLK_ZONE_WPLUG_HASH_BITS);
+
+	lockdep_assert_held(&disk->zone_wplugs_lock);
+
+	hlist_for_each_entry(zwplug, &disk->zone_wplugs_hash[idx], node)
+		if (zwplug->zone_no == zno)
+			return zwplug;
+	return NULL;
+}
+
+static void disk_free_zone_wplug(struct blk_zone_wplug *zwplug)
+{
+	hlist_del(&zwplug->node);
+	mempool_free(zwplug, zwplug->disk->zone_wplugs_pool);
+}
+
+static void disk_zone_wplug_fail_bios(struct bio_list *bl)
+{
+	struct bio *bio;
+
+	while ((bio = bio_list_pop(bl)))
+		bio_io_error(bio);
+}
+
+static void blk_zone_wplug_bio_work(struct work_struct *work)
+{
+	struct blk_zone_wplug *zwplug =
+		container_of(work, struct blk_zone_wplug, bio_work);
+	struct gendisk *disk = zwplug->disk;
+	unsigned long flags;
+	struct bio *bio;
+
+	spin_lock_irqsave(&disk->zone_wplugs_lock, flags);
+	bio = bio_list_pop(&zwplug->bio_list);
+	if (!bio) {
+		/* The plugged BIOs were aborted by a zone reset or finish */
+		disk_free_zone_wplug(zwplug);
+		spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+		return;
+	}
+	bio_set_flag(bio, BIO_ZONE_WRITE_PLUGGING);
+	spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+
+	blk_mq_submit_bio(bio);
+}
+
+/*
+ * Plugged writes target a write pointer position that a zone reset or finish
+ * invalidates, so fail them instead of letting the device reject them.
+ */
+static void disk_zone_wplug_abort(struct gendisk *disk, unsigned int zno,
+				  bool all)
+{
+	struct bio_list aborted = BIO_EMPTY_LIST;
+	struct blk_zone_wplug *zwplug;
+	unsigned long flags;
+	unsigned int i;
+
+	spin_lock_irqsave(&disk->zone_wplugs_lock, flags);
+	if (all) {
+		for (i = 0; i < 1U << BLK_ZONE_WPLUG_HASH_BITS; i++) {
+			hlist_for_each_entry(zwplug, &disk->zone_wplugs_hash[i],
+					     node) {
+				bio_list_merge(&aborted, &zwplug->bio_list);
+				bio_list_init(&zwplug->bio_list);
+			}
+		}
+	} else {
+		zwplug = disk_lookup_zone_wplug(disk, zno);
+		if (zwplug) {
+			bio_list_merge(&aborted, &zwplug->bio_list);
+			bio_list_init(&zwplug->bio_list);
+		}
+	}
+	spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+
+	disk_zone_wplug_fail_bios(&aborted);
+}
+
+/**
+ * blk_zone_plug_bio - Plug a write BIO to a sequential zone
+ * @bio:	The BIO being submitted
+ *
+ * Called from blk_mq_submit_bio() once @bio was split to the queue limits.
+ * Returns true if @bio was plugged (or failed) and must not be issued by the
+ * caller, false if it can be issued right away. In the latter case, a write
+ * BIO to a sequential zone owns the zone write plug until it completes.
+ */
+bool blk_zone_plug_bio(struct bio *bio)
+{
+	struct gendisk *disk = bio->bi_bdev->bd_disk;
+	struct blk_zone_wplug *zwplug, *new = NULL;
+	unsigned int zno = bio_zone_no(bio);
+	unsigned long flags;
+
+	if (!disk->zone_wplugs_hash)
+		return false;
+
+	switch (bio_op(bio)) {
+	case REQ_OP_WRITE:
+	case REQ_OP_WRITE_ZEROES:
+		break;
+	case REQ_OP_ZONE_RESET:
+	case REQ_OP_ZONE_FINISH:
+		disk_zone_wplug_abort(disk, zno, false);
+		return false;
+	case REQ_OP_ZONE_RESET_ALL:
+		disk_zone_wplug_abort(disk, 0, true);
+		return false;
+	default:
+		return false;
+	}
+
+	/* Empty flushes and BIOs issued from the plug go through as is */
+	if (!bio_sectors(bio) || bio_flagged(bio, BIO_ZONE_WRITE_PLUGGING) ||
+	    !bio_zone_is_seq(bio))
+		return false;
+
+retry:
+	spin_lock_irqsave(&disk->zone_wplugs_lock, flags);
+	zwplug = disk_lookup_zone_wplug(disk, zno);
+	if (zwplug) {
+		/*
+		 * The BIO is issued later from the plug work, which must not
+		 * fail it for lack of resources.
+		 */
+		bio->bi_opf &= ~REQ_NOWAIT;
+		bio_list_add(&zwplug->bio_list, bio);
+		spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+		if (new)
+			mempool_free(new, disk->zone_wplugs_pool);
+		return true;
+	}
+
+	if (!new) {
+		spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+		new = mempool_alloc(disk->zone_wplugs_pool,
+				    bio->bi_opf & REQ_NOWAIT ?
+				    GFP_NOWAIT : GFP_NOIO);
+		if (!new) {
+			bio_wouldblock_error(bio);
+			return true;
+		}
+		goto retry;
+	}
+
+	new->disk = disk;
+	new->zone_no = zno;
+	bio_list_init(&new->bio_list);
+	INIT_WORK(&new->bio_work, blk_zone_wplug_bio_work);
+	hlist_add_head(&new->node, &disk->zone_wplugs_hash[
+				hash_32(zno, BLK_ZONE_WPLUG_HASH_BITS)]);
+	bio_set_flag(bio, BIO_ZONE_WRITE_PLUGGING);
+	spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+
+	return false;
+}
+
+/*
+ * Called from bio_endio() for a write BIO owning its zone write plug: issue the
+ * next plugged BIO of the zone, or free the plug if there is none.
+ */
+void blk_zone_write_plug_bio_endio(struct bio *bio)
+{
+	struct gendisk *disk = bio->bi_bdev->bd_disk;
+	struct bio_list aborted = BIO_EMPTY_LIST;
+	struct blk_zone_wplug *zwplug;
+	sector_t sector = bio->bi_iter.bi_sector;
+	unsigned long flags;
+
+	bio_clear_flag(bio, BIO_ZONE_WRITE_PLUGGING);
+
+	/*
+	 * A BIO completed by the device was advanced to its end, which may be
+	 * the start of the next zone. A BIO failed before reaching the driver
+	 * still has its whole size.
+	 */
+	if (!bio->bi_iter.bi_size)
+		sector--;
+
+	spin_lock_irqsave(&disk->zone_wplugs_lock, flags);
+	zwplug = disk_lookup_zone_wplug(disk, disk_zone_no(disk, sector));
+	if (WARN_ON_ONCE(!zwplug)) {
+		spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+		return;
+	}
+
+	/* The write pointer is unknown, the plugged writes cannot succeed */
+	if (bio->bi_status) {
+		bio_list_merge(&aborted, &zwplug->bio_list);
+		bio_list_init(&zwplug->bio_list);
+	}
+
+	if (bio_list_empty(&zwplug->bio_list))
+		disk_free_zone_wplug(zwplug);
+	else
+		queue_work(disk->zone_wplugs_wq, &zwplug->bio_work);
+	spin_unlock_irqrestore(&disk->zone_wplugs_lock, flags);
+
+	disk_zone_wplug_fail_bios(&aborted);
+}
+
+static int disk_alloc_zone_wplugs(struct gendisk *disk)
+{
+	if (disk->zone_wplugs_hash)
+		return 0;
+
+	spin_lock_init(&disk->zone_wplugs_lock);
+	disk->zone_wplugs_hash = kcalloc(1U << BLK_ZONE_WPLUG_HASH_BITS,
+					 sizeof(struct hlist_head), GFP_KERNEL);
+	if (!disk->zone_wplugs_hash)
+		return -ENOMEM;
+
+	disk->zone_wplugs_pool = mempool_create_kmalloc_pool(
+			BLK_ZONE_WPLUG_POOL_SIZE, sizeof(struct blk_zone_wplug));
+	if (!disk->zone_wplugs_pool)
+		goto free_hash;
+
+	disk->zone_wplugs_wq = alloc_workqueue("%s_zwplugs",
+			WQ_MEM_RECLAIM | WQ_HIGHPRI, 0, disk->disk_name);
+	if (!disk->zone_wplugs_wq)
+		goto destroy_pool;
+
+	return 0;
+
+destroy_pool:
+	mempool_destroy(disk->zone_wplugs_pool);
+	disk->zone_wplugs_pool = NULL;
+free_hash:
+	kfree(disk->zone_wplugs_hash);
+	disk->zone_wplugs_hash = NULL;
+	return -ENOMEM;
+}
+
+void disk_free_zone_wplugs(struct gendisk *disk)
+{
+	if (!disk->zone_wplugs_hash)
+		return;
+
+	/* Plugged BIOs left by the work items fail on the dead queue */
+	destroy_workqueue(disk->zone_wplugs_wq);
+	disk->zone_wplugs_wq = NULL;
+	mempool_destroy(disk->zone_wplugs_pool);
+	disk->zone_wplugs_pool = NULL;
+	kfree(disk->zone_wplugs_hash);
+	disk->zone_wplugs_hash = NULL;
+}
+
 /**
  * bdev_nr_zones - Get number of zones
  * @bdev:	Target device
@@ -231,6 +512,70 @@ static int blkdev_zone_reset_all(struct block_device *bdev, gfp_t gfp_mask)
 	return submit_bio_wait(&bio);
 }
 
+/*
+ * Build the bio chain of a zone management operation on a range of zones
+ * without submitting its last bio, which is returned in @biop. The range has
+ * been checked by the caller. A reset of all zones uses REQ_OP_ZONE_RESET_ALL
+ * if the device supports it, otherwise each zone of the range is reset.
+ */
+void __blkdev_zone_mgmt(struct block_device *bdev, enum req_op op,
+			sector_t sector, sector_t nr_sectors, gfp_t gfp_mask,
+			struct bio **biop)
+{
+	sector_t zone_sectors = bdev_zone_sectors(bdev);
+	sector_t end_sector = sector + nr_sectors;
+	struct bio *bio = *biop;
+
+	if (op == REQ_OP_ZONE_RESET && sector == 0 &&
+	    nr_sectors == bdev_nr_sectors(bdev) &&
+	    blk_queue_zone_resetall(bdev_get_queue(bdev))) {
+		*biop = blk_next_bio(bio, bdev, 0,
+				     REQ_OP_ZONE_RESET_ALL | REQ_SYNC, gfp_mask);
+		return;
+	}
+
+	while (sector < end_sector) {
+		bio = blk_next_bio(bio, bdev, 0, op | REQ_SYNC, gfp_mask);
+		bio->bi_iter.bi_sector = sector;
+		sector += zone_sectors;
+
+		/* This may take a while, so be nice to others */
+		cond_resched();
+	}
+
+	*biop = bio;
+}
+
+/*
+ * Check a zone management range, it must start on a zone boundary and cover
+ * whole zones, except for a smaller last zone.
+ */
+int blkdev_zone_mgmt_check(struct block_device *bdev, sector_t sector,
+			   sector_t nr_sectors)
+{
+	sector_t capacity = bdev_nr_sectors(bdev);
+	sector_t end_sector = sector + nr_sectors;
+
+	if (!bdev_is_zoned(bdev))
+		return -EOPNOTSUPP;
+
+	if (bdev_read_only(bdev))
+		return -EPERM;
+
+	if (end_sector <= sector || end_sector > capacity)
+		/* Out of range */
+		return -EINVAL;
+
+	/* Check alignment (handle eventual smaller last zone) */
+	if (!bdev_is_zone_start(bdev, sector))
+		return -EINVAL;
+
+	if (!bdev_is_zone_start(bdev, nr_sectors) && end_sector != capacity)
+		return -EINVAL;
+
+	return 0;
+}
+
 /**
  * blkdev_zone_mgmt - Execute a zone management operation on a range of zones
  * @bdev:	Target block device
@@ -251,31 +596,16 @@ int blkdev_zone_mgmt(struct block_device *bdev, enum req_op op,
 		     sector_t sector, sector_t nr_sectors, gfp_t gfp_mask)
 {
 	struct request_queue *q = bdev_get_queue(bdev);
-	sector_t zone_sectors = bdev_zone_sectors(bdev);
 	sector_t capacity = bdev_nr_sectors(bdev);
-	sector_t end_sector = sector + nr_sectors;
 	struct bio *bio = NULL;
-	int ret = 0;
-
-	if (!bdev_is_zoned(bdev))
-		return -EOPNOTSUPP;
-
-	if (bdev_read_only(bdev))
-		return -EPERM;
+	int ret;
 
 	if (!op_is_zone_mgmt(op))
 		return -EOPNOTSUPP;
 
-	if (end_sector <= sector || end_sector > capacity)
-		/* Out of range */
-		return -EINVAL;
-
-	/* Check alignment (handle eventual smaller last zone) */
-	if (!bdev_is_zone_start(bdev, sector))
-		return -EINVAL;
-
-	if (!bdev_is_zone_start(bdev, nr_sectors) && end_sector != capacity)
-		return -EINVAL;
+	ret = blkdev_zone_mgmt_check(bdev, sector, nr_sectors);
+	if (ret)
+		return ret;
 
 	/*
 	 * In the case of a zone reset operation over all zones,
@@ -289,14 +619,7 @@ int blkdev_zone_mgmt(struct block_device *bdev, enum req_op op,
 		return blkdev_zone_reset_all(bdev, gfp_mask);
 	}
 
-	while (sector < end_sector) {
-		bio = blk_next_bio(bio, bdev, 0, op | REQ_SYNC, gfp_mask);
-		bio->bi_iter.bi_sector = sector;
-		sector += zone_sectors;
-
-		/* This may take a while, so be nice to others */
-		cond_resched();
-	}
+	__blkdev_zone_mgmt(bdev, op, sector, nr_sectors, gfp_mask, &bio);
 
 	ret = submit_bio_wait(bio);
 	bio_put(bio);
@@ -440,7 +763,6 @@ void disk_free_zone_bitmaps(struct gendisk *disk)
 struct blk_revalidate_zone_args {
 	struct gendisk	*disk;
 	unsigned long	*conv_zones_bitmap;
-	unsigned long	*seq_zones_wlock;
 	unsigned int	nr_zones;
 	sector_t	sector;
 };
@@ -499,12 +821,6 @@ static int blk_revalidate_zone_cb(struct blk_zone *zone, unsigned int idx,
 		break;
 	case BLK_ZONE_TYPE_SEQWRITE_REQ:
 	case BLK_ZONE_TYPE_SEQWRITE_PREF:
-		if (!args->seq_zones_wlock) {
-			args->seq_zones_wlock =
-				blk_alloc_zone_bitmap(q->node, args->nr_zones);
-			if (!args->seq_zones_wlock)
-				return -ENOMEM;
-		}
 		break;
 	default:
 		pr_warn("%s: Invalid zone type 0x%x at sectors %llu\n",
@@ -591,6 +907,13 @@ int blk_revalidate_disk_zones(struct gendisk *disk,
 		ret = -ENODEV;
 	}
 
+	if (ret > 0) {
+		int err = disk_alloc_zone_wplugs(disk);
+
+		if (err)
+			ret = err;
+	}
+
 	/*
 	 * Install the new bitmaps and update nr_zones only once the queue is
 	 * stopped and all I/Os are completed (i.e. a scheduler is not
@@ -599,8 +922,9 @@ int blk_revalidate_disk_zones(struct gendisk *disk,
 	blk_mq_freeze_queue(q);
 	if (ret > 0) {
 		disk->nr_zones = args.nr_zones;
-		swap(disk->seq_zones_wlock, args.seq_zones_wlock);
 		swap(disk->conv_zones_bitmap, args.conv_zones_bitmap);
+		/* Zone write plugging orders writes, any scheduler will do */
+		q->required_elevator_features &= ~ELEVATOR_F_ZBD_SEQ_WRITE;
 		if (update_driver_data)
 			update_driver_data(disk);
 		ret = 0;
@@ -610,7 +934,6 @@ int blk_revalidate_disk_zones(struct gendisk *disk,
 	}
 	blk_mq_unfreeze_queue(q);
 
-	kfree(args.seq_zones_wlock);
 	kfree(args.conv_zones_bitmap);
 	return ret;
 }
@@ -395,13 +395,27 @@ static inline struct bio *blk_queue_bounce(struct bio *bio,
 
 #ifdef CONFIG_BLK_DEV_ZONED
 void disk_free_zone_bitmaps(struct gendisk *disk);
+void disk_free_zone_wplugs(struct gendisk *disk);
+bool blk_zone_plug_bio(struct bio *bio);
+void blk_zone_write_plug_bio_endio(struct bio *bio);
 void disk_clear_zone_settings(struct gendisk *disk);
 int blkdev_report_zones_ioctl(struct block_device *bdev, unsigned int cmd,
 		unsigned long arg);
 int blkdev_zone_mgmt_ioctl(struct block_device *bdev, blk_mode_t mode,
 		unsigned int cmd, unsigned long arg);
+int blkdev_zone_mgmt_check(struct block_device *bdev, sector_t sector,
+		sector_t nr_sectors);
+void __blkdev_zone_mgmt(struct block_device *bdev, enum req_op op,
+		sector_t sector, sector_t nr_sectors, gfp_t gfp_mask,
+		struct bio **biop);
 #else /* CONFIG_BLK_DEV_ZONED */
 static inline void disk_free_zone_bitmaps(struct gendisk *disk) {}
+static inline void disk_free_zone_wplugs(struct gendisk *disk) {}
+static inline bool blk_zone_plug_bio(struct bio *bio)
+{
+	return false;
+}
+static inline void blk_zone_write_plug_bio_endio(struct bio *bio) {}
 static inline void disk_clear_zone_settings(struct gendisk *disk) {}
 static inline int blkdev_report_zones_ioctl(struct block_device *bdev,
 		unsigned int cmd, unsigned long arg)
@@ -413,6 +427,16 @@ static inline int blkdev_zone_mgmt_ioctl(struct block_device *bdev,
 {
 	return -ENOTTY;
 }
+static inline int blkdev_zone_mgmt_check(struct block_device *bdev,
+		sector_t sector, sector_t nr_sectors)
+{
+	return -EOPNOTSUPP;
+}
+static inline void __blkdev_zone_mgmt(struct block_device *bdev,
+		enum req_op op, sector_t sector, sector_t nr_sectors,
+		gfp_t gfp_mask, struct bio **biop)
+{
+}
 #endif /* CONFIG_BLK_DEV_ZONED */
 
 struct block_device *bdev_alloc(struct gendisk *disk, u8 partno);
@@ -449,6 +473,13 @@ static inline void bio_release_page(struct bio *bio, struct page *page)
 		unpin_user_page(page);
 }
 
+static inline void bio_release_folio(struct bio *bio, struct folio *folio,
+		unsigned long npages)
+{
+	if (bio_flagged(bio, BIO_PAGE_PINNED))
+		unpin_user_folio(folio, npages);
+}
+
 struct request_queue *blk_alloc_queue(int node_id);
 
 int disk_scan_partitions(struct gendisk *disk, blk_mode_t mode);
@@ -471,6 +502,8 @@ int truncate_bdev_range(struct block_device *bdev, blk_mode_t mode,
 		loff_t lstart, loff_t lend);
 long blkdev_ioctl(struct file *file, unsigned cmd, unsigned long arg);
 long compat_blkdev_ioctl(struct file *file, unsigned cmd, unsigned long arg);
+struct io_uring_cmd;
+int blkdev_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags);
 
 extern const struct address_space_operations def_blk_aops;
 
@@ -1173,6 +1173,7 @@ static void disk_release(struct device *dev)
 	disk_release_events(disk);
 	kfree(disk->random);
 	disk_free_zone_bitmaps(disk);
+	disk_free_zone_wplugs(disk);
 	xa_destroy(&disk->part_tbl);
 
 	disk->queue->disk = NULL;
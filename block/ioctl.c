@@ -11,6 +11,7 @@
 #include <linux/blktrace_api.h>
 #include <linux/pr.h>
 #include <linux/uaccess.h>
+#include <linux/io_uring.h>
 #include "blk.h"
 
 static int blkpg_do_ioctl(struct block_device *bdev,
@@ -688,3 +689,148 @@ long compat_blkdev_ioctl(struct file *file, unsigned cmd, unsigned long arg)
 	return ret;
 }
 #endif
+
+struct blk_iou_cmd {
+	int res;
+};
+
+static void blk_cmd_complete(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+	struct blk_iou_cmd *bic = (struct blk_iou_cmd *)cmd->pdu;
+
+	io_uring_cmd_done(cmd, bic->res, 0, issue_flags);
+}
+
+static void blk_cmd_bio_end_io(struct bio *bio)
+{
+	struct io_uring_cmd *cmd = bio->bi_private;
+	struct blk_iou_cmd *bic = (struct blk_iou_cmd *)cmd->pdu;
+
+	/* errors of the chained bios are propagated to the last one */
+	bic->res = blk_status_to_errno(bio->bi_status);
+	io_uring_cmd_do_in_task_lazy(cmd, blk_cmd_complete);
+	bio_put(bio);
+}
+
+static int blk_cmd_check_range(struct block_device *bdev, uint64_t start,
+			       uint64_t len)
+{
+	uint64_t end;
+
+	if ((start | len) & 511)
+		return -EINVAL;
+	if (!len || check_add_overflow(start, len, &end) ||
+	    end > bdev_nr_bytes(bdev))
+		return -EINVAL;
+	return 0;
+}
+
+static int blk_cmd_truncate(struct block_device *bdev, blk_mode_t mode,
+			    uint64_t start, uint64_t len)
+{
+	int err;
+
+	/* Invalidate the page cache, including dirty pages */
+	filemap_invalidate_lock(bdev->bd_inode->i_mapping);
+	err = truncate_bdev_range(bdev, mode, start, start + len - 1);
+	filemap_invalidate_unlock(bdev->bd_inode->i_mapping);
+	return err;
+}
+
+/*
+ * Discard, write zeroes and zone management without waiting for the device.
+ * Building the bio chain may block, so the command is always issued from
+ * io-wq, but it completes from the end_io of the last bio of the chain.
+ * Unlike the ioctls the invalidate lock isn't held until the IO completes,
+ * the page cache is only invalidated before the bios are issued.
+ */
+int blkdev_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+	struct block_device *bdev = I_BDEV(cmd->file->f_mapping->host);
+	struct blk_iou_cmd *bic = (struct blk_iou_cmd *)cmd->pdu;
+	blk_mode_t mode = file_to_blk_mode(cmd->file);
+	const struct io_uring_sqe *sqe = cmd->sqe;
+	sector_t sector, nr_sects;
+	struct bio *bio = NULL;
+	uint64_t start, len;
+	enum req_op op;
+	int err;
+
+	if (unlikely(sqe->ioprio || sqe->__pad1 || sqe->len ||
+		     sqe->rw_flags || sqe->file_index))
+		return -EINVAL;
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		return -EAGAIN;
+	if (!(mode & BLK_OPEN_WRITE))
+		return -EBADF;
+
+	start = READ_ONCE(sqe->addr);
+	len = READ_ONCE(sqe->addr3);
+	err = blk_cmd_check_range(bdev, start, len);
+	if (err)
+		return err;
+	sector = start >> SECTOR_SHIFT;
+	nr_sects = len >> SECTOR_SHIFT;
+
+	switch (cmd->cmd_op) {
+	case BLOCK_URING_CMD_DISCARD:
+		if (!bdev_max_discard_sectors(bdev))
+			return -EOPNOTSUPP;
+		err = blk_cmd_truncate(bdev, mode, start, len);
+		if (err)
+			return err;
+		err = __blkdev_issue_discard(bdev, sector, nr_sects,
+					     GFP_KERNEL, &bio);
+		break;
+	case BLOCK_URING_CMD_WRITE_ZEROES:
+		err = blk_cmd_truncate(bdev, mode, start, len);
+		if (err)
+			return err;
+		err = __blkdev_issue_zeroout(bdev, sector, nr_sects,
+					     GFP_KERNEL, &bio,
+					     BLKDEV_ZERO_NOUNMAP);
+		break;
+	case BLOCK_URING_CMD_ZONE_RESET:
+	case BLOCK_URING_CMD_ZONE_OPEN:
+	case BLOCK_URING_CMD_ZONE_CLOSE:
+	case BLOCK_URING_CMD_ZONE_FINISH:
+		if (cmd->cmd_op == BLOCK_URING_CMD_ZONE_RESET)
+			op = REQ_OP_ZONE_RESET;
+		else if (cmd->cmd_op == BLOCK_URING_CMD_ZONE_OPEN)
+			op = REQ_OP_ZONE_OPEN;
+		else if (cmd->cmd_op == BLOCK_URING_CMD_ZONE_CLOSE)
+			op = REQ_OP_ZONE_CLOSE;
+		else
+			op = REQ_OP_ZONE_FINISH;
+
+		err = blkdev_zone_mgmt_check(bdev, sector, nr_sects);
+		if (err)
+			return err;
+		if (op == REQ_OP_ZONE_RESET) {
+			err = blk_cmd_truncate(bdev, mode, start, len);
+			if (err)
+				return err;
+		}
+		__blkdev_zone_mgmt(bdev, op, sector, nr_sects, GFP_KERNEL, &bio);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (err) {
+		/* wait for the bios already in flight before failing */
+		if (bio) {
+			submit_bio_wait(bio);
+			bio_put(bio);
+		}
+		return err;
+	}
+	if (!bio)
+		return 0;
+
+	bic->res = 0;
+	bio->bi_private = cmd;
+	bio->bi_end_io = blk_cmd_bio_end_io;
+	submit_bio(bio);
+	return -EIOCBQUEUED;
+}
@@ -105,6 +105,18 @@ struct deadline_data {
 	spinlock_t zone_lock;
 };
 
+/*
+ * Per hardware queue insertion lists. Inserting a request only takes the lock
+ * of its hardware queue. The requests are moved to the sort and FIFO lists,
+ * under dd->lock, by the next dispatch. This keeps submitters on different
+ * hardware queues from contending on dd->lock.
+ */
+struct dd_hctx_data {
+	spinlock_t lock;
+	struct list_head at_head;
+	struct list_head at_tail;
+} ____cacheline_aligned_in_smp;
+
 /* Maps an I/O priority class to a deadline scheduler priority. */
 static const enum dd_prio ioprio_class_to_prio[] = {
 	[IOPRIO_CLASS_NONE]	= DD_BE_PRIO,
@@ -585,6 +597,8 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
 	return NULL;
 }
 
+static void dd_move_inserted(struct request_queue *q, struct list_head *free);
+
 /*
  * Called from blk_mq_run_hw_queue() -> __blk_mq_sched_dispatch_requests().
  *
@@ -599,8 +613,10 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	const unsigned long now = jiffies;
 	struct request *rq;
 	enum dd_prio prio;
+	LIST_HEAD(free);
 
 	spin_lock(&dd->lock);
+	dd_move_inserted(hctx->queue, &free);
 	rq = dd_dispatch_prio_aged_requests(dd, now);
 	if (rq)
 		goto unlock;
@@ -618,6 +634,8 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 unlock:
 	spin_unlock(&dd->lock);
 
+	blk_mq_free_requests(&free);
+
 	return rq;
 }
 
@@ -656,10 +674,31 @@ static void dd_depth_updated(struct blk_mq_hw_ctx *hctx)
 /* Called by blk_mq_init_hctx() and blk_mq_init_sched(). */
 static int dd_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
 {
+	struct dd_hctx_data *dh;
+
+	dh = kmalloc_node(sizeof(*dh), GFP_KERNEL, hctx->numa_node);
+	if (!dh)
+		return -ENOMEM;
+
+	spin_lock_init(&dh->lock);
+	INIT_LIST_HEAD(&dh->at_head);
+	INIT_LIST_HEAD(&dh->at_tail);
+	hctx->sched_data = dh;
+
 	dd_depth_updated(hctx);
 	return 0;
 }
 
+static void dd_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct dd_hctx_data *dh = hctx->sched_data;
+
+	WARN_ON_ONCE(!list_empty(&dh->at_head));
+	WARN_ON_ONCE(!list_empty(&dh->at_tail));
+	kfree(dh);
+	hctx->sched_data = NULL;
+}
+
 static void dd_exit_sched(struct elevator_queue *e)
 {
 	struct deadline_data *dd = e->elevator_data;
@@ -779,7 +818,13 @@ static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 	struct request *free = NULL;
 	bool ret;
 
-	spin_lock(&dd->lock);
+	/*
+	 * Merging is an optimization. Rather than queueing up on the lock
+	 * behind other submitters and the dispatcher, let the bio get its own
+	 * request.
+	 */
+	if (!spin_trylock(&dd->lock))
+		return false;
 	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
 	spin_unlock(&dd->lock);
 
@@ -858,28 +903,64 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	}
 }
 
-/*
- * Called from blk_mq_insert_request() or blk_mq_dispatch_plug_list().
- */
-static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
-			       struct list_head *list,
-			       blk_insert_t flags)
+static void dd_insert_list(struct blk_mq_hw_ctx *hctx, struct list_head *list,
+			   blk_insert_t flags, struct list_head *free)
 {
-	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
-	LIST_HEAD(free);
-
-	spin_lock(&dd->lock);
 	while (!list_empty(list)) {
 		struct request *rq;
 
 		rq = list_first_entry(list, struct request, queuelist);
 		list_del_init(&rq->queuelist);
-		dd_insert_request(hctx, rq, flags, &free);
+		dd_insert_request(hctx, rq, flags, free);
 	}
-	spin_unlock(&dd->lock);
+}
 
-	blk_mq_free_requests(&free);
+/*
+ * Move the requests from the insertion lists of all hardware queues to the
+ * sort and FIFO lists. Requests that got merged are added to @free.
+ */
+static void dd_move_inserted(struct request_queue *q, struct list_head *free)
+{
+	struct deadline_data *dd = q->elevator->elevator_data;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long i;
+
+	lockdep_assert_held(&dd->lock);
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		struct dd_hctx_data *dh = hctx->sched_data;
+		LIST_HEAD(at_head);
+		LIST_HEAD(at_tail);
+
+		if (list_empty_careful(&dh->at_head) &&
+		    list_empty_careful(&dh->at_tail))
+			continue;
+
+		spin_lock(&dh->lock);
+		list_splice_init(&dh->at_head, &at_head);
+		list_splice_init(&dh->at_tail, &at_tail);
+		spin_unlock(&dh->lock);
+
+		dd_insert_list(hctx, &at_head, BLK_MQ_INSERT_AT_HEAD, free);
+		dd_insert_list(hctx, &at_tail, 0, free);
+	}
+}
+
+/*
+ * Called from blk_mq_insert_request() or blk_mq_dispatch_plug_list().
+ */
+static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
+			       struct list_head *list,
+			       blk_insert_t flags)
+{
+	struct dd_hctx_data *dh = hctx->sched_data;
+
+	spin_lock(&dh->lock);
+	if (flags & BLK_MQ_INSERT_AT_HEAD)
+		list_splice_init(list, &dh->at_head);
+	else
+		list_splice_tail_init(list, &dh->at_tail);
+	spin_unlock(&dh->lock);
 }
 
 /* Callback from inside blk_mq_rq_ctx_init(). */
@@ -953,11 +1034,20 @@ static bool dd_has_work_for_prio(struct dd_per_prio *per_prio)
 		!list_empty_careful(&per_prio->fifo_list[DD_WRITE]);
 }
 
+/*
+ * Only the insertion lists of @hctx are checked: inserting a request runs the
+ * hardware queue it was inserted on.
+ */
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_hctx_data *dh = hctx->sched_data;
 	enum dd_prio prio;
 
+	if (!list_empty_careful(&dh->at_head) ||
+	    !list_empty_careful(&dh->at_tail))
+		return true;
+
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
 		if (dd_has_work_for_prio(&dd->per_prio[prio]))
 			return true;
@@ -1259,6 +1349,7 @@ static struct elevator_type mq_deadline = {
 		.init_sched		= dd_init_sched,
 		.exit_sched		= dd_exit_sched,
 		.init_hctx		= dd_init_hctx,
+		.exit_hctx		= dd_exit_hctx,
 	},
 
 #ifdef CONFIG_BLK_DEBUG_FS
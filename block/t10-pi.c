@@ -12,16 +12,31 @@
 #include <net/checksum.h>
 #include <asm/unaligned.h>
 
-typedef __be16 (csum_fn) (void *, unsigned int);
+/* Number of guard tags computed per checksum call */
+#define T10_PI_BATCH	16U
 
-static __be16 t10_pi_crc_fn(void *data, unsigned int len)
+/* Compute the guard tags of @nr consecutive intervals of @data */
+typedef void (csum_fn) (void *data, unsigned int interval, unsigned int nr,
+			__be16 *csum);
+
+static void t10_pi_crc_fn(void *data, unsigned int interval, unsigned int nr,
+			  __be16 *csum)
 {
-	return cpu_to_be16(crc_t10dif(data, len));
+	u16 crc[T10_PI_BATCH];
+	unsigned int i;
+
+	crc_t10dif_batch(data, interval, nr, crc);
+	for (i = 0; i < nr; i++)
+		csum[i] = cpu_to_be16(crc[i]);
 }
 
-static __be16 t10_pi_ip_fn(void *data, unsigned int len)
+static void t10_pi_ip_fn(void *data, unsigned int interval, unsigned int nr,
+			 __be16 *csum)
 {
-	return (__force __be16)ip_compute_csum(data, len);
+	unsigned int i;
+
+	for (i = 0; i < nr; i++, data += interval)
+		csum[i] = (__force __be16)ip_compute_csum(data, interval);
 }
 
 /*
@@ -32,22 +47,30 @@ static __be16 t10_pi_ip_fn(void *data, unsigned int len)
 static blk_status_t t10_pi_generate(struct blk_integrity_iter *iter,
 		csum_fn *fn, enum t10_dif_type type)
 {
-	unsigned int i;
+	unsigned int left = iter->data_size / iter->interval;
+	__be16 csum[T10_PI_BATCH];
+	unsigned int i, nr;
 
-	for (i = 0 ; i < iter->data_size ; i += iter->interval) {
-		struct t10_pi_tuple *pi = iter->prot_buf;
+	for (; left; left -= nr) {
+		nr = min(left, T10_PI_BATCH);
+		fn(iter->data_buf, iter->interval, nr, csum);
 
-		pi->guard_tag = fn(iter->data_buf, iter->interval);
-		pi->app_tag = 0;
+		for (i = 0; i < nr; i++) {
+			struct t10_pi_tuple *pi = iter->prot_buf;
 
-		if (type == T10_PI_TYPE1_PROTECTION)
-			pi->ref_tag = cpu_to_be32(lower_32_bits(iter->seed));
-		else
-			pi->ref_tag = 0;
+			pi->guard_tag = csum[i];
+			pi->app_tag = 0;
 
-		iter->data_buf += iter->interval;
-		iter->prot_buf += iter->tuple_size;
-		iter->seed++;
+			if (type == T10_PI_TYPE1_PROTECTION)
+				pi->ref_tag =
+					cpu_to_be32(lower_32_bits(iter->seed));
+			else
+				pi->ref_tag = 0;
+
+			iter->data_buf += iter->interval;
+			iter->prot_buf += iter->tuple_size;
+			iter->seed++;
+		}
 	}
 
 	return BLK_STS_OK;
@@ -56,13 +79,24 @@ static blk_status_t t10_pi_generate(struct blk_integrity_iter *iter,
 static blk_status_t t10_pi_verify(struct blk_integrity_iter *iter,
 		csum_fn *fn, enum t10_dif_type type)
 {
-	unsigned int i;
+	unsigned int left = iter->data_size / iter->interval;
+	__be16 csum[T10_PI_BATCH];
+	unsigned int i = 0, nr = 0;
 
 	BUG_ON(type == T10_PI_TYPE0_PROTECTION);
 
-	for (i = 0 ; i < iter->data_size ; i += iter->interval) {
+	for (; left; left--, i++) {
 		struct t10_pi_tuple *pi = iter->prot_buf;
-		__be16 csum;
+
+		/*
+		 * Compute the guard tags of the next batch of intervals up
+		 * front, escaped intervals are rare enough to not bother.
+		 */
+		if (i == nr) {
+			nr = min(left, T10_PI_BATCH);
+			fn(iter->data_buf, iter->interval, nr, csum);
+			i = 0;
+		}
 
 		if (type == T10_PI_TYPE1_PROTECTION ||
 		    type == T10_PI_TYPE2_PROTECTION) {
@@ -83,13 +117,11 @@ static blk_status_t t10_pi_verify(struct blk_integrity_iter *iter,
 				goto next;
 		}
 
-		csum = fn(iter->data_buf, iter->interval);
-
-		if (pi->guard_tag != csum) {
+		if (pi->guard_tag != csum[i]) {
 			pr_err("%s: guard tag error at sector %llu " \
 			       "(rcvd %04x, want %04x)\n", iter->disk_name,
 			       (unsigned long long)iter->seed,
-			       be16_to_cpu(pi->guard_tag), be16_to_cpu(csum));
+			       be16_to_cpu(pi->guard_tag), be16_to_cpu(csum[i]));
 			return BLK_STS_PROTECTION;
 		}
 
@@ -148,6 +180,13 @@ static void t10_pi_type1_prepare(struct request *rq)
 		if (bip->bip_flags & BIP_MAPPED_INTEGRITY)
 			break;
 
+		/* Virtual and physical ref tags match, nothing to remap */
+		if (virt == ref_tag) {
+			ref_tag += bip->bip_iter.bi_size / tuple_sz;
+			bip->bip_flags |= BIP_MAPPED_INTEGRITY;
+			continue;
+		}
+
 		bip_for_each_vec(iv, bip, iter) {
 			unsigned int j;
 			void *p;
@@ -194,6 +233,16 @@ static void t10_pi_type1_complete(struct request *rq, unsigned int nr_bytes)
 		struct bio_vec iv;
 		struct bvec_iter iter;
 
+		/* Virtual and physical ref tags match, nothing to remap */
+		if (virt == ref_tag) {
+			unsigned int n = min(intervals,
+					bip->bip_iter.bi_size / tuple_sz);
+
+			ref_tag += n;
+			intervals -= n;
+			continue;
+		}
+
 		bip_for_each_vec(iv, bip, iter) {
 			unsigned int j;
 			void *p;
@@ -280,30 +329,43 @@ const struct blk_integrity_profile t10_pi_type3_ip = {
 };
 EXPORT_SYMBOL(t10_pi_type3_ip);
 
-static __be64 ext_pi_crc64(void *data, unsigned int len)
+static void ext_pi_crc64(void *data, unsigned int interval, unsigned int nr,
+			 __be64 *csum)
 {
-	return cpu_to_be64(crc64_rocksoft(data, len));
+	u64 crc[T10_PI_BATCH];
+	unsigned int i;
+
+	crc64_rocksoft_batch(data, interval, nr, crc);
+	for (i = 0; i < nr; i++)
+		csum[i] = cpu_to_be64(crc[i]);
 }
 
 static blk_status_t ext_pi_crc64_generate(struct blk_integrity_iter *iter,
 					enum t10_dif_type type)
 {
-	unsigned int i;
+	unsigned int left = iter->data_size / iter->interval;
+	__be64 csum[T10_PI_BATCH];
+	unsigned int i, nr;
 
-	for (i = 0 ; i < iter->data_size ; i += iter->interval) {
-		struct crc64_pi_tuple *pi = iter->prot_buf;
+	for (; left; left -= nr) {
+		nr = min(left, T10_PI_BATCH);
+		ext_pi_crc64(iter->data_buf, iter->interval, nr, csum);
 
-		pi->guard_tag = ext_pi_crc64(iter->data_buf, iter->interval);
-		pi->app_tag = 0;
+		for (i = 0; i < nr; i++) {
+			struct crc64_pi_tuple *pi = iter->prot_buf;
 
-		if (type == T10_PI_TYPE1_PROTECTION)
-			put_unaligned_be48(iter->seed, pi->ref_tag);
-		else
-			put_unaligned_be48(0ULL, pi->ref_tag);
+			pi->guard_tag = csum[i];
+			pi->app_tag = 0;
 
-		iter->data_buf += iter->interval;
-		iter->prot_buf += iter->tuple_size;
-		iter->seed++;
+			if (type == T10_PI_TYPE1_PROTECTION)
+				put_unaligned_be48(iter->seed, pi->ref_tag);
+			else
+				put_unaligned_be48(0ULL, pi->ref_tag);
+
+			iter->data_buf += iter->interval;
+			iter->prot_buf += iter->tuple_size;
+			iter->seed++;
+		}
 	}
 
 	return BLK_STS_OK;
@@ -319,12 +381,19 @@ static bool ext_pi_ref_escape(u8 *ref_tag)
 static blk_status_t ext_pi_crc64_verify(struct blk_integrity_iter *iter,
 				      enum t10_dif_type type)
 {
-	unsigned int i;
+	unsigned int left = iter->data_size / iter->interval;
+	__be64 csum[T10_PI_BATCH];
+	unsigned int i = 0, nr = 0;
 
-	for (i = 0; i < iter->data_size; i += iter->interval) {
+	for (; left; left--, i++) {
 		struct crc64_pi_tuple *pi = iter->prot_buf;
 		u64 ref, seed;
-		__be64 csum;
+
+		if (i == nr) {
+			nr = min(left, T10_PI_BATCH);
+			ext_pi_crc64(iter->data_buf, iter->interval, nr, csum);
+			i = 0;
+		}
 
 		if (type == T10_PI_TYPE1_PROTECTION) {
 			if (pi->app_tag == T10_PI_APP_ESCAPE)
@@ -343,12 +412,11 @@ static blk_status_t ext_pi_crc64_verify(struct blk_integrity_iter *iter,
 				goto next;
 		}
 
-		csum = ext_pi_crc64(iter->data_buf, iter->interval);
-		if (pi->guard_tag != csum) {
+		if (pi->guard_tag != csum[i]) {
 			pr_err("%s: guard tag error at sector %llu " \
 			       "(rcvd %016llx, want %016llx)\n",
 				iter->disk_name, (unsigned long long)iter->seed,
-				be64_to_cpu(pi->guard_tag), be64_to_cpu(csum));
+				be64_to_cpu(pi->guard_tag), be64_to_cpu(csum[i]));
 			return BLK_STS_PROTECTION;
 		}
 
@@ -387,6 +455,13 @@ static void ext_pi_type1_prepare(struct request *rq)
 		if (bip->bip_flags & BIP_MAPPED_INTEGRITY)
 			break;
 
+		/* Virtual and physical ref tags match, nothing to remap */
+		if (virt == ref_tag) {
+			ref_tag += bip->bip_iter.bi_size / tuple_sz;
+			bip->bip_flags |= BIP_MAPPED_INTEGRITY;
+			continue;
+		}
+
 		bip_for_each_vec(iv, bip, iter) {
 			unsigned int j;
 			void *p;
@@ -422,6 +497,16 @@ static void ext_pi_type1_complete(struct request *rq, unsigned int nr_bytes)
 		struct bio_vec iv;
 		struct bvec_iter iter;
 
+		/* Virtual and physical ref tags match, nothing to remap */
+		if (virt == ref_tag) {
+			unsigned int n = min(intervals,
+					bip->bip_iter.bi_size / tuple_sz);
+
+			ref_tag += n;
+			intervals -= n;
+			continue;
+		}
+
 		bip_for_each_vec(iv, bip, iter) {
 			unsigned int j;
 			void *p;
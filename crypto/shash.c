@@ -216,6 +216,61 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+static int shash_finup_mb_fallback(struct shash_desc *desc,
+				   const u8 * const data[], unsigned int len,
+				   u8 * const outs[], unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	SHASH_DESC_ON_STACK(desc2, tfm);
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < num_msgs && !err; i++) {
+		memcpy(desc2, desc, sizeof(*desc) + crypto_shash_descsize(tfm));
+		err = crypto_shash_finup(desc2, data[i], len, outs[i]);
+	}
+
+	shash_desc_zero(desc2);
+	return err;
+}
+
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	struct shash_alg *shash = crypto_shash_alg(tfm);
+	unsigned long alignmask = crypto_shash_alignmask(tfm);
+	unsigned int i, n;
+	int err;
+
+	for (i = 0; i < num_msgs; i += n) {
+		n = min(num_msgs - i, shash->mb_max_msgs);
+		err = -EOPNOTSUPP;
+
+		/* There is no bounce buffering for the multibuffer path */
+		if (n > 1 && !alignmask) {
+			err = shash->finup_mb(desc, &data[i], len, &outs[i], n);
+			if (IS_ENABLED(CONFIG_CRYPTO_STATS) && err != -EOPNOTSUPP) {
+				struct crypto_istat_hash *istat =
+					shash_get_stat(shash);
+
+				atomic64_add(n, &istat->hash_cnt);
+				atomic64_add((u64)len * n, &istat->hash_tlen);
+				crypto_shash_errstat(shash, err);
+			}
+		}
+		if (err == -EOPNOTSUPP)
+			err = shash_finup_mb_fallback(desc, &data[i], len,
+						      &outs[i], n);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_digest_unaligned(struct shash_desc *desc, const u8 *data,
 				  unsigned int len, u8 *out)
 {
@@ -659,6 +714,8 @@ static int shash_prepare_alg(struct shash_alg *alg)
 		alg->finup = shash_finup_unaligned;
 	if (!alg->digest)
 		alg->digest = shash_digest_unaligned;
+	if (!alg->finup_mb || !alg->mb_max_msgs)
+		alg->mb_max_msgs = 1;
 	if (!alg->export) {
 		alg->export = shash_default_export;
 		alg->import = shash_default_import;
@@ -1087,6 +1087,49 @@ int device_links_check_suppliers(struct device *dev)
 	return ret ? ret : fwnode_ret;
 }
 
+/**
+ * device_links_suppliers_ready - Check whether the suppliers of a device
+ *				  are bound
+ * @dev: Consumer device.
+ *
+ * Unlike device_links_check_suppliers(), this does not change the state of
+ * the links, so it can be used to find out whether probing @dev would be
+ * deferred before scheduling the probe. Best effort consumers are always
+ * reported as ready.
+ */
+bool device_links_suppliers_ready(struct device *dev)
+{
+	struct device_link *link;
+	bool ready = true;
+	int idx;
+
+	if (dev_is_best_effort(dev))
+		return true;
+
+	mutex_lock(&fwnode_link_lock);
+	if (fwnode_links_check_suppliers(dev->fwnode))
+		ready = false;
+	mutex_unlock(&fwnode_link_lock);
+	if (!ready)
+		return false;
+
+	idx = device_links_read_lock();
+	list_for_each_entry_rcu(link, &dev->links.suppliers, c_node,
+				device_links_read_lock_held()) {
+		if (!(link->flags & DL_FLAG_MANAGED) ||
+		    link->flags & DL_FLAG_SYNC_STATE_ONLY)
+			continue;
+
+		if (READ_ONCE(link->status) != DL_STATE_AVAILABLE) {
+			ready = false;
+			break;
+		}
+	}
+	device_links_read_unlock(idx);
+
+	return ready;
+}
+
 /**
  * __device_links_queue_sync_state - Queue a device for sync_state() callback
  * @dev: Device to call sync_state() on
@@ -62,6 +62,9 @@ static bool initcalls_done;
 static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
 static bool async_probe_default;
 
+/* Probe all drivers asynchronously until the system is running */
+static bool driver_parallel_probe;
+
 /*
  * In some cases, like suspend to RAM or hibernation, It might be reasonable
  * to prohibit probing of devices as it could be unsafe.
@@ -256,6 +259,86 @@ static int deferred_devs_show(struct seq_file *s, void *data)
 }
 DEFINE_SHOW_ATTRIBUTE(deferred_devs);
 
+/*
+ * Boot time probe timeline, recorded with driver_parallel_probe or
+ * initcall_debug until the system is running.
+ */
+struct probe_timeline_entry {
+	struct list_head node;
+	const char *dev_name;
+	const char *drv_name;
+	ktime_t start;
+	ktime_t duration;
+	int cpu;
+	bool async;
+	int ret;
+};
+
+static LIST_HEAD(probe_timeline);
+static DEFINE_MUTEX(probe_timeline_mutex);
+
+static void probe_timeline_add(struct device *dev, struct device_driver *drv,
+			       ktime_t start, int ret)
+{
+	struct probe_timeline_entry *entry, *pos;
+
+	if (!IS_ENABLED(CONFIG_DEBUG_FS) || system_state >= SYSTEM_RUNNING ||
+	    !(driver_parallel_probe || initcall_debug))
+		return;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return;
+
+	entry->dev_name = kstrdup(dev_name(dev), GFP_KERNEL);
+	entry->drv_name = kstrdup_const(drv->name, GFP_KERNEL);
+	if (!entry->dev_name || !entry->drv_name) {
+		kfree(entry->dev_name);
+		kfree_const(entry->drv_name);
+		kfree(entry);
+		return;
+	}
+
+	entry->start = start;
+	entry->duration = ktime_sub(ktime_get(), start);
+	entry->cpu = raw_smp_processor_id();
+	entry->async = current_is_async();
+	entry->ret = ret;
+
+	/* Keep the timeline sorted by start time */
+	mutex_lock(&probe_timeline_mutex);
+	list_for_each_entry_reverse(pos, &probe_timeline, node)
+		if (ktime_compare(pos->start, start) <= 0)
+			break;
+	list_add(&entry->node, &pos->node);
+	mutex_unlock(&probe_timeline_mutex);
+}
+
+/*
+ * probe_timeline_show() - Show the start time, duration, CPU and result of
+ * the probes done during boot.
+ */
+static int probe_timeline_show(struct seq_file *s, void *data)
+{
+	struct probe_timeline_entry *entry;
+
+	seq_puts(s, "# start_us\tduration_us\tcpu\tasync\tret\tdriver\tdevice\n");
+
+	mutex_lock(&probe_timeline_mutex);
+
+	list_for_each_entry(entry, &probe_timeline, node)
+		seq_printf(s, "%lld\t%lld\t%d\t%d\t%d\t%s\t%s\n",
+			   ktime_to_us(entry->start),
+			   ktime_to_us(entry->duration), entry->cpu,
+			   entry->async, entry->ret, entry->drv_name,
+			   entry->dev_name);
+
+	mutex_unlock(&probe_timeline_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(probe_timeline);
+
 #ifdef CONFIG_MODULES
 static int driver_deferred_probe_timeout = 10;
 #else
@@ -345,6 +428,8 @@ static int deferred_probe_initcall(void)
 {
 	debugfs_create_file("devices_deferred", 0444, NULL, NULL,
 			    &deferred_devs_fops);
+	debugfs_create_file("probe_timeline", 0444, NULL, NULL,
+			    &probe_timeline_fops);
 
 	driver_deferred_probe_enable = true;
 	driver_deferred_probe_trigger();
@@ -377,6 +462,7 @@ late_initcall(deferred_probe_initcall);
 static void __exit deferred_probe_exit(void)
 {
 	debugfs_lookup_and_remove("devices_deferred", NULL);
+	debugfs_lookup_and_remove("probe_timeline", NULL);
 }
 __exitcall(deferred_probe_exit);
 
@@ -778,6 +864,7 @@ EXPORT_SYMBOL_GPL(wait_for_device_probe);
 
 static int __driver_probe_device(struct device_driver *drv, struct device *dev)
 {
+	ktime_t calltime;
 	int ret = 0;
 
 	if (dev->p->dead || !device_is_registered(dev))
@@ -794,10 +881,12 @@ static int __driver_probe_device(struct device_driver *drv, struct device *dev)
 		pm_runtime_get_sync(dev->parent);
 
 	pm_runtime_barrier(dev);
+	calltime = ktime_get();
 	if (initcall_debug)
 		ret = really_probe_debug(dev, drv);
 	else
 		ret = really_probe(dev, drv);
+	probe_timeline_add(dev, drv, calltime, ret);
 	pm_request_idle(dev);
 
 	if (dev->parent)
@@ -865,6 +954,52 @@ static int __init save_async_options(char *buf)
 }
 __setup("driver_async_probe=", save_async_options);
 
+/*
+ * The option format is "driver_parallel_probe=<bool>". Drivers that don't
+ * force synchronous probing are probed asynchronously during boot, and
+ * devices whose suppliers are not bound yet wait on the deferred list
+ * instead of occupying a probe thread.
+ */
+static int __init save_parallel_probe_option(char *buf)
+{
+	if (kstrtobool(buf, &driver_parallel_probe))
+		return 0;
+
+	/* Retry the parked devices as soon as one of their suppliers binds */
+	if (driver_parallel_probe)
+		driver_deferred_probe_enable = true;
+	return 1;
+}
+__setup("driver_parallel_probe=", save_parallel_probe_option);
+
+static bool driver_parallel_probe_active(void)
+{
+	return driver_parallel_probe && system_state < SYSTEM_RUNNING;
+}
+
+/*
+ * A device whose suppliers are not bound yet would only defer its probe.
+ * When probing in parallel, put it on the deferred list right away: it is
+ * retried once a supplier binds. Returns true if @dev was parked.
+ */
+static bool driver_parallel_probe_park(struct device *dev)
+{
+	int trigger_count = atomic_read(&deferred_trigger_count);
+
+	if (!driver_parallel_probe_active() ||
+	    device_links_suppliers_ready(dev))
+		return false;
+
+	dev_dbg(dev, "Suppliers not ready, parking probe\n");
+	dev->can_match = true;
+	driver_deferred_probe_add(dev);
+
+	/* Did a supplier bind meanwhile? */
+	if (trigger_count != atomic_read(&deferred_trigger_count))
+		driver_deferred_probe_trigger();
+	return true;
+}
+
 static bool driver_allows_async_probing(struct device_driver *drv)
 {
 	switch (drv->probe_type) {
@@ -881,6 +1016,9 @@ static bool driver_allows_async_probing(struct device_driver *drv)
 		if (module_requested_async_probing(drv->owner))
 			return true;
 
+		if (driver_parallel_probe_active())
+			return true;
+
 		return false;
 	}
 }
@@ -1029,7 +1167,8 @@ static int __device_attach(struct device *dev, bool allow_async)
 
 		ret = bus_for_each_drv(dev->bus, NULL, &data,
 					__device_attach_driver);
-		if (!ret && allow_async && data.have_async) {
+		if (!ret && allow_async && data.have_async &&
+		    !driver_parallel_probe_park(dev)) {
 			/*
 			 * If we could not find appropriate driver
 			 * synchronously and we are allowed to do
@@ -1199,6 +1338,9 @@ static int __driver_attach(struct device *dev, void *data)
 		 * We only take the device lock here in order to guarantee
 		 * that the dev->driver and async_driver fields are protected
 		 */
+		if (driver_parallel_probe_park(dev))
+			return 0;
+
 		dev_dbg(dev, "probing driver %s asynchronously\n", drv->name);
 		device_lock(dev);
 		if (!dev->driver && !dev->p->async_driver) {
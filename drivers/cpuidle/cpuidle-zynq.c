@@ -11,31 +11,102 @@
  * #1 wait-for-interrupt
  * #2 wait-for-interrupt and RAM self refresh
  *
+ * The exit latency of the states is measured at runtime on timer wakeups,
+ * as the time between the expiry of the timer and the CPU resuming. The
+ * teo governor is used, helped by the IRQ timings to predict the recurring
+ * PL interrupts.
+ *
  * Maintainer: Michal Simek <michal.simek@xilinx.com>
  */
 
 #include <linux/init.h>
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/platform_device.h>
+#include <linux/timekeeping.h>
 #include <asm/cpuidle.h>
 
 #define ZYNQ_MAX_STATES		2
 
+/* Wakeups later than this after the timer expiry are not timer wakeups */
+#define ZYNQ_EXIT_LATENCY_MAX_NS	(500 * NSEC_PER_USEC)
+/* Samples needed before the measured latency replaces the nominal one */
+#define ZYNQ_EXIT_LATENCY_MIN_SAMPLES	16
+/* Weight of a new sample in the average, as a shift */
+#define ZYNQ_EXIT_LATENCY_EWMA_SHIFT	3
+
+struct zynq_exit_latency {
+	u64 avg_ns;
+	unsigned int samples;
+};
+
+static struct zynq_exit_latency zynq_exit_latency[ZYNQ_MAX_STATES];
+
+/*
+ * Update the exit latency of the state from a timer wakeup. The states are
+ * shared by all CPUs, so they are only written when the average moved by
+ * more than an eighth.
+ */
+static void zynq_exit_latency_sample(struct cpuidle_driver *drv, int index,
+				     u64 sample_ns)
+{
+	struct zynq_exit_latency *lat = &zynq_exit_latency[index];
+	struct cpuidle_state *state = &drv->states[index];
+	s64 cur_ns = READ_ONCE(state->exit_latency_ns);
+	u64 avg_ns = READ_ONCE(lat->avg_ns);
+	unsigned int samples = READ_ONCE(lat->samples);
+
+	if (!samples)
+		avg_ns = sample_ns;
+	else
+		avg_ns = avg_ns - (avg_ns >> ZYNQ_EXIT_LATENCY_EWMA_SHIFT) +
+			 (sample_ns >> ZYNQ_EXIT_LATENCY_EWMA_SHIFT);
+	WRITE_ONCE(lat->avg_ns, avg_ns);
+
+	if (samples < ZYNQ_EXIT_LATENCY_MIN_SAMPLES) {
+		WRITE_ONCE(lat->samples, samples + 1);
+		return;
+	}
+
+	if (abs_diff(avg_ns, (u64)cur_ns) > (u64)cur_ns / 8) {
+		WRITE_ONCE(state->exit_latency_ns, avg_ns);
+		WRITE_ONCE(state->exit_latency,
+			   DIV_ROUND_UP_ULL(avg_ns, NSEC_PER_USEC));
+	}
+}
+
 /* Actual code that puts the SoC in different idle states */
 static int zynq_enter_idle(struct cpuidle_device *dev,
 			   struct cpuidle_driver *drv, int index)
 {
+	u64 expiry_ns = ktime_to_ns(READ_ONCE(dev->next_hrtimer));
+	u64 entry_ns = ktime_get_mono_fast_ns();
+	u64 exit_ns;
+
 	/* Add code for DDR self refresh start */
 	cpu_do_idle();
 
+	exit_ns = ktime_get_mono_fast_ns();
+	if (expiry_ns > entry_ns && exit_ns >= expiry_ns &&
+	    exit_ns - expiry_ns < ZYNQ_EXIT_LATENCY_MAX_NS)
+		zynq_exit_latency_sample(drv, index, exit_ns - expiry_ns);
+
 	return index;
 }
 
 static struct cpuidle_driver zynq_idle_driver = {
 	.name = "zynq_idle",
 	.owner = THIS_MODULE,
+	.governor = "teo",
 	.states = {
-		ARM_CPUIDLE_WFI_STATE,
+		{
+			.enter			= zynq_enter_idle,
+			.exit_latency		= 1,
+			.target_residency	= 1,
+			.power_usage		= UINT_MAX,
+			.name			= "WFI",
+			.desc			= "ARM WFI",
+		},
 		{
 			.enter			= zynq_enter_idle,
 			.exit_latency		= 10,
@@ -53,6 +124,9 @@ static int zynq_cpuidle_probe(struct platform_device *pdev)
 {
 	pr_info("Xilinx Zynq CpuIdle Driver started\n");
 
+	/* Let teo predict the periodic interrupts */
+	irq_timings_enable();
+
 	return cpuidle_register(&zynq_idle_driver, NULL);
 }
 
@@ -130,9 +130,18 @@
  * util to the precomputed util threshold. If it's below, it defaults to the
  * TEO metrics mechanism. If it's above, the closest shallower idle state will
  * be selected instead, as long as is not a polling state.
+ *
+ * IRQ timings:
+ *
+ * With CONFIG_IRQ_TIMINGS and the IRQ timings enabled, the governor also asks
+ * for the predicted arrival of the next recurring interrupt on the CPU. An
+ * interrupt expected before the target residency of the candidate state is
+ * treated like a timer, so periodic device interrupts don't keep pulling the
+ * CPU out of a deep state.
  */
 
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
@@ -364,6 +373,19 @@ static int teo_find_shallower_state(struct cpuidle_driver *drv,
 	return state_idx;
 }
 
+/* Time till the next interrupt predicted by the IRQ timings, if any */
+static s64 teo_irq_prediction_ns(void)
+{
+#ifdef CONFIG_IRQ_TIMINGS
+	u64 now = local_clock();
+	u64 next = irq_timings_next_event(now);
+
+	if (next != U64_MAX)
+		return next - now;
+#endif
+	return KTIME_MAX;
+}
+
 /**
  * teo_select - Selects the next idle state to enter.
  * @drv: cpuidle driver containing state data.
@@ -387,7 +409,7 @@ static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	int idx0 = 0, idx = -1;
 	bool alt_intercepts, alt_recent;
 	bool cpu_utilized;
-	s64 duration_ns;
+	s64 duration_ns, irq_ns;
 	int i;
 
 	if (dev->last_state_idx >= 0) {
@@ -601,6 +623,18 @@ static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 			idx = i;
 	}
 
+	/* Same for a recurring interrupt predicted to come first. */
+	irq_ns = teo_irq_prediction_ns();
+	if (irq_ns < duration_ns) {
+		duration_ns = irq_ns;
+		if (drv->states[idx].target_residency_ns > duration_ns) {
+			i = teo_find_shallower_state(drv, dev, idx, duration_ns,
+						     false);
+			if (teo_state_ok(i, drv))
+				idx = i;
+		}
+	}
+
 	/*
 	 * If the selected state's target residency is below the tick length
 	 * and intercepts occurring before the tick length are the majority of
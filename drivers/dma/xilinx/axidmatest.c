@@ -10,18 +10,23 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
 #include <linux/init.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of_dma.h>
 #include <linux/platform_device.h>
 #include <linux/random.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/wait.h>
 #include <linux/sched/task.h>
 #include <linux/dma/xilinx_dma.h>
+#include <linux/dma/xilinx_dma_slave.h>
 
 static unsigned int test_buf_size = 16384;
 module_param(test_buf_size, uint, 0444);
@@ -32,6 +37,39 @@ module_param(iterations, uint, 0444);
 MODULE_PARM_DESC(iterations,
 		 "Iterations before stopping test (default: infinite)");
 
+static bool bench;
+module_param(bench, bool, 0444);
+MODULE_PARM_DESC(bench, "Run the throughput/latency benchmark sweep instead of the loopback test");
+
+#define DMATEST_BENCH_MAX_POINTS	8
+
+static unsigned int bench_sizes[DMATEST_BENCH_MAX_POINTS] = { 4096, 65536 };
+static int nr_bench_sizes = 2;
+module_param_array(bench_sizes, uint, &nr_bench_sizes, 0444);
+MODULE_PARM_DESC(bench_sizes, "Buffer sizes to sweep, in bytes");
+
+static unsigned int bench_sg_lens[DMATEST_BENCH_MAX_POINTS] = { 1, 8 };
+static int nr_bench_sg_lens = 2;
+module_param_array(bench_sg_lens, uint, &nr_bench_sg_lens, 0444);
+MODULE_PARM_DESC(bench_sg_lens, "Scatterlist lengths to sweep");
+
+static unsigned int bench_depths[DMATEST_BENCH_MAX_POINTS] = { 1, 8 };
+static int nr_bench_depths = 2;
+module_param_array(bench_depths, uint, &nr_bench_depths, 0444);
+MODULE_PARM_DESC(bench_depths, "Queue depths to sweep");
+
+static bool bench_dim;
+module_param(bench_dim, bool, 0444);
+MODULE_PARM_DESC(bench_dim, "Also sweep with adaptive interrupt coalescing");
+
+static unsigned int bench_iters = 1000;
+module_param(bench_iters, uint, 0444);
+MODULE_PARM_DESC(bench_iters, "Transfers per benchmark point");
+
+static int bench_cpu = -1;
+module_param(bench_cpu, int, 0444);
+MODULE_PARM_DESC(bench_cpu, "CPU to pin the benchmark threads to (default: none)");
+
 /*
  * Initialization patterns. All bytes in the source buffer has bit 7
  * set, all bytes in the destination buffer has bit 7 cleared.
@@ -76,6 +114,71 @@ static DECLARE_WAIT_QUEUE_HEAD(thread_wait);
 static LIST_HEAD(dmatest_channels);
 static unsigned int nr_channels;
 
+/**
+ * struct dmatest_bench_result - One point of the benchmark sweep
+ * @node: Node in the results list
+ * @name: Thread name, identifying the channel pair
+ * @size: Buffer size per scatterlist entry
+ * @sg_len: Scatterlist length
+ * @depth: Transfers kept in flight
+ * @dim: Adaptive interrupt coalescing was enabled
+ * @threads: Benchmark threads running concurrently
+ * @xfers: Completed transfers
+ * @mbps: Throughput, in MB/s
+ * @iops: Transfers per second
+ * @p50: Median submit to completion latency, in ns
+ * @p99: 99th percentile latency, in ns
+ * @p999: 99.9th percentile latency, in ns
+ */
+struct dmatest_bench_result {
+	struct list_head node;
+	char name[TASK_COMM_LEN];
+	unsigned int size;
+	unsigned int sg_len;
+	unsigned int depth;
+	bool dim;
+	unsigned int threads;
+	unsigned int xfers;
+	u64 mbps;
+	u64 iops;
+	u64 p50;
+	u64 p99;
+	u64 p999;
+};
+
+/**
+ * struct dmatest_bench - Benchmark state of a thread
+ * @wait: Woken on every completion
+ * @inflight: Transfers submitted and not completed
+ * @completed: Transfers completed at this point
+ * @lat: Latency samples, one per transfer
+ * @submit: Submit time of each in flight slot
+ * @depth: Number of slots
+ */
+struct dmatest_bench {
+	wait_queue_head_t wait;
+	atomic_t inflight;
+	atomic_t completed;
+	u64 *lat;
+	ktime_t *submit;
+	unsigned int depth;
+};
+
+/**
+ * struct dmatest_bench_xfer - Completion context of an in flight slot
+ * @bench: Benchmark state
+ * @slot: Slot index
+ */
+struct dmatest_bench_xfer {
+	struct dmatest_bench *bench;
+	unsigned int slot;
+};
+
+static DEFINE_MUTEX(bench_lock);
+static LIST_HEAD(bench_results);
+static atomic_t bench_threads = ATOMIC_INIT(0);
+static struct dentry *dmatest_debugfs;
+
 static unsigned long long dmatest_persec(s64 runtime, unsigned int val)
 {
 	unsigned long long per_sec = 1000000;
@@ -515,6 +618,275 @@ static int dmatest_slave_func(void *data)
 	return ret;
 }
 
+static void dmatest_bench_callback(void *arg)
+{
+	struct dmatest_bench_xfer *xfer = arg;
+	struct dmatest_bench *b = xfer->bench;
+	unsigned int i = atomic_inc_return(&b->completed) - 1;
+
+	if (i < bench_iters)
+		b->lat[i] = ktime_to_ns(ktime_sub(ktime_get(),
+						  b->submit[xfer->slot]));
+	atomic_dec(&b->inflight);
+	wake_up(&b->wait);
+}
+
+static int dmatest_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int dmatest_bench_set_dim(struct dma_chan *chan, bool dim)
+{
+	struct xilinx_dma_slave_config xcfg = {
+		.flags = dim ? XILINX_DMA_SLAVE_DIM : 0,
+		.flags_mask = XILINX_DMA_SLAVE_DIM,
+	};
+	struct dma_slave_config cfg = {
+		.peripheral_config = &xcfg,
+		.peripheral_size = sizeof(xcfg),
+	};
+
+	return dmaengine_slave_config(chan, &cfg);
+}
+
+/*
+ * Run one point of the sweep: keep @depth loopback transfers of @sg_len
+ * entries of @size bytes in flight until bench_iters have completed. The
+ * payload is not verified, all entries share one source and one
+ * destination buffer.
+ */
+static int dmatest_bench_point(struct dmatest_slave_thread *thread,
+			       unsigned int size, unsigned int sg_len,
+			       unsigned int depth, bool dim)
+{
+	struct dma_chan *tx_chan = thread->tx_chan;
+	struct dma_chan *rx_chan = thread->rx_chan;
+	struct device *tx_dev = dmaengine_get_dma_device(tx_chan);
+	struct device *rx_dev = dmaengine_get_dma_device(rx_chan);
+	struct scatterlist *tx_sg, *rx_sg;
+	struct dmatest_bench_result *res;
+	struct dmatest_bench_xfer *xfers;
+	struct dmatest_bench b = { .depth = depth };
+	dma_addr_t src_dma, dst_dma;
+	unsigned int submitted, i, n;
+	void *src, *dst;
+	int ret = -ENOMEM;
+	u64 bytes, ns;
+	ktime_t start;
+
+	init_waitqueue_head(&b.wait);
+	atomic_set(&b.inflight, 0);
+	atomic_set(&b.completed, 0);
+
+	res = kzalloc(sizeof(*res), GFP_KERNEL);
+	b.lat = kvcalloc(bench_iters, sizeof(*b.lat), GFP_KERNEL);
+	b.submit = kcalloc(depth, sizeof(*b.submit), GFP_KERNEL);
+	xfers = kcalloc(depth, sizeof(*xfers), GFP_KERNEL);
+	tx_sg = kcalloc(sg_len, sizeof(*tx_sg), GFP_KERNEL);
+	rx_sg = kcalloc(sg_len, sizeof(*rx_sg), GFP_KERNEL);
+	src = kmalloc(size, GFP_KERNEL);
+	dst = kmalloc(size, GFP_KERNEL);
+	if (!res || !b.lat || !b.submit || !xfers || !tx_sg || !rx_sg ||
+	    !src || !dst)
+		goto err_free;
+
+	ret = dmatest_bench_set_dim(tx_chan, dim);
+	if (!ret)
+		ret = dmatest_bench_set_dim(rx_chan, dim);
+	if (ret)
+		goto err_free;
+
+	memset(src, PATTERN_SRC, size);
+
+	src_dma = dma_map_single(tx_dev, src, size, DMA_TO_DEVICE);
+	if (dma_mapping_error(tx_dev, src_dma)) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+	dst_dma = dma_map_single(rx_dev, dst, size, DMA_FROM_DEVICE);
+	if (dma_mapping_error(rx_dev, dst_dma)) {
+		ret = -ENOMEM;
+		goto err_unmap_src;
+	}
+
+	sg_init_table(tx_sg, sg_len);
+	sg_init_table(rx_sg, sg_len);
+	for (i = 0; i < sg_len; i++) {
+		sg_dma_address(&tx_sg[i]) = src_dma;
+		sg_dma_len(&tx_sg[i]) = size;
+		sg_dma_address(&rx_sg[i]) = dst_dma;
+		sg_dma_len(&rx_sg[i]) = size;
+	}
+
+	for (i = 0; i < depth; i++) {
+		xfers[i].bench = &b;
+		xfers[i].slot = i;
+	}
+
+	ret = 0;
+	start = ktime_get();
+	for (submitted = 0; submitted < bench_iters; submitted++) {
+		struct dma_async_tx_descriptor *txd, *rxd;
+		unsigned int slot = submitted % depth;
+
+		if (kthread_should_stop()) {
+			ret = -EINTR;
+			break;
+		}
+
+		/* Completions are in order, so this slot is free again */
+		if (!wait_event_timeout(b.wait,
+					atomic_read(&b.inflight) < depth,
+					msecs_to_jiffies(30000))) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+
+		rxd = dmaengine_prep_slave_sg(rx_chan, rx_sg, sg_len,
+					      DMA_DEV_TO_MEM,
+					      DMA_CTRL_ACK |
+					      DMA_PREP_INTERRUPT);
+		if (!rxd) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		rxd->callback = dmatest_bench_callback;
+		rxd->callback_param = &xfers[slot];
+
+		atomic_inc(&b.inflight);
+		b.submit[slot] = ktime_get();
+		if (dma_submit_error(dmaengine_submit(rxd))) {
+			atomic_dec(&b.inflight);
+			ret = -EIO;
+			break;
+		}
+
+		/*
+		 * The rxd is submitted before the txd is prepared, so that
+		 * the terminate below frees it if the txd cannot be queued.
+		 */
+		txd = dmaengine_prep_slave_sg(tx_chan, tx_sg, sg_len,
+					      DMA_MEM_TO_DEV, DMA_CTRL_ACK);
+		if (!txd || dma_submit_error(dmaengine_submit(txd))) {
+			atomic_dec(&b.inflight);
+			ret = txd ? -EIO : -ENOMEM;
+			break;
+		}
+		dma_async_issue_pending(rx_chan);
+		dma_async_issue_pending(tx_chan);
+	}
+
+	if (!wait_event_timeout(b.wait, !atomic_read(&b.inflight),
+				msecs_to_jiffies(30000)))
+		ret = -ETIMEDOUT;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (ret) {
+		dmaengine_terminate_sync(tx_chan);
+		dmaengine_terminate_sync(rx_chan);
+	}
+
+	dma_unmap_single(rx_dev, dst_dma, size, DMA_FROM_DEVICE);
+err_unmap_src:
+	dma_unmap_single(tx_dev, src_dma, size, DMA_TO_DEVICE);
+	if (ret)
+		goto err_free;
+
+	n = min_t(unsigned int, atomic_read(&b.completed), bench_iters);
+	sort(b.lat, n, sizeof(*b.lat), dmatest_cmp_u64, NULL);
+
+	bytes = (u64)n * size * sg_len;
+	strscpy(res->name, current->comm, sizeof(res->name));
+	res->size = size;
+	res->sg_len = sg_len;
+	res->depth = depth;
+	res->dim = dim;
+	res->threads = atomic_read(&bench_threads);
+	res->xfers = n;
+	if (ns) {
+		res->mbps = div64_u64(bytes * 1000, ns);
+		res->iops = div64_u64((u64)n * NSEC_PER_SEC, ns);
+	}
+	if (n) {
+		res->p50 = b.lat[n * 50 / 100];
+		res->p99 = b.lat[n * 99 / 100];
+		res->p999 = b.lat[n * 999 / 1000];
+	}
+
+	mutex_lock(&bench_lock);
+	list_add_tail(&res->node, &bench_results);
+	mutex_unlock(&bench_lock);
+	res = NULL;
+
+err_free:
+	kfree(dst);
+	kfree(src);
+	kfree(rx_sg);
+	kfree(tx_sg);
+	kfree(xfers);
+	kfree(b.submit);
+	kvfree(b.lat);
+	kfree(res);
+
+	return ret;
+}
+
+static int dmatest_bench_func(void *data)
+{
+	struct dmatest_slave_thread *thread = data;
+	const char *thread_name = current->comm;
+	int s, g, d, dim, ret = 0;
+
+	atomic_inc(&bench_threads);
+
+	for (dim = 0; dim <= bench_dim && !ret; dim++)
+		for (s = 0; s < nr_bench_sizes && !ret; s++)
+			for (g = 0; g < nr_bench_sg_lens && !ret; g++)
+				for (d = 0; d < nr_bench_depths && !ret; d++) {
+					if (!bench_sizes[s] ||
+					    !bench_sg_lens[g] ||
+					    !bench_depths[d])
+						continue;
+					ret = dmatest_bench_point(thread,
+								  bench_sizes[s],
+								  bench_sg_lens[g],
+								  bench_depths[d],
+								  dim);
+				}
+
+	atomic_dec(&bench_threads);
+
+	pr_notice("%s: benchmark %s (status %d)\n", thread_name,
+		  ret ? "aborted" : "done", ret);
+
+	thread->done = true;
+	wake_up(&thread_wait);
+
+	return ret;
+}
+
+static int dmatest_results_show(struct seq_file *s, void *data)
+{
+	struct dmatest_bench_result *res;
+
+	seq_puts(s, "thread,size,sg_len,depth,dim,threads,xfers,mbps,iops,p50_ns,p99_ns,p999_ns\n");
+
+	mutex_lock(&bench_lock);
+	list_for_each_entry(res, &bench_results, node)
+		seq_printf(s, "%s,%u,%u,%u,%d,%u,%u,%llu,%llu,%llu,%llu,%llu\n",
+			   res->name, res->size, res->sg_len, res->depth,
+			   res->dim, res->threads, res->xfers, res->mbps,
+			   res->iops, res->p50, res->p99, res->p999);
+	mutex_unlock(&bench_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dmatest_results);
+
 static void dmatest_cleanup_channel(struct dmatest_chan *dtc)
 {
 	struct dmatest_slave_thread *thread;
@@ -552,9 +924,10 @@ static int dmatest_add_slave_threads(struct dmatest_chan *tx_dtc,
 
 	/* Ensure that all previous writes are complete */
 	smp_wmb();
-	thread->task = kthread_run(dmatest_slave_func, thread, "%s-%s",
-				   dma_chan_name(tx_chan),
-				   dma_chan_name(rx_chan));
+	thread->task = kthread_create(bench ? dmatest_bench_func :
+				      dmatest_slave_func, thread, "%s-%s",
+				      dma_chan_name(tx_chan),
+				      dma_chan_name(rx_chan));
 	ret = PTR_ERR(thread->task);
 	if (IS_ERR(thread->task)) {
 		pr_warn("dmatest: Failed to run thread %s-%s\n",
@@ -563,6 +936,10 @@ static int dmatest_add_slave_threads(struct dmatest_chan *tx_dtc,
 		return ret;
 	}
 
+	if (bench_cpu >= 0 && cpu_online(bench_cpu))
+		kthread_bind(thread->task, bench_cpu);
+	wake_up_process(thread->task);
+
 	/* srcbuf and dstbuf are allocated by the thread itself */
 	get_task_struct(thread->task);
 	list_add_tail(&thread->node, &tx_dtc->threads);
@@ -683,13 +1060,25 @@ static struct platform_driver xilinx_axidmatest_driver = {
 
 static int __init axidma_init(void)
 {
+	dmatest_debugfs = debugfs_create_dir("xilinx_axidmatest", NULL);
+	debugfs_create_file("results", 0444, dmatest_debugfs, NULL,
+			    &dmatest_results_fops);
+
 	return platform_driver_register(&xilinx_axidmatest_driver);
 }
 late_initcall(axidma_init);
 
 static void __exit axidma_exit(void)
 {
+	struct dmatest_bench_result *res, *_res;
+
 	platform_driver_unregister(&xilinx_axidmatest_driver);
+	debugfs_remove_recursive(dmatest_debugfs);
+
+	list_for_each_entry_safe(res, _res, &bench_results, node) {
+		list_del(&res->node);
+		kfree(res);
+	}
 }
 module_exit(axidma_exit)
 
@@ -44,6 +44,8 @@
 	 FIELD_PREP(XDMA_DESC_FLAGS_BITS, (flag)))
 #define XDMA_DESC_CONTROL_LAST						\
 	XDMA_DESC_CONTROL(1, XDMA_DESC_STOPPED | XDMA_DESC_COMPLETED)
+#define XDMA_DESC_CONTROL_CYCLIC					\
+	XDMA_DESC_CONTROL(1, XDMA_DESC_COMPLETED)
 
 /*
  * Descriptor for a single contiguous memory block transfer.
@@ -74,8 +76,12 @@ struct xdma_hw_desc {
 #define XDMA_CHAN_CONTROL_W1S		0x8
 #define XDMA_CHAN_CONTROL_W1C		0xc
 #define XDMA_CHAN_STATUS		0x40
+#define XDMA_CHAN_STATUS_RC		0x44
 #define XDMA_CHAN_COMPLETED_DESC	0x48
+#define XDMA_CHAN_COMPLETED_DESC_MASK	GENMASK(23, 0)
 #define XDMA_CHAN_ALIGNMENTS		0x4c
+#define XDMA_CHAN_POLL_WB_LO		0x88
+#define XDMA_CHAN_POLL_WB_HI		0x8c
 #define XDMA_CHAN_INTR_ENABLE		0x90
 #define XDMA_CHAN_INTR_ENABLE_W1S	0x94
 #define XDMA_CHAN_INTR_ENABLE_W1C	0x9c
@@ -86,6 +92,11 @@ struct xdma_hw_desc {
 #define XDMA_CHAN_H2C_TARGET	0x0
 #define XDMA_CHAN_C2H_TARGET	0x1
 
+/* completion write-back word, written to host memory in poll mode */
+#define XDMA_WB_COUNT_MASK		GENMASK(23, 0)
+#define XDMA_WB_ERROR			BIT(31)
+#define XDMA_WB_SIZE			32
+
 /* macro to check if channel is available */
 #define XDMA_CHAN_MAGIC		0x1fc0
 #define XDMA_CHAN_CHECK_TARGET(id, target)		\
@@ -29,7 +29,9 @@
 #include <linux/platform_device.h>
 #include <linux/platform_data/amd_xdma.h>
 #include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
 #include <linux/pci.h>
+#include <trace/events/xilinx_dma.h>
 #include "../virt-dma.h"
 #include "xdma-regs.h"
 
@@ -41,6 +43,15 @@ static const struct regmap_config xdma_regmap_config = {
 	.max_register = XDMA_REG_SPACE_LEN,
 };
 
+/*
+ * Completed requests of up to XDMA_DESC_CACHE_BLOCKS descriptor blocks are
+ * kept, blocks included, in per-channel buckets indexed by block count so
+ * that requests of similar size do not go through dma_pool on every
+ * submission. Each bucket holds at most XDMA_DESC_CACHE_DEPTH requests.
+ */
+#define XDMA_DESC_CACHE_BLOCKS		4
+#define XDMA_DESC_CACHE_DEPTH		64
+
 /**
  * struct xdma_desc_block - Descriptor block
  * @virt_addr: Virtual address of block start
@@ -61,6 +72,11 @@ struct xdma_desc_block {
  * @dir: Transferring direction of the channel
  * @cfg: Transferring config of the channel
  * @irq: IRQ assigned to the channel
+ * @wb: Completion write-back word, NULL if write-back is not in use
+ * @wb_dma: DMA address of the completion write-back word
+ * @cache_lock: Lock protecting the descriptor cache
+ * @desc_cache: Cached requests, by number of descriptor blocks minus one
+ * @cache_cnt: Number of cached requests in each bucket
  */
 struct xdma_chan {
 	struct virt_dma_chan		vchan;
@@ -71,6 +87,11 @@ struct xdma_chan {
 	enum dma_transfer_direction	dir;
 	struct dma_slave_config		cfg;
 	u32				irq;
+	__le32				*wb;
+	dma_addr_t			wb_dma;
+	spinlock_t			cache_lock;
+	struct list_head		desc_cache[XDMA_DESC_CACHE_BLOCKS];
+	u32				cache_cnt[XDMA_DESC_CACHE_BLOCKS];
 };
 
 /**
@@ -83,6 +104,12 @@ struct xdma_chan {
  * @dblk_num: Number of hardware descriptor blocks
  * @desc_num: Number of hardware descriptors
  * @completed_desc_num: Completed hardware descriptors
+ * @cyclic: Cyclic transfer vs. scatter-gather
+ * @periods: Number of periods in the cyclic transfer
+ * @period_size: Size of a period in bytes in cyclic transfers
+ * @period_idx: Period the engine is working on in cyclic transfers
+ * @error: A transfer error was reported for the request
+ * @len: Total transfer length in bytes
  */
 struct xdma_desc {
 	struct virt_dma_desc		vdesc;
@@ -93,6 +120,12 @@ struct xdma_desc {
 	u32				dblk_num;
 	u32				desc_num;
 	u32				completed_desc_num;
+	bool				cyclic;
+	u32				periods;
+	u32				period_size;
+	u32				period_idx;
+	bool				error;
+	size_t				len;
 };
 
 #define XDMA_DEV_STATUS_REG_DMA		BIT(0)
@@ -137,10 +170,10 @@ static inline void *xdma_blk_last_desc(struct xdma_desc_block *block)
 }
 
 /**
- * xdma_link_desc_blocks - Link descriptor blocks for DMA transfer
+ * xdma_link_sg_desc_blocks - Link descriptor blocks for DMA transfer
  * @sw_desc: Tx descriptor pointer
  */
-static void xdma_link_desc_blocks(struct xdma_desc *sw_desc)
+static void xdma_link_sg_desc_blocks(struct xdma_desc *sw_desc)
 {
 	struct xdma_desc_block *block;
 	u32 last_blk_desc, desc_control;
@@ -174,6 +207,26 @@ static void xdma_link_desc_blocks(struct xdma_desc *sw_desc)
 	desc->control = cpu_to_le32(XDMA_DESC_CONTROL_LAST);
 }
 
+/**
+ * xdma_link_cyclic_desc_blocks - Link descriptors for a cyclic transfer
+ * @sw_desc: Tx descriptor pointer
+ *
+ * Cyclic transfers fit in a single block, every descriptor points to the
+ * next one and the last one back to the first, none of them stops the
+ * engine.
+ */
+static void xdma_link_cyclic_desc_blocks(struct xdma_desc *sw_desc)
+{
+	struct xdma_desc_block *block = sw_desc->desc_blocks;
+	struct xdma_hw_desc *desc = block->virt_addr;
+	int i;
+
+	for (i = 0; i < sw_desc->desc_num - 1; i++)
+		desc[i].next_desc = cpu_to_le64(block->dma_addr +
+						(i + 1) * XDMA_DESC_SIZE);
+	desc[i].next_desc = cpu_to_le64(block->dma_addr);
+}
+
 static inline struct xdma_chan *to_xdma_chan(struct dma_chan *chan)
 {
 	return container_of(chan, struct xdma_chan, vchan.chan);
@@ -184,6 +237,17 @@ static inline struct xdma_desc *to_xdma_desc(struct virt_dma_desc *vdesc)
 	return container_of(vdesc, struct xdma_desc, vdesc);
 }
 
+/* The DMA device is the PCI function the platform device sits below */
+static struct device *xdma_pci_dev(struct xdma_device *xdev)
+{
+	struct device *dev = xdev->dma_dev.dev;
+
+	while (dev && !dev_is_pci(dev))
+		dev = dev->parent;
+
+	return dev;
+}
+
 /**
  * xdma_channel_init - Initialize DMA channel registers
  * @chan: DMA channel pointer
@@ -207,15 +271,13 @@ static int xdma_channel_init(struct xdma_chan *chan)
 }
 
 /**
- * xdma_free_desc - Free descriptor
- * @vdesc: Virtual DMA descriptor
+ * __xdma_free_desc - Release descriptor and its blocks
+ * @sw_desc: Tx descriptor pointer
  */
-static void xdma_free_desc(struct virt_dma_desc *vdesc)
+static void __xdma_free_desc(struct xdma_desc *sw_desc)
 {
-	struct xdma_desc *sw_desc;
 	int i;
 
-	sw_desc = to_xdma_desc(vdesc);
 	for (i = 0; i < sw_desc->dblk_num; i++) {
 		if (!sw_desc->desc_blocks[i].virt_addr)
 			break;
@@ -227,28 +289,136 @@ static void xdma_free_desc(struct virt_dma_desc *vdesc)
 	kfree(sw_desc);
 }
 
+/**
+ * xdma_free_desc - Free descriptor
+ * @vdesc: Virtual DMA descriptor
+ *
+ * Requests whose blocks were all allocated go back to the channel cache if
+ * their bucket has room.
+ */
+static void xdma_free_desc(struct virt_dma_desc *vdesc)
+{
+	struct xdma_desc *sw_desc = to_xdma_desc(vdesc);
+	struct xdma_chan *chan = sw_desc->chan;
+	unsigned long flags;
+	u32 idx;
+
+	idx = sw_desc->dblk_num - 1;
+	if (!sw_desc->dblk_num || idx >= XDMA_DESC_CACHE_BLOCKS ||
+	    !sw_desc->desc_blocks[idx].virt_addr)
+		goto free;
+
+	spin_lock_irqsave(&chan->cache_lock, flags);
+	if (chan->desc_pool && chan->cache_cnt[idx] < XDMA_DESC_CACHE_DEPTH) {
+		list_add(&sw_desc->vdesc.node, &chan->desc_cache[idx]);
+		chan->cache_cnt[idx]++;
+		sw_desc = NULL;
+	}
+	spin_unlock_irqrestore(&chan->cache_lock, flags);
+
+	if (!sw_desc)
+		return;
+free:
+	__xdma_free_desc(sw_desc);
+}
+
+/**
+ * xdma_get_cached_desc - Take a request from the channel cache
+ * @chan: DMA channel pointer
+ * @dblk_num: Number of descriptor blocks needed
+ */
+static struct xdma_desc *xdma_get_cached_desc(struct xdma_chan *chan,
+					      u32 dblk_num)
+{
+	struct xdma_desc *sw_desc = NULL;
+	struct xdma_desc_block *blocks;
+	unsigned long flags;
+	u32 idx = dblk_num - 1;
+
+	if (idx >= XDMA_DESC_CACHE_BLOCKS)
+		return NULL;
+
+	spin_lock_irqsave(&chan->cache_lock, flags);
+	if (chan->cache_cnt[idx]) {
+		sw_desc = list_first_entry(&chan->desc_cache[idx],
+					   struct xdma_desc, vdesc.node);
+		list_del(&sw_desc->vdesc.node);
+		chan->cache_cnt[idx]--;
+	}
+	spin_unlock_irqrestore(&chan->cache_lock, flags);
+
+	if (!sw_desc)
+		return NULL;
+
+	/* keep the blocks, start over with the rest */
+	blocks = sw_desc->desc_blocks;
+	memset(sw_desc, 0, sizeof(*sw_desc));
+	sw_desc->desc_blocks = blocks;
+	sw_desc->dblk_num = dblk_num;
+	sw_desc->chan = chan;
+
+	return sw_desc;
+}
+
+/**
+ * xdma_drain_desc_cache - Release every request from the channel cache
+ * @chan: DMA channel pointer
+ */
+static void xdma_drain_desc_cache(struct xdma_chan *chan)
+{
+	struct xdma_desc *sw_desc, *tmp;
+	unsigned long flags;
+	LIST_HEAD(head);
+	int i;
+
+	spin_lock_irqsave(&chan->cache_lock, flags);
+	for (i = 0; i < XDMA_DESC_CACHE_BLOCKS; i++) {
+		list_splice_tail_init(&chan->desc_cache[i], &head);
+		chan->cache_cnt[i] = 0;
+	}
+	spin_unlock_irqrestore(&chan->cache_lock, flags);
+
+	list_for_each_entry_safe(sw_desc, tmp, &head, vdesc.node)
+		__xdma_free_desc(sw_desc);
+}
+
 /**
  * xdma_alloc_desc - Allocate descriptor
  * @chan: DMA channel pointer
  * @desc_num: Number of hardware descriptors
+ * @cyclic: Whether the descriptors form a cyclic transfer
  */
 static struct xdma_desc *
-xdma_alloc_desc(struct xdma_chan *chan, u32 desc_num)
+xdma_alloc_desc(struct xdma_chan *chan, u32 desc_num, bool cyclic)
 {
 	struct xdma_desc *sw_desc;
 	struct xdma_hw_desc *desc;
 	dma_addr_t dma_addr;
-	u32 dblk_num;
+	u32 dblk_num, control;
 	void *addr;
 	int i, j;
 
+	if (cyclic)
+		control = XDMA_DESC_CONTROL_CYCLIC;
+	else
+		control = XDMA_DESC_CONTROL(1, 0);
+
+	dblk_num = DIV_ROUND_UP(desc_num, XDMA_DESC_ADJACENT);
+	sw_desc = xdma_get_cached_desc(chan, dblk_num);
+	if (sw_desc) {
+		for (i = 0; i < dblk_num; i++) {
+			desc = sw_desc->desc_blocks[i].virt_addr;
+			for (j = 0; j < XDMA_DESC_ADJACENT; j++)
+				desc[j].control = cpu_to_le32(control);
+		}
+		goto link;
+	}
+
 	sw_desc = kzalloc(sizeof(*sw_desc), GFP_NOWAIT);
 	if (!sw_desc)
 		return NULL;
 
 	sw_desc->chan = chan;
-	sw_desc->desc_num = desc_num;
-	dblk_num = DIV_ROUND_UP(desc_num, XDMA_DESC_ADJACENT);
 	sw_desc->desc_blocks = kcalloc(dblk_num, sizeof(*sw_desc->desc_blocks),
 				       GFP_NOWAIT);
 	if (!sw_desc->desc_blocks)
@@ -263,15 +433,22 @@ xdma_alloc_desc(struct xdma_chan *chan, u32 desc_num)
 		sw_desc->desc_blocks[i].virt_addr = addr;
 		sw_desc->desc_blocks[i].dma_addr = dma_addr;
 		for (j = 0, desc = addr; j < XDMA_DESC_ADJACENT; j++)
-			desc[j].control = cpu_to_le32(XDMA_DESC_CONTROL(1, 0));
+			desc[j].control = cpu_to_le32(control);
 	}
 
-	xdma_link_desc_blocks(sw_desc);
+link:
+	sw_desc->desc_num = desc_num;
+	sw_desc->len = 0;
+	sw_desc->cyclic = cyclic;
+	if (cyclic)
+		xdma_link_cyclic_desc_blocks(sw_desc);
+	else
+		xdma_link_sg_desc_blocks(sw_desc);
 
 	return sw_desc;
 
 failed:
-	xdma_free_desc(&sw_desc->vdesc);
+	__xdma_free_desc(sw_desc);
 	return NULL;
 }
 
@@ -284,7 +461,7 @@ static int xdma_xfer_start(struct xdma_chan *xchan)
 	struct virt_dma_desc *vd = vchan_next_desc(&xchan->vchan);
 	struct xdma_device *xdev = xchan->xdev_hdl;
 	struct xdma_desc_block *block;
-	u32 val, completed_blocks;
+	u32 val, ctrl, completed_blocks;
 	struct xdma_desc *desc;
 	int ret;
 
@@ -328,16 +505,45 @@ static int xdma_xfer_start(struct xdma_chan *xchan)
 	if (ret)
 		return ret;
 
+	/* the completed count restarts from zero along with the engine */
+	ctrl = CHAN_CTRL_START;
+	if (xchan->wb) {
+		WRITE_ONCE(*xchan->wb, 0);
+		ctrl |= CHAN_CTRL_POLL_MODE_WB;
+	}
+
 	/* kick off DMA transfer */
-	ret = regmap_write(xdev->rmap, xchan->base + XDMA_CHAN_CONTROL,
-			   CHAN_CTRL_START);
+	ret = regmap_write(xdev->rmap, xchan->base + XDMA_CHAN_CONTROL, ctrl);
 	if (ret)
 		return ret;
 
+	if (!desc->completed_desc_num)
+		trace_xilinx_dma_start(&xchan->vchan.chan, vd->tx.cookie,
+				       desc->len);
+
 	xchan->busy = true;
 	return 0;
 }
 
+/**
+ * xdma_xfer_stop - Stop DMA transfer
+ * @xchan: DMA channel pointer
+ */
+static int xdma_xfer_stop(struct xdma_chan *xchan)
+{
+	struct xdma_device *xdev = xchan->xdev_hdl;
+	u32 val;
+	int ret;
+
+	ret = regmap_write(xdev->rmap, xchan->base + XDMA_CHAN_CONTROL_W1C,
+			   CHAN_CTRL_RUN_STOP);
+	if (ret)
+		return ret;
+
+	/* clear-on-read the status register */
+	return regmap_read(xdev->rmap, xchan->base + XDMA_CHAN_STATUS_RC, &val);
+}
+
 /**
  * xdma_alloc_channels - Detect and allocate DMA channels
  * @xdev: DMA device pointer
@@ -350,7 +556,7 @@ static int xdma_alloc_channels(struct xdma_device *xdev,
 	struct xdma_chan **chans, *xchan;
 	u32 base, identifier, target;
 	u32 *chan_num;
-	int i, j, ret;
+	int i, j, k, ret;
 
 	if (dir == DMA_MEM_TO_DEV) {
 		base = XDMA_CHAN_H2C_OFFSET;
@@ -412,6 +618,10 @@ static int xdma_alloc_channels(struct xdma_device *xdev,
 		ret = xdma_channel_init(xchan);
 		if (ret)
 			return ret;
+		spin_lock_init(&xchan->cache_lock);
+		for (k = 0; k < XDMA_DESC_CACHE_BLOCKS; k++)
+			INIT_LIST_HEAD(&xchan->desc_cache[k]);
+
 		xchan->vchan.desc_free = xdma_free_desc;
 		vchan_init(&xchan->vchan, &xdev->dma_dev);
 
@@ -424,6 +634,21 @@ static int xdma_alloc_channels(struct xdma_device *xdev,
 	return 0;
 }
 
+/**
+ * xdma_tx_submit - Submit a transaction to the virtual channel
+ * @tx: Async transaction descriptor pointer
+ */
+static dma_cookie_t xdma_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct virt_dma_desc *vd = container_of(tx, struct virt_dma_desc, tx);
+	dma_cookie_t cookie;
+
+	cookie = vchan_tx_submit(tx);
+	trace_xilinx_dma_submit(tx->chan, cookie, to_xdma_desc(vd)->len);
+
+	return cookie;
+}
+
 /**
  * xdma_issue_pending - Issue pending transactions
  * @chan: DMA channel pointer
@@ -433,12 +658,55 @@ static void xdma_issue_pending(struct dma_chan *chan)
 	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
 	unsigned long flags;
 
+	trace_xilinx_dma_issue_pending(chan);
+
 	spin_lock_irqsave(&xdma_chan->vchan.lock, flags);
 	if (vchan_issue_pending(&xdma_chan->vchan))
 		xdma_xfer_start(xdma_chan);
 	spin_unlock_irqrestore(&xdma_chan->vchan.lock, flags);
 }
 
+/**
+ * xdma_fill_descs - Fill hardware descriptors for a contiguous range
+ * @sw_desc: Tx descriptor pointer
+ * @src_addr: Source address of the range
+ * @dst_addr: Destination address of the range
+ * @size: Size of the range in bytes
+ * @filled_descs_num: Number of descriptors already filled
+ *
+ * Return: The number of descriptors used for the range.
+ */
+static u32 xdma_fill_descs(struct xdma_desc *sw_desc, u64 src_addr,
+			   u64 dst_addr, u32 size, u32 filled_descs_num)
+{
+	u32 left = size, len, desc_num = filled_descs_num;
+	struct xdma_desc_block *dblk;
+	struct xdma_hw_desc *desc;
+
+	sw_desc->len += size;
+	dblk = sw_desc->desc_blocks + (desc_num / XDMA_DESC_ADJACENT);
+	desc = dblk->virt_addr;
+	desc += desc_num & XDMA_DESC_ADJACENT_MASK;
+	do {
+		len = min_t(u32, left, XDMA_DESC_BLEN_MAX);
+		/* set hardware descriptor */
+		desc->bytes = cpu_to_le32(len);
+		desc->src_addr = cpu_to_le64(src_addr);
+		desc->dst_addr = cpu_to_le64(dst_addr);
+
+		if (!(++desc_num & XDMA_DESC_ADJACENT_MASK))
+			desc = (++dblk)->virt_addr;
+		else
+			desc++;
+
+		src_addr += len;
+		dst_addr += len;
+		left -= len;
+	} while (left);
+
+	return desc_num - filled_descs_num;
+}
+
 /**
  * xdma_prep_device_sg - prepare a descriptor for a DMA transaction
  * @chan: DMA channel pointer
@@ -455,18 +723,16 @@ xdma_prep_device_sg(struct dma_chan *chan, struct scatterlist *sgl,
 {
 	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
 	struct dma_async_tx_descriptor *tx_desc;
-	u32 desc_num = 0, i, len, rest;
-	struct xdma_desc_block *dblk;
-	struct xdma_hw_desc *desc;
 	struct xdma_desc *sw_desc;
 	u64 dev_addr, *src, *dst;
+	u32 desc_num = 0, i;
 	struct scatterlist *sg;
 	u64 addr;
 
 	for_each_sg(sgl, sg, sg_len, i)
 		desc_num += DIV_ROUND_UP(sg_dma_len(sg), XDMA_DESC_BLEN_MAX);
 
-	sw_desc = xdma_alloc_desc(xdma_chan, desc_num);
+	sw_desc = xdma_alloc_desc(xdma_chan, desc_num, false);
 	if (!sw_desc)
 		return NULL;
 	sw_desc->dir = dir;
@@ -481,37 +747,170 @@ xdma_prep_device_sg(struct dma_chan *chan, struct scatterlist *sgl,
 		dst = &addr;
 	}
 
-	dblk = sw_desc->desc_blocks;
-	desc = dblk->virt_addr;
-	desc_num = 1;
+	desc_num = 0;
 	for_each_sg(sgl, sg, sg_len, i) {
 		addr = sg_dma_address(sg);
-		rest = sg_dma_len(sg);
+		desc_num += xdma_fill_descs(sw_desc, *src, *dst,
+					    sg_dma_len(sg), desc_num);
+		dev_addr += sg_dma_len(sg);
+	}
+
+	tx_desc = vchan_tx_prep(&xdma_chan->vchan, &sw_desc->vdesc, flags);
+	if (!tx_desc)
+		goto failed;
+	tx_desc->tx_submit = xdma_tx_submit;
+
+	return tx_desc;
+
+failed:
+	xdma_free_desc(&sw_desc->vdesc);
+
+	return NULL;
+}
+
+/**
+ * xdma_prep_dma_cyclic - prepare a descriptor for a cyclic DMA transaction
+ * @chan: DMA channel pointer
+ * @address: Memory buffer address
+ * @size: Size of the buffer in bytes
+ * @period_size: Size of a period in bytes
+ * @dir: Transfer direction
+ * @flags: transfer ack flags
+ *
+ * Each period is a single hardware descriptor raising a completion
+ * interrupt, and all of them live in one descriptor block, so a cyclic
+ * transfer holds at most XDMA_DESC_ADJACENT periods of up to
+ * XDMA_DESC_BLEN_MAX bytes.
+ */
+static struct dma_async_tx_descriptor *
+xdma_prep_dma_cyclic(struct dma_chan *chan, dma_addr_t address,
+		     size_t size, size_t period_size,
+		     enum dma_transfer_direction dir,
+		     unsigned long flags)
+{
+	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
+	struct xdma_device *xdev = xdma_chan->xdev_hdl;
+	struct dma_async_tx_descriptor *tx_desc;
+	u64 addr, dev_addr, *src, *dst;
+	struct xdma_desc *sw_desc;
+	u32 periods, desc_num, i;
+
+	if (dir != xdma_chan->dir) {
+		xdma_err(xdev, "invalid transfer direction for this channel");
+		return NULL;
+	}
+
+	if (!period_size || size % period_size) {
+		xdma_err(xdev, "buffer size must be a multiple of period size");
+		return NULL;
+	}
+
+	if (period_size > XDMA_DESC_BLEN_MAX) {
+		xdma_err(xdev, "period size limited to %lu bytes",
+			 XDMA_DESC_BLEN_MAX);
+		return NULL;
+	}
+
+	periods = size / period_size;
+	if (periods > XDMA_DESC_ADJACENT) {
+		xdma_err(xdev, "number of periods limited to %u",
+			 XDMA_DESC_ADJACENT);
+		return NULL;
+	}
+
+	sw_desc = xdma_alloc_desc(xdma_chan, periods, true);
+	if (!sw_desc)
+		return NULL;
 
-		do {
-			len = min_t(u32, rest, XDMA_DESC_BLEN_MAX);
-			/* set hardware descriptor */
-			desc->bytes = cpu_to_le32(len);
-			desc->src_addr = cpu_to_le64(*src);
-			desc->dst_addr = cpu_to_le64(*dst);
+	sw_desc->periods = periods;
+	sw_desc->period_size = period_size;
+	sw_desc->dir = dir;
 
-			if (!(desc_num & XDMA_DESC_ADJACENT_MASK)) {
-				dblk++;
-				desc = dblk->virt_addr;
-			} else {
-				desc++;
-			}
+	addr = address;
+	if (dir == DMA_MEM_TO_DEV) {
+		dev_addr = xdma_chan->cfg.dst_addr;
+		src = &addr;
+		dst = &dev_addr;
+	} else {
+		dev_addr = xdma_chan->cfg.src_addr;
+		src = &dev_addr;
+		dst = &addr;
+	}
 
-			desc_num++;
-			dev_addr += len;
-			addr += len;
-			rest -= len;
-		} while (rest);
+	desc_num = 0;
+	for (i = 0; i < periods; i++) {
+		desc_num += xdma_fill_descs(sw_desc, *src, *dst, period_size,
+					    desc_num);
+		addr += period_size;
 	}
 
 	tx_desc = vchan_tx_prep(&xdma_chan->vchan, &sw_desc->vdesc, flags);
 	if (!tx_desc)
 		goto failed;
+	tx_desc->tx_submit = xdma_tx_submit;
+
+	return tx_desc;
+
+failed:
+	xdma_free_desc(&sw_desc->vdesc);
+
+	return NULL;
+}
+
+/**
+ * xdma_prep_interleaved_dma - prepare a descriptor for an interleaved
+ * DMA transaction
+ * @chan: DMA channel pointer
+ * @xt: Interleaved template
+ * @flags: transfer ack flags
+ */
+static struct dma_async_tx_descriptor *
+xdma_prep_interleaved_dma(struct dma_chan *chan,
+			  struct dma_interleaved_template *xt,
+			  unsigned long flags)
+{
+	struct xdma_chan *xchan = to_xdma_chan(chan);
+	struct dma_async_tx_descriptor *tx_desc;
+	struct xdma_desc *sw_desc;
+	u64 src_addr, dst_addr;
+	u32 desc_num = 0;
+	size_t i, j;
+
+	if (!xt->numf || !xt->frame_size || xt->dir != xchan->dir)
+		return NULL;
+
+	for (i = 0; i < xt->frame_size; i++)
+		desc_num += DIV_ROUND_UP(xt->sgl[i].size, XDMA_DESC_BLEN_MAX);
+	desc_num *= xt->numf;
+
+	sw_desc = xdma_alloc_desc(xchan, desc_num, false);
+	if (!sw_desc)
+		return NULL;
+	sw_desc->dir = xt->dir;
+
+	src_addr = xt->src_start;
+	dst_addr = xt->dst_start;
+	desc_num = 0;
+	for (i = 0; i < xt->numf; i++) {
+		for (j = 0; j < xt->frame_size; j++) {
+			if (!xt->sgl[j].size)
+				goto failed;
+
+			desc_num += xdma_fill_descs(sw_desc, src_addr, dst_addr,
+						    xt->sgl[j].size, desc_num);
+			if (xt->src_inc)
+				src_addr += xt->sgl[j].size +
+					    dmaengine_get_src_icg(xt, &xt->sgl[j]);
+			if (xt->dst_inc)
+				dst_addr += xt->sgl[j].size +
+					    dmaengine_get_dst_icg(xt, &xt->sgl[j]);
+		}
+	}
+
+	tx_desc = vchan_tx_prep(&xchan->vchan, &sw_desc->vdesc, flags);
+	if (!tx_desc)
+		goto failed;
+	tx_desc->tx_submit = xdma_tx_submit;
 
 	return tx_desc;
 
@@ -536,6 +935,93 @@ static int xdma_device_config(struct dma_chan *chan,
 	return 0;
 }
 
+/**
+ * xdma_terminate_all - Terminate all transactions
+ * @chan: DMA channel pointer
+ */
+static int xdma_terminate_all(struct dma_chan *chan)
+{
+	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
+	struct virt_dma_desc *vd;
+	unsigned long flags;
+	LIST_HEAD(head);
+	int ret;
+
+	trace_xilinx_dma_terminate(chan);
+
+	ret = xdma_xfer_stop(xdma_chan);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&xdma_chan->vchan.lock, flags);
+
+	/* the request in flight is not on any list once it is removed */
+	xdma_chan->busy = false;
+	vd = vchan_next_desc(&xdma_chan->vchan);
+	if (vd) {
+		list_del(&vd->node);
+		dma_cookie_complete(&vd->tx);
+		vchan_terminate_vdesc(vd);
+	}
+	vchan_get_all_descriptors(&xdma_chan->vchan, &head);
+	list_splice_tail(&head, &xdma_chan->vchan.desc_terminated);
+
+	spin_unlock_irqrestore(&xdma_chan->vchan.lock, flags);
+
+	return 0;
+}
+
+/**
+ * xdma_synchronize - Synchronize terminated transactions
+ * @chan: DMA channel pointer
+ */
+static void xdma_synchronize(struct dma_chan *chan)
+{
+	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
+
+	vchan_synchronize(&xdma_chan->vchan);
+}
+
+/**
+ * xdma_tx_status - Get DMA transaction status
+ * @chan: DMA channel pointer
+ * @cookie: Transaction identifier
+ * @state: Transaction state
+ */
+static enum dma_status xdma_tx_status(struct dma_chan *chan,
+				      dma_cookie_t cookie,
+				      struct dma_tx_state *state)
+{
+	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
+	struct virt_dma_desc *vd;
+	struct xdma_desc *desc;
+	enum dma_status ret;
+	unsigned long flags;
+
+	ret = dma_cookie_status(chan, cookie, state);
+	if (ret == DMA_COMPLETE)
+		return ret;
+
+	spin_lock_irqsave(&xdma_chan->vchan.lock, flags);
+
+	vd = vchan_find_desc(&xdma_chan->vchan, cookie);
+	if (!vd)
+		goto out;
+
+	desc = to_xdma_desc(vd);
+	if (desc->error) {
+		ret = DMA_ERROR;
+	} else if (desc->cyclic) {
+		dma_set_residue(state, (desc->periods - desc->period_idx) *
+				desc->period_size);
+	}
+
+out:
+	spin_unlock_irqrestore(&xdma_chan->vchan.lock, flags);
+
+	return ret;
+}
+
 /**
  * xdma_free_chan_resources - Free channel resources
  * @chan: DMA channel
@@ -543,10 +1029,27 @@ static int xdma_device_config(struct dma_chan *chan,
 static void xdma_free_chan_resources(struct dma_chan *chan)
 {
 	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
+	struct xdma_device *xdev = xdma_chan->xdev_hdl;
 
+	/*
+	 * The vchan tasklet frees completed requests into desc_pool, kill it
+	 * and release everything still queued before destroying the pool.
+	 */
+	vchan_synchronize(&xdma_chan->vchan);
 	vchan_free_chan_resources(&xdma_chan->vchan);
+	xdma_drain_desc_cache(xdma_chan);
 	dma_pool_destroy(xdma_chan->desc_pool);
 	xdma_chan->desc_pool = NULL;
+
+	if (xdma_chan->wb) {
+		regmap_write(xdev->rmap, xdma_chan->base + XDMA_CHAN_POLL_WB_LO,
+			     0);
+		regmap_write(xdev->rmap, xdma_chan->base + XDMA_CHAN_POLL_WB_HI,
+			     0);
+		dma_free_coherent(xdma_pci_dev(xdev), XDMA_WB_SIZE,
+				  xdma_chan->wb, xdma_chan->wb_dma);
+		xdma_chan->wb = NULL;
+	}
 }
 
 /**
@@ -557,10 +1060,9 @@ static int xdma_alloc_chan_resources(struct dma_chan *chan)
 {
 	struct xdma_chan *xdma_chan = to_xdma_chan(chan);
 	struct xdma_device *xdev = xdma_chan->xdev_hdl;
-	struct device *dev = xdev->dma_dev.dev;
+	struct device *dev = xdma_pci_dev(xdev);
+	int ret;
 
-	while (dev && !dev_is_pci(dev))
-		dev = dev->parent;
 	if (!dev) {
 		xdma_err(xdev, "unable to find pci device");
 		return -EINVAL;
@@ -574,6 +1076,56 @@ static int xdma_alloc_chan_resources(struct dma_chan *chan)
 		return -ENOMEM;
 	}
 
+	/*
+	 * Have the engine write its completed descriptor count to host
+	 * memory so the interrupt handler does not read it over MMIO. Fall
+	 * back to the register if the write-back word cannot be allocated.
+	 */
+	xdma_chan->wb = dma_alloc_coherent(dev, XDMA_WB_SIZE,
+					   &xdma_chan->wb_dma, GFP_KERNEL);
+	if (!xdma_chan->wb)
+		return 0;
+
+	ret = regmap_write(xdev->rmap, xdma_chan->base + XDMA_CHAN_POLL_WB_LO,
+			   lower_32_bits(xdma_chan->wb_dma));
+	if (!ret)
+		ret = regmap_write(xdev->rmap,
+				   xdma_chan->base + XDMA_CHAN_POLL_WB_HI,
+				   upper_32_bits(xdma_chan->wb_dma));
+	if (ret) {
+		dma_free_coherent(dev, XDMA_WB_SIZE, xdma_chan->wb,
+				  xdma_chan->wb_dma);
+		xdma_chan->wb = NULL;
+	}
+
+	return 0;
+}
+
+/**
+ * xdma_read_completed - Read the completed descriptor count of a channel
+ * @xchan: DMA channel pointer
+ * @complete_desc_num: Returned completed descriptor count
+ */
+static int xdma_read_completed(struct xdma_chan *xchan, u32 *complete_desc_num)
+{
+	struct xdma_device *xdev = xchan->xdev_hdl;
+	u32 wb;
+	int ret;
+
+	if (!xchan->wb) {
+		ret = regmap_read(xdev->rmap,
+				  xchan->base + XDMA_CHAN_COMPLETED_DESC,
+				  complete_desc_num);
+		*complete_desc_num &= XDMA_CHAN_COMPLETED_DESC_MASK;
+		return ret;
+	}
+
+	/* the write-back lands before the MSI-X message that got us here */
+	wb = le32_to_cpu(READ_ONCE(*xchan->wb));
+	if (wb & XDMA_WB_ERROR)
+		return -EIO;
+
+	*complete_desc_num = wb & XDMA_WB_COUNT_MASK;
 	return 0;
 }
 
@@ -589,6 +1141,7 @@ static irqreturn_t xdma_channel_isr(int irq, void *dev_id)
 	struct xdma_device *xdev;
 	struct virt_dma_desc *vd;
 	struct xdma_desc *desc;
+	u32 st, delta;
 	int ret;
 
 	spin_lock(&xchan->vchan.lock);
@@ -598,20 +1151,46 @@ static irqreturn_t xdma_channel_isr(int irq, void *dev_id)
 	if (!vd)
 		goto out;
 
-	xchan->busy = false;
 	desc = to_xdma_desc(vd);
 	xdev = xchan->xdev_hdl;
 
-	ret = regmap_read(xdev->rmap, xchan->base + XDMA_CHAN_COMPLETED_DESC,
-			  &complete_desc_num);
-	if (ret)
+	ret = xdma_read_completed(xchan, &complete_desc_num);
+	if (ret) {
+		desc->error = true;
+		xchan->busy = false;
+		goto out;
+	}
+	trace_xilinx_dma_irq(&xchan->vchan.chan, complete_desc_num);
+
+	/*
+	 * cyclic transfers keep the engine running, clear the status so the
+	 * next period raises a new interrupt and report the period
+	 */
+	if (desc->cyclic) {
+		ret = regmap_read(xdev->rmap,
+				  xchan->base + XDMA_CHAN_STATUS_RC, &st);
+		if (ret)
+			goto out;
+
+		/* the 24-bit count wraps, only its progress is meaningful */
+		delta = (complete_desc_num - desc->completed_desc_num) &
+			XDMA_CHAN_COMPLETED_DESC_MASK;
+		desc->completed_desc_num = complete_desc_num;
+		desc->period_idx = (desc->period_idx + delta % desc->periods) %
+				   desc->periods;
+		vchan_cyclic_callback(vd);
 		goto out;
+	}
+
+	xchan->busy = false;
 
 	desc->completed_desc_num += complete_desc_num;
 	/*
 	 * if all data blocks are transferred, remove and complete the request
 	 */
 	if (desc->completed_desc_num == desc->desc_num) {
+		trace_xilinx_dma_complete(&xchan->vchan.chan, vd->tx.cookie,
+					  desc->len, DMA_TRANS_NOERROR);
 		list_del(&vd->node);
 		vchan_cookie_complete(vd);
 		goto out;
@@ -629,6 +1208,53 @@ static irqreturn_t xdma_channel_isr(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/**
+ * xdma_free_chan_irq - Free the IRQ of a channel
+ * @xchan: DMA channel pointer
+ */
+static void xdma_free_chan_irq(struct xdma_chan *xchan)
+{
+	irq_update_affinity_hint(xchan->irq, NULL);
+	free_irq(xchan->irq, xchan);
+}
+
+/**
+ * xdma_request_chan_irq - Request the IRQ of a channel
+ * @xdev: DMA device pointer
+ * @xchan: DMA channel pointer
+ * @irq: IRQ number
+ * @index: Index of the channel in its direction
+ *
+ * Every channel has its own vector, named after the channel so it can be
+ * told apart in /proc/interrupts and pinned next to its consumer. The
+ * vectors are initially spread over the CPUs local to the PCIe device.
+ */
+static int xdma_request_chan_irq(struct xdma_device *xdev,
+				 struct xdma_chan *xchan, u32 irq, int index)
+{
+	struct device *dev = xdma_pci_dev(xdev);
+	const char *name;
+	unsigned int cpu;
+	int ret;
+
+	name = devm_kasprintf(&xdev->pdev->dev, GFP_KERNEL, "xdma-%s-chan%d",
+			      xchan->dir == DMA_MEM_TO_DEV ? "h2c" : "c2h",
+			      index);
+	if (!name)
+		return -ENOMEM;
+
+	ret = request_irq(irq, xdma_channel_isr, 0, name, xchan);
+	if (ret)
+		return ret;
+
+	xchan->irq = irq;
+	cpu = cpumask_local_spread(irq - xdev->irq_start,
+				   dev ? dev_to_node(dev) : NUMA_NO_NODE);
+	irq_update_affinity_hint(irq, cpumask_of(cpu));
+
+	return 0;
+}
+
 /**
  * xdma_irq_fini - Uninitialize IRQ
  * @xdev: DMA device pointer
@@ -642,10 +1268,10 @@ static void xdma_irq_fini(struct xdma_device *xdev)
 
 	/* free irq handler */
 	for (i = 0; i < xdev->h2c_chan_num; i++)
-		free_irq(xdev->h2c_chans[i].irq, &xdev->h2c_chans[i]);
+		xdma_free_chan_irq(&xdev->h2c_chans[i]);
 
 	for (i = 0; i < xdev->c2h_chan_num; i++)
-		free_irq(xdev->c2h_chans[i].irq, &xdev->c2h_chans[i]);
+		xdma_free_chan_irq(&xdev->c2h_chans[i]);
 }
 
 /**
@@ -701,27 +1327,23 @@ static int xdma_irq_init(struct xdma_device *xdev)
 
 	/* setup H2C interrupt handler */
 	for (i = 0; i < xdev->h2c_chan_num; i++) {
-		ret = request_irq(irq, xdma_channel_isr, 0,
-				  "xdma-h2c-channel", &xdev->h2c_chans[i]);
+		ret = xdma_request_chan_irq(xdev, &xdev->h2c_chans[i], irq, i);
 		if (ret) {
 			xdma_err(xdev, "H2C channel%d request irq%d failed: %d",
 				 i, irq, ret);
 			goto failed_init_h2c;
 		}
-		xdev->h2c_chans[i].irq = irq;
 		irq++;
 	}
 
 	/* setup C2H interrupt handler */
 	for (j = 0; j < xdev->c2h_chan_num; j++) {
-		ret = request_irq(irq, xdma_channel_isr, 0,
-				  "xdma-c2h-channel", &xdev->c2h_chans[j]);
+		ret = xdma_request_chan_irq(xdev, &xdev->c2h_chans[j], irq, j);
 		if (ret) {
 			xdma_err(xdev, "C2H channel%d request irq%d failed: %d",
 				 j, irq, ret);
 			goto failed_init_c2h;
 		}
-		xdev->c2h_chans[j].irq = irq;
 		irq++;
 	}
 
@@ -754,10 +1376,10 @@ static int xdma_irq_init(struct xdma_device *xdev)
 
 failed_init_c2h:
 	while (j--)
-		free_irq(xdev->c2h_chans[j].irq, &xdev->c2h_chans[j]);
+		xdma_free_chan_irq(&xdev->c2h_chans[j]);
 failed_init_h2c:
 	while (i--)
-		free_irq(xdev->h2c_chans[i].irq, &xdev->h2c_chans[i]);
+		xdma_free_chan_irq(&xdev->h2c_chans[i]);
 
 	return ret;
 }
@@ -921,13 +1543,19 @@ static int xdma_probe(struct platform_device *pdev)
 
 	dma_cap_set(DMA_SLAVE, xdev->dma_dev.cap_mask);
 	dma_cap_set(DMA_PRIVATE, xdev->dma_dev.cap_mask);
+	dma_cap_set(DMA_CYCLIC, xdev->dma_dev.cap_mask);
+	dma_cap_set(DMA_INTERLEAVE, xdev->dma_dev.cap_mask);
 
 	xdev->dma_dev.dev = &pdev->dev;
 	xdev->dma_dev.device_free_chan_resources = xdma_free_chan_resources;
 	xdev->dma_dev.device_alloc_chan_resources = xdma_alloc_chan_resources;
-	xdev->dma_dev.device_tx_status = dma_cookie_status;
+	xdev->dma_dev.device_tx_status = xdma_tx_status;
 	xdev->dma_dev.device_prep_slave_sg = xdma_prep_device_sg;
+	xdev->dma_dev.device_prep_dma_cyclic = xdma_prep_dma_cyclic;
+	xdev->dma_dev.device_prep_interleaved_dma = xdma_prep_interleaved_dma;
 	xdev->dma_dev.device_config = xdma_device_config;
+	xdev->dma_dev.device_terminate_all = xdma_terminate_all;
+	xdev->dma_dev.device_synchronize = xdma_synchronize;
 	xdev->dma_dev.device_issue_pending = xdma_issue_pending;
 	xdev->dma_dev.filter.map = pdata->device_map;
 	xdev->dma_dev.filter.mapcnt = pdata->device_map_cnt;
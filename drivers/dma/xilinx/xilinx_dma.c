@@ -33,21 +33,29 @@
  *
  */
 
+#include <linux/bitfield.h>
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/dim.h>
 #include <linux/dmapool.h>
 #include <linux/dma/xilinx_dma.h>
+#include <linux/dma/xilinx_dma_slave.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/iopoll.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_dma.h>
 #include <linux/of_irq.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/clk.h>
 #include <linux/io-64-nonatomic-lo-hi.h>
+#include <trace/events/xilinx_dma.h>
 
 #include "../dmaengine.h"
 
@@ -98,6 +106,7 @@
 #define XILINX_DMA_DMASR_FRAME_COUNT_MASK	GENMASK(23, 16)
 
 #define XILINX_DMA_REG_CURDESC			0x0008
+#define XILINX_DMA_REG_CURDESC_MSB		0x000c
 #define XILINX_DMA_REG_TAILDESC		0x0010
 #define XILINX_DMA_REG_REG_INDEX		0x0014
 #define XILINX_DMA_REG_FRMSTORE		0x0018
@@ -109,6 +118,9 @@
 #define XILINX_DMA_PARK_PTR_RD_REF_SHIFT	0
 #define XILINX_DMA_PARK_PTR_RD_REF_MASK		GENMASK(4, 0)
 #define XILINX_DMA_REG_VDMA_VERSION		0x002c
+#define XILINX_DMA_REG_SG_CTL			0x002c
+#define XILINX_DMA_SG_CTL_CACHE_MASK		GENMASK(3, 0)
+#define XILINX_DMA_SG_CTL_USER_MASK		GENMASK(11, 8)
 
 /* Register Direct Mode Registers */
 #define XILINX_DMA_REG_VSIZE			0x0000
@@ -183,6 +195,8 @@
 #define XILINX_DMA_COALESCE_MAX		255
 #define XILINX_DMA_NUM_DESCS		512
 #define XILINX_DMA_NUM_APP_WORDS	5
+#define XILINX_DMA_HIST_BUCKETS		32
+#define XILINX_DMA_POLL_BUDGET		64
 
 /* AXI CDMA Specific Registers/Offsets */
 #define XILINX_CDMA_REG_SRCADDR		0x18
@@ -199,7 +213,12 @@
 #define XILINX_MCDMA_S2MM_CTRL_OFFSET		0x0500
 #define XILINX_MCDMA_CHEN_OFFSET		0x0008
 #define XILINX_MCDMA_CH_ERR_OFFSET		0x0010
+#define XILINX_MCDMA_WRR_OFFSET(x)		(0x18 + ((x) / 8) * 4)
 #define XILINX_MCDMA_RXINT_SER_OFFSET		0x0020
+#define XILINX_MCDMA_AWCACHE_OFFSET		0x001c
+#define XILINX_MCDMA_ARCACHE_OFFSET		0x0024
+#define XILINX_MCDMA_AXCACHE_MASK		GENMASK(3, 0)
+#define XILINX_MCDMA_AXUSER_MASK		GENMASK(11, 8)
 #define XILINX_MCDMA_TXINT_SER_OFFSET		0x0028
 #define XILINX_MCDMA_CHAN_CR_OFFSET(x)		(0x40 + (x) * 0x40)
 #define XILINX_MCDMA_CHAN_SR_OFFSET(x)		(0x44 + (x) * 0x40)
@@ -211,12 +230,21 @@
 #define XILINX_MCDMA_COALESCE_MAX		24
 #define XILINX_MCDMA_IRQ_ALL_MASK		GENMASK(7, 5)
 #define XILINX_MCDMA_COALESCE_MASK		GENMASK(23, 16)
+#define XILINX_MCDMA_DELAY_SHIFT		24
+#define XILINX_MCDMA_DELAY_MASK			GENMASK(31, 24)
 #define XILINX_MCDMA_CR_RUNSTOP_MASK		BIT(0)
 #define XILINX_MCDMA_IRQ_IOC_MASK		BIT(5)
 #define XILINX_MCDMA_IRQ_DELAY_MASK		BIT(6)
 #define XILINX_MCDMA_IRQ_ERR_MASK		BIT(7)
 #define XILINX_MCDMA_BD_EOP			BIT(30)
 #define XILINX_MCDMA_BD_SOP			BIT(31)
+#define XILINX_MCDMA_BD_COMP_MASK		BIT(31)
+#define XILINX_MCDMA_WRR_SHIFT(x)		(((x) % 8) * 4)
+#define XILINX_MCDMA_WRR_MASK			GENMASK(3, 0)
+#define XILINX_MCDMA_WRR_MAX			15
+
+/* Pending descriptors beyond which a WRR channel counts as backed up */
+#define XILINX_MCDMA_WRR_BACKLOG		8
 
 /**
  * struct xilinx_vdma_desc_hw - Hardware Descriptor
@@ -365,6 +393,8 @@ struct xilinx_cdma_tx_segment {
  * @cyclic: Check for cyclic transfers.
  * @err: Whether the descriptor has an error.
  * @residue: Residue of the completed descriptor
+ * @len: Number of bytes programmed into the descriptor segments
+ * @submit_time: Time the descriptor was submitted
  */
 struct xilinx_dma_tx_descriptor {
 	struct dma_async_tx_descriptor async_tx;
@@ -373,6 +403,36 @@ struct xilinx_dma_tx_descriptor {
 	bool cyclic;
 	bool err;
 	u32 residue;
+	size_t len;
+	ktime_t submit_time;
+};
+
+/**
+ * struct xilinx_dma_dim_profile - Interrupt moderation profile
+ * @coalesce: Interrupt threshold, in completed descriptors
+ * @delay: Delay timer timeout, in delay timer resolution ticks
+ */
+struct xilinx_dma_dim_profile {
+	u8 coalesce;
+	u8 delay;
+};
+
+/**
+ * struct xilinx_dma_chan_stats - Per-channel completion statistics
+ * @irqs: Number of completion interrupts
+ * @ring_full: Number of segment allocations failed on a full BD ring
+ * @latency: log2 histogram of submit to complete latency, in ns
+ * @callback: log2 histogram of interrupt to first callback latency, in ns
+ * @batch: log2 histogram of descriptors completed per reaping pass
+ *
+ * Bucket 0 counts zero values, bucket n values in [2^(n-1), 2^n).
+ */
+struct xilinx_dma_chan_stats {
+	u64 irqs;
+	u64 ring_full;
+	u64 latency[XILINX_DMA_HIST_BUCKETS];
+	u64 callback[XILINX_DMA_HIST_BUCKETS];
+	u64 batch[XILINX_DMA_HIST_BUCKETS];
 };
 
 /**
@@ -409,6 +469,26 @@ struct xilinx_dma_tx_descriptor {
  * @seg_p: Physical allocated segments base
  * @cyclic_seg_v: Statically allocated segment base for cyclic transfers
  * @cyclic_seg_p: Physical allocated segments base for cyclic dma
+ * @num_descs: Number of segments in the coherent BD ring
+ * @max_descs: Upper bound on BD ring growth, 0 for no limit
+ * @nr_descs: Number of BD segments currently owned by the channel
+ * @ring_resizing: The BD ring is being reallocated, no segment may be taken
+ * @polled: Completions are reaped by a budgeted poll loop
+ * @irq_masked: Completion interrupts are masked while polling
+ * @use_dim: Interrupt coalescing is tuned by lib/dim
+ * @streaming: New BDs are hot-appended to a running SG chain
+ * @dim: Dynamic interrupt moderation state
+ * @dim_coalesce: Interrupt threshold selected by @dim
+ * @dim_delay: Delay timer timeout selected by @dim
+ * @irq_events: Number of completion interrupts handled
+ * @completed_descs: Number of descriptors completed
+ * @completed_bytes: Number of bytes transferred by completed descriptors
+ * @irq_time: Time of the last completion interrupt, 0 once reported
+ * @wrr_weight: MCDMA MM2S scheduler weight from the channel policy, 0 if
+ *		the channel is not software scheduled
+ * @wrr_active: MCDMA MM2S scheduler weight currently programmed
+ * @priority: XILINX_DMA_PRIO_* class of the channel
+ * @stats: Completion statistics
  * @start_transfer: Differentiate b/w DMA IP's transfer
  * @stop_transfer: Differentiate b/w DMA IP's quiesce
  * @tdest: TDEST value for mcdma
@@ -448,6 +528,25 @@ struct xilinx_dma_chan {
 	dma_addr_t seg_p;
 	struct xilinx_axidma_tx_segment *cyclic_seg_v;
 	dma_addr_t cyclic_seg_p;
+	u32 num_descs;
+	u32 max_descs;
+	u32 nr_descs;
+	bool ring_resizing;
+	bool polled;
+	bool irq_masked;
+	bool use_dim;
+	bool streaming;
+	struct dim dim;
+	u8 dim_coalesce;
+	u8 dim_delay;
+	u16 irq_events;
+	u64 completed_descs;
+	u64 completed_bytes;
+	ktime_t irq_time;
+	u8 wrr_weight;
+	u8 wrr_active;
+	u8 priority;
+	struct xilinx_dma_chan_stats stats;
 	void (*start_transfer)(struct xilinx_dma_chan *chan);
 	int (*stop_transfer)(struct xilinx_dma_chan *chan);
 	u16 tdest;
@@ -499,6 +598,7 @@ struct xilinx_dma_config {
  * @mm2s_chan_id: DMA mm2s channel identifier
  * @max_buffer_len: Max buffer length
  * @has_axistream_connected: AXI DMA connected to AXI Stream IP
+ * @wrr_lock: Serializes updates of the shared MCDMA WRR weight registers
  */
 struct xilinx_dma_device {
 	void __iomem *regs;
@@ -518,6 +618,7 @@ struct xilinx_dma_device {
 	u32 mm2s_chan_id;
 	u32 max_buffer_len;
 	bool has_axistream_connected;
+	spinlock_t wrr_lock;
 };
 
 /* Macros */
@@ -630,6 +731,19 @@ static inline void xilinx_aximcdma_buf(struct xilinx_dma_chan *chan,
 	}
 }
 
+/*
+ * Moderation profiles walked by net_dim(), from lowest latency to lowest
+ * interrupt rate. Every profile that coalesces more than one descriptor
+ * arms the delay timer, so a partial batch still raises an interrupt.
+ */
+static const struct xilinx_dma_dim_profile xilinx_dma_dim_profiles[] = {
+	{ .coalesce = 1, .delay = 0 },
+	{ .coalesce = 4, .delay = 2 },
+	{ .coalesce = 16, .delay = 4 },
+	{ .coalesce = 64, .delay = 8 },
+	{ .coalesce = 255, .delay = 16 },
+};
+
 /**
  * xilinx_dma_get_metadata_ptr- Populate metadata pointer and payload length
  * @tx: async transaction descriptor
@@ -699,10 +813,27 @@ xilinx_cdma_alloc_tx_segment(struct xilinx_dma_chan *chan)
 	return segment;
 }
 
+/**
+ * xilinx_dma_can_grow - Check whether the BD ring may grow by one segment
+ * @chan: Driver specific DMA channel
+ *
+ * This function was invoked with lock held.
+ *
+ * Return: true if a segment may be allocated from the descriptor pool.
+ */
+static bool xilinx_dma_can_grow(struct xilinx_dma_chan *chan)
+{
+	return chan->desc_pool && !chan->ring_resizing &&
+	       (!chan->max_descs || chan->nr_descs < chan->max_descs);
+}
+
 /**
  * xilinx_axidma_alloc_tx_segment - Allocate transaction segment
  * @chan: Driver specific DMA channel
  *
+ * Segments are taken from the free list first. Once the BD ring is
+ * exhausted it grows on demand from the channel descriptor pool.
+ *
  * Return: The allocated segment on success and NULL on failure.
  */
 static struct xilinx_axidma_tx_segment *
@@ -710,14 +841,23 @@ xilinx_axidma_alloc_tx_segment(struct xilinx_dma_chan *chan)
 {
 	struct xilinx_axidma_tx_segment *segment = NULL;
 	unsigned long flags;
+	dma_addr_t phys;
 
 	spin_lock_irqsave(&chan->lock, flags);
-	if (!list_empty(&chan->free_seg_list)) {
+	if (!chan->ring_resizing && !list_empty(&chan->free_seg_list)) {
 		segment = list_first_entry(&chan->free_seg_list,
 					   struct xilinx_axidma_tx_segment,
 					   node);
 		list_del(&segment->node);
+	} else if (xilinx_dma_can_grow(chan)) {
+		segment = dma_pool_zalloc(chan->desc_pool, GFP_ATOMIC, &phys);
+		if (segment) {
+			segment->phys = phys;
+			chan->nr_descs++;
+		}
 	}
+	if (!segment)
+		chan->stats.ring_full++;
 	spin_unlock_irqrestore(&chan->lock, flags);
 
 	if (!segment)
@@ -730,6 +870,9 @@ xilinx_axidma_alloc_tx_segment(struct xilinx_dma_chan *chan)
  * xilinx_aximcdma_alloc_tx_segment - Allocate transaction segment
  * @chan: Driver specific DMA channel
  *
+ * Segments are taken from the free list first. Once the BD ring is
+ * exhausted it grows on demand from the channel descriptor pool.
+ *
  * Return: The allocated segment on success and NULL on failure.
  */
 static struct xilinx_aximcdma_tx_segment *
@@ -737,14 +880,23 @@ xilinx_aximcdma_alloc_tx_segment(struct xilinx_dma_chan *chan)
 {
 	struct xilinx_aximcdma_tx_segment *segment = NULL;
 	unsigned long flags;
+	dma_addr_t phys;
 
 	spin_lock_irqsave(&chan->lock, flags);
-	if (!list_empty(&chan->free_seg_list)) {
+	if (!chan->ring_resizing && !list_empty(&chan->free_seg_list)) {
 		segment = list_first_entry(&chan->free_seg_list,
 					   struct xilinx_aximcdma_tx_segment,
 					   node);
 		list_del(&segment->node);
+	} else if (xilinx_dma_can_grow(chan)) {
+		segment = dma_pool_zalloc(chan->desc_pool, GFP_ATOMIC, &phys);
+		if (segment) {
+			segment->phys = phys;
+			chan->nr_descs++;
+		}
 	}
+	if (!segment)
+		chan->stats.ring_full++;
 	spin_unlock_irqrestore(&chan->lock, flags);
 
 	return segment;
@@ -922,50 +1074,218 @@ static void xilinx_dma_free_descriptors(struct xilinx_dma_chan *chan)
 }
 
 /**
- * xilinx_dma_free_chan_resources - Free channel resources
- * @dchan: DMA channel
+ * xilinx_dma_seg_in_ring - Check whether a segment belongs to the BD ring
+ * @chan: Driver specific DMA channel
+ * @phys: Physical address of the segment
+ * @size: Size of one BD ring segment
+ *
+ * Return: true if @phys lies in the coherent BD ring, false if the segment
+ * was grown from the descriptor pool.
  */
-static void xilinx_dma_free_chan_resources(struct dma_chan *dchan)
+static bool xilinx_dma_seg_in_ring(struct xilinx_dma_chan *chan,
+				   dma_addr_t phys, size_t size)
+{
+	if (!chan->seg_v && !chan->seg_mv)
+		return false;
+
+	return phys >= chan->seg_p &&
+	       phys < chan->seg_p + size * chan->num_descs;
+}
+
+/**
+ * xilinx_dma_alloc_bd_ring - Allocate the coherent BD ring of a channel
+ * @chan: Driver specific DMA channel
+ *
+ * Allocates chan->num_descs linked segments for AXI DMA or MCDMA and puts
+ * them on the free segment list.
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int xilinx_dma_alloc_bd_ring(struct xilinx_dma_chan *chan)
 {
-	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
 	unsigned long flags;
+	LIST_HEAD(segs);
+	u32 i, n = chan->num_descs;
 
-	dev_dbg(chan->dev, "Free all channel resources.\n");
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA) {
+		chan->seg_v = dma_alloc_coherent(chan->dev,
+						 sizeof(*chan->seg_v) * n,
+						 &chan->seg_p, GFP_KERNEL);
+		if (!chan->seg_v)
+			return -ENOMEM;
 
-	xilinx_dma_free_descriptors(chan);
+		for (i = 0; i < n; i++) {
+			chan->seg_v[i].hw.next_desc =
+			lower_32_bits(chan->seg_p + sizeof(*chan->seg_v) *
+				((i + 1) % n));
+			chan->seg_v[i].hw.next_desc_msb =
+			upper_32_bits(chan->seg_p + sizeof(*chan->seg_v) *
+				((i + 1) % n));
+			chan->seg_v[i].phys = chan->seg_p +
+				sizeof(*chan->seg_v) * i;
+			list_add_tail(&chan->seg_v[i].node, &segs);
+		}
+	} else {
+		chan->seg_mv = dma_alloc_coherent(chan->dev,
+						  sizeof(*chan->seg_mv) * n,
+						  &chan->seg_p, GFP_KERNEL);
+		if (!chan->seg_mv)
+			return -ENOMEM;
+
+		for (i = 0; i < n; i++) {
+			chan->seg_mv[i].hw.next_desc =
+			lower_32_bits(chan->seg_p + sizeof(*chan->seg_mv) *
+				((i + 1) % n));
+			chan->seg_mv[i].hw.next_desc_msb =
+			upper_32_bits(chan->seg_p + sizeof(*chan->seg_mv) *
+				((i + 1) % n));
+			chan->seg_mv[i].phys = chan->seg_p +
+				sizeof(*chan->seg_mv) * i;
+			list_add_tail(&chan->seg_mv[i].node, &segs);
+		}
+	}
+
+	spin_lock_irqsave(&chan->lock, flags);
+	list_splice_tail(&segs, &chan->free_seg_list);
+	chan->nr_descs = n;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return 0;
+}
+
+/**
+ * xilinx_dma_free_bd_ring - Free the BD ring and all grown segments
+ * @chan: Driver specific DMA channel
+ *
+ * All segments must have been returned to the free segment list.
+ */
+static void xilinx_dma_free_bd_ring(struct xilinx_dma_chan *chan)
+{
+	unsigned long flags;
+	LIST_HEAD(segs);
+
+	spin_lock_irqsave(&chan->lock, flags);
+	list_splice_init(&chan->free_seg_list, &segs);
+	chan->nr_descs = 0;
+	spin_unlock_irqrestore(&chan->lock, flags);
 
 	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA) {
-		spin_lock_irqsave(&chan->lock, flags);
-		INIT_LIST_HEAD(&chan->free_seg_list);
-		spin_unlock_irqrestore(&chan->lock, flags);
+		struct xilinx_axidma_tx_segment *seg, *next;
+
+		list_for_each_entry_safe(seg, next, &segs, node) {
+			if (!xilinx_dma_seg_in_ring(chan, seg->phys,
+						    sizeof(*seg)))
+				dma_pool_free(chan->desc_pool, seg, seg->phys);
+		}
 
 		/* Free memory that is allocated for BD */
-		dma_free_coherent(chan->dev, sizeof(*chan->seg_v) *
-				  XILINX_DMA_NUM_DESCS, chan->seg_v,
-				  chan->seg_p);
+		if (chan->seg_v)
+			dma_free_coherent(chan->dev, sizeof(*chan->seg_v) *
+					  chan->num_descs, chan->seg_v,
+					  chan->seg_p);
+		chan->seg_v = NULL;
+	} else {
+		struct xilinx_aximcdma_tx_segment *seg, *next;
 
-		/* Free Memory that is allocated for cyclic DMA Mode */
-		dma_free_coherent(chan->dev, sizeof(*chan->cyclic_seg_v),
-				  chan->cyclic_seg_v, chan->cyclic_seg_p);
+		list_for_each_entry_safe(seg, next, &segs, node) {
+			if (!xilinx_dma_seg_in_ring(chan, seg->phys,
+						    sizeof(*seg)))
+				dma_pool_free(chan->desc_pool, seg, seg->phys);
+		}
+
+		/* Free memory that is allocated for BD */
+		if (chan->seg_mv)
+			dma_free_coherent(chan->dev, sizeof(*chan->seg_mv) *
+					  chan->num_descs, chan->seg_mv,
+					  chan->seg_p);
+		chan->seg_mv = NULL;
 	}
+}
 
-	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA) {
-		spin_lock_irqsave(&chan->lock, flags);
-		INIT_LIST_HEAD(&chan->free_seg_list);
-		spin_unlock_irqrestore(&chan->lock, flags);
+/**
+ * xilinx_dma_resize_bd_ring - Change the depth of the coherent BD ring
+ * @chan: Driver specific DMA channel
+ * @num_descs: New number of segments in the BD ring
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int xilinx_dma_resize_bd_ring(struct xilinx_dma_chan *chan,
+				     u32 num_descs)
+{
+	unsigned long flags;
+	bool busy;
+	int err;
 
-		/* Free memory that is allocated for BD */
-		dma_free_coherent(chan->dev, sizeof(*chan->seg_mv) *
-				  XILINX_DMA_NUM_DESCS, chan->seg_mv,
-				  chan->seg_p);
+	if (num_descs == chan->num_descs)
+		return 0;
+
+	/*
+	 * Keep the prep callbacks off the ring from the busy check until the
+	 * new ring is in place, they would take segments from the old one.
+	 */
+	spin_lock_irqsave(&chan->lock, flags);
+	busy = chan->ring_resizing || chan->cyclic ||
+	       !list_empty(&chan->pending_list) ||
+	       !list_empty(&chan->active_list) ||
+	       !list_empty(&chan->done_list) ||
+	       list_count_nodes(&chan->free_seg_list) != chan->nr_descs;
+	if (!busy)
+		chan->ring_resizing = true;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	if (busy)
+		return -EBUSY;
+
+	/* Resources not allocated yet, the new depth is used on allocation */
+	if (!chan->desc_pool) {
+		chan->num_descs = num_descs;
+		err = 0;
+		goto out;
 	}
 
-	if (chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIDMA &&
-	    chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIMCDMA) {
-		dma_pool_destroy(chan->desc_pool);
-		chan->desc_pool = NULL;
+	xilinx_dma_free_bd_ring(chan);
+	chan->num_descs = num_descs;
+
+	err = xilinx_dma_alloc_bd_ring(chan);
+	if (err)
+		dev_err(chan->dev,
+			"unable to allocate channel %d descriptors\n",
+			chan->id);
+
+out:
+	spin_lock_irqsave(&chan->lock, flags);
+	chan->ring_resizing = false;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return err;
+}
+
+/**
+ * xilinx_dma_free_chan_resources - Free channel resources
+ * @dchan: DMA channel
+ */
+static void xilinx_dma_free_chan_resources(struct dma_chan *dchan)
+{
+	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
+
+	dev_dbg(chan->dev, "Free all channel resources.\n");
+
+	xilinx_dma_free_descriptors(chan);
+
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA ||
+	    chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA)
+		xilinx_dma_free_bd_ring(chan);
+
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA &&
+	    chan->cyclic_seg_v) {
+		/* Free Memory that is allocated for cyclic DMA Mode */
+		dma_free_coherent(chan->dev, sizeof(*chan->cyclic_seg_v),
+				  chan->cyclic_seg_v, chan->cyclic_seg_p);
+		chan->cyclic_seg_v = NULL;
 	}
 
+	dma_pool_destroy(chan->desc_pool);
+	chan->desc_pool = NULL;
 }
 
 /**
@@ -1018,26 +1338,79 @@ static u32 xilinx_dma_get_residue(struct xilinx_dma_chan *chan,
 	return residue;
 }
 
+/**
+ * xilinx_dma_cyclic_residue - Residue of a running cyclic transfer
+ * @chan: Driver specific dma channel
+ * @desc: dma transaction descriptor
+ *
+ * Cyclic BDs are not written back by the hardware, so the position is taken
+ * from the BD the engine is working on. That BD counts as not transferred.
+ *
+ * Return: The number of bytes left until the end of the cyclic buffer.
+ */
+static u32 xilinx_dma_cyclic_residue(struct xilinx_dma_chan *chan,
+				     struct xilinx_dma_tx_descriptor *desc)
+{
+	struct xilinx_axidma_tx_segment *segment;
+	bool found = false;
+	u32 residue = 0;
+	dma_addr_t cur;
+
+	cur = dma_ctrl_read(chan, XILINX_DMA_REG_CURDESC);
+	if (chan->ext_addr)
+		cur |= (u64)dma_ctrl_read(chan, XILINX_DMA_REG_CURDESC_MSB) << 32;
+
+	list_for_each_entry(segment, &desc->segments, node) {
+		if (segment->phys == cur)
+			found = true;
+		if (found)
+			residue += segment->hw.control &
+				   chan->xdev->max_buffer_len;
+	}
+
+	return residue;
+}
+
 /**
  * xilinx_dma_chan_handle_cyclic - Cyclic dma callback
  * @chan: Driver specific dma channel
  * @desc: dma transaction descriptor
  * @flags: flags for spin lock
+ *
+ * Several periods may elapse between two callbacks, the residue passed to
+ * callback_result users tells where the engine is in the buffer.
  */
 static void xilinx_dma_chan_handle_cyclic(struct xilinx_dma_chan *chan,
 					  struct xilinx_dma_tx_descriptor *desc,
 					  unsigned long *flags)
 {
+	struct dmaengine_result result = {
+		.result = DMA_TRANS_NOERROR,
+	};
 	struct dmaengine_desc_callback cb;
 
 	dmaengine_desc_get_callback(&desc->async_tx, &cb);
 	if (dmaengine_desc_callback_valid(&cb)) {
+		if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA)
+			result.residue = xilinx_dma_cyclic_residue(chan, desc);
 		spin_unlock_irqrestore(&chan->lock, *flags);
-		dmaengine_desc_callback_invoke(&cb, NULL);
+		dmaengine_desc_callback_invoke(&cb, &result);
 		spin_lock_irqsave(&chan->lock, *flags);
 	}
 }
 
+/**
+ * xilinx_dma_hist_add - Account a value in a log2 histogram
+ * @hist: Histogram of XILINX_DMA_HIST_BUCKETS buckets
+ * @val: Value to account
+ */
+static void xilinx_dma_hist_add(u64 *hist, u64 val)
+{
+	unsigned int bucket = val ? ilog2(val) + 1 : 0;
+
+	hist[min_t(unsigned int, bucket, XILINX_DMA_HIST_BUCKETS - 1)]++;
+}
+
 /**
  * xilinx_dma_chan_desc_cleanup - Clean channel descriptors
  * @chan: Driver specific DMA channel
@@ -1049,6 +1422,13 @@ static void xilinx_dma_chan_desc_cleanup(struct xilinx_dma_chan *chan)
 
 	spin_lock_irqsave(&chan->lock, flags);
 
+	if (chan->irq_time && !list_empty(&chan->done_list)) {
+		xilinx_dma_hist_add(chan->stats.callback,
+				    ktime_to_ns(ktime_sub(ktime_get(),
+						chan->irq_time)));
+		chan->irq_time = 0;
+	}
+
 	list_for_each_entry_safe(desc, next, &chan->done_list, node) {
 		struct dmaengine_result result;
 
@@ -1070,6 +1450,9 @@ static void xilinx_dma_chan_desc_cleanup(struct xilinx_dma_chan *chan)
 		}
 
 		result.residue = desc->residue;
+		trace_xilinx_dma_complete(&chan->common, desc->async_tx.cookie,
+					  desc->len - desc->residue,
+					  result.result);
 
 		/* Run the link descriptor callback function */
 		spin_unlock_irqrestore(&chan->lock, flags);
@@ -1091,17 +1474,6 @@ static void xilinx_dma_chan_desc_cleanup(struct xilinx_dma_chan *chan)
 	spin_unlock_irqrestore(&chan->lock, flags);
 }
 
-/**
- * xilinx_dma_do_tasklet - Schedule completion tasklet
- * @t: Pointer to the Xilinx DMA channel structure
- */
-static void xilinx_dma_do_tasklet(struct tasklet_struct *t)
-{
-	struct xilinx_dma_chan *chan = from_tasklet(chan, t, tasklet);
-
-	xilinx_dma_chan_desc_cleanup(chan);
-}
-
 /**
  * xilinx_dma_alloc_chan_resources - Allocate channel resources
  * @dchan: DMA channel
@@ -1111,7 +1483,6 @@ static void xilinx_dma_do_tasklet(struct tasklet_struct *t)
 static int xilinx_dma_alloc_chan_resources(struct dma_chan *dchan)
 {
 	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
-	int i;
 
 	/* Has this channel already been allocated? */
 	if (chan->desc_pool)
@@ -1123,10 +1494,7 @@ static int xilinx_dma_alloc_chan_resources(struct dma_chan *dchan)
 	 */
 	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA) {
 		/* Allocate the buffer descriptors. */
-		chan->seg_v = dma_alloc_coherent(chan->dev,
-						 sizeof(*chan->seg_v) * XILINX_DMA_NUM_DESCS,
-						 &chan->seg_p, GFP_KERNEL);
-		if (!chan->seg_v) {
+		if (xilinx_dma_alloc_bd_ring(chan)) {
 			dev_err(chan->dev,
 				"unable to allocate channel %d descriptors\n",
 				chan->id);
@@ -1145,49 +1513,32 @@ static int xilinx_dma_alloc_chan_resources(struct dma_chan *dchan)
 		if (!chan->cyclic_seg_v) {
 			dev_err(chan->dev,
 				"unable to allocate desc segment for cyclic DMA\n");
-			dma_free_coherent(chan->dev, sizeof(*chan->seg_v) *
-				XILINX_DMA_NUM_DESCS, chan->seg_v,
-				chan->seg_p);
+			xilinx_dma_free_bd_ring(chan);
 			return -ENOMEM;
 		}
 		chan->cyclic_seg_v->phys = chan->cyclic_seg_p;
 
-		for (i = 0; i < XILINX_DMA_NUM_DESCS; i++) {
-			chan->seg_v[i].hw.next_desc =
-			lower_32_bits(chan->seg_p + sizeof(*chan->seg_v) *
-				((i + 1) % XILINX_DMA_NUM_DESCS));
-			chan->seg_v[i].hw.next_desc_msb =
-			upper_32_bits(chan->seg_p + sizeof(*chan->seg_v) *
-				((i + 1) % XILINX_DMA_NUM_DESCS));
-			chan->seg_v[i].phys = chan->seg_p +
-				sizeof(*chan->seg_v) * i;
-			list_add_tail(&chan->seg_v[i].node,
-				      &chan->free_seg_list);
-		}
+		/* Segments beyond the BD ring are grown from this pool */
+		chan->desc_pool = dma_pool_create("xilinx_axidma_desc_pool",
+				   chan->dev,
+				   sizeof(struct xilinx_axidma_tx_segment),
+				   __alignof__(struct xilinx_axidma_tx_segment),
+				   0);
 	} else if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA) {
 		/* Allocate the buffer descriptors. */
-		chan->seg_mv = dma_alloc_coherent(chan->dev,
-						  sizeof(*chan->seg_mv) *
-						  XILINX_DMA_NUM_DESCS,
-						  &chan->seg_p, GFP_KERNEL);
-		if (!chan->seg_mv) {
+		if (xilinx_dma_alloc_bd_ring(chan)) {
 			dev_err(chan->dev,
 				"unable to allocate channel %d descriptors\n",
 				chan->id);
 			return -ENOMEM;
 		}
-		for (i = 0; i < XILINX_DMA_NUM_DESCS; i++) {
-			chan->seg_mv[i].hw.next_desc =
-			lower_32_bits(chan->seg_p + sizeof(*chan->seg_mv) *
-				((i + 1) % XILINX_DMA_NUM_DESCS));
-			chan->seg_mv[i].hw.next_desc_msb =
-			upper_32_bits(chan->seg_p + sizeof(*chan->seg_mv) *
-				((i + 1) % XILINX_DMA_NUM_DESCS));
-			chan->seg_mv[i].phys = chan->seg_p +
-				sizeof(*chan->seg_mv) * i;
-			list_add_tail(&chan->seg_mv[i].node,
-				      &chan->free_seg_list);
-		}
+
+		/* Segments beyond the BD ring are grown from this pool */
+		chan->desc_pool = dma_pool_create("xilinx_aximcdma_desc_pool",
+				   chan->dev,
+				   sizeof(struct xilinx_aximcdma_tx_segment),
+				   __alignof__(struct xilinx_aximcdma_tx_segment),
+				   0);
 	} else if (chan->xdev->dma_config->dmatype == XDMA_TYPE_CDMA) {
 		chan->desc_pool = dma_pool_create("xilinx_cdma_desc_pool",
 				   chan->dev,
@@ -1202,12 +1553,11 @@ static int xilinx_dma_alloc_chan_resources(struct dma_chan *dchan)
 				     0);
 	}
 
-	if (!chan->desc_pool &&
-	    ((chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIDMA) &&
-		chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIMCDMA)) {
+	if (!chan->desc_pool) {
 		dev_err(chan->dev,
 			"unable to allocate channel %d descriptor pool\n",
 			chan->id);
+		xilinx_dma_free_chan_resources(dchan);
 		return -ENOMEM;
 	}
 
@@ -1353,6 +1703,22 @@ static void xilinx_dma_start(struct xilinx_dma_chan *chan)
 	}
 }
 
+/**
+ * xilinx_dma_trace_start - Trace the pending descriptors handed to hardware
+ * @chan: Driver specific DMA channel
+ */
+static void xilinx_dma_trace_start(struct xilinx_dma_chan *chan)
+{
+	struct xilinx_dma_tx_descriptor *desc;
+
+	if (!trace_xilinx_dma_start_enabled())
+		return;
+
+	list_for_each_entry(desc, &chan->pending_list, node)
+		trace_xilinx_dma_start(&chan->common, desc->async_tx.cookie,
+				       desc->len);
+}
+
 /**
  * xilinx_vdma_start_transfer - Starts VDMA transfer
  * @chan: Driver specific channel struct pointer
@@ -1448,6 +1814,7 @@ static void xilinx_vdma_start_transfer(struct xilinx_dma_chan *chan)
 
 	chan->desc_submitcount++;
 	chan->desc_pendingcount--;
+	trace_xilinx_dma_start(&chan->common, desc->async_tx.cookie, desc->len);
 	list_move_tail(&desc->node, &chan->active_list);
 	if (chan->desc_submitcount == chan->num_frms)
 		chan->desc_submitcount = 0;
@@ -1522,11 +1889,73 @@ static void xilinx_cdma_start_transfer(struct xilinx_dma_chan *chan)
 				hw->control & chan->xdev->max_buffer_len);
 	}
 
+	xilinx_dma_trace_start(chan);
 	list_splice_tail_init(&chan->pending_list, &chan->active_list);
 	chan->desc_pendingcount = 0;
 	chan->idle = false;
 }
 
+/**
+ * xilinx_dma_hot_append - Extend a running SG chain with pending descriptors
+ * @chan: Driver specific channel struct pointer
+ *
+ * The first pending BD is linked behind the last active one and the tail
+ * pointer is moved past the pending list, so the engine runs on without
+ * going idle. This function was invoked with lock held.
+ */
+static void xilinx_dma_hot_append(struct xilinx_dma_chan *chan)
+{
+	struct xilinx_dma_tx_descriptor *head_desc, *tail_desc, *active_desc;
+	struct xilinx_axidma_tx_segment *active_segment, *tail_segment;
+	dma_addr_t cur;
+
+	if (list_empty(&chan->active_list))
+		return;
+
+	active_desc = list_last_entry(&chan->active_list,
+				      struct xilinx_dma_tx_descriptor, node);
+	active_segment = list_last_entry(&active_desc->segments,
+					 struct xilinx_axidma_tx_segment, node);
+	head_desc = list_first_entry(&chan->pending_list,
+				     struct xilinx_dma_tx_descriptor, node);
+
+	if (xilinx_prep_dma_addr_t(active_segment->hw.next_desc) !=
+	    head_desc->async_tx.phys) {
+		active_segment->hw.next_desc =
+			lower_32_bits(head_desc->async_tx.phys);
+		active_segment->hw.next_desc_msb =
+			upper_32_bits(head_desc->async_tx.phys);
+
+		/*
+		 * The engine latches the next pointer when it fetches a BD, and
+		 * CURDESC moves to a BD as it is fetched. If the active tail
+		 * was fetched before the update, the engine would follow the
+		 * stale pointer once TAILDESC moves. Order the BD write before
+		 * reading CURDESC, and leave the pending list to the restart
+		 * from idle if the engine has already reached the tail BD.
+		 */
+		mb();
+		cur = dma_ctrl_read(chan, XILINX_DMA_REG_CURDESC);
+		if (chan->ext_addr)
+			cur |= (u64)dma_ctrl_read(chan,
+						  XILINX_DMA_REG_CURDESC_MSB) << 32;
+		if (cur == active_segment->phys)
+			return;
+	}
+
+	tail_desc = list_last_entry(&chan->pending_list,
+				    struct xilinx_dma_tx_descriptor, node);
+	tail_segment = list_last_entry(&tail_desc->segments,
+				       struct xilinx_axidma_tx_segment, node);
+
+	/* Moving the tail pointer lets the engine continue without a stop */
+	xilinx_write(chan, XILINX_DMA_REG_TAILDESC, tail_segment->phys);
+
+	xilinx_dma_trace_start(chan);
+	list_splice_tail_init(&chan->pending_list, &chan->active_list);
+	chan->desc_pendingcount = 0;
+}
+
 /**
  * xilinx_dma_start_transfer - Starts DMA transfer
  * @chan: Driver specific channel struct pointer
@@ -1535,7 +1964,7 @@ static void xilinx_dma_start_transfer(struct xilinx_dma_chan *chan)
 {
 	struct xilinx_dma_tx_descriptor *head_desc, *tail_desc;
 	struct xilinx_axidma_tx_segment *tail_segment;
-	u32 reg;
+	u32 reg, coalesce, delay;
 
 	if (chan->err)
 		return;
@@ -1543,8 +1972,11 @@ static void xilinx_dma_start_transfer(struct xilinx_dma_chan *chan)
 	if (list_empty(&chan->pending_list))
 		return;
 
-	if (!chan->idle)
+	if (!chan->idle) {
+		if (chan->streaming)
+			xilinx_dma_hot_append(chan);
 		return;
+	}
 
 	head_desc = list_first_entry(&chan->pending_list,
 				     struct xilinx_dma_tx_descriptor, node);
@@ -1555,10 +1987,26 @@ static void xilinx_dma_start_transfer(struct xilinx_dma_chan *chan)
 
 	reg = dma_ctrl_read(chan, XILINX_DMA_REG_DMACR);
 
-	if (chan->desc_pendingcount <= XILINX_DMA_COALESCE_MAX) {
+	coalesce = chan->desc_pendingcount;
+	delay = chan->irq_delay;
+	if (chan->use_dim) {
+		coalesce = min_t(u32, coalesce, chan->dim_coalesce);
+		delay = chan->dim_delay;
+	} else if (chan->priority == XILINX_DMA_PRIO_LOW_LATENCY) {
+		/* Complete each descriptor as soon as it is done */
+		coalesce = 1;
+	}
+
+	/*
+	 * Appended BDs do not reprogram the threshold, the delay timer has
+	 * to flush whatever is left of the last batch.
+	 */
+	if (chan->streaming && !delay)
+		delay = 1;
+
+	if (coalesce <= XILINX_DMA_COALESCE_MAX) {
 		reg &= ~XILINX_DMA_CR_COALESCE_MAX;
-		reg |= chan->desc_pendingcount <<
-				  XILINX_DMA_CR_COALESCE_SHIFT;
+		reg |= coalesce << XILINX_DMA_CR_COALESCE_SHIFT;
 		dma_ctrl_write(chan, XILINX_DMA_REG_DMACR, reg);
 	}
 
@@ -1566,7 +2014,7 @@ static void xilinx_dma_start_transfer(struct xilinx_dma_chan *chan)
 		xilinx_write(chan, XILINX_DMA_REG_CURDESC,
 			     head_desc->async_tx.phys);
 	reg  &= ~XILINX_DMA_CR_DELAY_MAX;
-	reg  |= chan->irq_delay << XILINX_DMA_CR_DELAY_SHIFT;
+	reg  |= delay << XILINX_DMA_CR_DELAY_SHIFT;
 	dma_ctrl_write(chan, XILINX_DMA_REG_DMACR, reg);
 
 	xilinx_dma_start(chan);
@@ -1599,11 +2047,62 @@ static void xilinx_dma_start_transfer(struct xilinx_dma_chan *chan)
 			       hw->control & chan->xdev->max_buffer_len);
 	}
 
+	xilinx_dma_trace_start(chan);
 	list_splice_tail_init(&chan->pending_list, &chan->active_list);
 	chan->desc_pendingcount = 0;
 	chan->idle = false;
 }
 
+/**
+ * xilinx_mcdma_wrr_write - Program the MM2S WRR weight of a channel
+ * @chan: Driver specific channel struct pointer
+ * @weight: Weight, 1 to XILINX_MCDMA_WRR_MAX
+ *
+ * The weights of all channels share two registers, eight channels each.
+ */
+static void xilinx_mcdma_wrr_write(struct xilinx_dma_chan *chan, u8 weight)
+{
+	struct xilinx_dma_device *xdev = chan->xdev;
+	unsigned long flags;
+	u32 reg;
+
+	spin_lock_irqsave(&xdev->wrr_lock, flags);
+	reg = dma_ctrl_read(chan, XILINX_MCDMA_WRR_OFFSET(chan->tdest));
+	reg &= ~(XILINX_MCDMA_WRR_MASK << XILINX_MCDMA_WRR_SHIFT(chan->tdest));
+	reg |= weight << XILINX_MCDMA_WRR_SHIFT(chan->tdest);
+	dma_ctrl_write(chan, XILINX_MCDMA_WRR_OFFSET(chan->tdest), reg);
+	spin_unlock_irqrestore(&xdev->wrr_lock, flags);
+
+	chan->wrr_active = weight;
+}
+
+/**
+ * xilinx_mcdma_wrr_rebalance - Adapt the WRR weight to the channel backlog
+ * @chan: Driver specific channel struct pointer
+ *
+ * A channel whose pending queue keeps growing is not served fast enough by
+ * its share of the engine, typically because another channel saturates it.
+ * Its weight is raised one step at a time while it stays backed up and
+ * decays back to the policy weight once the backlog is gone.
+ *
+ * This function was invoked with lock held.
+ */
+static void xilinx_mcdma_wrr_rebalance(struct xilinx_dma_chan *chan)
+{
+	u8 weight = chan->wrr_active;
+
+	if (!chan->wrr_weight)
+		return;
+
+	if (chan->desc_pendingcount >= XILINX_MCDMA_WRR_BACKLOG)
+		weight = min_t(u8, weight + 1, XILINX_MCDMA_WRR_MAX);
+	else if (!chan->desc_pendingcount && weight > chan->wrr_weight)
+		weight--;
+
+	if (weight != chan->wrr_active)
+		xilinx_mcdma_wrr_write(chan, weight);
+}
+
 /**
  * xilinx_mcdma_start_transfer - Starts MCDMA transfer
  * @chan: Driver specific channel struct pointer
@@ -1622,6 +2121,8 @@ static void xilinx_mcdma_start_transfer(struct xilinx_dma_chan *chan)
 	if (chan->err)
 		return;
 
+	xilinx_mcdma_wrr_rebalance(chan);
+
 	if (!chan->idle)
 		return;
 
@@ -1637,13 +2138,24 @@ static void xilinx_mcdma_start_transfer(struct xilinx_dma_chan *chan)
 
 	reg = dma_ctrl_read(chan, XILINX_MCDMA_CHAN_CR_OFFSET(chan->tdest));
 
-	if (chan->desc_pendingcount <= XILINX_MCDMA_COALESCE_MAX) {
+	if (chan->use_dim) {
+		reg &= ~(XILINX_MCDMA_COALESCE_MASK | XILINX_MCDMA_DELAY_MASK);
+		reg |= min_t(u32, chan->desc_pendingcount, chan->dim_coalesce) <<
+			XILINX_MCDMA_COALESCE_SHIFT;
+		reg |= chan->dim_delay << XILINX_MCDMA_DELAY_SHIFT;
+	} else if (chan->priority == XILINX_DMA_PRIO_LOW_LATENCY) {
+		reg &= ~XILINX_MCDMA_COALESCE_MASK;
+		reg |= 1 << XILINX_MCDMA_COALESCE_SHIFT;
+	} else if (chan->desc_pendingcount <= XILINX_MCDMA_COALESCE_MAX) {
 		reg &= ~XILINX_MCDMA_COALESCE_MASK;
 		reg |= chan->desc_pendingcount <<
 			XILINX_MCDMA_COALESCE_SHIFT;
 	}
 
-	reg |= XILINX_MCDMA_IRQ_ALL_MASK;
+	if (chan->irq_masked)
+		reg |= XILINX_MCDMA_IRQ_ERR_MASK;
+	else
+		reg |= XILINX_MCDMA_IRQ_ALL_MASK;
 	dma_ctrl_write(chan, XILINX_MCDMA_CHAN_CR_OFFSET(chan->tdest), reg);
 
 	/* Program current descriptor */
@@ -1669,6 +2181,7 @@ static void xilinx_mcdma_start_transfer(struct xilinx_dma_chan *chan)
 	xilinx_write(chan, XILINX_MCDMA_CHAN_TDESC_OFFSET(chan->tdest),
 		     tail_segment->phys);
 
+	xilinx_dma_trace_start(chan);
 	list_splice_tail_init(&chan->pending_list, &chan->active_list);
 	chan->desc_pendingcount = 0;
 	chan->idle = false;
@@ -1683,39 +2196,331 @@ static void xilinx_dma_issue_pending(struct dma_chan *dchan)
 	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
 	unsigned long flags;
 
+	trace_xilinx_dma_issue_pending(dchan);
+
 	spin_lock_irqsave(&chan->lock, flags);
 	chan->start_transfer(chan);
 	spin_unlock_irqrestore(&chan->lock, flags);
 }
 
+/**
+ * xilinx_dma_partial_irq - Check whether an interrupt may cover part of
+ *			    the active list
+ * @chan: Driver specific DMA channel
+ *
+ * With adaptive coalescing or hot-appended BDs a completion interrupt does
+ * not imply the engine went idle, only an empty active list does.
+ *
+ * Return: true if the channel must not be marked idle on every interrupt.
+ */
+static bool xilinx_dma_partial_irq(struct xilinx_dma_chan *chan)
+{
+	return chan->use_dim || chan->streaming;
+}
+
+/**
+ * xilinx_dma_dim_update - Feed a completion event to the moderation logic
+ * @chan: Driver specific DMA channel
+ *
+ * This function was invoked with lock held.
+ */
+static void xilinx_dma_dim_update(struct xilinx_dma_chan *chan)
+{
+	struct dim_sample sample = {};
+
+	if (!chan->use_dim)
+		return;
+
+	dim_update_sample(chan->irq_events++, chan->completed_descs,
+			  chan->completed_bytes, &sample);
+	net_dim(&chan->dim, sample);
+}
+
+/**
+ * xilinx_dma_dim_work - Apply the moderation profile selected by net_dim
+ * @work: Work struct embedded in the channel dim state
+ *
+ * The new thresholds are programmed on the next start of the channel.
+ */
+static void xilinx_dma_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct xilinx_dma_chan *chan = container_of(dim, struct xilinx_dma_chan,
+						    dim);
+	const struct xilinx_dma_dim_profile *prof;
+	unsigned long flags;
+
+	prof = &xilinx_dma_dim_profiles[min_t(u8, dim->profile_ix,
+				ARRAY_SIZE(xilinx_dma_dim_profiles) - 1)];
+
+	spin_lock_irqsave(&chan->lock, flags);
+	chan->dim_coalesce = prof->coalesce;
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA)
+		chan->dim_coalesce = min_t(u8, chan->dim_coalesce,
+					   XILINX_MCDMA_COALESCE_MAX);
+	chan->dim_delay = prof->delay;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	dim->state = DIM_START_MEASURE;
+}
+
+/**
+ * xilinx_dma_irq_mask - Mask the completion interrupts of a polled channel
+ * @chan: Driver specific DMA channel
+ *
+ * Error interrupts stay enabled. This function was invoked with lock held.
+ */
+static void xilinx_dma_irq_mask(struct xilinx_dma_chan *chan)
+{
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA)
+		dma_ctrl_clr(chan, XILINX_MCDMA_CHAN_CR_OFFSET(chan->tdest),
+			     XILINX_MCDMA_IRQ_IOC_MASK |
+			     XILINX_MCDMA_IRQ_DELAY_MASK);
+	else
+		dma_ctrl_clr(chan, XILINX_DMA_REG_DMACR,
+			     XILINX_DMA_DMACR_FRM_CNT_IRQ |
+			     XILINX_DMA_DMACR_DLY_CNT_IRQ);
+
+	chan->irq_masked = true;
+}
+
+/**
+ * xilinx_dma_irq_unmask - Re-enable the completion interrupts
+ * @chan: Driver specific DMA channel
+ *
+ * The status bits latch while masked, so a completion that raced with the
+ * poll loop raises the interrupt as soon as it is unmasked. This function
+ * was invoked with lock held.
+ */
+static void xilinx_dma_irq_unmask(struct xilinx_dma_chan *chan)
+{
+	if (!chan->irq_masked)
+		return;
+
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA)
+		dma_ctrl_set(chan, XILINX_MCDMA_CHAN_CR_OFFSET(chan->tdest),
+			     XILINX_MCDMA_IRQ_IOC_MASK |
+			     XILINX_MCDMA_IRQ_DELAY_MASK);
+	else
+		dma_ctrl_set(chan, XILINX_DMA_REG_DMACR,
+			     XILINX_DMA_DMACR_FRM_CNT_IRQ |
+			     XILINX_DMA_DMACR_DLY_CNT_IRQ);
+
+	chan->irq_masked = false;
+}
+
+/**
+ * xilinx_dma_chan_irq_shared - Check whether a channel shares its interrupt
+ * @chan: Driver specific DMA channel
+ *
+ * Return: true if another channel of the device uses the same interrupt.
+ */
+static bool xilinx_dma_chan_irq_shared(struct xilinx_dma_chan *chan)
+{
+	struct xilinx_dma_device *xdev = chan->xdev;
+	int i;
+
+	for (i = 0; i < xdev->dma_config->max_channels; i++) {
+		if (xdev->chan[i] && xdev->chan[i] != chan &&
+		    xdev->chan[i]->irq == chan->irq)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * xilinx_dma_chan_set_priority - Set the priority class of a channel
+ * @chan: Driver specific DMA channel
+ * @priority: XILINX_DMA_PRIO_* class
+ *
+ * Low latency channels take one interrupt per descriptor and, on the MCDMA
+ * MM2S side, the largest scheduler weight. Bulk channels get the smallest
+ * weight so they yield to the others. An explicit weight set afterwards
+ * by the channel policy overrides the class default.
+ *
+ * This function was invoked with lock held.
+ */
+static void xilinx_dma_chan_set_priority(struct xilinx_dma_chan *chan,
+					 u8 priority)
+{
+	if (priority == XILINX_DMA_PRIO_LOW_LATENCY &&
+	    chan->priority != priority && xilinx_dma_chan_irq_shared(chan))
+		dev_warn(chan->dev,
+			 "low latency channel %d shares its interrupt\n",
+			 chan->id);
+	chan->priority = priority;
+
+	if (chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIMCDMA ||
+	    chan->direction != DMA_MEM_TO_DEV)
+		return;
+
+	if (priority == XILINX_DMA_PRIO_LOW_LATENCY)
+		chan->wrr_weight = XILINX_MCDMA_WRR_MAX;
+	else if (priority == XILINX_DMA_PRIO_BULK)
+		chan->wrr_weight = 1;
+	else
+		return;
+
+	xilinx_mcdma_wrr_write(chan, chan->wrr_weight);
+}
+
+/**
+ * xilinx_dma_chan_set_axcache - Program the AXI cache and user signals
+ * @chan: Driver specific DMA channel
+ * @axcache: AxCACHE value
+ * @axuser: AxUSER value
+ *
+ * The MCDMA has one setting per direction, for the data and descriptor
+ * accesses of its channels. The AXI DMA only exposes the signals of the
+ * scatter gather descriptor accesses, shared by both directions, the data
+ * accesses are fixed when the IP is synthesized.
+ */
+static void xilinx_dma_chan_set_axcache(struct xilinx_dma_chan *chan,
+					u32 axcache, u32 axuser)
+{
+	u32 reg;
+
+	if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA) {
+		reg = FIELD_PREP(XILINX_MCDMA_AXCACHE_MASK, axcache) |
+		      FIELD_PREP(XILINX_MCDMA_AXUSER_MASK, axuser);
+		dma_ctrl_write(chan, chan->direction == DMA_MEM_TO_DEV ?
+			       XILINX_MCDMA_ARCACHE_OFFSET :
+			       XILINX_MCDMA_AWCACHE_OFFSET, reg);
+	} else {
+		reg = FIELD_PREP(XILINX_DMA_SG_CTL_CACHE_MASK, axcache) |
+		      FIELD_PREP(XILINX_DMA_SG_CTL_USER_MASK, axuser);
+		dma_write(chan, XILINX_DMA_REG_SG_CTL, reg);
+	}
+}
+
 /**
  * xilinx_dma_device_config - Configure the DMA channel
  * @dchan: DMA channel
  * @config: channel configuration
  *
- * Return: 0 always.
+ * AXI DMA and MCDMA clients may pass a &struct xilinx_dma_slave_config
+ * through @config->peripheral_config to size the channel BD ring. Only the
+ * mode flags in its @flags_mask and the nonzero settings are applied, the
+ * others keep their current values, initially from the device tree.
+ *
+ * Return: '0' on success and failure value on error
  */
 static int xilinx_dma_device_config(struct dma_chan *dchan,
 				    struct dma_slave_config *config)
 {
+	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
+	struct xilinx_dma_slave_config *xcfg = config->peripheral_config;
+	unsigned long flags;
+	u32 mode, mask;
+	int err;
+
+	if (!xcfg)
+		return 0;
+
+	if (config->peripheral_size < sizeof(*xcfg))
+		return -EINVAL;
+
+	if (chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIDMA &&
+	    chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIMCDMA)
+		return -EINVAL;
+
+	if (xcfg->max_descs && xcfg->max_descs < xcfg->num_descs)
+		return -EINVAL;
+
+	mask = xcfg->flags_mask & (XILINX_DMA_SLAVE_POLLED |
+				   XILINX_DMA_SLAVE_DIM |
+				   XILINX_DMA_SLAVE_STREAMING);
+	mode = xcfg->flags & mask;
+
+	/* Polling relies on the BD completion status, SG mode only */
+	if ((mode & XILINX_DMA_SLAVE_POLLED) && !chan->has_sg)
+		return -EINVAL;
+
+	if ((mode & XILINX_DMA_SLAVE_STREAMING) &&
+	    (!chan->has_sg ||
+	     chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIDMA))
+		return -EINVAL;
+
+	if (xcfg->priority > XILINX_DMA_PRIO_LOW_LATENCY)
+		return -EINVAL;
+
+	/*
+	 * Adaptive coalescing would batch the completions again, whether the
+	 * class is set here or comes from the DMA specifier
+	 */
+	if ((xcfg->priority ?: chan->priority) == XILINX_DMA_PRIO_LOW_LATENCY &&
+	    (mode & XILINX_DMA_SLAVE_DIM))
+		return -EINVAL;
+
+	if ((xcfg->flags & XILINX_DMA_SLAVE_AXCACHE) &&
+	    (xcfg->axcache > 15 || xcfg->axuser > 15))
+		return -EINVAL;
+
+	/* Only the MM2S side of the MCDMA has a channel scheduler */
+	if (xcfg->weight &&
+	    (xcfg->weight > XILINX_MCDMA_WRR_MAX ||
+	     chan->xdev->dma_config->dmatype != XDMA_TYPE_AXIMCDMA ||
+	     chan->direction != DMA_MEM_TO_DEV))
+		return -EINVAL;
+
+	if (xcfg->num_descs) {
+		err = xilinx_dma_resize_bd_ring(chan, xcfg->num_descs);
+		if (err)
+			return err;
+	}
+
+	chan->max_descs = xcfg->max_descs;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	if (mask & XILINX_DMA_SLAVE_POLLED)
+		chan->polled = !!(mode & XILINX_DMA_SLAVE_POLLED);
+	if (!chan->polled)
+		xilinx_dma_irq_unmask(chan);
+	if (mask & XILINX_DMA_SLAVE_DIM)
+		chan->use_dim = !!(mode & XILINX_DMA_SLAVE_DIM);
+	if (mask & XILINX_DMA_SLAVE_STREAMING)
+		chan->streaming = !!(mode & XILINX_DMA_SLAVE_STREAMING);
+	if (xcfg->priority)
+		xilinx_dma_chan_set_priority(chan, xcfg->priority);
+	if (xcfg->weight) {
+		chan->wrr_weight = xcfg->weight;
+		xilinx_mcdma_wrr_write(chan, chan->wrr_weight);
+	}
+	if (xcfg->flags & XILINX_DMA_SLAVE_AXCACHE)
+		xilinx_dma_chan_set_axcache(chan, xcfg->axcache, xcfg->axuser);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	if (!chan->use_dim)
+		cancel_work_sync(&chan->dim.work);
+
 	return 0;
 }
 
 /**
  * xilinx_dma_complete_descriptor - Mark the active descriptor as complete
  * @chan : xilinx DMA channel
+ * @budget: Maximum number of descriptors to complete
  *
- * CONTEXT: hardirq
+ * CONTEXT: hardirq, or the channel tasklet for polled channels
+ *
+ * Return: The number of descriptors moved to the done list.
  */
-static void xilinx_dma_complete_descriptor(struct xilinx_dma_chan *chan)
+static int xilinx_dma_complete_descriptor(struct xilinx_dma_chan *chan,
+					  int budget)
 {
 	struct xilinx_dma_tx_descriptor *desc, *next;
+	ktime_t now = 0;
+	int done = 0;
 
 	/* This function was invoked with lock held */
 	if (list_empty(&chan->active_list))
-		return;
+		return 0;
 
 	list_for_each_entry_safe(desc, next, &chan->active_list, node) {
+		if (done >= budget)
+			break;
+
 		if (chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA) {
 			struct xilinx_axidma_tx_segment *seg;
 
@@ -1723,6 +2528,20 @@ static void xilinx_dma_complete_descriptor(struct xilinx_dma_chan *chan)
 					      struct xilinx_axidma_tx_segment, node);
 			if (!(seg->hw.status & XILINX_DMA_BD_COMP_MASK) && chan->has_sg)
 				break;
+		} else if ((chan->polled || chan->use_dim) &&
+			   chan->xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA) {
+			struct xilinx_aximcdma_tx_segment *seg;
+
+			/*
+			 * Polled or partially coalesced completions give no
+			 * guarantee the whole active list is done, check the
+			 * last BD.
+			 */
+			seg = list_last_entry(&desc->segments,
+					      struct xilinx_aximcdma_tx_segment,
+					      node);
+			if (!(seg->hw.status & XILINX_MCDMA_BD_COMP_MASK))
+				break;
 		}
 		if (chan->has_sg && chan->xdev->dma_config->dmatype !=
 		    XDMA_TYPE_VDMA)
@@ -1735,7 +2554,22 @@ static void xilinx_dma_complete_descriptor(struct xilinx_dma_chan *chan)
 		if (!desc->cyclic)
 			dma_cookie_complete(&desc->async_tx);
 		list_add_tail(&desc->node, &chan->done_list);
+		chan->completed_descs++;
+		chan->completed_bytes += desc->len - desc->residue;
+		if (!desc->cyclic) {
+			if (!now)
+				now = ktime_get();
+			xilinx_dma_hist_add(chan->stats.latency,
+					    ktime_to_ns(ktime_sub(now,
+							desc->submit_time)));
+		}
+		done++;
 	}
+
+	if (done)
+		xilinx_dma_hist_add(chan->stats.batch, done);
+
+	return done;
 }
 
 /**
@@ -1765,6 +2599,7 @@ static int xilinx_dma_reset(struct xilinx_dma_chan *chan)
 
 	chan->err = false;
 	chan->idle = true;
+	chan->irq_masked = false;
 	chan->desc_pendingcount = 0;
 	chan->desc_submitcount = 0;
 
@@ -1827,6 +2662,8 @@ static irqreturn_t xilinx_mcdma_irq_handler(int irq, void *data)
 	if (!(status & XILINX_MCDMA_IRQ_ALL_MASK))
 		return IRQ_NONE;
 
+	trace_xilinx_dma_irq(&chan->common, status);
+
 	dma_ctrl_write(chan, XILINX_MCDMA_CHAN_SR_OFFSET(chan->tdest),
 		       status & XILINX_MCDMA_IRQ_ALL_MASK);
 
@@ -1849,11 +2686,21 @@ static irqreturn_t xilinx_mcdma_irq_handler(int irq, void *data)
 		dev_dbg(chan->dev, "Inter-packet latency too long\n");
 	}
 
-	if (status & XILINX_MCDMA_IRQ_IOC_MASK) {
+	/* The delay timer flushes a partially coalesced batch */
+	if (status & (XILINX_MCDMA_IRQ_IOC_MASK | XILINX_MCDMA_IRQ_DELAY_MASK)) {
 		spin_lock(&chan->lock);
-		xilinx_dma_complete_descriptor(chan);
-		chan->idle = true;
-		chan->start_transfer(chan);
+		chan->stats.irqs++;
+		if (chan->polled) {
+			xilinx_dma_irq_mask(chan);
+		} else {
+			chan->irq_time = ktime_get();
+			xilinx_dma_complete_descriptor(chan, INT_MAX);
+			xilinx_dma_dim_update(chan);
+			if (!xilinx_dma_partial_irq(chan) ||
+			    list_empty(&chan->active_list))
+				chan->idle = true;
+			chan->start_transfer(chan);
+		}
 		spin_unlock(&chan->lock);
 	}
 
@@ -1878,6 +2725,8 @@ static irqreturn_t xilinx_dma_irq_handler(int irq, void *data)
 	if (!(status & XILINX_DMA_DMAXR_ALL_IRQ_MASK))
 		return IRQ_NONE;
 
+	trace_xilinx_dma_irq(&chan->common, status);
+
 	dma_ctrl_write(chan, XILINX_DMA_REG_DMASR,
 			status & XILINX_DMA_DMAXR_ALL_IRQ_MASK);
 
@@ -1894,28 +2743,86 @@ static irqreturn_t xilinx_dma_irq_handler(int irq, void *data)
 		dma_ctrl_write(chan, XILINX_DMA_REG_DMASR,
 				errors & XILINX_DMA_DMASR_ERR_RECOVER_MASK);
 
-		if (!chan->flush_on_fsync ||
-		    (errors & ~XILINX_DMA_DMASR_ERR_RECOVER_MASK)) {
-			dev_err(chan->dev,
-				"Channel %p has errors %x, cdr %x tdr %x\n",
-				chan, errors,
-				dma_ctrl_read(chan, XILINX_DMA_REG_CURDESC),
-				dma_ctrl_read(chan, XILINX_DMA_REG_TAILDESC));
-			chan->err = true;
-		}
-	}
+		if (!chan->flush_on_fsync ||
+		    (errors & ~XILINX_DMA_DMASR_ERR_RECOVER_MASK)) {
+			dev_err(chan->dev,
+				"Channel %p has errors %x, cdr %x tdr %x\n",
+				chan, errors,
+				dma_ctrl_read(chan, XILINX_DMA_REG_CURDESC),
+				dma_ctrl_read(chan, XILINX_DMA_REG_TAILDESC));
+			chan->err = true;
+		}
+	}
+
+	if (status & (XILINX_DMA_DMASR_FRM_CNT_IRQ |
+		      XILINX_DMA_DMASR_DLY_CNT_IRQ)) {
+		spin_lock(&chan->lock);
+		chan->stats.irqs++;
+		if (chan->polled && !chan->cyclic) {
+			xilinx_dma_irq_mask(chan);
+		} else {
+			chan->irq_time = ktime_get();
+			xilinx_dma_complete_descriptor(chan, INT_MAX);
+			xilinx_dma_dim_update(chan);
+			if (!xilinx_dma_partial_irq(chan) ||
+			    list_empty(&chan->active_list))
+				chan->idle = true;
+			chan->start_transfer(chan);
+		}
+		spin_unlock(&chan->lock);
+	}
+
+	tasklet_schedule(&chan->tasklet);
+	return IRQ_HANDLED;
+}
+
+/**
+ * xilinx_dma_poll - Budgeted completion poll for polled channels
+ * @chan: Driver specific DMA channel
+ *
+ * Runs from the channel tasklet with the completion interrupts masked, in
+ * the manner of NAPI interrupt mitigation. At most XILINX_DMA_POLL_BUDGET
+ * completed descriptors are reaped per run. The poll reschedules itself
+ * while it keeps exhausting its budget and re-enables the interrupts once
+ * the ring has no completed BDs left.
+ */
+static void xilinx_dma_poll(struct xilinx_dma_chan *chan)
+{
+	unsigned long flags;
+	int work;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	work = xilinx_dma_complete_descriptor(chan, XILINX_DMA_POLL_BUDGET);
+	xilinx_dma_dim_update(chan);
 
-	if (status & (XILINX_DMA_DMASR_FRM_CNT_IRQ |
-		      XILINX_DMA_DMASR_DLY_CNT_IRQ)) {
-		spin_lock(&chan->lock);
-		xilinx_dma_complete_descriptor(chan);
+	/* Every submitted BD has completed, restart from the pending list */
+	if (list_empty(&chan->active_list)) {
 		chan->idle = true;
 		chan->start_transfer(chan);
-		spin_unlock(&chan->lock);
 	}
 
-	tasklet_schedule(&chan->tasklet);
-	return IRQ_HANDLED;
+	if (work < XILINX_DMA_POLL_BUDGET)
+		xilinx_dma_irq_unmask(chan);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	xilinx_dma_chan_desc_cleanup(chan);
+
+	if (work >= XILINX_DMA_POLL_BUDGET)
+		tasklet_schedule(&chan->tasklet);
+}
+
+/**
+ * xilinx_dma_do_tasklet - Schedule completion tasklet
+ * @t: Pointer to the Xilinx DMA channel structure
+ */
+static void xilinx_dma_do_tasklet(struct tasklet_struct *t)
+{
+	struct xilinx_dma_chan *chan = from_tasklet(chan, t, tasklet);
+
+	if (chan->polled)
+		xilinx_dma_poll(chan);
+	else
+		xilinx_dma_chan_desc_cleanup(chan);
 }
 
 /**
@@ -1955,13 +2862,19 @@ static void append_desc_queue(struct xilinx_dma_chan *chan,
 		axidma_tail_segment = list_last_entry(&tail_desc->segments,
 					       struct xilinx_axidma_tx_segment,
 					       node);
-		axidma_tail_segment->hw.next_desc = (u32)desc->async_tx.phys;
+		axidma_tail_segment->hw.next_desc =
+			lower_32_bits(desc->async_tx.phys);
+		axidma_tail_segment->hw.next_desc_msb =
+			upper_32_bits(desc->async_tx.phys);
 	} else {
 		aximcdma_tail_segment =
 			list_last_entry(&tail_desc->segments,
 					struct xilinx_aximcdma_tx_segment,
 					node);
-		aximcdma_tail_segment->hw.next_desc = (u32)desc->async_tx.phys;
+		aximcdma_tail_segment->hw.next_desc =
+			lower_32_bits(desc->async_tx.phys);
+		aximcdma_tail_segment->hw.next_desc_msb =
+			upper_32_bits(desc->async_tx.phys);
 	}
 
 	/*
@@ -2011,6 +2924,8 @@ static dma_cookie_t xilinx_dma_tx_submit(struct dma_async_tx_descriptor *tx)
 	spin_lock_irqsave(&chan->lock, flags);
 
 	cookie = dma_cookie_assign(tx);
+	desc->submit_time = ktime_get();
+	trace_xilinx_dma_submit(tx->chan, cookie, desc->len);
 
 	/* Put this transaction onto the tail of the pending queue */
 	append_desc_queue(chan, desc);
@@ -2143,6 +3058,7 @@ xilinx_cdma_prep_memcpy(struct dma_chan *dchan, dma_addr_t dma_dst,
 
 	hw = &segment->hw;
 	hw->control = len;
+	desc->len = len;
 	hw->src_addr = dma_src;
 	hw->dest_addr = dma_dst;
 	if (chan->ext_addr) {
@@ -2181,7 +3097,7 @@ static struct dma_async_tx_descriptor *xilinx_dma_prep_slave_sg(
 {
 	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
 	struct xilinx_dma_tx_descriptor *desc;
-	struct xilinx_axidma_tx_segment *segment = NULL;
+	struct xilinx_axidma_tx_segment *segment = NULL, *prev = NULL;
 	u32 *app_w = (u32 *)context;
 	struct scatterlist *sg;
 	size_t copy;
@@ -2225,6 +3141,7 @@ static struct dma_async_tx_descriptor *xilinx_dma_prep_slave_sg(
 					  sg_used, 0);
 
 			hw->control = copy;
+			desc->len += copy;
 
 			if (chan->direction == DMA_MEM_TO_DEV) {
 				if (app_w)
@@ -2232,6 +3149,17 @@ static struct dma_async_tx_descriptor *xilinx_dma_prep_slave_sg(
 					       XILINX_DMA_NUM_APP_WORDS);
 			}
 
+			/*
+			 * Segments grown from the pool are not part of the
+			 * pre-linked BD ring, so chain them explicitly.
+			 */
+			if (prev) {
+				prev->hw.next_desc = lower_32_bits(segment->phys);
+				prev->hw.next_desc_msb =
+					upper_32_bits(segment->phys);
+			}
+
+			prev = segment;
 			sg_used += copy;
 
 			/*
@@ -2330,9 +3258,13 @@ static struct dma_async_tx_descriptor *xilinx_dma_prep_dma_cyclic(
 			xilinx_axidma_buf(chan, hw, buf_addr, sg_used,
 					  period_len * i);
 			hw->control = copy;
+			desc->len += copy;
 
-			if (prev)
-				prev->hw.next_desc = segment->phys;
+			if (prev) {
+				prev->hw.next_desc = lower_32_bits(segment->phys);
+				prev->hw.next_desc_msb =
+					upper_32_bits(segment->phys);
+			}
 
 			prev = segment;
 			sg_used += copy;
@@ -2357,7 +3289,8 @@ static struct dma_async_tx_descriptor *xilinx_dma_prep_dma_cyclic(
 	segment = list_last_entry(&desc->segments,
 				  struct xilinx_axidma_tx_segment,
 				  node);
-	segment->hw.next_desc = (u32) head_segment->phys;
+	segment->hw.next_desc = lower_32_bits(head_segment->phys);
+	segment->hw.next_desc_msb = upper_32_bits(head_segment->phys);
 
 	/* For the last DMA_MEM_TO_DEV transfer, set EOP */
 	if (direction == DMA_MEM_TO_DEV) {
@@ -2391,7 +3324,7 @@ xilinx_mcdma_prep_slave_sg(struct dma_chan *dchan, struct scatterlist *sgl,
 {
 	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
 	struct xilinx_dma_tx_descriptor *desc;
-	struct xilinx_aximcdma_tx_segment *segment = NULL;
+	struct xilinx_aximcdma_tx_segment *segment = NULL, *prev = NULL;
 	u32 *app_w = (u32 *)context;
 	struct scatterlist *sg;
 	size_t copy;
@@ -2434,12 +3367,21 @@ xilinx_mcdma_prep_slave_sg(struct dma_chan *dchan, struct scatterlist *sgl,
 			xilinx_aximcdma_buf(chan, hw, sg_dma_address(sg),
 					    sg_used);
 			hw->control = copy;
+			desc->len += copy;
 
 			if (chan->direction == DMA_MEM_TO_DEV && app_w) {
 				memcpy(hw->app, app_w, sizeof(u32) *
 				       XILINX_DMA_NUM_APP_WORDS);
 			}
 
+			/* Chain explicitly, the segment may be pool grown */
+			if (prev) {
+				prev->hw.next_desc = lower_32_bits(segment->phys);
+				prev->hw.next_desc_msb =
+					upper_32_bits(segment->phys);
+			}
+
+			prev = segment;
 			sg_used += copy;
 			/*
 			 * Insert the segment into the descriptor segments
@@ -2470,6 +3412,278 @@ xilinx_mcdma_prep_slave_sg(struct dma_chan *dchan, struct scatterlist *sgl,
 	return NULL;
 }
 
+/**
+ * xilinx_axidma_add_range - Append BDs covering a memory range
+ * @chan: Driver specific DMA channel
+ * @desc: Transaction descriptor the BDs are added to
+ * @addr: DMA address of the range
+ * @len: Length of the range
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int xilinx_axidma_add_range(struct xilinx_dma_chan *chan,
+				   struct xilinx_dma_tx_descriptor *desc,
+				   dma_addr_t addr, size_t len)
+{
+	struct xilinx_axidma_tx_segment *segment, *prev = NULL;
+	size_t copy, used = 0;
+
+	if (!list_empty(&desc->segments))
+		prev = list_last_entry(&desc->segments,
+				       struct xilinx_axidma_tx_segment, node);
+
+	while (used < len) {
+		segment = xilinx_axidma_alloc_tx_segment(chan);
+		if (!segment)
+			return -ENOMEM;
+
+		copy = xilinx_dma_calc_copysize(chan, len, used);
+		xilinx_axidma_buf(chan, &segment->hw, addr, used, 0);
+		segment->hw.control = copy;
+		desc->len += copy;
+
+		if (prev) {
+			prev->hw.next_desc = lower_32_bits(segment->phys);
+			prev->hw.next_desc_msb = upper_32_bits(segment->phys);
+		}
+
+		prev = segment;
+		used += copy;
+		list_add_tail(&segment->node, &desc->segments);
+	}
+
+	return 0;
+}
+
+/**
+ * xilinx_aximcdma_add_range - Append BDs covering a memory range
+ * @chan: Driver specific DMA channel
+ * @desc: Transaction descriptor the BDs are added to
+ * @addr: DMA address of the range
+ * @len: Length of the range
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int xilinx_aximcdma_add_range(struct xilinx_dma_chan *chan,
+				     struct xilinx_dma_tx_descriptor *desc,
+				     dma_addr_t addr, size_t len)
+{
+	struct xilinx_aximcdma_tx_segment *segment, *prev = NULL;
+	size_t copy, used = 0;
+
+	if (!list_empty(&desc->segments))
+		prev = list_last_entry(&desc->segments,
+				       struct xilinx_aximcdma_tx_segment, node);
+
+	while (used < len) {
+		segment = xilinx_aximcdma_alloc_tx_segment(chan);
+		if (!segment)
+			return -ENOMEM;
+
+		copy = min_t(size_t, len - used, chan->xdev->max_buffer_len);
+		xilinx_aximcdma_buf(chan, &segment->hw, addr, used);
+		segment->hw.control = copy;
+		desc->len += copy;
+
+		if (prev) {
+			prev->hw.next_desc = lower_32_bits(segment->phys);
+			prev->hw.next_desc_msb = upper_32_bits(segment->phys);
+		}
+
+		prev = segment;
+		used += copy;
+		list_add_tail(&segment->node, &desc->segments);
+	}
+
+	return 0;
+}
+
+/**
+ * xilinx_dma_xt_walk - Split an interleaved template into memory runs
+ * @chan: Driver specific DMA channel
+ * @desc: Transaction descriptor the BDs are added to
+ * @xt: Interleaved template pointer
+ * @add_range: Appends the BDs for one contiguous memory run
+ *
+ * The AXI DMA and MCDMA BDs carry no stride, so every chunk of the
+ * template needs its own BDs. Chunks that are contiguous in memory, such
+ * as rows without an inter-chunk gap, are merged into a single run first.
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int xilinx_dma_xt_walk(struct xilinx_dma_chan *chan,
+			      struct xilinx_dma_tx_descriptor *desc,
+			      struct dma_interleaved_template *xt,
+			      int (*add_range)(struct xilinx_dma_chan *chan,
+					       struct xilinx_dma_tx_descriptor *desc,
+					       dma_addr_t addr, size_t len))
+{
+	bool to_dev = xt->dir == DMA_MEM_TO_DEV;
+	dma_addr_t addr, run_addr = 0;
+	size_t run_len = 0;
+	size_t i, j;
+	int err;
+
+	addr = to_dev ? xt->src_start : xt->dst_start;
+
+	for (i = 0; i < xt->numf; i++) {
+		for (j = 0; j < xt->frame_size; j++) {
+			struct data_chunk *chunk = &xt->sgl[j];
+
+			if (run_len && run_addr + run_len == addr) {
+				run_len += chunk->size;
+			} else if (chunk->size) {
+				if (run_len) {
+					err = add_range(chan, desc, run_addr,
+							run_len);
+					if (err)
+						return err;
+				}
+				run_addr = addr;
+				run_len = chunk->size;
+			}
+
+			addr += chunk->size;
+			addr += to_dev ? dmaengine_get_src_icg(xt, chunk) :
+					 dmaengine_get_dst_icg(xt, chunk);
+		}
+	}
+
+	if (!run_len)
+		return -EINVAL;
+
+	return add_range(chan, desc, run_addr, run_len);
+}
+
+/**
+ * xilinx_dma_xt_valid - Check an interleaved template for AXI DMA or MCDMA
+ * @chan: Driver specific DMA channel
+ * @xt: Interleaved template pointer
+ *
+ * Return: true if the template can be mapped onto the channel.
+ */
+static bool xilinx_dma_xt_valid(struct xilinx_dma_chan *chan,
+				struct dma_interleaved_template *xt)
+{
+	if (!is_slave_direction(xt->dir) || xt->dir != chan->direction)
+		return false;
+
+	if (!xt->numf || !xt->frame_size)
+		return false;
+
+	/* Only the memory side has addresses, the stream side is fixed */
+	if (xt->dir == DMA_MEM_TO_DEV)
+		return xt->src_inc;
+
+	return xt->dst_inc;
+}
+
+/**
+ * xilinx_dma_prep_interleaved - prepare a descriptor for an interleaved
+ *	DMA_SLAVE transaction on AXI DMA
+ * @dchan: DMA channel
+ * @xt: Interleaved template pointer
+ * @flags: transfer ack flags
+ *
+ * The whole template is queued as a single packet, so MM2S frames it with
+ * one SOP and one EOP.
+ *
+ * Return: Async transaction descriptor on success and NULL on failure
+ */
+static struct dma_async_tx_descriptor *
+xilinx_dma_prep_interleaved(struct dma_chan *dchan,
+			    struct dma_interleaved_template *xt,
+			    unsigned long flags)
+{
+	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
+	struct xilinx_axidma_tx_segment *segment;
+	struct xilinx_dma_tx_descriptor *desc;
+
+	if (!xilinx_dma_xt_valid(chan, xt))
+		return NULL;
+
+	desc = xilinx_dma_alloc_tx_descriptor(chan);
+	if (!desc)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&desc->async_tx, &chan->common);
+	desc->async_tx.tx_submit = xilinx_dma_tx_submit;
+
+	if (xilinx_dma_xt_walk(chan, desc, xt, xilinx_axidma_add_range))
+		goto error;
+
+	segment = list_first_entry(&desc->segments,
+				   struct xilinx_axidma_tx_segment, node);
+	desc->async_tx.phys = segment->phys;
+
+	if (chan->direction == DMA_MEM_TO_DEV) {
+		segment->hw.control |= XILINX_DMA_BD_SOP;
+		segment = list_last_entry(&desc->segments,
+					  struct xilinx_axidma_tx_segment,
+					  node);
+		segment->hw.control |= XILINX_DMA_BD_EOP;
+	}
+
+	if (chan->xdev->has_axistream_connected)
+		desc->async_tx.metadata_ops = &xilinx_dma_metadata_ops;
+
+	return &desc->async_tx;
+
+error:
+	xilinx_dma_free_tx_descriptor(chan, desc);
+	return NULL;
+}
+
+/**
+ * xilinx_mcdma_prep_interleaved - prepare a descriptor for an interleaved
+ *	DMA_SLAVE transaction on MCDMA
+ * @dchan: DMA channel
+ * @xt: Interleaved template pointer
+ * @flags: transfer ack flags
+ *
+ * Return: Async transaction descriptor on success and NULL on failure
+ */
+static struct dma_async_tx_descriptor *
+xilinx_mcdma_prep_interleaved(struct dma_chan *dchan,
+			      struct dma_interleaved_template *xt,
+			      unsigned long flags)
+{
+	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
+	struct xilinx_aximcdma_tx_segment *segment;
+	struct xilinx_dma_tx_descriptor *desc;
+
+	if (!xilinx_dma_xt_valid(chan, xt))
+		return NULL;
+
+	desc = xilinx_dma_alloc_tx_descriptor(chan);
+	if (!desc)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&desc->async_tx, &chan->common);
+	desc->async_tx.tx_submit = xilinx_dma_tx_submit;
+
+	if (xilinx_dma_xt_walk(chan, desc, xt, xilinx_aximcdma_add_range))
+		goto error;
+
+	segment = list_first_entry(&desc->segments,
+				   struct xilinx_aximcdma_tx_segment, node);
+	desc->async_tx.phys = segment->phys;
+
+	if (chan->direction == DMA_MEM_TO_DEV) {
+		segment->hw.control |= XILINX_MCDMA_BD_SOP;
+		segment = list_last_entry(&desc->segments,
+					  struct xilinx_aximcdma_tx_segment,
+					  node);
+		segment->hw.control |= XILINX_MCDMA_BD_EOP;
+	}
+
+	return &desc->async_tx;
+
+error:
+	xilinx_dma_free_tx_descriptor(chan, desc);
+	return NULL;
+}
+
 /**
  * xilinx_dma_terminate_all - Halt the channel and free descriptors
  * @dchan: Driver specific DMA Channel pointer
@@ -2482,6 +3696,8 @@ static int xilinx_dma_terminate_all(struct dma_chan *dchan)
 	u32 reg;
 	int err;
 
+	trace_xilinx_dma_terminate(dchan);
+
 	if (!chan->cyclic) {
 		err = chan->stop_transfer(chan);
 		if (err) {
@@ -2517,6 +3733,7 @@ static void xilinx_dma_synchronize(struct dma_chan *dchan)
 	struct xilinx_dma_chan *chan = to_xilinx_chan(dchan);
 
 	tasklet_kill(&chan->tasklet);
+	cancel_work_sync(&chan->dim.work);
 }
 
 /**
@@ -2594,6 +3811,107 @@ EXPORT_SYMBOL(xilinx_vdma_channel_set_config);
  * Probe and remove
  */
 
+static int xilinx_dma_dim_show(struct seq_file *s, void *data)
+{
+	struct xilinx_dma_chan *chan = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	seq_printf(s, "enabled:\t%d\n", chan->use_dim);
+	seq_printf(s, "profile:\t%u\n", chan->dim.profile_ix);
+	seq_printf(s, "coalesce:\t%u\n", chan->dim_coalesce);
+	seq_printf(s, "delay:\t\t%u\n", chan->dim_delay);
+	seq_printf(s, "tune_state:\t%u\n", chan->dim.tune_state);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xilinx_dma_dim);
+
+static void xilinx_dma_hist_show(struct seq_file *s, const char *name,
+				 const u64 *hist)
+{
+	int i;
+
+	seq_printf(s, "%s:\n", name);
+	for (i = 0; i < XILINX_DMA_HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		seq_printf(s, "  %llu:\t%llu\n", i ? BIT_ULL(i - 1) : 0ULL,
+			   hist[i]);
+	}
+}
+
+static int xilinx_dma_stats_show(struct seq_file *s, void *data)
+{
+	struct xilinx_dma_chan *chan = s->private;
+	struct xilinx_dma_chan_stats *stats;
+	unsigned long flags;
+
+	stats = kmalloc(sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	/* Snapshot under the lock, print without it */
+	spin_lock_irqsave(&chan->lock, flags);
+	*stats = chan->stats;
+	seq_printf(s, "descs:\t\t%llu\n", chan->completed_descs);
+	seq_printf(s, "bytes:\t\t%llu\n", chan->completed_bytes);
+	seq_printf(s, "nr_descs:\t%u\n", chan->nr_descs);
+	if (chan->wrr_weight)
+		seq_printf(s, "wrr_weight:\t%u/%u\n", chan->wrr_active,
+			   chan->wrr_weight);
+	seq_printf(s, "priority:\t%u\n", chan->priority);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	seq_printf(s, "irqs:\t\t%llu\n", stats->irqs);
+	seq_printf(s, "ring_full:\t%llu\n", stats->ring_full);
+	xilinx_dma_hist_show(s, "latency_ns", stats->latency);
+	xilinx_dma_hist_show(s, "callback_ns", stats->callback);
+	xilinx_dma_hist_show(s, "batch", stats->batch);
+
+	kfree(stats);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xilinx_dma_stats);
+
+/**
+ * xilinx_dma_debugfs_init - Create the per-channel debugfs entries
+ * @xdev: Driver specific device structure
+ *
+ * The entries live below the dmaengine debugfs directory of the device,
+ * which the core removes on unregister. Every channel reports its
+ * statistics, AXI DMA and MCDMA channels also their moderation state.
+ */
+static void xilinx_dma_debugfs_init(struct xilinx_dma_device *xdev)
+{
+	struct dentry *root = dmaengine_get_debugfs_root(&xdev->common);
+	struct dentry *dir;
+	char name[16];
+	int i;
+
+	if (!root)
+		return;
+
+	for (i = 0; i < xdev->dma_config->max_channels; i++) {
+		struct xilinx_dma_chan *chan = xdev->chan[i];
+
+		if (!chan)
+			continue;
+
+		snprintf(name, sizeof(name), "chan%d", chan->id);
+		dir = debugfs_create_dir(name, root);
+		debugfs_create_file("stats", 0444, dir, chan,
+				    &xilinx_dma_stats_fops);
+
+		if (xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA ||
+		    xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA)
+			debugfs_create_file("dim", 0444, dir, chan,
+					    &xilinx_dma_dim_fops);
+	}
+}
+
 /**
  * xilinx_dma_chan_remove - Per Channel remove function
  * @chan: Driver specific DMA channel
@@ -2608,6 +3926,7 @@ static void xilinx_dma_chan_remove(struct xilinx_dma_chan *chan)
 		free_irq(chan->irq, chan);
 
 	tasklet_kill(&chan->tasklet);
+	cancel_work_sync(&chan->dim.work);
 
 	list_del(&chan->common.device_node);
 }
@@ -2835,6 +4154,17 @@ static int xilinx_dma_chan_probe(struct xilinx_dma_device *xdev,
 
 	of_property_read_u8(node, "xlnx,irq-delay", &chan->irq_delay);
 
+	chan->num_descs = XILINX_DMA_NUM_DESCS;
+	if (!of_property_read_u32(node, "xlnx,num-descs", &value) && value)
+		chan->num_descs = value;
+	of_property_read_u32(node, "xlnx,max-descs", &chan->max_descs);
+
+	chan->use_dim = of_property_read_bool(node, "xlnx,adaptive-coalesce");
+	INIT_WORK(&chan->dim.work, xilinx_dma_dim_work);
+	chan->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	chan->dim_coalesce = xilinx_dma_dim_profiles[0].coalesce;
+	chan->dim_delay = xilinx_dma_dim_profiles[0].delay;
+
 	chan->genlock = of_property_read_bool(node, "xlnx,genlock-mode");
 
 	err = of_property_read_u32(node, "xlnx,datawidth", &value);
@@ -2998,11 +4328,30 @@ static struct dma_chan *of_dma_xilinx_xlate(struct of_phandle_args *dma_spec,
 {
 	struct xilinx_dma_device *xdev = ofdma->of_dma_data;
 	int chan_id = dma_spec->args[0];
+	struct xilinx_dma_chan *chan;
+	struct dma_chan *dchan;
+	unsigned long flags;
+	u32 priority = XILINX_DMA_PRIO_DEFAULT;
 
 	if (chan_id >= xdev->dma_config->max_channels || !xdev->chan[chan_id])
 		return NULL;
 
-	return dma_get_slave_channel(&xdev->chan[chan_id]->common);
+	/* The optional second cell selects the priority class */
+	if (dma_spec->args_count > 1)
+		priority = dma_spec->args[1];
+	if (priority > XILINX_DMA_PRIO_LOW_LATENCY)
+		return NULL;
+
+	chan = xdev->chan[chan_id];
+	dchan = dma_get_slave_channel(&chan->common);
+	if (!dchan || priority == XILINX_DMA_PRIO_DEFAULT)
+		return dchan;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	xilinx_dma_chan_set_priority(chan, priority);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return dchan;
 }
 
 static const struct xilinx_dma_config axidma_config = {
@@ -3064,6 +4413,7 @@ static int xilinx_dma_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	xdev->dev = &pdev->dev;
+	spin_lock_init(&xdev->wrr_lock);
 	if (np) {
 		const struct of_device_id *match;
 
@@ -3168,6 +4518,8 @@ static int xilinx_dma_probe(struct platform_device *pdev)
 	if (xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA) {
 		dma_cap_set(DMA_CYCLIC, xdev->common.cap_mask);
 		xdev->common.device_prep_slave_sg = xilinx_dma_prep_slave_sg;
+		xdev->common.device_prep_interleaved_dma =
+					  xilinx_dma_prep_interleaved;
 		xdev->common.device_prep_dma_cyclic =
 					  xilinx_dma_prep_dma_cyclic;
 		/* Residue calculation is supported by only AXI DMA and CDMA */
@@ -3181,6 +4533,8 @@ static int xilinx_dma_probe(struct platform_device *pdev)
 					  DMA_RESIDUE_GRANULARITY_SEGMENT;
 	} else if (xdev->dma_config->dmatype == XDMA_TYPE_AXIMCDMA) {
 		xdev->common.device_prep_slave_sg = xilinx_mcdma_prep_slave_sg;
+		xdev->common.device_prep_interleaved_dma =
+					  xilinx_mcdma_prep_interleaved;
 	} else {
 		xdev->common.device_prep_interleaved_dma =
 				xilinx_vdma_dma_prep_interleaved;
@@ -3218,6 +4572,8 @@ static int xilinx_dma_probe(struct platform_device *pdev)
 		goto error;
 	}
 
+	xilinx_dma_debugfs_init(xdev);
+
 	if (xdev->dma_config->dmatype == XDMA_TYPE_AXIDMA)
 		dev_info(&pdev->dev, "Xilinx AXI DMA Engine Driver Probed!!\n");
 	else if (xdev->dma_config->dmatype == XDMA_TYPE_CDMA)
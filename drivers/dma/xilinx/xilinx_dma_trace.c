@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tracepoints shared by the Xilinx DMA engine drivers
+ */
+
+#include <linux/module.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/xilinx_dma.h>
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(xilinx_dma_issue_pending);
+EXPORT_TRACEPOINT_SYMBOL_GPL(xilinx_dma_terminate);
+EXPORT_TRACEPOINT_SYMBOL_GPL(xilinx_dma_submit);
+EXPORT_TRACEPOINT_SYMBOL_GPL(xilinx_dma_start);
+EXPORT_TRACEPOINT_SYMBOL_GPL(xilinx_dma_irq);
+EXPORT_TRACEPOINT_SYMBOL_GPL(xilinx_dma_complete);
+
+MODULE_DESCRIPTION("Xilinx DMA engine tracepoints");
+MODULE_LICENSE("GPL");
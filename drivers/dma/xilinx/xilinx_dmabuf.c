@@ -0,0 +1,799 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Xilinx AXI DMA dma-buf streaming interface
+ *
+ * Exposes the MM2S and S2MM channels of an AXI DMA to userspace through a
+ * character device. Buffers are imported as dma-bufs, mapped for the DMA
+ * device and queued to the channel without any copy. Completion is
+ * reported through an eventfd per transfer.
+ *
+ * For continuous capture the RX channel can also run a cyclic transfer
+ * into a driver allocated ring. The ring and a page of shared indices are
+ * mmapped, so periods are consumed without any syscall or copy.
+ */
+
+#include <linux/dma-buf.h>
+#include <linux/dmaengine.h>
+#include <linux/eventfd.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/overflow.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#include <uapi/linux/xilinx-dmabuf.h>
+
+#define XDMABUF_NUM_DIRS	2
+#define DEV_NAME_LEN		16
+
+/* mmap page offsets of the capture ring indices and period buffer */
+#define XDMABUF_RING_PGOFF	0
+#define XDMABUF_DATA_PGOFF	1
+
+static DEFINE_IDA(dev_nrs);
+
+/**
+ * struct xdmabuf_dev - Driver specific device structure
+ * @ref: Held by the platform device, the open file and each mapping
+ * @dev: Platform device
+ * @miscdev: Character device exposed to userspace
+ * @dev_name: Device name
+ * @dev_id: Device instance id
+ * @chan: DMA channels, indexed by XDMABUF_DIR_*
+ * @busy: Device is open, only a single opener is allowed
+ * @lock: Protects @active, @done and @errors
+ * @active: Transfers queued to the hardware
+ * @done: Completed transfers waiting to be unmapped
+ * @errors: Number of failed transfers per direction
+ * @work: Releases completed transfers in process context
+ * @cap_lock: Serializes queueing with capture setup, teardown and mmap
+ * @cap_ring: Capture ring indices shared with userspace
+ * @cap_buf: Capture period buffer
+ * @cap_dma: DMA address of @cap_buf
+ * @cap_size: Size of @cap_buf
+ * @cap_period: Index of the period the engine was filling at the last
+ *		callback
+ * @cap_eventfd: Capture eventfd, NULL for none
+ * @cap_maps: Number of userspace mappings of the capture ring or buffer
+ * @capturing: The RX channel runs a cyclic capture
+ * @removed: The device is unbound, every file operation fails with -ENODEV
+ */
+struct xdmabuf_dev {
+	struct kref ref;
+	struct device *dev;
+	struct miscdevice miscdev;
+	char dev_name[DEV_NAME_LEN];
+	int dev_id;
+	struct dma_chan *chan[XDMABUF_NUM_DIRS];
+	unsigned long busy;
+	spinlock_t lock;
+	struct list_head active;
+	struct list_head done;
+	u32 errors[XDMABUF_NUM_DIRS];
+	struct work_struct work;
+	struct mutex cap_lock;
+	struct xdmabuf_ring *cap_ring;
+	void *cap_buf;
+	dma_addr_t cap_dma;
+	size_t cap_size;
+	u32 cap_period;
+	struct eventfd_ctx *cap_eventfd;
+	atomic_t cap_maps;
+	bool capturing;
+	bool removed;
+};
+
+/**
+ * struct xdmabuf_xfer - A dma-buf queued to a channel
+ * @node: Node in the device active or done list
+ * @xdev: Driver specific device structure
+ * @dmabuf: Imported dma-buf
+ * @attach: Attachment of @dmabuf to the DMA device
+ * @sgt: Mapped scatterlist of @dmabuf
+ * @eventfd: Completion eventfd, NULL for none
+ * @dir: Mapping direction
+ * @index: XDMABUF_DIR_* channel index
+ */
+struct xdmabuf_xfer {
+	struct list_head node;
+	struct xdmabuf_dev *xdev;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	struct eventfd_ctx *eventfd;
+	enum dma_data_direction dir;
+	unsigned int index;
+};
+
+static void xdmabuf_xfer_free(struct xdmabuf_xfer *xfer)
+{
+	if (xfer->sgt)
+		dma_buf_unmap_attachment_unlocked(xfer->attach, xfer->sgt,
+						  xfer->dir);
+	if (xfer->attach)
+		dma_buf_detach(xfer->dmabuf, xfer->attach);
+	if (xfer->dmabuf)
+		dma_buf_put(xfer->dmabuf);
+	if (xfer->eventfd)
+		eventfd_ctx_put(xfer->eventfd);
+	kfree(xfer);
+}
+
+static void xdmabuf_free_list(struct list_head *list)
+{
+	struct xdmabuf_xfer *xfer, *next;
+
+	list_for_each_entry_safe(xfer, next, list, node) {
+		list_del(&xfer->node);
+		xdmabuf_xfer_free(xfer);
+	}
+}
+
+static void xdmabuf_work(struct work_struct *work)
+{
+	struct xdmabuf_dev *xdev = container_of(work, struct xdmabuf_dev, work);
+	LIST_HEAD(done);
+
+	spin_lock_irq(&xdev->lock);
+	list_splice_init(&xdev->done, &done);
+	spin_unlock_irq(&xdev->lock);
+
+	xdmabuf_free_list(&done);
+}
+
+/*
+ * The last reference is dropped by remove or by the last close of the file
+ * or of a mapping, the channels are only released then.
+ */
+static void xdmabuf_free(struct kref *ref)
+{
+	struct xdmabuf_dev *xdev = container_of(ref, struct xdmabuf_dev, ref);
+	int i;
+
+	for (i = 0; i < XDMABUF_NUM_DIRS; i++)
+		if (xdev->chan[i])
+			dma_release_channel(xdev->chan[i]);
+
+	ida_free(&dev_nrs, xdev->dev_id);
+	kfree(xdev);
+}
+
+static void xdmabuf_callback(void *param, const struct dmaengine_result *result)
+{
+	struct xdmabuf_xfer *xfer = param;
+	struct xdmabuf_dev *xdev = xfer->xdev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&xdev->lock, flags);
+	if (result->result != DMA_TRANS_NOERROR)
+		xdev->errors[xfer->index]++;
+	list_move_tail(&xfer->node, &xdev->done);
+	spin_unlock_irqrestore(&xdev->lock, flags);
+
+	if (xfer->eventfd)
+		eventfd_signal(xfer->eventfd, 1);
+
+	/* Unmapping may sleep, leave it to process context */
+	schedule_work(&xdev->work);
+}
+
+static int xdmabuf_queue(struct xdmabuf_dev *xdev, void __user *arg)
+{
+	struct dma_async_tx_descriptor *txd;
+	enum dma_transfer_direction dir;
+	struct xdmabuf_queue queue;
+	struct xdmabuf_xfer *xfer;
+	struct dma_chan *chan;
+	dma_cookie_t cookie;
+	int ret;
+
+	if (copy_from_user(&queue, arg, sizeof(queue)))
+		return -EFAULT;
+
+	if (queue.flags || queue.reserved ||
+	    queue.direction >= XDMABUF_NUM_DIRS)
+		return -EINVAL;
+
+	chan = xdev->chan[queue.direction];
+	if (!chan)
+		return -ENODEV;
+
+	xfer = kzalloc(sizeof(*xfer), GFP_KERNEL);
+	if (!xfer)
+		return -ENOMEM;
+
+	xfer->xdev = xdev;
+	xfer->index = queue.direction;
+	if (queue.direction == XDMABUF_DIR_TX) {
+		xfer->dir = DMA_TO_DEVICE;
+		dir = DMA_MEM_TO_DEV;
+	} else {
+		xfer->dir = DMA_FROM_DEVICE;
+		dir = DMA_DEV_TO_MEM;
+	}
+
+	if (queue.eventfd >= 0) {
+		xfer->eventfd = eventfd_ctx_fdget(queue.eventfd);
+		if (IS_ERR(xfer->eventfd)) {
+			ret = PTR_ERR(xfer->eventfd);
+			xfer->eventfd = NULL;
+			goto err_free;
+		}
+	}
+
+	xfer->dmabuf = dma_buf_get(queue.fd);
+	if (IS_ERR(xfer->dmabuf)) {
+		ret = PTR_ERR(xfer->dmabuf);
+		xfer->dmabuf = NULL;
+		goto err_free;
+	}
+
+	xfer->attach = dma_buf_attach(xfer->dmabuf,
+				      dmaengine_get_dma_device(chan));
+	if (IS_ERR(xfer->attach)) {
+		ret = PTR_ERR(xfer->attach);
+		xfer->attach = NULL;
+		goto err_free;
+	}
+
+	xfer->sgt = dma_buf_map_attachment_unlocked(xfer->attach, xfer->dir);
+	if (IS_ERR(xfer->sgt)) {
+		ret = PTR_ERR(xfer->sgt);
+		xfer->sgt = NULL;
+		goto err_free;
+	}
+
+	/* Not held across the user copies, mmap() takes it under mmap_lock */
+	mutex_lock(&xdev->cap_lock);
+	if (xdev->removed) {
+		ret = -ENODEV;
+		goto err_unlock;
+	}
+	if (queue.direction == XDMABUF_DIR_RX && xdev->capturing) {
+		ret = -EBUSY;
+		goto err_unlock;
+	}
+
+	txd = dmaengine_prep_slave_sg(chan, xfer->sgt->sgl, xfer->sgt->nents,
+				      dir, DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!txd) {
+		ret = -ENOMEM;
+		goto err_unlock;
+	}
+
+	txd->callback_result = xdmabuf_callback;
+	txd->callback_param = xfer;
+
+	spin_lock_irq(&xdev->lock);
+	list_add_tail(&xfer->node, &xdev->active);
+	cookie = dmaengine_submit(txd);
+	if (dma_submit_error(cookie))
+		list_del(&xfer->node);
+	spin_unlock_irq(&xdev->lock);
+
+	if (dma_submit_error(cookie)) {
+		ret = cookie;
+		goto err_unlock;
+	}
+
+	dma_async_issue_pending(chan);
+	mutex_unlock(&xdev->cap_lock);
+
+	queue.cookie = cookie;
+	if (copy_to_user(arg, &queue, sizeof(queue)))
+		return -EFAULT;
+
+	return 0;
+
+err_unlock:
+	mutex_unlock(&xdev->cap_lock);
+err_free:
+	xdmabuf_xfer_free(xfer);
+	return ret;
+}
+
+static int xdmabuf_status(struct xdmabuf_dev *xdev, void __user *arg)
+{
+	struct xdmabuf_status status;
+	struct dma_chan *chan;
+
+	if (copy_from_user(&status, arg, sizeof(status)))
+		return -EFAULT;
+
+	if (status.direction >= XDMABUF_NUM_DIRS)
+		return -EINVAL;
+
+	chan = xdev->chan[status.direction];
+	if (!chan)
+		return -ENODEV;
+
+	switch (dmaengine_tx_status(chan, status.cookie, NULL)) {
+	case DMA_COMPLETE:
+		status.status = XDMABUF_STATUS_COMPLETE;
+		break;
+	case DMA_ERROR:
+		status.status = XDMABUF_STATUS_ERROR;
+		break;
+	default:
+		status.status = XDMABUF_STATUS_IN_PROGRESS;
+		break;
+	}
+
+	spin_lock_irq(&xdev->lock);
+	status.errors = xdev->errors[status.direction];
+	spin_unlock_irq(&xdev->lock);
+
+	if (copy_to_user(arg, &status, sizeof(status)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static void xdmabuf_capture_callback(void *param,
+				     const struct dmaengine_result *result)
+{
+	struct xdmabuf_dev *xdev = param;
+	struct xdmabuf_ring *ring = xdev->cap_ring;
+	u32 n = ring->num_periods;
+	u32 period, head, tail, lost, old_lost;
+
+	/* The period the engine is filling now, the ones before it are done */
+	period = (xdev->cap_size - result->residue) / ring->period_size;
+	period = min(period, n - 1);
+
+	head = ring->head + (period + n - xdev->cap_period) % n;
+	xdev->cap_period = period;
+
+	tail = READ_ONCE(ring->tail);
+	old_lost = ring->head - tail > n ? ring->head - tail - n : 0;
+	lost = head - tail > n ? head - tail - n : 0;
+	if (lost > old_lost)
+		WRITE_ONCE(ring->overruns, ring->overruns + lost - old_lost);
+
+	/* Publish the indices after the period data */
+	smp_store_release(&ring->head, head);
+
+	if (xdev->cap_eventfd)
+		eventfd_signal(xdev->cap_eventfd, 1);
+}
+
+/*
+ * Release the state of a stopped capture.  A ring still mapped by userspace
+ * is kept for the next capture, mappings pin the file so it is freed at the
+ * latest on release.
+ */
+static void xdmabuf_capture_free(struct xdmabuf_dev *xdev)
+{
+	if (xdev->cap_eventfd)
+		eventfd_ctx_put(xdev->cap_eventfd);
+	xdev->cap_eventfd = NULL;
+
+	if (atomic_read(&xdev->cap_maps))
+		return;
+
+	if (xdev->cap_buf)
+		dma_free_coherent(dmaengine_get_dma_device(xdev->chan[XDMABUF_DIR_RX]),
+				  xdev->cap_size, xdev->cap_buf, xdev->cap_dma);
+	xdev->cap_buf = NULL;
+	free_page((unsigned long)xdev->cap_ring);
+	xdev->cap_ring = NULL;
+}
+
+static int xdmabuf_capture_start(struct xdmabuf_dev *xdev, void __user *arg)
+{
+	struct dma_chan *chan = xdev->chan[XDMABUF_DIR_RX];
+	struct dma_async_tx_descriptor *txd;
+	struct xdmabuf_capture capture;
+	struct xdmabuf_xfer *xfer;
+	dma_cookie_t cookie;
+	size_t size;
+	int ret = 0;
+
+	if (copy_from_user(&capture, arg, sizeof(capture)))
+		return -EFAULT;
+
+	if (capture.flags || !capture.period_size || capture.num_periods < 2)
+		return -EINVAL;
+
+	if (check_mul_overflow((size_t)capture.period_size,
+			       (size_t)capture.num_periods, &size))
+		return -EINVAL;
+
+	if (!chan)
+		return -ENODEV;
+
+	mutex_lock(&xdev->cap_lock);
+
+	if (xdev->removed) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	if (xdev->capturing) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	/* Any transfers queued to the channel must have completed */
+	spin_lock_irq(&xdev->lock);
+	list_for_each_entry(xfer, &xdev->active, node)
+		if (xfer->index == XDMABUF_DIR_RX)
+			ret = -EBUSY;
+	spin_unlock_irq(&xdev->lock);
+	if (ret)
+		goto out_unlock;
+
+	/*
+	 * A ring left over by the last capture was still mapped when it
+	 * stopped.  It is restarted if it has the requested geometry, and
+	 * only replaced once userspace has unmapped it otherwise.
+	 */
+	if (xdev->cap_ring) {
+		if (xdev->cap_ring->period_size != capture.period_size ||
+		    xdev->cap_ring->num_periods != capture.num_periods) {
+			ret = atomic_read(&xdev->cap_maps) ? -EBUSY : 0;
+			if (ret)
+				goto out_unlock;
+			xdmabuf_capture_free(xdev);
+		}
+	}
+
+	if (capture.eventfd >= 0) {
+		xdev->cap_eventfd = eventfd_ctx_fdget(capture.eventfd);
+		if (IS_ERR(xdev->cap_eventfd)) {
+			ret = PTR_ERR(xdev->cap_eventfd);
+			xdev->cap_eventfd = NULL;
+			goto out_unlock;
+		}
+	}
+
+	if (xdev->cap_ring) {
+		memset(xdev->cap_ring, 0, PAGE_SIZE);
+	} else {
+		xdev->cap_ring =
+			(struct xdmabuf_ring *)get_zeroed_page(GFP_KERNEL);
+		if (!xdev->cap_ring) {
+			ret = -ENOMEM;
+			goto err_free;
+		}
+
+		xdev->cap_size = size;
+		xdev->cap_buf = dma_alloc_coherent(dmaengine_get_dma_device(chan),
+						   size, &xdev->cap_dma,
+						   GFP_KERNEL);
+		if (!xdev->cap_buf) {
+			ret = -ENOMEM;
+			goto err_free;
+		}
+	}
+	xdev->cap_ring->period_size = capture.period_size;
+	xdev->cap_ring->num_periods = capture.num_periods;
+	xdev->cap_period = 0;
+
+	txd = dmaengine_prep_dma_cyclic(chan, xdev->cap_dma, size,
+					capture.period_size, DMA_DEV_TO_MEM,
+					DMA_PREP_INTERRUPT);
+	if (!txd) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	txd->callback_result = xdmabuf_capture_callback;
+	txd->callback_param = xdev;
+
+	cookie = dmaengine_submit(txd);
+	if (dma_submit_error(cookie)) {
+		ret = cookie;
+		goto err_free;
+	}
+
+	xdev->capturing = true;
+	dma_async_issue_pending(chan);
+	mutex_unlock(&xdev->cap_lock);
+
+	capture.ring_offset = (u64)XDMABUF_RING_PGOFF << PAGE_SHIFT;
+	capture.data_offset = (u64)XDMABUF_DATA_PGOFF << PAGE_SHIFT;
+	if (copy_to_user(arg, &capture, sizeof(capture)))
+		return -EFAULT;
+
+	return 0;
+
+err_free:
+	xdmabuf_capture_free(xdev);
+out_unlock:
+	mutex_unlock(&xdev->cap_lock);
+	return ret;
+}
+
+static int xdmabuf_capture_stop(struct xdmabuf_dev *xdev)
+{
+	mutex_lock(&xdev->cap_lock);
+	if (xdev->capturing) {
+		dmaengine_terminate_sync(xdev->chan[XDMABUF_DIR_RX]);
+		xdev->capturing = false;
+		xdmabuf_capture_free(xdev);
+	}
+	mutex_unlock(&xdev->cap_lock);
+
+	return 0;
+}
+
+static void xdmabuf_vm_open(struct vm_area_struct *vma)
+{
+	struct xdmabuf_dev *xdev = vma->vm_private_data;
+
+	atomic_inc(&xdev->cap_maps);
+	kref_get(&xdev->ref);
+}
+
+static void xdmabuf_vm_close(struct vm_area_struct *vma)
+{
+	struct xdmabuf_dev *xdev = vma->vm_private_data;
+
+	atomic_dec(&xdev->cap_maps);
+	kref_put(&xdev->ref, xdmabuf_free);
+}
+
+static const struct vm_operations_struct xdmabuf_vm_ops = {
+	.open = xdmabuf_vm_open,
+	.close = xdmabuf_vm_close,
+};
+
+static int xdmabuf_mmap(struct file *fptr, struct vm_area_struct *vma)
+{
+	struct xdmabuf_dev *xdev = container_of(fptr->private_data,
+						struct xdmabuf_dev, miscdev);
+	int ret = -EINVAL;
+
+	mutex_lock(&xdev->cap_lock);
+	if (xdev->removed) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+	if (!xdev->cap_ring)
+		goto out_unlock;
+
+	switch (vma->vm_pgoff) {
+	case XDMABUF_RING_PGOFF:
+		if (vma->vm_end - vma->vm_start != PAGE_SIZE)
+			break;
+		ret = remap_pfn_range(vma, vma->vm_start,
+				      virt_to_phys(xdev->cap_ring) >> PAGE_SHIFT,
+				      PAGE_SIZE, vma->vm_page_prot);
+		break;
+	case XDMABUF_DATA_PGOFF:
+		vma->vm_pgoff = 0;
+		ret = dma_mmap_coherent(dmaengine_get_dma_device(xdev->chan[XDMABUF_DIR_RX]),
+					vma, xdev->cap_buf, xdev->cap_dma,
+					xdev->cap_size);
+		break;
+	}
+
+	if (!ret) {
+		vma->vm_ops = &xdmabuf_vm_ops;
+		vma->vm_private_data = xdev;
+		xdmabuf_vm_open(vma);
+	}
+
+out_unlock:
+	mutex_unlock(&xdev->cap_lock);
+	return ret;
+}
+
+static long xdmabuf_ioctl(struct file *fptr, unsigned int cmd,
+			  unsigned long data)
+{
+	struct xdmabuf_dev *xdev = container_of(fptr->private_data,
+						struct xdmabuf_dev, miscdev);
+	void __user *arg = (void __user *)data;
+
+	if (READ_ONCE(xdev->removed))
+		return -ENODEV;
+
+	switch (cmd) {
+	case XDMABUF_IOCTL_QUEUE:
+		return xdmabuf_queue(xdev, arg);
+	case XDMABUF_IOCTL_STATUS:
+		return xdmabuf_status(xdev, arg);
+	case XDMABUF_IOCTL_CAPTURE_START:
+		return xdmabuf_capture_start(xdev, arg);
+	case XDMABUF_IOCTL_CAPTURE_STOP:
+		return xdmabuf_capture_stop(xdev);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int xdmabuf_open(struct inode *iptr, struct file *fptr)
+{
+	struct xdmabuf_dev *xdev = container_of(fptr->private_data,
+						struct xdmabuf_dev, miscdev);
+
+	/* The channels are shared, a second opener could stall the first */
+	if (test_and_set_bit(0, &xdev->busy))
+		return -EBUSY;
+
+	kref_get(&xdev->ref);
+
+	return 0;
+}
+
+static int xdmabuf_release(struct inode *iptr, struct file *fptr)
+{
+	struct xdmabuf_dev *xdev = container_of(fptr->private_data,
+						struct xdmabuf_dev, miscdev);
+	LIST_HEAD(list);
+	int i;
+
+	/* No callback runs once the channels are terminated */
+	for (i = 0; i < XDMABUF_NUM_DIRS; i++)
+		if (xdev->chan[i])
+			dmaengine_terminate_sync(xdev->chan[i]);
+
+	cancel_work_sync(&xdev->work);
+
+	spin_lock_irq(&xdev->lock);
+	list_splice_init(&xdev->active, &list);
+	list_splice_init(&xdev->done, &list);
+	memset(xdev->errors, 0, sizeof(xdev->errors));
+	spin_unlock_irq(&xdev->lock);
+
+	xdmabuf_free_list(&list);
+
+	/* The file pins any mapping, so the capture ring is unused now */
+	xdev->capturing = false;
+	xdmabuf_capture_free(xdev);
+
+	clear_bit_unlock(0, &xdev->busy);
+	kref_put(&xdev->ref, xdmabuf_free);
+
+	return 0;
+}
+
+static const struct file_operations xdmabuf_fops = {
+	.owner = THIS_MODULE,
+	.open = xdmabuf_open,
+	.release = xdmabuf_release,
+	.unlocked_ioctl = xdmabuf_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap = xdmabuf_mmap,
+};
+
+static struct dma_chan *xdmabuf_request_chan(struct device *dev,
+					     const char *name)
+{
+	struct dma_chan *chan = dma_request_chan(dev, name);
+
+	/* Either channel may be left out for a single direction stream */
+	if (chan == ERR_PTR(-ENODEV))
+		return NULL;
+
+	return chan;
+}
+
+static int xdmabuf_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct xdmabuf_dev *xdev;
+	int err, i;
+
+	xdev = kzalloc(sizeof(*xdev), GFP_KERNEL);
+	if (!xdev)
+		return -ENOMEM;
+
+	kref_init(&xdev->ref);
+	xdev->dev = dev;
+	spin_lock_init(&xdev->lock);
+	mutex_init(&xdev->cap_lock);
+	INIT_LIST_HEAD(&xdev->active);
+	INIT_LIST_HEAD(&xdev->done);
+	INIT_WORK(&xdev->work, xdmabuf_work);
+
+	xdev->chan[XDMABUF_DIR_TX] = xdmabuf_request_chan(dev, "tx");
+	if (IS_ERR(xdev->chan[XDMABUF_DIR_TX])) {
+		err = dev_err_probe(dev, PTR_ERR(xdev->chan[XDMABUF_DIR_TX]),
+				    "failed to request tx channel\n");
+		goto err_free;
+	}
+
+	xdev->chan[XDMABUF_DIR_RX] = xdmabuf_request_chan(dev, "rx");
+	if (IS_ERR(xdev->chan[XDMABUF_DIR_RX])) {
+		err = dev_err_probe(dev, PTR_ERR(xdev->chan[XDMABUF_DIR_RX]),
+				    "failed to request rx channel\n");
+		xdev->chan[XDMABUF_DIR_RX] = NULL;
+		goto err_release;
+	}
+
+	if (!xdev->chan[XDMABUF_DIR_TX] && !xdev->chan[XDMABUF_DIR_RX]) {
+		dev_err(dev, "no DMA channels\n");
+		err = -ENODEV;
+		goto err_free;
+	}
+
+	err = ida_alloc(&dev_nrs, GFP_KERNEL);
+	if (err < 0)
+		goto err_release;
+	xdev->dev_id = err;
+
+	snprintf(xdev->dev_name, DEV_NAME_LEN, "xdmabuf%d", xdev->dev_id);
+	xdev->miscdev.minor = MISC_DYNAMIC_MINOR;
+	xdev->miscdev.name = xdev->dev_name;
+	xdev->miscdev.fops = &xdmabuf_fops;
+	xdev->miscdev.parent = dev;
+	err = misc_register(&xdev->miscdev);
+	if (err) {
+		dev_err(dev, "error:%d. Unable to register device", err);
+		goto err_ida;
+	}
+
+	platform_set_drvdata(pdev, xdev);
+
+	return 0;
+
+err_ida:
+	ida_free(&dev_nrs, xdev->dev_id);
+err_release:
+	for (i = 0; i < XDMABUF_NUM_DIRS; i++)
+		if (xdev->chan[i])
+			dma_release_channel(xdev->chan[i]);
+err_free:
+	kfree(xdev);
+	return err;
+}
+
+static int xdmabuf_remove(struct platform_device *pdev)
+{
+	struct xdmabuf_dev *xdev = platform_get_drvdata(pdev);
+	int i;
+
+	/* No new opener once the misc device is gone */
+	misc_deregister(&xdev->miscdev);
+
+	/*
+	 * Stop the capture and any transfer, and fail any further file
+	 * operation.  An open file or a mapping of the capture ring keeps
+	 * xdev and the channels until it is closed, the ring and the
+	 * transfers are freed on release as usual.
+	 */
+	mutex_lock(&xdev->cap_lock);
+	WRITE_ONCE(xdev->removed, true);
+	for (i = 0; i < XDMABUF_NUM_DIRS; i++)
+		if (xdev->chan[i])
+			dmaengine_terminate_sync(xdev->chan[i]);
+	xdev->capturing = false;
+	mutex_unlock(&xdev->cap_lock);
+
+	kref_put(&xdev->ref, xdmabuf_free);
+
+	return 0;
+}
+
+static const struct of_device_id xdmabuf_of_ids[] = {
+	{ .compatible = "xlnx,axi-dma-buf-1.0", },
+	{}
+};
+MODULE_DEVICE_TABLE(of, xdmabuf_of_ids);
+
+static struct platform_driver xdmabuf_driver = {
+	.driver = {
+		.name = "xilinx-dmabuf",
+		.of_match_table = xdmabuf_of_ids,
+	},
+	.probe = xdmabuf_probe,
+	.remove = xdmabuf_remove,
+};
+
+module_platform_driver(xdmabuf_driver);
+
+MODULE_IMPORT_NS(DMA_BUF);
+MODULE_AUTHOR("Xilinx, Inc.");
+MODULE_DESCRIPTION("Xilinx AXI DMA dma-buf streaming interface");
+MODULE_LICENSE("GPL");
@@ -26,6 +26,7 @@
 #include <linux/wait.h>
 
 #include <dt-bindings/dma/xlnx-zynqmp-dpdma.h>
+#include <trace/events/xilinx_dma.h>
 
 #include "../dmaengine.h"
 #include "../virt-dma.h"
@@ -135,6 +136,7 @@
 #define XILINX_DPDMA_LINESIZE_ALIGN_BITS		128
 
 #define XILINX_DPDMA_NUM_CHAN				6
+#define XILINX_DPDMA_DESC_CACHE_DEPTH			4
 
 struct xilinx_dpdma_chan;
 
@@ -194,12 +196,15 @@ struct xilinx_dpdma_sw_desc {
  * @chan: DMA channel
  * @descriptors: list of software descriptors
  * @error: an error has been detected with this descriptor
+ * @frame: single frame interleaved descriptor, recycled through the channel
+ *	   descriptor cache when freed
  */
 struct xilinx_dpdma_tx_desc {
 	struct virt_dma_desc vdesc;
 	struct xilinx_dpdma_chan *chan;
 	struct list_head descriptors;
 	bool error;
+	bool frame;
 };
 
 #define to_dpdma_tx_desc(_desc) \
@@ -218,6 +223,11 @@ struct xilinx_dpdma_tx_desc {
  *        @vchan.lock, if both are to be held.
  * @desc_pool: descriptor allocation pool
  * @err_task: error IRQ bottom half handler
+ * @err_wait: true while @err_task waits for outstanding transactions to drain
+ * @err_timeout: jiffies after which @err_task stops waiting for the drain
+ * @cache_lock: lock to access @desc_cache and @cache_cnt
+ * @desc_cache: freed frame descriptors kept for reuse by later frames
+ * @cache_cnt: number of descriptors in @desc_cache
  * @desc: References to descriptors being processed
  * @desc.pending: Descriptor schedule to the hardware, pending execution
  * @desc.active: Descriptor being executed by the hardware
@@ -236,6 +246,12 @@ struct xilinx_dpdma_chan {
 	spinlock_t lock; /* lock to access struct xilinx_dpdma_chan */
 	struct dma_pool *desc_pool;
 	struct tasklet_struct err_task;
+	bool err_wait;
+	unsigned long err_timeout;
+
+	spinlock_t cache_lock; /* lock to access the descriptor cache */
+	struct list_head desc_cache;
+	unsigned int cache_cnt;
 
 	struct {
 		struct xilinx_dpdma_tx_desc *pending;
@@ -257,6 +273,11 @@ struct xilinx_dpdma_chan {
  * @axi_clk: axi clock
  * @chan: DPDMA channels
  * @ext_addr: flag for 64 bit system (48 bit addressing)
+ * @batch: Grouped commit state, see xilinx_dpdma_batch_begin()
+ * @batch.lock: lock to access @batch, nests inside the channel locks
+ * @batch.depth: number of open batches, triggers are deferred while non-zero
+ * @batch.trig: channels to trigger when the batch is committed
+ * @batch.retrig: channels to retrigger when the batch is committed
  */
 struct xilinx_dpdma_device {
 	struct dma_device common;
@@ -268,6 +289,13 @@ struct xilinx_dpdma_device {
 	struct xilinx_dpdma_chan *chan[XILINX_DPDMA_NUM_CHAN];
 
 	bool ext_addr;
+
+	struct {
+		spinlock_t lock; /* lock to access @batch */
+		unsigned int depth;
+		u32 trig;
+		u32 retrig;
+	} batch;
 };
 
 /* -----------------------------------------------------------------------------
@@ -646,28 +674,146 @@ xilinx_dpdma_chan_alloc_tx_desc(struct xilinx_dpdma_chan *chan)
 	return tx_desc;
 }
 
+static void __xilinx_dpdma_chan_free_tx_desc(struct xilinx_dpdma_tx_desc *desc)
+{
+	struct xilinx_dpdma_sw_desc *sw_desc, *next;
+
+	list_for_each_entry_safe(sw_desc, next, &desc->descriptors, node) {
+		list_del(&sw_desc->node);
+		xilinx_dpdma_chan_free_sw_desc(desc->chan, sw_desc);
+	}
+
+	kfree(desc);
+}
+
 /**
  * xilinx_dpdma_chan_free_tx_desc - Free a virtual DMA descriptor
  * @vdesc: virtual DMA descriptor
  *
  * Free the virtual DMA descriptor @vdesc including its software descriptors.
+ * Frame descriptors are kept in the channel descriptor cache instead, up to
+ * XILINX_DPDMA_DESC_CACHE_DEPTH, so that the next frames of the same format
+ * only need their buffer address updated.
  */
 static void xilinx_dpdma_chan_free_tx_desc(struct virt_dma_desc *vdesc)
 {
-	struct xilinx_dpdma_sw_desc *sw_desc, *next;
 	struct xilinx_dpdma_tx_desc *desc;
+	struct xilinx_dpdma_chan *chan;
+	unsigned long flags;
 
 	if (!vdesc)
 		return;
 
 	desc = to_dpdma_tx_desc(vdesc);
+	chan = desc->chan;
+
+	if (desc->frame && !desc->error) {
+		spin_lock_irqsave(&chan->cache_lock, flags);
+		if (chan->cache_cnt < XILINX_DPDMA_DESC_CACHE_DEPTH) {
+			list_add(&desc->vdesc.node, &chan->desc_cache);
+			chan->cache_cnt++;
+			desc = NULL;
+		}
+		spin_unlock_irqrestore(&chan->cache_lock, flags);
 
-	list_for_each_entry_safe(sw_desc, next, &desc->descriptors, node) {
-		list_del(&sw_desc->node);
-		xilinx_dpdma_chan_free_sw_desc(desc->chan, sw_desc);
+		if (!desc)
+			return;
 	}
 
-	kfree(desc);
+	__xilinx_dpdma_chan_free_tx_desc(desc);
+}
+
+/**
+ * xilinx_dpdma_chan_get_cached_desc - Get a frame descriptor from the cache
+ * @chan: DPDMA channel
+ * @xfer_size: transfer size of the frame
+ * @hsize_stride: line size and stride of the frame
+ *
+ * Look up the channel descriptor cache for a frame descriptor with the same
+ * format. Its software descriptor is already linked to itself and only the
+ * payload address needs to be programmed.
+ *
+ * Return: a tx descriptor or NULL.
+ */
+static struct xilinx_dpdma_tx_desc *
+xilinx_dpdma_chan_get_cached_desc(struct xilinx_dpdma_chan *chan,
+				  u32 xfer_size, u32 hsize_stride)
+{
+	struct xilinx_dpdma_tx_desc *desc, *found = NULL;
+	struct xilinx_dpdma_sw_desc *sw_desc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->cache_lock, flags);
+	list_for_each_entry(desc, &chan->desc_cache, vdesc.node) {
+		sw_desc = list_first_entry(&desc->descriptors,
+					   struct xilinx_dpdma_sw_desc, node);
+		if (sw_desc->hw.xfer_size == xfer_size &&
+		    sw_desc->hw.hsize_stride == hsize_stride) {
+			list_del(&desc->vdesc.node);
+			chan->cache_cnt--;
+			found = desc;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&chan->cache_lock, flags);
+
+	return found;
+}
+
+/**
+ * xilinx_dpdma_chan_drain_desc_cache - Free all cached frame descriptors
+ * @chan: DPDMA channel
+ */
+static void xilinx_dpdma_chan_drain_desc_cache(struct xilinx_dpdma_chan *chan)
+{
+	struct xilinx_dpdma_tx_desc *desc, *next;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&chan->cache_lock, flags);
+	list_splice_init(&chan->desc_cache, &list);
+	chan->cache_cnt = 0;
+	spin_unlock_irqrestore(&chan->cache_lock, flags);
+
+	list_for_each_entry_safe(desc, next, &list, vdesc.node)
+		__xilinx_dpdma_chan_free_tx_desc(desc);
+}
+
+/**
+ * xilinx_dpdma_tx_desc_len - Total transfer size of a tx descriptor
+ * @desc: tx descriptor
+ *
+ * Return: the sum of the transfer sizes of the hardware descriptors.
+ */
+static size_t xilinx_dpdma_tx_desc_len(struct xilinx_dpdma_tx_desc *desc)
+{
+	struct xilinx_dpdma_sw_desc *sw_desc;
+	size_t len = 0;
+
+	list_for_each_entry(sw_desc, &desc->descriptors, node)
+		len += sw_desc->hw.xfer_size;
+
+	return len;
+}
+
+/**
+ * xilinx_dpdma_tx_submit - Submit a tx descriptor to the virtual channel
+ * @tx: async transaction descriptor
+ *
+ * Return: the cookie assigned to @tx.
+ */
+static dma_cookie_t xilinx_dpdma_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct virt_dma_desc *vdesc = container_of(tx, struct virt_dma_desc, tx);
+	struct xilinx_dpdma_tx_desc *desc = to_dpdma_tx_desc(vdesc);
+	dma_cookie_t cookie;
+
+	cookie = vchan_tx_submit(tx);
+	if (trace_xilinx_dma_submit_enabled())
+		trace_xilinx_dma_submit(tx->chan, cookie,
+					xilinx_dpdma_tx_desc_len(desc));
+
+	return cookie;
 }
 
 /**
@@ -740,7 +886,10 @@ xilinx_dpdma_chan_prep_cyclic(struct xilinx_dpdma_chan *chan,
 
 	last->hw.control |= XILINX_DPDMA_DESC_CONTROL_LAST_OF_FRAME;
 
-	return vchan_tx_prep(&chan->vchan, &tx_desc->vdesc, flags);
+	vchan_tx_prep(&chan->vchan, &tx_desc->vdesc, flags);
+	tx_desc->vdesc.tx.tx_submit = xilinx_dpdma_tx_submit;
+
+	return &tx_desc->vdesc.tx;
 
 error:
 	xilinx_dpdma_chan_free_tx_desc(&tx_desc->vdesc);
@@ -768,6 +917,7 @@ xilinx_dpdma_chan_prep_interleaved_dma(struct xilinx_dpdma_chan *chan,
 	struct xilinx_dpdma_hw_desc *hw_desc;
 	size_t hsize = xt->sgl[0].size;
 	size_t stride = hsize + xt->sgl[0].icg;
+	u32 xfer_size, hsize_stride;
 
 	if (!IS_ALIGNED(xt->src_start, XILINX_DPDMA_ALIGN_BYTES)) {
 		dev_err(chan->xdev->dev,
@@ -776,6 +926,28 @@ xilinx_dpdma_chan_prep_interleaved_dma(struct xilinx_dpdma_chan *chan,
 		return NULL;
 	}
 
+	hsize = ALIGN(hsize, XILINX_DPDMA_LINESIZE_ALIGN_BITS / 8);
+	xfer_size = hsize * xt->numf;
+	hsize_stride =
+		FIELD_PREP(XILINX_DPDMA_DESC_HSIZE_STRIDE_HSIZE_MASK, hsize) |
+		FIELD_PREP(XILINX_DPDMA_DESC_HSIZE_STRIDE_STRIDE_MASK,
+			   stride / 16);
+
+	/* Reuse a descriptor of the same format, only patch the address. */
+	tx_desc = xilinx_dpdma_chan_get_cached_desc(chan, xfer_size,
+						    hsize_stride);
+	if (tx_desc) {
+		/* Don't carry the callbacks of the previous frame over. */
+		memset(&tx_desc->vdesc, 0, sizeof(tx_desc->vdesc));
+
+		sw_desc = list_first_entry(&tx_desc->descriptors,
+					   struct xilinx_dpdma_sw_desc, node);
+		sw_desc->hw.addr_ext &= ~XILINX_DPDMA_DESC_ADDR_EXT_SRC_ADDR_MASK;
+		xilinx_dpdma_sw_desc_set_dma_addrs(chan->xdev, sw_desc, NULL,
+						   &xt->src_start, 1);
+		return tx_desc;
+	}
+
 	tx_desc = xilinx_dpdma_chan_alloc_tx_desc(chan);
 	if (!tx_desc)
 		return NULL;
@@ -790,18 +962,15 @@ xilinx_dpdma_chan_prep_interleaved_dma(struct xilinx_dpdma_chan *chan,
 					   &xt->src_start, 1);
 
 	hw_desc = &sw_desc->hw;
-	hsize = ALIGN(hsize, XILINX_DPDMA_LINESIZE_ALIGN_BITS / 8);
-	hw_desc->xfer_size = hsize * xt->numf;
-	hw_desc->hsize_stride =
-		FIELD_PREP(XILINX_DPDMA_DESC_HSIZE_STRIDE_HSIZE_MASK, hsize) |
-		FIELD_PREP(XILINX_DPDMA_DESC_HSIZE_STRIDE_STRIDE_MASK,
-			   stride / 16);
+	hw_desc->xfer_size = xfer_size;
+	hw_desc->hsize_stride = hsize_stride;
 	hw_desc->control |= XILINX_DPDMA_DESC_CONTROL_PREEMBLE;
 	hw_desc->control |= XILINX_DPDMA_DESC_CONTROL_COMPLETE_INTR;
 	hw_desc->control |= XILINX_DPDMA_DESC_CONTROL_IGNORE_DONE;
 	hw_desc->control |= XILINX_DPDMA_DESC_CONTROL_LAST_OF_FRAME;
 
 	list_add_tail(&sw_desc->node, &tx_desc->descriptors);
+	tx_desc->frame = true;
 
 	return tx_desc;
 }
@@ -894,6 +1063,36 @@ static u32 xilinx_dpdma_chan_video_group_ready(struct xilinx_dpdma_chan *chan)
 	return channels;
 }
 
+/**
+ * xilinx_dpdma_trigger - Trigger or retrigger a set of channels
+ * @xdev: DPDMA device
+ * @channels: mask of the channels to trigger
+ * @first_frame: trigger the channels if true, retrigger them otherwise
+ *
+ * Write the global trigger register for @channels, or record them in the open
+ * batch to be written by xilinx_dpdma_batch_commit().
+ */
+static void xilinx_dpdma_trigger(struct xilinx_dpdma_device *xdev,
+				 u32 channels, bool first_frame)
+{
+	spin_lock(&xdev->batch.lock);
+
+	if (xdev->batch.depth) {
+		if (first_frame)
+			xdev->batch.trig |= channels;
+		else
+			xdev->batch.retrig |= channels;
+	} else if (first_frame) {
+		dpdma_write(xdev->reg, XILINX_DPDMA_GBL,
+			    XILINX_DPDMA_GBL_TRIG_MASK(channels));
+	} else {
+		dpdma_write(xdev->reg, XILINX_DPDMA_GBL,
+			    XILINX_DPDMA_GBL_RETRIG_MASK(channels));
+	}
+
+	spin_unlock(&xdev->batch.lock);
+}
+
 /**
  * xilinx_dpdma_chan_queue_transfer - Queue the next transfer
  * @chan: DPDMA channel
@@ -907,7 +1106,7 @@ static void xilinx_dpdma_chan_queue_transfer(struct xilinx_dpdma_chan *chan)
 	struct xilinx_dpdma_sw_desc *sw_desc;
 	struct xilinx_dpdma_tx_desc *desc;
 	struct virt_dma_desc *vdesc;
-	u32 reg, channels;
+	u32 channels;
 	bool first_frame;
 
 	lockdep_assert_held(&chan->lock);
@@ -947,6 +1146,10 @@ static void xilinx_dpdma_chan_queue_transfer(struct xilinx_dpdma_chan *chan)
 			    FIELD_PREP(XILINX_DPDMA_CH_DESC_START_ADDRE_MASK,
 				       upper_32_bits(sw_desc->dma_addr)));
 
+	if (trace_xilinx_dma_start_enabled())
+		trace_xilinx_dma_start(&chan->vchan.chan, desc->vdesc.tx.cookie,
+				       xilinx_dpdma_tx_desc_len(desc));
+
 	first_frame = chan->first_frame;
 	chan->first_frame = false;
 
@@ -962,12 +1165,7 @@ static void xilinx_dpdma_chan_queue_transfer(struct xilinx_dpdma_chan *chan)
 		channels = BIT(chan->id);
 	}
 
-	if (first_frame)
-		reg = XILINX_DPDMA_GBL_TRIG_MASK(channels);
-	else
-		reg = XILINX_DPDMA_GBL_RETRIG_MASK(channels);
-
-	dpdma_write(xdev->reg, XILINX_DPDMA_GBL, reg);
+	xilinx_dpdma_trigger(xdev, channels, first_frame);
 }
 
 /**
@@ -1052,35 +1250,45 @@ static int xilinx_dpdma_chan_wait_no_ostand(struct xilinx_dpdma_chan *chan)
 }
 
 /**
- * xilinx_dpdma_chan_poll_no_ostand - Poll the outstanding transaction status
+ * xilinx_dpdma_chan_err_drain - Check for outstanding transactions on error
  * @chan: DPDMA channel
  *
- * Poll the outstanding transaction status, and return when there's no
- * outstanding transaction. This functions can be used in the interrupt context
- * or where the atomicity is required. Calling thread may wait more than 50ms.
+ * Check whether the outstanding transactions have drained before handling an
+ * error. Instead of polling, arm the 'no outstanding' interrupt and let the
+ * interrupt handler reschedule the error tasklet, either when the transactions
+ * have drained or, with the VSYNC interrupt as a tick, once 50ms (20 fps) have
+ * elapsed. This must be called from the error tasklet only.
  *
- * Return: 0 on success, or -ETIMEDOUT.
+ * Return: true if the error handling must wait, or false if it can proceed.
  */
-static int xilinx_dpdma_chan_poll_no_ostand(struct xilinx_dpdma_chan *chan)
+static bool xilinx_dpdma_chan_err_drain(struct xilinx_dpdma_chan *chan)
 {
-	u32 cnt, loop = 50000;
-
-	/* Poll at least for 50ms (20 fps). */
-	do {
-		cnt = xilinx_dpdma_chan_ostand(chan);
-		udelay(1);
-	} while (loop-- > 0 && cnt);
+	if (!xilinx_dpdma_chan_ostand(chan))
+		goto done;
 
-	if (loop) {
+	if (!chan->err_wait) {
+		chan->err_timeout = jiffies + msecs_to_jiffies(50);
+		WRITE_ONCE(chan->err_wait, true);
 		dpdma_write(chan->xdev->reg, XILINX_DPDMA_IEN,
 			    XILINX_DPDMA_INTR_NO_OSTAND(chan->id));
-		return 0;
+
+		/* The transactions may have drained before the IRQ was armed. */
+		if (xilinx_dpdma_chan_ostand(chan))
+			return true;
+		goto done;
 	}
 
+	if (time_before(jiffies, chan->err_timeout))
+		return true;
+
 	dev_err(chan->xdev->dev, "chan%u: not ready to stop: %d trans\n",
 		chan->id, xilinx_dpdma_chan_ostand(chan));
 
-	return -ETIMEDOUT;
+done:
+	WRITE_ONCE(chan->err_wait, false);
+	dpdma_write(chan->xdev->reg, XILINX_DPDMA_IEN,
+		    XILINX_DPDMA_INTR_NO_OSTAND(chan->id));
+	return false;
 }
 
 /**
@@ -1148,7 +1356,7 @@ static void xilinx_dpdma_chan_done_irq(struct xilinx_dpdma_chan *chan)
  */
 static void xilinx_dpdma_chan_vsync_irq(struct  xilinx_dpdma_chan *chan)
 {
-	struct xilinx_dpdma_tx_desc *pending;
+	struct xilinx_dpdma_tx_desc *pending, *active;
 	struct xilinx_dpdma_sw_desc *sw_desc;
 	unsigned long flags;
 	u32 desc_id;
@@ -1177,8 +1385,15 @@ static void xilinx_dpdma_chan_vsync_irq(struct  xilinx_dpdma_chan *chan)
 	 * descriptor to active, and queue the next transfer, if any.
 	 */
 	spin_lock(&chan->vchan.lock);
-	if (chan->desc.active)
-		vchan_cookie_complete(&chan->desc.active->vdesc);
+	active = chan->desc.active;
+	if (active) {
+		if (trace_xilinx_dma_complete_enabled())
+			trace_xilinx_dma_complete(&chan->vchan.chan,
+						  active->vdesc.tx.cookie,
+						  xilinx_dpdma_tx_desc_len(active),
+						  DMA_TRANS_NOERROR);
+		vchan_cookie_complete(&active->vdesc);
+	}
 	chan->desc.active = pending;
 	chan->desc.pending = NULL;
 
@@ -1309,6 +1524,7 @@ xilinx_dpdma_prep_interleaved_dma(struct dma_chan *dchan,
 		return NULL;
 
 	vchan_tx_prep(&chan->vchan, &desc->vdesc, flags | DMA_CTRL_ACK);
+	desc->vdesc.tx.tx_submit = xilinx_dpdma_tx_submit;
 
 	return &desc->vdesc.tx;
 }
@@ -1352,6 +1568,7 @@ static void xilinx_dpdma_free_chan_resources(struct dma_chan *dchan)
 	struct xilinx_dpdma_chan *chan = to_xilinx_chan(dchan);
 
 	vchan_free_chan_resources(&chan->vchan);
+	xilinx_dpdma_chan_drain_desc_cache(chan);
 
 	dma_pool_destroy(chan->desc_pool);
 	chan->desc_pool = NULL;
@@ -1362,6 +1579,8 @@ static void xilinx_dpdma_issue_pending(struct dma_chan *dchan)
 	struct xilinx_dpdma_chan *chan = to_xilinx_chan(dchan);
 	unsigned long flags;
 
+	trace_xilinx_dma_issue_pending(dchan);
+
 	spin_lock_irqsave(&chan->lock, flags);
 	spin_lock(&chan->vchan.lock);
 	if (vchan_issue_pending(&chan->vchan))
@@ -1436,8 +1655,11 @@ static int xilinx_dpdma_terminate_all(struct dma_chan *dchan)
 	struct xilinx_dpdma_device *xdev = chan->xdev;
 	LIST_HEAD(descriptors);
 	unsigned long flags;
+	u32 channels = 0;
 	unsigned int i;
 
+	trace_xilinx_dma_terminate(dchan);
+
 	/* Pause the channel (including the whole video group if applicable). */
 	if (chan->video_group) {
 		for (i = ZYNQMP_DPDMA_VIDEO0; i <= ZYNQMP_DPDMA_VIDEO2; i++) {
@@ -1445,12 +1667,20 @@ static int xilinx_dpdma_terminate_all(struct dma_chan *dchan)
 			    xdev->chan[i]->running) {
 				xilinx_dpdma_chan_pause(xdev->chan[i]);
 				xdev->chan[i]->video_group = false;
+				channels |= BIT(i);
 			}
 		}
 	} else {
 		xilinx_dpdma_chan_pause(chan);
+		channels = BIT(chan->id);
 	}
 
+	/* Don't let an open batch retrigger the paused channels. */
+	spin_lock_irqsave(&xdev->batch.lock, flags);
+	xdev->batch.trig &= ~channels;
+	xdev->batch.retrig &= ~channels;
+	spin_unlock_irqrestore(&xdev->batch.lock, flags);
+
 	/* Gather all the descriptors we can free and free them. */
 	spin_lock_irqsave(&chan->vchan.lock, flags);
 	vchan_get_all_descriptors(&chan->vchan, &descriptors);
@@ -1495,6 +1725,65 @@ static void xilinx_dpdma_synchronize(struct dma_chan *dchan)
 	vchan_synchronize(&chan->vchan);
 }
 
+/**
+ * xilinx_dpdma_batch_begin - Open a grouped commit
+ * @dchan: DMA channel of the DPDMA device
+ *
+ * Defer the channel triggers of all transfers subsequently issued on any
+ * channel of the DPDMA device until xilinx_dpdma_batch_commit() is called.
+ * The descriptors are still programmed to the channels as they are issued,
+ * only the write of the global trigger register is held back. This lets a
+ * display driver updating several planes in an atomic commit arm all of their
+ * channels for the same VSYNC. Batches nest, the triggers are released by the
+ * outermost commit.
+ */
+void xilinx_dpdma_batch_begin(struct dma_chan *dchan)
+{
+	struct xilinx_dpdma_device *xdev = to_xilinx_chan(dchan)->xdev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&xdev->batch.lock, flags);
+	xdev->batch.depth++;
+	spin_unlock_irqrestore(&xdev->batch.lock, flags);
+}
+EXPORT_SYMBOL_GPL(xilinx_dpdma_batch_begin);
+
+/**
+ * xilinx_dpdma_batch_commit - Commit a grouped commit
+ * @dchan: DMA channel of the DPDMA device
+ *
+ * Close the batch opened by xilinx_dpdma_batch_begin(). When the outermost
+ * batch is closed, trigger and retrigger all the channels that have been
+ * queued in the meantime with a single write of the global trigger register,
+ * so that the new frames are latched by the hardware at the same VSYNC.
+ */
+void xilinx_dpdma_batch_commit(struct dma_chan *dchan)
+{
+	struct xilinx_dpdma_device *xdev = to_xilinx_chan(dchan)->xdev;
+	unsigned long flags;
+	u32 reg;
+
+	spin_lock_irqsave(&xdev->batch.lock, flags);
+
+	if (WARN_ON(!xdev->batch.depth))
+		goto out_unlock;
+
+	if (--xdev->batch.depth)
+		goto out_unlock;
+
+	reg = XILINX_DPDMA_GBL_TRIG_MASK(xdev->batch.trig) |
+	      XILINX_DPDMA_GBL_RETRIG_MASK(xdev->batch.retrig);
+	if (reg)
+		dpdma_write(xdev->reg, XILINX_DPDMA_GBL, reg);
+
+	xdev->batch.trig = 0;
+	xdev->batch.retrig = 0;
+
+out_unlock:
+	spin_unlock_irqrestore(&xdev->batch.lock, flags);
+}
+EXPORT_SYMBOL_GPL(xilinx_dpdma_batch_commit);
+
 /* -----------------------------------------------------------------------------
  * Interrupt and Tasklet Handling
  */
@@ -1574,9 +1863,10 @@ static void xilinx_dpdma_disable_irq(struct xilinx_dpdma_device *xdev)
  * xilinx_dpdma_chan_err_task - Per channel tasklet for error handling
  * @t: pointer to the tasklet associated with this handler
  *
- * Per channel error handling tasklet. This function waits for the outstanding
- * transaction to complete and triggers error handling. After error handling,
- * re-enable channel error interrupts, and restart the channel if needed.
+ * Per channel error handling tasklet. This function defers error handling
+ * until the outstanding transactions complete, see
+ * xilinx_dpdma_chan_err_drain(). After error handling, re-enable channel error
+ * interrupts, and restart the channel if needed.
  */
 static void xilinx_dpdma_chan_err_task(struct tasklet_struct *t)
 {
@@ -1584,8 +1874,9 @@ static void xilinx_dpdma_chan_err_task(struct tasklet_struct *t)
 	struct xilinx_dpdma_device *xdev = chan->xdev;
 	unsigned long flags;
 
-	/* Proceed error handling even when polling fails. */
-	xilinx_dpdma_chan_poll_no_ostand(chan);
+	/* Proceed error handling even when the drain times out. */
+	if (xilinx_dpdma_chan_err_drain(chan))
+		return;
 
 	xilinx_dpdma_chan_handle_err(chan);
 
@@ -1625,21 +1916,34 @@ static irqreturn_t xilinx_dpdma_irq_handler(int irq, void *data)
 		for (i = 0; i < ARRAY_SIZE(xdev->chan); i++) {
 			struct xilinx_dpdma_chan *chan = xdev->chan[i];
 
-			if (chan)
-				xilinx_dpdma_chan_vsync_irq(chan);
+			if (!chan)
+				continue;
+
+			xilinx_dpdma_chan_vsync_irq(chan);
+
+			/* Let a waiting error tasklet check its timeout. */
+			if (READ_ONCE(chan->err_wait))
+				tasklet_schedule(&chan->err_task);
 		}
 	}
 
 	mask = FIELD_GET(XILINX_DPDMA_INTR_DESC_DONE_MASK, status);
 	if (mask) {
-		for_each_set_bit(i, &mask, ARRAY_SIZE(xdev->chan))
+		for_each_set_bit(i, &mask, ARRAY_SIZE(xdev->chan)) {
+			trace_xilinx_dma_irq(&xdev->chan[i]->vchan.chan, status);
 			xilinx_dpdma_chan_done_irq(xdev->chan[i]);
+		}
 	}
 
 	mask = FIELD_GET(XILINX_DPDMA_INTR_NO_OSTAND_MASK, status);
 	if (mask) {
-		for_each_set_bit(i, &mask, ARRAY_SIZE(xdev->chan))
-			xilinx_dpdma_chan_notify_no_ostand(xdev->chan[i]);
+		for_each_set_bit(i, &mask, ARRAY_SIZE(xdev->chan)) {
+			struct xilinx_dpdma_chan *chan = xdev->chan[i];
+
+			if (!xilinx_dpdma_chan_notify_no_ostand(chan) &&
+			    READ_ONCE(chan->err_wait))
+				tasklet_schedule(&chan->err_task);
+		}
 	}
 
 	mask = status & XILINX_DPDMA_INTR_ERR_ALL;
@@ -1669,6 +1973,8 @@ static int xilinx_dpdma_chan_init(struct xilinx_dpdma_device *xdev,
 	chan->xdev = xdev;
 
 	spin_lock_init(&chan->lock);
+	spin_lock_init(&chan->cache_lock);
+	INIT_LIST_HEAD(&chan->desc_cache);
 	init_waitqueue_head(&chan->wait_to_stop);
 
 	tasklet_setup(&chan->err_task, xilinx_dpdma_chan_err_task);
@@ -1738,6 +2044,7 @@ static int xilinx_dpdma_probe(struct platform_device *pdev)
 
 	xdev->dev = &pdev->dev;
 	xdev->ext_addr = sizeof(dma_addr_t) > 4;
+	spin_lock_init(&xdev->batch.lock);
 
 	INIT_LIST_HEAD(&xdev->common.channels);
 
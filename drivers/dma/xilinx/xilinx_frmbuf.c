@@ -20,6 +20,7 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/dma/xilinx_frmbuf.h>
+#include <linux/dma-fence.h>
 #include <linux/dmapool.h>
 #include <linux/gpio/consumer.h>
 #include <linux/init.h>
@@ -35,6 +36,7 @@
 #include <linux/videodev2.h>
 
 #include <drm/drm_fourcc.h>
+#include <trace/events/xilinx_dma.h>
 
 #include "../dmaengine.h"
 
@@ -148,6 +150,8 @@ struct xilinx_frmbuf_desc_hw {
  * @node: Node in the channel descriptors list
  * @fid: Field ID of buffer
  * @earlycb: Whether the callback should be called when in staged state
+ * @fence: Fence signalled once the frame is complete, NULL until requested
+ * @in_fence: Fence to wait for before the frame is programmed, or NULL
  */
 struct xilinx_frmbuf_tx_descriptor {
 	struct dma_async_tx_descriptor async_tx;
@@ -155,6 +159,8 @@ struct xilinx_frmbuf_tx_descriptor {
 	struct list_head node;
 	u32 fid;
 	u32 earlycb;
+	struct dma_fence *fence;
+	struct dma_fence *in_fence;
 };
 
 /**
@@ -179,6 +185,10 @@ struct xilinx_frmbuf_tx_descriptor {
  * @fid_err_flag: Field id error detection flag
  * @fid_out_val: Field id out val
  * @fid_mode: Select fid mode
+ * @fence_lock: Lock protecting the frame fences
+ * @fence_context: Fence context of the channel timeline
+ * @wait_fence: In-fence the head of the pending list is waiting for
+ * @fence_cb: Callback registered on @wait_fence
  */
 struct xilinx_frmbuf_chan {
 	struct xilinx_frmbuf_device *xdev;
@@ -203,6 +213,11 @@ struct xilinx_frmbuf_chan {
 	u8 fid_err_flag;
 	u8 fid_out_val;
 	enum fid_modes fid_mode;
+	/* Frame fence lock */
+	spinlock_t fence_lock;
+	u64 fence_context;
+	struct dma_fence *wait_fence;
+	struct dma_fence_cb fence_cb;
 };
 
 /**
@@ -657,6 +672,37 @@ static inline void frmbuf_set(struct xilinx_frmbuf_chan *chan, u32 reg,
 	frmbuf_write(chan, reg, frmbuf_read(chan, reg) | set);
 }
 
+static const char *xilinx_frmbuf_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "xilinx-frmbuf";
+}
+
+static const char *
+xilinx_frmbuf_fence_get_timeline_name(struct dma_fence *fence)
+{
+	struct xilinx_frmbuf_chan *chan;
+
+	chan = container_of(fence->lock, struct xilinx_frmbuf_chan, fence_lock);
+	return dev_name(chan->dev);
+}
+
+static const struct dma_fence_ops xilinx_frmbuf_fence_ops = {
+	.get_driver_name = xilinx_frmbuf_fence_get_driver_name,
+	.get_timeline_name = xilinx_frmbuf_fence_get_timeline_name,
+};
+
+static void xilinx_frmbuf_start_transfer(struct xilinx_frmbuf_chan *chan);
+
+/* The in-fence callback runs under the fence lock, defer to the tasklet */
+static void xilinx_frmbuf_fence_cb(struct dma_fence *fence,
+				   struct dma_fence_cb *cb)
+{
+	struct xilinx_frmbuf_chan *chan;
+
+	chan = container_of(cb, struct xilinx_frmbuf_chan, fence_cb);
+	tasklet_schedule(&chan->tasklet);
+}
+
 static void frmbuf_init_format_array(struct xilinx_frmbuf_device *xdev)
 {
 	u32 i, cnt;
@@ -999,6 +1045,114 @@ int xilinx_xdma_set_earlycb(struct dma_chan *chan,
 }
 EXPORT_SYMBOL(xilinx_xdma_set_earlycb);
 
+/**
+ * xilinx_xdma_get_fence - Get the completion fence of a frame
+ * @chan: dma channel instance
+ * @async_tx: descriptor of the frame, prepared but not yet submitted
+ *
+ * The fence is signalled from the interrupt handler as soon as the frame is
+ * done, ahead of the descriptor callback, and with -ECANCELED if the frame
+ * is dropped. Frames may be queued several deep, each with its own fence.
+ *
+ * Return: A reference to the fence, or an ERR_PTR() on error.
+ */
+struct dma_fence *xilinx_xdma_get_fence(struct dma_chan *chan,
+					struct dma_async_tx_descriptor *async_tx)
+{
+	struct xilinx_frmbuf_tx_descriptor *desc;
+	struct xilinx_frmbuf_chan *xil_chan;
+
+	xil_chan = frmbuf_find_chan(chan);
+	if (IS_ERR(xil_chan))
+		return ERR_CAST(xil_chan);
+
+	if (!async_tx || async_tx->cookie)
+		return ERR_PTR(-EINVAL);
+
+	desc = to_dma_tx_descriptor(async_tx);
+	if (!desc->fence) {
+		desc->fence = kzalloc(sizeof(*desc->fence), GFP_KERNEL);
+		if (!desc->fence)
+			return ERR_PTR(-ENOMEM);
+
+		/* the sequence number is set once the frame is submitted */
+		dma_fence_init(desc->fence, &xilinx_frmbuf_fence_ops,
+			       &xil_chan->fence_lock, xil_chan->fence_context,
+			       0);
+	}
+
+	return dma_fence_get(desc->fence);
+}
+EXPORT_SYMBOL_GPL(xilinx_xdma_get_fence);
+
+/**
+ * xilinx_xdma_set_in_fence - Hold a frame back until a fence signals
+ * @chan: dma channel instance
+ * @async_tx: descriptor of the frame, prepared but not yet submitted
+ * @fence: fence to wait for, a reference is taken
+ *
+ * For framebuffer read this lets the producer of a frame, a GPU or a
+ * previous capture stage, hand the buffer over without waiting for it on
+ * the CPU. Later frames queue up behind the held back one.
+ *
+ * Return: '0' on success and failure value on error
+ */
+int xilinx_xdma_set_in_fence(struct dma_chan *chan,
+			     struct dma_async_tx_descriptor *async_tx,
+			     struct dma_fence *fence)
+{
+	struct xilinx_frmbuf_tx_descriptor *desc;
+	struct xilinx_frmbuf_chan *xil_chan;
+
+	xil_chan = frmbuf_find_chan(chan);
+	if (IS_ERR(xil_chan))
+		return PTR_ERR(xil_chan);
+
+	if (!async_tx || async_tx->cookie || !fence)
+		return -EINVAL;
+
+	desc = to_dma_tx_descriptor(async_tx);
+	dma_fence_put(desc->in_fence);
+	desc->in_fence = dma_fence_get(fence);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xilinx_xdma_set_in_fence);
+
+/**
+ * xilinx_xdma_get_lines_done - Get the number of lines of a frame written
+ * @chan: dma channel instance
+ * @async_tx: submitted descriptor of the frame
+ * @lines: returned number of lines that are safe to consume
+ *
+ * The Framebuffer Write IP has no line counter and no slice or line done
+ * interrupt, it cannot report progress within a frame. @lines is 0 until
+ * the IP has signalled AP_DONE for the frame and U32_MAX after that.
+ *
+ * Return: '0' on success and failure value on error
+ */
+int xilinx_xdma_get_lines_done(struct dma_chan *chan,
+			       struct dma_async_tx_descriptor *async_tx,
+			       u32 *lines)
+{
+	struct xilinx_frmbuf_chan *xil_chan;
+
+	xil_chan = frmbuf_find_chan(chan);
+	if (IS_ERR(xil_chan))
+		return PTR_ERR(xil_chan);
+
+	if (!async_tx || !lines || xil_chan->direction != DMA_DEV_TO_MEM)
+		return -EINVAL;
+
+	if (dma_cookie_status(chan, async_tx->cookie, NULL) == DMA_COMPLETE)
+		*lines = U32_MAX;
+	else
+		*lines = 0;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xilinx_xdma_get_lines_done);
+
 /**
  * of_dma_xilinx_xlate - Translation function
  * @dma_spec: Pointer to DMA specifier as found in the device tree
@@ -1036,6 +1190,26 @@ xilinx_frmbuf_alloc_tx_descriptor(struct xilinx_frmbuf_chan *chan)
 	return desc;
 }
 
+/**
+ * xilinx_frmbuf_free_tx_descriptor - Free transaction descriptor
+ * @desc: Transaction descriptor
+ *
+ * A frame dropped before completion still signals its fence, with an error.
+ */
+static void
+xilinx_frmbuf_free_tx_descriptor(struct xilinx_frmbuf_tx_descriptor *desc)
+{
+	if (desc->fence) {
+		if (!dma_fence_is_signaled(desc->fence)) {
+			dma_fence_set_error(desc->fence, -ECANCELED);
+			dma_fence_signal(desc->fence);
+		}
+		dma_fence_put(desc->fence);
+	}
+	dma_fence_put(desc->in_fence);
+	kfree(desc);
+}
+
 /**
  * xilinx_frmbuf_free_desc_list - Free descriptors list
  * @chan: Driver specific dma channel
@@ -1048,7 +1222,7 @@ static void xilinx_frmbuf_free_desc_list(struct xilinx_frmbuf_chan *chan,
 
 	list_for_each_entry_safe(desc, next, list, node) {
 		list_del(&desc->node);
-		kfree(desc);
+		xilinx_frmbuf_free_tx_descriptor(desc);
 	}
 }
 
@@ -1062,10 +1236,18 @@ static void xilinx_frmbuf_free_descriptors(struct xilinx_frmbuf_chan *chan)
 
 	spin_lock_irqsave(&chan->lock, flags);
 
+	if (chan->wait_fence) {
+		dma_fence_remove_callback(chan->wait_fence, &chan->fence_cb);
+		chan->wait_fence = NULL;
+	}
+
 	xilinx_frmbuf_free_desc_list(chan, &chan->pending_list);
 	xilinx_frmbuf_free_desc_list(chan, &chan->done_list);
-	kfree(chan->active_desc);
-	kfree(chan->staged_desc);
+	/* an early callback descriptor may be both active and staged */
+	if (chan->active_desc && chan->active_desc != chan->staged_desc)
+		xilinx_frmbuf_free_tx_descriptor(chan->active_desc);
+	if (chan->staged_desc)
+		xilinx_frmbuf_free_tx_descriptor(chan->staged_desc);
 
 	chan->staged_desc = NULL;
 	chan->active_desc = NULL;
@@ -1114,7 +1296,13 @@ static void xilinx_frmbuf_chan_desc_cleanup(struct xilinx_frmbuf_chan *chan)
 
 		/* Run any dependencies, then free the descriptor */
 		dma_run_dependencies(&desc->async_tx);
-		kfree(desc);
+		xilinx_frmbuf_free_tx_descriptor(desc);
+	}
+
+	/* Program the frame held back by its in-fence once it signalled */
+	if (chan->wait_fence && dma_fence_is_signaled(chan->wait_fence)) {
+		chan->wait_fence = NULL;
+		xilinx_frmbuf_start_transfer(chan);
 	}
 
 	spin_unlock_irqrestore(&chan->lock, flags);
@@ -1201,6 +1389,11 @@ static void xilinx_frmbuf_complete_descriptor(struct xilinx_frmbuf_chan *chan)
 			    XILINX_FRMBUF_FID_MASK;
 
 	dma_cookie_complete(&desc->async_tx);
+	trace_xilinx_dma_complete(&chan->common, desc->async_tx.cookie,
+				  desc->hw.stride * desc->hw.vsize,
+				  DMA_TRANS_NOERROR);
+	if (desc->fence)
+		dma_fence_signal(desc->fence);
 	list_add_tail(&desc->node, &chan->done_list);
 }
 
@@ -1230,6 +1423,28 @@ static void xilinx_frmbuf_start_transfer(struct xilinx_frmbuf_chan *chan)
 				struct xilinx_frmbuf_tx_descriptor,
 				node);
 
+	if (desc->in_fence) {
+		if (chan->wait_fence)
+			return;
+
+		if (!dma_fence_add_callback(desc->in_fence, &chan->fence_cb,
+					    xilinx_frmbuf_fence_cb)) {
+			chan->wait_fence = desc->in_fence;
+			return;
+		}
+
+		/* drop frames whose producer failed */
+		if (desc->in_fence->error) {
+			list_del(&desc->node);
+			xilinx_frmbuf_free_tx_descriptor(desc);
+			xilinx_frmbuf_start_transfer(chan);
+			return;
+		}
+
+		dma_fence_put(desc->in_fence);
+		desc->in_fence = NULL;
+	}
+
 	if (desc->earlycb == EARLY_CALLBACK_START_DESC) {
 		dma_async_tx_callback callback;
 		void *callback_param;
@@ -1269,6 +1484,8 @@ static void xilinx_frmbuf_start_transfer(struct xilinx_frmbuf_chan *chan)
 
 	/* Start the hardware */
 	xilinx_frmbuf_start(chan);
+	trace_xilinx_dma_start(&chan->common, desc->async_tx.cookie,
+			       desc->hw.stride * desc->hw.vsize);
 	list_del(&desc->node);
 
 	/* No staging descriptor required when auto restart is disabled */
@@ -1287,6 +1504,8 @@ static void xilinx_frmbuf_issue_pending(struct dma_chan *dchan)
 	struct xilinx_frmbuf_chan *chan = to_xilinx_chan(dchan);
 	unsigned long flags;
 
+	trace_xilinx_dma_issue_pending(dchan);
+
 	spin_lock_irqsave(&chan->lock, flags);
 	xilinx_frmbuf_start_transfer(chan);
 	spin_unlock_irqrestore(&chan->lock, flags);
@@ -1338,6 +1557,7 @@ static irqreturn_t xilinx_frmbuf_irq_handler(int irq, void *data)
 
 	frmbuf_write(chan, XILINX_FRMBUF_ISR_OFFSET,
 		     status & XILINX_FRMBUF_ISR_ALL_IRQ_MASK);
+	trace_xilinx_dma_irq(&chan->common, status);
 
 	/* Check if callback function needs to be called early */
 	desc = chan->staged_desc;
@@ -1405,6 +1625,11 @@ static dma_cookie_t xilinx_frmbuf_tx_submit(struct dma_async_tx_descriptor *tx)
 
 	spin_lock_irqsave(&chan->lock, flags);
 	cookie = dma_cookie_assign(tx);
+	trace_xilinx_dma_submit(tx->chan, cookie,
+				desc->hw.stride * desc->hw.vsize);
+	/* frames complete in submission order, the cookie orders the fences */
+	if (desc->fence)
+		desc->fence->seqno = cookie;
 	list_add_tail(&desc->node, &chan->pending_list);
 	spin_unlock_irqrestore(&chan->lock, flags);
 
@@ -1517,6 +1742,8 @@ static int xilinx_frmbuf_terminate_all(struct dma_chan *dchan)
 {
 	struct xilinx_frmbuf_chan *chan = to_xilinx_chan(dchan);
 
+	trace_xilinx_dma_terminate(dchan);
+
 	xilinx_frmbuf_halt(chan);
 	xilinx_frmbuf_free_descriptors(chan);
 	/* worst case frame-to-frame boundary; ensure frame output complete */
@@ -1625,6 +1852,9 @@ static int xilinx_frmbuf_chan_probe(struct xilinx_frmbuf_device *xdev,
 	INIT_LIST_HEAD(&chan->pending_list);
 	INIT_LIST_HEAD(&chan->done_list);
 
+	spin_lock_init(&chan->fence_lock);
+	chan->fence_context = dma_fence_context_alloc(1);
+
 	chan->irq = irq_of_parse_and_map(node, 0);
 	err = devm_request_irq(xdev->dev, chan->irq, xilinx_frmbuf_irq_handler,
 			       IRQF_SHARED, "xilinx_framebuffer", chan);
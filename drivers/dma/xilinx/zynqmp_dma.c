@@ -18,6 +18,7 @@
 #include <linux/clk.h>
 #include <linux/io-64-nonatomic-lo-hi.h>
 #include <linux/pm_runtime.h>
+#include <trace/events/xilinx_dma.h>
 
 #include "../dmaengine.h"
 
@@ -118,6 +119,12 @@
 /* Max number of descriptors per channel */
 #define ZYNQMP_DMA_NUM_DESCS	32
 
+/* Upper bound on the descriptors a channel may grow to on demand */
+#define ZYNQMP_DMA_MAX_DESCS	1024
+
+/* Memset pattern buffer, read with FIXED bursts so one bus beat is enough */
+#define ZYNQMP_DMA_MEMSET_LEN	64
+
 /* Max transfer size per descriptor */
 #define ZYNQMP_DMA_MAX_TRANS_LEN	0x40000000
 
@@ -179,6 +186,7 @@ struct zynqmp_dma_desc_ll {
  * @src_p: Physical address of the src descriptor
  * @dst_v: Virtual address of the dst descriptor
  * @dst_p: Physical address of the dst descriptor
+ * @memset: Transaction copies from the channel memset pattern buffer
  */
 struct zynqmp_dma_desc_sw {
 	u64 src;
@@ -191,6 +199,23 @@ struct zynqmp_dma_desc_sw {
 	dma_addr_t src_p;
 	struct zynqmp_dma_desc_ll *dst_v;
 	dma_addr_t dst_p;
+	bool memset;
+};
+
+/**
+ * struct zynqmp_dma_desc_chunk - Block of descriptors added to a channel
+ * @node: Node in the channel chunk list
+ * @sw: SW descriptors of the block
+ * @v: Virtual address of the hw descriptors of the block
+ * @p: Physical address of the hw descriptors of the block
+ * @count: Number of descriptors in the block
+ */
+struct zynqmp_dma_desc_chunk {
+	struct list_head node;
+	struct zynqmp_dma_desc_sw *sw;
+	void *v;
+	dma_addr_t p;
+	u32 count;
 };
 
 /**
@@ -201,16 +226,17 @@ struct zynqmp_dma_desc_sw {
  * @pending_list: Descriptors waiting
  * @free_list: Descriptors free
  * @active_list: Descriptors active
- * @sw_desc_pool: SW descriptor pool
+ * @desc_chunks: Descriptor blocks owned by the channel
  * @done_list: Complete descriptors
  * @common: DMA common channel
- * @desc_pool_v: Statically allocated descriptor base
- * @desc_pool_p: Physical allocated descriptor base
+ * @desc_cnt: Number of descriptors owned by the channel
  * @desc_free_cnt: Descriptor available count
  * @dev: The dma device
  * @irq: Channel IRQ
  * @is_dmacoherent: Tells whether dma operations are coherent or not
- * @tasklet: Cleanup work after irq
+ * @bh_work: Cleanup work after irq, run from BH context
+ * @grow_work: Grows the descriptor pool outside of the prep calls
+ * @desc_wanted: Free descriptors a failed prep asked for, 0 for none
  * @idle : Channel status;
  * @desc_size: Size of the low level descriptor
  * @err: Channel has errors
@@ -218,6 +244,10 @@ struct zynqmp_dma_desc_sw {
  * @src_burst_len: Source burst length
  * @dst_burst_len: Dest burst length
  * @irq_offset: Irq register offset
+ * @memset_v: Memset pattern buffer
+ * @memset_p: Physical address of the memset pattern buffer
+ * @memset_value: Fill value held by the memset pattern buffer, -1 for none
+ * @memset_cnt: Memset transactions not freed yet
  */
 struct zynqmp_dma_chan {
 	struct zynqmp_dma_device *zdev;
@@ -226,16 +256,17 @@ struct zynqmp_dma_chan {
 	struct list_head pending_list;
 	struct list_head free_list;
 	struct list_head active_list;
-	struct zynqmp_dma_desc_sw *sw_desc_pool;
+	struct list_head desc_chunks;
 	struct list_head done_list;
 	struct dma_chan common;
-	void *desc_pool_v;
-	dma_addr_t desc_pool_p;
+	u32 desc_cnt;
 	u32 desc_free_cnt;
 	struct device *dev;
 	int irq;
 	bool is_dmacoherent;
-	struct tasklet_struct tasklet;
+	struct work_struct bh_work;
+	struct work_struct grow_work;
+	u32 desc_wanted;
 	bool idle;
 	size_t desc_size;
 	bool err;
@@ -243,6 +274,10 @@ struct zynqmp_dma_chan {
 	u32 src_burst_len;
 	u32 dst_burst_len;
 	u32 irq_offset;
+	void *memset_v;
+	dma_addr_t memset_p;
+	int memset_value;
+	u32 memset_cnt;
 };
 
 /**
@@ -309,17 +344,18 @@ static void zynqmp_dma_desc_config_eod(struct zynqmp_dma_chan *chan,
 /**
  * zynqmp_dma_config_sg_ll_desc - Configure the linked list descriptor
  * @chan: ZynqMP DMA channel pointer
- * @sdesc: Hw descriptor pointer
+ * @new: Transaction descriptor owning the hw descriptors
  * @src: Source buffer address
  * @dst: Destination buffer address
  * @len: Transfer length
  * @prev: Previous hw descriptor pointer
  */
 static void zynqmp_dma_config_sg_ll_desc(struct zynqmp_dma_chan *chan,
-				   struct zynqmp_dma_desc_ll *sdesc,
+				   struct zynqmp_dma_desc_sw *new,
 				   dma_addr_t src, dma_addr_t dst, size_t len,
 				   struct zynqmp_dma_desc_ll *prev)
 {
+	struct zynqmp_dma_desc_ll *sdesc = new->src_v;
 	struct zynqmp_dma_desc_ll *ddesc = sdesc + 1;
 
 	sdesc->size = ddesc->size = len;
@@ -332,12 +368,11 @@ static void zynqmp_dma_config_sg_ll_desc(struct zynqmp_dma_chan *chan,
 		ddesc->ctrl |= ZYNQMP_DMA_DESC_CTRL_COHRNT;
 	}
 
+	/* The descriptors may come from different blocks */
 	if (prev) {
-		dma_addr_t addr = chan->desc_pool_p +
-			    ((uintptr_t)sdesc - (uintptr_t)chan->desc_pool_v);
 		ddesc = prev + 1;
-		prev->nxtdscraddr = addr;
-		ddesc->nxtdscraddr = addr + ZYNQMP_DMA_DESC_SIZE(chan);
+		prev->nxtdscraddr = new->src_p;
+		ddesc->nxtdscraddr = new->dst_p;
 	}
 }
 
@@ -395,6 +430,7 @@ static dma_cookie_t zynqmp_dma_tx_submit(struct dma_async_tx_descriptor *tx)
 	new = tx_to_desc(tx);
 	spin_lock_irqsave(&chan->lock, irqflags);
 	cookie = dma_cookie_assign(tx);
+	trace_xilinx_dma_submit(tx->chan, cookie, new->len);
 
 	if (!list_empty(&chan->pending_list)) {
 		desc = list_last_entry(&chan->pending_list,
@@ -450,6 +486,11 @@ static void zynqmp_dma_free_descriptor(struct zynqmp_dma_chan *chan,
 {
 	struct zynqmp_dma_desc_sw *child, *next;
 
+	if (sdesc->memset) {
+		sdesc->memset = false;
+		chan->memset_cnt--;
+	}
+
 	chan->desc_free_cnt++;
 	list_move_tail(&sdesc->node, &chan->free_list);
 	list_for_each_entry_safe(child, next, &sdesc->tx_list, node) {
@@ -472,6 +513,152 @@ static void zynqmp_dma_free_desc_list(struct zynqmp_dma_chan *chan,
 		zynqmp_dma_free_descriptor(chan, desc);
 }
 
+/**
+ * zynqmp_dma_grow_descs - Add a block of descriptors to the channel
+ * @chan: ZynqMP DMA channel pointer
+ * @count: Number of descriptors to add
+ * @gfp: Allocation flags
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int zynqmp_dma_grow_descs(struct zynqmp_dma_chan *chan, u32 count,
+				 gfp_t gfp)
+{
+	struct zynqmp_dma_desc_chunk *chunk;
+	struct zynqmp_dma_desc_sw *desc;
+	unsigned long irqflags;
+	u32 i;
+
+	chunk = kzalloc(sizeof(*chunk), gfp);
+	if (!chunk)
+		return -ENOMEM;
+
+	chunk->sw = kcalloc(count, sizeof(*desc), gfp);
+	if (!chunk->sw)
+		goto err_free_chunk;
+
+	chunk->v = dma_alloc_coherent(chan->dev,
+				      2 * ZYNQMP_DMA_DESC_SIZE(chan) * count,
+				      &chunk->p, gfp);
+	if (!chunk->v)
+		goto err_free_sw;
+
+	chunk->count = count;
+
+	for (i = 0; i < count; i++) {
+		desc = chunk->sw + i;
+		dma_async_tx_descriptor_init(&desc->async_tx, &chan->common);
+		desc->async_tx.tx_submit = zynqmp_dma_tx_submit;
+		desc->src_v = (struct zynqmp_dma_desc_ll *) (chunk->v +
+					(i * ZYNQMP_DMA_DESC_SIZE(chan) * 2));
+		desc->dst_v = (struct zynqmp_dma_desc_ll *) (desc->src_v + 1);
+		desc->src_p = chunk->p + (i * ZYNQMP_DMA_DESC_SIZE(chan) * 2);
+		desc->dst_p = desc->src_p + ZYNQMP_DMA_DESC_SIZE(chan);
+	}
+
+	spin_lock_irqsave(&chan->lock, irqflags);
+	list_add_tail(&chunk->node, &chan->desc_chunks);
+	for (i = 0; i < count; i++)
+		list_add_tail(&chunk->sw[i].node, &chan->free_list);
+	chan->desc_cnt += count;
+	chan->desc_free_cnt += count;
+	spin_unlock_irqrestore(&chan->lock, irqflags);
+
+	return 0;
+
+err_free_sw:
+	kfree(chunk->sw);
+err_free_chunk:
+	kfree(chunk);
+	return -ENOMEM;
+}
+
+/**
+ * zynqmp_dma_grow_work - Grow the descriptor pool for a failed prep
+ * @work: grow_work of the channel
+ *
+ * Adds blocks of at least ZYNQMP_DMA_NUM_DESCS descriptors, up to
+ * ZYNQMP_DMA_MAX_DESCS, until the request of the last failed prep fits.
+ */
+static void zynqmp_dma_grow_work(struct work_struct *work)
+{
+	struct zynqmp_dma_chan *chan = container_of(work, struct zynqmp_dma_chan,
+						    grow_work);
+	unsigned long irqflags;
+	u32 grow;
+
+	spin_lock_irqsave(&chan->lock, irqflags);
+	while (chan->desc_wanted > chan->desc_free_cnt &&
+	       chan->desc_cnt < ZYNQMP_DMA_MAX_DESCS) {
+		grow = max_t(u32, chan->desc_wanted - chan->desc_free_cnt,
+			     ZYNQMP_DMA_NUM_DESCS);
+		grow = min_t(u32, grow, ZYNQMP_DMA_MAX_DESCS - chan->desc_cnt);
+		spin_unlock_irqrestore(&chan->lock, irqflags);
+		if (zynqmp_dma_grow_descs(chan, grow, GFP_KERNEL))
+			return;
+		spin_lock_irqsave(&chan->lock, irqflags);
+	}
+	chan->desc_wanted = 0;
+	spin_unlock_irqrestore(&chan->lock, irqflags);
+}
+
+/**
+ * zynqmp_dma_reserve_descs - Reserve descriptors for a transaction
+ * @chan: ZynqMP DMA channel pointer
+ * @desc_cnt: Number of descriptors needed
+ *
+ * Nothing is allocated here, prep may be called from atomic context.  When
+ * the pool is short the reservation fails and grow_work adds descriptors
+ * for the next attempt.
+ *
+ * Return: '0' on success and failure value on error
+ */
+static int zynqmp_dma_reserve_descs(struct zynqmp_dma_chan *chan,
+				    u32 desc_cnt)
+{
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&chan->lock, irqflags);
+	if (desc_cnt > chan->desc_free_cnt) {
+		if (chan->desc_cnt < ZYNQMP_DMA_MAX_DESCS) {
+			chan->desc_wanted = max(chan->desc_wanted, desc_cnt);
+			schedule_work(&chan->grow_work);
+		}
+		spin_unlock_irqrestore(&chan->lock, irqflags);
+		return -ENOMEM;
+	}
+	chan->desc_free_cnt -= desc_cnt;
+	spin_unlock_irqrestore(&chan->lock, irqflags);
+
+	return 0;
+}
+
+/**
+ * zynqmp_dma_free_descs - Free the descriptor blocks of the channel
+ * @chan: ZynqMP DMA channel pointer
+ */
+static void zynqmp_dma_free_descs(struct zynqmp_dma_chan *chan)
+{
+	struct zynqmp_dma_desc_chunk *chunk, *next;
+
+	list_for_each_entry_safe(chunk, next, &chan->desc_chunks, node) {
+		list_del(&chunk->node);
+		dma_free_coherent(chan->dev,
+				  2 * ZYNQMP_DMA_DESC_SIZE(chan) * chunk->count,
+				  chunk->v, chunk->p);
+		kfree(chunk->sw);
+		kfree(chunk);
+	}
+
+	INIT_LIST_HEAD(&chan->free_list);
+	chan->desc_cnt = 0;
+	chan->desc_free_cnt = 0;
+
+	dma_free_coherent(chan->dev, ZYNQMP_DMA_MEMSET_LEN, chan->memset_v,
+			  chan->memset_p);
+	chan->memset_v = NULL;
+}
+
 /**
  * zynqmp_dma_alloc_chan_resources - Allocate channel resources
  * @dchan: DMA channel
@@ -481,45 +668,36 @@ static void zynqmp_dma_free_desc_list(struct zynqmp_dma_chan *chan,
 static int zynqmp_dma_alloc_chan_resources(struct dma_chan *dchan)
 {
 	struct zynqmp_dma_chan *chan = to_chan(dchan);
-	struct zynqmp_dma_desc_sw *desc;
-	int i, ret;
+	int ret;
 
 	ret = pm_runtime_resume_and_get(chan->dev);
 	if (ret < 0)
 		return ret;
 
-	chan->sw_desc_pool = kcalloc(ZYNQMP_DMA_NUM_DESCS, sizeof(*desc),
-				     GFP_KERNEL);
-	if (!chan->sw_desc_pool)
-		return -ENOMEM;
-
 	chan->idle = true;
-	chan->desc_free_cnt = ZYNQMP_DMA_NUM_DESCS;
+	chan->desc_cnt = 0;
+	chan->desc_free_cnt = 0;
+	chan->desc_wanted = 0;
 
 	INIT_LIST_HEAD(&chan->free_list);
+	INIT_LIST_HEAD(&chan->desc_chunks);
 
-	for (i = 0; i < ZYNQMP_DMA_NUM_DESCS; i++) {
-		desc = chan->sw_desc_pool + i;
-		dma_async_tx_descriptor_init(&desc->async_tx, &chan->common);
-		desc->async_tx.tx_submit = zynqmp_dma_tx_submit;
-		list_add_tail(&desc->node, &chan->free_list);
-	}
-
-	chan->desc_pool_v = dma_alloc_coherent(chan->dev,
-					       (2 * ZYNQMP_DMA_DESC_SIZE(chan) *
-					       ZYNQMP_DMA_NUM_DESCS),
-					       &chan->desc_pool_p, GFP_KERNEL);
-	if (!chan->desc_pool_v)
+	chan->memset_v = dma_alloc_coherent(chan->dev, ZYNQMP_DMA_MEMSET_LEN,
+					    &chan->memset_p, GFP_KERNEL);
+	if (!chan->memset_v) {
+		pm_runtime_put(chan->dev);
 		return -ENOMEM;
+	}
+	chan->memset_value = -1;
+	chan->memset_cnt = 0;
 
-	for (i = 0; i < ZYNQMP_DMA_NUM_DESCS; i++) {
-		desc = chan->sw_desc_pool + i;
-		desc->src_v = (struct zynqmp_dma_desc_ll *) (chan->desc_pool_v +
-					(i * ZYNQMP_DMA_DESC_SIZE(chan) * 2));
-		desc->dst_v = (struct zynqmp_dma_desc_ll *) (desc->src_v + 1);
-		desc->src_p = chan->desc_pool_p +
-				(i * ZYNQMP_DMA_DESC_SIZE(chan) * 2);
-		desc->dst_p = desc->src_p + ZYNQMP_DMA_DESC_SIZE(chan);
+	ret = zynqmp_dma_grow_descs(chan, ZYNQMP_DMA_NUM_DESCS, GFP_KERNEL);
+	if (ret) {
+		dma_free_coherent(chan->dev, ZYNQMP_DMA_MEMSET_LEN,
+				  chan->memset_v, chan->memset_p);
+		chan->memset_v = NULL;
+		pm_runtime_put(chan->dev);
+		return ret;
 	}
 
 	return ZYNQMP_DMA_NUM_DESCS;
@@ -608,6 +786,14 @@ static void zynqmp_dma_start_transfer(struct zynqmp_dma_chan *chan)
 	if (!desc)
 		return;
 
+	if (trace_xilinx_dma_start_enabled()) {
+		struct zynqmp_dma_desc_sw *d;
+
+		list_for_each_entry(d, &chan->pending_list, node)
+			trace_xilinx_dma_start(&chan->common,
+					       d->async_tx.cookie, d->len);
+	}
+
 	list_splice_tail_init(&chan->pending_list, &chan->active_list);
 	zynqmp_dma_update_desc_to_ctrlr(chan, desc);
 	zynqmp_dma_start(chan);
@@ -636,6 +822,7 @@ static void zynqmp_dma_chan_desc_cleanup(struct zynqmp_dma_chan *chan)
 		}
 
 		/* Run any dependencies, then free the descriptor */
+		dma_run_dependencies(&desc->async_tx);
 		zynqmp_dma_free_descriptor(chan, desc);
 	}
 
@@ -656,6 +843,9 @@ static void zynqmp_dma_complete_descriptor(struct zynqmp_dma_chan *chan)
 		return;
 	list_del(&desc->node);
 	dma_cookie_complete(&desc->async_tx);
+	trace_xilinx_dma_complete(&chan->common, desc->async_tx.cookie,
+				  desc->len, chan->err ? DMA_TRANS_ABORTED :
+				  DMA_TRANS_NOERROR);
 	list_add_tail(&desc->node, &chan->done_list);
 }
 
@@ -668,6 +858,8 @@ static void zynqmp_dma_issue_pending(struct dma_chan *dchan)
 	struct zynqmp_dma_chan *chan = to_chan(dchan);
 	unsigned long irqflags;
 
+	trace_xilinx_dma_issue_pending(dchan);
+
 	spin_lock_irqsave(&chan->lock, irqflags);
 	zynqmp_dma_start_transfer(chan);
 	spin_unlock_irqrestore(&chan->lock, irqflags);
@@ -696,11 +888,9 @@ static void zynqmp_dma_free_chan_resources(struct dma_chan *dchan)
 {
 	struct zynqmp_dma_chan *chan = to_chan(dchan);
 
+	cancel_work_sync(&chan->grow_work);
 	zynqmp_dma_free_descriptors(chan);
-	dma_free_coherent(chan->dev,
-		(2 * ZYNQMP_DMA_DESC_SIZE(chan) * ZYNQMP_DMA_NUM_DESCS),
-		chan->desc_pool_v, chan->desc_pool_p);
-	kfree(chan->sw_desc_pool);
+	zynqmp_dma_free_descs(chan);
 	pm_runtime_mark_last_busy(chan->dev);
 	pm_runtime_put_autosuspend(chan->dev);
 }
@@ -742,8 +932,11 @@ static irqreturn_t zynqmp_dma_irq_handler(int irq, void *data)
 	status = isr & ~imr;
 
 	writel(isr, chan->regs + ZYNQMP_DMA_ISR);
+	if (status)
+		trace_xilinx_dma_irq(&chan->common, status);
+
 	if (status & ZYNQMP_DMA_INT_DONE) {
-		tasklet_schedule(&chan->tasklet);
+		queue_work(system_bh_wq, &chan->bh_work);
 		ret = IRQ_HANDLED;
 	}
 
@@ -752,7 +945,7 @@ static irqreturn_t zynqmp_dma_irq_handler(int irq, void *data)
 
 	if (status & ZYNQMP_DMA_INT_ERR) {
 		chan->err = true;
-		tasklet_schedule(&chan->tasklet);
+		queue_work(system_bh_wq, &chan->bh_work);
 		dev_err(chan->dev, "Channel %p has errors\n", chan);
 		ret = IRQ_HANDLED;
 	}
@@ -767,12 +960,13 @@ static irqreturn_t zynqmp_dma_irq_handler(int irq, void *data)
 }
 
 /**
- * zynqmp_dma_do_tasklet - Schedule completion tasklet
- * @t: Pointer to the ZynqMP DMA channel structure
+ * zynqmp_dma_bh_work - Per-channel completion work
+ * @work: Pointer to the bh_work of the ZynqMP DMA channel
  */
-static void zynqmp_dma_do_tasklet(struct tasklet_struct *t)
+static void zynqmp_dma_bh_work(struct work_struct *work)
 {
-	struct zynqmp_dma_chan *chan = from_tasklet(chan, t, tasklet);
+	struct zynqmp_dma_chan *chan = container_of(work, struct zynqmp_dma_chan,
+						    bh_work);
 	u32 count;
 	unsigned long irqflags;
 
@@ -809,6 +1003,8 @@ static int zynqmp_dma_device_terminate_all(struct dma_chan *dchan)
 {
 	struct zynqmp_dma_chan *chan = to_chan(dchan);
 
+	trace_xilinx_dma_terminate(dchan);
+
 	writel(ZYNQMP_DMA_IDS_DEFAULT_MASK, chan->regs + ZYNQMP_DMA_IDS);
 	zynqmp_dma_free_descriptors(chan);
 
@@ -823,7 +1019,7 @@ static void zynqmp_dma_synchronize(struct dma_chan *dchan)
 {
 	struct zynqmp_dma_chan *chan = to_chan(dchan);
 
-	tasklet_kill(&chan->tasklet);
+	cancel_work_sync(&chan->bh_work);
 }
 
 /**
@@ -843,34 +1039,129 @@ static struct dma_async_tx_descriptor *zynqmp_dma_prep_memcpy(
 	struct zynqmp_dma_chan *chan;
 	struct zynqmp_dma_desc_sw *new, *first = NULL;
 	void *desc = NULL, *prev = NULL;
-	size_t copy;
+	size_t copy, total = len;
 	u32 desc_cnt;
+
+	chan = to_chan(dchan);
+
+	desc_cnt = DIV_ROUND_UP(len, ZYNQMP_DMA_MAX_TRANS_LEN);
+
+	if (zynqmp_dma_reserve_descs(chan, desc_cnt)) {
+		dev_dbg(chan->dev, "chan %p descs are not available\n", chan);
+		return NULL;
+	}
+
+	do {
+		/* Allocate and populate the descriptor */
+		new = zynqmp_dma_get_descriptor(chan);
+
+		copy = min_t(size_t, len, ZYNQMP_DMA_MAX_TRANS_LEN);
+		desc = (struct zynqmp_dma_desc_ll *)new->src_v;
+		zynqmp_dma_config_sg_ll_desc(chan, new, dma_src,
+					     dma_dst, copy, prev);
+		prev = desc;
+		len -= copy;
+		dma_src += copy;
+		dma_dst += copy;
+		if (!first)
+			first = new;
+		else
+			list_add_tail(&new->node, &first->tx_list);
+	} while (len);
+
+	zynqmp_dma_desc_config_eod(chan, desc);
+	first->len = total;
+	async_tx_ack(&first->async_tx);
+	first->async_tx.flags = (enum dma_ctrl_flags)flags;
+	return &first->async_tx;
+}
+
+/**
+ * zynqmp_dma_memset_pattern - Claim the pattern buffer for a fill value
+ * @chan: ZynqMP DMA channel pointer
+ * @value: Fill value
+ *
+ * The channel has a single pattern buffer, allocated with its resources.
+ * It is refilled when no memset transaction is outstanding, so only
+ * transactions with the same value can be in flight at the same time.
+ * Must be called with the channel lock held.
+ *
+ * Return: '0' on success, -EBUSY if the buffer holds another value
+ */
+static int zynqmp_dma_memset_pattern(struct zynqmp_dma_chan *chan, u8 value)
+{
+	if (chan->memset_value != value) {
+		if (chan->memset_cnt)
+			return -EBUSY;
+		memset(chan->memset_v, value, ZYNQMP_DMA_MEMSET_LEN);
+		chan->memset_value = value;
+	}
+	chan->memset_cnt++;
+
+	return 0;
+}
+
+/**
+ * zynqmp_dma_prep_memset - prepare descriptors for memset transaction
+ * @dchan: DMA channel
+ * @dma_dst: Destination buffer address
+ * @value: Fill value, the lowest byte is used
+ * @len: Transfer length
+ * @flags: transfer ack flags
+ *
+ * The engine has no fill mode of its own, the destination is written by
+ * copying from the pattern buffer of the channel.  The source descriptors
+ * use FIXED bursts, every beat reads the same pattern, so each descriptor
+ * covers up to ZYNQMP_DMA_MAX_TRANS_LEN bytes.
+ *
+ * Return: Async transaction descriptor on success and NULL on failure
+ */
+static struct dma_async_tx_descriptor *zynqmp_dma_prep_memset(
+				struct dma_chan *dchan, dma_addr_t dma_dst,
+				int value, size_t len, ulong flags)
+{
+	struct zynqmp_dma_chan *chan;
+	struct zynqmp_dma_desc_sw *new, *first = NULL;
+	void *desc = NULL, *prev = NULL;
 	unsigned long irqflags;
+	size_t copy, total = len;
+	u32 desc_cnt;
+	int ret;
 
 	chan = to_chan(dchan);
 
+	if (!len)
+		return NULL;
+
 	desc_cnt = DIV_ROUND_UP(len, ZYNQMP_DMA_MAX_TRANS_LEN);
 
 	spin_lock_irqsave(&chan->lock, irqflags);
-	if (desc_cnt > chan->desc_free_cnt) {
+	ret = zynqmp_dma_memset_pattern(chan, value);
+	spin_unlock_irqrestore(&chan->lock, irqflags);
+	if (ret) {
+		dev_dbg(chan->dev, "chan %p memset pattern is busy\n", chan);
+		return NULL;
+	}
+
+	if (zynqmp_dma_reserve_descs(chan, desc_cnt)) {
+		spin_lock_irqsave(&chan->lock, irqflags);
+		chan->memset_cnt--;
 		spin_unlock_irqrestore(&chan->lock, irqflags);
 		dev_dbg(chan->dev, "chan %p descs are not available\n", chan);
 		return NULL;
 	}
-	chan->desc_free_cnt = chan->desc_free_cnt - desc_cnt;
-	spin_unlock_irqrestore(&chan->lock, irqflags);
 
 	do {
-		/* Allocate and populate the descriptor */
 		new = zynqmp_dma_get_descriptor(chan);
 
 		copy = min_t(size_t, len, ZYNQMP_DMA_MAX_TRANS_LEN);
 		desc = (struct zynqmp_dma_desc_ll *)new->src_v;
-		zynqmp_dma_config_sg_ll_desc(chan, desc, dma_src,
+		zynqmp_dma_config_sg_ll_desc(chan, new, chan->memset_p,
 					     dma_dst, copy, prev);
+		/* Bit 1 of the control word selects INCR bursts, use FIXED */
+		new->src_v->ctrl &= ~ZYNQMP_DMA_DESC_CTRL_SIZE_256;
 		prev = desc;
 		len -= copy;
-		dma_src += copy;
 		dma_dst += copy;
 		if (!first)
 			first = new;
@@ -879,6 +1170,8 @@ static struct dma_async_tx_descriptor *zynqmp_dma_prep_memcpy(
 	} while (len);
 
 	zynqmp_dma_desc_config_eod(chan, desc);
+	first->len = total;
+	first->memset = true;
 	async_tx_ack(&first->async_tx);
 	first->async_tx.flags = (enum dma_ctrl_flags)flags;
 	return &first->async_tx;
@@ -895,7 +1188,7 @@ static void zynqmp_dma_chan_remove(struct zynqmp_dma_chan *chan)
 
 	if (chan->irq)
 		devm_free_irq(chan->zdev->dev, chan->irq, chan);
-	tasklet_kill(&chan->tasklet);
+	cancel_work_sync(&chan->bh_work);
 	list_del(&chan->common.device_node);
 }
 
@@ -945,7 +1238,8 @@ static int zynqmp_dma_chan_probe(struct zynqmp_dma_device *zdev,
 
 	chan->is_dmacoherent =  of_property_read_bool(node, "dma-coherent");
 	zdev->chan = chan;
-	tasklet_setup(&chan->tasklet, zynqmp_dma_do_tasklet);
+	INIT_WORK(&chan->bh_work, zynqmp_dma_bh_work);
+	INIT_WORK(&chan->grow_work, zynqmp_dma_grow_work);
 	spin_lock_init(&chan->lock);
 	INIT_LIST_HEAD(&chan->active_list);
 	INIT_LIST_HEAD(&chan->pending_list);
@@ -1091,9 +1385,11 @@ static int zynqmp_dma_probe(struct platform_device *pdev)
 		return ret;
 	}
 	dma_cap_set(DMA_MEMCPY, zdev->common.cap_mask);
+	dma_cap_set(DMA_MEMSET, zdev->common.cap_mask);
 
 	p = &zdev->common;
 	p->device_prep_dma_memcpy = zynqmp_dma_prep_memcpy;
+	p->device_prep_dma_memset = zynqmp_dma_prep_memset;
 	p->device_terminate_all = zynqmp_dma_device_terminate_all;
 	p->device_synchronize = zynqmp_dma_synchronize;
 	p->device_issue_pending = zynqmp_dma_issue_pending;
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Zynq MPSoC Firmware layer - batched and asynchronous requests
+ *
+ * A batch gathers EEMI requests so that a driver issuing many of them in a
+ * row, as clock and pin controller probe do, can hand them over in one go
+ * and, if it does not need the results at once, have them issued from a
+ * worker while it carries on.
+ */
+
+#include <linux/completion.h>
+#include <linux/firmware/xlnx-zynqmp.h>
+#include <linux/module.h>
+#include <linux/stdarg.h>
+#include <linux/workqueue.h>
+
+/**
+ * zynqmp_pm_batch_init() - Initialize an empty batch
+ * @batch:	Batch to initialize
+ * @reqs:	Storage for the requests of the batch
+ * @max_reqs:	Number of entries of @reqs
+ */
+void zynqmp_pm_batch_init(struct zynqmp_pm_batch *batch,
+			  struct zynqmp_pm_request *reqs,
+			  unsigned int max_reqs)
+{
+	batch->reqs = reqs;
+	batch->nr_reqs = 0;
+	batch->max_reqs = max_reqs;
+	batch->ret = 0;
+	batch->complete = NULL;
+	batch->data = NULL;
+	init_completion(&batch->done);
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_batch_init);
+
+/**
+ * zynqmp_pm_batch_add() - Queue an EEMI request in a batch
+ * @batch:	Batch to add the request to
+ * @api_id:	Requested PM-API call
+ * @num_args:	Number of arguments that follow
+ *
+ * The request is only issued when the batch is submitted. Its return
+ * payload and status are then found in the entry of the batch whose index
+ * is returned.
+ *
+ * Return: Index of the request in the batch, -EINVAL if there are too many
+ * arguments or -ENOSPC if the batch is full.
+ */
+int zynqmp_pm_batch_add(struct zynqmp_pm_batch *batch, u32 api_id,
+			u32 num_args, ...)
+{
+	struct zynqmp_pm_request *req;
+	va_list arg_list;
+	u32 i;
+
+	if (num_args > ZYNQMP_PM_BATCH_MAX_ARGS)
+		return -EINVAL;
+
+	if (batch->nr_reqs == batch->max_reqs)
+		return -ENOSPC;
+
+	req = &batch->reqs[batch->nr_reqs];
+	memset(req, 0, sizeof(*req));
+	req->api_id = api_id;
+	req->num_args = num_args;
+
+	va_start(arg_list, num_args);
+	for (i = 0; i < num_args; i++)
+		req->args[i] = va_arg(arg_list, u32);
+	va_end(arg_list);
+
+	return batch->nr_reqs++;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_batch_add);
+
+/* Issue the requests in order, stopping at the first one that fails */
+static int zynqmp_pm_batch_run(struct zynqmp_pm_batch *batch)
+{
+	struct zynqmp_pm_request *req;
+	unsigned int i;
+
+	for (i = 0; i < batch->nr_reqs; i++) {
+		req = &batch->reqs[i];
+		req->ret = zynqmp_pm_invoke_fn(req->api_id, req->ret_payload,
+					       req->num_args, req->args[0],
+					       req->args[1], req->args[2],
+					       req->args[3], req->args[4],
+					       req->args[5]);
+		if (req->ret)
+			return req->ret;
+	}
+
+	return 0;
+}
+
+/**
+ * zynqmp_pm_batch_submit() - Issue the requests of a batch
+ * @batch:	Batch to submit
+ *
+ * Requests are issued in the order they were added. Later requests may
+ * depend on earlier ones, so the first failure ends the batch and the
+ * requests after it are left with a zero status and payload.
+ *
+ * Return: 0 if all the requests succeeded, else the error of the failing one.
+ */
+int zynqmp_pm_batch_submit(struct zynqmp_pm_batch *batch)
+{
+	batch->ret = zynqmp_pm_batch_run(batch);
+
+	return batch->ret;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_batch_submit);
+
+static void zynqmp_pm_batch_work(struct work_struct *work)
+{
+	struct zynqmp_pm_batch *batch = container_of(work,
+						     struct zynqmp_pm_batch,
+						     work);
+
+	batch->ret = zynqmp_pm_batch_run(batch);
+
+	if (batch->complete)
+		batch->complete(batch, batch->data);
+	complete_all(&batch->done);
+}
+
+/**
+ * zynqmp_pm_batch_submit_async() - Issue the requests of a batch in background
+ * @batch:	Batch to submit
+ * @complete:	Optional function called once the batch is done
+ * @data:	Argument passed to @complete
+ *
+ * Same as zynqmp_pm_batch_submit(), except that the requests are issued
+ * from a worker. The batch must not be touched until @complete is called or
+ * zynqmp_pm_batch_wait() returns.
+ *
+ * Return: 0 as the batch was queued.
+ */
+int zynqmp_pm_batch_submit_async(struct zynqmp_pm_batch *batch,
+				 void (*complete)(struct zynqmp_pm_batch *batch,
+						  void *data),
+				 void *data)
+{
+	batch->complete = complete;
+	batch->data = data;
+	reinit_completion(&batch->done);
+	INIT_WORK(&batch->work, zynqmp_pm_batch_work);
+	queue_work(system_unbound_wq, &batch->work);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_batch_submit_async);
+
+/**
+ * zynqmp_pm_batch_wait() - Wait for an asynchronous batch to complete
+ * @batch:	Batch submitted with zynqmp_pm_batch_submit_async()
+ *
+ * Return: 0 if all the requests succeeded, else the error of the failing one.
+ */
+int zynqmp_pm_batch_wait(struct zynqmp_pm_batch *batch)
+{
+	wait_for_completion(&batch->done);
+
+	return batch->ret;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_batch_wait);
+
+MODULE_DESCRIPTION("Xilinx Zynq MPSoC batched EEMI requests");
+MODULE_LICENSE("GPL");
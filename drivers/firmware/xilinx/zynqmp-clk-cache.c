@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Zynq MPSoC Firmware layer - clock settings cache
+ *
+ * The clock drivers read the divider and parent of their clocks from the
+ * PMU firmware each time the clock framework asks for them. Keep the last
+ * values read or set from Linux, so that those reads don't trap into the
+ * firmware again. Values changed behind Linux's back, e.g. by the firmware
+ * itself, have to be dropped with the invalidate calls.
+ *
+ * The enable state is not cached: the firmware keeps a clock running while
+ * any master uses it, so it changes with the requests of the other masters.
+ */
+
+#include <linux/firmware/xlnx-zynqmp.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/xarray.h>
+
+#define ZYNQMP_CLK_CACHE_DIVIDER	BIT(0)
+#define ZYNQMP_CLK_CACHE_PARENT		BIT(1)
+
+/* Number of clocks whose settings are fetched by one batch */
+#define ZYNQMP_CLK_CACHE_BATCH		32U
+
+struct zynqmp_clk_cache_entry {
+	unsigned long valid;
+	u32 divider;
+	u32 parent;
+};
+
+/* Entries are never freed, the set of clocks is fixed */
+static DEFINE_XARRAY(zynqmp_clk_cache);
+static DEFINE_SPINLOCK(zynqmp_clk_cache_lock);
+
+/*
+ * Bumped by every change of the cache, so that a value read from the
+ * firmware is not cached if it may have been changed meanwhile.
+ */
+static unsigned long zynqmp_clk_cache_seq;
+
+static u32 *zynqmp_clk_cache_field(struct zynqmp_clk_cache_entry *entry,
+				   unsigned long field)
+{
+	if (field == ZYNQMP_CLK_CACHE_DIVIDER)
+		return &entry->divider;
+	return &entry->parent;
+}
+
+static bool zynqmp_clk_cache_get(u32 clock_id, unsigned long field, u32 *val,
+				 unsigned long *seq)
+{
+	struct zynqmp_clk_cache_entry *entry;
+	unsigned long flags;
+	bool hit = false;
+
+	spin_lock_irqsave(&zynqmp_clk_cache_lock, flags);
+	entry = xa_load(&zynqmp_clk_cache, clock_id);
+	if (entry && (entry->valid & field)) {
+		*val = *zynqmp_clk_cache_field(entry, field);
+		hit = true;
+	}
+	*seq = zynqmp_clk_cache_seq;
+	spin_unlock_irqrestore(&zynqmp_clk_cache_lock, flags);
+
+	return hit;
+}
+
+static void __zynqmp_clk_cache_set(u32 clock_id, unsigned long field, u32 val)
+{
+	struct zynqmp_clk_cache_entry *entry;
+
+	lockdep_assert_held(&zynqmp_clk_cache_lock);
+
+	entry = xa_load(&zynqmp_clk_cache, clock_id);
+	if (!entry) {
+		entry = kzalloc(sizeof(*entry), GFP_ATOMIC);
+		if (!entry)
+			return;
+		if (xa_err(xa_store(&zynqmp_clk_cache, clock_id, entry,
+				    GFP_ATOMIC))) {
+			kfree(entry);
+			return;
+		}
+	}
+
+	*zynqmp_clk_cache_field(entry, field) = val;
+	entry->valid |= field;
+}
+
+/* Cache a value read from the firmware, unless the cache changed since */
+static void zynqmp_clk_cache_fill(u32 clock_id, unsigned long field, u32 val,
+				  unsigned long seq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&zynqmp_clk_cache_lock, flags);
+	if (seq == zynqmp_clk_cache_seq)
+		__zynqmp_clk_cache_set(clock_id, field, val);
+	spin_unlock_irqrestore(&zynqmp_clk_cache_lock, flags);
+}
+
+/* Record a value set from Linux, or forget it if setting it failed */
+static void zynqmp_clk_cache_update(u32 clock_id, unsigned long field, u32 val,
+				    bool valid)
+{
+	struct zynqmp_clk_cache_entry *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zynqmp_clk_cache_lock, flags);
+	zynqmp_clk_cache_seq++;
+	if (valid) {
+		__zynqmp_clk_cache_set(clock_id, field, val);
+	} else {
+		entry = xa_load(&zynqmp_clk_cache, clock_id);
+		if (entry)
+			entry->valid &= ~field;
+	}
+	spin_unlock_irqrestore(&zynqmp_clk_cache_lock, flags);
+}
+
+static int zynqmp_clk_cache_read(u32 clock_id, unsigned long field, u32 *val,
+				 int (*read)(u32 clock_id, u32 *val))
+{
+	unsigned long seq;
+	int ret;
+
+	if (zynqmp_clk_cache_get(clock_id, field, val, &seq))
+		return 0;
+
+	ret = read(clock_id, val);
+	if (!ret)
+		zynqmp_clk_cache_fill(clock_id, field, *val, seq);
+
+	return ret;
+}
+
+/**
+ * zynqmp_pm_clock_getdivider_cached() - Get the clock divider, from the
+ *					 cache if possible
+ * @clock_id:	ID of the clock
+ * @divider:	Divider value
+ *
+ * Return: Returns status, either success or error+reason
+ */
+int zynqmp_pm_clock_getdivider_cached(u32 clock_id, u32 *divider)
+{
+	return zynqmp_clk_cache_read(clock_id, ZYNQMP_CLK_CACHE_DIVIDER,
+				     divider, zynqmp_pm_clock_getdivider);
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_getdivider_cached);
+
+/**
+ * zynqmp_pm_clock_getparent_cached() - Get the clock parent, from the cache
+ *					if possible
+ * @clock_id:	ID of the clock
+ * @parent_id:	Index of the parent of the clock
+ *
+ * Return: Returns status, either success or error+reason
+ */
+int zynqmp_pm_clock_getparent_cached(u32 clock_id, u32 *parent_id)
+{
+	return zynqmp_clk_cache_read(clock_id, ZYNQMP_CLK_CACHE_PARENT,
+				     parent_id, zynqmp_pm_clock_getparent);
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_getparent_cached);
+
+/**
+ * zynqmp_pm_clock_setdivider_cached() - Set the clock divider and update
+ *					 the cache
+ * @clock_id:	ID of the clock
+ * @divider:	Divider value
+ *
+ * Return: Returns status, either success or error+reason
+ */
+int zynqmp_pm_clock_setdivider_cached(u32 clock_id, u32 divider)
+{
+	int ret = zynqmp_pm_clock_setdivider(clock_id, divider);
+
+	zynqmp_clk_cache_update(clock_id, ZYNQMP_CLK_CACHE_DIVIDER, divider,
+				!ret);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_setdivider_cached);
+
+/**
+ * zynqmp_pm_clock_setparent_cached() - Set the clock parent and update the
+ *					cache
+ * @clock_id:	ID of the clock
+ * @parent_id:	Index of the new parent of the clock
+ *
+ * Return: Returns status, either success or error+reason
+ */
+int zynqmp_pm_clock_setparent_cached(u32 clock_id, u32 parent_id)
+{
+	int ret = zynqmp_pm_clock_setparent(clock_id, parent_id);
+
+	zynqmp_clk_cache_update(clock_id, ZYNQMP_CLK_CACHE_PARENT, parent_id,
+				!ret);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_setparent_cached);
+
+/**
+ * zynqmp_pm_clock_cache_invalidate() - Drop the cached settings of a clock
+ * @clock_id:	ID of the clock
+ *
+ * To be called when the firmware reports a change of the clock.
+ */
+void zynqmp_pm_clock_cache_invalidate(u32 clock_id)
+{
+	struct zynqmp_clk_cache_entry *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zynqmp_clk_cache_lock, flags);
+	zynqmp_clk_cache_seq++;
+	entry = xa_load(&zynqmp_clk_cache, clock_id);
+	if (entry)
+		entry->valid = 0;
+	spin_unlock_irqrestore(&zynqmp_clk_cache_lock, flags);
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_cache_invalidate);
+
+/**
+ * zynqmp_pm_clock_cache_invalidate_all() - Drop the cached settings of all
+ *					    clocks
+ *
+ * To be called when the firmware may have changed any clock, e.g. after a
+ * subsystem restart or a system suspend.
+ */
+void zynqmp_pm_clock_cache_invalidate_all(void)
+{
+	struct zynqmp_clk_cache_entry *entry;
+	unsigned long flags, index;
+
+	spin_lock_irqsave(&zynqmp_clk_cache_lock, flags);
+	zynqmp_clk_cache_seq++;
+	xa_for_each(&zynqmp_clk_cache, index, entry)
+		entry->valid = 0;
+	spin_unlock_irqrestore(&zynqmp_clk_cache_lock, flags);
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_cache_invalidate_all);
+
+static const struct {
+	u32 api_id;
+	unsigned long field;
+} zynqmp_clk_cache_reads[] = {
+	{ PM_CLOCK_GETDIVIDER,	ZYNQMP_CLK_CACHE_DIVIDER },
+	{ PM_CLOCK_GETPARENT,	ZYNQMP_CLK_CACHE_PARENT },
+};
+
+#define ZYNQMP_CLK_CACHE_NR_READS	ARRAY_SIZE(zynqmp_clk_cache_reads)
+
+/*
+ * Issue the queued reads and cache the results. Not every clock has a
+ * divider or a parent, so the reads following a failing one are submitted
+ * again until all of them were issued.
+ */
+static void zynqmp_clk_cache_prefetch_batch(struct zynqmp_pm_request *reqs,
+					    unsigned int nr_reqs)
+{
+	struct zynqmp_pm_batch batch;
+	unsigned int start = 0, i;
+	unsigned long seq;
+
+	while (start < nr_reqs) {
+		zynqmp_pm_batch_init(&batch, reqs + start, nr_reqs - start);
+		batch.nr_reqs = nr_reqs - start;
+
+		spin_lock_irq(&zynqmp_clk_cache_lock);
+		seq = zynqmp_clk_cache_seq;
+		spin_unlock_irq(&zynqmp_clk_cache_lock);
+
+		zynqmp_pm_batch_submit(&batch);
+
+		for (i = start; i < nr_reqs && !reqs[i].ret; i++)
+			zynqmp_clk_cache_fill(reqs[i].args[0],
+					      zynqmp_clk_cache_reads[i % ZYNQMP_CLK_CACHE_NR_READS].field,
+					      reqs[i].ret_payload[1], seq);
+		start = i + 1;
+	}
+}
+
+/**
+ * zynqmp_pm_clock_cache_prefetch() - Read the settings of clocks in bulk
+ * @clock_ids:	IDs of the clocks
+ * @nr:		Number of entries of @clock_ids
+ *
+ * Meant to be called by the clock driver at probe time with all of its
+ * clocks, so that registering them with the clock framework is served from
+ * the cache.
+ *
+ * Return: 0 on success, -ENOMEM if the requests could not be allocated.
+ */
+int zynqmp_pm_clock_cache_prefetch(const u32 *clock_ids, unsigned int nr)
+{
+	struct zynqmp_pm_request *reqs;
+	struct zynqmp_pm_batch batch;
+	unsigned int i, j, n;
+
+	reqs = kcalloc(ZYNQMP_CLK_CACHE_BATCH * ZYNQMP_CLK_CACHE_NR_READS,
+		       sizeof(*reqs), GFP_KERNEL);
+	if (!reqs)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i += n) {
+		n = min(nr - i, ZYNQMP_CLK_CACHE_BATCH);
+
+		zynqmp_pm_batch_init(&batch, reqs,
+				     n * ZYNQMP_CLK_CACHE_NR_READS);
+		for (j = 0; j < n * ZYNQMP_CLK_CACHE_NR_READS; j++)
+			zynqmp_pm_batch_add(&batch,
+					    zynqmp_clk_cache_reads[j % ZYNQMP_CLK_CACHE_NR_READS].api_id,
+					    1, clock_ids[i + j / ZYNQMP_CLK_CACHE_NR_READS]);
+
+		zynqmp_clk_cache_prefetch_batch(reqs, batch.nr_reqs);
+	}
+
+	kfree(reqs);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(zynqmp_pm_clock_cache_prefetch);
@@ -8,6 +8,7 @@
  * With code from the mailing list:
  * Copyright (C) 2013 Xilinx, Inc.
  */
+#include <crypto/sha2.h>
 #include <linux/dma-buf.h>
 #include <linux/dma-map-ops.h>
 #include <linux/kernel.h>
@@ -28,6 +29,26 @@ struct fpga_mgr_devres {
 	struct fpga_manager *mgr;
 };
 
+/**
+ * struct fpga_mgr_cache_entry - image kept in memory by an FPGA manager
+ * @node: entry in &fpga_manager->cache
+ * @name: firmware name the image was requested with
+ * @digest: SHA-256 of the image
+ * @size: size of the image
+ * @sgt: pages holding the image, DMA mapped if @mapped
+ * @mapped: @sgt is mapped for the parent device of the manager
+ * @hits: number of loads served from the entry
+ */
+struct fpga_mgr_cache_entry {
+	struct list_head node;
+	const char *name;
+	u8 digest[SHA256_DIGEST_SIZE];
+	size_t size;
+	struct sg_table sgt;
+	bool mapped;
+	unsigned long hits;
+};
+
 static inline void fpga_mgr_fpga_remove(struct fpga_manager *mgr)
 {
 	if (mgr->mops->fpga_remove)
@@ -555,7 +576,9 @@ static int fpga_dmabuf_load(struct fpga_manager *mgr,
 	}
 
 	info->sgt = sgt;
+	mgr->sgt_mapped = true;
 	ret = fpga_mgr_buf_load_sg(mgr, info, info->sgt);
+	mgr->sgt_mapped = false;
 	dma_buf_unmap_attachment(attach, sgt, DMA_BIDIRECTIONAL);
 
 fail_detach:
@@ -566,6 +589,216 @@ static int fpga_dmabuf_load(struct fpga_manager *mgr,
 	return ret;
 }
 
+static struct fpga_mgr_cache_entry *
+fpga_mgr_cache_find(struct fpga_manager *mgr, const char *image_name)
+{
+	struct fpga_mgr_cache_entry *entry;
+
+	lockdep_assert_held(&mgr->cache_mutex);
+
+	list_for_each_entry(entry, &mgr->cache, node)
+		if (!strcmp(entry->name, image_name))
+			return entry;
+
+	return NULL;
+}
+
+static void fpga_mgr_cache_free(struct fpga_manager *mgr,
+				struct fpga_mgr_cache_entry *entry)
+{
+	struct sg_page_iter piter;
+
+	if (entry->mapped)
+		dma_unmap_sgtable(mgr->dev.parent, &entry->sgt, DMA_TO_DEVICE, 0);
+	for_each_sgtable_page(&entry->sgt, &piter, 0)
+		__free_page(sg_page_iter_page(&piter));
+	sg_free_table(&entry->sgt);
+	kfree_const(entry->name);
+	kfree(entry);
+}
+
+static struct fpga_mgr_cache_entry *
+fpga_mgr_cache_alloc(struct fpga_manager *mgr, const char *image_name,
+		     const struct firmware *fw)
+{
+	struct fpga_mgr_cache_entry *entry;
+	unsigned int nr_pages, i;
+	struct page **pages;
+	size_t len;
+	int ret;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return ERR_PTR(-ENOMEM);
+
+	entry->name = kstrdup_const(image_name, GFP_KERNEL);
+	if (!entry->name) {
+		ret = -ENOMEM;
+		goto err_entry;
+	}
+
+	entry->size = fw->size;
+	sha256(fw->data, fw->size, entry->digest);
+
+	/* Order-0 pages, so that large images need no contiguous memory */
+	nr_pages = DIV_ROUND_UP(fw->size, PAGE_SIZE);
+	pages = kvcalloc(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages) {
+		ret = -ENOMEM;
+		goto err_name;
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto err_pages;
+		}
+		len = min_t(size_t, PAGE_SIZE, fw->size - i * PAGE_SIZE);
+		memcpy_to_page(pages[i], 0, fw->data + i * PAGE_SIZE, len);
+	}
+
+	ret = sg_alloc_table_from_pages(&entry->sgt, pages, nr_pages, 0,
+					fw->size, GFP_KERNEL);
+	if (ret)
+		goto err_pages;
+	kvfree(pages);
+
+	if (mgr->mops->write_sg && mgr->mops->premapped_sg) {
+		ret = dma_map_sgtable(mgr->dev.parent, &entry->sgt,
+				      DMA_TO_DEVICE, 0);
+		if (ret) {
+			fpga_mgr_cache_free(mgr, entry);
+			return ERR_PTR(ret);
+		}
+		entry->mapped = true;
+	}
+
+	return entry;
+
+err_pages:
+	while (i--)
+		__free_page(pages[i]);
+	kvfree(pages);
+err_name:
+	kfree_const(entry->name);
+err_entry:
+	kfree(entry);
+	return ERR_PTR(ret);
+}
+
+/**
+ * fpga_mgr_cache_add - keep an FPGA image in memory for later loads
+ * @mgr:	fpga manager
+ * @image_name:	name of image file on the firmware search path
+ *
+ * Request @image_name and keep a copy of it, mapped for DMA once if the low
+ * level driver supports it. Later loads of @image_name through
+ * fpga_mgr_load() or the firmware attribute are served from this copy and
+ * go straight to the low level driver. An existing entry of the same name is
+ * replaced if the image changed.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int fpga_mgr_cache_add(struct fpga_manager *mgr, const char *image_name)
+{
+	struct fpga_mgr_cache_entry *entry, *old;
+	u8 digest[SHA256_DIGEST_SIZE];
+	const struct firmware *fw;
+	int ret;
+
+	ret = request_firmware(&fw, image_name, &mgr->dev);
+	if (ret) {
+		dev_err(&mgr->dev, "Error requesting firmware %s\n",
+			image_name);
+		return ret;
+	}
+
+	mutex_lock(&mgr->cache_mutex);
+	old = fpga_mgr_cache_find(mgr, image_name);
+	if (old) {
+		sha256(fw->data, fw->size, digest);
+		if (old->size == fw->size &&
+		    !memcmp(old->digest, digest, sizeof(digest)))
+			goto out;
+	}
+
+	entry = fpga_mgr_cache_alloc(mgr, image_name, fw);
+	if (IS_ERR(entry)) {
+		ret = PTR_ERR(entry);
+		goto out;
+	}
+
+	if (old) {
+		list_del(&old->node);
+		fpga_mgr_cache_free(mgr, old);
+	}
+	list_add(&entry->node, &mgr->cache);
+
+out:
+	mutex_unlock(&mgr->cache_mutex);
+	release_firmware(fw);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(fpga_mgr_cache_add);
+
+/**
+ * fpga_mgr_cache_remove - drop an FPGA image added by fpga_mgr_cache_add()
+ * @mgr:	fpga manager
+ * @image_name:	name the image was added with
+ *
+ * Return: 0 on success, -ENOENT if @image_name is not cached.
+ */
+int fpga_mgr_cache_remove(struct fpga_manager *mgr, const char *image_name)
+{
+	struct fpga_mgr_cache_entry *entry;
+
+	mutex_lock(&mgr->cache_mutex);
+	entry = fpga_mgr_cache_find(mgr, image_name);
+	if (entry) {
+		list_del(&entry->node);
+		fpga_mgr_cache_free(mgr, entry);
+	}
+	mutex_unlock(&mgr->cache_mutex);
+
+	return entry ? 0 : -ENOENT;
+}
+EXPORT_SYMBOL_GPL(fpga_mgr_cache_remove);
+
+/* Load @image_name from the cache, -ENOENT if it is not cached */
+static int fpga_mgr_cache_load(struct fpga_manager *mgr,
+			       struct fpga_image_info *info,
+			       const char *image_name)
+{
+	struct fpga_mgr_cache_entry *entry;
+	int ret = -ENOENT;
+
+	mutex_lock(&mgr->cache_mutex);
+	entry = fpga_mgr_cache_find(mgr, image_name);
+	if (entry) {
+		entry->hits++;
+		mgr->sgt_mapped = entry->mapped;
+		ret = fpga_mgr_buf_load_sg(mgr, info, &entry->sgt);
+		mgr->sgt_mapped = false;
+	}
+	mutex_unlock(&mgr->cache_mutex);
+
+	return ret;
+}
+
+static void fpga_mgr_cache_flush(struct fpga_manager *mgr)
+{
+	struct fpga_mgr_cache_entry *entry, *tmp;
+
+	mutex_lock(&mgr->cache_mutex);
+	list_for_each_entry_safe(entry, tmp, &mgr->cache, node) {
+		list_del(&entry->node);
+		fpga_mgr_cache_free(mgr, entry);
+	}
+	mutex_unlock(&mgr->cache_mutex);
+}
+
 /**
  * fpga_mgr_firmware_load - request firmware and load to fpga
  * @mgr:	fpga manager
@@ -597,6 +830,10 @@ static int fpga_mgr_firmware_load(struct fpga_manager *mgr,
 	info->flags = mgr->flags;
 	memcpy(info->key, mgr->key, ENCRYPTED_KEY_LEN);
 
+	ret = fpga_mgr_cache_load(mgr, info, image_name);
+	if (ret != -ENOENT)
+		return ret;
+
 	ret = request_firmware(&fw, image_name, dev);
 	if (ret) {
 		mgr->state = FPGA_MGR_STATE_FIRMWARE_REQ_ERR;
@@ -778,12 +1015,69 @@ static ssize_t flags_store(struct device *dev,
 	return count;
 }
 
+static ssize_t cache_show(struct device *dev,
+			  struct device_attribute *attr, char *buf)
+{
+	struct fpga_manager *mgr = to_fpga_manager(dev);
+	struct fpga_mgr_cache_entry *entry;
+	int len = 0;
+
+	mutex_lock(&mgr->cache_mutex);
+	list_for_each_entry(entry, &mgr->cache, node)
+		len += sysfs_emit_at(buf, len, "%s %zu %*phN %lu\n",
+				     entry->name, entry->size,
+				     SHA256_DIGEST_SIZE, entry->digest,
+				     entry->hits);
+	mutex_unlock(&mgr->cache_mutex);
+
+	return len;
+}
+
+static ssize_t cache_add_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct fpga_manager *mgr = to_fpga_manager(dev);
+	char *image_name;
+	int ret;
+
+	image_name = kstrndup(buf, count, GFP_KERNEL);
+	if (!image_name)
+		return -ENOMEM;
+
+	ret = fpga_mgr_cache_add(mgr, strim(image_name));
+	kfree(image_name);
+
+	return ret ? ret : count;
+}
+
+static ssize_t cache_remove_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct fpga_manager *mgr = to_fpga_manager(dev);
+	char *image_name;
+	int ret;
+
+	image_name = kstrndup(buf, count, GFP_KERNEL);
+	if (!image_name)
+		return -ENOMEM;
+
+	ret = fpga_mgr_cache_remove(mgr, strim(image_name));
+	kfree(image_name);
+
+	return ret ? ret : count;
+}
+
 static DEVICE_ATTR_RO(name);
 static DEVICE_ATTR_RO(state);
 static DEVICE_ATTR_RO(status);
 static DEVICE_ATTR_WO(firmware);
 static DEVICE_ATTR_RW(flags);
 static DEVICE_ATTR_RW(key);
+static DEVICE_ATTR_RO(cache);
+static DEVICE_ATTR_WO(cache_add);
+static DEVICE_ATTR_WO(cache_remove);
 
 static struct attribute *fpga_mgr_attrs[] = {
 	&dev_attr_name.attr,
@@ -792,6 +1086,9 @@ static struct attribute *fpga_mgr_attrs[] = {
 	&dev_attr_firmware.attr,
 	&dev_attr_flags.attr,
 	&dev_attr_key.attr,
+	&dev_attr_cache.attr,
+	&dev_attr_cache_add.attr,
+	&dev_attr_cache_remove.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(fpga_mgr);
@@ -904,6 +1201,63 @@ static const struct file_operations fpga_mgr_ops_image = {
 	.open = fpga_mgr_read_open,
 	.read = seq_read,
 };
+
+/*
+ * Raw configuration data readback. Each read() is handed to the driver as
+ * a single request and copied straight out of its DMA buffer, so pread()
+ * of a frame range only costs the readback of that range.
+ */
+static ssize_t fpga_mgr_readback_read(struct file *file, char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	struct fpga_manager *mgr = file->private_data;
+	const void *data;
+	ssize_t ret;
+
+	if (!mgr->mops->read_data)
+		return -ENOENT;
+
+	if (*ppos < 0)
+		return -EINVAL;
+
+	if (!count)
+		return 0;
+
+	if (!mutex_trylock(&mgr->ref_mutex))
+		return -EBUSY;
+
+	if (mgr->state != FPGA_MGR_STATE_OPERATING) {
+		ret = -EPERM;
+		goto err_unlock;
+	}
+
+	data = mgr->mops->read_data(mgr, *ppos, &count);
+	if (IS_ERR(data)) {
+		ret = PTR_ERR(data);
+		dev_err(&mgr->dev, "Error while reading back configuration data\n");
+		goto err_unlock;
+	}
+
+	if (count && copy_to_user(ubuf, data, count)) {
+		ret = -EFAULT;
+		goto err_unlock;
+	}
+
+	*ppos += count;
+	ret = count;
+
+err_unlock:
+	mutex_unlock(&mgr->ref_mutex);
+
+	return ret;
+}
+
+static const struct file_operations fpga_mgr_ops_readback = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = fpga_mgr_readback_read,
+	.llseek = default_llseek,
+};
 #endif
 
 static int fpga_dmabuf_fd_get(struct file *file, char __user *argp)
@@ -987,6 +1341,19 @@ int fpga_mgr_lock(struct fpga_manager *mgr)
 }
 EXPORT_SYMBOL_GPL(fpga_mgr_lock);
 
+/**
+ * fpga_mgr_lock_wait - Lock FPGA manager, waiting for the current user
+ * @mgr:	fpga manager
+ *
+ * Like fpga_mgr_lock(), but sleeps until the manager is free instead of
+ * failing, for callers programming in the background.
+ */
+void fpga_mgr_lock_wait(struct fpga_manager *mgr)
+{
+	mutex_lock(&mgr->ref_mutex);
+}
+EXPORT_SYMBOL_GPL(fpga_mgr_lock_wait);
+
 /**
  * fpga_mgr_unlock - Unlock FPGA manager after done programming
  * @mgr:	fpga manager
@@ -1038,6 +1405,8 @@ fpga_mgr_register_full(struct device *parent, const struct fpga_manager_info *in
 	}
 
 	mutex_init(&mgr->ref_mutex);
+	mutex_init(&mgr->cache_mutex);
+	INIT_LIST_HEAD(&mgr->cache);
 
 	mgr->name = info->name;
 	mgr->mops = info->mops;
@@ -1104,6 +1473,10 @@ fpga_mgr_register_full(struct device *parent, const struct fpga_manager_info *in
 		debugfs_remove_recursive(mgr->dir);
 		goto error_device;
 	}
+
+	if (mgr->mops->read_data)
+		debugfs_create_file("readback", 0400, parent_dir, mgr,
+				    &fpga_mgr_ops_readback);
 #endif
 	dev_info(&mgr->dev, "%s registered\n", mgr->name);
 
@@ -1167,6 +1540,9 @@ void fpga_mgr_unregister(struct fpga_manager *mgr)
 	 */
 	fpga_mgr_fpga_remove(mgr);
 
+	/* The cached mappings belong to the parent device */
+	fpga_mgr_cache_flush(mgr);
+
 	device_unregister(&mgr->dev);
 }
 EXPORT_SYMBOL_GPL(fpga_mgr_unregister);
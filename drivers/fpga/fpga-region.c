@@ -35,6 +35,7 @@ EXPORT_SYMBOL_GPL(fpga_region_class_find);
 /**
  * fpga_region_get - get an exclusive reference to an fpga region
  * @region: FPGA Region struct
+ * @wait: sleep until the region is free instead of failing
  *
  * Caller should call fpga_region_put() when done with region.
  *
@@ -43,11 +44,14 @@ EXPORT_SYMBOL_GPL(fpga_region_class_find);
  * * -EBUSY if someone already has a reference to the region.
  * * -ENODEV if can't take parent driver module refcount.
  */
-static struct fpga_region *fpga_region_get(struct fpga_region *region)
+static struct fpga_region *fpga_region_get(struct fpga_region *region,
+					   bool wait)
 {
 	struct device *dev = &region->dev;
 
-	if (!mutex_trylock(&region->mutex)) {
+	if (wait) {
+		mutex_lock(&region->mutex);
+	} else if (!mutex_trylock(&region->mutex)) {
 		dev_dbg(dev, "%s: FPGA Region already in use\n", __func__);
 		return ERR_PTR(-EBUSY);
 	}
@@ -94,22 +98,26 @@ static void fpga_region_put(struct fpga_region *region)
  *
  * Return: 0 for success or negative error code.
  */
-int fpga_region_program_fpga(struct fpga_region *region)
+static int __fpga_region_program_fpga(struct fpga_region *region, bool wait)
 {
 	struct device *dev = &region->dev;
 	struct fpga_image_info *info = region->info;
 	int ret;
 
-	region = fpga_region_get(region);
+	region = fpga_region_get(region, wait);
 	if (IS_ERR(region)) {
 		dev_err(dev, "failed to get FPGA region\n");
 		return PTR_ERR(region);
 	}
 
-	ret = fpga_mgr_lock(region->mgr);
-	if (ret) {
-		dev_err(dev, "FPGA manager is busy\n");
-		goto err_put_region;
+	if (wait) {
+		fpga_mgr_lock_wait(region->mgr);
+	} else {
+		ret = fpga_mgr_lock(region->mgr);
+		if (ret) {
+			dev_err(dev, "FPGA manager is busy\n");
+			goto err_put_region;
+		}
 	}
 
 	/*
@@ -157,8 +165,94 @@ int fpga_region_program_fpga(struct fpga_region *region)
 
 	return ret;
 }
+
+int fpga_region_program_fpga(struct fpga_region *region)
+{
+	return __fpga_region_program_fpga(region, false);
+}
 EXPORT_SYMBOL_GPL(fpga_region_program_fpga);
 
+static void fpga_region_program_work(struct work_struct *work)
+{
+	struct fpga_region *region = container_of(work, struct fpga_region,
+						  program_work);
+	void (*complete)(struct fpga_region *region, int ret, void *data);
+	void *data;
+	int ret;
+
+	ret = __fpga_region_program_fpga(region, true);
+
+	spin_lock(&region->program_lock);
+	complete = region->program_complete;
+	data = region->program_data;
+	region->program_complete = NULL;
+	region->program_err = ret;
+	region->program_done = true;
+	region->program_pending = false;
+	spin_unlock(&region->program_lock);
+
+	sysfs_notify(&region->dev.kobj, NULL, "program_status");
+
+	if (complete)
+		complete(region, ret, data);
+}
+
+/**
+ * fpga_region_program_fpga_async - program FPGA in the background
+ * @region: FPGA region
+ * @complete: optional function called with the result once done
+ * @data: argument passed to @complete
+ *
+ * Queue the programming of region->info and return. Unlike
+ * fpga_region_program_fpga(), the request waits for the region and its
+ * manager to become free rather than failing. The bridges are disabled
+ * for the duration and enabled again on success, as in the synchronous
+ * case. Completion is also signalled on the program_status attribute of
+ * the region, so that userspace can poll() it.
+ *
+ * Return: 0 if the request was queued, -EBUSY if one is already pending.
+ */
+int fpga_region_program_fpga_async(struct fpga_region *region,
+				   void (*complete)(struct fpga_region *region,
+						    int ret, void *data),
+				   void *data)
+{
+	spin_lock(&region->program_lock);
+	if (region->program_pending) {
+		spin_unlock(&region->program_lock);
+		return -EBUSY;
+	}
+	region->program_pending = true;
+	region->program_complete = complete;
+	region->program_data = data;
+	spin_unlock(&region->program_lock);
+
+	sysfs_notify(&region->dev.kobj, NULL, "program_status");
+	queue_work(system_unbound_wq, &region->program_work);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(fpga_region_program_fpga_async);
+
+/* Release what the last firmware attribute request left behind */
+static void fpga_region_program_info_put(struct fpga_region *region)
+{
+	if (!region->program_info)
+		return;
+
+	/* On success the bridges stay reserved, as for an overlay */
+	if (region->get_bridges && region->program_done &&
+	    !region->program_err) {
+		fpga_bridges_disable(&region->bridge_list);
+		fpga_bridges_put(&region->bridge_list);
+	}
+
+	if (region->info == region->program_info)
+		region->info = NULL;
+	fpga_image_info_free(region->program_info);
+	region->program_info = NULL;
+}
+
 static ssize_t compat_id_show(struct device *dev,
 			      struct device_attribute *attr, char *buf)
 {
@@ -174,8 +268,71 @@ static ssize_t compat_id_show(struct device *dev,
 
 static DEVICE_ATTR_RO(compat_id);
 
+static ssize_t firmware_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct fpga_region *region = to_fpga_region(dev);
+	struct fpga_image_info *info;
+	int ret;
+
+	if (READ_ONCE(region->program_pending))
+		return -EBUSY;
+
+	info = fpga_image_info_alloc(dev);
+	if (!info)
+		return -ENOMEM;
+
+	info->firmware_name = devm_kstrdup(dev, buf, GFP_KERNEL);
+	if (!info->firmware_name) {
+		fpga_image_info_free(info);
+		return -ENOMEM;
+	}
+	info->firmware_name[strcspn(info->firmware_name, "\n")] = '\0';
+
+	/* Regions described by an overlay are owned by that overlay */
+	mutex_lock(&region->mutex);
+	if (region->info && region->info != region->program_info) {
+		mutex_unlock(&region->mutex);
+		fpga_image_info_free(info);
+		return -EBUSY;
+	}
+	fpga_region_program_info_put(region);
+	region->info = info;
+	region->program_info = info;
+	mutex_unlock(&region->mutex);
+
+	ret = fpga_region_program_fpga_async(region, NULL, NULL);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_WO(firmware);
+
+static ssize_t program_status_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct fpga_region *region = to_fpga_region(dev);
+	ssize_t len;
+
+	spin_lock(&region->program_lock);
+	if (region->program_pending)
+		len = sysfs_emit(buf, "programming\n");
+	else if (!region->program_done)
+		len = sysfs_emit(buf, "idle\n");
+	else if (region->program_err)
+		len = sysfs_emit(buf, "error %d\n", region->program_err);
+	else
+		len = sysfs_emit(buf, "operating\n");
+	spin_unlock(&region->program_lock);
+
+	return len;
+}
+static DEVICE_ATTR_RO(program_status);
+
 static struct attribute *fpga_region_attrs[] = {
 	&dev_attr_compat_id.attr,
+	&dev_attr_firmware.attr,
+	&dev_attr_program_status.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(fpga_region);
@@ -216,6 +373,8 @@ fpga_region_register_full(struct device *parent, const struct fpga_region_info *
 
 	mutex_init(&region->mutex);
 	INIT_LIST_HEAD(&region->bridge_list);
+	INIT_WORK(&region->program_work, fpga_region_program_work);
+	spin_lock_init(&region->program_lock);
 
 	region->dev.class = &fpga_region_class;
 	region->dev.parent = parent;
@@ -276,6 +435,12 @@ EXPORT_SYMBOL_GPL(fpga_region_register);
  */
 void fpga_region_unregister(struct fpga_region *region)
 {
+	flush_work(&region->program_work);
+
+	mutex_lock(&region->mutex);
+	fpga_region_program_info_put(region);
+	mutex_unlock(&region->mutex);
+
 	device_unregister(&region->dev);
 }
 EXPORT_SYMBOL_GPL(fpga_region_unregister);
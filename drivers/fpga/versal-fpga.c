@@ -9,6 +9,7 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/of_address.h>
+#include <linux/scatterlist.h>
 #include <linux/string.h>
 #include <linux/firmware/xlnx-zynqmp.h>
 
@@ -19,39 +20,74 @@ static int versal_fpga_ops_write_init(struct fpga_manager *mgr,
 	return 0;
 }
 
-static int versal_fpga_ops_write_sg(struct fpga_manager *mgr,
-				    struct sg_table *sgt)
+/* Load the image from a bounce buffer copied from the pages of @sgt */
+static int versal_fpga_load_copy(struct fpga_manager *mgr,
+				 struct sg_table *sgt, size_t size)
 {
-	dma_addr_t dma_addr;
+	dma_addr_t dma_addr = 0;
+	char *kbuf;
 	int ret;
 
-	dma_addr = sg_dma_address(sgt->sgl);
+	kbuf = dma_alloc_coherent(mgr->dev.parent, size, &dma_addr, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+
+	sg_copy_to_buffer(sgt->sgl, sgt->orig_nents, kbuf, size);
 	ret = zynqmp_pm_load_pdi(PDI_SRC_DDR, dma_addr);
+	dma_free_coherent(mgr->dev.parent, size, kbuf, dma_addr);
 
 	return ret;
 }
 
-static int versal_fpga_ops_write(struct fpga_manager *mgr,
-				 const char *buf, size_t size)
+static int versal_fpga_ops_write_sg(struct fpga_manager *mgr,
+				    struct sg_table *sgt)
 {
-	dma_addr_t dma_addr = 0;
-	char *kbuf;
+	struct device *dev = mgr->dev.parent;
+	struct scatterlist *s;
+	dma_addr_t expected;
+	size_t size = 0;
+	bool contig = true;
+	unsigned int i;
 	int ret;
 
-	kbuf = dma_alloc_coherent(mgr->dev.parent, size, &dma_addr, GFP_KERNEL);
-	if (!kbuf)
-		return -ENOMEM;
+	for_each_sgtable_sg(sgt, s, i)
+		size += s->length;
 
-	memcpy(kbuf, buf, size);
-	ret = zynqmp_pm_load_pdi(PDI_SRC_DDR, dma_addr);
-	dma_free_coherent(mgr->dev.parent, size, kbuf, dma_addr);
+	/* dma-buf and cached images come mapped, the others are page lists */
+	if (!mgr->sgt_mapped) {
+		ret = dma_map_sgtable(dev, sgt, DMA_TO_DEVICE, 0);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * The PLM takes the address of the whole PDI. Behind an IOMMU the
+	 * mapping of any page list is contiguous, without one fall back to a
+	 * bounce buffer.
+	 */
+	expected = sg_dma_address(sgt->sgl);
+	for_each_sgtable_dma_sg(sgt, s, i) {
+		if (sg_dma_address(s) != expected) {
+			contig = false;
+			break;
+		}
+		expected += sg_dma_len(s);
+	}
+
+	if (contig)
+		ret = zynqmp_pm_load_pdi(PDI_SRC_DDR, sg_dma_address(sgt->sgl));
+	else
+		ret = versal_fpga_load_copy(mgr, sgt, size);
+
+	if (!mgr->sgt_mapped)
+		dma_unmap_sgtable(dev, sgt, DMA_TO_DEVICE, 0);
 
 	return ret;
 }
 
 static const struct fpga_manager_ops versal_fpga_ops = {
+	.premapped_sg = true,
 	.write_init = versal_fpga_ops_write_init,
-	.write = versal_fpga_ops_write,
 	.write_sg = versal_fpga_ops_write_sg,
 };
 
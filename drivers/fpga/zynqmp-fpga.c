@@ -9,6 +9,7 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/of_address.h>
+#include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/string.h>
 #include <linux/firmware/xlnx-zynqmp.h>
@@ -81,6 +82,12 @@ static struct zynqmp_configreg cfgreg[] = {
  *           to a minor version number.
  * @flags:	flags which is used to identify the bitfile type
  * @size:	Size of the Bit-stream used for readback
+ * @rb_buf:	Configuration data readback buffer
+ * @rb_dma:	DMA address of @rb_buf
+ * @rb_size:	Size of @rb_buf
+ * @rb_data:	Configuration data in @rb_buf, past the readback header
+ * @rb_valid:	Bytes of configuration data held at @rb_data
+ * @rb_next:	Offset following the last readback request, -1 if none
  */
 struct zynqmp_fpga_priv {
 	struct device *dev;
@@ -88,6 +95,12 @@ struct zynqmp_fpga_priv {
 	u32 version;
 	u32 flags;
 	u32 size;
+	void *rb_buf;
+	dma_addr_t rb_dma;
+	size_t rb_size;
+	const void *rb_data;
+	size_t rb_valid;
+	loff_t rb_next;
 };
 
 static int zynqmp_fpga_ops_write_init(struct fpga_manager *mgr,
@@ -99,6 +112,7 @@ static int zynqmp_fpga_ops_write_init(struct fpga_manager *mgr,
 
 	priv = mgr->priv;
 	priv->flags = info->flags;
+	priv->rb_next = -1;
 
 	/* Update firmware flags */
 	if (priv->flags & FPGA_MGR_USERKEY_ENCRYPTED_BITSTREAM)
@@ -119,8 +133,9 @@ static int zynqmp_fpga_ops_write_init(struct fpga_manager *mgr,
 	return 0;
 }
 
-static int zynqmp_fpga_ops_write(struct fpga_manager *mgr,
-				 const char *buf, size_t size)
+/* Load the image from a bounce buffer copied from the pages of @sgt */
+static int zynqmp_fpga_load_copy(struct fpga_manager *mgr,
+				 struct sg_table *sgt, size_t size)
 {
 	struct zynqmp_fpga_priv *priv;
 	int word_align, ret, index;
@@ -149,7 +164,8 @@ static int zynqmp_fpga_ops_write(struct fpga_manager *mgr,
 	for (index = 0; index < word_align; index++)
 		kbuf[index] = DUMMY_PAD_BYTE;
 
-	memcpy(&kbuf[index], buf, size - index);
+	sg_copy_to_buffer(sgt->sgl, sgt->orig_nents, &kbuf[index],
+			  size - index);
 
 	if (priv->flags & FPGA_MGR_USERKEY_ENCRYPTED_BITSTREAM) {
 		eemi_flags |= XILINX_ZYNQMP_PM_FPGA_ENCRYPTION_USERKEY;
@@ -202,14 +218,39 @@ static int zynqmp_fpga_ops_write_sg(struct fpga_manager *mgr,
 	dma_addr_t dma_addr, key_addr = 0;
 	struct zynqmp_fpga_priv *priv;
 	unsigned long contig_size;
+	struct scatterlist *s;
+	bool mapped = false;
 	u32 eemi_flags = 0;
+	size_t size = 0;
+	unsigned int i;
 	char *kbuf;
 	int ret;
 
 	priv = mgr->priv;
 
+	for_each_sgtable_sg(sgt, s, i)
+		size += s->length;
+
+	/* dma-buf and cached images come mapped, the others are page lists */
+	if (!mgr->sgt_mapped) {
+		ret = dma_map_sgtable(priv->dev, sgt, DMA_TO_DEVICE, 0);
+		if (ret)
+			return ret;
+		mapped = true;
+	}
+
+	/*
+	 * The firmware takes a single DMA range. Behind an IOMMU the mapping
+	 * of any page list is contiguous, without one fall back to a bounce
+	 * buffer rather than loading only the first run of the image.
+	 */
 	dma_addr = sg_dma_address(sgt->sgl);
 	contig_size = zynqmp_fpga_get_contiguous_size(sgt);
+	if (contig_size < size || size % FPGA_WORD_SIZE) {
+		ret = zynqmp_fpga_load_copy(mgr, sgt, size);
+		goto out;
+	}
+	priv->size = size;
 
 	if (priv->flags & FPGA_MGR_PARTIAL_RECONFIG)
 		eemi_flags |= XILINX_ZYNQMP_PM_FPGA_PARTIAL;
@@ -225,8 +266,10 @@ static int zynqmp_fpga_ops_write_sg(struct fpga_manager *mgr,
 	if (priv->flags & FPGA_MGR_USERKEY_ENCRYPTED_BITSTREAM) {
 		kbuf = dma_alloc_coherent(priv->dev, ENCRYPTED_KEY_LEN,
 					  &key_addr, GFP_KERNEL);
-		if (!kbuf)
-			return -ENOMEM;
+		if (!kbuf) {
+			ret = -ENOMEM;
+			goto out;
+		}
 		memcpy(kbuf, mgr->key, ENCRYPTED_KEY_LEN);
 		ret = zynqmp_pm_fpga_load(dma_addr, key_addr, eemi_flags);
 		dma_free_coherent(priv->dev, ENCRYPTED_KEY_LEN, kbuf, key_addr);
@@ -234,6 +277,10 @@ static int zynqmp_fpga_ops_write_sg(struct fpga_manager *mgr,
 		ret = zynqmp_pm_fpga_load(dma_addr, contig_size, eemi_flags);
 	}
 
+out:
+	if (mapped)
+		dma_unmap_sgtable(priv->dev, sgt, DMA_TO_DEVICE, 0);
+
 	return ret;
 }
 
@@ -342,6 +389,72 @@ static int zynqmp_fpga_read_cfgdata(struct fpga_manager *mgr,
 	return ret;
 }
 
+/*
+ * The firmware reads the configuration data back from the first frame on,
+ * so a request costs a readback of everything up to its end. Each request
+ * is read back afresh, except that a read continuing where the previous
+ * one stopped is served from the buffer, which is then filled up to the
+ * end of the data once: a sequential reader such as cat costs a single
+ * full readback rather than one per read() call.
+ */
+static const void *zynqmp_fpga_ops_read_data(struct fpga_manager *mgr,
+					     loff_t offset, size_t *count)
+{
+	struct zynqmp_fpga_priv *priv = mgr->priv;
+	size_t end, words, size;
+	u32 data_offset;
+	int ret;
+
+	if (!(priv->feature_list & XILINX_ZYNQMP_PM_FPGA_REG_READ_BACK))
+		return ERR_PTR(-EINVAL);
+
+	if (offset >= priv->size) {
+		*count = 0;
+		return NULL;
+	}
+
+	*count = min_t(size_t, *count, priv->size - offset);
+	end = offset + *count;
+
+	if (offset == priv->rb_next) {
+		if (end <= priv->rb_valid)
+			goto out;
+		end = priv->size;
+	}
+
+	words = DIV_ROUND_UP(end + DUMMY_FRAMES_SIZE, FPGA_WORD_SIZE);
+	size = words * FPGA_WORD_SIZE + READ_DMA_SIZE;
+	if (size > priv->rb_size) {
+		if (priv->rb_buf)
+			dmam_free_coherent(priv->dev, priv->rb_size,
+					   priv->rb_buf, priv->rb_dma);
+		priv->rb_size = 0;
+		priv->rb_buf = dmam_alloc_coherent(priv->dev, size,
+						   &priv->rb_dma, GFP_KERNEL);
+		if (!priv->rb_buf)
+			return ERR_PTR(-ENOMEM);
+		priv->rb_size = size;
+	}
+
+	priv->rb_valid = 0;
+	priv->rb_next = -1;
+	ret = zynqmp_pm_fpga_read(words, priv->rb_dma, true, &data_offset);
+	if (ret)
+		return ERR_PTR(ret);
+
+	/* The data follows @data_offset words of readback header */
+	if (data_offset * FPGA_WORD_SIZE + end > priv->rb_size)
+		return ERR_PTR(-EIO);
+
+	priv->rb_data = priv->rb_buf + data_offset * FPGA_WORD_SIZE;
+	priv->rb_valid = end;
+
+out:
+	priv->rb_next = offset + *count;
+
+	return priv->rb_data + offset;
+}
+
 static int zynqmp_fpga_ops_read(struct fpga_manager *mgr, struct seq_file *s)
 {
 	int ret;
@@ -356,10 +469,11 @@ static int zynqmp_fpga_ops_read(struct fpga_manager *mgr, struct seq_file *s)
 
 static const struct fpga_manager_ops zynqmp_fpga_ops = {
 	.state = zynqmp_fpga_ops_state,
+	.premapped_sg = true,
 	.write_init = zynqmp_fpga_ops_write_init,
-	.write = zynqmp_fpga_ops_write,
 	.write_sg = zynqmp_fpga_ops_write_sg,
 	.read = zynqmp_fpga_ops_read,
+	.read_data = zynqmp_fpga_ops_read_data,
 };
 
 static int zynqmp_fpga_probe(struct platform_device *pdev)
@@ -373,6 +487,7 @@ static int zynqmp_fpga_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	priv->dev = dev;
+	priv->rb_next = -1;
 
 	if (!(zynqmp_pm_fpga_get_version(&priv->version))) {
 		if (zynqmp_pm_fpga_get_feature_list(&priv->feature_list))
@@ -214,21 +214,15 @@ static inline void zynq_gpio_get_bank_pin(unsigned int pin_num,
 }
 
 /**
- * zynq_gpio_get_value - Get the state of the specified pin of GPIO device
- * @chip:	gpio_chip instance to be worked on
- * @pin:	gpio pin number within the device
- *
- * This function reads the state of the specified pin of the GPIO device.
+ * zynq_gpio_read_bank - Read the state of the pins of a bank
+ * @gpio:	gpio device data structure
+ * @bank_num:	the bank to read
  *
- * Return: 0 if the pin is low, 1 if pin is high.
+ * Return: the pin states of the bank, one bit per pin.
  */
-static int zynq_gpio_get_value(struct gpio_chip *chip, unsigned int pin)
+static u32 zynq_gpio_read_bank(struct zynq_gpio *gpio, unsigned int bank_num)
 {
 	u32 data;
-	unsigned int bank_num, bank_pin_num;
-	struct zynq_gpio *gpio = gpiochip_get_data(chip);
-
-	zynq_gpio_get_bank_pin(pin, &bank_num, &bank_pin_num, gpio);
 
 	if (gpio_data_ro_bug(gpio)) {
 		if (zynq_gpio_is_zynq(gpio)) {
@@ -252,7 +246,87 @@ static int zynq_gpio_get_value(struct gpio_chip *chip, unsigned int pin)
 		data = readl_relaxed(gpio->base_addr +
 			ZYNQ_GPIO_DATA_RO_OFFSET(bank_num));
 	}
-	return (data >> bank_pin_num) & 1;
+	return data;
+}
+
+/**
+ * zynq_gpio_get_value - Get the state of the specified pin of GPIO device
+ * @chip:	gpio_chip instance to be worked on
+ * @pin:	gpio pin number within the device
+ *
+ * This function reads the state of the specified pin of the GPIO device.
+ *
+ * Return: 0 if the pin is low, 1 if pin is high.
+ */
+static int zynq_gpio_get_value(struct gpio_chip *chip, unsigned int pin)
+{
+	unsigned int bank_num, bank_pin_num;
+	struct zynq_gpio *gpio = gpiochip_get_data(chip);
+
+	zynq_gpio_get_bank_pin(pin, &bank_num, &bank_pin_num, gpio);
+
+	return (zynq_gpio_read_bank(gpio, bank_num) >> bank_pin_num) & 1;
+}
+
+/**
+ * zynq_gpio_bank_bits - Extract the bits of a bank from a pin bitmap
+ * @gpio:	gpio device data structure
+ * @bank_num:	the bank
+ * @bits:	bitmap indexed by the gpio pin number within the device
+ *
+ * Return: the bits of the pins of the bank, bit 0 being its first pin.
+ */
+static u32 zynq_gpio_bank_bits(struct zynq_gpio *gpio, unsigned int bank_num,
+			       const unsigned long *bits)
+{
+	unsigned int pin = gpio->p_data->bank_min[bank_num];
+	unsigned int end = gpio->p_data->bank_max[bank_num] + 1;
+	u32 val = 0;
+
+	for_each_set_bit_from(pin, bits, end)
+		val |= BIT(pin - gpio->p_data->bank_min[bank_num]);
+
+	return val;
+}
+
+/**
+ * zynq_gpio_get_multiple - Get the state of several pins of GPIO device
+ * @chip:	gpio_chip instance to be worked on
+ * @mask:	pins to read
+ * @bits:	returns the state of the pins in @mask
+ *
+ * Each bank holding a pin of @mask is read once.
+ *
+ * Return: 0 always
+ */
+static int zynq_gpio_get_multiple(struct gpio_chip *chip, unsigned long *mask,
+				  unsigned long *bits)
+{
+	struct zynq_gpio *gpio = gpiochip_get_data(chip);
+	unsigned int bank_num, pin, bit;
+	unsigned long bank_mask;
+	u32 data;
+
+	for (bank_num = 0; bank_num < gpio->p_data->max_bank; bank_num++) {
+		/* skip the unused banks */
+		if (gpio->p_data->bank_max[bank_num] <=
+		    gpio->p_data->bank_min[bank_num])
+			goto next;
+
+		bank_mask = zynq_gpio_bank_bits(gpio, bank_num, mask);
+		if (!bank_mask)
+			goto next;
+
+		data = zynq_gpio_read_bank(gpio, bank_num);
+		pin = gpio->p_data->bank_min[bank_num];
+		for_each_set_bit(bit, &bank_mask, 32)
+			__assign_bit(pin + bit, bits, data & BIT(bit));
+next:
+		if (gpio->p_data->quirks & GPIO_QUIRK_VERSAL)
+			bank_num = bank_num + VERSAL_UNUSED_BANKS;
+	}
+
+	return 0;
 }
 
 /**
@@ -292,6 +366,64 @@ static void zynq_gpio_set_value(struct gpio_chip *chip, unsigned int pin,
 	writel_relaxed(state, gpio->base_addr + reg_offset);
 }
 
+/**
+ * zynq_gpio_set_multiple - Modify the state of several pins of GPIO device
+ * @chip:	gpio_chip instance to be worked on
+ * @mask:	pins to modify
+ * @bits:	state of the pins in @mask
+ *
+ * A bank whose pins are all in @mask is updated with a single write of its
+ * data register. Otherwise each half of the bank holding a pin of @mask gets
+ * one write of its mask/data register, which leaves the other pins alone.
+ */
+static void zynq_gpio_set_multiple(struct gpio_chip *chip, unsigned long *mask,
+				   unsigned long *bits)
+{
+	struct zynq_gpio *gpio = gpiochip_get_data(chip);
+	unsigned int bank_num, npins;
+	u32 bank_mask, data, full;
+
+	for (bank_num = 0; bank_num < gpio->p_data->max_bank; bank_num++) {
+		/* skip the unused banks */
+		if (gpio->p_data->bank_max[bank_num] <=
+		    gpio->p_data->bank_min[bank_num])
+			goto next;
+
+		bank_mask = zynq_gpio_bank_bits(gpio, bank_num, mask);
+		if (!bank_mask)
+			goto next;
+
+		data = zynq_gpio_bank_bits(gpio, bank_num, bits) & bank_mask;
+		npins = gpio->p_data->bank_max[bank_num] -
+			gpio->p_data->bank_min[bank_num] + 1;
+		full = GENMASK(npins - 1, 0);
+
+		if (bank_mask == full) {
+			writel_relaxed(data, gpio->base_addr +
+				       ZYNQ_GPIO_DATA_OFFSET(bank_num));
+			goto next;
+		}
+
+		/*
+		 * the upper 16 bits of the mask/data registers mask the
+		 * lower 16 data bits
+		 */
+		if (bank_mask & ~ZYNQ_GPIO_UPPER_MASK)
+			writel_relaxed((~bank_mask << ZYNQ_GPIO_MID_PIN_NUM) |
+				       (data & ~ZYNQ_GPIO_UPPER_MASK),
+				       gpio->base_addr +
+				       ZYNQ_GPIO_DATA_LSW_OFFSET(bank_num));
+		if (bank_mask & ZYNQ_GPIO_UPPER_MASK)
+			writel_relaxed((~bank_mask & ZYNQ_GPIO_UPPER_MASK) |
+				       (data >> ZYNQ_GPIO_MID_PIN_NUM),
+				       gpio->base_addr +
+				       ZYNQ_GPIO_DATA_MSW_OFFSET(bank_num));
+next:
+		if (gpio->p_data->quirks & GPIO_QUIRK_VERSAL)
+			bank_num = bank_num + VERSAL_UNUSED_BANKS;
+	}
+}
+
 /**
  * zynq_gpio_dir_in - Set the direction of the specified GPIO pin as input
  * @chip:	gpio_chip instance to be worked on
@@ -931,6 +1063,8 @@ static int zynq_gpio_probe(struct platform_device *pdev)
 	chip->parent = &pdev->dev;
 	chip->get = zynq_gpio_get_value;
 	chip->set = zynq_gpio_set_value;
+	chip->get_multiple = zynq_gpio_get_multiple;
+	chip->set_multiple = zynq_gpio_set_multiple;
 	chip->request = zynq_gpio_request;
 	chip->free = zynq_gpio_free;
 	chip->direction_input = zynq_gpio_dir_in;
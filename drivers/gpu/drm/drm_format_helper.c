@@ -168,7 +168,8 @@ static int drm_fb_xfrm(struct iosys_map *dst,
  * respective color plane at the same index.
  *
  * This function does not apply clipping on @dst (i.e. the destination is at the
- * top-left corner).
+ * top-left corner). Copies to system memory use non-temporal stores, the CPU
+ * does not read the display memory back.
  */
 void drm_fb_memcpy(struct iosys_map *dst, const unsigned int *dst_pitch,
 		   const struct iosys_map *src, const struct drm_framebuffer *fb,
@@ -198,7 +199,10 @@ void drm_fb_memcpy(struct iosys_map *dst, const unsigned int *dst_pitch,
 		iosys_map_incr(&src_i, clip_offset(clip, fb->pitches[i], cpp_i));
 		for (y = 0; y < lines; y++) {
 			/* TODO: handle src_i in I/O memory here */
-			iosys_map_memcpy_to(&dst_i, 0, src_i.vaddr, len_i);
+			if (dst_i.is_iomem)
+				iosys_map_memcpy_to(&dst_i, 0, src_i.vaddr, len_i);
+			else
+				memcpy_nt(dst_i.vaddr, src_i.vaddr, len_i);
 			iosys_map_incr(&src_i, fb->pitches[i]);
 			iosys_map_incr(&dst_i, dst_pitch_i);
 		}
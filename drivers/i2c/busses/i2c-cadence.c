@@ -168,6 +168,7 @@ enum cdns_i2c_slave_state {
  * @membase:		Base address of the I2C device
  * @adap:		I2C adapter instance
  * @p_msg:		Message pointer
+ * @p_msg_last:		Last message the interrupt handler chains to, if any
  * @err_status:		Error status in Interrupt Status Register
  * @xfer_done:		Transfer complete status
  * @p_send_buf:		Pointer to transmit buffer
@@ -198,6 +199,7 @@ struct cdns_i2c {
 	void __iomem *membase;
 	struct i2c_adapter adap;
 	struct i2c_msg *p_msg;
+	struct i2c_msg *p_msg_last;
 	int err_status;
 	struct completion xfer_done;
 	unsigned char *p_send_buf;
@@ -451,6 +453,8 @@ static irqreturn_t cdns_i2c_slave_isr(void *ptr)
 }
 #endif
 
+static void cdns_i2c_start_msg(struct cdns_i2c *id, struct i2c_msg *msg);
+
 /**
  * cdns_i2c_master_isr - Interrupt handler for the I2C device in master role
  * @ptr:       Pointer to I2C device private data
@@ -599,6 +603,21 @@ static irqreturn_t cdns_i2c_master_isr(void *ptr)
 	if (id->err_status)
 		status = IRQ_HANDLED;
 
+	/*
+	 * Start the next message of a combined transfer right away, only the
+	 * last one or an error wakes up the waiting thread.
+	 */
+	if (done_flag && !id->err_status && id->p_msg_last &&
+	    id->p_msg != id->p_msg_last) {
+		if (id->p_msg->flags & I2C_M_RECV_LEN)
+			id->p_msg->len += min_t(unsigned int, id->p_msg->buf[0],
+						I2C_SMBUS_BLOCK_MAX);
+		if (id->p_msg + 1 == id->p_msg_last)
+			id->bus_hold_flag = 0;
+		cdns_i2c_start_msg(id, id->p_msg + 1);
+		done_flag = 0;
+	}
+
 	if (done_flag)
 		complete(&id->xfer_done);
 
@@ -931,16 +950,20 @@ static void cdns_i2c_master_reset(struct i2c_adapter *adap)
 	cdns_i2c_writereg(regval, CDNS_I2C_SR_OFFSET);
 }
 
-static int cdns_i2c_process_msg(struct cdns_i2c *id, struct i2c_msg *msg,
-		struct i2c_adapter *adap)
+/**
+ * cdns_i2c_start_msg - Program the controller for a message
+ * @id:		pointer to the i2c device
+ * @msg:	the message to start
+ *
+ * Called from the transfer thread and, for the following messages of a
+ * combined transfer, from the interrupt handler.
+ */
+static void cdns_i2c_start_msg(struct cdns_i2c *id, struct i2c_msg *msg)
 {
-	unsigned long time_left, msg_timeout;
 	u32 reg;
 
 	id->p_msg = msg;
 	id->err_status = 0;
-	if (!id->atomic)
-		reinit_completion(&id->xfer_done);
 
 	/* Check for the TEN Bit mode on each msg */
 	reg = cdns_i2c_readreg(CDNS_I2C_CR_OFFSET);
@@ -959,9 +982,28 @@ static int cdns_i2c_process_msg(struct cdns_i2c *id, struct i2c_msg *msg,
 		cdns_i2c_mrecv(id);
 	else
 		cdns_i2c_msend(id);
+}
 
-	/* Minimal time to execute this message */
-	msg_timeout = msecs_to_jiffies((1000 * msg->len * BITS_PER_BYTE) / id->i2c_clk);
+static int cdns_i2c_process_msg(struct cdns_i2c *id, struct i2c_msg *msg,
+		struct i2c_adapter *adap)
+{
+	unsigned long time_left, msg_timeout;
+	unsigned int len = msg->len;
+	struct i2c_msg *next;
+	u32 reg;
+
+	if (!id->atomic)
+		reinit_completion(&id->xfer_done);
+
+	cdns_i2c_start_msg(id, msg);
+
+	/* A combined transfer also runs the following messages */
+	if (id->p_msg_last)
+		for (next = msg + 1; next <= id->p_msg_last; next++)
+			len += next->len;
+
+	/* Minimal time to execute these messages */
+	msg_timeout = msecs_to_jiffies((1000 * len * BITS_PER_BYTE) / id->i2c_clk);
 	/* Plus some wiggle room */
 	if (!id->atomic)
 		msg_timeout += msecs_to_jiffies(500);
@@ -993,6 +1035,8 @@ static int cdns_i2c_process_msg(struct cdns_i2c *id, struct i2c_msg *msg,
 	if (id->err_status & CDNS_I2C_IXR_ARB_LOST)
 		return -EAGAIN;
 
+	/* the message the interrupt handler stopped at */
+	msg = id->p_msg;
 	if (msg->flags & I2C_M_RECV_LEN)
 		msg->len += min_t(unsigned int, msg->buf[0], I2C_SMBUS_BLOCK_MAX);
 
@@ -1050,6 +1094,13 @@ static int cdns_i2c_master_common_xfer(struct i2c_adapter *adap,
 		reg = cdns_i2c_readreg(CDNS_I2C_CR_OFFSET);
 		reg |= CDNS_I2C_CR_HOLD;
 		cdns_i2c_writereg(reg, CDNS_I2C_CR_OFFSET);
+
+		/*
+		 * Let the interrupt handler chain the messages, the thread
+		 * then only waits once for the whole transfer.
+		 */
+		if (!id->atomic)
+			id->p_msg_last = &msgs[num - 1];
 	} else {
 		id->bus_hold_flag = 0;
 	}
@@ -1061,19 +1112,27 @@ static int cdns_i2c_master_common_xfer(struct i2c_adapter *adap,
 
 		ret = cdns_i2c_process_msg(id, msgs, adap);
 		if (ret)
-			return ret;
+			break;
 
 		/* Report the other error interrupts to application */
 		if (id->err_status || id->err_status_atomic) {
 			cdns_i2c_master_reset(adap);
 
 			if (id->err_status & CDNS_I2C_IXR_NACK)
-				return -ENXIO;
-
-			return -EIO;
+				ret = -ENXIO;
+			else
+				ret = -EIO;
+			break;
 		}
+
+		/* The interrupt handler went through the remaining messages */
+		if (id->p_msg_last)
+			break;
 	}
-	return 0;
+
+	id->p_msg_last = NULL;
+
+	return ret;
 }
 
 /**
@@ -24,8 +24,11 @@
 #include <linux/property.h>
 #include <linux/slab.h>
 
+#include <linux/iio/buffer.h>
 #include <linux/iio/events.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
 
 /* AMS registers definitions */
 #define AMS_ISR_0			0x010
@@ -233,6 +236,14 @@ enum ams_ps_pl_seq {
 #define PS_SEQ(x)		(x)
 #define PL_SEQ(x)		(AMS_PS_SEQ_MAX + (x))
 #define AMS_CTRL_SEQ_BASE	(AMS_PS_SEQ_MAX * 3)
+#define AMS_TIMESTAMP_SEQ	(AMS_CTRL_SEQ_BASE + AMS_SEQ_INTDDR + 1)
+
+#define AMS_SCAN_TYPE { \
+	.sign = 'u', \
+	.realbits = 16, \
+	.storagebits = 16, \
+	.endianness = IIO_CPU, \
+}
 
 #define AMS_CHAN_TEMP(_scan_index, _addr) { \
 	.type = IIO_TEMP, \
@@ -244,6 +255,7 @@ enum ams_ps_pl_seq {
 		BIT(IIO_CHAN_INFO_OFFSET), \
 	.event_spec = ams_temp_events, \
 	.scan_index = _scan_index, \
+	.scan_type = AMS_SCAN_TYPE, \
 	.num_event_specs = ARRAY_SIZE(ams_temp_events), \
 }
 
@@ -255,6 +267,7 @@ enum ams_ps_pl_seq {
 		BIT(IIO_CHAN_INFO_SCALE), \
 	.event_spec = (_alarm) ? ams_voltage_events : NULL, \
 	.scan_index = _scan_index, \
+	.scan_type = AMS_SCAN_TYPE, \
 	.num_event_specs = (_alarm) ? ARRAY_SIZE(ams_voltage_events) : 0, \
 }
 
@@ -285,6 +298,9 @@ enum ams_ps_pl_seq {
  * @current_masked_alarm: currently masked due to alarm
  * @intr_mask: interrupt configuration
  * @ams_unmask_work: re-enables event once the event condition disappears
+ * @scan: sample of the enabled sequencer channels pushed to the buffer
+ * @scan.data: channel results, in scan_index order
+ * @scan.ts: timestamp of the sample
  *
  */
 struct ams {
@@ -299,6 +315,10 @@ struct ams {
 	u64 current_masked_alarm;
 	u64 intr_mask;
 	struct delayed_work ams_unmask_work;
+	struct {
+		u16 data[AMS_CTRL_SEQ_BASE];
+		s64 ts __aligned(8);
+	} scan;
 };
 
 static inline void ams_ps_update_reg(struct ams *ams, unsigned int offset,
@@ -440,8 +460,12 @@ static void ams_enable_channel_sequence(struct iio_dev *indio_dev)
 
 	/* Run calibration of PS & PL as part of the sequence */
 	scan_mask = BIT(0) | BIT(AMS_PS_SEQ_MAX);
-	for (i = 0; i < indio_dev->num_channels; i++)
+	for (i = 0; i < indio_dev->num_channels; i++) {
+		/* control block supplies are read in single channel mode */
+		if (indio_dev->channels[i].scan_index >= AMS_CTRL_SEQ_BASE)
+			continue;
 		scan_mask |= BIT_ULL(indio_dev->channels[i].scan_index);
+	}
 
 	if (ams->ps_base) {
 		/* put sysmon in a soft reset to change the sequence */
@@ -764,6 +788,56 @@ static int ams_read_raw(struct iio_dev *indio_dev,
 	}
 }
 
+static irqreturn_t ams_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct ams *ams = iio_priv(indio_dev);
+	const struct iio_chan_spec *chan;
+	int i, j = 0;
+
+	/*
+	 * The sequencer converts all enabled channels continuously and keeps
+	 * the latest result of each in its data registers, so a sample is a
+	 * plain read of the registers of the channels in the scan.
+	 */
+	mutex_lock(&ams->lock);
+	for_each_set_bit(i, indio_dev->active_scan_mask, indio_dev->masklength) {
+		chan = iio_find_channel_from_si(indio_dev, i);
+		if (!chan || chan->scan_index >= AMS_CTRL_SEQ_BASE)
+			continue;
+
+		if (chan->scan_index >= AMS_PS_SEQ_MAX)
+			ams->scan.data[j++] = readl(ams->pl_base + chan->address);
+		else
+			ams->scan.data[j++] = readl(ams->ps_base + chan->address);
+	}
+	mutex_unlock(&ams->lock);
+
+	iio_push_to_buffers_with_timestamp(indio_dev, &ams->scan, pf->timestamp);
+	iio_trigger_notify_done(indio_dev->trig);
+
+	return IRQ_HANDLED;
+}
+
+static bool ams_validate_scan_mask(struct iio_dev *indio_dev,
+				   const unsigned long *scan_mask)
+{
+	unsigned int bit;
+
+	/*
+	 * The control block supplies are not part of the sequence, reading
+	 * them reconfigures the PS sysmon so they can't be buffered.
+	 */
+	bit = find_next_bit(scan_mask, indio_dev->masklength, AMS_CTRL_SEQ_BASE);
+
+	return bit >= AMS_TIMESTAMP_SEQ;
+}
+
+static const struct iio_buffer_setup_ops ams_buffer_setup_ops = {
+	.validate_scan_mask = &ams_validate_scan_mask,
+};
+
 static int ams_get_alarm_offset(int scan_index, enum iio_event_direction dir,
 				enum iio_event_type type)
 {
@@ -1350,8 +1424,9 @@ static int ams_parse_firmware(struct iio_dev *indio_dev)
 	int ret, ch_cnt = 0, i, rising_off, falling_off;
 	unsigned int num_channels = 0;
 
+	/* one extra entry for the buffer timestamp */
 	ams_size = ARRAY_SIZE(ams_ps_channels) + ARRAY_SIZE(ams_pl_channels) +
-		ARRAY_SIZE(ams_ctrl_channels);
+		ARRAY_SIZE(ams_ctrl_channels) + 1;
 
 	/* Initialize buffer for channel specification */
 	ams_channels = devm_kcalloc(dev, ams_size, sizeof(*ams_channels), GFP_KERNEL);
@@ -1422,6 +1497,9 @@ static int ams_parse_firmware(struct iio_dev *indio_dev)
 		}
 	}
 
+	ams_channels[num_channels++] =
+		(struct iio_chan_spec)IIO_CHAN_SOFT_TIMESTAMP(AMS_TIMESTAMP_SEQ);
+
 	dev_channels = devm_krealloc_array(dev, ams_channels, num_channels,
 					   sizeof(*dev_channels), GFP_KERNEL);
 	if (!dev_channels)
@@ -1490,6 +1568,13 @@ static int ams_probe(struct platform_device *pdev)
 
 	ams_enable_channel_sequence(indio_dev);
 
+	ret = devm_iio_triggered_buffer_setup(&pdev->dev, indio_dev,
+					      &iio_pollfunc_store_time,
+					      &ams_trigger_handler,
+					      &ams_buffer_setup_ops);
+	if (ret)
+		return dev_err_probe(&pdev->dev, ret, "failed to setup buffer\n");
+
 	irq = platform_get_irq(pdev, 0);
 	if (irq < 0)
 		return irq;
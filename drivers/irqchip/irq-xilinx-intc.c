@@ -43,6 +43,7 @@ struct xintc_irq_chip {
 	struct		irq_domain *root_domain;
 	u32		intr_mask;
 	u32		nr_irq;
+	bool		has_ipr;
 #ifdef CONFIG_IRQCHIP_XILINX_INTC_MODULE_SUPPORT_EXPERIMENTAL
 	int				irq;
 #endif
@@ -139,6 +140,38 @@ static const struct irq_domain_ops xintc_irq_domain_ops = {
 	.map = xintc_map,
 };
 
+/*
+ * With the optional IPR, everything pending is dispatched from a single
+ * read instead of one IVR read per interrupt. IVR returns the lowest
+ * pending number first, walking the bits upwards keeps that priority order.
+ */
+static void xintc_handle_pending(struct xintc_irq_chip *irqc)
+{
+	unsigned long pending;
+	unsigned int bit;
+	u32 hwirq;
+
+	if (!irqc->has_ipr) {
+		do {
+			hwirq = xintc_read(irqc, IVR);
+			if (unlikely(hwirq == SPURIOUS_IRQ))
+				break;
+
+			generic_handle_domain_irq(irqc->root_domain, hwirq);
+		} while (true);
+		return;
+	}
+
+	do {
+		pending = xintc_read(irqc, IPR) & GENMASK(irqc->nr_irq - 1, 0);
+		if (!pending)
+			break;
+
+		for_each_set_bit(bit, &pending, irqc->nr_irq)
+			generic_handle_domain_irq(irqc->root_domain, bit);
+	} while (true);
+}
+
 static void xil_intc_irq_handler(struct irq_desc *desc)
 {
 	struct irq_chip *chip = irq_desc_get_chip(desc);
@@ -146,28 +179,13 @@ static void xil_intc_irq_handler(struct irq_desc *desc)
 
 	irqc = irq_data_get_irq_handler_data(&desc->irq_data);
 	chained_irq_enter(chip, desc);
-	do {
-		u32 hwirq = xintc_read(irqc, IVR);
-
-		if (hwirq == -1U)
-			break;
-
-		generic_handle_domain_irq(irqc->root_domain, hwirq);
-	} while (true);
+	xintc_handle_pending(irqc);
 	chained_irq_exit(chip, desc);
 }
 
 static void xil_intc_handle_irq(struct pt_regs *regs)
 {
-	u32 hwirq;
-
-	do {
-		hwirq = xintc_read(primary_intc, IVR);
-		if (unlikely(hwirq == SPURIOUS_IRQ))
-			break;
-
-		generic_handle_domain_irq(primary_intc->root_domain, hwirq);
-	} while (true);
+	xintc_handle_pending(primary_intc);
 }
 
 #ifndef CONFIG_IRQCHIP_XILINX_INTC_MODULE_SUPPORT_EXPERIMENTAL
@@ -180,6 +198,7 @@ static int xilinx_intc_of_init(struct device_node *intc,
 {
 	struct xintc_irq_chip *irqc;
 	int ret, irq;
+	u32 val;
 
 	irqc = kzalloc(sizeof(*irqc), GFP_KERNEL);
 	if (!irqc)
@@ -220,6 +239,9 @@ static int xilinx_intc_of_init(struct device_node *intc,
 	if ((u64)irqc->intr_mask >> irqc->nr_irq)
 		pr_warn("irq-xilinx: mismatch in kind-of-intr param\n");
 
+	if (!of_property_read_u32(intc, "xlnx,has-ipr", &val))
+		irqc->has_ipr = val;
+
 	pr_info("irq-xilinx: %pOF: num_irq=%d, edge=0x%x\n",
 		intc, irqc->nr_irq, irqc->intr_mask);
 
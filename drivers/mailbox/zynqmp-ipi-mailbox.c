@@ -62,6 +62,13 @@
 #define DST_BIT_POS	9U
 #define SRC_BITMASK	GENMASK(11, 8)
 
+/* IPI agent registers, used when Linux owns the agent */
+#define IPI_TRIG_OFFSET	0x00U
+#define IPI_OBS_OFFSET	0x04U
+#define IPI_ISR_OFFSET	0x10U
+#define IPI_IER_OFFSET	0x18U
+#define IPI_IDR_OFFSET	0x1CU
+
 /*
  * Module parameters
  */
@@ -78,6 +85,7 @@ MODULE_PARM_DESC(tx_poll_period, "Poll period waiting for ack after send.");
  * @resp_buf_size: response buffer size
  * @rx_buf: receive buffer to pass received message to client
  * @chan_type: channel type
+ * @tx_busy: a request waits for the remote to take it, with tx done irq
  */
 struct zynqmp_ipi_mchan {
 	int is_opened;
@@ -87,6 +95,7 @@ struct zynqmp_ipi_mchan {
 	size_t req_buf_size;
 	size_t resp_buf_size;
 	unsigned int chan_type;
+	atomic_t tx_busy;
 };
 
 struct zynqmp_ipi_mbox;
@@ -100,6 +109,8 @@ typedef int (*setup_ipi_fn)(struct zynqmp_ipi_mbox *ipi_mbox, struct device_node
  * @dev:                  device pointer corresponding to the Xilinx ZynqMP
  *                        IPI mailbox
  * @remote_id:            remote IPI agent ID
+ * @remote_mask:          remote IPI agent bit in the agent registers, 0 to
+ *                        go through the firmware
  * @mbox:                 mailbox Controller
  * @mchans:               array for channels, tx channel and rx channel.
  * @irq:                  IPI agent interrupt ID
@@ -109,6 +120,7 @@ struct zynqmp_ipi_mbox {
 	struct zynqmp_ipi_pdata *pdata;
 	struct device dev;
 	u32 remote_id;
+	u32 remote_mask;
 	struct mbox_controller mbox;
 	struct zynqmp_ipi_mchan mchans[2];
 	setup_ipi_fn setup_ipi_fn;
@@ -123,6 +135,7 @@ struct zynqmp_ipi_mbox {
  * @method:               IPI SMC or HVC is going to be used
  * @local_id:             local IPI agent ID
  * @virq_sgi:             IRQ number mapped to SGI
+ * @ctrl:                 IPI agent registers if owned by Linux, else NULL
  * @num_mboxes:           number of mailboxes of this IPI agent
  * @ipi_mboxes:           IPI mailboxes of this IPI agent
  */
@@ -132,6 +145,7 @@ struct zynqmp_ipi_pdata {
 	unsigned int method;
 	u32 local_id;
 	int virq_sgi;
+	void __iomem *ctrl;
 	int num_mboxes;
 	struct zynqmp_ipi_mbox ipi_mboxes[];
 };
@@ -143,6 +157,51 @@ static struct device_driver zynqmp_ipi_mbox_driver = {
 	.name = "zynqmp-ipi-mbox",
 };
 
+/*
+ * Carry out an IPI firmware call on the agent registers directly, for
+ * agents owned by Linux. This saves a trip through EL3 on every status
+ * enquiry, notification and acknowledgment.
+ */
+static unsigned long zynqmp_ipi_mmio_call(struct zynqmp_ipi_mbox *ipi_mbox,
+					  unsigned long a0, unsigned long a3)
+{
+	void __iomem *ctrl = ipi_mbox->pdata->ctrl;
+	u32 mask = ipi_mbox->remote_mask;
+	unsigned long ret = 0;
+
+	switch (a0) {
+	case SMC_IPI_MAILBOX_STATUS_ENQUIRY:
+		if (readl_relaxed(ctrl + IPI_OBS_OFFSET) & mask)
+			ret |= IPI_MB_STATUS_SEND_PENDING;
+		if (readl_relaxed(ctrl + IPI_ISR_OFFSET) & mask) {
+			ret |= IPI_MB_STATUS_RECV_PENDING;
+			if (a3 & IPI_SMC_ENQUIRY_DIRQ_MASK)
+				writel_relaxed(mask, ctrl + IPI_IDR_OFFSET);
+		}
+		break;
+	case SMC_IPI_MAILBOX_NOTIFY:
+		/* Orders the message buffer writes before the doorbell */
+		writel(mask, ctrl + IPI_TRIG_OFFSET);
+		break;
+	case SMC_IPI_MAILBOX_ACK:
+		writel(mask, ctrl + IPI_ISR_OFFSET);
+		if (a3 & IPI_SMC_ACK_EIRQ_MASK)
+			writel(mask, ctrl + IPI_IER_OFFSET);
+		break;
+	case SMC_IPI_MAILBOX_ENABLE_IRQ:
+		writel(mask, ctrl + IPI_IER_OFFSET);
+		break;
+	case SMC_IPI_MAILBOX_DISABLE_IRQ:
+	case SMC_IPI_MAILBOX_RELEASE:
+		writel(mask, ctrl + IPI_IDR_OFFSET);
+		break;
+	default:
+		break;
+	}
+
+	return ret;
+}
+
 static void zynqmp_ipi_fw_call(struct zynqmp_ipi_mbox *ipi_mbox,
 			       unsigned long a0, unsigned long a3,
 			       struct arm_smccc_res *res)
@@ -150,6 +209,12 @@ static void zynqmp_ipi_fw_call(struct zynqmp_ipi_mbox *ipi_mbox,
 	struct zynqmp_ipi_pdata *pdata = ipi_mbox->pdata;
 	unsigned long a1, a2;
 
+	if (ipi_mbox->remote_mask) {
+		memset(res, 0, sizeof(*res));
+		res->a0 = zynqmp_ipi_mmio_call(ipi_mbox, a0, a3);
+		return;
+	}
+
 	a1 = pdata->local_id;
 	a2 = ipi_mbox->remote_id;
 	if (pdata->method == USE_SMC)
@@ -189,6 +254,14 @@ static irqreturn_t zynqmp_ipi_interrupt(int irq, void *data)
 		chan = &ipi_mbox->mbox.chans[IPI_MB_CHNL_RX];
 		zynqmp_ipi_fw_call(ipi_mbox, arg0, arg3, &res);
 		ret = (int)(res.a0 & 0xFFFFFFFF);
+		/* The remote took the request and notified us back */
+		if (ret >= 0 && !(ret & IPI_MB_STATUS_SEND_PENDING) &&
+		    atomic_cmpxchg(&ipi_mbox->mchans[IPI_MB_CHNL_TX].tx_busy,
+				   1, 0) == 1) {
+			mbox_chan_txdone(&ipi_mbox->mbox.chans[IPI_MB_CHNL_TX],
+					 0);
+			status = IRQ_HANDLED;
+		}
 		if (ret > 0 && ret & IPI_MB_STATUS_RECV_PENDING) {
 			if (mchan->is_opened) {
 				msg = mchan->rx_buf;
@@ -322,6 +395,8 @@ static int zynqmp_ipi_send_data(struct mbox_chan *chan, void *data)
 		}
 		if (msg && msg->len && mchan->req_buf)
 			memcpy_toio(mchan->req_buf, msg->data, msg->len);
+		if (chan->mbox->txdone_irq)
+			atomic_set(&mchan->tx_busy, 1);
 		/* Kick IPI mailbox to send message */
 		arg0 = SMC_IPI_MAILBOX_NOTIFY;
 		zynqmp_ipi_fw_call(ipi_mbox, arg0, 0, &res);
@@ -416,6 +491,7 @@ static void zynqmp_ipi_shutdown(struct mbox_chan *chan)
 		zynqmp_ipi_fw_call(ipi_mbox, arg0, 0, &res);
 	}
 
+	atomic_set(&mchan->tx_busy, 0);
 	mchan->is_opened = 0;
 }
 
@@ -538,12 +614,22 @@ static int zynqmp_ipi_mbox_probe(struct zynqmp_ipi_mbox *ipi_mbox,
 		return ret;
 	}
 
+	/* Drive the agent registers directly if Linux owns them */
+	if (ipi_mbox->pdata->ctrl)
+		of_property_read_u32(node, "xlnx,ipi-bitmask",
+				     &ipi_mbox->remote_mask);
+
 	mbox = &ipi_mbox->mbox;
 	mbox->dev = mdev;
 	mbox->ops = &zynqmp_ipi_chan_ops;
 	mbox->num_chans = 2;
-	mbox->txdone_irq = false;
-	mbox->txdone_poll = true;
+	/*
+	 * A remote that notifies us back once it has taken a request lets
+	 * the IPI interrupt complete the transmission, rather than a timer
+	 * polling for it every tx_poll_period.
+	 */
+	mbox->txdone_irq = of_property_read_bool(node, "xlnx,ipi-tx-done-irq");
+	mbox->txdone_poll = !mbox->txdone_irq;
 	mbox->txpoll_period = tx_poll_period;
 	mbox->of_xlate = zynqmp_ipi_of_xlate;
 	chans = devm_kzalloc(mdev, 2 * sizeof(*chans), GFP_KERNEL);
@@ -909,6 +995,7 @@ static int zynqmp_ipi_probe(struct platform_device *pdev)
 	struct zynqmp_ipi_pdata __percpu *pdata;
 	struct of_phandle_args out_irq;
 	struct zynqmp_ipi_mbox *mbox;
+	struct resource res;
 	int num_mboxes, ret = -EINVAL;
 	setup_ipi_fn ipi_fn;
 
@@ -931,6 +1018,13 @@ static int zynqmp_ipi_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	/* Optional agent registers, present when Linux owns the IPI agent */
+	if (!zynqmp_ipi_mbox_get_buf_res(np, "ctrl", &res)) {
+		pdata->ctrl = devm_ioremap(dev, res.start, resource_size(&res));
+		if (!pdata->ctrl)
+			return -ENOMEM;
+	}
+
 	ipi_fn = (setup_ipi_fn)device_get_match_data(&pdev->dev);
 	if (!ipi_fn) {
 		dev_err(dev,
@@ -22,13 +22,25 @@
 #include <linux/clk.h>
 #include <linux/compat.h>
 #include <linux/highmem.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
 
 #include <uapi/misc/xilinx_sdfec.h>
+#include <uapi/misc/xilinx_sdfec_ext.h>
 
 #define DEV_NAME_LEN 12
 
 static DEFINE_IDA(dev_nrs);
 
+/* Probed instances, for the aggregate device */
+static LIST_HEAD(xsdfec_list);
+/* Mutex to protect xsdfec_list and the aggregate streams built over it */
+static DEFINE_MUTEX(xsdfec_list_mutex);
+
 /* Xilinx SDFEC Register Map */
 /* CODE_WRI_PROTECT Register */
 #define XSDFEC_CODE_WR_PROTECT_ADDR (0x4)
@@ -162,6 +174,19 @@ static DEFINE_IDA(dev_nrs);
 #define XSDFEC_LDPC_REG_JUMP (0x10)
 #define XSDFEC_REG_WIDTH_JUMP (4)
 
+/* Number of LDPC code ids, and of code ids per code bank */
+#define XSDFEC_LDPC_NUM_CODES                                                  \
+	((XSDFEC_LDPC_CODE_REG0_ADDR_HIGH - XSDFEC_LDPC_CODE_REG0_ADDR_BASE) / \
+		 XSDFEC_LDPC_REG_JUMP +                                        \
+	 1)
+#define XSDFEC_LDPC_BANK_CODES (XSDFEC_LDPC_NUM_CODES / XSDFEC_LDPC_NUM_BANKS)
+
+/* Streaming data path limits */
+#define XSDFEC_STREAM_MIN_SLOTS (2)
+#define XSDFEC_STREAM_MAX_SLOTS (1024)
+#define XSDFEC_STREAM_MAX_BLOCK SZ_1M
+#define XSDFEC_STREAM_ALIGN (64)
+
 /* The maximum number of pinned pages */
 #define MAX_NUM_PAGES ((XSDFEC_QC_TABLE_DEPTH / PAGE_SIZE) + 1)
 
@@ -207,6 +232,11 @@ struct xsdfec_clks {
  * @state_updated: indicates State updated by interrupt handler
  * @stats_updated: indicates Stats updated by interrupt handler
  * @intr_enabled: indicates IRQ enabled
+ * @code_bank: Active LDPC code bank
+ * @stream_mutex: Serializes setup and teardown of @stream
+ * @stream: Streaming data path, NULL if not set up
+ * @node: Entry in xsdfec_list
+ * @agg: Aggregate stream the device is a member of, NULL if none
  *
  * This structure contains necessary state for SDFEC driver to operate
  */
@@ -230,6 +260,96 @@ struct xsdfec_dev {
 	bool state_updated;
 	bool stats_updated;
 	bool intr_enabled;
+	u32 code_bank;
+	/* Mutex to protect stream setup and teardown */
+	struct mutex stream_mutex;
+	struct xsdfec_stream *stream;
+	struct list_head node;
+	struct xsdfec_agg *agg;
+};
+
+enum xsdfec_stream_chan {
+	XSDFEC_STREAM_CTRL,
+	XSDFEC_STREAM_DIN,
+	XSDFEC_STREAM_DOUT,
+	XSDFEC_STREAM_STATUS,
+	XSDFEC_STREAM_NR_CHANS,
+};
+
+static const char * const xsdfec_stream_chan_names[] = {
+	[XSDFEC_STREAM_CTRL] = "ctrl",
+	[XSDFEC_STREAM_DIN] = "din",
+	[XSDFEC_STREAM_DOUT] = "dout",
+	[XSDFEC_STREAM_STATUS] = "status",
+};
+
+/**
+ * struct xsdfec_stream_slot - Code block in flight on the streaming path
+ * @stream: Stream the slot belongs to
+ * @user_data: Value from the submission entry
+ * @pending: Number of DOUT and STATUS transfers not yet completed
+ * @result: 0 or a negative error code for the completion entry
+ */
+struct xsdfec_stream_slot {
+	struct xsdfec_stream *stream;
+	u64 user_data;
+	int pending;
+	int result;
+};
+
+/**
+ * struct xsdfec_stream - Kernel managed streaming data path
+ * @xsdfec: SD-FEC device
+ * @file: File which set the stream up
+ * @chans: CTRL, DIN, DOUT and STATUS DMA channels
+ * @dma_dev: Device the data slots are allocated for
+ * @lock: Protects the stream state and the indices below
+ * @wq: Wait queue signalled on completion
+ * @ring: Ring header shared with userspace
+ * @ring_size: Size of @ring and of the queues following it
+ * @sq: Submission queue
+ * @cq: Completion queue
+ * @data: Data slots shared with userspace
+ * @data_dma: DMA address of @data
+ * @data_size: Size of @data
+ * @words: Control words followed by status words, one of each per slot
+ * @words_dma: DMA address of @words
+ * @slots: Per-slot state
+ * @nr: Number of slots
+ * @din_size: Size of the DIN area of a slot
+ * @dout_size: Size of the DOUT area of a slot
+ * @sq_head: Submission entries consumed
+ * @cq_tail: Completion entries produced
+ * @done: Slots retired, in submission order
+ * @inflight: Number of slots queued to the DMA channels
+ * @running: DMA is enabled
+ */
+struct xsdfec_stream {
+	struct xsdfec_dev *xsdfec;
+	struct file *file;
+	struct dma_chan *chans[XSDFEC_STREAM_NR_CHANS];
+	struct device *dma_dev;
+	/* Spinlock to protect the stream state */
+	spinlock_t lock;
+	wait_queue_head_t wq;
+	struct xsdfec_stream_ring *ring;
+	size_t ring_size;
+	struct xsdfec_sqe *sq;
+	struct xsdfec_cqe *cq;
+	void *data;
+	dma_addr_t data_dma;
+	size_t data_size;
+	u32 *words;
+	dma_addr_t words_dma;
+	struct xsdfec_stream_slot *slots;
+	u32 nr;
+	u32 din_size;
+	u32 dout_size;
+	u32 sq_head;
+	u32 cq_tail;
+	u32 done;
+	u32 inflight;
+	bool running;
 };
 
 static inline void xsdfec_regwrite(struct xsdfec_dev *xsdfec, u32 addr,
@@ -728,6 +848,592 @@ static int xsdfec_add_ldpc(struct xsdfec_dev *xsdfec, void __user *arg)
 	return ret;
 }
 
+/*
+ * Check that words [offset, offset + len) of a table lie within the part of
+ * the table owned by a code bank
+ */
+static bool xsdfec_bank_range_valid(u32 bank, u32 offset, u32 len, u32 depth)
+{
+	u32 bank_words = depth / XSDFEC_REG_WIDTH_JUMP / XSDFEC_LDPC_NUM_BANKS;
+	u32 start = bank * bank_words;
+
+	return offset >= start && len <= bank_words &&
+	       offset - start <= bank_words - len;
+}
+
+static int xsdfec_ldpc_check(struct xsdfec_dev *xsdfec,
+			     struct xsdfec_ldpc_params *ldpc, u32 bank)
+{
+	u32 n_sc;
+
+	if (ldpc->code_id / XSDFEC_LDPC_BANK_CODES != bank) {
+		dev_dbg(xsdfec->dev, "Code id %u is not in bank %u",
+			ldpc->code_id, bank);
+		return -EINVAL;
+	}
+
+	/* Same checks as the register writes, done before any write */
+	if (ldpc->psize < XSDFEC_REG1_PSIZE_MIN ||
+	    ldpc->psize > XSDFEC_REG1_PSIZE_MAX ||
+	    ldpc->n < XSDFEC_REG0_N_MIN || ldpc->n > XSDFEC_REG0_N_MAX ||
+	    ldpc->n > XSDFEC_REG0_N_MUL_P * ldpc->psize ||
+	    ldpc->n <= ldpc->k || ldpc->n % ldpc->psize ||
+	    ldpc->k < XSDFEC_REG0_K_MIN || ldpc->k > XSDFEC_REG0_K_MAX ||
+	    ldpc->k > XSDFEC_REG0_K_MUL_P * ldpc->psize ||
+	    ldpc->k % ldpc->psize ||
+	    ldpc->nlayers < XSDFEC_REG2_NLAYERS_MIN ||
+	    ldpc->nlayers > XSDFEC_REG2_NLAYERS_MAX) {
+		dev_dbg(xsdfec->dev, "Code %u parameters are not in range",
+			ldpc->code_id);
+		return -EINVAL;
+	}
+
+	n_sc = DIV_ROUND_UP(ldpc->nlayers, 4);
+	if (!xsdfec_bank_range_valid(bank, ldpc->sc_off, n_sc,
+				     XSDFEC_SC_TABLE_DEPTH) ||
+	    !xsdfec_bank_range_valid(bank, 4 * ldpc->la_off, ldpc->nlayers,
+				     XSDFEC_LA_TABLE_DEPTH) ||
+	    !xsdfec_bank_range_valid(bank, 4 * ldpc->qc_off, ldpc->nqc,
+				     XSDFEC_QC_TABLE_DEPTH)) {
+		dev_dbg(xsdfec->dev, "Code %u tables are not in bank %u",
+			ldpc->code_id, bank);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Copy a table from userspace and write it with a single burst of
+ * consecutive register writes
+ */
+static int xsdfec_table_load(struct xsdfec_dev *xsdfec, u32 offset,
+			     u32 __user *src_ptr, u32 len, const u32 base_addr,
+			     u32 *buf)
+{
+	if (!len)
+		return 0;
+
+	if (copy_from_user(buf, src_ptr, len * XSDFEC_REG_WIDTH_JUMP))
+		return -EFAULT;
+
+	__iowrite32_copy(xsdfec->regs + base_addr +
+				 offset * XSDFEC_REG_WIDTH_JUMP,
+			 buf, len);
+
+	return 0;
+}
+
+static int xsdfec_ldpc_load(struct xsdfec_dev *xsdfec,
+			    struct xsdfec_ldpc_params *ldpc, u32 *buf)
+{
+	int ret;
+
+	ret = xsdfec_reg0_write(xsdfec, ldpc->n, ldpc->k, ldpc->psize,
+				ldpc->code_id);
+	if (ret)
+		return ret;
+
+	ret = xsdfec_reg1_write(xsdfec, ldpc->psize, ldpc->no_packing, ldpc->nm,
+				ldpc->code_id);
+	if (ret)
+		return ret;
+
+	ret = xsdfec_reg2_write(xsdfec, ldpc->nlayers, ldpc->nmqc,
+				ldpc->norm_type, ldpc->special_qc,
+				ldpc->no_final_parity, ldpc->max_schedule,
+				ldpc->code_id);
+	if (ret)
+		return ret;
+
+	ret = xsdfec_reg3_write(xsdfec, ldpc->sc_off, ldpc->la_off,
+				ldpc->qc_off, ldpc->code_id);
+	if (ret)
+		return ret;
+
+	ret = xsdfec_table_load(xsdfec, ldpc->sc_off,
+				(u32 __user *)ldpc->sc_table,
+				DIV_ROUND_UP(ldpc->nlayers, 4),
+				XSDFEC_LDPC_SC_TABLE_ADDR_BASE, buf);
+	if (ret)
+		return ret;
+
+	ret = xsdfec_table_load(xsdfec, 4 * ldpc->la_off,
+				(u32 __user *)ldpc->la_table, ldpc->nlayers,
+				XSDFEC_LDPC_LA_TABLE_ADDR_BASE, buf);
+	if (ret)
+		return ret;
+
+	return xsdfec_table_load(xsdfec, 4 * ldpc->qc_off,
+				 (u32 __user *)ldpc->qc_table, ldpc->nqc,
+				 XSDFEC_LDPC_QC_TABLE_ADDR_BASE, buf);
+}
+
+static int xsdfec_add_ldpc_set(struct xsdfec_dev *xsdfec, void __user *arg)
+{
+	struct xsdfec_ldpc_code_set set;
+	struct xsdfec_ldpc_params *codes;
+	u32 *buf;
+	int ret;
+	u32 i;
+
+	if (copy_from_user(&set, arg, sizeof(set)))
+		return -EFAULT;
+
+	if (set.bank >= XSDFEC_LDPC_NUM_BANKS || !set.nr_codes ||
+	    set.nr_codes > XSDFEC_LDPC_BANK_CODES)
+		return -EINVAL;
+
+	if (xsdfec->config.code == XSDFEC_TURBO_CODE ||
+	    xsdfec->config.code_wr_protect)
+		return -EIO;
+
+	/* Only the inactive bank may be rewritten while running */
+	if (xsdfec->state == XSDFEC_STARTED && set.bank == xsdfec->code_bank)
+		return -EBUSY;
+
+	codes = kvmalloc_array(set.nr_codes, sizeof(*codes), GFP_KERNEL);
+	if (!codes)
+		return -ENOMEM;
+
+	if (copy_from_user(codes, u64_to_user_ptr(set.codes),
+			   set.nr_codes * sizeof(*codes))) {
+		ret = -EFAULT;
+		goto err_codes;
+	}
+
+	for (i = 0; i < set.nr_codes; i++) {
+		ret = xsdfec_ldpc_check(xsdfec, &codes[i], set.bank);
+		if (ret)
+			goto err_codes;
+	}
+
+	/* Large enough for the biggest table, the QC table */
+	buf = kvmalloc(XSDFEC_QC_TABLE_DEPTH, GFP_KERNEL);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto err_codes;
+	}
+
+	for (i = 0; i < set.nr_codes; i++) {
+		ret = xsdfec_ldpc_load(xsdfec, &codes[i], buf);
+		if (ret)
+			break;
+	}
+
+	kvfree(buf);
+err_codes:
+	kvfree(codes);
+	return ret;
+}
+
+static int xsdfec_set_code_bank(struct xsdfec_dev *xsdfec, u32 __user *arg)
+{
+	u32 bank;
+
+	if (get_user(bank, arg))
+		return -EFAULT;
+
+	if (bank >= XSDFEC_LDPC_NUM_BANKS)
+		return -EINVAL;
+
+	if (xsdfec->config.code == XSDFEC_TURBO_CODE)
+		return -EIO;
+
+	xsdfec->code_bank = bank;
+
+	return 0;
+}
+
+/* Post the completions of the retired slots, in submission order */
+static void xsdfec_stream_retire(struct xsdfec_stream *stream)
+{
+	struct xsdfec_stream_slot *slot;
+	struct xsdfec_cqe *cqe;
+	u32 idx;
+
+	lockdep_assert_held(&stream->lock);
+
+	while (stream->inflight) {
+		idx = stream->done & (stream->nr - 1);
+		slot = &stream->slots[idx];
+		if (slot->pending)
+			break;
+
+		cqe = &stream->cq[stream->cq_tail & (stream->nr - 1)];
+		cqe->user_data = slot->user_data;
+		cqe->slot = idx;
+		cqe->status = READ_ONCE(stream->words[stream->nr + idx]);
+		cqe->result = slot->result;
+		cqe->reserved = 0;
+
+		stream->done++;
+		stream->inflight--;
+		stream->cq_tail++;
+		smp_store_release(&stream->ring->cq_tail, stream->cq_tail);
+	}
+}
+
+static void xsdfec_stream_submit(struct xsdfec_stream *stream);
+
+static void xsdfec_stream_cb(void *param, const struct dmaengine_result *res)
+{
+	struct xsdfec_stream_slot *slot = param;
+	struct xsdfec_stream *stream = slot->stream;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stream->lock, flags);
+	if (res && res->result != DMA_TRANS_NOERROR)
+		slot->result = -EIO;
+	if (slot->pending && !--slot->pending) {
+		xsdfec_stream_retire(stream);
+		xsdfec_stream_submit(stream);
+	}
+	spin_unlock_irqrestore(&stream->lock, flags);
+
+	wake_up_interruptible(&stream->wq);
+}
+
+static struct dma_async_tx_descriptor *
+xsdfec_stream_prep(struct xsdfec_stream *stream, enum xsdfec_stream_chan ch,
+		   dma_addr_t buf, size_t len,
+		   struct xsdfec_stream_slot *slot)
+{
+	enum dma_transfer_direction dir;
+	struct dma_async_tx_descriptor *desc;
+
+	dir = (ch == XSDFEC_STREAM_CTRL || ch == XSDFEC_STREAM_DIN) ?
+	      DMA_MEM_TO_DEV : DMA_DEV_TO_MEM;
+	desc = dmaengine_prep_slave_single(stream->chans[ch], buf, len, dir,
+					   slot ? DMA_PREP_INTERRUPT : 0);
+	if (desc && slot) {
+		desc->callback_result = xsdfec_stream_cb;
+		desc->callback_param = slot;
+	}
+
+	return desc;
+}
+
+/* Queue the four transfers of the code block of slot @idx */
+static int xsdfec_stream_queue(struct xsdfec_stream *stream, u32 idx,
+			       const struct xsdfec_sqe *sqe)
+{
+	struct dma_async_tx_descriptor *desc[XSDFEC_STREAM_NR_CHANS];
+	struct xsdfec_stream_slot *slot = &stream->slots[idx];
+	dma_addr_t din = stream->data_dma +
+			 (dma_addr_t)idx * (stream->din_size + stream->dout_size);
+	dma_addr_t words = stream->words_dma;
+	int i;
+
+	stream->words[idx] = sqe->ctrl;
+
+	/* The receiving side is queued first so that no output is dropped */
+	desc[XSDFEC_STREAM_DOUT] =
+		xsdfec_stream_prep(stream, XSDFEC_STREAM_DOUT,
+				   din + stream->din_size, sqe->dout_len, slot);
+	desc[XSDFEC_STREAM_STATUS] =
+		xsdfec_stream_prep(stream, XSDFEC_STREAM_STATUS,
+				   words + (stream->nr + idx) * sizeof(u32),
+				   sizeof(u32), slot);
+	desc[XSDFEC_STREAM_CTRL] =
+		xsdfec_stream_prep(stream, XSDFEC_STREAM_CTRL,
+				   words + idx * sizeof(u32), sizeof(u32),
+				   NULL);
+	desc[XSDFEC_STREAM_DIN] =
+		xsdfec_stream_prep(stream, XSDFEC_STREAM_DIN, din,
+				   sqe->din_len, NULL);
+
+	if (!desc[XSDFEC_STREAM_DOUT] || !desc[XSDFEC_STREAM_STATUS] ||
+	    !desc[XSDFEC_STREAM_CTRL] || !desc[XSDFEC_STREAM_DIN])
+		return -ENOMEM;
+
+	slot->pending = 2;
+	for (i = XSDFEC_STREAM_DOUT; i <= XSDFEC_STREAM_STATUS; i++)
+		if (dma_submit_error(dmaengine_submit(desc[i])))
+			return -EIO;
+	dmaengine_submit(desc[XSDFEC_STREAM_CTRL]);
+	dmaengine_submit(desc[XSDFEC_STREAM_DIN]);
+
+	return 0;
+}
+
+/* Consume the submission entries produced by userspace */
+static void xsdfec_stream_submit(struct xsdfec_stream *stream)
+{
+	struct xsdfec_stream_slot *slot;
+	struct xsdfec_sqe sqe;
+	u32 tail, cq_head, idx;
+	bool queued = false;
+	int i;
+
+	lockdep_assert_held(&stream->lock);
+
+	if (!stream->running)
+		return;
+
+	tail = smp_load_acquire(&stream->ring->sq_tail);
+	cq_head = READ_ONCE(stream->ring->cq_head);
+
+	while (stream->sq_head != tail) {
+		/* Keep room in the completion queue for every block in flight */
+		if (stream->inflight + (stream->cq_tail - cq_head) >=
+		    stream->nr)
+			break;
+
+		idx = stream->sq_head & (stream->nr - 1);
+		slot = &stream->slots[idx];
+		memcpy(&sqe, &stream->sq[idx], sizeof(sqe));
+
+		slot->user_data = sqe.user_data;
+		slot->result = 0;
+		slot->pending = 0;
+
+		if (!sqe.din_len || sqe.din_len > stream->din_size ||
+		    !sqe.dout_len || sqe.dout_len > stream->dout_size)
+			slot->result = -EINVAL;
+		else
+			slot->result = xsdfec_stream_queue(stream, idx, &sqe);
+
+		if (!slot->result)
+			queued = true;
+		else
+			slot->pending = 0;
+
+		stream->inflight++;
+		stream->sq_head++;
+		WRITE_ONCE(stream->ring->sq_head, stream->sq_head);
+	}
+
+	/* Malformed entries retire as soon as the blocks ahead of them do */
+	xsdfec_stream_retire(stream);
+
+	if (queued)
+		for (i = 0; i < XSDFEC_STREAM_NR_CHANS; i++)
+			dma_async_issue_pending(stream->chans[i]);
+}
+
+static void xsdfec_stream_stop(struct xsdfec_stream *stream)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&stream->lock, flags);
+	stream->running = false;
+	spin_unlock_irqrestore(&stream->lock, flags);
+
+	for (i = 0; i < XSDFEC_STREAM_NR_CHANS; i++)
+		dmaengine_terminate_sync(stream->chans[i]);
+
+	/* No callback runs any more, cancel what is left in flight */
+	spin_lock_irqsave(&stream->lock, flags);
+	for (i = 0; i < stream->nr; i++) {
+		if (stream->slots[i].pending) {
+			stream->slots[i].pending = 0;
+			stream->slots[i].result = -ECANCELED;
+		}
+	}
+	xsdfec_stream_retire(stream);
+	spin_unlock_irqrestore(&stream->lock, flags);
+
+	wake_up_interruptible(&stream->wq);
+}
+
+static void xsdfec_stream_free(struct xsdfec_stream *stream)
+{
+	int i;
+
+	if (stream->running)
+		xsdfec_stream_stop(stream);
+
+	if (stream->words)
+		dma_free_coherent(stream->dma_dev, 2 * stream->nr * sizeof(u32),
+				  stream->words, stream->words_dma);
+	if (stream->data)
+		dma_free_coherent(stream->dma_dev, stream->data_size,
+				  stream->data, stream->data_dma);
+	vfree(stream->ring);
+	kfree(stream->slots);
+
+	for (i = 0; i < XSDFEC_STREAM_NR_CHANS; i++)
+		if (!IS_ERR_OR_NULL(stream->chans[i]))
+			dma_release_channel(stream->chans[i]);
+
+	kfree(stream);
+}
+
+static bool xsdfec_stream_setup_valid(const struct xsdfec_stream_setup *setup)
+{
+	return !setup->flags && is_power_of_2(setup->nr_slots) &&
+	       setup->nr_slots >= XSDFEC_STREAM_MIN_SLOTS &&
+	       setup->nr_slots <= XSDFEC_STREAM_MAX_SLOTS &&
+	       setup->din_size && setup->din_size <= XSDFEC_STREAM_MAX_BLOCK &&
+	       setup->dout_size && setup->dout_size <= XSDFEC_STREAM_MAX_BLOCK;
+}
+
+static int xsdfec_stream_start(struct xsdfec_dev *xsdfec, struct file *fptr,
+			       void __user *arg)
+{
+	struct xsdfec_stream_setup setup;
+	struct xsdfec_stream *stream;
+	int err, i;
+
+	if (copy_from_user(&setup, arg, sizeof(setup)))
+		return -EFAULT;
+
+	if (!xsdfec_stream_setup_valid(&setup))
+		return -EINVAL;
+
+	/* DOUT and STATUS words are matched to the blocks in order */
+	if (xsdfec->config.order != XSDFEC_MAINTAIN_ORDER)
+		return -EINVAL;
+
+	mutex_lock(&xsdfec->stream_mutex);
+	if (xsdfec->stream || xsdfec->agg) {
+		err = -EBUSY;
+		goto err_unlock;
+	}
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (!stream) {
+		err = -ENOMEM;
+		goto err_unlock;
+	}
+
+	stream->xsdfec = xsdfec;
+	stream->file = fptr;
+	spin_lock_init(&stream->lock);
+	init_waitqueue_head(&stream->wq);
+	stream->nr = setup.nr_slots;
+	stream->din_size = ALIGN(setup.din_size, XSDFEC_STREAM_ALIGN);
+	stream->dout_size = ALIGN(setup.dout_size, XSDFEC_STREAM_ALIGN);
+
+	for (i = 0; i < XSDFEC_STREAM_NR_CHANS; i++) {
+		stream->chans[i] =
+			dma_request_chan(xsdfec->dev,
+					 xsdfec_stream_chan_names[i]);
+		if (IS_ERR(stream->chans[i])) {
+			err = PTR_ERR(stream->chans[i]);
+			dev_dbg(xsdfec->dev, "no %s DMA channel (%d)",
+				xsdfec_stream_chan_names[i], err);
+			goto err_free;
+		}
+	}
+
+	/* The slots are shared by all channels, as MCDMA channels are */
+	stream->dma_dev = dmaengine_get_dma_device(stream->chans[0]);
+	for (i = 1; i < XSDFEC_STREAM_NR_CHANS; i++) {
+		if (dmaengine_get_dma_device(stream->chans[i]) !=
+		    stream->dma_dev) {
+			err = -EINVAL;
+			goto err_free;
+		}
+	}
+
+	stream->slots = kcalloc(stream->nr, sizeof(*stream->slots),
+				GFP_KERNEL);
+	if (!stream->slots) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+	for (i = 0; i < stream->nr; i++)
+		stream->slots[i].stream = stream;
+
+	stream->ring_size = sizeof(*stream->ring) +
+			    stream->nr * (sizeof(*stream->sq) +
+					  sizeof(*stream->cq));
+	stream->ring = vmalloc_user(stream->ring_size);
+	if (!stream->ring) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+	stream->ring->nr_slots = stream->nr;
+	stream->sq = (struct xsdfec_sqe *)(stream->ring + 1);
+	stream->cq = (struct xsdfec_cqe *)(stream->sq + stream->nr);
+
+	stream->data_size = (size_t)stream->nr *
+			    (stream->din_size + stream->dout_size);
+	stream->data = dma_alloc_coherent(stream->dma_dev, stream->data_size,
+					  &stream->data_dma, GFP_KERNEL);
+	if (!stream->data) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+
+	stream->words = dma_alloc_coherent(stream->dma_dev,
+					   2 * stream->nr * sizeof(u32),
+					   &stream->words_dma, GFP_KERNEL);
+	if (!stream->words) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+
+	setup.din_size = stream->din_size;
+	setup.dout_size = stream->dout_size;
+	setup.ring_offset = 0;
+	setup.data_offset = PAGE_ALIGN(stream->ring_size);
+	if (copy_to_user(arg, &setup, sizeof(setup))) {
+		err = -EFAULT;
+		goto err_free;
+	}
+
+	stream->running = true;
+	xsdfec->stream = stream;
+	mutex_unlock(&xsdfec->stream_mutex);
+
+	return 0;
+
+err_free:
+	xsdfec_stream_free(stream);
+err_unlock:
+	mutex_unlock(&xsdfec->stream_mutex);
+	return err;
+}
+
+/* Return the stream set up through @fptr, NULL if there is none */
+static struct xsdfec_stream *xsdfec_file_stream(struct xsdfec_dev *xsdfec,
+						struct file *fptr)
+{
+	struct xsdfec_stream *stream = READ_ONCE(xsdfec->stream);
+
+	return stream && stream->file == fptr ? stream : NULL;
+}
+
+static int xsdfec_stream_kick(struct xsdfec_dev *xsdfec, struct file *fptr)
+{
+	struct xsdfec_stream *stream;
+	unsigned long flags;
+	int err = 0;
+
+	mutex_lock(&xsdfec->stream_mutex);
+	stream = xsdfec_file_stream(xsdfec, fptr);
+	if (stream) {
+		spin_lock_irqsave(&stream->lock, flags);
+		if (stream->running)
+			xsdfec_stream_submit(stream);
+		else
+			err = -EPIPE;
+		spin_unlock_irqrestore(&stream->lock, flags);
+	} else {
+		err = -EINVAL;
+	}
+	mutex_unlock(&xsdfec->stream_mutex);
+
+	return err;
+}
+
+static int xsdfec_stream_halt(struct xsdfec_dev *xsdfec, struct file *fptr)
+{
+	struct xsdfec_stream *stream;
+
+	mutex_lock(&xsdfec->stream_mutex);
+	stream = xsdfec_file_stream(xsdfec, fptr);
+	if (stream && stream->running)
+		xsdfec_stream_stop(stream);
+	mutex_unlock(&xsdfec->stream_mutex);
+
+	return stream ? 0 : -EINVAL;
+}
+
 static int xsdfec_set_order(struct xsdfec_dev *xsdfec, void __user *arg)
 {
 	bool order_invalid;
@@ -944,7 +1650,8 @@ static long xsdfec_dev_ioctl(struct file *fptr, unsigned int cmd,
 	/* In failed state allow only reset and get status IOCTLs */
 	if (xsdfec->state == XSDFEC_NEEDS_RESET &&
 	    (cmd != XSDFEC_SET_DEFAULT_CONFIG && cmd != XSDFEC_GET_STATUS &&
-	     cmd != XSDFEC_GET_STATS && cmd != XSDFEC_CLEAR_STATS)) {
+	     cmd != XSDFEC_GET_STATS && cmd != XSDFEC_CLEAR_STATS &&
+	     cmd != XSDFEC_STREAM_STOP)) {
 		return -EPERM;
 	}
 
@@ -991,6 +1698,24 @@ static long xsdfec_dev_ioctl(struct file *fptr, unsigned int cmd,
 	case XSDFEC_IS_ACTIVE:
 		rval = xsdfec_is_active(xsdfec, (bool __user *)arg);
 		break;
+	case XSDFEC_ADD_LDPC_CODE_SET:
+		rval = xsdfec_add_ldpc_set(xsdfec, arg);
+		break;
+	case XSDFEC_SET_CODE_BANK:
+		rval = xsdfec_set_code_bank(xsdfec, arg);
+		break;
+	case XSDFEC_GET_CODE_BANK:
+		rval = put_user(xsdfec->code_bank, (u32 __user *)arg);
+		break;
+	case XSDFEC_STREAM_START:
+		rval = xsdfec_stream_start(xsdfec, fptr, arg);
+		break;
+	case XSDFEC_STREAM_KICK:
+		rval = xsdfec_stream_kick(xsdfec, fptr);
+		break;
+	case XSDFEC_STREAM_STOP:
+		rval = xsdfec_stream_halt(xsdfec, fptr);
+		break;
 	default:
 		rval = -ENOTTY;
 		break;
@@ -1002,11 +1727,21 @@ static __poll_t xsdfec_poll(struct file *file, poll_table *wait)
 {
 	__poll_t mask = 0;
 	struct xsdfec_dev *xsdfec;
+	struct xsdfec_stream *stream;
 
 	xsdfec = container_of(file->private_data, struct xsdfec_dev, miscdev);
 
 	poll_wait(file, &xsdfec->waitq, wait);
 
+	/* The stream lives until this file is released */
+	stream = xsdfec_file_stream(xsdfec, file);
+	if (stream) {
+		poll_wait(file, &stream->wq, wait);
+		if (smp_load_acquire(&stream->ring->cq_tail) !=
+		    READ_ONCE(stream->ring->cq_head))
+			mask |= EPOLLIN | EPOLLRDBAND;
+	}
+
 	/* XSDFEC ISR detected an error */
 	spin_lock_irqsave(&xsdfec->error_data_lock, xsdfec->flags);
 	if (xsdfec->state_updated)
@@ -1019,13 +1754,907 @@ static __poll_t xsdfec_poll(struct file *file, poll_table *wait)
 	return mask;
 }
 
+static int xsdfec_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xsdfec_dev *xsdfec;
+	struct xsdfec_stream *stream;
+	unsigned long pgoff = vma->vm_pgoff;
+
+	xsdfec = container_of(file->private_data, struct xsdfec_dev, miscdev);
+
+	stream = xsdfec_file_stream(xsdfec, file);
+	if (!stream)
+		return -EINVAL;
+
+	vma->vm_pgoff = 0;
+	if (!pgoff)
+		return remap_vmalloc_range(vma, stream->ring, 0);
+
+	if (pgoff == PAGE_ALIGN(stream->ring_size) >> PAGE_SHIFT)
+		return dma_mmap_coherent(stream->dma_dev, vma, stream->data,
+					 stream->data_dma, stream->data_size);
+
+	return -EINVAL;
+}
+
+static int xsdfec_release(struct inode *inode, struct file *file)
+{
+	struct xsdfec_dev *xsdfec;
+	struct xsdfec_stream *stream;
+
+	xsdfec = container_of(file->private_data, struct xsdfec_dev, miscdev);
+
+	mutex_lock(&xsdfec->stream_mutex);
+	stream = xsdfec_file_stream(xsdfec, file);
+	if (stream) {
+		xsdfec->stream = NULL;
+		xsdfec_stream_free(stream);
+	}
+	mutex_unlock(&xsdfec->stream_mutex);
+
+	return 0;
+}
+
 static const struct file_operations xsdfec_fops = {
 	.owner = THIS_MODULE,
 	.unlocked_ioctl = xsdfec_dev_ioctl,
 	.poll = xsdfec_poll,
+	.mmap = xsdfec_mmap,
+	.release = xsdfec_release,
+	.compat_ioctl = compat_ptr_ioctl,
+};
+
+/**
+ * struct xsdfec_agg_member - SD-FEC instance of an aggregate stream
+ * @xsdfec: SD-FEC device, NULL once it has been removed
+ * @dev_id: Device id of @xsdfec
+ * @chans: CTRL, DIN, DOUT and STATUS DMA channels
+ * @dma_dev: Device the data slots are mapped for
+ * @words: Control words followed by status words, one of each per slot
+ * @words_dma: DMA address of @words
+ * @sgts: DIN and DOUT mappings of every slot, in that order
+ * @inflight: Number of blocks in flight on the instance
+ * @blocks: Number of blocks completed
+ * @errors: Number of blocks completed with an error
+ */
+struct xsdfec_agg_member {
+	struct xsdfec_dev *xsdfec;
+	int dev_id;
+	struct dma_chan *chans[XSDFEC_STREAM_NR_CHANS];
+	struct device *dma_dev;
+	u32 *words;
+	dma_addr_t words_dma;
+	struct sg_table *sgts;
+	u32 inflight;
+	u64 blocks;
+	u64 errors;
+};
+
+/**
+ * struct xsdfec_agg_slot - Code block in flight on an aggregate stream
+ * @agg: Aggregate stream the slot belongs to
+ * @member: Instance the block was sent to, NULL if it was not queued
+ * @user_data: Value from the submission entry
+ * @din_len: Number of DIN bytes of the block
+ * @dout_len: Number of DOUT bytes of the block
+ * @pending: Number of DOUT and STATUS transfers not yet completed
+ * @result: 0 or a negative error code for the completion entry
+ */
+struct xsdfec_agg_slot {
+	struct xsdfec_agg *agg;
+	struct xsdfec_agg_member *member;
+	u64 user_data;
+	u32 din_len;
+	u32 dout_len;
+	int pending;
+	int result;
+};
+
+/**
+ * struct xsdfec_agg - Stream spread over several SD-FEC instances
+ * @lock: Protects the stream state, the indices and the counters below
+ * @wq: Wait queue signalled on completion
+ * @ring: Ring header shared with userspace
+ * @ring_size: Size of @ring and of the queues following it
+ * @sq: Submission queue
+ * @cq: Completion queue
+ * @data: Data slots shared with userspace
+ * @data_size: Size of @data
+ * @slots: Per-slot state
+ * @nr: Number of slots
+ * @din_size: Size of the DIN area of a slot
+ * @dout_size: Size of the DOUT area of a slot
+ * @sq_head: Submission entries consumed
+ * @cq_tail: Completion entries produced
+ * @done: Slots retired, in submission order
+ * @inflight: Number of slots consumed and not yet retired
+ * @next: Instance the search for the least loaded one starts from
+ * @din_bytes: DIN bytes of the completed blocks
+ * @dout_bytes: DOUT bytes of the completed blocks
+ * @running: DMA is enabled
+ * @nr_members: Number of valid entries in @members
+ * @members: Aggregated instances
+ *
+ * The data slots are not bound to an instance, they are mapped for the DMA
+ * device of every member so that each block can go to whichever instance is
+ * the least loaded when it is consumed.
+ */
+struct xsdfec_agg {
+	/* Spinlock to protect the stream state */
+	spinlock_t lock;
+	wait_queue_head_t wq;
+	struct xsdfec_stream_ring *ring;
+	size_t ring_size;
+	struct xsdfec_sqe *sq;
+	struct xsdfec_cqe *cq;
+	void *data;
+	size_t data_size;
+	struct xsdfec_agg_slot *slots;
+	u32 nr;
+	u32 din_size;
+	u32 dout_size;
+	u32 sq_head;
+	u32 cq_tail;
+	u32 done;
+	u32 inflight;
+	u32 next;
+	u64 din_bytes;
+	u64 dout_bytes;
+	bool running;
+	u32 nr_members;
+	struct xsdfec_agg_member members[XSDFEC_AGG_MAX_MEMBERS];
+};
+
+static void xsdfec_agg_retire(struct xsdfec_agg *agg)
+{
+	struct xsdfec_agg_member *member;
+	struct xsdfec_agg_slot *slot;
+	struct xsdfec_cqe *cqe;
+	u32 idx;
+
+	lockdep_assert_held(&agg->lock);
+
+	while (agg->inflight) {
+		idx = agg->done & (agg->nr - 1);
+		slot = &agg->slots[idx];
+		if (slot->pending)
+			break;
+
+		member = slot->member;
+		cqe = &agg->cq[agg->cq_tail & (agg->nr - 1)];
+		cqe->user_data = slot->user_data;
+		cqe->slot = idx;
+		cqe->status = 0;
+		cqe->result = slot->result;
+		cqe->reserved = 0;
+
+		if (member) {
+			dma_sync_sgtable_for_cpu(member->dma_dev,
+						 &member->sgts[2 * idx + 1],
+						 DMA_FROM_DEVICE);
+			cqe->status = READ_ONCE(member->words[agg->nr + idx]);
+			member->inflight--;
+			member->blocks++;
+			if (slot->result)
+				member->errors++;
+			agg->din_bytes += slot->din_len;
+			agg->dout_bytes += slot->dout_len;
+			slot->member = NULL;
+		}
+
+		agg->done++;
+		agg->inflight--;
+		agg->cq_tail++;
+		smp_store_release(&agg->ring->cq_tail, agg->cq_tail);
+	}
+}
+
+static void xsdfec_agg_submit(struct xsdfec_agg *agg);
+
+static void xsdfec_agg_cb(void *param, const struct dmaengine_result *res)
+{
+	struct xsdfec_agg_slot *slot = param;
+	struct xsdfec_agg *agg = slot->agg;
+	unsigned long flags;
+
+	spin_lock_irqsave(&agg->lock, flags);
+	if (res && res->result != DMA_TRANS_NOERROR)
+		slot->result = -EIO;
+	if (slot->pending && !--slot->pending) {
+		xsdfec_agg_retire(agg);
+		xsdfec_agg_submit(agg);
+	}
+	spin_unlock_irqrestore(&agg->lock, flags);
+
+	wake_up_interruptible(&agg->wq);
+}
+
+static struct dma_async_tx_descriptor *
+xsdfec_agg_prep_word(struct dma_chan *chan, dma_addr_t buf,
+		     enum dma_transfer_direction dir,
+		     struct xsdfec_agg_slot *slot)
+{
+	struct dma_async_tx_descriptor *desc;
+
+	desc = dmaengine_prep_slave_single(chan, buf, sizeof(u32), dir,
+					   slot ? DMA_PREP_INTERRUPT : 0);
+	if (desc && slot) {
+		desc->callback_result = xsdfec_agg_cb;
+		desc->callback_param = slot;
+	}
+
+	return desc;
+}
+
+/* Build a descriptor for the first @len bytes of the mapping @sgt */
+static struct dma_async_tx_descriptor *
+xsdfec_agg_prep_sg(struct dma_chan *chan, struct sg_table *sgt, size_t len,
+		   enum dma_transfer_direction dir,
+		   struct xsdfec_agg_slot *slot)
+{
+	struct dma_async_tx_descriptor *desc;
+	struct scatterlist *sg, *last = NULL;
+	unsigned int nents = 0, last_len;
+	int i;
+
+	for_each_sgtable_dma_sg(sgt, sg, i) {
+		nents++;
+		last = sg;
+		if (sg_dma_len(sg) >= len)
+			break;
+		len -= sg_dma_len(sg);
+	}
+	if (!last)
+		return NULL;
+
+	/* The engine copies the list while preparing, trim it meanwhile */
+	last_len = sg_dma_len(last);
+	sg_dma_len(last) = min_t(size_t, last_len, len);
+	desc = dmaengine_prep_slave_sg(chan, sgt->sgl, nents, dir,
+				       slot ? DMA_PREP_INTERRUPT : 0);
+	sg_dma_len(last) = last_len;
+
+	if (desc && slot) {
+		desc->callback_result = xsdfec_agg_cb;
+		desc->callback_param = slot;
+	}
+
+	return desc;
+}
+
+static int xsdfec_agg_queue(struct xsdfec_agg *agg,
+			    struct xsdfec_agg_member *member, u32 idx,
+			    const struct xsdfec_sqe *sqe)
+{
+	struct dma_async_tx_descriptor *desc[XSDFEC_STREAM_NR_CHANS];
+	struct xsdfec_agg_slot *slot = &agg->slots[idx];
+	struct sg_table *din = &member->sgts[2 * idx];
+	struct sg_table *dout = din + 1;
+	dma_addr_t words = member->words_dma;
+	int i;
+
+	member->words[idx] = sqe->ctrl;
+	dma_sync_sgtable_for_device(member->dma_dev, din, DMA_TO_DEVICE);
+	dma_sync_sgtable_for_device(member->dma_dev, dout, DMA_FROM_DEVICE);
+
+	/* The receiving side is queued first so that no output is dropped */
+	desc[XSDFEC_STREAM_DOUT] =
+		xsdfec_agg_prep_sg(member->chans[XSDFEC_STREAM_DOUT], dout,
+				   sqe->dout_len, DMA_DEV_TO_MEM, slot);
+	desc[XSDFEC_STREAM_STATUS] =
+		xsdfec_agg_prep_word(member->chans[XSDFEC_STREAM_STATUS],
+				     words + (agg->nr + idx) * sizeof(u32),
+				     DMA_DEV_TO_MEM, slot);
+	desc[XSDFEC_STREAM_CTRL] =
+		xsdfec_agg_prep_word(member->chans[XSDFEC_STREAM_CTRL],
+				     words + idx * sizeof(u32),
+				     DMA_MEM_TO_DEV, NULL);
+	desc[XSDFEC_STREAM_DIN] =
+		xsdfec_agg_prep_sg(member->chans[XSDFEC_STREAM_DIN], din,
+				   sqe->din_len, DMA_MEM_TO_DEV, NULL);
+
+	if (!desc[XSDFEC_STREAM_DOUT] || !desc[XSDFEC_STREAM_STATUS] ||
+	    !desc[XSDFEC_STREAM_CTRL] || !desc[XSDFEC_STREAM_DIN])
+		return -ENOMEM;
+
+	slot->pending = 2;
+	for (i = XSDFEC_STREAM_DOUT; i <= XSDFEC_STREAM_STATUS; i++)
+		if (dma_submit_error(dmaengine_submit(desc[i])))
+			return -EIO;
+	dmaengine_submit(desc[XSDFEC_STREAM_CTRL]);
+	dmaengine_submit(desc[XSDFEC_STREAM_DIN]);
+
+	return 0;
+}
+
+/* Return the member with the fewest blocks in flight */
+static struct xsdfec_agg_member *xsdfec_agg_pick(struct xsdfec_agg *agg)
+{
+	struct xsdfec_agg_member *member, *best = NULL;
+	u32 i;
+
+	for (i = 0; i < agg->nr_members; i++) {
+		member = &agg->members[(agg->next + i) % agg->nr_members];
+		if (!member->xsdfec)
+			continue;
+		if (!best || member->inflight < best->inflight)
+			best = member;
+		if (!best->inflight)
+			break;
+	}
+
+	/* Spread ties over the idle instances */
+	agg->next = (agg->next + 1) % agg->nr_members;
+
+	return best;
+}
+
+static void xsdfec_agg_submit(struct xsdfec_agg *agg)
+{
+	struct xsdfec_agg_member *member;
+	struct xsdfec_agg_slot *slot;
+	u32 queued = 0;
+	struct xsdfec_sqe sqe;
+	u32 tail, cq_head, idx;
+	int i, j;
+
+	lockdep_assert_held(&agg->lock);
+
+	if (!agg->running)
+		return;
+
+	tail = smp_load_acquire(&agg->ring->sq_tail);
+	cq_head = READ_ONCE(agg->ring->cq_head);
+
+	while (agg->sq_head != tail) {
+		/* Keep room in the completion queue for every block in flight */
+		if (agg->inflight + (agg->cq_tail - cq_head) >= agg->nr)
+			break;
+
+		idx = agg->sq_head & (agg->nr - 1);
+		slot = &agg->slots[idx];
+		memcpy(&sqe, &agg->sq[idx], sizeof(sqe));
+
+		slot->user_data = sqe.user_data;
+		slot->din_len = sqe.din_len;
+		slot->dout_len = sqe.dout_len;
+		slot->member = NULL;
+		slot->pending = 0;
+
+		member = xsdfec_agg_pick(agg);
+		if (!member)
+			slot->result = -ENODEV;
+		else if (!sqe.din_len || sqe.din_len > agg->din_size ||
+			 !sqe.dout_len || sqe.dout_len > agg->dout_size)
+			slot->result = -EINVAL;
+		else
+			slot->result = xsdfec_agg_queue(agg, member, idx, &sqe);
+
+		if (!slot->result) {
+			slot->member = member;
+			member->inflight++;
+			queued |= BIT(member - agg->members);
+		} else {
+			slot->pending = 0;
+		}
+
+		agg->inflight++;
+		agg->sq_head++;
+		WRITE_ONCE(agg->ring->sq_head, agg->sq_head);
+	}
+
+	/* Malformed entries retire as soon as the blocks ahead of them do */
+	xsdfec_agg_retire(agg);
+
+	for (i = 0; i < agg->nr_members; i++) {
+		if (!(queued & BIT(i)))
+			continue;
+		for (j = 0; j < XSDFEC_STREAM_NR_CHANS; j++)
+			dma_async_issue_pending(agg->members[i].chans[j]);
+	}
+}
+
+static void xsdfec_agg_stop(struct xsdfec_agg *agg)
+{
+	unsigned long flags;
+	int i, j;
+
+	spin_lock_irqsave(&agg->lock, flags);
+	agg->running = false;
+	spin_unlock_irqrestore(&agg->lock, flags);
+
+	for (i = 0; i < agg->nr_members; i++)
+		for (j = 0; j < XSDFEC_STREAM_NR_CHANS; j++)
+			if (!IS_ERR_OR_NULL(agg->members[i].chans[j]))
+				dmaengine_terminate_sync(agg->members[i].chans[j]);
+
+	/* No callback runs any more, cancel what is left in flight */
+	spin_lock_irqsave(&agg->lock, flags);
+	for (i = 0; i < agg->nr; i++) {
+		if (agg->slots[i].pending) {
+			agg->slots[i].pending = 0;
+			agg->slots[i].result = -ECANCELED;
+		}
+	}
+	xsdfec_agg_retire(agg);
+	spin_unlock_irqrestore(&agg->lock, flags);
+
+	wake_up_interruptible(&agg->wq);
+}
+
+/* Map the DIN and DOUT areas of every slot for the DMA device of @member */
+static int xsdfec_agg_map(struct xsdfec_agg *agg,
+			  struct xsdfec_agg_member *member)
+{
+	struct page **pages;
+	unsigned long addr;
+	size_t size;
+	u32 i, n, p;
+	int err;
+
+	n = DIV_ROUND_UP(max(agg->din_size, agg->dout_size), PAGE_SIZE) + 1;
+	pages = kmalloc_array(n, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	member->sgts = kcalloc(2 * agg->nr, sizeof(*member->sgts), GFP_KERNEL);
+	if (!member->sgts) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < 2 * agg->nr; i++) {
+		addr = (unsigned long)agg->data +
+		       (i / 2) * (agg->din_size + agg->dout_size);
+		size = agg->din_size;
+		if (i & 1) {
+			addr += agg->din_size;
+			size = agg->dout_size;
+		}
+
+		n = DIV_ROUND_UP(offset_in_page(addr) + size, PAGE_SIZE);
+		for (p = 0; p < n; p++)
+			pages[p] = vmalloc_to_page((void *)(addr & PAGE_MASK) +
+						   p * PAGE_SIZE);
+
+		err = sg_alloc_table_from_pages(&member->sgts[i], pages, n,
+						offset_in_page(addr), size,
+						GFP_KERNEL);
+		if (err)
+			goto out;
+
+		err = dma_map_sgtable(member->dma_dev, &member->sgts[i],
+				      i & 1 ? DMA_FROM_DEVICE : DMA_TO_DEVICE,
+				      0);
+		if (err) {
+			sg_free_table(&member->sgts[i]);
+			goto out;
+		}
+	}
+	err = 0;
+
+out:
+	kfree(pages);
+	return err;
+}
+
+static void xsdfec_agg_unmap(struct xsdfec_agg *agg,
+			     struct xsdfec_agg_member *member)
+{
+	u32 i;
+
+	if (!member->sgts)
+		return;
+
+	for (i = 0; i < 2 * agg->nr; i++) {
+		if (!member->sgts[i].sgl)
+			break;
+		dma_unmap_sgtable(member->dma_dev, &member->sgts[i],
+				  i & 1 ? DMA_FROM_DEVICE : DMA_TO_DEVICE, 0);
+		sg_free_table(&member->sgts[i]);
+	}
+	kfree(member->sgts);
+	member->sgts = NULL;
+}
+
+static int xsdfec_agg_member_init(struct xsdfec_agg *agg,
+				  struct xsdfec_agg_member *member)
+{
+	struct xsdfec_dev *xsdfec = member->xsdfec;
+	int err, i;
+
+	for (i = 0; i < XSDFEC_STREAM_NR_CHANS; i++) {
+		member->chans[i] =
+			dma_request_chan(xsdfec->dev,
+					 xsdfec_stream_chan_names[i]);
+		if (IS_ERR(member->chans[i])) {
+			err = PTR_ERR(member->chans[i]);
+			dev_dbg(xsdfec->dev, "no %s DMA channel (%d)",
+				xsdfec_stream_chan_names[i], err);
+			return err;
+		}
+	}
+
+	member->dma_dev = dmaengine_get_dma_device(member->chans[0]);
+	for (i = 1; i < XSDFEC_STREAM_NR_CHANS; i++)
+		if (dmaengine_get_dma_device(member->chans[i]) !=
+		    member->dma_dev)
+			return -EINVAL;
+
+	member->words = dma_alloc_coherent(member->dma_dev,
+					   2 * agg->nr * sizeof(u32),
+					   &member->words_dma, GFP_KERNEL);
+	if (!member->words)
+		return -ENOMEM;
+
+	return xsdfec_agg_map(agg, member);
+}
+
+/* Called with xsdfec_list_mutex held */
+static void xsdfec_agg_teardown(struct xsdfec_agg *agg)
+{
+	struct xsdfec_agg_member *member;
+	int i, j;
+
+	if (agg->running)
+		xsdfec_agg_stop(agg);
+
+	for (i = 0; i < agg->nr_members; i++) {
+		member = &agg->members[i];
+
+		xsdfec_agg_unmap(agg, member);
+		if (member->words)
+			dma_free_coherent(member->dma_dev,
+					  2 * agg->nr * sizeof(u32),
+					  member->words, member->words_dma);
+		for (j = 0; j < XSDFEC_STREAM_NR_CHANS; j++)
+			if (!IS_ERR_OR_NULL(member->chans[j]))
+				dma_release_channel(member->chans[j]);
+
+		if (member->xsdfec) {
+			mutex_lock(&member->xsdfec->stream_mutex);
+			member->xsdfec->agg = NULL;
+			mutex_unlock(&member->xsdfec->stream_mutex);
+		}
+	}
+	memset(agg->members, 0, sizeof(agg->members));
+	agg->nr_members = 0;
+
+	vfree(agg->data);
+	agg->data = NULL;
+	vfree(agg->ring);
+	agg->ring = NULL;
+	kfree(agg->slots);
+	agg->slots = NULL;
+}
+
+static bool xsdfec_agg_match(struct xsdfec_dev *xsdfec,
+			     const struct xsdfec_agg_setup *setup)
+{
+	if (setup->members && (xsdfec->dev_id >= 64 ||
+			       !(setup->members & BIT_ULL(xsdfec->dev_id))))
+		return false;
+
+	if (xsdfec->stream || xsdfec->agg ||
+	    xsdfec->state != XSDFEC_STARTED ||
+	    xsdfec->config.order != XSDFEC_MAINTAIN_ORDER ||
+	    xsdfec->config.code != setup->code)
+		return false;
+
+	return setup->code != XSDFEC_LDPC_CODE ||
+	       xsdfec->code_bank == setup->code_bank;
+}
+
+static int xsdfec_agg_start(struct xsdfec_agg *agg, void __user *arg)
+{
+	struct xsdfec_agg_member *member;
+	struct xsdfec_agg_setup setup;
+	struct xsdfec_dev *xsdfec;
+	int err, i;
+
+	if (copy_from_user(&setup, arg, sizeof(setup)))
+		return -EFAULT;
+
+	if (!xsdfec_stream_setup_valid(&setup.stream) || setup.reserved ||
+	    (setup.code != XSDFEC_TURBO_CODE && setup.code != XSDFEC_LDPC_CODE))
+		return -EINVAL;
+
+	mutex_lock(&xsdfec_list_mutex);
+	if (agg->ring) {
+		err = -EBUSY;
+		goto err_unlock;
+	}
+
+	agg->nr = setup.stream.nr_slots;
+	agg->din_size = ALIGN(setup.stream.din_size, XSDFEC_STREAM_ALIGN);
+	agg->dout_size = ALIGN(setup.stream.dout_size, XSDFEC_STREAM_ALIGN);
+	agg->sq_head = 0;
+	agg->cq_tail = 0;
+	agg->done = 0;
+	agg->inflight = 0;
+	agg->next = 0;
+	agg->din_bytes = 0;
+	agg->dout_bytes = 0;
+
+	/* Claim the matching instances */
+	list_for_each_entry(xsdfec, &xsdfec_list, node) {
+		if (agg->nr_members == XSDFEC_AGG_MAX_MEMBERS)
+			break;
+
+		mutex_lock(&xsdfec->stream_mutex);
+		if (xsdfec_agg_match(xsdfec, &setup)) {
+			xsdfec->agg = agg;
+			member = &agg->members[agg->nr_members++];
+			member->xsdfec = xsdfec;
+			member->dev_id = xsdfec->dev_id;
+		}
+		mutex_unlock(&xsdfec->stream_mutex);
+	}
+	if (!agg->nr_members) {
+		err = -ENODEV;
+		goto err_unlock;
+	}
+
+	agg->slots = kcalloc(agg->nr, sizeof(*agg->slots), GFP_KERNEL);
+	if (!agg->slots) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+	for (i = 0; i < agg->nr; i++)
+		agg->slots[i].agg = agg;
+
+	agg->ring_size = sizeof(*agg->ring) +
+			 agg->nr * (sizeof(*agg->sq) + sizeof(*agg->cq));
+	agg->ring = vmalloc_user(agg->ring_size);
+	if (!agg->ring) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+	agg->ring->nr_slots = agg->nr;
+	agg->sq = (struct xsdfec_sqe *)(agg->ring + 1);
+	agg->cq = (struct xsdfec_cqe *)(agg->sq + agg->nr);
+
+	agg->data_size = (size_t)agg->nr * (agg->din_size + agg->dout_size);
+	agg->data = vmalloc_user(agg->data_size);
+	if (!agg->data) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+
+	setup.members = 0;
+	for (i = 0; i < agg->nr_members; i++) {
+		err = xsdfec_agg_member_init(agg, &agg->members[i]);
+		if (err)
+			goto err_free;
+		if (agg->members[i].dev_id < 64)
+			setup.members |= BIT_ULL(agg->members[i].dev_id);
+	}
+
+	setup.nr_members = agg->nr_members;
+	setup.stream.din_size = agg->din_size;
+	setup.stream.dout_size = agg->dout_size;
+	setup.stream.ring_offset = 0;
+	setup.stream.data_offset = PAGE_ALIGN(agg->ring_size);
+	if (copy_to_user(arg, &setup, sizeof(setup))) {
+		err = -EFAULT;
+		goto err_free;
+	}
+
+	agg->running = true;
+	mutex_unlock(&xsdfec_list_mutex);
+
+	return 0;
+
+err_free:
+	xsdfec_agg_teardown(agg);
+err_unlock:
+	mutex_unlock(&xsdfec_list_mutex);
+	return err;
+}
+
+static int xsdfec_agg_get_stats(struct xsdfec_agg *agg, void __user *arg)
+{
+	struct xsdfec_agg_member_stats *ms;
+	struct xsdfec_agg_member *member;
+	struct xsdfec_agg_stats *stats;
+	unsigned long flags;
+	int err = 0;
+	u32 i;
+
+	stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	mutex_lock(&xsdfec_list_mutex);
+	if (!agg->ring) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	spin_lock_irqsave(&agg->lock, flags);
+	stats->nr_members = agg->nr_members;
+	stats->inflight = agg->inflight;
+	stats->din_bytes = agg->din_bytes;
+	stats->dout_bytes = agg->dout_bytes;
+	for (i = 0; i < agg->nr_members; i++) {
+		member = &agg->members[i];
+		ms = &stats->members[i];
+		ms->dev_id = member->xsdfec ? member->dev_id : -1;
+		ms->inflight = member->inflight;
+		ms->blocks = member->blocks;
+		ms->errors = member->errors;
+		stats->blocks += member->blocks;
+		stats->errors += member->errors;
+	}
+	spin_unlock_irqrestore(&agg->lock, flags);
+
+	/* Members are only detached under xsdfec_list_mutex */
+	for (i = 0; i < agg->nr_members; i++) {
+		member = &agg->members[i];
+		ms = &stats->members[i];
+		if (!member->xsdfec)
+			continue;
+
+		spin_lock_irqsave(&member->xsdfec->error_data_lock, flags);
+		ms->isr_err_count = member->xsdfec->isr_err_count;
+		ms->cecc_count = member->xsdfec->cecc_count;
+		ms->uecc_count = member->xsdfec->uecc_count;
+		spin_unlock_irqrestore(&member->xsdfec->error_data_lock, flags);
+
+		stats->isr_err_count += ms->isr_err_count;
+		stats->cecc_count += ms->cecc_count;
+		stats->uecc_count += ms->uecc_count;
+	}
+
+	if (copy_to_user(arg, stats, sizeof(*stats)))
+		err = -EFAULT;
+out:
+	mutex_unlock(&xsdfec_list_mutex);
+	kfree(stats);
+	return err;
+}
+
+static long xsdfec_agg_ioctl(struct file *fptr, unsigned int cmd,
+			     unsigned long data)
+{
+	struct xsdfec_agg *agg = fptr->private_data;
+	void __user *arg = (void __user *)data;
+	unsigned long flags;
+	int rval = 0;
+
+	switch (cmd) {
+	case XSDFEC_AGG_START:
+		rval = xsdfec_agg_start(agg, arg);
+		break;
+	case XSDFEC_AGG_GET_STATS:
+		rval = xsdfec_agg_get_stats(agg, arg);
+		break;
+	case XSDFEC_STREAM_KICK:
+		mutex_lock(&xsdfec_list_mutex);
+		if (agg->ring) {
+			spin_lock_irqsave(&agg->lock, flags);
+			if (agg->running)
+				xsdfec_agg_submit(agg);
+			else
+				rval = -EPIPE;
+			spin_unlock_irqrestore(&agg->lock, flags);
+		} else {
+			rval = -EINVAL;
+		}
+		mutex_unlock(&xsdfec_list_mutex);
+		break;
+	case XSDFEC_STREAM_STOP:
+		mutex_lock(&xsdfec_list_mutex);
+		if (agg->running)
+			xsdfec_agg_stop(agg);
+		else if (!agg->ring)
+			rval = -EINVAL;
+		mutex_unlock(&xsdfec_list_mutex);
+		break;
+	default:
+		rval = -ENOTTY;
+		break;
+	}
+	return rval;
+}
+
+static __poll_t xsdfec_agg_poll(struct file *file, poll_table *wait)
+{
+	struct xsdfec_agg *agg = file->private_data;
+	__poll_t mask = 0;
+
+	poll_wait(file, &agg->wq, wait);
+
+	/* The ring is only freed when this file is released */
+	if (READ_ONCE(agg->ring) &&
+	    smp_load_acquire(&agg->ring->cq_tail) !=
+	    READ_ONCE(agg->ring->cq_head))
+		mask |= EPOLLIN | EPOLLRDBAND;
+
+	return mask;
+}
+
+static int xsdfec_agg_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xsdfec_agg *agg = file->private_data;
+	unsigned long pgoff = vma->vm_pgoff;
+	int err = -EINVAL;
+
+	mutex_lock(&xsdfec_list_mutex);
+	if (agg->ring) {
+		vma->vm_pgoff = 0;
+		if (!pgoff)
+			err = remap_vmalloc_range(vma, agg->ring, 0);
+		else if (pgoff == PAGE_ALIGN(agg->ring_size) >> PAGE_SHIFT)
+			err = remap_vmalloc_range(vma, agg->data, 0);
+	}
+	mutex_unlock(&xsdfec_list_mutex);
+
+	return err;
+}
+
+static int xsdfec_agg_open(struct inode *inode, struct file *file)
+{
+	struct xsdfec_agg *agg;
+
+	agg = kzalloc(sizeof(*agg), GFP_KERNEL);
+	if (!agg)
+		return -ENOMEM;
+
+	spin_lock_init(&agg->lock);
+	init_waitqueue_head(&agg->wq);
+	file->private_data = agg;
+
+	return 0;
+}
+
+static int xsdfec_agg_release(struct inode *inode, struct file *file)
+{
+	struct xsdfec_agg *agg = file->private_data;
+
+	mutex_lock(&xsdfec_list_mutex);
+	xsdfec_agg_teardown(agg);
+	mutex_unlock(&xsdfec_list_mutex);
+	kfree(agg);
+
+	return 0;
+}
+
+static const struct file_operations xsdfec_agg_fops = {
+	.owner = THIS_MODULE,
+	.open = xsdfec_agg_open,
+	.release = xsdfec_agg_release,
+	.unlocked_ioctl = xsdfec_agg_ioctl,
+	.poll = xsdfec_agg_poll,
+	.mmap = xsdfec_agg_mmap,
 	.compat_ioctl = compat_ptr_ioctl,
 };
 
+static struct miscdevice xsdfec_agg_miscdev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "xsdfec_agg",
+	.fops = &xsdfec_agg_fops,
+};
+
+/* Stop the aggregate stream @xsdfec is part of, before it goes away */
+static void xsdfec_agg_detach(struct xsdfec_dev *xsdfec)
+{
+	struct xsdfec_agg *agg = xsdfec->agg;
+	int i;
+
+	lockdep_assert_held(&xsdfec_list_mutex);
+
+	if (!agg)
+		return;
+
+	if (agg->running)
+		xsdfec_agg_stop(agg);
+	for (i = 0; i < agg->nr_members; i++)
+		if (agg->members[i].xsdfec == xsdfec)
+			agg->members[i].xsdfec = NULL;
+	xsdfec->agg = NULL;
+}
+
 static int xsdfec_parse_of(struct xsdfec_dev *xsdfec)
 {
 	struct device *dev = xsdfec->dev;
@@ -1357,6 +2986,7 @@ static int xsdfec_probe(struct platform_device *pdev)
 
 	xsdfec->dev = &pdev->dev;
 	spin_lock_init(&xsdfec->error_data_lock);
+	mutex_init(&xsdfec->stream_mutex);
 
 	err = xsdfec_clk_init(pdev, &xsdfec->clks);
 	if (err)
@@ -1411,6 +3041,11 @@ static int xsdfec_probe(struct platform_device *pdev)
 		dev_err(dev, "error:%d. Unable to register device", err);
 		goto err_xsdfec_ida;
 	}
+
+	mutex_lock(&xsdfec_list_mutex);
+	list_add_tail(&xsdfec->node, &xsdfec_list);
+	mutex_unlock(&xsdfec_list_mutex);
+
 	return 0;
 
 err_xsdfec_ida:
@@ -1425,6 +3060,12 @@ static int xsdfec_remove(struct platform_device *pdev)
 	struct xsdfec_dev *xsdfec;
 
 	xsdfec = platform_get_drvdata(pdev);
+
+	mutex_lock(&xsdfec_list_mutex);
+	list_del(&xsdfec->node);
+	xsdfec_agg_detach(xsdfec);
+	mutex_unlock(&xsdfec_list_mutex);
+
 	misc_deregister(&xsdfec->miscdev);
 	ida_free(&dev_nrs, xsdfec->dev_id);
 	xsdfec_disable_all_clks(&xsdfec->clks);
@@ -1448,7 +3089,30 @@ static struct platform_driver xsdfec_driver = {
 	.remove =  xsdfec_remove,
 };
 
-module_platform_driver(xsdfec_driver);
+static int __init xsdfec_init(void)
+{
+	int err;
+
+	err = platform_driver_register(&xsdfec_driver);
+	if (err)
+		return err;
+
+	err = misc_register(&xsdfec_agg_miscdev);
+	if (err) {
+		platform_driver_unregister(&xsdfec_driver);
+		return err;
+	}
+
+	return 0;
+}
+module_init(xsdfec_init);
+
+static void __exit xsdfec_exit(void)
+{
+	misc_deregister(&xsdfec_agg_miscdev);
+	platform_driver_unregister(&xsdfec_driver);
+}
+module_exit(xsdfec_exit);
 
 MODULE_AUTHOR("Xilinx, Inc");
 MODULE_DESCRIPTION("Xilinx SD-FEC16 Driver");
@@ -23,11 +23,22 @@
 #include <linux/nospec.h>
 #include <linux/slab.h>
 #include <linux/iommu.h>
+#include <linux/eventfd.h>
+#include <linux/poll.h>
+#include <linux/workqueue.h>
+#include <linux/capability.h>
+#include <linux/math64.h>
+#include <linux/interval_tree_generic.h>
+#include <linux/dma-buf.h>
+#include <linux/kref.h>
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
 #endif
 #include "xlnx_dpu.h"
 
+#define CREATE_TRACE_POINTS
+#include "xlnx_dpu_trace.h"
+
 #define DEVICE_NAME "dpu"
 #define DRV_NAME "xlnx-dpu"
 #define DRIVER_DESC "Xilinx Deep Learning Processing Unit driver"
@@ -53,16 +64,53 @@ static bool force_contig;
 module_param(force_contig, bool, 0444);
 MODULE_PARM_DESC(force_contig, "buffer is forced to be contiguous, default 0");
 
+/* outstanding asynchronous jobs per client, queued, running or unreaped */
+#define XDPU_MAX_JOBS		(64)
+
+/* log2 buckets of the job latency histogram, in us, the last one open */
+#define XDPU_LAT_BUCKETS	(24)
+
+struct dpu_job;
+struct xdpu_dev;
+
 /**
  * struct cu - Computer Unit (cu) structure
  * @mutex: protects from simultaneous access
  * @done: completion of cu
  * @irq: indicates cu IRQ number
+ * @xdpu: back pointer to the dpu device
+ * @job: asynchronous job running on the cu, NULL if none
+ * @reserved: the cu is claimed by a synchronous DPUIOC_RUN
+ * @deadline: jiffies after which @job is considered timed out
+ * @work: timeout, or completion polling in force_poll mode, of @job
+ * @cycles: total DPU cycles run on the cu
+ * @nr_jobs: number of jobs run on the cu
+ * @nr_timeouts: number of jobs which timed out on the cu
+ * @pend: total misc instructions completed
+ * @cend: total conv instructions completed
+ * @send: total save instructions completed
+ * @lend: total load instructions completed
+ * @busy_us: total time the cu spent running jobs
+ * @lat_hist: job latency histogram, bucket n counts [2^(n-1), 2^n) us
  */
 struct cu {
 	struct mutex	mutex; /* protects from simultaneous accesses */
 	struct completion	done;
 	int	irq;
+	struct xdpu_dev	*xdpu;
+	struct dpu_job	*job;
+	bool	reserved;
+	unsigned long	deadline;
+	struct delayed_work	work;
+	u64	cycles;
+	u64	nr_jobs;
+	u64	nr_timeouts;
+	u64	pend;
+	u64	cend;
+	u64	send;
+	u64	lend;
+	u64	busy_us;
+	u64	lat_hist[XDPU_LAT_BUCKETS];
 };
 
 /**
@@ -74,9 +122,13 @@ struct cu {
  * @dpu_clk: DPU clock used for DPUCZDX8G general logic
  * @dsp_clk: DSP clock used for DSP blocks
  * @miscdev: misc device handle
- * @mutex: protect client
+ * @mutex: protect client_list
  * @root: debugfs dentry
  * @client_list: indicates how many dpu clients link to xdpu
+ * @job_lock: protects the job queues and the cu job state
+ * @sched_list: clients with queued jobs
+ * @min_vruntime: lower bound of the virtual runtime of queued clients
+ * @cu_wq: wait queue for a synchronous DPUIOC_RUN waiting for its cu
  * @dpu_cnt: indicates how many dpu core/cu enabled in IP, up to 4
  * @sfm_cnt: indicates softmax core enabled or not
  */
@@ -88,11 +140,15 @@ struct xdpu_dev {
 	struct clk	*dpu_clk;
 	struct clk	*dsp_clk;
 	struct miscdevice	miscdev;
-	struct mutex	mutex; /* guards client */
+	struct mutex	mutex; /* guards client_list */
 #ifdef CONFIG_DEBUG_FS
 	struct dentry	*root;
 	struct list_head	client_list;
 #endif
+	spinlock_t	job_lock; /* guards job queues and cu->job */
+	struct list_head	sched_list;
+	u64	min_vruntime;
+	wait_queue_head_t	cu_wq;
 	u8	dpu_cnt;
 	u8	sfm_cnt;
 };
@@ -100,33 +156,136 @@ struct xdpu_dev {
 /**
  * struct xdpu_client - DPU client
  * @dev: pointer to dpu device struct
- * @head: indicates dma memory pool list head
+ * @lock: protects @bos
+ * @bos: dma memory pool, indexed by dma address range
  * @node: client node
+ * @pending: jobs waiting for a free cu
+ * @done: completed jobs waiting for DPUIOC_REAP
+ * @sched: node in xdpu_dev sched_list while @pending is not empty
+ * @wq: wait queue signalled on job completion
+ * @efd: eventfd signalled on job completion, NULL for none
+ * @jobs: number of outstanding jobs
+ * @running: number of jobs running on a cu
+ * @seq: sequence number of the last submitted job
+ * @pid: thread group id of the process which opened the device
+ * @weight: scheduling weight, DPU_WEIGHT_MIN to DPU_WEIGHT_MAX
+ * @vruntime: DPU cycles consumed, scaled by the inverse of @weight
+ * @est_cycles: cycles of the last job, charged when a job is started
+ * @cycles: total DPU cycles consumed
+ * @nr_jobs: number of jobs run
  */
 struct xdpu_client {
 	struct xdpu_dev	*dev;
-	struct list_head	head;
+	struct mutex	lock; /* guards bos */
+	struct rb_root_cached	bos;
 	struct list_head	node;
+	struct list_head	pending;
+	struct list_head	done;
+	struct list_head	sched;
+	wait_queue_head_t	wq;
+	struct eventfd_ctx	*efd;
+	u32	jobs;
+	u32	running;
+	u64	seq;
+	pid_t	pid;
+	u32	weight;
+	u64	vruntime;
+	u64	est_cycles;
+	u64	cycles;
+	u64	nr_jobs;
+};
+
+/**
+ * struct dpu_job - asynchronous DPU job
+ * @node: node in the client pending or done list
+ * @client: submitting client
+ * @charge: virtual runtime charged to @client when the job was started
+ * @queued: submission time
+ * @req: job parameters and result
+ */
+struct dpu_job {
+	struct list_head	node;
+	struct xdpu_client	*client;
+	u64	charge;
+	ktime_t	queued;
+	struct ioc_job_t	req;
 };
 
 /**
  * struct dpu_buffer_block - DPU buffer block
- * @head: list head
+ * @rb: node in the client interval tree
+ * @subtree_last: last dma address in the subtree of @rb
  * @cpu_addr: cpu virtual address of the blocks memory
  * @dma_addr: dma address of the blocks memory
  * @phy_addr: physical address of the blocks memory
  * @size: total size of the block in bytes
  * @attrs: dma buffer attributes
+ * @ref: reference count, held by the client and by exported dma-bufs
+ * @dev: dpu device the memory is allocated from or mapped to
+ * @import: imported dma-buf, NULL for memory allocated by the driver
+ * @attach: dma-buf attachment of @import
+ * @sgt: dpu mapping of @import
  */
 struct dpu_buffer_block {
-	struct list_head	head;
+	struct rb_node	rb;
+	u64	subtree_last;
 	void	*cpu_addr;
 	dma_addr_t	dma_addr;
 	phys_addr_t	phy_addr;
 	size_t	size;
 	unsigned long	attrs;
+	struct kref	ref;
+	struct device	*dev;
+	struct dma_buf	*import;
+	struct dma_buf_attachment	*attach;
+	struct sg_table	*sgt;
 };
 
+#define BO_START(b)	((u64)(b)->dma_addr)
+#define BO_LAST(b)	((u64)(b)->dma_addr + (b)->size - 1)
+
+INTERVAL_TREE_DEFINE(struct dpu_buffer_block, rb, u64, subtree_last,
+		     BO_START, BO_LAST, static, dpu_bo_tree);
+
+/**
+ * dpu_bo_lookup - find the buffer block containing a dma address
+ * @client:	dpu client
+ * @dma_addr:	dma address
+ *
+ * Must be called with the client lock held.
+ *
+ * Return:	the buffer block, NULL if none contains @dma_addr
+ */
+static inline struct dpu_buffer_block *
+dpu_bo_lookup(struct xdpu_client *client, dma_addr_t dma_addr)
+{
+	lockdep_assert_held(&client->lock);
+
+	return dpu_bo_tree_iter_first(&client->bos, dma_addr, dma_addr);
+}
+
+static void dpu_bo_release(struct kref *ref)
+{
+	struct dpu_buffer_block *h = container_of(ref, struct dpu_buffer_block,
+						  ref);
+
+	if (h->import) {
+		dma_buf_unmap_attachment_unlocked(h->attach, h->sgt,
+						  DMA_BIDIRECTIONAL);
+		dma_buf_detach(h->import, h->attach);
+		dma_buf_put(h->import);
+	} else {
+		dma_free_attrs(h->dev, h->size, h->cpu_addr, h->dma_addr,
+			       h->attrs);
+	}
+	kfree(h);
+}
+
+static inline void dpu_bo_put(struct dpu_buffer_block *h)
+{
+	kref_put(&h->ref, dpu_bo_release);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int dpu_debugfs_init(struct xdpu_dev *xdpu);
 #endif
@@ -319,18 +478,14 @@ static int xlnx_dpu_softmax(struct xdpu_dev *xdpu, struct ioc_softmax_t *p)
 }
 
 /**
- * xlnx_dpu_run - run dpu
+ * xlnx_dpu_cu_start - program the addresses and start a cu
  * @xdpu:	dpu structure
  * @p:	dpu run struct, contains the necessary address info
- * @id:	indicates which cu is running
- *
- * Return:	0 if successful; otherwise -errno
+ * @id:	indicates which cu is started
  */
-static inline int xlnx_dpu_run(struct xdpu_dev *xdpu,
-			       struct ioc_kernel_run_t *p, int id)
+static void xlnx_dpu_cu_start(struct xdpu_dev *xdpu,
+			      struct ioc_kernel_run_t *p, int id)
 {
-	int val, ret;
-
 	iowrite32(p->addr_code >> DPU_INSTR_OFFSET,
 		  xdpu->regs + DPU_INSADDR(id));
 
@@ -358,6 +513,44 @@ static inline int xlnx_dpu_run(struct xdpu_dev *xdpu,
 	iowrite32(1, xdpu->regs + DPU_IPSTART(id));
 
 	p->time_start = ktime_get();
+}
+
+/**
+ * xlnx_dpu_cu_result - read back the counters of a finished cu
+ * @xdpu:	dpu structure
+ * @p:	dpu run struct the counters are stored in
+ * @id:	indicates which cu has finished
+ */
+static void xlnx_dpu_cu_result(struct xdpu_dev *xdpu,
+			       struct ioc_kernel_run_t *p, int id)
+{
+	p->time_end = ktime_get();
+	p->core_id = id;
+	p->pend_cnt = ioread32(xdpu->regs + DPU_P_END_C(id));
+	p->cend_cnt = ioread32(xdpu->regs + DPU_C_END_C(id));
+	p->send_cnt = ioread32(xdpu->regs + DPU_S_END_C(id));
+	p->lend_cnt = ioread32(xdpu->regs + DPU_L_END_C(id));
+	p->pstart_cnt = ioread32(xdpu->regs + DPU_P_STA_C(id));
+	p->cstart_cnt = ioread32(xdpu->regs + DPU_C_STA_C(id));
+	p->sstart_cnt = ioread32(xdpu->regs + DPU_S_STA_C(id));
+	p->lstart_cnt = ioread32(xdpu->regs + DPU_L_STA_C(id));
+	p->counter = lo_hi_readq(xdpu->regs + DPU_CYCLE_L(id));
+}
+
+/**
+ * xlnx_dpu_run - run dpu
+ * @xdpu:	dpu structure
+ * @p:	dpu run struct, contains the necessary address info
+ * @id:	indicates which cu is running
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static inline int xlnx_dpu_run(struct xdpu_dev *xdpu,
+			       struct ioc_kernel_run_t *p, int id)
+{
+	int val, ret;
+
+	xlnx_dpu_cu_start(xdpu, p, id);
 
 	if (!force_poll) {
 		if (!wait_for_completion_timeout(&xdpu->cu[id].done,
@@ -376,17 +569,7 @@ static inline int xlnx_dpu_run(struct xdpu_dev *xdpu,
 		xlnx_dpu_int_clear(xdpu, id);
 	}
 
-	p->time_end = ktime_get();
-	p->core_id = id;
-	p->pend_cnt = ioread32(xdpu->regs + DPU_P_END_C(id));
-	p->cend_cnt = ioread32(xdpu->regs + DPU_C_END_C(id));
-	p->send_cnt = ioread32(xdpu->regs + DPU_S_END_C(id));
-	p->lend_cnt = ioread32(xdpu->regs + DPU_L_END_C(id));
-	p->pstart_cnt = ioread32(xdpu->regs + DPU_P_STA_C(id));
-	p->cstart_cnt = ioread32(xdpu->regs + DPU_C_STA_C(id));
-	p->sstart_cnt = ioread32(xdpu->regs + DPU_S_STA_C(id));
-	p->lstart_cnt = ioread32(xdpu->regs + DPU_L_STA_C(id));
-	p->counter = lo_hi_readq(xdpu->regs + DPU_CYCLE_L(id));
+	xlnx_dpu_cu_result(xdpu, p, id);
 
 	dev_dbg(xdpu->dev,
 		"%s: PID=%d DPU=%d CPU=%d TIME=%lldus complete!\n",
@@ -402,6 +585,540 @@ static inline int xlnx_dpu_run(struct xdpu_dev *xdpu,
 	return -ETIMEDOUT;
 }
 
+/**
+ * xlnx_dpu_vtime - scale DPU cycles to the virtual runtime of a client
+ * @client:	dpu client
+ * @cycles:	DPU cycles
+ *
+ * Return:	@cycles weighted by the inverse of the client weight
+ */
+static inline u64 xlnx_dpu_vtime(struct xdpu_client *client, u64 cycles)
+{
+	return div_u64(cycles * DPU_WEIGHT_DEFAULT, client->weight);
+}
+
+/**
+ * xlnx_dpu_account - account the cycles of a finished job
+ * @xdpu:	dpu structure
+ * @client:	dpu client which ran the job
+ * @id:	indicates which cu ran the job
+ * @cycles:	DPU cycles of the job, from DPU_CYCLE_L
+ * @charge:	virtual runtime already charged when the job was started
+ *
+ * Must be called with job_lock held.
+ */
+static void xlnx_dpu_account(struct xdpu_dev *xdpu,
+			     struct xdpu_client *client, int id, u64 cycles,
+			     u64 charge)
+{
+	lockdep_assert_held(&xdpu->job_lock);
+
+	/* replace the estimate charged at dispatch with the actual cost */
+	client->vruntime += xlnx_dpu_vtime(client, cycles) - charge;
+	client->est_cycles = cycles;
+	client->cycles += cycles;
+	client->nr_jobs++;
+
+	xdpu->cu[id].cycles += cycles;
+	xdpu->cu[id].nr_jobs++;
+}
+
+/**
+ * xlnx_dpu_profile - aggregate the counters of a finished job
+ * @xdpu:	dpu structure
+ * @client:	dpu client which ran the job
+ * @id:	indicates which cu ran the job
+ * @seq:	job sequence number, 0 for a synchronous run
+ * @p:	dpu run struct of the job
+ * @wait_us:	time the job spent queued
+ * @status:	0 if the job completed; otherwise -errno
+ *
+ * Must be called with job_lock held.
+ */
+static void xlnx_dpu_profile(struct xdpu_dev *xdpu,
+			     struct xdpu_client *client, int id, u64 seq,
+			     struct ioc_kernel_run_t *p, s64 wait_us,
+			     int status)
+{
+	struct cu *cu = &xdpu->cu[id];
+	s64 run_us = max_t(s64, ktime_us_delta(p->time_end, p->time_start), 0);
+
+	lockdep_assert_held(&xdpu->job_lock);
+
+	trace_xlnx_dpu_job(xdpu->dev, id, client->pid, seq, p, wait_us,
+			   status);
+
+	if (status) {
+		cu->nr_timeouts++;
+		return;
+	}
+
+	cu->pend += p->pend_cnt;
+	cu->cend += p->cend_cnt;
+	cu->send += p->send_cnt;
+	cu->lend += p->lend_cnt;
+	cu->busy_us += run_us;
+	cu->lat_hist[min_t(int, fls64(run_us), XDPU_LAT_BUCKETS - 1)]++;
+}
+
+/**
+ * xlnx_dpu_cu_idle - find the least loaded idle cu
+ * @xdpu:	dpu structure
+ *
+ * Return:	the idle cu with the fewest cycles run, NULL if all are busy
+ */
+static struct cu *xlnx_dpu_cu_idle(struct xdpu_dev *xdpu)
+{
+	struct cu *cu, *best = NULL;
+	int i;
+
+	for (i = 0; i < xdpu->dpu_cnt; i++) {
+		cu = &xdpu->cu[i];
+		if (cu->job || cu->reserved)
+			continue;
+		if (!best || cu->cycles < best->cycles)
+			best = cu;
+	}
+
+	return best;
+}
+
+/**
+ * xlnx_dpu_client_next - pick the client to run next
+ * @xdpu:	dpu structure
+ *
+ * Return:	the queued client with the smallest virtual runtime
+ */
+static struct xdpu_client *xlnx_dpu_client_next(struct xdpu_dev *xdpu)
+{
+	struct xdpu_client *client, *best = NULL;
+
+	list_for_each_entry(client, &xdpu->sched_list, sched)
+		if (!best || client->vruntime < best->vruntime)
+			best = client;
+
+	return best;
+}
+
+/**
+ * xlnx_dpu_job_dispatch - start queued jobs on every idle cu
+ * @xdpu:	dpu structure
+ *
+ * Jobs go to the least loaded idle cu. The client with the smallest
+ * weighted DPU time is served first, so clients share the cores in
+ * proportion to their weight. Jobs are not preempted, the scheduling
+ * decision is taken at every job boundary. Must be called with job_lock
+ * held.
+ */
+static void xlnx_dpu_job_dispatch(struct xdpu_dev *xdpu)
+{
+	struct xdpu_client *client;
+	struct dpu_job *job;
+	struct cu *cu;
+	int i;
+
+	lockdep_assert_held(&xdpu->job_lock);
+
+	while (!list_empty(&xdpu->sched_list)) {
+		cu = xlnx_dpu_cu_idle(xdpu);
+		if (!cu)
+			break;
+		i = cu - xdpu->cu;
+
+		client = xlnx_dpu_client_next(xdpu);
+		job = list_first_entry(&client->pending, struct dpu_job, node);
+		list_del(&job->node);
+		if (list_empty(&client->pending))
+			list_del_init(&client->sched);
+
+		xdpu->min_vruntime = max(xdpu->min_vruntime, client->vruntime);
+		job->charge = xlnx_dpu_vtime(client, client->est_cycles);
+		client->vruntime += job->charge;
+
+		client->running++;
+		cu->job = job;
+		cu->deadline = jiffies + TIMEOUT;
+		xlnx_dpu_cu_start(xdpu, &job->req.run, i);
+		mod_delayed_work(system_wq, &cu->work,
+				 force_poll ? usecs_to_jiffies(POLL_PERIOD_US) :
+				 TIMEOUT);
+	}
+}
+
+/**
+ * xlnx_dpu_job_done - retire the asynchronous job of a cu
+ * @xdpu:	dpu structure
+ * @id:	indicates which cu has finished
+ * @status:	0 if the job completed; otherwise -errno
+ *
+ * Must be called with job_lock held.
+ */
+static void xlnx_dpu_job_done(struct xdpu_dev *xdpu, int id, int status)
+{
+	struct dpu_job *job = xdpu->cu[id].job;
+	struct xdpu_client *client = job->client;
+
+	lockdep_assert_held(&xdpu->job_lock);
+
+	xdpu->cu[id].job = NULL;
+
+	if (!status) {
+		xlnx_dpu_cu_result(xdpu, &job->req.run, id);
+	} else {
+		job->req.run.time_end = ktime_get();
+		job->req.run.core_id = id;
+		job->req.run.counter = lo_hi_readq(xdpu->regs +
+						   DPU_CYCLE_L(id));
+	}
+	job->req.status = status;
+	xlnx_dpu_account(xdpu, client, id, job->req.run.counter, job->charge);
+	xlnx_dpu_profile(xdpu, client, id, job->req.seq, &job->req.run,
+			 ktime_us_delta(job->req.run.time_start, job->queued),
+			 status);
+
+	client->running--;
+	list_add_tail(&job->node, &client->done);
+	wake_up_all(&client->wq);
+	if (client->efd)
+		eventfd_signal(client->efd, 1);
+
+	wake_up(&xdpu->cu_wq);
+}
+
+/**
+ * xlnx_dpu_cu_work - timeout and polling handler of an asynchronous job
+ * @work:	delayed work of the cu
+ */
+static void xlnx_dpu_cu_work(struct work_struct *work)
+{
+	struct cu *cu = container_of(to_delayed_work(work), struct cu, work);
+	struct xdpu_dev *xdpu = cu->xdpu;
+	int id = cu - xdpu->cu;
+	unsigned long flags;
+	int status = 0;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	if (!cu->job)
+		goto out;
+
+	if (force_poll && (ioread32(xdpu->regs + DPU_INT_RAW) & BIT(id))) {
+		xlnx_dpu_int_clear(xdpu, id);
+	} else if (time_before(jiffies, cu->deadline)) {
+		mod_delayed_work(system_wq, &cu->work,
+				 force_poll ? usecs_to_jiffies(POLL_PERIOD_US) :
+				 cu->deadline - jiffies);
+		goto out;
+	} else {
+		status = -ETIMEDOUT;
+		xlnx_dpu_int_clear(xdpu, id);
+	}
+
+	xlnx_dpu_job_done(xdpu, id, status);
+	xlnx_dpu_job_dispatch(xdpu);
+out:
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	if (status) {
+		dev_warn(xdpu->dev, "cu[%d] job timeout", id);
+		xlnx_dpu_dump_regs(xdpu);
+	}
+}
+
+/**
+ * xlnx_dpu_cu_reserve - claim a cu for a synchronous run
+ * @xdpu:	dpu structure
+ * @id:	indicates which cu is claimed
+ *
+ * Keeps the dispatcher off the cu and waits for its asynchronous job, if
+ * any, to retire. Must be called with the cu mutex held.
+ */
+static void xlnx_dpu_cu_reserve(struct xdpu_dev *xdpu, int id)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	xdpu->cu[id].reserved = true;
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	wait_event(xdpu->cu_wq, !READ_ONCE(xdpu->cu[id].job));
+}
+
+/**
+ * xlnx_dpu_cu_unreserve - hand a cu back to the dispatcher
+ * @xdpu:	dpu structure
+ * @client:	dpu client which ran the synchronous job
+ * @id:	indicates which cu is released
+ * @p:	dpu run struct of the synchronous job, NULL if it failed
+ */
+static void xlnx_dpu_cu_unreserve(struct xdpu_dev *xdpu,
+				  struct xdpu_client *client, int id,
+				  struct ioc_kernel_run_t *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	xdpu->cu[id].reserved = false;
+	if (p) {
+		xlnx_dpu_account(xdpu, client, id, p->counter, 0);
+		xlnx_dpu_profile(xdpu, client, id, 0, p, 0, 0);
+	}
+	xlnx_dpu_job_dispatch(xdpu);
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+}
+
+/**
+ * xlnx_dpu_cu_pick - pick the cu of a DPU_CORE_ANY synchronous run
+ * @xdpu:	dpu structure
+ *
+ * Return:	the least loaded cu, preferring idle ones; -ENODEV if none
+ */
+static int xlnx_dpu_cu_pick(struct xdpu_dev *xdpu)
+{
+	struct cu *cu, *best = NULL;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	best = xlnx_dpu_cu_idle(xdpu);
+	for (i = 0; !best && i < xdpu->dpu_cnt; i++) {
+		cu = &xdpu->cu[i];
+		if (!best || cu->cycles < best->cycles)
+			best = cu;
+	}
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	return best ? best - xdpu->cu : -ENODEV;
+}
+
+/**
+ * xlnx_dpu_set_weight - set the scheduling weight of a client
+ * @client:	dpu client
+ * @req:	new weight, DPU_WEIGHT_MIN to DPU_WEIGHT_MAX
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static long xlnx_dpu_set_weight(struct xdpu_client *client, u32 __user *req)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	unsigned long flags;
+	u32 weight;
+
+	if (get_user(weight, req))
+		return -EFAULT;
+
+	if (weight < DPU_WEIGHT_MIN || weight > DPU_WEIGHT_MAX)
+		return -EINVAL;
+
+	if (weight > DPU_WEIGHT_DEFAULT && !capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	client->weight = weight;
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	return 0;
+}
+
+/**
+ * xlnx_dpu_get_stats - report the DPU usage of a client
+ * @client:	dpu client
+ * @req:	ioc_client_stats_t struct the statistics are copied to
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static long xlnx_dpu_get_stats(struct xdpu_client *client,
+			       struct ioc_client_stats_t __user *req)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	struct ioc_client_stats_t t = { };
+	unsigned long flags;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	t.cycles = client->cycles;
+	t.jobs = client->nr_jobs;
+	t.weight = client->weight;
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	if (copy_to_user(req, &t, sizeof(t)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * xlnx_dpu_submit - queue an asynchronous job
+ * @client:	dpu client
+ * @req:	ioc_job_t struct, contains the job info
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static long xlnx_dpu_submit(struct xdpu_client *client,
+			    struct ioc_job_t __user *req)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	struct dpu_job *job;
+	unsigned long flags;
+	u64 seq;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	if (copy_from_user(&job->req, req, sizeof(job->req))) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	job->client = client;
+	job->req.status = 0;
+	job->queued = ktime_get();
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	if (client->jobs >= XDPU_MAX_JOBS) {
+		spin_unlock_irqrestore(&xdpu->job_lock, flags);
+		kfree(job);
+		return -EBUSY;
+	}
+
+	client->jobs++;
+	seq = ++client->seq;
+	job->req.seq = seq;
+	list_add_tail(&job->node, &client->pending);
+	if (list_empty(&client->sched)) {
+		/* an idle client does not bank DPU time */
+		client->vruntime = max(client->vruntime, xdpu->min_vruntime);
+		list_add_tail(&client->sched, &xdpu->sched_list);
+	}
+	xlnx_dpu_job_dispatch(xdpu);
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	dev_dbg(xdpu->dev, "%s: PID=%d SEQ=%llu queued",
+		__func__, current->pid, seq);
+
+	return put_user(seq, &req->seq);
+}
+
+/**
+ * xlnx_dpu_reap - retrieve the result of a completed asynchronous job
+ * @client:	dpu client
+ * @file:	file handle of the DPU device
+ * @req:	ioc_job_t struct the result is copied to
+ *
+ * Blocks until a job completes unless the file is non-blocking.
+ *
+ * Return:	0 if successful; -EAGAIN if no job has completed in
+ *		non-blocking mode; -ENOENT if there is no outstanding job;
+ *		otherwise -errno
+ */
+static long xlnx_dpu_reap(struct xdpu_client *client, struct file *file,
+			  struct ioc_job_t __user *req)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	struct dpu_job *job;
+	unsigned long flags;
+	long ret;
+
+	for (;;) {
+		spin_lock_irqsave(&xdpu->job_lock, flags);
+		job = list_first_entry_or_null(&client->done, struct dpu_job,
+					       node);
+		if (job) {
+			list_del(&job->node);
+			client->jobs--;
+		}
+		spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+		if (job)
+			break;
+
+		if (!READ_ONCE(client->jobs))
+			return -ENOENT;
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(client->wq,
+					       !list_empty(&client->done));
+		if (ret)
+			return ret;
+	}
+
+	ret = copy_to_user(req, &job->req, sizeof(job->req)) ? -EFAULT : 0;
+	kfree(job);
+
+	return ret;
+}
+
+/**
+ * xlnx_dpu_set_eventfd - set the eventfd signalled on job completion
+ * @client:	dpu client
+ * @req:	eventfd file descriptor, negative to clear
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static long xlnx_dpu_set_eventfd(struct xdpu_client *client,
+				 int __user *req)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	struct eventfd_ctx *efd = NULL, *old;
+	unsigned long flags;
+	int fd;
+
+	if (get_user(fd, req))
+		return -EFAULT;
+
+	if (fd >= 0) {
+		efd = eventfd_ctx_fdget(fd);
+		if (IS_ERR(efd))
+			return PTR_ERR(efd);
+	}
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	old = client->efd;
+	client->efd = efd;
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+
+	return 0;
+}
+
+/**
+ * xlnx_dpu_job_flush - drop the jobs of a closing client
+ * @client:	dpu client
+ *
+ * Queued jobs are discarded, running jobs are waited for, they retire on
+ * completion or timeout.
+ */
+static void xlnx_dpu_job_flush(struct xdpu_client *client)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	struct dpu_job *job, *n;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	list_del_init(&client->sched);
+	list_splice_init(&client->pending, &list);
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	wait_event(client->wq, !READ_ONCE(client->running));
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	list_splice_init(&client->done, &list);
+	client->jobs = 0;
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	list_for_each_entry_safe(job, n, &list, node) {
+		list_del(&job->node);
+		kfree(job);
+	}
+
+	if (client->efd)
+		eventfd_ctx_put(client->efd);
+}
+
 static inline phys_addr_t get_pa(void *addr)
 {
 	if (likely(is_vmalloc_addr(addr)))
@@ -428,10 +1145,13 @@ static long xlnx_dpu_alloc_bo(struct xdpu_client *client,
 	if (!pb)
 		return -ENOMEM;
 
+	kref_init(&pb->ref);
+	pb->dev = xdpu->dev;
+
 	if (get_user(size, &req->size))
 		goto err_pb;
 
-	if (size > SIZE_MAX - PAGE_SIZE)
+	if (!size || size > SIZE_MAX - PAGE_SIZE)
 		goto err_pb;
 
 	pb->size = size;
@@ -455,9 +1175,9 @@ static long xlnx_dpu_alloc_bo(struct xdpu_client *client,
 	else
 		pb->phy_addr = get_pa(pb->cpu_addr);
 
-	mutex_lock(&xdpu->mutex);
-	list_add(&pb->head, &client->head);
-	mutex_unlock(&xdpu->mutex);
+	mutex_lock(&client->lock);
+	dpu_bo_tree_insert(pb, &client->bos);
+	mutex_unlock(&client->lock);
 
 	return 0;
 err_out:
@@ -479,22 +1199,18 @@ static long xlnx_dpu_free_bo(struct xdpu_client *client,
 			     struct dpcma_req_free __user *req)
 {
 	dma_addr_t dma_addr = 0;
-	struct xdpu_dev *xdpu = client->dev;
-	struct dpu_buffer_block *h, *n;
+	struct dpu_buffer_block *h;
 
 	if (get_user(dma_addr, &req->dma_addr))
 		return -EFAULT;
 
-	mutex_lock(&xdpu->mutex);
-	list_for_each_entry_safe(h, n, &client->head, head) {
-		if (in_range(dma_addr, h->dma_addr, h->size)) {
-			dma_free_attrs(xdpu->dev, h->size, h->cpu_addr,
-				       h->dma_addr, h->attrs);
-			list_del(&h->head);
-			kfree(h);
-		}
+	mutex_lock(&client->lock);
+	h = dpu_bo_lookup(client, dma_addr);
+	if (h) {
+		dpu_bo_tree_remove(h, &client->bos);
+		dpu_bo_put(h);
 	}
-	mutex_unlock(&xdpu->mutex);
+	mutex_unlock(&client->lock);
 
 	return 0;
 }
@@ -512,7 +1228,7 @@ static inline long xlnx_dpu_sync_bo(struct xdpu_client *client,
 	dma_addr_t dma_addr;
 	int dir;
 	size_t size;
-	struct dpu_buffer_block *h = NULL, *n = NULL;
+	struct dpu_buffer_block *h;
 	struct xdpu_dev *xdpu = client->dev;
 
 	if (get_user(dma_addr, &req->dma_addr) ||
@@ -524,25 +1240,268 @@ static inline long xlnx_dpu_sync_bo(struct xdpu_client *client,
 		return -EINVAL;
 	}
 
-	mutex_lock(&xdpu->mutex);
-	list_for_each_entry_safe(h, n, &client->head, head) {
-		if (in_range(dma_addr, h->dma_addr, h->size)) {
-			if (dir == DPU_TO_CPU)
-				dma_sync_single_for_cpu(xdpu->dev,
-							h->phy_addr,
-							size,
-							DMA_FROM_DEVICE);
-			else
-				dma_sync_single_for_device(xdpu->dev,
-							   h->phy_addr,
-							   size,
-							   DMA_TO_DEVICE);
-			break;
+	mutex_lock(&client->lock);
+	h = dpu_bo_lookup(client, dma_addr);
+	if (h && h->sgt) {
+		if (dir == DPU_TO_CPU)
+			dma_sync_sgtable_for_cpu(xdpu->dev, h->sgt,
+						 DMA_FROM_DEVICE);
+		else
+			dma_sync_sgtable_for_device(xdpu->dev, h->sgt,
+						    DMA_TO_DEVICE);
+	} else if (h) {
+		if (dir == DPU_TO_CPU)
+			dma_sync_single_for_cpu(xdpu->dev,
+						h->phy_addr,
+						size,
+						DMA_FROM_DEVICE);
+		else
+			dma_sync_single_for_device(xdpu->dev,
+						   h->phy_addr,
+						   size,
+						   DMA_TO_DEVICE);
+	}
+	mutex_unlock(&client->lock);
+
+	return 0;
+}
+
+static int dpu_dmabuf_attach(struct dma_buf *dmabuf,
+			     struct dma_buf_attachment *attach)
+{
+	struct dpu_buffer_block *h = dmabuf->priv;
+	struct sg_table *sgt;
+	int ret;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return -ENOMEM;
+
+	ret = dma_get_sgtable_attrs(h->dev, sgt, h->cpu_addr, h->dma_addr,
+				    h->size, h->attrs);
+	if (ret) {
+		kfree(sgt);
+		return ret;
+	}
+
+	attach->priv = sgt;
+
+	return 0;
+}
+
+static void dpu_dmabuf_detach(struct dma_buf *dmabuf,
+			      struct dma_buf_attachment *attach)
+{
+	struct sg_table *sgt = attach->priv;
+
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static struct sg_table *dpu_dmabuf_map(struct dma_buf_attachment *attach,
+				       enum dma_data_direction dir)
+{
+	struct sg_table *sgt = attach->priv;
+	int ret;
+
+	ret = dma_map_sgtable(attach->dev, sgt, dir, 0);
+	if (ret)
+		return ERR_PTR(ret);
+
+	return sgt;
+}
+
+static void dpu_dmabuf_unmap(struct dma_buf_attachment *attach,
+			     struct sg_table *sgt,
+			     enum dma_data_direction dir)
+{
+	dma_unmap_sgtable(attach->dev, sgt, dir, 0);
+}
+
+static int dpu_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	struct dpu_buffer_block *h = dmabuf->priv;
+
+	return dma_mmap_attrs(h->dev, vma, h->cpu_addr, h->dma_addr, h->size,
+			      h->attrs);
+}
+
+static int dpu_dmabuf_vmap(struct dma_buf *dmabuf, struct iosys_map *map)
+{
+	struct dpu_buffer_block *h = dmabuf->priv;
+
+	iosys_map_set_vaddr(map, h->cpu_addr);
+
+	return 0;
+}
+
+static void dpu_dmabuf_release(struct dma_buf *dmabuf)
+{
+	struct dpu_buffer_block *h = dmabuf->priv;
+	struct device *dev = h->dev;
+
+	dpu_bo_put(h);
+	put_device(dev);
+}
+
+static const struct dma_buf_ops dpu_dmabuf_ops = {
+	.cache_sgt_mapping = true,
+	.attach = dpu_dmabuf_attach,
+	.detach = dpu_dmabuf_detach,
+	.map_dma_buf = dpu_dmabuf_map,
+	.unmap_dma_buf = dpu_dmabuf_unmap,
+	.mmap = dpu_dmabuf_mmap,
+	.vmap = dpu_dmabuf_vmap,
+	.release = dpu_dmabuf_release,
+};
+
+/**
+ * xlnx_dpu_export_bo - export a buffer object as a dma-buf
+ * @client:	dpu client
+ * @req:	dpcma_req_export struct, contains the request info
+ *
+ * The dma-buf holds a reference to the buffer object, which outlives
+ * DPUIOC_FREE_BO and the client until the dma-buf is released.
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static long xlnx_dpu_export_bo(struct xdpu_client *client,
+			       struct dpcma_req_export __user *req)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct dpu_buffer_block *h;
+	struct dma_buf *dmabuf;
+	dma_addr_t dma_addr;
+	int flags, fd;
+
+	if (get_user(dma_addr, &req->dma_addr) || get_user(flags, &req->flags))
+		return -EFAULT;
+
+	if (flags & ~(O_CLOEXEC | O_ACCMODE))
+		return -EINVAL;
+
+	mutex_lock(&client->lock);
+	h = dpu_bo_lookup(client, dma_addr);
+	/* imported buffers are exported by their owner */
+	if (!h || h->import) {
+		mutex_unlock(&client->lock);
+		return -EINVAL;
+	}
+	kref_get(&h->ref);
+	mutex_unlock(&client->lock);
+
+	exp_info.ops = &dpu_dmabuf_ops;
+	exp_info.size = PAGE_ALIGN(h->size);
+	exp_info.flags = O_RDWR;
+	exp_info.priv = h;
+
+	get_device(h->dev);
+	dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(dmabuf)) {
+		put_device(h->dev);
+		dpu_bo_put(h);
+		return PTR_ERR(dmabuf);
+	}
+
+	fd = dma_buf_fd(dmabuf, flags & O_CLOEXEC);
+	if (fd < 0) {
+		dma_buf_put(dmabuf);
+		return fd;
+	}
+
+	return put_user(fd, &req->fd);
+}
+
+/**
+ * xlnx_dpu_import_bo - import a dma-buf as a buffer object
+ * @client:	dpu client
+ * @req:	dpcma_req_import struct, contains the request info
+ *
+ * The dma-buf is mapped to the DPU for its whole lifetime as a buffer
+ * object, it is released by DPUIOC_FREE_BO. The DPU takes a single base
+ * address per tensor, so the mapping must be contiguous.
+ *
+ * Return:	0 if successful; otherwise -errno
+ */
+static long xlnx_dpu_import_bo(struct xdpu_client *client,
+			       struct dpcma_req_import __user *req)
+{
+	struct xdpu_dev *xdpu = client->dev;
+	struct dpu_buffer_block *pb;
+	struct scatterlist *sg;
+	dma_addr_t next;
+	unsigned int i;
+	int fd, ret;
+
+	if (get_user(fd, &req->fd))
+		return -EFAULT;
+
+	pb = kzalloc(sizeof(*pb), GFP_KERNEL);
+	if (!pb)
+		return -ENOMEM;
+
+	kref_init(&pb->ref);
+	pb->dev = xdpu->dev;
+
+	pb->import = dma_buf_get(fd);
+	if (IS_ERR(pb->import)) {
+		ret = PTR_ERR(pb->import);
+		goto err_pb;
+	}
+
+	pb->attach = dma_buf_attach(pb->import, xdpu->dev);
+	if (IS_ERR(pb->attach)) {
+		ret = PTR_ERR(pb->attach);
+		goto err_put;
+	}
+
+	pb->sgt = dma_buf_map_attachment_unlocked(pb->attach,
+						  DMA_BIDIRECTIONAL);
+	if (IS_ERR(pb->sgt)) {
+		ret = PTR_ERR(pb->sgt);
+		goto err_detach;
+	}
+
+	pb->dma_addr = sg_dma_address(pb->sgt->sgl);
+	next = pb->dma_addr;
+	for_each_sgtable_dma_sg(pb->sgt, sg, i) {
+		if (sg_dma_address(sg) != next) {
+			dev_dbg(xdpu->dev, "dma-buf %d is not contiguous\n",
+				fd);
+			ret = -EINVAL;
+			goto err_unmap;
 		}
+		next += sg_dma_len(sg);
+	}
+	pb->size = next - pb->dma_addr;
+
+	if (!pb->size) {
+		ret = -EINVAL;
+		goto err_unmap;
 	}
-	mutex_unlock(&xdpu->mutex);
+
+	if (put_user(pb->dma_addr, &req->dma_addr) ||
+	    put_user(pb->size, &req->capacity)) {
+		ret = -EFAULT;
+		goto err_unmap;
+	}
+
+	mutex_lock(&client->lock);
+	dpu_bo_tree_insert(pb, &client->bos);
+	mutex_unlock(&client->lock);
 
 	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment_unlocked(pb->attach, pb->sgt,
+					  DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(pb->import, pb->attach);
+err_put:
+	dma_buf_put(pb->import);
+err_pb:
+	kfree(pb);
+	return ret;
 }
 
 /**
@@ -583,7 +1542,9 @@ static long xlnx_dpu_ioctl(struct file *file, unsigned int cmd,
 		}
 
 		id = t.core_id;
-		if (id >= xdpu->dpu_cnt)
+		if (id == DPU_CORE_ANY)
+			id = xlnx_dpu_cu_pick(xdpu);
+		if (id < 0 || id >= xdpu->dpu_cnt)
 			return -EINVAL;
 
 		dev_dbg(xdpu->dev,
@@ -594,9 +1555,11 @@ static long xlnx_dpu_ioctl(struct file *file, unsigned int cmd,
 		id = array_index_nospec(id, xdpu->dpu_cnt);
 		/* Allows one process to run the cu by using a mutex */
 		mutex_lock(&xdpu->cu[id].mutex);
+		xlnx_dpu_cu_reserve(xdpu, id);
 
 		ret = xlnx_dpu_run(xdpu, &t, id);
 
+		xlnx_dpu_cu_unreserve(xdpu, client, id, ret ? NULL : &t);
 		mutex_unlock(&xdpu->cu[id].mutex);
 
 		if (copy_to_user(data, &t, sizeof(struct ioc_kernel_run_t)))
@@ -613,6 +1576,24 @@ static long xlnx_dpu_ioctl(struct file *file, unsigned int cmd,
 	case DPUIOC_SYNC_BO:
 		return xlnx_dpu_sync_bo(client,
 					(struct dpcma_req_sync __user *)arg);
+	case DPUIOC_EXPORT_BO:
+		return xlnx_dpu_export_bo(client,
+					  (struct dpcma_req_export __user *)arg);
+	case DPUIOC_IMPORT_BO:
+		return xlnx_dpu_import_bo(client,
+					  (struct dpcma_req_import __user *)arg);
+	case DPUIOC_SUBMIT:
+		return xlnx_dpu_submit(client, (struct ioc_job_t __user *)arg);
+	case DPUIOC_REAP:
+		return xlnx_dpu_reap(client, file,
+				     (struct ioc_job_t __user *)arg);
+	case DPUIOC_SET_EVENTFD:
+		return xlnx_dpu_set_eventfd(client, (int __user *)arg);
+	case DPUIOC_SET_WEIGHT:
+		return xlnx_dpu_set_weight(client, (u32 __user *)arg);
+	case DPUIOC_G_STATS:
+		return xlnx_dpu_get_stats(client,
+					  (struct ioc_client_stats_t __user *)arg);
 	case DPUIOC_G_INFO:
 	{
 		u32 dpu_info = ioread32(xdpu->regs + DPU_IPVER_INFO);
@@ -686,6 +1667,17 @@ static irqreturn_t xlnx_dpu_isr(int irq, void *data)
 			xlnx_dpu_int_clear(xdpu, i);
 			dev_dbg(xdpu->dev, "%s: DPU=%d IRQ=%d",
 				__func__, i, irq);
+
+			spin_lock(&xdpu->job_lock);
+			if (xdpu->cu[i].job) {
+				cancel_delayed_work(&xdpu->cu[i].work);
+				xlnx_dpu_job_done(xdpu, i, 0);
+				xlnx_dpu_job_dispatch(xdpu);
+				spin_unlock(&xdpu->job_lock);
+				continue;
+			}
+			spin_unlock(&xdpu->job_lock);
+
 			complete(&xdpu->cu[i].done);
 		}
 	}
@@ -699,6 +1691,33 @@ static irqreturn_t xlnx_dpu_isr(int irq, void *data)
 	return IRQ_HANDLED;
 }
 
+/**
+ * xlnx_dpu_poll - poll for completed asynchronous jobs
+ * @file:	file structure for the device
+ * @wait:	poll table
+ *
+ * Return:	EPOLLIN if a job can be reaped, EPOLLOUT if a job can be
+ *		submitted
+ */
+static __poll_t xlnx_dpu_poll(struct file *file, poll_table *wait)
+{
+	struct xdpu_client *client = file->private_data;
+	struct xdpu_dev *xdpu = client->dev;
+	unsigned long flags;
+	__poll_t mask = 0;
+
+	poll_wait(file, &client->wq, wait);
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	if (!list_empty(&client->done))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (client->jobs < XDPU_MAX_JOBS)
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	return mask;
+}
+
 /**
  * xlnx_dpu_mmap - maps cma ranges into userspace
  * @file:	file structure for the device
@@ -708,10 +1727,10 @@ static irqreturn_t xlnx_dpu_isr(int irq, void *data)
  */
 static int xlnx_dpu_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	int found = 0;
+	int ret;
 	struct xdpu_client *client = file->private_data;
 	struct xdpu_dev *xdpu = client->dev;
-	struct dpu_buffer_block *h = NULL, *n = NULL;
+	struct dpu_buffer_block *h;
 	size_t size = vma->vm_end - vma->vm_start;
 	dma_addr_t offset = (dma_addr_t)vma->vm_pgoff << PAGE_SHIFT;
 
@@ -724,23 +1743,22 @@ static int xlnx_dpu_mmap(struct file *file, struct vm_area_struct *vma)
 	if (!((vma->vm_pgoff + size) <= __pa(high_memory)))
 		return -EINVAL;
 
-	mutex_lock(&xdpu->mutex);
-	list_for_each_entry_safe(h, n, &client->head, head) {
-		if (in_range(offset, h->dma_addr, h->size)) {
-			found = 1;
-			break;
-		}
-	}
-	mutex_unlock(&xdpu->mutex);
-
-	if (!found)
+	mutex_lock(&client->lock);
+	h = dpu_bo_lookup(client, offset);
+	/* imported buffers are mapped through their dma-buf */
+	if (!h || h->import) {
+		mutex_unlock(&client->lock);
 		return -EINVAL;
+	}
 
 	/* map the whole buffer */
 	vma->vm_pgoff = 0;
 
-	return dma_mmap_attrs(xdpu->dev, vma, h->cpu_addr, h->dma_addr,
-			size, 0);
+	ret = dma_mmap_attrs(xdpu->dev, vma, h->cpu_addr, h->dma_addr,
+			     size, 0);
+	mutex_unlock(&client->lock);
+
+	return ret;
 }
 
 /**
@@ -760,7 +1778,14 @@ static int xlnx_dpu_open(struct inode *inode, struct file *filp)
 
 	xdpu = container_of(filp->private_data, struct xdpu_dev, miscdev);
 	client->dev = xdpu;
-	INIT_LIST_HEAD(&client->head);
+	mutex_init(&client->lock);
+	client->bos = RB_ROOT_CACHED;
+	INIT_LIST_HEAD(&client->pending);
+	INIT_LIST_HEAD(&client->done);
+	INIT_LIST_HEAD(&client->sched);
+	init_waitqueue_head(&client->wq);
+	client->pid = task_tgid_nr(current);
+	client->weight = DPU_WEIGHT_DEFAULT;
 
 	filp->private_data = client;
 
@@ -782,27 +1807,24 @@ static int xlnx_dpu_open(struct inode *inode, struct file *filp)
 static int xlnx_dpu_release(struct inode *inode, struct file *filp)
 {
 	struct xdpu_client *client = filp->private_data;
-	struct xdpu_dev *xdpu = client->dev;
-	struct dpu_buffer_block *h = NULL, *n = NULL;
+	struct dpu_buffer_block *h;
 #ifdef CONFIG_DEBUG_FS
+	struct xdpu_dev *xdpu = client->dev;
 	struct xdpu_client *p = NULL, *t = NULL;
 #endif
 
-	mutex_lock(&xdpu->mutex);
+	xlnx_dpu_job_flush(client);
+
 	/* Drain the remaining buffer entries when abnormal close */
-	if (!list_empty(&client->head)) {
-		list_for_each_entry_safe(h, n, &client->head, head) {
-			dma_free_attrs(xdpu->dev,
-				       h->size,
-				       h->cpu_addr,
-				       h->dma_addr,
-				       h->attrs);
-			list_del(&h->head);
-			kfree(h);
-		};
+	mutex_lock(&client->lock);
+	while ((h = dpu_bo_tree_iter_first(&client->bos, 0, U64_MAX))) {
+		dpu_bo_tree_remove(h, &client->bos);
+		dpu_bo_put(h);
 	}
+	mutex_unlock(&client->lock);
 
 #ifdef CONFIG_DEBUG_FS
+	mutex_lock(&xdpu->mutex);
 	list_for_each_entry_safe(p, t, &xdpu->client_list, node) {
 		if (p == client) {
 			list_del(&p->node);
@@ -810,8 +1832,8 @@ static int xlnx_dpu_release(struct inode *inode, struct file *filp)
 			break;
 		};
 	};
-#endif
 	mutex_unlock(&xdpu->mutex);
+#endif
 
 	return 0;
 }
@@ -820,6 +1842,7 @@ static const struct file_operations dev_fops = {
 	.owner = THIS_MODULE,
 	.open = xlnx_dpu_open,
 	.mmap = xlnx_dpu_mmap,
+	.poll = xlnx_dpu_poll,
 	.unlocked_ioctl = xlnx_dpu_ioctl,
 	.release = xlnx_dpu_release,
 };
@@ -965,6 +1988,14 @@ static int xlnx_dpu_probe(struct platform_device *pdev)
 	dev_dbg(dev, "found %d dpu core @%ldMHz and %d softmax core",
 		xdpu->dpu_cnt, DPU_FREQ(val), xdpu->sfm_cnt);
 
+	spin_lock_init(&xdpu->job_lock);
+	INIT_LIST_HEAD(&xdpu->sched_list);
+	init_waitqueue_head(&xdpu->cu_wq);
+	for (i = 0; i < xdpu->dpu_cnt; i++) {
+		xdpu->cu[i].xdpu = xdpu;
+		INIT_DELAYED_WORK(&xdpu->cu[i].work, xlnx_dpu_cu_work);
+	}
+
 	if (get_irq(pdev, xdpu))
 		goto err_out;
 
@@ -1047,6 +2078,9 @@ static int xlnx_dpu_remove(struct platform_device *pdev)
 	platform_set_drvdata(pdev, NULL);
 	misc_deregister(&xdpu->miscdev);
 
+	for (i = 0; i < xdpu->dpu_cnt; i++)
+		cancel_delayed_work_sync(&xdpu->cu[i].work);
+
 	dev_dbg(xdpu->dev, "%s: device /dev/dpu unregistered\n", __func__);
 	return 0;
 }
@@ -1277,12 +2311,14 @@ static int dump_show(struct seq_file *seq, void *v)
 
 	mutex_lock(&xdpu->mutex);
 	list_for_each_entry(client, &xdpu->client_list, node) {
-		if (!list_empty(&client->head)) {
+		mutex_lock(&client->lock);
+		h = dpu_bo_tree_iter_first(&client->bos, 0, U64_MAX);
+		if (h) {
 			seq_printf(seq, "Client: %px\n", client);
 			seq_puts(seq, "Virtual Address\t\t\t\t");
 			seq_puts(seq, "Request Mem\t\tPhysical Address\t\t\t");
 			seq_puts(seq, "DMA Address\n");
-			list_for_each_entry(h, &client->head, head) {
+			for (; h; h = dpu_bo_tree_iter_next(h, 0, U64_MAX)) {
 				delta = (h->size) >> 10;
 				while (!(delta & 1023) && unit[1]) {
 					delta >>= 10;
@@ -1302,6 +2338,7 @@ static int dump_show(struct seq_file *seq, void *v)
 				unit = units;
 			};
 		};
+		mutex_unlock(&client->lock);
 	};
 	mutex_unlock(&xdpu->mutex);
 
@@ -1309,6 +2346,81 @@ static int dump_show(struct seq_file *seq, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(dump);
 
+static int sched_show(struct seq_file *seq, void *v)
+{
+	struct xdpu_client *client;
+	struct xdpu_dev *xdpu = seq->private;
+	unsigned long flags;
+	int i;
+
+	seq_puts(seq, "CU\tJobs\t\tCycles\n");
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	for (i = 0; i < xdpu->dpu_cnt; i++)
+		seq_printf(seq, "%d\t%llu\t\t%llu\n", i,
+			   xdpu->cu[i].nr_jobs, xdpu->cu[i].cycles);
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	seq_puts(seq, "\nPID\tWeight\tJobs\t\tCycles\t\t\tVruntime\n");
+	mutex_lock(&xdpu->mutex);
+	list_for_each_entry(client, &xdpu->client_list, node) {
+		spin_lock_irqsave(&xdpu->job_lock, flags);
+		seq_printf(seq, "%d\t%u\t%llu\t\t%llu\t\t\t%llu\n",
+			   client->pid, client->weight, client->nr_jobs,
+			   client->cycles, client->vruntime);
+		spin_unlock_irqrestore(&xdpu->job_lock, flags);
+	}
+	mutex_unlock(&xdpu->mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sched);
+
+static int stats_show(struct seq_file *seq, void *v)
+{
+	struct cu *cu = seq->private;
+	struct xdpu_dev *xdpu = cu->xdpu;
+	u64 hist[XDPU_LAT_BUCKETS];
+	u64 jobs, timeouts, cycles, busy, pend, cend, send, lend;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&xdpu->job_lock, flags);
+	jobs = cu->nr_jobs;
+	timeouts = cu->nr_timeouts;
+	cycles = cu->cycles;
+	busy = cu->busy_us;
+	pend = cu->pend;
+	cend = cu->cend;
+	send = cu->send;
+	lend = cu->lend;
+	memcpy(hist, cu->lat_hist, sizeof(hist));
+	spin_unlock_irqrestore(&xdpu->job_lock, flags);
+
+	seq_printf(seq, "%-16s %llu\n", "jobs", jobs);
+	seq_printf(seq, "%-16s %llu\n", "timeouts", timeouts);
+	seq_printf(seq, "%-16s %llu\n", "busy_cycles", cycles);
+	seq_printf(seq, "%-16s %llu\n", "busy_us", busy);
+	seq_printf(seq, "%-16s %llu\n", "misc_instr", pend);
+	seq_printf(seq, "%-16s %llu\n", "conv_instr", cend);
+	seq_printf(seq, "%-16s %llu\n", "save_instr", send);
+	seq_printf(seq, "%-16s %llu\n", "load_instr", lend);
+
+	seq_puts(seq, "\nlatency_us\t\tjobs\n");
+	for (i = 0; i < XDPU_LAT_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == XDPU_LAT_BUCKETS - 1)
+			seq_printf(seq, "[%llu, inf)\t\t%llu\n",
+				   BIT_ULL(i - 1), hist[i]);
+		else
+			seq_printf(seq, "[%llu, %llu)\t\t%llu\n",
+				   i ? BIT_ULL(i - 1) : 0, BIT_ULL(i), hist[i]);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
 /**
  * dpu_debugfs_init - create DPU debugfs directory.
  * @xdpu:	dpu structure
@@ -1332,6 +2444,7 @@ static int dpu_debugfs_init(struct xdpu_dev *xdpu)
 	}
 
 	debugfs_create_file("dma_pool", 0444, xdpu->root, xdpu, &dump_fops);
+	debugfs_create_file("sched", 0444, xdpu->root, xdpu, &sched_fops);
 
 	for (i = 0; i < xdpu->dpu_cnt; i++) {
 		if (snprintf(buf, 32, "cu-%d", i) < 0)
@@ -1346,6 +2459,8 @@ static int dpu_debugfs_init(struct xdpu_dev *xdpu)
 		regset->nregs = ARRAY_SIZE(cu_regs[i]);
 		regset->base = xdpu->regs;
 		debugfs_create_regset32("registers", 0444, dentry, regset);
+		debugfs_create_file("stats", 0444, dentry, &xdpu->cu[i],
+				    &stats_fops);
 	}
 
 	if (xdpu->sfm_cnt) {
@@ -1366,3 +2481,4 @@ static int dpu_debugfs_init(struct xdpu_dev *xdpu)
 MODULE_DESCRIPTION(DRIVER_DESC);
 MODULE_AUTHOR("Ye Yang <ye.yang@xilinx.com>");
 MODULE_LICENSE("GPL");
+MODULE_IMPORT_NS(DMA_BUF);
@@ -18,14 +18,6 @@
 #define TIMEOUT_US		(timeout * 1000000)
 #define POLL_PERIOD_US		(2000)
 
-#define in_range(b, start, len) (		\
-{						\
-typeof(b) b_ = (b);				\
-typeof(start) start_ = (start);			\
-((b_) >= (start_) && (b_) < (start_) + (len));	\
-}						\
-)
-
 /* DPU fingerprint, target info */
 #define DPU_PMU_IP_RST		(0x004)
 #define DPU_IPVER_INFO		(0x1E0)
@@ -121,6 +113,32 @@ struct dpcma_req_sync {
 	int direction;
 };
 
+/**
+ * struct  dpcma_req_export - export a buffer object as a dma-buf
+ * @dma_addr:	dma address within the buffer object
+ * @flags:	O_CLOEXEC and/or O_RDWR for the returned file descriptor
+ * @fd:	returned dma-buf file descriptor
+ */
+struct dpcma_req_export {
+	u64 dma_addr;
+	int flags;
+	int fd;
+};
+
+/**
+ * struct  dpcma_req_import - import a dma-buf as a buffer object
+ * @fd:	dma-buf file descriptor, must be contiguous in DPU address space
+ * @reserved:	reserved, set to 0
+ * @dma_addr:	returned dma address of the buffer object
+ * @capacity:	returned size of the buffer object
+ */
+struct dpcma_req_import {
+	int fd;
+	u32 reserved;
+	u64 dma_addr;
+	size_t capacity;
+};
+
 /**
  * struct  ioc_kernel_run_t - describe structure for each dpu ioctl
  * @addr_code:	the address for DPU code
@@ -187,6 +205,43 @@ struct ioc_softmax_t {
 	u32 offset;
 };
 
+/**
+ * struct  ioc_job_t - describe structure for each asynchronous dpu job
+ * @run:	the dpu run parameters, @run.core_id is ignored on submission
+ *		and reports the cu which executed the job once reaped
+ * @user_data:	opaque value handed back with the result
+ * @seq:	job sequence number, returned by DPUIOC_SUBMIT
+ * @status:	0 if the job completed; otherwise -ETIMEDOUT
+ */
+struct ioc_job_t {
+	struct ioc_kernel_run_t run;
+	u64 user_data;
+	u64 seq;
+	int status;
+};
+
+/**
+ * struct  ioc_client_stats_t - describe structure for client statistics
+ * @cycles:	total DPU cycles consumed by the client
+ * @jobs:	number of jobs run by the client
+ * @weight:	scheduling weight of the client
+ * @reserved:	reserved, set to 0
+ */
+struct ioc_client_stats_t {
+	u64 cycles;
+	u64 jobs;
+	u32 weight;
+	u32 reserved;
+};
+
+/* scheduling weights, raising a weight above the default needs CAP_SYS_NICE */
+#define DPU_WEIGHT_MIN		(1)
+#define DPU_WEIGHT_DEFAULT	(100)
+#define DPU_WEIGHT_MAX		(10000)
+
+/* DPUIOC_RUN core_id letting the driver pick the least loaded core */
+#define DPU_CORE_ANY		(-1)
+
 #define DPU_IOC_MAGIC 'D'
 
 #define DPUIOC_CREATE_BO _IOWR(DPU_IOC_MAGIC, 1, struct dpcma_req_alloc*)
@@ -197,5 +252,12 @@ struct ioc_softmax_t {
 #define DPUIOC_RUN _IOWR(DPU_IOC_MAGIC, 6, struct ioc_kernel_run_t*)
 #define DPUIOC_RUN_SOFTMAX _IOWR(DPU_IOC_MAGIC, 7, struct ioc_softmax_t*)
 #define DPUIOC_REG_READ _IOR(DPU_IOC_MAGIC, 8, u32)
+#define DPUIOC_SUBMIT _IOWR(DPU_IOC_MAGIC, 9, struct ioc_job_t*)
+#define DPUIOC_REAP _IOWR(DPU_IOC_MAGIC, 10, struct ioc_job_t*)
+#define DPUIOC_SET_EVENTFD _IOW(DPU_IOC_MAGIC, 11, int)
+#define DPUIOC_SET_WEIGHT _IOW(DPU_IOC_MAGIC, 12, u32)
+#define DPUIOC_G_STATS _IOR(DPU_IOC_MAGIC, 13, struct ioc_client_stats_t*)
+#define DPUIOC_EXPORT_BO _IOWR(DPU_IOC_MAGIC, 14, struct dpcma_req_export*)
+#define DPUIOC_IMPORT_BO _IOWR(DPU_IOC_MAGIC, 15, struct dpcma_req_import*)
 
 #endif /* _DPU_UAPI_H_ */
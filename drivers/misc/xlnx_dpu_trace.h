@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#if !defined(_XLNX_DPU_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _XLNX_DPU_TRACE_H_
+
+#include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/tracepoint.h>
+
+#include "xlnx_dpu.h"
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM xlnx_dpu
+
+/*
+ * A DPU job has finished on a cu. The instruction counts are the misc, conv,
+ * save and load end counters sampled at completion, @wait_us is the time
+ * spent queued, 0 for synchronous DPUIOC_RUN jobs.
+ */
+TRACE_EVENT(xlnx_dpu_job,
+	TP_PROTO(struct device *dev, int cu, pid_t pid, u64 seq,
+		 const struct ioc_kernel_run_t *p, s64 wait_us, int status),
+	TP_ARGS(dev, cu, pid, seq, p, wait_us, status),
+	TP_STRUCT__entry(
+		__string(dev,		dev_name(dev))
+		__field(int,		cu)
+		__field(pid_t,		pid)
+		__field(u64,		seq)
+		__field(u64,		cycles)
+		__field(u32,		pend)
+		__field(u32,		cend)
+		__field(u32,		send)
+		__field(u32,		lend)
+		__field(s64,		run_us)
+		__field(s64,		wait_us)
+		__field(int,		status)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__entry->cu = cu;
+		__entry->pid = pid;
+		__entry->seq = seq;
+		__entry->cycles = p->counter;
+		__entry->pend = p->pend_cnt;
+		__entry->cend = p->cend_cnt;
+		__entry->send = p->send_cnt;
+		__entry->lend = p->lend_cnt;
+		__entry->run_us = ktime_us_delta(p->time_end, p->time_start);
+		__entry->wait_us = wait_us;
+		__entry->status = status;
+	),
+	TP_printk("%s cu%d: pid %d seq %llu cycles %llu misc %u conv %u save %u load %u run %lldus wait %lldus status %d",
+		  __get_str(dev), __entry->cu, __entry->pid, __entry->seq,
+		  __entry->cycles, __entry->pend, __entry->cend,
+		  __entry->send, __entry->lend, __entry->run_us,
+		  __entry->wait_us, __entry->status)
+);
+
+#endif /* _XLNX_DPU_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE xlnx_dpu_trace
+#include <trace/define_trace.h>
@@ -16,13 +16,16 @@
  */
 
 #include <linux/clk-provider.h>
+#include <linux/debugfs.h>
 #include <linux/mfd/syscon.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/phy/phy.h>
+#include <linux/pm_runtime.h>
 #include <linux/regmap.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
 #include <linux/firmware/xlnx-zynqmp.h>
 
 #include "cqhci.h"
@@ -165,6 +168,29 @@ struct sdhci_arasan_clk_data {
 	void		*clk_of_data;
 };
 
+/* Number of CQHCI task slots, the last one being the DCMD slot */
+#define SDHCI_ARASAN_CQE_SLOTS		32
+
+/**
+ * struct sdhci_arasan_cqe_stats - Command queue engine counters
+ * @requests:		Number of tasks issued, direct commands included.
+ * @dcmds:		Number of direct commands issued.
+ * @completed:		Number of tasks completed.
+ * @lat_total_ns:	Sum of the issue to completion latencies.
+ * @lat_max_ns:		Largest issue to completion latency.
+ * @max_in_flight:	Largest number of tasks queued at once.
+ * @issued:		Issue time of the task of each slot.
+ */
+struct sdhci_arasan_cqe_stats {
+	u64		requests;
+	u64		dcmds;
+	u64		completed;
+	u64		lat_total_ns;
+	u64		lat_max_ns;
+	int		max_in_flight;
+	ktime_t		issued[SDHCI_ARASAN_CQE_SLOTS];
+};
+
 /**
  * struct sdhci_arasan_data - Arasan Controller Data
  *
@@ -174,6 +200,14 @@ struct sdhci_arasan_clk_data {
  * @is_phy_on:		True if the PHY is on; false if not.
  * @internal_phy_reg:	True if the PHY is within the Host controller.
  * @has_cqe:		True if controller has command queuing engine.
+ * @cqe_ops:		Command queue ops wrapping the CQHCI ones for @cqe_stats.
+ * @cqhci_ops:		Command queue ops of CQHCI.
+ * @cqe_stats:		Command queue engine counters.
+ * @cqe_ic_count:	Interrupt coalescing task count, 0 to disable it.
+ * @cqe_ic_timeout:	Interrupt coalescing timeout, in 1024 CQ clock units.
+ * @tuned_node:		ZynqMP DLL node of the cached tuning result, 0 if none.
+ * @tuned_timing:	Bus timing the cached tuning result is valid for.
+ * @tuned_clock:	Card clock the cached tuning result is valid for.
  * @clk_data:		Struct for the Arasan Controller Clock Data.
  * @clk_ops:		Struct for the Arasan Controller Clock Operations.
  * @soc_ctl_base:	Pointer to regmap for syscon for soc_ctl registers.
@@ -188,6 +222,14 @@ struct sdhci_arasan_data {
 	bool		internal_phy_reg;
 
 	bool		has_cqe;
+	struct mmc_cqe_ops cqe_ops;
+	const struct mmc_cqe_ops *cqhci_ops;
+	struct sdhci_arasan_cqe_stats cqe_stats;
+	u32		cqe_ic_count;
+	u32		cqe_ic_timeout;
+	u32		tuned_node;
+	unsigned char	tuned_timing;
+	unsigned int	tuned_clock;
 	struct sdhci_arasan_clk_data clk_data;
 	const struct sdhci_arasan_clk_ops *clk_ops;
 
@@ -542,9 +584,32 @@ static void sdhci_arasan_dumpregs(struct mmc_host *mmc)
 	sdhci_dumpregs(mmc_priv(mmc));
 }
 
+/**
+ * sdhci_arasan_cqe_set_ic - Program the CQHCI interrupt coalescing
+ * @sdhci_arasan:	Our private data structure.
+ *
+ * The completion interrupt is raised once cqe_ic_count tasks completed, or
+ * cqe_ic_timeout after the first pending completion.
+ */
+static void sdhci_arasan_cqe_set_ic(struct sdhci_arasan_data *sdhci_arasan)
+{
+	struct cqhci_host *cq_host = sdhci_arasan->host->mmc->cqe_private;
+	u32 ic = 0;
+
+	if (sdhci_arasan->cqe_ic_count)
+		ic = CQHCI_IC_ENABLE | CQHCI_IC_ICCTHWEN |
+		     CQHCI_IC_ICCTH(sdhci_arasan->cqe_ic_count) |
+		     CQHCI_IC_ICTOVALWEN |
+		     CQHCI_IC_ICTOVAL(sdhci_arasan->cqe_ic_timeout);
+
+	cqhci_writel(cq_host, ic, CQHCI_IC);
+}
+
 static void sdhci_arasan_cqe_enable(struct mmc_host *mmc)
 {
 	struct sdhci_host *host = mmc_priv(mmc);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_arasan_data *sdhci_arasan = sdhci_pltfm_priv(pltfm_host);
 	u32 reg;
 
 	reg = sdhci_readl(host, SDHCI_PRESENT_STATE);
@@ -554,8 +619,159 @@ static void sdhci_arasan_cqe_enable(struct mmc_host *mmc)
 	}
 
 	sdhci_cqe_enable(mmc);
+	sdhci_arasan_cqe_set_ic(sdhci_arasan);
+}
+
+static int sdhci_arasan_cqe_request(struct mmc_host *mmc,
+				    struct mmc_request *mrq)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(mmc_priv(mmc));
+	struct sdhci_arasan_data *sdhci_arasan = sdhci_pltfm_priv(pltfm_host);
+	struct sdhci_arasan_cqe_stats *stats = &sdhci_arasan->cqe_stats;
+	struct cqhci_host *cq_host = mmc->cqe_private;
+	int tag = mrq->cmd ? cq_host->dcmd_slot : mrq->tag;
+	int ret;
+
+	stats->issued[tag] = ktime_get();
+
+	ret = sdhci_arasan->cqhci_ops->cqe_request(mmc, mrq);
+	if (ret)
+		return ret;
+
+	stats->requests++;
+	if (mrq->cmd)
+		stats->dcmds++;
+	stats->max_in_flight = max(stats->max_in_flight, READ_ONCE(cq_host->qcnt));
+
+	return 0;
+}
+
+static void sdhci_arasan_cqe_post_req(struct mmc_host *mmc,
+				      struct mmc_request *mrq)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(mmc_priv(mmc));
+	struct sdhci_arasan_data *sdhci_arasan = sdhci_pltfm_priv(pltfm_host);
+	struct sdhci_arasan_cqe_stats *stats = &sdhci_arasan->cqe_stats;
+	struct cqhci_host *cq_host = mmc->cqe_private;
+	int tag = mrq->cmd ? cq_host->dcmd_slot : mrq->tag;
+	u64 lat;
+
+	if (sdhci_arasan->cqhci_ops->cqe_post_req)
+		sdhci_arasan->cqhci_ops->cqe_post_req(mmc, mrq);
+
+	lat = ktime_to_ns(ktime_sub(ktime_get(), stats->issued[tag]));
+	stats->completed++;
+	stats->lat_total_ns += lat;
+	stats->lat_max_ns = max(stats->lat_max_ns, lat);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int sdhci_arasan_cqe_stats_show(struct seq_file *m, void *unused)
+{
+	struct sdhci_arasan_data *sdhci_arasan = m->private;
+	struct sdhci_arasan_cqe_stats *stats = &sdhci_arasan->cqe_stats;
+	struct mmc_host *mmc = sdhci_arasan->host->mmc;
+	struct cqhci_host *cq_host = mmc->cqe_private;
+	u64 completed = stats->completed;
+
+	seq_printf(m, "queue_depth: %d\n", mmc->cqe_qdepth);
+	seq_printf(m, "in_flight: %d\n", READ_ONCE(cq_host->qcnt));
+	seq_printf(m, "max_in_flight: %d\n", stats->max_in_flight);
+	seq_printf(m, "requests: %llu\n", stats->requests);
+	seq_printf(m, "dcmds: %llu\n", stats->dcmds);
+	seq_printf(m, "completed: %llu\n", completed);
+	seq_printf(m, "latency_avg_ns: %llu\n",
+		   completed ? div64_u64(stats->lat_total_ns, completed) : 0);
+	seq_printf(m, "latency_max_ns: %llu\n", stats->lat_max_ns);
+	seq_printf(m, "ic: 0x%08x\n", cqhci_readl(cq_host, CQHCI_IC));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sdhci_arasan_cqe_stats);
+
+static int sdhci_arasan_cqe_ic_get(void *data, u64 *val, u32 *field)
+{
+	*val = *field;
+
+	return 0;
 }
 
+static int sdhci_arasan_cqe_ic_set(struct sdhci_arasan_data *sdhci_arasan,
+				   u32 *field, u64 val, u64 max)
+{
+	struct sdhci_host *host = sdhci_arasan->host;
+	struct cqhci_host *cq_host = host->mmc->cqe_private;
+	unsigned long flags;
+
+	if (val > max)
+		return -EINVAL;
+
+	spin_lock_irqsave(&host->lock, flags);
+	*field = val;
+	if (cq_host->enabled)
+		sdhci_arasan_cqe_set_ic(sdhci_arasan);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return 0;
+}
+
+static int sdhci_arasan_cqe_ic_count_get(void *data, u64 *val)
+{
+	struct sdhci_arasan_data *sdhci_arasan = data;
+
+	return sdhci_arasan_cqe_ic_get(data, val, &sdhci_arasan->cqe_ic_count);
+}
+
+static int sdhci_arasan_cqe_ic_count_set(void *data, u64 val)
+{
+	struct sdhci_arasan_data *sdhci_arasan = data;
+
+	return sdhci_arasan_cqe_ic_set(sdhci_arasan, &sdhci_arasan->cqe_ic_count,
+				       val, CQHCI_IC_DEFAULT_ICCTH);
+}
+DEFINE_DEBUGFS_ATTRIBUTE(sdhci_arasan_cqe_ic_count_fops,
+			 sdhci_arasan_cqe_ic_count_get,
+			 sdhci_arasan_cqe_ic_count_set, "%llu\n");
+
+static int sdhci_arasan_cqe_ic_timeout_get(void *data, u64 *val)
+{
+	struct sdhci_arasan_data *sdhci_arasan = data;
+
+	return sdhci_arasan_cqe_ic_get(data, val, &sdhci_arasan->cqe_ic_timeout);
+}
+
+static int sdhci_arasan_cqe_ic_timeout_set(void *data, u64 val)
+{
+	struct sdhci_arasan_data *sdhci_arasan = data;
+
+	if (!val)
+		return -EINVAL;
+
+	return sdhci_arasan_cqe_ic_set(sdhci_arasan,
+				       &sdhci_arasan->cqe_ic_timeout, val,
+				       CQHCI_IC_ICTOVAL(~0));
+}
+DEFINE_DEBUGFS_ATTRIBUTE(sdhci_arasan_cqe_ic_timeout_fops,
+			 sdhci_arasan_cqe_ic_timeout_get,
+			 sdhci_arasan_cqe_ic_timeout_set, "%llu\n");
+
+static void sdhci_arasan_cqe_debugfs_init(struct sdhci_arasan_data *sdhci_arasan)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cqe", sdhci_arasan->host->mmc->debugfs_root);
+	debugfs_create_file("stats", 0400, dir, sdhci_arasan,
+			    &sdhci_arasan_cqe_stats_fops);
+	debugfs_create_file_unsafe("ic_count", 0600, dir, sdhci_arasan,
+				   &sdhci_arasan_cqe_ic_count_fops);
+	debugfs_create_file_unsafe("ic_timeout", 0600, dir, sdhci_arasan,
+				   &sdhci_arasan_cqe_ic_timeout_fops);
+}
+#else
+static inline void
+sdhci_arasan_cqe_debugfs_init(struct sdhci_arasan_data *sdhci_arasan) { }
+#endif
+
 static const struct cqhci_host_ops sdhci_arasan_cqhci_ops = {
 	.enable         = sdhci_arasan_cqe_enable,
 	.disable        = sdhci_cqe_disable,
@@ -596,6 +812,10 @@ static int sdhci_arasan_suspend(struct device *dev)
 	struct sdhci_arasan_data *sdhci_arasan = sdhci_pltfm_priv(pltfm_host);
 	int ret;
 
+	/* The register state is lost below, drop the cached tuning result */
+	pm_runtime_resume(dev);
+	sdhci_arasan->tuned_node = 0;
+
 	if (host->tuning_mode != SDHCI_TUNING_MODE_3)
 		mmc_retune_needed(host->mmc);
 
@@ -676,8 +896,115 @@ static int sdhci_arasan_resume(struct device *dev)
 }
 #endif /* ! CONFIG_PM_SLEEP */
 
-static SIMPLE_DEV_PM_OPS(sdhci_arasan_dev_pm_ops, sdhci_arasan_suspend,
-			 sdhci_arasan_resume);
+#ifdef CONFIG_PM
+static void arasan_zynqmp_dll_reset(struct sdhci_host *host, u32 deviceid);
+
+/**
+ * sdhci_arasan_runtime_suspend - Runtime suspend method for the driver
+ * @dev:	Address of the device structure
+ *
+ * Gate the controller clocks. The controller keeps its registers, and with
+ * them the tuned sampling point, so no re-tuning is requested.
+ *
+ * Return: 0 on success and error value on error
+ */
+static int sdhci_arasan_runtime_suspend(struct device *dev)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_arasan_data *sdhci_arasan = sdhci_pltfm_priv(pltfm_host);
+	int ret;
+
+	if (sdhci_arasan->has_cqe) {
+		ret = cqhci_suspend(host->mmc);
+		if (ret)
+			return ret;
+	}
+
+	ret = sdhci_runtime_suspend_host(host);
+	if (ret)
+		return ret;
+
+	if (!IS_ERR(sdhci_arasan->phy) && sdhci_arasan->is_phy_on) {
+		ret = phy_power_off(sdhci_arasan->phy);
+		if (ret) {
+			dev_err(dev, "Cannot power off phy.\n");
+			sdhci_runtime_resume_host(host, 1);
+			return ret;
+		}
+		sdhci_arasan->is_phy_on = false;
+	}
+
+	clk_disable(pltfm_host->clk);
+	clk_disable(sdhci_arasan->clk_ahb);
+
+	return 0;
+}
+
+/**
+ * sdhci_arasan_runtime_resume - Runtime resume method for the driver
+ * @dev:	Address of the device structure
+ *
+ * Ungate the controller clocks and restore the bus settings. When the bus
+ * still runs at the timing and clock it was tuned for, the ZynqMP DLL is
+ * relocked onto the cached tuning result instead of tuning again. Re-tuning
+ * is left to the MMC core, on CRC errors and on the re-tuning timer.
+ *
+ * Return: 0 on success and error value on error
+ */
+static int sdhci_arasan_runtime_resume(struct device *dev)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_arasan_data *sdhci_arasan = sdhci_pltfm_priv(pltfm_host);
+	struct mmc_ios *ios = &host->mmc->ios;
+	int ret;
+
+	ret = clk_enable(sdhci_arasan->clk_ahb);
+	if (ret) {
+		dev_err(dev, "Cannot enable AHB clock.\n");
+		return ret;
+	}
+
+	ret = clk_enable(pltfm_host->clk);
+	if (ret) {
+		dev_err(dev, "Cannot enable SD clock.\n");
+		clk_disable(sdhci_arasan->clk_ahb);
+		return ret;
+	}
+
+	if (!IS_ERR(sdhci_arasan->phy) && host->mmc->actual_clock) {
+		ret = phy_power_on(sdhci_arasan->phy);
+		if (ret) {
+			dev_err(dev, "Cannot power on phy.\n");
+			return ret;
+		}
+		sdhci_arasan->is_phy_on = true;
+	}
+
+	ret = sdhci_runtime_resume_host(host, 1);
+	if (ret) {
+		dev_err(dev, "Cannot resume host.\n");
+		return ret;
+	}
+
+	if (sdhci_arasan->tuned_node &&
+	    ios->timing == sdhci_arasan->tuned_timing &&
+	    ios->clock == sdhci_arasan->tuned_clock)
+		arasan_zynqmp_dll_reset(host, sdhci_arasan->tuned_node);
+
+	if (sdhci_arasan->has_cqe)
+		return cqhci_resume(host->mmc);
+
+	return 0;
+}
+#endif /* ! CONFIG_PM */
+
+static const struct dev_pm_ops sdhci_arasan_dev_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(sdhci_arasan_suspend, sdhci_arasan_resume)
+	SET_RUNTIME_PM_OPS(sdhci_arasan_runtime_suspend,
+			   sdhci_arasan_runtime_resume, NULL)
+};
 
 /**
  * sdhci_arasan_sdcardclk_recalc_rate - Return the card clock rate
@@ -1129,6 +1456,8 @@ static int arasan_zynqmp_execute_tuning(struct mmc_host *mmc, u32 opcode)
 	if (mmc->ios.timing == MMC_TIMING_UHS_DDR50)
 		return 0;
 
+	sdhci_arasan->tuned_node = 0;
+
 	arasan_zynqmp_dll_reset(host, device_id);
 
 	err = sdhci_execute_tuning(mmc, opcode);
@@ -1137,6 +1466,11 @@ static int arasan_zynqmp_execute_tuning(struct mmc_host *mmc, u32 opcode)
 
 	arasan_zynqmp_dll_reset(host, device_id);
 
+	/* Cache the result so that runtime resume only relocks the DLL */
+	sdhci_arasan->tuned_timing = mmc->ios.timing;
+	sdhci_arasan->tuned_clock = mmc->ios.clock;
+	sdhci_arasan->tuned_node = device_id;
+
 	return 0;
 }
 
@@ -1809,6 +2143,7 @@ static int sdhci_arasan_add_host(struct sdhci_arasan_data *sdhci_arasan)
 {
 	struct sdhci_host *host = sdhci_arasan->host;
 	struct cqhci_host *cq_host;
+	u32 qdepth;
 	bool dma64;
 	int ret;
 
@@ -1837,10 +2172,34 @@ static int sdhci_arasan_add_host(struct sdhci_arasan_data *sdhci_arasan)
 	if (ret)
 		goto cleanup;
 
+	/* A shallower queue bounds the latency of each task */
+	if (!of_property_read_u32(host->mmc->parent->of_node,
+				  "xlnx,cqe-queue-depth", &qdepth) &&
+	    qdepth && qdepth < host->mmc->cqe_qdepth)
+		host->mmc->cqe_qdepth = qdepth;
+
+	of_property_read_u32(host->mmc->parent->of_node, "xlnx,cqe-ic-count",
+			     &sdhci_arasan->cqe_ic_count);
+	sdhci_arasan->cqe_ic_count = min_t(u32, sdhci_arasan->cqe_ic_count,
+					   CQHCI_IC_DEFAULT_ICCTH);
+	sdhci_arasan->cqe_ic_timeout = CQHCI_IC_DEFAULT_ICTOVAL;
+	of_property_read_u32(host->mmc->parent->of_node, "xlnx,cqe-ic-timeout",
+			     &sdhci_arasan->cqe_ic_timeout);
+	sdhci_arasan->cqe_ic_timeout = clamp_t(u32, sdhci_arasan->cqe_ic_timeout,
+					       1, CQHCI_IC_ICTOVAL(~0));
+
+	sdhci_arasan->cqhci_ops = host->mmc->cqe_ops;
+	sdhci_arasan->cqe_ops = *host->mmc->cqe_ops;
+	sdhci_arasan->cqe_ops.cqe_request = sdhci_arasan_cqe_request;
+	sdhci_arasan->cqe_ops.cqe_post_req = sdhci_arasan_cqe_post_req;
+	host->mmc->cqe_ops = &sdhci_arasan->cqe_ops;
+
 	ret = __sdhci_add_host(host);
 	if (ret)
 		goto cleanup;
 
+	sdhci_arasan_cqe_debugfs_init(sdhci_arasan);
+
 	return 0;
 
 cleanup:
@@ -2013,13 +2372,24 @@ static int sdhci_arasan_probe(struct platform_device *pdev)
 	if (of_device_is_compatible(np, "xlnx,versal-net-emmc"))
 		sdhci_arasan->internal_phy_reg = true;
 
+	pm_runtime_get_noresume(dev);
+	pm_runtime_set_active(dev);
+	pm_runtime_enable(dev);
+	pm_runtime_set_autosuspend_delay(dev, 50);
+	pm_runtime_use_autosuspend(dev);
+
 	ret = sdhci_arasan_add_host(sdhci_arasan);
 	if (ret)
-		goto err_add_host;
+		goto pm_runtime_disable;
+
+	pm_runtime_put_autosuspend(dev);
 
 	return 0;
 
-err_add_host:
+pm_runtime_disable:
+	pm_runtime_disable(dev);
+	pm_runtime_set_suspended(dev);
+	pm_runtime_put_noidle(dev);
 	if (!IS_ERR(sdhci_arasan->phy))
 		phy_exit(sdhci_arasan->phy);
 unreg_clk:
@@ -2041,6 +2411,10 @@ static void sdhci_arasan_remove(struct platform_device *pdev)
 	struct clk *clk_ahb = sdhci_arasan->clk_ahb;
 	struct clk *clk_xin = pltfm_host->clk;
 
+	pm_runtime_get_sync(&pdev->dev);
+	pm_runtime_disable(&pdev->dev);
+	pm_runtime_put_noidle(&pdev->dev);
+
 	if (!IS_ERR(sdhci_arasan->phy)) {
 		if (sdhci_arasan->is_phy_on)
 			phy_power_off(sdhci_arasan->phy);
@@ -17,6 +17,7 @@
 #include <linux/ptp_clock_kernel.h>
 #include <linux/platform_device.h>
 #include <linux/of_irq.h>
+#include <linux/workqueue.h>
 #include <linux/ptp/ptp_xilinx.h>
 
 /* Register offset definitions */
@@ -75,6 +76,37 @@
 
 #define PPM_FRACTION	16
 
+/*
+ * PPS servo: offsets beyond the step threshold are corrected with a time
+ * step, smaller ones by a PI loop on the frequency. The gains are the
+ * linuxptp defaults for hardware timestamps at one update per second.
+ */
+#define XPTPTIMER_SERVO_STEP_NS		(20 * NSEC_PER_USEC)
+#define XPTPTIMER_SERVO_KP_NUM		7
+#define XPTPTIMER_SERVO_KI_NUM		3
+#define XPTPTIMER_SERVO_GAIN_DEN	10
+
+static bool pps_servo;
+module_param(pps_servo, bool, 0644);
+MODULE_PARM_DESC(pps_servo,
+		 "Discipline the timer to the external 1PPS input while it is timestamped");
+
+/**
+ * struct xlnx_ptp - Timer syncer instance
+ * @timer: timer state used by the PTP clock operations
+ * @servo_work: runs the PPS servo for the last 1PPS timestamp
+ * @pps_nsec: nanoseconds of the last 1PPS timestamp
+ * @servo_locked: the timer has been stepped onto the 1PPS edges
+ * @servo_integral: integral term of the PPS servo, in ns
+ */
+struct xlnx_ptp {
+	struct xlnx_ptp_timer timer;
+	struct work_struct servo_work;
+	u32 pps_nsec;
+	bool servo_locked;
+	s64 servo_integral;
+};
+
 /* I/O accessors */
 static inline u32 xlnx_ptp_ior(struct xlnx_ptp_timer *timer, off_t reg)
 {
@@ -91,12 +123,17 @@ static inline void xlnx_ptp_iow(struct xlnx_ptp_timer *timer, off_t reg,
  * Inline timer helpers
  */
 static inline void xlnx_tod_read(struct xlnx_ptp_timer *timer,
-				 struct timespec64 *ts)
+				 struct timespec64 *ts,
+				 struct ptp_system_timestamp *sts)
 {
 	u32 sech, secl, nsec;
 
+	ptp_read_system_prets(sts);
 	xlnx_ptp_iow(timer, XPTPTIMER_TOD_SNAPSHOT_OFFSET,
 		     XPTPTIMER_SNAPSHOT_MASK);
+	/* Flush the posted write so that the snapshot lands in the window */
+	xlnx_ptp_ior(timer, XPTPTIMER_TOD_CONFIG_OFFSET);
+	ptp_read_system_postts(sts);
 
 	if (timer->use_sys_timer_only) {
 		nsec = xlnx_ptp_ior(timer, XPTPTIMER_SYS_NS_OFFSET);
@@ -268,21 +305,25 @@ static int xlnx_ptp_adjtime(struct ptp_clock_info *ptp, s64 delta)
 }
 
 /**
- * xlnx_ptp_gettime - Get the current time on the hardware clock
+ * xlnx_ptp_gettimex - Get the current time on the hardware clock
  * @ptp: ptp clock structure
  * @ts: timespec64 containing the current TX port timer time.
+ * @sts: system timestamps taken around the snapshot, may be NULL
  * Return: 0 on success
  * Since TX and RX ports are initialized and adjusted simultaneously,
  * they should be the same.
  *
+ * The timer latches its time on the snapshot register write, so bracketing
+ * that write bounds the correlation error to one register round trip.
  */
-static int xlnx_ptp_gettime(struct ptp_clock_info *ptp, struct timespec64 *ts)
+static int xlnx_ptp_gettimex(struct ptp_clock_info *ptp, struct timespec64 *ts,
+			     struct ptp_system_timestamp *sts)
 {
 	struct xlnx_ptp_timer *timer = container_of(ptp, struct xlnx_ptp_timer,
 						    ptp_clock_info);
 
 	spin_lock(&timer->reg_lock);
-	xlnx_tod_read(timer, ts);
+	xlnx_tod_read(timer, ts, sts);
 	spin_unlock(&timer->reg_lock);
 
 	return 0;
@@ -319,6 +360,8 @@ static int xlnx_ptp_enable(struct ptp_clock_info *ptp,
 	switch (rq->type) {
 	case PTP_CLK_REQ_EXTTS:
 		timer->extts_enable = on;
+		/* Step onto the 1PPS edges again when re-enabled */
+		container_of(timer, struct xlnx_ptp, timer)->servo_locked = false;
 
 		data = xlnx_ptp_ior(timer, XPTPTIMER_TOD_CONFIG_OFFSET);
 
@@ -344,11 +387,50 @@ static struct ptp_clock_info xlnx_ptp_clock_info = {
 	.n_ext_ts	= 1,
 	.adjfine	= xlnx_ptp_adjfine,
 	.adjtime	= xlnx_ptp_adjtime,
-	.gettime64	= xlnx_ptp_gettime,
+	.gettimex64	= xlnx_ptp_gettimex,
 	.settime64	= xlnx_ptp_settime,
 	.enable		= xlnx_ptp_enable,
 };
 
+/**
+ * xlnx_ptp_servo_work - Disciplines the timer to the external 1PPS input
+ * @work: servo work of the timer
+ *
+ * The phase error is the distance of the last 1PPS timestamp to the nearest
+ * second. It runs from a work item as the clock operations take the
+ * register lock without disabling interrupts.
+ */
+static void xlnx_ptp_servo_work(struct work_struct *work)
+{
+	struct xlnx_ptp *xptp = container_of(work, struct xlnx_ptp, servo_work);
+	struct ptp_clock_info *info = &xptp->timer.ptp_clock_info;
+	s64 max_integral, offset, ppb;
+
+	offset = READ_ONCE(xptp->pps_nsec);
+	if (offset >= NSEC_PER_SEC / 2)
+		offset -= NSEC_PER_SEC;
+
+	if (!xptp->servo_locked || abs(offset) > XPTPTIMER_SERVO_STEP_NS) {
+		xlnx_ptp_adjtime(info, -offset);
+		xptp->servo_integral = 0;
+		xptp->servo_locked = true;
+		return;
+	}
+
+	max_integral = div_s64((s64)info->max_adj * XPTPTIMER_SERVO_GAIN_DEN,
+			       XPTPTIMER_SERVO_KI_NUM);
+	xptp->servo_integral = clamp(xptp->servo_integral + offset,
+				     -max_integral, max_integral);
+
+	ppb = div_s64(offset * XPTPTIMER_SERVO_KP_NUM +
+		      xptp->servo_integral * XPTPTIMER_SERVO_KI_NUM,
+		      XPTPTIMER_SERVO_GAIN_DEN);
+	ppb = clamp_t(s64, -ppb, -info->max_adj, info->max_adj);
+
+	/* scaled_ppm is ppm with a 16 bit binary fraction */
+	xlnx_ptp_adjfine(info, div_s64(ppb << PPM_FRACTION, 1000));
+}
+
 /**
  * xlnx_ptp_timer_isr - Interrupt Service Routine
  * @irq:               IRQ number
@@ -377,6 +459,15 @@ static irqreturn_t xlnx_ptp_timer_isr(int irq, void *priv)
 			sec = (((u64)sech << 32) | secl) & XPTPTIMER_MAX_SEC_MASK;
 			event.timestamp = ktime_set(sec, nsec);
 			ptp_clock_event(timer->ptp_clock, &event);
+
+			if (pps_servo) {
+				struct xlnx_ptp *xptp;
+
+				xptp = container_of(timer, struct xlnx_ptp,
+						    timer);
+				WRITE_ONCE(xptp->pps_nsec, nsec);
+				schedule_work(&xptp->servo_work);
+			}
 		}
 		return IRQ_HANDLED;
 	}
@@ -387,6 +478,7 @@ static irqreturn_t xlnx_ptp_timer_isr(int irq, void *priv)
 static int xlnx_ptp_timer_probe(struct platform_device *pdev)
 {
 	struct xlnx_ptp_timer *timer;
+	struct xlnx_ptp *xptp;
 	struct resource *r_mem;
 	int err = 0;
 	struct timespec64 ts, tsp;
@@ -397,10 +489,12 @@ static int xlnx_ptp_timer_probe(struct platform_device *pdev)
 		return -EINVAL;
 	}
 
-	timer = devm_kzalloc(&pdev->dev, sizeof(*timer), GFP_KERNEL);
-	if (!timer)
+	xptp = devm_kzalloc(&pdev->dev, sizeof(*xptp), GFP_KERNEL);
+	if (!xptp)
 		return -ENOMEM;
 
+	INIT_WORK(&xptp->servo_work, xlnx_ptp_servo_work);
+	timer = &xptp->timer;
 	timer->dev = &pdev->dev;
 
 	r_mem = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -506,6 +600,8 @@ static int xlnx_ptp_timer_remove(struct platform_device *pdev)
 		/* Disable timer interrupt */
 		xlnx_ptp_iow(timer, XPTPTIMER_IER_OFFSET,
 			     (u32)~(XPTPTIMER_EXTS_1PPS_INTR_MASK));
+	cancel_work_sync(&container_of(timer, struct xlnx_ptp,
+				       timer)->servo_work);
 	ptp_clock_unregister(timer->ptp_clock);
 
 	return 0;
@@ -12,6 +12,8 @@
  */
 
 #include <linux/module.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
 #include <linux/interrupt.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
@@ -111,6 +113,18 @@
  * @rx_bus_width:	Number of wires used to receive data
  * @tx_fifo:		For writing data to fifo
  * @rx_fifo:		For reading data from fifo
+ * @dma_tx:		Optional DMA channel feeding the TX FIFO
+ * @dma_rx:		Optional DMA channel draining the RX FIFO
+ * @fifo_phys:		Bus address of the registers as seen by the DMA
+ * @dma_scratch:	One FIFO of zeroes to send, then one to receive into,
+ *			for transfers without TX or RX buffer
+ * @dma_scratch_addr:	DMA address of @dma_scratch
+ * @dma_tx_addr:	DMA address of the TX buffer of the current transfer
+ * @dma_rx_addr:	DMA address of the RX buffer of the current transfer
+ * @dma_len:		Length of the current DMA transfer
+ * @dma_offset:		Bytes of the current DMA transfer done
+ * @dma_chunk:		Bytes of the current DMA transfer in the FIFOs
+ * @use_dma:		The current transfer goes through DMA
  */
 struct xilinx_spi {
 	void __iomem	*regs;	/* virt. address of the control registers */
@@ -132,6 +146,17 @@ struct xilinx_spi {
 	u32 rx_bus_width;
 	void (*tx_fifo)(struct xilinx_spi *xqspi);
 	void (*rx_fifo)(struct xilinx_spi *xqspi);
+	struct dma_chan *dma_tx;
+	struct dma_chan *dma_rx;
+	phys_addr_t fifo_phys;
+	void *dma_scratch;
+	dma_addr_t dma_scratch_addr;
+	dma_addr_t dma_tx_addr;
+	dma_addr_t dma_rx_addr;
+	u32 dma_len;
+	u32 dma_offset;
+	u32 dma_chunk;
+	bool use_dma;
 };
 
 /**
@@ -378,6 +403,208 @@ static int xspi_setup(struct spi_device *qspi)
 	return ret;
 }
 
+/* Bytes moved per DMA round, one full FIFO */
+static u32 xspi_dma_fifo_bytes(struct xilinx_spi *xspi)
+{
+	return xspi->buffer_size * xspi->bytes_per_word;
+}
+
+/**
+ * xspi_can_dma - Check if a transfer should go through DMA
+ * @xspi:	Pointer to the xilinx_spi structure
+ * @transfer:	Pointer to the spi_transfer structure
+ *
+ * DMA pays off for transfers spanning several FIFOs. Dummy cycles and quad
+ * reads need the byte accounting of the FIFO path, so they stay on it.
+ *
+ * Return:	true if the transfer should use DMA
+ */
+static bool xspi_can_dma(struct xilinx_spi *xspi, struct spi_transfer *transfer)
+{
+	if (!xspi->dma_tx || transfer->dummy ||
+	    xspi->rx_bus_width != XSPI_RX_ONE_WIRE)
+		return false;
+
+	if (transfer->len <= xspi_dma_fifo_bytes(xspi) ||
+	    transfer->len % xspi->bytes_per_word)
+		return false;
+
+	if ((transfer->tx_buf && !virt_addr_valid(transfer->tx_buf)) ||
+	    (transfer->rx_buf && !virt_addr_valid(transfer->rx_buf)))
+		return false;
+
+	return true;
+}
+
+static void xspi_dma_unmap(struct xilinx_spi *xspi)
+{
+	if (xspi->tx_ptr)
+		dma_unmap_single(xspi->dma_tx->device->dev, xspi->dma_tx_addr,
+				 xspi->dma_len, DMA_TO_DEVICE);
+	if (xspi->rx_ptr)
+		dma_unmap_single(xspi->dma_rx->device->dev, xspi->dma_rx_addr,
+				 xspi->dma_len, DMA_FROM_DEVICE);
+	xspi->use_dma = false;
+}
+
+/* Fail the current message from a DMA callback or the interrupt handler */
+static void xspi_dma_fail(struct xilinx_spi *xspi)
+{
+	struct spi_master *master = dev_get_drvdata(xspi->dev);
+
+	dev_err(xspi->dev, "failed to queue DMA transfer\n");
+	xspi->write_fn(0x0, xspi->regs + XIPIF_V123B_DGIER_OFFSET);
+	xspi_dma_unmap(xspi);
+	if (master->cur_msg)
+		master->cur_msg->status = -EIO;
+	spi_finalize_current_transfer(master);
+}
+
+static void xspi_dma_tx_done(void *data)
+{
+	struct xilinx_spi *xspi = data;
+	u32 cr;
+
+	/* The FIFO is full, let it shift out */
+	cr = xspi->read_fn(xspi->regs + XSPI_CR_OFFSET);
+	cr &= ~XSPI_CR_TRANS_INHIBIT;
+	xspi->write_fn(cr, xspi->regs + XSPI_CR_OFFSET);
+	xspi->write_fn(XIPIF_V123B_GINTR_ENABLE,
+		       xspi->regs + XIPIF_V123B_DGIER_OFFSET);
+}
+
+static void xspi_dma_tx_chunk(struct xilinx_spi *xspi)
+{
+	struct dma_async_tx_descriptor *desc;
+	dma_addr_t src;
+
+	xspi->dma_chunk = min(xspi->dma_len - xspi->dma_offset,
+			      xspi_dma_fifo_bytes(xspi));
+	if (xspi->tx_ptr)
+		src = xspi->dma_tx_addr + xspi->dma_offset;
+	else
+		src = xspi->dma_scratch_addr;
+
+	desc = dmaengine_prep_slave_single(xspi->dma_tx, src, xspi->dma_chunk,
+					   DMA_MEM_TO_DEV,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		xspi_dma_fail(xspi);
+		return;
+	}
+
+	desc->callback = xspi_dma_tx_done;
+	desc->callback_param = xspi;
+	dmaengine_submit(desc);
+	dma_async_issue_pending(xspi->dma_tx);
+}
+
+static void xspi_dma_rx_done(void *data)
+{
+	struct xilinx_spi *xspi = data;
+
+	xspi->dma_offset += xspi->dma_chunk;
+	if (xspi->dma_offset < xspi->dma_len) {
+		xspi_dma_tx_chunk(xspi);
+		return;
+	}
+
+	xspi_dma_unmap(xspi);
+	spi_finalize_current_transfer(dev_get_drvdata(xspi->dev));
+}
+
+static void xspi_dma_rx_chunk(struct xilinx_spi *xspi)
+{
+	struct dma_async_tx_descriptor *desc;
+	dma_addr_t dst;
+
+	if (xspi->rx_ptr)
+		dst = xspi->dma_rx_addr + xspi->dma_offset;
+	else
+		dst = xspi->dma_scratch_addr + xspi_dma_fifo_bytes(xspi);
+
+	desc = dmaengine_prep_slave_single(xspi->dma_rx, dst, xspi->dma_chunk,
+					   DMA_DEV_TO_MEM,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		xspi_dma_fail(xspi);
+		return;
+	}
+
+	desc->callback = xspi_dma_rx_done;
+	desc->callback_param = xspi;
+	dmaengine_submit(desc);
+	dma_async_issue_pending(xspi->dma_rx);
+}
+
+/**
+ * xspi_start_dma - Start a transfer through DMA
+ * @xspi:	Pointer to the xilinx_spi structure
+ * @transfer:	Pointer to the spi_transfer structure
+ *
+ * The controller has no DMA request lines, so the transfer goes one FIFO
+ * at a time: the TX DMA fills the TX FIFO with the transmitter inhibited,
+ * the TX empty interrupt starts the RX DMA draining the RX FIFO, and its
+ * completion queues the next round. The CPU no longer touches the data.
+ *
+ * Return:	0 on success; error value otherwise
+ */
+static int xspi_start_dma(struct xilinx_spi *xspi,
+			  struct spi_transfer *transfer)
+{
+	struct device *tx_dev = xspi->dma_tx->device->dev;
+	struct device *rx_dev = xspi->dma_rx->device->dev;
+
+	xspi->dma_len = transfer->len;
+	xspi->dma_offset = 0;
+
+	if (xspi->tx_ptr) {
+		xspi->dma_tx_addr = dma_map_single(tx_dev, (void *)xspi->tx_ptr,
+						   xspi->dma_len,
+						   DMA_TO_DEVICE);
+		if (dma_mapping_error(tx_dev, xspi->dma_tx_addr))
+			return -ENOMEM;
+	}
+
+	if (xspi->rx_ptr) {
+		xspi->dma_rx_addr = dma_map_single(rx_dev, xspi->rx_ptr,
+						   xspi->dma_len,
+						   DMA_FROM_DEVICE);
+		if (dma_mapping_error(rx_dev, xspi->dma_rx_addr)) {
+			if (xspi->tx_ptr)
+				dma_unmap_single(tx_dev, xspi->dma_tx_addr,
+						 xspi->dma_len, DMA_TO_DEVICE);
+			return -ENOMEM;
+		}
+	}
+
+	xspi->use_dma = true;
+	xspi->bytes_to_transfer = 0;
+	xspi->bytes_to_receive = 0;
+	xspi_dma_tx_chunk(xspi);
+
+	return 0;
+}
+
+/**
+ * xspi_handle_err - Stop the DMA of a failed transfer
+ * @master:	Pointer to the spi_master structure
+ * @msg:	Pointer to the failed message
+ */
+static void xspi_handle_err(struct spi_master *master, struct spi_message *msg)
+{
+	struct xilinx_spi *xspi = spi_master_get_devdata(master);
+
+	if (!xspi->use_dma)
+		return;
+
+	xspi->write_fn(0x0, xspi->regs + XIPIF_V123B_DGIER_OFFSET);
+	dmaengine_terminate_sync(xspi->dma_tx);
+	dmaengine_terminate_sync(xspi->dma_rx);
+	xspi_dma_unmap(xspi);
+	xspi_init_hw(xspi);
+}
+
 /**
  * xspi_start_transfer - Initiates the SPI transfer
  * @master:	Pointer to the spi_master structure which provides
@@ -419,6 +646,15 @@ static int xspi_start_transfer(struct spi_master *master,
 	/* Enable master transaction inhibit */
 	cr |= XSPI_CR_TRANS_INHIBIT;
 	xqspi->write_fn(cr, xqspi->regs + XSPI_CR_OFFSET);
+
+	if (xspi_can_dma(xqspi, transfer)) {
+		int ret = xspi_start_dma(xqspi, transfer);
+
+		if (!ret)
+			return transfer->len;
+		dev_dbg(xqspi->dev, "DMA mapping failed, using PIO\n");
+	}
+
 	xqspi->tx_fifo(xqspi);
 	/* Disable master transaction inhibit */
 	cr &= ~XSPI_CR_TRANS_INHIBIT;
@@ -597,6 +833,19 @@ static irqreturn_t xilinx_spi_irq(int irq, void *dev_id)
 	ipif_isr = xspi->read_fn(xspi->regs + XIPIF_V123B_IISR_OFFSET);
 	xspi->write_fn(ipif_isr, xspi->regs + XIPIF_V123B_IISR_OFFSET);
 
+	if (xspi->use_dma) {
+		if (!(ipif_isr & XSPI_INTR_TX_EMPTY))
+			return IRQ_NONE;
+
+		/* The round is shifted out, stay inhibited until the next */
+		cr = xspi->read_fn(xspi->regs + XSPI_CR_OFFSET);
+		cr |= XSPI_CR_TRANS_INHIBIT;
+		xspi->write_fn(cr, xspi->regs + XSPI_CR_OFFSET);
+		xspi->write_fn(0x0, xspi->regs + XIPIF_V123B_DGIER_OFFSET);
+		xspi_dma_rx_chunk(xspi);
+		return IRQ_HANDLED;
+	}
+
 	cr = xspi->read_fn(xspi->regs + XSPI_CR_OFFSET);
 	/* Enable master transaction inhibit */
 	cr |= XSPI_CR_TRANS_INHIBIT;
@@ -624,6 +873,105 @@ static irqreturn_t xilinx_spi_irq(int irq, void *dev_id)
 
 	return status;
 }
+
+static void xspi_dma_release(struct xilinx_spi *xspi)
+{
+	if (xspi->dma_scratch)
+		dma_free_coherent(xspi->dma_tx->device->dev,
+				  2 * xspi_dma_fifo_bytes(xspi),
+				  xspi->dma_scratch, xspi->dma_scratch_addr);
+	xspi->dma_scratch = NULL;
+	if (xspi->dma_tx)
+		dma_release_channel(xspi->dma_tx);
+	if (xspi->dma_rx)
+		dma_release_channel(xspi->dma_rx);
+	xspi->dma_tx = NULL;
+	xspi->dma_rx = NULL;
+}
+
+/**
+ * xspi_dma_init - Set up the optional DMA channels
+ * @pdev:	Pointer to the platform_device structure
+ * @xspi:	Pointer to the xilinx_spi structure
+ *
+ * The "tx" and "rx" channels move data between memory and the data
+ * registers, reached through the AXI4 interface of the core when it is
+ * given as second reg entry, else through the register interface.
+ *
+ * Return:	0 on success or if there is no DMA; -EPROBE_DEFER otherwise
+ */
+static int xspi_dma_init(struct platform_device *pdev,
+			 struct xilinx_spi *xspi)
+{
+	struct dma_slave_config conf = {};
+	enum dma_slave_buswidth width;
+	struct resource *res;
+	int ret;
+
+	/* The DMA writes the FIFOs little endian */
+	if (xspi->irq < 0 || xspi->write_fn != xspi_write32)
+		return 0;
+
+	xspi->dma_tx = dma_request_chan(&pdev->dev, "tx");
+	if (IS_ERR(xspi->dma_tx)) {
+		ret = PTR_ERR(xspi->dma_tx);
+		xspi->dma_tx = NULL;
+		return ret == -EPROBE_DEFER ? ret : 0;
+	}
+
+	xspi->dma_rx = dma_request_chan(&pdev->dev, "rx");
+	if (IS_ERR(xspi->dma_rx)) {
+		ret = PTR_ERR(xspi->dma_rx);
+		xspi->dma_rx = NULL;
+		goto err_release;
+	}
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+	if (!res)
+		res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	xspi->fifo_phys = res->start;
+
+	width = (enum dma_slave_buswidth)xspi->bytes_per_word;
+	conf.direction = DMA_MEM_TO_DEV;
+	conf.dst_addr = xspi->fifo_phys + XSPI_TXD_OFFSET;
+	conf.dst_addr_width = width;
+	conf.dst_maxburst = 1;
+	ret = dmaengine_slave_config(xspi->dma_tx, &conf);
+	if (ret)
+		goto err_release;
+
+	memset(&conf, 0, sizeof(conf));
+	conf.direction = DMA_DEV_TO_MEM;
+	conf.src_addr = xspi->fifo_phys + XSPI_RXD_OFFSET;
+	conf.src_addr_width = width;
+	conf.src_maxburst = 1;
+	ret = dmaengine_slave_config(xspi->dma_rx, &conf);
+	if (ret)
+		goto err_release;
+
+	xspi->dma_scratch = dma_alloc_coherent(xspi->dma_tx->device->dev,
+					       2 * xspi_dma_fifo_bytes(xspi),
+					       &xspi->dma_scratch_addr,
+					       GFP_KERNEL);
+	if (!xspi->dma_scratch) {
+		ret = -ENOMEM;
+		goto err_release;
+	}
+
+	dev_info(&pdev->dev, "using DMA for transfers over %u bytes\n",
+		 xspi_dma_fifo_bytes(xspi));
+
+	return 0;
+
+err_release:
+	xspi_dma_release(xspi);
+	if (ret == -EPROBE_DEFER)
+		return ret;
+	dev_warn(&pdev->dev, "DMA unavailable (%d), using PIO\n", ret);
+
+	return 0;
+}
+
 static int xilinx_spi_probe(struct platform_device *pdev)
 {
 	struct xilinx_spi *xspi;
@@ -770,6 +1118,11 @@ static int xilinx_spi_probe(struct platform_device *pdev)
 	}
 	xspi->cs_inactive = 0xffffffff;
 
+	ret = xspi_dma_init(pdev, xspi);
+	if (ret)
+		goto clk_unprepare_all;
+	master->handle_err = xspi_handle_err;
+
 	/*
 	 * This is the work around for the startup block issue in
 	 * the spi controller. SPI clock is passing through STARTUP
@@ -782,11 +1135,14 @@ static int xilinx_spi_probe(struct platform_device *pdev)
 	ret = spi_register_master(master);
 	if (ret) {
 		dev_err(&pdev->dev, "spi_register_master failed\n");
-		goto clk_unprepare_all;
+		goto dma_release;
 	}
 
 	return ret;
 
+dma_release:
+	xspi_dma_release(xspi);
+
 clk_unprepare_all:
 	pm_runtime_put_sync(&pdev->dev);
 runtime_disable:
@@ -824,6 +1180,7 @@ static int xilinx_spi_remove(struct platform_device *pdev)
 	clk_bulk_disable_unprepare(xspi->num_clocks, xspi->clks);
 
 	spi_unregister_master(master);
+	xspi_dma_release(xspi);
 
 	return 0;
 }
@@ -100,11 +100,16 @@
  * It is named Linear Configuration but it controls other modes when not in
  * linear mode also.
  */
+#define ZYNQ_QSPI_LCFG_LQ_MODE		BIT(31) /* LQSPI Linear mode */
 #define ZYNQ_QSPI_LCFG_TWO_MEM		BIT(30) /* LQSPI Two memories */
 #define ZYNQ_QSPI_LCFG_SEP_BUS		BIT(29) /* LQSPI Separate bus */
 #define ZYNQ_QSPI_LCFG_U_PAGE		BIT(28) /* LQSPI Upper Page */
 
 #define ZYNQ_QSPI_LCFG_DUMMY_SHIFT	8
+#define ZYNQ_QSPI_LCFG_DUMMY_MAX	7 /* LQSPI dummy bytes */
+
+/* Size of the address space of the linear mode with one memory */
+#define ZYNQ_QSPI_LINEAR_MAX_SIZE	SZ_16M
 
 #define ZYNQ_QSPI_FAST_READ_QOUT_CODE	0x6B /* read instruction code */
 #define ZYNQ_QSPI_FIFO_DEPTH		63 /* FIFO depth in words */
@@ -137,6 +142,8 @@
  * @data_completion:	completion structure
  * @is_stripe:		Flag to indicate if data needs to be split between flashes
  *			(Used in dual parallel configuration)
+ * @linear:		Linear mode window, NULL if not described
+ * @linear_size:	Size of @linear
  */
 struct zynq_qspi {
 	struct spi_controller *ctlr;
@@ -155,6 +162,8 @@ struct zynq_qspi {
 #define	ZYNQ_QSPI_IS_STACKED		BIT(2)
 	bool is_stripe;
 	struct completion data_completion;
+	void __iomem *linear;
+	resource_size_t linear_size;
 };
 
 /**
@@ -680,9 +689,103 @@ static int zynq_qspi_exec_mem_op(struct spi_mem *mem,
 	return err;
 }
 
+/**
+ * zynq_qspi_dirmap_create - Set up a direct mapping through the linear mode
+ * @desc: Direct mapping descriptor
+ *
+ * The linear mode issues the read instruction of the mapping itself and
+ * streams the data through the AXI window of the controller, with no FIFO
+ * handling and no interrupt. It only knows 3-byte addressing and the read
+ * instructions sending the address on a single line, and is only used with
+ * a single memory. Anything else uses the regular operations.
+ *
+ * Return: 0 if the mapping can use the linear mode, -EOPNOTSUPP otherwise.
+ */
+static int zynq_qspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct zynq_qspi *xqspi =
+		spi_controller_get_devdata(desc->mem->spi->master);
+	const struct spi_mem_op *op = &desc->info.op_tmpl;
+	u32 lqspi_cfg_reg;
+
+	if (!xqspi->linear || xqspi->ctlr->num_chipselect > 1)
+		return -EOPNOTSUPP;
+
+	if (op->data.dir != SPI_MEM_DATA_IN || op->cmd.nbytes != 1 ||
+	    op->cmd.buswidth != 1 || op->addr.nbytes != 3 ||
+	    op->addr.buswidth != 1 ||
+	    op->dummy.nbytes > ZYNQ_QSPI_LCFG_DUMMY_MAX)
+		return -EOPNOTSUPP;
+
+	switch (op->cmd.opcode) {
+	case SPINOR_OP_READ:
+	case SPINOR_OP_READ_FAST:
+	case SPINOR_OP_READ_1_1_2:
+	case SPINOR_OP_READ_1_1_4:
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	if (desc->info.offset + desc->info.length >
+	    min_t(resource_size_t, xqspi->linear_size,
+		  ZYNQ_QSPI_LINEAR_MAX_SIZE))
+		return -EOPNOTSUPP;
+
+	lqspi_cfg_reg = ZYNQ_QSPI_LCFG_LQ_MODE |
+			(op->dummy.nbytes << ZYNQ_QSPI_LCFG_DUMMY_SHIFT) |
+			op->cmd.opcode;
+	desc->priv = (void *)(uintptr_t)lqspi_cfg_reg;
+
+	return 0;
+}
+
+/**
+ * zynq_qspi_dirmap_read - Read from a direct mapping in linear mode
+ * @desc: Direct mapping descriptor
+ * @offs: Offset of the data in the mapping
+ * @len: Number of bytes to read
+ * @buf: Destination buffer
+ *
+ * Return: Number of bytes read.
+ */
+static ssize_t zynq_qspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				     u64 offs, size_t len, void *buf)
+{
+	struct zynq_qspi *xqspi =
+		spi_controller_get_devdata(desc->mem->spi->master);
+	u32 config_reg, lqspi_cfg_reg;
+
+	zynq_qspi_config_op(xqspi, desc->mem->spi);
+	lqspi_cfg_reg = zynq_qspi_read(xqspi, ZYNQ_QSPI_LINEAR_CFG_OFFSET);
+	config_reg = zynq_qspi_read(xqspi, ZYNQ_QSPI_CONFIG_OFFSET);
+
+	/* The linear mode drives the chip select and the start itself */
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_ENABLE_OFFSET, 0);
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_CONFIG_OFFSET,
+			config_reg & ~(ZYNQ_QSPI_CONFIG_SSFORCE_MASK |
+				       ZYNQ_QSPI_CONFIG_MANSRTEN_MASK));
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_LINEAR_CFG_OFFSET,
+			(u32)(uintptr_t)desc->priv);
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_ENABLE_OFFSET,
+			ZYNQ_QSPI_ENABLE_ENABLE_MASK);
+
+	memcpy_fromio(buf, xqspi->linear + desc->info.offset + offs, len);
+
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_ENABLE_OFFSET, 0);
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_LINEAR_CFG_OFFSET, lqspi_cfg_reg);
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_CONFIG_OFFSET, config_reg);
+	zynq_qspi_write(xqspi, ZYNQ_QSPI_ENABLE_OFFSET,
+			ZYNQ_QSPI_ENABLE_ENABLE_MASK);
+
+	return len;
+}
+
 static const struct spi_controller_mem_ops zynq_qspi_mem_ops = {
 	.supports_op = zynq_qspi_supports_op,
 	.exec_op = zynq_qspi_exec_mem_op,
+	.dirmap_create = zynq_qspi_dirmap_create,
+	.dirmap_read = zynq_qspi_dirmap_read,
 };
 
 /**
@@ -700,6 +803,7 @@ static int zynq_qspi_probe(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct device_node *np = dev->of_node;
 	struct zynq_qspi *xqspi;
+	struct resource *res;
 	u32 num_cs;
 
 	ctlr = spi_alloc_master(&pdev->dev, sizeof(*xqspi));
@@ -716,6 +820,18 @@ static int zynq_qspi_probe(struct platform_device *pdev)
 		goto remove_master;
 	}
 
+	/* Optional linear mode window, used for direct mappings */
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+	if (res) {
+		xqspi->linear = devm_ioremap(dev, res->start,
+					     resource_size(res));
+		if (!xqspi->linear) {
+			ret = -ENOMEM;
+			goto remove_master;
+		}
+		xqspi->linear_size = resource_size(res);
+	}
+
 	xqspi->pclk = devm_clk_get(&pdev->dev, "pclk");
 	if (IS_ERR(xqspi->pclk)) {
 		dev_err(&pdev->dev, "pclk clock not found.\n");
@@ -134,6 +134,8 @@
 #define GQSPI_SELECT_MODE_DUALSPI	0x2
 #define GQSPI_SELECT_MODE_QUADSPI	0x4
 #define GQSPI_DMA_UNALIGN		0x3
+/* Size of the DMA bounce buffer for reads that cannot be DMAed in place */
+#define GQSPI_BOUNCE_SIZE		SZ_64K
 #define GQSPI_DEFAULT_NUM_CS	1	/* Default number of chip selects */
 
 #define GQSPI_MAX_NUM_CS	2	/* Maximum number of chip selects */
@@ -193,6 +195,9 @@ struct qspi_platform_data {
  * @speed_hz:          Current SPI bus clock speed in hz
  * @has_tapdelay:	Used for tapdelay register available in qspi
  * @is_parallel:		Used for multi CS support
+ * @bounce_buf:		DMA bounce buffer, NULL if it could not be allocated
+ * @bounce_dma:		DMA address of @bounce_buf
+ * @bounce:		The current read is DMAed into @bounce_buf
  */
 struct zynqmp_qspi {
 	struct spi_controller *ctlr;
@@ -217,6 +222,9 @@ struct zynqmp_qspi {
 	bool io_mode;
 	bool has_tapdelay;
 	bool is_parallel;
+	void *bounce_buf;
+	dma_addr_t bounce_dma;
+	bool bounce;
 };
 
 /**
@@ -816,8 +824,9 @@ static void zynqmp_process_dma_irq(struct zynqmp_qspi *xqspi)
 {
 	u32 config_reg, genfifoentry;
 
-	dma_unmap_single(xqspi->dev, xqspi->dma_addr,
-			 xqspi->dma_rx_bytes, DMA_FROM_DEVICE);
+	if (!xqspi->bounce)
+		dma_unmap_single(xqspi->dev, xqspi->dma_addr,
+				 xqspi->dma_rx_bytes, DMA_FROM_DEVICE);
 	xqspi->rxbuf += xqspi->dma_rx_bytes;
 	xqspi->bytes_to_receive -= xqspi->dma_rx_bytes;
 	xqspi->dma_rx_bytes = 0;
@@ -924,27 +933,37 @@ static int zynqmp_qspi_setuprxdma(struct zynqmp_qspi *xqspi)
 	u32 rx_bytes, rx_rem, config_reg;
 	dma_addr_t addr;
 	u64 dma_align =  (u64)(uintptr_t)xqspi->rxbuf;
+	bool in_place;
 
-	if ((xqspi->bytes_to_receive < 8 || xqspi->io_mode) ||
-	    ((dma_align & GQSPI_DMA_UNALIGN) != 0x0) ||
-	    is_vmalloc_addr(xqspi->rxbuf)) {
-		/* Setting to IO mode */
-		config_reg = zynqmp_gqspi_read(xqspi, GQSPI_CONFIG_OFST);
-		config_reg &= ~GQSPI_CFG_MODE_EN_MASK;
-		zynqmp_gqspi_write(xqspi, GQSPI_CONFIG_OFST, config_reg);
-		xqspi->mode = GQSPI_MODE_IO;
-		xqspi->dma_rx_bytes = 0;
-		return 0;
-	}
-
+	xqspi->bounce = false;
+	in_place = !(dma_align & GQSPI_DMA_UNALIGN) &&
+		   !is_vmalloc_addr(xqspi->rxbuf);
 	rx_rem = xqspi->bytes_to_receive % 4;
+
+	if (xqspi->bytes_to_receive < 8 || xqspi->io_mode)
+		goto io_mode;
+
 	rx_bytes = (xqspi->bytes_to_receive - rx_rem);
 
-	addr = dma_map_single(xqspi->dev, (void *)xqspi->rxbuf,
-			      rx_bytes, DMA_FROM_DEVICE);
-	if (dma_mapping_error(xqspi->dev, addr)) {
-		dev_err(xqspi->dev, "ERR:rxdma:memory not mapped\n");
-		return -ENOMEM;
+	if (!in_place && xqspi->bounce_buf &&
+	    xqspi->bytes_to_receive <= GQSPI_BOUNCE_SIZE) {
+		/*
+		 * DMA the words into the bounce buffer rather than reading the
+		 * whole buffer through the RX FIFO. As for in place DMA, the
+		 * 1 to 3 byte tail is read through the RX FIFO straight into
+		 * the buffer, only the exact length is clocked on the bus.
+		 */
+		addr = xqspi->bounce_dma;
+		xqspi->bounce = true;
+	} else if (in_place) {
+		addr = dma_map_single(xqspi->dev, (void *)xqspi->rxbuf,
+				      rx_bytes, DMA_FROM_DEVICE);
+		if (dma_mapping_error(xqspi->dev, addr)) {
+			dev_err(xqspi->dev, "ERR:rxdma:memory not mapped\n");
+			return -ENOMEM;
+		}
+	} else {
+		goto io_mode;
 	}
 
 	xqspi->dma_rx_bytes = rx_bytes;
@@ -968,6 +987,15 @@ static int zynqmp_qspi_setuprxdma(struct zynqmp_qspi *xqspi)
 	zynqmp_gqspi_write(xqspi, GQSPI_QSPIDMA_DST_SIZE_OFST, rx_bytes);
 
 	return 0;
+
+io_mode:
+	/* Setting to IO mode */
+	config_reg = zynqmp_gqspi_read(xqspi, GQSPI_CONFIG_OFST);
+	config_reg &= ~GQSPI_CFG_MODE_EN_MASK;
+	zynqmp_gqspi_write(xqspi, GQSPI_CONFIG_OFST, config_reg);
+	xqspi->mode = GQSPI_MODE_IO;
+	xqspi->dma_rx_bytes = 0;
+	return 0;
 }
 
 /**
@@ -1170,13 +1198,19 @@ static int zynqmp_qspi_exec_op(struct spi_mem *mem,
 		zynqmp_gqspi_write(xqspi, GQSPI_CONFIG_OFST,
 				   zynqmp_gqspi_read(xqspi, GQSPI_CONFIG_OFST) |
 				   GQSPI_CFG_START_GEN_FIFO_MASK);
-		zynqmp_gqspi_write(xqspi, GQSPI_IER_OFST,
-				   GQSPI_IER_GENFIFOEMPTY_MASK |
-				   GQSPI_IER_TXNOT_FULL_MASK);
-		if (!wait_for_completion_timeout
-		    (&xqspi->data_completion, msecs_to_jiffies(1000))) {
-			err = -ETIMEDOUT;
-			goto return_err;
+		/*
+		 * The opcode is already in the TX FIFO, so an address phase
+		 * can be queued behind it right away and waited for instead.
+		 */
+		if (!op->addr.nbytes) {
+			zynqmp_gqspi_write(xqspi, GQSPI_IER_OFST,
+					   GQSPI_IER_GENFIFOEMPTY_MASK |
+					   GQSPI_IER_TXNOT_FULL_MASK);
+			if (!wait_for_completion_timeout
+			    (&xqspi->data_completion, msecs_to_jiffies(1000))) {
+				err = -ETIMEDOUT;
+				goto return_err;
+			}
 		}
 	}
 
@@ -1296,6 +1330,13 @@ static int zynqmp_qspi_exec_op(struct spi_mem *mem,
 		    (&xqspi->data_completion, msecs_to_jiffies(ms)))
 			err = -ETIMEDOUT;
 
+		if (op->data.dir == SPI_MEM_DATA_IN && xqspi->bounce) {
+			/* The tail, if any, was read in place from the FIFO */
+			if (!err)
+				memcpy(op->data.buf.in, xqspi->bounce_buf,
+				       round_down(op->data.nbytes, 4));
+			xqspi->bounce = false;
+		}
 	}
 
 return_err:
@@ -1333,8 +1374,86 @@ static const struct of_device_id zynqmp_qspi_of_match[] = {
 	{ /* End of table */ }
 };
 
+/**
+ * zynqmp_qspi_adjust_op_size - Split reads to fit the DMA bounce buffer
+ * @mem: The SPI memory
+ * @op: The memory operation to adjust
+ *
+ * Reads into buffers that cannot be DMAed in place, such as vmalloc()ed
+ * ones, go through the bounce buffer, so they are split into chunks of its
+ * size rather than being read through the RX FIFO.
+ *
+ * Return: Always 0
+ */
+static int zynqmp_qspi_adjust_op_size(struct spi_mem *mem,
+				      struct spi_mem_op *op)
+{
+	struct zynqmp_qspi *xqspi = spi_controller_get_devdata
+				    (mem->spi->master);
+	u64 dma_align = (u64)(uintptr_t)op->data.buf.in;
+
+	if (op->data.dir != SPI_MEM_DATA_IN || !xqspi->bounce_buf ||
+	    xqspi->io_mode)
+		return 0;
+
+	if ((dma_align & GQSPI_DMA_UNALIGN) ||
+	    is_vmalloc_addr(op->data.buf.in))
+		op->data.nbytes = min_t(unsigned int, op->data.nbytes,
+					GQSPI_BOUNCE_SIZE);
+
+	return 0;
+}
+
+/**
+ * zynqmp_qspi_dirmap_create - Set up a direct mapping
+ * @desc: Direct mapping descriptor
+ *
+ * Only reads are mapped. Their template was checked when the mapping was
+ * created, so each read is issued straight from it.
+ *
+ * Return: 0 for read mappings, -EOPNOTSUPP otherwise.
+ */
+static int zynqmp_qspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	if (desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
+/**
+ * zynqmp_qspi_dirmap_read - Read from a direct mapping
+ * @desc: Direct mapping descriptor
+ * @offs: Offset of the data in the mapping
+ * @len: Number of bytes to read
+ * @buf: Destination buffer
+ *
+ * The read goes out as a single operation, DMAed in place or through the
+ * bounce buffer, which then bounds it.
+ *
+ * Return: Number of bytes read, a negative error code otherwise.
+ */
+static ssize_t zynqmp_qspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				       u64 offs, size_t len, void *buf)
+{
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int err;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.buf.in = buf;
+	op.data.nbytes = len;
+	zynqmp_qspi_adjust_op_size(desc->mem, &op);
+
+	err = zynqmp_qspi_exec_op(desc->mem, &op);
+
+	return err ? err : op.data.nbytes;
+}
+
 static const struct spi_controller_mem_ops zynqmp_qspi_mem_ops = {
+	.adjust_op_size = zynqmp_qspi_adjust_op_size,
 	.exec_op = zynqmp_qspi_exec_op,
+	.dirmap_create = zynqmp_qspi_dirmap_create,
+	.dirmap_read = zynqmp_qspi_dirmap_read,
 };
 
 /**
@@ -1442,6 +1561,15 @@ static int zynqmp_qspi_probe(struct platform_device *pdev)
 	if (ret)
 		goto clk_dis_all;
 
+	if (!xqspi->io_mode) {
+		xqspi->bounce_buf = dmam_alloc_coherent(&pdev->dev,
+							GQSPI_BOUNCE_SIZE,
+							&xqspi->bounce_dma,
+							GFP_KERNEL);
+		if (!xqspi->bounce_buf)
+			dev_warn(dev, "no DMA bounce buffer, using IO mode for unaligned reads\n");
+	}
+
 	ret = of_property_read_u32(np, "num-cs", &num_cs);
 	if (ret < 0) {
 		ctlr->num_chipselect = GQSPI_DEFAULT_NUM_CS;
@@ -1520,6 +1648,7 @@ static struct platform_driver zynqmp_qspi_driver = {
 		.name = "zynqmp-qspi",
 		.of_match_table = zynqmp_qspi_of_match,
 		.pm = &zynqmp_qspi_dev_pm_ops,
+		.probe_type = PROBE_FORCE_SYNCHRONOUS,
 	},
 };
 
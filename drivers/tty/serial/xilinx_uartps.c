@@ -19,6 +19,7 @@
 #include <linux/clk.h>
 #include <linux/irq.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 #include <linux/of.h>
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
@@ -26,6 +27,8 @@
 #include <linux/gpio/consumer.h>
 #include <linux/delay.h>
 #include <linux/reset.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
 
 #define CDNS_UART_TTY_NAME	"ttyPS"
 #define CDNS_UART_NAME		"xuartps"
@@ -46,6 +49,15 @@ static int rx_timeout = 10;
 module_param(rx_timeout, uint, 0444);
 MODULE_PARM_DESC(rx_timeout, "Rx timeout, 1-255");
 
+/*
+ * Low latency Rx trigger level and timeout, used until the FIFO keeps reaching
+ * the trigger level. The module parameters above are the throughput settings.
+ */
+#define CDNS_UART_RX_LEVEL_LOW	8
+#define CDNS_UART_RX_TOUT_LOW	4
+/* Consecutive Rx trigger interrupts switching to the throughput settings */
+#define CDNS_UART_RX_STREAM	4
+
 /* Register offsets for the UART. */
 #define CDNS_UART_CR		0x00  /* Control Register */
 #define CDNS_UART_MR		0x04  /* Mode Register */
@@ -200,6 +212,19 @@ MODULE_PARM_DESC(rx_timeout, "Rx timeout, 1-255");
  * @rs485_tx_started:	RS485 tx state
  * @tx_timer:		Timer for tx
  * @rstc:		Pointer to the reset control
+ * @rx_chan:		Optional RX DMA channel
+ * @tx_chan:		Optional TX DMA channel
+ * @rx_buf:		RX DMA buffer, one word per character
+ * @tx_buf:		TX DMA buffer, one word per character
+ * @rx_dma:		DMA address of @rx_buf
+ * @tx_dma:		DMA address of @tx_buf
+ * @rx_dma_len:		Number of characters of the RX DMA in flight
+ * @rx_dma_busy:	RX DMA in flight
+ * @tx_dma_busy:	TX DMA in flight
+ * @rx_flush:		Interrupt status to handle by PIO once the RX DMA is done
+ * @rx_level:		Current RX trigger level
+ * @rx_tout:		Current RX timeout
+ * @rx_streak:		Consecutive RX trigger interrupts at the low latency level
  */
 struct cdns_uart {
 	struct uart_port	*port;
@@ -214,6 +239,19 @@ struct cdns_uart {
 	bool			rs485_tx_started;
 	struct hrtimer		tx_timer;
 	struct reset_control	*rstc;
+	struct dma_chan		*rx_chan;
+	struct dma_chan		*tx_chan;
+	u32			*rx_buf;
+	u32			*tx_buf;
+	dma_addr_t		rx_dma;
+	dma_addr_t		tx_dma;
+	unsigned int		rx_dma_len;
+	bool			rx_dma_busy;
+	bool			tx_dma_busy;
+	unsigned int		rx_flush;
+	unsigned int		rx_level;
+	unsigned int		rx_tout;
+	unsigned int		rx_streak;
 };
 struct cdns_platform_data {
 	u32 quirks;
@@ -229,6 +267,107 @@ struct serial_rs485 cdns_rs485_supported = {
 #define to_cdns_uart(_nb) container_of(_nb, struct cdns_uart, \
 		clk_rate_change_nb)
 
+static int cdns_uart_dma_tx_start(struct uart_port *port);
+static void cdns_uart_dma_rx_complete(void *data);
+
+/**
+ * cdns_uart_rx_set_mode - Program the Rx trigger level and timeout
+ * @port: Handle to the uart port structure
+ * @throughput: Use the throughput instead of the low latency settings
+ */
+static void cdns_uart_rx_set_mode(struct uart_port *port, bool throughput)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+
+	if (throughput) {
+		cdns_uart->rx_level = rx_trigger_level;
+		cdns_uart->rx_tout = rx_timeout;
+	} else {
+		cdns_uart->rx_level = min(rx_trigger_level, CDNS_UART_RX_LEVEL_LOW);
+		cdns_uart->rx_tout = min(rx_timeout, CDNS_UART_RX_TOUT_LOW);
+	}
+	cdns_uart->rx_streak = 0;
+
+	writel(cdns_uart->rx_level, port->membase + CDNS_UART_RXWM);
+	writel(cdns_uart->rx_tout, port->membase + CDNS_UART_RXTOUT);
+}
+
+/**
+ * cdns_uart_rx_adapt - Follow the Rx rate with the trigger level and timeout
+ * @port: Handle to the uart port structure
+ * @isrstatus: The interrupt status register value the Rx was handled for
+ *
+ * A stream keeps filling the FIFO up to the trigger level, so moving to the
+ * high level cuts the number of interrupts. A timeout means the stream paused
+ * and the low level gets the next characters to the reader sooner.
+ */
+static void cdns_uart_rx_adapt(struct uart_port *port, unsigned int isrstatus)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+
+	if (cdns_uart->rx_level < rx_trigger_level) {
+		if (!(isrstatus & CDNS_UART_IXR_RXTRIG))
+			cdns_uart->rx_streak = 0;
+		else if (++cdns_uart->rx_streak >= CDNS_UART_RX_STREAM)
+			cdns_uart_rx_set_mode(port, true);
+	} else if (isrstatus & CDNS_UART_IXR_TOUT &&
+		   cdns_uart->rx_level > CDNS_UART_RX_LEVEL_LOW) {
+		cdns_uart_rx_set_mode(port, false);
+	}
+}
+
+/**
+ * cdns_uart_handle_rx_bulk - Receive error free characters as one block
+ * @port: Handle to the uart port structure
+ * @isrstatus: The interrupt status register value as read
+ *
+ * Stops at the first character with an error status, the remaining ones are
+ * handled by cdns_uart_handle_rx().
+ *
+ * Return: the number of characters received
+ */
+static unsigned int cdns_uart_handle_rx_bulk(struct uart_port *port,
+					     unsigned int isrstatus)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+	bool is_rxbs_support = cdns_uart->quirks & CDNS_UART_RXBS_SUPPORT;
+	unsigned int count = 0, avail = 0;
+	u8 buf[CDNS_UART_FIFO_SIZE];
+
+	/* errors, a pending break and sysrq need per character handling */
+	if (isrstatus & (CDNS_UART_IXR_PARITY | CDNS_UART_IXR_FRAMING |
+			 CDNS_UART_IXR_OVERRUN) ||
+	    port->read_status_mask & CDNS_UART_IXR_BRK || uart_console(port))
+		return 0;
+
+	/* at the trigger level that many characters need no status check */
+	if (readl(port->membase + CDNS_UART_SR) & CDNS_UART_SR_RXTRIG)
+		avail = cdns_uart->rx_level;
+
+	while (count < CDNS_UART_FIFO_SIZE) {
+		if (avail)
+			avail--;
+		else if (readl(port->membase + CDNS_UART_SR) &
+			 CDNS_UART_SR_RXEMPTY)
+			break;
+
+		if (is_rxbs_support &&
+		    readl(port->membase + CDNS_UART_RXBS) &
+		    (CDNS_UART_RXBS_PARITY | CDNS_UART_RXBS_FRAMING |
+		     CDNS_UART_RXBS_BRK))
+			break;
+
+		buf[count++] = readl(port->membase + CDNS_UART_FIFO);
+	}
+
+	if (count) {
+		tty_insert_flip_string(&port->state->port, buf, count);
+		port->icount.rx += count;
+	}
+
+	return count;
+}
+
 /**
  * cdns_uart_handle_rx - Handle the received bytes along with Rx errors.
  * @dev_id: Id of the UART port
@@ -248,6 +387,9 @@ static void cdns_uart_handle_rx(void *dev_id, unsigned int isrstatus)
 
 	is_rxbs_support = cdns_uart->quirks & CDNS_UART_RXBS_SUPPORT;
 
+	cdns_uart_rx_adapt(port, isrstatus);
+	cdns_uart_handle_rx_bulk(port, isrstatus);
+
 	while ((readl(port->membase + CDNS_UART_SR) &
 		CDNS_UART_SR_RXEMPTY) != CDNS_UART_SR_RXEMPTY) {
 		if (is_rxbs_support)
@@ -431,12 +573,20 @@ static void cdns_uart_handle_tx(void *dev_id)
 	struct circ_buf *xmit = &port->state->xmit;
 	unsigned int numbytes;
 
+	/* The DMA completion refills the FIFO */
+	if (cdns_uart->tx_dma_busy)
+		return;
+
 	if (uart_circ_empty(xmit) || uart_tx_stopped(port)) {
 		/* Disable the TX Empty interrupt */
 		writel(CDNS_UART_IXR_TXEMPTY, port->membase + CDNS_UART_IDR);
 		return;
 	}
 
+	if (cdns_uart->tx_chan && !(port->rs485.flags & SER_RS485_ENABLED) &&
+	    !cdns_uart_dma_tx_start(port))
+		return;
+
 	numbytes = port->fifosize;
 	while (numbytes && !uart_circ_empty(xmit) &&
 	       !(readl(port->membase + CDNS_UART_SR) & CDNS_UART_SR_TXFULL)) {
@@ -460,6 +610,306 @@ static void cdns_uart_handle_tx(void *dev_id)
 	}
 }
 
+/**
+ * cdns_uart_dma_rx_start - Move a trigger level worth of characters by DMA
+ * @port: Handle to the uart port structure
+ *
+ * The controller has no DMA request lines, so a transfer is only started once
+ * the RX trigger interrupt guarantees that the FIFO holds the current trigger
+ * level worth of characters. The RX trigger interrupt stays masked until the DMA is done.
+ *
+ * Return: 0 on success, negative errno otherwise
+ */
+static int cdns_uart_dma_rx_start(struct uart_port *port)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+	struct dma_async_tx_descriptor *desc;
+	unsigned int len = clamp_t(unsigned int, cdns_uart->rx_level, 1,
+				   CDNS_UART_FIFO_SIZE);
+
+	desc = dmaengine_prep_slave_single(cdns_uart->rx_chan, cdns_uart->rx_dma,
+					   len * sizeof(u32), DMA_DEV_TO_MEM,
+					   DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = cdns_uart_dma_rx_complete;
+	desc->callback_param = port;
+	if (dma_submit_error(dmaengine_submit(desc)))
+		return -EIO;
+
+	writel(CDNS_UART_IXR_RXTRIG, port->membase + CDNS_UART_IDR);
+	cdns_uart->rx_dma_len = len;
+	cdns_uart->rx_dma_busy = true;
+	dma_async_issue_pending(cdns_uart->rx_chan);
+
+	return 0;
+}
+
+/**
+ * cdns_uart_dma_rx_complete - RX DMA completion callback
+ * @data: Handle to the uart port structure
+ */
+static void cdns_uart_dma_rx_complete(void *data)
+{
+	struct uart_port *port = data;
+	struct cdns_uart *cdns_uart = port->private_data;
+	struct tty_port *tport = &port->state->port;
+	unsigned int i, isrstatus;
+	unsigned long flags;
+	size_t count;
+	u8 *chars;
+
+	spin_lock_irqsave(&port->lock, flags);
+
+	/* terminated by set_termios or shutdown */
+	if (!cdns_uart->rx_dma_busy) {
+		spin_unlock_irqrestore(&port->lock, flags);
+		return;
+	}
+	cdns_uart->rx_dma_busy = false;
+
+	count = tty_prepare_flip_string(tport, &chars, cdns_uart->rx_dma_len);
+	for (i = 0; i < count; i++)
+		chars[i] = cdns_uart->rx_buf[i];
+	port->icount.rx += cdns_uart->rx_dma_len;
+	port->icount.buf_overrun += cdns_uart->rx_dma_len - count;
+
+	/*
+	 * Errors and the timeout tail seen while the DMA was running are
+	 * handled character by character, after the DMAed data.
+	 */
+	isrstatus = cdns_uart->rx_flush;
+	cdns_uart->rx_flush = 0;
+	if (isrstatus) {
+		cdns_uart_handle_rx(port, isrstatus);
+	} else {
+		tty_flip_buffer_push(tport);
+		cdns_uart_rx_adapt(port, CDNS_UART_IXR_RXTRIG);
+		if ((readl(port->membase + CDNS_UART_SR) & CDNS_UART_SR_RXTRIG) &&
+		    !cdns_uart_dma_rx_start(port))
+			goto out;
+	}
+
+	writel(CDNS_UART_IXR_RXTRIG, port->membase + CDNS_UART_IER);
+out:
+	spin_unlock_irqrestore(&port->lock, flags);
+}
+
+/**
+ * cdns_uart_dma_rx_stop - Abort the RX DMA in flight
+ * @port: Handle to the uart port structure
+ */
+static void cdns_uart_dma_rx_stop(struct uart_port *port)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+
+	if (!cdns_uart->rx_dma_busy)
+		return;
+
+	dmaengine_terminate_async(cdns_uart->rx_chan);
+	cdns_uart->rx_dma_busy = false;
+	cdns_uart->rx_flush = 0;
+}
+
+/**
+ * cdns_uart_dma_rx - Handle the RX interrupts of a port doing DMA
+ * @port: Handle to the uart port structure
+ * @isrstatus: The interrupt status register value as read
+ */
+static void cdns_uart_dma_rx(struct uart_port *port, unsigned int isrstatus)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+
+	if (cdns_uart->rx_dma_busy) {
+		cdns_uart->rx_flush |= isrstatus;
+		return;
+	}
+
+	/* errors, breaks and the timeout tail need per character handling */
+	if (isrstatus != CDNS_UART_IXR_RXTRIG ||
+	    (port->read_status_mask & CDNS_UART_IXR_BRK) ||
+	    cdns_uart_dma_rx_start(port))
+		cdns_uart_handle_rx(port, isrstatus);
+}
+
+/**
+ * cdns_uart_dma_tx_complete - TX DMA completion callback
+ * @data: Handle to the uart port structure
+ */
+static void cdns_uart_dma_tx_complete(void *data)
+{
+	struct uart_port *port = data;
+	struct cdns_uart *cdns_uart = port->private_data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->lock, flags);
+
+	if (!cdns_uart->tx_dma_busy) {
+		spin_unlock_irqrestore(&port->lock, flags);
+		return;
+	}
+	cdns_uart->tx_dma_busy = false;
+
+	/* refill now if the FIFO already drained, else on TX empty */
+	writel(CDNS_UART_IXR_TXEMPTY, port->membase + CDNS_UART_ISR);
+	if (readl(port->membase + CDNS_UART_SR) & CDNS_UART_SR_TXEMPTY)
+		cdns_uart_handle_tx(port);
+	else
+		writel(CDNS_UART_IXR_TXEMPTY, port->membase + CDNS_UART_IER);
+
+	spin_unlock_irqrestore(&port->lock, flags);
+}
+
+/**
+ * cdns_uart_dma_tx_start - Move up to a FIFO worth of characters by DMA
+ * @port: Handle to the uart port structure
+ *
+ * Without DMA request lines a transfer can only be started into an empty
+ * FIFO, which then takes port->fifosize characters.
+ *
+ * Return: 0 on success, negative errno otherwise
+ */
+static int cdns_uart_dma_tx_start(struct uart_port *port)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+	struct circ_buf *xmit = &port->state->xmit;
+	struct dma_async_tx_descriptor *desc;
+	unsigned int i, count;
+
+	if (!(readl(port->membase + CDNS_UART_SR) & CDNS_UART_SR_TXEMPTY))
+		return -EBUSY;
+
+	count = min_t(unsigned int, uart_circ_chars_pending(xmit),
+		      port->fifosize);
+	for (i = 0; i < count; i++)
+		cdns_uart->tx_buf[i] =
+			xmit->buf[(xmit->tail + i) & (UART_XMIT_SIZE - 1)];
+
+	desc = dmaengine_prep_slave_single(cdns_uart->tx_chan, cdns_uart->tx_dma,
+					   count * sizeof(u32), DMA_MEM_TO_DEV,
+					   DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = cdns_uart_dma_tx_complete;
+	desc->callback_param = port;
+	if (dma_submit_error(dmaengine_submit(desc)))
+		return -EIO;
+
+	writel(CDNS_UART_IXR_TXEMPTY, port->membase + CDNS_UART_IDR);
+	cdns_uart->tx_dma_busy = true;
+	dma_async_issue_pending(cdns_uart->tx_chan);
+
+	uart_xmit_advance(port, count);
+	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS)
+		uart_write_wakeup(port);
+
+	return 0;
+}
+
+/**
+ * cdns_uart_dma_request - Request one optional DMA channel
+ * @port: Handle to the uart port structure
+ * @name: Name of the channel
+ * @dir: Direction of the channel
+ * @buf: Returns the coherent buffer of the channel
+ * @dma: Returns the DMA address of @buf
+ *
+ * Return: the channel, NULL when the port uses PIO in that direction
+ */
+static struct dma_chan *cdns_uart_dma_request(struct uart_port *port,
+					      const char *name,
+					      enum dma_transfer_direction dir,
+					      u32 **buf, dma_addr_t *dma)
+{
+	struct dma_slave_config config = {
+		.direction = dir,
+		.src_addr = port->mapbase + CDNS_UART_FIFO,
+		.dst_addr = port->mapbase + CDNS_UART_FIFO,
+		.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES,
+		.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES,
+		.src_maxburst = 1,
+		.dst_maxburst = 1,
+	};
+	struct dma_chan *chan;
+
+	chan = dma_request_chan(port->dev, name);
+	if (IS_ERR(chan))
+		return NULL;
+
+	if (dmaengine_slave_config(chan, &config))
+		goto err_release;
+
+	*buf = dma_alloc_coherent(chan->device->dev,
+				  CDNS_UART_FIFO_SIZE * sizeof(u32), dma,
+				  GFP_KERNEL);
+	if (!*buf)
+		goto err_release;
+
+	return chan;
+
+err_release:
+	dma_release_channel(chan);
+	return NULL;
+}
+
+/**
+ * cdns_uart_dma_init - Set up the optional RX and TX DMA channels
+ * @port: Handle to the uart port structure
+ *
+ * The console keeps using PIO so that sysrq and early output work.
+ */
+static void cdns_uart_dma_init(struct uart_port *port)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+
+	if (uart_console(port))
+		return;
+
+	cdns_uart->rx_chan = cdns_uart_dma_request(port, "rx", DMA_DEV_TO_MEM,
+						   &cdns_uart->rx_buf,
+						   &cdns_uart->rx_dma);
+	cdns_uart->tx_chan = cdns_uart_dma_request(port, "tx", DMA_MEM_TO_DEV,
+						   &cdns_uart->tx_buf,
+						   &cdns_uart->tx_dma);
+	if (cdns_uart->rx_chan || cdns_uart->tx_chan)
+		dev_dbg(port->dev, "using DMA for%s%s\n",
+			cdns_uart->rx_chan ? " rx" : "",
+			cdns_uart->tx_chan ? " tx" : "");
+}
+
+/**
+ * cdns_uart_dma_release - Release the DMA channels
+ * @port: Handle to the uart port structure
+ */
+static void cdns_uart_dma_release(struct uart_port *port)
+{
+	struct cdns_uart *cdns_uart = port->private_data;
+
+	if (cdns_uart->rx_chan) {
+		dmaengine_terminate_sync(cdns_uart->rx_chan);
+		dma_free_coherent(cdns_uart->rx_chan->device->dev,
+				  CDNS_UART_FIFO_SIZE * sizeof(u32),
+				  cdns_uart->rx_buf, cdns_uart->rx_dma);
+		dma_release_channel(cdns_uart->rx_chan);
+		cdns_uart->rx_chan = NULL;
+	}
+
+	if (cdns_uart->tx_chan) {
+		dmaengine_terminate_sync(cdns_uart->tx_chan);
+		dma_free_coherent(cdns_uart->tx_chan->device->dev,
+				  CDNS_UART_FIFO_SIZE * sizeof(u32),
+				  cdns_uart->tx_buf, cdns_uart->tx_dma);
+		dma_release_channel(cdns_uart->tx_chan);
+		cdns_uart->tx_chan = NULL;
+	}
+
+	cdns_uart->rx_dma_busy = false;
+	cdns_uart->tx_dma_busy = false;
+	cdns_uart->rx_flush = 0;
+}
+
 /**
  * cdns_uart_isr - Interrupt handler
  * @irq: Irq number
@@ -470,6 +920,7 @@ static void cdns_uart_handle_tx(void *dev_id)
 static irqreturn_t cdns_uart_isr(int irq, void *dev_id)
 {
 	struct uart_port *port = (struct uart_port *)dev_id;
+	struct cdns_uart *cdns_uart = port->private_data;
 	unsigned int isrstatus;
 
 	spin_lock(&port->lock);
@@ -492,8 +943,12 @@ static irqreturn_t cdns_uart_isr(int irq, void *dev_id)
 	 * as read bytes will not be removed from the FIFO.
 	 */
 	if (isrstatus & CDNS_UART_IXR_RXMASK &&
-	    !(readl(port->membase + CDNS_UART_CR) & CDNS_UART_CR_RX_DIS))
-		cdns_uart_handle_rx(dev_id, isrstatus);
+	    !(readl(port->membase + CDNS_UART_CR) & CDNS_UART_CR_RX_DIS)) {
+		if (cdns_uart->rx_chan)
+			cdns_uart_dma_rx(port, isrstatus);
+		else
+			cdns_uart_handle_rx(dev_id, isrstatus);
+	}
 
 	spin_unlock(&port->lock);
 	return IRQ_HANDLED;
@@ -675,7 +1130,7 @@ static int cdns_uart_clk_notifier_cb(struct notifier_block *nb,
 		 * enable bit and RX enable bit to enable the transmitter and
 		 * receiver.
 		 */
-		writel(rx_timeout, port->membase + CDNS_UART_RXTOUT);
+		writel(cdns_uart->rx_tout, port->membase + CDNS_UART_RXTOUT);
 		ctrl_reg = readl(port->membase + CDNS_UART_CR);
 		ctrl_reg &= ~(CDNS_UART_CR_TX_DIS | CDNS_UART_CR_RX_DIS);
 		ctrl_reg |= CDNS_UART_CR_TX_EN | CDNS_UART_CR_RX_EN;
@@ -816,6 +1271,7 @@ static void cdns_uart_set_termios(struct uart_port *port,
 				  struct ktermios *termios,
 				  const struct ktermios *old)
 {
+	struct cdns_uart *cdns_uart = port->private_data;
 	u32 cval = 0;
 	unsigned int baud, minbaud, maxbaud;
 	unsigned long flags;
@@ -823,6 +1279,9 @@ static void cdns_uart_set_termios(struct uart_port *port,
 
 	spin_lock_irqsave(&port->lock, flags);
 
+	/* the FIFO reset below would hand the RX DMA stale words */
+	cdns_uart_dma_rx_stop(port);
+
 	/* Disable the TX and RX to set baud rate */
 	ctrl_reg = readl(port->membase + CDNS_UART_CR);
 	ctrl_reg |= CDNS_UART_CR_TX_DIS | CDNS_UART_CR_RX_DIS;
@@ -862,7 +1321,10 @@ static void cdns_uart_set_termios(struct uart_port *port,
 	ctrl_reg |= CDNS_UART_CR_TX_EN | CDNS_UART_CR_RX_EN;
 	writel(ctrl_reg, port->membase + CDNS_UART_CR);
 
-	writel(rx_timeout, port->membase + CDNS_UART_RXTOUT);
+	writel(cdns_uart->rx_tout, port->membase + CDNS_UART_RXTOUT);
+
+	if (cdns_uart->rx_chan)
+		writel(CDNS_UART_IXR_RXTRIG, port->membase + CDNS_UART_IER);
 
 	port->read_status_mask = CDNS_UART_IXR_TXEMPTY | CDNS_UART_IXR_RXTRIG |
 			CDNS_UART_IXR_OVERRUN | CDNS_UART_IXR_TOUT;
@@ -991,16 +1453,10 @@ static int cdns_uart_startup(struct uart_port *port)
 		port->membase + CDNS_UART_MR);
 
 	/*
-	 * Set the RX FIFO Trigger level to use most of the FIFO, but it
-	 * can be tuned with a module parameter
+	 * Start with the low latency RX FIFO trigger level and timeout, the
+	 * throughput ones used for streams can be tuned with module parameters
 	 */
-	writel(rx_trigger_level, port->membase + CDNS_UART_RXWM);
-
-	/*
-	 * Receive Timeout register is enabled but it
-	 * can be tuned with a module parameter
-	 */
-	writel(rx_timeout, port->membase + CDNS_UART_RXTOUT);
+	cdns_uart_rx_set_mode(port, false);
 
 	/* Clear out any pending interrupts before enabling them */
 	writel(readl(port->membase + CDNS_UART_ISR),
@@ -1008,10 +1464,13 @@ static int cdns_uart_startup(struct uart_port *port)
 
 	spin_unlock_irqrestore(&port->lock, flags);
 
+	cdns_uart_dma_init(port);
+
 	ret = request_irq(port->irq, cdns_uart_isr, 0, CDNS_UART_NAME, port);
 	if (ret) {
 		dev_err(port->dev, "request_irq '%d' failed with %d\n",
 			port->irq, ret);
+		cdns_uart_dma_release(port);
 		return ret;
 	}
 
@@ -1052,6 +1511,8 @@ static void cdns_uart_shutdown(struct uart_port *port)
 	spin_unlock_irqrestore(&port->lock, flags);
 
 	free_irq(port->irq, port);
+
+	cdns_uart_dma_release(port);
 }
 
 /**
@@ -1371,6 +1832,9 @@ static struct uart_port *console_port;
  * @co: Console handle
  * @s: Pointer to character array
  * @count: No of characters
+ *
+ * Also used as the atomic write callback, i.e. in panic and while the
+ * printer thread is not running.
  */
 static void cdns_uart_console_write(struct console *co, const char *s,
 				unsigned int count)
@@ -1411,6 +1875,62 @@ static void cdns_uart_console_write(struct console *co, const char *s,
 		spin_unlock_irqrestore(&port->lock, flags);
 }
 
+/**
+ * cdns_uart_console_write_thread - write from the console printer thread
+ * @co: Console handle
+ * @s: Pointer to character array
+ * @count: No of characters
+ *
+ * The port lock is only held while filling the TX FIFO. Waiting for the
+ * FIFO to drain is done with the lock dropped and interrupts enabled,
+ * sleeping in between polls.
+ */
+static void cdns_uart_console_write_thread(struct console *co, const char *s,
+					   unsigned int count)
+{
+	struct uart_port *port = console_port;
+	unsigned int imr, ctrl, status;
+	bool cr_sent = false;
+	unsigned long flags;
+	unsigned int i = 0;
+
+	while (i < count) {
+		if (readl_poll_timeout(port->membase + CDNS_UART_SR, status,
+				       status & CDNS_UART_SR_TXEMPTY,
+				       100, TX_TIMEOUT))
+			dev_warn_ratelimited(port->dev,
+					     "timeout waiting for TX fifo\n");
+
+		spin_lock_irqsave(&port->lock, flags);
+
+		imr = readl(port->membase + CDNS_UART_IMR);
+		writel(imr, port->membase + CDNS_UART_IDR);
+
+		ctrl = readl(port->membase + CDNS_UART_CR);
+		ctrl &= ~CDNS_UART_CR_TX_DIS;
+		ctrl |= CDNS_UART_CR_TX_EN;
+		writel(ctrl, port->membase + CDNS_UART_CR);
+
+		while (i < count &&
+		       !(readl(port->membase + CDNS_UART_SR) & CDNS_UART_SR_TXFULL)) {
+			if (s[i] == '\n' && !cr_sent) {
+				writel('\r', port->membase + CDNS_UART_FIFO);
+				cr_sent = true;
+				continue;
+			}
+			writel(s[i++], port->membase + CDNS_UART_FIFO);
+			cr_sent = false;
+		}
+
+		writel(imr, port->membase + CDNS_UART_IER);
+
+		spin_unlock_irqrestore(&port->lock, flags);
+	}
+
+	readl_poll_timeout(port->membase + CDNS_UART_SR, status,
+			   status & CDNS_UART_SR_TXEMPTY, 100, TX_TIMEOUT);
+}
+
 /**
  * cdns_uart_console_setup - Initialize the uart to default config
  * @co: Console handle
@@ -1450,9 +1970,11 @@ static int cdns_uart_console_setup(struct console *co, char *options)
 static struct console cdns_uart_console = {
 	.name	= CDNS_UART_TTY_NAME,
 	.write	= cdns_uart_console_write,
+	.write_atomic = cdns_uart_console_write,
+	.write_thread = cdns_uart_console_write_thread,
 	.device	= uart_console_device,
 	.setup	= cdns_uart_console_setup,
-	.flags	= CON_PRINTBUFFER,
+	.flags	= CON_PRINTBUFFER | CON_NBCON,
 	.index	= -1, /* Specified on the cmdline (e.g. console=ttyPS ) */
 	.data	= &cdns_uart_uart_driver,
 };
@@ -1534,7 +2056,7 @@ static int cdns_uart_resume(struct device *device)
 			cpu_relax();
 
 		/* restore rx timeout value */
-		writel(rx_timeout, port->membase + CDNS_UART_RXTOUT);
+		writel(cdns_uart->rx_tout, port->membase + CDNS_UART_RXTOUT);
 		/* Enable Tx/Rx */
 		ctrl_reg = readl(port->membase + CDNS_UART_CR);
 		ctrl_reg &= ~(CDNS_UART_CR_TX_DIS | CDNS_UART_CR_RX_DIS);
@@ -1547,7 +2069,7 @@ static int cdns_uart_resume(struct device *device)
 	} else {
 		spin_lock_irqsave(&port->lock, flags);
 		/* restore original rx trigger level */
-		writel(rx_trigger_level, port->membase + CDNS_UART_RXWM);
+		writel(cdns_uart->rx_level, port->membase + CDNS_UART_RXWM);
 		/* enable RX timeout interrupt */
 		writel(CDNS_UART_IXR_TOUT, port->membase + CDNS_UART_IER);
 		spin_unlock_irqrestore(&port->lock, flags);
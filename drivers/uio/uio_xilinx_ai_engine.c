@@ -29,6 +29,18 @@ module_param_named(mem_size, xilinx_ai_engine_mem_size, uint, 0444);
 MODULE_PARM_DESC(mem_size,
 		 "Dynamic memory allocation size in bytes (default: 32 MB)");
 
+/**
+ * struct xilinx_ai_engine - AI Engine UIO devices
+ * @uio: UIO device with the register and memory maps and the first interrupt
+ * @event: UIO devices carrying the remaining interrupt lines
+ * @num_events: number of devices in @event
+ */
+struct xilinx_ai_engine {
+	struct platform_device *uio;
+	struct platform_device *event[XILINX_AI_ENGINE_MAX_IRQ - 1];
+	unsigned int num_events;
+};
+
 #ifdef CONFIG_DEBUG_FS
 
 static ssize_t xilinx_ai_engine_debugfs_write(struct file *f,
@@ -189,23 +201,89 @@ static int xilinx_ai_engine_mmap(struct uio_info *info,
 			       vma->vm_page_prot);
 }
 
+/**
+ * xilinx_ai_engine_add_event - Add a UIO device for an interrupt line
+ * @pdev: AI Engine platform device
+ * @irq: interrupt number
+ * @name: UIO device name
+ *
+ * The generic UIO driver handles a single interrupt per device, so each
+ * AI Engine interrupt line beyond the first one gets its own UIO device
+ * without memory maps. Userspace blocks in read() or poll() on it and
+ * re-enables the line by writing 1, instead of polling the tile state.
+ *
+ * Return: the UIO platform device for success, error pointer otherwise.
+ */
+static struct platform_device *
+xilinx_ai_engine_add_event(struct platform_device *pdev, int irq,
+			   const char *name)
+{
+	struct uio_dmem_genirq_pdata pdata = { };
+	struct platform_device *event;
+	int ret;
+
+	event = platform_device_alloc(DRIVER_NAME, PLATFORM_DEVID_AUTO);
+	if (!event)
+		return ERR_PTR(-ENOMEM);
+	event->dev.parent = &pdev->dev;
+
+	pdata.uioinfo.name = name;
+	pdata.uioinfo.version = "devicetree";
+	pdata.uioinfo.irq = irq;
+
+	ret = driver_set_override(&event->dev, &event->driver_override,
+				  "uio_dmem_genirq", strlen("uio_dmem_genirq"));
+	if (ret)
+		goto err_out;
+
+	ret = platform_device_add_data(event, &pdata, sizeof(pdata));
+	if (ret)
+		goto err_out;
+
+	ret = platform_device_add(event);
+	if (ret)
+		goto err_out;
+
+	return event;
+
+err_out:
+	platform_device_put(event);
+	return ERR_PTR(ret);
+}
+
+static void xilinx_ai_engine_remove_events(struct xilinx_ai_engine *aie)
+{
+	while (aie->num_events)
+		platform_device_unregister(aie->event[--aie->num_events]);
+}
+
 static int xilinx_ai_engine_probe(struct platform_device *pdev)
 {
+	struct xilinx_ai_engine *aie;
 	struct platform_device *uio;
 	struct uio_dmem_genirq_pdata *pdata;
-	unsigned int i;
+	unsigned int i, num_irqs = 0;
 	static const char * const interrupt_names[] = { "interrupt0",
 							"interrupt1",
 							"interrupt2",
 							"interrupt3" };
+	int irqs[XILINX_AI_ENGINE_MAX_IRQ];
 	int ret;
 
+	aie = devm_kzalloc(&pdev->dev, sizeof(*aie), GFP_KERNEL);
+	if (!aie)
+		return -ENOMEM;
+
 	uio = platform_device_alloc(DRIVER_NAME, PLATFORM_DEVID_NONE);
 	if (!uio)
 		return -ENOMEM;
-	uio->driver_override = "uio_dmem_genirq";
 	uio->dev.parent = &pdev->dev;
 
+	ret = driver_set_override(&uio->dev, &uio->driver_override,
+				  "uio_dmem_genirq", strlen("uio_dmem_genirq"));
+	if (ret)
+		goto err_out;
+
 	pdata = devm_kzalloc(&pdev->dev, sizeof(*pdata), GFP_KERNEL);
 	if (!pdata) {
 		ret = -ENOMEM;
@@ -221,20 +299,24 @@ static int xilinx_ai_engine_probe(struct platform_device *pdev)
 	for (i = 0; i < MAX_UIO_MAPS; i++)
 		pdata->uioinfo.mem[i].offs = i << PAGE_SHIFT;
 
-	/* TODO: Only one interrupt is supported out of 4 */
 	for (i  = 0; i < XILINX_AI_ENGINE_MAX_IRQ; i++) {
-		ret = platform_get_irq_byname(pdev, interrupt_names[i]);
+		ret = platform_get_irq_byname_optional(pdev,
+						       interrupt_names[i]);
+		if (ret == -EPROBE_DEFER)
+			goto err_out;
 		if (ret >= 0) {
 			dev_info(&pdev->dev, "%s is used", interrupt_names[i]);
-			break;
+			irqs[num_irqs++] = ret;
 		}
 	}
 
-	/* Interrupt is optional */
-	if (ret < 0) {
+	/* Interrupt is optional, the simulated one is only for debugging */
+	if (!num_irqs) {
 		ret = xilinx_ai_engine_simulate_irq(pdev);
 		if (ret < 0)
 			ret = UIO_IRQ_CUSTOM;
+	} else {
+		ret = irqs[0];
 	}
 	pdata->uioinfo.irq = ret;
 
@@ -259,11 +341,35 @@ static int xilinx_ai_engine_probe(struct platform_device *pdev)
 	if (ret)
 		goto err_out;
 	platform_set_drvdata(uio, pdata);
-	platform_set_drvdata(pdev, uio);
+	aie->uio = uio;
+
+	for (i = 1; i < num_irqs; i++) {
+		struct platform_device *event;
+		const char *name;
+
+		name = devm_kasprintf(&pdev->dev, GFP_KERNEL, "%s-event%u",
+				      DRIVER_NAME, i);
+		if (!name) {
+			ret = -ENOMEM;
+			goto err_events;
+		}
+
+		event = xilinx_ai_engine_add_event(pdev, irqs[i], name);
+		if (IS_ERR(event)) {
+			ret = PTR_ERR(event);
+			goto err_events;
+		}
+		aie->event[aie->num_events++] = event;
+	}
+	platform_set_drvdata(pdev, aie);
 
 	dev_info(&pdev->dev, "Xilinx AI Engine UIO driver probed");
 	return 0;
 
+err_events:
+	xilinx_ai_engine_remove_events(aie);
+	platform_device_unregister(uio);
+	uio = NULL;
 err_out:
 	platform_device_put(uio);
 	dev_err(&pdev->dev,
@@ -273,9 +379,10 @@ static int xilinx_ai_engine_probe(struct platform_device *pdev)
 
 static int xilinx_ai_engine_remove(struct platform_device *pdev)
 {
-	struct platform_device *uio = platform_get_drvdata(pdev);
+	struct xilinx_ai_engine *aie = platform_get_drvdata(pdev);
 
-	platform_device_unregister(uio);
+	xilinx_ai_engine_remove_events(aie);
+	platform_device_unregister(aie->uio);
 	of_node_put(pdev->dev.of_node);
 
 	return 0;
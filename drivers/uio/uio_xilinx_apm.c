@@ -10,18 +10,29 @@
  * of AXI bus in the system. Driver maps HW registers and parameters
  * to userspace. Userspace need not clear the interrupt of IP since
  * driver clears the interrupt.
+ *
+ * The driver can also sample the metric counters from a hrtimer into a ring
+ * exported as an additional UIO map, and exposes them as a perf uncore PMU.
  */
 
 #include <linux/clk.h>
+#include <linux/cpuhotplug.h>
+#include <linux/hrtimer.h>
 #include <linux/io.h>
 #include <linux/module.h>
 #include <linux/of.h>
+#include <linux/perf_event.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
 #include <linux/slab.h>
 #include <linux/uio_driver.h>
+#include <linux/vmalloc.h>
+#include <uapi/linux/xilinx-apm.h>
 
+#define XAPM_GCC_HIGH_OFFSET	0x0000  /* Global Clock Counter upper */
+#define XAPM_GCC_LOW_OFFSET	0x0004  /* Global Clock Counter lower */
 #define XAPM_IS_OFFSET		0x0038  /* Interrupt Status Register */
+#define XAPM_MC_OFFSET(n)	(0x0100 + (n) * 0x10) /* Metric Counter n */
 #define DRV_NAME		"xilinxapm_uio"
 #define DRV_VERSION		"1.0"
 #define UIO_DUMMY_MEMSIZE	4096
@@ -29,6 +40,11 @@
 #define XAPM_MODE_PROFILE	2
 #define XAPM_MODE_TRACE		3
 
+/* Sample ring geometry and the accepted sampling periods */
+#define XAPM_RING_SAMPLES	16384
+#define XAPM_PERIOD_MIN_NS	(10 * NSEC_PER_USEC)
+#define XAPM_PERIOD_MAX_NS	NSEC_PER_SEC
+
 /**
  * struct xapm_param - HW parameters structure
  * @mode: Mode in which APM is working
@@ -66,13 +82,36 @@ struct xapm_param {
  * @info: uio_info structure
  * @param: xapm_param structure
  * @regs: IOmapped base address
+ * @dev: Device
+ * @lock: Protects the sampler settings and the ring head
+ * @timer: Sampling timer
+ * @ring: Sample ring shared with userspace
+ * @samples: Samples following @ring
+ * @period: Sampling period, 0 when the sampler is stopped
+ * @counters: Mask of the sampled metric counters
+ * @pmu: perf uncore PMU
+ * @node: CPU hotplug instance
+ * @cpu: CPU the PMU events are counted on
  */
 struct xapm_dev {
 	struct uio_info info;
 	struct xapm_param param;
 	void __iomem *regs;
+	struct device *dev;
+	/* Spinlock to protect the sampler */
+	spinlock_t lock;
+	struct hrtimer timer;
+	struct xapm_sample_ring *ring;
+	struct xapm_sample *samples;
+	u32 period;
+	u32 counters;
+	struct pmu pmu;
+	struct hlist_node node;
+	unsigned int cpu;
 };
 
+#define to_xapm_dev(p)	container_of(p, struct xapm_dev, pmu)
+
 /**
  * xapm_handler - Interrupt handler for APM
  * @irq: IRQ number
@@ -94,6 +133,341 @@ static irqreturn_t xapm_handler(int irq, struct uio_info *info)
 	return IRQ_HANDLED;
 }
 
+static void xapm_sample(struct xapm_dev *xapm)
+{
+	struct xapm_sample_ring *ring = xapm->ring;
+	struct xapm_sample *sample;
+	u32 head = ring->head;
+	u32 hi, lo;
+	int i;
+
+	if (head - READ_ONCE(ring->tail) >= ring->nr_samples)
+		ring->overruns++;
+
+	sample = &xapm->samples[head % ring->nr_samples];
+	sample->timestamp = ktime_get_ns();
+
+	/* Read the upper half again to catch a carry from the lower one */
+	do {
+		hi = readl(xapm->regs + XAPM_GCC_HIGH_OFFSET);
+		lo = readl(xapm->regs + XAPM_GCC_LOW_OFFSET);
+	} while (hi != readl(xapm->regs + XAPM_GCC_HIGH_OFFSET));
+	sample->clock = (u64)hi << 32 | lo;
+
+	for (i = 0; i < XAPM_MAX_COUNTERS; i++)
+		sample->value[i] = xapm->counters & BIT(i) ?
+				   readl(xapm->regs + XAPM_MC_OFFSET(i)) : 0;
+
+	smp_store_release(&ring->head, head + 1);
+}
+
+static enum hrtimer_restart xapm_timer_fn(struct hrtimer *timer)
+{
+	struct xapm_dev *xapm = container_of(timer, struct xapm_dev, timer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+
+	spin_lock_irqsave(&xapm->lock, flags);
+	if (xapm->period) {
+		xapm_sample(xapm);
+		hrtimer_forward_now(timer, ns_to_ktime(xapm->period));
+		ret = HRTIMER_RESTART;
+	}
+	spin_unlock_irqrestore(&xapm->lock, flags);
+
+	return ret;
+}
+
+static ssize_t sample_period_ns_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct xapm_dev *xapm = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(xapm->period));
+}
+
+static ssize_t sample_period_ns_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct xapm_dev *xapm = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 period;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &period);
+	if (ret)
+		return ret;
+	if (period && (period < XAPM_PERIOD_MIN_NS ||
+		       period > XAPM_PERIOD_MAX_NS))
+		return -EINVAL;
+
+	/* Stop first so that a new period takes effect right away */
+	spin_lock_irqsave(&xapm->lock, flags);
+	xapm->period = 0;
+	spin_unlock_irqrestore(&xapm->lock, flags);
+	hrtimer_cancel(&xapm->timer);
+
+	if (period) {
+		spin_lock_irqsave(&xapm->lock, flags);
+		xapm->period = period;
+		xapm->ring->period_ns = period;
+		spin_unlock_irqrestore(&xapm->lock, flags);
+		hrtimer_start(&xapm->timer, ns_to_ktime(period),
+			      HRTIMER_MODE_REL);
+	}
+
+	return count;
+}
+static DEVICE_ATTR_RW(sample_period_ns);
+
+static ssize_t sample_counters_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct xapm_dev *xapm = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "0x%x\n", READ_ONCE(xapm->counters));
+}
+
+static ssize_t sample_counters_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct xapm_dev *xapm = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 counters;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &counters);
+	if (ret)
+		return ret;
+	if (counters >= BIT(min_t(u32, xapm->param.numcounters,
+				  XAPM_MAX_COUNTERS)))
+		return -EINVAL;
+
+	spin_lock_irqsave(&xapm->lock, flags);
+	xapm->counters = counters;
+	xapm->ring->counters = counters;
+	spin_unlock_irqrestore(&xapm->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(sample_counters);
+
+static struct attribute *xapm_attrs[] = {
+	&dev_attr_sample_period_ns.attr,
+	&dev_attr_sample_counters.attr,
+	NULL,
+};
+
+static const struct attribute_group xapm_attr_group = {
+	.attrs = xapm_attrs,
+};
+
+#ifdef CONFIG_PERF_EVENTS
+static enum cpuhp_state xapm_cpuhp_state;
+
+static void xapm_pmu_update(struct perf_event *event)
+{
+	struct xapm_dev *xapm = to_xapm_dev(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = readl(xapm->regs + XAPM_MC_OFFSET(hwc->idx));
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	local64_add((now - prev) & U32_MAX, &event->count);
+}
+
+static int xapm_pmu_event_init(struct perf_event *event)
+{
+	struct xapm_dev *xapm = to_xapm_dev(event->pmu);
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/* The counters are shared by the whole system and cannot interrupt */
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EINVAL;
+	if (event->cpu < 0)
+		return -EINVAL;
+	if (event->attr.config >= min_t(u32, xapm->param.numcounters,
+					XAPM_MAX_COUNTERS))
+		return -EINVAL;
+
+	event->cpu = xapm->cpu;
+	event->hw.idx = event->attr.config;
+
+	return 0;
+}
+
+static void xapm_pmu_start(struct perf_event *event, int flags)
+{
+	struct xapm_dev *xapm = to_xapm_dev(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	local64_set(&hwc->prev_count,
+		    readl(xapm->regs + XAPM_MC_OFFSET(hwc->idx)));
+	hwc->state = 0;
+}
+
+static void xapm_pmu_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	xapm_pmu_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int xapm_pmu_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (flags & PERF_EF_START)
+		xapm_pmu_start(event, flags);
+
+	return 0;
+}
+
+static void xapm_pmu_del(struct perf_event *event, int flags)
+{
+	xapm_pmu_stop(event, PERF_EF_UPDATE);
+}
+
+static ssize_t cpumask_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct xapm_dev *xapm = to_xapm_dev(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(xapm->cpu));
+}
+static DEVICE_ATTR_RO(cpumask);
+
+static struct attribute *xapm_pmu_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static const struct attribute_group xapm_pmu_cpumask_group = {
+	.attrs = xapm_pmu_cpumask_attrs,
+};
+
+PMU_FORMAT_ATTR(counter, "config:0-3");
+
+static struct attribute *xapm_pmu_format_attrs[] = {
+	&format_attr_counter.attr,
+	NULL,
+};
+
+static const struct attribute_group xapm_pmu_format_group = {
+	.name = "format",
+	.attrs = xapm_pmu_format_attrs,
+};
+
+static const struct attribute_group *xapm_pmu_attr_groups[] = {
+	&xapm_pmu_cpumask_group,
+	&xapm_pmu_format_group,
+	NULL,
+};
+
+static int xapm_pmu_offline_cpu(unsigned int cpu, struct hlist_node *node)
+{
+	struct xapm_dev *xapm = hlist_entry_safe(node, struct xapm_dev, node);
+	unsigned int target;
+
+	if (cpu != xapm->cpu)
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target >= nr_cpu_ids)
+		return 0;
+
+	perf_pmu_migrate_context(&xapm->pmu, cpu, target);
+	xapm->cpu = target;
+
+	return 0;
+}
+
+static int xapm_pmu_register(struct xapm_dev *xapm)
+{
+	char *name;
+	int ret;
+
+	name = devm_kasprintf(xapm->dev, GFP_KERNEL, "xapm_%llx",
+			      (u64)xapm->info.mem[0].addr);
+	if (!name)
+		return -ENOMEM;
+
+	xapm->cpu = raw_smp_processor_id();
+	xapm->pmu = (struct pmu) {
+		.module = THIS_MODULE,
+		.parent = xapm->dev,
+		.task_ctx_nr = perf_invalid_context,
+		.capabilities = PERF_PMU_CAP_NO_EXCLUDE,
+		.attr_groups = xapm_pmu_attr_groups,
+		.event_init = xapm_pmu_event_init,
+		.add = xapm_pmu_add,
+		.del = xapm_pmu_del,
+		.start = xapm_pmu_start,
+		.stop = xapm_pmu_stop,
+		.read = xapm_pmu_update,
+	};
+
+	ret = cpuhp_state_add_instance_nocalls(xapm_cpuhp_state, &xapm->node);
+	if (ret)
+		return ret;
+
+	ret = perf_pmu_register(&xapm->pmu, name, -1);
+	if (ret)
+		cpuhp_state_remove_instance_nocalls(xapm_cpuhp_state,
+						    &xapm->node);
+
+	return ret;
+}
+
+static void xapm_pmu_unregister(struct xapm_dev *xapm)
+{
+	perf_pmu_unregister(&xapm->pmu);
+	cpuhp_state_remove_instance_nocalls(xapm_cpuhp_state, &xapm->node);
+}
+
+static int __init xapm_pmu_init(void)
+{
+	int ret;
+
+	ret = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN, "perf/xapm:online",
+				      NULL, xapm_pmu_offline_cpu);
+	if (ret < 0)
+		return ret;
+	xapm_cpuhp_state = ret;
+
+	return 0;
+}
+
+static void xapm_pmu_exit(void)
+{
+	cpuhp_remove_multi_state(xapm_cpuhp_state);
+}
+#else
+static inline int xapm_pmu_register(struct xapm_dev *xapm)
+{
+	return 0;
+}
+
+static inline void xapm_pmu_unregister(struct xapm_dev *xapm) {}
+
+static inline int xapm_pmu_init(void)
+{
+	return 0;
+}
+
+static inline void xapm_pmu_exit(void) {}
+#endif
+
 /**
  * xapm_getprop - Retrieves dts properties to param structure
  * @pdev: Pointer to platform device
@@ -251,6 +625,28 @@ static int xapm_probe(struct platform_device *pdev)
 	xapm->info.mem[1].size = UIO_DUMMY_MEMSIZE;
 	xapm->info.mem[1].memtype = UIO_MEM_LOGICAL;
 
+	xapm->ring = vmalloc_user(PAGE_ALIGN(sizeof(*xapm->ring) +
+					     XAPM_RING_SAMPLES *
+					     sizeof(*xapm->samples)));
+	if (!xapm->ring) {
+		ret = -ENOMEM;
+		goto err_clk_dis;
+	}
+	xapm->samples = (struct xapm_sample *)(xapm->ring + 1);
+	xapm->ring->nr_samples = XAPM_RING_SAMPLES;
+
+	xapm->info.mem[XAPM_SAMPLE_MAP].name = "samples";
+	xapm->info.mem[XAPM_SAMPLE_MAP].addr = (unsigned long)xapm->ring;
+	xapm->info.mem[XAPM_SAMPLE_MAP].size =
+		PAGE_ALIGN(sizeof(*xapm->ring) +
+			   XAPM_RING_SAMPLES * sizeof(*xapm->samples));
+	xapm->info.mem[XAPM_SAMPLE_MAP].memtype = UIO_MEM_VIRTUAL;
+
+	xapm->dev = &pdev->dev;
+	spin_lock_init(&xapm->lock);
+	hrtimer_init(&xapm->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	xapm->timer.function = xapm_timer_fn;
+
 	xapm->info.name = "axi-pmon";
 	xapm->info.version = DRV_VERSION;
 
@@ -276,11 +672,24 @@ static int xapm_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, xapm);
 
+	ret = devm_device_add_group(&pdev->dev, &xapm_attr_group);
+	if (ret < 0)
+		goto err_uio;
+
+	ret = xapm_pmu_register(xapm);
+	if (ret < 0) {
+		dev_err(&pdev->dev, "unable to register PMU\n");
+		goto err_uio;
+	}
+
 	dev_info(&pdev->dev, "Probed Xilinx APM\n");
 
 	return 0;
 
+err_uio:
+	uio_unregister_device(&xapm->info);
 err_clk_dis:
+	vfree(xapm->ring);
 	clk_disable_unprepare(xapm->param.clk);
 	pm_runtime_disable(&pdev->dev);
 	pm_runtime_set_suspended(&pdev->dev);
@@ -296,8 +705,17 @@ static int xapm_probe(struct platform_device *pdev)
 static int xapm_remove(struct platform_device *pdev)
 {
 	struct xapm_dev *xapm = platform_get_drvdata(pdev);
+	unsigned long flags;
+
+	xapm_pmu_unregister(xapm);
+
+	spin_lock_irqsave(&xapm->lock, flags);
+	xapm->period = 0;
+	spin_unlock_irqrestore(&xapm->lock, flags);
+	hrtimer_cancel(&xapm->timer);
 
 	uio_unregister_device(&xapm->info);
+	vfree(xapm->ring);
 	clk_disable_unprepare(xapm->param.clk);
 	pm_runtime_disable(&pdev->dev);
 	pm_runtime_set_suspended(&pdev->dev);
@@ -351,7 +769,28 @@ static struct platform_driver xapm_driver = {
 	.remove = xapm_remove,
 };
 
-module_platform_driver(xapm_driver);
+static int __init xapm_init(void)
+{
+	int ret;
+
+	ret = xapm_pmu_init();
+	if (ret)
+		return ret;
+
+	ret = platform_driver_register(&xapm_driver);
+	if (ret)
+		xapm_pmu_exit();
+
+	return ret;
+}
+module_init(xapm_init);
+
+static void __exit xapm_exit(void)
+{
+	platform_driver_unregister(&xapm_driver);
+	xapm_pmu_exit();
+}
+module_exit(xapm_exit);
 
 MODULE_AUTHOR("Xilinx Inc.");
 MODULE_DESCRIPTION("Xilinx AXI Performance Monitor driver");
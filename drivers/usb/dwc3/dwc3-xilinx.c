@@ -63,6 +63,14 @@
 #define XLNX_USB_FPD_POWER_PRSNT		0x80
 #define FPD_POWER_PRSNT_OPTION			BIT(0)
 
+/*
+ * Runtime autosuspend delays of the glue, in ms. Runtime suspend only gates
+ * the clocks, so resuming is cheap. Peripheral links see bursty traffic from
+ * consoles and HID functions and keep their clocks a little longer.
+ */
+#define XLNX_USB_AUTOSUSPEND_DELAY_HOST		100
+#define XLNX_USB_AUTOSUSPEND_DELAY_PERIPHERAL	500
+
 enum dwc3_xlnx_core_state {
 	UNKNOWN_STATE = 0,
 	D0_STATE,
@@ -83,6 +91,7 @@ struct dwc3_xlnx {
 	struct reset_control		*crst;
 	int				wakeup_irq;
 	bool				enable_d3_suspend;
+	bool				system_sleep;
 	enum usb_dr_mode		dr_mode;
 	struct regulator_desc		dwc3_xlnx_reg_desc;
 };
@@ -255,6 +264,14 @@ static int dwc3_versal_power_req(struct device *dev, bool on)
 		if (priv_data->pmu_state == D3_STATE)
 			return 0;
 
+		/*
+		 * Outside of system sleep D3 is only needed to wake up through
+		 * PME, otherwise stay in D0 and keep the core and PHY context.
+		 * That saves the firmware round trip on every runtime PM cycle.
+		 */
+		if (!priv_data->system_sleep && !priv_data->enable_d3_suspend)
+			return 0;
+
 		/* enable PME to wakeup from hibernation */
 		writel(XLNX_PME_ENABLE_SIG_GEN,
 		       priv_data->regs + XLNX_VERSAL_USB_PME_ENABLE);
@@ -717,7 +734,15 @@ static int dwc3_xlnx_probe(struct platform_device *pdev)
 		goto err_pm_set_suspended;
 
 	pm_suspend_ignore_children(dev, false);
-	return pm_runtime_resume_and_get(dev);
+	pm_runtime_set_autosuspend_delay(dev,
+					 priv_data->dr_mode == USB_DR_MODE_HOST ?
+					 XLNX_USB_AUTOSUSPEND_DELAY_HOST :
+					 XLNX_USB_AUTOSUSPEND_DELAY_PERIPHERAL);
+	pm_runtime_use_autosuspend(dev);
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return 0;
 
 err_pm_set_suspended:
 	pm_runtime_set_suspended(dev);
@@ -733,6 +758,7 @@ static void dwc3_xlnx_remove(struct platform_device *pdev)
 	struct dwc3_xlnx	*priv_data = platform_get_drvdata(pdev);
 	struct device		*dev = &pdev->dev;
 
+	pm_runtime_get_sync(dev);
 	of_platform_depopulate(dev);
 
 	/* disable PME wakeup interrupt */
@@ -773,6 +799,26 @@ static int __maybe_unused dwc3_xlnx_runtime_idle(struct device *dev)
 	return 0;
 }
 
+static int __maybe_unused dwc3_xlnx_prepare(struct device *dev)
+{
+	struct dwc3_xlnx *priv_data = dev_get_drvdata(dev);
+
+	/* Let the core enter D3, see dwc3_versal_power_req() */
+	priv_data->system_sleep = true;
+
+	/* The system sleep callbacks expect the clocks to be running */
+	pm_runtime_resume(dev);
+
+	return 0;
+}
+
+static void __maybe_unused dwc3_xlnx_complete(struct device *dev)
+{
+	struct dwc3_xlnx *priv_data = dev_get_drvdata(dev);
+
+	priv_data->system_sleep = false;
+}
+
 static int __maybe_unused dwc3_xlnx_suspend(struct device *dev)
 {
 	struct dwc3_xlnx *priv_data = dev_get_drvdata(dev);
@@ -824,6 +870,10 @@ static int __maybe_unused dwc3_xlnx_resume(struct device *dev)
 }
 
 static const struct dev_pm_ops dwc3_xlnx_dev_pm_ops = {
+#ifdef CONFIG_PM_SLEEP
+	.prepare	= dwc3_xlnx_prepare,
+	.complete	= dwc3_xlnx_complete,
+#endif
 	SET_SYSTEM_SLEEP_PM_OPS(dwc3_xlnx_suspend, dwc3_xlnx_resume)
 	SET_RUNTIME_PM_OPS(dwc3_xlnx_runtime_suspend,
 			   dwc3_xlnx_runtime_resume, dwc3_xlnx_runtime_idle)
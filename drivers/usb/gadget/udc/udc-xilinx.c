@@ -110,11 +110,15 @@
  * @usb_req: Linux usb request structure
  * @queue: usb device request queue
  * @ep: pointer to xusb_endpoint structure
+ * @sg: scatterlist entry the next DMA transfer starts in
+ * @sg_offset: offset of the next DMA transfer within @sg
  */
 struct xusb_req {
 	struct usb_request usb_req;
 	struct list_head queue;
 	struct xusb_ep *ep;
+	struct scatterlist *sg;
+	u32 sg_offset;
 };
 
 /**
@@ -361,6 +365,62 @@ static int xudc_start_dma(struct xusb_ep *ep, dma_addr_t src,
 	return rc;
 }
 
+/**
+ * xudc_dma_xfer - Moves one packet between a request and an endpoint buffer.
+ * @ep: pointer to the usb device endpoint structure.
+ * @req: pointer to the usb request structure.
+ * @ram: DMA address of the endpoint buffer.
+ * @length: number of bytes to transfer.
+ * @ctrl: DMA control value of the transfer.
+ *
+ * Return: 0 on success, error code on failure
+ *
+ * Scatter-gather requests get the packet split at the segment boundaries,
+ * only the last piece lets the hardware mark the buffer ready.
+ */
+static int xudc_dma_xfer(struct xusb_ep *ep, struct xusb_req *req,
+			 dma_addr_t ram, u32 length, u32 ctrl)
+{
+	struct xusb_udc *udc = ep->udc;
+	dma_addr_t mem;
+	u32 chunk;
+	int ret;
+
+	if (!req->usb_req.num_mapped_sgs) {
+		mem = req->usb_req.dma + req->usb_req.actual;
+		udc->write_fn(udc->addr, XUSB_DMA_CONTROL_OFFSET, ctrl);
+		if (ep->is_in)
+			return xudc_start_dma(ep, mem, ram, length);
+		return xudc_start_dma(ep, ram, mem, length);
+	}
+
+	do {
+		chunk = min(length, sg_dma_len(req->sg) - req->sg_offset);
+		mem = sg_dma_address(req->sg) + req->sg_offset;
+
+		udc->write_fn(udc->addr, XUSB_DMA_CONTROL_OFFSET,
+			      chunk == length ? ctrl :
+			      ctrl & XUSB_DMA_READ_FROM_DPRAM);
+		if (ep->is_in)
+			ret = xudc_start_dma(ep, mem, ram, chunk);
+		else
+			ret = xudc_start_dma(ep, ram, mem, chunk);
+		if (ret)
+			return ret;
+
+		req->sg_offset += chunk;
+		if (req->sg_offset == sg_dma_len(req->sg) &&
+		    !sg_is_last(req->sg)) {
+			req->sg = sg_next(req->sg);
+			req->sg_offset = 0;
+		}
+		ram += chunk;
+		length -= chunk;
+	} while (length);
+
+	return 0;
+}
+
 /**
  * xudc_dma_send - Sends IN data using DMA.
  * @ep: pointer to the usb device endpoint structure.
@@ -379,10 +439,11 @@ static int xudc_dma_send(struct xusb_ep *ep, struct xusb_req *req,
 	u32 *eprambase;
 	dma_addr_t src;
 	dma_addr_t dst;
+	u32 ctrl;
 	struct xusb_udc *udc = ep->udc;
 
 	src = req->usb_req.dma + req->usb_req.actual;
-	if (req->usb_req.length)
+	if (req->usb_req.length && !req->usb_req.num_mapped_sgs)
 		dma_sync_single_for_device(udc->dev, src,
 					   length, DMA_TO_DEVICE);
 	if (!ep->curbufnum && !ep->buffer0ready) {
@@ -391,8 +452,7 @@ static int xudc_dma_send(struct xusb_ep *ep, struct xusb_req *req,
 		dst = virt_to_phys(eprambase);
 		udc->write_fn(udc->addr, ep->offset +
 			      XUSB_EP_BUF0COUNT_OFFSET, length);
-		udc->write_fn(udc->addr, XUSB_DMA_CONTROL_OFFSET,
-			      XUSB_DMA_BRR_CTRL | (1 << ep->epnumber));
+		ctrl = XUSB_DMA_BRR_CTRL | (1 << ep->epnumber);
 		ep->buffer0ready = 1;
 		ep->curbufnum = 1;
 	} else if (ep->curbufnum && !ep->buffer1ready) {
@@ -402,9 +462,8 @@ static int xudc_dma_send(struct xusb_ep *ep, struct xusb_req *req,
 		dst = virt_to_phys(eprambase);
 		udc->write_fn(udc->addr, ep->offset +
 			      XUSB_EP_BUF1COUNT_OFFSET, length);
-		udc->write_fn(udc->addr, XUSB_DMA_CONTROL_OFFSET,
-			      XUSB_DMA_BRR_CTRL | (1 << (ep->epnumber +
-			      XUSB_STATUS_EP_BUFF2_SHIFT)));
+		ctrl = XUSB_DMA_BRR_CTRL | (1 << (ep->epnumber +
+			XUSB_STATUS_EP_BUFF2_SHIFT));
 		ep->buffer1ready = 1;
 		ep->curbufnum = 0;
 	} else {
@@ -412,7 +471,7 @@ static int xudc_dma_send(struct xusb_ep *ep, struct xusb_req *req,
 		return -EAGAIN;
 	}
 
-	return xudc_start_dma(ep, src, dst, length);
+	return xudc_dma_xfer(ep, req, dst, length, ctrl);
 }
 
 /**
@@ -432,17 +491,19 @@ static int xudc_dma_receive(struct xusb_ep *ep, struct xusb_req *req,
 {
 	u32 *eprambase;
 	dma_addr_t src;
-	dma_addr_t dst;
+	u32 ctrl;
 	struct xusb_udc *udc = ep->udc;
 
-	dst = req->usb_req.dma + req->usb_req.actual;
+	/* The segments only cover the request, drop what overflows it */
+	if (req->usb_req.num_mapped_sgs)
+		length = min(length, req->usb_req.length - req->usb_req.actual);
+
 	if (!ep->curbufnum && !ep->buffer0ready) {
 		/* Get the Buffer address and copy the transmit data */
 		eprambase = (u32 __force *)(udc->addr + ep->rambase);
 		src = virt_to_phys(eprambase);
-		udc->write_fn(udc->addr, XUSB_DMA_CONTROL_OFFSET,
-			      XUSB_DMA_BRR_CTRL | XUSB_DMA_READ_FROM_DPRAM |
-			      (1 << ep->epnumber));
+		ctrl = XUSB_DMA_BRR_CTRL | XUSB_DMA_READ_FROM_DPRAM |
+		       (1 << ep->epnumber);
 		ep->buffer0ready = 1;
 		ep->curbufnum = 1;
 	} else if (ep->curbufnum && !ep->buffer1ready) {
@@ -450,10 +511,8 @@ static int xudc_dma_receive(struct xusb_ep *ep, struct xusb_req *req,
 		eprambase = (u32 __force *)(udc->addr +
 			     ep->rambase + ep->ep_usb.maxpacket);
 		src = virt_to_phys(eprambase);
-		udc->write_fn(udc->addr, XUSB_DMA_CONTROL_OFFSET,
-			      XUSB_DMA_BRR_CTRL | XUSB_DMA_READ_FROM_DPRAM |
-			      (1 << (ep->epnumber +
-			      XUSB_STATUS_EP_BUFF2_SHIFT)));
+		ctrl = XUSB_DMA_BRR_CTRL | XUSB_DMA_READ_FROM_DPRAM |
+		       (1 << (ep->epnumber + XUSB_STATUS_EP_BUFF2_SHIFT));
 		ep->buffer1ready = 1;
 		ep->curbufnum = 0;
 	} else {
@@ -461,7 +520,7 @@ static int xudc_dma_receive(struct xusb_ep *ep, struct xusb_req *req,
 		return -EAGAIN;
 	}
 
-	return xudc_start_dma(ep, src, dst, length);
+	return xudc_dma_xfer(ep, req, src, length, ctrl);
 }
 
 /**
@@ -637,7 +696,8 @@ static int xudc_read_fifo(struct xusb_ep *ep, struct xusb_req *req)
 
 		/* Completion */
 		if ((req->usb_req.actual == req->usb_req.length) || is_short) {
-			if (udc->dma_enabled && req->usb_req.length)
+			if (udc->dma_enabled && req->usb_req.length &&
+			    !req->usb_req.num_mapped_sgs)
 				dma_sync_single_for_cpu(udc->dev,
 							req->usb_req.dma,
 							req->usb_req.actual,
@@ -726,6 +786,40 @@ static int xudc_write_fifo(struct xusb_ep *ep, struct xusb_req *req)
 	return retval;
 }
 
+/**
+ * xudc_ep_buf_free - Checks the ping-pong buffer that is processed next.
+ * @ep: pointer to the usb device endpoint structure.
+ *
+ * Return: true if the buffer is owned by the driver, that is free for an IN
+ *	   packet or holding a received OUT packet.
+ */
+static bool xudc_ep_buf_free(struct xusb_ep *ep)
+{
+	return ep->curbufnum ? !ep->buffer1ready : !ep->buffer0ready;
+}
+
+/**
+ * xudc_ep_process_queue - Processes the endpoint queue.
+ * @ep: pointer to the usb device endpoint structure.
+ *
+ * Keeps both ping-pong buffers busy: an IN packet, of the head request or
+ * of the request after it, is loaded into the second buffer while the first
+ * one is being sent, and received OUT packets are handed to the queued
+ * requests as long as any is left.
+ */
+static void xudc_ep_process_queue(struct xusb_ep *ep)
+{
+	struct xusb_req *req;
+
+	while (!list_empty(&ep->queue) && xudc_ep_buf_free(ep)) {
+		req = list_first_entry(&ep->queue, struct xusb_req, queue);
+		if (ep->is_in)
+			xudc_write_fifo(ep, req);
+		else
+			xudc_read_fifo(ep, req);
+	}
+}
+
 /**
  * xudc_nuke - Cleans up the data transfer message list.
  * @ep: pointer to the usb device endpoint structure.
@@ -1107,22 +1201,12 @@ static int xudc_ep_queue(struct usb_ep *_ep, struct usb_request *_req,
 			spin_unlock_irqrestore(&udc->lock, flags);
 			return -EAGAIN;
 		}
+		req->sg = _req->sg;
+		req->sg_offset = 0;
 	}
 
-	if (list_empty(&ep->queue)) {
-		if (ep->is_in) {
-			dev_dbg(udc->dev, "xudc_write_fifo from ep_queue\n");
-			if (!xudc_write_fifo(ep, req))
-				req = NULL;
-		} else {
-			dev_dbg(udc->dev, "xudc_read_fifo from ep_queue\n");
-			if (!xudc_read_fifo(ep, req))
-				req = NULL;
-		}
-	}
-
-	if (req != NULL)
-		list_add_tail(&req->queue, &ep->queue);
+	list_add_tail(&req->queue, &ep->queue);
+	xudc_ep_process_queue(ep);
 
 	spin_unlock_irqrestore(&udc->lock, flags);
 	return 0;
@@ -1961,8 +2045,6 @@ static void xudc_ctrl_ep_handler(struct xusb_udc *udc, u32 intrstatus)
 static void xudc_nonctrl_ep_handler(struct xusb_udc *udc, u8 epnum,
 				    u32 intrstatus)
 {
-
-	struct xusb_req *req;
 	struct xusb_ep *ep;
 
 	ep = &udc->ep[epnum];
@@ -1972,15 +2054,7 @@ static void xudc_nonctrl_ep_handler(struct xusb_udc *udc, u8 epnum,
 	if (intrstatus & (XUSB_STATUS_EP0_BUFF2_COMP_MASK << epnum))
 		ep->buffer1ready = false;
 
-	if (list_empty(&ep->queue))
-		return;
-
-	req = list_first_entry(&ep->queue, struct xusb_req, queue);
-
-	if (ep->is_in)
-		xudc_write_fifo(ep, req);
-	else
-		xudc_read_fifo(ep, req);
+	xudc_ep_process_queue(ep);
 }
 
 /**
@@ -2103,6 +2177,7 @@ static int xudc_probe(struct platform_device *pdev)
 	/* Setup gadget structure */
 	udc->gadget.ops = &xusb_udc_ops;
 	udc->gadget.max_speed = USB_SPEED_HIGH;
+	udc->gadget.sg_supported = udc->dma_enabled;
 	udc->gadget.speed = USB_SPEED_UNKNOWN;
 	udc->gadget.ep0 = &udc->ep[XUSB_EP_NUMBER_ZERO].ep_usb;
 	udc->gadget.name = driver_name;
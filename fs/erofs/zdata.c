@@ -105,7 +105,8 @@ struct z_erofs_decompressqueue {
 		struct work_struct work;
 		struct kthread_work kthread_work;
 	} u;
-	bool eio, sync;
+	/* split: a part of a queue spread over the decompression workers */
+	bool eio, sync, split;
 };
 
 static inline bool z_erofs_is_inline_pcluster(struct z_erofs_pcluster *pcl)
@@ -1376,6 +1377,8 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	}
 }
 
+static void z_erofs_decompress_spread(struct z_erofs_decompressqueue *io);
+
 static void z_erofs_decompressqueue_work(struct work_struct *work)
 {
 	struct z_erofs_decompressqueue *bgq =
@@ -1383,6 +1386,8 @@ static void z_erofs_decompressqueue_work(struct work_struct *work)
 	struct page *pagepool = NULL;
 
 	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL);
+	if (!bgq->split)
+		z_erofs_decompress_spread(bgq);
 	z_erofs_decompress_queue(bgq, &pagepool);
 	erofs_release_pages(&pagepool);
 	kvfree(bgq);
@@ -1395,6 +1400,97 @@ static void z_erofs_decompressqueue_kthread_work(struct kthread_work *work)
 }
 #endif
 
+static void z_erofs_queue_decompress_work(struct z_erofs_decompressqueue *io,
+					  unsigned int cpu)
+{
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	struct kthread_worker *worker;
+
+	rcu_read_lock();
+	worker = rcu_dereference(z_erofs_pcpu_workers[cpu]);
+	if (!worker) {
+		INIT_WORK(&io->u.work, z_erofs_decompressqueue_work);
+		queue_work(z_erofs_workqueue, &io->u.work);
+	} else {
+		kthread_queue_work(worker, &io->u.kthread_work);
+	}
+	rcu_read_unlock();
+#else
+	queue_work(z_erofs_workqueue, &io->u.work);
+#endif
+}
+
+static struct z_erofs_decompressqueue *
+z_erofs_alloc_split_queue(const struct z_erofs_decompressqueue *io)
+{
+	struct z_erofs_decompressqueue *q;
+
+	q = kvzalloc(sizeof(*q), GFP_NOIO | __GFP_NOWARN);
+	if (!q)
+		return NULL;
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	kthread_init_work(&q->u.kthread_work,
+			  z_erofs_decompressqueue_kthread_work);
+#else
+	INIT_WORK(&q->u.work, z_erofs_decompressqueue_work);
+#endif
+	q->sb = io->sb;
+	q->eio = io->eio;
+	q->split = true;
+	return q;
+}
+
+/*
+ * Pclusters are independent of each other, so spread the pclusters of a
+ * background queue over the workers of the online CPUs rather than
+ * decompressing a large read on a single one.  The first part is left to
+ * the caller.  If a part cannot be allocated, the remaining pclusters stay
+ * with the previous part.
+ */
+static void z_erofs_decompress_spread(struct z_erofs_decompressqueue *io)
+{
+	z_erofs_next_pcluster_t owned = io->head;
+	struct z_erofs_decompressqueue *cur = io, *q;
+	unsigned int cpu = raw_smp_processor_id();
+	unsigned int nr = 0, parts, per_part, i;
+	struct z_erofs_pcluster *pcl;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		++nr;
+	}
+
+	parts = min(nr, num_online_cpus());
+	if (parts <= 1)
+		return;
+	per_part = DIV_ROUND_UP(nr, parts);
+
+	owned = io->head;
+	for (i = 1; owned != Z_EROFS_PCLUSTER_TAIL; ++i) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		if (i % per_part || owned == Z_EROFS_PCLUSTER_TAIL)
+			continue;
+
+		q = z_erofs_alloc_split_queue(io);
+		if (!q)
+			break;
+		/* still owned (!= NIL), just the end of this part now */
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL);
+		q->head = owned;
+
+		if (cur != io)
+			z_erofs_queue_decompress_work(cur, cpu);
+		cur = q;
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+	if (cur != io)
+		z_erofs_queue_decompress_work(cur, cpu);
+}
+
 static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 				       int bios)
 {
@@ -1411,22 +1507,7 @@ static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 		return;
 	/* Use (kthread_)work and sync decompression for atomic contexts only */
 	if (!in_task() || irqs_disabled() || rcu_read_lock_any_held()) {
-#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
-		struct kthread_worker *worker;
-
-		rcu_read_lock();
-		worker = rcu_dereference(
-				z_erofs_pcpu_workers[raw_smp_processor_id()]);
-		if (!worker) {
-			INIT_WORK(&io->u.work, z_erofs_decompressqueue_work);
-			queue_work(z_erofs_workqueue, &io->u.work);
-		} else {
-			kthread_queue_work(worker, &io->u.kthread_work);
-		}
-		rcu_read_unlock();
-#else
-		queue_work(z_erofs_workqueue, &io->u.work);
-#endif
+		z_erofs_queue_decompress_work(io, raw_smp_processor_id());
 		/* enable sync decompression for readahead */
 		if (sbi->opt.sync_decompress == EROFS_SYNC_DECOMPRESS_AUTO)
 			sbi->opt.sync_decompress = EROFS_SYNC_DECOMPRESS_FORCE_ON;
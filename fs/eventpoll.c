@@ -37,6 +37,7 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/cpumask.h>
 #include <net/busy_poll.h>
 
 /*
@@ -45,18 +46,20 @@
  *
  * 1) epnested_mutex (mutex)
  * 2) ep->mtx (mutex)
- * 3) ep->lock (rwlock)
  *
- * The acquire order is the one listed above, from 1 to 3.
- * We need a rwlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
- * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
- * user space) we could end up sleeping due a copy_to_user(), so
- * we need a lock that will allow us to sleep. This lock is a
- * mutex (ep->mtx). It is acquired during the event transfer loop,
- * during epoll_ctl(EPOLL_CTL_DEL) and during eventpoll_release_file().
+ * The acquire order is the one listed above, from 1 to 2.
+ * The poll callback might be triggered from a wake_up() that in turn
+ * might be called from IRQ context, so it can't take either of them.
+ * Instead of touching ep->rdllist it chains the ready items onto
+ * lockless per-CPU lists, which are merged into ep->rdllist when the
+ * events are collected. This way wakeups from different CPUs don't
+ * contend on a lock or cacheline of the eventpoll. All other accesses
+ * to ep->rdllist are done with ep->mtx held. During the event transfer
+ * loop (from kernel to user space) we could end up sleeping due a
+ * copy_to_user(), so we need a lock that will allow us to sleep. This
+ * lock is a mutex (ep->mtx). It is acquired during the event transfer
+ * loop, during epoll_ctl(EPOLL_CTL_DEL) and during
+ * eventpoll_release_file().
  * The epnested_mutex is acquired when inserting an epoll fd onto another
  * epoll fd. We do this so that we walk the epoll tree and ensure that this
  * insertion does not create a cycle of epoll file descriptors, which
@@ -74,7 +77,7 @@
  * of epoll file descriptors, we use the current recursion depth as
  * the lockdep subkey.
  * It is possible to drop the "ep->mtx" and to use the global
- * mutex "epnested_mutex" (together with "ep->lock") to have it working,
+ * mutex "epnested_mutex" to have it working,
  * but having "ep->mtx" will make the interface more scalable.
  * Events that require holding "epnested_mutex" are very rare, while for
  * normal operations the epoll private "ep->mtx" will guarantee
@@ -139,8 +142,8 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links the item on a per-CPU ready list of the eventpoll,
+	 * EP_UNACTIVE_PTR while not chained.
 	 */
 	struct epitem *next;
 
@@ -190,21 +193,20 @@ struct eventpoll {
 	/* Wait queue used by file->poll() */
 	wait_queue_head_t poll_wait;
 
-	/* List of ready file descriptors */
+	/* List of ready file descriptors, protected by mtx */
 	struct list_head rdllist;
 
-	/* Lock which protects rdllist and ovflist */
-	rwlock_t lock;
-
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root_cached rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Per-CPU single linked lists of the items made ready by the poll
+	 * callback, merged into rdllist when collecting events.
 	 */
-	struct epitem *ovflist;
+	struct epitem * __percpu *pcp_rdl;
+
+	/* CPUs whose per-CPU ready list may be non-empty */
+	cpumask_var_t pcp_rdl_cpus;
 
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
@@ -384,7 +386,7 @@ static inline struct epitem *ep_item_from_wait(wait_queue_entry_t *p)
 static inline int ep_events_available(struct eventpoll *ep)
 {
 	return !list_empty_careful(&ep->rdllist) ||
-		READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR;
+		!cpumask_empty(ep->pcp_rdl_cpus);
 }
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
@@ -609,6 +611,55 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 }
 
 
+/*
+ * Moves all the items chained by the poll callback on the per-CPU ready
+ * lists to ep->rdllist, visiting only the CPUs flagged in ep->pcp_rdl_cpus.
+ * Must be called with "mtx" held.
+ */
+static void __ep_merge_pcp_rdl(struct eventpoll *ep)
+{
+	struct epitem *epi, *nepi;
+	LIST_HEAD(batch);
+	int cpu;
+
+	lockdep_assert_held(&ep->mtx);
+
+	for_each_cpu(cpu, ep->pcp_rdl_cpus) {
+		struct epitem **head = per_cpu_ptr(ep->pcp_rdl, cpu);
+
+		cpumask_clear_cpu(cpu, ep->pcp_rdl_cpus);
+		/* Pairs with the barrier in chain_epi_lockless() */
+		smp_mb__after_atomic();
+
+		if (!READ_ONCE(*head))
+			continue;
+
+		for (nepi = xchg(head, NULL); (epi = nepi) != NULL;
+		     nepi = epi->next, WRITE_ONCE(epi->next, EP_UNACTIVE_PTR)) {
+			/*
+			 * We need to check if the item is already in the list,
+			 * e.g. a level triggered item or one being transferred
+			 * on the "txlist" of ep_send_events().
+			 */
+			if (!ep_is_linked(epi)) {
+				/*
+				 * The per-CPU lists are LIFO, so we have to
+				 * reverse them in order to keep in FIFO.
+				 */
+				list_add(&epi->rdllink, &batch);
+				ep_pm_stay_awake(epi);
+			}
+		}
+		list_splice_tail_init(&batch, &ep->rdllist);
+	}
+}
+
+static void ep_merge_pcp_rdl(struct eventpoll *ep)
+{
+	if (!cpumask_empty(ep->pcp_rdl_cpus))
+		__ep_merge_pcp_rdl(ep);
+}
+
 /*
  * ep->mutex needs to be held because we could be hit by
  * eventpoll_release_file() and epoll_ctl().
@@ -616,67 +667,26 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 static void ep_start_scan(struct eventpoll *ep, struct list_head *txlist)
 {
 	/*
-	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * Collect what the poll callback queued on the per-CPU lists and
+	 * steal the ready list. Events happening while looping w/out locks
+	 * keep being queued on the per-CPU lists, so they are not lost.
 	 */
-	lockdep_assert_irqs_enabled();
-	write_lock_irq(&ep->lock);
+	ep_merge_pcp_rdl(ep);
 	list_splice_init(&ep->rdllist, txlist);
-	WRITE_ONCE(ep->ovflist, NULL);
-	write_unlock_irq(&ep->lock);
 }
 
 static void ep_done_scan(struct eventpoll *ep,
 			 struct list_head *txlist)
 {
-	struct epitem *epi, *nepi;
-
-	write_lock_irq(&ep->lock);
-	/*
-	 * During the time we spent inside the "sproc" callback, some
-	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
-	 */
-	for (nepi = READ_ONCE(ep->ovflist); (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(epi)) {
-			/*
-			 * ->ovflist is LIFO, so we have to reverse it in order
-			 * to keep in FIFO.
-			 */
-			list_add(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
-		}
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	WRITE_ONCE(ep->ovflist, EP_UNACTIVE_PTR);
-
 	/*
 	 * Quickly re-inject items left on "txlist".
 	 */
 	list_splice(txlist, &ep->rdllist);
 	__pm_relax(ep->ws);
 
-	if (!list_empty(&ep->rdllist)) {
-		if (waitqueue_active(&ep->wq))
-			wake_up(&ep->wq);
-	}
-
-	write_unlock_irq(&ep->lock);
+	/* Pairs with the barrier in ep_poll() */
+	if (!list_empty(&ep->rdllist) && wq_has_sleeper(&ep->wq))
+		wake_up(&ep->wq);
 }
 
 static void epi_rcu_free(struct rcu_head *head)
@@ -705,6 +715,8 @@ static bool ep_refcount_dec_and_test(struct eventpoll *ep)
 static void ep_free(struct eventpoll *ep)
 {
 	mutex_destroy(&ep->mtx);
+	free_percpu(ep->pcp_rdl);
+	free_cpumask_var(ep->pcp_rdl_cpus);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
 	kfree(ep);
@@ -755,10 +767,15 @@ static bool __ep_remove(struct eventpoll *ep, struct epitem *epi, bool force)
 
 	rb_erase_cached(&epi->rbn, &ep->rbr);
 
-	write_lock_irq(&ep->lock);
+	/*
+	 * No poll callback can chain the item anymore, but it may still be
+	 * on a per-CPU ready list. The callback which chained it has flagged
+	 * that CPU before returning.
+	 */
+	if (READ_ONCE(epi->next) != EP_UNACTIVE_PTR)
+		__ep_merge_pcp_rdl(ep);
 	if (ep_is_linked(epi))
 		list_del_init(&epi->rdllink);
-	write_unlock_irq(&ep->lock);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 	/*
@@ -981,13 +998,23 @@ static int ep_alloc(struct eventpoll **pep)
 	if (unlikely(!ep))
 		return -ENOMEM;
 
+	ep->pcp_rdl = alloc_percpu(struct epitem *);
+	if (unlikely(!ep->pcp_rdl)) {
+		kfree(ep);
+		return -ENOMEM;
+	}
+
+	if (unlikely(!zalloc_cpumask_var(&ep->pcp_rdl_cpus, GFP_KERNEL))) {
+		free_percpu(ep->pcp_rdl);
+		kfree(ep);
+		return -ENOMEM;
+	}
+
 	mutex_init(&ep->mtx);
-	rwlock_init(&ep->lock);
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT_CACHED;
-	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = get_current_user();
 	refcount_set(&ep->refcount, 1);
 
@@ -1070,78 +1097,45 @@ struct file *get_epoll_tfile_raw_ptr(struct file *file, int tfd,
 #endif /* CONFIG_KCMP */
 
 /*
- * Adds a new entry to the tail of the list in a lockless way, i.e.
- * multiple CPUs are allowed to call this function concurrently.
- *
- * Beware: it is necessary to prevent any other modifications of the
- *         existing list until all changes are completed, in other words
- *         concurrent list_add_tail_lockless() calls should be protected
- *         with a read lock, where write lock acts as a barrier which
- *         makes sure all list_add_tail_lockless() calls are fully
- *         completed.
- *
- *        Also an element can be locklessly added to the list only in one
- *        direction i.e. either to the tail or to the head, otherwise
- *        concurrent access will corrupt the list.
- *
- * Return: %false if element has been already added to the list, %true
- * otherwise.
- */
-static inline bool list_add_tail_lockless(struct list_head *new,
-					  struct list_head *head)
-{
-	struct list_head *prev;
-
-	/*
-	 * This is simple 'new->next = head' operation, but cmpxchg()
-	 * is used in order to detect that same element has been just
-	 * added to the list from another CPU: the winner observes
-	 * new->next == new.
-	 */
-	if (!try_cmpxchg(&new->next, &new, head))
-		return false;
-
-	/*
-	 * Initially ->next of a new element must be updated with the head
-	 * (we are inserting to the tail) and only then pointers are atomically
-	 * exchanged.  XCHG guarantees memory ordering, thus ->next should be
-	 * updated before pointers are actually swapped and pointers are
-	 * swapped before prev->next is updated.
-	 */
-
-	prev = xchg(&head->prev, new);
-
-	/*
-	 * It is safe to modify prev->next and new->prev, because a new element
-	 * is added only to the tail and new->next is updated before XCHG.
-	 */
-
-	prev->next = new;
-	new->prev = prev;
-
-	return true;
-}
-
-/*
- * Chains a new epi entry to the tail of the ep->ovflist in a lockless way,
- * i.e. multiple CPUs are allowed to call this function concurrently.
+ * Chains a new epi entry to the ready list of the current CPU in a lockless
+ * way, i.e. multiple CPUs are allowed to call this function concurrently.
  *
  * Return: %false if epi element has been already chained, %true otherwise.
  */
 static inline bool chain_epi_lockless(struct epitem *epi)
 {
 	struct eventpoll *ep = epi->ep;
+	struct epitem **head, *first;
+	int cpu;
 
 	/* Fast preliminary check */
-	if (epi->next != EP_UNACTIVE_PTR)
+	if (READ_ONCE(epi->next) != EP_UNACTIVE_PTR)
 		return false;
 
 	/* Check that the same epi has not been just chained from another CPU */
 	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
 		return false;
 
-	/* Atomically exchange tail */
-	epi->next = xchg(&ep->ovflist, epi);
+	/*
+	 * ->next has to be set before the item is visible on the list, as
+	 * __ep_merge_pcp_rdl() may grab the list at any time.
+	 */
+	cpu = raw_smp_processor_id();
+	head = per_cpu_ptr(ep->pcp_rdl, cpu);
+	first = READ_ONCE(*head);
+	do {
+		WRITE_ONCE(epi->next, first);
+	} while (!try_cmpxchg(head, &first, epi));
+
+	/*
+	 * Flag the CPU for __ep_merge_pcp_rdl(), only writing the shared mask
+	 * when the bit is clear so that it stays clean while a CPU queues a
+	 * batch. The full barrier of the cmpxchg() pairs with the one in
+	 * __ep_merge_pcp_rdl(): if the bit is seen set here, the merge which
+	 * clears it has yet to grab the list and will find the item.
+	 */
+	if (!cpumask_test_cpu(cpu, ep->pcp_rdl_cpus))
+		cpumask_set_cpu(cpu, ep->pcp_rdl_cpus);
 
 	return true;
 }
@@ -1151,11 +1145,9 @@ static inline bool chain_epi_lockless(struct epitem *epi)
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
  *
- * This callback takes a read lock in order not to contend with concurrent
- * events from another file descriptor, thus all modifications to ->rdllist
- * or ->ovflist are lockless.  Read lock is paired with the write lock from
- * ep_scan_ready_list(), which stops all list modifications and guarantees
- * that lists state is seen correctly.
+ * This callback takes no lock of the eventpoll in order not to contend with
+ * concurrent events from another file descriptor: ready items are chained
+ * on a per-CPU list, which ep_start_scan() merges into ->rdllist.
  *
  * Another thing worth to mention is that ep_poll_callback() can be called
  * concurrently for the same @epi from different CPUs if poll table was inited
@@ -1170,11 +1162,8 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 	__poll_t pollflags = key_to_poll(key);
-	unsigned long flags;
 	int ewake = 0;
 
-	read_lock_irqsave(&ep->lock, flags);
-
 	ep_set_busy_poll_napi_id(epi);
 
 	/*
@@ -1184,7 +1173,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -1193,27 +1182,17 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (pollflags && !(pollflags & epi->event.events))
-		goto out_unlock;
+		goto out;
 
-	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
-	 */
-	if (READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR) {
-		if (chain_epi_lockless(epi))
-			ep_pm_stay_awake_rcu(epi);
-	} else if (!ep_is_linked(epi)) {
-		/* In the usual case, add event to ready list. */
-		if (list_add_tail_lockless(&epi->rdllink, &ep->rdllist))
-			ep_pm_stay_awake_rcu(epi);
-	}
+	if (chain_epi_lockless(epi))
+		ep_pm_stay_awake_rcu(epi);
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. The barrier pairs with the one in ep_poll(), so either
+	 * we see the waiter or it sees the chained item.
 	 */
+	smp_mb();
 	if (waitqueue_active(&ep->wq)) {
 		if ((epi->event.events & EPOLLEXCLUSIVE) &&
 					!(pollflags & POLLFREE)) {
@@ -1236,10 +1215,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
-out_unlock:
-	read_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
+out:
 	if (pwake)
 		ep_poll_safewake(ep, epi, pollflags & EPOLL_URING_WAKE);
 
@@ -1570,9 +1546,6 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 		return -ENOMEM;
 	}
 
-	/* We have to drop the new item inside our item list to keep track of it */
-	write_lock_irq(&ep->lock);
-
 	/* record NAPI ID of new item if present */
 	ep_set_busy_poll_napi_id(epi);
 
@@ -1582,15 +1555,12 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 		ep_pm_stay_awake(epi);
 
 		/* Notify waiting tasks that events are available */
-		if (waitqueue_active(&ep->wq))
+		if (wq_has_sleeper(&ep->wq))
 			wake_up(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
 
-	write_unlock_irq(&ep->lock);
-
-	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(ep, NULL, 0);
 
@@ -1631,9 +1601,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 * 1) Flush epi changes above to other CPUs.  This ensures
 	 *    we do not miss events from ep_poll_callback if an
 	 *    event occurs immediately after we call f_op->poll().
-	 *    We need this because we did not take ep->lock while
-	 *    changing epi above (but ep_poll_callback does take
-	 *    ep->lock).
+	 *    We need this because ep_poll_callback takes no lock
+	 *    we could hold while changing epi above.
 	 *
 	 * 2) We also need to ensure we do not miss _past_ events
 	 *    when calling f_op->poll().  This barrier also
@@ -1651,22 +1620,17 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 * If the item is "hot" and it is not registered inside the ready
 	 * list, push it inside.
 	 */
-	if (ep_item_poll(epi, &pt, 1)) {
-		write_lock_irq(&ep->lock);
-		if (!ep_is_linked(epi)) {
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
+	if (ep_item_poll(epi, &pt, 1) && !ep_is_linked(epi)) {
+		list_add_tail(&epi->rdllink, &ep->rdllist);
+		ep_pm_stay_awake(epi);
 
-			/* Notify waiting tasks that events are available */
-			if (waitqueue_active(&ep->wq))
-				wake_up(&ep->wq);
-			if (waitqueue_active(&ep->poll_wait))
-				pwake++;
-		}
-		write_unlock_irq(&ep->lock);
+		/* Notify waiting tasks that events are available */
+		if (wq_has_sleeper(&ep->wq))
+			wake_up(&ep->wq);
+		if (waitqueue_active(&ep->poll_wait))
+			pwake++;
 	}
 
-	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(ep, NULL, 0);
 
@@ -1751,9 +1715,8 @@ static int ep_send_events(struct eventpoll *ep,
 			 * epoll_wait() will check again the events
 			 * availability. At this point, no one can insert
 			 * into ep->rdllist besides us. The epoll_ctl()
-			 * callers are locked out by
-			 * ep_scan_ready_list() holding "mtx" and the
-			 * poll callback will queue them in ep->ovflist.
+			 * callers are locked out by us holding "mtx" and
+			 * the poll callback queues on the per-CPU lists.
 			 */
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
@@ -1884,8 +1847,8 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		 * chance to harvest new event. Otherwise wakeup can be
 		 * lost. This is also good performance-wise, because on
 		 * normal wakeup path no need to call __remove_wait_queue()
-		 * explicitly, thus ep->lock is not taken, which halts the
-		 * event delivery.
+		 * explicitly, thus ep->wq.lock is not taken, which halts
+		 * the event delivery.
 		 *
 		 * In fact, we now use an even more aggressive function that
 		 * unconditionally removes, because we don't reuse the wait
@@ -1896,26 +1859,21 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		init_wait(&wait);
 		wait.func = ep_autoremove_wake_function;
 
-		write_lock_irq(&ep->lock);
+		spin_lock_irq(&ep->wq.lock);
+		__add_wait_queue_exclusive(&ep->wq, &wait);
 		/*
-		 * Barrierless variant, waitqueue_active() is called under
-		 * the same lock on wakeup ep_poll_callback() side, so it
-		 * is safe to avoid an explicit barrier.
+		 * The barrier of set_current_state() pairs with the one in
+		 * ep_poll_callback(), which chains the item and then checks
+		 * for waiters without holding the wait queue lock: either
+		 * it sees us queued or we see the item below.
 		 */
-		__set_current_state(TASK_INTERRUPTIBLE);
+		set_current_state(TASK_INTERRUPTIBLE);
 
-		/*
-		 * Do the final check under the lock. ep_scan_ready_list()
-		 * plays with two lists (->rdllist and ->ovflist) and there
-		 * is always a race when both lists are empty for short
-		 * period of time although events are pending, so lock is
-		 * important.
-		 */
 		eavail = ep_events_available(ep);
-		if (!eavail)
-			__add_wait_queue_exclusive(&ep->wq, &wait);
+		if (eavail)
+			list_del_init(&wait.entry);
 
-		write_unlock_irq(&ep->lock);
+		spin_unlock_irq(&ep->wq.lock);
 
 		if (!eavail)
 			timed_out = !schedule_hrtimeout_range(to, slack,
@@ -1930,7 +1888,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		eavail = 1;
 
 		if (!list_empty_careful(&wait.entry)) {
-			write_lock_irq(&ep->lock);
+			spin_lock_irq(&ep->wq.lock);
 			/*
 			 * If the thread timed out and is not on the wait queue,
 			 * it means that the thread was woken up after its
@@ -1941,7 +1899,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 			if (timed_out)
 				eavail = list_empty(&wait.entry);
 			__remove_wait_queue(&ep->wq, &wait);
-			write_unlock_irq(&ep->lock);
+			spin_unlock_irq(&ep->wq.lock);
 		}
 	}
 }
@@ -2276,6 +2234,26 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	return do_epoll_ctl(epfd, op, fd, &epds, false);
 }
 
+/*
+ * Non-blocking harvest of the ready list, for callers that wait for the
+ * eventpoll file to become readable themselves (io_uring). Returns 0 if no
+ * events were ready.
+ */
+int epoll_sendevents(struct file *file, struct epoll_event __user *events,
+		     int maxevents)
+{
+	struct timespec64 ts = { };
+
+	if (!is_file_epoll(file))
+		return -EINVAL;
+	if (maxevents <= 0 || maxevents > EP_MAX_EVENTS)
+		return -EINVAL;
+	if (!access_ok(events, maxevents * sizeof(struct epoll_event)))
+		return -EFAULT;
+
+	return ep_poll(file->private_data, events, maxevents, &ts);
+}
+
 /*
  * Implement the event wait interface for the eventpoll file. It is the kernel
  * part of the user space epoll_wait(2).
@@ -1002,7 +1002,7 @@ int do_journal_get_write_access(handle_t *handle, struct inode *inode,
 static int ext4_block_write_begin(struct folio *folio, loff_t pos, unsigned len,
 				  get_block_t *get_block)
 {
-	unsigned from = pos & (PAGE_SIZE - 1);
+	unsigned from = offset_in_folio(folio, pos);
 	unsigned to = from + len;
 	struct inode *inode = folio->mapping->host;
 	unsigned block_start, block_end;
@@ -1015,8 +1015,8 @@ static int ext4_block_write_begin(struct folio *folio, loff_t pos, unsigned len,
 	int i;
 
 	BUG_ON(!folio_test_locked(folio));
-	BUG_ON(from > PAGE_SIZE);
-	BUG_ON(to > PAGE_SIZE);
+	BUG_ON(from > folio_size(folio));
+	BUG_ON(to > folio_size(folio));
 	BUG_ON(from > to);
 
 	head = folio_buffers(folio);
@@ -1124,8 +1124,6 @@ static int ext4_write_begin(struct file *file, struct address_space *mapping,
 	 */
 	needed_blocks = ext4_writepage_trans_blocks(inode) + 1;
 	index = pos >> PAGE_SHIFT;
-	from = pos & (PAGE_SIZE - 1);
-	to = from + len;
 
 	if (ext4_test_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA)) {
 		ret = ext4_try_to_write_inline_data(mapping, inode, pos, len,
@@ -1144,10 +1142,18 @@ static int ext4_write_begin(struct file *file, struct address_space *mapping,
 	 * the folio (if needed) without using GFP_NOFS.
 	 */
 retry_grab:
-	folio = __filemap_get_folio(mapping, index, FGP_WRITEBEGIN,
-					mapping_gfp_mask(mapping));
+	folio = __filemap_get_folio(mapping, index,
+				    FGP_WRITEBEGIN | fgf_set_order(len),
+				    mapping_gfp_mask(mapping));
 	if (IS_ERR(folio))
 		return PTR_ERR(folio);
+
+	/* The caller writes at most up to the end of the folio */
+	if (pos + len > folio_pos(folio) + folio_size(folio))
+		len = folio_pos(folio) + folio_size(folio) - pos;
+	from = offset_in_folio(folio, pos);
+	to = from + len;
+
 	/*
 	 * The same as page allocation, we prealloc buffer heads before
 	 * starting the handle.
@@ -1861,10 +1867,10 @@ static int mpage_submit_folio(struct mpage_da_data *mpd, struct folio *folio)
 	len = folio_size(folio);
 	if (folio_pos(folio) + len > size &&
 	    !ext4_verity_in_progress(mpd->inode))
-		len = size & ~PAGE_MASK;
+		len = size - folio_pos(folio);
 	err = ext4_bio_write_folio(&mpd->io_submit, folio, len);
 	if (!err)
-		mpd->wbc->nr_to_write--;
+		mpd->wbc->nr_to_write -= folio_nr_pages(folio);
 
 	return err;
 }
@@ -2087,7 +2093,6 @@ static int mpage_map_and_submit_buffers(struct mpage_da_data *mpd)
 
 	start = mpd->map.m_lblk >> bpp_bits;
 	end = (mpd->map.m_lblk + mpd->map.m_len - 1) >> bpp_bits;
-	lblk = start << bpp_bits;
 	pblock = mpd->map.m_pblk;
 
 	folio_batch_init(&fbatch);
@@ -2098,6 +2103,8 @@ static int mpage_map_and_submit_buffers(struct mpage_da_data *mpd)
 		for (i = 0; i < nr; i++) {
 			struct folio *folio = fbatch.folios[i];
 
+			/* A large folio may start before the extent */
+			lblk = (ext4_lblk_t)folio->index << bpp_bits;
 			err = mpage_process_folio(mpd, folio, &lblk, &pblock,
 						 &map_bh);
 			/*
@@ -2878,11 +2885,16 @@ static int ext4_da_write_begin(struct file *file, struct address_space *mapping,
 	}
 
 retry:
-	folio = __filemap_get_folio(mapping, index, FGP_WRITEBEGIN,
-			mapping_gfp_mask(mapping));
+	folio = __filemap_get_folio(mapping, index,
+				    FGP_WRITEBEGIN | fgf_set_order(len),
+				    mapping_gfp_mask(mapping));
 	if (IS_ERR(folio))
 		return PTR_ERR(folio);
 
+	/* The caller writes at most up to the end of the folio */
+	if (pos + len > folio_pos(folio) + folio_size(folio))
+		len = folio_pos(folio) + folio_size(folio) - pos;
+
 	/* In case writeback began while the folio was unlocked */
 	folio_wait_stable(folio);
 
@@ -2970,7 +2982,7 @@ static int ext4_da_do_write_end(struct address_space *mapping,
 		unsigned long end;
 
 		i_size_write(inode, new_i_size);
-		end = (new_i_size - 1) & (PAGE_SIZE - 1);
+		end = offset_in_folio(page_folio(page), new_i_size - 1);
 		if (copied && ext4_da_should_update_i_disksize(page_folio(page), end)) {
 			ext4_update_i_disksize(inode, new_i_size);
 			disksize_changed = true;
@@ -3017,7 +3029,7 @@ static int ext4_da_write_end(struct file *file,
 		return ext4_write_inline_data_end(inode, pos, len, copied,
 						  folio);
 
-	if (unlikely(copied < len) && !PageUptodate(page))
+	if (unlikely(copied < len) && !folio_test_uptodate(folio))
 		copied = 0;
 
 	return ext4_da_do_write_end(mapping, pos, len, copied, &folio->page);
@@ -3623,9 +3635,7 @@ void ext4_set_aops(struct inode *inode)
 static int __ext4_block_zero_page_range(handle_t *handle,
 		struct address_space *mapping, loff_t from, loff_t length)
 {
-	ext4_fsblk_t index = from >> PAGE_SHIFT;
-	unsigned offset = from & (PAGE_SIZE-1);
-	unsigned blocksize, pos;
+	unsigned offset, blocksize, pos;
 	ext4_lblk_t iblock;
 	struct inode *inode = mapping->host;
 	struct buffer_head *bh;
@@ -3640,7 +3650,9 @@ static int __ext4_block_zero_page_range(handle_t *handle,
 
 	blocksize = inode->i_sb->s_blocksize;
 
-	iblock = index << (PAGE_SHIFT - inode->i_sb->s_blocksize_bits);
+	offset = offset_in_folio(folio, from);
+	iblock = (ext4_lblk_t)folio->index <<
+			(PAGE_SHIFT - inode->i_sb->s_blocksize_bits);
 
 	bh = folio_buffers(folio);
 	if (!bh) {
@@ -4488,6 +4500,47 @@ static int __ext4_get_inode_loc(struct super_block *sb, unsigned long ino,
 	return 0;
 }
 
+/*
+ * Start reading the inode table blocks of the inodes @inos, which are about
+ * to be looked up, e.g. by getdents_statx().
+ */
+void ext4_prefetch_inodes(struct super_block *sb, const u64 *inos,
+			  unsigned int nr)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_fsblk_t block, last = 0;
+	struct ext4_group_desc *gdp;
+	struct blk_plug plug;
+	unsigned long ino;
+	unsigned int i;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr; i++) {
+		if (inos[i] < EXT4_ROOT_INO ||
+		    inos[i] > le32_to_cpu(sbi->s_es->s_inodes_count))
+			continue;
+		ino = inos[i];
+
+		gdp = ext4_get_group_desc(sb, (ino - 1) /
+					  EXT4_INODES_PER_GROUP(sb), NULL);
+		if (!gdp)
+			continue;
+
+		block = ext4_inode_table(sb, gdp);
+		if (block <= le32_to_cpu(sbi->s_es->s_first_data_block) ||
+		    block >= ext4_blocks_count(sbi->s_es))
+			continue;
+		block += ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) /
+			 sbi->s_inodes_per_block;
+
+		/* Entries of a directory tend to use neighbouring inodes */
+		if (block != last)
+			ext4_sb_breadahead_unmovable(sb, block);
+		last = block;
+	}
+	blk_finish_plug(&plug);
+}
+
 static int __ext4_get_inode_loc_noinmem(struct inode *inode,
 					struct ext4_iloc *iloc)
 {
@@ -4550,6 +4603,40 @@ static bool ext4_should_enable_dax(struct inode *inode)
 	return ext4_test_inode_flag(inode, EXT4_INODE_DAX);
 }
 
+/*
+ * Large folios are used for the page cache of extent mapped regular files.
+ * Journalled data, encryption, verity and inline data still handle the
+ * page cache one page at a time. The last three can be enabled on existing
+ * files, so they are checked on the whole filesystem.
+ */
+static bool ext4_should_enable_large_folio(struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+
+	if (!S_ISREG(inode->i_mode))
+		return false;
+	if (EXT4_I(inode)->i_flags & EXT4_EA_INODE_FL)
+		return false;
+	if (IS_DAX(inode))
+		return false;
+	if (!ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS))
+		return false;
+	if (ext4_should_journal_data(inode))
+		return false;
+	if (ext4_has_feature_encrypt(sb) || ext4_has_feature_verity(sb) ||
+	    ext4_has_feature_inline_data(sb))
+		return false;
+
+	return true;
+}
+
+/* Must be called before the page cache of @inode is used */
+void ext4_set_inode_mapping_order(struct inode *inode)
+{
+	if (ext4_should_enable_large_folio(inode))
+		mapping_set_large_folios(inode->i_mapping);
+}
+
 void ext4_set_inode_flags(struct inode *inode, bool init)
 {
 	unsigned int flags = EXT4_I(inode)->i_flags;
@@ -4935,6 +5022,7 @@ struct inode *__ext4_iget(struct super_block *sb, unsigned long ino,
 		inode->i_op = &ext4_file_inode_operations;
 		inode->i_fop = &ext4_file_operations;
 		ext4_set_aops(inode);
+		ext4_set_inode_mapping_order(inode);
 	} else if (S_ISDIR(inode->i_mode)) {
 		inode->i_op = &ext4_dir_inode_operations;
 		inode->i_fop = &ext4_dir_operations;
@@ -5998,6 +6086,15 @@ int ext4_change_inode_journal_flag(struct inode *inode, int val)
 			filemap_invalidate_unlock(inode->i_mapping);
 			return err;
 		}
+		/* Journalled data only handles small folios, drop the others */
+		if (mapping_large_folio_support(inode->i_mapping)) {
+			err = invalidate_inode_pages2(inode->i_mapping);
+			if (err < 0) {
+				filemap_invalidate_unlock(inode->i_mapping);
+				return err;
+			}
+			mapping_clear_large_folios(inode->i_mapping);
+		}
 	}
 
 	alloc_ctx = ext4_writepages_down_write(inode->i_sb);
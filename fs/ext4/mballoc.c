@@ -84,6 +84,12 @@
  * The reason for having a per cpu locality group is to reduce the contention
  * between CPUs. It is possible to get scheduled at this point.
  *
+ * The locality group of a CPU also remembers where the last stream or
+ * group allocation done from that CPU ended, which is used as the goal of
+ * the next one. The goals of the CPUs are spread over the filesystem at
+ * mount time, so concurrent allocators start scanning in different groups
+ * instead of contending on the same group locks.
+ *
  * The locality group prealloc space is used looking at whether we have
  * enough free space (pa_free) within the prealloc space.
  *
@@ -2103,13 +2109,24 @@ static int mb_mark_used(struct ext4_buddy *e4b, struct ext4_free_extent *ex)
 	return ret;
 }
 
+/*
+ * Returns the locality group of the allocating cpu, which holds the goal
+ * of its stream and group allocations.
+ */
+static inline struct ext4_locality_group *
+ext4_mb_home_lg(struct ext4_allocation_context *ac)
+{
+	if (ac->ac_lg)
+		return ac->ac_lg;
+	return raw_cpu_ptr(EXT4_SB(ac->ac_sb)->s_locality_groups);
+}
+
 /*
  * Must be called under group lock!
  */
 static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 					struct ext4_buddy *e4b)
 {
-	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
 	int ret;
 
 	BUG_ON(ac->ac_b_ex.fe_group != e4b->bd_group);
@@ -2138,12 +2155,12 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_bitmap_page);
 	ac->ac_buddy_page = e4b->bd_buddy_page;
 	get_page(ac->ac_buddy_page);
-	/* store last allocated for subsequent stream allocation */
-	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+	/* store last allocated for subsequent stream or group allocation */
+	if (ac->ac_flags & (EXT4_MB_STREAM_ALLOC | EXT4_MB_HINT_GROUP_ALLOC)) {
+		struct ext4_locality_group *lg = ext4_mb_home_lg(ac);
+
+		WRITE_ONCE(lg->lg_last_group, ac->ac_f_ex.fe_group);
+		WRITE_ONCE(lg->lg_last_start, ac->ac_f_ex.fe_start);
 	}
 	/*
 	 * As we've just preallocated more space than
@@ -2812,13 +2829,15 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 							   MB_NUM_ORDERS(sb));
 	}
 
-	/* if stream allocation is enabled, use global goal */
-	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+	/* if stream or group allocation is enabled, use the per-cpu goal */
+	if (ac->ac_flags & (EXT4_MB_STREAM_ALLOC | EXT4_MB_HINT_GROUP_ALLOC)) {
+		struct ext4_locality_group *lg = ext4_mb_home_lg(ac);
+		ext4_group_t last_group = READ_ONCE(lg->lg_last_group);
+
+		if (last_group < ngroups) {
+			ac->ac_g_ex.fe_group = last_group;
+			ac->ac_g_ex.fe_start = READ_ONCE(lg->lg_last_start);
+		}
 	}
 
 	/*
@@ -3551,7 +3570,8 @@ static void ext4_discard_work(struct work_struct *work)
 int ext4_mb_init(struct super_block *sb)
 {
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
-	unsigned i, j;
+	ext4_group_t ngroups = ext4_get_groups_count(sb);
+	unsigned i, j, nr = 0;
 	unsigned offset, offset_incr;
 	unsigned max;
 	int ret;
@@ -3682,6 +3702,10 @@ int ext4_mb_init(struct super_block *sb)
 		for (j = 0; j < PREALLOC_TB_SIZE; j++)
 			INIT_LIST_HEAD(&lg->lg_prealloc_list[j]);
 		spin_lock_init(&lg->lg_prealloc_lock);
+		/* spread the allocation goals of the cpus over the groups */
+		lg->lg_last_group = div_u64((u64)ngroups * nr++,
+					    num_possible_cpus());
+		lg->lg_last_start = 0;
 	}
 
 	if (bdev_nonrot(sb->s_bdev))
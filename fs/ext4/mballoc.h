@@ -168,6 +168,9 @@ struct ext4_locality_group {
 	/* list of preallocations */
 	struct list_head	lg_prealloc_list[PREALLOC_TB_SIZE];
 	spinlock_t		lg_prealloc_lock;
+	/* where last stream or group allocation of this cpu was done */
+	ext4_group_t		lg_last_group;
+	ext4_grpblk_t		lg_last_start;
 };
 
 struct ext4_allocation_context {
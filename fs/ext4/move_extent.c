@@ -318,9 +318,11 @@ move_extent_per_page(struct file *o_filp, struct inode *donor_inode,
 	 * necessary, just swap data blocks between orig and donor.
 	 */
 
-	VM_BUG_ON_FOLIO(folio_test_large(folio[0]), folio[0]);
-	VM_BUG_ON_FOLIO(folio_test_large(folio[1]), folio[1]);
-	VM_BUG_ON_FOLIO(folio_nr_pages(folio[0]) != folio_nr_pages(folio[1]), folio[1]);
+	/* Extents are moved one page at a time, large folios are not handled */
+	if (folio_test_large(folio[0]) || folio_test_large(folio[1])) {
+		*err = -EOPNOTSUPP;
+		goto unlock_folios;
+	}
 
 	if (unwritten) {
 		ext4_double_down_write_data_sem(orig_inode, donor_inode);
@@ -1433,15 +1433,18 @@ static void queue_io(struct bdi_writeback *wb, struct wb_writeback_work *work,
 		     unsigned long dirtied_before)
 {
 	int moved;
+	unsigned long more;
 	unsigned long time_expire_jif = dirtied_before;
 
 	assert_spin_locked(&wb->list_lock);
+	more = list_count_nodes(&wb->b_more_io);
 	list_splice_init(&wb->b_more_io, &wb->b_io);
 	moved = move_expired_inodes(&wb->b_dirty, &wb->b_io, dirtied_before);
 	if (!work->for_sync)
 		time_expire_jif = jiffies - dirtytime_expire_interval * HZ;
 	moved += move_expired_inodes(&wb->b_dirty_time, &wb->b_io,
 				     time_expire_jif);
+	WRITE_ONCE(wb->b_io_queued, more + moved);
 	if (moved)
 		wb_io_lists_populated(wb);
 	trace_writeback_queue_io(wb, work, dirtied_before, moved);
@@ -1784,8 +1787,24 @@ static long writeback_chunk_size(struct bdi_writeback *wb,
 	if (work->sync_mode == WB_SYNC_ALL || work->tagged_writepages)
 		pages = LONG_MAX;
 	else {
+		struct wb_domain *dom = mem_cgroup_wb_domain(wb);
+		unsigned long dirty_limit = global_wb_domain.dirty_limit;
+		unsigned long nr_inodes = READ_ONCE(wb->b_io_queued);
+
+		/* A cgroup wb is bound by the dirty limit of its memcg too */
+		if (dom)
+			dirty_limit = min(dirty_limit, dom->dirty_limit);
+
 		pages = min(wb->avg_write_bandwidth / 2,
-			    global_wb_domain.dirty_limit / DIRTY_SCOPE);
+			    dirty_limit / DIRTY_SCOPE);
+		/*
+		 * Share the slice among the inodes queued for this round,
+		 * so that a large inode can't keep all the others waiting
+		 * for the whole slice. It is requeued to b_more_io and gets
+		 * its next chunk once they have been written.
+		 */
+		if (nr_inodes > 1)
+			pages /= nr_inodes;
 		pages = min(pages, work->nr_pages);
 		pages = round_down(pages + MIN_WRITEBACK_PAGES,
 				   MIN_WRITEBACK_PAGES);
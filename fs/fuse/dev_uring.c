@@ -0,0 +1,680 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE: Filesystem in Userspace
+ *
+ * io-uring transport for FUSE requests
+ *
+ * The daemon registers request buffers ("ring entries") on per CPU queues
+ * with FUSE_IO_URING_CMD_REGISTER. The command stays queued in io-uring until
+ * a request issued on that CPU is copied into the entry, from the daemon's
+ * task context, and the command is completed. The daemon then sends the
+ * reply and waits for the next request with one
+ * FUSE_IO_URING_CMD_COMMIT_AND_FETCH command, so no read(2)/write(2) on
+ * /dev/fuse is needed per request.
+ *
+ * Requests are only sent through the ring once every queue has an entry.
+ * FUSE_INTERRUPT, FUSE_FORGET and notifications keep using /dev/fuse.
+ */
+
+#include "fuse_i.h"
+#include "fuse_dev_i.h"
+#include "dev_uring_i.h"
+
+#include <linux/io_uring.h>
+#include <linux/sched/task.h>
+#include <linux/uio.h>
+
+/* Header buffer and payload buffer */
+#define FUSE_URING_IOV_SEGS	2
+
+static struct fuse_ring_ent *uring_cmd_to_ring_ent(struct io_uring_cmd *cmd)
+{
+	return *(struct fuse_ring_ent **)cmd->pdu;
+}
+
+static void uring_cmd_set_ring_ent(struct io_uring_cmd *cmd,
+				   struct fuse_ring_ent *ent)
+{
+	*(struct fuse_ring_ent **)cmd->pdu = ent;
+}
+
+/* Unregister @ent, called with queue->lock held */
+static void fuse_uring_ent_release(struct fuse_ring_ent *ent)
+{
+	lockdep_assert_held(&ent->queue->lock);
+
+	xa_erase(&ent->queue->ents, ent->id);
+	list_del_init(&ent->list);
+}
+
+static void fuse_uring_ent_free(struct fuse_ring_ent *ent)
+{
+	put_task_struct(ent->task);
+	kfree(ent);
+}
+
+/*
+ * Hand the first queued request to @ent, or make @ent available if there
+ * is none. The returned request has to be sent with fuse_uring_send_req().
+ */
+static struct fuse_req *fuse_uring_ent_next_req(struct fuse_ring_ent *ent)
+{
+	struct fuse_ring_queue *queue = ent->queue;
+	struct fuse_req *req;
+
+	lockdep_assert_held(&queue->lock);
+
+	req = list_first_entry_or_null(&queue->fuse_req_queue, struct fuse_req,
+				       list);
+	if (!req) {
+		ent->state = FRRS_AVAILABLE;
+		list_move(&ent->list, &queue->ent_avail_queue);
+		return NULL;
+	}
+
+	list_del_init(&req->list);
+	clear_bit(FR_PENDING, &req->flags);
+	ent->fuse_req = req;
+	ent->state = FRRS_FUSE_REQ;
+	list_move(&ent->list, &queue->ent_busy_queue);
+	return req;
+}
+
+/* Copy the request header and arguments into the buffers of @ent */
+static int fuse_uring_copy_to_ring(struct fuse_ring_ent *ent,
+				   struct fuse_req *req)
+{
+	struct fuse_args *args = req->args;
+	struct fuse_uring_ent_in_out ent_in_out = {
+		.commit_id = ent->id,
+	};
+	size_t payload_sz = req->in.h.len - sizeof(req->in.h);
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	int err;
+
+	if (payload_sz > ent->payload_sz)
+		return args->opcode == FUSE_SETXATTR ? -E2BIG : -EIO;
+
+	err = import_ubuf(ITER_DEST, ent->payload, payload_sz, &iter);
+	if (err)
+		return err;
+
+	fuse_copy_init(&cs, 1, &iter);
+	cs.req = req;
+	err = fuse_copy_args(&cs, args->in_numargs, args->in_pages,
+			     (struct fuse_arg *) args->in_args, 0);
+	fuse_copy_finish(&cs);
+	if (err)
+		return err;
+
+	ent_in_out.payload_sz = payload_sz;
+	if (copy_to_user(&ent->headers->in_out, &req->in.h, sizeof(req->in.h)) ||
+	    copy_to_user(&ent->headers->ring_ent_in_out, &ent_in_out,
+			 sizeof(ent_in_out)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* Copy the reply header and arguments from the buffers of @ent */
+static int fuse_uring_copy_from_ring(struct fuse_ring_ent *ent,
+				     struct fuse_req *req)
+{
+	struct fuse_uring_ent_in_out ent_in_out;
+	struct fuse_out_header oh;
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	int err;
+
+	if (copy_from_user(&oh, &ent->headers->in_out, sizeof(oh)) ||
+	    copy_from_user(&ent_in_out, &ent->headers->ring_ent_in_out,
+			   sizeof(ent_in_out)))
+		return -EFAULT;
+
+	if (oh.unique != req->in.h.unique || oh.error <= -512 || oh.error > 0)
+		return -EINVAL;
+	if (ent_in_out.payload_sz > ent->payload_sz)
+		return -EINVAL;
+
+	req->out.h = oh;
+	if (oh.error)
+		return ent_in_out.payload_sz ? -EINVAL : 0;
+
+	err = import_ubuf(ITER_SOURCE, ent->payload, ent_in_out.payload_sz,
+			  &iter);
+	if (err)
+		return err;
+
+	fuse_copy_init(&cs, 0, &iter);
+	cs.req = req;
+	err = fuse_copy_out_args(&cs, req->args,
+				 sizeof(oh) + ent_in_out.payload_sz);
+	fuse_copy_finish(&cs);
+
+	return err;
+}
+
+static void fuse_uring_send_in_task(struct io_uring_cmd *cmd,
+				    unsigned int issue_flags)
+{
+	struct fuse_ring_ent *ent = uring_cmd_to_ring_ent(cmd);
+	struct fuse_ring_queue *queue = ent->queue;
+	struct fuse_req *req = ent->fuse_req;
+	struct fuse_req *next;
+	int err;
+
+again:
+	err = fuse_uring_copy_to_ring(ent, req);
+
+	spin_lock(&queue->lock);
+	clear_bit(FR_LOCKED, &req->flags);
+	if (queue->stopped) {
+		/* fuse_uring_abort() left the request to us */
+		if (!test_bit(FR_PRIVATE, &req->flags))
+			list_del_init(&req->list);
+		ent->fuse_req = NULL;
+		fuse_uring_ent_release(ent);
+		spin_unlock(&queue->lock);
+
+		fuse_request_end(req);
+		io_uring_cmd_done(cmd, -ENOTCONN, 0, issue_flags);
+		fuse_uring_ent_free(ent);
+		return;
+	}
+
+	if (err) {
+		ent->fuse_req = NULL;
+		next = fuse_uring_ent_next_req(ent);
+		spin_unlock(&queue->lock);
+
+		req->out.h.error = err == -E2BIG ? -E2BIG : -EIO;
+		fuse_request_end(req);
+		if (next) {
+			req = next;
+			goto again;
+		}
+		return;
+	}
+
+	ent->state = FRRS_USERSPACE;
+	/* Requests without reply end here, the commit only fetches */
+	if (!test_bit(FR_ISREPLY, &req->flags)) {
+		ent->fuse_req = NULL;
+		spin_unlock(&queue->lock);
+		fuse_request_end(req);
+		io_uring_cmd_done(cmd, 0, 0, issue_flags);
+		return;
+	}
+
+	__fuse_get_request(req);
+	set_bit(FR_SENT, &req->flags);
+	spin_unlock(&queue->lock);
+
+	/* matches barrier in request_wait_answer() */
+	smp_mb__after_atomic();
+	if (test_bit(FR_INTERRUPTED, &req->flags))
+		fuse_queue_interrupt(req);
+	fuse_put_request(req);
+
+	io_uring_cmd_done(cmd, 0, 0, issue_flags);
+}
+
+/* Copy the request of @ent into the daemon's buffers from its task */
+static void fuse_uring_send_req(struct fuse_ring_ent *ent)
+{
+	io_uring_cmd_complete_in_task(ent->cmd, fuse_uring_send_in_task);
+}
+
+static void fuse_uring_cancel_in_task(struct io_uring_cmd *cmd,
+				      unsigned int issue_flags)
+{
+	struct fuse_ring_ent *ent = uring_cmd_to_ring_ent(cmd);
+
+	io_uring_cmd_done(cmd, -ENOTCONN, 0, issue_flags);
+	fuse_uring_ent_free(ent);
+}
+
+/**
+ * fuse_uring_queue_req - queue a request on the ring queue of this CPU
+ * @req: the request, with the in header set up
+ *
+ * Return: False if the ring got stopped, the request then has to take the
+ * /dev/fuse path.
+ *
+ * Context: Called with fiq->lock held.
+ */
+bool fuse_uring_queue_req(struct fuse_req *req)
+{
+	struct fuse_ring *ring = req->fm->fc->ring;
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+
+	queue = ring->queues[raw_smp_processor_id()];
+
+	spin_lock(&queue->lock);
+	if (queue->stopped) {
+		spin_unlock(&queue->lock);
+		return false;
+	}
+
+	set_bit(FR_URING, &req->flags);
+	req->ring_queue = queue;
+	list_add_tail(&req->list, &queue->fuse_req_queue);
+
+	ent = list_first_entry_or_null(&queue->ent_avail_queue,
+				       struct fuse_ring_ent, list);
+	if (ent)
+		fuse_uring_ent_next_req(ent);
+	spin_unlock(&queue->lock);
+
+	if (ent)
+		fuse_uring_send_req(ent);
+	return true;
+}
+
+/* Remove a request not yet sent to the daemon from its ring queue */
+bool fuse_uring_remove_pending_req(struct fuse_req *req)
+{
+	struct fuse_ring_queue *queue = req->ring_queue;
+	bool removed = false;
+
+	spin_lock(&queue->lock);
+	if (test_bit(FR_PENDING, &req->flags)) {
+		list_del(&req->list);
+		removed = true;
+	}
+	spin_unlock(&queue->lock);
+
+	return removed;
+}
+
+/**
+ * fuse_uring_abort - stop the ring queues of an aborted connection
+ * @fc: the connection
+ * @to_end: list collecting the requests to end
+ *
+ * Queued requests and those handled by the daemon are moved to @to_end.
+ * Requests being copied are ended by the copying task, or moved to @to_end
+ * like fuse_abort_conn() does for /dev/fuse. The commands of the available
+ * entries are completed with -ENOTCONN.
+ *
+ * Context: Called with fc->lock held.
+ */
+void fuse_uring_abort(struct fuse_conn *fc, struct list_head *to_end)
+{
+	struct fuse_ring *ring = fc->ring;
+	struct fuse_ring_ent *ent, *next;
+	struct fuse_req *req;
+	unsigned int qid;
+
+	if (!ring)
+		return;
+
+	for (qid = 0; qid < ring->nr_queues; qid++) {
+		struct fuse_ring_queue *queue = ring->queues[qid];
+
+		spin_lock(&queue->lock);
+		queue->stopped = true;
+
+		list_for_each_entry(req, &queue->fuse_req_queue, list)
+			clear_bit(FR_PENDING, &req->flags);
+		list_splice_tail_init(&queue->fuse_req_queue, to_end);
+
+		list_for_each_entry(ent, &queue->ent_busy_queue, list) {
+			req = ent->fuse_req;
+			if (!req)
+				continue;
+
+			if (ent->state == FRRS_USERSPACE) {
+				ent->fuse_req = NULL;
+				list_add_tail(&req->list, to_end);
+				continue;
+			}
+
+			req->out.h.error = -ECONNABORTED;
+			spin_lock(&req->waitq.lock);
+			set_bit(FR_ABORTED, &req->flags);
+			if (!test_bit(FR_LOCKED, &req->flags)) {
+				set_bit(FR_PRIVATE, &req->flags);
+				__fuse_get_request(req);
+				list_add_tail(&req->list, to_end);
+			}
+			spin_unlock(&req->waitq.lock);
+		}
+
+		list_for_each_entry_safe(ent, next, &queue->ent_avail_queue,
+					 list) {
+			fuse_uring_ent_release(ent);
+			io_uring_cmd_complete_in_task(ent->cmd,
+						      fuse_uring_cancel_in_task);
+		}
+		spin_unlock(&queue->lock);
+	}
+}
+
+/*
+ * Queued io-uring commands keep an exiting daemon from tearing down its
+ * ring, as they hold a reference on /dev/fuse. Abort the connection once a
+ * task owning entries exits, which completes the commands.
+ */
+static void fuse_uring_monitor_work(struct work_struct *work)
+{
+	struct fuse_ring *ring = container_of(to_delayed_work(work),
+					      struct fuse_ring, monitor_work);
+	struct fuse_ring_ent *ent;
+	bool exiting = false;
+	bool stopped = false;
+	unsigned int qid;
+
+	for (qid = 0; qid < ring->nr_queues && !exiting; qid++) {
+		struct fuse_ring_queue *queue = ring->queues[qid];
+
+		spin_lock(&queue->lock);
+		stopped |= queue->stopped;
+		list_for_each_entry(ent, &queue->ent_avail_queue, list)
+			exiting |= !!(ent->task->flags & PF_EXITING);
+		list_for_each_entry(ent, &queue->ent_busy_queue, list)
+			exiting |= !!(ent->task->flags & PF_EXITING);
+		spin_unlock(&queue->lock);
+	}
+
+	if (exiting)
+		fuse_abort_conn(ring->fc);
+	else if (!stopped)
+		schedule_delayed_work(&ring->monitor_work,
+				      FUSE_URING_MONITOR_PERIOD);
+}
+
+static void fuse_uring_free(struct fuse_ring *ring)
+{
+	struct fuse_ring_ent *ent;
+	unsigned long index;
+	unsigned int qid;
+
+	for (qid = 0; qid < ring->nr_queues; qid++) {
+		struct fuse_ring_queue *queue = ring->queues[qid];
+
+		if (!queue)
+			continue;
+
+		/* Entries the daemon never committed */
+		xa_for_each(&queue->ents, index, ent)
+			fuse_uring_ent_free(ent);
+		xa_destroy(&queue->ents);
+		kfree(queue);
+	}
+	kfree(ring);
+}
+
+void fuse_uring_destruct(struct fuse_conn *fc)
+{
+	struct fuse_ring *ring = fc->ring;
+
+	if (!ring)
+		return;
+
+	cancel_delayed_work_sync(&ring->monitor_work);
+	fuse_uring_free(ring);
+	fc->ring = NULL;
+}
+
+static struct fuse_ring *fuse_uring_create(struct fuse_conn *fc)
+{
+	unsigned int nr_queues = nr_cpu_ids;
+	struct fuse_ring *ring;
+	unsigned int qid;
+
+	ring = READ_ONCE(fc->ring);
+	if (ring)
+		return ring;
+
+	ring = kzalloc(struct_size(ring, queues, nr_queues), GFP_KERNEL_ACCOUNT);
+	if (!ring)
+		return ERR_PTR(-ENOMEM);
+
+	ring->fc = fc;
+	ring->nr_queues = nr_queues;
+	ring->max_payload_sz = max3((size_t)FUSE_MIN_READ_BUFFER,
+				    sizeof(struct fuse_write_in) + fc->max_write,
+				    (size_t)fc->max_pages << PAGE_SHIFT);
+	atomic_set(&ring->nr_queues_ready, 0);
+	INIT_DELAYED_WORK(&ring->monitor_work, fuse_uring_monitor_work);
+
+	for (qid = 0; qid < nr_queues; qid++) {
+		struct fuse_ring_queue *queue;
+
+		queue = kzalloc(sizeof(*queue), GFP_KERNEL_ACCOUNT);
+		if (!queue) {
+			fuse_uring_free(ring);
+			return ERR_PTR(-ENOMEM);
+		}
+		queue->ring = ring;
+		queue->qid = qid;
+		spin_lock_init(&queue->lock);
+		xa_init_flags(&queue->ents, XA_FLAGS_ALLOC);
+		INIT_LIST_HEAD(&queue->ent_avail_queue);
+		INIT_LIST_HEAD(&queue->ent_busy_queue);
+		INIT_LIST_HEAD(&queue->fuse_req_queue);
+		ring->queues[qid] = queue;
+	}
+
+	/* Installed under fc->lock, so that fuse_abort_conn() sees it */
+	spin_lock(&fc->lock);
+	if (fc->ring) {
+		spin_unlock(&fc->lock);
+		fuse_uring_free(ring);
+		return fc->ring;
+	}
+	if (!fc->connected) {
+		spin_unlock(&fc->lock);
+		fuse_uring_free(ring);
+		return ERR_PTR(-ENOTCONN);
+	}
+	WRITE_ONCE(fc->ring, ring);
+	spin_unlock(&fc->lock);
+
+	return ring;
+}
+
+static int fuse_uring_get_iovec_from_sqe(const struct io_uring_sqe *sqe,
+					 struct iovec iov[FUSE_URING_IOV_SEGS])
+{
+	struct iovec __user *uiov = u64_to_user_ptr(READ_ONCE(sqe->addr));
+
+	if (READ_ONCE(sqe->len) != FUSE_URING_IOV_SEGS)
+		return -EINVAL;
+
+	if (copy_from_user(iov, uiov, sizeof(*iov) * FUSE_URING_IOV_SEGS))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int fuse_uring_register(struct io_uring_cmd *cmd,
+			       unsigned int issue_flags, struct fuse_conn *fc)
+{
+	const struct fuse_uring_cmd_req *cmd_req = io_uring_sqe_cmd(cmd->sqe);
+	struct iovec iov[FUSE_URING_IOV_SEGS];
+	u16 qid = READ_ONCE(cmd_req->qid);
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+	struct fuse_ring *ring;
+	struct fuse_req *req;
+	bool first;
+	int err;
+
+	ring = fuse_uring_create(fc);
+	if (IS_ERR(ring))
+		return PTR_ERR(ring);
+
+	if (qid >= ring->nr_queues)
+		return -EINVAL;
+	queue = ring->queues[qid];
+
+	err = fuse_uring_get_iovec_from_sqe(cmd->sqe, iov);
+	if (err)
+		return err;
+
+	if (iov[0].iov_len < sizeof(struct fuse_uring_req_header) ||
+	    iov[1].iov_len < ring->max_payload_sz)
+		return -EINVAL;
+
+	ent = kzalloc(sizeof(*ent), GFP_KERNEL_ACCOUNT);
+	if (!ent)
+		return -ENOMEM;
+
+	ent->headers = iov[0].iov_base;
+	ent->payload = iov[1].iov_base;
+	ent->payload_sz = iov[1].iov_len;
+	ent->cmd = cmd;
+	ent->queue = queue;
+	ent->state = FRRS_AVAILABLE;
+	INIT_LIST_HEAD(&ent->list);
+
+	err = xa_alloc(&queue->ents, &ent->id, ent, xa_limit_32b,
+		       GFP_KERNEL_ACCOUNT);
+	if (err) {
+		kfree(ent);
+		return err;
+	}
+	ent->task = get_task_struct(current);
+	uring_cmd_set_ring_ent(cmd, ent);
+
+	spin_lock(&queue->lock);
+	if (queue->stopped) {
+		fuse_uring_ent_release(ent);
+		spin_unlock(&queue->lock);
+		fuse_uring_ent_free(ent);
+		return -ENOTCONN;
+	}
+	first = list_empty(&queue->ent_avail_queue) &&
+		list_empty(&queue->ent_busy_queue);
+	req = fuse_uring_ent_next_req(ent);
+	spin_unlock(&queue->lock);
+
+	if (req)
+		fuse_uring_send_req(ent);
+
+	if (first &&
+	    atomic_inc_return(&ring->nr_queues_ready) == ring->nr_queues)
+		WRITE_ONCE(ring->ready, true);
+
+	schedule_delayed_work(&ring->monitor_work, FUSE_URING_MONITOR_PERIOD);
+
+	return -EIOCBQUEUED;
+}
+
+static int fuse_uring_commit_fetch(struct io_uring_cmd *cmd,
+				   unsigned int issue_flags,
+				   struct fuse_conn *fc)
+{
+	const struct fuse_uring_cmd_req *cmd_req = io_uring_sqe_cmd(cmd->sqe);
+	u64 commit_id = READ_ONCE(cmd_req->commit_id);
+	u16 qid = READ_ONCE(cmd_req->qid);
+	struct fuse_ring *ring = READ_ONCE(fc->ring);
+	struct fuse_ring_queue *queue;
+	struct fuse_ring_ent *ent;
+	struct fuse_req *req;
+	int err;
+
+	if (!ring || qid >= ring->nr_queues || commit_id > U32_MAX)
+		return -EINVAL;
+	queue = ring->queues[qid];
+
+	spin_lock(&queue->lock);
+	ent = xa_load(&queue->ents, commit_id);
+	if (!ent || ent->state != FRRS_USERSPACE) {
+		spin_unlock(&queue->lock);
+		return -EINVAL;
+	}
+	if (queue->stopped)
+		goto stopped;
+
+	req = ent->fuse_req;
+	ent->cmd = cmd;
+	ent->state = FRRS_COMMIT;
+	uring_cmd_set_ring_ent(cmd, ent);
+	if (req) {
+		clear_bit(FR_SENT, &req->flags);
+		set_bit(FR_LOCKED, &req->flags);
+	}
+	spin_unlock(&queue->lock);
+
+	if (req) {
+		err = fuse_uring_copy_from_ring(ent, req);
+
+		spin_lock(&queue->lock);
+		clear_bit(FR_LOCKED, &req->flags);
+		if (queue->stopped)
+			err = -ENOENT;
+		else if (err)
+			req->out.h.error = -EIO;
+		if (!test_bit(FR_PRIVATE, &req->flags))
+			list_del_init(&req->list);
+		ent->fuse_req = NULL;
+		spin_unlock(&queue->lock);
+
+		fuse_request_end(req);
+	}
+
+	spin_lock(&queue->lock);
+	if (queue->stopped)
+		goto stopped;
+	req = fuse_uring_ent_next_req(ent);
+	spin_unlock(&queue->lock);
+
+	if (req)
+		fuse_uring_send_req(ent);
+
+	return -EIOCBQUEUED;
+
+stopped:
+	fuse_uring_ent_release(ent);
+	spin_unlock(&queue->lock);
+	fuse_uring_ent_free(ent);
+	return -ENOTCONN;
+}
+
+/**
+ * fuse_uring_cmd - io-uring command handler of /dev/fuse
+ * @cmd: the command, issued with a 128 byte SQE
+ * @issue_flags: io-uring issue flags
+ *
+ * Return: -EIOCBQUEUED if the command was queued waiting for a request,
+ * a negative error otherwise.
+ */
+int fuse_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
+{
+	const struct fuse_uring_cmd_req *cmd_req = io_uring_sqe_cmd(cmd->sqe);
+	struct fuse_dev *fud = fuse_get_dev(cmd->file);
+	struct fuse_conn *fc;
+
+	if (!fud)
+		return -EPERM;
+	fc = fud->fc;
+
+	if (!(issue_flags & IO_URING_F_SQE128))
+		return -EINVAL;
+	if (READ_ONCE(cmd_req->flags))
+		return -EINVAL;
+
+	/* The ring is set up after the INIT reply negotiated it */
+	if (!fc->initialized)
+		return -EOPNOTSUPP;
+	/* Pairs with smp_wmb() in fuse_set_initialized() */
+	smp_rmb();
+	if (!fc->io_uring)
+		return -EOPNOTSUPP;
+	if (!READ_ONCE(fc->connected))
+		return -ENOTCONN;
+
+	switch (cmd->cmd_op) {
+	case FUSE_IO_URING_CMD_REGISTER:
+		return fuse_uring_register(cmd, issue_flags, fc);
+	case FUSE_IO_URING_CMD_COMMIT_AND_FETCH:
+		return fuse_uring_commit_fetch(cmd, issue_flags, fc);
+	default:
+		return -EINVAL;
+	}
+}
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * FUSE: Filesystem in Userspace
+ *
+ * io-uring transport for FUSE requests
+ */
+#ifndef _FS_FUSE_DEV_URING_I_H
+#define _FS_FUSE_DEV_URING_I_H
+
+#include "fuse_i.h"
+
+#ifdef CONFIG_FUSE_IO_URING
+
+/* How often the tasks owning the ring entries are checked for exit */
+#define FUSE_URING_MONITOR_PERIOD	(5 * HZ)
+
+enum fuse_ring_ent_state {
+	/* Waiting in io-uring for a request */
+	FRRS_AVAILABLE,
+	/* A request is being copied to the daemon */
+	FRRS_FUSE_REQ,
+	/* The daemon handles the request */
+	FRRS_USERSPACE,
+	/* The reply is being copied from the daemon */
+	FRRS_COMMIT,
+};
+
+/** A request/reply buffer pair registered by the daemon */
+struct fuse_ring_ent {
+	/* Buffers in the daemon */
+	struct fuse_uring_req_header __user *headers;
+	void __user *payload;
+	size_t payload_sz;
+
+	/* Command the entry got registered or committed with */
+	struct io_uring_cmd *cmd;
+
+	/* Task which registered the entry */
+	struct task_struct *task;
+
+	struct fuse_ring_queue *queue;
+
+	/* Identifies the entry in FUSE_IO_URING_CMD_COMMIT_AND_FETCH */
+	u32 id;
+
+	/* Entry of the avail or busy list of the queue */
+	struct list_head list;
+	enum fuse_ring_ent_state state;
+
+	/* Request handled through this entry, if any */
+	struct fuse_req *fuse_req;
+};
+
+/** Queue of the requests issued on one CPU */
+struct fuse_ring_queue {
+	struct fuse_ring *ring;
+	unsigned int qid;
+
+	/* Protects the entries and the lists below */
+	spinlock_t lock;
+
+	/* Registered entries, indexed by id */
+	struct xarray ents;
+
+	/* Entries waiting for a request */
+	struct list_head ent_avail_queue;
+
+	/* Entries handling a request */
+	struct list_head ent_busy_queue;
+
+	/* Requests waiting for an entry */
+	struct list_head fuse_req_queue;
+
+	/* Set on connection abort, no more requests are accepted */
+	bool stopped;
+};
+
+/** io-uring queues of a connection, one per possible CPU */
+struct fuse_ring {
+	struct fuse_conn *fc;
+	unsigned int nr_queues;
+
+	/* Minimum size of the payload buffers */
+	size_t max_payload_sz;
+
+	/* Number of queues with at least one entry */
+	atomic_t nr_queues_ready;
+
+	/* Requests are sent through the ring once every queue has an entry */
+	bool ready;
+
+	/* Aborts the connection if a daemon task exits with entries queued */
+	struct delayed_work monitor_work;
+
+	struct fuse_ring_queue *queues[];
+};
+
+int fuse_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags);
+bool fuse_uring_queue_req(struct fuse_req *req);
+bool fuse_uring_remove_pending_req(struct fuse_req *req);
+void fuse_uring_abort(struct fuse_conn *fc, struct list_head *to_end);
+void fuse_uring_destruct(struct fuse_conn *fc);
+
+static inline bool fuse_uring_ready(struct fuse_conn *fc)
+{
+	struct fuse_ring *ring = READ_ONCE(fc->ring);
+
+	return ring && READ_ONCE(ring->ready);
+}
+
+#else /* CONFIG_FUSE_IO_URING */
+
+static inline bool fuse_uring_queue_req(struct fuse_req *req)
+{
+	return false;
+}
+
+static inline bool fuse_uring_remove_pending_req(struct fuse_req *req)
+{
+	return false;
+}
+
+static inline void fuse_uring_abort(struct fuse_conn *fc,
+				    struct list_head *to_end)
+{
+}
+
+static inline void fuse_uring_destruct(struct fuse_conn *fc)
+{
+}
+
+static inline bool fuse_uring_ready(struct fuse_conn *fc)
+{
+	return false;
+}
+
+#endif /* CONFIG_FUSE_IO_URING */
+
+#endif /* _FS_FUSE_DEV_URING_I_H */
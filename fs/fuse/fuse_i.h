@@ -31,6 +31,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
 #include <linux/user_namespace.h>
+#include <linux/idr.h>
 
 /** Default max number of pages that can be used in a single read request */
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
@@ -115,6 +116,11 @@ struct fuse_inode {
 
 			/* List of writepage requestst (pending or sent) */
 			struct rb_root writepages;
+
+			/* Number of cached io opens if positive, number of
+			 * passthrough opens if negative.  Protected by
+			 * fi->lock */
+			int iocachectr;
 		};
 
 		/* readdir cache (directory only) */
@@ -229,8 +235,32 @@ struct fuse_file {
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
 
+	/** Backing file id returned by open, valid until finish_open */
+	int backing_id;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** Backing file for passthrough io, NULL for other opens */
+	struct file *passthrough;
+
+	/** Credentials of the server used to access the backing file */
+	const struct cred *cred;
+#endif
+
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Does this open keep the inode in cached io mode? */
+	bool cached_io:1;
+};
+
+/** Backing file registered by the server for passthrough io */
+struct fuse_backing {
+	struct file *file;
+	const struct cred *cred;
+
+	/** Refcount */
+	refcount_t count;
+	struct rcu_head rcu;
 };
 
 /** One input argument of a request */
@@ -321,6 +351,7 @@ struct fuse_io_priv {
  * FR_FINISHED:		request is finished
  * FR_PRIVATE:		request is on private list
  * FR_ASYNC:		request is asynchronous
+ * FR_URING:		request is handled through the io-uring queues
  */
 enum fuse_req_flag {
 	FR_ISREPLY,
@@ -335,8 +366,12 @@ enum fuse_req_flag {
 	FR_FINISHED,
 	FR_PRIVATE,
 	FR_ASYNC,
+	FR_URING,
 };
 
+struct fuse_ring;
+struct fuse_ring_queue;
+
 /**
  * A request to the client
  *
@@ -379,6 +414,11 @@ struct fuse_req {
 	void *argbuf;
 #endif
 
+#ifdef CONFIG_FUSE_IO_URING
+	/** io-uring queue the request got queued on */
+	struct fuse_ring_queue *ring_queue;
+#endif
+
 	/** fuse_mount this request belongs to */
 	struct fuse_mount *fm;
 };
@@ -803,6 +843,15 @@ struct fuse_conn {
 	/* Is statx not implemented by fs? */
 	unsigned int no_statx:1;
 
+	/* Passthrough read/write/mmap to backing files */
+	unsigned int passthrough:1;
+
+	/** Maximum stack depth of the passthrough backing files */
+	int max_stack_depth;
+
+	/* Use io-uring queues for the communication with the server */
+	unsigned int io_uring:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -852,6 +901,16 @@ struct fuse_conn {
 
 	/* New writepages go into this bucket */
 	struct fuse_sync_bucket __rcu *curr_bucket;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** IDR of the backing files registered by the server */
+	struct idr backing_files_map;
+#endif
+
+#ifdef CONFIG_FUSE_IO_URING
+	/** io-uring queues registered by the server */
+	struct fuse_ring *ring;
+#endif
 };
 
 /*
@@ -1023,7 +1082,7 @@ int fuse_open_common(struct inode *inode, struct file *file, bool isdir);
 
 struct fuse_file *fuse_file_alloc(struct fuse_mount *fm);
 void fuse_file_free(struct fuse_file *ff);
-void fuse_finish_open(struct inode *inode, struct file *file);
+int fuse_finish_open(struct inode *inode, struct file *file);
 
 void fuse_sync_release(struct fuse_inode *fi, struct fuse_file *ff,
 		       unsigned int flags);
@@ -1340,4 +1399,61 @@ struct fuse_file *fuse_file_open(struct fuse_mount *fm, u64 nodeid,
 void fuse_file_release(struct inode *inode, struct fuse_file *ff,
 		       unsigned int open_flags, fl_owner_t id, bool isdir);
 
+/* passthrough.c */
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+void fuse_backing_files_init(struct fuse_conn *fc);
+void fuse_backing_files_free(struct fuse_conn *fc);
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+
+int fuse_file_io_open(struct file *file, struct inode *inode);
+int fuse_file_io_mmap(struct file *file, struct inode *inode);
+void fuse_file_io_release(struct fuse_file *ff, struct inode *inode);
+
+static inline struct file *fuse_file_passthrough(struct fuse_file *ff)
+{
+	return ff->passthrough;
+}
+#else
+static inline void fuse_backing_files_init(struct fuse_conn *fc) {}
+static inline void fuse_backing_files_free(struct fuse_conn *fc) {}
+
+static inline int fuse_backing_open(struct fuse_conn *fc,
+				    struct fuse_backing_map *map)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int fuse_file_io_open(struct file *file, struct inode *inode)
+{
+	return 0;
+}
+
+static inline int fuse_file_io_mmap(struct file *file, struct inode *inode)
+{
+	return 0;
+}
+
+static inline void fuse_file_io_release(struct fuse_file *ff,
+					struct inode *inode) {}
+
+static inline struct file *fuse_file_passthrough(struct fuse_file *ff)
+{
+	return NULL;
+}
+#endif
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe,
+				     size_t len, unsigned int flags);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,449 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE passthrough to backing file.
+ *
+ * The server registers a backing file with FUSE_DEV_IOC_BACKING_OPEN and
+ * returns its id along with FOPEN_PASSTHROUGH in the reply to an open.
+ * Reads, writes, splice reads and mmap of that open file are then served
+ * by a kernel internal open of the backing file, with the credentials of
+ * the server that registered it, without a round trip to the server.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/splice.h>
+#include <linux/uio.h>
+
+struct fuse_aio_req {
+	struct kiocb iocb;
+	refcount_t ref;
+	struct kiocb *orig_iocb;
+};
+
+static struct fuse_backing *fuse_backing_get(struct fuse_backing *fb)
+{
+	if (fb && refcount_inc_not_zero(&fb->count))
+		return fb;
+	return NULL;
+}
+
+static void fuse_backing_put(struct fuse_backing *fb)
+{
+	if (refcount_dec_and_test(&fb->count)) {
+		fput(fb->file);
+		put_cred(fb->cred);
+		kfree_rcu(fb, rcu);
+	}
+}
+
+static struct fuse_backing *fuse_backing_lookup(struct fuse_conn *fc,
+						int backing_id)
+{
+	struct fuse_backing *fb;
+
+	rcu_read_lock();
+	fb = fuse_backing_get(idr_find(&fc->backing_files_map, backing_id));
+	rcu_read_unlock();
+
+	return fb;
+}
+
+void fuse_backing_files_init(struct fuse_conn *fc)
+{
+	idr_init(&fc->backing_files_map);
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	struct fuse_backing *fb;
+	int id;
+
+	idr_for_each_entry(&fc->backing_files_map, fb, id)
+		fuse_backing_put(fb);
+	idr_destroy(&fc->backing_files_map);
+}
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct fuse_backing *fb;
+	struct file *file;
+	int res;
+
+	/* The backing files are not visible to the users of the mount */
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (map->flags || map->padding)
+		return -EINVAL;
+
+	file = fget(map->fd);
+	if (!file)
+		return -EBADF;
+
+	res = -EOPNOTSUPP;
+	if (!file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	res = -ELOOP;
+	if (file_inode(file)->i_sb->s_stack_depth >= fc->max_stack_depth)
+		goto out_fput;
+
+	res = -ENOMEM;
+	fb = kmalloc(sizeof(*fb), GFP_KERNEL);
+	if (!fb)
+		goto out_fput;
+
+	fb->file = file;
+	fb->cred = prepare_creds();
+	if (!fb->cred) {
+		kfree(fb);
+		goto out_fput;
+	}
+	refcount_set(&fb->count, 1);
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	res = idr_alloc_cyclic(&fc->backing_files_map, fb, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+
+	if (res < 0)
+		fuse_backing_put(fb);
+	return res;
+
+out_fput:
+	fput(file);
+	return res;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct fuse_backing *fb;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	fb = idr_remove(&fc->backing_files_map, backing_id);
+	spin_unlock(&fc->lock);
+	if (!fb)
+		return -ENOENT;
+
+	/* Opens already using the backing file keep their own reference */
+	fuse_backing_put(fb);
+	return 0;
+}
+
+/*
+ * The page cache of the FUSE inode and the backing file of a passthrough
+ * open are not kept coherent, so an inode is only ever accessed one way:
+ * fi->iocachectr counts the opens using the page cache when positive and
+ * the passthrough opens when negative.
+ */
+static int fuse_file_cached_io_start(struct fuse_inode *fi,
+				     struct fuse_file *ff)
+{
+	int err = 0;
+
+	spin_lock(&fi->lock);
+	if (fi->iocachectr < 0) {
+		err = -ETXTBSY;
+	} else if (!ff->cached_io) {
+		ff->cached_io = true;
+		fi->iocachectr++;
+	}
+	spin_unlock(&fi->lock);
+
+	return err;
+}
+
+static int fuse_file_passthrough_open(struct file *file, struct inode *inode)
+{
+	struct fuse_file *ff = file->private_data;
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct fuse_backing *fb;
+	struct file *backing_file;
+	int err = 0;
+
+	fb = fuse_backing_lookup(get_fuse_conn(inode), ff->backing_id);
+	if (!fb)
+		return -ENOENT;
+
+	spin_lock(&fi->lock);
+	if (fi->iocachectr > 0)
+		err = -ETXTBSY;
+	else
+		fi->iocachectr--;
+	spin_unlock(&fi->lock);
+	if (err)
+		goto out_put;
+
+	backing_file = backing_file_open(&file->f_path, file->f_flags,
+					 &fb->file->f_path, fb->cred);
+	if (IS_ERR(backing_file)) {
+		err = PTR_ERR(backing_file);
+		spin_lock(&fi->lock);
+		fi->iocachectr++;
+		spin_unlock(&fi->lock);
+		goto out_put;
+	}
+
+	ff->passthrough = backing_file;
+	ff->cred = get_cred(fb->cred);
+out_put:
+	fuse_backing_put(fb);
+	return err;
+}
+
+/**
+ * fuse_file_io_open - Set up the io mode of a newly opened regular file
+ * @file:	The open file, with the fuse_file in ->private_data
+ * @inode:	The inode of @file
+ *
+ * Opens the backing file of a FOPEN_PASSTHROUGH open, or accounts a page
+ * cache user on @inode otherwise.
+ *
+ * Return: 0 on success, -ETXTBSY if @inode is already accessed the other
+ * way, or the error of the backing file lookup and open.
+ */
+int fuse_file_io_open(struct file *file, struct inode *inode)
+{
+	struct fuse_file *ff = file->private_data;
+	struct fuse_conn *fc = get_fuse_conn(inode);
+
+	if (!fc->passthrough || !S_ISREG(inode->i_mode) ||
+	    FUSE_IS_DAX(inode)) {
+		ff->open_flags &= ~FOPEN_PASSTHROUGH;
+		return 0;
+	}
+
+	if (ff->open_flags & FOPEN_PASSTHROUGH)
+		return fuse_file_passthrough_open(file, inode);
+
+	/* Direct io opens only use the page cache once they are mmapped */
+	if (ff->open_flags & FOPEN_DIRECT_IO)
+		return 0;
+
+	return fuse_file_cached_io_start(get_fuse_inode(inode), ff);
+}
+
+/* Called when a FOPEN_DIRECT_IO open gets mmapped through the page cache */
+int fuse_file_io_mmap(struct file *file, struct inode *inode)
+{
+	if (!get_fuse_conn(inode)->passthrough)
+		return 0;
+
+	return fuse_file_cached_io_start(get_fuse_inode(inode),
+					 file->private_data);
+}
+
+void fuse_file_io_release(struct fuse_file *ff, struct inode *inode)
+{
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	if (ff->passthrough) {
+		fput(ff->passthrough);
+		put_cred(ff->cred);
+		ff->passthrough = NULL;
+		ff->cred = NULL;
+
+		spin_lock(&fi->lock);
+		fi->iocachectr++;
+		spin_unlock(&fi->lock);
+	} else if (ff->cached_io) {
+		ff->cached_io = false;
+
+		spin_lock(&fi->lock);
+		fi->iocachectr--;
+		spin_unlock(&fi->lock);
+	}
+}
+
+static rwf_t fuse_iocb_to_rwf(int ifl)
+{
+	rwf_t flags = 0;
+
+	if (ifl & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+	if (ifl & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ifl & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ifl & IOCB_SYNC)
+		flags |= RWF_SYNC;
+
+	return flags;
+}
+
+static inline void fuse_aio_put(struct fuse_aio_req *aio_req)
+{
+	if (refcount_dec_and_test(&aio_req->ref)) {
+		fput(aio_req->iocb.ki_filp);
+		kfree(aio_req);
+	}
+}
+
+static void fuse_aio_cleanup_handler(struct fuse_aio_req *aio_req, long res)
+{
+	struct kiocb *iocb = &aio_req->iocb;
+	struct kiocb *orig_iocb = aio_req->orig_iocb;
+
+	if (iocb->ki_flags & IOCB_WRITE) {
+		kiocb_end_write(iocb);
+		fuse_write_update_attr(file_inode(orig_iocb->ki_filp),
+				       iocb->ki_pos, res);
+	}
+
+	orig_iocb->ki_pos = iocb->ki_pos;
+	fuse_aio_put(aio_req);
+}
+
+static void fuse_aio_rw_complete(struct kiocb *iocb, long res)
+{
+	struct fuse_aio_req *aio_req = container_of(iocb,
+						    struct fuse_aio_req, iocb);
+	struct kiocb *orig_iocb = aio_req->orig_iocb;
+
+	fuse_aio_cleanup_handler(aio_req, res);
+	orig_iocb->ki_complete(orig_iocb, res);
+}
+
+static ssize_t fuse_passthrough_aio(struct kiocb *iocb, struct iov_iter *iter,
+				    struct file *backing_file, int ifl)
+{
+	struct fuse_aio_req *aio_req;
+	ssize_t ret;
+
+	aio_req = kzalloc(sizeof(*aio_req), GFP_KERNEL);
+	if (!aio_req)
+		return -ENOMEM;
+
+	aio_req->orig_iocb = iocb;
+	kiocb_clone(&aio_req->iocb, iocb, get_file(backing_file));
+	aio_req->iocb.ki_flags = ifl;
+	aio_req->iocb.ki_complete = fuse_aio_rw_complete;
+	refcount_set(&aio_req->ref, 2);
+	if (ifl & IOCB_WRITE) {
+		kiocb_start_write(&aio_req->iocb);
+		ret = vfs_iocb_iter_write(backing_file, &aio_req->iocb, iter);
+	} else {
+		ret = vfs_iocb_iter_read(backing_file, &aio_req->iocb, iter);
+	}
+	fuse_aio_put(aio_req);
+	if (ret != -EIOCBQUEUED)
+		fuse_aio_cleanup_handler(aio_req, ret);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = fuse_file_passthrough(ff);
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(iter))
+		return 0;
+
+	if (iocb->ki_flags & IOCB_DIRECT &&
+	    !(backing_file->f_mode & FMODE_CAN_ODIRECT))
+		return -EINVAL;
+
+	old_cred = override_creds(ff->cred);
+	if (is_sync_kiocb(iocb))
+		ret = vfs_iter_read(backing_file, iter, &iocb->ki_pos,
+				    fuse_iocb_to_rwf(iocb->ki_flags));
+	else
+		ret = fuse_passthrough_aio(iocb, iter, backing_file,
+					   iocb->ki_flags & ~IOCB_WRITE);
+	revert_creds(old_cred);
+	fuse_invalidate_atime(file_inode(file));
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = fuse_file_passthrough(ff);
+	const struct cred *old_cred;
+	int ifl = iocb->ki_flags;
+	ssize_t ret;
+
+	if (!iov_iter_count(iter))
+		return 0;
+
+	if (iocb->ki_flags & IOCB_DIRECT &&
+	    !(backing_file->f_mode & FMODE_CAN_ODIRECT))
+		return -EINVAL;
+
+	/* Deferred completions are not passed on to the backing file */
+	ifl &= ~IOCB_DIO_CALLER_COMP;
+
+	inode_lock(inode);
+	old_cred = override_creds(ff->cred);
+	if (is_sync_kiocb(iocb)) {
+		file_start_write(backing_file);
+		ret = vfs_iter_write(backing_file, iter, &iocb->ki_pos,
+				     fuse_iocb_to_rwf(ifl));
+		file_end_write(backing_file);
+		fuse_write_update_attr(inode, iocb->ki_pos, ret);
+	} else {
+		ret = fuse_passthrough_aio(iocb, iter, backing_file,
+					   ifl | IOCB_WRITE);
+	}
+	revert_creds(old_cred);
+	inode_unlock(inode);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe,
+				     size_t len, unsigned int flags)
+{
+	struct fuse_file *ff = in->private_data;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	old_cred = override_creds(ff->cred);
+	ret = vfs_splice_read(fuse_file_passthrough(ff), ppos, pipe, len,
+			      flags);
+	revert_creds(old_cred);
+	fuse_invalidate_atime(file_inode(in));
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = fuse_file_passthrough(ff);
+	const struct cred *old_cred;
+	int ret;
+
+	if (!backing_file->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma_set_file(vma, backing_file);
+
+	old_cred = override_creds(ff->cred);
+	ret = call_mmap(vma->vm_file, vma);
+	revert_creds(old_cred);
+	fuse_invalidate_atime(file_inode(file));
+
+	return ret;
+}
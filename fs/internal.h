@@ -17,6 +17,8 @@ struct fs_context;
 struct pipe_inode_info;
 struct iov_iter;
 struct mnt_idmap;
+struct kstat;
+struct statx;
 
 /*
  * block/bdev.c
@@ -229,6 +231,9 @@ extern const struct dentry_operations ns_dentry_operations;
  */
 
 int getname_statx_lookup_flags(int flags);
+int vfs_statx_path(const struct path *path, int flags, struct kstat *stat,
+		   u32 request_mask);
+void statx_from_kstat(struct statx *tmp, const struct kstat *stat);
 int do_statx(int dfd, struct filename *filename, unsigned int flags,
 	     unsigned int mask, struct statx __user *buffer);
 
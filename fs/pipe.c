@@ -47,6 +47,17 @@
  */
 #define PIPE_MIN_DEF_BUFFERS 2
 
+/*
+ * Pipes grown beyond the default size store large writes in folios of up
+ * to 2MB, so that a single buffer slot and a single copy cover them. They
+ * are taken from lowmem, as some splice consumers kmap() only the first
+ * page of a buffer.
+ */
+#define PIPE_FOLIO_MIN_ORDER	get_order(SZ_64K)
+#define PIPE_FOLIO_MAX_ORDER	min_t(unsigned int, get_order(SZ_2M), MAX_ORDER)
+#define PIPE_FOLIO_GFP		(GFP_KERNEL | __GFP_ACCOUNT | __GFP_NORETRY | \
+				 __GFP_NOWARN)
+
 /*
  * The max size that a non-root user is allowed to grow the pipe. Can
  * be set by root in /proc/sys/fs/pipe-max-size
@@ -131,8 +142,10 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	 * If nobody else uses this page, and we don't already have a
 	 * temporary page, let's keep track of it as a one-deep
 	 * allocation cache. (Otherwise just release our reference to it)
+	 * Large folios are not cached, pipe_write() only wants them for
+	 * large writes.
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
+	if (page_count(page) == 1 && !pipe->tmp_page && !PageCompound(page))
 		pipe->tmp_page = page;
 	else
 		put_page(page);
@@ -143,7 +156,7 @@ static bool anon_pipe_buf_try_steal(struct pipe_inode_info *pipe,
 {
 	struct page *page = buf->page;
 
-	if (page_count(page) != 1)
+	if (page_count(page) != 1 || PageCompound(page))
 		return false;
 	memcg_kmem_uncharge_page(page, 0);
 	__SetPageLocked(page);
@@ -402,6 +415,39 @@ static inline int is_packetized(struct file *file)
 	return (file->f_flags & O_DIRECT) != 0;
 }
 
+/*
+ * Pick the order of the folio backing the next buffer of a @count bytes
+ * write. The pages held by the pipe are bounded by its size as if each of
+ * them used a slot, so large folios don't let a pipe buffer more memory
+ * than a pipe of order-0 pages would.
+ *
+ * Called with the pipe locked.
+ */
+static unsigned int pipe_write_folio_order(struct pipe_inode_info *pipe,
+					   size_t count)
+{
+	unsigned int mask = pipe->ring_size - 1;
+	unsigned int head = pipe->head;
+	unsigned int tail = pipe->tail;
+	unsigned int used = 0, order;
+
+	if (pipe->max_usage <= PIPE_DEF_BUFFERS ||
+	    count < (PAGE_SIZE << PIPE_FOLIO_MIN_ORDER))
+		return 0;
+
+	for (; tail != head; tail++) {
+		struct pipe_buffer *buf = &pipe->bufs[tail & mask];
+
+		used += max_t(unsigned int, 1,
+			      DIV_ROUND_UP(buf->offset + buf->len, PAGE_SIZE));
+	}
+	if (used + (1U << PIPE_FOLIO_MIN_ORDER) > pipe->max_usage)
+		return 0;
+
+	order = min(ilog2(count >> PAGE_SHIFT), ilog2(pipe->max_usage - used));
+	return min_t(unsigned int, order, PIPE_FOLIO_MAX_ORDER);
+}
+
 /* Done while waiting without holding the pipe lock - thus the READ_ONCE() */
 static inline bool pipe_writable(const struct pipe_inode_info *pipe)
 {
@@ -491,8 +537,20 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			unsigned int mask = pipe->ring_size - 1;
 			struct pipe_buffer *buf;
 			struct page *page = pipe->tmp_page;
+			unsigned int order = 0;
+			size_t size;
 			int copied;
 
+			if (!is_packetized(filp))
+				order = pipe_write_folio_order(pipe,
+							iov_iter_count(from));
+			if (order) {
+				struct folio *folio;
+
+				folio = folio_alloc(PIPE_FOLIO_GFP, order);
+				if (folio)
+					page = &folio->page;
+			}
 			if (!page) {
 				page = alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
 				if (unlikely(!page)) {
@@ -512,6 +570,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			head = pipe->head;
 			if (pipe_full(head, pipe->tail, pipe->max_usage)) {
 				spin_unlock_irq(&pipe->rd_wait.lock);
+				if (page != pipe->tmp_page)
+					put_page(page);
 				continue;
 			}
 
@@ -528,10 +588,12 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			else
 				buf->flags = PIPE_BUF_FLAG_CAN_MERGE;
-			pipe->tmp_page = NULL;
+			if (page == pipe->tmp_page)
+				pipe->tmp_page = NULL;
 
-			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
-			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+			size = page_size(page);
+			copied = copy_page_from_iter(page, 0, size, from);
+			if (unlikely(copied < size && iov_iter_count(from))) {
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -20,10 +20,15 @@
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
 #include <linux/compat.h>
+#include <linux/namei.h>
+#include <linux/slab.h>
+#include <linux/sizes.h>
 #include <linux/uaccess.h>
 
 #include <asm/unaligned.h>
 
+#include "internal.h"
+
 /*
  * Some filesystems were never converted to '->iterate_shared()'
  * and their directory iterators want the inode lock held for
@@ -419,6 +424,209 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 	return error;
 }
 
+/* Largest buffer getdents_statx() fills in one call */
+#define GETDENTS_STATX_MAX	SZ_128K
+
+struct getdents_statx_callback {
+	struct dir_context ctx;
+	void *buf;
+	struct statx_dirent *prev;
+	unsigned int used;
+	unsigned int count;
+	unsigned int nr;
+	int error;
+};
+
+static bool filldir_statx(struct dir_context *ctx, const char *name, int namlen,
+			  loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct getdents_statx_callback *buf =
+		container_of(ctx, struct getdents_statx_callback, ctx);
+	int reclen = ALIGN(offsetof(struct statx_dirent, d_name) + namlen + 1,
+		sizeof(u64));
+	struct statx_dirent *dirent;
+
+	buf->error = verify_dirent_name(name, namlen);
+	if (unlikely(buf->error))
+		return false;
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->count - buf->used)
+		return false;
+	if (buf->prev && signal_pending(current))
+		return false;
+
+	/* The buffer is zeroed, so the padding and d_stx are cleared already */
+	if (buf->prev)
+		buf->prev->d_off = offset;
+	dirent = buf->buf + buf->used;
+	dirent->d_ino = ino;
+	dirent->d_reclen = reclen;
+	dirent->d_type = d_type;
+	memcpy(dirent->d_name, name, namlen);
+
+	buf->prev = dirent;
+	buf->used += reclen;
+	buf->nr++;
+	return true;
+}
+
+static inline bool is_dot_or_dotdot(const char *name, int len)
+{
+	return name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.'));
+}
+
+/*
+ * Let the filesystem start reading the inodes of the entries which are not
+ * in the dcache, so that the lookups below don't wait for them one by one.
+ */
+static void getdents_statx_prefetch(struct dentry *dir,
+				    struct getdents_statx_callback *buf)
+{
+	struct super_block *sb = dir->d_sb;
+	struct statx_dirent *dirent;
+	unsigned int pos, nr = 0;
+	u64 *inos;
+
+	inos = kmalloc_array(buf->nr, sizeof(*inos), GFP_KERNEL);
+	if (!inos)
+		return;
+
+	for (pos = 0; pos < buf->used; pos += dirent->d_reclen) {
+		struct qstr qname;
+		struct dentry *dentry;
+
+		dirent = buf->buf + pos;
+		qname.name = dirent->d_name;
+		qname.len = strlen(dirent->d_name);
+		if (is_dot_or_dotdot(qname.name, qname.len))
+			continue;
+
+		dentry = d_hash_and_lookup(dir, &qname);
+		if (IS_ERR(dentry))
+			continue;
+		if (dentry)
+			dput(dentry);
+		else
+			inos[nr++] = dirent->d_ino;
+	}
+
+	if (nr)
+		sb->s_op->prefetch_inodes(sb, inos, nr);
+	kfree(inos);
+}
+
+static void getdents_statx_one(const struct path *dir,
+			       struct statx_dirent *dirent, int flags,
+			       unsigned int mask)
+{
+	int namlen = strlen(dirent->d_name);
+	struct dentry *dentry;
+	struct kstat stat;
+	struct path path;
+
+	if (namlen == 1 && dirent->d_name[0] == '.') {
+		path = *dir;
+		path_get(&path);
+	} else if (is_dot_or_dotdot(dirent->d_name, namlen)) {
+		/* The parent may be on another mount, leave it to statx() */
+		return;
+	} else {
+		dentry = lookup_one_unlocked(mnt_idmap(dir->mnt), dirent->d_name,
+					     dir->dentry, namlen);
+		if (IS_ERR(dentry))
+			return;
+		if (d_really_is_negative(dentry)) {
+			dput(dentry);
+			return;
+		}
+		path.mnt = mntget(dir->mnt);
+		path.dentry = dentry;
+		/* Report what is mounted on the entry, like statx() does */
+		follow_down(&path, 0);
+	}
+
+	if (!vfs_statx_path(&path, flags, &stat, mask))
+		statx_from_kstat(&dirent->d_stx, &stat);
+	path_put(&path);
+}
+
+/**
+ * sys_getdents_statx - Read directory entries together with their attributes
+ * @fd: Directory to read
+ * @dirent: Buffer for the struct statx_dirent records
+ * @count: Size of @dirent
+ * @flags: AT_STATX_* flags
+ * @mask: Parts of the statx structs actually required.
+ *
+ * Works like getdents64() followed by a statx() with AT_SYMLINK_NOFOLLOW of
+ * every entry returned, without the per-entry system call and path walk.
+ * Attributes of entries not cached are read after the whole directory
+ * chunk has been collected, which lets the filesystem batch the inode
+ * reads through ->prefetch_inodes().
+ *
+ * Return: The number of bytes filled in @dirent, 0 at the end of the
+ * directory or a negative error code.
+ */
+SYSCALL_DEFINE5(getdents_statx, unsigned int, fd,
+		struct statx_dirent __user *, dirent, unsigned int, count,
+		unsigned int, flags, unsigned int, mask)
+{
+	struct getdents_statx_callback buf = {
+		.ctx.actor = filldir_statx,
+	};
+	struct statx_dirent *ent;
+	unsigned int pos;
+	struct fd f;
+	int error;
+
+	if (flags & ~AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if ((flags & AT_STATX_SYNC_TYPE) == AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if (mask & STATX__RESERVED)
+		return -EINVAL;
+	/* STATX_CHANGE_COOKIE is kernel-only for now */
+	mask &= ~STATX_CHANGE_COOKIE;
+
+	buf.count = min_t(unsigned int, count, GETDENTS_STATX_MAX);
+	buf.buf = kvzalloc(buf.count, GFP_KERNEL);
+	if (!buf.buf)
+		return -ENOMEM;
+
+	f = fdget_pos(fd);
+	if (!f.file) {
+		error = -EBADF;
+		goto out_free;
+	}
+
+	error = iterate_dir(f.file, &buf.ctx);
+	if (error >= 0)
+		error = buf.error;
+	if (!buf.prev)
+		goto out_put;
+
+	buf.prev->d_off = buf.ctx.pos;
+
+	if (f.file->f_path.dentry->d_sb->s_op->prefetch_inodes)
+		getdents_statx_prefetch(f.file->f_path.dentry, &buf);
+
+	for (pos = 0; pos < buf.used; pos += ent->d_reclen) {
+		ent = buf.buf + pos;
+		getdents_statx_one(&f.file->f_path, ent, flags, mask);
+		cond_resched();
+	}
+
+	if (copy_to_user(dirent, buf.buf, buf.used))
+		error = -EFAULT;
+	else
+		error = buf.used;
+out_put:
+	fdput_pos(f);
+out_free:
+	kvfree(buf.buf);
+	return error;
+}
+
 #ifdef CONFIG_COMPAT
 struct compat_old_linux_dirent {
 	compat_ulong_t	d_ino;
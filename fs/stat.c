@@ -210,6 +210,41 @@ int getname_statx_lookup_flags(int flags)
 	return lookup_flags;
 }
 
+/**
+ * vfs_statx_path - Get basic and extra attributes of a resolved path
+ * @path: The path to stat
+ * @flags: AT_STATX_* flags
+ * @stat: The result structure to fill in.
+ * @request_mask: STATX_xxx flags indicating what the caller wants
+ *
+ * Fills in the attributes statx() reports on top of the ones of
+ * vfs_getattr(), like the mount ID.
+ */
+int vfs_statx_path(const struct path *path, int flags, struct kstat *stat,
+		   u32 request_mask)
+{
+	int error;
+
+	error = vfs_getattr(path, stat, request_mask, flags);
+
+	stat->mnt_id = real_mount(path->mnt)->mnt_id;
+	stat->result_mask |= STATX_MNT_ID;
+
+	if (path->mnt->mnt_root == path->dentry)
+		stat->attributes |= STATX_ATTR_MOUNT_ROOT;
+	stat->attributes_mask |= STATX_ATTR_MOUNT_ROOT;
+
+	/* Handle STATX_DIOALIGN for block devices. */
+	if (request_mask & STATX_DIOALIGN) {
+		struct inode *inode = d_backing_inode(path->dentry);
+
+		if (S_ISBLK(inode->i_mode))
+			bdev_statx_dioalign(inode, stat);
+	}
+
+	return error;
+}
+
 /**
  * vfs_statx - Get basic and extra attributes by filename
  * @dfd: A file descriptor representing the base dir for a relative filename
@@ -241,23 +276,7 @@ static int vfs_statx(int dfd, struct filename *filename, int flags,
 	if (error)
 		goto out;
 
-	error = vfs_getattr(&path, stat, request_mask, flags);
-
-	stat->mnt_id = real_mount(path.mnt)->mnt_id;
-	stat->result_mask |= STATX_MNT_ID;
-
-	if (path.mnt->mnt_root == path.dentry)
-		stat->attributes |= STATX_ATTR_MOUNT_ROOT;
-	stat->attributes_mask |= STATX_ATTR_MOUNT_ROOT;
-
-	/* Handle STATX_DIOALIGN for block devices. */
-	if (request_mask & STATX_DIOALIGN) {
-		struct inode *inode = d_backing_inode(path.dentry);
-
-		if (S_ISBLK(inode->i_mode))
-			bdev_statx_dioalign(inode, stat);
-	}
-
+	error = vfs_statx_path(&path, flags, stat, request_mask);
 	path_put(&path);
 	if (retry_estale(error, lookup_flags)) {
 		lookup_flags |= LOOKUP_REVAL;
@@ -614,42 +633,46 @@ SYSCALL_DEFINE4(fstatat64, int, dfd, const char __user *, filename,
 }
 #endif /* __ARCH_WANT_STAT64 || __ARCH_WANT_COMPAT_STAT64 */
 
-static noinline_for_stack int
-cp_statx(const struct kstat *stat, struct statx __user *buffer)
+void statx_from_kstat(struct statx *tmp, const struct kstat *stat)
 {
-	struct statx tmp;
-
-	memset(&tmp, 0, sizeof(tmp));
+	memset(tmp, 0, sizeof(*tmp));
 
 	/* STATX_CHANGE_COOKIE is kernel-only for now */
-	tmp.stx_mask = stat->result_mask & ~STATX_CHANGE_COOKIE;
-	tmp.stx_blksize = stat->blksize;
+	tmp->stx_mask = stat->result_mask & ~STATX_CHANGE_COOKIE;
+	tmp->stx_blksize = stat->blksize;
 	/* STATX_ATTR_CHANGE_MONOTONIC is kernel-only for now */
-	tmp.stx_attributes = stat->attributes & ~STATX_ATTR_CHANGE_MONOTONIC;
-	tmp.stx_nlink = stat->nlink;
-	tmp.stx_uid = from_kuid_munged(current_user_ns(), stat->uid);
-	tmp.stx_gid = from_kgid_munged(current_user_ns(), stat->gid);
-	tmp.stx_mode = stat->mode;
-	tmp.stx_ino = stat->ino;
-	tmp.stx_size = stat->size;
-	tmp.stx_blocks = stat->blocks;
-	tmp.stx_attributes_mask = stat->attributes_mask;
-	tmp.stx_atime.tv_sec = stat->atime.tv_sec;
-	tmp.stx_atime.tv_nsec = stat->atime.tv_nsec;
-	tmp.stx_btime.tv_sec = stat->btime.tv_sec;
-	tmp.stx_btime.tv_nsec = stat->btime.tv_nsec;
-	tmp.stx_ctime.tv_sec = stat->ctime.tv_sec;
-	tmp.stx_ctime.tv_nsec = stat->ctime.tv_nsec;
-	tmp.stx_mtime.tv_sec = stat->mtime.tv_sec;
-	tmp.stx_mtime.tv_nsec = stat->mtime.tv_nsec;
-	tmp.stx_rdev_major = MAJOR(stat->rdev);
-	tmp.stx_rdev_minor = MINOR(stat->rdev);
-	tmp.stx_dev_major = MAJOR(stat->dev);
-	tmp.stx_dev_minor = MINOR(stat->dev);
-	tmp.stx_mnt_id = stat->mnt_id;
-	tmp.stx_dio_mem_align = stat->dio_mem_align;
-	tmp.stx_dio_offset_align = stat->dio_offset_align;
+	tmp->stx_attributes = stat->attributes & ~STATX_ATTR_CHANGE_MONOTONIC;
+	tmp->stx_nlink = stat->nlink;
+	tmp->stx_uid = from_kuid_munged(current_user_ns(), stat->uid);
+	tmp->stx_gid = from_kgid_munged(current_user_ns(), stat->gid);
+	tmp->stx_mode = stat->mode;
+	tmp->stx_ino = stat->ino;
+	tmp->stx_size = stat->size;
+	tmp->stx_blocks = stat->blocks;
+	tmp->stx_attributes_mask = stat->attributes_mask;
+	tmp->stx_atime.tv_sec = stat->atime.tv_sec;
+	tmp->stx_atime.tv_nsec = stat->atime.tv_nsec;
+	tmp->stx_btime.tv_sec = stat->btime.tv_sec;
+	tmp->stx_btime.tv_nsec = stat->btime.tv_nsec;
+	tmp->stx_ctime.tv_sec = stat->ctime.tv_sec;
+	tmp->stx_ctime.tv_nsec = stat->ctime.tv_nsec;
+	tmp->stx_mtime.tv_sec = stat->mtime.tv_sec;
+	tmp->stx_mtime.tv_nsec = stat->mtime.tv_nsec;
+	tmp->stx_rdev_major = MAJOR(stat->rdev);
+	tmp->stx_rdev_minor = MINOR(stat->rdev);
+	tmp->stx_dev_major = MAJOR(stat->dev);
+	tmp->stx_dev_minor = MINOR(stat->dev);
+	tmp->stx_mnt_id = stat->mnt_id;
+	tmp->stx_dio_mem_align = stat->dio_mem_align;
+	tmp->stx_dio_offset_align = stat->dio_offset_align;
+}
+
+static noinline_for_stack int
+cp_statx(const struct kstat *stat, struct statx __user *buffer)
+{
+	struct statx tmp;
 
+	statx_from_kstat(&tmp, stat);
 	return copy_to_user(buffer, &tmp, sizeof(tmp)) ? -EFAULT : 0;
 }
 
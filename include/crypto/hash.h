@@ -196,6 +196,13 @@ struct shash_desc {
  * @update: see struct ahash_alg
  * @final: see struct ahash_alg
  * @finup: see struct ahash_alg
+ * @finup_mb: **[optional]** Finish @num_msgs messages of @len bytes each,
+ *	      all continuing from the state in the descriptor, and store their
+ *	      digests in @outs. The descriptor state is left untouched. This
+ *	      lets implementations interleave independent streams to hide the
+ *	      instruction latency. May return -EOPNOTSUPP for a combination
+ *	      it cannot handle, crypto_shash_finup_mb() then hashes the
+ *	      messages one at a time.
  * @digest: see struct ahash_alg
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
@@ -217,6 +224,8 @@ struct shash_desc {
  * @descsize: Size of the operational state for the message digest. This state
  * 	      size is the memory size that needs to be allocated for
  *	      shash_desc.__ctx
+ * @mb_max_msgs: Maximum number of messages @finup_mb handles at once, set to
+ *		 1 when @finup_mb is not provided
  * @stat: Statistics for hash algorithm.
  * @base: internally used
  * @halg: see struct hash_alg_common
@@ -229,6 +238,9 @@ struct shash_alg {
 	int (*final)(struct shash_desc *desc, u8 *out);
 	int (*finup)(struct shash_desc *desc, const u8 *data,
 		     unsigned int len, u8 *out);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 	int (*digest)(struct shash_desc *desc, const u8 *data,
 		      unsigned int len, u8 *out);
 	int (*export)(struct shash_desc *desc, void *out);
@@ -240,6 +252,7 @@ struct shash_alg {
 	int (*clone_tfm)(struct crypto_shash *dst, struct crypto_shash *src);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	union {
 		struct HASH_ALG_COMMON;
@@ -1050,6 +1063,40 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the multibuffer width of the tfm
+ * @tfm: hash transformation object
+ *
+ * Return: the number of messages crypto_shash_finup_mb() processes in
+ *	   parallel, 1 if the implementation has no multibuffer support
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
+/**
+ * crypto_shash_finup_mb() - calculate message digests of several buffers
+ * @desc: operational state handle, shared by all messages
+ * @data: array of @num_msgs input buffers, see crypto_shash_update()
+ * @len: length of each of the input buffers
+ * @outs: array of @num_msgs output buffers, see crypto_shash_final()
+ * @num_msgs: number of messages
+ *
+ * Equivalent to calling crypto_shash_finup() for each message on a copy of
+ * @desc, e.g. to hash several data blocks of the same size that are all
+ * prefixed with the same salt. Batches of up to crypto_shash_mb_max_msgs()
+ * messages are hashed in parallel if the implementation supports it, the
+ * state in @desc is left unchanged either way.
+ *
+ * Context: Any context.
+ * Return: 0 if the message digest creation was successful; < 0 if an error
+ *	   occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
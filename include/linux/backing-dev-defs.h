@@ -113,6 +113,7 @@ struct bdi_writeback {
 	struct list_head b_more_io;	/* parked for more writeback */
 	struct list_head b_dirty_time;	/* time stamps are dirty */
 	spinlock_t list_lock;		/* protects the b_* lists */
+	unsigned long b_io_queued;	/* inodes queued by last queue_io() */
 
 	atomic_t writeback_inodes;	/* number of inodes under writeback */
 	struct percpu_counter stat[NR_WB_STAT_ITEMS];
@@ -142,6 +143,7 @@ struct bdi_writeback {
 	struct delayed_work bw_dwork;	/* work item used for bandwidth estimate */
 
 	unsigned long dirty_sleep;	/* last wait */
+	unsigned long dirty_flush;	/* last background flush kick */
 
 	struct list_head bdi_node;	/* anchored at bdi->wb_list */
 
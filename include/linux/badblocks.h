@@ -3,6 +3,7 @@
 #define _LINUX_BADBLOCKS_H
 
 #include <linux/seqlock.h>
+#include <linux/rcupdate.h>
 #include <linux/device.h>
 #include <linux/kernel.h>
 #include <linux/stddef.h>
@@ -24,6 +25,16 @@
  */
 #define MAX_BADBLOCKS	(PAGE_SIZE/8)
 
+/*
+ * Read-only copy of the table published with RCU each time it changes, so that
+ * badblocks_check() never waits for or retries against a writer.
+ */
+struct badblocks_snap {
+	struct rcu_head rcu;
+	int count;
+	u64 entries[];
+};
+
 struct badblocks {
 	struct device *dev;	/* set by devm_init_badblocks */
 	int count;		/* count of bad blocks */
@@ -37,6 +48,7 @@ struct badblocks {
 	u64 *page;		/* badblock list */
 	int changed;
 	seqlock_t lock;
+	struct badblocks_snap __rcu *snap;	/* NULL: use the seqlock */
 	sector_t sector;
 	sector_t size;		/* in sectors */
 };
@@ -11,6 +11,7 @@
 
 struct blk_mq_tags;
 struct blk_flush_queue;
+struct blk_mq_lat_stats;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_DEFAULT_RQ	128
@@ -111,6 +112,10 @@ struct request {
 	u64 start_time_ns;
 	/* Time that I/O was submitted to the device. */
 	u64 io_start_time_ns;
+#ifdef CONFIG_BLK_DEBUG_FS
+	/* Time that the request was first handed to the dispatch path. */
+	u64 dispatch_time_ns;
+#endif
 
 #ifdef CONFIG_BLK_WBT
 	unsigned short wbt_flags;
@@ -281,6 +286,26 @@ enum blk_eh_timer_return {
 #define BLK_TAG_ALLOC_FIFO 0 /* allocate starting from 0 */
 #define BLK_TAG_ALLOC_RR 1 /* allocate starting from last allocated tag */
 
+/* Number of power-of-two request size classes tracked for hybrid polling */
+#define BLK_MQ_POLL_CLASSES	8
+
+/**
+ * struct blk_mq_poll_stats - Completion time estimates for hybrid polling
+ */
+struct blk_mq_poll_stats {
+	/**
+	 * @mean_ns: Moving average of the service time of polled requests,
+	 * per data direction and per size class, the first class covering
+	 * requests of up to 512 bytes.
+	 */
+	u32		mean_ns[2][BLK_MQ_POLL_CLASSES];
+	/**
+	 * @sleep_pct: Share of @mean_ns to sleep for before polling, adjusted
+	 * by whether the first poll after a sleep finds a completion.
+	 */
+	unsigned int	sleep_pct;
+};
+
 /**
  * struct blk_mq_hw_ctx - State for a hardware queue facing the hardware
  * block device
@@ -360,6 +385,12 @@ struct blk_mq_hw_ctx {
 	 */
 	unsigned int		dispatch_busy;
 
+	/**
+	 * @poll_stats: Completion times of polled requests, used to size the
+	 * sleep of adaptive hybrid polling.
+	 */
+	struct blk_mq_poll_stats poll_stats;
+
 	/** @type: HCTX_TYPE_* flags. Type of hardware queue. */
 	unsigned short		type;
 	/** @nr_ctx: Number of software queues. */
@@ -422,6 +453,11 @@ struct blk_mq_hw_ctx {
 	struct dentry		*debugfs_dir;
 	/** @sched_debugfs_dir:	debugfs directory for the scheduler. */
 	struct dentry		*sched_debugfs_dir;
+	/**
+	 * @lat_stats: Per-CPU latency breakdown of the requests of this
+	 * hardware queue, only allocated while enabled in debugfs.
+	 */
+	struct blk_mq_lat_stats __percpu *lat_stats;
 #endif
 
 	/**
@@ -345,6 +345,8 @@ enum {
 	BIO_QOS_MERGED,		/* but went through rq_qos merge path */
 	BIO_REMAPPED,
 	BIO_ZONE_WRITE_LOCKED,	/* Owns a zoned device zone write lock */
+	BIO_ZONE_WRITE_PLUGGING, /* Owns a zone write plug */
+	BIO_POLL_SLEPT,		/* hybrid polling already slept for this bio */
 	BIO_FLAG_LAST
 };
 
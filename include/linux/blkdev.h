@@ -179,7 +179,9 @@ struct gendisk {
 	 * bits which indicates if a zone is conventional (bit set) or
 	 * sequential (bit clear). seq_zones_wlock is a bitmap of nr_zones
 	 * bits which indicates if a zone is write locked, that is, if a write
-	 * request targeting the zone was dispatched.
+	 * request targeting the zone was dispatched. It is only used by BIO
+	 * based drivers, blk-mq disks order writes with zone write plugs
+	 * instead, which live in the zone_wplugs_* hash table.
 	 *
 	 * Reads of this information must be protected with blk_queue_enter() /
 	 * blk_queue_exit(). Modifying this information is only allowed while
@@ -191,6 +193,10 @@ struct gendisk {
 	unsigned int		max_active_zones;
 	unsigned long		*conv_zones_bitmap;
 	unsigned long		*seq_zones_wlock;
+	spinlock_t		zone_wplugs_lock;
+	struct hlist_head	*zone_wplugs_hash;
+	mempool_t		*zone_wplugs_pool;
+	struct workqueue_struct	*zone_wplugs_wq;
 #endif /* CONFIG_BLK_DEV_ZONED */
 
 #if IS_ENABLED(CONFIG_CDROM)
@@ -452,6 +458,8 @@ struct request_queue {
 
 	unsigned int		rq_timeout;
 
+	int			poll_nsec;
+
 	struct timer_list	timeout;
 	struct work_struct	timeout_work;
 
@@ -521,6 +529,8 @@ struct request_queue {
 	 * Serializes all debugfs metadata operations using the above dentries.
 	 */
 	struct mutex		debugfs_mutex;
+	/* hctx latency breakdown enabled in debugfs */
+	bool			lat_stats;
 
 	bool			mq_sysfs_init_done;
 };
@@ -16,8 +16,10 @@
 
 #include <linux/atomic.h>
 #include <linux/bits.h>
+#include <linux/irq_work.h>
 #include <linux/rculist.h>
 #include <linux/types.h>
+#include <linux/wait.h>
 
 struct vc_data;
 struct console_font_op;
@@ -25,6 +27,8 @@ struct console_font;
 struct module;
 struct tty_struct;
 struct notifier_block;
+struct printk_buffers;
+struct task_struct;
 
 enum con_scroll {
 	SM_UP,
@@ -156,6 +160,11 @@ static inline int con_debug_leave(void)
  *			/dev/kmesg which requires a larger output buffer.
  * @CON_SUSPENDED:	Indicates if a console is suspended. If true, the
  *			printing callbacks must not be called.
+ * @CON_NBCON:		Console can operate outside of the legacy style
+ *			console_lock constraints. It is printed by a
+ *			dedicated thread through the write_thread()
+ *			callback and uses write_atomic() only when the
+ *			thread cannot be used, e.g. in panic.
  */
 enum cons_flags {
 	CON_PRINTBUFFER		= BIT(0),
@@ -166,6 +175,7 @@ enum cons_flags {
 	CON_BRL			= BIT(5),
 	CON_EXTENDED		= BIT(6),
 	CON_SUSPENDED		= BIT(7),
+	CON_NBCON		= BIT(8),
 };
 
 /**
@@ -187,6 +197,17 @@ enum cons_flags {
  * @dropped:		Number of unreported dropped ringbuffer records
  * @data:		Driver private data
  * @node:		hlist node for the console list
+ *
+ * @write_atomic:	Write callback for nbcon consoles, called from any
+ *			context with interrupts disabled (Required for
+ *			CON_NBCON)
+ * @write_thread:	Write callback for nbcon consoles, called from the
+ *			printer thread and may sleep (Optional)
+ * @nbcon_owner:	Current owner of an nbcon console
+ * @kthread:		Printer thread of an nbcon console
+ * @kthread_wait:	Wait queue of the printer thread
+ * @irq_work:		Defers waking the printer thread
+ * @pbufs:		Buffers used by the printer thread
  */
 struct console {
 	char			name[16];
@@ -206,6 +227,17 @@ struct console {
 	unsigned long		dropped;
 	void			*data;
 	struct hlist_node	node;
+
+	/* nbcon console specific members */
+	void			(*write_atomic)(struct console *con, const char *s,
+						unsigned int count);
+	void			(*write_thread)(struct console *con, const char *s,
+						unsigned int count);
+	atomic_t		nbcon_owner;
+	struct task_struct	*kthread;
+	wait_queue_head_t	kthread_wait;
+	struct irq_work		irq_work;
+	struct printk_buffers	*pbufs;
 };
 
 #ifdef CONFIG_LOCKDEP
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Offload of bulk kernel copies to public DMA_MEMCPY channels.
+ */
+#ifndef _LINUX_COPY_ENGINE_H
+#define _LINUX_COPY_ENGINE_H
+
+#include <linux/jump_label.h>
+#include <linux/mm.h>
+
+#ifdef CONFIG_COPY_ENGINE
+DECLARE_STATIC_KEY_FALSE(copy_engine_enabled);
+
+bool __copy_engine_copy_pages(struct page *dst, struct page *src, size_t len);
+
+/**
+ * copy_engine_copy_pages - copy physically contiguous pages with a DMA engine
+ * @dst: first destination page
+ * @src: first source page
+ * @len: number of bytes to copy, a multiple of PAGE_SIZE
+ *
+ * May sleep. Copies below the configured threshold, or issued while no
+ * channel is available, are left to the caller.
+ *
+ * Return: true if the pages were copied, false if the caller must copy.
+ */
+static inline bool copy_engine_copy_pages(struct page *dst, struct page *src,
+					  size_t len)
+{
+	if (!static_branch_unlikely(&copy_engine_enabled))
+		return false;
+	return __copy_engine_copy_pages(dst, src, len);
+}
+#else
+static inline bool copy_engine_copy_pages(struct page *dst, struct page *src,
+					  size_t len)
+{
+	return false;
+}
+#endif /* CONFIG_COPY_ENGINE */
+
+static inline bool copy_engine_copy_folio(struct folio *dst, struct folio *src)
+{
+	return copy_engine_copy_pages(&dst->page, &src->page, folio_size(src));
+}
+
+#endif /* _LINUX_COPY_ENGINE_H */
@@ -12,5 +12,7 @@ extern __u16 crc_t10dif_generic(__u16 crc, const unsigned char *buffer,
 				size_t len);
 extern __u16 crc_t10dif(unsigned char const *, size_t);
 extern __u16 crc_t10dif_update(__u16 crc, unsigned char const *, size_t);
+extern void crc_t10dif_batch(const unsigned char *buffer, size_t interval,
+			     unsigned int nr, __u16 *crcs);
 
 #endif
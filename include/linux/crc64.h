@@ -14,5 +14,7 @@ u64 __pure crc64_rocksoft_generic(u64 crc, const void *p, size_t len);
 
 u64 crc64_rocksoft(const unsigned char *buffer, size_t len);
 u64 crc64_rocksoft_update(u64 crc, const unsigned char *buffer, size_t len);
+void crc64_rocksoft_batch(const unsigned char *buffer, size_t interval,
+			  unsigned int nr, u64 *crcs);
 
 #endif /* _LINUX_CRC64_H */
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Xilinx AXI DMA / MCDMA slave channel configuration
+ *
+ * Copyright (C) 2026, Advanced Micro Devices, Inc.
+ */
+
+#ifndef __DMA_XILINX_DMA_SLAVE_H
+#define __DMA_XILINX_DMA_SLAVE_H
+
+#include <linux/bits.h>
+#include <linux/types.h>
+
+/* Reap completions from a budgeted poll loop instead of per-IRQ */
+#define XILINX_DMA_SLAVE_POLLED		BIT(0)
+/* Adapt the interrupt coalescing thresholds to the completion rate */
+#define XILINX_DMA_SLAVE_DIM		BIT(1)
+/* Append new BDs to a running SG chain by advancing TAILDESC (AXI DMA) */
+#define XILINX_DMA_SLAVE_STREAMING	BIT(2)
+/* Program the AXI cache and user signals from @axcache and @axuser */
+#define XILINX_DMA_SLAVE_AXCACHE	BIT(3)
+
+/*
+ * Channel priority classes, also accepted as the optional second cell of the
+ * DMA specifier
+ */
+#define XILINX_DMA_PRIO_DEFAULT		0
+#define XILINX_DMA_PRIO_BULK		1
+#define XILINX_DMA_PRIO_LOW_LATENCY	2
+
+/**
+ * struct xilinx_dma_slave_config - AXI DMA / MCDMA per-channel settings
+ * @num_descs: Number of buffer descriptors in the coherent BD ring, 0 keeps
+ *	       the current depth
+ * @max_descs: Upper bound on the number of buffer descriptors the channel
+ *	       may grow to on demand, 0 for no limit
+ * @flags: XILINX_DMA_SLAVE_* channel mode flags
+ * @flags_mask: XILINX_DMA_SLAVE_POLLED, _DIM and _STREAMING modes set or
+ *		cleared from @flags, the modes not in the mask keep their
+ *		current setting, initially the device tree one.
+ *		XILINX_DMA_SLAVE_AXCACHE is applied whenever set in @flags
+ * @weight: MCDMA MM2S weighted round-robin weight, 1 to 15, 0 keeps the
+ *	    current weight, or the default of @priority when that is set
+ * @priority: XILINX_DMA_PRIO_* class of the channel, XILINX_DMA_PRIO_DEFAULT
+ *	      keeps the current class, initially the one from the DMA
+ *	      specifier. Low latency channels interrupt on every descriptor
+ *	      and get the largest MCDMA weight, bulk channels the smallest one
+ * @axcache: AxCACHE value, 0 to 15, used with XILINX_DMA_SLAVE_AXCACHE
+ * @axuser: AxUSER value, 0 to 15, used with XILINX_DMA_SLAVE_AXCACHE
+ *
+ * Passed through &dma_slave_config.peripheral_config. The BD ring can only
+ * be resized while the channel has no descriptors outstanding.
+ */
+struct xilinx_dma_slave_config {
+	u32 num_descs;
+	u32 max_descs;
+	u32 flags;
+	u32 flags_mask;
+	u32 weight;
+	u32 priority;
+	u32 axcache;
+	u32 axuser;
+};
+
+#endif /* __DMA_XILINX_DMA_SLAVE_H */
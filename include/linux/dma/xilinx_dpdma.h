@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __LINUX_DMA_XILINX_DPDMA_H
+#define __LINUX_DMA_XILINX_DPDMA_H
+
+#include <linux/types.h>
+
+struct dma_chan;
+
+struct xilinx_dpdma_peripheral_config {
+	bool video_group;
+};
+
+#if IS_ENABLED(CONFIG_XILINX_ZYNQMP_DPDMA)
+void xilinx_dpdma_batch_begin(struct dma_chan *dchan);
+void xilinx_dpdma_batch_commit(struct dma_chan *dchan);
+#else
+static inline void xilinx_dpdma_batch_begin(struct dma_chan *dchan)
+{
+}
+
+static inline void xilinx_dpdma_batch_commit(struct dma_chan *dchan)
+{
+}
+#endif
+
+#endif /* __LINUX_DMA_XILINX_DPDMA_H */
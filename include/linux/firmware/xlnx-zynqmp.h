@@ -15,7 +15,9 @@
 #define __FIRMWARE_ZYNQMP_H__
 #include <linux/types.h>
 
+#include <linux/completion.h>
 #include <linux/err.h>
+#include <linux/workqueue.h>
 
 #define ZYNQMP_PM_VERSION_MAJOR	1
 #define ZYNQMP_PM_VERSION_MINOR	0
@@ -640,6 +642,46 @@ struct zynqmp_pm_query_data {
 
 int zynqmp_pm_invoke_fn(u32 pm_api_id, u32 *ret_payload, u32 num_args, ...);
 int zynqmp_pm_invoke_fw_fn(u32 pm_api_id, u32 *ret_payload, u32 num_args, ...);
+
+#define ZYNQMP_PM_BATCH_MAX_ARGS	6U
+
+/**
+ * struct zynqmp_pm_request - EEMI request queued in a batch
+ * @api_id:	Requested PM-API call
+ * @num_args:	Number of valid entries of @args
+ * @args:	Arguments of the request
+ * @ret_payload: Return payload of the request once the batch is done
+ * @ret:	Status of the request once the batch is done
+ */
+struct zynqmp_pm_request {
+	u32 api_id;
+	u32 num_args;
+	u32 args[ZYNQMP_PM_BATCH_MAX_ARGS];
+	u32 ret_payload[PAYLOAD_ARG_CNT];
+	int ret;
+};
+
+/**
+ * struct zynqmp_pm_batch - Batch of EEMI requests
+ * @reqs:	Requests of the batch, provided by the caller
+ * @nr_reqs:	Number of queued requests
+ * @max_reqs:	Number of entries of @reqs
+ * @ret:	Status of the batch once done
+ * @complete:	Completion callback of an asynchronous submission
+ * @data:	Argument of @complete
+ * @work:	Issues the requests of an asynchronous submission
+ * @done:	Completed once an asynchronous submission is done
+ */
+struct zynqmp_pm_batch {
+	struct zynqmp_pm_request *reqs;
+	unsigned int nr_reqs;
+	unsigned int max_reqs;
+	int ret;
+	void (*complete)(struct zynqmp_pm_batch *batch, void *data);
+	void *data;
+	struct work_struct work;
+	struct completion done;
+};
 /**
  * struct xlnx_feature - Feature data
  * @family:	Family code of platform
@@ -779,6 +821,24 @@ int versal2_pm_ufs_get_txrx_cfgrdy(u32 node_id, u32 *value);
 int versal2_pm_ufs_sram_csr_sel(u32 node_id, u32 type, u32 *value);
 int versal_pm_puf_clear_id(void);
 int versal_pm_aes_init(void);
+void zynqmp_pm_batch_init(struct zynqmp_pm_batch *batch,
+			  struct zynqmp_pm_request *reqs,
+			  unsigned int max_reqs);
+int zynqmp_pm_batch_add(struct zynqmp_pm_batch *batch, u32 api_id,
+			u32 num_args, ...);
+int zynqmp_pm_batch_submit(struct zynqmp_pm_batch *batch);
+int zynqmp_pm_batch_submit_async(struct zynqmp_pm_batch *batch,
+				 void (*complete)(struct zynqmp_pm_batch *batch,
+						  void *data),
+				 void *data);
+int zynqmp_pm_batch_wait(struct zynqmp_pm_batch *batch);
+int zynqmp_pm_clock_getdivider_cached(u32 clock_id, u32 *divider);
+int zynqmp_pm_clock_getparent_cached(u32 clock_id, u32 *parent_id);
+int zynqmp_pm_clock_setdivider_cached(u32 clock_id, u32 divider);
+int zynqmp_pm_clock_setparent_cached(u32 clock_id, u32 parent_id);
+void zynqmp_pm_clock_cache_invalidate(u32 clock_id);
+void zynqmp_pm_clock_cache_invalidate_all(void);
+int zynqmp_pm_clock_cache_prefetch(const u32 *clock_ids, unsigned int nr);
 #else
 static inline int zynqmp_pm_get_api_version(u32 *version)
 {
@@ -1351,6 +1411,75 @@ static inline int versal_pm_aes_init(void)
 {
 	return -ENODEV;
 }
+
+static inline void zynqmp_pm_batch_init(struct zynqmp_pm_batch *batch,
+					struct zynqmp_pm_request *reqs,
+					unsigned int max_reqs)
+{
+}
+
+static inline int zynqmp_pm_batch_add(struct zynqmp_pm_batch *batch,
+				      u32 api_id, u32 num_args, ...)
+{
+	return -ENODEV;
+}
+
+static inline int zynqmp_pm_batch_submit(struct zynqmp_pm_batch *batch)
+{
+	return -ENODEV;
+}
+
+static inline int
+zynqmp_pm_batch_submit_async(struct zynqmp_pm_batch *batch,
+			     void (*complete)(struct zynqmp_pm_batch *batch,
+					      void *data),
+			     void *data)
+{
+	return -ENODEV;
+}
+
+static inline int zynqmp_pm_batch_wait(struct zynqmp_pm_batch *batch)
+{
+	return -ENODEV;
+}
+
+static inline int zynqmp_pm_clock_getdivider_cached(u32 clock_id,
+						    u32 *divider)
+{
+	return -ENODEV;
+}
+
+static inline int zynqmp_pm_clock_getparent_cached(u32 clock_id,
+						   u32 *parent_id)
+{
+	return -ENODEV;
+}
+
+static inline int zynqmp_pm_clock_setdivider_cached(u32 clock_id,
+						    u32 divider)
+{
+	return -ENODEV;
+}
+
+static inline int zynqmp_pm_clock_setparent_cached(u32 clock_id,
+						   u32 parent_id)
+{
+	return -ENODEV;
+}
+
+static inline void zynqmp_pm_clock_cache_invalidate(u32 clock_id)
+{
+}
+
+static inline void zynqmp_pm_clock_cache_invalidate_all(void)
+{
+}
+
+static inline int zynqmp_pm_clock_cache_prefetch(const u32 *clock_ids,
+						 unsigned int nr)
+{
+	return -ENODEV;
+}
 #endif
 
 #endif /* __FIRMWARE_ZYNQMP_H__ */
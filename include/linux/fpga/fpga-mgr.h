@@ -168,6 +168,9 @@ struct fpga_manager_info {
  * @skip_header: bool flag to tell fpga-mgr core whether it should skip
  *	info->header_size part at the beginning of the image when invoking
  *	write callback.
+ * @premapped_sg: write_sg uses the DMA mapping of the table as is when
+ *	&fpga_manager->sgt_mapped is set, so that cached images are mapped
+ *	for the parent device once.
  * @state: returns an enum value of the FPGA's state
  * @status: returns status of the FPGA, including reconfiguration error code
  * @parse_header: parse FPGA image header to set info->header_size and
@@ -178,6 +181,11 @@ struct fpga_manager_info {
  * @write_sg: write the scatter list of configuration data to the FPGA
  * @write_complete: set FPGA to operating state after writing is done
  * @read: optional: read FPGA configuration information
+ * @read_data: optional: read back up to *@count bytes of configuration data
+ *	starting @offset bytes into it. Returns the address of the data in a
+ *	buffer owned by the driver, valid until the next call, and updates
+ *	*@count with the number of bytes available there, 0 at the end of the
+ *	data. Called with the manager locked.
  * @fpga_remove: optional: Set FPGA into a specific state during driver remove
  * @groups: optional attribute groups.
  *
@@ -188,6 +196,7 @@ struct fpga_manager_info {
 struct fpga_manager_ops {
 	size_t initial_header_size;
 	bool skip_header;
+	bool premapped_sg;
 	enum fpga_mgr_states (*state)(struct fpga_manager *mgr);
 	u64 (*status)(struct fpga_manager *mgr);
 	int (*parse_header)(struct fpga_manager *mgr,
@@ -201,6 +210,8 @@ struct fpga_manager_ops {
 	int (*write_complete)(struct fpga_manager *mgr,
 			      struct fpga_image_info *info);
 	int (*read)(struct fpga_manager *mgr, struct seq_file *s);
+	const void *(*read_data)(struct fpga_manager *mgr, loff_t offset,
+				 size_t *count);
 	void (*fpga_remove)(struct fpga_manager *mgr);
 	const struct attribute_group **groups;
 };
@@ -226,6 +237,9 @@ struct fpga_manager_ops {
  * @mops: pointer to struct of fpga manager ops
  * @priv: low level driver private date
  * @err: low level driver error code
+ * @sgt_mapped: the table passed to write_sg is already DMA mapped
+ * @cache_mutex: protects @cache and serializes loads from it
+ * @cache: cached images, see fpga_mgr_cache_add()
  * @dir: debugfs image directory
  */
 struct fpga_manager {
@@ -241,6 +255,9 @@ struct fpga_manager {
 	const struct fpga_manager_ops *mops;
 	void *priv;
 	int err;
+	bool sgt_mapped;
+	struct mutex cache_mutex;
+	struct list_head cache;
 #ifdef CONFIG_FPGA_MGR_DEBUG_FS
 	struct dentry *dir;
 #endif
@@ -254,7 +271,11 @@ void fpga_image_info_free(struct fpga_image_info *info);
 
 int fpga_mgr_load(struct fpga_manager *mgr, struct fpga_image_info *info);
 
+int fpga_mgr_cache_add(struct fpga_manager *mgr, const char *image_name);
+int fpga_mgr_cache_remove(struct fpga_manager *mgr, const char *image_name);
+
 int fpga_mgr_lock(struct fpga_manager *mgr);
+void fpga_mgr_lock_wait(struct fpga_manager *mgr);
 void fpga_mgr_unlock(struct fpga_manager *mgr);
 
 struct fpga_manager *of_fpga_mgr_get(struct device_node *node);
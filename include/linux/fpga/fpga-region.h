@@ -4,6 +4,8 @@
 #define _FPGA_REGION_H
 
 #include <linux/device.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/fpga/fpga-mgr.h>
 #include <linux/fpga/fpga-bridge.h>
 
@@ -38,6 +40,14 @@ struct fpga_region_info {
  * @compat_id: FPGA region id for compatibility check.
  * @priv: private data
  * @get_bridges: optional function to get bridges to a list
+ * @program_work: runs fpga_region_program_fpga_async() requests
+ * @program_lock: protects the program_* fields below
+ * @program_pending: an asynchronous request is queued or running
+ * @program_done: an asynchronous request has completed
+ * @program_err: result of the last asynchronous request
+ * @program_complete: completion callback of the pending request
+ * @program_data: argument of @program_complete
+ * @program_info: image info programmed through the firmware attribute
  */
 struct fpga_region {
 	struct device dev;
@@ -48,6 +58,15 @@ struct fpga_region {
 	struct fpga_compat_id *compat_id;
 	void *priv;
 	int (*get_bridges)(struct fpga_region *region);
+	struct work_struct program_work;
+	spinlock_t program_lock; /* for the asynchronous request state */
+	bool program_pending;
+	bool program_done;
+	int program_err;
+	void (*program_complete)(struct fpga_region *region, int ret,
+				 void *data);
+	void *program_data;
+	struct fpga_image_info *program_info;
 };
 
 #define to_fpga_region(d) container_of(d, struct fpga_region, dev)
@@ -57,6 +76,10 @@ fpga_region_class_find(struct device *start, const void *data,
 		       int (*match)(struct device *, const void *));
 
 int fpga_region_program_fpga(struct fpga_region *region);
+int fpga_region_program_fpga_async(struct fpga_region *region,
+				   void (*complete)(struct fpga_region *region,
+						    int ret, void *data),
+				   void *data);
 
 struct fpga_region *
 fpga_region_register_full(struct device *parent, const struct fpga_region_info *info);
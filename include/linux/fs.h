@@ -2025,6 +2025,8 @@ struct super_operations {
 	long (*free_cached_objects)(struct super_block *,
 				    struct shrink_control *);
 	void (*shutdown)(struct super_block *sb);
+	void (*prefetch_inodes)(struct super_block *sb, const u64 *inos,
+				unsigned int nr);
 };
 
 /*
@@ -4,6 +4,7 @@
 
 #include <linux/sched/coredump.h>
 #include <linux/mm_types.h>
+#include <linux/kobject.h>
 
 #include <linux/fs.h> /* only for vma_is_dax() */
 
@@ -63,6 +64,15 @@ ssize_t single_hugepage_flag_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf,
 				  enum transparent_hugepage_flag flag);
 extern struct kobj_attribute shmem_enabled_attr;
+extern struct kobj_attribute thpsize_shmem_enabled_attr;
+
+struct thpsize {
+	struct kobject kobj;
+	struct list_head node;
+	int order;
+};
+
+#define to_thpsize(kobj) container_of(kobj, struct thpsize, kobj)
 
 #define HPAGE_PMD_ORDER (HPAGE_PMD_SHIFT-PAGE_SHIFT)
 #define HPAGE_PMD_NR (1<<HPAGE_PMD_ORDER)
@@ -133,6 +143,19 @@ static inline bool file_thp_enabled(struct vm_area_struct *vma)
 bool hugepage_vma_check(struct vm_area_struct *vma, unsigned long vm_flags,
 			bool smaps, bool in_pf, bool enforce_sysfs);
 
+/*
+ * Orders of PTE-mapped anonymous folios that may be allocated at fault time.
+ * Order 1 is excluded because the deferred split list lives in the second
+ * tail page; PMD order is governed by the top-level "enabled" control.
+ */
+#define THP_ORDERS_ANON_SMALL	(BIT(HPAGE_PMD_ORDER) - BIT(2))
+
+extern unsigned long huge_anon_orders_always;
+extern unsigned long huge_anon_orders_madvise;
+extern unsigned long huge_anon_orders_inherit;
+
+unsigned long thp_vma_anon_orders(struct vm_area_struct *vma);
+
 #define transparent_hugepage_use_zero_page()				\
 	(transparent_hugepage_flags &					\
 	 (1<<TRANSPARENT_HUGEPAGE_USE_ZERO_PAGE_FLAG))
@@ -280,6 +303,11 @@ static inline bool hugepage_vma_check(struct vm_area_struct *vma,
 	return false;
 }
 
+static inline unsigned long thp_vma_anon_orders(struct vm_area_struct *vma)
+{
+	return 0;
+}
+
 static inline void folio_prep_large_rmappable(struct folio *folio) {}
 
 #define transparent_hugepage_flags 0UL
@@ -5,6 +5,7 @@
 #include <linux/task_work.h>
 #include <linux/bitmap.h>
 #include <linux/llist.h>
+#include <linux/hashtable.h>
 #include <uapi/linux/io_uring.h>
 
 struct io_wq_work_node {
@@ -257,6 +258,16 @@ struct io_ring_ctx {
 		struct io_alloc_cache	apoll_cache;
 		struct io_alloc_cache	netmsg_cache;
 
+		/*
+		 * Pending FUTEX_WAIT/FUTEX_WAITV requests, protected by
+		 * ->uring_lock
+		 */
+		struct hlist_head	futex_list;
+		struct io_alloc_cache	futex_cache;
+
+		/* pending IORING_OP_WAITID requests, protected by ->uring_lock */
+		struct hlist_head	waitid_list;
+
 		/*
 		 * ->iopoll_list is protected by the ctx->uring_lock for
 		 * io_uring instances that don't use IORING_SETUP_SQPOLL.
@@ -368,8 +379,14 @@ struct io_ring_ctx {
 	struct callback_head		poll_wq_task_work;
 	struct list_head		defer_list;
 	unsigned			sq_thread_idle;
+	/* sqpoll time spent on this ring in nsecs, owned by the sqpoll thread */
+	u64				sq_work_time;
+	/* deficit round robin credit on a shared sqpoll thread, in nsecs */
+	s64				sq_deficit;
 	/* protected by ->completion_lock */
 	unsigned			evfd_last_cq_tail;
+	/* IORING_REGISTER_STATS, set and cleared under both locks */
+	struct io_ring_stats		*stats;
 
 	/*
 	 * If IORING_SETUP_NO_MMAP is used, then the below holds
@@ -379,6 +396,16 @@ struct io_ring_ctx {
 	unsigned short			n_sqe_pages;
 	struct page			**ring_pages;
 	struct page			**sqe_pages;
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* napi ids of the polled sockets, protected by ->napi_lock */
+	struct list_head		napi_list;
+	DECLARE_HASHTABLE(napi_ht, 4);
+	spinlock_t			napi_lock;
+	/* busy poll timeout of CQE waits in usecs, 0 if disabled */
+	unsigned int			napi_busy_poll_to;
+	bool				napi_prefer_busy_poll;
+#endif
 };
 
 struct io_tw_state {
@@ -420,6 +447,7 @@ enum {
 	/* keep async read/write and isreg together and in order */
 	REQ_F_SUPPORT_NOWAIT_BIT,
 	REQ_F_ISREG_BIT,
+	REQ_F_IOWQ_BIT,
 
 	/* not a real bit, just to check we're not overflowing the space */
 	__REQ_F_LAST_BIT,
@@ -487,6 +515,8 @@ enum {
 	REQ_F_CLEAR_POLLIN	= BIT(REQ_F_CLEAR_POLLIN_BIT),
 	/* hashed into ->cancel_hash_locked, protected by ->uring_lock */
 	REQ_F_HASH_LOCKED	= BIT(REQ_F_HASH_LOCKED_BIT),
+	/* issued from an io-wq worker */
+	REQ_F_IOWQ		= BIT(REQ_F_IOWQ_BIT),
 };
 
 typedef void (*io_req_tw_func_t)(struct io_kiocb *req, struct io_tw_state *ts);
@@ -591,6 +621,8 @@ struct io_kiocb {
 	/* custom credentials, valid IFF REQ_F_CREDS is set */
 	const struct cred		*creds;
 	struct io_wq_work		work;
+	/* submission time in nsecs if IORING_REGISTER_STATS is on, or 0 */
+	u64				start_time;
 
 	struct {
 		u64			extra1;
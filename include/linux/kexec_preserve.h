@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef LINUX_KEXEC_PRESERVE_H
+#define LINUX_KEXEC_PRESERVE_H
+
+#include <linux/errno.h>
+#include <linux/init.h>
+#include <linux/types.h>
+
+/*
+ * Memory regions handed over from a kernel to the one it kexecs. The old
+ * kernel passes a table of named regions to the new one, which reserves
+ * them before it allocates any memory. The table layout is shared between
+ * kernel versions and must only be extended by bumping the version.
+ */
+#define KEXEC_PRESERVE_MAGIC		0x5652504b	/* "KPRV" */
+#define KEXEC_PRESERVE_VERSION		1
+#define KEXEC_PRESERVE_NAME_LEN		32
+
+/* Property of /chosen holding the address and size of the table */
+#define KEXEC_PRESERVE_FDT_PROP		"linux,kexec-preserved"
+
+struct kexec_preserve_entry {
+	char name[KEXEC_PRESERVE_NAME_LEN];
+	u64 base;
+	u64 size;
+};
+
+struct kexec_preserve_table {
+	u32 magic;
+	u32 version;
+	u32 nr_entries;
+	u32 reserved;
+	struct kexec_preserve_entry entries[];
+};
+
+#ifdef CONFIG_KEXEC_PRESERVE
+/* Old kernel */
+int kexec_preserve_region(const char *name, phys_addr_t base,
+			  phys_addr_t size);
+int kexec_preserve_blob(const char *name, const void *data, size_t len);
+void kexec_unpreserve(const char *name);
+bool kexec_preserved_overlaps(phys_addr_t start, phys_addr_t end);
+void *kexec_preserve_build_table(unsigned long *size);
+
+/* New kernel */
+void __init kexec_preserved_scan_fdt(void);
+int kexec_preserved_lookup(const char *name, phys_addr_t *base,
+			   phys_addr_t *size);
+void kexec_preserved_release(const char *name);
+#else
+static inline int kexec_preserve_region(const char *name, phys_addr_t base,
+					phys_addr_t size)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int kexec_preserve_blob(const char *name, const void *data,
+				      size_t len)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void kexec_unpreserve(const char *name)
+{
+}
+
+static inline bool kexec_preserved_overlaps(phys_addr_t start,
+					    phys_addr_t end)
+{
+	return false;
+}
+
+static inline void *kexec_preserve_build_table(unsigned long *size)
+{
+	return NULL;
+}
+
+static inline void kexec_preserved_scan_fdt(void)
+{
+}
+
+static inline int kexec_preserved_lookup(const char *name, phys_addr_t *base,
+					 phys_addr_t *size)
+{
+	return -ENOENT;
+}
+
+static inline void kexec_preserved_release(const char *name)
+{
+}
+#endif
+
+#endif /* LINUX_KEXEC_PRESERVE_H */
@@ -102,6 +102,35 @@ bool list_lru_add(struct list_lru *lru, struct list_head *item);
  */
 bool list_lru_del(struct list_lru *lru, struct list_head *item);
 
+/**
+ * list_lru_add_memcg: add an element to a given node and cgroup of the lru
+ * @list_lru: the lru pointer
+ * @item: the item to be added.
+ * @nid: the node id of the sublist to add the item to.
+ * @memcg: the cgroup of the sublist to add the item to.
+ *
+ * Like list_lru_add(), for objects that are not slab allocated on behalf of
+ * the cgroup they should be accounted to. The caller must have set up the
+ * cgroup's sublist with memcg_list_lru_alloc() and must pass the same @nid
+ * and @memcg to list_lru_del_memcg().
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+bool list_lru_add_memcg(struct list_lru *lru, struct list_head *item, int nid,
+			struct mem_cgroup *memcg);
+
+/**
+ * list_lru_del_memcg: delete an element from a given node and cgroup of the lru
+ * @list_lru: the lru pointer
+ * @item: the item to be deleted.
+ * @nid: the node id the item was added to.
+ * @memcg: the cgroup the item was added to.
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+bool list_lru_del_memcg(struct list_lru *lru, struct list_head *item, int nid,
+			struct mem_cgroup *memcg);
+
 /**
  * list_lru_count_one: return the number of objects currently held by @lru
  * @lru: the lru pointer.
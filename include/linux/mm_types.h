@@ -670,6 +670,7 @@ struct mm_cid {
 #endif
 
 struct kioctx_table;
+struct futex_private_hash;
 struct mm_struct {
 	struct {
 		/*
@@ -884,6 +885,10 @@ struct mm_struct {
 #ifdef CONFIG_IOMMU_SVA
 		u32 pasid;
 #endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+		/* Hash for the private futexes of this mm, see PR_FUTEX_HASH */
+		struct futex_private_hash *futex_phash;
+#endif
 #ifdef CONFIG_KSM
 		/*
 		 * Represent how many pages of this process are involved in KSM
@@ -206,7 +206,12 @@ enum node_stat_item {
 #ifdef CONFIG_NUMA_BALANCING
 	PGPROMOTE_SUCCESS,	/* promote successfully */
 	PGPROMOTE_CANDIDATE,	/* candidate pages to promote */
+	PGPROMOTE_SRC_CANDIDATE, /* candidate pages to promote off this node */
 #endif
+	/* PGDEMOTE_*: pages demoted off this node */
+	PGDEMOTE_KSWAPD,
+	PGDEMOTE_DIRECT,
+	PGDEMOTE_KHUGEPAGED,
 	NR_VM_NODE_STAT_ITEMS
 };
 
@@ -680,6 +685,8 @@ struct per_cpu_pages {
 	spinlock_t lock;	/* Protects lists field */
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
+	int high_min;		/* min high watermark */
+	int high_max;		/* max high watermark */
 	int batch;		/* chunk size for buddy add/remove */
 	short free_factor;	/* batch scaling factor during free */
 #ifdef CONFIG_NUMA
@@ -837,7 +844,8 @@ struct zone {
 	 * the high and batch values are copied to individual pagesets for
 	 * faster access
 	 */
-	int pageset_high;
+	int pageset_high_min;
+	int pageset_high_max;
 	int pageset_batch;
 
 #ifndef CONFIG_SPARSEMEM
@@ -1368,6 +1376,13 @@ typedef struct pglist_data {
 	 * threshold adjustment period
 	 */
 	unsigned long nbp_th_nr_cand;
+	/* start time in ms of current promote-off rate limit period */
+	unsigned int nbp_src_rl_start;
+	/*
+	 * number of promote candidate pages off this node at start time of
+	 * current promote-off rate limit period
+	 */
+	unsigned long nbp_src_rl_nr_cand;
 #endif
 	/* Fields commonly accessed by the page reclaim scanner */
 
@@ -127,6 +127,10 @@ extern void __mutex_init(struct mutex *lock, const char *name,
  */
 extern bool mutex_is_locked(struct mutex *lock);
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+extern struct task_struct *mutex_owner_task(struct mutex *lock);
+#endif
+
 #else /* !CONFIG_PREEMPT_RT */
 /*
  * Preempt-RT variant based on rtmutexes.
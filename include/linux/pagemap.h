@@ -326,6 +326,18 @@ static inline void mapping_set_large_folios(struct address_space *mapping)
 	__set_bit(AS_LARGE_FOLIO_SUPPORT, &mapping->flags);
 }
 
+/**
+ * mapping_clear_large_folios() - Stop using large folios in this mapping.
+ * @mapping: The file.
+ *
+ * The caller must have removed all the large folios from the page cache
+ * and must prevent new ones from being added until this returns.
+ */
+static inline void mapping_clear_large_folios(struct address_space *mapping)
+{
+	clear_bit(AS_LARGE_FOLIO_SUPPORT, &mapping->flags);
+}
+
 /*
  * Large folio support currently depends on THP.  These dependencies are
  * being worked on but are not yet fixed.
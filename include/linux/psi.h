@@ -41,6 +41,7 @@ int psi_cgroup_alloc(struct cgroup *cgrp);
 void psi_cgroup_free(struct cgroup *cgrp);
 void cgroup_move_task(struct task_struct *p, struct css_set *to);
 void psi_cgroup_restart(struct psi_group *group);
+void psi_rstat_flush(struct cgroup *cgrp, int cpu);
 #endif
 
 #else /* CONFIG_PSI */
@@ -63,6 +64,7 @@ static inline void cgroup_move_task(struct task_struct *p, struct css_set *to)
 	rcu_assign_pointer(p->cgroups, to);
 }
 static inline void psi_cgroup_restart(struct psi_group *group) {}
+static inline void psi_rstat_flush(struct cgroup *cgrp, int cpu) {}
 #endif
 
 #endif /* CONFIG_PSI */
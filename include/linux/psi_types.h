@@ -8,6 +8,8 @@
 #include <linux/kref.h>
 #include <linux/wait.h>
 
+struct cgroup;
+
 #ifdef CONFIG_PSI
 
 /* Tracked task states */
@@ -104,6 +106,20 @@ struct psi_group_cpu {
 	/* Delta detection against the sampling buckets */
 	u32 times_prev[NR_PSI_AGGREGATORS][NR_PSI_STATES]
 			____cacheline_aligned_in_smp;
+
+	/* Lazy aggregation, protected by cgroup_rstat_lock */
+
+	/* Own times already folded into lazy_times */
+	u32 lazy_flushed[NR_PSI_STATES];
+
+	/* Times of the whole subtree, clipped to wallclock time */
+	u32 lazy_times[NR_PSI_STATES];
+
+	/* Times propagated from the children, not folded yet */
+	u64 lazy_pending[NR_PSI_STATES];
+
+	/* Time of the last fold */
+	u64 lazy_last;
 };
 
 /* PSI growth tracking window */
@@ -163,6 +179,9 @@ struct psi_group {
 	struct psi_group *parent;
 	bool enabled;
 
+	/* Owning cgroup, NULL for the system group */
+	struct cgroup *cgrp;
+
 	/* Protects data used by the aggregator */
 	struct mutex avgs_lock;
 
@@ -27,6 +27,7 @@
 #include <linux/latencytop.h>
 #include <linux/sched/prio.h>
 #include <linux/sched/types.h>
+#include <linux/sched/ext.h>
 #include <linux/signal_types.h>
 #include <linux/syscall_user_dispatch.h>
 #include <linux/mm_types_task.h>
@@ -604,6 +605,12 @@ struct sched_rt_entity {
 #endif
 } __randomize_layout;
 
+struct rq;
+struct sched_dl_entity;
+
+typedef bool (*dl_server_has_tasks_f)(struct sched_dl_entity *);
+typedef struct task_struct *(*dl_server_pick_f)(struct sched_dl_entity *);
+
 struct sched_dl_entity {
 	struct rb_node			rb_node;
 
@@ -646,11 +653,23 @@ struct sched_dl_entity {
 	 *
 	 * @dl_overrun tells if the task asked to be informed about runtime
 	 * overruns.
+	 *
+	 * @dl_server tells if this is a server entity, scheduling the tasks of
+	 * another class rather than a task of its own.
+	 *
+	 * @dl_server_active tells if the server has been started, that is, its
+	 * class has runnable tasks.
+	 *
+	 * @dl_defer_armed tells if the server is holding back until the
+	 * zero-laxity instant of its current period; dl_timer is armed for it.
 	 */
 	unsigned int			dl_throttled      : 1;
 	unsigned int			dl_yielded        : 1;
 	unsigned int			dl_non_contending : 1;
 	unsigned int			dl_overrun	  : 1;
+	unsigned int			dl_server         : 1;
+	unsigned int			dl_server_active  : 1;
+	unsigned int			dl_defer_armed    : 1;
 
 	/*
 	 * Bandwidth enforcement timer. Each -deadline task has its
@@ -675,6 +694,21 @@ struct sched_dl_entity {
 	 */
 	struct sched_dl_entity *pi_se;
 #endif
+
+	/*
+	 * Server entities only, see dl_server_init():
+	 *
+	 * @rq is the runqueue the server belongs to.
+	 *
+	 * @server_has_tasks() tells if the served class has runnable tasks.
+	 *
+	 * @server_pick_next() picks the next task of the served class and sets
+	 * it up to run; @server_pick_task() only peeks at it.
+	 */
+	struct rq			*rq;
+	dl_server_has_tasks_f		server_has_tasks;
+	dl_server_pick_f		server_pick_next;
+	dl_server_pick_f		server_pick_task;
 };
 
 #ifdef CONFIG_UCLAMP_TASK
@@ -794,6 +828,9 @@ struct task_struct {
 	struct sched_entity		se;
 	struct sched_rt_entity		rt;
 	struct sched_dl_entity		dl;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	struct sched_ext_entity		scx;
+#endif
 	const struct sched_class	*sched_class;
 
 #ifdef CONFIG_SCHED_CORE
@@ -1150,6 +1187,11 @@ struct task_struct {
 	struct mutex_waiter		*blocked_on;
 #endif
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+	/* Mutex the task is blocked on, for proxy execution: */
+	struct mutex			*blocked_mutex;
+#endif
+
 #ifdef CONFIG_DEBUG_ATOMIC_SLEEP
 	int				non_block_count;
 #endif
@@ -0,0 +1,237 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF extensible scheduler class: Documentation is in kernel/sched/ext.c
+ */
+#ifndef _LINUX_SCHED_EXT_H
+#define _LINUX_SCHED_EXT_H
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+
+#include <linux/rhashtable-types.h>
+#include <linux/spinlock_types.h>
+
+struct task_struct;
+
+enum scx_consts {
+	SCX_SLICE_DFL		= 20 * 1000000,	/* 20ms */
+	SCX_EXIT_MSG_LEN	= 256,
+};
+
+/*
+ * Builtin dispatch queue ids. Custom DSQs created with scx_bpf_create_dsq()
+ * must use ids below SCX_DSQ_FLAG_BUILTIN.
+ */
+enum scx_dsq_id_flags {
+	SCX_DSQ_FLAG_BUILTIN	= 1LLU << 63,
+
+	SCX_DSQ_INVALID		= SCX_DSQ_FLAG_BUILTIN | 0,
+	SCX_DSQ_GLOBAL		= SCX_DSQ_FLAG_BUILTIN | 1,
+	SCX_DSQ_LOCAL		= SCX_DSQ_FLAG_BUILTIN | 2,
+};
+
+/*
+ * A dispatch queue (DSQ) is a FIFO of runnable tasks. Every CPU has a local
+ * DSQ from which it picks the next task, there is one global DSQ which any
+ * CPU consumes from when its local one runs dry, and the BPF scheduler may
+ * create any number of custom ones.
+ */
+struct scx_dispatch_q {
+	raw_spinlock_t		lock;
+	struct list_head	list;	/* tasks in dispatch order */
+	u32			nr;
+	u64			id;
+	struct rhash_head	hash_node;
+	struct rcu_head		rcu;
+};
+
+/* scx_entity.flags */
+enum scx_ent_flags {
+	SCX_TASK_QUEUED		= 1 << 0, /* on ext runqueue */
+	SCX_TASK_INITED		= 1 << 1, /* ops.init_task() called */
+	SCX_TASK_BAL_KEEP	= 1 << 2, /* balance decided to keep current */
+	SCX_TASK_CONSUMING	= 1 << 3, /* being moved to the consuming CPU */
+};
+
+/*
+ * The following is embedded in task_struct and contains all fields necessary
+ * for a task to be scheduled by SCX.
+ */
+struct sched_ext_entity {
+	struct scx_dispatch_q	*dsq;
+	struct list_head	dsq_node;	/* protected by dsq->lock */
+	struct list_head	runnable_node;	/* rq->scx.runnable_list */
+	unsigned long		runnable_at;	/* jiffies, for the watchdog */
+	u32			flags;
+
+	/*
+	 * Runtime budget in nsecs. This is usually set through
+	 * scx_bpf_dispatch() but can also be modified directly by the BPF
+	 * scheduler. When it reaches zero, the task is preempted and
+	 * ops.enqueue() is invoked to queue it again.
+	 */
+	u64			slice;
+};
+
+enum scx_exit_kind {
+	SCX_EXIT_NONE,
+	SCX_EXIT_DONE,
+	SCX_EXIT_UNREG,		/* BPF scheduler unregistered */
+	SCX_EXIT_UNREG_BPF,	/* BPF scheduler called scx_bpf_exit() */
+	SCX_EXIT_ERROR,		/* runtime error, see msg */
+	SCX_EXIT_ERROR_STALL,	/* watchdog detected a stalled task */
+};
+
+/* Passed to ops.exit() to describe why the BPF scheduler is being disabled. */
+struct scx_exit_info {
+	enum scx_exit_kind	kind;
+	s64			exit_code;
+	const char		*reason;
+	char			msg[SCX_EXIT_MSG_LEN];
+};
+
+/* sched_ext_ops.flags */
+enum scx_ops_flags {
+	/*
+	 * Only tasks with the SCHED_EXT policy are scheduled by the BPF
+	 * scheduler. If clear, all SCHED_NORMAL, SCHED_BATCH, SCHED_IDLE and
+	 * SCHED_EXT tasks are switched over.
+	 */
+	SCX_OPS_SWITCH_PARTIAL	= 1LLU << 0,
+
+	SCX_OPS_ALL_FLAGS	= SCX_OPS_SWITCH_PARTIAL,
+};
+
+/* Flags for ops.enqueue() and scx_bpf_dispatch() */
+enum scx_enq_flags {
+	/* expose select ENQUEUE_* flags */
+	SCX_ENQ_WAKEUP		= 1LLU << 0,
+
+	/* queue at the head of the DSQ rather than the tail */
+	SCX_ENQ_HEAD		= 1LLU << 32,
+	/* preempt the current task when dispatching to a local DSQ */
+	SCX_ENQ_PREEMPT		= 1LLU << 33,
+};
+
+/* Flags for ops.dequeue() */
+enum scx_deq_flags {
+	SCX_DEQ_SLEEP		= 1LLU << 0,
+};
+
+/**
+ * struct sched_ext_ops - Operation table for BPF scheduler implementation
+ *
+ * Userland can implement an arbitrary scheduling policy by implementing and
+ * loading operations in this table. All operations are optional.
+ */
+struct sched_ext_ops {
+	/**
+	 * select_cpu - Pick the target CPU for a task which is being woken up
+	 * @p: task being woken up
+	 * @prev_cpu: the cpu @p was on before sleeping
+	 * @wake_flags: %WF_* flags
+	 *
+	 * The returned CPU is only a hint, the task may still end up
+	 * elsewhere if the CPU is not allowed. If not implemented,
+	 * scx_bpf_select_cpu_dfl() is used.
+	 */
+	s32 (*select_cpu)(struct task_struct *p, s32 prev_cpu, u64 wake_flags);
+
+	/**
+	 * enqueue - Enqueue a task on the BPF scheduler
+	 * @p: task being enqueued
+	 * @enq_flags: %SCX_ENQ_*
+	 *
+	 * @p is ready to run. Dispatch it with scx_bpf_dispatch() to a DSQ.
+	 * If the task isn't dispatched, it's put on the global DSQ. If not
+	 * implemented, all tasks go to the global DSQ.
+	 */
+	void (*enqueue)(struct task_struct *p, u64 enq_flags);
+
+	/**
+	 * dequeue - Remove a task from the BPF scheduler
+	 * @p: task being dequeued
+	 * @deq_flags: %SCX_DEQ_*
+	 *
+	 * Called when @p stops being runnable or changes its properties.
+	 */
+	void (*dequeue)(struct task_struct *p, u64 deq_flags);
+
+	/**
+	 * dispatch - Fill the local DSQ of a CPU
+	 * @cpu: CPU to dispatch tasks for
+	 * @prev: previous task being switched out, NULL if not on SCX
+	 *
+	 * Called when @cpu's local DSQ and the global DSQ are empty. Use
+	 * scx_bpf_consume() to move a task from a custom DSQ to the local one.
+	 * If nothing ends up there and @prev is still runnable, @prev keeps
+	 * running.
+	 */
+	void (*dispatch)(s32 cpu, struct task_struct *prev);
+
+	/**
+	 * running - A task is starting to run on its associated CPU
+	 * @p: task starting to run
+	 */
+	void (*running)(struct task_struct *p);
+
+	/**
+	 * stopping - A task is stopping execution
+	 * @p: task stopping to run
+	 * @runnable: is task @p still runnable?
+	 */
+	void (*stopping)(struct task_struct *p, bool runnable);
+
+	/**
+	 * init_task - Initialize a task to run in a BPF scheduler
+	 * @p: task to initialize for BPF scheduling
+	 *
+	 * Called right before @p is queued on the BPF scheduler for the first
+	 * time, with its runqueue locked. A non-zero return is an error and
+	 * disables the BPF scheduler.
+	 */
+	s32 (*init_task)(struct task_struct *p);
+
+	/**
+	 * exit_task - Exit a previously-running task from the system
+	 * @p: task to exit
+	 *
+	 * Called when @p exits or leaves the BPF scheduler.
+	 */
+	void (*exit_task)(struct task_struct *p);
+
+	/**
+	 * init - Initialize the BPF scheduler
+	 */
+	s32 (*init)(void);
+
+	/**
+	 * exit - Clean up after the BPF scheduler
+	 * @info: Exit info
+	 */
+	void (*exit)(struct scx_exit_info *info);
+
+	/**
+	 * flags - %SCX_OPS_* flags
+	 */
+	u64 flags;
+
+	/**
+	 * timeout_ms - The maximum amount of time, in milliseconds, that a
+	 * runnable task should be able to wait before being scheduled. The
+	 * maximum timeout may not exceed the default timeout of 30 seconds.
+	 *
+	 * Defaults to the maximum allowed timeout value of 30 seconds.
+	 */
+	u32 timeout_ms;
+
+	/**
+	 * name - BPF scheduler's name
+	 *
+	 * Must be a non-zero valid BPF object name including only isalnum(),
+	 * '_' and '.' chars. Shows up in kernel messages.
+	 */
+	char name[128];
+};
+
+#endif	/* CONFIG_SCHED_CLASS_EXT */
+#endif	/* _LINUX_SCHED_EXT_H */
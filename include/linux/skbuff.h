@@ -3282,6 +3282,8 @@ static inline struct sk_buff *napi_alloc_skb(struct napi_struct *napi,
 	return __napi_alloc_skb(napi, length, GFP_ATOMIC);
 }
 void napi_consume_skb(struct sk_buff *skb, int budget);
+void napi_consume_skb_bulk(struct sk_buff **skbs, unsigned int count,
+			   int budget);
 
 void napi_skb_free_stolen_head(struct sk_buff *skb);
 void __napi_kfree_skb(struct sk_buff *skb, enum skb_drop_reason reason);
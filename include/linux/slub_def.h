@@ -39,6 +39,11 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_PCS,		/* Allocation from the percpu sheaves */
+	FREE_PCS,		/* Free to the percpu sheaves */
+	BARN_GET,		/* Full sheaf taken from the node barn */
+	BARN_PUT,		/* Full sheaf put to the node barn */
+	SHEAF_FLUSH,		/* Sheaf objects returned to slabs */
 	NR_SLUB_STAT_ITEMS
 };
 
@@ -83,6 +88,8 @@ struct kmem_cache_cpu {
 #define slub_percpu_partial_read_once(c)	NULL
 #endif // CONFIG_SLUB_CPU_PARTIAL
 
+struct slub_percpu_sheaves;
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -98,6 +105,9 @@ struct kmem_cache_order_objects {
 struct kmem_cache {
 #ifndef CONFIG_SLUB_TINY
 	struct kmem_cache_cpu __percpu *cpu_slab;
+	/* Optional per cpu object arrays, NULL unless enabled for the cache */
+	struct slub_percpu_sheaves __percpu *cpu_sheaves;
+	unsigned int sheaf_capacity;
 #endif
 	/* Used for retrieving partial slabs, etc. */
 	slab_flags_t flags;
@@ -168,6 +168,18 @@ static inline void memcpy_flushcache(void *dst, const void *src, size_t cnt)
 }
 #endif
 
+/*
+ * memcpy_nt - copy without allocating the destination in the caches, for
+ * large buffers that the CPU will not read back, e.g. frame buffers and
+ * buffers about to be handed to a device. The buffers must not overlap.
+ */
+#ifndef __HAVE_ARCH_MEMCPY_NT
+static inline void *memcpy_nt(void *dst, const void *src, size_t cnt)
+{
+	return memcpy(dst, src, cnt);
+}
+#endif
+
 void *memchr_inv(const void *s, int c, size_t n);
 char *strreplace(char *str, char old, char new);
 
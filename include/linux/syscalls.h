@@ -47,6 +47,7 @@ struct stat64;
 struct statfs;
 struct statfs64;
 struct statx;
+struct statx_dirent;
 struct sysinfo;
 struct timespec;
 struct __kernel_old_timeval;
@@ -445,6 +446,10 @@ asmlinkage long sys_quotactl_fd(unsigned int fd, unsigned int cmd, qid_t id,
 asmlinkage long sys_getdents64(unsigned int fd,
 				struct linux_dirent64 __user *dirent,
 				unsigned int count);
+asmlinkage long sys_getdents_statx(unsigned int fd,
+				   struct statx_dirent __user *dirent,
+				   unsigned int count, unsigned int flags,
+				   unsigned int mask);
 asmlinkage long sys_llseek(unsigned int fd, unsigned long offset_high,
 			unsigned long offset_low, loff_t __user *result,
 			unsigned int whence);
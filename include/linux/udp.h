@@ -68,6 +68,7 @@ struct udp_sock {
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
 	__u8		 unused[3];
+	__u32		 gso_txtime_delta; /* ns between GSO segment departures */
 	/*
 	 * For encapsulation sockets.
 	 */
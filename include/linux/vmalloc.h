@@ -71,7 +71,7 @@ struct vmap_area {
 	 * The following two variables can be packed, because
 	 * a vmap_area object can be either:
 	 *    1) in "free" tree (root is free_vmap_area_root)
-	 *    2) or "busy" tree (root is vmap_area_root)
+	 *    2) or "busy" tree (root is a per-node vmap_node.busy.root)
 	 */
 	union {
 		unsigned long subtree_max_size; /* in "free" tree */
@@ -253,7 +253,6 @@ extern long vread_iter(struct iov_iter *iter, const char *addr, size_t count);
 /*
  *	Internals.  Don't use..
  */
-extern struct list_head vmap_area_list;
 extern __init void vm_area_add_early(struct vm_struct *vm);
 extern __init void vm_area_register_early(struct vm_struct *vm, size_t align);
 
@@ -180,6 +180,44 @@ zstd_cctx *zstd_init_cctx(void *workspace, size_t workspace_size);
 size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size, const zstd_parameters *parameters);
 
+/* ======   Multi-threaded Compression   ====== */
+
+/* Chunk size used by zstd_compress_mt() when none is given */
+#define ZSTD_MT_DEFAULT_CHUNK_SIZE (1U << 20)
+
+/**
+ * zstd_compress_mt_bound() - dst capacity needed by zstd_compress_mt()
+ * @src_size:   The size of the data to compress.
+ * @chunk_size: The chunk size passed to zstd_compress_mt().
+ *
+ * Return:      The size of the destination buffer zstd_compress_mt() needs.
+ */
+size_t zstd_compress_mt_bound(size_t src_size, size_t chunk_size);
+
+/**
+ * zstd_compress_mt() - compress src into dst using several CPUs
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer. Must be at least
+ *                zstd_compress_mt_bound(src_size, chunk_size).
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ * @level:        The compression level.
+ * @chunk_size:   The size of the independently compressed chunks, or 0 for
+ *                ZSTD_MT_DEFAULT_CHUNK_SIZE.
+ *
+ * Each chunk of src is compressed into its own zstd frame, on the unbound
+ * workqueue and in the calling context. The frames are stored in the order
+ * of the chunks, so dst can be decompressed by any zstd decompressor. No
+ * match spans two chunks, so the ratio is a bit worse than with
+ * zstd_compress_cctx() on the whole input. Might sleep.
+ *
+ * Return:        The compressed size, -ENOSPC if dst_capacity is too small,
+ *                -ENOMEM if no context could be allocated or -EIO if zstd
+ *                failed.
+ */
+ssize_t zstd_compress_mt(void *dst, size_t dst_capacity, const void *src,
+	size_t src_size, int level, size_t chunk_size);
+
 /* ======   Single-pass Decompression   ====== */
 
 typedef ZSTD_DCtx zstd_dctx;
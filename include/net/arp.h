@@ -19,12 +19,60 @@ static inline u32 arp_hashfn(const void *pkey, const struct net_device *dev, u32
 }
 
 #ifdef CONFIG_INET
+/* Small direct-mapped per-CPU cache in front of the ARP hash table, so
+ * forwarding to a hot next hop reads the neighbour (and its prebuilt
+ * hh header) without walking the shared hash buckets. Entries hold no
+ * reference: they are valid while their generation matches
+ * arp_tbl.cache_gen, which neigh_destroy() bumps before the RCU free.
+ * Only softirq context, or BH disabled, touches it so no locking is
+ * needed.
+ */
+#define ARP_CACHE_BITS	6
+
+struct arp_cache_ent {
+	struct neighbour *n;
+	unsigned int gen;
+};
+
+DECLARE_PER_CPU(struct arp_cache_ent [1 << ARP_CACHE_BITS], arp_cache);
+
+static inline struct neighbour *arp_cache_lookup(struct net_device *dev,
+						 u32 key)
+{
+	struct arp_cache_ent *e;
+	struct neighbour *n;
+	unsigned int gen;
+
+	if (IS_ENABLED(CONFIG_PREEMPT_RT) || !in_softirq() || in_hardirq())
+		return ___neigh_lookup_noref(&arp_tbl, neigh_key_eq32,
+					     arp_hashfn, &key, dev);
+
+	e = this_cpu_ptr(&arp_cache[hash_32(key ^ dev->ifindex,
+					    ARP_CACHE_BITS)]);
+	gen = atomic_read(&arp_tbl.cache_gen);
+	n = e->n;
+	if (likely(n && e->gen == gen && n->dev == dev &&
+		   neigh_key_eq32(n, &key) && !READ_ONCE(n->dead)))
+		return n;
+
+	/* pairs with smp_mb__before_atomic() in neigh_destroy() */
+	smp_rmb();
+	n = ___neigh_lookup_noref(&arp_tbl, neigh_key_eq32, arp_hashfn,
+				  &key, dev);
+	if (n && !READ_ONCE(n->dead)) {
+		e->n = n;
+		e->gen = gen;
+	}
+
+	return n;
+}
+
 static inline struct neighbour *__ipv4_neigh_lookup_noref(struct net_device *dev, u32 key)
 {
 	if (dev->flags & (IFF_LOOPBACK | IFF_POINTOPOINT))
 		key = INADDR_ANY;
 
-	return ___neigh_lookup_noref(&arp_tbl, neigh_key_eq32, arp_hashfn, &key, dev);
+	return arp_cache_lookup(dev, key);
 }
 #else
 static inline
@@ -175,6 +175,7 @@ struct inet_cork {
 	__u16			gso_size;
 	u64			transmit_time;
 	u32			mark;
+	u32			gso_txtime_delta;
 };
 
 struct inet_cork_full {
@@ -82,6 +82,7 @@ struct ipcm_cookie {
 	__s16			tos;
 	char			priority;
 	__u16			gso_size;
+	__u32			gso_txtime_delta;
 };
 
 static inline void ipcm_init(struct ipcm_cookie *ipcm)
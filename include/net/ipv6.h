@@ -360,6 +360,7 @@ struct ipcm6_cookie {
 	__s16 tclass;
 	__u16 gso_size;
 	__s8  dontfrag;
+	__u32 gso_txtime_delta;
 	struct ipv6_txoptions *opt;
 };
 
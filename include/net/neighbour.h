@@ -227,6 +227,7 @@ struct neigh_table {
 	struct sk_buff_head	proxy_queue;
 	atomic_t		entries;
 	atomic_t		gc_entries;
+	atomic_t		cache_gen;	/* bumped per destroyed entry */
 	struct list_head	gc_list;
 	struct list_head	managed_list;
 	rwlock_t		lock;
@@ -174,6 +174,8 @@ INDIRECT_CALLABLE_DECLARE(int udpv6_rcv(struct sk_buff *));
 
 struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
 				  netdev_features_t features, bool is_ipv6);
+struct sk_buff *udp_gso_segment_txtime(struct sk_buff *gso_skb,
+				       __be16 protocol, u32 delta);
 
 static inline void udp_lib_init_sock(struct sock *sk)
 {
@@ -279,7 +281,8 @@ int udp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len);
 void udp_splice_eof(struct socket *sock);
 int udp_push_pending_frames(struct sock *sk);
 void udp_flush_pending_frames(struct sock *sk);
-int udp_cmsg_send(struct sock *sk, struct msghdr *msg, u16 *gso_size);
+int udp_cmsg_send(struct sock *sk, struct msghdr *msg, u16 *gso_size,
+		  u32 *gso_txtime_delta);
 void udp4_hwcsum(struct sk_buff *skb, __be32 src, __be32 dst);
 int udp_rcv(struct sk_buff *skb);
 int udp_ioctl(struct sock *sk, int cmd, int *karg);
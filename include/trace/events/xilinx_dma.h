@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM xilinx_dma
+
+#if !defined(_TRACE_XILINX_DMA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_XILINX_DMA_H
+
+#include <linux/tracepoint.h>
+#include <linux/dmaengine.h>
+
+/*
+ * Transfer life cycle events shared by the Xilinx DMA engine drivers. All
+ * events carry the DMA device name and the channel id, the descriptor events
+ * also carry the cookie so that submit, start and complete can be matched to
+ * build latency histograms.
+ */
+
+DECLARE_EVENT_CLASS(xilinx_dma_chan,
+	TP_PROTO(struct dma_chan *dc),
+	TP_ARGS(dc),
+	TP_STRUCT__entry(
+		__string(dev,	dev_name(dc->device->dev))
+		__field(int,	chan_id)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dc->device->dev));
+		__entry->chan_id = dc->chan_id;
+	),
+	TP_printk("%s chan%d", __get_str(dev), __entry->chan_id)
+);
+
+DEFINE_EVENT(xilinx_dma_chan, xilinx_dma_issue_pending,
+	TP_PROTO(struct dma_chan *dc),
+	TP_ARGS(dc)
+);
+
+DEFINE_EVENT(xilinx_dma_chan, xilinx_dma_terminate,
+	TP_PROTO(struct dma_chan *dc),
+	TP_ARGS(dc)
+);
+
+DECLARE_EVENT_CLASS(xilinx_dma_desc,
+	TP_PROTO(struct dma_chan *dc, dma_cookie_t cookie, size_t len),
+	TP_ARGS(dc, cookie, len),
+	TP_STRUCT__entry(
+		__string(dev,	dev_name(dc->device->dev))
+		__field(int,	chan_id)
+		__field(dma_cookie_t, cookie)
+		__field(size_t,	len)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dc->device->dev));
+		__entry->chan_id = dc->chan_id;
+		__entry->cookie = cookie;
+		__entry->len = len;
+	),
+	TP_printk("%s chan%d: cookie %d, len %zu", __get_str(dev),
+		  __entry->chan_id, __entry->cookie, __entry->len)
+);
+
+/* The descriptor has been submitted to the driver */
+DEFINE_EVENT(xilinx_dma_desc, xilinx_dma_submit,
+	TP_PROTO(struct dma_chan *dc, dma_cookie_t cookie, size_t len),
+	TP_ARGS(dc, cookie, len)
+);
+
+/* The descriptor has been handed to the hardware */
+DEFINE_EVENT(xilinx_dma_desc, xilinx_dma_start,
+	TP_PROTO(struct dma_chan *dc, dma_cookie_t cookie, size_t len),
+	TP_ARGS(dc, cookie, len)
+);
+
+/*
+ * A channel interrupt has been taken. @status is driver specific, the raw
+ * interrupt status for most engines, the completed descriptor count for XDMA.
+ */
+TRACE_EVENT(xilinx_dma_irq,
+	TP_PROTO(struct dma_chan *dc, u32 status),
+	TP_ARGS(dc, status),
+	TP_STRUCT__entry(
+		__string(dev,	dev_name(dc->device->dev))
+		__field(int,	chan_id)
+		__field(u32,	status)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dc->device->dev));
+		__entry->chan_id = dc->chan_id;
+		__entry->status = status;
+	),
+	TP_printk("%s chan%d: status 0x%08x", __get_str(dev),
+		  __entry->chan_id, __entry->status)
+);
+
+/*
+ * The descriptor has completed and its callback is about to be run, directly
+ * or from the virt-dma tasklet. @len is the number of bytes transferred.
+ */
+TRACE_EVENT(xilinx_dma_complete,
+	TP_PROTO(struct dma_chan *dc, dma_cookie_t cookie, size_t len,
+		 enum dmaengine_tx_result result),
+	TP_ARGS(dc, cookie, len, result),
+	TP_STRUCT__entry(
+		__string(dev,	dev_name(dc->device->dev))
+		__field(int,	chan_id)
+		__field(dma_cookie_t, cookie)
+		__field(size_t,	len)
+		__field(int,	result)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dc->device->dev));
+		__entry->chan_id = dc->chan_id;
+		__entry->cookie = cookie;
+		__entry->len = len;
+		__entry->result = result;
+	),
+	TP_printk("%s chan%d: cookie %d, len %zu, result %d",
+		  __get_str(dev), __entry->chan_id, __entry->cookie,
+		  __entry->len, __entry->result)
+);
+
+#endif /* _TRACE_XILINX_DMA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -185,6 +185,17 @@ struct fsxattr {
 #define BLKROTATIONAL _IO(0x12,126)
 #define BLKZEROOUT _IO(0x12,127)
 #define BLKGETDISKSEQ _IOR(0x12,128,__u64)
+
+/*
+ * io_uring commands on block devices, the byte range is passed in sqe->addr
+ * (start) and sqe->addr3 (length). Zone commands take zone aligned ranges.
+ */
+#define BLOCK_URING_CMD_DISCARD		_IO(0x12,0)
+#define BLOCK_URING_CMD_WRITE_ZEROES	_IO(0x12,1)
+#define BLOCK_URING_CMD_ZONE_RESET	_IO(0x12,2)
+#define BLOCK_URING_CMD_ZONE_OPEN	_IO(0x12,3)
+#define BLOCK_URING_CMD_ZONE_CLOSE	_IO(0x12,4)
+#define BLOCK_URING_CMD_ZONE_FINISH	_IO(0x12,5)
 /*
  * A jump here: 130-136 are reserved for zoned block devices
  * (see uapi/linux/blkzoned.h)
@@ -211,6 +211,16 @@
  *  7.39
  *  - add FUSE_DIRECT_IO_RELAX
  *  - add FUSE_STATX and related structures
+ *
+ *  7.40
+ *  - add max_stack_depth to fuse_init_out, add FUSE_PASSTHROUGH init flag
+ *  - add backing_id to fuse_open_out, add FOPEN_PASSTHROUGH open flag
+ *  - add FUSE_DEV_IOC_BACKING_OPEN and FUSE_DEV_IOC_BACKING_CLOSE
+ *
+ *  7.41
+ *  - add FUSE_OVER_IO_URING init flag
+ *  - add fuse_uring_cmd_req, fuse_uring_req_header and
+ *    fuse_uring_ent_in_out for the io-uring transport
  */
 
 #ifndef _LINUX_FUSE_H
@@ -246,7 +256,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 39
+#define FUSE_KERNEL_MINOR_VERSION 41
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -353,6 +363,7 @@ struct fuse_file_lock {
  * FOPEN_STREAM: the file is stream-like (no file position at all)
  * FOPEN_NOFLUSH: don't flush data cache on close (unless FUSE_WRITEBACK_CACHE)
  * FOPEN_PARALLEL_DIRECT_WRITES: Allow concurrent direct writes on the same inode
+ * FOPEN_PASSTHROUGH: passthrough read/write io for this open file
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
@@ -361,6 +372,7 @@ struct fuse_file_lock {
 #define FOPEN_STREAM		(1 << 4)
 #define FOPEN_NOFLUSH		(1 << 5)
 #define FOPEN_PARALLEL_DIRECT_WRITES	(1 << 6)
+#define FOPEN_PASSTHROUGH	(1 << 7)
 
 /**
  * INIT request/reply flags
@@ -411,6 +423,8 @@ struct fuse_file_lock {
  * FUSE_HAS_EXPIRE_ONLY: kernel supports expiry-only entry invalidation
  * FUSE_DIRECT_IO_RELAX: relax restrictions in FOPEN_DIRECT_IO mode, for now
  *                       allow shared mmap
+ * FUSE_PASSTHROUGH: passthrough read/write io for regular files
+ * FUSE_OVER_IO_URING: requests and replies may use io-uring queues
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -450,6 +464,8 @@ struct fuse_file_lock {
 #define FUSE_CREATE_SUPP_GROUP	(1ULL << 34)
 #define FUSE_HAS_EXPIRE_ONLY	(1ULL << 35)
 #define FUSE_DIRECT_IO_RELAX	(1ULL << 36)
+#define FUSE_PASSTHROUGH	(1ULL << 37)
+#define FUSE_OVER_IO_URING	(1ULL << 38)
 
 /**
  * CUSE INIT request/reply flags
@@ -759,7 +775,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	int32_t		backing_id;
 };
 
 struct fuse_release_in {
@@ -875,7 +891,8 @@ struct fuse_init_out {
 	uint16_t	max_pages;
 	uint16_t	map_alignment;
 	uint32_t	flags2;
-	uint32_t	unused[7];
+	uint32_t	max_stack_depth;
+	uint32_t	unused[6];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -1047,9 +1064,18 @@ struct fuse_notify_retrieve_in {
 	uint64_t	dummy4;
 };
 
+struct fuse_backing_map {
+	int32_t		fd;
+	uint32_t	flags;
+	uint64_t	padding;
+};
+
 /* Device ioctls: */
 #define FUSE_DEV_IOC_MAGIC		229
 #define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, uint32_t)
+#define FUSE_DEV_IOC_BACKING_OPEN	_IOW(FUSE_DEV_IOC_MAGIC, 1, \
+					     struct fuse_backing_map)
+#define FUSE_DEV_IOC_BACKING_CLOSE	_IOW(FUSE_DEV_IOC_MAGIC, 2, uint32_t)
 
 struct fuse_lseek_in {
 	uint64_t	fh;
@@ -1151,4 +1177,67 @@ struct fuse_supp_groups {
 	uint32_t	groups[];
 };
 
+/**
+ * Size of the area in struct fuse_uring_req_header holding the
+ * fuse_in_header of a request or the fuse_out_header of its reply
+ */
+#define FUSE_URING_IN_OUT_HEADER_SZ 128
+
+/**
+ * struct fuse_uring_ent_in_out - per request ring entry information
+ * @flags: currently unused, must be zero
+ * @commit_id: identifies the ring entry in FUSE_IO_URING_CMD_COMMIT_AND_FETCH
+ * @payload_sz: size of the request arguments (set by the kernel) or of the
+ *		reply arguments (set by the daemon) in the payload buffer
+ */
+struct fuse_uring_ent_in_out {
+	uint64_t	flags;
+	uint64_t	commit_id;
+	uint32_t	payload_sz;
+	uint32_t	padding;
+	uint64_t	reserved;
+};
+
+/**
+ * struct fuse_uring_req_header - header buffer of a ring entry
+ * @in_out: fuse_in_header of the request, fuse_out_header of the reply
+ * @ring_ent_in_out: see struct fuse_uring_ent_in_out
+ *
+ * The request arguments follow in the payload buffer of the entry, laid out
+ * as they would be following the fuse_in_header when read from /dev/fuse.
+ * The reply arguments are expected there in the same way.
+ */
+struct fuse_uring_req_header {
+	char				in_out[FUSE_URING_IN_OUT_HEADER_SZ];
+	struct fuse_uring_ent_in_out	ring_ent_in_out;
+};
+
+/**
+ * enum fuse_uring_cmd - io-uring command opcodes (sqe->cmd_op) on /dev/fuse
+ * @FUSE_IO_URING_CMD_REGISTER: register a ring entry and wait for a request
+ * @FUSE_IO_URING_CMD_COMMIT_AND_FETCH: send the reply to the request of an
+ *					entry and wait for the next request
+ */
+enum fuse_uring_cmd {
+	FUSE_IO_URING_CMD_INVALID = 0,
+	FUSE_IO_URING_CMD_REGISTER = 1,
+	FUSE_IO_URING_CMD_COMMIT_AND_FETCH = 2,
+};
+
+/**
+ * struct fuse_uring_cmd_req - command data in the 128 byte SQE
+ * @flags: currently unused, must be zero
+ * @commit_id: entry to commit, see struct fuse_uring_ent_in_out
+ * @qid: queue the entry belongs to, one queue per possible CPU
+ *
+ * FUSE_IO_URING_CMD_REGISTER passes an array of two iovecs in sqe->addr
+ * and sqe->len: the fuse_uring_req_header buffer and the payload buffer.
+ */
+struct fuse_uring_cmd_req {
+	uint64_t	flags;
+	uint64_t	commit_id;
+	uint16_t	qid;
+	uint8_t		padding[6];
+};
+
 #endif /* _LINUX_FUSE_H */
@@ -35,6 +35,17 @@
 /* Flags for xsk_umem_config flags */
 #define XDP_UMEM_UNALIGNED_CHUNK_FLAG (1 << 0)
 
+/* Force checksum calculation in software. Can be used for testing or
+ * working around potential HW issues. This option causes performance
+ * degradation and only works in XDP_COPY mode.
+ */
+#define XDP_UMEM_TX_SW_CSUM (1 << 1)
+
+/* Honour the tx_metadata_len field of struct xdp_umem_reg. Older kernels
+ * left that field as structure padding, so it is ignored without this flag.
+ */
+#define XDP_UMEM_TX_METADATA_LEN (1 << 2)
+
 struct sockaddr_xdp {
 	__u16 sxdp_family;
 	__u16 sxdp_flags;
@@ -76,6 +87,7 @@ struct xdp_umem_reg {
 	__u32 chunk_size;
 	__u32 headroom;
 	__u32 flags;
+	__u32 tx_metadata_len;
 };
 
 struct xdp_statistics {
@@ -121,4 +133,39 @@ struct xdp_desc {
  */
 #define XDP_PKT_CONTD (1 << 0)
 
+/* TX packet carries valid metadata. */
+#define XDP_TX_METADATA (1 << 1)
+
+/* Request L4 checksum offload: the device computes the checksum starting at
+ * csum_start and stores it at csum_start + csum_offset.
+ */
+#define XDP_TXMD_FLAGS_CHECKSUM			(1 << 0)
+
+/* Request the packet to be transmitted at launch_time, in the clock of the
+ * device (CLOCK_TAI for most TSN capable NICs), like SO_TXTIME does.
+ */
+#define XDP_TXMD_FLAGS_LAUNCH_TIME		(1 << 1)
+
+/* AF_XDP offloads request. The request is consumed by the driver when the
+ * packet is being transmitted. The structure sits right before desc->addr,
+ * in the last tx_metadata_len bytes of the headroom.
+ */
+struct xsk_tx_metadata {
+	__u64 flags;
+
+	struct {
+		/* XDP_TXMD_FLAGS_CHECKSUM */
+
+		/* Offset from desc->addr where checksumming should start. */
+		__u16 csum_start;
+		/* Offset from csum_start where checksum should be stored. */
+		__u16 csum_offset;
+
+		/* XDP_TXMD_FLAGS_LAUNCH_TIME */
+
+		/* Launch time in nanoseconds. */
+		__u64 launch_time;
+	} request;
+};
+
 #endif /* _LINUX_IF_XDP_H */
@@ -65,6 +65,8 @@ struct io_uring_sqe {
 		__u32		xattr_flags;
 		__u32		msg_ring_flags;
 		__u32		uring_cmd_flags;
+		__u32		futex_flags;
+		__u32		waitid_flags;
 	};
 	__u64	user_data;	/* data to be passed back at completion time */
 	/* pack this to avoid bogus arm OABI complaints */
@@ -240,6 +242,12 @@ enum io_uring_op {
 	IORING_OP_URING_CMD,
 	IORING_OP_SEND_ZC,
 	IORING_OP_SENDMSG_ZC,
+	IORING_OP_READ_MULTISHOT,
+	IORING_OP_FUTEX_WAIT,
+	IORING_OP_FUTEX_WAKE,
+	IORING_OP_FUTEX_WAITV,
+	IORING_OP_WAITID,
+	IORING_OP_EPOLL_WAIT,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
@@ -336,11 +344,18 @@ enum io_uring_op {
  *				0 is reported if zerocopy was actually possible.
  *				IORING_NOTIF_USAGE_ZC_COPIED if data was copied
  *				(at least partially).
+ *
+ * IORING_RECVSEND_BUNDLE	Used with IOSQE_BUFFER_SELECT on a ring mapped
+ *				buffer group. A recv may fill several
+ *				consecutive buffers, the CQE carries the id
+ *				of the first one and the total length, the
+ *				others follow it in the ring.
  */
 #define IORING_RECVSEND_POLL_FIRST	(1U << 0)
 #define IORING_RECV_MULTISHOT		(1U << 1)
 #define IORING_RECVSEND_FIXED_BUF	(1U << 2)
 #define IORING_SEND_ZC_REPORT_USAGE	(1U << 3)
+#define IORING_RECVSEND_BUNDLE		(1U << 4)
 
 /*
  * cqe.res for IORING_CQE_F_NOTIF if
@@ -397,11 +412,15 @@ struct io_uring_cqe {
  * IORING_CQE_F_SOCK_NONEMPTY	If set, more data to read after socket recv
  * IORING_CQE_F_NOTIF	Set for notification CQEs. Can be used to distinct
  * 			them from sends.
+ * IORING_CQE_F_BUF_MORE	If set, the buffer ID set in the upper 16 bits
+ *			is still in use, the data of the next completion
+ *			follows in the same buffer (IOU_PBUF_RING_INC).
  */
 #define IORING_CQE_F_BUFFER		(1U << 0)
 #define IORING_CQE_F_MORE		(1U << 1)
 #define IORING_CQE_F_SOCK_NONEMPTY	(1U << 2)
 #define IORING_CQE_F_NOTIF		(1U << 3)
+#define IORING_CQE_F_BUF_MORE		(1U << 4)
 
 enum {
 	IORING_CQE_BUFFER_SHIFT		= 16,
@@ -546,6 +565,18 @@ enum {
 	/* register a range of fixed file slots for automatic slot allocation */
 	IORING_REGISTER_FILE_ALLOC_RANGE	= 25,
 
+	/* set/clear busy poll settings */
+	IORING_REGISTER_NAPI			= 26,
+	IORING_UNREGISTER_NAPI			= 27,
+
+	/* per-opcode completion latency stats, shown in fdinfo */
+	IORING_REGISTER_STATS			= 28,
+	IORING_UNREGISTER_STATS			= 29,
+
+	/* share another ring's registered buffers or files */
+	IORING_REGISTER_CLONE_BUFFERS		= 30,
+	IORING_REGISTER_CLONE_FILES		= 31,
+
 	/* this goes last */
 	IORING_REGISTER_LAST,
 
@@ -658,9 +689,15 @@ struct io_uring_buf_ring {
  *			mmap(2) with the offset set as:
  *			IORING_OFF_PBUF_RING | (bgid << IORING_OFF_PBUF_SHIFT)
  *			to get a virtual mapping for the ring.
+ * IOU_PBUF_RING_INC:	If set, buffers are consumed incrementally. A
+ *			transfer only uses up the part of the head buffer it
+ *			needed, the next one continues in the same buffer.
+ *			Completions set IORING_CQE_F_BUF_MORE while the
+ *			kernel still holds on to the reported buffer.
  */
 enum {
 	IOU_PBUF_RING_MMAP	= 1,
+	IOU_PBUF_RING_INC	= 2,
 };
 
 /* argument for IORING_(UN)REGISTER_PBUF_RING */
@@ -721,6 +758,27 @@ struct io_uring_file_index_range {
 	__u64	resv;
 };
 
+/* flags for struct io_uring_clone_rsrc */
+enum {
+	/* src_fd is an index into the registered ring fds */
+	IORING_REGISTER_SRC_REGISTERED	= 1,
+};
+
+/* argument for IORING_REGISTER_CLONE_BUFFERS and IORING_REGISTER_CLONE_FILES */
+struct io_uring_clone_rsrc {
+	__u32	src_fd;
+	__u32	flags;
+	__u32	pad[6];
+};
+
+/* argument for IORING_(UN)REGISTER_NAPI */
+struct io_uring_napi {
+	__u32	busy_poll_to;
+	__u8	prefer_busy_poll;
+	__u8	pad[3];
+	__u64	resv;
+};
+
 struct io_uring_recvmsg_out {
 	__u32 namelen;
 	__u32 controllen;
@@ -58,6 +58,8 @@ enum {
 	NET_DM_CMD_CONFIG_NEW,
 	NET_DM_CMD_STATS_GET,
 	NET_DM_CMD_STATS_NEW,
+	NET_DM_CMD_AGGR_GET,
+	NET_DM_CMD_AGGR_NEW,
 	_NET_DM_CMD_MAX,
 };
 
@@ -94,6 +96,9 @@ enum net_dm_attr {
 	NET_DM_ATTR_HW_DROPS,			/* flag */
 	NET_DM_ATTR_FLOW_ACTION_COOKIE,		/* binary */
 	NET_DM_ATTR_REASON,			/* string */
+	NET_DM_ATTR_AGGR_COUNT,			/* u64 */
+	NET_DM_ATTR_AGGR_TOTAL,			/* u64 */
+	NET_DM_ATTR_AGGR_OVERFLOW,		/* flag */
 
 	__NET_DM_ATTR_MAX,
 	NET_DM_ATTR_MAX = __NET_DM_ATTR_MAX - 1
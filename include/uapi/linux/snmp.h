@@ -296,6 +296,8 @@ enum
 	LINUX_MIB_TCPMIGRATEREQSUCCESS,		/* TCPMigrateReqSuccess */
 	LINUX_MIB_TCPMIGRATEREQFAILURE,		/* TCPMigrateReqFailure */
 	LINUX_MIB_TCPPLBREHASH,			/* TCPPLBRehash */
+	LINUX_MIB_LOCALPORTALLOC,		/* LocalPortAlloc */
+	LINUX_MIB_LOCALPORTSCAN,		/* LocalPortScan */
 	__LINUX_MIB_MAX
 };
 
@@ -131,6 +131,21 @@ struct statx {
 	/* 0x100 */
 };
 
+/*
+ * Directory entry returned by getdents_statx(). The attributes of the entry
+ * are in d_stx, whose stx_mask is 0 if they could not be retrieved, e.g.
+ * for "..". Entries are not followed if they are symbolic links.
+ */
+struct statx_dirent {
+	__u64	d_ino;
+	__s64	d_off;
+	__u16	d_reclen;
+	__u8	d_type;
+	__u8	__spare[5];
+	struct statx d_stx;
+	char	d_name[];
+};
+
 /*
  * Flags to be stx_mask
  *
@@ -213,7 +213,8 @@ struct taskstats {
 
 enum {
 	TASKSTATS_CMD_UNSPEC = 0,	/* Reserved */
-	TASKSTATS_CMD_GET,		/* user->kernel request/get-response */
+	TASKSTATS_CMD_GET,		/* user->kernel request/get-response,
+					 * dumps all the tasks with NLM_F_DUMP */
 	TASKSTATS_CMD_NEW,		/* kernel->user event */
 	__TASKSTATS_CMD_MAX,
 };
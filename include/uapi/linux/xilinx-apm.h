@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Xilinx AXI Performance Monitor sample ring
+ */
+
+#ifndef __UAPI_XILINX_APM_H__
+#define __UAPI_XILINX_APM_H__
+
+#include <linux/types.h>
+
+/* Maximum number of metric counters of the APM */
+#define XAPM_MAX_COUNTERS	10
+
+/* UIO map index of the sample ring */
+#define XAPM_SAMPLE_MAP		2
+
+/**
+ * struct xapm_sample - Metric counters sampled at one timer tick
+ * @timestamp: CLOCK_MONOTONIC time of the sample in nanoseconds
+ * @clock: APM global clock counter
+ * @value: Metric counters, zero for the counters not selected
+ * @reserved: Reserved
+ */
+struct xapm_sample {
+	__u64 timestamp;
+	__u64 clock;
+	__u32 value[XAPM_MAX_COUNTERS];
+	__u32 reserved[2];
+};
+
+/**
+ * struct xapm_sample_ring - Sample ring header, followed by the samples
+ * @head: Number of samples written so far, written by the kernel
+ * @tail: Number of samples consumed so far, written by userspace
+ * @overruns: Number of samples overwritten before they were consumed
+ * @nr_samples: Number of samples in the ring
+ * @counters: Mask of the sampled metric counters
+ * @period_ns: Sampling period in nanoseconds
+ * @reserved: Reserved
+ *
+ * @head and @tail are free running, sample i lives at index
+ * (i % @nr_samples) of the array following the header. The counters are
+ * free running too, userspace computes the per-period deltas.
+ */
+struct xapm_sample_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 overruns;
+	__u32 nr_samples;
+	__u32 counters;
+	__u32 period_ns;
+	__u32 reserved[2];
+};
+
+#endif /* __UAPI_XILINX_APM_H__ */
@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Xilinx AXI DMA dma-buf streaming interface
+ */
+
+#ifndef __UAPI_XILINX_DMABUF_H__
+#define __UAPI_XILINX_DMABUF_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* Transfer directions, the MM2S and S2MM channels of the AXI DMA */
+#define XDMABUF_DIR_TX			0
+#define XDMABUF_DIR_RX			1
+
+/* Transfer states reported by XDMABUF_IOCTL_STATUS */
+#define XDMABUF_STATUS_COMPLETE		0
+#define XDMABUF_STATUS_IN_PROGRESS	1
+#define XDMABUF_STATUS_ERROR		2
+
+/**
+ * struct xdmabuf_queue - Queue a dma-buf to a channel
+ * @fd: dma-buf file descriptor, the whole buffer is transferred
+ * @eventfd: eventfd signalled once the transfer completes, -1 for none
+ * @direction: XDMABUF_DIR_TX or XDMABUF_DIR_RX
+ * @flags: Must be zero
+ * @cookie: Returned transfer cookie, for XDMABUF_IOCTL_STATUS
+ * @reserved: Must be zero
+ */
+struct xdmabuf_queue {
+	__s32 fd;
+	__s32 eventfd;
+	__u32 direction;
+	__u32 flags;
+	__s32 cookie;
+	__u32 reserved;
+};
+
+/**
+ * struct xdmabuf_status - Query the state of a queued transfer
+ * @cookie: Cookie returned by XDMABUF_IOCTL_QUEUE
+ * @direction: XDMABUF_DIR_TX or XDMABUF_DIR_RX
+ * @status: Returned XDMABUF_STATUS_* value
+ * @errors: Returned number of failed transfers in @direction
+ */
+struct xdmabuf_status {
+	__s32 cookie;
+	__u32 direction;
+	__u32 status;
+	__u32 errors;
+};
+
+/**
+ * struct xdmabuf_capture - Start a cyclic capture on the RX channel
+ * @period_size: Size of a period in bytes
+ * @num_periods: Number of periods in the ring, at least 2
+ * @eventfd: eventfd signalled as periods complete, -1 for none
+ * @flags: Must be zero
+ * @ring_offset: Returned mmap offset of the struct xdmabuf_ring page
+ * @data_offset: Returned mmap offset of the period buffer
+ */
+struct xdmabuf_capture {
+	__u32 period_size;
+	__u32 num_periods;
+	__s32 eventfd;
+	__u32 flags;
+	__u64 ring_offset;
+	__u64 data_offset;
+};
+
+/**
+ * struct xdmabuf_ring - Capture ring indices shared with userspace
+ * @head: Number of periods filled so far, written by the kernel
+ * @tail: Number of periods consumed so far, written by userspace
+ * @overruns: Number of periods overwritten before they were consumed
+ * @period_size: Size of a period in bytes
+ * @num_periods: Number of periods in the ring
+ * @reserved: Reserved
+ *
+ * @head and @tail are free running, period i lives at offset
+ * (i % @num_periods) * @period_size of the period buffer.
+ */
+struct xdmabuf_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 overruns;
+	__u32 period_size;
+	__u32 num_periods;
+	__u32 reserved[3];
+};
+
+#define XDMABUF_IOCTL_MAGIC	'x'
+
+#define XDMABUF_IOCTL_QUEUE	_IOWR(XDMABUF_IOCTL_MAGIC, 1, struct xdmabuf_queue)
+#define XDMABUF_IOCTL_STATUS	_IOWR(XDMABUF_IOCTL_MAGIC, 2, struct xdmabuf_status)
+#define XDMABUF_IOCTL_CAPTURE_START	_IOWR(XDMABUF_IOCTL_MAGIC, 3, struct xdmabuf_capture)
+#define XDMABUF_IOCTL_CAPTURE_STOP	_IO(XDMABUF_IOCTL_MAGIC, 4)
+
+#endif /* __UAPI_XILINX_DMABUF_H__ */
@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: GPL-2.0+ WITH Linux-syscall-note */
+/*
+ * Xilinx SD-FEC
+ *
+ * Extensions to the SD-FEC interface of <misc/xilinx_sdfec.h>
+ */
+#ifndef __XILINX_SDFEC_EXT_H__
+#define __XILINX_SDFEC_EXT_H__
+
+#include <linux/types.h>
+#include <misc/xilinx_sdfec.h>
+
+/* LDPC code banks, each one owns half of the code ids and of every table */
+#define XSDFEC_LDPC_NUM_BANKS (2)
+
+/**
+ * struct xsdfec_ldpc_code_set - Set of LDPC codes loaded in one call
+ * @codes: User pointer to an array of struct xsdfec_ldpc_params
+ * @nr_codes: Number of entries in @codes
+ * @bank: Code bank the codes are loaded to, below XSDFEC_LDPC_NUM_BANKS
+ *
+ * All the codes are validated before any of them is written. Their code ids
+ * and table offsets must lie within the half of the code and table space
+ * owned by @bank. A bank which is not the active one may be loaded while the
+ * device is started.
+ */
+struct xsdfec_ldpc_code_set {
+	__u64 codes;
+	__u32 nr_codes;
+	__u32 bank;
+};
+
+/**
+ * struct xsdfec_sqe - Streaming submission queue entry, one per code block
+ * @user_data: Opaque value returned in the completion
+ * @ctrl: Control word sent on the CTRL stream ahead of the block
+ * @din_len: Number of DIN bytes in the slot of the entry
+ * @dout_len: Number of DOUT bytes expected back in the slot of the entry
+ *
+ * Entry i of the queue uses data slot i % nr_slots.
+ */
+struct xsdfec_sqe {
+	__u64 user_data;
+	__u32 ctrl;
+	__u32 din_len;
+	__u32 dout_len;
+	__u32 reserved;
+};
+
+/**
+ * struct xsdfec_cqe - Streaming completion queue entry
+ * @user_data: Value from the matching struct xsdfec_sqe
+ * @slot: Data slot holding the decoded DOUT data
+ * @status: Word returned on the STATUS stream for the block, carrying the
+ *	    decode result (iterations, parity pass/fail) as laid out by the
+ *	    core
+ * @result: 0 on success, -EIO on DMA error, -EINVAL for a malformed entry,
+ *	    -ECANCELED if the stream was stopped
+ */
+struct xsdfec_cqe {
+	__u64 user_data;
+	__u32 slot;
+	__u32 status;
+	__s32 result;
+	__u32 reserved;
+};
+
+/**
+ * struct xsdfec_stream_ring - Ring indices shared with userspace
+ * @sq_head: Submission entries consumed, written by the kernel
+ * @sq_tail: Submission entries produced, written by userspace
+ * @cq_head: Completion entries consumed, written by userspace
+ * @cq_tail: Completion entries produced, written by the kernel
+ * @nr_slots: Number of entries of each queue and of data slots
+ * @reserved: Reserved
+ *
+ * The indices are free running, entry i lives at i % @nr_slots. The
+ * submission queue, an array of struct xsdfec_sqe, follows this header and
+ * is followed by the completion queue, an array of struct xsdfec_cqe.
+ */
+struct xsdfec_stream_ring {
+	__u32 sq_head;
+	__u32 sq_tail;
+	__u32 cq_head;
+	__u32 cq_tail;
+	__u32 nr_slots;
+	__u32 reserved[3];
+};
+
+/**
+ * struct xsdfec_stream_setup - Set up the streaming data path
+ * @nr_slots: Number of data slots, a power of two from 2 to 1024
+ * @din_size: Size of the DIN area of a slot, rounded up by the kernel
+ * @dout_size: Size of the DOUT area of a slot, rounded up by the kernel
+ * @flags: Must be zero
+ * @ring_offset: Returned mmap offset of the struct xsdfec_stream_ring
+ * @data_offset: Returned mmap offset of the data slots, slot i holds its
+ *		 DIN data at i * (@din_size + @dout_size) and its DOUT data
+ *		 @din_size bytes further
+ */
+struct xsdfec_stream_setup {
+	__u32 nr_slots;
+	__u32 din_size;
+	__u32 dout_size;
+	__u32 flags;
+	__u64 ring_offset;
+	__u64 data_offset;
+};
+
+/*
+ * XSDFEC IOCTL List
+ */
+/**
+ * DOC: XSDFEC_ADD_LDPC_CODE_SET
+ *
+ * @Description
+ *
+ * ioctl that validates and loads a set of LDPC codes into a code bank
+ */
+#define XSDFEC_ADD_LDPC_CODE_SET                                               \
+	_IOW(XSDFEC_MAGIC, 14, struct xsdfec_ldpc_code_set)
+/**
+ * DOC: XSDFEC_SET_CODE_BANK
+ *
+ * @Description
+ *
+ * ioctl that makes a code bank the active one, the bank previously active
+ * can then be reloaded while the device is running. Userspace switches the
+ * code ids of its control words to the new bank once this returns.
+ */
+#define XSDFEC_SET_CODE_BANK _IOW(XSDFEC_MAGIC, 15, __u32)
+/**
+ * DOC: XSDFEC_GET_CODE_BANK
+ *
+ * @Description
+ *
+ * ioctl that returns the active code bank
+ */
+#define XSDFEC_GET_CODE_BANK _IOR(XSDFEC_MAGIC, 16, __u32)
+/**
+ * DOC: XSDFEC_STREAM_START
+ *
+ * @Description
+ *
+ * ioctl that sets up the kernel managed data path over the DMA channels of
+ * the device. This fails if the device is not set to XSDFEC_MAINTAIN_ORDER,
+ * since the DOUT and STATUS data is matched to the blocks in order.
+ * Completions are signalled by poll() with EPOLLIN | EPOLLRDBAND.
+ */
+#define XSDFEC_STREAM_START                                                    \
+	_IOWR(XSDFEC_MAGIC, 17, struct xsdfec_stream_setup)
+/**
+ * DOC: XSDFEC_STREAM_KICK
+ *
+ * @Description
+ *
+ * ioctl that queues the submission entries produced so far. Entries added
+ * while blocks are in flight are picked up as they complete, so a busy
+ * stream needs no further kick.
+ */
+#define XSDFEC_STREAM_KICK _IO(XSDFEC_MAGIC, 18)
+/**
+ * DOC: XSDFEC_STREAM_STOP
+ *
+ * @Description
+ *
+ * ioctl that stops the data path, blocks in flight complete with
+ * -ECANCELED. The rings stay mapped until the file is closed.
+ */
+#define XSDFEC_STREAM_STOP _IO(XSDFEC_MAGIC, 19)
+
+/* Maximum number of SD-FEC instances behind one aggregate stream */
+#define XSDFEC_AGG_MAX_MEMBERS (16)
+
+/**
+ * struct xsdfec_agg_setup - Aggregate stream set up on /dev/xsdfec_agg
+ * @stream: Ring and slot geometry, as for XSDFEC_STREAM_START
+ * @code: Code of the instances to aggregate, XSDFEC_TURBO_CODE or
+ *	  XSDFEC_LDPC_CODE
+ * @code_bank: Active LDPC code bank of the instances, ignored for Turbo
+ * @members: Mask of the device ids (N of xsdfecN) which may be used, 0 for
+ *	     any. Returns the mask of the instances in use
+ * @nr_members: Returns the number of instances in use
+ * @reserved: Must be zero
+ *
+ * The instances must be started, set to XSDFEC_MAINTAIN_ORDER and have no
+ * stream of their own. The ring and the data slots are laid out as for
+ * XSDFEC_STREAM_START, each block is sent to the least loaded instance and
+ * the completions are posted in submission order.
+ */
+struct xsdfec_agg_setup {
+	struct xsdfec_stream_setup stream;
+	__u32 code;
+	__u32 code_bank;
+	__u64 members;
+	__u32 nr_members;
+	__u32 reserved;
+};
+
+/**
+ * struct xsdfec_agg_member_stats - Statistics of an aggregated instance
+ * @dev_id: Device id of the instance, -1 once it has been removed
+ * @inflight: Number of blocks in flight on the instance
+ * @blocks: Number of blocks completed by the instance
+ * @errors: Number of blocks completed with an error
+ * @isr_err_count: ISR error count of the instance
+ * @cecc_count: Correctable ECC count of the instance
+ * @uecc_count: Uncorrectable ECC count of the instance
+ * @reserved: Reserved
+ */
+struct xsdfec_agg_member_stats {
+	__s32 dev_id;
+	__u32 inflight;
+	__u64 blocks;
+	__u64 errors;
+	__u32 isr_err_count;
+	__u32 cecc_count;
+	__u32 uecc_count;
+	__u32 reserved;
+};
+
+/**
+ * struct xsdfec_agg_stats - Combined statistics of an aggregate stream
+ * @nr_members: Number of valid entries in @members
+ * @inflight: Number of blocks in flight
+ * @blocks: Number of blocks completed
+ * @errors: Number of blocks completed with an error
+ * @din_bytes: Number of DIN bytes of the completed blocks
+ * @dout_bytes: Number of DOUT bytes of the completed blocks
+ * @isr_err_count: Sum of the ISR error counts of the instances
+ * @cecc_count: Sum of the correctable ECC counts of the instances
+ * @uecc_count: Sum of the uncorrectable ECC counts of the instances
+ * @reserved: Reserved
+ * @members: Per instance statistics
+ */
+struct xsdfec_agg_stats {
+	__u32 nr_members;
+	__u32 inflight;
+	__u64 blocks;
+	__u64 errors;
+	__u64 din_bytes;
+	__u64 dout_bytes;
+	__u32 isr_err_count;
+	__u32 cecc_count;
+	__u32 uecc_count;
+	__u32 reserved;
+	struct xsdfec_agg_member_stats members[XSDFEC_AGG_MAX_MEMBERS];
+};
+
+/**
+ * DOC: XSDFEC_AGG_START
+ *
+ * @Description
+ *
+ * ioctl of /dev/xsdfec_agg that claims the matching idle SD-FEC instances
+ * and sets up an aggregate stream over them. XSDFEC_STREAM_KICK and
+ * XSDFEC_STREAM_STOP, poll() and mmap() then behave as on a single
+ * instance.
+ */
+#define XSDFEC_AGG_START _IOWR(XSDFEC_MAGIC, 20, struct xsdfec_agg_setup)
+/**
+ * DOC: XSDFEC_AGG_GET_STATS
+ *
+ * @Description
+ *
+ * ioctl of /dev/xsdfec_agg that returns the combined statistics of the
+ * aggregate stream and of each of its instances.
+ */
+#define XSDFEC_AGG_GET_STATS _IOR(XSDFEC_MAGIC, 21, struct xsdfec_agg_stats)
+
+#endif /* __XILINX_SDFEC_EXT_H__ */
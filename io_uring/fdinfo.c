@@ -14,6 +14,7 @@
 #include "fdinfo.h"
 #include "cancel.h"
 #include "rsrc.h"
+#include "stats.h"
 
 #ifdef CONFIG_PROC_FS
 static __cold int io_uring_show_cred(struct seq_file *m, unsigned int id,
@@ -156,6 +157,8 @@ __cold void io_uring_show_fdinfo(struct seq_file *m, struct file *f)
 
 	seq_printf(m, "SqThread:\t%d\n", sq_pid);
 	seq_printf(m, "SqThreadCpu:\t%d\n", sq_cpu);
+	seq_printf(m, "SqWorkTime:\t%llu\n",
+		   READ_ONCE(ctx->sq_work_time) / NSEC_PER_USEC);
 	seq_printf(m, "UserFiles:\t%u\n", ctx->nr_user_files);
 	for (i = 0; has_lock && i < ctx->nr_user_files; i++) {
 		struct file *f = io_file_from_index(&ctx->file_table, i);
@@ -181,6 +184,9 @@ __cold void io_uring_show_fdinfo(struct seq_file *m, struct file *f)
 			io_uring_show_cred(m, index, cred);
 	}
 
+	if (has_lock)
+		io_stats_show(m, ctx);
+
 	seq_puts(m, "PollList:\n");
 	for (i = 0; i < (1U << ctx->cancel_table.hash_bits); i++) {
 		struct io_hash_bucket *hb = &ctx->cancel_table.hbs[i];
@@ -59,6 +59,10 @@ struct io_worker {
 	unsigned long create_state;
 	struct callback_head create_work;
 	int create_index;
+	int create_node;
+
+	/* NUMA node the worker runs on, NUMA_NO_NODE if not node bound */
+	int node;
 
 	union {
 		struct rcu_head rcu;
@@ -133,7 +137,7 @@ struct io_cb_cancel_data {
 	bool cancel_all;
 };
 
-static bool create_io_worker(struct io_wq *wq, int index);
+static bool create_io_worker(struct io_wq *wq, int index, int node);
 static void io_wq_dec_running(struct io_worker *worker);
 static bool io_acct_cancel_pending_work(struct io_wq *wq,
 					struct io_wq_acct *acct,
@@ -267,8 +271,8 @@ static inline bool io_acct_run_queue(struct io_wq_acct *acct)
  * Check head of free list for an available worker. If one isn't available,
  * caller must create one.
  */
-static bool io_wq_activate_free_worker(struct io_wq *wq,
-					struct io_wq_acct *acct)
+static bool __io_wq_activate_free_worker(struct io_wq *wq,
+					  struct io_wq_acct *acct, int node)
 	__must_hold(RCU)
 {
 	struct hlist_nulls_node *n;
@@ -280,6 +284,8 @@ static bool io_wq_activate_free_worker(struct io_wq *wq,
 	 * of exiting, keep trying.
 	 */
 	hlist_nulls_for_each_entry_rcu(worker, n, &wq->free_list, nulls_node) {
+		if (node != NUMA_NO_NODE && worker->node != node)
+			continue;
 		if (!io_worker_get(worker))
 			continue;
 		if (io_wq_get_acct(worker) != acct) {
@@ -299,6 +305,21 @@ static bool io_wq_activate_free_worker(struct io_wq *wq,
 	return false;
 }
 
+/*
+ * Prefer an idle worker on the local node, so that the work runs close to
+ * the memory of the task that queued it. Any other idle worker is still
+ * better than waiting for a new one, the work list is shared.
+ */
+static bool io_wq_activate_free_worker(struct io_wq *wq,
+					struct io_wq_acct *acct)
+	__must_hold(RCU)
+{
+	if (nr_node_ids > 1 &&
+	    __io_wq_activate_free_worker(wq, acct, numa_node_id()))
+		return true;
+	return __io_wq_activate_free_worker(wq, acct, NUMA_NO_NODE);
+}
+
 /*
  * We need a worker. If we find a free one, we're good. If not, and we're
  * below the max number of workers, create one.
@@ -321,7 +342,7 @@ static bool io_wq_create_worker(struct io_wq *wq, struct io_wq_acct *acct)
 	raw_spin_unlock(&wq->lock);
 	atomic_inc(&acct->nr_running);
 	atomic_inc(&wq->worker_refs);
-	return create_io_worker(wq, acct->index);
+	return create_io_worker(wq, acct->index, numa_node_id());
 }
 
 static void io_wq_inc_running(struct io_worker *worker)
@@ -350,7 +371,7 @@ static void create_worker_cb(struct callback_head *cb)
 	}
 	raw_spin_unlock(&wq->lock);
 	if (do_create) {
-		create_io_worker(wq, worker->create_index);
+		create_io_worker(wq, worker->create_index, worker->create_node);
 	} else {
 		atomic_dec(&acct->nr_running);
 		io_worker_ref_put(wq);
@@ -383,6 +404,7 @@ static bool io_queue_worker_create(struct io_worker *worker,
 	atomic_inc(&wq->worker_refs);
 	init_task_work(&worker->create_work, func);
 	worker->create_index = acct->index;
+	worker->create_node = numa_node_id();
 	if (!task_work_add(wq->task, &worker->create_work, TWA_SIGNAL)) {
 		/*
 		 * EXIT may have been set after checking it above, check after
@@ -727,7 +749,17 @@ static void io_init_new_worker(struct io_wq *wq, struct io_worker *worker,
 {
 	tsk->worker_private = worker;
 	worker->task = tsk;
-	set_cpus_allowed_ptr(tsk, wq->cpu_mask);
+	/*
+	 * Keep the worker on its node unless the io-wq affinity doesn't
+	 * cover the whole node or the node has no CPUs online, then it isn't
+	 * node bound.
+	 */
+	if (worker->node != NUMA_NO_NODE &&
+	    cpumask_subset(cpumask_of_node(worker->node), wq->cpu_mask) &&
+	    cpumask_intersects(cpumask_of_node(worker->node), cpu_online_mask))
+		set_cpus_allowed_ptr(tsk, cpumask_of_node(worker->node));
+	else
+		set_cpus_allowed_ptr(tsk, wq->cpu_mask);
 
 	raw_spin_lock(&wq->lock);
 	hlist_nulls_add_head_rcu(&worker->nulls_node, &wq->free_list);
@@ -771,7 +803,7 @@ static void create_worker_cont(struct callback_head *cb)
 	worker = container_of(cb, struct io_worker, create_work);
 	clear_bit_unlock(0, &worker->create_state);
 	wq = worker->wq;
-	tsk = create_io_thread(io_wq_worker, worker, NUMA_NO_NODE);
+	tsk = create_io_thread(io_wq_worker, worker, worker->node);
 	if (!IS_ERR(tsk)) {
 		io_init_new_worker(wq, worker, tsk);
 		io_worker_release(worker);
@@ -813,7 +845,7 @@ static void io_workqueue_create(struct work_struct *work)
 		kfree(worker);
 }
 
-static bool create_io_worker(struct io_wq *wq, int index)
+static bool create_io_worker(struct io_wq *wq, int index, int node)
 {
 	struct io_wq_acct *acct = &wq->acct[index];
 	struct io_worker *worker;
@@ -839,8 +871,9 @@ static bool create_io_worker(struct io_wq *wq, int index)
 
 	if (index == IO_WQ_ACCT_BOUND)
 		worker->flags |= IO_WORKER_F_BOUND;
+	worker->node = nr_node_ids > 1 ? node : NUMA_NO_NODE;
 
-	tsk = create_io_thread(io_wq_worker, worker, NUMA_NO_NODE);
+	tsk = create_io_thread(io_wq_worker, worker, worker->node);
 	if (!IS_ERR(tsk)) {
 		io_init_new_worker(wq, worker, tsk);
 	} else if (!io_should_retry_thread(PTR_ERR(tsk))) {
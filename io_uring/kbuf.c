@@ -74,7 +74,7 @@ void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags)
 	return;
 }
 
-unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags)
+unsigned int __io_put_kbuf(struct io_kiocb *req, int len, unsigned issue_flags)
 {
 	unsigned int cflags;
 
@@ -92,17 +92,17 @@ unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags)
 	 */
 	if (req->flags & REQ_F_BUFFER_RING) {
 		/* no buffers to recycle for this case */
-		cflags = __io_put_kbuf_list(req, NULL);
+		cflags = __io_put_kbuf_list(req, len, NULL);
 	} else if (issue_flags & IO_URING_F_UNLOCKED) {
 		struct io_ring_ctx *ctx = req->ctx;
 
 		spin_lock(&ctx->completion_lock);
-		cflags = __io_put_kbuf_list(req, &ctx->io_buffers_comp);
+		cflags = __io_put_kbuf_list(req, len, &ctx->io_buffers_comp);
 		spin_unlock(&ctx->completion_lock);
 	} else {
 		lockdep_assert_held(&req->ctx->uring_lock);
 
-		cflags = __io_put_kbuf_list(req, &req->ctx->io_buffers_cache);
+		cflags = __io_put_kbuf_list(req, len, &req->ctx->io_buffers_cache);
 	}
 	return cflags;
 }
@@ -125,6 +125,51 @@ static void __user *io_provided_buffer_select(struct io_kiocb *req, size_t *len,
 	return NULL;
 }
 
+static struct io_uring_buf *io_ring_head_to_buf(struct io_buffer_list *bl,
+						__u16 head)
+{
+	struct io_uring_buf *buf;
+
+	head &= bl->mask;
+	/* mmaped buffers are always contig */
+	if (bl->is_mmap || head < IO_BUFFER_LIST_BUF_PER_PAGE)
+		return &bl->buf_ring->bufs[head];
+
+	buf = page_address(bl->buf_pages[head / IO_BUFFER_LIST_BUF_PER_PAGE]);
+	return buf + (head & (IO_BUFFER_LIST_BUF_PER_PAGE - 1));
+}
+
+/*
+ * Consume @len bytes of an incrementally consumed ring. The head buffer is
+ * only retired once it has been used up, until then its entry in the ring is
+ * advanced past the used part and completions keep reporting its id.
+ */
+bool io_kbuf_inc_commit(struct io_buffer_list *bl, int len)
+{
+	if (len <= 0)
+		return false;
+
+	while (len) {
+		struct io_uring_buf *buf = io_ring_head_to_buf(bl, bl->head);
+		u32 buf_len = READ_ONCE(buf->len);
+		int this_len = min_t(u32, len, buf_len);
+
+		buf_len -= this_len;
+		if (buf_len) {
+			WRITE_ONCE(buf->addr, READ_ONCE(buf->addr) + this_len);
+			WRITE_ONCE(buf->len, buf_len);
+			return false;
+		}
+		WRITE_ONCE(buf->len, 0);
+		bl->head++;
+		len -= this_len;
+		/* the transfer can't have gone past the tail */
+		if (bl->head == smp_load_acquire(&bl->buf_ring->tail))
+			break;
+	}
+	return true;
+}
+
 static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
 					  struct io_buffer_list *bl,
 					  unsigned int issue_flags)
@@ -136,16 +181,7 @@ static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
 	if (unlikely(smp_load_acquire(&br->tail) == head))
 		return NULL;
 
-	head &= bl->mask;
-	/* mmaped buffers are always contig */
-	if (bl->is_mmap || head < IO_BUFFER_LIST_BUF_PER_PAGE) {
-		buf = &br->bufs[head];
-	} else {
-		int off = head & (IO_BUFFER_LIST_BUF_PER_PAGE - 1);
-		int index = head / IO_BUFFER_LIST_BUF_PER_PAGE;
-		buf = page_address(bl->buf_pages[index]);
-		buf += off;
-	}
+	buf = io_ring_head_to_buf(bl, head);
 	if (*len == 0 || *len > buf->len)
 		*len = buf->len;
 	req->flags |= REQ_F_BUFFER_RING;
@@ -161,7 +197,8 @@ static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
 		 * io-wq context and there may be further retries in async hybrid
 		 * mode. For the locked case, the caller must call commit when
 		 * the transfer completes (or if we get -EAGAIN and must poll of
-		 * retry).
+		 * retry). As the transfer length isn't known yet, the buffer
+		 * is consumed as a whole even for an incremental ring.
 		 */
 		req->buf_list = NULL;
 		bl->head++;
@@ -189,6 +226,81 @@ void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
 	return ret;
 }
 
+/*
+ * Select a bundle of up to @nr_iovs consecutive ring buffers for a single
+ * transfer of at most @max_len bytes, 0 meaning no limit, and map them into
+ * @iov. The id of the first buffer ends up in req->buf_index, the CQE reports
+ * it and the others follow it in the ring. As with a single ring buffer the
+ * head is only moved when the request completes, see io_put_kbufs(). From
+ * io-wq the buffers have to be consumed right away, and as nothing would tell
+ * the application how many were taken the bundle is a single buffer then.
+ *
+ * Returns the number of buffers selected, 0 if none are available, or
+ * -EINVAL if the group isn't ring mapped.
+ */
+int io_buffers_select(struct io_kiocb *req, struct iovec *iov, int nr_iovs,
+		      size_t max_len, unsigned int issue_flags)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_buffer_list *bl;
+	struct io_uring_buf *buf;
+	__u16 head, nr_avail;
+	int i = 0;
+
+	io_ring_submit_lock(ctx, issue_flags);
+
+	bl = io_buffer_get_list(ctx, req->buf_index);
+	if (unlikely(!bl))
+		goto out;
+	if (unlikely(!bl->is_mapped)) {
+		i = -EINVAL;
+		goto out;
+	}
+
+	if (issue_flags & IO_URING_F_UNLOCKED || !file_can_poll(req->file)) {
+		iov->iov_base = io_ring_buffer_select(req, &max_len, bl,
+						      issue_flags);
+		if (iov->iov_base) {
+			iov->iov_len = max_len;
+			i = 1;
+		}
+		goto out;
+	}
+
+	head = bl->head;
+	nr_avail = smp_load_acquire(&bl->buf_ring->tail) - head;
+	if (unlikely(!nr_avail))
+		goto out;
+	nr_iovs = min_t(int, nr_iovs, nr_avail);
+
+	for (i = 0; i < nr_iovs; i++) {
+		size_t len;
+
+		buf = io_ring_head_to_buf(bl, head + i);
+		if (i == 0)
+			req->buf_index = buf->bid;
+
+		len = buf->len;
+		if (max_len)
+			len = min_t(size_t, len, max_len);
+		iov[i].iov_base = u64_to_user_ptr(buf->addr);
+		iov[i].iov_len = len;
+		if (max_len) {
+			max_len -= len;
+			if (!max_len) {
+				i++;
+				break;
+			}
+		}
+	}
+
+	req->flags |= REQ_F_BUFFER_RING;
+	req->buf_list = bl;
+out:
+	io_ring_submit_unlock(ctx, issue_flags);
+	return i;
+}
+
 static __cold int io_init_bl_list(struct io_ring_ctx *ctx)
 {
 	int i;
@@ -552,7 +664,7 @@ int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
 
 	if (reg.resv[0] || reg.resv[1] || reg.resv[2])
 		return -EINVAL;
-	if (reg.flags & ~IOU_PBUF_RING_MMAP)
+	if (reg.flags & ~(IOU_PBUF_RING_MMAP | IOU_PBUF_RING_INC))
 		return -EINVAL;
 	if (!(reg.flags & IOU_PBUF_RING_MMAP)) {
 		if (!reg.ring_addr)
@@ -596,6 +708,7 @@ int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
 	if (!ret) {
 		bl->nr_entries = reg.ring_entries;
 		bl->mask = reg.ring_entries - 1;
+		bl->is_inc = !!(reg.flags & IOU_PBUF_RING_INC);
 
 		io_buffer_add_list(ctx, bl, reg.bgid);
 		return 0;
@@ -28,6 +28,8 @@ struct io_buffer_list {
 	__u8 is_mapped;
 	/* ring mapped provided buffers, but mmap'ed by application */
 	__u8 is_mmap;
+	/* ring buffers are consumed incrementally, IOU_PBUF_RING_INC */
+	__u8 is_inc;
 };
 
 struct io_buffer {
@@ -40,6 +42,8 @@ struct io_buffer {
 
 void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
 			      unsigned int issue_flags);
+int io_buffers_select(struct io_kiocb *req, struct iovec *iov, int nr_iovs,
+		      size_t max_len, unsigned int issue_flags);
 void io_destroy_buffers(struct io_ring_ctx *ctx);
 
 int io_remove_buffers_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe);
@@ -51,7 +55,8 @@ int io_provide_buffers(struct io_kiocb *req, unsigned int issue_flags);
 int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg);
 int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg);
 
-unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags);
+unsigned int __io_put_kbuf(struct io_kiocb *req, int len, unsigned issue_flags);
+bool io_kbuf_inc_commit(struct io_buffer_list *bl, int len);
 
 void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags);
 
@@ -99,7 +104,20 @@ static inline void io_kbuf_recycle(struct io_kiocb *req, unsigned issue_flags)
 		io_kbuf_recycle_ring(req);
 }
 
-static inline unsigned int __io_put_kbuf_list(struct io_kiocb *req,
+/*
+ * Consume @len bytes from the head of the ring. Returns false if the head
+ * buffer of an incrementally consumed ring is still in use, the CQE then
+ * gets IORING_CQE_F_BUF_MORE.
+ */
+static inline bool io_kbuf_commit(struct io_buffer_list *bl, int len)
+{
+	if (bl->is_inc)
+		return io_kbuf_inc_commit(bl, len);
+	bl->head++;
+	return true;
+}
+
+static inline unsigned int __io_put_kbuf_list(struct io_kiocb *req, int len,
 					      struct list_head *list)
 {
 	unsigned int ret = IORING_CQE_F_BUFFER | (req->buf_index << IORING_CQE_BUFFER_SHIFT);
@@ -107,7 +125,8 @@ static inline unsigned int __io_put_kbuf_list(struct io_kiocb *req,
 	if (req->flags & REQ_F_BUFFER_RING) {
 		if (req->buf_list) {
 			req->buf_index = req->buf_list->bgid;
-			req->buf_list->head++;
+			if (!io_kbuf_commit(req->buf_list, len))
+				ret |= IORING_CQE_F_BUF_MORE;
 		}
 		req->flags &= ~REQ_F_BUFFER_RING;
 	} else {
@@ -125,15 +144,29 @@ static inline unsigned int io_put_kbuf_comp(struct io_kiocb *req)
 
 	if (!(req->flags & (REQ_F_BUFFER_SELECTED|REQ_F_BUFFER_RING)))
 		return 0;
-	return __io_put_kbuf_list(req, &req->ctx->io_buffers_comp);
+	return __io_put_kbuf_list(req, 0, &req->ctx->io_buffers_comp);
 }
 
-static inline unsigned int io_put_kbuf(struct io_kiocb *req,
+/* Put the selected buffer, @len bytes of it have been used */
+static inline unsigned int io_put_kbuf(struct io_kiocb *req, int len,
 				       unsigned issue_flags)
 {
 
 	if (!(req->flags & (REQ_F_BUFFER_SELECTED|REQ_F_BUFFER_RING)))
 		return 0;
-	return __io_put_kbuf(req, issue_flags);
+	return __io_put_kbuf(req, len, issue_flags);
+}
+
+/*
+ * Put a bundle from io_buffers_select(), @len bytes spread over @nbufs of its
+ * buffers have been used and are consumed along with the first one.
+ */
+static inline unsigned int io_put_kbufs(struct io_kiocb *req, int len,
+					int nbufs, unsigned issue_flags)
+{
+	if ((req->flags & REQ_F_BUFFER_RING) && req->buf_list &&
+	    !req->buf_list->is_inc && nbufs > 1)
+		req->buf_list->head += nbufs - 1;
+	return io_put_kbuf(req, len, issue_flags);
 }
 #endif
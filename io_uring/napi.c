@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/hashtable.h>
+
+#include "io_uring.h"
+#include "napi.h"
+
+/* Timeout for cleanout of stale entries. */
+#define NAPI_TIMEOUT		(60 * HZ)
+
+/* napi ids busy polled per wait, the list itself isn't bounded */
+#define IO_NAPI_MAX_IDS		16
+
+struct io_napi_entry {
+	unsigned int		napi_id;
+	struct list_head	list;
+
+	unsigned long		timeout;
+	struct hlist_node	node;
+
+	struct rcu_head		rcu;
+};
+
+static struct io_napi_entry *io_napi_hash_find(struct hlist_head *hash_list,
+					       unsigned int napi_id)
+{
+	struct io_napi_entry *e;
+
+	hlist_for_each_entry_rcu(e, hash_list, node) {
+		if (e->napi_id != napi_id)
+			continue;
+		e->timeout = jiffies + NAPI_TIMEOUT;
+		return e;
+	}
+
+	return NULL;
+}
+
+void __io_napi_add(struct io_ring_ctx *ctx, struct socket *sock)
+{
+	struct hlist_head *hash_list;
+	unsigned int napi_id;
+	struct sock *sk;
+	struct io_napi_entry *e;
+
+	sk = sock->sk;
+	if (!sk)
+		return;
+
+	napi_id = READ_ONCE(sk->sk_napi_id);
+
+	/* Non-NAPI IDs can be rejected. */
+	if (napi_id < MIN_NAPI_ID)
+		return;
+
+	hash_list = &ctx->napi_ht[hash_min(napi_id, HASH_BITS(ctx->napi_ht))];
+
+	rcu_read_lock();
+	e = io_napi_hash_find(hash_list, napi_id);
+	if (e) {
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	e = kmalloc(sizeof(*e), GFP_NOWAIT);
+	if (!e)
+		return;
+
+	e->napi_id = napi_id;
+	e->timeout = jiffies + NAPI_TIMEOUT;
+
+	spin_lock(&ctx->napi_lock);
+	if (unlikely(io_napi_hash_find(hash_list, napi_id))) {
+		spin_unlock(&ctx->napi_lock);
+		kfree(e);
+		return;
+	}
+
+	hlist_add_tail_rcu(&e->node, hash_list);
+	list_add_tail_rcu(&e->list, &ctx->napi_list);
+	spin_unlock(&ctx->napi_lock);
+}
+
+static void __io_napi_remove_stale(struct io_ring_ctx *ctx)
+{
+	struct io_napi_entry *e;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	spin_lock(&ctx->napi_lock);
+	hash_for_each_safe(ctx->napi_ht, i, tmp, e, node) {
+		if (time_after(jiffies, e->timeout)) {
+			list_del_rcu(&e->list);
+			hash_del_rcu(&e->node);
+			kfree_rcu(e, rcu);
+		}
+	}
+	spin_unlock(&ctx->napi_lock);
+}
+
+static inline void io_napi_remove_stale(struct io_ring_ctx *ctx, bool is_stale)
+{
+	if (is_stale)
+		__io_napi_remove_stale(ctx);
+}
+
+static inline bool io_napi_busy_loop_timeout(unsigned long start_time,
+					     unsigned long bp_usec)
+{
+	if (bp_usec) {
+		unsigned long end_time = start_time + bp_usec;
+		unsigned long now = busy_loop_current_time();
+
+		return time_after(now, end_time);
+	}
+
+	return true;
+}
+
+static bool io_napi_busy_loop_should_end(void *data,
+					 unsigned long start_time)
+{
+	struct io_wait_queue *iowq = data;
+
+	if (signal_pending(current))
+		return true;
+	if (io_should_wake(iowq) || io_has_work(iowq->ctx))
+		return true;
+	if (io_napi_busy_loop_timeout(start_time, iowq->napi_busy_poll_to))
+		return true;
+
+	return false;
+}
+
+/*
+ * Snapshot the napi ids to poll. napi_busy_loop() may reschedule, so it
+ * can't be called with the list under RCU.
+ */
+static unsigned int io_napi_get_ids(struct io_ring_ctx *ctx,
+				    unsigned int *ids, bool *is_stale)
+{
+	struct io_napi_entry *e;
+	unsigned int nr = 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(e, &ctx->napi_list, list) {
+		if (time_after(jiffies, e->timeout))
+			*is_stale = true;
+		if (nr < IO_NAPI_MAX_IDS)
+			ids[nr++] = e->napi_id;
+	}
+	rcu_read_unlock();
+
+	return nr;
+}
+
+/*
+ * __io_napi_busy_loop() - busy poll the napi ids of the ring before waiting
+ * @ctx: pointer to io-uring context structure
+ * @iowq: pointer to io wait queue
+ *
+ * Busy polls until enough CQEs are posted, task work or a signal is pending,
+ * or the busy poll timeout of the ring, bounded by the wait timeout, runs
+ * out. A single napi id is handed to napi_busy_loop() with a loop end
+ * callback, several ones are polled round robin.
+ */
+void __io_napi_busy_loop(struct io_ring_ctx *ctx, struct io_wait_queue *iowq)
+{
+	unsigned int ids[IO_NAPI_MAX_IDS];
+	unsigned long start_time;
+	bool is_stale = false;
+	unsigned int nr, i;
+
+	iowq->napi_busy_poll_to = READ_ONCE(ctx->napi_busy_poll_to);
+	iowq->napi_prefer_busy_poll = READ_ONCE(ctx->napi_prefer_busy_poll);
+	if (!iowq->napi_busy_poll_to)
+		return;
+
+	if (iowq->timeout != KTIME_MAX) {
+		s64 left = ktime_to_us(ktime_sub(iowq->timeout, ktime_get()));
+
+		if (left <= 0)
+			return;
+		iowq->napi_busy_poll_to = min_t(s64, iowq->napi_busy_poll_to,
+						left);
+	}
+
+	nr = io_napi_get_ids(ctx, ids, &is_stale);
+	if (!nr)
+		goto out;
+
+	start_time = busy_loop_current_time();
+	if (nr == 1) {
+		napi_busy_loop(ids[0], io_napi_busy_loop_should_end, iowq,
+			       iowq->napi_prefer_busy_poll, BUSY_POLL_BUDGET);
+		goto out;
+	}
+
+	do {
+		for (i = 0; i < nr; i++)
+			napi_busy_loop(ids[i], NULL, NULL,
+				       iowq->napi_prefer_busy_poll,
+				       BUSY_POLL_BUDGET);
+		cond_resched();
+	} while (!io_napi_busy_loop_should_end(iowq, start_time));
+out:
+	io_napi_remove_stale(ctx, is_stale);
+}
+
+/*
+ * io_napi_init() - Init napi settings
+ * @ctx: pointer to io-uring context structure
+ *
+ * Init napi settings in the io-uring context.
+ */
+void io_napi_init(struct io_ring_ctx *ctx)
+{
+	INIT_LIST_HEAD(&ctx->napi_list);
+	spin_lock_init(&ctx->napi_lock);
+	ctx->napi_prefer_busy_poll = false;
+	ctx->napi_busy_poll_to = 0;
+}
+
+/*
+ * io_napi_free() - Deallocate napi
+ * @ctx: pointer to io-uring context structure
+ *
+ * Free the napi list and the hash table in the io-uring context.
+ */
+void io_napi_free(struct io_ring_ctx *ctx)
+{
+	struct io_napi_entry *e;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	spin_lock(&ctx->napi_lock);
+	hash_for_each_safe(ctx->napi_ht, i, tmp, e, node) {
+		hash_del_rcu(&e->node);
+		kfree_rcu(e, rcu);
+	}
+	INIT_LIST_HEAD_RCU(&ctx->napi_list);
+	spin_unlock(&ctx->napi_lock);
+}
+
+/*
+ * io_register_napi() - Register napi with io-uring
+ * @ctx: pointer to io-uring context structure
+ * @arg: pointer to io_uring_napi structure
+ *
+ * Register napi in the io-uring context. The previous settings are copied
+ * back to @arg.
+ */
+int io_register_napi(struct io_ring_ctx *ctx, void __user *arg)
+{
+	const struct io_uring_napi curr = {
+		.busy_poll_to	  = ctx->napi_busy_poll_to,
+		.prefer_busy_poll = ctx->napi_prefer_busy_poll
+	};
+	struct io_uring_napi napi;
+
+	if (copy_from_user(&napi, arg, sizeof(napi)))
+		return -EFAULT;
+	if (napi.pad[0] || napi.pad[1] || napi.pad[2] || napi.resv)
+		return -EINVAL;
+
+	if (copy_to_user(arg, &curr, sizeof(curr)))
+		return -EFAULT;
+
+	WRITE_ONCE(ctx->napi_busy_poll_to, napi.busy_poll_to);
+	WRITE_ONCE(ctx->napi_prefer_busy_poll, !!napi.prefer_busy_poll);
+	return 0;
+}
+
+/*
+ * io_unregister_napi() - Unregister napi with io-uring
+ * @ctx: pointer to io-uring context structure
+ * @arg: pointer to io_uring_napi structure
+ *
+ * Unregister napi. If @arg has been specified copy the busy poll timeout and
+ * prefer busy poll setting to the passed in structure.
+ */
+int io_unregister_napi(struct io_ring_ctx *ctx, void __user *arg)
+{
+	const struct io_uring_napi curr = {
+		.busy_poll_to	  = ctx->napi_busy_poll_to,
+		.prefer_busy_poll = ctx->napi_prefer_busy_poll
+	};
+
+	if (arg && copy_to_user(arg, &curr, sizeof(curr)))
+		return -EFAULT;
+
+	WRITE_ONCE(ctx->napi_busy_poll_to, 0);
+	WRITE_ONCE(ctx->napi_prefer_busy_poll, false);
+	return 0;
+}
@@ -64,6 +64,8 @@ struct io_sr_msg {
 	/* initialised and used only by !msg send variants */
 	u16				addr_len;
 	u16				buf_group;
+	/* buffers used by the last bundle recv */
+	u16				nr_bufs;
 	void __user			*addr;
 	void __user			*msg_control;
 	/* used only for send zerocopy */
@@ -568,7 +570,8 @@ int io_recvmsg_prep_async(struct io_kiocb *req)
 	return ret;
 }
 
-#define RECVMSG_FLAGS (IORING_RECVSEND_POLL_FIRST | IORING_RECV_MULTISHOT)
+#define RECVMSG_FLAGS (IORING_RECVSEND_POLL_FIRST | IORING_RECV_MULTISHOT | \
+			IORING_RECVSEND_BUNDLE)
 
 int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
@@ -605,12 +608,22 @@ int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 		 */
 		sr->buf_group = req->buf_index;
 	}
+	if (sr->flags & IORING_RECVSEND_BUNDLE) {
+		if (req->opcode != IORING_OP_RECV)
+			return -EINVAL;
+		if (!(req->flags & REQ_F_BUFFER_SELECT))
+			return -EINVAL;
+		if (sr->msg_flags & MSG_WAITALL)
+			return -EINVAL;
+		sr->buf_group = req->buf_index;
+	}
 
 #ifdef CONFIG_COMPAT
 	if (req->ctx->compat)
 		sr->msg_flags |= MSG_CMSG_COMPAT;
 #endif
 	sr->done_io = 0;
+	sr->nr_bufs = 0;
 	return 0;
 }
 
@@ -619,6 +632,7 @@ static inline void io_recv_prep_retry(struct io_kiocb *req)
 	struct io_sr_msg *sr = io_kiocb_to_cmd(req, struct io_sr_msg);
 
 	sr->done_io = 0;
+	sr->nr_bufs = 0;
 	sr->len = 0; /* get from the provided buffer */
 	req->buf_index = sr->buf_group;
 }
@@ -633,9 +647,10 @@ static inline bool io_recv_finish(struct io_kiocb *req, int *ret,
 				  struct msghdr *msg, bool mshot_finished,
 				  unsigned issue_flags)
 {
+	struct io_sr_msg *sr = io_kiocb_to_cmd(req, struct io_sr_msg);
 	unsigned int cflags;
 
-	cflags = io_put_kbuf(req, issue_flags);
+	cflags = io_put_kbufs(req, *ret, sr->nr_bufs, issue_flags);
 	if (msg->msg_inq && msg->msg_inq != -1)
 		cflags |= IORING_CQE_F_SOCK_NONEMPTY;
 
@@ -865,13 +880,24 @@ int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 	return ret;
 }
 
+/* Number of buffers of a bundle that @len received bytes have been spread over */
+static int io_bundle_nbufs(const struct iovec *iov, int nr_iovs, int len)
+{
+	int nbufs;
+
+	for (nbufs = 0; len > 0 && nbufs < nr_iovs; nbufs++)
+		len -= min_t(size_t, len, iov[nbufs].iov_len);
+	return nbufs;
+}
+
 int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 {
 	struct io_sr_msg *sr = io_kiocb_to_cmd(req, struct io_sr_msg);
+	struct iovec iov[UIO_FASTIOV];
 	struct msghdr msg;
 	struct socket *sock;
 	unsigned flags;
-	int ret, min_ret = 0;
+	int ret, min_ret = 0, nr_iovs = 0;
 	bool force_nonblock = issue_flags & IO_URING_F_NONBLOCK;
 	size_t len = sr->len;
 
@@ -895,7 +921,21 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	msg.msg_ubuf = NULL;
 
 retry_multishot:
-	if (io_do_buffer_select(req)) {
+	if ((sr->flags & IORING_RECVSEND_BUNDLE) && io_do_buffer_select(req)) {
+		size_t total = 0;
+		int i;
+
+		nr_iovs = io_buffers_select(req, iov, UIO_FASTIOV, sr->len,
+					    issue_flags);
+		if (nr_iovs <= 0)
+			return nr_iovs ?: -ENOBUFS;
+		for (i = 0; i < nr_iovs; i++)
+			total += iov[i].iov_len;
+		iov_iter_init(&msg.msg_iter, ITER_DEST, iov, nr_iovs, total);
+		/* a retry that still owns the buffers only gets the first one */
+		sr->buf = iov[0].iov_base;
+		len = iov[0].iov_len;
+	} else if (io_do_buffer_select(req)) {
 		void __user *buf;
 
 		buf = io_buffer_select(req, &len, issue_flags);
@@ -904,9 +944,11 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 		sr->buf = buf;
 	}
 
-	ret = import_ubuf(ITER_DEST, sr->buf, len, &msg.msg_iter);
-	if (unlikely(ret))
-		goto out_free;
+	if (!nr_iovs) {
+		ret = import_ubuf(ITER_DEST, sr->buf, len, &msg.msg_iter);
+		if (unlikely(ret))
+			goto out_free;
+	}
 
 	msg.msg_inq = -1;
 	msg.msg_flags = 0;
@@ -924,7 +966,9 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 				io_kbuf_recycle(req, issue_flags);
 				return IOU_ISSUE_SKIP_COMPLETE;
 			}
-
+			/* the bundle iovec doesn't outlive this issue */
+			if (nr_iovs)
+				io_kbuf_recycle(req, issue_flags);
 			return -EAGAIN;
 		}
 		if (ret > 0 && io_net_retry(sock, flags)) {
@@ -942,6 +986,9 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 		req_set_fail(req);
 	}
 
+	if (ret > 0 && nr_iovs)
+		sr->nr_bufs = io_bundle_nbufs(iov, nr_iovs, ret);
+
 	if (ret > 0)
 		ret += sr->done_io;
 	else if (sr->done_io)
@@ -949,8 +996,10 @@ int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	else
 		io_kbuf_recycle(req, issue_flags);
 
-	if (!io_recv_finish(req, &ret, &msg, ret <= 0, issue_flags))
+	if (!io_recv_finish(req, &ret, &msg, ret <= 0, issue_flags)) {
+		nr_iovs = 0;
 		goto retry_multishot;
+	}
 
 	return ret;
 }
@@ -19,6 +19,7 @@
 #include "kbuf.h"
 #include "poll.h"
 #include "cancel.h"
+#include "napi.h"
 
 struct io_poll_update {
 	struct file			*file;
@@ -572,6 +573,7 @@ static int __io_arm_poll_handler(struct io_kiocb *req,
 	INIT_HLIST_NODE(&req->hash_node);
 	req->work.cancel_seq = atomic_read(&ctx->cancel_seq);
 	io_init_poll_iocb(poll, mask);
+	io_napi_add(req);
 	poll->file = req->file;
 	req->apoll_events = poll->events;
 
@@ -139,12 +139,15 @@ static void io_buffer_unmap(struct io_ring_ctx *ctx, struct io_mapped_ubuf **slo
 	unsigned int i;
 
 	if (imu != &dummy_ubuf) {
+		if (!refcount_dec_and_test(&imu->refs))
+			goto out;
 		for (i = 0; i < imu->nr_bvecs; i++)
 			unpin_user_page(imu->bvec[i].bv_page);
 		if (imu->acct_pages)
 			io_unaccount_mem(ctx, imu->acct_pages);
 		kvfree(imu);
 	}
+out:
 	*slot = NULL;
 }
 
@@ -1138,6 +1141,7 @@ static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 	imu->ubuf = (unsigned long) iov->iov_base;
 	imu->ubuf_end = imu->ubuf + iov->iov_len;
 	imu->nr_bvecs = nr_pages;
+	refcount_set(&imu->refs, 1);
 	*pimu = imu;
 	ret = 0;
 
@@ -1220,6 +1224,159 @@ int io_sqe_buffers_register(struct io_ring_ctx *ctx, void __user *arg,
 	return ret;
 }
 
+static int io_clone_buffers(struct io_ring_ctx *ctx,
+			    struct io_ring_ctx *src_ctx)
+{
+	struct io_rsrc_data *data;
+	unsigned int i, nr;
+	int ret;
+
+	if (ctx->user_bufs)
+		return -EBUSY;
+	/* also zero while the source is quiescing for unregister */
+	nr = src_ctx->nr_user_bufs;
+	if (!src_ctx->user_bufs || !nr)
+		return -ENXIO;
+	/*
+	 * The pages stay accounted to whichever ring unmaps the buffer last,
+	 * so both must charge the same user and mm.
+	 */
+	if (ctx->user != src_ctx->user ||
+	    ctx->mm_account != src_ctx->mm_account)
+		return -EPERM;
+
+	ret = io_rsrc_data_alloc(ctx, IORING_RSRC_BUFFER, NULL, nr, &data);
+	if (ret)
+		return ret;
+	ret = io_buffers_map_alloc(ctx, nr);
+	if (ret) {
+		io_rsrc_data_free(data);
+		return ret;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct io_mapped_ubuf *imu = src_ctx->user_bufs[i];
+
+		if (imu != &dummy_ubuf)
+			refcount_inc(&imu->refs);
+		ctx->user_bufs[i] = imu;
+	}
+	ctx->nr_user_bufs = nr;
+	ctx->buf_data = data;
+	return 0;
+}
+
+static int io_clone_files(struct io_ring_ctx *ctx, struct io_ring_ctx *src_ctx)
+{
+	unsigned int i, nr;
+	int ret;
+
+	if (ctx->file_data)
+		return -EBUSY;
+	nr = src_ctx->nr_user_files;
+	if (!src_ctx->file_data || !nr)
+		return -ENXIO;
+
+	ret = io_rsrc_data_alloc(ctx, IORING_RSRC_FILE, NULL, nr,
+				 &ctx->file_data);
+	if (ret)
+		return ret;
+	if (!io_alloc_file_tables(&ctx->file_table, nr)) {
+		io_rsrc_data_free(ctx->file_data);
+		ctx->file_data = NULL;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr; i++, ctx->nr_user_files++) {
+		struct file *file = io_file_from_index(&src_ctx->file_table, i);
+
+		if (!file)
+			continue;
+		get_file(file);
+		ret = io_scm_file_account(ctx, file);
+		if (ret) {
+			fput(file);
+			__io_sqe_files_unregister(ctx);
+			return ret;
+		}
+		io_fixed_file_set(io_fixed_file_slot(&ctx->file_table, i), file);
+		io_file_bitmap_set(&ctx->file_table, i);
+	}
+
+	io_file_table_set_alloc_range(ctx, src_ctx->file_alloc_start,
+			src_ctx->file_alloc_end - src_ctx->file_alloc_start);
+	return 0;
+}
+
+static void io_lock_two_rings(struct io_ring_ctx *ctx1,
+			      struct io_ring_ctx *ctx2)
+{
+	if (ctx1 > ctx2)
+		swap(ctx1, ctx2);
+	mutex_lock(&ctx1->uring_lock);
+	mutex_lock_nested(&ctx2->uring_lock, SINGLE_DEPTH_NESTING);
+}
+
+/*
+ * Give @ctx its own buffer or file table, filled from the table of another
+ * ring. Buffers are shared by reference, so their pages are neither pinned
+ * nor accounted again. Files get a reference each. Either table can be
+ * updated or unregistered afterwards without affecting the other one.
+ */
+int io_register_clone_rsrc(struct io_ring_ctx *ctx, void __user *arg,
+			   int type)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_uring_clone_rsrc clone;
+	struct io_ring_ctx *src_ctx;
+	struct file *file;
+	int ret;
+
+	if (copy_from_user(&clone, arg, sizeof(clone)))
+		return -EFAULT;
+	if (clone.flags & ~IORING_REGISTER_SRC_REGISTERED)
+		return -EINVAL;
+	if (memchr_inv(clone.pad, 0, sizeof(clone.pad)))
+		return -EINVAL;
+
+	if (clone.flags & IORING_REGISTER_SRC_REGISTERED) {
+		struct io_uring_task *tctx = current->io_uring;
+		unsigned int idx = clone.src_fd;
+
+		if (!tctx || idx >= IO_RINGFD_REG_MAX)
+			return -EINVAL;
+		idx = array_index_nospec(idx, IO_RINGFD_REG_MAX);
+		file = tctx->registered_rings[idx];
+		if (!file)
+			return -EBADF;
+		get_file(file);
+	} else {
+		file = fget(clone.src_fd);
+		if (!file)
+			return -EBADF;
+		if (!io_is_uring_fops(file)) {
+			fput(file);
+			return -EOPNOTSUPP;
+		}
+	}
+
+	src_ctx = file->private_data;
+	if (src_ctx != ctx) {
+		mutex_unlock(&ctx->uring_lock);
+		io_lock_two_rings(ctx, src_ctx);
+	}
+
+	if (type == IORING_RSRC_BUFFER)
+		ret = io_clone_buffers(ctx, src_ctx);
+	else
+		ret = io_clone_files(ctx, src_ctx);
+
+	if (src_ctx != ctx)
+		mutex_unlock(&src_ctx->uring_lock);
+	fput(file);
+	return ret;
+}
+
 int io_import_fixed(int ddir, struct iov_iter *iter,
 			   struct io_mapped_ubuf *imu,
 			   u64 buf_addr, size_t len)
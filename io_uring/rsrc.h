@@ -53,6 +53,8 @@ struct io_mapped_ubuf {
 	u64		ubuf;
 	u64		ubuf_end;
 	unsigned int	nr_bvecs;
+	/* one per buffer table holding it, see IORING_REGISTER_CLONE_BUFFERS */
+	refcount_t	refs;
 	unsigned long	acct_pages;
 	struct bio_vec	bvec[] __counted_by(nr_bvecs);
 };
@@ -74,6 +76,8 @@ void __io_sqe_files_unregister(struct io_ring_ctx *ctx);
 int io_sqe_files_unregister(struct io_ring_ctx *ctx);
 int io_sqe_files_register(struct io_ring_ctx *ctx, void __user *arg,
 			  unsigned nr_args, u64 __user *tags);
+int io_register_clone_rsrc(struct io_ring_ctx *ctx, void __user *arg,
+			   int type);
 
 int __io_scm_file_account(struct io_ring_ctx *ctx, struct file *file);
 
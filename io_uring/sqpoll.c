@@ -10,6 +10,7 @@
 #include <linux/slab.h>
 #include <linux/audit.h>
 #include <linux/security.h>
+#include <linux/sched/clock.h>
 #include <linux/io_uring.h>
 
 #include <uapi/linux/io_uring.h>
@@ -18,6 +19,8 @@
 #include "sqpoll.h"
 
 #define IORING_SQPOLL_CAP_ENTRIES_VALUE 8
+/* time slice of each ring per round on a shared sqpoll thread */
+#define IORING_SQPOLL_QUANTUM_NS	(50 * NSEC_PER_USEC)
 
 enum {
 	IO_SQ_THREAD_SHOULD_STOP = 0,
@@ -202,6 +205,86 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 	return ret;
 }
 
+/*
+ * Service a ring of a shared sqpoll thread. The rings are serviced by
+ * deficit round robin on the time spent on them: each round a ring with
+ * work gets another quantum and submits batches until it has used up its
+ * credit or has nothing left to do, so a busy ring can't hog the thread
+ * however expensive its submissions are. Idle rings don't build up credit.
+ */
+static int io_sq_thread_drr(struct io_ring_ctx *ctx)
+{
+	u64 start, now;
+	int ret = 0, submitted = 0;
+
+	if (!io_sqring_entries(ctx) && wq_list_empty(&ctx->iopoll_list)) {
+		ctx->sq_deficit = 0;
+		return 0;
+	}
+
+	ctx->sq_deficit = min_t(s64, ctx->sq_deficit + IORING_SQPOLL_QUANTUM_NS,
+				IORING_SQPOLL_QUANTUM_NS);
+	start = local_clock();
+	while (ctx->sq_deficit > 0) {
+		ret = __io_sq_thread(ctx, true);
+		now = local_clock();
+		ctx->sq_deficit -= now - start;
+		WRITE_ONCE(ctx->sq_work_time, ctx->sq_work_time + now - start);
+		start = now;
+		if (ret <= 0)
+			break;
+		submitted += ret;
+		if (!io_sqring_entries(ctx))
+			break;
+	}
+
+	return submitted ?: ret;
+}
+
+static int io_sq_thread_single(struct io_ring_ctx *ctx)
+{
+	u64 start = local_clock();
+	int ret;
+
+	ret = __io_sq_thread(ctx, false);
+	WRITE_ONCE(ctx->sq_work_time,
+		   ctx->sq_work_time + local_clock() - start);
+	return ret;
+}
+
+static void io_sqd_update_submit_gap(struct io_sq_data *sqd)
+{
+	u64 now = local_clock();
+
+	if (sqd->last_submit) {
+		u64 gap = now - sqd->last_submit;
+
+		if (sqd->submit_gap)
+			sqd->submit_gap += (gap >> 3) - (sqd->submit_gap >> 3);
+		else
+			sqd->submit_gap = gap;
+	}
+	sqd->last_submit = now;
+}
+
+/*
+ * How long to keep spinning without work. Spinning pays off up to a few
+ * times the average gap between submissions, bounded by the idle time the
+ * rings asked for. If submissions are further apart than that, the thread
+ * would go to sleep in between anyway and spinning only burns CPU.
+ */
+static unsigned long io_sqd_thread_idle(struct io_sq_data *sqd)
+{
+	u64 gap = sqd->submit_gap;
+
+	if (!gap)
+		return sqd->sq_thread_idle;
+	if (gap > jiffies_to_nsecs(sqd->sq_thread_idle))
+		return 1;
+	return min_t(unsigned long, nsecs_to_jiffies(4 * gap) + 1,
+		     sqd->sq_thread_idle);
+}
+
 static bool io_sqd_handle_event(struct io_sq_data *sqd)
 {
 	bool did_sig = false;
@@ -236,27 +319,36 @@ static int io_sq_thread(void *data)
 
 	mutex_lock(&sqd->lock);
 	while (1) {
-		bool cap_entries, sqt_spin = false;
+		bool cap_entries, submitted, sqt_spin = false;
 
 		if (io_sqd_events_pending(sqd) || signal_pending(current)) {
 			if (io_sqd_handle_event(sqd))
 				break;
-			timeout = jiffies + sqd->sq_thread_idle;
+			timeout = jiffies + io_sqd_thread_idle(sqd);
 		}
 
 		cap_entries = !list_is_singular(&sqd->ctx_list);
+		submitted = false;
 		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
-			int ret = __io_sq_thread(ctx, cap_entries);
-
+			int ret;
+
+			if (cap_entries)
+				ret = io_sq_thread_drr(ctx);
+			else
+				ret = io_sq_thread_single(ctx);
+			if (ret > 0)
+				submitted = true;
 			if (!sqt_spin && (ret > 0 || !wq_list_empty(&ctx->iopoll_list)))
 				sqt_spin = true;
 		}
+		if (submitted)
+			io_sqd_update_submit_gap(sqd);
 		if (io_run_task_work())
 			sqt_spin = true;
 
 		if (sqt_spin || !time_after(jiffies, timeout)) {
 			if (sqt_spin)
-				timeout = jiffies + sqd->sq_thread_idle;
+				timeout = jiffies + io_sqd_thread_idle(sqd);
 			if (unlikely(need_resched())) {
 				mutex_unlock(&sqd->lock);
 				cond_resched();
@@ -301,7 +393,7 @@ static int io_sq_thread(void *data)
 		}
 
 		finish_wait(&sqd->wait, &wait);
-		timeout = jiffies + sqd->sq_thread_idle;
+		timeout = jiffies + io_sqd_thread_idle(sqd);
 	}
 
 	io_uring_cancel_generic(true, sqd);
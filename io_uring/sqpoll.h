@@ -12,6 +12,9 @@ struct io_sq_data {
 	struct wait_queue_head	wait;
 
 	unsigned		sq_thread_idle;
+	/* average time between submissions in nsecs, for adaptive idle */
+	u64			submit_gap;
+	u64			last_submit;
 	int			sq_cpu;
 	pid_t			task_pid;
 	pid_t			task_tgid;
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/io_uring.h>
+
+#include "io_uring.h"
+#include "stats.h"
+
+static const char * const io_stats_path_names[IO_STATS_NR_PATHS] = {
+	[IO_STATS_INLINE]	= "inline",
+	[IO_STATS_POLL]		= "poll",
+	[IO_STATS_IOWQ]		= "iowq",
+};
+
+void __io_stats_complete(struct io_ring_stats *stats, struct io_kiocb *req)
+{
+	u64 ns = ktime_get_ns() - req->start_time;
+	unsigned int path = IO_STATS_INLINE;
+	struct io_op_stats *s;
+	unsigned long us;
+
+	/* the punt wins over poll, a request may have polled before it */
+	if (req->flags & REQ_F_IOWQ)
+		path = IO_STATS_IOWQ;
+	else if (req->flags & REQ_F_POLLED)
+		path = IO_STATS_POLL;
+
+	s = &stats->ops[req->opcode][path];
+	s->nr++;
+	s->total_ns += ns;
+	us = ns / NSEC_PER_USEC;
+	s->hist[us ? min(ilog2(us), IO_STATS_BUCKETS - 1) : 0]++;
+}
+
+int io_register_stats(struct io_ring_ctx *ctx)
+{
+	struct io_ring_stats *stats;
+
+	if (ctx->stats)
+		return -EBUSY;
+
+	stats = kvzalloc(sizeof(*stats), GFP_KERNEL_ACCOUNT);
+	if (!stats)
+		return -ENOMEM;
+
+	/* uring_lock keeps new requests out, CQ posting needs the lock below */
+	spin_lock(&ctx->completion_lock);
+	WRITE_ONCE(ctx->stats, stats);
+	spin_unlock(&ctx->completion_lock);
+	return 0;
+}
+
+int io_unregister_stats(struct io_ring_ctx *ctx)
+{
+	struct io_ring_stats *stats = ctx->stats;
+
+	if (!stats)
+		return -ENXIO;
+
+	spin_lock(&ctx->completion_lock);
+	WRITE_ONCE(ctx->stats, NULL);
+	spin_unlock(&ctx->completion_lock);
+	/* task_work accounting only holds the RCU read lock */
+	kvfree_rcu(stats, rcu);
+	return 0;
+}
+
+void io_stats_free(struct io_ring_ctx *ctx)
+{
+	kvfree(ctx->stats);
+	ctx->stats = NULL;
+}
+
+/*
+ * Must be called with ->uring_lock held, which keeps the stats from being
+ * unregistered. Counters may be updated under us, the output is a snapshot.
+ */
+void io_stats_show(struct seq_file *m, struct io_ring_ctx *ctx)
+{
+	struct io_ring_stats *stats = ctx->stats;
+	unsigned int op, path, i;
+
+	if (!stats)
+		return;
+
+	seq_printf(m, "TaskWorkRuns:\t%ld\n", atomic_long_read(&stats->tw_runs));
+	seq_puts(m, "OpStats:\n");
+	for (op = 0; op < IORING_OP_LAST; op++) {
+		for (path = 0; path < IO_STATS_NR_PATHS; path++) {
+			struct io_op_stats *s = &stats->ops[op][path];
+			u64 nr = READ_ONCE(s->nr);
+
+			if (!nr)
+				continue;
+			seq_printf(m, "  %s/%s: nr=%llu avg_us=%llu hist_log2_us=",
+				   io_uring_get_opcode(op),
+				   io_stats_path_names[path], nr,
+				   div64_u64(READ_ONCE(s->total_ns), nr) /
+				   NSEC_PER_USEC);
+			for (i = 0; i < IO_STATS_BUCKETS; i++) {
+				u32 cnt = READ_ONCE(s->hist[i]);
+
+				if (cnt)
+					seq_printf(m, " %u:%u", i, cnt);
+			}
+			seq_putc(m, '\n');
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+#ifndef IOU_STATS_H
+#define IOU_STATS_H
+
+#include <linux/io_uring_types.h>
+#include <linux/seq_file.h>
+
+/* log2 usec buckets, the last one also takes everything above 2^23 usecs */
+#define IO_STATS_BUCKETS	24
+
+enum {
+	IO_STATS_INLINE,
+	IO_STATS_POLL,
+	IO_STATS_IOWQ,
+
+	IO_STATS_NR_PATHS,
+};
+
+struct io_op_stats {
+	u64		nr;
+	u64		total_ns;
+	u32		hist[IO_STATS_BUCKETS];
+};
+
+/*
+ * Updated when the CQE of a request is filled, which serialises on
+ * ->completion_lock or, for ->lockless_cq, on the submitter task.
+ */
+struct io_ring_stats {
+	struct io_op_stats	ops[IORING_OP_LAST][IO_STATS_NR_PATHS];
+	/* task_work items run for the ring */
+	atomic_long_t		tw_runs;
+	struct rcu_head		rcu;
+};
+
+int io_register_stats(struct io_ring_ctx *ctx);
+int io_unregister_stats(struct io_ring_ctx *ctx);
+void io_stats_free(struct io_ring_ctx *ctx);
+void io_stats_show(struct seq_file *m, struct io_ring_ctx *ctx);
+void __io_stats_complete(struct io_ring_stats *stats, struct io_kiocb *req);
+
+static inline void io_stats_init_req(struct io_ring_ctx *ctx,
+				     struct io_kiocb *req)
+{
+	req->start_time = unlikely(ctx->stats) ? ktime_get_ns() : 0;
+}
+
+static inline void io_stats_complete(struct io_ring_ctx *ctx,
+				     struct io_kiocb *req)
+{
+	struct io_ring_stats *stats = ctx->stats;
+
+	if (unlikely(stats) && req->start_time)
+		__io_stats_complete(stats, req);
+}
+
+static inline void io_stats_tw_run(struct io_ring_ctx *ctx, unsigned int nr)
+{
+	struct io_ring_stats *stats;
+
+	rcu_read_lock();
+	stats = READ_ONCE(ctx->stats);
+	if (unlikely(stats))
+		atomic_long_add(nr, &stats->tw_runs);
+	rcu_read_unlock();
+}
+
+#endif
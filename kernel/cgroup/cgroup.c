@@ -5377,8 +5377,9 @@ static void css_free_rwork_fn(struct work_struct *work)
 			 */
 			cgroup_put(cgroup_parent(cgrp));
 			kernfs_put(cgrp->kn);
-			psi_cgroup_free(cgrp);
+			/* The final rstat flush folds the pressure into the parent */
 			cgroup_rstat_exit(cgrp);
+			psi_cgroup_free(cgrp);
 			kfree(cgrp);
 		} else {
 			/*
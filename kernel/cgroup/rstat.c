@@ -2,6 +2,7 @@
 #include "cgroup-internal.h"
 
 #include <linux/sched/cputime.h>
+#include <linux/psi.h>
 
 #include <linux/bpf.h>
 #include <linux/btf.h>
@@ -197,6 +198,7 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp)
 			struct cgroup_subsys_state *css;
 
 			cgroup_base_stat_flush(pos, cpu);
+			psi_rstat_flush(pos, cpu);
 			bpf_rstat_flush(pos, cgroup_parent(pos), cpu);
 
 			rcu_read_lock();
@@ -37,6 +37,8 @@
 #include <linux/memblock.h>
 #include <linux/fault-inject.h>
 #include <linux/slab.h>
+#include <linux/prctl.h>
+#include <linux/sched/mm.h>
 
 #include "futex.h"
 #include "../locking/rtmutex_common.h"
@@ -105,17 +107,137 @@ late_initcall(fail_futex_debugfs);
 
 #endif /* CONFIG_FAIL_FUTEX */
 
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+
+/* Bounds for the number of slots of a private hash */
+#define FUTEX_PRIVATE_HASH_MIN	16
+#define FUTEX_PRIVATE_HASH_MAX	(1U << 16)
+
+static struct futex_private_hash *futex_private_hash(union futex_key *key)
+{
+	/* Shared keys may be used by other processes */
+	if (key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))
+		return NULL;
+
+	/* Pairs with the cmpxchg_release() in futex_hash_allocate() */
+	return smp_load_acquire(&key->private.mm->futex_phash);
+}
+
+static int futex_hash_allocate(unsigned int slots)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph;
+	unsigned int i;
+
+	if (!slots)
+		slots = 4 * num_online_cpus();
+	else if (!is_power_of_2(slots))
+		return -EINVAL;
+	slots = clamp_t(unsigned int, roundup_pow_of_two(slots),
+			FUTEX_PRIVATE_HASH_MIN, FUTEX_PRIVATE_HASH_MAX);
+
+	/*
+	 * Private futexes hash into the global table until the private hash
+	 * is installed. A waiter queued there would never be found by a waker
+	 * using the private hash, so only allow the switch as long as nobody
+	 * else is using the mm.
+	 */
+	if (!mm || atomic_read(&mm->mm_users) != 1)
+		return -EBUSY;
+	if (READ_ONCE(mm->futex_phash))
+		return -EBUSY;
+
+	/* Allocate the buckets on the node of the caller */
+	fph = kvzalloc_node(struct_size(fph, queues, slots),
+			    GFP_KERNEL_ACCOUNT, numa_node_id());
+	if (!fph)
+		return -ENOMEM;
+
+	fph->hash_mask = slots - 1;
+	for (i = 0; i < slots; i++) {
+		atomic_set(&fph->queues[i].waiters, 0);
+		plist_head_init(&fph->queues[i].chain);
+		spin_lock_init(&fph->queues[i].lock);
+	}
+
+	if (cmpxchg_release(&mm->futex_phash, NULL, fph)) {
+		kvfree(fph);
+		return -EBUSY;
+	}
+	return 0;
+}
+
+static int futex_hash_get_slots(void)
+{
+	struct futex_private_hash *fph = READ_ONCE(current->mm->futex_phash);
+
+	return fph ? fph->hash_mask + 1 : 0;
+}
+
 /**
- * futex_hash - Return the hash bucket in the global hash
+ * futex_hash_prctl - Handle PR_FUTEX_HASH
+ * @arg2:	PR_FUTEX_HASH_SET_SLOTS or PR_FUTEX_HASH_GET_SLOTS
+ * @arg3:	Number of slots for PR_FUTEX_HASH_SET_SLOTS, a power of two or
+ *		0 for a size derived from the number of CPUs
+ * @arg4:	Unused, must be 0
+ * @arg5:	Unused, must be 0
+ *
+ * Gives the calling process a hash of its own for its private futexes, so
+ * they do not share hash buckets with unrelated processes.
+ *
+ * Return: 0 or the number of slots on success, -EBUSY if the process already
+ * has a private hash or is multi threaded already, -EINVAL or -ENOMEM.
+ */
+int futex_hash_prctl(unsigned long arg2, unsigned long arg3,
+		     unsigned long arg4, unsigned long arg5)
+{
+	if (arg4 || arg5)
+		return -EINVAL;
+
+	switch (arg2) {
+	case PR_FUTEX_HASH_SET_SLOTS:
+		if (arg3 > FUTEX_PRIVATE_HASH_MAX)
+			return -EINVAL;
+		return futex_hash_allocate(arg3);
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (arg3)
+			return -EINVAL;
+		return futex_hash_get_slots();
+	default:
+		return -EINVAL;
+	}
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_phash);
+}
+
+#else
+
+static inline struct futex_private_hash *futex_private_hash(union futex_key *key)
+{
+	return NULL;
+}
+
+#endif /* CONFIG_FUTEX_PRIVATE_HASH */
+
+/**
+ * futex_hash - Return the hash bucket in the private or the global hash
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the private hash of the process, if it has
+ * one and the key is private, or in the global hash.
  */
 struct futex_hash_bucket *futex_hash(union futex_key *key)
 {
 	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
 			  key->both.offset);
+	struct futex_private_hash *fph = futex_private_hash(key);
+
+	if (fph)
+		return &fph->queues[hash & fph->hash_mask];
 
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
@@ -14,6 +14,7 @@
 #include <linux/file.h>
 #include <linux/slab.h>
 #include <linux/kexec.h>
+#include <linux/kexec_preserve.h>
 #include <linux/memblock.h>
 #include <linux/mutex.h>
 #include <linux/list.h>
@@ -439,9 +440,10 @@ static int locate_mem_hole_top_down(unsigned long start, unsigned long end,
 
 		/*
 		 * Make sure this does not conflict with any of existing
-		 * segments
+		 * segments, nor with memory handed over to the new kernel
 		 */
-		if (kimage_is_destination_range(image, temp_start, temp_end)) {
+		if (kimage_is_destination_range(image, temp_start, temp_end) ||
+		    kexec_preserved_overlaps(temp_start, temp_end)) {
 			temp_start = temp_start - PAGE_SIZE;
 			continue;
 		}
@@ -473,9 +475,10 @@ static int locate_mem_hole_bottom_up(unsigned long start, unsigned long end,
 			return 0;
 		/*
 		 * Make sure this does not conflict with any of existing
-		 * segments
+		 * segments, nor with memory handed over to the new kernel
 		 */
-		if (kimage_is_destination_range(image, temp_start, temp_end)) {
+		if (kimage_is_destination_range(image, temp_start, temp_end) ||
+		    kexec_preserved_overlaps(temp_start, temp_end)) {
 			temp_start = temp_start + PAGE_SIZE;
 			continue;
 		}
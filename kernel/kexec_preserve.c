@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * kexec_preserve.c - Hand memory regions over to the next kernel
+ *
+ * Subsystems register named physical regions, or copy small blobs of
+ * state, to be kept across kexec. The table of the registered regions is
+ * loaded with the next kernel as a kexec segment. The new kernel reserves
+ * the table and the regions from memblock before it allocates memory, and
+ * the subsystems look their regions up by name to restore their state.
+ */
+
+#define pr_fmt(fmt)	"kexec_preserve: " fmt
+
+#include <linux/early_ioremap.h>
+#include <linux/kexec_preserve.h>
+#include <linux/list.h>
+#include <linux/memblock.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/of_fdt.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+struct kexec_preserved {
+	struct list_head list;
+	char name[KEXEC_PRESERVE_NAME_LEN];
+	phys_addr_t base;
+	phys_addr_t size;
+	/* Copy of the data made by kexec_preserve_blob() */
+	void *blob;
+};
+
+/* Regions to hand over to the next kernel */
+static LIST_HEAD(kexec_preserved_list);
+
+/* Table handed over by the previous kernel */
+static phys_addr_t kexec_preserved_table_phys;
+
+static DEFINE_MUTEX(kexec_preserve_mutex);
+
+static struct kexec_preserved *kexec_preserved_find(const char *name)
+{
+	struct kexec_preserved *p;
+
+	list_for_each_entry(p, &kexec_preserved_list, list)
+		if (!strcmp(p->name, name))
+			return p;
+
+	return NULL;
+}
+
+static int __kexec_preserve(const char *name, phys_addr_t base,
+			    phys_addr_t size, void *blob)
+{
+	struct kexec_preserved *p;
+	int ret = 0;
+
+	if (!size || !PAGE_ALIGNED(base))
+		return -EINVAL;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+
+	if (strscpy(p->name, name, sizeof(p->name)) < 0) {
+		kfree(p);
+		return -ENAMETOOLONG;
+	}
+	p->base = base;
+	p->size = size;
+	p->blob = blob;
+
+	mutex_lock(&kexec_preserve_mutex);
+	if (kexec_preserved_find(name))
+		ret = -EEXIST;
+	else
+		list_add_tail(&p->list, &kexec_preserved_list);
+	mutex_unlock(&kexec_preserve_mutex);
+
+	if (ret)
+		kfree(p);
+	return ret;
+}
+
+/**
+ * kexec_preserve_region - Hand a memory region over to the next kernel
+ * @name:	Name the next kernel looks the region up with
+ * @base:	Page aligned physical address of the region
+ * @size:	Size of the region in bytes
+ *
+ * The region is reserved by the next kernel loaded with kexec_file_load()
+ * after this call. The caller keeps the region allocated and must not let
+ * it be reused until the kexec.
+ *
+ * Return: 0 on success, -EEXIST if @name is taken, -EINVAL or
+ * -ENAMETOOLONG for invalid arguments.
+ */
+int kexec_preserve_region(const char *name, phys_addr_t base,
+			  phys_addr_t size)
+{
+	return __kexec_preserve(name, base, size, NULL);
+}
+EXPORT_SYMBOL_GPL(kexec_preserve_region);
+
+/**
+ * kexec_preserve_blob - Hand a copy of some data over to the next kernel
+ * @name:	Name the next kernel looks the data up with
+ * @data:	Data to copy
+ * @len:	Length of @data
+ *
+ * Return: 0 on success or a negative error code.
+ */
+int kexec_preserve_blob(const char *name, const void *data, size_t len)
+{
+	void *blob;
+	int ret;
+
+	if (!len)
+		return -EINVAL;
+
+	blob = alloc_pages_exact(len, GFP_KERNEL);
+	if (!blob)
+		return -ENOMEM;
+	memcpy(blob, data, len);
+
+	ret = __kexec_preserve(name, virt_to_phys(blob), len, blob);
+	if (ret)
+		free_pages_exact(blob, len);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(kexec_preserve_blob);
+
+/**
+ * kexec_unpreserve - Stop handing a region or blob over to the next kernel
+ * @name:	Name the region or blob was registered with
+ */
+void kexec_unpreserve(const char *name)
+{
+	struct kexec_preserved *p;
+
+	mutex_lock(&kexec_preserve_mutex);
+	p = kexec_preserved_find(name);
+	if (p)
+		list_del(&p->list);
+	mutex_unlock(&kexec_preserve_mutex);
+
+	if (!p)
+		return;
+
+	if (p->blob)
+		free_pages_exact(p->blob, p->size);
+	kfree(p);
+}
+EXPORT_SYMBOL_GPL(kexec_unpreserve);
+
+/*
+ * Check whether [@start, @end] overlaps a preserved region, so that no
+ * kexec segment gets placed there.
+ */
+bool kexec_preserved_overlaps(phys_addr_t start, phys_addr_t end)
+{
+	struct kexec_preserved *p;
+	bool ret = false;
+
+	mutex_lock(&kexec_preserve_mutex);
+	list_for_each_entry(p, &kexec_preserved_list, list) {
+		if (start < p->base + PAGE_ALIGN(p->size) && end >= p->base) {
+			ret = true;
+			break;
+		}
+	}
+	mutex_unlock(&kexec_preserve_mutex);
+
+	return ret;
+}
+
+/*
+ * Build the table to load with the next kernel. Returns NULL if nothing is
+ * preserved. The caller frees the table with kvfree().
+ */
+void *kexec_preserve_build_table(unsigned long *size)
+{
+	struct kexec_preserve_table *table = NULL;
+	struct kexec_preserved *p;
+	u32 nr = 0;
+
+	mutex_lock(&kexec_preserve_mutex);
+	list_for_each_entry(p, &kexec_preserved_list, list)
+		nr++;
+	if (!nr)
+		goto out;
+
+	*size = struct_size(table, entries, nr);
+	table = kvzalloc(*size, GFP_KERNEL);
+	if (!table)
+		goto out;
+
+	table->magic = KEXEC_PRESERVE_MAGIC;
+	table->version = KEXEC_PRESERVE_VERSION;
+	list_for_each_entry(p, &kexec_preserved_list, list) {
+		struct kexec_preserve_entry *e = &table->entries[table->nr_entries++];
+
+		memcpy(e->name, p->name, sizeof(e->name));
+		e->base = p->base;
+		e->size = p->size;
+	}
+out:
+	mutex_unlock(&kexec_preserve_mutex);
+	return table;
+}
+
+/**
+ * kexec_preserved_scan_fdt - Reserve the regions handed over by the
+ *			      previous kernel
+ *
+ * Called by the architecture code once memblock knows about the memory,
+ * before the first memblock allocation.
+ */
+void __init kexec_preserved_scan_fdt(void)
+{
+	struct kexec_preserve_table *table;
+	struct kexec_preserve_entry *e;
+	phys_addr_t phys, size;
+	const __be32 *prop;
+	int node, len;
+	u32 i;
+
+	node = of_get_flat_dt_subnode_by_name(of_get_flat_dt_root(), "chosen");
+	if (node < 0)
+		return;
+
+	prop = of_get_flat_dt_prop(node, KEXEC_PRESERVE_FDT_PROP, &len);
+	if (!prop || len != 4 * sizeof(__be32))
+		return;
+
+	phys = of_read_number(prop, 2);
+	size = of_read_number(prop + 2, 2);
+	if (size < sizeof(*table))
+		return;
+
+	table = early_memremap(phys, size);
+	if (!table)
+		return;
+
+	if (table->magic != KEXEC_PRESERVE_MAGIC ||
+	    table->version != KEXEC_PRESERVE_VERSION ||
+	    struct_size(table, entries, table->nr_entries) > size) {
+		pr_warn("ignoring invalid table at %pa\n", &phys);
+		goto out;
+	}
+
+	memblock_reserve(phys, size);
+
+	for (i = 0; i < table->nr_entries; i++) {
+		phys_addr_t base, end;
+
+		e = &table->entries[i];
+		base = e->base;
+		end = base + PAGE_ALIGN(e->size);
+
+		if (!PAGE_ALIGNED(base) || end <= base ||
+		    !memblock_is_region_memory(base, end - base) ||
+		    memblock_is_region_reserved(base, end - base)) {
+			pr_warn("%.*s: region %pa-%pa not available, dropped\n",
+				KEXEC_PRESERVE_NAME_LEN, e->name, &base, &end);
+			e->size = 0;
+			continue;
+		}
+
+		memblock_reserve(base, end - base);
+		pr_info("%.*s: reserved %pa-%pa\n", KEXEC_PRESERVE_NAME_LEN,
+			e->name, &base, &end);
+	}
+
+	kexec_preserved_table_phys = phys;
+out:
+	early_memunmap(table, size);
+}
+
+static struct kexec_preserve_entry *kexec_preserved_lookup_entry(const char *name)
+{
+	struct kexec_preserve_table *table;
+	u32 i;
+
+	if (!kexec_preserved_table_phys)
+		return NULL;
+
+	table = phys_to_virt(kexec_preserved_table_phys);
+	for (i = 0; i < table->nr_entries; i++) {
+		struct kexec_preserve_entry *e = &table->entries[i];
+
+		if (e->size && !strncmp(e->name, name, sizeof(e->name)))
+			return e;
+	}
+
+	return NULL;
+}
+
+/**
+ * kexec_preserved_lookup - Find a region handed over by the previous kernel
+ * @name:	Name of the region
+ * @base:	Physical address of the region
+ * @size:	Size of the region in bytes
+ *
+ * The region stays reserved until it is released with
+ * kexec_preserved_release(). A blob is accessed through phys_to_virt().
+ *
+ * Return: 0 if the region was found, -ENOENT otherwise.
+ */
+int kexec_preserved_lookup(const char *name, phys_addr_t *base,
+			   phys_addr_t *size)
+{
+	struct kexec_preserve_entry *e;
+	int ret = -ENOENT;
+
+	mutex_lock(&kexec_preserve_mutex);
+	e = kexec_preserved_lookup_entry(name);
+	if (e) {
+		*base = e->base;
+		*size = e->size;
+		ret = 0;
+	}
+	mutex_unlock(&kexec_preserve_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(kexec_preserved_lookup);
+
+/**
+ * kexec_preserved_release - Give a handed over region to the page allocator
+ * @name:	Name of the region
+ *
+ * Only for regions whose content is not needed anymore. A subsystem keeping
+ * the memory simply never releases it.
+ */
+void kexec_preserved_release(const char *name)
+{
+	struct kexec_preserve_entry *e;
+	phys_addr_t base, size = 0;
+
+	mutex_lock(&kexec_preserve_mutex);
+	e = kexec_preserved_lookup_entry(name);
+	if (e) {
+		base = e->base;
+		size = PAGE_ALIGN(e->size);
+		e->size = 0;
+	}
+	mutex_unlock(&kexec_preserve_mutex);
+
+	if (size)
+		free_reserved_area(phys_to_virt(base), phys_to_virt(base + size),
+				   -1, NULL);
+}
+EXPORT_SYMBOL_GPL(kexec_preserved_release);
+
+/* Regions nobody claimed stay reserved, at least make them visible */
+static int __init kexec_preserved_report(void)
+{
+	struct kexec_preserve_table *table;
+	u32 i;
+
+	if (!kexec_preserved_table_phys)
+		return 0;
+
+	mutex_lock(&kexec_preserve_mutex);
+	table = phys_to_virt(kexec_preserved_table_phys);
+	for (i = 0; i < table->nr_entries; i++) {
+		struct kexec_preserve_entry *e = &table->entries[i];
+
+		if (e->size)
+			pr_info("%.*s: %llu bytes still reserved\n",
+				KEXEC_PRESERVE_NAME_LEN, e->name, e->size);
+	}
+	mutex_unlock(&kexec_preserve_mutex);
+
+	return 0;
+}
+late_initcall_sync(kexec_preserved_report);
@@ -92,6 +92,25 @@ bool mutex_is_locked(struct mutex *lock)
 }
 EXPORT_SYMBOL(mutex_is_locked);
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+/*
+ * Used by the scheduler to find the task to run on behalf of a waiter. The
+ * result is only a snapshot; the caller must cope with the lock changing
+ * hands under it.
+ */
+struct task_struct *mutex_owner_task(struct mutex *lock)
+{
+	return __mutex_owner(lock);
+}
+
+static inline void set_task_blocked_mutex(struct task_struct *p, struct mutex *lock)
+{
+	WRITE_ONCE(p->blocked_mutex, lock);
+}
+#else
+static inline void set_task_blocked_mutex(struct task_struct *p, struct mutex *lock) { }
+#endif
+
 static inline unsigned long __owner_flags(unsigned long owner)
 {
 	return owner & MUTEX_FLAGS;
@@ -645,6 +664,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 			goto err_early_kill;
 	}
 
+	set_task_blocked_mutex(current, lock);
 	set_current_state(state);
 	trace_contention_begin(lock, LCB_F_MUTEX);
 	for (;;) {
@@ -700,6 +720,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	}
 	raw_spin_lock(&lock->wait_lock);
 acquired:
+	set_task_blocked_mutex(current, NULL);
 	__set_current_state(TASK_RUNNING);
 
 	if (ww_ctx) {
@@ -729,6 +750,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	return 0;
 
 err:
+	set_task_blocked_mutex(current, NULL);
 	__set_current_state(TASK_RUNNING);
 	__mutex_remove_waiter(lock, &waiter);
 err_early_kill:
@@ -104,4 +104,29 @@ struct printk_message {
 	unsigned long		dropped;
 };
 
+struct console;
+
+bool panic_in_progress(void);
 bool other_cpu_in_panic(void);
+bool this_cpu_in_panic(void);
+bool console_is_usable(struct console *con);
+bool printk_get_next_message(struct printk_message *pmsg, u64 seq,
+			     bool is_extended, bool may_supress);
+
+#ifdef CONFIG_PRINTK
+extern struct printk_ringbuffer *prb;
+
+void console_prepend_dropped(struct printk_message *pmsg, unsigned long dropped);
+
+bool nbcon_atomic_emit_next_record(struct console *con);
+bool nbcon_kthread_printing(struct console *con);
+void nbcon_wake_threads(void);
+int nbcon_init(struct console *con);
+void nbcon_free(struct console *con);
+#else
+static inline bool nbcon_atomic_emit_next_record(struct console *con) { return false; }
+static inline bool nbcon_kthread_printing(struct console *con) { return false; }
+static inline void nbcon_wake_threads(void) { }
+static inline int nbcon_init(struct console *con) { return 0; }
+static inline void nbcon_free(struct console *con) { }
+#endif
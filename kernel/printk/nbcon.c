@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * nbcon.c - Non-blocking consoles
+ *
+ * Consoles flagged CON_NBCON are not printed from the context calling
+ * printk(). Each of them gets a printer thread which emits the records
+ * through the ->write_thread() callback. That callback runs in task context
+ * and may sleep, so drivers can wait for their hardware with interrupts
+ * enabled. printk() callers only queue an irq_work to wake the thread and
+ * never wait on the device.
+ *
+ * The ->write_atomic() callback is used instead of the thread on the panic
+ * CPU, when the system is going down and while no printer thread is
+ * available yet, e.g. during early boot.
+ *
+ * The thread and the atomic printing contexts serialize on @nbcon_owner
+ * of the console. Whoever owns the console is the only one printing to it
+ * and advancing its @seq. The panic CPU takes the ownership over after a
+ * while if the owner does not release it, as the owner may have been
+ * stopped in the middle of a write.
+ */
+
+#include <linux/console.h>
+#include <linux/delay.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include "printk_ringbuffer.h"
+#include "internal.h"
+
+enum nbcon_owner {
+	NBCON_OWNER_NONE,
+	NBCON_OWNER_THREAD,
+	NBCON_OWNER_ATOMIC,
+};
+
+/* How long the panic CPU waits for the current owner to finish, in us */
+#define NBCON_PANIC_TAKEOVER_US		(1 * USEC_PER_SEC)
+
+/* Set once printer threads can be created */
+static bool printk_kthreads_ready;
+
+/* Only used for atomic printing, which is serialized by the console_lock or panic */
+static struct printk_buffers nbcon_atomic_pbufs;
+
+static bool nbcon_acquire(struct console *con, enum nbcon_owner owner)
+{
+	unsigned int waited = 0;
+
+	for (;;) {
+		if (atomic_cmpxchg_acquire(&con->nbcon_owner, NBCON_OWNER_NONE,
+					   owner) == NBCON_OWNER_NONE)
+			return true;
+
+		if (owner != NBCON_OWNER_ATOMIC || !this_cpu_in_panic())
+			return false;
+
+		/* The owner may be stopped for good, take the console over */
+		if (waited++ >= NBCON_PANIC_TAKEOVER_US) {
+			atomic_set(&con->nbcon_owner, owner);
+			return true;
+		}
+		udelay(1);
+	}
+}
+
+/* Returns false if the ownership was taken over in the meantime */
+static bool nbcon_release(struct console *con, enum nbcon_owner owner)
+{
+	return atomic_cmpxchg_release(&con->nbcon_owner, owner,
+				      NBCON_OWNER_NONE) == owner;
+}
+
+/*
+ * Print the next record of @con with the ownership @owner held. Returns
+ * false if there is no record to print.
+ */
+static bool nbcon_emit_next_record(struct console *con, struct printk_buffers *pbufs,
+				   enum nbcon_owner owner)
+{
+	bool is_extended = console_srcu_read_flags(con) & CON_EXTENDED;
+	struct printk_message pmsg = {
+		.pbufs = pbufs,
+	};
+	unsigned long flags;
+
+	if (!printk_get_next_message(&pmsg, con->seq, is_extended, true))
+		return false;
+
+	con->dropped += pmsg.dropped;
+
+	/* Skip messages of formatted length 0. */
+	if (pmsg.outbuf_len == 0)
+		goto update_seq;
+
+	if (con->dropped && !is_extended) {
+		console_prepend_dropped(&pmsg, con->dropped);
+		con->dropped = 0;
+	}
+
+	if (owner == NBCON_OWNER_THREAD) {
+		con->write_thread(con, &pbufs->outbuf[0], pmsg.outbuf_len);
+	} else {
+		printk_safe_enter_irqsave(flags);
+		stop_critical_timings();
+		con->write_atomic(con, &pbufs->outbuf[0], pmsg.outbuf_len);
+		start_critical_timings();
+		printk_safe_exit_irqrestore(flags);
+	}
+
+update_seq:
+	/* A taken over console is printed by somebody else now */
+	if (atomic_read(&con->nbcon_owner) == owner)
+		WRITE_ONCE(con->seq, pmsg.seq + 1);
+	return true;
+}
+
+/**
+ * nbcon_atomic_emit_next_record - Print the next record from printk() context
+ * @con:	The nbcon console to print on
+ *
+ * Used on the panic CPU, on shutdown and while @con has no printer thread.
+ *
+ * Return: True if a record was printed. False if there was nothing to print
+ * or the printer thread owns the console, in which case it will print the
+ * record itself.
+ *
+ * Context: Under the console_lock or on the panic CPU, with the SRCU read
+ *	    lock held.
+ */
+bool nbcon_atomic_emit_next_record(struct console *con)
+{
+	bool progress;
+
+	if (!nbcon_acquire(con, NBCON_OWNER_ATOMIC))
+		return false;
+
+	progress = nbcon_emit_next_record(con, &nbcon_atomic_pbufs,
+					  NBCON_OWNER_ATOMIC);
+
+	return nbcon_release(con, NBCON_OWNER_ATOMIC) && progress;
+}
+
+/**
+ * nbcon_kthread_printing - Check whether the thread is in charge of @con
+ * @con:	The nbcon console
+ *
+ * Return: True if the printer thread of @con prints its records, false if
+ * they have to be printed atomically from the printk() context.
+ *
+ * Context: Any context, with the SRCU read lock held.
+ */
+bool nbcon_kthread_printing(struct console *con)
+{
+	if (!READ_ONCE(con->kthread))
+		return false;
+
+	return !panic_in_progress() && system_state <= SYSTEM_RUNNING;
+}
+
+static bool nbcon_kthread_should_wakeup(struct console *con)
+{
+	bool ret;
+	int cookie;
+
+	if (kthread_should_stop())
+		return true;
+
+	cookie = console_srcu_read_lock();
+	ret = console_is_usable(con) && nbcon_kthread_printing(con) &&
+	      prb_read_valid(prb, READ_ONCE(con->seq), NULL);
+	console_srcu_read_unlock(cookie);
+
+	return ret;
+}
+
+static int nbcon_kthread_func(void *__console)
+{
+	struct console *con = __console;
+	bool progress;
+	int cookie;
+
+	for (;;) {
+		wait_event_interruptible(con->kthread_wait,
+					 nbcon_kthread_should_wakeup(con));
+
+		if (kthread_should_stop())
+			break;
+
+		do {
+			progress = false;
+
+			cookie = console_srcu_read_lock();
+			if (console_is_usable(con) && nbcon_kthread_printing(con) &&
+			    nbcon_acquire(con, NBCON_OWNER_THREAD)) {
+				progress = nbcon_emit_next_record(con, con->pbufs,
+								  NBCON_OWNER_THREAD);
+				if (!nbcon_release(con, NBCON_OWNER_THREAD))
+					progress = false;
+			}
+			console_srcu_read_unlock(cookie);
+
+			cond_resched();
+		} while (progress && !kthread_should_stop());
+	}
+
+	return 0;
+}
+
+static void nbcon_irq_work(struct irq_work *irq_work)
+{
+	struct console *con = container_of(irq_work, struct console, irq_work);
+
+	wake_up_interruptible(&con->kthread_wait);
+}
+
+/**
+ * nbcon_wake_threads - Wake the printer threads for new records
+ *
+ * Context: Any context, including NMI.
+ */
+void nbcon_wake_threads(void)
+{
+	struct console *con;
+	int cookie;
+
+	cookie = console_srcu_read_lock();
+	for_each_console_srcu(con) {
+		if (!(console_srcu_read_flags(con) & CON_NBCON))
+			continue;
+		if (READ_ONCE(con->kthread))
+			irq_work_queue(&con->irq_work);
+	}
+	console_srcu_read_unlock(cookie);
+}
+
+static void nbcon_kthread_create(struct console *con)
+{
+	struct task_struct *kt;
+
+	lockdep_assert_console_list_lock_held();
+
+	if (con->kthread || !printk_kthreads_ready || !con->write_thread)
+		return;
+
+	kt = kthread_run(nbcon_kthread_func, con, "pr/%s%d", con->name, con->index);
+	if (IS_ERR(kt)) {
+		pr_err("console [%s%d]: failed to start printing thread\n",
+		       con->name, con->index);
+		return;
+	}
+
+	WRITE_ONCE(con->kthread, kt);
+	/* Catch up with the records printed so far */
+	irq_work_queue(&con->irq_work);
+}
+
+/**
+ * nbcon_init - Initialize the nbcon state of a console to be registered
+ * @con:	The nbcon console
+ *
+ * Return: 0 on success, -ENOMEM if the printing buffers could not be
+ * allocated.
+ *
+ * Context: Under the console_list_lock.
+ */
+int nbcon_init(struct console *con)
+{
+	if (WARN_ON_ONCE(!con->write_atomic))
+		return -EINVAL;
+
+	con->pbufs = kmalloc(sizeof(*con->pbufs), GFP_KERNEL);
+	if (!con->pbufs)
+		return -ENOMEM;
+
+	atomic_set(&con->nbcon_owner, NBCON_OWNER_NONE);
+	init_waitqueue_head(&con->kthread_wait);
+	init_irq_work(&con->irq_work, nbcon_irq_work);
+	con->kthread = NULL;
+
+	nbcon_kthread_create(con);
+	return 0;
+}
+
+/**
+ * nbcon_free - Stop the printer thread of an unregistered console
+ * @con:	The nbcon console
+ *
+ * Context: Under the console_list_lock. @con is not visible in the
+ *	    console list anymore.
+ */
+void nbcon_free(struct console *con)
+{
+	if (con->kthread) {
+		kthread_stop(con->kthread);
+		WRITE_ONCE(con->kthread, NULL);
+	}
+	irq_work_sync(&con->irq_work);
+
+	kfree(con->pbufs);
+	con->pbufs = NULL;
+}
+
+/* Start the printer threads of the nbcon consoles registered so far */
+static int __init printk_setup_kthreads(void)
+{
+	struct console *con;
+
+	console_list_lock();
+	printk_kthreads_ready = true;
+	for_each_console(con) {
+		if (con->flags & CON_NBCON)
+			nbcon_kthread_create(con);
+	}
+	console_list_unlock();
+
+	return 0;
+}
+early_initcall(printk_setup_kthreads);
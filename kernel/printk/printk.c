@@ -348,7 +348,7 @@ static void __up_console_sem(unsigned long ip)
 }
 #define up_console_sem() __up_console_sem(_RET_IP_)
 
-static bool panic_in_progress(void)
+bool panic_in_progress(void)
 {
 	return unlikely(atomic_read(&panic_cpu) != PANIC_CPU_INVALID);
 }
@@ -494,7 +494,7 @@ _DEFINE_PRINTKRB(printk_rb_static, CONFIG_LOG_BUF_SHIFT - PRB_AVGBITS,
 
 static struct printk_ringbuffer printk_rb_dynamic;
 
-static struct printk_ringbuffer *prb = &printk_rb_static;
+struct printk_ringbuffer *prb = &printk_rb_static;
 
 /*
  * We cannot access per-CPU data (e.g. per-CPU flush irq_work) before
@@ -698,9 +698,6 @@ static ssize_t msg_print_ext_body(char *buf, size_t size,
 	return len;
 }
 
-static bool printk_get_next_message(struct printk_message *pmsg, u64 seq,
-				    bool is_extended, bool may_supress);
-
 /* /dev/kmsg - userspace message inject/listen interface */
 struct devkmsg_user {
 	atomic64_t seq;
@@ -2287,6 +2284,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 
 	printed_len = vprintk_store(facility, level, dev_info, fmt, args);
 
+	/* nbcon consoles are printed by their own threads */
+	nbcon_wake_threads();
+
 	/* If called from the scheduler, we can not call up(). */
 	if (!in_sched) {
 		/*
@@ -2633,6 +2633,18 @@ bool other_cpu_in_panic(void)
 	return atomic_read(&panic_cpu) != raw_smp_processor_id();
 }
 
+/*
+ * Return true if this CPU is the one handling the panic. Like for
+ * other_cpu_in_panic(), the result is stable for the calling task.
+ */
+bool this_cpu_in_panic(void)
+{
+	if (!panic_in_progress())
+		return false;
+
+	return atomic_read(&panic_cpu) == raw_smp_processor_id();
+}
+
 /**
  * console_lock - block the console subsystem from printing
  *
@@ -2684,11 +2696,12 @@ EXPORT_SYMBOL(is_console_locked);
 
 /*
  * Check if the given console is currently capable and allowed to print
- * records.
+ * records. nbcon consoles are printed through their ->write_atomic() and
+ * ->write_thread() callbacks instead of ->write().
  *
  * Requires the console_srcu_read_lock.
  */
-static inline bool console_is_usable(struct console *con)
+bool console_is_usable(struct console *con)
 {
 	short flags = console_srcu_read_flags(con);
 
@@ -2698,8 +2711,12 @@ static inline bool console_is_usable(struct console *con)
 	if ((flags & CON_SUSPENDED))
 		return false;
 
-	if (!con->write)
+	if (flags & CON_NBCON) {
+		if (!con->write_atomic)
+			return false;
+	} else if (!con->write) {
 		return false;
+	}
 
 	/*
 	 * Console drivers may assume that per-cpu resources have been
@@ -2733,7 +2750,7 @@ static void __console_unlock(void)
  * If @pmsg->pbufs->outbuf is modified, @pmsg->outbuf_len is updated.
  */
 #ifdef CONFIG_PRINTK
-static void console_prepend_dropped(struct printk_message *pmsg, unsigned long dropped)
+void console_prepend_dropped(struct printk_message *pmsg, unsigned long dropped)
 {
 	struct printk_buffers *pbufs = pmsg->pbufs;
 	const size_t scratchbuf_sz = sizeof(pbufs->scratchbuf);
@@ -2787,8 +2804,8 @@ static void console_prepend_dropped(struct printk_message *pmsg, unsigned long d
  * of @pmsg are valid. (See the documentation of struct printk_message
  * for information about the @pmsg fields.)
  */
-static bool printk_get_next_message(struct printk_message *pmsg, u64 seq,
-				    bool is_extended, bool may_suppress)
+bool printk_get_next_message(struct printk_message *pmsg, u64 seq,
+			     bool is_extended, bool may_suppress)
 {
 	static int panic_console_dropped;
 
@@ -2961,6 +2978,22 @@ static bool console_flush_all(bool do_cond_resched, u64 *next_seq, bool *handove
 
 			if (!console_is_usable(con))
 				continue;
+
+			/*
+			 * nbcon consoles are printed by their thread. They are
+			 * only printed from here when the thread is not
+			 * available or the console is owned by somebody else.
+			 */
+			if (console_srcu_read_flags(con) & CON_NBCON) {
+				if (nbcon_kthread_printing(con))
+					continue;
+				progress = nbcon_atomic_emit_next_record(con);
+				if (!progress &&
+				    prb_read_valid(prb, READ_ONCE(con->seq), NULL))
+					continue;
+				any_usable = true;
+				goto track_seq;
+			}
 			any_usable = true;
 
 			progress = console_emit_next_record(con, handover, cookie);
@@ -2971,7 +3004,7 @@ static bool console_flush_all(bool do_cond_resched, u64 *next_seq, bool *handove
 			 */
 			if (*handover)
 				return false;
-
+track_seq:
 			/* Track the next of the highest seq flushed. */
 			if (con->seq > *next_seq)
 				*next_seq = con->seq;
@@ -3488,6 +3521,11 @@ void register_console(struct console *newcon)
 	newcon->dropped = 0;
 	console_init_seq(newcon, bootcon_registered);
 
+	if (newcon->flags & CON_NBCON) {
+		if (nbcon_init(newcon))
+			goto unlock;
+	}
+
 	/*
 	 * Put this console in the list - keep the
 	 * preferred driver at the head of the list.
@@ -3579,6 +3617,9 @@ static int unregister_console_locked(struct console *console)
 	 */
 	synchronize_srcu(&console_srcu);
 
+	if (console->flags & CON_NBCON)
+		nbcon_free(console);
+
 	console_sysfs_notify();
 
 	if (console->exit)
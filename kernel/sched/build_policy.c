@@ -29,6 +29,13 @@
 #include <linux/tsacct_kern.h>
 #include <linux/vtime.h>
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+# include <linux/bpf_verifier.h>
+# include <linux/btf_ids.h>
+# include <linux/filter.h>
+# include <linux/rhashtable.h>
+#endif
+
 #include <uapi/linux/sched/types.h>
 
 #include "sched.h"
@@ -52,3 +59,7 @@
 #include "cputime.c"
 #include "deadline.c"
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+# include "ext.c"
+#endif
+
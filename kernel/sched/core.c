@@ -793,7 +793,7 @@ static enum hrtimer_restart hrtick(struct hrtimer *timer)
 
 	rq_lock(rq, &rf);
 	update_rq_clock(rq);
-	rq->curr->sched_class->task_tick(rq, rq->curr, 1);
+	rq->donor->sched_class->task_tick(rq, rq->donor, 1);
 	rq_unlock(rq, &rf);
 
 	return HRTIMER_NORESTART;
@@ -2205,9 +2205,9 @@ inline int task_curr(const struct task_struct *p)
  * this means any call to check_class_changed() must be followed by a call to
  * balance_callback().
  */
-static inline void check_class_changed(struct rq *rq, struct task_struct *p,
-				       const struct sched_class *prev_class,
-				       int oldprio)
+void check_class_changed(struct rq *rq, struct task_struct *p,
+			 const struct sched_class *prev_class,
+			 int oldprio)
 {
 	if (prev_class != p->sched_class) {
 		if (prev_class->switched_from)
@@ -2220,9 +2220,11 @@ static inline void check_class_changed(struct rq *rq, struct task_struct *p,
 
 void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags)
 {
-	if (p->sched_class == rq->curr->sched_class)
-		rq->curr->sched_class->check_preempt_curr(rq, p, flags);
-	else if (sched_class_above(p->sched_class, rq->curr->sched_class))
+	struct task_struct *donor = rq->donor;
+
+	if (p->sched_class == donor->sched_class)
+		donor->sched_class->check_preempt_curr(rq, p, flags);
+	else if (sched_class_above(p->sched_class, donor->sched_class))
 		resched_curr(rq);
 
 	/*
@@ -2768,7 +2770,7 @@ __do_set_cpus_allowed(struct task_struct *p, struct affinity_context *ctx)
 		lockdep_assert_held(&p->pi_lock);
 
 	queued = task_on_rq_queued(p);
-	running = task_current(rq, p);
+	running = task_current_donor(rq, p);
 
 	if (queued) {
 		/*
@@ -3857,6 +3859,13 @@ static int ttwu_runnable(struct task_struct *p, int wake_flags)
 			 */
 			update_rq_clock(rq);
 			check_preempt_curr(rq, p, wake_flags);
+		} else if (task_current_donor(rq, p) && !task_current(rq, p)) {
+			/*
+			 * @p lends its scheduling context to the owner of the
+			 * mutex it was blocked on; stop proxying and let it
+			 * retry the lock itself.
+			 */
+			resched_curr(rq);
 		}
 		ttwu_do_wakeup(p);
 		ret = 1;
@@ -4524,6 +4533,12 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->rt.on_rq		= 0;
 	p->rt.on_list		= 0;
 
+	init_scx_entity(p);
+
+#ifdef CONFIG_SCHED_PROXY_EXEC
+	p->blocked_mutex = NULL;
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -4571,6 +4586,9 @@ static void reset_memory_tiering(void)
 		pgdat->nbp_threshold = 0;
 		pgdat->nbp_th_nr_cand = node_page_state(pgdat, PGPROMOTE_CANDIDATE);
 		pgdat->nbp_th_start = jiffies_to_msecs(jiffies);
+		pgdat->nbp_src_rl_nr_cand =
+			node_page_state(pgdat, PGPROMOTE_SRC_CANDIDATE);
+		pgdat->nbp_src_rl_start = jiffies_to_msecs(jiffies);
 	}
 }
 
@@ -4767,6 +4785,10 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		return -EAGAIN;
 	else if (rt_prio(p->prio))
 		p->sched_class = &rt_sched_class;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	else if (task_should_scx(p))
+		p->sched_class = &ext_sched_class;
+#endif
 	else
 		p->sched_class = &fair_sched_class;
 
@@ -4820,6 +4842,7 @@ void sched_cgroup_fork(struct task_struct *p, struct kernel_clone_args *kargs)
 void sched_post_fork(struct task_struct *p)
 {
 	uclamp_post_fork(p);
+	scx_post_fork(p);
 }
 
 unsigned long to_ratio(u64 period, u64 runtime)
@@ -5571,7 +5594,7 @@ unsigned long long task_sched_runtime(struct task_struct *p)
 	 * project cycles that may never be accounted to this
 	 * thread, breaking clock_gettime().
 	 */
-	if (task_current(rq, p) && task_on_rq_queued(p)) {
+	if (task_current_donor(rq, p) && task_on_rq_queued(p)) {
 		prefetch_curr_exec_start(p);
 		update_rq_clock(rq);
 		p->sched_class->update_curr(rq);
@@ -5640,6 +5663,7 @@ void scheduler_tick(void)
 	int cpu = smp_processor_id();
 	struct rq *rq = cpu_rq(cpu);
 	struct task_struct *curr = rq->curr;
+	struct task_struct *donor = rq->donor;
 	struct rq_flags rf;
 	unsigned long thermal_pressure;
 	u64 resched_latency;
@@ -5654,7 +5678,7 @@ void scheduler_tick(void)
 	update_rq_clock(rq);
 	thermal_pressure = arch_scale_thermal_pressure(cpu_of(rq));
 	update_thermal_load_avg(rq_clock_thermal(rq), rq, thermal_pressure);
-	curr->sched_class->task_tick(rq, curr, 0);
+	donor->sched_class->task_tick(rq, donor, 0);
 	if (sched_feat(LATENCY_WARN))
 		resched_latency = cpu_resched_latency(rq);
 	calc_global_load_tick(rq);
@@ -5965,7 +5989,18 @@ static void put_prev_task_balance(struct rq *rq, struct task_struct *prev,
 				  struct rq_flags *rf)
 {
 #ifdef CONFIG_SMP
+	const struct sched_class *start_class = prev->sched_class;
 	const struct sched_class *class;
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+	/*
+	 * The BPF scheduler's balance() is what moves tasks onto this CPU's
+	 * local DSQ, so it has to run even when coming out of idle.
+	 */
+	if (scx_enabled() && sched_class_above(&ext_sched_class, start_class))
+		start_class = &ext_sched_class;
+#endif
+
 	/*
 	 * We must do the balancing pass before put_prev_task(), such
 	 * that when we release the rq->lock the task is in the same
@@ -5974,7 +6009,7 @@ static void put_prev_task_balance(struct rq *rq, struct task_struct *prev,
 	 * We can terminate the balance pass as soon as we know there is
 	 * a runnable task of @class priority or higher.
 	 */
-	for_class_range(class, prev->sched_class, &idle_sched_class) {
+	for_class_range(class, start_class, &idle_sched_class) {
 		if (class->balance(rq, prev, rf))
 			break;
 	}
@@ -5996,9 +6031,12 @@ __pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 	 * Optimization: we know that if all tasks are in the fair class we can
 	 * call that function directly, but only if the @prev task wasn't of a
 	 * higher scheduling class, because otherwise those lose the
-	 * opportunity to pull in more work from other CPUs.
+	 * opportunity to pull in more work from other CPUs. The BPF
+	 * scheduler may have work for this CPU queued elsewhere, so it always
+	 * takes the slow path.
 	 */
-	if (likely(!sched_class_above(prev->sched_class, &fair_sched_class) &&
+	if (likely(!scx_enabled() &&
+		   !sched_class_above(prev->sched_class, &fair_sched_class) &&
 		   rq->nr_running == rq->cfs.h_nr_running)) {
 
 		p = pick_next_task_fair(rq, prev, rf);
@@ -6534,6 +6572,123 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 # define SM_MASK_PREEMPT	SM_PREEMPT
 #endif
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+DEFINE_STATIC_KEY_TRUE(__sched_proxy_exec);
+
+static int __init setup_proxy_exec(char *str)
+{
+	bool enable;
+
+	if (kstrtobool(str, &enable)) {
+		pr_warn("Unable to parse sched_proxy_exec=\n");
+		return 0;
+	}
+
+	if (!enable)
+		static_branch_disable(&__sched_proxy_exec);
+	return 1;
+}
+__setup("sched_proxy_exec=", setup_proxy_exec);
+
+/*
+ * Only blocked CFS tasks are left on the runqueue, and only a CFS owner
+ * queued on the same runqueue can run on their behalf.
+ */
+static inline bool task_can_proxy(struct task_struct *p)
+{
+	return p->sched_class == &fair_sched_class;
+}
+
+/*
+ * @donor can neither run nor lend its context to anyone, block it like
+ * __schedule() would have if proxying was not possible.
+ */
+static void proxy_block_task(struct rq *rq, struct task_struct *donor)
+{
+	unsigned long state = READ_ONCE(donor->__state);
+
+	/* Woken up in the meantime, ttwu_runnable() already handled it. */
+	if (state == TASK_RUNNING)
+		return;
+
+	donor->sched_contributes_to_load =
+		(state & TASK_UNINTERRUPTIBLE) &&
+		!(state & TASK_NOLOAD) &&
+		!(state & TASK_FROZEN);
+
+	if (donor->sched_contributes_to_load)
+		rq->nr_uninterruptible++;
+
+	deactivate_task(rq, donor, DEQUEUE_SLEEP | DEQUEUE_NOCLOCK);
+
+	if (donor->in_iowait) {
+		atomic_inc(&rq->nr_iowait);
+		/* delayacct only tracks current */
+		if (donor == current)
+			delayacct_blkio_start();
+	}
+}
+
+/*
+ * Follow the blocked_mutex chain from @donor to the task which should run
+ * on its behalf.
+ *
+ * The chain is walked without taking any mutex wait_lock; doing so under
+ * the rq lock would invert against ww_mutex wounding, which wakes tasks
+ * while holding wait_lock. A stale answer is harmless: if the owner
+ * releases the lock, it wakes the top waiter, which goes through
+ * ttwu_runnable() and forces another pass through __schedule(). Task
+ * structs stay valid since we run with IRQs disabled.
+ *
+ * Returns the task to run, or NULL if @donor was blocked and a new pick is
+ * needed.
+ */
+static struct task_struct *
+find_proxy_task(struct rq *rq, struct task_struct *donor)
+{
+	struct task_struct *p = donor, *owner;
+	struct mutex *mutex;
+	int depth = 0;
+
+	for (;;) {
+		mutex = READ_ONCE(p->blocked_mutex);
+		if (!mutex || READ_ONCE(p->__state) == TASK_RUNNING)
+			return p;
+
+		owner = mutex_owner_task(mutex);
+		/* Released; the waiter is being woken, let it retry. */
+		if (!owner)
+			return p;
+
+		if (owner == p || ++depth > 16)
+			break;
+
+		if (task_cpu(owner) != cpu_of(rq) || !task_on_rq_queued(owner) ||
+		    !task_can_proxy(owner))
+			break;
+
+		p = owner;
+	}
+
+	if (READ_ONCE(donor->__state) == TASK_RUNNING)
+		return donor;
+
+	proxy_block_task(rq, donor);
+	return NULL;
+}
+#else
+static inline bool task_can_proxy(struct task_struct *p)
+{
+	return false;
+}
+
+static inline struct task_struct *
+find_proxy_task(struct rq *rq, struct task_struct *donor)
+{
+	return donor;
+}
+#endif /* CONFIG_SCHED_PROXY_EXEC */
+
 /*
  * __schedule() is the main scheduler function.
  *
@@ -6626,6 +6781,12 @@ static void __sched notrace __schedule(unsigned int sched_mode)
 	if (!(sched_mode & SM_MASK_PREEMPT) && prev_state) {
 		if (signal_pending_state(prev_state, prev)) {
 			WRITE_ONCE(prev->__state, TASK_RUNNING);
+		} else if (task_is_blocked(prev) && task_can_proxy(prev)) {
+			/*
+			 * Blocked on a mutex: stay queued so that, if picked,
+			 * the owner can run on our behalf. find_proxy_task()
+			 * dequeues us if that turns out to be impossible.
+			 */
 		} else {
 			prev->sched_contributes_to_load =
 				(prev_state & TASK_UNINTERRUPTIBLE) &&
@@ -6656,7 +6817,14 @@ static void __sched notrace __schedule(unsigned int sched_mode)
 		switch_count = &prev->nvcsw;
 	}
 
-	next = pick_next_task(rq, prev, &rf);
+pick_again:
+	next = pick_next_task(rq, rq->donor, &rf);
+	rq_set_donor(rq, next);
+	if (unlikely(task_is_blocked(next))) {
+		next = find_proxy_task(rq, next);
+		if (!next)
+			goto pick_again;
+	}
 	clear_tsk_need_resched(prev);
 	clear_preempt_need_resched();
 #ifdef CONFIG_SCHED_DEBUG
@@ -7026,12 +7194,54 @@ static void __setscheduler_prio(struct task_struct *p, int prio)
 		p->sched_class = &dl_sched_class;
 	else if (rt_prio(prio))
 		p->sched_class = &rt_sched_class;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	else if (task_should_scx(p))
+		p->sched_class = &ext_sched_class;
+#endif
 	else
 		p->sched_class = &fair_sched_class;
 
 	p->prio = prio;
 }
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+/*
+ * Re-evaluate which class @p belongs to without changing its priority, e.g.
+ * after the BPF scheduler got enabled or disabled, and move it over.
+ */
+void sched_reclass_task(struct task_struct *p)
+{
+	const struct sched_class *prev_class;
+	struct balance_callback *head;
+	int queued, running;
+	struct rq_flags rf;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &rf);
+	update_rq_clock(rq);
+
+	prev_class = p->sched_class;
+	queued = task_on_rq_queued(p);
+	running = task_current_donor(rq, p);
+	if (queued)
+		dequeue_task(rq, p, DEQUEUE_SAVE | DEQUEUE_NOCLOCK);
+	if (running)
+		put_prev_task(rq, p);
+
+	__setscheduler_prio(p, p->prio);
+
+	if (queued)
+		enqueue_task(rq, p, ENQUEUE_RESTORE | ENQUEUE_NOCLOCK);
+	if (running)
+		set_next_task(rq, p);
+
+	check_class_changed(rq, p, prev_class, p->prio);
+	head = splice_balance_callbacks(rq);
+	task_rq_unlock(rq, p, &rf);
+	balance_callbacks(rq, head);
+}
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 
 static inline int __rt_effective_prio(struct task_struct *pi_task, int prio)
@@ -7123,7 +7333,7 @@ void rt_mutex_setprio(struct task_struct *p, struct task_struct *pi_task)
 
 	prev_class = p->sched_class;
 	queued = task_on_rq_queued(p);
-	running = task_current(rq, p);
+	running = task_current_donor(rq, p);
 	if (queued)
 		dequeue_task(rq, p, queue_flag);
 	if (running)
@@ -7211,7 +7421,7 @@ void set_user_nice(struct task_struct *p, long nice)
 		goto out_unlock;
 	}
 	queued = task_on_rq_queued(p);
-	running = task_current(rq, p);
+	running = task_current_donor(rq, p);
 	if (queued)
 		dequeue_task(rq, p, DEQUEUE_SAVE | DEQUEUE_NOCLOCK);
 	if (running)
@@ -7795,7 +8005,7 @@ static int __sched_setscheduler(struct task_struct *p,
 	}
 
 	queued = task_on_rq_queued(p);
-	running = task_current(rq, p);
+	running = task_current_donor(rq, p);
 	if (queued)
 		dequeue_task(rq, p, queue_flags);
 	if (running)
@@ -8533,7 +8743,7 @@ static void do_sched_yield(void)
 	rq = this_rq_lock_irq(&rf);
 
 	schedstat_inc(rq->yld_count);
-	current->sched_class->yield_task(rq);
+	rq->donor->sched_class->yield_task(rq);
 
 	preempt_disable();
 	rq_unlock_irq(rq, &rf);
@@ -9049,6 +9259,7 @@ SYSCALL_DEFINE1(sched_get_priority_max, int, policy)
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
+	case SCHED_EXT:
 		ret = 0;
 		break;
 	}
@@ -9076,6 +9287,7 @@ SYSCALL_DEFINE1(sched_get_priority_min, int, policy)
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
+	case SCHED_EXT:
 		ret = 0;
 	}
 	return ret;
@@ -9296,6 +9508,7 @@ void __init init_idle(struct task_struct *idle, int cpu)
 	rcu_read_unlock();
 
 	rq->idle = idle;
+	rq_set_donor(rq, idle);
 	rcu_assign_pointer(rq->curr, idle);
 	idle->on_rq = TASK_ON_RQ_QUEUED;
 #ifdef CONFIG_SMP
@@ -9385,7 +9598,7 @@ void sched_setnuma(struct task_struct *p, int nid)
 
 	rq = task_rq_lock(p, &rf);
 	queued = task_on_rq_queued(p);
-	running = task_current(rq, p);
+	running = task_current_donor(rq, p);
 
 	if (queued)
 		dequeue_task(rq, p, DEQUEUE_SAVE);
@@ -9981,6 +10194,7 @@ void __init sched_init(void)
 		init_cfs_rq(&rq->cfs);
 		init_rt_rq(&rq->rt);
 		init_dl_rq(&rq->dl);
+		fair_server_init(rq);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 		INIT_LIST_HEAD(&rq->leaf_cfs_rq_list);
 		rq->tmp_alone_branch = &rq->leaf_cfs_rq_list;
@@ -10087,6 +10301,7 @@ void __init sched_init(void)
 	balance_push_set(smp_processor_id(), false);
 #endif
 	init_sched_fair_class();
+	init_sched_ext_class();
 
 	psi_init();
 
@@ -10512,7 +10727,7 @@ void sched_move_task(struct task_struct *tsk)
 
 	update_rq_clock(rq);
 
-	running = task_current(rq, tsk);
+	running = task_current_donor(rq, tsk);
 	queued = task_on_rq_queued(tsk);
 
 	if (queued)
@@ -54,8 +54,14 @@ static int __init sched_dl_sysctl_init(void)
 late_initcall(sched_dl_sysctl_init);
 #endif
 
+static inline bool dl_server(struct sched_dl_entity *dl_se)
+{
+	return dl_se->dl_server;
+}
+
 static inline struct task_struct *dl_task_of(struct sched_dl_entity *dl_se)
 {
+	BUG_ON(dl_server(dl_se));
 	return container_of(dl_se, struct task_struct, dl);
 }
 
@@ -64,12 +70,17 @@ static inline struct rq *rq_of_dl_rq(struct dl_rq *dl_rq)
 	return container_of(dl_rq, struct rq, dl);
 }
 
-static inline struct dl_rq *dl_rq_of_se(struct sched_dl_entity *dl_se)
+static inline struct rq *rq_of_dl_se(struct sched_dl_entity *dl_se)
 {
-	struct task_struct *p = dl_task_of(dl_se);
-	struct rq *rq = task_rq(p);
+	if (dl_server(dl_se))
+		return dl_se->rq;
+
+	return task_rq(dl_task_of(dl_se));
+}
 
-	return &rq->dl;
+static inline struct dl_rq *dl_rq_of_se(struct sched_dl_entity *dl_se)
+{
+	return &rq_of_dl_se(dl_se)->dl;
 }
 
 static inline int on_dl_rq(struct sched_dl_entity *dl_se)
@@ -482,10 +493,8 @@ static void task_contending(struct sched_dl_entity *dl_se, int flags)
 	}
 }
 
-static inline int is_leftmost(struct task_struct *p, struct dl_rq *dl_rq)
+static inline int is_leftmost(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	struct sched_dl_entity *dl_se = &p->dl;
-
 	return rb_first_cached(&dl_rq->root) == &dl_se->rb_node;
 }
 
@@ -568,9 +577,8 @@ static void update_dl_migration(struct dl_rq *dl_rq)
 
 static void inc_dl_migration(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	struct task_struct *p = dl_task_of(dl_se);
-
-	if (p->nr_cpus_allowed > 1)
+	/* servers are per-CPU, only their tasks can move */
+	if (!dl_server(dl_se) && dl_task_of(dl_se)->nr_cpus_allowed > 1)
 		dl_rq->dl_nr_migratory++;
 
 	update_dl_migration(dl_rq);
@@ -578,9 +586,7 @@ static void inc_dl_migration(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 
 static void dec_dl_migration(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	struct task_struct *p = dl_task_of(dl_se);
-
-	if (p->nr_cpus_allowed > 1)
+	if (!dl_server(dl_se) && dl_task_of(dl_se)->nr_cpus_allowed > 1)
 		dl_rq->dl_nr_migratory--;
 
 	update_dl_migration(dl_rq);
@@ -1042,11 +1048,10 @@ static inline u64 dl_next_period(struct sched_dl_entity *dl_se)
  * actually started or not (i.e., the replenishment instant is in
  * the future or in the past).
  */
-static int start_dl_timer(struct task_struct *p)
+static int start_dl_timer(struct sched_dl_entity *dl_se)
 {
-	struct sched_dl_entity *dl_se = &p->dl;
 	struct hrtimer *timer = &dl_se->dl_timer;
-	struct rq *rq = task_rq(p);
+	struct rq *rq = rq_of_dl_se(dl_se);
 	ktime_t now, act;
 	s64 delta;
 
@@ -1056,8 +1061,15 @@ static int start_dl_timer(struct task_struct *p)
 	 * We want the timer to fire at the deadline, but considering
 	 * that it is actually coming from rq->clock and not from
 	 * hrtimer's time base reading.
+	 *
+	 * A deferred server instead wants to fire at the zero-laxity
+	 * instant, the last moment at which it can still consume its
+	 * remaining runtime before the deadline.
 	 */
-	act = ns_to_ktime(dl_next_period(dl_se));
+	if (dl_se->dl_defer_armed)
+		act = ns_to_ktime(dl_se->deadline - dl_se->runtime);
+	else
+		act = ns_to_ktime(dl_next_period(dl_se));
 	now = hrtimer_cb_get_time(timer);
 	delta = ktime_to_ns(now) - rq_clock(rq);
 	act = ktime_add_ns(act, delta);
@@ -1080,13 +1092,78 @@ static int start_dl_timer(struct task_struct *p)
 	 * and observe our state.
 	 */
 	if (!hrtimer_is_queued(timer)) {
-		get_task_struct(p);
+		if (!dl_server(dl_se))
+			get_task_struct(dl_task_of(dl_se));
 		hrtimer_start(timer, act, HRTIMER_MODE_ABS_HARD);
 	}
 
 	return 1;
 }
 
+static void __enqueue_dl_entity(struct sched_dl_entity *dl_se);
+static void __dequeue_dl_entity(struct sched_dl_entity *dl_se);
+
+/*
+ * Hold the server back until the zero-laxity instant of its current period.
+ * If its class gets dl_runtime in the background before then, the server
+ * never needs to run; see update_curr_dl_se().
+ */
+static void dl_server_defer(struct sched_dl_entity *dl_se)
+{
+	struct rq *rq = rq_of_dl_se(dl_se);
+
+	dl_se->dl_throttled = 1;
+	dl_se->dl_defer_armed = 1;
+	if (start_dl_timer(dl_se))
+		return;
+
+	/* the zero-laxity instant already passed: run now */
+	dl_se->dl_defer_armed = 0;
+	dl_se->dl_throttled = 0;
+	__enqueue_dl_entity(dl_se);
+	resched_curr(rq);
+}
+
+static enum hrtimer_restart dl_server_timer(struct hrtimer *timer,
+					    struct sched_dl_entity *dl_se)
+{
+	struct rq *rq = rq_of_dl_se(dl_se);
+	struct rq_flags rf;
+
+	rq_lock(rq, &rf);
+
+	/*
+	 * Stopped meanwhile, or re-armed by update_curr_dl_se() while we were
+	 * waiting for the lock.
+	 */
+	if (!dl_se->dl_server_active || !dl_se->dl_throttled ||
+	    hrtimer_is_queued(timer))
+		goto unlock;
+
+	sched_clock_tick();
+	update_rq_clock(rq);
+
+	if (dl_se->dl_defer_armed) {
+		/*
+		 * The class didn't get its runtime on its own within this
+		 * period: run it from here on, at the server's deadline.
+		 */
+		dl_se->dl_defer_armed = 0;
+		dl_se->dl_throttled = 0;
+		__enqueue_dl_entity(dl_se);
+		resched_curr(rq);
+	} else {
+		/* the server ran out of runtime, defer again in the new period */
+		replenish_dl_entity(dl_se);
+		dl_server_defer(dl_se);
+	}
+
+unlock:
+	rq_unlock(rq, &rf);
+
+	return HRTIMER_NORESTART;
+}
+
 /*
  * This is the bandwidth enforcement timer callback. If here, we know
  * a task is not on its dl_rq, since the fact that the timer was running
@@ -1105,10 +1182,14 @@ static enum hrtimer_restart dl_task_timer(struct hrtimer *timer)
 	struct sched_dl_entity *dl_se = container_of(timer,
 						     struct sched_dl_entity,
 						     dl_timer);
-	struct task_struct *p = dl_task_of(dl_se);
+	struct task_struct *p;
 	struct rq_flags rf;
 	struct rq *rq;
 
+	if (dl_server(dl_se))
+		return dl_server_timer(timer, dl_se);
+
+	p = dl_task_of(dl_se);
 	rq = task_rq_lock(p, &rf);
 
 	/*
@@ -1235,12 +1316,11 @@ void init_dl_task_timer(struct sched_dl_entity *dl_se)
  */
 static inline void dl_check_constrained_dl(struct sched_dl_entity *dl_se)
 {
-	struct task_struct *p = dl_task_of(dl_se);
 	struct rq *rq = rq_of_dl_rq(dl_rq_of_se(dl_se));
 
 	if (dl_time_before(dl_se->deadline, rq_clock(rq)) &&
 	    dl_time_before(rq_clock(rq), dl_next_period(dl_se))) {
-		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(p)))
+		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(dl_se)))
 			return;
 		dl_se->dl_throttled = 1;
 		if (dl_se->runtime > 0)
@@ -1292,43 +1372,22 @@ static u64 grub_reclaim(u64 delta, struct rq *rq, struct sched_dl_entity *dl_se)
 }
 
 /*
- * Update the current task's runtime statistics (provided it is still
- * a -deadline task and has not been removed from the dl_rq).
+ * Charge @delta_exec to @dl_se, which is either the current -deadline task
+ * or a server whose class is running, and throttle it once its runtime is
+ * exhausted.
  */
-static void update_curr_dl(struct rq *rq)
+static void update_curr_dl_se(struct rq *rq, struct sched_dl_entity *dl_se,
+			      s64 delta_exec)
 {
-	struct task_struct *curr = rq->curr;
-	struct sched_dl_entity *dl_se = &curr->dl;
-	u64 delta_exec, scaled_delta_exec;
 	int cpu = cpu_of(rq);
-	u64 now;
+	u64 scaled_delta_exec;
 
-	if (!dl_task(curr) || !on_dl_rq(dl_se))
-		return;
-
-	/*
-	 * Consumed budget is computed considering the time as
-	 * observed by schedulable tasks (excluding time spent
-	 * in hardirq context, etc.). Deadlines are instead
-	 * computed using hard walltime. This seems to be the more
-	 * natural solution, but the full ramifications of this
-	 * approach need further study.
-	 */
-	now = rq_clock_task(rq);
-	delta_exec = now - curr->se.exec_start;
-	if (unlikely((s64)delta_exec <= 0)) {
+	if (unlikely(delta_exec <= 0)) {
 		if (unlikely(dl_se->dl_yielded))
 			goto throttle;
 		return;
 	}
 
-	schedstat_set(curr->stats.exec_max,
-		      max(curr->stats.exec_max, delta_exec));
-
-	trace_sched_stat_runtime(curr, delta_exec, 0);
-
-	update_current_exec_runtime(curr, now, delta_exec);
-
 	if (dl_entity_is_special(dl_se))
 		return;
 
@@ -1342,7 +1401,7 @@ static void update_curr_dl(struct rq *rq)
 	if (unlikely(dl_se->flags & SCHED_FLAG_RECLAIM)) {
 		scaled_delta_exec = grub_reclaim(delta_exec,
 						 rq,
-						 &curr->dl);
+						 dl_se);
 	} else {
 		unsigned long scale_freq = arch_scale_freq_capacity(cpu);
 		unsigned long scale_cpu = arch_scale_cpu_capacity(cpu);
@@ -1353,6 +1412,20 @@ static void update_curr_dl(struct rq *rq)
 
 	dl_se->runtime -= scaled_delta_exec;
 
+	/*
+	 * A deferred server only tracks what its class got in the background.
+	 * Once that covers its runtime there's nothing to guarantee in this
+	 * period anymore: start over with a new one.
+	 */
+	if (dl_se->dl_defer_armed) {
+		if (dl_runtime_exceeded(dl_se)) {
+			hrtimer_try_to_cancel(&dl_se->dl_timer);
+			replenish_dl_new_period(dl_se, rq);
+			WARN_ON_ONCE(!start_dl_timer(dl_se));
+		}
+		return;
+	}
+
 throttle:
 	if (dl_runtime_exceeded(dl_se) || dl_se->dl_yielded) {
 		dl_se->dl_throttled = 1;
@@ -1362,13 +1435,62 @@ static void update_curr_dl(struct rq *rq)
 		    (dl_se->flags & SCHED_FLAG_DL_OVERRUN))
 			dl_se->dl_overrun = 1;
 
-		__dequeue_task_dl(rq, curr, 0);
-		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(curr)))
-			enqueue_task_dl(rq, curr, ENQUEUE_REPLENISH);
+		if (dl_server(dl_se)) {
+			__dequeue_dl_entity(dl_se);
+			if (!start_dl_timer(dl_se)) {
+				replenish_dl_entity(dl_se);
+				dl_server_defer(dl_se);
+			}
+		} else {
+			struct task_struct *curr = dl_task_of(dl_se);
+
+			__dequeue_task_dl(rq, curr, 0);
+			if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(dl_se)))
+				enqueue_task_dl(rq, curr, ENQUEUE_REPLENISH);
+		}
 
-		if (!is_leftmost(curr, &rq->dl))
+		if (!is_leftmost(dl_se, &rq->dl))
 			resched_curr(rq);
 	}
+}
+
+/*
+ * Update the current task's runtime statistics (provided it is still
+ * a -deadline task and has not been removed from the dl_rq).
+ */
+static void update_curr_dl(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	struct sched_dl_entity *dl_se = &curr->dl;
+	s64 delta_exec;
+	u64 now;
+
+	if (!dl_task(curr) || !on_dl_rq(dl_se))
+		return;
+
+	/*
+	 * Consumed budget is computed considering the time as
+	 * observed by schedulable tasks (excluding time spent
+	 * in hardirq context, etc.). Deadlines are instead
+	 * computed using hard walltime. This seems to be the more
+	 * natural solution, but the full ramifications of this
+	 * approach need further study.
+	 */
+	now = rq_clock_task(rq);
+	delta_exec = now - curr->se.exec_start;
+	if (delta_exec > 0) {
+		schedstat_set(curr->stats.exec_max,
+			      max(curr->stats.exec_max, (u64)delta_exec));
+
+		trace_sched_stat_runtime(curr, delta_exec, 0);
+
+		update_current_exec_runtime(curr, now, delta_exec);
+	}
+
+	update_curr_dl_se(rq, dl_se, delta_exec);
+
+	if (delta_exec <= 0 || dl_entity_is_special(dl_se))
+		return;
 
 	/*
 	 * Because -- for now -- we share the rt bandwidth, we need to
@@ -1396,6 +1518,121 @@ static void update_curr_dl(struct rq *rq)
 	}
 }
 
+/*
+ * Charge the runtime of a task of the served class. While the server is
+ * throttled waiting for its next period, that runtime isn't relevant.
+ */
+void dl_server_update(struct sched_dl_entity *dl_se, s64 delta_exec)
+{
+	if (!dl_se->dl_server_active || !dl_se->dl_runtime)
+		return;
+
+	if (dl_se->dl_throttled && !dl_se->dl_defer_armed)
+		return;
+
+	update_curr_dl_se(dl_se->rq, dl_se, delta_exec);
+}
+
+void dl_server_start(struct sched_dl_entity *dl_se)
+{
+	struct rq *rq = dl_se->rq;
+
+	if (dl_se->dl_server_active)
+		return;
+
+	dl_se->dl_server_active = 1;
+	if (!dl_se->dl_runtime)
+		return;
+
+	add_running_bw(dl_se, &rq->dl);
+
+	/*
+	 * Restarting within a period the server already ran out of runtime
+	 * in must not hand out a fresh budget.
+	 */
+	if (dl_runtime_exceeded(dl_se) &&
+	    dl_time_before(rq_clock(rq), dl_se->deadline)) {
+		dl_se->dl_throttled = 1;
+		if (start_dl_timer(dl_se))
+			return;
+		replenish_dl_entity(dl_se);
+	} else {
+		update_dl_entity(dl_se);
+	}
+
+	dl_server_defer(dl_se);
+}
+
+void dl_server_stop(struct sched_dl_entity *dl_se)
+{
+	struct rq *rq = dl_se->rq;
+
+	if (!dl_se->dl_server_active)
+		return;
+
+	dl_se->dl_server_active = 0;
+	if (!dl_se->dl_runtime)
+		return;
+
+	hrtimer_try_to_cancel(&dl_se->dl_timer);
+	__dequeue_dl_entity(dl_se);
+	sub_running_bw(dl_se, &rq->dl);
+	dl_se->dl_throttled = 0;
+	dl_se->dl_defer_armed = 0;
+}
+
+void dl_server_init(struct sched_dl_entity *dl_se, struct rq *rq,
+		    dl_server_has_tasks_f has_tasks,
+		    dl_server_pick_f pick_next,
+		    dl_server_pick_f pick_task)
+{
+	RB_CLEAR_NODE(&dl_se->rb_node);
+	init_dl_task_timer(dl_se);
+
+#ifdef CONFIG_RT_MUTEXES
+	dl_se->pi_se = dl_se;
+#endif
+	dl_se->rq = rq;
+	dl_se->dl_server = 1;
+	dl_se->server_has_tasks = has_tasks;
+	dl_se->server_pick_next = pick_next;
+	dl_se->server_pick_task = pick_task;
+}
+
+/*
+ * Set the server's runtime and period; a runtime of 0 disables it. The
+ * server's bandwidth is accounted to its rq but, like the RT throttling
+ * it replaces, kept out of the root domain's admission control.
+ *
+ * Must be called with the rq lock held and the rq clock updated.
+ */
+void dl_server_apply_params(struct sched_dl_entity *dl_se, u64 runtime,
+			    u64 period)
+{
+	struct rq *rq = dl_se->rq;
+	bool active = dl_se->dl_server_active;
+
+	if (active)
+		dl_server_stop(dl_se);
+
+	if (dl_se->dl_runtime)
+		sub_rq_bw(dl_se, &rq->dl);
+
+	dl_se->dl_runtime = runtime;
+	dl_se->dl_deadline = period;
+	dl_se->dl_period = period;
+	dl_se->dl_bw = runtime ? to_ratio(period, runtime) : 0;
+	dl_se->dl_density = dl_se->dl_bw;
+	dl_se->runtime = 0;
+	dl_se->deadline = 0;
+
+	if (dl_se->dl_runtime)
+		add_rq_bw(dl_se, &rq->dl);
+
+	if (active)
+		dl_server_start(dl_se);
+}
+
 static enum hrtimer_restart inactive_task_timer(struct hrtimer *timer)
 {
 	struct sched_dl_entity *dl_se = container_of(timer,
@@ -1496,12 +1733,14 @@ static inline void dec_dl_deadline(struct dl_rq *dl_rq, u64 deadline) {}
 static inline
 void inc_dl_tasks(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	int prio = dl_task_of(dl_se)->prio;
 	u64 deadline = dl_se->deadline;
 
-	WARN_ON(!dl_prio(prio));
 	dl_rq->dl_nr_running++;
-	add_nr_running(rq_of_dl_rq(dl_rq), 1);
+	/* the tasks of a server are accounted by their own class */
+	if (!dl_server(dl_se)) {
+		WARN_ON(!dl_prio(dl_task_of(dl_se)->prio));
+		add_nr_running(rq_of_dl_rq(dl_rq), 1);
+	}
 
 	inc_dl_deadline(dl_rq, deadline);
 	inc_dl_migration(dl_se, dl_rq);
@@ -1510,12 +1749,12 @@ void inc_dl_tasks(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 static inline
 void dec_dl_tasks(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 {
-	int prio = dl_task_of(dl_se)->prio;
-
-	WARN_ON(!dl_prio(prio));
 	WARN_ON(!dl_rq->dl_nr_running);
 	dl_rq->dl_nr_running--;
-	sub_nr_running(rq_of_dl_rq(dl_rq), 1);
+	if (!dl_server(dl_se)) {
+		WARN_ON(!dl_prio(dl_task_of(dl_se)->prio));
+		sub_nr_running(rq_of_dl_rq(dl_rq), 1);
+	}
 
 	dec_dl_deadline(dl_rq, dl_se->deadline);
 	dec_dl_migration(dl_se, dl_rq);
@@ -1572,7 +1811,7 @@ static inline void
 update_stats_enqueue_dl(struct dl_rq *dl_rq, struct sched_dl_entity *dl_se,
 			int flags)
 {
-	if (!schedstat_enabled())
+	if (!schedstat_enabled() || dl_server(dl_se))
 		return;
 
 	if (flags & ENQUEUE_WAKEUP)
@@ -1959,12 +2198,12 @@ static void check_preempt_curr_dl(struct rq *rq, struct task_struct *p,
 }
 
 #ifdef CONFIG_SCHED_HRTICK
-static void start_hrtick_dl(struct rq *rq, struct task_struct *p)
+static void start_hrtick_dl(struct rq *rq, struct sched_dl_entity *dl_se)
 {
-	hrtick_start(rq, p->dl.runtime);
+	hrtick_start(rq, dl_se->runtime);
 }
 #else /* !CONFIG_SCHED_HRTICK */
-static void start_hrtick_dl(struct rq *rq, struct task_struct *p)
+static void start_hrtick_dl(struct rq *rq, struct sched_dl_entity *dl_se)
 {
 }
 #endif
@@ -1985,7 +2224,7 @@ static void set_next_task_dl(struct rq *rq, struct task_struct *p, bool first)
 		return;
 
 	if (hrtick_enabled_dl(rq))
-		start_hrtick_dl(rq, p);
+		start_hrtick_dl(rq, dl_se);
 
 	if (rq->curr->sched_class != &dl_sched_class)
 		update_dl_rq_load_avg(rq_clock_pelt(rq), rq, 0);
@@ -2003,28 +2242,52 @@ static struct sched_dl_entity *pick_next_dl_entity(struct dl_rq *dl_rq)
 	return __node_2_dle(left);
 }
 
-static struct task_struct *pick_task_dl(struct rq *rq)
+static struct task_struct *__pick_task_dl(struct rq *rq, bool next)
 {
 	struct sched_dl_entity *dl_se;
 	struct dl_rq *dl_rq = &rq->dl;
 	struct task_struct *p;
 
+again:
 	if (!sched_dl_runnable(rq))
 		return NULL;
 
 	dl_se = pick_next_dl_entity(dl_rq);
 	WARN_ON_ONCE(!dl_se);
-	p = dl_task_of(dl_se);
+
+	if (!dl_server(dl_se))
+		return dl_task_of(dl_se);
+
+	p = next ? dl_se->server_pick_next(dl_se) :
+		   dl_se->server_pick_task(dl_se);
+	if (!p) {
+		/* nothing to run after all, give up the rest of the period */
+		if (next) {
+			dl_se->dl_yielded = 1;
+			update_curr_dl_se(rq, dl_se, 0);
+			goto again;
+		}
+		return NULL;
+	}
+
+	if (next && hrtick_enabled_dl(rq))
+		start_hrtick_dl(rq, dl_se);
 
 	return p;
 }
 
+static struct task_struct *pick_task_dl(struct rq *rq)
+{
+	return __pick_task_dl(rq, false);
+}
+
 static struct task_struct *pick_next_task_dl(struct rq *rq)
 {
 	struct task_struct *p;
 
-	p = pick_task_dl(rq);
-	if (p)
+	p = __pick_task_dl(rq, true);
+	/* a server's pick has been set up by its own class */
+	if (p && dl_task(p))
 		set_next_task_dl(rq, p, true);
 
 	return p;
@@ -2064,8 +2327,8 @@ static void task_tick_dl(struct rq *rq, struct task_struct *p, int queued)
 	 * be set and schedule() will start a new hrtick for the next task.
 	 */
 	if (hrtick_enabled_dl(rq) && queued && p->dl.runtime > 0 &&
-	    is_leftmost(p, &rq->dl))
-		start_hrtick_dl(rq, p);
+	    is_leftmost(&p->dl, &rq->dl))
+		start_hrtick_dl(rq, &p->dl);
 }
 
 static void task_fork_dl(struct task_struct *p)
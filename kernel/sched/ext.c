@@ -0,0 +1,1330 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BPF extensible scheduler class (SCX)
+ *
+ * The policy of this scheduling class is implemented by a BPF program
+ * attached through the sched_ext_ops struct_ops type. The kernel side only
+ * provides the mechanics:
+ *
+ *  - Runnable tasks are queued on dispatch queues (DSQs). Each CPU picks its
+ *    next task from its own local DSQ. When that runs dry, balance() first
+ *    takes a task from the global DSQ and then lets ops.dispatch() move tasks
+ *    from custom DSQs with scx_bpf_consume().
+ *
+ *  - ops.enqueue() decides where a newly runnable task goes by calling
+ *    scx_bpf_dispatch(). Tasks which aren't dispatched, e.g. because the BPF
+ *    scheduler doesn't implement ops.enqueue(), go to the global DSQ.
+ *
+ *  - A task runs until its slice runs out, it blocks or it gets preempted by
+ *    a higher class. If nothing else is queued for the CPU, the previous task
+ *    is kept running.
+ *
+ * The BPF scheduler can't be trusted to make forward progress. A watchdog
+ * checks that no runnable task waits for longer than ops.timeout_ms and any
+ * error - including invalid kfunc arguments - disables the BPF scheduler,
+ * moving all tasks back to the fair class. The same happens when the
+ * struct_ops map is unregistered.
+ *
+ * The tasks which are switched over are either all fair class tasks or, with
+ * %SCX_OPS_SWITCH_PARTIAL, only the ones with the SCHED_EXT policy. While no
+ * BPF scheduler is loaded, SCHED_EXT tasks are scheduled like SCHED_NORMAL.
+ */
+
+#define SCX_WATCHDOG_MAX_TIMEOUT	(30 * HZ)
+
+enum scx_ops_enable_state {
+	SCX_OPS_ENABLING,
+	SCX_OPS_ENABLED,
+	SCX_OPS_DISABLING,
+	SCX_OPS_DISABLED,
+};
+
+#define SCX_HAS_OP(op)		(scx_ops.op != NULL)
+
+/* serializes enable, disable and unregistration */
+static DEFINE_MUTEX(scx_ops_enable_mutex);
+DEFINE_STATIC_KEY_FALSE(__scx_ops_enabled);
+static atomic_t scx_ops_enable_state_var = ATOMIC_INIT(SCX_OPS_DISABLED);
+static bool scx_ops_registered;
+static bool scx_switching_all;
+static struct sched_ext_ops scx_ops;
+
+static atomic_t scx_exit_kind = ATOMIC_INIT(SCX_EXIT_DONE);
+static struct scx_exit_info scx_exit_info;
+
+static unsigned long scx_watchdog_timeout;
+static unsigned long scx_watchdog_timestamp = INITIAL_JIFFIES;
+static struct delayed_work scx_watchdog_work;
+
+/* only ops.init() may create DSQs, see scx_bpf_create_dsq() */
+static struct task_struct *scx_ops_init_task;
+
+static struct scx_dispatch_q scx_dsq_global;
+
+static const struct rhashtable_params dsq_hash_params = {
+	.key_len		= 8,
+	.key_offset		= offsetof(struct scx_dispatch_q, id),
+	.head_offset		= offsetof(struct scx_dispatch_q, hash_node),
+};
+static struct rhashtable dsq_hash;
+
+/* the task ops.enqueue() is running for, the only one it may dispatch */
+static DEFINE_PER_CPU(struct task_struct *, scx_enq_task);
+/* the rq ops.dispatch() is running for, the only one it may consume into */
+static DEFINE_PER_CPU(struct rq *, scx_dsp_rq);
+
+static void scx_ops_error_irq_workfn(struct irq_work *irq_work);
+static void scx_ops_disable_workfn(struct work_struct *work);
+static struct irq_work scx_ops_error_irq_work =
+	IRQ_WORK_INIT_HARD(scx_ops_error_irq_workfn);
+static DECLARE_WORK(scx_ops_disable_work, scx_ops_disable_workfn);
+
+static enum scx_ops_enable_state scx_ops_enable_state(void)
+{
+	return atomic_read(&scx_ops_enable_state_var);
+}
+
+static enum scx_ops_enable_state
+scx_ops_set_enable_state(enum scx_ops_enable_state to)
+{
+	return atomic_xchg(&scx_ops_enable_state_var, to);
+}
+
+static bool scx_ops_tryset_enable_state(enum scx_ops_enable_state to,
+					enum scx_ops_enable_state from)
+{
+	int from_v = from;
+
+	return atomic_try_cmpxchg(&scx_ops_enable_state_var, &from_v, to);
+}
+
+/*
+ * Once disabling starts, no more scheduling decisions are handed to the BPF
+ * scheduler. Tasks still on SCX are queued FIFO on their CPU's local DSQ.
+ */
+static bool scx_ops_bypassing(void)
+{
+	return unlikely(scx_ops_enable_state() >= SCX_OPS_DISABLING);
+}
+
+static __printf(3, 4) void scx_ops_exit_kind(enum scx_exit_kind kind,
+					     s64 exit_code,
+					     const char *fmt, ...)
+{
+	struct scx_exit_info *ei = &scx_exit_info;
+	int none = SCX_EXIT_NONE;
+	va_list args;
+
+	/* only the first exit request is recorded */
+	if (!atomic_try_cmpxchg(&scx_exit_kind, &none, kind))
+		return;
+
+	ei->exit_code = exit_code;
+	va_start(args, fmt);
+	vscnprintf(ei->msg, SCX_EXIT_MSG_LEN, fmt, args);
+	va_end(args);
+
+	/* we may be holding rq locks, bounce through irq_work */
+	irq_work_queue(&scx_ops_error_irq_work);
+}
+
+#define scx_ops_error_kind(kind, fmt, args...)				\
+	scx_ops_exit_kind((kind), 0, fmt, ##args)
+
+#define scx_ops_error(fmt, args...)					\
+	scx_ops_error_kind(SCX_EXIT_ERROR, fmt, ##args)
+
+bool task_should_scx(struct task_struct *p)
+{
+	if (!scx_enabled() || scx_ops_bypassing())
+		return false;
+	if (READ_ONCE(scx_switching_all))
+		return true;
+	return p->policy == SCHED_EXT;
+}
+
+static bool task_can_run_on_rq(struct task_struct *p, struct rq *rq)
+{
+	return likely(cpu_active(cpu_of(rq))) &&
+		cpumask_test_cpu(cpu_of(rq), p->cpus_ptr) &&
+		!is_migration_disabled(p);
+}
+
+/*
+ * Kicking another CPU takes its rq lock, which can't nest inside the rq lock
+ * we're usually holding here. Collect the CPUs and kick them from irq_work.
+ */
+static void scx_kick_cpu(s32 cpu)
+{
+	struct rq *this_rq;
+
+	preempt_disable();
+	this_rq = this_rq();
+	cpumask_set_cpu(cpu, this_rq->scx.cpus_to_kick);
+	irq_work_queue(&this_rq->scx.kick_cpus_irq_work);
+	preempt_enable();
+}
+
+static void kick_cpus_irq_workfn(struct irq_work *irq_work)
+{
+	struct rq *this_rq = this_rq();
+	s32 cpu;
+
+	for_each_cpu(cpu, this_rq->scx.cpus_to_kick) {
+		cpumask_clear_cpu(cpu, this_rq->scx.cpus_to_kick);
+		resched_cpu(cpu);
+	}
+}
+
+/*
+ * @p went on a shared DSQ. If its own CPU is busy, wake up an idle CPU which
+ * can run it so that the task gets consumed without waiting for a tick.
+ */
+static void kick_idle_cpu_for(struct rq *rq, struct task_struct *p)
+{
+	s32 cpu;
+
+	if (rq->curr == rq->idle)
+		return;
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_online_mask) {
+		if (cpu != cpu_of(rq) && idle_cpu(cpu)) {
+			scx_kick_cpu(cpu);
+			return;
+		}
+	}
+}
+
+static void init_dsq(struct scx_dispatch_q *dsq, u64 dsq_id)
+{
+	memset(dsq, 0, sizeof(*dsq));
+	raw_spin_lock_init(&dsq->lock);
+	INIT_LIST_HEAD(&dsq->list);
+	dsq->id = dsq_id;
+}
+
+static struct scx_dispatch_q *find_user_dsq(u64 dsq_id)
+{
+	return rhashtable_lookup_fast(&dsq_hash, &dsq_id, dsq_hash_params);
+}
+
+static struct scx_dispatch_q *find_dsq_for_dispatch(struct rq *rq, u64 dsq_id,
+						    struct task_struct *p)
+{
+	struct scx_dispatch_q *dsq;
+
+	if (dsq_id == SCX_DSQ_LOCAL)
+		return &rq->scx.local_dsq;
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		return &scx_dsq_global;
+
+	dsq = find_user_dsq(dsq_id);
+	if (unlikely(!dsq)) {
+		scx_ops_error("non-existent DSQ 0x%llx for %s[%d]",
+			      dsq_id, p->comm, p->pid);
+		return &scx_dsq_global;
+	}
+	return dsq;
+}
+
+/*
+ * Queue @p on @dsq. @p's rq must be locked, which is what keeps p->scx.dsq
+ * stable against a remote consumer.
+ */
+static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
+			     u64 enq_flags)
+{
+	struct rq *rq = task_rq(p);
+	bool is_local = dsq == &rq->scx.local_dsq;
+
+	lockdep_assert_rq_held(rq);
+	WARN_ON_ONCE(p->scx.dsq || !list_empty(&p->scx.dsq_node));
+
+	raw_spin_lock(&dsq->lock);
+	if (unlikely(dsq->id == SCX_DSQ_INVALID)) {
+		raw_spin_unlock(&dsq->lock);
+		scx_ops_error("attempting to dispatch to a destroyed DSQ");
+		dsq = &scx_dsq_global;
+		raw_spin_lock(&dsq->lock);
+	}
+
+	if (enq_flags & SCX_ENQ_HEAD)
+		list_add(&p->scx.dsq_node, &dsq->list);
+	else
+		list_add_tail(&p->scx.dsq_node, &dsq->list);
+	dsq->nr++;
+	p->scx.dsq = dsq;
+	raw_spin_unlock(&dsq->lock);
+
+	if (!is_local) {
+		kick_idle_cpu_for(rq, p);
+	} else if ((enq_flags & SCX_ENQ_PREEMPT) && rq->curr != p &&
+		   rq->curr->sched_class == &ext_sched_class) {
+		rq->curr->scx.slice = 0;
+		resched_curr(rq);
+	}
+}
+
+static void dispatch_dequeue(struct task_struct *p)
+{
+	struct scx_dispatch_q *dsq = p->scx.dsq;
+
+	if (!dsq)
+		return;
+
+	raw_spin_lock(&dsq->lock);
+	list_del_init(&p->scx.dsq_node);
+	dsq->nr--;
+	p->scx.dsq = NULL;
+	raw_spin_unlock(&dsq->lock);
+}
+
+static struct task_struct *first_local_task(struct rq *rq)
+{
+	return list_first_entry_or_null(&rq->scx.local_dsq.list,
+					struct task_struct, scx.dsq_node);
+}
+
+static void scx_init_task(struct task_struct *p)
+{
+	int ret;
+
+	p->scx.flags |= SCX_TASK_INITED;
+
+	if (!SCX_HAS_OP(init_task) || scx_ops_bypassing())
+		return;
+
+	ret = scx_ops.init_task(p);
+	if (unlikely(ret))
+		scx_ops_error("ops.init_task() failed (%d) for %s[%d]",
+			      ret, p->comm, p->pid);
+}
+
+static void scx_exit_task(struct task_struct *p)
+{
+	if (!(p->scx.flags & SCX_TASK_INITED))
+		return;
+
+	p->scx.flags &= ~SCX_TASK_INITED;
+	if (SCX_HAS_OP(exit_task) &&
+	    scx_ops_enable_state() != SCX_OPS_DISABLED)
+		scx_ops.exit_task(p);
+}
+
+static void update_curr_scx(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	u64 now = rq_clock_task(rq);
+	u64 delta_exec;
+
+	if (curr->sched_class != &ext_sched_class)
+		return;
+
+	delta_exec = now - curr->se.exec_start;
+	if (unlikely((s64)delta_exec <= 0))
+		return;
+
+	trace_sched_stat_runtime(curr, delta_exec, 0);
+	update_current_exec_runtime(curr, now, delta_exec);
+	curr->scx.slice -= min(curr->scx.slice, delta_exec);
+}
+
+static void set_task_runnable(struct rq *rq, struct task_struct *p)
+{
+	p->scx.runnable_at = jiffies;
+	list_add_tail(&p->scx.runnable_node, &rq->scx.runnable_list);
+}
+
+static void do_enqueue_task(struct rq *rq, struct task_struct *p, u64 enq_flags)
+{
+	/* being moved over by consume_remote_task(), keep the slice */
+	if (p->scx.flags & SCX_TASK_CONSUMING)
+		goto local;
+
+	if (scx_ops_bypassing()) {
+		p->scx.slice = SCX_SLICE_DFL;
+		goto local;
+	}
+
+	if (SCX_HAS_OP(enqueue)) {
+		__this_cpu_write(scx_enq_task, p);
+		scx_ops.enqueue(p, enq_flags);
+		__this_cpu_write(scx_enq_task, NULL);
+		if (p->scx.dsq)
+			return;
+	}
+
+	p->scx.slice = SCX_SLICE_DFL;
+	dispatch_enqueue(&scx_dsq_global, p, enq_flags);
+	return;
+
+local:
+	dispatch_enqueue(&rq->scx.local_dsq, p, enq_flags);
+}
+
+static void enqueue_task_scx(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (unlikely(!(p->scx.flags & SCX_TASK_INITED)))
+		scx_init_task(p);
+
+	p->scx.flags |= SCX_TASK_QUEUED;
+	rq->scx.nr_running++;
+	add_nr_running(rq, 1);
+	set_task_runnable(rq, p);
+
+	do_enqueue_task(rq, p, flags & ENQUEUE_WAKEUP ? SCX_ENQ_WAKEUP : 0);
+}
+
+static void dequeue_task_scx(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (WARN_ON_ONCE(!(p->scx.flags & SCX_TASK_QUEUED)))
+		return;
+
+	if (!(p->scx.flags & SCX_TASK_CONSUMING) && SCX_HAS_OP(dequeue) &&
+	    !scx_ops_bypassing())
+		scx_ops.dequeue(p, flags & DEQUEUE_SLEEP ? SCX_DEQ_SLEEP : 0);
+
+	dispatch_dequeue(p);
+	list_del_init(&p->scx.runnable_node);
+	p->scx.flags &= ~(SCX_TASK_QUEUED | SCX_TASK_BAL_KEEP);
+	rq->scx.nr_running--;
+	sub_nr_running(rq, 1);
+}
+
+static void yield_task_scx(struct rq *rq)
+{
+	rq->curr->scx.slice = 0;
+}
+
+static void check_preempt_curr_scx(struct rq *rq, struct task_struct *p,
+				   int wake_flags)
+{
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Move @p, found on @dsq while it was queued on @src_rq, over to @rq. Both rq
+ * locks are needed and double_lock_balance() may drop @rq's, so everything is
+ * re-validated once they're held.
+ */
+static bool consume_remote_task(struct rq *rq, struct scx_dispatch_q *dsq,
+				struct task_struct *p, struct rq *src_rq)
+{
+	bool moved;
+
+	double_lock_balance(rq, src_rq);
+
+	raw_spin_lock(&dsq->lock);
+	moved = p->scx.dsq == dsq && task_rq(p) == src_rq &&
+		!task_on_cpu(src_rq, p) && task_can_run_on_rq(p, rq);
+	if (moved) {
+		list_del_init(&p->scx.dsq_node);
+		dsq->nr--;
+		p->scx.dsq = NULL;
+	}
+	raw_spin_unlock(&dsq->lock);
+
+	if (moved) {
+		p->scx.flags |= SCX_TASK_CONSUMING;
+		deactivate_task(src_rq, p, 0);
+		set_task_cpu(p, cpu_of(rq));
+		activate_task(rq, p, 0);
+		p->scx.flags &= ~SCX_TASK_CONSUMING;
+	}
+
+	double_unlock_balance(rq, src_rq);
+	return moved;
+}
+#else
+static bool consume_remote_task(struct rq *rq, struct scx_dispatch_q *dsq,
+				struct task_struct *p, struct rq *src_rq)
+{
+	return false;
+}
+#endif
+
+/* Move the first task on @dsq which can run on @rq to @rq's local DSQ. */
+static bool consume_dispatch_q(struct rq *rq, struct scx_dispatch_q *dsq)
+{
+	struct task_struct *p;
+	bool moved;
+
+retry:
+	if (!READ_ONCE(dsq->nr))
+		return false;
+
+	raw_spin_lock(&dsq->lock);
+	list_for_each_entry(p, &dsq->list, scx.dsq_node) {
+		struct rq *task_rq = task_rq(p);
+
+		if (task_rq == rq) {
+			list_del_init(&p->scx.dsq_node);
+			dsq->nr--;
+			p->scx.dsq = NULL;
+			raw_spin_unlock(&dsq->lock);
+			dispatch_enqueue(&rq->scx.local_dsq, p, 0);
+			return true;
+		}
+
+		if (task_can_run_on_rq(p, rq)) {
+			get_task_struct(p);
+			raw_spin_unlock(&dsq->lock);
+			moved = consume_remote_task(rq, dsq, p, task_rq);
+			put_task_struct(p);
+			if (moved)
+				return true;
+			goto retry;
+		}
+	}
+	raw_spin_unlock(&dsq->lock);
+	return false;
+}
+
+static int balance_one(struct rq *rq, struct task_struct *prev)
+{
+	bool prev_on_scx = prev && prev->sched_class == &ext_sched_class;
+
+	lockdep_assert_rq_held(rq);
+
+	if (prev_on_scx) {
+		update_curr_scx(rq);
+
+		/* @prev still has slice left, let it keep running */
+		if ((prev->scx.flags & SCX_TASK_QUEUED) && prev->scx.slice &&
+		    !scx_ops_bypassing()) {
+			prev->scx.flags |= SCX_TASK_BAL_KEEP;
+			return 1;
+		}
+	}
+
+	if (rq->scx.local_dsq.nr)
+		return 1;
+
+	if (consume_dispatch_q(rq, &scx_dsq_global))
+		return 1;
+
+	if (SCX_HAS_OP(dispatch) && !scx_ops_bypassing()) {
+		__this_cpu_write(scx_dsp_rq, rq);
+		scx_ops.dispatch(cpu_of(rq), prev_on_scx ? prev : NULL);
+		__this_cpu_write(scx_dsp_rq, NULL);
+
+		if (rq->scx.local_dsq.nr)
+			return 1;
+	}
+
+	/* nothing else to run, keep @prev going with a fresh slice */
+	if (prev_on_scx && (prev->scx.flags & SCX_TASK_QUEUED)) {
+		prev->scx.flags |= SCX_TASK_BAL_KEEP;
+		prev->scx.slice = SCX_SLICE_DFL;
+		return 1;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SMP
+static int balance_scx(struct rq *rq, struct task_struct *prev,
+		       struct rq_flags *rf)
+{
+	int ret;
+
+	/* consume_remote_task() may drop the rq lock */
+	rq_unpin_lock(rq, rf);
+	ret = balance_one(rq, prev);
+	rq_repin_lock(rq, rf);
+
+	return ret;
+}
+#endif
+
+static void set_next_task_scx(struct rq *rq, struct task_struct *p, bool first)
+{
+	if (p->scx.flags & SCX_TASK_QUEUED)
+		dispatch_dequeue(p);
+
+	p->se.exec_start = rq_clock_task(rq);
+	list_del_init(&p->scx.runnable_node);
+
+	if (SCX_HAS_OP(running) && !scx_ops_bypassing())
+		scx_ops.running(p);
+}
+
+static void put_prev_task_scx(struct rq *rq, struct task_struct *p)
+{
+	bool queued = p->scx.flags & SCX_TASK_QUEUED;
+
+	update_curr_scx(rq);
+
+	if (SCX_HAS_OP(stopping) && !scx_ops_bypassing())
+		scx_ops.stopping(p, queued);
+
+	if (!queued)
+		return;
+
+	set_task_runnable(rq, p);
+
+	/*
+	 * Tasks which were kept by balance() or preempted by a higher class
+	 * with slice left go back to the head of the local DSQ. Everyone else
+	 * used up its slice and is handed back to the BPF scheduler.
+	 */
+	if ((p->scx.flags & SCX_TASK_BAL_KEEP) || p->scx.slice) {
+		p->scx.flags &= ~SCX_TASK_BAL_KEEP;
+		dispatch_enqueue(&rq->scx.local_dsq, p, SCX_ENQ_HEAD);
+		return;
+	}
+
+	do_enqueue_task(rq, p, 0);
+}
+
+static struct task_struct *pick_next_task_scx(struct rq *rq)
+{
+	struct task_struct *p;
+
+#ifndef CONFIG_SMP
+	/* UP doesn't call balance() */
+	if (!rq->scx.local_dsq.nr)
+		balance_one(rq, NULL);
+#endif
+
+	p = first_local_task(rq);
+	if (!p)
+		return NULL;
+
+	set_next_task_scx(rq, p, true);
+	return p;
+}
+
+static s32 scx_select_cpu_dfl(struct task_struct *p, s32 prev_cpu,
+			      u64 wake_flags)
+{
+	s32 cpu;
+
+	if (cpumask_test_cpu(prev_cpu, p->cpus_ptr) && idle_cpu(prev_cpu))
+		return prev_cpu;
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_online_mask) {
+		if (idle_cpu(cpu))
+			return cpu;
+	}
+
+	return prev_cpu;
+}
+
+#ifdef CONFIG_SMP
+static struct task_struct *pick_task_scx(struct rq *rq)
+{
+	return first_local_task(rq);
+}
+
+static int select_task_rq_scx(struct task_struct *p, int prev_cpu,
+			      int wake_flags)
+{
+	s32 cpu;
+
+	if (!SCX_HAS_OP(select_cpu) || scx_ops_bypassing())
+		return scx_select_cpu_dfl(p, prev_cpu, wake_flags);
+
+	cpu = scx_ops.select_cpu(p, prev_cpu, wake_flags);
+	if (unlikely(cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu))) {
+		scx_ops_error("select_cpu returned invalid cpu %d", cpu);
+		return prev_cpu;
+	}
+	return cpu;
+}
+#endif
+
+static void task_tick_scx(struct rq *rq, struct task_struct *curr, int queued)
+{
+	unsigned long last_check = READ_ONCE(scx_watchdog_timestamp);
+
+	update_curr_scx(rq);
+
+	/* the watchdog work may itself be starved by the BPF scheduler */
+	if (unlikely(time_after(jiffies, last_check + scx_watchdog_timeout))) {
+		u32 dur_ms = jiffies_to_msecs(jiffies - last_check);
+
+		scx_ops_error_kind(SCX_EXIT_ERROR_STALL,
+				   "watchdog failed to check in for %u.%03us",
+				   dur_ms / 1000, dur_ms % 1000);
+	}
+
+	if (!curr->scx.slice)
+		resched_curr(rq);
+}
+
+static void task_dead_scx(struct task_struct *p)
+{
+	scx_exit_task(p);
+}
+
+static void switched_from_scx(struct rq *rq, struct task_struct *p)
+{
+	scx_exit_task(p);
+}
+
+static void switched_to_scx(struct rq *rq, struct task_struct *p) {}
+static void prio_changed_scx(struct rq *rq, struct task_struct *p, int oldprio) {}
+
+static unsigned int get_rr_interval_scx(struct rq *rq, struct task_struct *p)
+{
+	return NS_TO_JIFFIES(p->scx.slice ?: SCX_SLICE_DFL);
+}
+
+/*
+ * Ordered below the fair class: the BPF scheduler only gets to run what the
+ * fair class leaves, and switched tasks are no longer on the fair class.
+ */
+DEFINE_SCHED_CLASS(ext) = {
+	.enqueue_task		= enqueue_task_scx,
+	.dequeue_task		= dequeue_task_scx,
+	.yield_task		= yield_task_scx,
+
+	.check_preempt_curr	= check_preempt_curr_scx,
+
+	.pick_next_task		= pick_next_task_scx,
+
+	.put_prev_task		= put_prev_task_scx,
+	.set_next_task		= set_next_task_scx,
+
+#ifdef CONFIG_SMP
+	.balance		= balance_scx,
+	.select_task_rq		= select_task_rq_scx,
+	.pick_task		= pick_task_scx,
+	.set_cpus_allowed	= set_cpus_allowed_common,
+#endif
+
+	.task_tick		= task_tick_scx,
+	.task_dead		= task_dead_scx,
+
+	.switched_from		= switched_from_scx,
+	.switched_to		= switched_to_scx,
+	.prio_changed		= prio_changed_scx,
+
+	.get_rr_interval	= get_rr_interval_scx,
+
+	.update_curr		= update_curr_scx,
+};
+
+void init_scx_entity(struct task_struct *p)
+{
+	memset(&p->scx, 0, sizeof(p->scx));
+	INIT_LIST_HEAD(&p->scx.dsq_node);
+	INIT_LIST_HEAD(&p->scx.runnable_node);
+	p->scx.slice = SCX_SLICE_DFL;
+}
+
+/*
+ * Watchdog: make sure that no task sits on a runqueue for longer than the
+ * timeout without getting to run.
+ */
+static bool check_rq_for_timeouts(struct rq *rq)
+{
+	struct task_struct *p;
+	struct rq_flags rf;
+	bool timed_out = false;
+
+	rq_lock_irqsave(rq, &rf);
+	p = list_first_entry_or_null(&rq->scx.runnable_list,
+				     struct task_struct, scx.runnable_node);
+	if (p && time_after(jiffies, p->scx.runnable_at + scx_watchdog_timeout)) {
+		u32 dur_ms = jiffies_to_msecs(jiffies - p->scx.runnable_at);
+
+		scx_ops_error_kind(SCX_EXIT_ERROR_STALL,
+				   "%s[%d] failed to run for %u.%03us",
+				   p->comm, p->pid,
+				   dur_ms / 1000, dur_ms % 1000);
+		timed_out = true;
+	}
+	rq_unlock_irqrestore(rq, &rf);
+
+	return timed_out;
+}
+
+static void scx_watchdog_workfn(struct work_struct *work)
+{
+	int cpu;
+
+	WRITE_ONCE(scx_watchdog_timestamp, jiffies);
+
+	for_each_online_cpu(cpu) {
+		if (unlikely(check_rq_for_timeouts(cpu_rq(cpu))))
+			break;
+		cond_resched();
+	}
+
+	queue_delayed_work(system_unbound_wq, to_delayed_work(work),
+			   scx_watchdog_timeout / 2);
+}
+
+static s32 create_dsq(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+	s32 ret;
+
+	if (dsq_id & SCX_DSQ_FLAG_BUILTIN)
+		return -EINVAL;
+
+	dsq = kmalloc(sizeof(*dsq), GFP_NOWAIT);
+	if (!dsq)
+		return -ENOMEM;
+
+	init_dsq(dsq, dsq_id);
+
+	ret = rhashtable_lookup_insert_fast(&dsq_hash, &dsq->hash_node,
+					    dsq_hash_params);
+	if (ret)
+		kfree(dsq);
+	return ret;
+}
+
+static void destroy_dsq(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+	unsigned long flags;
+
+	rcu_read_lock();
+
+	dsq = find_user_dsq(dsq_id);
+	if (!dsq)
+		goto out_unlock_rcu;
+
+	raw_spin_lock_irqsave(&dsq->lock, flags);
+
+	if (dsq->nr) {
+		scx_ops_error("attempting to destroy in-use DSQ 0x%016llx (nr=%u)",
+			      dsq->id, dsq->nr);
+		goto out_unlock_dsq;
+	}
+
+	if (rhashtable_remove_fast(&dsq_hash, &dsq->hash_node, dsq_hash_params))
+		goto out_unlock_dsq;
+
+	/* mark dead for dispatch_enqueue() racing through a stale lookup */
+	dsq->id = SCX_DSQ_INVALID;
+	kfree_rcu(dsq, rcu);
+
+out_unlock_dsq:
+	raw_spin_unlock_irqrestore(&dsq->lock, flags);
+out_unlock_rcu:
+	rcu_read_unlock();
+}
+
+static const char *scx_exit_reason(enum scx_exit_kind kind)
+{
+	switch (kind) {
+	case SCX_EXIT_UNREG:
+		return "BPF scheduler unregistered";
+	case SCX_EXIT_UNREG_BPF:
+		return "BPF scheduler requested exit";
+	case SCX_EXIT_ERROR:
+		return "runtime error";
+	case SCX_EXIT_ERROR_STALL:
+		return "runnable task stall";
+	default:
+		return "<UNKNOWN>";
+	}
+}
+
+static void scx_ops_disable_workfn(struct work_struct *work)
+{
+	struct scx_exit_info *ei = &scx_exit_info;
+	struct rhashtable_iter rht_iter;
+	struct scx_dispatch_q *dsq;
+	struct task_struct *g, *p;
+	int kind;
+
+	kind = atomic_read(&scx_exit_kind);
+	do {
+		if (kind == SCX_EXIT_DONE || kind == SCX_EXIT_NONE)
+			return;
+	} while (!atomic_try_cmpxchg(&scx_exit_kind, &kind, SCX_EXIT_DONE));
+
+	ei->kind = kind;
+	ei->reason = scx_exit_reason(kind);
+
+	mutex_lock(&scx_ops_enable_mutex);
+
+	if (WARN_ON_ONCE(scx_ops_set_enable_state(SCX_OPS_DISABLING) ==
+			 SCX_OPS_DISABLED)) {
+		scx_ops_set_enable_state(SCX_OPS_DISABLED);
+		goto out_unlock;
+	}
+
+	/*
+	 * All ops are called with preemption disabled. Once this returns,
+	 * everyone sees the bypass state and no more scheduling decisions are
+	 * made by the BPF scheduler.
+	 */
+	synchronize_rcu();
+
+	WRITE_ONCE(scx_switching_all, false);
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		if (p->sched_class == &ext_sched_class)
+			sched_reclass_task(p);
+	}
+	read_unlock(&tasklist_lock);
+
+	static_branch_disable(&__scx_ops_enabled);
+	cancel_delayed_work_sync(&scx_watchdog_work);
+
+	rhashtable_walk_enter(&dsq_hash, &rht_iter);
+	do {
+		rhashtable_walk_start(&rht_iter);
+
+		while ((dsq = rhashtable_walk_next(&rht_iter)) && !IS_ERR(dsq))
+			destroy_dsq(dsq->id);
+
+		rhashtable_walk_stop(&rht_iter);
+	} while (dsq == ERR_PTR(-EAGAIN));
+	rhashtable_walk_exit(&rht_iter);
+
+	if (SCX_HAS_OP(exit))
+		scx_ops.exit(ei);
+
+	if (ei->msg[0])
+		pr_err("sched_ext: BPF scheduler \"%s\" disabled (%s)\nsched_ext: %s\n",
+		       scx_ops.name, ei->reason, ei->msg);
+	else
+		pr_info("sched_ext: BPF scheduler \"%s\" disabled (%s)\n",
+			scx_ops.name, ei->reason);
+
+	WARN_ON_ONCE(scx_ops_set_enable_state(SCX_OPS_DISABLED) !=
+		     SCX_OPS_DISABLING);
+
+	/* dying tasks may still be calling ops.exit_task() */
+	synchronize_rcu();
+	memset(&scx_ops, 0, sizeof(scx_ops));
+
+out_unlock:
+	mutex_unlock(&scx_ops_enable_mutex);
+}
+
+static void scx_ops_error_irq_workfn(struct irq_work *irq_work)
+{
+	schedule_work(&scx_ops_disable_work);
+}
+
+static void scx_ops_disable(enum scx_exit_kind kind)
+{
+	scx_ops_error_kind(kind, "%s", "");
+	irq_work_sync(&scx_ops_error_irq_work);
+	flush_work(&scx_ops_disable_work);
+}
+
+static int scx_ops_enable(struct sched_ext_ops *ops)
+{
+	struct task_struct *g, *p;
+	int ret;
+
+	mutex_lock(&scx_ops_enable_mutex);
+
+	if (scx_ops_registered ||
+	    scx_ops_enable_state() != SCX_OPS_DISABLED) {
+		ret = -EBUSY;
+		goto err_unlock;
+	}
+
+	memset(&scx_exit_info, 0, sizeof(scx_exit_info));
+	atomic_set(&scx_exit_kind, SCX_EXIT_NONE);
+	scx_ops = *ops;
+	WARN_ON_ONCE(scx_ops_set_enable_state(SCX_OPS_ENABLING) !=
+		     SCX_OPS_DISABLED);
+
+	scx_watchdog_timeout = SCX_WATCHDOG_MAX_TIMEOUT;
+	if (ops->timeout_ms)
+		scx_watchdog_timeout = msecs_to_jiffies(ops->timeout_ms);
+
+	if (SCX_HAS_OP(init)) {
+		WRITE_ONCE(scx_ops_init_task, current);
+		ret = scx_ops.init();
+		WRITE_ONCE(scx_ops_init_task, NULL);
+		if (ret) {
+			scx_ops_error("ops.init() failed (%d)", ret);
+			goto err_disable;
+		}
+	}
+
+	WRITE_ONCE(scx_watchdog_timestamp, jiffies);
+	queue_delayed_work(system_unbound_wq, &scx_watchdog_work,
+			   scx_watchdog_timeout / 2);
+
+	WRITE_ONCE(scx_switching_all, !(ops->flags & SCX_OPS_SWITCH_PARTIAL));
+	static_branch_enable(&__scx_ops_enabled);
+
+	/*
+	 * Tasks forked from here on pick the new class in sched_fork(). The
+	 * ones which become visible only after this walk are fixed up by
+	 * scx_post_fork().
+	 */
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		if (p->sched_class == &fair_sched_class && task_should_scx(p))
+			sched_reclass_task(p);
+	}
+	read_unlock(&tasklist_lock);
+
+	/* an error while switching tasks leaves the disable work queued */
+	if (scx_ops_tryset_enable_state(SCX_OPS_ENABLED, SCX_OPS_ENABLING))
+		pr_info("sched_ext: BPF scheduler \"%s\" enabled\n",
+			scx_ops.name);
+
+	scx_ops_registered = true;
+	mutex_unlock(&scx_ops_enable_mutex);
+	return 0;
+
+err_disable:
+	mutex_unlock(&scx_ops_enable_mutex);
+	irq_work_sync(&scx_ops_error_irq_work);
+	flush_work(&scx_ops_disable_work);
+	return ret;
+
+err_unlock:
+	mutex_unlock(&scx_ops_enable_mutex);
+	return ret;
+}
+
+/*
+ * bpf_struct_ops glue.
+ */
+extern struct bpf_struct_ops bpf_sched_ext_ops;
+
+static const struct btf_type *task_struct_type;
+
+static bool bpf_scx_is_valid_access(int off, int size,
+				    enum bpf_access_type type,
+				    const struct bpf_prog *prog,
+				    struct bpf_insn_access_aux *info)
+{
+	if (type != BPF_READ)
+		return false;
+	if (off < 0 || off >= sizeof(__u64) * MAX_BPF_FUNC_ARGS)
+		return false;
+	if (off % size != 0)
+		return false;
+
+	return btf_ctx_access(off, size, type, prog, info);
+}
+
+static int bpf_scx_btf_struct_access(struct bpf_verifier_log *log,
+				     const struct bpf_reg_state *reg,
+				     int off, int size)
+{
+	const struct btf_type *t;
+
+	t = btf_type_by_id(reg->btf, reg->btf_id);
+	if (t == task_struct_type &&
+	    off >= offsetof(struct task_struct, scx.slice) &&
+	    off + size <= offsetofend(struct task_struct, scx.slice))
+		return 0;
+
+	bpf_log(log, "only p->scx.slice is writable\n");
+	return -EACCES;
+}
+
+static const struct bpf_func_proto *
+bpf_scx_get_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	switch (func_id) {
+	case BPF_FUNC_task_storage_get:
+		return &bpf_task_storage_get_proto;
+	case BPF_FUNC_task_storage_delete:
+		return &bpf_task_storage_delete_proto;
+	default:
+		return bpf_base_func_proto(func_id);
+	}
+}
+
+static const struct bpf_verifier_ops bpf_scx_verifier_ops = {
+	.get_func_proto		= bpf_scx_get_func_proto,
+	.is_valid_access	= bpf_scx_is_valid_access,
+	.btf_struct_access	= bpf_scx_btf_struct_access,
+};
+
+static int bpf_scx_init_member(const struct btf_type *t,
+			       const struct btf_member *member,
+			       void *kdata, const void *udata)
+{
+	const struct sched_ext_ops *uops = udata;
+	struct sched_ext_ops *ops = kdata;
+	u32 moff = __btf_member_bit_offset(t, member) / 8;
+
+	switch (moff) {
+	case offsetof(struct sched_ext_ops, flags):
+		if (uops->flags & ~SCX_OPS_ALL_FLAGS)
+			return -EINVAL;
+		ops->flags = uops->flags;
+		return 1;
+	case offsetof(struct sched_ext_ops, timeout_ms):
+		if (msecs_to_jiffies(uops->timeout_ms) > SCX_WATCHDOG_MAX_TIMEOUT)
+			return -E2BIG;
+		ops->timeout_ms = uops->timeout_ms;
+		return 1;
+	case offsetof(struct sched_ext_ops, name):
+		if (bpf_obj_name_cpy(ops->name, uops->name,
+				     sizeof(ops->name)) <= 0)
+			return -EINVAL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int bpf_scx_check_member(const struct btf_type *t,
+				const struct btf_member *member,
+				const struct bpf_prog *prog)
+{
+	return 0;
+}
+
+static int bpf_scx_reg(void *kdata)
+{
+	return scx_ops_enable(kdata);
+}
+
+static void bpf_scx_unreg(void *kdata)
+{
+	scx_ops_disable(SCX_EXIT_UNREG);
+
+	mutex_lock(&scx_ops_enable_mutex);
+	scx_ops_registered = false;
+	mutex_unlock(&scx_ops_enable_mutex);
+}
+
+static int bpf_scx_init(struct btf *btf)
+{
+	s32 type_id;
+
+	type_id = btf_find_by_name_kind(btf, "task_struct", BTF_KIND_STRUCT);
+	if (type_id < 0)
+		return -EINVAL;
+	task_struct_type = btf_type_by_id(btf, type_id);
+
+	return 0;
+}
+
+static int bpf_scx_update(void *kdata, void *old_kdata)
+{
+	/* a BPF scheduler can't be swapped out without going through fair */
+	return -EOPNOTSUPP;
+}
+
+static int bpf_scx_validate(void *kdata)
+{
+	return 0;
+}
+
+struct bpf_struct_ops bpf_sched_ext_ops = {
+	.verifier_ops = &bpf_scx_verifier_ops,
+	.reg = bpf_scx_reg,
+	.unreg = bpf_scx_unreg,
+	.check_member = bpf_scx_check_member,
+	.init_member = bpf_scx_init_member,
+	.init = bpf_scx_init,
+	.update = bpf_scx_update,
+	.validate = bpf_scx_validate,
+	.name = "sched_ext_ops",
+};
+
+/*
+ * kfuncs for the BPF scheduler.
+ */
+__diag_push();
+__diag_ignore_all("-Wmissing-prototypes",
+		  "Global kfuncs as their definitions will be in BTF");
+
+/**
+ * scx_bpf_create_dsq - Create a custom DSQ
+ * @dsq_id: DSQ to create, must be below %SCX_DSQ_FLAG_BUILTIN
+ * @node: NUMA node to allocate from, currently ignored
+ *
+ * Can only be called from ops.init().
+ */
+__bpf_kfunc s32 scx_bpf_create_dsq(u64 dsq_id, s32 node)
+{
+	if (READ_ONCE(scx_ops_init_task) != current)
+		return -EPERM;
+
+	return create_dsq(dsq_id);
+}
+
+/**
+ * scx_bpf_destroy_dsq - Destroy an empty custom DSQ
+ * @dsq_id: DSQ to destroy
+ */
+__bpf_kfunc void scx_bpf_destroy_dsq(u64 dsq_id)
+{
+	destroy_dsq(dsq_id);
+}
+
+/**
+ * scx_bpf_dispatch - Dispatch a task into a DSQ
+ * @p: task_struct to dispatch
+ * @dsq_id: DSQ to dispatch to
+ * @slice: duration @p can run for in nsecs, 0 for %SCX_SLICE_DFL
+ * @enq_flags: %SCX_ENQ_*
+ *
+ * Can only be called from ops.enqueue() and only for the task being enqueued.
+ * %SCX_DSQ_LOCAL is the local DSQ of the CPU @p is queued on.
+ */
+__bpf_kfunc void scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
+				  u64 enq_flags)
+{
+	if (unlikely(p != __this_cpu_read(scx_enq_task))) {
+		scx_ops_error("dispatching %s[%d] outside of its ops.enqueue()",
+			      p->comm, p->pid);
+		return;
+	}
+
+	if (unlikely(p->scx.dsq)) {
+		scx_ops_error("%s[%d] dispatched twice", p->comm, p->pid);
+		return;
+	}
+
+	p->scx.slice = slice ?: SCX_SLICE_DFL;
+	dispatch_enqueue(find_dsq_for_dispatch(task_rq(p), dsq_id, p), p,
+			 enq_flags & (SCX_ENQ_HEAD | SCX_ENQ_PREEMPT));
+}
+
+/**
+ * scx_bpf_consume - Transfer a task from a DSQ to the current CPU's local DSQ
+ * @dsq_id: DSQ to consume
+ *
+ * Can only be called from ops.dispatch(). Returns %true if a task has been
+ * moved, %false if there's nothing in @dsq which can run on this CPU.
+ */
+__bpf_kfunc bool scx_bpf_consume(u64 dsq_id)
+{
+	struct rq *rq = __this_cpu_read(scx_dsp_rq);
+	struct scx_dispatch_q *dsq;
+
+	if (unlikely(!rq)) {
+		scx_ops_error("scx_bpf_consume() called outside of ops.dispatch()");
+		return false;
+	}
+
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		dsq = &scx_dsq_global;
+	else
+		dsq = find_user_dsq(dsq_id);
+
+	if (unlikely(!dsq)) {
+		scx_ops_error("invalid DSQ ID 0x%016llx", dsq_id);
+		return false;
+	}
+
+	return consume_dispatch_q(rq, dsq);
+}
+
+/**
+ * scx_bpf_dsq_nr_queued - Return the number of queued tasks
+ * @dsq_id: id of the DSQ
+ *
+ * %SCX_DSQ_LOCAL refers to the current CPU's local DSQ. Returns -%ENOENT if
+ * @dsq_id doesn't exist.
+ */
+__bpf_kfunc s32 scx_bpf_dsq_nr_queued(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+	s32 ret;
+
+	if (dsq_id == SCX_DSQ_LOCAL)
+		return READ_ONCE(this_rq()->scx.local_dsq.nr);
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		return READ_ONCE(scx_dsq_global.nr);
+
+	rcu_read_lock();
+	dsq = find_user_dsq(dsq_id);
+	ret = dsq ? READ_ONCE(dsq->nr) : -ENOENT;
+	rcu_read_unlock();
+
+	return ret;
+}
+
+/**
+ * scx_bpf_kick_cpu - Trigger reschedule on a CPU
+ * @cpu: cpu to kick
+ * @flags: reserved, must be zero
+ *
+ * Make @cpu go through the scheduler, e.g. to wake it up from idle so that it
+ * calls ops.dispatch().
+ */
+__bpf_kfunc void scx_bpf_kick_cpu(s32 cpu, u64 flags)
+{
+	if (unlikely(cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu))) {
+		scx_ops_error("invalid cpu %d", cpu);
+		return;
+	}
+
+	scx_kick_cpu(cpu);
+}
+
+/**
+ * scx_bpf_select_cpu_dfl - The default implementation of ops.select_cpu()
+ * @p: task_struct to select a CPU for
+ * @prev_cpu: CPU @p was on previously
+ * @wake_flags: %WF_* flags
+ *
+ * Returns @prev_cpu if it's idle, else the first idle CPU @p may run on,
+ * else @prev_cpu.
+ */
+__bpf_kfunc s32 scx_bpf_select_cpu_dfl(struct task_struct *p, s32 prev_cpu,
+				       u64 wake_flags)
+{
+	return scx_select_cpu_dfl(p, prev_cpu, wake_flags);
+}
+
+/**
+ * scx_bpf_exit - Gracefully disable the BPF scheduler
+ * @exit_code: passed to ops.exit() in &scx_exit_info.exit_code
+ */
+__bpf_kfunc void scx_bpf_exit(s64 exit_code)
+{
+	scx_ops_exit_kind(SCX_EXIT_UNREG_BPF, exit_code, "%s", "");
+}
+
+__diag_pop();
+
+BTF_SET8_START(scx_kfunc_ids)
+BTF_ID_FLAGS(func, scx_bpf_create_dsq)
+BTF_ID_FLAGS(func, scx_bpf_destroy_dsq)
+BTF_ID_FLAGS(func, scx_bpf_dispatch, KF_RCU)
+BTF_ID_FLAGS(func, scx_bpf_consume)
+BTF_ID_FLAGS(func, scx_bpf_dsq_nr_queued)
+BTF_ID_FLAGS(func, scx_bpf_kick_cpu)
+BTF_ID_FLAGS(func, scx_bpf_select_cpu_dfl, KF_RCU)
+BTF_ID_FLAGS(func, scx_bpf_exit)
+BTF_SET8_END(scx_kfunc_ids)
+
+static const struct btf_kfunc_id_set scx_kfunc_set = {
+	.owner	= THIS_MODULE,
+	.set	= &scx_kfunc_ids,
+};
+
+static int __init scx_init(void)
+{
+	return register_btf_kfunc_id_set(BPF_PROG_TYPE_STRUCT_OPS,
+					 &scx_kfunc_set);
+}
+__initcall(scx_init);
+
+void __init init_sched_ext_class(void)
+{
+	int cpu;
+
+	init_dsq(&scx_dsq_global, SCX_DSQ_GLOBAL);
+	BUG_ON(rhashtable_init(&dsq_hash, &dsq_hash_params));
+	INIT_DELAYED_WORK(&scx_watchdog_work, scx_watchdog_workfn);
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		init_dsq(&rq->scx.local_dsq, SCX_DSQ_LOCAL);
+		INIT_LIST_HEAD(&rq->scx.runnable_list);
+		BUG_ON(!zalloc_cpumask_var(&rq->scx.cpus_to_kick, GFP_KERNEL));
+		rq->scx.kick_cpus_irq_work =
+			IRQ_WORK_INIT_HARD(kick_cpus_irq_workfn);
+	}
+}
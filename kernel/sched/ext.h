@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF extensible scheduler class: Documentation is in kernel/sched/ext.c
+ */
+#ifndef _KERNEL_SCHED_EXT_H
+#define _KERNEL_SCHED_EXT_H
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+
+DECLARE_STATIC_KEY_FALSE(__scx_ops_enabled);
+#define scx_enabled()		static_branch_unlikely(&__scx_ops_enabled)
+
+bool task_should_scx(struct task_struct *p);
+void init_scx_entity(struct task_struct *p);
+void init_sched_ext_class(void);
+
+static inline bool task_on_scx(const struct task_struct *p)
+{
+	return scx_enabled() && p->sched_class == &ext_sched_class;
+}
+
+/*
+ * The BPF scheduler may have been enabled or disabled between sched_fork()
+ * picking @p's class and @p becoming visible to the task iteration which
+ * switches everyone over. Fix it up once @p is on the tasklist.
+ */
+static inline void scx_post_fork(struct task_struct *p)
+{
+	const struct sched_class *class = p->sched_class;
+
+	if (class != &fair_sched_class && class != &ext_sched_class)
+		return;
+
+	if ((class == &ext_sched_class) != task_should_scx(p))
+		sched_reclass_task(p);
+}
+
+#else	/* CONFIG_SCHED_CLASS_EXT */
+
+#define scx_enabled()		false
+
+static inline bool task_should_scx(struct task_struct *p) { return false; }
+static inline void init_scx_entity(struct task_struct *p) {}
+static inline void init_sched_ext_class(void) {}
+static inline bool task_on_scx(const struct task_struct *p) { return false; }
+static inline void scx_post_fork(struct task_struct *p) {}
+
+#endif	/* CONFIG_SCHED_CLASS_EXT */
+#endif	/* _KERNEL_SCHED_EXT_H */
@@ -1183,6 +1183,12 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cgroup_account_cputime(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+
+		/*
+		 * Fair tasks running on their own, not only through the
+		 * fair server, count against its guarantee.
+		 */
+		dl_server_update(&rq_of(cfs_rq)->fair_server, delta_exec);
 	}
 
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
@@ -1190,7 +1196,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 static void update_curr_fair(struct rq *rq)
 {
-	update_curr(cfs_rq_of(&rq->curr->se));
+	update_curr(cfs_rq_of(&rq->donor->se));
 }
 
 static inline void
@@ -1788,8 +1794,32 @@ static int numa_hint_fault_latency(struct page *page)
  * For memory tiering mode, too high promotion/demotion throughput may
  * hurt application latency.  So we provide a mechanism to rate limit
  * the number of pages that are tried to be promoted.
+ *
+ * The limit is applied on both ends of the migration: the target node
+ * caps how much it takes in, and the source node caps how much leaves
+ * it, so a single slow node (and the link behind it) cannot be drained
+ * faster than the limit even when several fast nodes pull from it.
  */
+static bool numa_promotion_src_rate_limit(struct pglist_data *pgdat,
+					  unsigned long rate_limit, int nr)
+{
+	unsigned long nr_cand;
+	unsigned int now, start;
+
+	now = jiffies_to_msecs(jiffies);
+	mod_node_page_state(pgdat, PGPROMOTE_SRC_CANDIDATE, nr);
+	nr_cand = node_page_state(pgdat, PGPROMOTE_SRC_CANDIDATE);
+	start = pgdat->nbp_src_rl_start;
+	if (now - start > MSEC_PER_SEC &&
+	    cmpxchg(&pgdat->nbp_src_rl_start, start, now) == start)
+		pgdat->nbp_src_rl_nr_cand = nr_cand;
+	if (nr_cand - pgdat->nbp_src_rl_nr_cand >= rate_limit)
+		return true;
+	return false;
+}
+
 static bool numa_promotion_rate_limit(struct pglist_data *pgdat,
+				      struct pglist_data *src_pgdat,
 				      unsigned long rate_limit, int nr)
 {
 	unsigned long nr_cand;
@@ -1804,7 +1834,7 @@ static bool numa_promotion_rate_limit(struct pglist_data *pgdat,
 		pgdat->nbp_rl_nr_cand = nr_cand;
 	if (nr_cand - pgdat->nbp_rl_nr_cand >= rate_limit)
 		return true;
-	return false;
+	return numa_promotion_src_rate_limit(src_pgdat, rate_limit, nr);
 }
 
 #define NUMA_MIGRATION_ADJUST_STEPS	16
@@ -1870,8 +1900,8 @@ bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 		if (latency >= th)
 			return false;
 
-		return !numa_promotion_rate_limit(pgdat, rate_limit,
-						  thp_nr_pages(page));
+		return !numa_promotion_rate_limit(pgdat, NODE_DATA(src_nid),
+						  rate_limit, thp_nr_pages(page));
 	}
 
 	this_cpupid = cpu_pid_to_cpupid(dst_cpu, current->pid);
@@ -5634,6 +5664,9 @@ static bool throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	/* At this point se is NULL and we are at root level*/
 	sub_nr_running(rq, task_delta);
 
+	if (!rq->cfs.h_nr_running)
+		dl_server_stop(&rq->fair_server);
+
 done:
 	/*
 	 * Note: distribution will already see us throttled via the
@@ -5724,6 +5757,9 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 	/* At this point se is NULL and we are at root level*/
 	add_nr_running(rq, task_delta);
 
+	if (rq->cfs.h_nr_running)
+		dl_server_start(&rq->fair_server);
+
 unthrottle_throttle:
 	assert_list_leaf_cfs_rq(rq);
 
@@ -6448,7 +6484,7 @@ static void hrtick_start_fair(struct rq *rq, struct task_struct *p)
  */
 static void hrtick_update(struct rq *rq)
 {
-	struct task_struct *curr = rq->curr;
+	struct task_struct *curr = rq->donor;
 
 	if (!hrtick_enabled_fair(rq) || curr->sched_class != &fair_sched_class)
 		return;
@@ -6570,6 +6606,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	/* At this point se is NULL and we are at root level*/
 	add_nr_running(rq, 1);
 
+	dl_server_start(&rq->fair_server);
+
 	/*
 	 * Since new tasks are assigned an initial util_avg equal to
 	 * half of the spare capacity of their CPU, tiny tasks have the
@@ -6661,6 +6699,9 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	/* At this point se is NULL and we are at root level*/
 	sub_nr_running(rq, 1);
 
+	if (!rq->cfs.h_nr_running)
+		dl_server_stop(&rq->fair_server);
+
 	/* balance early to pull high priority tasks */
 	if (unlikely(!was_sched_idle && sched_idle_rq(rq)))
 		rq->next_balance = jiffies;
@@ -8054,7 +8095,7 @@ static void set_next_buddy(struct sched_entity *se)
  */
 static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_flags)
 {
-	struct task_struct *curr = rq->curr;
+	struct task_struct *curr = rq->donor;
 	struct sched_entity *se = &curr->se, *pse = &p->se;
 	struct cfs_rq *cfs_rq = task_cfs_rq(curr);
 	int next_buddy_marked = 0;
@@ -8315,6 +8356,72 @@ static struct task_struct *__pick_next_task_fair(struct rq *rq)
 	return pick_next_task_fair(rq, NULL, NULL);
 }
 
+/*
+ * The fair server guarantees fair tasks whatever sched_rt_runtime_us leaves
+ * of every sched_rt_period_us, in place of throttling RT tasks. Being
+ * deferred, it only preempts RT tasks if fair tasks didn't get that much
+ * on their own.
+ */
+static bool fair_server_has_tasks(struct sched_dl_entity *dl_se)
+{
+	return !!dl_se->rq->cfs.nr_running;
+}
+
+static struct task_struct *fair_server_pick_next(struct sched_dl_entity *dl_se)
+{
+	return pick_next_task_fair(dl_se->rq, NULL, NULL);
+}
+
+#ifdef CONFIG_SMP
+static struct task_struct *fair_server_pick_task(struct sched_dl_entity *dl_se)
+{
+	return pick_task_fair(dl_se->rq);
+}
+#else
+#define fair_server_pick_task	NULL
+#endif
+
+static void fair_server_params(u64 *runtime, u64 *period)
+{
+	*period = global_rt_period();
+	*runtime = 0;
+	if (global_rt_runtime() != RUNTIME_INF)
+		*runtime = *period - global_rt_runtime();
+}
+
+void fair_server_init(struct rq *rq)
+{
+	struct rq_flags rf;
+	u64 runtime, period;
+
+	dl_server_init(&rq->fair_server, rq, fair_server_has_tasks,
+		       fair_server_pick_next, fair_server_pick_task);
+
+	fair_server_params(&runtime, &period);
+	rq_lock_irqsave(rq, &rf);
+	dl_server_apply_params(&rq->fair_server, runtime, period);
+	rq_unlock_irqrestore(rq, &rf);
+}
+
+/* Called when sched_rt_{period,runtime}_us change. */
+void fair_server_apply_global(void)
+{
+	u64 runtime, period;
+	int cpu;
+
+	fair_server_params(&runtime, &period);
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+		struct rq_flags rf;
+
+		rq_lock_irqsave(rq, &rf);
+		update_rq_clock(rq);
+		dl_server_apply_params(&rq->fair_server, runtime, period);
+		rq_unlock_irqrestore(rq, &rf);
+	}
+}
+
 /*
  * Account for a descheduled task:
  */
@@ -8334,7 +8441,7 @@ static void put_prev_task_fair(struct rq *rq, struct task_struct *prev)
  */
 static void yield_task_fair(struct rq *rq)
 {
-	struct task_struct *curr = rq->curr;
+	struct task_struct *curr = rq->donor;
 	struct cfs_rq *cfs_rq = task_cfs_rq(curr);
 	struct sched_entity *se = &curr->se;
 
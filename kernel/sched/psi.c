@@ -153,6 +153,27 @@ static int __init setup_psi(char *str)
 }
 __setup("psi=", setup_psi);
 
+/*
+ * Lazy aggregation mode: task state changes only update the task's own
+ * cgroup and the system group. The pressure of the cgroup levels above is
+ * folded up through cgroup rstat when it is read, by the aggregation
+ * workers or a periodic flush from the system group.
+ *
+ * A parent's per-CPU stall time is approximated by the sum of its
+ * children's, clipped to the elapsed time, as overlapping stalls of
+ * different children cannot be told apart anymore.
+ */
+static DEFINE_STATIC_KEY_FALSE(psi_lazy);
+static bool psi_lazy_enable;
+static int __init setup_psi_lazy(char *str)
+{
+	return kstrtobool(str, &psi_lazy_enable) == 0;
+}
+__setup("psi_lazy=", setup_psi_lazy);
+
+/* Groups with RT polling triggers, which need to be kicked eagerly */
+static atomic_t psi_lazy_rtpoll_groups = ATOMIC_INIT(0);
+
 /* Running averages - we need to be higher-res than loadavg */
 #define PSI_FREQ	(2*HZ+1)	/* 2 sec intervals */
 #define EXP_10s		1677		/* 1/exp(2s/10s) as fixed-point */
@@ -213,11 +234,47 @@ void __init psi_init(void)
 
 	if (!cgroup_psi_enabled())
 		static_branch_disable(&psi_cgroups_enabled);
+	else if (psi_lazy_enable)
+		static_branch_enable(&psi_lazy);
 
 	psi_period = jiffies_to_nsecs(PSI_FREQ);
 	group_init(&psi_system);
 }
 
+#ifdef CONFIG_CGROUPS
+/* Is @group's pressure aggregated lazily from its subtree? */
+static inline bool psi_group_lazy(struct psi_group *group)
+{
+	return static_branch_unlikely(&psi_lazy) && group != &psi_system;
+}
+
+/* Fold @group's subtree and keep the folded times stable */
+static inline void psi_lazy_flush_hold(struct psi_group *group)
+{
+	cgroup_rstat_flush_hold(group->cgrp);
+}
+
+static inline void psi_lazy_flush_release(void)
+{
+	cgroup_rstat_flush_release();
+}
+#else
+static inline bool psi_group_lazy(struct psi_group *group) { return false; }
+static inline void psi_lazy_flush_hold(struct psi_group *group) { }
+static inline void psi_lazy_flush_release(void) { }
+#endif
+
+/*
+ * The next group to update on a task change. In lazy mode only the task's
+ * group and the system group are updated.
+ */
+static inline struct psi_group *psi_next_group(struct psi_group *group)
+{
+	if (static_branch_unlikely(&psi_lazy))
+		return group == &psi_system ? NULL : &psi_system;
+	return group->parent;
+}
+
 static bool test_state(unsigned int *tasks, enum psi_states state, bool oncpu)
 {
 	switch (state) {
@@ -249,6 +306,7 @@ static void get_recent_times(struct psi_group *group, int cpu,
 	struct psi_group_cpu *groupc = per_cpu_ptr(group->pcpu, cpu);
 	int current_cpu = raw_smp_processor_id();
 	unsigned int tasks[NR_PSI_TASK_COUNTS];
+	bool lazy = psi_group_lazy(group);
 	u64 now, state_start;
 	enum psi_states s;
 	unsigned int seq;
@@ -256,16 +314,26 @@ static void get_recent_times(struct psi_group *group, int cpu,
 
 	*pchanged_states = 0;
 
-	/* Snapshot a coherent view of the CPU state */
-	do {
-		seq = read_seqcount_begin(&groupc->seq);
-		now = cpu_clock(cpu);
-		memcpy(times, groupc->times, sizeof(groupc->times));
-		state_mask = groupc->state_mask;
-		state_start = groupc->state_start;
-		if (cpu == current_cpu)
-			memcpy(tasks, groupc->tasks, sizeof(groupc->tasks));
-	} while (read_seqcount_retry(&groupc->seq, seq));
+	if (lazy) {
+		/*
+		 * Folded by psi_rstat_flush() including the live states,
+		 * see collect_percpu_times().
+		 */
+		memcpy(times, groupc->lazy_times, sizeof(groupc->lazy_times));
+		state_mask = 0;
+		state_start = now = 0;
+	} else {
+		/* Snapshot a coherent view of the CPU state */
+		do {
+			seq = read_seqcount_begin(&groupc->seq);
+			now = cpu_clock(cpu);
+			memcpy(times, groupc->times, sizeof(groupc->times));
+			state_mask = groupc->state_mask;
+			state_start = groupc->state_start;
+			if (cpu == current_cpu)
+				memcpy(tasks, groupc->tasks, sizeof(groupc->tasks));
+		} while (read_seqcount_retry(&groupc->seq, seq));
+	}
 
 	/* Calculate state time deltas against the previous snapshot */
 	for (s = 0; s < NR_PSI_STATES; s++) {
@@ -296,12 +364,13 @@ static void get_recent_times(struct psi_group *group, int cpu,
 	 * this avgs_work is never IDLE, cause avgs_work can't be shut off.
 	 * So for the current CPU, we need to re-arm avgs_work only when
 	 * (NR_RUNNING > 1 || NR_IOWAIT > 0 || NR_MEMSTALL > 0), for other CPUs
-	 * we can just check PSI_NONIDLE delta.
+	 * we can just check PSI_NONIDLE delta. The worker never runs in the
+	 * subtree of a lazily aggregated group.
 	 */
 	if (current_work() == &group->avgs_work.work) {
 		bool reschedule;
 
-		if (cpu == current_cpu)
+		if (cpu == current_cpu && !lazy)
 			reschedule = tasks[NR_RUNNING] +
 				     tasks[NR_IOWAIT] +
 				     tasks[NR_MEMSTALL] > 1;
@@ -338,11 +407,15 @@ static void collect_percpu_times(struct psi_group *group,
 				 u32 *pchanged_states)
 {
 	u64 deltas[NR_PSI_STATES - 1] = { 0, };
+	bool lazy = psi_group_lazy(group);
 	unsigned long nonidle_total = 0;
 	u32 changed_states = 0;
 	int cpu;
 	int s;
 
+	if (lazy)
+		psi_lazy_flush_hold(group);
+
 	/*
 	 * Collect the per-cpu time buckets and average them into a
 	 * single time sample that is normalized to wallclock time.
@@ -367,6 +440,9 @@ static void collect_percpu_times(struct psi_group *group,
 			deltas[s] += (u64)times[s] * nonidle;
 	}
 
+	if (lazy)
+		psi_lazy_flush_release();
+
 	/*
 	 * Integrate the sample into the running statistics that are
 	 * reported to userspace: the cumulative stall times and the
@@ -571,6 +647,16 @@ static void psi_avgs_work(struct work_struct *work)
 	dwork = to_delayed_work(work);
 	group = container_of(dwork, struct psi_group, avgs_work);
 
+#ifdef CONFIG_CGROUPS
+	/*
+	 * In lazy mode, the system group's clock keeps the cgroup pressure
+	 * folded up, which also restarts the clocks of the cgroups with
+	 * activity.
+	 */
+	if (static_branch_unlikely(&psi_lazy) && group == &psi_system)
+		cgroup_rstat_flush(&cgrp_dfl_root.cgrp);
+#endif
+
 	mutex_lock(&group->avgs_lock);
 
 	now = sched_clock();
@@ -775,6 +861,92 @@ static void record_times(struct psi_group_cpu *groupc, u64 now)
 		groupc->times[PSI_NONIDLE] += delta;
 }
 
+#ifdef CONFIG_CGROUPS
+/*
+ * Mark @group's times to be folded into its ancestors, and kick their RT
+ * polling. The stall states of a cgroup are a subset of its ancestors'.
+ */
+static void psi_lazy_group_change(struct psi_group *group, int cpu,
+				  u32 state_mask)
+{
+	cgroup_rstat_updated(group->cgrp, cpu);
+
+	if (likely(!atomic_read(&psi_lazy_rtpoll_groups)))
+		return;
+
+	for (group = group->parent; group != &psi_system; group = group->parent) {
+		if (state_mask & group->rtpoll_states)
+			psi_schedule_rtpoll_work(group, 1, false);
+	}
+}
+
+/**
+ * psi_rstat_flush - fold lazily aggregated pressure into the parent
+ * @cgrp: cgroup to fold
+ * @cpu: CPU whose times to fold
+ *
+ * Called by cgroup rstat, for the children before their parents.
+ */
+void psi_rstat_flush(struct cgroup *cgrp, int cpu)
+{
+	struct psi_group *group = cgrp->psi;
+	struct psi_group_cpu *groupc;
+	u64 delta[NR_PSI_STATES];
+	u32 times[NR_PSI_STATES];
+	u64 now, state_start;
+	unsigned int seq;
+	u32 state_mask;
+	int s;
+
+	if (!static_branch_unlikely(&psi_lazy) || !group ||
+	    cgroup_psi(cgrp) == &psi_system)
+		return;
+
+	groupc = per_cpu_ptr(group->pcpu, cpu);
+
+	do {
+		seq = read_seqcount_begin(&groupc->seq);
+		now = cpu_clock(cpu);
+		memcpy(times, groupc->times, sizeof(groupc->times));
+		state_mask = groupc->state_mask;
+		state_start = groupc->state_start;
+	} while (read_seqcount_retry(&groupc->seq, seq));
+
+	for (s = 0; s < NR_PSI_STATES; s++) {
+		if (state_mask & (1 << s))
+			times[s] += now - state_start;
+
+		delta[s] = (u32)(times[s] - groupc->lazy_flushed[s]) +
+			   groupc->lazy_pending[s];
+		groupc->lazy_flushed[s] = times[s];
+		groupc->lazy_pending[s] = 0;
+	}
+
+	/* The subtree can't be stalled for longer than the time elapsed */
+	delta[PSI_NONIDLE] = min(delta[PSI_NONIDLE], now - groupc->lazy_last);
+	groupc->lazy_last = now;
+	for (s = 0; s < PSI_NONIDLE; s++)
+		delta[s] = min(delta[s], delta[PSI_NONIDLE]);
+	for (s = PSI_IO_SOME; s <= PSI_CPU_SOME; s += 2)
+		delta[s + 1] = min(delta[s + 1], delta[s]);
+
+	for (s = 0; s < NR_PSI_STATES; s++) {
+		groupc->lazy_times[s] += delta[s];
+		if (group->parent != &psi_system)
+			per_cpu_ptr(group->parent->pcpu, cpu)->lazy_pending[s] += delta[s];
+	}
+
+	/* Run the clock of every group with activity, as in eager mode */
+	if (delta[PSI_NONIDLE] && !delayed_work_pending(&group->avgs_work))
+		schedule_delayed_work(&group->avgs_work, PSI_FREQ);
+}
+#else
+static inline void psi_lazy_group_change(struct psi_group *group, int cpu,
+					 u32 state_mask)
+{
+}
+#endif
+
 static void psi_group_change(struct psi_group *group, int cpu,
 			     unsigned int clear, unsigned int set, u64 now,
 			     bool wake_clock)
@@ -874,6 +1046,9 @@ static void psi_group_change(struct psi_group *group, int cpu,
 
 	write_seqcount_end(&groupc->seq);
 
+	if (psi_group_lazy(group))
+		psi_lazy_group_change(group, cpu, state_mask);
+
 	if (state_mask & group->rtpoll_states)
 		psi_schedule_rtpoll_work(group, 1, false);
 
@@ -921,7 +1096,7 @@ void psi_task_change(struct task_struct *task, int clear, int set)
 	group = task_psi_group(task);
 	do {
 		psi_group_change(group, cpu, clear, set, now, true);
-	} while ((group = group->parent));
+	} while ((group = psi_next_group(group)));
 }
 
 void psi_task_switch(struct task_struct *prev, struct task_struct *next,
@@ -947,7 +1122,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 			}
 
 			psi_group_change(group, cpu, 0, TSK_ONCPU, now, true);
-		} while ((group = group->parent));
+		} while ((group = psi_next_group(group)));
 	}
 
 	if (prev->pid) {
@@ -985,7 +1160,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 			if (group == common)
 				break;
 			psi_group_change(group, cpu, clear, set, now, wake_clock);
-		} while ((group = group->parent));
+		} while ((group = psi_next_group(group)));
 
 		/*
 		 * TSK_ONCPU is handled up to the common ancestor. If there are
@@ -995,7 +1170,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 		 */
 		if ((prev->psi_flags ^ next->psi_flags) & ~TSK_ONCPU) {
 			clear &= ~TSK_ONCPU;
-			for (; group; group = group->parent)
+			for (; group; group = psi_next_group(group))
 				psi_group_change(group, cpu, clear, set, now, wake_clock);
 		}
 	}
@@ -1028,9 +1203,12 @@ void psi_account_irqtime(struct task_struct *task, u32 delta)
 
 		write_seqcount_end(&groupc->seq);
 
+		if (psi_group_lazy(group))
+			psi_lazy_group_change(group, cpu, 1 << PSI_IRQ_FULL);
+
 		if (group->rtpoll_states & (1 << PSI_IRQ_FULL))
 			psi_schedule_rtpoll_work(group, 1, false);
-	} while ((group = group->parent));
+	} while ((group = psi_next_group(group)));
 }
 #endif
 
@@ -1113,6 +1291,7 @@ int psi_cgroup_alloc(struct cgroup *cgroup)
 	}
 	group_init(cgroup->psi);
 	cgroup->psi->parent = cgroup_psi(cgroup_parent(cgroup));
+	cgroup->psi->cgrp = cgroup;
 	return 0;
 }
 
@@ -1126,6 +1305,7 @@ void psi_cgroup_free(struct cgroup *cgroup)
 	/* All triggers must be removed by now */
 	WARN_ONCE(cgroup->psi->rtpoll_states, "psi: trigger leak\n");
 	kfree(cgroup->psi);
+	cgroup->psi = NULL;
 }
 
 /**
@@ -1363,6 +1543,8 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group, char *buf,
 		group->rtpoll_min_period = min(group->rtpoll_min_period,
 			div_u64(t->win.size, UPDATES_PER_WINDOW));
 		group->rtpoll_nr_triggers[t->state]++;
+		if (!group->rtpoll_states)
+			atomic_inc(&psi_lazy_rtpoll_groups);
 		group->rtpoll_states |= (1 << t->state);
 
 		mutex_unlock(&group->rtpoll_trigger_lock);
@@ -1429,6 +1611,7 @@ void psi_trigger_destroy(struct psi_trigger *t)
 			}
 			/* Destroy rtpoll_task when the last trigger is destroyed */
 			if (group->rtpoll_states == 0) {
+				atomic_dec(&psi_lazy_rtpoll_groups);
 				group->rtpoll_until = 0;
 				task_to_destroy = rcu_dereference_protected(
 						group->rtpoll_task,
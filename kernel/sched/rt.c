@@ -3035,6 +3035,7 @@ static int sched_rt_handler(struct ctl_table *table, int write, void *buffer,
 
 		sched_rt_do_global();
 		sched_dl_do_global();
+		fair_server_apply_global();
 	}
 	if (0) {
 undo:
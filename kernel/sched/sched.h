@@ -184,7 +184,8 @@ static inline int idle_policy(int policy)
 }
 static inline int fair_policy(int policy)
 {
-	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH ||
+	       (IS_ENABLED(CONFIG_SCHED_CLASS_EXT) && policy == SCHED_EXT);
 }
 
 static inline int rt_policy(int policy)
@@ -286,6 +287,30 @@ struct rt_bandwidth {
 
 void __dl_clear_params(struct task_struct *p);
 
+/*
+ * Deadline servers: a sched_dl_entity which, rather than running a task of
+ * its own, runs the tasks of a lower class for up to dl_runtime every
+ * dl_period. They're deferred: a server only gets enqueued once the zero-
+ * laxity instant of its period is reached and its class still didn't get
+ * dl_runtime on its own.
+ *
+ * The owning class starts the server when it gets runnable tasks, stops it
+ * once it has none left, and charges the runtime of its tasks to it with
+ * dl_server_update().
+ */
+extern void dl_server_update(struct sched_dl_entity *dl_se, s64 delta_exec);
+extern void dl_server_start(struct sched_dl_entity *dl_se);
+extern void dl_server_stop(struct sched_dl_entity *dl_se);
+extern void dl_server_init(struct sched_dl_entity *dl_se, struct rq *rq,
+			   dl_server_has_tasks_f has_tasks,
+			   dl_server_pick_f pick_next,
+			   dl_server_pick_f pick_task);
+extern void dl_server_apply_params(struct sched_dl_entity *dl_se,
+				   u64 runtime, u64 period);
+
+extern void fair_server_init(struct rq *rq);
+extern void fair_server_apply_global(void);
+
 static inline int dl_bandwidth_enabled(void)
 {
 	return sysctl_sched_rt_runtime >= 0;
@@ -651,9 +676,18 @@ struct cfs_rq {
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 };
 
+/*
+ * Without RT group scheduling the root rt_rq isn't throttled: the fair
+ * server keeps RT tasks from starving fair tasks instead, see
+ * fair_server_init().
+ */
 static inline int rt_bandwidth_enabled(void)
 {
+#ifdef CONFIG_RT_GROUP_SCHED
 	return sysctl_sched_rt_runtime >= 0;
+#else
+	return 0;
+#endif
 }
 
 /* RT IPI pull logic requires IRQ_WORK */
@@ -765,6 +799,17 @@ struct dl_rq {
 	u64			bw_ratio;
 };
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+/* BPF extensible class' related fields in a runqueue */
+struct scx_rq {
+	struct scx_dispatch_q	local_dsq;
+	struct list_head	runnable_list;		/* runnable tasks, oldest first */
+	unsigned int		nr_running;
+	cpumask_var_t		cpus_to_kick;
+	struct irq_work		kick_cpus_irq_work;
+};
+#endif /* CONFIG_SCHED_CLASS_EXT */
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 /* An entity is a task if it doesn't "own" a runqueue */
 #define entity_is_task(se)	(!se->my_q)
@@ -998,6 +1043,10 @@ struct rq {
 	struct cfs_rq		cfs;
 	struct rt_rq		rt;
 	struct dl_rq		dl;
+	struct sched_dl_entity	fair_server;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	struct scx_rq		scx;
+#endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this CPU: */
@@ -1013,7 +1062,21 @@ struct rq {
 	 */
 	unsigned int		nr_uninterruptible;
 
+#ifdef CONFIG_SCHED_PROXY_EXEC
+	/*
+	 * With proxy execution a task blocked on a mutex may lend its
+	 * scheduling context (donor, what the sched class picked and
+	 * accounts to) to the mutex owner, which is what actually runs
+	 * (curr, the execution context).
+	 */
+	struct task_struct __rcu	*donor;
 	struct task_struct __rcu	*curr;
+#else
+	union {
+		struct task_struct __rcu	*donor;
+		struct task_struct __rcu	*curr;
+	};
+#endif
 	struct task_struct	*idle;
 	struct task_struct	*stop;
 	unsigned long		next_balance;
@@ -2133,10 +2196,51 @@ static inline int task_current(struct rq *rq, struct task_struct *p)
 	return rq->curr == p;
 }
 
+/*
+ * Is @p the scheduling context of @rq, i.e. the task its sched class considers
+ * running? Only differs from task_current() while proxying.
+ */
+static inline int task_current_donor(struct rq *rq, struct task_struct *p)
+{
+	return rq->donor == p;
+}
+
+#ifdef CONFIG_SCHED_PROXY_EXEC
+DECLARE_STATIC_KEY_TRUE(__sched_proxy_exec);
+
+static inline bool sched_proxy_exec(void)
+{
+	return static_branch_likely(&__sched_proxy_exec);
+}
+
+static inline void rq_set_donor(struct rq *rq, struct task_struct *t)
+{
+	rcu_assign_pointer(rq->donor, t);
+}
+
+static inline bool task_is_blocked(struct task_struct *p)
+{
+	return sched_proxy_exec() && READ_ONCE(p->blocked_mutex);
+}
+#else
+static inline bool sched_proxy_exec(void)
+{
+	return false;
+}
+
+static inline void rq_set_donor(struct rq *rq, struct task_struct *t) { }
+
+static inline bool task_is_blocked(struct task_struct *p)
+{
+	return false;
+}
+#endif
+
 static inline int task_on_cpu(struct rq *rq, struct task_struct *p)
 {
 #ifdef CONFIG_SMP
-	return p->on_cpu;
+	/* A proxy donor is still this CPU's scheduling context, keep it here */
+	return p->on_cpu || task_current_donor(rq, p);
 #else
 	return task_current(rq, p);
 #endif
@@ -2294,7 +2398,7 @@ struct sched_class {
 
 static inline void put_prev_task(struct rq *rq, struct task_struct *prev)
 {
-	WARN_ON_ONCE(rq->curr != prev);
+	WARN_ON_ONCE(rq->donor != prev);
 	prev->sched_class->put_prev_task(rq, prev);
 }
 
@@ -2335,6 +2439,7 @@ extern const struct sched_class stop_sched_class;
 extern const struct sched_class dl_sched_class;
 extern const struct sched_class rt_sched_class;
 extern const struct sched_class fair_sched_class;
+extern const struct sched_class ext_sched_class;
 extern const struct sched_class idle_sched_class;
 
 static inline bool sched_stop_runnable(struct rq *rq)
@@ -2515,6 +2620,11 @@ extern void deactivate_task(struct rq *rq, struct task_struct *p, int flags);
 
 extern void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags);
 
+extern void check_class_changed(struct rq *rq, struct task_struct *p,
+				const struct sched_class *prev_class,
+				int oldprio);
+extern void sched_reclass_task(struct task_struct *p);
+
 #ifdef CONFIG_PREEMPT_RT
 #define SCHED_NR_MIGRATE_BREAK 8
 #else
@@ -3528,4 +3638,6 @@ static inline void init_sched_mm_cid(struct task_struct *t) { }
 extern u64 avg_vruntime(struct cfs_rq *cfs_rq);
 extern int entity_eligible(struct cfs_rq *cfs_rq, struct sched_entity *se);
 
+#include "ext.h"
+
 #endif /* _KERNEL_SCHED_SCHED_H */
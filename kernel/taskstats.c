@@ -526,6 +526,61 @@ static int cmd_attr_pid(struct genl_info *info)
 	return rc;
 }
 
+/*
+ * Dump the stats of all the tasks of the caller's pid namespace, one
+ * TASKSTATS_CMD_NEW message per task. This saves the agents monitoring
+ * every task of the system a request, or a walk of /proc, per pid.
+ */
+static int taskstats_user_dump(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct user_namespace *user_ns = current_user_ns();
+	struct pid_namespace *pid_ns = task_active_pid_ns(current);
+	pid_t nr = cb->args[0];
+
+	for (;; nr++) {
+		struct task_struct *tsk = NULL;
+		struct taskstats *stats;
+		struct pid *pid;
+		void *reply;
+
+		rcu_read_lock();
+		pid = find_ge_pid(nr, pid_ns);
+		if (pid) {
+			nr = pid_nr_ns(pid, pid_ns);
+			tsk = pid_task(pid, PIDTYPE_PID);
+			if (tsk)
+				get_task_struct(tsk);
+		}
+		rcu_read_unlock();
+
+		if (!pid)
+			break;
+		if (!tsk)
+			continue;
+
+		reply = genlmsg_put(skb, NETLINK_CB(cb->skb).portid,
+				    cb->nlh->nlmsg_seq, &family, NLM_F_MULTI,
+				    TASKSTATS_CMD_NEW);
+		if (!reply) {
+			put_task_struct(tsk);
+			break;
+		}
+		stats = mk_reply(skb, TASKSTATS_TYPE_PID, nr);
+		if (!stats) {
+			genlmsg_cancel(skb, reply);
+			put_task_struct(tsk);
+			break;
+		}
+		fill_stats(user_ns, pid_ns, tsk, stats);
+		put_task_struct(tsk);
+		genlmsg_end(skb, reply);
+	}
+
+	/* Resume from the task which did not fit, if any */
+	cb->args[0] = nr;
+	return skb->len;
+}
+
 static int cmd_attr_tgid(struct genl_info *info)
 {
 	struct taskstats *stats;
@@ -669,6 +724,7 @@ static const struct genl_ops taskstats_ops[] = {
 		.cmd		= TASKSTATS_CMD_GET,
 		.validate = GENL_DONT_VALIDATE_STRICT | GENL_DONT_VALIDATE_DUMP,
 		.doit		= taskstats_user_cmd,
+		.dumpit		= taskstats_user_dump,
 		.policy		= taskstats_cmd_get_policy,
 		.maxattr	= ARRAY_SIZE(taskstats_cmd_get_policy) - 1,
 		.flags		= GENL_ADMIN_PERM,
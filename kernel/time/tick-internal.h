@@ -166,6 +166,27 @@ DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
 void timer_clear_idle(void);
 
+#ifdef CONFIG_TIMER_MIGRATION
+extern u64 get_jiffies_update(unsigned long *basej);
+extern void timer_expire_remote(unsigned int cpu);
+extern void timer_lock_remote_base(unsigned int cpu);
+extern void timer_unlock_remote_base(unsigned int cpu);
+extern u64 fetch_next_timer_interrupt_remote(unsigned long basej, u64 basem,
+					     unsigned int cpu);
+
+extern void tmigr_handle_remote(void);
+extern bool tmigr_requires_handle_remote(void);
+extern void tmigr_cpu_activate(void);
+extern u64 tmigr_cpu_deactivate(u64 nextevt);
+extern bool tmigr_cpu_is_idle(unsigned int cpu);
+#else
+static inline void tmigr_handle_remote(void) { }
+static inline bool tmigr_requires_handle_remote(void) { return false; }
+static inline void tmigr_cpu_activate(void) { }
+static inline u64 tmigr_cpu_deactivate(u64 nextevt) { return nextevt; }
+static inline bool tmigr_cpu_is_idle(unsigned int cpu) { return false; }
+#endif
+
 #define CLOCK_SET_WALL							\
 	(BIT(HRTIMER_BASE_REALTIME) | BIT(HRTIMER_BASE_REALTIME_SOFT) |	\
 	 BIT(HRTIMER_BASE_TAI) | BIT(HRTIMER_BASE_TAI_SOFT))
@@ -181,18 +181,22 @@ EXPORT_SYMBOL(jiffies_64);
 #define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
 
 /*
- * The resulting wheel size. If NOHZ is configured we allocate two
- * wheels so we have a separate storage for the deferrable timers.
+ * The resulting wheel size. If NOHZ is configured we allocate three
+ * wheels: pinned timers, which are always expired by their CPU, non pinned
+ * timers, which an idle CPU hands over to the timer migration hierarchy,
+ * and deferrable timers.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 #ifdef CONFIG_NO_HZ_COMMON
-# define NR_BASES	2
-# define BASE_STD	0
-# define BASE_DEF	1
+# define NR_BASES	3
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
 #else
 # define NR_BASES	1
-# define BASE_STD	0
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -228,6 +232,11 @@ static unsigned int sysctl_timer_migration = 1;
 
 DEFINE_STATIC_KEY_FALSE(timers_migration_enabled);
 
+static inline bool is_timers_migration_enabled(void)
+{
+	return static_branch_likely(&timers_migration_enabled);
+}
+
 static void timers_update_migration(void)
 {
 	if (sysctl_timer_migration && tick_nohz_active)
@@ -271,6 +280,7 @@ static int __init timer_sysctl_init(void)
 device_initcall(timer_sysctl_init);
 #endif /* CONFIG_SYSCTL */
 #else /* CONFIG_SMP */
+static inline bool is_timers_migration_enabled(void) { return false; }
 static inline void timers_update_migration(void) { }
 #endif /* !CONFIG_SMP */
 
@@ -587,10 +597,17 @@ trigger_dyntick_cpu(struct timer_base *base, struct timer_list *timer)
 	/*
 	 * We might have to IPI the remote CPU if the base is idle and the
 	 * timer is not deferrable. If the other CPU is on the way to idle
-	 * then it can't set base->is_idle as we hold the base lock:
+	 * then it can't set base->is_idle as we hold the base lock.
+	 *
+	 * A non pinned timer only ends up on a remote idle base when it was
+	 * running while being queued, i.e. it is being expired by the timer
+	 * migration hierarchy, which picks up the new expiry afterwards.
 	 */
-	if (base->is_idle)
+	if (base->is_idle) {
+		if (!(timer->flags & TIMER_PINNED) && tmigr_cpu_is_idle(base->cpu))
+			return;
 		wake_up_nohz_cpu(base->cpu);
+	}
 }
 
 /*
@@ -900,30 +917,28 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 	return 1;
 }
 
-static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
+static inline unsigned int timer_base_index(u32 tflags)
 {
-	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_STD], cpu);
-
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
+	 * to use the deferrable base. Otherwise pinned timers go to the
+	 * local base and everything else to the global one.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = per_cpu_ptr(&timer_bases[BASE_DEF], cpu);
-	return base;
+		return BASE_DEF;
+	if (tflags & TIMER_PINNED)
+		return BASE_LOCAL;
+	return BASE_GLOBAL;
 }
 
-static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
+static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	return per_cpu_ptr(&timer_bases[timer_base_index(tflags)], cpu);
+}
 
-	/*
-	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
-	 */
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = this_cpu_ptr(&timer_bases[BASE_DEF]);
-	return base;
+static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
+{
+	return this_cpu_ptr(&timer_bases[timer_base_index(tflags)]);
 }
 
 static inline struct timer_base *get_timer_base(u32 tflags)
@@ -931,14 +946,14 @@ static inline struct timer_base *get_timer_base(u32 tflags)
 	return get_timer_cpu_base(tflags, tflags & TIMER_CPUMASK);
 }
 
+/*
+ * Timers are always queued on the local CPU. Non pinned timers of a CPU
+ * which goes idle are pulled by the timer migration hierarchy instead of
+ * being pushed to a busy CPU at enqueue time.
+ */
 static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
-#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
-	if (static_branch_likely(&timers_migration_enabled) &&
-	    !(tflags & TIMER_PINNED))
-		return get_timer_cpu_base(tflags, get_nohz_timer_target());
-#endif
 	return get_timer_this_cpu_base(tflags);
 }
 
@@ -1264,6 +1279,10 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	if (WARN_ON_ONCE(timer_pending(timer)))
 		return;
 
+	/* The timer must stay on @cpu, do not let it be migrated */
+	if (!(timer->flags & TIMER_PINNED))
+		timer->flags |= TIMER_PINNED;
+
 	new_base = get_timer_cpu_base(timer->flags, cpu);
 
 	/*
@@ -1910,6 +1929,39 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
 	return DIV_ROUND_UP_ULL(nextevt, TICK_NSEC) * TICK_NSEC;
 }
 
+/*
+ * Recalculate the next expiry of @base if needed, forward its clock and
+ * return the expiry as clock monotonic time, KTIME_MAX if no timer is
+ * pending. Called with @base->lock held.
+ */
+static u64 next_timer_event(struct timer_base *base, unsigned long basej,
+			    u64 basem)
+{
+	unsigned long nextevt;
+
+	if (base->next_expiry_recalc)
+		base->next_expiry = __next_timer_interrupt(base);
+	nextevt = base->next_expiry;
+
+	/*
+	 * We have a fresh next event. Check whether we can forward the
+	 * base. We can only do that when @basej is past base->clk
+	 * otherwise we might rewind base->clk.
+	 */
+	if (time_after(basej, base->clk)) {
+		if (time_after(nextevt, basej))
+			base->clk = basej;
+		else if (time_after(nextevt, base->clk))
+			base->clk = nextevt;
+	}
+
+	if (time_before_eq(nextevt, basej))
+		return basem;
+	if (!base->timers_pending)
+		return KTIME_MAX;
+	return basem + (u64)(nextevt - basej) * TICK_NSEC;
+}
+
 /**
  * get_next_timer_interrupt - return the time (clock mono) of the next timer
  * @basej:	base time jiffies
@@ -1917,54 +1969,52 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
  *
  * Returns the tick aligned clock monotonic time of the next pending
  * timer or KTIME_MAX if no timer is pending.
+ *
+ * If the CPU is about to sleep for more than a tick, its non pinned timers
+ * are handed over to the timer migration hierarchy, which expires them
+ * from a busy CPU. The returned time then only covers the pinned timers,
+ * unless this CPU is the last one going idle and has to wake up for the
+ * first global event of the hierarchy.
  */
 u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-	u64 expires = KTIME_MAX;
-	unsigned long nextevt;
+	struct timer_base *base_local, *base_global;
+	u64 expires, tevt_local, tevt_global;
 
 	/*
 	 * Pretend that there is no timer pending if the cpu is offline.
 	 * Possible pending timers will be migrated later to an active cpu.
 	 */
 	if (cpu_is_offline(smp_processor_id()))
-		return expires;
+		return KTIME_MAX;
 
-	raw_spin_lock(&base->lock);
-	if (base->next_expiry_recalc)
-		base->next_expiry = __next_timer_interrupt(base);
-	nextevt = base->next_expiry;
+	base_local = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+
+	tevt_local = next_timer_event(base_local, basej, basem);
+	tevt_global = next_timer_event(base_global, basej, basem);
+	expires = min(tevt_local, tevt_global);
 
 	/*
-	 * We have a fresh next event. Check whether we can forward the
-	 * base. We can only do that when @basej is past base->clk
-	 * otherwise we might rewind base->clk.
+	 * If we expect to sleep more than a tick, mark the base idle.
+	 * Also the tick is stopped so any added timer must forward
+	 * the base clk itself to keep granularity small. This idle
+	 * logic is only maintained for the local and global bases,
+	 * deferrable timers may still see large granularity skew (by
+	 * design).
 	 */
-	if (time_after(basej, base->clk)) {
-		if (time_after(nextevt, basej))
-			base->clk = basej;
-		else if (time_after(nextevt, base->clk))
-			base->clk = nextevt;
-	}
+	base_local->is_idle = (expires - basem) > TICK_NSEC;
 
-	if (time_before_eq(nextevt, basej)) {
-		expires = basem;
-		base->is_idle = false;
-	} else {
-		if (base->timers_pending)
-			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
-		/*
-		 * If we expect to sleep more than a tick, mark the base idle.
-		 * Also the tick is stopped so any added timer must forward
-		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
-		 */
-		if ((expires - basem) > TICK_NSEC)
-			base->is_idle = true;
-	}
-	raw_spin_unlock(&base->lock);
+	if (base_local->is_idle && is_timers_migration_enabled())
+		expires = min(tevt_local, tmigr_cpu_deactivate(tevt_global));
+
+	base_global->is_idle = base_local->is_idle;
+
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
@@ -1976,15 +2026,17 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
 	 * We do this unlocked. The worst outcome is a remote enqueue sending
 	 * a pointless IPI, but taking the lock would just make the window for
 	 * sending the IPI a few instructions smaller for the cost of taking
 	 * the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	__this_cpu_write(timer_bases[BASE_LOCAL].is_idle, false);
+	__this_cpu_write(timer_bases[BASE_GLOBAL].is_idle, false);
+
+	/* Take the global timers back from the hierarchy */
+	tmigr_cpu_activate();
 }
 #endif
 
@@ -2003,6 +2055,15 @@ static inline void __run_timers(struct timer_base *base)
 	timer_base_lock_expiry(base);
 	raw_spin_lock_irq(&base->lock);
 
+	/*
+	 * The global base of an idle CPU can be expired remotely by the
+	 * timer migration hierarchy while the CPU itself handles a tick.
+	 * Whoever runs a callback already is in the expiry loop below and
+	 * will process everything that is due.
+	 */
+	if (base->running_timer)
+		goto unlock;
+
 	while (time_after_eq(jiffies, base->clk) &&
 	       time_after_eq(jiffies, base->next_expiry)) {
 		levels = collect_expired_timers(base, heads);
@@ -2021,20 +2082,71 @@ static inline void __run_timers(struct timer_base *base)
 		while (levels--)
 			expire_timers(base, heads + levels);
 	}
+unlock:
 	raw_spin_unlock_irq(&base->lock);
 	timer_base_unlock_expiry(base);
 }
 
+#ifdef CONFIG_TIMER_MIGRATION
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	Idle CPU whose timers were handed over to the hierarchy
+ *
+ * Called by the timer migration hierarchy from softirq context.
+ */
+void timer_expire_remote(unsigned int cpu)
+{
+	__run_timers(per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu));
+}
+
+/*
+ * The global base of @cpu has to stay locked while the hierarchy fetches
+ * its next expiry and updates the CPU's event, so that a concurrent idle
+ * reevaluation on @cpu is serialized against it.
+ */
+void timer_lock_remote_base(unsigned int cpu)
+{
+	raw_spin_lock(&per_cpu(timer_bases[BASE_GLOBAL], cpu).lock);
+}
+
+void timer_unlock_remote_base(unsigned int cpu)
+{
+	raw_spin_unlock(&per_cpu(timer_bases[BASE_GLOBAL], cpu).lock);
+}
+
+/**
+ * fetch_next_timer_interrupt_remote - next global timer event of a CPU
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ * @cpu:	Remote CPU, its global base locked by timer_lock_remote_base()
+ *
+ * Returns the clock monotonic time of the first pending global timer of
+ * @cpu or KTIME_MAX if there is none.
+ */
+u64 fetch_next_timer_interrupt_remote(unsigned long basej, u64 basem,
+				      unsigned int cpu)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+
+	lockdep_assert_held(&base->lock);
+
+	return next_timer_event(base, basej, basem);
+}
+#endif /* CONFIG_TIMER_MIGRATION */
+
 /*
  * This function runs timers and the timer-tq in bottom half context.
  */
 static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
-	__run_timers(base);
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON))
+	__run_timers(this_cpu_ptr(&timer_bases[BASE_LOCAL]));
+	if (IS_ENABLED(CONFIG_NO_HZ_COMMON)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
+
+		if (is_timers_nohz_active())
+			tmigr_handle_remote();
+	}
 }
 
 /*
@@ -2042,19 +2154,23 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
  */
 static void run_local_timers(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	int i;
 
 	hrtimer_run_queues();
-	/* Raise the softirq only if required. */
-	if (time_before(jiffies, base->next_expiry)) {
-		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
-			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->next_expiry))
+
+	/*
+	 * Raise the softirq only if required. The CPU is awake, so the
+	 * deferrable base is checked as well, and a migrator also has to
+	 * look after the expired timers of idle CPUs.
+	 */
+	for (i = 0; i < NR_BASES; i++, base++) {
+		if (time_after_eq(jiffies, base->next_expiry) ||
+		    (i == BASE_DEF && tmigr_requires_handle_remote())) {
+			raise_softirq(TIMER_SOFTIRQ);
 			return;
+		}
 	}
-	raise_softirq(TIMER_SOFTIRQ);
 }
 
 /*
@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Hierarchical pull model for the non pinned timers of idle CPUs
+ *
+ * Timers are queued on the CPU which arms them. Pinned timers go to the
+ * local wheel and are always expired by their CPU; everything else goes
+ * to the global wheel. When a CPU goes idle it hands the first event of
+ * its global wheel over to this hierarchy instead of programming its tick
+ * for it, so that NOHZ idle CPUs are not woken up just to expire timers
+ * which any busy CPU could handle.
+ *
+ * CPUs are the children of level 0 groups, groups are the children of the
+ * groups one level up, up to a single top level group. Every group tracks
+ * which children are active and the first event of each idle child. One
+ * active child of a group is its migrator: it expires the due events of
+ * the idle children from its tick. A CPU handles the groups up from its
+ * level 0 group as long as it is the migrator of each of them.
+ *
+ * When the last active child of a group goes idle, the group goes idle in
+ * its parent and reports the first event of its idle children there. If
+ * the whole hierarchy goes idle the CPU which went idle last keeps its
+ * tick programmed for the first event of the hierarchy and handles all
+ * levels when it wakes up.
+ *
+ * Locking: timer base locks nest outside of tmigr_cpu::lock, which nests
+ * outside of the group locks. Group locks are taken bottom up, handing
+ * over from child to parent so that concurrent updates arrive at the top
+ * in the order they were made. The remote expiry path never takes a group
+ * lock while holding another one.
+ */
+#include <linux/cpuhotplug.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include "tick-internal.h"
+#include "timer_migration.h"
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+
+static inline bool tmigr_is_not_available(struct tmigr_cpu *tmc)
+{
+	return !tmc->online;
+}
+
+static u64 tmigr_group_next(struct tmigr_group *group)
+{
+	u64 next = KTIME_MAX;
+	int i;
+
+	for (i = 0; i < group->num_children; i++)
+		next = min(next, group->events[i]);
+	return next;
+}
+
+/*
+ * Apply @action for the child @childmask of @group and propagate the
+ * change as far up as needed: activation only has to be propagated when
+ * the group was idle before, deactivations and event updates only when
+ * the group is idle afterwards, as an active group handles its children
+ * itself.
+ *
+ * Returns the first event of the hierarchy if the walk ended in the idle
+ * top level group, i.e. when the caller is responsible for it, KTIME_MAX
+ * otherwise.
+ */
+static u64 tmigr_walk_up(struct tmigr_group *group, u8 childmask, u64 evt,
+			 enum tmigr_action action)
+{
+	struct tmigr_group *parent;
+	u64 ret = KTIME_MAX;
+	bool was_active;
+
+	raw_spin_lock_nested(&group->lock, group->level);
+	for (;;) {
+		was_active = group->active;
+
+		switch (action) {
+		case TMIGR_ACTIVATE:
+			group->active |= childmask;
+			/* An idle migrator can't do its job, take over */
+			if (!was_active)
+				group->migrator = childmask;
+			evt = KTIME_MAX;
+			break;
+		case TMIGR_DEACTIVATE:
+			group->active &= ~childmask;
+			if (group->migrator == childmask && group->active)
+				group->migrator = BIT(__ffs(group->active));
+			break;
+		case TMIGR_UPDATE:
+			break;
+		}
+
+		group->events[__ffs(childmask)] = evt;
+		WRITE_ONCE(group->next_expiry, tmigr_group_next(group));
+
+		if (action == TMIGR_ACTIVATE ? was_active : group->active)
+			break;
+
+		if (!group->parent) {
+			if (!group->active)
+				ret = group->next_expiry;
+			break;
+		}
+
+		parent = group->parent;
+		raw_spin_lock_nested(&parent->lock, parent->level);
+		evt = group->next_expiry;
+		childmask = group->childmask;
+		raw_spin_unlock(&group->lock);
+		group = parent;
+	}
+	raw_spin_unlock(&group->lock);
+
+	return ret;
+}
+
+/**
+ * tmigr_cpu_activate - take the global timers back from the hierarchy
+ *
+ * Called with interrupts disabled when the CPU leaves idle.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (tmigr_is_not_available(tmc) || !tmc->idle)
+		return;
+
+	raw_spin_lock(&tmc->lock);
+	tmc->idle = false;
+	tmc->nextevt = KTIME_MAX;
+	tmc->wakeup = KTIME_MAX;
+	tmigr_walk_up(tmc->group, tmc->childmask, KTIME_MAX, TMIGR_ACTIVATE);
+	raw_spin_unlock(&tmc->lock);
+}
+
+/**
+ * tmigr_cpu_deactivate - hand the global timers over to the hierarchy
+ * @nextevt:	First event of the CPU's global timers, KTIME_MAX if none
+ *
+ * Called with interrupts disabled and the local timer bases locked when
+ * the CPU is about to stop its tick, and again whenever an idle CPU
+ * reevaluates its next event.
+ *
+ * Returns the time the CPU has to wake up for the hierarchy: KTIME_MAX if
+ * some other CPU takes care of the events, or @nextevt if the CPU does not
+ * take part in the hierarchy.
+ */
+u64 tmigr_cpu_deactivate(u64 nextevt)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	enum tmigr_action action;
+
+	if (tmigr_is_not_available(tmc))
+		return nextevt;
+
+	raw_spin_lock(&tmc->lock);
+	action = tmc->idle ? TMIGR_UPDATE : TMIGR_DEACTIVATE;
+	tmc->idle = true;
+	tmc->nextevt = nextevt;
+	/*
+	 * Always walk, even if @nextevt did not change: the first event of
+	 * an idle hierarchy might have changed through remote expiry.
+	 */
+	tmc->wakeup = tmigr_walk_up(tmc->group, tmc->childmask, nextevt, action);
+	raw_spin_unlock(&tmc->lock);
+
+	return tmc->wakeup;
+}
+
+/* Lockless check for trigger_dyntick_cpu(), called with @cpu's base locked */
+bool tmigr_cpu_is_idle(unsigned int cpu)
+{
+	return READ_ONCE(per_cpu(tmigr_cpu, cpu).idle);
+}
+
+static void tmigr_handle_remote_cpu(unsigned int cpu, unsigned long jif,
+				    u64 now)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	u64 next;
+
+	raw_spin_lock_irq(&tmc->lock);
+	/*
+	 * The CPU might have woken up, gone offline or be handled by another
+	 * CPU in the meantime.
+	 */
+	if (!tmc->online || !tmc->idle || tmc->remote || tmc->nextevt > now) {
+		raw_spin_unlock_irq(&tmc->lock);
+		return;
+	}
+	tmc->remote = true;
+	raw_spin_unlock_irq(&tmc->lock);
+
+	timer_expire_remote(cpu);
+
+	/*
+	 * Fetch the new first event with the remote base and tmc->lock held,
+	 * so that the CPU can't update its event concurrently when it comes
+	 * out of idle for a moment and goes back.
+	 */
+	local_irq_disable();
+	timer_lock_remote_base(cpu);
+	raw_spin_lock(&tmc->lock);
+	next = fetch_next_timer_interrupt_remote(jif, now, cpu);
+	timer_unlock_remote_base(cpu);
+
+	tmc->remote = false;
+	if (tmc->online && tmc->idle) {
+		tmc->nextevt = next;
+		tmigr_walk_up(tmc->group, tmc->childmask, next, TMIGR_UPDATE);
+	}
+	raw_spin_unlock(&tmc->lock);
+	local_irq_enable();
+}
+
+static void tmigr_handle_group(struct tmigr_group *group, unsigned long jif,
+			       u64 now)
+{
+	unsigned long expired = 0;
+	int i;
+
+	if (now < READ_ONCE(group->next_expiry))
+		return;
+
+	raw_spin_lock_irq(&group->lock);
+	for (i = 0; i < group->num_children; i++) {
+		if (group->events[i] <= now)
+			__set_bit(i, &expired);
+	}
+	raw_spin_unlock_irq(&group->lock);
+
+	for_each_set_bit(i, &expired, group->num_children) {
+		if (group->children)
+			tmigr_handle_group(&group->children[i], jif, now);
+		else
+			tmigr_handle_remote_cpu(group->first + i, jif, now);
+	}
+}
+
+/**
+ * tmigr_handle_remote - expire the due global timers of idle CPUs
+ *
+ * Called from the timer softirq. A CPU handles every level it is the
+ * migrator of, and every level which is completely idle, which is only
+ * the case when it woke up for the first event of an idle hierarchy.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long jif;
+	u8 childmask;
+	u64 now;
+
+	if (tmigr_is_not_available(tmc))
+		return;
+
+	now = get_jiffies_update(&jif);
+	childmask = tmc->childmask;
+
+	for (group = tmc->group; group; group = group->parent) {
+		if (READ_ONCE(group->migrator) != childmask &&
+		    READ_ONCE(group->active))
+			break;
+		tmigr_handle_group(group, jif, now);
+		childmask = group->childmask;
+	}
+}
+
+/**
+ * tmigr_requires_handle_remote - check whether remote timers are due
+ *
+ * Called from the tick with interrupts disabled.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long jif;
+	u8 childmask;
+	u64 now;
+
+	if (tmigr_is_not_available(tmc))
+		return false;
+
+	now = get_jiffies_update(&jif);
+
+	if (tmc->idle)
+		return now >= READ_ONCE(tmc->wakeup);
+
+	childmask = tmc->childmask;
+	for (group = tmc->group; group; group = group->parent) {
+		if (READ_ONCE(group->migrator) != childmask)
+			break;
+		if (now >= READ_ONCE(group->next_expiry))
+			return true;
+		childmask = group->childmask;
+	}
+	return false;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+
+	raw_spin_lock_irq(&tmc->lock);
+	tmc->idle = false;
+	tmc->nextevt = KTIME_MAX;
+	tmc->wakeup = KTIME_MAX;
+	tmigr_walk_up(tmc->group, tmc->childmask, KTIME_MAX, TMIGR_ACTIVATE);
+	tmc->online = true;
+	raw_spin_unlock_irq(&tmc->lock);
+
+	return 0;
+}
+
+static long tmigr_trigger_active(void *unused)
+{
+	/* Running a work item made this CPU leave idle, nothing else to do */
+	return 0;
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	u64 firstexp;
+
+	/* The global timers of this CPU are migrated by timers_dead_cpu() */
+	raw_spin_lock_irq(&tmc->lock);
+	tmc->online = false;
+	tmc->idle = false;
+	firstexp = tmigr_walk_up(tmc->group, tmc->childmask, KTIME_MAX,
+				 TMIGR_DEACTIVATE);
+	raw_spin_unlock_irq(&tmc->lock);
+
+	/*
+	 * This CPU was the last active one and there are events pending in
+	 * the hierarchy: make another CPU active so it takes over.
+	 */
+	if (firstexp != KTIME_MAX)
+		work_on_cpu(cpumask_any_but(cpu_online_mask, cpu),
+			    tmigr_trigger_active, NULL);
+
+	return 0;
+}
+
+static int __init tmigr_init(void)
+{
+	struct tmigr_group *groups, *children = NULL;
+	unsigned int nr_children = nr_cpu_ids, nr_groups, lvl = 0, i, c;
+	struct tmigr_cpu *tmc;
+	int cpu, ret;
+
+	/* Nothing to migrate to */
+	if (nr_cpu_ids == 1)
+		return 0;
+
+	do {
+		nr_groups = DIV_ROUND_UP(nr_children, TMIGR_CHILDREN_PER_GROUP);
+		groups = kcalloc(nr_groups, sizeof(*groups), GFP_KERNEL);
+		if (!groups) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		for (i = 0; i < nr_groups; i++) {
+			struct tmigr_group *group = &groups[i];
+
+			raw_spin_lock_init(&group->lock);
+			group->level = lvl;
+			group->first = i * TMIGR_CHILDREN_PER_GROUP;
+			group->num_children = min_t(unsigned int,
+						    nr_children - group->first,
+						    TMIGR_CHILDREN_PER_GROUP);
+			group->children = children ? &children[group->first] : NULL;
+			group->next_expiry = KTIME_MAX;
+			for (c = 0; c < TMIGR_CHILDREN_PER_GROUP; c++)
+				group->events[c] = KTIME_MAX;
+		}
+
+		if (children) {
+			for (i = 0; i < nr_children; i++) {
+				children[i].parent = &groups[i / TMIGR_CHILDREN_PER_GROUP];
+				children[i].childmask = BIT(i % TMIGR_CHILDREN_PER_GROUP);
+			}
+		} else {
+			for_each_possible_cpu(cpu) {
+				tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+				raw_spin_lock_init(&tmc->lock);
+				tmc->group = &groups[cpu / TMIGR_CHILDREN_PER_GROUP];
+				tmc->childmask = BIT(cpu % TMIGR_CHILDREN_PER_GROUP);
+				tmc->nextevt = KTIME_MAX;
+				tmc->wakeup = KTIME_MAX;
+			}
+		}
+
+		children = groups;
+		nr_children = nr_groups;
+		lvl++;
+	} while (nr_groups > 1);
+
+	/* Group locks use the level as lockdep subclass */
+	BUILD_BUG_ON(TMIGR_CHILDREN_PER_GROUP > BITS_PER_BYTE);
+	WARN_ON_ONCE(lvl > MAX_LOCKDEP_SUBCLASSES);
+
+	ret = cpuhp_setup_state(CPUHP_AP_TMIGR_ONLINE, "tmigr:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	if (ret)
+		goto err;
+
+	pr_info("Timer migration: %u hierarchy levels; %d children per group\n",
+		lvl, TMIGR_CHILDREN_PER_GROUP);
+	return 0;
+
+err:
+	pr_err("Timer migration setup failed\n");
+	return ret;
+}
+early_initcall(tmigr_init);
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TIMER_MIGRATION_H
+#define _TIMER_MIGRATION_H
+
+/* Number of children (CPUs or groups) per group */
+#define TMIGR_CHILDREN_PER_GROUP	8
+
+enum tmigr_action {
+	TMIGR_UPDATE,
+	TMIGR_ACTIVATE,
+	TMIGR_DEACTIVATE,
+};
+
+/**
+ * struct tmigr_group - timer migration hierarchy group
+ * @lock:		Protects the state and the events of the group
+ * @parent:		Parent group, NULL for the top level group
+ * @children:		First child group, NULL for level 0 groups
+ * @first:		Index of the first child in the level below; the first
+ *			CPU for level 0 groups
+ * @level:		Hierarchy level, CPUs are the children of level 0
+ * @childmask:		Bit of this group in the parent's masks
+ * @num_children:	Number of children of this group
+ * @active:		Mask of the active children
+ * @migrator:		Mask bit of the child which expires the timers of the
+ *			idle children. When the group is idle it keeps
+ *			pointing to the child which went idle last.
+ * @next_expiry:	First event of the idle children, KTIME_MAX if none
+ * @events:		Next event per child, KTIME_MAX for active children
+ */
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;
+	struct tmigr_group	*children;
+	unsigned int		first;
+	unsigned int		level;
+	u8			childmask;
+	u8			num_children;
+	u8			active;
+	u8			migrator;
+	u64			next_expiry;
+	u64			events[TMIGR_CHILDREN_PER_GROUP];
+};
+
+/**
+ * struct tmigr_cpu - timer migration per CPU state
+ * @lock:	Protects the state below, nests outside the group locks
+ * @online:	CPU takes part in the hierarchy
+ * @idle:	CPU handed its global timers over to the hierarchy
+ * @remote:	Another CPU is expiring the global timers of this CPU
+ * @childmask:	Bit of this CPU in its level 0 group
+ * @group:	Level 0 group of this CPU
+ * @nextevt:	Global event handed over, KTIME_MAX if none
+ * @wakeup:	When an idle CPU has to handle the hierarchy's events as the
+ *		whole hierarchy is idle, KTIME_MAX otherwise
+ */
+struct tmigr_cpu {
+	raw_spinlock_t		lock;
+	bool			online;
+	bool			idle;
+	bool			remote;
+	u8			childmask;
+	struct tmigr_group	*group;
+	u64			nextevt;
+	u64			wakeup;
+};
+
+#endif
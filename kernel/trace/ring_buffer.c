@@ -4,6 +4,7 @@
  *
  * Copyright (C) 2008 Steven Rostedt <srostedt@redhat.com>
  */
+#include <uapi/linux/trace_mmap.h>
 #include <linux/trace_recursion.h>
 #include <linux/trace_events.h>
 #include <linux/ring_buffer.h>
@@ -331,6 +332,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* ID for external mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -537,6 +539,13 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned long			*subbuf_ids;	/* ID to subbuf addr */
+	struct trace_buffer_meta	*meta_page;
+	/* number of mapping VMAs, changed under mapping_lock and reader_lock */
+	unsigned int			mapped;
 };
 
 struct trace_buffer {
@@ -1729,6 +1738,7 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -1909,6 +1919,7 @@ bool ring_buffer_time_stamp_abs(struct trace_buffer *buffer)
 }
 
 static void rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer);
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer);
 
 static inline unsigned long rb_page_entries(struct buffer_page *bpage)
 {
@@ -5304,6 +5315,9 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 
 	rb_head_page_activate(cpu_buffer);
 	cpu_buffer->pages_removed = 0;
+
+	if (cpu_buffer->mapped)
+		rb_update_meta_page(cpu_buffer);
 }
 
 /* Must have disabled the cpu buffer then done a synchronize_rcu */
@@ -5516,6 +5530,12 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 	cpu_buffer_a = buffer_a->buffers[cpu];
 	cpu_buffer_b = buffer_b->buffers[cpu];
 
+	/* The pages of a mapped buffer must stay where user space sees them */
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped) {
+		ret = -EBUSY;
+		goto out;
+	}
+
 	/* At least make sure the two buffers are somewhat the same */
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
@@ -5753,12 +5773,14 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page or
+	 * the buffer pages are mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -5768,10 +5790,11 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 		 * If a full page is expected, this can still be returned
 		 * if there's been a previous partial read and the
 		 * rest of the page can be read and the commit page is off
-		 * the reader page.
+		 * the reader page. A full page is also copied out of a
+		 * mapped buffer.
 		 */
 		if (full &&
-		    (!read || (len < (commit - read)) ||
+		    ((!read && !cpu_buffer->mapped) || (len < (commit - read)) ||
 		     cpu_buffer->reader_page == cpu_buffer->commit_page))
 			goto out_unlock;
 
@@ -5875,6 +5898,377 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	WRITE_ONCE(meta->reader.read, cpu_buffer->reader_page->read);
+	WRITE_ONCE(meta->reader.id, cpu_buffer->reader_page->id);
+
+	WRITE_ONCE(meta->entries, local_read(&cpu_buffer->entries));
+	WRITE_ONCE(meta->overrun, local_read(&cpu_buffer->overrun));
+	WRITE_ONCE(meta->read, cpu_buffer->read);
+
+	/* Some archs do not have data cache coherency between kernel and user space */
+	flush_dcache_folio(virt_to_folio(cpu_buffer->meta_page));
+}
+
+/*
+ * Give every sub-buffer an ID: 0 for the reader page, then the ring pages
+ * starting from the head page. The IDs stick to the pages, so they stay
+ * valid when the reader page is swapped.
+ */
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	unsigned int nr_subbufs = cpu_buffer->nr_pages + 1;
+	struct buffer_page *first_subbuf, *subbuf;
+	int id = 0;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	first_subbuf = subbuf = rb_set_head_page(cpu_buffer);
+	do {
+		if (RB_WARN_ON(cpu_buffer, id >= nr_subbufs))
+			break;
+
+		subbuf_ids[id] = (unsigned long)subbuf->page;
+		subbuf->id = id;
+
+		rb_inc_page(&subbuf);
+		id++;
+	} while (subbuf != first_subbuf);
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->nr_subbufs = nr_subbufs;
+	meta->subbuf_size = PAGE_SIZE;
+	meta->reader.lost_events = 0;
+
+	rb_update_meta_page(cpu_buffer);
+}
+
+static struct ring_buffer_per_cpu *
+rb_get_mapped_buffer(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return ERR_PTR(-EINVAL);
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (!cpu_buffer->mapped) {
+		mutex_unlock(&cpu_buffer->mapping_lock);
+		return ERR_PTR(-ENODEV);
+	}
+
+	return cpu_buffer;
+}
+
+static void rb_put_mapped_buffer(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	mutex_unlock(&cpu_buffer->mapping_lock);
+}
+
+/*
+ * Map the meta page followed by the sub-buffers in ID order. A non zero
+ * @vma->vm_pgoff skips the meta page and the first sub-buffers.
+ */
+static int __rb_map_vma(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long nr_subbufs, nr_pages, nr_vma_pages, pgoff = vma->vm_pgoff;
+	struct page **pages;
+	int p = 0, s = 0;
+	int err;
+
+	lockdep_assert_held(&cpu_buffer->mapping_lock);
+
+	if (vma->vm_flags & VM_WRITE || vma->vm_flags & VM_EXEC ||
+	    !(vma->vm_flags & VM_MAYSHARE))
+		return -EPERM;
+
+	nr_subbufs = cpu_buffer->nr_pages + 1; /* + reader page */
+	if (pgoff > nr_subbufs)
+		return -EINVAL;
+	nr_pages = nr_subbufs + 1 - pgoff; /* + meta page */
+
+	nr_vma_pages = vma_pages(vma);
+	if (!nr_vma_pages || nr_vma_pages > nr_pages)
+		return -EINVAL;
+
+	nr_pages = nr_vma_pages;
+
+	/*
+	 * The mapping must never become writable, and must not be copied on
+	 * fork nor grown with mremap().
+	 */
+	vm_flags_mod(vma, VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP, VM_MAYWRITE);
+
+	pages = kcalloc(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	if (!pgoff)
+		pages[p++] = virt_to_page(cpu_buffer->meta_page);
+	else
+		s = pgoff - 1; /* skip the meta page */
+
+	while (p < nr_pages)
+		pages[p++] = virt_to_page((void *)cpu_buffer->subbuf_ids[s++]);
+
+	err = vm_insert_pages(vma, vma->vm_start, pages, &nr_pages);
+
+	kfree(pages);
+
+	return err;
+}
+
+/**
+ * ring_buffer_map - map a per CPU buffer into user space
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the CPU buffer to map
+ * @vma: the read-only and shared VMA to map into
+ *
+ * Maps the meta page (struct trace_buffer_meta) followed by all the
+ * sub-buffers of the CPU buffer. User space reads the events straight
+ * from the reader sub-buffer given by the meta page, and gets the next
+ * one with ring_buffer_map_get_reader().
+ *
+ * The CPU buffer cannot be resized nor swapped while it is mapped.
+ *
+ * Returns 0 on success or a negative error code.
+ */
+int ring_buffer_map(struct trace_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags, *subbuf_ids;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (cpu_buffer->mapped) {
+		err = __rb_map_vma(cpu_buffer, vma);
+		if (!err) {
+			raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+			cpu_buffer->mapped++;
+			raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		}
+		mutex_unlock(&cpu_buffer->mapping_lock);
+		return err;
+	}
+
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+
+	cpu_buffer->meta_page = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!cpu_buffer->meta_page) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!subbuf_ids) {
+		err = -ENOMEM;
+		goto free_meta;
+	}
+
+	atomic_inc(&cpu_buffer->resize_disabled);
+
+	/* Lock all readers to block any page swap until the IDs are assigned */
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	err = __rb_map_vma(cpu_buffer, vma);
+	if (err) {
+		atomic_dec(&cpu_buffer->resize_disabled);
+		kfree(cpu_buffer->subbuf_ids);
+		cpu_buffer->subbuf_ids = NULL;
+		goto free_meta;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	goto unlock;
+
+ free_meta:
+	free_page((unsigned long)cpu_buffer->meta_page);
+	cpu_buffer->meta_page = NULL;
+ unlock:
+	mutex_unlock(&buffer->mutex);
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+
+/**
+ * ring_buffer_map_dup - account a copy of a mapping of a per CPU buffer
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * For VMAs duplicated by the VM, e.g. on split or mremap(), which are
+ * released with ring_buffer_unmap() as well.
+ */
+void ring_buffer_map_dup(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags;
+
+	cpu_buffer = rb_get_mapped_buffer(buffer, cpu);
+	if (WARN_ON(IS_ERR(cpu_buffer)))
+		return;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped++;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	rb_put_mapped_buffer(cpu_buffer);
+}
+
+/**
+ * ring_buffer_unmap - release a user space mapping of a per CPU buffer
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * Once the last mapping is gone, the CPU buffer can be resized and
+ * swapped again.
+ *
+ * Returns 0 on success, -ENODEV if the CPU buffer is not mapped.
+ */
+int ring_buffer_unmap(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags;
+
+	cpu_buffer = rb_get_mapped_buffer(buffer, cpu);
+	if (IS_ERR(cpu_buffer))
+		return PTR_ERR(cpu_buffer);
+
+	if (cpu_buffer->mapped > 1) {
+		raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+		cpu_buffer->mapped--;
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		goto out;
+	}
+
+	mutex_lock(&buffer->mutex);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 0;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	atomic_dec(&cpu_buffer->resize_disabled);
+
+	free_page((unsigned long)cpu_buffer->meta_page);
+	cpu_buffer->meta_page = NULL;
+	kfree(cpu_buffer->subbuf_ids);
+	cpu_buffer->subbuf_ids = NULL;
+
+	mutex_unlock(&buffer->mutex);
+ out:
+	rb_put_mapped_buffer(cpu_buffer);
+
+	return 0;
+}
+
+/**
+ * ring_buffer_map_get_reader - hand the next sub-buffer to user space
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * If the current reader sub-buffer still has unread events, they are
+ * accounted as read by user space and the sub-buffer is kept. Otherwise
+ * the reader sub-buffer is swapped with the head of the ring. The meta
+ * page is updated in both cases.
+ *
+ * Returns 0 on success, -ENODEV if the CPU buffer is not mapped.
+ */
+int ring_buffer_map_get_reader(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long missed_events;
+	struct buffer_page *reader;
+	unsigned long flags;
+	unsigned int commit;
+
+	cpu_buffer = rb_get_mapped_buffer(buffer, cpu);
+	if (IS_ERR(cpu_buffer))
+		return PTR_ERR(cpu_buffer);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (rb_per_cpu_empty(cpu_buffer))
+		goto out;
+
+	/*
+	 * There is data left on the current reader page: user space is
+	 * expected to read all of it, account for that and keep the page.
+	 */
+	if (cpu_buffer->reader_page->read < rb_page_size(cpu_buffer->reader_page)) {
+		while (cpu_buffer->reader_page->read <
+		       rb_page_size(cpu_buffer->reader_page))
+			rb_advance_reader(cpu_buffer);
+		goto out;
+	}
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (RB_WARN_ON(cpu_buffer, !reader))
+		goto out;
+
+	/* Check if any events were dropped */
+	missed_events = cpu_buffer->lost_events;
+
+	if (missed_events && cpu_buffer->reader_page != cpu_buffer->commit_page) {
+		struct buffer_data_page *bpage = reader->page;
+
+		/*
+		 * Use the real_end for the data size, this gives us a
+		 * chance to store the lost events on the page.
+		 */
+		if (reader->real_end)
+			local_set(&bpage->commit, reader->real_end);
+
+		commit = rb_page_size(reader);
+		if (BUF_PAGE_SIZE - commit >= sizeof(missed_events)) {
+			memcpy(&bpage->data[commit], &missed_events,
+			       sizeof(missed_events));
+			local_add(RB_MISSED_STORED, &bpage->commit);
+		}
+		local_add(RB_MISSED_EVENTS, &bpage->commit);
+	}
+
+	WRITE_ONCE(cpu_buffer->meta_page->reader.lost_events, missed_events);
+	cpu_buffer->lost_events = 0;
+
+ out:
+	/* Some archs do not have data cache coherency between kernel and user space */
+	flush_dcache_folio(virt_to_folio(cpu_buffer->reader_page->page));
+
+	rb_update_meta_page(cpu_buffer);
+
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	rb_put_mapped_buffer(cpu_buffer);
+
+	return 0;
+}
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
@@ -51,6 +51,8 @@
 
 #include <asm/setup.h> /* COMMAND_LINE_SIZE */
 
+#include <uapi/linux/trace_mmap.h>
+
 #include "trace.h"
 #include "trace_output.h"
 
@@ -1266,6 +1268,10 @@ int tracing_alloc_snapshot_instance(struct trace_array *tr)
 
 	if (!tr->allocated_snapshot) {
 
+		/* The buffer mapped to user space cannot be swapped */
+		if (READ_ONCE(tr->mapped))
+			return -EBUSY;
+
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
 				   &tr->array_buffer, RING_BUFFER_ALL_CPUS);
@@ -1876,6 +1882,12 @@ update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu,
 
 	arch_spin_lock(&tr->max_lock);
 
+	/* The buffer mapped to user space cannot be swapped */
+	if (tr->mapped) {
+		arch_spin_unlock(&tr->max_lock);
+		return;
+	}
+
 	/* Inherit the recordable setting from array_buffer */
 	if (ring_buffer_record_is_set_on(tr->array_buffer.buffer))
 		ring_buffer_record_on(tr->max_buffer.buffer);
@@ -8562,14 +8574,30 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
-/* An ioctl call with cmd 0 to the ring buffer file will wake up all waiters */
+/*
+ * An ioctl call with cmd 0 to the ring buffer file will wake up all waiters.
+ * TRACE_MMAP_IOCTL_GET_READER moves the reader of a mapped buffer forward.
+ */
 static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct ftrace_buffer_info *info = file->private_data;
 	struct trace_iterator *iter = &info->iter;
+	int err;
 
-	if (cmd)
+	if (cmd == TRACE_MMAP_IOCTL_GET_READER) {
+		if (!(file->f_flags & O_NONBLOCK)) {
+			err = ring_buffer_wait(iter->array_buffer->buffer,
+					       iter->cpu_file,
+					       iter->tr->buffer_percent);
+			if (err)
+				return err;
+		}
+
+		return ring_buffer_map_get_reader(iter->array_buffer->buffer,
+						  iter->cpu_file);
+	} else if (cmd) {
 		return -ENOIOCTLCMD;
+	}
 
 	mutex_lock(&trace_types_lock);
 
@@ -8583,6 +8611,93 @@ static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned
 	return 0;
 }
 
+#ifdef CONFIG_TRACER_MAX_TRACE
+static void __tracing_mapped_add(struct trace_array *tr, int delta)
+{
+	local_irq_disable();
+	arch_spin_lock(&tr->max_lock);
+	tr->mapped += delta;
+	arch_spin_unlock(&tr->max_lock);
+	local_irq_enable();
+}
+
+/* Snapshots swap the buffers, a buffer with a snapshot cannot be mapped */
+static int tracing_get_mapped(struct trace_array *tr)
+{
+	if (READ_ONCE(tr->allocated_snapshot))
+		return -EBUSY;
+
+	__tracing_mapped_add(tr, 1);
+	return 0;
+}
+
+static void tracing_dup_mapped(struct trace_array *tr)
+{
+	__tracing_mapped_add(tr, 1);
+}
+
+static void tracing_put_mapped(struct trace_array *tr)
+{
+	__tracing_mapped_add(tr, -1);
+}
+#else
+static inline int tracing_get_mapped(struct trace_array *tr) { return 0; }
+static inline void tracing_dup_mapped(struct trace_array *tr) { }
+static inline void tracing_put_mapped(struct trace_array *tr) { }
+#endif
+
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	tracing_dup_mapped(iter->tr);
+	ring_buffer_map_dup(iter->array_buffer->buffer, iter->cpu_file);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	WARN_ON(ring_buffer_unmap(iter->array_buffer->buffer, iter->cpu_file));
+	tracing_put_mapped(iter->tr);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+};
+
+/*
+ * Map the meta page and the sub-buffers of a per CPU buffer read-only, see
+ * struct trace_buffer_meta. The snapshot of the instance is unavailable
+ * while the buffer is mapped.
+ */
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	ret = tracing_get_mapped(iter->tr);
+	if (ret)
+		return ret;
+
+	ret = ring_buffer_map(iter->array_buffer->buffer, iter->cpu_file, vma);
+	if (ret) {
+		tracing_put_mapped(iter->tr);
+		return ret;
+	}
+
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return 0;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
@@ -8590,6 +8705,7 @@ static const struct file_operations tracing_buffers_fops = {
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
 	.unlocked_ioctl = tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
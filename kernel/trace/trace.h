@@ -334,6 +334,8 @@ struct trace_array {
 	 */
 	struct array_buffer	max_buffer;
 	bool			allocated_snapshot;
+	/* VMAs mapping array_buffer, which must not be swapped, under max_lock */
+	unsigned int		mapped;
 #endif
 #ifdef CONFIG_TRACER_MAX_TRACE
 	unsigned long		max_latency;
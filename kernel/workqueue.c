@@ -53,6 +53,8 @@
 #include <linux/nmi.h>
 #include <linux/kvm_para.h>
 #include <linux/delay.h>
+#include <linux/interrupt.h>
+#include <linux/irq_work.h>
 
 #include "workqueue_internal.h"
 
@@ -72,9 +74,15 @@ enum {
 	 * Note that DISASSOCIATED should be flipped only while holding
 	 * wq_pool_attach_mutex to avoid changing binding state while
 	 * worker_attach_to_pool() is in progress.
+	 *
+	 * BH pools execute work items from softirq on their CPU and have a
+	 * single task-less worker. They don't take part in CPU hotplug; see
+	 * workqueue_softirq_dead() for how a dead CPU's pools are drained.
 	 */
 	POOL_MANAGER_ACTIVE	= 1 << 0,	/* being managed */
+	POOL_BH			= 1 << 1,	/* is a BH pool */
 	POOL_DISASSOCIATED	= 1 << 2,	/* cpu can't serve workers */
+	POOL_BH_DRAINING	= 1 << 3,	/* draining after CPU offline */
 
 	/* worker flags */
 	WORKER_DIE		= 1 << 1,	/* die die die */
@@ -101,6 +109,13 @@ enum {
 	MAYDAY_INTERVAL		= HZ / 10,	/* and then every 100ms */
 	CREATE_COOLDOWN		= HZ,		/* time to breath after fail */
 
+	/*
+	 * Like softirq restarts, a BH worker yields after this many rounds or
+	 * this much time so that other softirqs and tasks get to run.
+	 */
+	BH_WORKER_JIFFIES	= HZ / 500 >= 2 ? HZ / 500 : 2,
+	BH_WORKER_RESTARTS	= 10,
+
 	/*
 	 * Rescue workers are used only on emergencies and shared by
 	 * all cpus.  Give MIN_NICE.
@@ -399,6 +414,9 @@ static bool wq_debug_force_rr_cpu = false;
 #endif
 module_param_named(debug_force_rr_cpu, wq_debug_force_rr_cpu, bool, 0644);
 
+/* the BH worker pools */
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct worker_pool [NR_STD_WORKER_POOLS], bh_worker_pools);
+
 /* the per-cpu worker pools */
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct worker_pool [NR_STD_WORKER_POOLS], cpu_worker_pools);
 
@@ -434,6 +452,10 @@ struct workqueue_struct *system_power_efficient_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_power_efficient_wq);
 struct workqueue_struct *system_freezable_power_efficient_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_freezable_power_efficient_wq);
+struct workqueue_struct *system_bh_wq;
+EXPORT_SYMBOL_GPL(system_bh_wq);
+struct workqueue_struct *system_bh_highpri_wq;
+EXPORT_SYMBOL_GPL(system_bh_highpri_wq);
 
 static int worker_thread(void *__worker);
 static void workqueue_sysfs_unregister(struct workqueue_struct *wq);
@@ -454,6 +476,11 @@ static void show_one_worker_pool(struct worker_pool *pool);
 			 !lockdep_is_held(&wq_pool_mutex),		\
 			 "RCU, wq->mutex or wq_pool_mutex should be held")
 
+#define for_each_bh_worker_pool(pool, cpu)				\
+	for ((pool) = &per_cpu(bh_worker_pools, cpu)[0];		\
+	     (pool) < &per_cpu(bh_worker_pools, cpu)[NR_STD_WORKER_POOLS]; \
+	     (pool)++)
+
 #define for_each_cpu_worker_pool(pool, cpu)				\
 	for ((pool) = &per_cpu(cpu_worker_pools, cpu)[0];		\
 	     (pool) < &per_cpu(cpu_worker_pools, cpu)[NR_STD_WORKER_POOLS]; \
@@ -1095,6 +1122,38 @@ static bool assign_work(struct work_struct *work, struct worker *worker,
 	return true;
 }
 
+static void bh_pool_kick_normal(struct irq_work *irq_work)
+{
+	raise_softirq_irqoff(TASKLET_SOFTIRQ);
+}
+
+static void bh_pool_kick_highpri(struct irq_work *irq_work)
+{
+	raise_softirq_irqoff(HI_SOFTIRQ);
+}
+
+/* used to raise the softirq of a BH pool on a remote CPU */
+static DEFINE_PER_CPU(struct irq_work [NR_STD_WORKER_POOLS], bh_pool_irq_works) = {
+	IRQ_WORK_INIT_HARD(bh_pool_kick_normal),
+	IRQ_WORK_INIT_HARD(bh_pool_kick_highpri),
+};
+
+static void kick_bh_pool(struct worker_pool *pool)
+{
+	bool highpri = pool->attrs->nice == HIGHPRI_NICE_LEVEL;
+
+#ifdef CONFIG_SMP
+	/* a dead CPU's pool is drained by workqueue_softirq_dead() instead */
+	if (unlikely(pool->cpu != smp_processor_id() &&
+		     !(pool->flags & POOL_BH_DRAINING))) {
+		irq_work_queue_on(&per_cpu(bh_pool_irq_works, pool->cpu)[highpri],
+				  pool->cpu);
+		return;
+	}
+#endif
+	raise_softirq_irqoff(highpri ? HI_SOFTIRQ : TASKLET_SOFTIRQ);
+}
+
 /**
  * kick_pool - wake up an idle worker if necessary
  * @pool: pool to kick
@@ -1112,6 +1171,11 @@ static bool kick_pool(struct worker_pool *pool)
 	if (!need_more_worker(pool) || !worker)
 		return false;
 
+	if (pool->flags & POOL_BH) {
+		kick_bh_pool(pool);
+		return true;
+	}
+
 	p = worker->task;
 
 #ifdef CONFIG_SMP
@@ -2106,10 +2170,13 @@ static void worker_attach_to_pool(struct worker *worker,
 	 * stable across this function.  See the comments above the flag
 	 * definition for details.
 	 */
-	if (pool->flags & POOL_DISASSOCIATED)
-		worker->flags |= WORKER_UNBOUND;
-	else
-		kthread_set_per_cpu(worker->task, pool->cpu);
+	/* BH workers have no task and are never unbound */
+	if (!(pool->flags & POOL_BH)) {
+		if (pool->flags & POOL_DISASSOCIATED)
+			worker->flags |= WORKER_UNBOUND;
+		else
+			kthread_set_per_cpu(worker->task, pool->cpu);
+	}
 
 	if (worker->rescue_wq)
 		set_cpus_allowed_ptr(worker->task, pool_allowed_cpus(pool));
@@ -2233,6 +2300,35 @@ static struct worker *create_worker(struct worker_pool *pool)
 	return NULL;
 }
 
+/**
+ * create_bh_worker - create the worker of a BH pool
+ * @pool: BH pool the new worker will belong to
+ *
+ * BH pools have a single worker which runs from softirq through
+ * workqueue_softirq_action() and thus doesn't need a kthread.
+ *
+ * Return:
+ * Pointer to the newly created worker.
+ */
+static struct worker * __init create_bh_worker(struct worker_pool *pool)
+{
+	struct worker *worker;
+
+	worker = alloc_worker(pool->node);
+	if (!worker)
+		return NULL;
+
+	worker_attach_to_pool(worker, pool);
+
+	raw_spin_lock_irq(&pool->lock);
+	pool->nr_workers++;
+	worker_enter_idle(worker);
+	kick_pool(pool);
+	raw_spin_unlock_irq(&pool->lock);
+
+	return worker;
+}
+
 static void unbind_worker(struct worker *worker)
 {
 	lockdep_assert_held(&wq_pool_attach_mutex);
@@ -2553,7 +2649,7 @@ __acquires(&pool->lock)
 	lockdep_copy_map(&lockdep_map, &work->lockdep_map);
 #endif
 	/* ensure we're on the correct CPU */
-	WARN_ON_ONCE(!(pool->flags & POOL_DISASSOCIATED) &&
+	WARN_ON_ONCE(!(pool->flags & (POOL_DISASSOCIATED | POOL_BH_DRAINING)) &&
 		     raw_smp_processor_id() != pool->cpu);
 
 	/* claim and dequeue */
@@ -2562,7 +2658,8 @@ __acquires(&pool->lock)
 	worker->current_work = work;
 	worker->current_func = work->func;
 	worker->current_pwq = pwq;
-	worker->current_at = worker->task->se.sum_exec_runtime;
+	if (worker->task)
+		worker->current_at = worker->task->se.sum_exec_runtime;
 	work_data = *work_data_bits(work);
 	worker->current_color = get_work_color(work_data);
 
@@ -2637,7 +2734,9 @@ __acquires(&pool->lock)
 	lock_map_release(&lockdep_map);
 	lock_map_release(&pwq->wq->lockdep_map);
 
-	if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
+	/* BH work items run in softirq context where in_atomic() is true */
+	if (unlikely((worker->task && in_atomic()) ||
+		     lockdep_depth(current) > 0)) {
 		pr_err("BUG: workqueue leaked lock or atomic: %s/0x%08x/%d\n"
 		       "     last function: %ps\n",
 		       current->comm, preempt_count(), task_pid_nr(current),
@@ -2654,7 +2753,8 @@ __acquires(&pool->lock)
 	 * stop_machine. At the same time, report a quiescent RCU state so
 	 * the same condition doesn't freeze RCU.
 	 */
-	cond_resched();
+	if (worker->task)
+		cond_resched();
 
 	raw_spin_lock_irq(&pool->lock);
 
@@ -2800,6 +2900,98 @@ static int worker_thread(void *__worker)
 	goto woke_up;
 }
 
+/**
+ * bh_worker - the BH worker function
+ * @worker: the worker of a BH pool
+ *
+ * Process the work items of a BH pool from softirq context. This follows the
+ * structure of worker_thread(), see there for each step, but gives up after
+ * %BH_WORKER_RESTARTS rounds or %BH_WORKER_JIFFIES and lets kick_pool() raise
+ * the softirq again if work items remain.
+ */
+static void bh_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+	int nr_restarts = BH_WORKER_RESTARTS;
+	unsigned long end = jiffies + BH_WORKER_JIFFIES;
+
+	raw_spin_lock_irq(&pool->lock);
+	worker_leave_idle(worker);
+
+	if (!need_more_worker(pool))
+		goto done;
+
+	WARN_ON_ONCE(!list_empty(&worker->scheduled));
+	worker_clr_flags(worker, WORKER_PREP | WORKER_REBOUND);
+
+	do {
+		struct work_struct *work =
+			list_first_entry(&pool->worklist,
+					 struct work_struct, entry);
+
+		if (assign_work(work, worker, NULL))
+			process_scheduled_works(worker);
+	} while (keep_working(pool) &&
+		 --nr_restarts && time_before(jiffies, end));
+
+	worker_set_flags(worker, WORKER_PREP);
+done:
+	worker_enter_idle(worker);
+	kick_pool(pool);
+	raw_spin_unlock_irq(&pool->lock);
+}
+
+/**
+ * workqueue_softirq_action - run the BH work items of the local CPU
+ * @highpri: run the highpri pool from HI_SOFTIRQ instead of the normal one
+ *
+ * Called from TASKLET_SOFTIRQ and HI_SOFTIRQ, right before the tasklets.
+ */
+void workqueue_softirq_action(bool highpri)
+{
+	struct worker_pool *pool =
+		&per_cpu(bh_worker_pools, smp_processor_id())[highpri];
+
+	/* the worker is created in workqueue_init() and never goes away */
+	if (need_more_worker(pool) && !list_empty(&pool->workers))
+		bh_worker(list_first_entry(&pool->workers, struct worker, node));
+}
+
+/**
+ * workqueue_softirq_dead - drain the BH pools of a dead CPU
+ * @cpu: the CPU which went offline
+ *
+ * Like tasklets, BH work items left on @cpu are taken over by the CPU running
+ * the CPUHP_SOFTIRQ_DEAD callback. They're executed right here with BH
+ * disabled, in their queueing order.
+ */
+void workqueue_softirq_dead(unsigned int cpu)
+{
+	struct worker_pool *pool;
+
+	for_each_bh_worker_pool(pool, cpu) {
+		struct worker *worker;
+
+		if (!need_more_worker(pool) || list_empty(&pool->workers))
+			continue;
+
+		worker = list_first_entry(&pool->workers, struct worker, node);
+
+		raw_spin_lock_irq(&pool->lock);
+		pool->flags |= POOL_BH_DRAINING;
+		raw_spin_unlock_irq(&pool->lock);
+
+		local_bh_disable();
+		while (need_more_worker(pool))
+			bh_worker(worker);
+		local_bh_enable();
+
+		raw_spin_lock_irq(&pool->lock);
+		pool->flags &= ~POOL_BH_DRAINING;
+		raw_spin_unlock_irq(&pool->lock);
+	}
+}
+
 /**
  * rescuer_thread - the rescuer thread function
  * @__rescuer: self
@@ -4571,8 +4763,12 @@ static int alloc_and_link_pwqs(struct workqueue_struct *wq)
 		for_each_possible_cpu(cpu) {
 			struct pool_workqueue **pwq_p =
 				per_cpu_ptr(wq->cpu_pwq, cpu);
-			struct worker_pool *pool =
-				&(per_cpu_ptr(cpu_worker_pools, cpu)[highpri]);
+			struct worker_pool *pool;
+
+			if (wq->flags & WQ_BH)
+				pool = &(per_cpu_ptr(bh_worker_pools, cpu)[highpri]);
+			else
+				pool = &(per_cpu_ptr(cpu_worker_pools, cpu)[highpri]);
 
 			*pwq_p = kmem_cache_alloc_node(pwq_cache, GFP_KERNEL,
 						       pool->node);
@@ -4690,6 +4886,14 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 	if ((flags & WQ_POWER_EFFICIENT) && wq_power_efficient)
 		flags |= WQ_UNBOUND;
 
+	/* BH wqs are per-cpu, have no rescuer and use the default max_active */
+	if (flags & WQ_BH) {
+		if (WARN_ON_ONCE(flags & ~__WQ_BH_ALLOWS))
+			return NULL;
+		if (WARN_ON_ONCE(max_active))
+			return NULL;
+	}
+
 	/* allocate wq and format name */
 	wq = kzalloc(sizeof(*wq), GFP_KERNEL);
 	if (!wq)
@@ -5079,7 +5283,24 @@ static void pr_cont_pool_info(struct worker_pool *pool)
 	pr_cont(" cpus=%*pbl", nr_cpumask_bits, pool->attrs->cpumask);
 	if (pool->node != NUMA_NO_NODE)
 		pr_cont(" node=%d", pool->node);
-	pr_cont(" flags=0x%x nice=%d", pool->flags, pool->attrs->nice);
+	pr_cont(" flags=0x%x", pool->flags);
+	if (pool->flags & POOL_BH)
+		pr_cont(" bh%s",
+			pool->attrs->nice == HIGHPRI_NICE_LEVEL ? "-hi" : "");
+	else
+		pr_cont(" nice=%d", pool->attrs->nice);
+}
+
+static void pr_cont_worker_id(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	if (pool->flags & POOL_BH)
+		pr_cont("bh%s",
+			pool->attrs->nice == HIGHPRI_NICE_LEVEL ? "-hi" : "");
+	else
+		pr_cont("%d%s", task_pid_nr(worker->task),
+			worker->rescue_wq ? "(RESCUER)" : "");
 }
 
 struct pr_cont_work_struct {
@@ -5156,10 +5377,9 @@ static void show_pwq(struct pool_workqueue *pwq)
 			if (worker->current_pwq != pwq)
 				continue;
 
-			pr_cont("%s %d%s:%ps", comma ? "," : "",
-				task_pid_nr(worker->task),
-				worker->rescue_wq ? "(RESCUER)" : "",
-				worker->current_func);
+			pr_cont(" %s", comma ? "," : "");
+			pr_cont_worker_id(worker);
+			pr_cont(":%ps", worker->current_func);
 			list_for_each_entry(work, &worker->scheduled, entry)
 				pr_cont_work(false, work, &pcws);
 			pr_cont_work_flush(comma, (work_func_t)-1L, &pcws);
@@ -5278,8 +5498,8 @@ static void show_one_worker_pool(struct worker_pool *pool)
 		pr_cont(" manager: %d",
 			task_pid_nr(pool->manager->task));
 	list_for_each_entry(worker, &pool->idle_list, entry) {
-		pr_cont(" %s%d", first ? "idle: " : "",
-			task_pid_nr(worker->task));
+		pr_cont(" %s", first ? "idle: " : "");
+		pr_cont_worker_id(worker);
 		first = false;
 	}
 	pr_cont("\n");
@@ -5552,6 +5772,10 @@ int workqueue_online_cpu(unsigned int cpu)
 	mutex_lock(&wq_pool_mutex);
 
 	for_each_pool(pool, pi) {
+		/* BH pools aren't affected by hotplug */
+		if (pool->flags & POOL_BH)
+			continue;
+
 		mutex_lock(&wq_pool_attach_mutex);
 
 		if (pool->cpu == cpu)
@@ -6341,7 +6565,8 @@ static void show_cpu_pool_hog(struct worker_pool *pool)
 	raw_spin_lock_irqsave(&pool->lock, flags);
 
 	hash_for_each(pool->busy_hash, bkt, worker, hentry) {
-		if (task_is_running(worker->task)) {
+		/* a hogging BH worker shows up in the CPU's backtrace */
+		if (worker->task && task_is_running(worker->task)) {
 			/*
 			 * Defer printing to avoid deadlocks in console
 			 * drivers that queue work while holding locks
@@ -6511,6 +6736,23 @@ static inline void wq_watchdog_init(void) { }
 
 #endif	/* CONFIG_WQ_WATCHDOG */
 
+static void __init init_cpu_worker_pool(struct worker_pool *pool, int cpu,
+					int nice)
+{
+	BUG_ON(init_worker_pool(pool));
+	pool->cpu = cpu;
+	cpumask_copy(pool->attrs->cpumask, cpumask_of(cpu));
+	cpumask_copy(pool->attrs->__pod_cpumask, cpumask_of(cpu));
+	pool->attrs->nice = nice;
+	pool->attrs->affn_strict = true;
+	pool->node = cpu_to_node(cpu);
+
+	/* alloc pool ID */
+	mutex_lock(&wq_pool_mutex);
+	BUG_ON(worker_pool_assign_id(pool));
+	mutex_unlock(&wq_pool_mutex);
+}
+
 /**
  * workqueue_init_early - early init for workqueue subsystem
  *
@@ -6554,25 +6796,21 @@ void __init workqueue_init_early(void)
 	pt->pod_node[0] = NUMA_NO_NODE;
 	pt->cpu_pod[0] = 0;
 
-	/* initialize CPU pools */
+	/* initialize BH and CPU pools */
 	for_each_possible_cpu(cpu) {
 		struct worker_pool *pool;
 
 		i = 0;
-		for_each_cpu_worker_pool(pool, cpu) {
-			BUG_ON(init_worker_pool(pool));
-			pool->cpu = cpu;
-			cpumask_copy(pool->attrs->cpumask, cpumask_of(cpu));
-			cpumask_copy(pool->attrs->__pod_cpumask, cpumask_of(cpu));
-			pool->attrs->nice = std_nice[i++];
-			pool->attrs->affn_strict = true;
-			pool->node = cpu_to_node(cpu);
-
-			/* alloc pool ID */
-			mutex_lock(&wq_pool_mutex);
-			BUG_ON(worker_pool_assign_id(pool));
-			mutex_unlock(&wq_pool_mutex);
+		for_each_bh_worker_pool(pool, cpu) {
+			init_cpu_worker_pool(pool, cpu, std_nice[i++]);
+			/* BH pools are always associated with their CPU */
+			pool->flags &= ~POOL_DISASSOCIATED;
+			pool->flags |= POOL_BH;
 		}
+
+		i = 0;
+		for_each_cpu_worker_pool(pool, cpu)
+			init_cpu_worker_pool(pool, cpu, std_nice[i++]);
 	}
 
 	/* create default unbound and ordered wq attrs */
@@ -6605,10 +6843,14 @@ void __init workqueue_init_early(void)
 	system_freezable_power_efficient_wq = alloc_workqueue("events_freezable_power_efficient",
 					      WQ_FREEZABLE | WQ_POWER_EFFICIENT,
 					      0);
+	system_bh_wq = alloc_workqueue("events_bh", WQ_BH, 0);
+	system_bh_highpri_wq = alloc_workqueue("events_bh_highpri",
+					       WQ_BH | WQ_HIGHPRI, 0);
 	BUG_ON(!system_wq || !system_highpri_wq || !system_long_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
 	       !system_power_efficient_wq ||
-	       !system_freezable_power_efficient_wq);
+	       !system_freezable_power_efficient_wq ||
+	       !system_bh_wq || !system_bh_highpri_wq);
 }
 
 static void __init wq_cpu_intensive_thresh_init(void)
@@ -6674,6 +6916,8 @@ void __init workqueue_init(void)
 	 * up. Also, create a rescuer for workqueues that requested it.
 	 */
 	for_each_possible_cpu(cpu) {
+		for_each_bh_worker_pool(pool, cpu)
+			pool->node = cpu_to_node(cpu);
 		for_each_cpu_worker_pool(pool, cpu) {
 			pool->node = cpu_to_node(cpu);
 		}
@@ -6687,7 +6931,15 @@ void __init workqueue_init(void)
 
 	mutex_unlock(&wq_pool_mutex);
 
-	/* create the initial workers */
+	/*
+	 * Create the initial workers. BH workers don't need a kthread, so each
+	 * possible CPU gets one right away.
+	 */
+	for_each_possible_cpu(cpu) {
+		for_each_bh_worker_pool(pool, cpu)
+			BUG_ON(!create_bh_worker(pool));
+	}
+
 	for_each_online_cpu(cpu) {
 		for_each_cpu_worker_pool(pool, cpu) {
 			pool->flags &= ~POOL_DISASSOCIATED;
@@ -89,6 +89,44 @@ __u16 crc_t10dif(const unsigned char *buffer, size_t len)
 }
 EXPORT_SYMBOL(crc_t10dif);
 
+/**
+ * crc_t10dif_batch - compute the CRCs of consecutive intervals of a buffer
+ * @buffer:	data of @nr intervals
+ * @interval:	size of each interval in bytes
+ * @nr:		number of intervals
+ * @crcs:	array of @nr CRCs to fill
+ *
+ * Equivalent to calling crc_t10dif() for each interval, but the transform is
+ * only looked up once for the whole buffer.
+ */
+void crc_t10dif_batch(const unsigned char *buffer, size_t interval,
+		      unsigned int nr, __u16 *crcs)
+{
+	struct {
+		struct shash_desc shash;
+		__u16 crc;
+	} desc;
+	unsigned int i;
+	int err;
+
+	if (static_branch_unlikely(&crct10dif_fallback)) {
+		for (i = 0; i < nr; i++, buffer += interval)
+			crcs[i] = crc_t10dif_generic(0, buffer, interval);
+		return;
+	}
+
+	rcu_read_lock();
+	desc.shash.tfm = rcu_dereference(crct10dif_tfm);
+	for (i = 0; i < nr; i++, buffer += interval) {
+		desc.crc = 0;
+		err = crypto_shash_update(&desc.shash, buffer, interval);
+		BUG_ON(err);
+		crcs[i] = desc.crc;
+	}
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL(crc_t10dif_batch);
+
 static int __init crc_t10dif_mod_init(void)
 {
 	INIT_WORK(&crct10dif_rehash_work, crc_t10dif_rehash);
@@ -83,6 +83,44 @@ u64 crc64_rocksoft(const unsigned char *buffer, size_t len)
 }
 EXPORT_SYMBOL_GPL(crc64_rocksoft);
 
+/**
+ * crc64_rocksoft_batch - compute the CRCs of consecutive intervals of a buffer
+ * @buffer:	data of @nr intervals
+ * @interval:	size of each interval in bytes
+ * @nr:		number of intervals
+ * @crcs:	array of @nr CRCs to fill
+ *
+ * Equivalent to calling crc64_rocksoft() for each interval, but the transform
+ * is only looked up once for the whole buffer.
+ */
+void crc64_rocksoft_batch(const unsigned char *buffer, size_t interval,
+			  unsigned int nr, u64 *crcs)
+{
+	struct {
+		struct shash_desc shash;
+		u64 crc;
+	} desc;
+	unsigned int i;
+	int err;
+
+	if (static_branch_unlikely(&crc64_rocksoft_fallback)) {
+		for (i = 0; i < nr; i++, buffer += interval)
+			crcs[i] = crc64_rocksoft_generic(0, buffer, interval);
+		return;
+	}
+
+	rcu_read_lock();
+	desc.shash.tfm = rcu_dereference(crc64_rocksoft_tfm);
+	for (i = 0; i < nr; i++, buffer += interval) {
+		desc.crc = 0;
+		err = crypto_shash_update(&desc.shash, buffer, interval);
+		BUG_ON(err);
+		crcs[i] = desc.crc;
+	}
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(crc64_rocksoft_batch);
+
 static int __init crc64_rocksoft_mod_init(void)
 {
 	INIT_WORK(&crc64_rocksoft_rehash_work, crc64_rocksoft_rehash);
@@ -183,6 +183,38 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	} while (d < e);
 }
 
+/*
+ * Copy 16 bytes, loading all of them before storing any, so that the
+ * compiler can use a single pair of loads and stores (LDP/STP on arm64)
+ */
+static FORCE_INLINE void LZ4_copy16(void *dst, const void *src)
+{
+	U64 a = get_unaligned((const U64 *)src);
+	U64 b = get_unaligned((const U64 *)src + 1);
+
+	put_unaligned(a, (U64 *)dst);
+	put_unaligned(b, (U64 *)dst + 1);
+}
+
+/*
+ * LZ4_wildCopy() by steps of 16 bytes, which can overwrite up to 15 bytes
+ * beyond dstEnd. The source must be at least 16 bytes away from the
+ * destination.
+ */
+static FORCE_INLINE void LZ4_wildCopy16(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+	BYTE *d = (BYTE *)dstPtr;
+	const BYTE *s = (const BYTE *)srcPtr;
+	BYTE *const e = (BYTE *)dstEnd;
+
+	do {
+		LZ4_copy16(d, s);
+		d += 16;
+		s += 16;
+	} while (d < e);
+}
+
 static FORCE_INLINE unsigned int LZ4_NbCommonBytes(register size_t val)
 {
 #if LZ4_LITTLE_ENDIAN
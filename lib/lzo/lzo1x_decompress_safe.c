@@ -97,12 +97,9 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 					const unsigned char *ie = ip + t;
 					unsigned char *oe = op + t;
 					do {
-						COPY8(op, ip);
-						op += 8;
-						ip += 8;
-						COPY8(op, ip);
-						op += 8;
-						ip += 8;
+						COPY16(op, ip);
+						op += 16;
+						ip += 16;
 					} while (ip < ie);
 					ip = ie;
 					op = oe;
@@ -214,14 +211,22 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (op - m_pos >= 8) {
 			unsigned char *oe = op + t;
 			if (likely(HAVE_OP(t + 15))) {
-				do {
-					COPY8(op, m_pos);
-					op += 8;
-					m_pos += 8;
-					COPY8(op, m_pos);
-					op += 8;
-					m_pos += 8;
-				} while (op < oe);
+				if (op - m_pos >= 16) {
+					do {
+						COPY16(op, m_pos);
+						op += 16;
+						m_pos += 16;
+					} while (op < oe);
+				} else {
+					do {
+						COPY8(op, m_pos);
+						op += 8;
+						m_pos += 8;
+						COPY8(op, m_pos);
+						op += 8;
+						m_pos += 8;
+					} while (op < oe);
+				}
 				op = oe;
 				if (HAVE_IP(6)) {
 					state = next;
@@ -28,6 +28,16 @@
 #define COPY8(dst, src)	\
 		COPY4(dst, src); COPY4((dst) + 4, (src) + 4)
 #endif
+/*
+ * Loads all 16 bytes before storing any, so it compiles to a load and a
+ * store pair (LDP/STP on arm64). src must be 16 bytes away from dst.
+ */
+#define COPY16(dst, src)	do {				\
+		u64 __c16a = get_unaligned((const u64 *)(src));		\
+		u64 __c16b = get_unaligned((const u64 *)(src) + 1);	\
+		put_unaligned(__c16a, (u64 *)(dst));			\
+		put_unaligned(__c16b, (u64 *)(dst) + 1);		\
+	} while (0)
 
 #if defined(__BIG_ENDIAN) && defined(__LITTLE_ENDIAN)
 #error "conflicting endian definitions"
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0+ OR BSD-3-Clause
+/*
+ * Multi-threaded compression of large buffers, by splitting them into
+ * chunks compressed as independent frames.
+ */
+
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <linux/zstd.h>
+
+struct zstd_mt_job {
+	const void *src;
+	size_t src_size;
+	void *dst;
+	size_t chunk_size;
+	/* Room in dst for the frame of each chunk */
+	size_t slot_size;
+	zstd_parameters params;
+	size_t workspace_size;
+	unsigned int nr_chunks;
+	atomic_t next_chunk;
+	/* Compressed size of each chunk */
+	size_t *sizes;
+	int error;
+};
+
+struct zstd_mt_worker {
+	struct work_struct work;
+	struct zstd_mt_job *job;
+	void *workspace;
+};
+
+/*
+ * Compress chunks until none is left. The frame of chunk i is stored at
+ * dst + i * slot_size, and moved in place once all chunks are done.
+ */
+static void zstd_mt_compress_chunks(struct zstd_mt_job *job, void *workspace)
+{
+	zstd_cctx *cctx = zstd_init_cctx(workspace, job->workspace_size);
+	unsigned int i;
+	size_t ret;
+
+	if (!cctx) {
+		WRITE_ONCE(job->error, -EIO);
+		return;
+	}
+
+	while ((i = atomic_inc_return(&job->next_chunk) - 1) < job->nr_chunks) {
+		size_t offset = (size_t)i * job->chunk_size;
+
+		if (READ_ONCE(job->error))
+			return;
+
+		ret = zstd_compress_cctx(cctx, job->dst + i * job->slot_size,
+					 job->slot_size, job->src + offset,
+					 min(job->chunk_size, job->src_size - offset),
+					 &job->params);
+		if (zstd_is_error(ret)) {
+			WRITE_ONCE(job->error, -EIO);
+			return;
+		}
+		job->sizes[i] = ret;
+	}
+}
+
+static void zstd_mt_worker_fn(struct work_struct *work)
+{
+	struct zstd_mt_worker *worker =
+		container_of(work, struct zstd_mt_worker, work);
+
+	zstd_mt_compress_chunks(worker->job, worker->workspace);
+}
+
+size_t zstd_compress_mt_bound(size_t src_size, size_t chunk_size)
+{
+	if (!chunk_size)
+		chunk_size = ZSTD_MT_DEFAULT_CHUNK_SIZE;
+
+	return DIV_ROUND_UP(src_size, chunk_size) *
+	       zstd_compress_bound(min(chunk_size, src_size));
+}
+EXPORT_SYMBOL(zstd_compress_mt_bound);
+
+ssize_t zstd_compress_mt(void *dst, size_t dst_capacity, const void *src,
+	size_t src_size, int level, size_t chunk_size)
+{
+	struct zstd_mt_worker *workers;
+	struct zstd_mt_job job = {};
+	unsigned int nr_workers, i;
+	void *workspace;
+	size_t out;
+	int ret;
+
+	if (!chunk_size)
+		chunk_size = ZSTD_MT_DEFAULT_CHUNK_SIZE;
+	chunk_size = min(chunk_size, src_size);
+
+	if (dst_capacity < zstd_compress_mt_bound(src_size, chunk_size))
+		return -ENOSPC;
+	if (!src_size)
+		return 0;
+
+	job.src = src;
+	job.src_size = src_size;
+	job.dst = dst;
+	job.chunk_size = chunk_size;
+	job.slot_size = zstd_compress_bound(chunk_size);
+	job.params = zstd_get_params(level, chunk_size);
+	job.workspace_size = zstd_cctx_workspace_bound(&job.params.cParams);
+	job.nr_chunks = DIV_ROUND_UP(src_size, chunk_size);
+	atomic_set(&job.next_chunk, 0);
+
+	job.sizes = kvcalloc(job.nr_chunks, sizeof(*job.sizes), GFP_KERNEL);
+	if (!job.sizes)
+		return -ENOMEM;
+
+	/* The calling context compresses too */
+	workspace = kvmalloc(job.workspace_size, GFP_KERNEL);
+	if (!workspace) {
+		ret = -ENOMEM;
+		goto out_sizes;
+	}
+
+	nr_workers = min(job.nr_chunks, num_online_cpus()) - 1;
+	workers = kcalloc(nr_workers, sizeof(*workers), GFP_KERNEL);
+	if (!workers)
+		nr_workers = 0;
+
+	/* Helpers are best effort, the chunks get done without them */
+	for (i = 0; i < nr_workers; i++) {
+		workers[i].workspace = kvmalloc(job.workspace_size,
+						GFP_KERNEL | __GFP_NORETRY);
+		if (!workers[i].workspace)
+			break;
+		workers[i].job = &job;
+		INIT_WORK(&workers[i].work, zstd_mt_worker_fn);
+		queue_work(system_unbound_wq, &workers[i].work);
+	}
+	nr_workers = i;
+
+	zstd_mt_compress_chunks(&job, workspace);
+
+	for (i = 0; i < nr_workers; i++) {
+		flush_work(&workers[i].work);
+		kvfree(workers[i].workspace);
+	}
+	kfree(workers);
+	kvfree(workspace);
+
+	ret = job.error;
+	if (ret)
+		goto out_sizes;
+
+	/* Move the frames next to each other, in order */
+	out = job.sizes[0];
+	for (i = 1; i < job.nr_chunks; i++) {
+		memmove(dst + out, dst + i * job.slot_size, job.sizes[i]);
+		out += job.sizes[i];
+	}
+	kvfree(job.sizes);
+	return out;
+
+out_sizes:
+	kvfree(job.sizes);
+	return ret;
+}
+EXPORT_SYMBOL(zstd_compress_mt);
@@ -437,6 +437,7 @@ static int wb_init(struct bdi_writeback *wb, struct backing_dev_info *bdi,
 	INIT_DELAYED_WORK(&wb->dwork, wb_workfn);
 	INIT_DELAYED_WORK(&wb->bw_dwork, wb_update_bandwidth_workfn);
 	wb->dirty_sleep = jiffies;
+	wb->dirty_flush = jiffies - HZ;
 
 	err = fprop_local_init_percpu(&wb->completions, gfp);
 	if (err)
@@ -38,7 +38,17 @@
 
 struct cma cma_areas[MAX_CMA_AREAS];
 unsigned cma_area_count;
-static DEFINE_MUTEX(cma_mutex);
+
+/*
+ * A pfn range handed to alloc_contig_range(), widened to the granularity at
+ * which it isolates pages. Allocations whose ranges do not overlap run
+ * concurrently.
+ */
+struct cma_inflight {
+	struct list_head list;
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+};
 
 phys_addr_t cma_get_base(const struct cma *cma)
 {
@@ -121,6 +131,8 @@ static void __init cma_activate_area(struct cma *cma)
 		init_cma_reserved_pageblock(pfn_to_page(pfn));
 
 	spin_lock_init(&cma->lock);
+	INIT_LIST_HEAD(&cma->inflight);
+	init_waitqueue_head(&cma->inflight_wq);
 
 #ifdef CONFIG_CMA_DEBUGFS
 	INIT_HLIST_HEAD(&cma->mem_head);
@@ -416,6 +428,41 @@ static void cma_debug_show_areas(struct cma *cma)
 static inline void cma_debug_show_areas(struct cma *cma) { }
 #endif
 
+static void cma_inflight_init(struct cma_inflight *inflight,
+			      unsigned long pfn, unsigned long count)
+{
+	unsigned long nr = max_t(unsigned long, pageblock_nr_pages,
+				 MAX_ORDER_NR_PAGES);
+
+	inflight->start_pfn = ALIGN_DOWN(pfn, nr);
+	inflight->end_pfn = ALIGN(pfn + count, nr);
+}
+
+static bool cma_inflight_overlaps(struct cma *cma,
+				  const struct cma_inflight *inflight)
+{
+	struct cma_inflight *other;
+
+	lockdep_assert_held(&cma->lock);
+
+	list_for_each_entry(other, &cma->inflight, list)
+		if (inflight->start_pfn < other->end_pfn &&
+		    other->start_pfn < inflight->end_pfn)
+			return true;
+
+	return false;
+}
+
+static void cma_inflight_done(struct cma *cma, struct cma_inflight *inflight)
+{
+	spin_lock_irq(&cma->lock);
+	list_del(&inflight->list);
+	cma->inflight_gen++;
+	spin_unlock_irq(&cma->lock);
+
+	wake_up_all(&cma->inflight_wq);
+}
+
 /**
  * cma_alloc() - allocate pages from contiguous area
  * @cma:   Contiguous memory region for which the allocation is performed.
@@ -433,6 +480,9 @@ struct page *cma_alloc(struct cma *cma, unsigned long count,
 	unsigned long pfn = -1;
 	unsigned long start = 0;
 	unsigned long bitmap_maxno, bitmap_no, bitmap_count;
+	struct cma_inflight inflight;
+	unsigned int inflight_gen;
+	bool contended = false;
 	unsigned long i;
 	struct page *page = NULL;
 	int ret = -ENOMEM;
@@ -462,10 +512,36 @@ struct page *cma_alloc(struct cma *cma, unsigned long count,
 				bitmap_maxno, start, bitmap_count, mask,
 				offset);
 		if (bitmap_no >= bitmap_maxno) {
+			if (!contended) {
+				spin_unlock_irq(&cma->lock);
+				break;
+			}
+			/*
+			 * Only ranges sharing pageblocks with concurrent
+			 * allocations were free. Wait for one of those to
+			 * finish and scan the area again.
+			 */
+			inflight_gen = cma->inflight_gen;
 			spin_unlock_irq(&cma->lock);
-			break;
+			wait_event(cma->inflight_wq,
+				   list_empty_careful(&cma->inflight) ||
+				   READ_ONCE(cma->inflight_gen) != inflight_gen);
+			contended = false;
+			start = 0;
+			continue;
 		}
+
+		pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
+		cma_inflight_init(&inflight, pfn, count);
+		if (cma_inflight_overlaps(cma, &inflight)) {
+			spin_unlock_irq(&cma->lock);
+			contended = true;
+			start = bitmap_no + mask + 1;
+			continue;
+		}
+
 		bitmap_set(cma->bitmap, bitmap_no, bitmap_count);
+		list_add(&inflight.list, &cma->inflight);
 		/*
 		 * It's safe to drop the lock here. We've marked this region for
 		 * our exclusive use. If the migration fails we will take the
@@ -473,11 +549,9 @@ struct page *cma_alloc(struct cma *cma, unsigned long count,
 		 */
 		spin_unlock_irq(&cma->lock);
 
-		pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
-		mutex_lock(&cma_mutex);
 		ret = alloc_contig_range(pfn, pfn + count, MIGRATE_CMA,
 				     GFP_KERNEL | (no_warn ? __GFP_NOWARN : 0));
-		mutex_unlock(&cma_mutex);
+		cma_inflight_done(cma, &inflight);
 		if (ret == 0) {
 			page = pfn_to_page(pfn);
 			break;
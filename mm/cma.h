@@ -16,6 +16,10 @@ struct cma {
 	unsigned long   *bitmap;
 	unsigned int order_per_bit; /* Order of pages represented by one bit */
 	spinlock_t	lock;
+	/* ranges under alloc_contig_range(), protected by lock */
+	struct list_head inflight;
+	unsigned int	inflight_gen;
+	wait_queue_head_t inflight_wq;
 #ifdef CONFIG_CMA_DEBUGFS
 	struct hlist_head mem_head;
 	spinlock_t mem_head_lock;
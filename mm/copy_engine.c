@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Offload of bulk kernel copies to public DMA_MEMCPY channels.
+ *
+ * Sleepable callers such as batched page migration hand copies of at least
+ * 'threshold' bytes to the memcpy channel dmaengine assigned to the local CPU,
+ * and copy with the CPU themselves when no channel is available or the
+ * transfer fails.  folio_copy() itself stays a CPU copy, as it is also used
+ * in atomic context.
+ * Offload is off by default and is controlled, together with its counters,
+ * through /sys/kernel/mm/copy_engine/.
+ */
+
+#define pr_fmt(fmt) "copy_engine: " fmt
+
+#include <linux/completion.h>
+#include <linux/copy_engine.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/init.h>
+#include <linux/kobject.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sizes.h>
+#include <linux/srcu.h>
+#include <linux/sysfs.h>
+
+enum copy_engine_stat {
+	COPY_ENGINE_OFFLOADED,
+	COPY_ENGINE_OFFLOADED_BYTES,
+	COPY_ENGINE_BELOW_THRESHOLD,
+	COPY_ENGINE_NO_CHANNEL,
+	COPY_ENGINE_FAILED,
+	NR_COPY_ENGINE_STATS,
+};
+
+DEFINE_STATIC_KEY_FALSE(copy_engine_enabled);
+
+static DEFINE_PER_CPU(unsigned long [NR_COPY_ENGINE_STATS], copy_engine_stats);
+static DEFINE_MUTEX(copy_engine_mutex);
+DEFINE_STATIC_SRCU(copy_engine_srcu);
+static unsigned long copy_engine_threshold __read_mostly = SZ_64K;
+static bool copy_engine_on;
+
+struct copy_engine_wait {
+	struct completion done;
+	enum dmaengine_tx_result result;
+};
+
+static inline void copy_engine_count(enum copy_engine_stat item,
+				     unsigned long delta)
+{
+	this_cpu_add(copy_engine_stats[item], delta);
+}
+
+static void copy_engine_callback(void *param,
+				 const struct dmaengine_result *result)
+{
+	struct copy_engine_wait *wait = param;
+
+	wait->result = result->result;
+	complete(&wait->done);
+}
+
+static bool copy_engine_dma(struct dma_chan *chan, struct page *dst,
+			    struct page *src, size_t len)
+{
+	struct device *dev = dmaengine_get_dma_device(chan);
+	struct dma_async_tx_descriptor *tx;
+	struct copy_engine_wait wait;
+	dma_addr_t dma_src, dma_dst;
+	bool copied = false;
+
+	if (!is_dma_copy_aligned(chan->device, 0, 0, len))
+		return false;
+
+	dma_src = dma_map_page(dev, src, 0, len, DMA_TO_DEVICE);
+	if (dma_mapping_error(dev, dma_src))
+		return false;
+
+	dma_dst = dma_map_page(dev, dst, 0, len, DMA_FROM_DEVICE);
+	if (dma_mapping_error(dev, dma_dst))
+		goto unmap_src;
+
+	/* A NULL descriptor means the channel is out of descriptors */
+	tx = dmaengine_prep_dma_memcpy(chan, dma_dst, dma_src, len,
+				       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!tx)
+		goto unmap_dst;
+
+	init_completion(&wait.done);
+	wait.result = DMA_TRANS_NOERROR;
+	tx->callback_result = copy_engine_callback;
+	tx->callback_param = &wait;
+
+	if (dma_submit_error(dmaengine_submit(tx)))
+		goto unmap_dst;
+	dma_async_issue_pending(chan);
+
+	/*
+	 * The transfer cannot be safely abandoned on a shared channel, wait
+	 * for it to retire before the pages are handed back.
+	 */
+	wait_for_completion(&wait.done);
+	copied = wait.result == DMA_TRANS_NOERROR;
+
+unmap_dst:
+	dma_unmap_page(dev, dma_dst, len, DMA_FROM_DEVICE);
+unmap_src:
+	dma_unmap_page(dev, dma_src, len, DMA_TO_DEVICE);
+	return copied;
+}
+
+bool __copy_engine_copy_pages(struct page *dst, struct page *src, size_t len)
+{
+	struct dma_chan *chan;
+	bool copied = false;
+	int idx;
+
+	if (len < READ_ONCE(copy_engine_threshold)) {
+		copy_engine_count(COPY_ENGINE_BELOW_THRESHOLD, 1);
+		return false;
+	}
+
+	might_sleep();
+
+	idx = srcu_read_lock(&copy_engine_srcu);
+	if (!READ_ONCE(copy_engine_on)) {
+		copy_engine_count(COPY_ENGINE_NO_CHANNEL, 1);
+		goto out;
+	}
+
+	chan = dma_find_channel(DMA_MEMCPY);
+	if (!chan) {
+		copy_engine_count(COPY_ENGINE_NO_CHANNEL, 1);
+		goto out;
+	}
+
+	copied = copy_engine_dma(chan, dst, src, len);
+	if (copied) {
+		copy_engine_count(COPY_ENGINE_OFFLOADED, 1);
+		copy_engine_count(COPY_ENGINE_OFFLOADED_BYTES, len);
+	} else {
+		copy_engine_count(COPY_ENGINE_FAILED, 1);
+	}
+out:
+	srcu_read_unlock(&copy_engine_srcu, idx);
+	return copied;
+}
+EXPORT_SYMBOL_GPL(__copy_engine_copy_pages);
+
+#ifdef CONFIG_SYSFS
+static unsigned long copy_engine_sum(enum copy_engine_stat item)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += per_cpu(copy_engine_stats, cpu)[item];
+	return sum;
+}
+
+static ssize_t enabled_show(struct kobject *kobj, struct kobj_attribute *attr,
+			    char *buf)
+{
+	return sysfs_emit(buf, "%d\n", copy_engine_on);
+}
+
+static ssize_t enabled_store(struct kobject *kobj, struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	bool enable;
+	int err;
+
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return err;
+
+	mutex_lock(&copy_engine_mutex);
+	if (enable && !copy_engine_on) {
+		/* Take a client reference so dmaengine fills its channel table */
+		dmaengine_get();
+		WRITE_ONCE(copy_engine_on, true);
+		static_branch_enable(&copy_engine_enabled);
+	} else if (!enable && copy_engine_on) {
+		static_branch_disable(&copy_engine_enabled);
+		WRITE_ONCE(copy_engine_on, false);
+		/* Let in-flight copies finish before dropping the channels */
+		synchronize_srcu(&copy_engine_srcu);
+		dmaengine_put();
+	}
+	mutex_unlock(&copy_engine_mutex);
+
+	return count;
+}
+static struct kobj_attribute enabled_attr = __ATTR_RW(enabled);
+
+static ssize_t threshold_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%lu\n", READ_ONCE(copy_engine_threshold));
+}
+
+static ssize_t threshold_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned long threshold;
+	int err;
+
+	err = kstrtoul(buf, 10, &threshold);
+	if (err)
+		return err;
+	if (threshold < PAGE_SIZE)
+		return -EINVAL;
+
+	WRITE_ONCE(copy_engine_threshold, threshold);
+	return count;
+}
+static struct kobj_attribute threshold_attr = __ATTR_RW(threshold);
+
+#define COPY_ENGINE_STAT_ATTR(_name, _item)				\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sysfs_emit(buf, "%lu\n", copy_engine_sum(_item));	\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+COPY_ENGINE_STAT_ATTR(offloaded, COPY_ENGINE_OFFLOADED);
+COPY_ENGINE_STAT_ATTR(offloaded_bytes, COPY_ENGINE_OFFLOADED_BYTES);
+COPY_ENGINE_STAT_ATTR(below_threshold, COPY_ENGINE_BELOW_THRESHOLD);
+COPY_ENGINE_STAT_ATTR(no_channel, COPY_ENGINE_NO_CHANNEL);
+COPY_ENGINE_STAT_ATTR(failed, COPY_ENGINE_FAILED);
+
+static struct attribute *copy_engine_attrs[] = {
+	&enabled_attr.attr,
+	&threshold_attr.attr,
+	&offloaded_attr.attr,
+	&offloaded_bytes_attr.attr,
+	&below_threshold_attr.attr,
+	&no_channel_attr.attr,
+	&failed_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group copy_engine_attr_group = {
+	.attrs = copy_engine_attrs,
+	.name = "copy_engine",
+};
+
+static int __init copy_engine_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &copy_engine_attr_group);
+	if (err)
+		pr_err("register sysfs failed\n");
+	return err;
+}
+late_initcall(copy_engine_init);
+#endif /* CONFIG_SYSFS */
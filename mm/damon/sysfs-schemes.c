@@ -883,6 +883,275 @@ static const struct kobj_type damon_sysfs_weights_ktype = {
 	.default_groups = damon_sysfs_weights_groups,
 };
 
+/*
+ * quota goal directory
+ */
+
+struct damon_sysfs_quota_goal {
+	struct kobject kobj;
+	enum damos_quota_goal_metric metric;
+	unsigned long target_value;
+	unsigned long current_value;
+	char *memcg_path;
+};
+
+/* Should match with enum damos_quota_goal_metric */
+static const char * const damos_sysfs_quota_goal_metric_strs[] = {
+	"user_input",
+	"some_mem_psi_us",
+	"memcg_free_bp",
+};
+
+static struct damon_sysfs_quota_goal *damon_sysfs_quota_goal_alloc(void)
+{
+	return kzalloc(sizeof(struct damon_sysfs_quota_goal), GFP_KERNEL);
+}
+
+static ssize_t target_metric_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%s\n",
+			damos_sysfs_quota_goal_metric_strs[goal->metric]);
+}
+
+static ssize_t target_metric_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+	enum damos_quota_goal_metric m;
+
+	for (m = 0; m < NR_DAMOS_QUOTA_GOAL_METRICS; m++) {
+		if (sysfs_streq(buf, damos_sysfs_quota_goal_metric_strs[m])) {
+			goal->metric = m;
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+
+static ssize_t target_value_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj, struct
+			damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%lu\n", goal->target_value);
+}
+
+static ssize_t target_value_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj, struct
+			damon_sysfs_quota_goal, kobj);
+	int err = kstrtoul(buf, 0, &goal->target_value);
+
+	return err ? err : count;
+}
+
+static ssize_t current_value_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj, struct
+			damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%lu\n", goal->current_value);
+}
+
+static ssize_t current_value_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj, struct
+			damon_sysfs_quota_goal, kobj);
+	int err = kstrtoul(buf, 0, &goal->current_value);
+
+	/* feed callback should check existence of this file and read value */
+	return err ? err : count;
+}
+
+static ssize_t goal_memcg_path_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj, struct
+			damon_sysfs_quota_goal, kobj);
+
+	return sysfs_emit(buf, "%s\n", goal->memcg_path ? goal->memcg_path : "");
+}
+
+static ssize_t goal_memcg_path_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj, struct
+			damon_sysfs_quota_goal, kobj);
+	char *path = kmalloc(sizeof(*path) * (count + 1), GFP_KERNEL);
+
+	if (!path)
+		return -ENOMEM;
+
+	strscpy(path, buf, count + 1);
+	kfree(goal->memcg_path);
+	goal->memcg_path = path;
+	return count;
+}
+
+static void damon_sysfs_quota_goal_release(struct kobject *kobj)
+{
+	struct damon_sysfs_quota_goal *goal = container_of(kobj,
+			struct damon_sysfs_quota_goal, kobj);
+
+	kfree(goal->memcg_path);
+	kfree(goal);
+}
+
+static struct kobj_attribute damon_sysfs_quota_goal_target_metric_attr =
+		__ATTR_RW_MODE(target_metric, 0600);
+
+static struct kobj_attribute damon_sysfs_quota_goal_target_value_attr =
+		__ATTR_RW_MODE(target_value, 0600);
+
+static struct kobj_attribute damon_sysfs_quota_goal_current_value_attr =
+		__ATTR_RW_MODE(current_value, 0600);
+
+static struct kobj_attribute damon_sysfs_quota_goal_memcg_path_attr =
+		__ATTR(memcg_path, 0600, goal_memcg_path_show,
+				goal_memcg_path_store);
+
+static struct attribute *damon_sysfs_quota_goal_attrs[] = {
+	&damon_sysfs_quota_goal_target_metric_attr.attr,
+	&damon_sysfs_quota_goal_target_value_attr.attr,
+	&damon_sysfs_quota_goal_current_value_attr.attr,
+	&damon_sysfs_quota_goal_memcg_path_attr.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(damon_sysfs_quota_goal);
+
+static const struct kobj_type damon_sysfs_quota_goal_ktype = {
+	.release = damon_sysfs_quota_goal_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_groups = damon_sysfs_quota_goal_groups,
+};
+
+/*
+ * quota goals directory
+ */
+
+struct damon_sysfs_quota_goals {
+	struct kobject kobj;
+	struct damon_sysfs_quota_goal **goals_arr;	/* counted by nr */
+	int nr;
+};
+
+static struct damon_sysfs_quota_goals *damon_sysfs_quota_goals_alloc(void)
+{
+	return kzalloc(sizeof(struct damon_sysfs_quota_goals), GFP_KERNEL);
+}
+
+static void damon_sysfs_quota_goals_rm_dirs(
+		struct damon_sysfs_quota_goals *goals)
+{
+	struct damon_sysfs_quota_goal **goals_arr = goals->goals_arr;
+	int i;
+
+	for (i = 0; i < goals->nr; i++)
+		kobject_put(&goals_arr[i]->kobj);
+	goals->nr = 0;
+	kfree(goals_arr);
+	goals->goals_arr = NULL;
+}
+
+static int damon_sysfs_quota_goals_add_dirs(
+		struct damon_sysfs_quota_goals *goals, int nr_goals)
+{
+	struct damon_sysfs_quota_goal **goals_arr, *goal;
+	int err, i;
+
+	damon_sysfs_quota_goals_rm_dirs(goals);
+	if (!nr_goals)
+		return 0;
+
+	goals_arr = kmalloc_array(nr_goals, sizeof(*goals_arr),
+			GFP_KERNEL | __GFP_NOWARN);
+	if (!goals_arr)
+		return -ENOMEM;
+	goals->goals_arr = goals_arr;
+
+	for (i = 0; i < nr_goals; i++) {
+		goal = damon_sysfs_quota_goal_alloc();
+		if (!goal) {
+			damon_sysfs_quota_goals_rm_dirs(goals);
+			return -ENOMEM;
+		}
+
+		err = kobject_init_and_add(&goal->kobj,
+				&damon_sysfs_quota_goal_ktype, &goals->kobj,
+				"%d", i);
+		if (err) {
+			kobject_put(&goal->kobj);
+			damon_sysfs_quota_goals_rm_dirs(goals);
+			return err;
+		}
+
+		goals_arr[i] = goal;
+		goals->nr++;
+	}
+	return 0;
+}
+
+static ssize_t nr_goals_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_quota_goals *goals = container_of(kobj,
+			struct damon_sysfs_quota_goals, kobj);
+
+	return sysfs_emit(buf, "%d\n", goals->nr);
+}
+
+static ssize_t nr_goals_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_quota_goals *goals;
+	int nr, err = kstrtoint(buf, 0, &nr);
+
+	if (err)
+		return err;
+	if (nr < 0)
+		return -EINVAL;
+
+	goals = container_of(kobj, struct damon_sysfs_quota_goals, kobj);
+
+	if (!mutex_trylock(&damon_sysfs_lock))
+		return -EBUSY;
+	err = damon_sysfs_quota_goals_add_dirs(goals, nr);
+	mutex_unlock(&damon_sysfs_lock);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static void damon_sysfs_quota_goals_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct damon_sysfs_quota_goals, kobj));
+}
+
+static struct kobj_attribute damon_sysfs_quota_goals_nr_attr =
+		__ATTR_RW_MODE(nr_goals, 0600);
+
+static struct attribute *damon_sysfs_quota_goals_attrs[] = {
+	&damon_sysfs_quota_goals_nr_attr.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(damon_sysfs_quota_goals);
+
+static const struct kobj_type damon_sysfs_quota_goals_ktype = {
+	.release = damon_sysfs_quota_goals_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_groups = damon_sysfs_quota_goals_groups,
+};
+
 /*
  * quotas directory
  */
@@ -890,6 +1159,7 @@ static const struct kobj_type damon_sysfs_weights_ktype = {
 struct damon_sysfs_quotas {
 	struct kobject kobj;
 	struct damon_sysfs_weights *weights;
+	struct damon_sysfs_quota_goals *goals;
 	unsigned long ms;
 	unsigned long sz;
 	unsigned long reset_interval_ms;
@@ -903,6 +1173,7 @@ static struct damon_sysfs_quotas *damon_sysfs_quotas_alloc(void)
 static int damon_sysfs_quotas_add_dirs(struct damon_sysfs_quotas *quotas)
 {
 	struct damon_sysfs_weights *weights;
+	struct damon_sysfs_quota_goals *goals;
 	int err;
 
 	weights = damon_sysfs_weights_alloc(0, 0, 0);
@@ -911,16 +1182,35 @@ static int damon_sysfs_quotas_add_dirs(struct damon_sysfs_quotas *quotas)
 
 	err = kobject_init_and_add(&weights->kobj, &damon_sysfs_weights_ktype,
 			&quotas->kobj, "weights");
-	if (err)
+	if (err) {
 		kobject_put(&weights->kobj);
-	else
-		quotas->weights = weights;
+		return err;
+	}
+	quotas->weights = weights;
+
+	goals = damon_sysfs_quota_goals_alloc();
+	if (!goals) {
+		kobject_put(&weights->kobj);
+		return -ENOMEM;
+	}
+	err = kobject_init_and_add(&goals->kobj,
+			&damon_sysfs_quota_goals_ktype, &quotas->kobj,
+			"goals");
+	if (err) {
+		kobject_put(&weights->kobj);
+		kobject_put(&goals->kobj);
+	} else {
+		quotas->goals = goals;
+	}
+
 	return err;
 }
 
 static void damon_sysfs_quotas_rm_dirs(struct damon_sysfs_quotas *quotas)
 {
 	kobject_put(&quotas->weights->kobj);
+	damon_sysfs_quota_goals_rm_dirs(quotas->goals);
+	kobject_put(&quotas->goals->kobj);
 }
 
 static ssize_t ms_show(struct kobject *kobj, struct kobj_attribute *attr,
@@ -1573,6 +1863,42 @@ static int damon_sysfs_set_scheme_filters(struct damos *scheme,
 	return 0;
 }
 
+static int damon_sysfs_set_quota_goals(struct damos_quota *quota,
+		struct damon_sysfs_quota_goals *sysfs_goals)
+{
+	struct damos_quota_goal *goal, *next;
+	int i, err;
+
+	damos_for_each_quota_goal_safe(goal, next, quota)
+		damos_destroy_quota_goal(goal);
+
+	for (i = 0; i < sysfs_goals->nr; i++) {
+		struct damon_sysfs_quota_goal *sysfs_goal =
+			sysfs_goals->goals_arr[i];
+
+		if (!sysfs_goal->target_value)
+			continue;
+
+		goal = damos_new_quota_goal(sysfs_goal->metric,
+				sysfs_goal->target_value);
+		if (!goal)
+			return -ENOMEM;
+		if (sysfs_goal->metric == DAMOS_QUOTA_USER_INPUT) {
+			goal->current_value = sysfs_goal->current_value;
+		} else if (sysfs_goal->metric == DAMOS_QUOTA_MEMCG_FREE_BP) {
+			err = damon_sysfs_memcg_path_to_id(
+					sysfs_goal->memcg_path,
+					&goal->memcg_id);
+			if (err) {
+				damos_destroy_quota_goal(goal);
+				return err;
+			}
+		}
+		damos_add_quota_goal(quota, goal);
+	}
+	return 0;
+}
+
 static struct damos *damon_sysfs_mk_scheme(
 		struct damon_sysfs_scheme *sysfs_scheme)
 {
@@ -1615,6 +1941,12 @@ static struct damos *damon_sysfs_mk_scheme(
 	if (!scheme)
 		return NULL;
 
+	err = damon_sysfs_set_quota_goals(&scheme->quota, sysfs_quotas->goals);
+	if (err) {
+		damon_destroy_scheme(scheme);
+		return NULL;
+	}
+
 	err = damon_sysfs_set_scheme_filters(scheme, sysfs_filters);
 	if (err) {
 		damon_destroy_scheme(scheme);
@@ -1649,6 +1981,12 @@ static void damon_sysfs_update_scheme(struct damos *scheme,
 	scheme->quota.weight_nr_accesses = sysfs_weights->nr_accesses;
 	scheme->quota.weight_age = sysfs_weights->age;
 
+	err = damon_sysfs_set_quota_goals(&scheme->quota, sysfs_quotas->goals);
+	if (err) {
+		damon_destroy_scheme(scheme);
+		return;
+	}
+
 	scheme->wmarks.metric = sysfs_wmarks->metric;
 	scheme->wmarks.interval = sysfs_wmarks->interval_us;
 	scheme->wmarks.high = sysfs_wmarks->high;
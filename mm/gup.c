@@ -276,6 +276,20 @@ void unpin_user_page(struct page *page)
 }
 EXPORT_SYMBOL(unpin_user_page);
 
+/**
+ * unpin_user_folio() - release pins of pages of a folio
+ * @folio:  pointer to folio to be released
+ * @npages: number of pinned pages of @folio to release
+ *
+ * Equivalent to calling unpin_user_page() on @npages pages of @folio, with a
+ * single update of the folio's pin count.
+ */
+void unpin_user_folio(struct folio *folio, unsigned long npages)
+{
+	gup_put_folio(folio, npages, FOLL_PIN);
+}
+EXPORT_SYMBOL(unpin_user_folio);
+
 /**
  * folio_add_pin - Try to get an additional pin on a pinned folio
  * @folio: The folio to be pinned
@@ -65,6 +65,16 @@ unsigned long transparent_hugepage_flags __read_mostly =
 	(1<<TRANSPARENT_HUGEPAGE_DEFRAG_KHUGEPAGED_FLAG)|
 	(1<<TRANSPARENT_HUGEPAGE_USE_ZERO_PAGE_FLAG);
 
+/*
+ * Per-order policy for PTE-mapped anonymous large folios, see
+ * THP_ORDERS_ANON_SMALL. An order is in at most one of these masks; orders
+ * in none of them are never used. All start out disabled.
+ */
+unsigned long huge_anon_orders_always __read_mostly;
+unsigned long huge_anon_orders_madvise __read_mostly;
+unsigned long huge_anon_orders_inherit __read_mostly;
+static DEFINE_SPINLOCK(huge_anon_orders_lock);
+
 static struct shrinker deferred_split_shrinker;
 
 static atomic_t huge_zero_refcount;
@@ -151,6 +161,30 @@ bool hugepage_vma_check(struct vm_area_struct *vma, unsigned long vm_flags,
 	return true;
 }
 
+/**
+ * thp_vma_anon_orders - orders of anonymous large folios allowed for a VMA
+ * @vma: the anonymous VMA being faulted
+ *
+ * Return: a bitmask of orders in THP_ORDERS_ANON_SMALL enabled by the
+ * per-size sysfs controls for @vma, or 0 if THP is disabled for it.
+ */
+unsigned long thp_vma_anon_orders(struct vm_area_struct *vma)
+{
+	unsigned long orders = READ_ONCE(huge_anon_orders_always);
+
+	if (vma->vm_flags & VM_HUGEPAGE)
+		orders |= READ_ONCE(huge_anon_orders_madvise);
+	if (hugepage_flags_always() ||
+	    ((vma->vm_flags & VM_HUGEPAGE) && hugepage_flags_enabled()))
+		orders |= READ_ONCE(huge_anon_orders_inherit);
+
+	if (!orders || !hugepage_vma_check(vma, vma->vm_flags, false, true,
+					   false))
+		return 0;
+
+	return orders & THP_ORDERS_ANON_SMALL;
+}
+
 static bool get_huge_zero_page(void)
 {
 	struct page *zero_page;
@@ -391,6 +425,116 @@ static ssize_t hpage_pmd_size_show(struct kobject *kobj,
 static struct kobj_attribute hpage_pmd_size_attr =
 	__ATTR_RO(hpage_pmd_size);
 
+static LIST_HEAD(thpsize_list);
+
+static ssize_t thpsize_enabled_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	int order = to_thpsize(kobj)->order;
+	const char *output;
+
+	if (test_bit(order, &huge_anon_orders_always))
+		output = "[always] inherit madvise never";
+	else if (test_bit(order, &huge_anon_orders_inherit))
+		output = "always [inherit] madvise never";
+	else if (test_bit(order, &huge_anon_orders_madvise))
+		output = "always inherit [madvise] never";
+	else
+		output = "always inherit madvise [never]";
+
+	return sysfs_emit(buf, "%s\n", output);
+}
+
+static ssize_t thpsize_enabled_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	int order = to_thpsize(kobj)->order;
+	unsigned long *policy = NULL;
+
+	if (sysfs_streq(buf, "always"))
+		policy = &huge_anon_orders_always;
+	else if (sysfs_streq(buf, "inherit"))
+		policy = &huge_anon_orders_inherit;
+	else if (sysfs_streq(buf, "madvise"))
+		policy = &huge_anon_orders_madvise;
+	else if (!sysfs_streq(buf, "never"))
+		return -EINVAL;
+
+	spin_lock(&huge_anon_orders_lock);
+	clear_bit(order, &huge_anon_orders_always);
+	clear_bit(order, &huge_anon_orders_inherit);
+	clear_bit(order, &huge_anon_orders_madvise);
+	if (policy)
+		set_bit(order, policy);
+	spin_unlock(&huge_anon_orders_lock);
+
+	return count;
+}
+
+static struct kobj_attribute thpsize_enabled_attr =
+	__ATTR(enabled, 0644, thpsize_enabled_show, thpsize_enabled_store);
+
+static struct attribute *thpsize_attrs[] = {
+	&thpsize_enabled_attr.attr,
+#ifdef CONFIG_SHMEM
+	&thpsize_shmem_enabled_attr.attr,
+#endif
+	NULL,
+};
+
+static const struct attribute_group thpsize_attr_group = {
+	.attrs = thpsize_attrs,
+};
+
+static void thpsize_release(struct kobject *kobj)
+{
+	kfree(to_thpsize(kobj));
+}
+
+static const struct kobj_type thpsize_ktype = {
+	.release = &thpsize_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+};
+
+static struct thpsize * __init thpsize_create(int order, struct kobject *parent)
+{
+	unsigned long size = (PAGE_SIZE << order) / SZ_1K;
+	struct thpsize *thpsize;
+	int ret;
+
+	thpsize = kzalloc(sizeof(*thpsize), GFP_KERNEL);
+	if (!thpsize)
+		return ERR_PTR(-ENOMEM);
+
+	thpsize->order = order;
+
+	ret = kobject_init_and_add(&thpsize->kobj, &thpsize_ktype, parent,
+				   "hugepages-%lukB", size);
+	if (ret) {
+		kobject_put(&thpsize->kobj);
+		return ERR_PTR(ret);
+	}
+
+	ret = sysfs_create_group(&thpsize->kobj, &thpsize_attr_group);
+	if (ret) {
+		kobject_put(&thpsize->kobj);
+		return ERR_PTR(ret);
+	}
+
+	return thpsize;
+}
+
+static void __init thpsize_remove_all(void)
+{
+	struct thpsize *thpsize, *tmp;
+
+	list_for_each_entry_safe(thpsize, tmp, &thpsize_list, node) {
+		list_del(&thpsize->node);
+		kobject_put(&thpsize->kobj);
+	}
+}
+
 static struct attribute *hugepage_attr[] = {
 	&enabled_attr.attr,
 	&defrag_attr.attr,
@@ -408,7 +552,9 @@ static const struct attribute_group hugepage_attr_group = {
 
 static int __init hugepage_init_sysfs(struct kobject **hugepage_kobj)
 {
-	int err;
+	unsigned long orders = THP_ORDERS_ANON_SMALL;
+	struct thpsize *thpsize;
+	int err, order;
 
 	*hugepage_kobj = kobject_create_and_add("transparent_hugepage", mm_kobj);
 	if (unlikely(!*hugepage_kobj)) {
@@ -428,8 +574,21 @@ static int __init hugepage_init_sysfs(struct kobject **hugepage_kobj)
 		goto remove_hp_group;
 	}
 
+	for_each_set_bit(order, &orders, BITS_PER_LONG) {
+		thpsize = thpsize_create(order, *hugepage_kobj);
+		if (IS_ERR(thpsize)) {
+			pr_err("failed to create thpsize for order %d\n", order);
+			err = PTR_ERR(thpsize);
+			goto remove_all;
+		}
+		list_add(&thpsize->node, &thpsize_list);
+	}
+
 	return 0;
 
+remove_all:
+	thpsize_remove_all();
+	sysfs_remove_group(*hugepage_kobj, &khugepaged_attr_group);
 remove_hp_group:
 	sysfs_remove_group(*hugepage_kobj, &hugepage_attr_group);
 delete_obj:
@@ -439,6 +598,7 @@ static int __init hugepage_init_sysfs(struct kobject **hugepage_kobj)
 
 static void __init hugepage_exit_sysfs(struct kobject *hugepage_kobj)
 {
+	thpsize_remove_all();
 	sysfs_remove_group(hugepage_kobj, &khugepaged_attr_group);
 	sysfs_remove_group(hugepage_kobj, &hugepage_attr_group);
 	kobject_put(hugepage_kobj);
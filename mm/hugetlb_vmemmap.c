@@ -26,6 +26,8 @@
  * @reuse_addr:		the virtual address of the @reuse_page page.
  * @vmemmap_pages:	the list head of the vmemmap pages that can be freed
  *			or is mapped from.
+ * @flags:		used to modify behavior in vmemmap page table walking
+ *			operations.
  */
 struct vmemmap_remap_walk {
 	void			(*remap_pte)(pte_t *pte, unsigned long addr,
@@ -34,9 +36,15 @@ struct vmemmap_remap_walk {
 	struct page		*reuse_page;
 	unsigned long		reuse_addr;
 	struct list_head	*vmemmap_pages;
+
+/* Skip the TLB flush when we split the PMD */
+#define VMEMMAP_SPLIT_NO_TLB_FLUSH	BIT(0)
+/* Skip the TLB flush when we remap the PTE */
+#define VMEMMAP_REMAP_NO_TLB_FLUSH	BIT(1)
+	unsigned long		flags;
 };
 
-static int split_vmemmap_huge_pmd(pmd_t *pmd, unsigned long start)
+static int split_vmemmap_huge_pmd(pmd_t *pmd, unsigned long start, bool flush)
 {
 	pmd_t __pmd;
 	int i;
@@ -79,7 +87,8 @@ static int split_vmemmap_huge_pmd(pmd_t *pmd, unsigned long start)
 		/* Make pte visible before pmd. See comment in pmd_install(). */
 		smp_wmb();
 		pmd_populate_kernel(&init_mm, pmd, pgtable);
-		flush_tlb_kernel_range(start, start + PMD_SIZE);
+		if (flush)
+			flush_tlb_kernel_range(start, start + PMD_SIZE);
 	} else {
 		pte_free_kernel(&init_mm, pgtable);
 	}
@@ -126,11 +135,20 @@ static int vmemmap_pmd_range(pud_t *pud, unsigned long addr,
 	do {
 		int ret;
 
-		ret = split_vmemmap_huge_pmd(pmd, addr & PMD_MASK);
+		ret = split_vmemmap_huge_pmd(pmd, addr & PMD_MASK,
+				!(walk->flags & VMEMMAP_SPLIT_NO_TLB_FLUSH));
 		if (ret)
 			return ret;
 
 		next = pmd_addr_end(addr, end);
+
+		/*
+		 * We are only splitting, not remapping the hugetlb vmemmap
+		 * pages.
+		 */
+		if (!walk->remap_pte)
+			continue;
+
 		vmemmap_pte_range(pmd, addr, next, walk);
 	} while (pmd++, addr = next, addr != end);
 
@@ -197,7 +215,8 @@ static int vmemmap_remap_range(unsigned long start, unsigned long end,
 			return ret;
 	} while (pgd++, addr = next, addr != end);
 
-	flush_tlb_kernel_range(start, end);
+	if (walk->remap_pte && !(walk->flags & VMEMMAP_REMAP_NO_TLB_FLUSH))
+		flush_tlb_kernel_range(start, end);
 
 	return 0;
 }
@@ -305,11 +324,15 @@ static void vmemmap_restore_pte(pte_t *pte, unsigned long addr,
  * @end:	end address of the vmemmap virtual address range that we want to
  *		remap.
  * @reuse:	reuse address.
+ * @freed:	list the pages which the range was mapped to are moved to, on
+ *		success. The caller frees them once the TLB has been flushed.
+ * @flags:	modifications to vmemmap_remap_walk flags
  *
  * Return: %0 on success, negative error code otherwise.
  */
 static int vmemmap_remap_free(unsigned long start, unsigned long end,
-			      unsigned long reuse)
+			      unsigned long reuse, struct list_head *freed,
+			      unsigned long flags)
 {
 	int ret;
 	LIST_HEAD(vmemmap_pages);
@@ -317,6 +340,7 @@ static int vmemmap_remap_free(unsigned long start, unsigned long end,
 		.remap_pte	= vmemmap_remap_pte,
 		.reuse_addr	= reuse,
 		.vmemmap_pages	= &vmemmap_pages,
+		.flags		= flags,
 	};
 	int nid = page_to_nid((struct page *)start);
 	gfp_t gfp_mask = GFP_KERNEL | __GFP_THISNODE | __GFP_NORETRY |
@@ -372,7 +396,29 @@ static int vmemmap_remap_free(unsigned long start, unsigned long end,
 	}
 	mmap_read_unlock(&init_mm);
 
-	free_vmemmap_page_list(&vmemmap_pages);
+	if (ret)
+		free_vmemmap_page_list(&vmemmap_pages);
+	else
+		list_splice_tail(&vmemmap_pages, freed);
+
+	return ret;
+}
+
+static int vmemmap_remap_split(unsigned long start, unsigned long end,
+			       unsigned long reuse)
+{
+	int ret;
+	struct vmemmap_remap_walk walk = {
+		.remap_pte	= NULL,
+		.flags		= VMEMMAP_SPLIT_NO_TLB_FLUSH,
+	};
+
+	/* See the comment in the vmemmap_remap_free(). */
+	BUG_ON(start - reuse != PAGE_SIZE);
+
+	mmap_read_lock(&init_mm);
+	ret = vmemmap_remap_range(reuse, end, &walk);
+	mmap_read_unlock(&init_mm);
 
 	return ret;
 }
@@ -384,17 +430,19 @@ static int alloc_vmemmap_page_list(unsigned long start, unsigned long end,
 	unsigned long nr_pages = (end - start) >> PAGE_SHIFT;
 	int nid = page_to_nid((struct page *)start);
 	struct page *page, *next;
+	LIST_HEAD(pages);
 
 	while (nr_pages--) {
 		page = alloc_pages_node(nid, gfp_mask, 0);
 		if (!page)
 			goto out;
-		list_add_tail(&page->lru, list);
+		list_add_tail(&page->lru, &pages);
 	}
 
+	list_splice_tail(&pages, list);
 	return 0;
 out:
-	list_for_each_entry_safe(page, next, list, lru)
+	list_for_each_entry_safe(page, next, &pages, lru)
 		__free_page(page);
 	return -ENOMEM;
 }
@@ -408,30 +456,28 @@ static int alloc_vmemmap_page_list(unsigned long start, unsigned long end,
  * @end:	end address of the vmemmap virtual address range that we want to
  *		remap.
  * @reuse:	reuse address.
- *
- * Return: %0 on success, negative error code otherwise.
+ * @vmemmap_pages: list of pages allocated by alloc_vmemmap_page_list(). The
+ *		first (@end - @start) / PAGE_SIZE of them are consumed.
+ * @flags:	modifications to vmemmap_remap_walk flags
  */
-static int vmemmap_remap_alloc(unsigned long start, unsigned long end,
-			       unsigned long reuse)
+static void vmemmap_remap_alloc(unsigned long start, unsigned long end,
+				unsigned long reuse,
+				struct list_head *vmemmap_pages,
+				unsigned long flags)
 {
-	LIST_HEAD(vmemmap_pages);
 	struct vmemmap_remap_walk walk = {
 		.remap_pte	= vmemmap_restore_pte,
 		.reuse_addr	= reuse,
-		.vmemmap_pages	= &vmemmap_pages,
+		.vmemmap_pages	= vmemmap_pages,
+		.flags		= flags,
 	};
 
 	/* See the comment in the vmemmap_remap_free(). */
 	BUG_ON(start - reuse != PAGE_SIZE);
 
-	if (alloc_vmemmap_page_list(start, end, &vmemmap_pages))
-		return -ENOMEM;
-
 	mmap_read_lock(&init_mm);
 	vmemmap_remap_range(reuse, end, &walk);
 	mmap_read_unlock(&init_mm);
-
-	return 0;
 }
 
 DEFINE_STATIC_KEY_FALSE(hugetlb_optimize_vmemmap_key);
@@ -440,6 +486,31 @@ EXPORT_SYMBOL(hugetlb_optimize_vmemmap_key);
 static bool vmemmap_optimize_enabled = IS_ENABLED(CONFIG_HUGETLB_PAGE_OPTIMIZE_VMEMMAP_DEFAULT_ON);
 core_param(hugetlb_free_vmemmap, vmemmap_optimize_enabled, bool, 0);
 
+static void __hugetlb_vmemmap_restore(const struct hstate *h,
+				      struct page *head,
+				      struct list_head *vmemmap_pages,
+				      unsigned long flags)
+{
+	unsigned long vmemmap_start = (unsigned long)head, vmemmap_end;
+	unsigned long vmemmap_reuse;
+
+	vmemmap_end	= vmemmap_start + hugetlb_vmemmap_size(h);
+	vmemmap_reuse	= vmemmap_start;
+	vmemmap_start	+= HUGETLB_VMEMMAP_RESERVE_SIZE;
+
+	/*
+	 * The pages which the vmemmap virtual address range [@vmemmap_start,
+	 * @vmemmap_end) are mapped to are freed to the buddy allocator, and
+	 * the range is mapped to the page which @vmemmap_reuse is mapped to.
+	 * When a HugeTLB page is freed to the buddy allocator, previously
+	 * discarded vmemmap pages must be allocated and remapping.
+	 */
+	vmemmap_remap_alloc(vmemmap_start, vmemmap_end, vmemmap_reuse,
+			    vmemmap_pages, flags);
+	ClearHPageVmemmapOptimized(head);
+	static_branch_dec(&hugetlb_optimize_vmemmap_key);
+}
+
 /**
  * hugetlb_vmemmap_restore - restore previously optimized (by
  *			     hugetlb_vmemmap_optimize()) vmemmap pages which
@@ -452,31 +523,73 @@ core_param(hugetlb_free_vmemmap, vmemmap_optimize_enabled, bool, 0);
  */
 int hugetlb_vmemmap_restore(const struct hstate *h, struct page *head)
 {
-	int ret;
-	unsigned long vmemmap_start = (unsigned long)head, vmemmap_end;
-	unsigned long vmemmap_reuse;
+	LIST_HEAD(vmemmap_pages);
+	unsigned long vmemmap_start = (unsigned long)head;
 
 	if (!HPageVmemmapOptimized(head))
 		return 0;
 
-	vmemmap_end	= vmemmap_start + hugetlb_vmemmap_size(h);
-	vmemmap_reuse	= vmemmap_start;
-	vmemmap_start	+= HUGETLB_VMEMMAP_RESERVE_SIZE;
+	if (alloc_vmemmap_page_list(vmemmap_start + HUGETLB_VMEMMAP_RESERVE_SIZE,
+				    vmemmap_start + hugetlb_vmemmap_size(h),
+				    &vmemmap_pages))
+		return -ENOMEM;
 
-	/*
-	 * The pages which the vmemmap virtual address range [@vmemmap_start,
-	 * @vmemmap_end) are mapped to are freed to the buddy allocator, and
-	 * the range is mapped to the page which @vmemmap_reuse is mapped to.
-	 * When a HugeTLB page is freed to the buddy allocator, previously
-	 * discarded vmemmap pages must be allocated and remapping.
-	 */
-	ret = vmemmap_remap_alloc(vmemmap_start, vmemmap_end, vmemmap_reuse);
-	if (!ret) {
-		ClearHPageVmemmapOptimized(head);
-		static_branch_dec(&hugetlb_optimize_vmemmap_key);
+	__hugetlb_vmemmap_restore(h, head, &vmemmap_pages, 0);
+
+	return 0;
+}
+
+/**
+ * hugetlb_vmemmap_restore_folios - restore vmemmap for every folio on the list.
+ * @h:			hstate.
+ * @folio_list:		list of folios.
+ * @non_hvo_folios:	output list of folios for which vmemmap exists.
+ *
+ * The vmemmap pages of every optimized folio are allocated before any of
+ * them is remapped, so the remapping itself cannot fail and needs only one
+ * TLB flush for the whole batch. If the allocation falls short, the folios
+ * at the tail of @folio_list that got no pages are left there, still
+ * optimized; all others are moved to @non_hvo_folios.
+ *
+ * Return: number of folios whose vmemmap was restored.
+ */
+long hugetlb_vmemmap_restore_folios(const struct hstate *h,
+				    struct list_head *folio_list,
+				    struct list_head *non_hvo_folios)
+{
+	struct folio *folio, *t_folio;
+	LIST_HEAD(vmemmap_pages);
+	long nr_alloced = 0;
+	long restored = 0;
+
+	list_for_each_entry(folio, folio_list, lru) {
+		unsigned long vmemmap_start = (unsigned long)&folio->page;
+
+		if (!folio_test_hugetlb_vmemmap_optimized(folio))
+			continue;
+		if (alloc_vmemmap_page_list(vmemmap_start + HUGETLB_VMEMMAP_RESERVE_SIZE,
+					    vmemmap_start + hugetlb_vmemmap_size(h),
+					    &vmemmap_pages))
+			break;
+		nr_alloced++;
 	}
 
-	return ret;
+	list_for_each_entry_safe(folio, t_folio, folio_list, lru) {
+		if (folio_test_hugetlb_vmemmap_optimized(folio)) {
+			if (restored == nr_alloced)
+				continue;
+			__hugetlb_vmemmap_restore(h, &folio->page, &vmemmap_pages,
+						  VMEMMAP_REMAP_NO_TLB_FLUSH);
+			restored++;
+		}
+
+		list_move_tail(&folio->lru, non_hvo_folios);
+	}
+
+	if (restored)
+		flush_tlb_all();
+
+	return restored;
 }
 
 /* Return true iff a HugeTLB whose vmemmap should and can be optimized. */
@@ -535,6 +648,36 @@ static bool vmemmap_should_optimize(const struct hstate *h, const struct page *h
 	return true;
 }
 
+static void __hugetlb_vmemmap_optimize(const struct hstate *h,
+				       struct page *head,
+				       struct list_head *vmemmap_pages,
+				       unsigned long flags)
+{
+	unsigned long vmemmap_start = (unsigned long)head, vmemmap_end;
+	unsigned long vmemmap_reuse;
+
+	if (!vmemmap_should_optimize(h, head))
+		return;
+
+	static_branch_inc(&hugetlb_optimize_vmemmap_key);
+
+	vmemmap_end	= vmemmap_start + hugetlb_vmemmap_size(h);
+	vmemmap_reuse	= vmemmap_start;
+	vmemmap_start	+= HUGETLB_VMEMMAP_RESERVE_SIZE;
+
+	/*
+	 * Remap the vmemmap virtual address range [@vmemmap_start, @vmemmap_end)
+	 * to the page which @vmemmap_reuse is mapped to, then add the pages
+	 * which the range [@vmemmap_start, @vmemmap_end] is mapped to to
+	 * @vmemmap_pages, for the caller to free after the TLB flush.
+	 */
+	if (vmemmap_remap_free(vmemmap_start, vmemmap_end, vmemmap_reuse,
+			       vmemmap_pages, flags))
+		static_branch_dec(&hugetlb_optimize_vmemmap_key);
+	else
+		SetHPageVmemmapOptimized(head);
+}
+
 /**
  * hugetlb_vmemmap_optimize - optimize @head page's vmemmap pages.
  * @h:		struct hstate.
@@ -546,28 +689,70 @@ static bool vmemmap_should_optimize(const struct hstate *h, const struct page *h
  * have been optimized.
  */
 void hugetlb_vmemmap_optimize(const struct hstate *h, struct page *head)
+{
+	LIST_HEAD(vmemmap_pages);
+
+	__hugetlb_vmemmap_optimize(h, head, &vmemmap_pages, 0);
+	free_vmemmap_page_list(&vmemmap_pages);
+}
+
+static int hugetlb_vmemmap_split(const struct hstate *h, struct page *head)
 {
 	unsigned long vmemmap_start = (unsigned long)head, vmemmap_end;
 	unsigned long vmemmap_reuse;
 
 	if (!vmemmap_should_optimize(h, head))
-		return;
-
-	static_branch_inc(&hugetlb_optimize_vmemmap_key);
+		return 0;
 
 	vmemmap_end	= vmemmap_start + hugetlb_vmemmap_size(h);
 	vmemmap_reuse	= vmemmap_start;
 	vmemmap_start	+= HUGETLB_VMEMMAP_RESERVE_SIZE;
 
 	/*
-	 * Remap the vmemmap virtual address range [@vmemmap_start, @vmemmap_end)
-	 * to the page which @vmemmap_reuse is mapped to, then free the pages
-	 * which the range [@vmemmap_start, @vmemmap_end] is mapped to.
+	 * Split PMDs on the vmemmap virtual address range [@vmemmap_start,
+	 * @vmemmap_end]
 	 */
-	if (vmemmap_remap_free(vmemmap_start, vmemmap_end, vmemmap_reuse))
-		static_branch_dec(&hugetlb_optimize_vmemmap_key);
-	else
-		SetHPageVmemmapOptimized(head);
+	return vmemmap_remap_split(vmemmap_start, vmemmap_end, vmemmap_reuse);
+}
+
+/**
+ * hugetlb_vmemmap_optimize_folios - optimize the vmemmap of every folio on
+ *				     the list.
+ * @h:		struct hstate.
+ * @folio_list:	list of folios.
+ *
+ * Like hugetlb_vmemmap_optimize() for each folio, but the vmemmap PMDs of
+ * the whole batch are split first and the freed vmemmap pages are given
+ * back only at the end, so that only two TLB flushes are needed in total.
+ */
+void hugetlb_vmemmap_optimize_folios(struct hstate *h, struct list_head *folio_list)
+{
+	struct folio *folio;
+	LIST_HEAD(vmemmap_pages);
+
+	/* Don't pay for the TLB flushes when nothing is going to be remapped */
+	if (list_empty(folio_list) || !READ_ONCE(vmemmap_optimize_enabled) ||
+	    !hugetlb_vmemmap_optimizable(h))
+		return;
+
+	list_for_each_entry(folio, folio_list, lru) {
+		/*
+		 * On failure, the remaining folios split their own PMDs (and
+		 * flush) in __hugetlb_vmemmap_optimize() below.
+		 */
+		if (hugetlb_vmemmap_split(h, &folio->page))
+			break;
+	}
+
+	flush_tlb_all();
+
+	list_for_each_entry(folio, folio_list, lru)
+		__hugetlb_vmemmap_optimize(h, &folio->page, &vmemmap_pages,
+					   VMEMMAP_REMAP_NO_TLB_FLUSH);
+
+	flush_tlb_all();
+
+	free_vmemmap_page_list(&vmemmap_pages);
 }
 
 static struct ctl_table hugetlb_vmemmap_sysctls[] = {
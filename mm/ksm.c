@@ -21,6 +21,7 @@
 #include <linux/sched.h>
 #include <linux/sched/mm.h>
 #include <linux/sched/coredump.h>
+#include <linux/sched/cputime.h>
 #include <linux/rwsem.h>
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
@@ -182,6 +183,8 @@ struct ksm_stable_node {
 #endif
 };
 
+typedef u8 rmap_age_t;
+
 /**
  * struct ksm_rmap_item - reverse mapping item for virtual addresses
  * @rmap_list: next rmap_item in mm_slot's singly-linked rmap_list
@@ -190,6 +193,8 @@ struct ksm_stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @age: number of scan iterations since creation
+ * @remaining_skips: how many scans to skip
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -205,6 +210,8 @@ struct ksm_rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	rmap_age_t age;
+	rmap_age_t remaining_skips;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -270,7 +277,8 @@ static unsigned int ksm_stable_node_chains_prune_millisecs = 2000;
 static int ksm_max_page_sharing = 256;
 
 /* Number of pages ksmd should scan in one batch */
-static unsigned int ksm_thread_pages_to_scan = 100;
+#define DEFAULT_PAGES_TO_SCAN 100
+static unsigned int ksm_thread_pages_to_scan = DEFAULT_PAGES_TO_SCAN;
 
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
@@ -284,6 +292,39 @@ static bool ksm_use_zero_pages __read_mostly;
 /* The number of zero pages which is placed by KSM */
 unsigned long ksm_zero_pages;
 
+/* Skip pages that repeatedly failed to be de-duplicated */
+static bool ksm_smart_scan = true;
+
+/* The number of pages that have been skipped due to "smart scanning" */
+static unsigned long ksm_pages_skipped;
+
+enum ksm_advisor_type {
+	KSM_ADVISOR_NONE,
+	KSM_ADVISOR_CPU,
+};
+
+/* Auto-tuning of pages_to_scan */
+static enum ksm_advisor_type ksm_advisor;
+
+/* Share of one CPU, in percent, that the advisor aims ksmd to consume */
+static unsigned int ksm_advisor_target_cpu = 10;
+
+/* Bounds of the pages_to_scan values picked by the advisor */
+static unsigned int ksm_advisor_min_pages_to_scan = DEFAULT_PAGES_TO_SCAN;
+static unsigned int ksm_advisor_max_pages_to_scan = 30000;
+
+/* How often, in milliseconds, the advisor re-evaluates pages_to_scan */
+#define KSM_ADVISOR_PERIOD_MS	1000
+
+/* Weight, in percent, of the latest sample in the advisor's moving average */
+#define KSM_ADVISOR_EWMA_WEIGHT	30
+
+struct advisor_ctx {
+	ktime_t start;		/* Zero: (re)start measuring */
+	u64 cpu_time;		/* ksmd run time at @start, in ns */
+};
+static struct advisor_ctx advisor_ctx;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -2305,6 +2346,70 @@ static struct ksm_rmap_item *get_next_rmap_item(struct ksm_mm_slot *mm_slot,
 	return rmap_item;
 }
 
+static unsigned int skip_age(rmap_age_t age)
+{
+	if (age <= 3)
+		return 1;
+	if (age <= 5)
+		return 2;
+	if (age <= 8)
+		return 4;
+
+	return 8;
+}
+
+/*
+ * should_skip_rmap_item - decide if the page should be skipped in this scan
+ * @page: page to check
+ * @rmap_item: associated rmap_item of page
+ *
+ * Every scan ages the rmap_item of a page that is not (yet) KSM.  Once the
+ * page has failed to merge for a few scans, it is only looked at every 2,
+ * 4, then 8 scans.
+ */
+static bool should_skip_rmap_item(struct page *page,
+				  struct ksm_rmap_item *rmap_item)
+{
+	rmap_age_t age;
+
+	if (!ksm_smart_scan)
+		return false;
+
+	/*
+	 * Never skip pages that are already KSM; cmp_and_merge_page() will
+	 * essentially ignore them, but they still have to be processed
+	 * properly.
+	 */
+	if (PageKsm(page))
+		return false;
+
+	age = rmap_item->age;
+	if (age != U8_MAX)
+		rmap_item->age++;
+
+	/*
+	 * Smaller ages are not skipped, they need to get a chance to go
+	 * through the different phases of the KSM merging.
+	 */
+	if (age < 3)
+		return false;
+
+	/*
+	 * Are we still allowed to skip? If not, then don't skip it and
+	 * determine how many more scans we are allowed to skip next.
+	 */
+	if (!rmap_item->remaining_skips) {
+		rmap_item->remaining_skips = skip_age(age);
+		return false;
+	}
+
+	/* Skip this page */
+	ksm_pages_skipped++;
+	rmap_item->remaining_skips--;
+	remove_rmap_item_from_tree(rmap_item);
+	return true;
+}
+
 static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -2409,6 +2514,10 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 				if (rmap_item) {
 					ksm_scan.rmap_list =
 							&rmap_item->rmap_list;
+
+					if (should_skip_rmap_item(*page, rmap_item))
+						goto next_page;
+
 					ksm_scan.address += PAGE_SIZE;
 				} else
 					put_page(*page);
@@ -2478,6 +2587,62 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 	return NULL;
 }
 
+static unsigned long ewma(unsigned long prev, unsigned long curr)
+{
+	return ((100 - KSM_ADVISOR_EWMA_WEIGHT) * prev +
+		KSM_ADVISOR_EWMA_WEIGHT * curr) / 100;
+}
+
+/*
+ * The CPU advisor keeps ksmd at ksm_advisor_target_cpu percent of one CPU.
+ * The cost of ksmd is roughly proportional to the number of pages scanned
+ * per batch, so every period it scales pages_to_scan by the ratio between
+ * the target and the measured CPU share, smoothed by a moving average and
+ * capped by the min and max bounds:
+ *
+ *	new_pages_to_scan = pages_to_scan * target_cpu / measured_cpu
+ *
+ * Must be called from ksmd, whose run time is measured.
+ */
+static void ksm_advisor_tune(void)
+{
+	ktime_t now = ktime_get();
+	u64 cpu_time = task_sched_runtime(current);
+	unsigned long used_permil, pages;
+	s64 elapsed_ms;
+
+	if (!advisor_ctx.start)
+		goto restart;
+
+	elapsed_ms = ktime_ms_delta(now, advisor_ctx.start);
+	if (elapsed_ms < KSM_ADVISOR_PERIOD_MS)
+		return;
+
+	used_permil = div64_u64((cpu_time - advisor_ctx.cpu_time) * 1000,
+				elapsed_ms * NSEC_PER_MSEC);
+	used_permil = max(used_permil, 1UL);
+
+	pages = div64_u64((u64)ksm_thread_pages_to_scan *
+			  ksm_advisor_target_cpu * 10, used_permil);
+	pages = ewma(ksm_thread_pages_to_scan, pages);
+	pages = clamp_t(unsigned long, pages, ksm_advisor_min_pages_to_scan,
+			ksm_advisor_max_pages_to_scan);
+	WRITE_ONCE(ksm_thread_pages_to_scan, pages);
+
+restart:
+	advisor_ctx.start = now;
+	advisor_ctx.cpu_time = cpu_time;
+}
+
+static void set_advisor_defaults(void)
+{
+	if (ksm_advisor == KSM_ADVISOR_NONE)
+		ksm_thread_pages_to_scan = DEFAULT_PAGES_TO_SCAN;
+	else
+		ksm_thread_pages_to_scan = ksm_advisor_min_pages_to_scan;
+	advisor_ctx.start = 0;
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages:  number of pages we want to scan before we return.
@@ -2515,8 +2680,11 @@ static int ksm_scan_thread(void *nothing)
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			if (ksm_advisor == KSM_ADVISOR_CPU)
+				ksm_advisor_tune();
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -3159,6 +3327,9 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 	unsigned int nr_pages;
 	int err;
 
+	if (ksm_advisor != KSM_ADVISOR_NONE)
+		return -EINVAL;
+
 	err = kstrtouint(buf, 10, &nr_pages);
 	if (err)
 		return -EINVAL;
@@ -3449,6 +3620,146 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t smart_scan_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_smart_scan);
+}
+
+static ssize_t smart_scan_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	int err;
+	bool value;
+
+	err = kstrtobool(buf, &value);
+	if (err)
+		return -EINVAL;
+
+	ksm_smart_scan = value;
+	return count;
+}
+KSM_ATTR(smart_scan);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
+static ssize_t advisor_mode_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	const char *output;
+
+	if (ksm_advisor == KSM_ADVISOR_NONE)
+		output = "[none] cpu";
+	else
+		output = "none [cpu]";
+
+	return sysfs_emit(buf, "%s\n", output);
+}
+
+static ssize_t advisor_mode_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	enum ksm_advisor_type curr_advisor = ksm_advisor;
+
+	if (sysfs_streq("cpu", buf))
+		ksm_advisor = KSM_ADVISOR_CPU;
+	else if (sysfs_streq("none", buf))
+		ksm_advisor = KSM_ADVISOR_NONE;
+	else
+		return -EINVAL;
+
+	/* Set advisor default values */
+	if (curr_advisor != ksm_advisor) {
+		mutex_lock(&ksm_thread_mutex);
+		set_advisor_defaults();
+		mutex_unlock(&ksm_thread_mutex);
+	}
+
+	return count;
+}
+KSM_ATTR(advisor_mode);
+
+static ssize_t advisor_target_cpu_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_target_cpu);
+}
+
+static ssize_t advisor_target_cpu_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int percent;
+	int err;
+
+	err = kstrtouint(buf, 10, &percent);
+	if (err)
+		return -EINVAL;
+	if (!percent || percent > 100)
+		return -EINVAL;
+
+	ksm_advisor_target_cpu = percent;
+	return count;
+}
+KSM_ATTR(advisor_target_cpu);
+
+static ssize_t advisor_min_pages_to_scan_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_min_pages_to_scan);
+}
+
+static ssize_t advisor_min_pages_to_scan_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	unsigned int nr_pages;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr_pages);
+	if (err)
+		return -EINVAL;
+	if (!nr_pages || nr_pages > ksm_advisor_max_pages_to_scan)
+		return -EINVAL;
+
+	ksm_advisor_min_pages_to_scan = nr_pages;
+	return count;
+}
+KSM_ATTR(advisor_min_pages_to_scan);
+
+static ssize_t advisor_max_pages_to_scan_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_max_pages_to_scan);
+}
+
+static ssize_t advisor_max_pages_to_scan_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	unsigned int nr_pages;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr_pages);
+	if (err)
+		return -EINVAL;
+	if (nr_pages < ksm_advisor_min_pages_to_scan)
+		return -EINVAL;
+
+	ksm_advisor_max_pages_to_scan = nr_pages;
+	return count;
+}
+KSM_ATTR(advisor_max_pages_to_scan);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -3469,6 +3780,12 @@ static struct attribute *ksm_attrs[] = {
 	&stable_node_chains_prune_millisecs_attr.attr,
 	&use_zero_pages_attr.attr,
 	&general_profit_attr.attr,
+	&smart_scan_attr.attr,
+	&pages_skipped_attr.attr,
+	&advisor_mode_attr.attr,
+	&advisor_target_cpu_attr.attr,
+	&advisor_min_pages_to_scan_attr.attr,
+	&advisor_max_pages_to_scan_attr.attr,
 	NULL,
 };
 
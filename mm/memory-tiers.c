@@ -145,8 +145,59 @@ static ssize_t nodelist_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(nodelist);
 
+#ifdef CONFIG_NUMA_BALANCING
+/* Pages promoted into the nodes of this tier */
+static ssize_t pgpromote_success_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	unsigned long nr = 0;
+	nodemask_t nmask;
+	int node;
+
+	mutex_lock(&memory_tier_lock);
+	nmask = get_memtier_nodemask(to_memory_tier(dev));
+	mutex_unlock(&memory_tier_lock);
+	for_each_node_mask(node, nmask) {
+		if (node_online(node))
+			nr += node_page_state(NODE_DATA(node),
+					      PGPROMOTE_SUCCESS);
+	}
+	return sysfs_emit(buf, "%lu\n", nr);
+}
+static DEVICE_ATTR_RO(pgpromote_success);
+#endif
+
+/* Pages demoted off the nodes of this tier */
+static ssize_t pgdemote_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	unsigned long nr = 0;
+	nodemask_t nmask;
+	int node;
+
+	mutex_lock(&memory_tier_lock);
+	nmask = get_memtier_nodemask(to_memory_tier(dev));
+	mutex_unlock(&memory_tier_lock);
+	for_each_node_mask(node, nmask) {
+		struct pglist_data *pgdat;
+
+		if (!node_online(node))
+			continue;
+		pgdat = NODE_DATA(node);
+		nr += node_page_state(pgdat, PGDEMOTE_KSWAPD) +
+		      node_page_state(pgdat, PGDEMOTE_DIRECT) +
+		      node_page_state(pgdat, PGDEMOTE_KHUGEPAGED);
+	}
+	return sysfs_emit(buf, "%lu\n", nr);
+}
+static DEVICE_ATTR_RO(pgdemote);
+
 static struct attribute *memtier_dev_attrs[] = {
 	&dev_attr_nodelist.attr,
+#ifdef CONFIG_NUMA_BALANCING
+	&dev_attr_pgpromote_success.attr,
+#endif
+	&dev_attr_pgdemote.attr,
 	NULL
 };
 
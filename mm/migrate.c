@@ -50,6 +50,8 @@
 #include <linux/random.h>
 #include <linux/sched/sysctl.h>
 #include <linux/memory-tiers.h>
+#include <linux/workqueue.h>
+#include <linux/copy_engine.h>
 
 #include <asm/tlbflush.h>
 
@@ -1255,26 +1257,12 @@ static int migrate_folio_unmap(new_folio_t get_new_folio,
 	return rc;
 }
 
-/* Migrate the folio to the newly allocated folio in dst. */
-static int migrate_folio_move(free_folio_t put_new_folio, unsigned long private,
-			      struct folio *src, struct folio *dst,
-			      enum migrate_mode mode, enum migrate_reason reason,
-			      struct list_head *ret)
+/* Map dst in place of src and release src, once the contents are moved. */
+static void migrate_folio_move_finish(struct folio *src, struct folio *dst,
+				      int page_was_mapped,
+				      struct anon_vma *anon_vma, bool is_lru,
+				      enum migrate_reason reason)
 {
-	int rc;
-	int page_was_mapped = 0;
-	struct anon_vma *anon_vma = NULL;
-	bool is_lru = !__PageMovable(&src->page);
-	struct list_head *prev;
-
-	__migrate_folio_extract(dst, &page_was_mapped, &anon_vma);
-	prev = dst->lru.prev;
-	list_del(&dst->lru);
-
-	rc = move_to_new_folio(dst, src, mode);
-	if (rc)
-		goto out;
-
 	if (unlikely(!is_lru))
 		goto out_unlock_both;
 
@@ -1314,7 +1302,30 @@ static int migrate_folio_move(free_folio_t put_new_folio, unsigned long private,
 		put_anon_vma(anon_vma);
 	folio_unlock(src);
 	migrate_folio_done(src, reason);
+}
+
+/* Migrate the folio to the newly allocated folio in dst. */
+static int migrate_folio_move(free_folio_t put_new_folio, unsigned long private,
+			      struct folio *src, struct folio *dst,
+			      enum migrate_mode mode, enum migrate_reason reason,
+			      struct list_head *ret)
+{
+	int rc;
+	int page_was_mapped = 0;
+	struct anon_vma *anon_vma = NULL;
+	bool is_lru = !__PageMovable(&src->page);
+	struct list_head *prev;
+
+	__migrate_folio_extract(dst, &page_was_mapped, &anon_vma);
+	prev = dst->lru.prev;
+	list_del(&dst->lru);
+
+	rc = move_to_new_folio(dst, src, mode);
+	if (rc)
+		goto out;
 
+	migrate_folio_move_finish(src, dst, page_was_mapped, anon_vma, is_lru,
+				  reason);
 	return rc;
 out:
 	/*
@@ -1333,6 +1344,185 @@ static int migrate_folio_move(free_folio_t put_new_folio, unsigned long private,
 	return rc;
 }
 
+/*
+ * Batched copy
+ *
+ * For folios using the generic migrate_folio() or filemap_migrate_folio(),
+ * migrate_pages_batch() splits the move step in three: every folio of the
+ * batch first has its mapping switched over to dst (which freezes the src
+ * reference count, so nobody can write to src any more), then the contents
+ * of the whole batch are copied, spread over helper threads, and finally
+ * each dst gets the flags of src and is mapped in place of src.
+ */
+struct migrate_copy_folio {
+	struct folio *src;
+	struct folio *dst;
+	int page_was_mapped;
+	struct anon_vma *anon_vma;
+};
+
+struct migrate_copy_work {
+	struct work_struct work;
+	struct migrate_copy_folio *folios;
+	int nr;
+};
+
+/* Up to this many threads, each copying at least MIGRATE_COPY_CHUNK_PAGES */
+#define MIGRATE_COPY_MAX_THREADS	8
+#define MIGRATE_COPY_CHUNK_PAGES	64
+
+static struct workqueue_struct *migrate_copy_wq;
+
+static bool migrate_folio_batch_copyable(struct folio *src)
+{
+	struct address_space *mapping;
+
+	if (__PageMovable(&src->page))
+		return false;
+
+	mapping = folio_mapping(src);
+	if (!mapping)
+		return true;
+	return mapping->a_ops->migrate_folio == migrate_folio ||
+	       mapping->a_ops->migrate_folio == filemap_migrate_folio;
+}
+
+/*
+ * Move the mapping of src over to dst without copying the contents: the
+ * first half of migrate_folio() and filemap_migrate_folio().
+ */
+static int migrate_folio_move_prep(struct folio *src, struct folio *dst,
+				   struct migrate_copy_folio *mcf)
+{
+	struct address_space *mapping = folio_mapping(src);
+	int page_was_mapped = 0;
+	struct anon_vma *anon_vma = NULL;
+	int rc;
+
+	VM_BUG_ON_FOLIO(!folio_test_locked(src), src);
+	VM_BUG_ON_FOLIO(!folio_test_locked(dst), dst);
+	BUG_ON(folio_test_writeback(src));	/* Writeback must be complete */
+
+	/* folio_migrate_mapping() overwrites what is recorded in dst */
+	__migrate_folio_extract(dst, &page_was_mapped, &anon_vma);
+	rc = folio_migrate_mapping(mapping, dst, src, 0);
+	if (rc != MIGRATEPAGE_SUCCESS) {
+		__migrate_folio_record(dst, page_was_mapped, anon_vma);
+		return rc;
+	}
+
+	if (mapping && mapping->a_ops->migrate_folio == filemap_migrate_folio &&
+	    folio_get_private(src))
+		folio_attach_private(dst, folio_detach_private(src));
+
+	mcf->src = src;
+	mcf->dst = dst;
+	mcf->page_was_mapped = page_was_mapped;
+	mcf->anon_vma = anon_vma;
+	return MIGRATEPAGE_SUCCESS;
+}
+
+/* The second half of migrate_folio(), then of migrate_folio_move() */
+static void migrate_folio_batch_finish(struct migrate_copy_folio *mcf,
+				       enum migrate_reason reason)
+{
+	struct folio *src = mcf->src, *dst = mcf->dst;
+
+	folio_migrate_flags(dst, src);
+	/* See move_to_new_folio() */
+	if (!folio_mapping_flags(src))
+		src->mapping = NULL;
+	flush_dcache_folio(dst);
+
+	migrate_folio_move_finish(src, dst, mcf->page_was_mapped,
+				  mcf->anon_vma, true, reason);
+}
+
+static void migrate_copy_folios(struct migrate_copy_folio *folios, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (!copy_engine_copy_folio(folios[i].dst, folios[i].src))
+			folio_copy(folios[i].dst, folios[i].src);
+	}
+}
+
+static void migrate_copy_work_fn(struct work_struct *work)
+{
+	struct migrate_copy_work *mcw =
+		container_of(work, struct migrate_copy_work, work);
+
+	migrate_copy_folios(mcw->folios, mcw->nr);
+}
+
+/* Return the end of the slice starting at @start, of at least @nr_pages */
+static int migrate_copy_slice_end(struct migrate_copy_folio *folios,
+				  int start, int nr, unsigned long nr_pages)
+{
+	unsigned long slice_pages = 0;
+
+	while (start < nr && slice_pages < nr_pages)
+		slice_pages += folio_nr_pages(folios[start++].src);
+	return start;
+}
+
+/*
+ * Copy the contents of all folios of the batch.  Large enough batches are
+ * cut into slices of about the same number of pages; the caller copies the
+ * first slice while migrate_copy_wq workers copy the others.  Each folio may
+ * in turn be offloaded to a DMA engine, as this runs in sleepable context.
+ */
+static void migrate_copy_batch(struct migrate_copy_folio *folios, int nr)
+{
+	struct migrate_copy_work works[MIGRATE_COPY_MAX_THREADS - 1];
+	unsigned long nr_pages = 0, per_thread;
+	int i, start, end, first_end, nr_threads, nr_works = 0;
+
+	for (i = 0; i < nr; i++)
+		nr_pages += folio_nr_pages(folios[i].src);
+
+	nr_threads = min3(nr_pages / MIGRATE_COPY_CHUNK_PAGES,
+			  (unsigned long)MIGRATE_COPY_MAX_THREADS,
+			  (unsigned long)num_online_cpus());
+	if (!migrate_copy_wq || nr_threads <= 1 || nr <= 1) {
+		migrate_copy_folios(folios, nr);
+		return;
+	}
+
+	/* Every slice but the last has per_thread pages or more */
+	per_thread = DIV_ROUND_UP(nr_pages, nr_threads);
+	first_end = migrate_copy_slice_end(folios, 0, nr, per_thread);
+	for (start = first_end; start < nr; start = end) {
+		struct migrate_copy_work *mcw = &works[nr_works++];
+
+		end = migrate_copy_slice_end(folios, start, nr, per_thread);
+		INIT_WORK_ONSTACK(&mcw->work, migrate_copy_work_fn);
+		mcw->folios = &folios[start];
+		mcw->nr = end - start;
+		queue_work(migrate_copy_wq, &mcw->work);
+	}
+
+	migrate_copy_folios(folios, first_end);
+
+	for (i = 0; i < nr_works; i++) {
+		flush_work(&works[i].work);
+		destroy_work_on_stack(&works[i].work);
+	}
+}
+
+static int __init migrate_copy_init(void)
+{
+	/* Migration can run on behalf of reclaim, the workers must not stall */
+	migrate_copy_wq = alloc_workqueue("migrate_copy",
+					 WQ_UNBOUND | WQ_HIGHPRI |
+					 WQ_MEM_RECLAIM, 0);
+	if (!migrate_copy_wq)
+		pr_warn("failed to create migrate_copy workqueue\n");
+	return 0;
+}
+subsys_initcall(migrate_copy_init);
+
 /*
  * Counterpart of unmap_and_move_page() for hugepage migration.
  *
@@ -1617,8 +1807,11 @@ static int migrate_pages_batch(struct list_head *from,
 	bool is_thp = false;
 	struct folio *folio, *folio2, *dst = NULL, *dst2;
 	int rc, rc_saved = 0, nr_pages;
+	struct migrate_copy_folio *copy_folios;
+	int i, nr_copy;
 	LIST_HEAD(unmap_folios);
 	LIST_HEAD(dst_folios);
+	LIST_HEAD(copy_src_folios);
 	bool nosplit = (reason == MR_NUMA_MISPLACED);
 
 	VM_WARN_ON_ONCE(mode != MIGRATE_ASYNC &&
@@ -1742,11 +1935,21 @@ static int migrate_pages_batch(struct list_head *from,
 	/* Flush TLBs for all unmapped folios */
 	try_to_unmap_flush();
 
+	/*
+	 * Without room to track the batch, fall back to copying each folio
+	 * right when it is moved.
+	 */
+	nr_copy = list_count_nodes(&unmap_folios);
+	copy_folios = nr_copy > 1 ?
+		kmalloc_array(nr_copy, sizeof(*copy_folios),
+			      GFP_NOWAIT | __GFP_NOWARN) : NULL;
+
 	retry = 1;
 	for (pass = 0; pass < nr_pass && retry; pass++) {
 		retry = 0;
 		thp_retry = 0;
 		nr_retry_pages = 0;
+		nr_copy = 0;
 
 		dst = list_first_entry(&dst_folios, struct folio, lru);
 		dst2 = list_next_entry(dst, lru);
@@ -1756,12 +1959,25 @@ static int migrate_pages_batch(struct list_head *from,
 
 			cond_resched();
 
-			rc = migrate_folio_move(put_new_folio, private,
-						folio, dst, mode,
-						reason, ret_folios);
+			if (copy_folios && migrate_folio_batch_copyable(folio)) {
+				rc = migrate_folio_move_prep(folio, dst,
+						&copy_folios[nr_copy]);
+				if (rc == MIGRATEPAGE_SUCCESS) {
+					/* Keep the pair off the retry lists */
+					list_del(&dst->lru);
+					list_move_tail(&folio->lru,
+						       &copy_src_folios);
+					nr_copy++;
+				}
+			} else {
+				rc = migrate_folio_move(put_new_folio, private,
+							folio, dst, mode,
+							reason, ret_folios);
+			}
 			/*
 			 * The rules are:
-			 *	Success: folio will be freed
+			 *	Success: folio will be freed, once copied if
+			 *		 in copy_folios
 			 *	-EAGAIN: stay on the unmap_folios list
 			 *	Other errno: put on ret_folios list
 			 */
@@ -1784,7 +2000,16 @@ static int migrate_pages_batch(struct list_head *from,
 			dst = dst2;
 			dst2 = list_next_entry(dst, lru);
 		}
+
+		/* Mappings are switched over, copy and finish the batch */
+		if (nr_copy) {
+			migrate_copy_batch(copy_folios, nr_copy);
+			for (i = 0; i < nr_copy; i++)
+				migrate_folio_batch_finish(&copy_folios[i],
+							   reason);
+		}
 	}
+	kfree(copy_folios);
 	nr_failed += retry;
 	stats->nr_thp_failed += thp_retry;
 	stats->nr_failed_pages += nr_retry_pages;
@@ -1750,8 +1750,11 @@ static int balance_dirty_pages(struct bdi_writeback *wb,
 		 * background_thresh, to keep the amount of dirty memory low.
 		 */
 		if (!laptop_mode && nr_reclaimable > gdtc->bg_thresh &&
-		    !writeback_in_progress(wb))
+		    !writeback_in_progress(wb)) {
+			/* lets blk-wbt get ahead of the coming flush */
+			wb->dirty_flush = now;
 			wb_start_background_writeback(wb);
+		}
 
 		/*
 		 * Throttle it only when the background writeback cannot
@@ -1784,8 +1787,10 @@ static int balance_dirty_pages(struct bdi_writeback *wb,
 		}
 
 		/* Start writeback even when in laptop mode */
-		if (unlikely(!writeback_in_progress(wb)))
+		if (unlikely(!writeback_in_progress(wb))) {
+			wb->dirty_flush = now;
 			wb_start_background_writeback(wb);
+		}
 
 		mem_cgroup_flush_foreign(wb);
 
@@ -483,6 +483,41 @@ static inline int ra_alloc_folio(struct readahead_control *ractl, pgoff_t index,
 	return 0;
 }
 
+/*
+ * Pick the folio order for the next readahead window, given the order of the
+ * folio that triggered it.
+ *
+ * While the window is still ramping up, the order grows by 2 each round.
+ * Once the window has reached its maximum the stream has proven sequential,
+ * so use the largest order that fits the window straight away.  Folios larger
+ * than the biggest request the device takes would only be split over several
+ * I/Os, so the order does not grow past that.
+ */
+static unsigned int ra_next_order(struct readahead_control *ractl,
+		struct file_ra_state *ra, unsigned int order)
+{
+	struct backing_dev_info *bdi = inode_to_bdi(ractl->mapping->host);
+	unsigned int max_order = MAX_PAGECACHE_ORDER;
+
+	if (order >= MAX_PAGECACHE_ORDER)
+		return order;
+
+	if (bdi->io_pages)
+		max_order = min(max_order, max_t(unsigned int, order,
+						 ilog2(bdi->io_pages)));
+	max_order = min_t(unsigned int, max_order, ilog2(ra->size));
+
+	if (ra->size >= ra->ra_pages)
+		order = max_order;
+	else
+		order = min(order + 2, max_order);
+
+	/* Order-1 file folios are not supported */
+	if (order == 1)
+		order = 0;
+	return order;
+}
+
 void page_cache_ra_order(struct readahead_control *ractl,
 		struct file_ra_state *ra, unsigned int new_order)
 {
@@ -498,13 +533,7 @@ void page_cache_ra_order(struct readahead_control *ractl,
 
 	limit = min(limit, index + ra->size - 1);
 
-	if (new_order < MAX_PAGECACHE_ORDER) {
-		new_order += 2;
-		if (new_order > MAX_PAGECACHE_ORDER)
-			new_order = MAX_PAGECACHE_ORDER;
-		while ((1 << new_order) > ra->size)
-			new_order--;
-	}
+	new_order = ra_next_order(ractl, ra, new_order);
 
 	filemap_invalidate_lock_shared(mapping);
 	while (index <= limit) {
@@ -522,6 +551,16 @@ void page_cache_ra_order(struct readahead_control *ractl,
 				order = 0;
 		}
 		err = ra_alloc_folio(ractl, index, mark, order, gfp);
+		if (err == -ENOMEM && order) {
+			/*
+			 * Memory is too fragmented for this order: step down
+			 * for the rest of the window.  The readahead mark
+			 * lands on one of the smaller folios, so the next
+			 * window starts ramping up again from there.
+			 */
+			new_order = order > 2 ? order - 2 : 0;
+			continue;
+		}
 		if (err)
 			break;
 		index += 1UL << order;
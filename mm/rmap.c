@@ -1266,8 +1266,10 @@ void page_add_anon_rmap(struct page *page, struct vm_area_struct *vma,
  * This means the inc-and-test can be bypassed.
  * The folio does not have to be locked.
  *
- * If the folio is large, it is accounted as a THP.  As the folio
- * is new, it's assumed to be mapped exclusively by a single process.
+ * If the folio is PMD-mappable, it is accounted as a THP; a smaller large
+ * folio is mapped by PTEs covering all of its pages starting at @address.
+ * As the folio is new, it's assumed to be mapped exclusively by a single
+ * process.
  */
 void folio_add_new_anon_rmap(struct folio *folio, struct vm_area_struct *vma,
 		unsigned long address)
@@ -1278,19 +1280,30 @@ void folio_add_new_anon_rmap(struct folio *folio, struct vm_area_struct *vma,
 	__folio_set_swapbacked(folio);
 
 	if (likely(!folio_test_pmd_mappable(folio))) {
-		/* increment count (starts at -1) */
-		atomic_set(&folio->_mapcount, 0);
-		nr = 1;
+		int i;
+
+		nr = folio_nr_pages(folio);
+		for (i = 0; i < nr; i++) {
+			struct page *page = folio_page(folio, i);
+
+			/* increment count (starts at -1) */
+			atomic_set(&page->_mapcount, 0);
+			__page_set_anon_rmap(folio, page, vma,
+					     address + (i << PAGE_SHIFT), 1);
+		}
+
+		if (folio_test_large(folio))
+			atomic_set(&folio->_nr_pages_mapped, nr);
 	} else {
 		/* increment count (starts at -1) */
 		atomic_set(&folio->_entire_mapcount, 0);
 		atomic_set(&folio->_nr_pages_mapped, COMPOUND_MAPPED);
 		nr = folio_nr_pages(folio);
 		__lruvec_stat_mod_folio(folio, NR_ANON_THPS, nr);
+		__page_set_anon_rmap(folio, &folio->page, vma, address, 1);
 	}
 
 	__lruvec_stat_mod_folio(folio, NR_ANON_MAPPED, nr);
-	__page_set_anon_rmap(folio, &folio->page, vma, address, 1);
 }
 
 /**
@@ -535,31 +535,34 @@ static bool shmem_confirm_swap(struct address_space *mapping,
 
 static int shmem_huge __read_mostly = SHMEM_HUGE_NEVER;
 
-bool shmem_is_huge(struct inode *inode, pgoff_t index, bool shmem_huge_force,
-		   struct mm_struct *mm, unsigned long vm_flags)
+/*
+ * Per-order policy for shmem large folios smaller than PMD size, set through
+ * /sys/kernel/mm/transparent_hugepage/hugepages-<size>kB/shmem_enabled.
+ * "inherit" follows shmem_enabled and the huge= mount option, the others
+ * behave like the huge= value of the same name. An order is in at most one
+ * of these masks; orders in none of them are never used.
+ */
+static unsigned long huge_shmem_orders_always __read_mostly;
+static unsigned long huge_shmem_orders_within_size __read_mostly;
+static unsigned long huge_shmem_orders_madvise __read_mostly;
+static unsigned long huge_shmem_orders_inherit __read_mostly;
+
+static bool shmem_huge_order_allowed(int huge, struct inode *inode,
+		pgoff_t index, int order, unsigned long vm_flags)
 {
 	loff_t i_size;
 
-	if (!S_ISREG(inode->i_mode))
-		return false;
-	if (mm && ((vm_flags & VM_NOHUGEPAGE) || test_bit(MMF_DISABLE_THP, &mm->flags)))
-		return false;
-	if (shmem_huge == SHMEM_HUGE_DENY)
-		return false;
-	if (shmem_huge_force || shmem_huge == SHMEM_HUGE_FORCE)
-		return true;
-
-	switch (SHMEM_SB(inode->i_sb)->huge) {
+	switch (huge) {
 	case SHMEM_HUGE_ALWAYS:
 		return true;
 	case SHMEM_HUGE_WITHIN_SIZE:
-		index = round_up(index + 1, HPAGE_PMD_NR);
+		index = round_up(index + 1, 1UL << order);
 		i_size = round_up(i_size_read(inode), PAGE_SIZE);
 		if (i_size >> PAGE_SHIFT >= index)
 			return true;
 		fallthrough;
 	case SHMEM_HUGE_ADVISE:
-		if (mm && (vm_flags & VM_HUGEPAGE))
+		if (vm_flags & VM_HUGEPAGE)
 			return true;
 		fallthrough;
 	default:
@@ -567,6 +570,81 @@ bool shmem_is_huge(struct inode *inode, pgoff_t index, bool shmem_huge_force,
 	}
 }
 
+bool shmem_is_huge(struct inode *inode, pgoff_t index, bool shmem_huge_force,
+		   struct mm_struct *mm, unsigned long vm_flags)
+{
+	if (!S_ISREG(inode->i_mode))
+		return false;
+	if (mm && ((vm_flags & VM_NOHUGEPAGE) || test_bit(MMF_DISABLE_THP, &mm->flags)))
+		return false;
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return false;
+	if (shmem_huge_force || shmem_huge == SHMEM_HUGE_FORCE)
+		return true;
+
+	return shmem_huge_order_allowed(SHMEM_SB(inode->i_sb)->huge, inode,
+					index, HPAGE_PMD_ORDER,
+					mm ? vm_flags : 0);
+}
+
+/*
+ * Return the orders that may back the page cache at @index: PMD order as
+ * decided by shmem_is_huge(), plus the smaller orders enabled through
+ * hugepages-<size>kB/shmem_enabled. A smaller folio must not extend past
+ * i_size, or past the end of the write or fallocate in progress, so that
+ * it never needs splitting by shmem_unused_huge_shrink().
+ */
+static unsigned long shmem_huge_orders(struct inode *inode, pgoff_t index,
+		enum sgp_type sgp, struct vm_area_struct *vma)
+{
+	unsigned long vm_flags = vma ? vma->vm_flags : 0;
+	unsigned long orders = 0, mask;
+	pgoff_t end;
+	int huge, order;
+
+	if (shmem_is_huge(inode, index, false, vma ? vma->vm_mm : NULL,
+			  vm_flags))
+		orders = BIT(HPAGE_PMD_ORDER);
+
+	if (!S_ISREG(inode->i_mode) || shmem_huge == SHMEM_HUGE_DENY)
+		return orders;
+	if (vma && ((vm_flags & VM_NOHUGEPAGE) ||
+		    test_bit(MMF_DISABLE_THP, &vma->vm_mm->flags)))
+		return orders;
+
+	orders |= READ_ONCE(huge_shmem_orders_always);
+	if (vm_flags & VM_HUGEPAGE)
+		orders |= READ_ONCE(huge_shmem_orders_madvise);
+
+	mask = READ_ONCE(huge_shmem_orders_within_size);
+	for_each_set_bit(order, &mask, HPAGE_PMD_ORDER) {
+		if (shmem_huge_order_allowed(SHMEM_HUGE_WITHIN_SIZE, inode,
+					     index, order, vm_flags))
+			orders |= BIT(order);
+	}
+
+	huge = shmem_huge == SHMEM_HUGE_FORCE ? SHMEM_HUGE_ALWAYS :
+						SHMEM_SB(inode->i_sb)->huge;
+	mask = READ_ONCE(huge_shmem_orders_inherit);
+	for_each_set_bit(order, &mask, HPAGE_PMD_ORDER) {
+		if (shmem_huge_order_allowed(huge, inode, index, order,
+					     vm_flags))
+			orders |= BIT(order);
+	}
+
+	/* alloc_end is stable under i_rwsem, held for SGP_WRITE and SGP_FALLOC */
+	end = DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE);
+	if (sgp >= SGP_WRITE)
+		end = max(end, SHMEM_I(inode)->alloc_end);
+	mask = orders & (BIT(HPAGE_PMD_ORDER) - 1);
+	for_each_set_bit(order, &mask, HPAGE_PMD_ORDER) {
+		if (round_down(index, 1UL << order) + (1UL << order) > end)
+			orders &= ~BIT(order);
+	}
+
+	return orders;
+}
+
 #if defined(CONFIG_SYSFS)
 static int shmem_parse_huge(const char *str)
 {
@@ -748,6 +826,12 @@ bool shmem_is_huge(struct inode *inode, pgoff_t index, bool shmem_huge_force,
 	return false;
 }
 
+static unsigned long shmem_huge_orders(struct inode *inode, pgoff_t index,
+		enum sgp_type sgp, struct vm_area_struct *vma)
+{
+	return 0;
+}
+
 static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 		struct shrink_control *sc, unsigned long nr_to_split)
 {
@@ -1449,6 +1533,8 @@ static int shmem_writepage(struct page *page, struct writeback_control *wbc)
 	 * If /sys/kernel/mm/transparent_hugepage/shmem_enabled is "always" or
 	 * "force", drivers/gpu/drm/i915/gem/i915_gem_shmem.c gets huge pages,
 	 * and its shmem_writeback() needs them to be split when swapping.
+	 * Folios of the smaller hugepages-<size>kB/shmem_enabled orders are
+	 * split too: swap slots are only allocated a page or a PMD at a time.
 	 */
 	if (folio_test_large(folio)) {
 		/* Ensure the subpages are still dirty */
@@ -1628,22 +1714,23 @@ static gfp_t limit_gfp_mask(gfp_t huge_gfp, gfp_t limit_gfp)
 }
 
 static struct folio *shmem_alloc_hugefolio(gfp_t gfp,
-		struct shmem_inode_info *info, pgoff_t index)
+		struct shmem_inode_info *info, pgoff_t index, int order)
 {
 	struct vm_area_struct pvma;
 	struct address_space *mapping = info->vfs_inode.i_mapping;
+	bool pmd = order == HPAGE_PMD_ORDER;
+	unsigned long nr = 1UL << order;
 	pgoff_t hindex;
 	struct folio *folio;
 
-	hindex = round_down(index, HPAGE_PMD_NR);
-	if (xa_find(&mapping->i_pages, &hindex, hindex + HPAGE_PMD_NR - 1,
-								XA_PRESENT))
+	hindex = round_down(index, nr);
+	if (xa_find(&mapping->i_pages, &hindex, hindex + nr - 1, XA_PRESENT))
 		return NULL;
 
 	shmem_pseudo_vma_init(&pvma, info, hindex);
-	folio = vma_alloc_folio(gfp, HPAGE_PMD_ORDER, &pvma, 0, true);
+	folio = vma_alloc_folio(gfp, order, &pvma, 0, pmd);
 	shmem_pseudo_vma_destroy(&pvma);
-	if (!folio)
+	if (!folio && pmd)
 		count_vm_event(THP_FILE_FALLBACK);
 	return folio;
 }
@@ -1661,35 +1748,47 @@ static struct folio *shmem_alloc_folio(gfp_t gfp,
 	return folio;
 }
 
+/*
+ * Allocate a folio of the largest order in @orders that fits, trying each
+ * smaller order in turn; an empty @orders allocates a single page.
+ */
 static struct folio *shmem_alloc_and_acct_folio(gfp_t gfp, struct inode *inode,
-		pgoff_t index, bool huge)
+		pgoff_t index, unsigned long orders)
 {
 	struct shmem_inode_info *info = SHMEM_I(inode);
 	struct folio *folio;
+	int order = 0;
 	int nr;
 	int err;
 
 	if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
-		huge = false;
-	nr = huge ? HPAGE_PMD_NR : 1;
+		orders = 0;
 
-	err = shmem_inode_acct_block(inode, nr);
-	if (err)
-		goto failed;
+	do {
+		if (orders)
+			order = __fls(orders);
+		nr = 1 << order;
 
-	if (huge)
-		folio = shmem_alloc_hugefolio(gfp, info, index);
-	else
-		folio = shmem_alloc_folio(gfp, info, index);
-	if (folio) {
-		__folio_set_locked(folio);
-		__folio_set_swapbacked(folio);
-		return folio;
-	}
+		err = shmem_inode_acct_block(inode, nr);
+		if (err)
+			goto next;
+
+		if (order)
+			folio = shmem_alloc_hugefolio(gfp, info, index, order);
+		else
+			folio = shmem_alloc_folio(gfp, info, index);
+		if (folio) {
+			__folio_set_locked(folio);
+			__folio_set_swapbacked(folio);
+			return folio;
+		}
+
+		err = -ENOMEM;
+		shmem_inode_unacct_blocks(inode, nr);
+next:
+		orders &= ~BIT(order);
+	} while (orders);
 
-	err = -ENOMEM;
-	shmem_inode_unacct_blocks(inode, nr);
-failed:
 	return ERR_PTR(err);
 }
 
@@ -1934,6 +2033,7 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 	struct shmem_sb_info *sbinfo;
 	struct mm_struct *charge_mm;
 	struct folio *folio;
+	unsigned long orders;
 	pgoff_t hindex;
 	gfp_t huge_gfp;
 	int error;
@@ -2008,16 +2108,16 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 		return 0;
 	}
 
-	if (!shmem_is_huge(inode, index, false,
-			   vma ? vma->vm_mm : NULL, vma ? vma->vm_flags : 0))
+	orders = shmem_huge_orders(inode, index, sgp, vma);
+	if (!orders)
 		goto alloc_nohuge;
 
 	huge_gfp = vma_thp_gfp_mask(vma);
 	huge_gfp = limit_gfp_mask(huge_gfp, gfp);
-	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, true);
+	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, orders);
 	if (IS_ERR(folio)) {
 alloc_nohuge:
-		folio = shmem_alloc_and_acct_folio(gfp, inode, index, false);
+		folio = shmem_alloc_and_acct_folio(gfp, inode, index, 0);
 	}
 	if (IS_ERR(folio)) {
 		int retry = 5;
@@ -2850,6 +2950,7 @@ static ssize_t shmem_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
 	struct file *file = iocb->ki_filp;
 	struct inode *inode = file->f_mapping->host;
+	struct shmem_inode_info *info = SHMEM_I(inode);
 	ssize_t ret;
 
 	inode_lock(inode);
@@ -2862,7 +2963,14 @@ static ssize_t shmem_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	ret = file_update_time(file);
 	if (ret)
 		goto unlock;
+	/*
+	 * generic_perform_write() asks for one page at a time: let
+	 * shmem_huge_orders() size new folios to the whole write instead.
+	 */
+	info->alloc_end = DIV_ROUND_UP(iocb->ki_pos + iov_iter_count(from),
+				       PAGE_SIZE);
 	ret = generic_perform_write(iocb, from);
+	info->alloc_end = 0;
 unlock:
 	inode_unlock(inode);
 	return ret;
@@ -3107,6 +3215,7 @@ static long shmem_fallocate(struct file *file, int mode, loff_t offset,
 	undo_fallocend = info->fallocend;
 	if (info->fallocend < end)
 		info->fallocend = end;
+	info->alloc_end = end;
 
 	for (index = start; index < end; ) {
 		struct folio *folio;
@@ -3167,6 +3276,7 @@ static long shmem_fallocate(struct file *file, int mode, loff_t offset,
 	if (!(mode & FALLOC_FL_KEEP_SIZE) && offset + len > inode->i_size)
 		i_size_write(inode, offset + len);
 undone:
+	info->alloc_end = 0;
 	spin_lock(&inode->i_lock);
 	inode->i_private = NULL;
 	spin_unlock(&inode->i_lock);
@@ -4692,6 +4802,62 @@ static ssize_t shmem_enabled_store(struct kobject *kobj,
 }
 
 struct kobj_attribute shmem_enabled_attr = __ATTR_RW(shmem_enabled);
+
+static DEFINE_SPINLOCK(huge_shmem_orders_lock);
+
+static ssize_t thpsize_shmem_enabled_show(struct kobject *kobj,
+					  struct kobj_attribute *attr, char *buf)
+{
+	int order = to_thpsize(kobj)->order;
+	const char *output;
+
+	if (test_bit(order, &huge_shmem_orders_always))
+		output = "[always] inherit within_size advise never";
+	else if (test_bit(order, &huge_shmem_orders_inherit))
+		output = "always [inherit] within_size advise never";
+	else if (test_bit(order, &huge_shmem_orders_within_size))
+		output = "always inherit [within_size] advise never";
+	else if (test_bit(order, &huge_shmem_orders_madvise))
+		output = "always inherit within_size [advise] never";
+	else
+		output = "always inherit within_size advise [never]";
+
+	return sysfs_emit(buf, "%s\n", output);
+}
+
+static ssize_t thpsize_shmem_enabled_store(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   const char *buf, size_t count)
+{
+	int order = to_thpsize(kobj)->order;
+	unsigned long *policy = NULL;
+
+	if (sysfs_streq(buf, "always"))
+		policy = &huge_shmem_orders_always;
+	else if (sysfs_streq(buf, "inherit"))
+		policy = &huge_shmem_orders_inherit;
+	else if (sysfs_streq(buf, "within_size"))
+		policy = &huge_shmem_orders_within_size;
+	else if (sysfs_streq(buf, "advise"))
+		policy = &huge_shmem_orders_madvise;
+	else if (!sysfs_streq(buf, "never"))
+		return -EINVAL;
+
+	spin_lock(&huge_shmem_orders_lock);
+	clear_bit(order, &huge_shmem_orders_always);
+	clear_bit(order, &huge_shmem_orders_inherit);
+	clear_bit(order, &huge_shmem_orders_within_size);
+	clear_bit(order, &huge_shmem_orders_madvise);
+	if (policy)
+		set_bit(order, policy);
+	spin_unlock(&huge_shmem_orders_lock);
+
+	return count;
+}
+
+struct kobj_attribute thpsize_shmem_enabled_attr =
+	__ATTR(shmem_enabled, 0644, thpsize_shmem_enabled_show,
+	       thpsize_shmem_enabled_store);
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE && CONFIG_SYSFS */
 
 #else /* !CONFIG_SHMEM */
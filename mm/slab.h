@@ -773,6 +773,17 @@ static inline void slab_post_alloc_hook(struct kmem_cache *s,
 /*
  * The slab lists for all objects.
  */
+#if defined(CONFIG_SLUB) && !defined(CONFIG_SLUB_TINY)
+/* Full and empty sheaves exchanged between the cpus of a node */
+struct node_barn {
+	spinlock_t lock;
+	struct list_head sheaves_full;
+	struct list_head sheaves_empty;
+	unsigned int nr_full;
+	unsigned int nr_empty;
+};
+#endif
+
 struct kmem_cache_node {
 #ifdef CONFIG_SLAB
 	raw_spinlock_t list_lock;
@@ -799,6 +810,9 @@ struct kmem_cache_node {
 	atomic_long_t total_objects;
 	struct list_head full;
 #endif
+#ifndef CONFIG_SLUB_TINY
+	struct node_barn barn;
+#endif
 #endif
 
 };
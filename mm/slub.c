@@ -2483,6 +2483,80 @@ static void init_kmem_cache_cpus(struct kmem_cache *s)
 	}
 }
 
+/*
+ * Sheaves are an optional per cpu layer of object arrays in front of the cpu
+ * slab, enabled for a few hot caches (see slub_sheaves=) that see many frees
+ * on cpus other than the allocating one. A free pushes the object to the
+ * cpu's main sheaf whatever slab it belongs to, and an allocation pops it
+ * again, so neither touches slab freelists or the node list_lock. Full and
+ * empty sheaves are traded with the per node barn, which hands objects freed
+ * on one cpu to the other cpus of the node in bulk.
+ *
+ * Only objects of the local node and from non-pfmemalloc slabs are put into
+ * sheaves, and caches with debugging enabled never use them.
+ */
+struct slab_sheaf {
+	struct list_head barn_list;
+	unsigned int size;
+	void *objects[];
+};
+
+struct slub_percpu_sheaves {
+	local_lock_t lock;
+	struct slab_sheaf *main;	/* Sheaf to allocate from and free to */
+	struct slab_sheaf *spare;	/* Swapped with main before the barn */
+};
+
+#define BARN_MAX_FULL		10
+#define BARN_MAX_EMPTY		10
+
+static unsigned int slub_sheaf_capacity = 32;
+static const char *slub_sheaves_caches =
+	"skbuff_head_cache,io_kiocb,filp,dentry";
+
+static int __init setup_slub_sheaves(char *str)
+{
+	if (!*str || !strcmp(str, "off"))
+		slub_sheaves_caches = NULL;
+	else
+		slub_sheaves_caches = str;
+
+	return 1;
+}
+__setup("slub_sheaves=", setup_slub_sheaves);
+
+static int __init setup_slub_sheaf_capacity(char *str)
+{
+	get_option(&str, (int *)&slub_sheaf_capacity);
+
+	return 1;
+}
+__setup("slub_sheaf_capacity=", setup_slub_sheaf_capacity);
+
+static bool slub_sheaves_wanted(const char *name)
+{
+	const char *list = slub_sheaves_caches;
+	size_t len = strlen(name);
+
+	while (list && *list) {
+		const char *end = strchrnul(list, ',');
+
+		if (end - list == len && !strncmp(list, name, len))
+			return true;
+		list = *end ? end + 1 : end;
+	}
+	return false;
+}
+
+static void init_barn(struct node_barn *barn)
+{
+	spin_lock_init(&barn->lock);
+	INIT_LIST_HEAD(&barn->sheaves_full);
+	INIT_LIST_HEAD(&barn->sheaves_empty);
+	barn->nr_full = 0;
+	barn->nr_empty = 0;
+}
+
 /*
  * Finishes removing the cpu slab. Merges cpu's freelist with slab's freelist,
  * unfreezes the slabs and puts it on the proper list.
@@ -2764,12 +2838,21 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	}
 }
 
+static void pcs_flush(struct kmem_cache *s);
+static void pcs_flush_cpu(struct kmem_cache *s, int cpu);
+static void flush_all_barns(struct kmem_cache *s);
+
 static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
-	void *freelist = c->freelist;
-	struct slab *slab = c->slab;
+	void *freelist;
+	struct slab *slab;
 
+	/* Sheaf objects may go to the cpu slab, so flush them first */
+	pcs_flush_cpu(s, cpu);
+
+	freelist = c->freelist;
+	slab = c->slab;
 	c->slab = NULL;
 	c->freelist = NULL;
 	c->tid = next_tid(c->tid);
@@ -2802,6 +2885,7 @@ static void flush_cpu_slab(struct work_struct *w)
 	sfw = container_of(w, struct slub_flush_work, work);
 
 	s = sfw->s;
+	pcs_flush(s);
 	c = this_cpu_ptr(s->cpu_slab);
 
 	if (c->slab)
@@ -2814,6 +2898,13 @@ static bool has_cpu_slab(int cpu, struct kmem_cache *s)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_sheaves) {
+		struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+		if (READ_ONCE(pcs->main) || READ_ONCE(pcs->spare))
+			return true;
+	}
+
 	return c->slab || slub_percpu_partial(c);
 }
 
@@ -2848,6 +2939,8 @@ static void flush_all_cpus_locked(struct kmem_cache *s)
 	}
 
 	mutex_unlock(&flush_lock);
+
+	flush_all_barns(s);
 }
 
 static void flush_all(struct kmem_cache *s)
@@ -3400,7 +3493,94 @@ static __always_inline void *__slab_alloc_node(struct kmem_cache *s,
 
 	return object;
 }
+
+/*
+ * Make a non-empty sheaf the main one, by swapping with the spare or by trading
+ * the empty main sheaf for a full one from the barn. Called with the sheaves
+ * lock held.
+ */
+static bool pcs_refill_main(struct kmem_cache *s, struct slub_percpu_sheaves *pcs)
+{
+	struct slab_sheaf *empty = pcs->main;
+	struct slab_sheaf *full = NULL;
+	struct kmem_cache_node *n;
+	struct node_barn *barn;
+
+	if (pcs->spare && pcs->spare->size) {
+		swap(pcs->main, pcs->spare);
+		return true;
+	}
+
+	/* The spare is NULL or empty here, keep one empty sheaf around */
+	if (empty && !pcs->spare) {
+		pcs->spare = empty;
+		pcs->main = NULL;
+		empty = NULL;
+	}
+
+	n = get_node(s, numa_mem_id());
+	if (!n)
+		return false;
+	barn = &n->barn;
+
+	spin_lock(&barn->lock);
+	if (barn->nr_full) {
+		full = list_first_entry(&barn->sheaves_full, struct slab_sheaf,
+					barn_list);
+		list_del(&full->barn_list);
+		barn->nr_full--;
+		if (empty && barn->nr_empty < BARN_MAX_EMPTY) {
+			list_add(&empty->barn_list, &barn->sheaves_empty);
+			barn->nr_empty++;
+			empty = NULL;
+		}
+	}
+	spin_unlock(&barn->lock);
+
+	if (!full)
+		return false;
+
+	kfree(empty);
+	pcs->main = full;
+	stat(s, BARN_GET);
+	return true;
+}
+
+static __always_inline void *alloc_from_pcs(struct kmem_cache *s, int node)
+{
+	struct slub_percpu_sheaves *pcs;
+	unsigned long flags;
+	void *object = NULL;
+
+	if (!s->cpu_sheaves)
+		return NULL;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	/* Sheaves only hold objects of the local node */
+	if (unlikely(node != NUMA_NO_NODE && node != numa_mem_id()))
+		goto out;
+
+	if (unlikely(!pcs->main || !pcs->main->size)) {
+		if (!pcs_refill_main(s, pcs))
+			goto out;
+	}
+
+	object = pcs->main->objects[--pcs->main->size];
+out:
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (object)
+		stat(s, ALLOC_PCS);
+	return object;
+}
 #else /* CONFIG_SLUB_TINY */
+static inline void *alloc_from_pcs(struct kmem_cache *s, int node)
+{
+	return NULL;
+}
+
 static void *__slab_alloc_node(struct kmem_cache *s,
 		gfp_t gfpflags, int node, unsigned long addr, size_t orig_size)
 {
@@ -3465,7 +3645,9 @@ static __fastpath_inline void *slab_alloc_node(struct kmem_cache *s, struct list
 	if (unlikely(object))
 		goto out;
 
-	object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
+	object = alloc_from_pcs(s, node);
+	if (!object)
+		object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
 
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
@@ -3786,6 +3968,182 @@ static __always_inline void do_slab_free(struct kmem_cache *s,
 	}
 	stat(s, FREE_FASTPATH);
 }
+
+/*
+ * Make a sheaf with free space the main one, by swapping with the spare or by
+ * trading the full main sheaf for an empty one from the barn, allocating a new
+ * empty sheaf if the barn has none. Called with the sheaves lock held.
+ */
+static bool pcs_make_room(struct kmem_cache *s, struct slub_percpu_sheaves *pcs)
+{
+	struct slab_sheaf *full = pcs->main;
+	struct slab_sheaf *empty = NULL;
+	struct kmem_cache_node *n;
+	struct node_barn *barn;
+
+	if (pcs->spare && pcs->spare->size < s->sheaf_capacity) {
+		swap(pcs->main, pcs->spare);
+		return true;
+	}
+
+	/* The spare is NULL or full here, park a full main sheaf there first */
+	if (full && !pcs->spare) {
+		pcs->spare = full;
+		pcs->main = NULL;
+		full = NULL;
+	}
+
+	n = get_node(s, numa_mem_id());
+	if (!n)
+		return false;
+	barn = &n->barn;
+
+	spin_lock(&barn->lock);
+	if (full) {
+		if (barn->nr_full >= BARN_MAX_FULL) {
+			spin_unlock(&barn->lock);
+			return false;
+		}
+		list_add_tail(&full->barn_list, &barn->sheaves_full);
+		barn->nr_full++;
+		pcs->main = NULL;
+	}
+	if (barn->nr_empty) {
+		empty = list_first_entry(&barn->sheaves_empty, struct slab_sheaf,
+					 barn_list);
+		list_del(&empty->barn_list);
+		barn->nr_empty--;
+	}
+	spin_unlock(&barn->lock);
+
+	if (full)
+		stat(s, BARN_PUT);
+
+	if (!empty) {
+		empty = kmalloc(struct_size(empty, objects, s->sheaf_capacity),
+				GFP_NOWAIT | __GFP_NOWARN);
+		if (!empty)
+			return false;
+		empty->size = 0;
+	}
+
+	pcs->main = empty;
+	return true;
+}
+
+static __always_inline bool free_to_pcs(struct kmem_cache *s,
+					struct slab *slab, void *object)
+{
+	struct slub_percpu_sheaves *pcs;
+	unsigned long flags;
+	bool ret = false;
+
+	if (!s->cpu_sheaves || unlikely(slab_test_pfmemalloc(slab)))
+		return false;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	if (unlikely(slab_nid(slab) != numa_mem_id()))
+		goto out;
+
+	if (unlikely(!pcs->main || pcs->main->size == s->sheaf_capacity)) {
+		if (!pcs_make_room(s, pcs))
+			goto out;
+	}
+
+	pcs->main->objects[pcs->main->size++] = object;
+	ret = true;
+out:
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (ret)
+		stat(s, FREE_PCS);
+	return ret;
+}
+
+/* Return the objects of a detached sheaf to their slabs and free it */
+static void sheaf_free(struct kmem_cache *s, struct slab_sheaf *sheaf)
+{
+	if (!sheaf)
+		return;
+
+	if (sheaf->size)
+		stat(s, SHEAF_FLUSH);
+
+	while (sheaf->size) {
+		void *object = sheaf->objects[--sheaf->size];
+
+		do_slab_free(s, virt_to_slab(object), object, NULL, 1, _RET_IP_);
+	}
+	kfree(sheaf);
+}
+
+/* Flush the sheaves of the current cpu */
+static void pcs_flush(struct kmem_cache *s)
+{
+	struct slub_percpu_sheaves *pcs;
+	struct slab_sheaf *main, *spare;
+	unsigned long flags;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	main = pcs->main;
+	spare = pcs->spare;
+	pcs->main = NULL;
+	pcs->spare = NULL;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	sheaf_free(s, main);
+	sheaf_free(s, spare);
+}
+
+/* Flush the sheaves of a cpu that went offline */
+static void pcs_flush_cpu(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaves *pcs;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+	sheaf_free(s, pcs->main);
+	sheaf_free(s, pcs->spare);
+	pcs->main = NULL;
+	pcs->spare = NULL;
+}
+
+static void barn_flush(struct kmem_cache *s, struct node_barn *barn)
+{
+	struct slab_sheaf *sheaf, *tmp;
+	unsigned long flags;
+	LIST_HEAD(sheaves);
+
+	spin_lock_irqsave(&barn->lock, flags);
+	list_splice_init(&barn->sheaves_full, &sheaves);
+	list_splice_init(&barn->sheaves_empty, &sheaves);
+	barn->nr_full = 0;
+	barn->nr_empty = 0;
+	spin_unlock_irqrestore(&barn->lock, flags);
+
+	list_for_each_entry_safe(sheaf, tmp, &sheaves, barn_list)
+		sheaf_free(s, sheaf);
+}
+
+static void flush_all_barns(struct kmem_cache *s)
+{
+	struct kmem_cache_node *n;
+	int node;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	for_each_kmem_cache_node(s, node, n)
+		barn_flush(s, &n->barn);
+}
 #else /* CONFIG_SLUB_TINY */
 static void do_slab_free(struct kmem_cache *s,
 				struct slab *slab, void *head, void *tail,
@@ -3795,6 +4153,12 @@ static void do_slab_free(struct kmem_cache *s,
 
 	__slab_free(s, slab, head, tail_obj, cnt, addr);
 }
+
+static inline bool free_to_pcs(struct kmem_cache *s, struct slab *slab,
+			       void *object)
+{
+	return false;
+}
 #endif /* CONFIG_SLUB_TINY */
 
 static __fastpath_inline void slab_free(struct kmem_cache *s, struct slab *slab,
@@ -3806,8 +4170,13 @@ static __fastpath_inline void slab_free(struct kmem_cache *s, struct slab *slab,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail, &cnt))
-		do_slab_free(s, slab, head, tail, cnt, addr);
+	if (!slab_free_freelist_hook(s, &head, &tail, &cnt))
+		return;
+
+	if (cnt == 1 && free_to_pcs(s, slab, head))
+		return;
+
+	do_slab_free(s, slab, head, tail, cnt, addr);
 }
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -4210,6 +4579,9 @@ init_kmem_cache_node(struct kmem_cache_node *n)
 	atomic_long_set(&n->total_objects, 0);
 	INIT_LIST_HEAD(&n->full);
 #endif
+#ifndef CONFIG_SLUB_TINY
+	init_barn(&n->barn);
+#endif
 }
 
 #ifndef CONFIG_SLUB_TINY
@@ -4233,11 +4605,56 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 
 	return 1;
 }
+
+static int alloc_kmem_cache_sheaves(struct kmem_cache *s)
+{
+	int cpu;
+
+	if (!slub_sheaf_capacity || slab_state < UP || kmem_cache_debug(s) ||
+	    (s->flags & SLAB_KMALLOC) || !slub_sheaves_wanted(s->name))
+		return 1;
+
+	s->cpu_sheaves = alloc_percpu(struct slub_percpu_sheaves);
+	if (!s->cpu_sheaves)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+		local_lock_init(&pcs->lock);
+	}
+	s->sheaf_capacity = slub_sheaf_capacity;
+
+	return 1;
+}
+
+static void free_kmem_cache_sheaves(struct kmem_cache *s)
+{
+	int cpu;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	/* The sheaves were flushed on shutdown, only the arrays remain */
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+		kfree(pcs->main);
+		kfree(pcs->spare);
+	}
+	free_percpu(s->cpu_sheaves);
+	s->cpu_sheaves = NULL;
+}
 #else
 static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 {
 	return 1;
 }
+
+static inline int alloc_kmem_cache_sheaves(struct kmem_cache *s)
+{
+	return 1;
+}
 #endif /* CONFIG_SLUB_TINY */
 
 static struct kmem_cache *kmem_cache_node;
@@ -4302,6 +4719,7 @@ void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
 #ifndef CONFIG_SLUB_TINY
+	free_kmem_cache_sheaves(s);
 	free_percpu(s->cpu_slab);
 #endif
 	free_kmem_cache_nodes(s);
@@ -4557,7 +4975,7 @@ static int kmem_cache_open(struct kmem_cache *s, slab_flags_t flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s) && alloc_kmem_cache_sheaves(s))
 		return 0;
 
 error:
@@ -5554,6 +5972,12 @@ static ssize_t objs_per_slab_show(struct kmem_cache *s, char *buf)
 }
 SLAB_ATTR_RO(objs_per_slab);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", s->sheaf_capacity);
+}
+SLAB_ATTR_RO(sheaf_capacity);
+
 static ssize_t order_show(struct kmem_cache *s, char *buf)
 {
 	return sysfs_emit(buf, "%u\n", oo_order(s->oo));
@@ -5933,6 +6357,11 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_PCS, alloc_cpu_sheaf);
+STAT_ATTR(FREE_PCS, free_cpu_sheaf);
+STAT_ATTR(BARN_GET, barn_get);
+STAT_ATTR(BARN_PUT, barn_put);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 #ifdef CONFIG_KFENCE
@@ -5962,6 +6391,7 @@ static struct attribute *slab_attrs[] = {
 	&slab_size_attr.attr,
 	&object_size_attr.attr,
 	&objs_per_slab_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
@@ -6020,6 +6450,11 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_cpu_sheaf_attr.attr,
+	&free_cpu_sheaf_attr.attr,
+	&barn_get_attr.attr,
+	&barn_put_attr.attr,
+	&sheaf_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
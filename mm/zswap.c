@@ -34,6 +34,8 @@
 #include <linux/writeback.h>
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
+#include <linux/list_lru.h>
+#include <linux/memcontrol.h>
 
 #include "swap.h"
 #include "internal.h"
@@ -141,6 +143,13 @@ static bool zswap_exclusive_loads_enabled = IS_ENABLED(
 		CONFIG_ZSWAP_EXCLUSIVE_LOADS_DEFAULT_ON);
 module_param_named(exclusive_loads, zswap_exclusive_loads_enabled, bool, 0644);
 
+/*
+ * Enable/disable the memory pressure driven writeback of cold entries to the
+ * backing swap device (disabled by default)
+ */
+static bool zswap_shrinker_enabled;
+module_param_named(shrinker_enabled, zswap_shrinker_enabled, bool, 0644);
+
 /* Number of zpools in zswap_pool (empirically determined for scalability) */
 #define ZSWAP_NR_ZPOOLS 32
 
@@ -157,10 +166,16 @@ struct crypto_acomp_ctx {
 };
 
 /*
- * The lock ordering is zswap_tree.lock -> zswap_pool.lru_lock.
- * The only case where lru_lock is not acquired while holding tree.lock is
- * when a zswap_entry is taken off the lru for writeback, in that case it
- * needs to be verified that it's still valid in the tree.
+ * The lock ordering is zswap_tree.lock -> zswap_pool.list_lru lock.
+ * The only case where the list_lru lock is not acquired while holding
+ * tree.lock is when a zswap_entry is taken off the lru for writeback, in
+ * that case it needs to be verified that it's still valid in the tree.
+ *
+ * The list_lru is memcg aware: entries are kept on the LRU of the cgroup
+ * they are charged to, so that both the pool limit and cgroup limits push
+ * out the coldest entries of the right cgroup. next_shrink is the cursor of
+ * the cgroup round-robin done by the pool limit shrink_worker, protected by
+ * zswap_pools_lock.
  */
 struct zswap_pool {
 	struct zpool *zpools[ZSWAP_NR_ZPOOLS];
@@ -171,8 +186,9 @@ struct zswap_pool {
 	struct work_struct shrink_work;
 	struct hlist_node node;
 	char tfm_name[CRYPTO_MAX_ALG_NAME];
-	struct list_head lru;
-	spinlock_t lru_lock;
+	struct list_lru list_lru;
+	struct mem_cgroup *next_shrink;
+	struct shrinker shrinker;
 };
 
 /*
@@ -197,6 +213,8 @@ struct zswap_pool {
  * value - value of the same-value filled pages which have same content
  * objcg - the obj_cgroup that the compressed memory is charged to
  * lru - handle to the pool's lru used to evict pages.
+ * referenced - true if the entry was stored or loaded since the memory
+ *              pressure shrinker last looked at it.
  */
 struct zswap_entry {
 	struct rb_node rbnode;
@@ -210,6 +228,7 @@ struct zswap_entry {
 	};
 	struct obj_cgroup *objcg;
 	struct list_head lru;
+	bool referenced;
 };
 
 /*
@@ -380,6 +399,45 @@ static struct zpool *zswap_find_zpool(struct zswap_entry *entry)
 	return entry->pool->zpools[i];
 }
 
+/*********************************
+* lru functions
+**********************************/
+/* caller must hold the RCU read lock */
+static struct mem_cgroup *zswap_entry_memcg(struct zswap_entry *entry)
+{
+#ifdef CONFIG_MEMCG_KMEM
+	return entry->objcg ? obj_cgroup_memcg(entry->objcg) : NULL;
+#else
+	return NULL;
+#endif
+}
+
+static int zswap_entry_nid(struct zswap_entry *entry)
+{
+	return page_to_nid(virt_to_page(entry));
+}
+
+static void zswap_lru_add(struct list_lru *list_lru, struct zswap_entry *entry)
+{
+	/*
+	 * The objcg may be reparented concurrently, the RCU read lock keeps
+	 * the memcg it currently points to alive; list_lru reparenting is
+	 * serialized against us by the list_lru node lock.
+	 */
+	rcu_read_lock();
+	list_lru_add_memcg(list_lru, &entry->lru, zswap_entry_nid(entry),
+			   zswap_entry_memcg(entry));
+	rcu_read_unlock();
+}
+
+static void zswap_lru_del(struct list_lru *list_lru, struct zswap_entry *entry)
+{
+	rcu_read_lock();
+	list_lru_del_memcg(list_lru, &entry->lru, zswap_entry_nid(entry),
+			   zswap_entry_memcg(entry));
+	rcu_read_unlock();
+}
+
 /*
  * Carries out the common pattern of freeing and entry's zpool allocation,
  * freeing the entry itself, and decrementing the number of stored pages.
@@ -393,9 +451,7 @@ static void zswap_free_entry(struct zswap_entry *entry)
 	if (!entry->length)
 		atomic_dec(&zswap_same_filled_pages);
 	else {
-		spin_lock(&entry->pool->lru_lock);
-		list_del(&entry->lru);
-		spin_unlock(&entry->pool->lru_lock);
+		zswap_lru_del(&entry->pool->list_lru, entry);
 		zpool_free(zswap_find_zpool(entry), entry->handle);
 		zswap_pool_put(entry->pool);
 	}
@@ -629,21 +685,28 @@ static void zswap_invalidate_entry(struct zswap_tree *tree,
 		zswap_entry_put(tree, entry);
 }
 
-static int zswap_reclaim_entry(struct zswap_pool *pool)
+struct zswap_shrink_ctx {
+	bool second_chance;
+	bool encountered_page_in_swapcache;
+};
+
+static enum lru_status shrink_memcg_cb(struct list_head *item,
+				       struct list_lru_one *l,
+				       spinlock_t *lock, void *arg)
 {
-	struct zswap_entry *entry;
+	struct zswap_entry *entry = container_of(item, struct zswap_entry, lru);
+	struct zswap_shrink_ctx *ctx = arg;
 	struct zswap_tree *tree;
 	pgoff_t swpoffset;
 	int ret;
 
-	/* Get an entry off the LRU */
-	spin_lock(&pool->lru_lock);
-	if (list_empty(&pool->lru)) {
-		spin_unlock(&pool->lru_lock);
-		return -EINVAL;
+	/* Give entries that were used since the last pass another round */
+	if (ctx->second_chance && entry->referenced) {
+		entry->referenced = false;
+		return LRU_ROTATE;
 	}
-	entry = list_last_entry(&pool->lru, struct zswap_entry, lru);
-	list_del_init(&entry->lru);
+
+	list_lru_isolate(l, item);
 	/*
 	 * Once the lru lock is dropped, the entry might get freed. The
 	 * swpoffset is copied to the stack, and entry isn't deref'd again
@@ -651,14 +714,13 @@ static int zswap_reclaim_entry(struct zswap_pool *pool)
 	 */
 	swpoffset = swp_offset(entry->swpentry);
 	tree = zswap_trees[swp_type(entry->swpentry)];
-	spin_unlock(&pool->lru_lock);
+	spin_unlock(lock);
 
 	/* Check for invalidate() race */
 	spin_lock(&tree->lock);
-	if (entry != zswap_rb_search(&tree->rbroot, swpoffset)) {
-		ret = -EAGAIN;
+	if (entry != zswap_rb_search(&tree->rbroot, swpoffset))
 		goto unlock;
-	}
+
 	/* Hold a reference to prevent a free during writeback */
 	zswap_entry_get(entry);
 	spin_unlock(&tree->lock);
@@ -668,9 +730,10 @@ static int zswap_reclaim_entry(struct zswap_pool *pool)
 	spin_lock(&tree->lock);
 	if (ret) {
 		/* Writeback failed, put entry back on LRU */
-		spin_lock(&pool->lru_lock);
-		list_move(&entry->lru, &pool->lru);
-		spin_unlock(&pool->lru_lock);
+		zswap_reject_reclaim_fail++;
+		zswap_lru_add(&entry->pool->list_lru, entry);
+		if (ret == -EEXIST)
+			ctx->encountered_page_in_swapcache = true;
 		goto put_unlock;
 	}
 
@@ -686,29 +749,159 @@ static int zswap_reclaim_entry(struct zswap_pool *pool)
 	zswap_entry_put(tree, entry);
 unlock:
 	spin_unlock(&tree->lock);
-	return ret ? -EAGAIN : 0;
+	spin_lock(lock);
+	return LRU_REMOVED_RETRY;
+}
+
+/*
+ * Write back the coldest entry of @memcg on each node. Returns 0 if at least
+ * one entry was written back, -EAGAIN if none could be, or -ENOENT if the
+ * cgroup went offline.
+ */
+static int shrink_memcg(struct zswap_pool *pool, struct mem_cgroup *memcg)
+{
+	struct zswap_shrink_ctx ctx = { };
+	unsigned long nr_written = 0;
+	int nid;
+
+	if (memcg && !mem_cgroup_online(memcg))
+		return -ENOENT;
+
+	for_each_node_state(nid, N_NORMAL_MEMORY) {
+		unsigned long nr_to_walk = 1;
+
+		nr_written += list_lru_walk_one(&pool->list_lru, nid, memcg,
+						&shrink_memcg_cb, &ctx,
+						&nr_to_walk);
+	}
+	return nr_written ? 0 : -EAGAIN;
 }
 
 static void shrink_worker(struct work_struct *w)
 {
 	struct zswap_pool *pool = container_of(w, typeof(*pool),
 						shrink_work);
+	struct mem_cgroup *memcg;
 	int ret, failures = 0;
 
+	/* Global reclaim goes round-robin over all cgroups */
 	do {
-		ret = zswap_reclaim_entry(pool);
-		if (ret) {
-			zswap_reject_reclaim_fail++;
-			if (ret != -EAGAIN)
-				break;
-			if (++failures == MAX_RECLAIM_RETRIES)
-				break;
+		if (mem_cgroup_disabled()) {
+			memcg = NULL;
+		} else {
+			spin_lock(&zswap_pools_lock);
+			pool->next_shrink = mem_cgroup_iter(NULL,
+						pool->next_shrink, NULL);
+			memcg = pool->next_shrink;
+			/*
+			 * A full round trip through the hierarchy without a
+			 * single writeback counts as a failure.
+			 */
+			if (!memcg) {
+				spin_unlock(&zswap_pools_lock);
+				if (++failures == MAX_RECLAIM_RETRIES)
+					break;
+				goto resched;
+			}
+			if (!mem_cgroup_tryget(memcg)) {
+				spin_unlock(&zswap_pools_lock);
+				goto resched;
+			}
+			spin_unlock(&zswap_pools_lock);
 		}
+
+		ret = shrink_memcg(pool, memcg);
+		mem_cgroup_put(memcg);
+		if (ret == -ENOENT)
+			continue;
+		if (ret && ++failures == MAX_RECLAIM_RETRIES)
+			break;
+resched:
 		cond_resched();
 	} while (!zswap_can_accept());
 	zswap_pool_put(pool);
 }
 
+#ifdef CONFIG_MEMCG_KMEM
+/* Write back an entry of the cgroup @objcg belongs to */
+static int zswap_shrink_objcg(struct obj_cgroup *objcg)
+{
+	struct mem_cgroup *memcg;
+	struct zswap_pool *pool;
+	int ret = -ENOENT;
+
+	pool = zswap_pool_current_get();
+	if (!pool)
+		return ret;
+
+	memcg = get_mem_cgroup_from_objcg(objcg);
+	ret = shrink_memcg(pool, memcg);
+	mem_cgroup_put(memcg);
+	zswap_pool_put(pool);
+	return ret;
+}
+
+/* Make sure the LRU of the cgroup @objcg belongs to exists in @pool */
+static int zswap_objcg_lru_alloc(struct zswap_pool *pool,
+				 struct obj_cgroup *objcg)
+{
+	struct mem_cgroup *memcg;
+	int ret;
+
+	memcg = get_mem_cgroup_from_objcg(objcg);
+	ret = memcg_list_lru_alloc(memcg, &pool->list_lru, GFP_KERNEL);
+	mem_cgroup_put(memcg);
+	return ret;
+}
+#else
+static inline int zswap_shrink_objcg(struct obj_cgroup *objcg)
+{
+	return -ENOENT;
+}
+
+static inline int zswap_objcg_lru_alloc(struct zswap_pool *pool,
+					struct obj_cgroup *objcg)
+{
+	return 0;
+}
+#endif
+
+static unsigned long zswap_shrinker_count(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+	struct zswap_pool *pool = container_of(shrinker, typeof(*pool),
+					       shrinker);
+
+	if (!zswap_shrinker_enabled)
+		return 0;
+
+	return list_lru_shrink_count(&pool->list_lru, sc);
+}
+
+static unsigned long zswap_shrinker_scan(struct shrinker *shrinker,
+					 struct shrink_control *sc)
+{
+	struct zswap_pool *pool = container_of(shrinker, typeof(*pool),
+					       shrinker);
+	struct zswap_shrink_ctx ctx = { .second_chance = true };
+	unsigned long nr_written;
+
+	/* Writeback allocates swapcache pages and submits IO */
+	if (!zswap_shrinker_enabled || !(sc->gfp_mask & __GFP_IO))
+		return SHRINK_STOP;
+
+	nr_written = list_lru_shrink_walk(&pool->list_lru, sc,
+					  &shrink_memcg_cb, &ctx);
+	/*
+	 * A page already in the swapcache means swapin is racing with us on
+	 * entries that are evidently still in use; back off.
+	 */
+	if (ctx.encountered_page_in_swapcache || !nr_written)
+		return SHRINK_STOP;
+
+	return nr_written;
+}
+
 static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 {
 	int i;
@@ -753,10 +946,20 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 		goto error;
 	}
 
+	pool->shrinker.count_objects = zswap_shrinker_count;
+	pool->shrinker.scan_objects = zswap_shrinker_scan;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	pool->shrinker.flags = SHRINKER_NUMA_AWARE | SHRINKER_MEMCG_AWARE;
+	if (prealloc_shrinker(&pool->shrinker, "mm-zswap"))
+		goto error;
+
+	if (list_lru_init_memcg(&pool->list_lru, &pool->shrinker))
+		goto shrinker_fail;
+
 	ret = cpuhp_state_add_instance(CPUHP_MM_ZSWP_POOL_PREPARE,
 				       &pool->node);
 	if (ret)
-		goto error;
+		goto lru_fail;
 	pr_debug("using %s compressor\n", pool->tfm_name);
 
 	/* being the current pool takes 1 ref; this func expects the
@@ -764,14 +967,17 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 	 */
 	kref_init(&pool->kref);
 	INIT_LIST_HEAD(&pool->list);
-	INIT_LIST_HEAD(&pool->lru);
-	spin_lock_init(&pool->lru_lock);
 	INIT_WORK(&pool->shrink_work, shrink_worker);
+	register_shrinker_prepared(&pool->shrinker);
 
 	zswap_pool_debug("created", pool);
 
 	return pool;
 
+lru_fail:
+	list_lru_destroy(&pool->list_lru);
+shrinker_fail:
+	free_prealloced_shrinker(&pool->shrinker);
 error:
 	if (pool->acomp_ctx)
 		free_percpu(pool->acomp_ctx);
@@ -829,8 +1035,16 @@ static void zswap_pool_destroy(struct zswap_pool *pool)
 
 	zswap_pool_debug("destroying", pool);
 
+	unregister_shrinker(&pool->shrinker);
 	cpuhp_state_remove_instance(CPUHP_MM_ZSWP_POOL_PREPARE, &pool->node);
 	free_percpu(pool->acomp_ctx);
+	list_lru_destroy(&pool->list_lru);
+
+	spin_lock(&zswap_pools_lock);
+	mem_cgroup_iter_break(NULL, pool->next_shrink);
+	pool->next_shrink = NULL;
+	spin_unlock(&zswap_pools_lock);
+
 	for (i = 0; i < ZSWAP_NR_ZPOOLS; i++)
 		zpool_destroy_pool(pool->zpools[i]);
 	kfree(pool);
@@ -1232,12 +1446,11 @@ bool zswap_store(struct folio *folio)
 	spin_unlock(&tree->lock);
 
 	/*
-	 * XXX: zswap reclaim does not work with cgroups yet. Without a
-	 * cgroup-aware entry LRU, we will push out entries system-wide based on
-	 * local cgroup limits.
+	 * A cgroup at its zswap limit makes room by writing back its own
+	 * coldest entry, rather than pushing out other cgroups' entries.
 	 */
 	objcg = get_obj_cgroup_from_folio(folio);
-	if (objcg && !obj_cgroup_may_zswap(objcg))
+	if (objcg && !obj_cgroup_may_zswap(objcg) && zswap_shrink_objcg(objcg))
 		goto reject;
 
 	/* reclaim space if needed */
@@ -1282,6 +1495,9 @@ bool zswap_store(struct folio *folio)
 	if (!entry->pool)
 		goto freepage;
 
+	if (objcg && zswap_objcg_lru_alloc(entry->pool, objcg))
+		goto put_pool;
+
 	/* compress */
 	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
 
@@ -1358,9 +1574,9 @@ bool zswap_store(struct folio *folio)
 		zswap_invalidate_entry(tree, dupentry);
 	}
 	if (entry->length) {
-		spin_lock(&entry->pool->lru_lock);
-		list_add(&entry->lru, &entry->pool->lru);
-		spin_unlock(&entry->pool->lru_lock);
+		INIT_LIST_HEAD(&entry->lru);
+		entry->referenced = true;
+		zswap_lru_add(&entry->pool->list_lru, entry);
 	}
 	spin_unlock(&tree->lock);
 
@@ -1373,6 +1589,7 @@ bool zswap_store(struct folio *folio)
 
 put_dstmem:
 	mutex_unlock(acomp_ctx->mutex);
+put_pool:
 	zswap_pool_put(entry->pool);
 freepage:
 	zswap_entry_cache_free(entry);
@@ -1467,9 +1684,10 @@ bool zswap_load(struct folio *folio)
 		zswap_invalidate_entry(tree, entry);
 		folio_mark_dirty(folio);
 	} else if (entry->length) {
-		spin_lock(&entry->pool->lru_lock);
-		list_move(&entry->lru, &entry->pool->lru);
-		spin_unlock(&entry->pool->lru_lock);
+		/* Rotate to the hot end and give it a second chance */
+		zswap_lru_del(&entry->pool->list_lru, entry);
+		zswap_lru_add(&entry->pool->list_lru, entry);
+		entry->referenced = true;
 	}
 	zswap_entry_put(tree, entry);
 	spin_unlock(&tree->lock);
@@ -6089,6 +6089,24 @@ void __napi_schedule_irqoff(struct napi_struct *n)
 }
 EXPORT_SYMBOL(__napi_schedule_irqoff);
 
+/* Holding packets in GRO past the end of a poll only pays off if they get
+ * merged. Back off the flush timeout of an instance whose packets keep
+ * completing unmerged, and return to the configured value once one merges.
+ */
+#define NAPI_GRO_TIMEOUT_SHIFT_MAX	4
+
+static unsigned long napi_gro_flush_timeout(struct napi_struct *n)
+{
+	if (n->gro_merged) {
+		n->gro_merged = false;
+		n->gro_timeout_shift = 0;
+	} else if (n->gro_timeout_shift < NAPI_GRO_TIMEOUT_SHIFT_MAX) {
+		n->gro_timeout_shift++;
+	}
+
+	return READ_ONCE(n->dev->gro_flush_timeout) >> n->gro_timeout_shift;
+}
+
 bool napi_complete_done(struct napi_struct *n, int work_done)
 {
 	unsigned long flags, val, new, timeout = 0;
@@ -6106,7 +6124,7 @@ bool napi_complete_done(struct napi_struct *n, int work_done)
 
 	if (work_done) {
 		if (n->gro_bitmask)
-			timeout = READ_ONCE(n->dev->gro_flush_timeout);
+			timeout = napi_gro_flush_timeout(n);
 		n->defer_hard_irqs_count = READ_ONCE(n->dev->napi_defer_hard_irqs);
 	}
 	if (n->defer_hard_irqs_count > 0) {
@@ -6679,6 +6697,91 @@ static void skb_defer_free_flush(struct softnet_data *sd)
 	}
 }
 
+#if defined(CONFIG_NET_RX_BUSY_POLL)
+/* Max shift of the spin budget after windows that saw no packets */
+#define NAPI_THREAD_IDLE_SHIFT_MAX	4
+
+/*
+ * Keep polling from the napi kthread instead of waiting for the next IRQ.
+ * Like napi_busy_loop(), NAPI_STATE_IN_BUSY_POLL makes napi_complete_done()
+ * a no-op, so the driver leaves its IRQ masked.  Spinning stops once nothing
+ * has been received for the spin budget, which is halved after every window
+ * that turned out to be idle, and busy_poll_stop() re-arms the IRQ.
+ */
+static bool napi_threaded_busy_poll(struct napi_struct *napi)
+{
+	unsigned int usecs = READ_ONCE(napi->dev->threaded_busy_poll_usecs);
+	unsigned long idle_start, spin;
+	struct softnet_data *sd;
+	bool received = false;
+	void *have;
+	int work;
+
+	if (!usecs)
+		return false;
+
+	spin = usecs >> napi->thread_idle_shift;
+	set_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state);
+	idle_start = busy_loop_current_time();
+
+	for (;;) {
+		local_bh_disable();
+		sd = this_cpu_ptr(&softnet_data);
+		sd->in_napi_threaded_poll = true;
+
+		have = netpoll_poll_lock(napi);
+		work = napi->poll(napi, napi->weight);
+		trace_napi_poll(napi, work, napi->weight);
+		if (napi->gro_bitmask)
+			napi_gro_flush(napi, HZ >= 1000);
+		gro_normal_list(napi);
+		netpoll_poll_unlock(have);
+
+		sd->in_napi_threaded_poll = false;
+		barrier();
+
+		if (sd_has_rps_ipi_waiting(sd)) {
+			local_irq_disable();
+			net_rps_action_and_irq_enable(sd);
+		}
+		skb_defer_free_flush(sd);
+		if (work > 0)
+			__NET_ADD_STATS(dev_net(napi->dev),
+					LINUX_MIB_BUSYPOLLRXPACKETS, work);
+		local_bh_enable();
+
+		if (work > 0) {
+			received = true;
+			idle_start = busy_loop_current_time();
+		} else if (time_after(busy_loop_current_time(),
+				      idle_start + spin)) {
+			break;
+		}
+
+		if (kthread_should_stop() || napi_disable_pending(napi) ||
+		    !READ_ONCE(napi->dev->threaded_busy_poll_usecs))
+			break;
+
+		cond_resched();
+		cpu_relax();
+	}
+
+	if (received)
+		napi->thread_idle_shift = 0;
+	else if (napi->thread_idle_shift < NAPI_THREAD_IDLE_SHIFT_MAX)
+		napi->thread_idle_shift++;
+
+	/* Clears IN_BUSY_POLL and lets the driver complete and unmask */
+	busy_poll_stop(napi, netpoll_poll_lock(napi), false, napi->weight);
+	return true;
+}
+#else
+static bool napi_threaded_busy_poll(struct napi_struct *napi)
+{
+	return false;
+}
+#endif
+
 static int napi_threaded_poll(void *data)
 {
 	struct napi_struct *napi = data;
@@ -6686,6 +6789,9 @@ static int napi_threaded_poll(void *data)
 	void *have;
 
 	while (!napi_thread_wait(napi)) {
+		if (napi_threaded_busy_poll(napi))
+			continue;
+
 		for (;;) {
 			bool repoll = false;
 
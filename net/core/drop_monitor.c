@@ -25,6 +25,7 @@
 #include <linux/percpu.h>
 #include <linux/timer.h>
 #include <linux/bitops.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <net/genetlink.h>
@@ -606,12 +607,35 @@ static int net_dm_packet_report_in_port_put(struct sk_buff *msg, int ifindex,
 	return -EMSGSIZE;
 }
 
+static int net_dm_reason_put(struct sk_buff *msg, u32 reason)
+{
+	const struct drop_reason_list *list = NULL;
+	unsigned int subsys, subsys_reason;
+	int rc;
+
+	rcu_read_lock();
+	subsys = u32_get_bits(reason, SKB_DROP_REASON_SUBSYS_MASK);
+	if (subsys < SKB_DROP_REASON_SUBSYS_NUM)
+		list = rcu_dereference(drop_reasons_by_subsys[subsys]);
+	subsys_reason = reason & ~SKB_DROP_REASON_SUBSYS_MASK;
+	if (!list ||
+	    subsys_reason >= list->n_reasons ||
+	    !list->reasons[subsys_reason] ||
+	    strlen(list->reasons[subsys_reason]) > NET_DM_MAX_REASON_LEN) {
+		list = rcu_dereference(drop_reasons_by_subsys[SKB_DROP_REASON_SUBSYS_CORE]);
+		subsys_reason = SKB_DROP_REASON_NOT_SPECIFIED;
+	}
+	rc = nla_put_string(msg, NET_DM_ATTR_REASON,
+			    list->reasons[subsys_reason]);
+	rcu_read_unlock();
+
+	return rc;
+}
+
 static int net_dm_packet_report_fill(struct sk_buff *msg, struct sk_buff *skb,
 				     size_t payload_len)
 {
 	struct net_dm_skb_cb *cb = NET_DM_SKB_CB(skb);
-	const struct drop_reason_list *list = NULL;
-	unsigned int subsys, subsys_reason;
 	char buf[NET_DM_MAX_SYMBOL_LEN];
 	struct nlattr *attr;
 	void *hdr;
@@ -629,24 +653,8 @@ static int net_dm_packet_report_fill(struct sk_buff *msg, struct sk_buff *skb,
 			      NET_DM_ATTR_PAD))
 		goto nla_put_failure;
 
-	rcu_read_lock();
-	subsys = u32_get_bits(cb->reason, SKB_DROP_REASON_SUBSYS_MASK);
-	if (subsys < SKB_DROP_REASON_SUBSYS_NUM)
-		list = rcu_dereference(drop_reasons_by_subsys[subsys]);
-	subsys_reason = cb->reason & ~SKB_DROP_REASON_SUBSYS_MASK;
-	if (!list ||
-	    subsys_reason >= list->n_reasons ||
-	    !list->reasons[subsys_reason] ||
-	    strlen(list->reasons[subsys_reason]) > NET_DM_MAX_REASON_LEN) {
-		list = rcu_dereference(drop_reasons_by_subsys[SKB_DROP_REASON_SUBSYS_CORE]);
-		subsys_reason = SKB_DROP_REASON_NOT_SPECIFIED;
-	}
-	if (nla_put_string(msg, NET_DM_ATTR_REASON,
-			   list->reasons[subsys_reason])) {
-		rcu_read_unlock();
+	if (net_dm_reason_put(msg, cb->reason))
 		goto nla_put_failure;
-	}
-	rcu_read_unlock();
 
 	snprintf(buf, sizeof(buf), "%pS", cb->pc);
 	if (nla_put_string(msg, NET_DM_ATTR_SYMBOL, buf))
@@ -1599,6 +1607,200 @@ static int dropmon_net_event(struct notifier_block *ev_block,
 	return NOTIFY_DONE;
 }
 
+/* Aggregated drop counters
+ *
+ * An always-on summary of software drops keyed by (drop reason, input
+ * ifindex, protocol). A tuple is assigned a slot in a global open-addressed
+ * table the first time it is seen and keeps it for the lifetime of the
+ * module, so the hot path is a lockless lookup followed by a per-CPU
+ * increment. Tuples that find no free slot within a few probes are
+ * accounted to an overflow slot instead.
+ */
+#define NET_DM_AGGR_BITS	10
+#define NET_DM_AGGR_SIZE	(1 << NET_DM_AGGR_BITS)
+#define NET_DM_AGGR_OVERFLOW	NET_DM_AGGR_SIZE
+#define NET_DM_AGGR_PROBES	8
+
+struct net_dm_aggr_key {
+	u32 reason;
+	int ifindex;
+	__be16 proto;
+	bool used;
+};
+
+struct net_dm_aggr_counts {
+	unsigned long cnt[NET_DM_AGGR_SIZE + 1];
+};
+
+static bool net_dm_aggr_enabled = true;
+module_param_named(aggregate, net_dm_aggr_enabled, bool, 0444);
+MODULE_PARM_DESC(aggregate, "Count software drops per reason, port and protocol");
+
+static struct net_dm_aggr_key net_dm_aggr_keys[NET_DM_AGGR_SIZE];
+static DEFINE_SPINLOCK(net_dm_aggr_lock);
+static DEFINE_PER_CPU(struct net_dm_aggr_counts, net_dm_aggr_counts);
+/* Totals already reported to user space, protected by net_dm_mutex */
+static unsigned long net_dm_aggr_reported[NET_DM_AGGR_SIZE + 1];
+
+static bool net_dm_aggr_key_match(const struct net_dm_aggr_key *key,
+				  u32 reason, int ifindex, __be16 proto)
+{
+	return key->reason == reason && key->ifindex == ifindex &&
+	       key->proto == proto;
+}
+
+static unsigned int net_dm_aggr_slot(u32 reason, int ifindex, __be16 proto)
+{
+	u32 hash = jhash_3words(reason, ifindex, (__force u32)proto, 0);
+	struct net_dm_aggr_key *key;
+	unsigned int i, slot;
+	unsigned long flags;
+
+	for (i = 0; i < NET_DM_AGGR_PROBES; i++) {
+		slot = (hash + i) & (NET_DM_AGGR_SIZE - 1);
+		key = &net_dm_aggr_keys[slot];
+
+		if (!smp_load_acquire(&key->used)) {
+			spin_lock_irqsave(&net_dm_aggr_lock, flags);
+			if (!key->used) {
+				key->reason = reason;
+				key->ifindex = ifindex;
+				key->proto = proto;
+				smp_store_release(&key->used, true);
+			}
+			spin_unlock_irqrestore(&net_dm_aggr_lock, flags);
+		}
+
+		if (net_dm_aggr_key_match(key, reason, ifindex, proto))
+			return slot;
+	}
+
+	return NET_DM_AGGR_OVERFLOW;
+}
+
+static void net_dm_aggr_kfree_skb_probe(void *ignore, struct sk_buff *skb,
+					void *location,
+					enum skb_drop_reason reason)
+{
+	unsigned int slot;
+
+	slot = net_dm_aggr_slot(reason, skb->skb_iif, skb->protocol);
+	this_cpu_inc(net_dm_aggr_counts.cnt[slot]);
+}
+
+static unsigned long net_dm_aggr_total(unsigned int slot)
+{
+	unsigned long total = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		total += READ_ONCE(per_cpu(net_dm_aggr_counts, cpu).cnt[slot]);
+
+	return total;
+}
+
+static int net_dm_aggr_entry_fill(struct sk_buff *msg,
+				  struct netlink_callback *cb,
+				  unsigned int slot, u64 count, u64 total)
+{
+	const struct net_dm_aggr_key *key;
+	void *hdr;
+
+	hdr = genlmsg_put(msg, NETLINK_CB(cb->skb).portid, cb->nlh->nlmsg_seq,
+			  &net_drop_monitor_family, NLM_F_MULTI,
+			  NET_DM_CMD_AGGR_NEW);
+	if (!hdr)
+		return -EMSGSIZE;
+
+	if (slot == NET_DM_AGGR_OVERFLOW) {
+		if (nla_put_flag(msg, NET_DM_ATTR_AGGR_OVERFLOW))
+			goto nla_put_failure;
+	} else {
+		key = &net_dm_aggr_keys[slot];
+
+		if (net_dm_reason_put(msg, key->reason))
+			goto nla_put_failure;
+
+		if (net_dm_packet_report_in_port_put(msg, key->ifindex, NULL))
+			goto nla_put_failure;
+
+		if (nla_put_u16(msg, NET_DM_ATTR_PROTO,
+				be16_to_cpu(key->proto)))
+			goto nla_put_failure;
+	}
+
+	if (nla_put_u64_64bit(msg, NET_DM_ATTR_AGGR_COUNT, count,
+			      NET_DM_ATTR_PAD))
+		goto nla_put_failure;
+
+	if (nla_put_u64_64bit(msg, NET_DM_ATTR_AGGR_TOTAL, total,
+			      NET_DM_ATTR_PAD))
+		goto nla_put_failure;
+
+	genlmsg_end(msg, hdr);
+
+	return 0;
+
+nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+	return -EMSGSIZE;
+}
+
+/* Each dump reports the drops accumulated since the previous one. Entries
+ * without new drops are skipped.
+ */
+static int net_dm_cmd_aggr_dump(struct sk_buff *msg,
+				struct netlink_callback *cb)
+{
+	unsigned int slot = cb->args[0];
+	unsigned long total, count;
+	int rc = 0;
+
+	mutex_lock(&net_dm_mutex);
+
+	for (; slot <= NET_DM_AGGR_OVERFLOW; slot++) {
+		if (slot != NET_DM_AGGR_OVERFLOW &&
+		    !smp_load_acquire(&net_dm_aggr_keys[slot].used))
+			continue;
+
+		total = net_dm_aggr_total(slot);
+		count = total - net_dm_aggr_reported[slot];
+		if (!count)
+			continue;
+
+		rc = net_dm_aggr_entry_fill(msg, cb, slot, count, total);
+		if (rc)
+			break;
+		net_dm_aggr_reported[slot] = total;
+	}
+
+	mutex_unlock(&net_dm_mutex);
+
+	cb->args[0] = slot;
+
+	if (rc && !msg->len)
+		return rc;
+
+	return msg->len;
+}
+
+static int net_dm_aggr_init(void)
+{
+	if (!net_dm_aggr_enabled)
+		return 0;
+
+	return register_trace_kfree_skb(net_dm_aggr_kfree_skb_probe, NULL);
+}
+
+static void net_dm_aggr_fini(void)
+{
+	if (!net_dm_aggr_enabled)
+		return;
+
+	unregister_trace_kfree_skb(net_dm_aggr_kfree_skb_probe, NULL);
+	tracepoint_synchronize_unregister();
+}
+
 static const struct nla_policy net_dm_nl_policy[NET_DM_ATTR_MAX + 1] = {
 	[NET_DM_ATTR_UNSPEC] = { .strict_start_type = NET_DM_ATTR_UNSPEC + 1 },
 	[NET_DM_ATTR_ALERT_MODE] = { .type = NLA_U8 },
@@ -1633,6 +1835,10 @@ static const struct genl_small_ops dropmon_ops[] = {
 		.cmd = NET_DM_CMD_STATS_GET,
 		.doit = net_dm_cmd_stats_get,
 	},
+	{
+		.cmd = NET_DM_CMD_AGGR_GET,
+		.dumpit = net_dm_cmd_aggr_dump,
+	},
 };
 
 static int net_dm_nl_pre_doit(const struct genl_split_ops *ops,
@@ -1742,15 +1948,25 @@ static int __init init_net_drop_monitor(void)
 		goto out_unreg;
 	}
 
-	rc = 0;
-
 	for_each_possible_cpu(cpu) {
 		net_dm_cpu_data_init(cpu);
 		net_dm_hw_cpu_data_init(cpu);
 	}
 
+	rc = net_dm_aggr_init();
+	if (rc) {
+		pr_err("Failed to register aggregated drop counters\n");
+		goto out_fini;
+	}
+
 	goto out;
 
+out_fini:
+	for_each_possible_cpu(cpu) {
+		net_dm_hw_cpu_data_fini(cpu);
+		net_dm_cpu_data_fini(cpu);
+	}
+	unregister_netdevice_notifier(&dropmon_net_notifier);
 out_unreg:
 	genl_unregister_family(&net_drop_monitor_family);
 out:
@@ -1761,6 +1977,8 @@ static void exit_net_drop_monitor(void)
 {
 	int cpu;
 
+	net_dm_aggr_fini();
+
 	BUG_ON(unregister_netdevice_notifier(&dropmon_net_notifier));
 
 	/*
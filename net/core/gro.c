@@ -246,6 +246,7 @@ static void napi_gro_complete(struct napi_struct *napi, struct sk_buff *skb)
 		skb_shinfo(skb)->gso_size = 0;
 		goto out;
 	}
+	napi->gro_merged = true;
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(ptype, head, list) {
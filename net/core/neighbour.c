@@ -891,6 +891,12 @@ void neigh_destroy(struct neighbour *neigh)
 		return;
 	}
 
+	/* Stale per-CPU cache entries must not outlive the RCU grace
+	 * period below; pairs with the barrier in arp_cache_lookup().
+	 */
+	smp_mb__before_atomic();
+	atomic_inc(&neigh->tbl->cache_gen);
+
 	if (neigh_del_timer(neigh))
 		pr_warn("Impossible event\n");
 
@@ -423,6 +423,27 @@ static ssize_t napi_defer_hard_irqs_store(struct device *dev,
 }
 NETDEVICE_SHOW_RW(napi_defer_hard_irqs, fmt_dec);
 
+static int change_threaded_busy_poll_usecs(struct net_device *dev,
+					   unsigned long val)
+{
+	if (val > USEC_PER_SEC)
+		return -ERANGE;
+	WRITE_ONCE(dev->threaded_busy_poll_usecs, val);
+	return 0;
+}
+
+static ssize_t threaded_busy_poll_usecs_store(struct device *dev,
+					      struct device_attribute *attr,
+					      const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len,
+			    change_threaded_busy_poll_usecs);
+}
+NETDEVICE_SHOW_RW(threaded_busy_poll_usecs, fmt_dec);
+
 static ssize_t ifalias_store(struct device *dev, struct device_attribute *attr,
 			     const char *buf, size_t len)
 {
@@ -654,6 +675,7 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_carrier_up_count.attr,
 	&dev_attr_carrier_down_count.attr,
 	&dev_attr_threaded.attr,
+	&dev_attr_threaded_busy_poll_usecs.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(net_class);
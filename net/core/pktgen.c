@@ -158,6 +158,7 @@
 #include <net/udp.h>
 #include <net/ip6_checksum.h>
 #include <net/addrconf.h>
+#include <net/xdp.h>
 #ifdef CONFIG_XFRM
 #include <net/xfrm.h>
 #endif
@@ -170,6 +171,7 @@
 #include <linux/uaccess.h>
 #include <asm/dma.h>
 #include <asm/div64.h>		/* do_div */
+#include <asm/unaligned.h>
 
 #define VERSION	"2.75"
 #define IP_NAME_SZ 32
@@ -230,6 +232,7 @@ static char *pkt_flag_names[] = {
 #define M_START_XMIT		0	/* Default normal TX */
 #define M_NETIF_RECEIVE 	1	/* Inject packets into stack */
 #define M_QUEUE_XMIT		2	/* Inject packet into qdisc */
+#define M_XDP_XMIT		3	/* Copy into xdp_frames, ndo_xdp_xmit */
 
 /* If lock -- protects updating of if_list */
 #define   if_lock(t)           mutex_lock(&(t->if_lock));
@@ -239,6 +242,7 @@ static char *pkt_flag_names[] = {
 #define PKTGEN_MAGIC 0xbe9be955
 #define PG_PROC_DIR "pktgen"
 #define PGCTRL	    "pgctrl"
+#define PGRX	    "pgrx"
 
 #define MAX_CFLOWS  65536
 
@@ -448,9 +452,30 @@ struct pktgen_net {
 	struct net		*net;
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
+	struct pktgen_rx	*rx;	/* protected by RTNL */
 	bool			pktgen_exiting;
 };
 
+/* Receiver side: match pktgen headers and histogram their one-way latency */
+#define PKTGEN_RX_BUCKETS	32	/* log2(usec) */
+
+struct pktgen_rx_stats {
+	u64_stats_t packets;
+	u64_stats_t bytes;
+	u64_stats_t lat_sum;		/* usec, stamped packets only */
+	u64_stats_t stamped;
+	u64_stats_t skewed;		/* stamped in our future */
+	u64_stats_t lat_max;
+	u32 hist[PKTGEN_RX_BUCKETS];
+	struct u64_stats_sync syncp;
+};
+
+struct pktgen_rx {
+	struct packet_type pt;
+	netdevice_tracker dev_tracker;
+	struct pktgen_rx_stats __percpu *stats;
+};
+
 struct pktgen_thread {
 	struct mutex if_lock;		/* for list of devices */
 	struct list_head if_list;	/* All device here */
@@ -501,6 +526,214 @@ static struct notifier_block pktgen_notifier_block = {
 	.notifier_call = pktgen_device_event,
 };
 
+static void pktgen_rx_latency(struct pktgen_rx_stats *st,
+			      const struct pktgen_hdr *pgh)
+{
+	struct timespec64 now;
+	s64 lat;
+
+	/* F_NO_TIMESTAMP senders leave the stamp zeroed */
+	if (!pgh->tv_sec && !pgh->tv_usec)
+		return;
+
+	/* 32-bit seconds on the wire, the difference survives the wrap */
+	ktime_get_real_ts64(&now);
+	lat = (s64)(s32)((u32)now.tv_sec - ntohl(pgh->tv_sec)) * USEC_PER_SEC +
+	      now.tv_nsec / NSEC_PER_USEC - ntohl(pgh->tv_usec);
+	if (lat < 0) {
+		u64_stats_inc(&st->skewed);
+		lat = 0;
+	}
+
+	u64_stats_inc(&st->stamped);
+	u64_stats_add(&st->lat_sum, lat);
+	if (lat > u64_stats_read(&st->lat_max))
+		u64_stats_set(&st->lat_max, lat);
+	st->hist[lat ? min_t(int, ilog2(lat), PKTGEN_RX_BUCKETS - 1) : 0]++;
+}
+
+static int pktgen_rcv(struct sk_buff *skb, struct net_device *dev,
+		      struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct pktgen_rx *rx = container_of(pt, struct pktgen_rx, pt);
+	int off = skb_network_offset(skb);
+	struct pktgen_hdr _pgh, *pgh;
+	struct pktgen_rx_stats *st;
+
+	/* ETH_P_ALL also sees our own transmissions */
+	if (skb->pkt_type == PACKET_OUTGOING)
+		goto out;
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		struct iphdr _iph, *iph;
+
+		iph = skb_header_pointer(skb, off, sizeof(_iph), &_iph);
+		if (!iph || iph->ihl < 5 || iph->protocol != IPPROTO_UDP)
+			goto out;
+		off += iph->ihl * 4;
+	} else if (skb->protocol == htons(ETH_P_IPV6)) {
+		struct ipv6hdr _ip6h, *ip6h;
+
+		ip6h = skb_header_pointer(skb, off, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			goto out;
+		off += sizeof(*ip6h);
+	} else {
+		goto out;
+	}
+
+	pgh = skb_header_pointer(skb, off + sizeof(struct udphdr),
+				 sizeof(_pgh), &_pgh);
+	if (!pgh || pgh->pgh_magic != htonl(PKTGEN_MAGIC))
+		goto out;
+
+	st = this_cpu_ptr(rx->stats);
+	u64_stats_update_begin(&st->syncp);
+	u64_stats_inc(&st->packets);
+	u64_stats_add(&st->bytes, skb->len);
+	pktgen_rx_latency(st, pgh);
+	u64_stats_update_end(&st->syncp);
+out:
+	consume_skb(skb);
+	return 0;
+}
+
+/* Called under RTNL */
+static int pktgen_rx_start(struct pktgen_net *pn, const char *ifname)
+{
+	struct net_device *dev;
+	struct pktgen_rx *rx;
+	int cpu;
+
+	if (pn->rx)
+		return -EBUSY;
+
+	rx = kzalloc(sizeof(*rx), GFP_KERNEL);
+	if (!rx)
+		return -ENOMEM;
+
+	rx->stats = alloc_percpu(struct pktgen_rx_stats);
+	if (!rx->stats) {
+		kfree(rx);
+		return -ENOMEM;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(rx->stats, cpu)->syncp);
+
+	dev = netdev_get_by_name(pn->net, ifname, &rx->dev_tracker, GFP_KERNEL);
+	if (!dev) {
+		free_percpu(rx->stats);
+		kfree(rx);
+		return -ENODEV;
+	}
+
+	rx->pt.type = htons(ETH_P_ALL);
+	rx->pt.dev = dev;
+	rx->pt.func = pktgen_rcv;
+	dev_add_pack(&rx->pt);
+	pn->rx = rx;
+	return 0;
+}
+
+/* Called under RTNL */
+static void pktgen_rx_stop(struct pktgen_net *pn)
+{
+	struct pktgen_rx *rx = pn->rx;
+
+	if (!rx)
+		return;
+
+	pn->rx = NULL;
+	/* waits for pktgen_rcv() callers */
+	dev_remove_pack(&rx->pt);
+	netdev_put(rx->pt.dev, &rx->dev_tracker);
+	free_percpu(rx->stats);
+	kfree(rx);
+}
+
+static int pktgen_rx_show(struct seq_file *seq, void *v)
+{
+	struct pktgen_net *pn = seq->private;
+	u64 packets = 0, bytes = 0, sum = 0, stamped = 0, skewed = 0;
+	u64 lat_max = 0;
+	u64 hist[PKTGEN_RX_BUCKETS] = {};
+	int cpu, i;
+
+	rtnl_lock();
+	if (!pn->rx) {
+		seq_puts(seq, "Receiver: off\n");
+		goto out;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct pktgen_rx_stats *st = per_cpu_ptr(pn->rx->stats, cpu);
+		u64 p, b, l, n, k, m;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin(&st->syncp);
+			p = u64_stats_read(&st->packets);
+			b = u64_stats_read(&st->bytes);
+			l = u64_stats_read(&st->lat_sum);
+			n = u64_stats_read(&st->stamped);
+			k = u64_stats_read(&st->skewed);
+			m = u64_stats_read(&st->lat_max);
+		} while (u64_stats_fetch_retry(&st->syncp, start));
+
+		packets += p;
+		bytes += b;
+		sum += l;
+		stamped += n;
+		skewed += k;
+		lat_max = max(lat_max, m);
+		for (i = 0; i < PKTGEN_RX_BUCKETS; i++)
+			hist[i] += READ_ONCE(st->hist[i]);
+	}
+
+	seq_printf(seq, "Receiver: %s\n", pn->rx->pt.dev->name);
+	seq_printf(seq, "     packets: %llu  bytes: %llu\n", packets, bytes);
+	seq_printf(seq, "     stamped: %llu  skewed: %llu\n", stamped, skewed);
+	if (stamped)
+		seq_printf(seq, "     latency_us: avg=%llu max=%llu\n",
+			   div64_u64(sum, stamped), lat_max);
+	seq_puts(seq, "     hist_log2_us:");
+	for (i = 0; i < PKTGEN_RX_BUCKETS; i++)
+		if (hist[i])
+			seq_printf(seq, " %d:%llu", i, hist[i]);
+	seq_putc(seq, '\n');
+out:
+	rtnl_unlock();
+	return 0;
+}
+
+/* One device per thread, each transmitting on its own CPU's queue */
+static int pktgen_add_device_all(struct pktgen_net *pn, const char *ifname)
+{
+	struct pktgen_thread *t;
+	char name[IFNAMSIZ + 8];
+	int added = 0, err = 0;
+
+	if (strlen(ifname) >= IFNAMSIZ || strchr(ifname, '@'))
+		return -EINVAL;
+
+	mutex_lock(&pktgen_thread_lock);
+	list_for_each_entry(t, &pn->pktgen_threads, th_list) {
+		struct pktgen_dev *pkt_dev;
+
+		snprintf(name, sizeof(name), "%s@%d", ifname, t->cpu);
+		err = pktgen_add_device(t, name);
+		if (err)
+			break;
+		pkt_dev = pktgen_find_dev(t, name, true);
+		if (pkt_dev)
+			pkt_dev->flags |= F_QUEUE_MAP_CPU;
+		added++;
+	}
+	mutex_unlock(&pktgen_thread_lock);
+
+	return added ? 0 : err;
+}
+
 /*
  * /proc handling functions
  *
@@ -538,7 +771,24 @@ static ssize_t pgctrl_write(struct file *file, const char __user *buf,
 		pktgen_run_all_threads(pn);
 	else if (!strcmp(data, "reset"))
 		pktgen_reset_all_threads(pn);
-	else
+	else if (!strncmp(data, "add_device_all ", 15)) {
+		int err = pktgen_add_device_all(pn, data + 15);
+
+		if (err)
+			return err;
+	} else if (!strncmp(data, "rx ", 3)) {
+		int err;
+
+		rtnl_lock();
+		err = pktgen_rx_start(pn, data + 3);
+		rtnl_unlock();
+		if (err)
+			return err;
+	} else if (!strcmp(data, "rx_stop")) {
+		rtnl_lock();
+		pktgen_rx_stop(pn);
+		rtnl_unlock();
+	} else
 		return -EINVAL;
 
 	return count;
@@ -557,6 +807,18 @@ static const struct proc_ops pktgen_proc_ops = {
 	.proc_release	= single_release,
 };
 
+static int pgrx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pktgen_rx_show, pde_data(inode));
+}
+
+static const struct proc_ops pktgen_rx_proc_ops = {
+	.proc_open	= pgrx_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+
 static int pktgen_if_show(struct seq_file *seq, void *v)
 {
 	const struct pktgen_dev *pkt_dev = seq->private;
@@ -665,6 +927,8 @@ static int pktgen_if_show(struct seq_file *seq, void *v)
 		seq_puts(seq, "     xmit_mode: netif_receive\n");
 	else if (pkt_dev->xmit_mode == M_QUEUE_XMIT)
 		seq_puts(seq, "     xmit_mode: xmit_queue\n");
+	else if (pkt_dev->xmit_mode == M_XDP_XMIT)
+		seq_puts(seq, "     xmit_mode: xdp_xmit\n");
 
 	seq_puts(seq, "     Flags: ");
 
@@ -1308,10 +1572,16 @@ static ssize_t pktgen_if_write(struct file *file,
 		} else if (strcmp(f, "queue_xmit") == 0) {
 			pkt_dev->xmit_mode = M_QUEUE_XMIT;
 			pkt_dev->last_ok = 1;
+		} else if (strcmp(f, "xdp_xmit") == 0) {
+			if (!pkt_dev->odev->netdev_ops->ndo_xdp_xmit)
+				return -EOPNOTSUPP;
+
+			pkt_dev->xmit_mode = M_XDP_XMIT;
+			pkt_dev->last_ok = 1;
 		} else {
 			sprintf(pg_result,
 				"xmit_mode -:%s:- unknown\nAvailable modes: %s",
-				f, "start_xmit, netif_receive\n");
+				f, "start_xmit, netif_receive, queue_xmit, xdp_xmit\n");
 			return count;
 		}
 		sprintf(pg_result, "OK: xmit_mode=%s", f);
@@ -2051,6 +2321,9 @@ static int pktgen_device_event(struct notifier_block *unused,
 	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
 	struct pktgen_net *pn = net_generic(dev_net(dev), pg_net_id);
 
+	if (event == NETDEV_UNREGISTER && pn->rx && pn->rx->pt.dev == dev)
+		pktgen_rx_stop(pn);
+
 	if (pn->pktgen_exiting)
 		return NOTIFY_DONE;
 
@@ -3438,6 +3711,132 @@ static void pktgen_wait_for_skb(struct pktgen_dev *pkt_dev)
 	pkt_dev->idle_acc += ktime_to_ns(ktime_sub(ktime_get(), idle_start));
 }
 
+/* The frame, its headroom and the tailroom a driver may expect in one page */
+#define PKTGEN_XDP_MAX_LEN	(PAGE_SIZE - XDP_PACKET_HEADROOM - \
+				 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
+static void pktgen_xdp_set32(struct udphdr *udph, __be32 *field, __be32 val)
+{
+	if (udph->check) {
+		csum_replace4(&udph->check, get_unaligned(field), val);
+		if (!udph->check)
+			udph->check = CSUM_MANGLED_0;
+	}
+	put_unaligned(val, field);
+}
+
+/* The template is reused, give every copy its own sequence and time stamp */
+static void pktgen_xdp_stamp(struct pktgen_dev *pkt_dev, void *data, u32 seq)
+{
+	struct udphdr *udph = data + skb_transport_offset(pkt_dev->skb);
+	struct pktgen_hdr *pgh = (struct pktgen_hdr *)(udph + 1);
+	struct timespec64 timestamp;
+
+	pktgen_xdp_set32(udph, &pgh->seq_num, htonl(seq));
+
+	if (pkt_dev->flags & F_NO_TIMESTAMP)
+		return;
+
+	ktime_get_real_ts64(&timestamp);
+	pktgen_xdp_set32(udph, &pgh->tv_sec, htonl(timestamp.tv_sec));
+	pktgen_xdp_set32(udph, &pgh->tv_usec,
+			 htonl(timestamp.tv_nsec / NSEC_PER_USEC));
+}
+
+static struct xdp_frame *pktgen_xdp_frame(struct pktgen_dev *pkt_dev, u32 seq)
+{
+	struct sk_buff *skb = pkt_dev->skb;
+	int node = numa_node_id();
+	struct xdp_frame *xdpf;
+	struct page *page;
+	void *data;
+
+	if (pkt_dev->node >= 0 && (pkt_dev->flags & F_NODE))
+		node = pkt_dev->node;
+	page = alloc_pages_node(node, GFP_NOWAIT | __GFP_NOWARN, 0);
+	if (!page)
+		return NULL;
+
+	xdpf = page_address(page);
+	data = (void *)xdpf + XDP_PACKET_HEADROOM;
+	if (skb_copy_bits(skb, 0, data, skb->len)) {
+		put_page(page);
+		return NULL;
+	}
+
+	/* Laid out as xdp_convert_buff_to_frame() would for an order-0 page */
+	xdpf->data = data;
+	xdpf->len = skb->len;
+	xdpf->headroom = XDP_PACKET_HEADROOM - sizeof(*xdpf);
+	xdpf->metasize = 0;
+	xdpf->frame_sz = PAGE_SIZE;
+	xdpf->flags = 0;
+	xdpf->dev_rx = NULL;
+	xdpf->mem.type = MEM_TYPE_PAGE_ORDER0;
+	xdpf->mem.id = 0;
+
+	/* IPsec transformed the payload, its header is not ours to touch */
+	if (!(pkt_dev->flags & F_IPSEC))
+		pktgen_xdp_stamp(pkt_dev, data, seq);
+
+	return xdpf;
+}
+
+/* Copy the template into freshly allocated frames and hand them to the
+ * driver's XDP transmit path, bypassing the qdisc and skb TX machinery.
+ * The driver picks the TX queue of the current CPU.
+ */
+static void pktgen_xdp_xmit(struct pktgen_dev *pkt_dev, unsigned int burst)
+{
+	struct xdp_frame *frames[XDP_BULK_QUEUE_SIZE];
+	struct net_device *odev = pkt_dev->odev;
+	struct sk_buff *skb = pkt_dev->skb;
+	int i, n, sent;
+
+	if (unlikely(!(odev->xdp_features & NETDEV_XDP_ACT_NDO_XMIT) ||
+		     skb->len > PKTGEN_XDP_MAX_LEN)) {
+		net_info_ratelimited("%s xdp_xmit not possible, len %u\n",
+				     pkt_dev->odevname, skb->len);
+		pktgen_stop_device(pkt_dev);
+		return;
+	}
+
+	/* frames carry no offload state, resolve it once per template */
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb)) {
+		pkt_dev->errors++;
+		return;
+	}
+
+	burst = min_t(unsigned int, burst, XDP_BULK_QUEUE_SIZE);
+	if (pkt_dev->count && pkt_dev->count - pkt_dev->sofar < burst)
+		burst = pkt_dev->count - pkt_dev->sofar;
+
+	for (n = 0; n < burst; n++) {
+		frames[n] = pktgen_xdp_frame(pkt_dev, pkt_dev->seq_num + n);
+		if (!frames[n])
+			break;
+	}
+	if (!n) {
+		pkt_dev->last_ok = 0;
+		return;
+	}
+
+	local_bh_disable();
+	sent = odev->netdev_ops->ndo_xdp_xmit(odev, n, frames, XDP_XMIT_FLUSH);
+	local_bh_enable();
+	if (sent < 0)
+		sent = 0;
+
+	for (i = sent; i < n; i++)
+		xdp_return_frame(frames[i]);
+
+	pkt_dev->sofar += sent;
+	pkt_dev->seq_num += sent;
+	pkt_dev->tx_bytes += (u64)sent * pkt_dev->last_pkt_size;
+	pkt_dev->errors += n - sent;
+	pkt_dev->last_ok = sent == n;
+}
+
 static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 {
 	unsigned int burst = READ_ONCE(pkt_dev->burst);
@@ -3507,6 +3906,9 @@ static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 			skb_reset_redirect(skb);
 		} while (--burst > 0);
 		goto out; /* Skips xmit_mode M_START_XMIT */
+	} else if (pkt_dev->xmit_mode == M_XDP_XMIT) {
+		pktgen_xdp_xmit(pkt_dev, burst);
+		goto done;
 	} else if (pkt_dev->xmit_mode == M_QUEUE_XMIT) {
 		local_bh_disable();
 		refcount_inc(&pkt_dev->skb->users);
@@ -3585,7 +3987,7 @@ static void pktgen_xmit(struct pktgen_dev *pkt_dev)
 
 out:
 	local_bh_enable();
-
+done:
 	/* If pkt_dev->count is zero, then run forever */
 	if ((pkt_dev->count != 0) && (pkt_dev->sofar >= pkt_dev->count)) {
 		pktgen_wait_for_skb(pkt_dev);
@@ -3940,6 +4342,13 @@ static int __net_init pg_net_init(struct net *net)
 		ret = -EINVAL;
 		goto remove;
 	}
+	pe = proc_create_data(PGRX, 0400, pn->proc_dir, &pktgen_rx_proc_ops,
+			      pn);
+	if (pe == NULL) {
+		pr_err("cannot create %s procfs entry\n", PGRX);
+		ret = -EINVAL;
+		goto remove_entry;
+	}
 
 	for_each_online_cpu(cpu) {
 		int err;
@@ -3953,11 +4362,13 @@ static int __net_init pg_net_init(struct net *net)
 	if (list_empty(&pn->pktgen_threads)) {
 		pr_err("Initialization failed for all threads\n");
 		ret = -ENODEV;
-		goto remove_entry;
+		goto remove_rx_entry;
 	}
 
 	return 0;
 
+remove_rx_entry:
+	remove_proc_entry(PGRX, pn->proc_dir);
 remove_entry:
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 remove:
@@ -3987,6 +4398,11 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	remove_proc_entry(PGRX, pn->proc_dir);
+	rtnl_lock();
+	pktgen_rx_stop(pn);
+	rtnl_unlock();
+
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
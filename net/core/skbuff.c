@@ -886,9 +886,25 @@ static void skb_clone_fraglist(struct sk_buff *skb)
 }
 
 #if IS_ENABLED(CONFIG_PAGE_POOL)
+/* Allow direct recycle if we have reasons to believe that we are
+ * in the same context as the consumer would run, so there's
+ * no possible race.
+ * __page_pool_put_page() makes sure we're not in hardirq context
+ * and interrupts are enabled prior to accessing the cache.
+ */
+static bool napi_pp_allow_direct(struct page_pool *pp, bool napi_safe)
+{
+	const struct napi_struct *napi;
+
+	if (!napi_safe && !in_softirq())
+		return false;
+
+	napi = READ_ONCE(pp->p.napi);
+	return napi && READ_ONCE(napi->list_owner) == smp_processor_id();
+}
+
 bool napi_pp_put_page(struct page *page, bool napi_safe)
 {
-	bool allow_direct = false;
 	struct page_pool *pp;
 
 	page = compound_head(page);
@@ -905,31 +921,116 @@ bool napi_pp_put_page(struct page *page, bool napi_safe)
 
 	pp = page->pp;
 
-	/* Allow direct recycle if we have reasons to believe that we are
-	 * in the same context as the consumer would run, so there's
-	 * no possible race.
-	 * __page_pool_put_page() makes sure we're not in hardirq context
-	 * and interrupts are enabled prior to accessing the cache.
-	 */
-	if (napi_safe || in_softirq()) {
-		const struct napi_struct *napi = READ_ONCE(pp->p.napi);
-
-		allow_direct = napi &&
-			READ_ONCE(napi->list_owner) == smp_processor_id();
-	}
-
 	/* Driver set this to memory recycling info. Reset it on recycle.
 	 * This will *not* work for NIC using a split-page memory model.
 	 * The page will be returned to the pool here regardless of the
 	 * 'flipped' fragment being in use or not.
 	 */
-	page_pool_put_full_page(pp, page, allow_direct);
+	page_pool_put_full_page(pp, page, napi_pp_allow_direct(pp, napi_safe));
 
 	return true;
 }
 EXPORT_SYMBOL(napi_pp_put_page);
 #endif
 
+#define SKB_BULK_FREE_SIZE	16
+
+/* Memory released by napi_consume_skb_bulk(), handed back in batches */
+struct skb_bulk_free {
+	struct page_pool *pool;
+	unsigned int pp_count;
+	void *pp_array[SKB_BULK_FREE_SIZE];
+	unsigned int page_count;
+	struct page *page_array[SKB_BULK_FREE_SIZE];
+	unsigned int head_count;
+	void *head_array[SKB_BULK_FREE_SIZE];
+};
+
+static void skb_bulk_flush_pp(struct skb_bulk_free *bf)
+{
+#if IS_ENABLED(CONFIG_PAGE_POOL)
+	if (bf->pp_count)
+		page_pool_put_page_bulk(bf->pool, bf->pp_array, bf->pp_count);
+#endif
+	bf->pp_count = 0;
+}
+
+static void skb_bulk_flush_pages(struct skb_bulk_free *bf)
+{
+	if (bf->page_count)
+		release_pages(bf->page_array, bf->page_count);
+	bf->page_count = 0;
+}
+
+static void skb_bulk_flush_heads(struct skb_bulk_free *bf)
+{
+	if (bf->head_count)
+		kmem_cache_free_bulk(skb_small_head_cache, bf->head_count,
+				     bf->head_array);
+	bf->head_count = 0;
+}
+
+static bool skb_bulk_pp_put(struct skb_bulk_free *bf, struct page *page,
+			    bool napi_safe)
+{
+#if IS_ENABLED(CONFIG_PAGE_POOL)
+	struct page_pool *pp;
+
+	page = compound_head(page);
+	if (unlikely((page->pp_magic & ~0x3UL) != PP_SIGNATURE))
+		return false;
+
+	pp = page->pp;
+
+	/* the lockless per-pool cache beats the ptr_ring bulk path */
+	if (napi_pp_allow_direct(pp, napi_safe)) {
+		page_pool_put_full_page(pp, page, true);
+		return true;
+	}
+
+	if (bf->pool != pp || bf->pp_count == SKB_BULK_FREE_SIZE) {
+		skb_bulk_flush_pp(bf);
+		bf->pool = pp;
+	}
+	bf->pp_array[bf->pp_count++] = page_address(page);
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void skb_bulk_frag_unref(struct skb_bulk_free *bf, skb_frag_t *frag,
+				bool recycle, bool napi_safe)
+{
+	struct page *page = skb_frag_page(frag);
+
+	if (recycle && skb_bulk_pp_put(bf, page, napi_safe))
+		return;
+
+	if (bf->page_count == SKB_BULK_FREE_SIZE)
+		skb_bulk_flush_pages(bf);
+	bf->page_array[bf->page_count++] = page;
+}
+
+static void skb_bulk_free_head(struct skb_bulk_free *bf, struct sk_buff *skb,
+			       bool napi_safe)
+{
+	unsigned char *head = skb->head;
+
+	if (skb->head_frag) {
+		if (skb->pp_recycle &&
+		    skb_bulk_pp_put(bf, virt_to_page(head), napi_safe))
+			return;
+		skb_free_frag(head);
+	} else if (skb_end_offset(skb) == SKB_SMALL_HEAD_HEADROOM) {
+		if (bf->head_count == SKB_BULK_FREE_SIZE)
+			skb_bulk_flush_heads(bf);
+		bf->head_array[bf->head_count++] = head;
+	} else {
+		kfree(head);
+	}
+}
+
 static bool skb_pp_recycle(struct sk_buff *skb, void *data, bool napi_safe)
 {
 	if (!IS_ENABLED(CONFIG_PAGE_POOL) || !skb->pp_recycle)
@@ -958,8 +1059,8 @@ static void skb_free_head(struct sk_buff *skb, bool napi_safe)
 	}
 }
 
-static void skb_release_data(struct sk_buff *skb, enum skb_drop_reason reason,
-			     bool napi_safe)
+static void __skb_release_data(struct sk_buff *skb, enum skb_drop_reason reason,
+			       bool napi_safe, struct skb_bulk_free *bf)
 {
 	struct skb_shared_info *shinfo = skb_shinfo(skb);
 	int i;
@@ -977,14 +1078,23 @@ static void skb_release_data(struct sk_buff *skb, enum skb_drop_reason reason,
 			goto free_head;
 	}
 
-	for (i = 0; i < shinfo->nr_frags; i++)
-		napi_frag_unref(&shinfo->frags[i], skb->pp_recycle, napi_safe);
+	for (i = 0; i < shinfo->nr_frags; i++) {
+		if (bf)
+			skb_bulk_frag_unref(bf, &shinfo->frags[i],
+					    skb->pp_recycle, napi_safe);
+		else
+			napi_frag_unref(&shinfo->frags[i], skb->pp_recycle,
+					napi_safe);
+	}
 
 free_head:
 	if (shinfo->frag_list)
 		kfree_skb_list_reason(shinfo->frag_list, reason);
 
-	skb_free_head(skb, napi_safe);
+	if (bf)
+		skb_bulk_free_head(bf, skb, napi_safe);
+	else
+		skb_free_head(skb, napi_safe);
 exit:
 	/* When we clone an SKB we copy the reycling bit. The pp_recycle
 	 * bit is only set on the head though, so in order to avoid races
@@ -998,6 +1108,12 @@ static void skb_release_data(struct sk_buff *skb, enum skb_drop_reason reason,
 	skb->pp_recycle = 0;
 }
 
+static void skb_release_data(struct sk_buff *skb, enum skb_drop_reason reason,
+			     bool napi_safe)
+{
+	__skb_release_data(skb, reason, napi_safe, NULL);
+}
+
 /*
  *	Free an skbuff by memory without cleaning the state.
  */
@@ -1363,6 +1479,62 @@ void napi_consume_skb(struct sk_buff *skb, int budget)
 }
 EXPORT_SYMBOL(napi_consume_skb);
 
+/**
+ *	napi_consume_skb_bulk - free a batch of transmitted skbs
+ *	@skbs: skbs to free, the array itself is left to the caller
+ *	@count: number of entries in @skbs
+ *	@budget: NAPI budget, 0 from non-NAPI context such as netpoll
+ *
+ *	Same as calling napi_consume_skb() on every entry, meant for driver
+ *	TX completion loops. Heads, paged fragments and page_pool pages are
+ *	collected and returned in batches rather than one call per object.
+ */
+void napi_consume_skb_bulk(struct sk_buff **skbs, unsigned int count,
+			   int budget)
+{
+	struct skb_bulk_free bf;
+	unsigned int i;
+
+	/* Zero budget indicate non-NAPI context called us, like netpoll */
+	if (unlikely(!budget)) {
+		for (i = 0; i < count; i++)
+			dev_consume_skb_any(skbs[i]);
+		return;
+	}
+
+	DEBUG_NET_WARN_ON_ONCE(!in_softirq());
+
+	bf.pool = NULL;
+	bf.pp_count = 0;
+	bf.page_count = 0;
+	bf.head_count = 0;
+
+	for (i = 0; i < count; i++) {
+		struct sk_buff *skb = skbs[i];
+
+		if (!skb_unref(skb))
+			continue;
+
+		trace_consume_skb(skb, __builtin_return_address(0));
+
+		/* if SKB is a clone, don't handle this case */
+		if (skb->fclone != SKB_FCLONE_UNAVAILABLE) {
+			__kfree_skb(skb);
+			continue;
+		}
+
+		skb_release_head_state(skb);
+		if (likely(skb->head))
+			__skb_release_data(skb, SKB_CONSUMED, true, &bf);
+		napi_skb_cache_put(skb);
+	}
+
+	skb_bulk_flush_pp(&bf);
+	skb_bulk_flush_pages(&bf);
+	skb_bulk_flush_heads(&bf);
+}
+EXPORT_SYMBOL(napi_consume_skb_bulk);
+
 /* Make sure a field is contained by headers group */
 #define CHECK_SKB_FIELD(field) \
 	BUILD_BUG_ON(offsetof(struct sk_buff, field) !=		\
@@ -3064,18 +3236,70 @@ static int sendmsg_unlocked(struct sock *sk, struct msghdr *msg)
 }
 
 typedef int (*sendmsg_func)(struct sock *sk, struct msghdr *msg);
+
+#define SKB_SEND_SOCK_MAX_BVEC	(MAX_SKB_FRAGS + 2)
+
+/* Describe the page backed data of @skb from @offset as a bio_vec array: the
+ * head when it is an unlocked page fragment, followed by the frags. Returns
+ * the number of entries used and their total length in @size.
+ */
+static int skb_send_sock_bvec(struct sk_buff *skb, int offset, int len,
+			      struct bio_vec *bvec, int *size)
+{
+	int i, slen, nr = 0, total = 0;
+
+	while (offset < skb_headlen(skb) && len &&
+	       nr < SKB_SEND_SOCK_MAX_BVEC) {
+		void *data = skb->data + offset;
+
+		slen = min_t(int, len, skb_headlen(skb) - offset);
+		slen = min_t(int, slen, PAGE_SIZE - offset_in_page(data));
+		bvec_set_virt(&bvec[nr++], data, slen);
+		offset += slen;
+		len -= slen;
+		total += slen;
+	}
+
+	if (offset < skb_headlen(skb))
+		goto out;
+
+	/* Make offset relative to start of frags */
+	offset -= skb_headlen(skb);
+
+	for (i = 0; i < skb_shinfo(skb)->nr_frags && len &&
+		    nr < SKB_SEND_SOCK_MAX_BVEC; i++) {
+		skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+
+		if (offset >= skb_frag_size(frag)) {
+			offset -= skb_frag_size(frag);
+			continue;
+		}
+
+		slen = min_t(int, len, skb_frag_size(frag) - offset);
+		bvec_set_page(&bvec[nr++], skb_frag_page(frag), slen,
+			      skb_frag_off(frag) + offset);
+		offset = 0;
+		len -= slen;
+		total += slen;
+	}
+
+out:
+	*size = total;
+	return nr;
+}
+
 static int __skb_send_sock(struct sock *sk, struct sk_buff *skb, int offset,
 			   int len, sendmsg_func sendmsg)
 {
+	struct bio_vec bvec[SKB_SEND_SOCK_MAX_BVEC];
 	unsigned int orig_len = len;
 	struct sk_buff *head = skb;
-	unsigned short fragidx;
-	int slen, ret;
+	int slen, ret, nr, i;
 
 do_frag_list:
 
-	/* Deal with head data */
-	while (offset < skb_headlen(skb) && len) {
+	/* Deal with head data that can't be referenced, it must be copied */
+	while (offset < skb_headlen(skb) && len && skb_head_is_locked(skb)) {
 		struct kvec kv;
 		struct msghdr msg;
 
@@ -3095,53 +3319,31 @@ static int __skb_send_sock(struct sock *sk, struct sk_buff *skb, int offset,
 		len -= ret;
 	}
 
-	/* All the data was skb head? */
-	if (!len)
-		goto out;
-
-	/* Make offset relative to start of frags */
-	offset -= skb_headlen(skb);
-
-	/* Find where we are in frag list */
-	for (fragidx = 0; fragidx < skb_shinfo(skb)->nr_frags; fragidx++) {
-		skb_frag_t *frag  = &skb_shinfo(skb)->frags[fragidx];
-
-		if (offset < skb_frag_size(frag))
-			break;
-
-		offset -= skb_frag_size(frag);
-	}
-
-	for (; len && fragidx < skb_shinfo(skb)->nr_frags; fragidx++) {
-		skb_frag_t *frag  = &skb_shinfo(skb)->frags[fragidx];
-
-		slen = min_t(size_t, len, skb_frag_size(frag) - offset);
-
-		while (slen) {
-			struct bio_vec bvec;
-			struct msghdr msg = {
-				.msg_flags = MSG_SPLICE_PAGES | MSG_DONTWAIT,
-			};
-
-			bvec_set_page(&bvec, skb_frag_page(frag), slen,
-				      skb_frag_off(frag) + offset);
-			iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, &bvec, 1,
-				      slen);
+	/* Hand the remaining pages to the socket in as few calls as
+	 * possible, taking page references rather than copying.
+	 */
+	while (len && (nr = skb_send_sock_bvec(skb, offset, len, bvec, &slen))) {
+		struct msghdr msg = {
+			.msg_flags = MSG_SPLICE_PAGES | MSG_DONTWAIT,
+		};
 
-			ret = INDIRECT_CALL_2(sendmsg, sendmsg_locked,
-					      sendmsg_unlocked, sk, &msg);
-			if (ret <= 0)
-				goto error;
+		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, bvec, nr, slen);
 
-			len -= ret;
-			offset += ret;
-			slen -= ret;
-		}
+		ret = INDIRECT_CALL_2(sendmsg, sendmsg_locked,
+				      sendmsg_unlocked, sk, &msg);
+		if (ret <= 0)
+			goto error;
 
-		offset = 0;
+		offset += ret;
+		len -= ret;
 	}
 
 	if (len) {
+		/* Make offset relative to the next skb of the frag list */
+		offset -= skb_headlen(skb);
+		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
+			offset -= skb_frag_size(&skb_shinfo(skb)->frags[i]);
+
 		/* Process any frag lists */
 
 		if (skb == head) {
@@ -3155,7 +3357,6 @@ static int __skb_send_sock(struct sock *sk, struct sk_buff *skb, int offset,
 		}
 	}
 
-out:
 	return orig_len - len;
 
 error:
@@ -610,13 +610,15 @@ static int sk_psock_skb_ingress_self(struct sk_psock *psock, struct sk_buff *skb
 }
 
 static int sk_psock_handle_skb(struct sk_psock *psock, struct sk_buff *skb,
-			       u32 off, u32 len, bool ingress)
+			       u32 off, u32 len, bool ingress, bool locked)
 {
 	int err = 0;
 
 	if (!ingress) {
 		if (!sock_writeable(psock->sk))
 			return -EAGAIN;
+		if (locked)
+			return skb_send_sock_locked(psock->sk, skb, off, len);
 		return skb_send_sock(psock->sk, skb, off, len);
 	}
 	skb_get(skb);
@@ -638,12 +640,25 @@ static void sk_psock_skb_state(struct sk_psock *psock,
 	spin_unlock_bh(&psock->ingress_lock);
 }
 
+/* Number of egress skbs sent under a single lock_sock() by the backlog */
+#define SK_PSOCK_BACKLOG_BATCH	16
+
+/* Sending with the socket already locked bypasses sk_prot->sendmsg, which is
+ * only equivalent for TCP sockets without a msg parser attached.
+ */
+static bool sk_psock_backlog_can_lock(const struct sk_psock *psock)
+{
+	return sk_is_tcp(psock->sk) && !READ_ONCE(psock->progs.msg_parser);
+}
+
 static void sk_psock_backlog(struct work_struct *work)
 {
 	struct delayed_work *dwork = to_delayed_work(work);
 	struct sk_psock *psock = container_of(dwork, struct sk_psock, work);
 	struct sk_psock_work_state *state = &psock->work_state;
 	struct sk_buff *skb = NULL;
+	unsigned int batch = 0;
+	bool locked = false;
 	u32 len = 0, off = 0;
 	bool ingress;
 	int ret;
@@ -665,11 +680,25 @@ static void sk_psock_backlog(struct work_struct *work)
 		}
 		ingress = skb_bpf_ingress(skb);
 		skb_bpf_redirect_clear(skb);
+
+		/* Consecutive egress skbs share one socket lock hold, so the
+		 * destination does not bounce its lock for every redirect.
+		 */
+		if (ingress && locked) {
+			release_sock(psock->sk);
+			locked = false;
+			batch = 0;
+		} else if (!ingress && !locked &&
+			   sk_psock_backlog_can_lock(psock)) {
+			lock_sock(psock->sk);
+			locked = true;
+		}
+
 		do {
 			ret = -EIO;
 			if (!sock_flag(psock->sk, SOCK_DEAD))
 				ret = sk_psock_handle_skb(psock, skb, off,
-							  len, ingress);
+							  len, ingress, locked);
 			if (ret <= 0) {
 				if (ret == -EAGAIN) {
 					sk_psock_skb_state(psock, state, len, off);
@@ -692,8 +721,16 @@ static void sk_psock_backlog(struct work_struct *work)
 
 		skb = skb_dequeue(&psock->ingress_skb);
 		kfree_skb(skb);
+
+		if (locked && ++batch >= SK_PSOCK_BACKLOG_BATCH) {
+			release_sock(psock->sk);
+			locked = false;
+			batch = 0;
+		}
 	}
 end:
+	if (locked)
+		release_sock(psock->sk);
 	mutex_unlock(&psock->work_mutex);
 }
 
@@ -525,10 +525,17 @@ static struct sock *run_bpf_filter(struct sock_reuseport *reuse, u16 socks,
 	return reuse->socks[index];
 }
 
+/*
+ * With SO_INCOMING_CPU set on some sockets of the group, prefer the socket
+ * bound to the receiving CPU, then the first one (in hash order) bound to a
+ * CPU on the same NUMA node, and only then fall back to plain hashing.
+ */
 static struct sock *reuseport_select_sock_by_hash(struct sock_reuseport *reuse,
 						  u32 hash, u16 num_socks)
 {
-	struct sock *first_valid_sk = NULL;
+	struct sock *first_valid_sk = NULL, *first_node_sk = NULL;
+	int cpu = raw_smp_processor_id();
+	int node = cpu_to_node(cpu);
 	int i, j;
 
 	i = j = reciprocal_scale(hash, num_socks);
@@ -536,14 +543,21 @@ static struct sock *reuseport_select_sock_by_hash(struct sock_reuseport *reuse,
 		struct sock *sk = reuse->socks[i];
 
 		if (sk->sk_state != TCP_ESTABLISHED) {
+			int sk_cpu;
+
 			/* Paired with WRITE_ONCE() in __reuseport_(get|put)_incoming_cpu(). */
 			if (!READ_ONCE(reuse->incoming_cpu))
 				return sk;
 
 			/* Paired with WRITE_ONCE() in reuseport_update_incoming_cpu(). */
-			if (READ_ONCE(sk->sk_incoming_cpu) == raw_smp_processor_id())
+			sk_cpu = READ_ONCE(sk->sk_incoming_cpu);
+			if (sk_cpu == cpu)
 				return sk;
 
+			if (!first_node_sk && sk_cpu >= 0 &&
+			    sk_cpu < nr_cpu_ids && cpu_to_node(sk_cpu) == node)
+				first_node_sk = sk;
+
 			if (!first_valid_sk)
 				first_valid_sk = sk;
 		}
@@ -553,7 +567,7 @@ static struct sock *reuseport_select_sock_by_hash(struct sock_reuseport *reuse,
 			i = 0;
 	} while (i != j);
 
-	return first_valid_sk;
+	return first_node_sk ?: first_valid_sk;
 }
 
 /**
@@ -184,6 +184,9 @@ struct neigh_table arp_tbl = {
 };
 EXPORT_SYMBOL(arp_tbl);
 
+DEFINE_PER_CPU(struct arp_cache_ent [1 << ARP_CACHE_BITS], arp_cache);
+EXPORT_PER_CPU_SYMBOL(arp_cache);
+
 int arp_mc_map(__be32 addr, u8 *haddr, struct net_device *dev, int dir)
 {
 	switch (dev->type) {
@@ -60,6 +60,7 @@
 #include <linux/export.h>
 #include <linux/vmalloc.h>
 #include <linux/notifier.h>
+#include <linux/workqueue.h>
 #include <net/net_namespace.h>
 #include <net/inet_dscp.h>
 #include <net/ip.h>
@@ -163,11 +164,36 @@ struct trie_stat {
 	unsigned int nodesizes[MAX_STAT_DEPTH];
 };
 
+#ifdef CONFIG_IP_FIB_DIR
+/* DIR-16-8-8 index of the trie: a 64K entry first level indexed by the top
+ * 16 bits of the key, then 256 entry chunks for the next two bytes.  An
+ * entry is either 0 (no prefix), a chunk index tagged with FIB_DIR_CHUNK, or
+ * one plus the index of the leaf holding the longest matching prefix.
+ */
+#define FIB_DIR_CHUNK		0x80000000U
+#define FIB_DIR_CHUNK_BITS	8
+#define FIB_DIR_MIN_LEAVES	1024
+#define FIB_DIR_DELAY		msecs_to_jiffies(100)
+
+struct fib_dir {
+	struct rcu_head rcu;
+	struct key_vector **leaves;
+	u32 *chunks;
+	unsigned int nr_chunks;
+	unsigned int max_chunks;
+	u32 tbl16[1 << 16];
+};
+#endif
+
 struct trie {
 	struct key_vector kv[1];
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats __percpu *stats;
 #endif
+#ifdef CONFIG_IP_FIB_DIR
+	struct fib_dir __rcu *dir;	/* NULL while stale */
+	struct delayed_work dir_work;
+#endif
 };
 
 static struct key_vector *resize(struct trie *t, struct key_vector *tn);
@@ -317,6 +343,72 @@ static void __node_free_rcu(struct rcu_head *head)
 
 #define node_free(n) call_rcu(&tn_info(n)->rcu, __node_free_rcu)
 
+#ifdef CONFIG_IP_FIB_DIR
+static void fib_dir_free(struct fib_dir *dir)
+{
+	kvfree(dir->chunks);
+	kvfree(dir->leaves);
+	kvfree(dir);
+}
+
+static void __fib_dir_free_rcu(struct rcu_head *head)
+{
+	fib_dir_free(container_of(head, struct fib_dir, rcu));
+}
+
+/* Caller must hold RTNL. Lookups fall back to the trie until the rebuild */
+static void fib_dir_invalidate(struct trie *t)
+{
+	struct fib_dir *dir = rtnl_dereference(t->dir);
+
+	if (dir) {
+		RCU_INIT_POINTER(t->dir, NULL);
+		call_rcu(&dir->rcu, __fib_dir_free_rcu);
+	}
+
+	/* not mod_delayed_work(), a steady stream of updates must not starve
+	 * the rebuild
+	 */
+	queue_delayed_work(system_unbound_wq, &t->dir_work, FIB_DIR_DELAY);
+}
+
+static void fib_dir_release(struct trie *t)
+{
+	struct fib_dir *dir;
+
+	cancel_delayed_work_sync(&t->dir_work);
+	/* the table is unreachable, no more updates or lookups */
+	dir = rcu_dereference_protected(t->dir, 1);
+	if (dir)
+		call_rcu(&dir->rcu, __fib_dir_free_rcu);
+}
+
+/* caller must hold RCU read lock or RTNL */
+static struct key_vector *fib_dir_lookup(struct trie *t, t_key key)
+{
+	struct fib_dir *dir = rcu_dereference_rtnl(t->dir);
+	u32 e;
+
+	if (!dir)
+		return NULL;
+
+	e = dir->tbl16[key >> 16];
+	if (e & FIB_DIR_CHUNK) {
+		e = dir->chunks[((unsigned long)(e & ~FIB_DIR_CHUNK) <<
+				 FIB_DIR_CHUNK_BITS) | ((key >> 8) & 0xff)];
+		if (e & FIB_DIR_CHUNK)
+			e = dir->chunks[((unsigned long)(e & ~FIB_DIR_CHUNK) <<
+					 FIB_DIR_CHUNK_BITS) | (key & 0xff)];
+	}
+
+	return e ? dir->leaves[e - 1] : NULL;
+}
+#else
+static inline void fib_dir_invalidate(struct trie *t)
+{
+}
+#endif
+
 static struct tnode *tnode_alloc(int bits)
 {
 	size_t size;
@@ -1160,6 +1252,8 @@ static int fib_insert_alias(struct trie *t, struct key_vector *tp,
 			    struct key_vector *l, struct fib_alias *new,
 			    struct fib_alias *fa, t_key key)
 {
+	fib_dir_invalidate(t);
+
 	if (!l)
 		return fib_insert_node(t, tp, new, key);
 
@@ -1450,6 +1544,9 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 #endif
 	const t_key key = ntohl(flp->daddr);
 	struct key_vector *n, *pn;
+#ifdef CONFIG_IP_FIB_DIR
+	struct key_vector *dir_leaf;
+#endif
 	struct fib_alias *fa;
 	unsigned long index;
 	t_key cindex;
@@ -1467,6 +1564,17 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	this_cpu_inc(stats->gets);
 #endif
 
+#ifdef CONFIG_IP_FIB_DIR
+	/* Step 0: the index names the leaf holding the longest prefix, if
+	 * none of its aliases is usable we restart with a full trie walk.
+	 */
+	dir_leaf = fib_dir_lookup(t, key);
+	if (dir_leaf) {
+		n = dir_leaf;
+		goto found;
+	}
+walk:
+#endif
 	/* Step 1: Travel to the longest prefix match in the trie */
 	for (;;) {
 		index = get_cindex(key, n);
@@ -1642,6 +1750,14 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 miss:
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	this_cpu_inc(stats->semantic_match_miss);
+#endif
+#ifdef CONFIG_IP_FIB_DIR
+	if (dir_leaf) {
+		dir_leaf = NULL;
+		n = get_child_rcu(pn, cindex);
+		if (n)
+			goto walk;
+	}
 #endif
 	goto backtrace;
 }
@@ -1654,6 +1770,8 @@ static void fib_remove_alias(struct trie *t, struct key_vector *tp,
 	struct hlist_node **pprev = old->fa_list.pprev;
 	struct fib_alias *fa = hlist_entry(pprev, typeof(*fa), fa_list.next);
 
+	fib_dir_invalidate(t);
+
 	/* remove the fib_alias from the list */
 	hlist_del_rcu(&old->fa_list);
 
@@ -1838,6 +1956,199 @@ static struct key_vector *leaf_walk_rcu(struct key_vector **tn, t_key key)
 	return n;
 }
 
+#ifdef CONFIG_IP_FIB_DIR
+struct fib_dir_prefix {
+	t_key key;
+	u32 leaf;		/* leaf index + 1 */
+};
+
+/* Return the chunk an entry points to, creating one that inherits the
+ * entry's result if needed. The caller stores the tagged index back.
+ */
+static long fib_dir_chunk(struct fib_dir *dir, u32 e)
+{
+	unsigned long off;
+	unsigned int i;
+
+	if (e & FIB_DIR_CHUNK)
+		return e & ~FIB_DIR_CHUNK;
+
+	if (dir->nr_chunks == dir->max_chunks) {
+		unsigned int max = dir->max_chunks * 2;
+		u32 *chunks;
+
+		if (max > FIB_DIR_CHUNK)
+			return -ENOSPC;
+		chunks = kvmalloc_array((size_t)max << FIB_DIR_CHUNK_BITS,
+					sizeof(u32), GFP_KERNEL);
+		if (!chunks)
+			return -ENOMEM;
+		memcpy(chunks, dir->chunks, ((size_t)dir->nr_chunks <<
+		       FIB_DIR_CHUNK_BITS) * sizeof(u32));
+		kvfree(dir->chunks);
+		dir->chunks = chunks;
+		dir->max_chunks = max;
+	}
+
+	off = (unsigned long)dir->nr_chunks << FIB_DIR_CHUNK_BITS;
+	for (i = 0; i < (1U << FIB_DIR_CHUNK_BITS); i++)
+		dir->chunks[off + i] = e;
+
+	return dir->nr_chunks++;
+}
+
+static int fib_dir_insert(struct fib_dir *dir, t_key key, int plen, u32 val)
+{
+	unsigned long off;
+	unsigned int i, n;
+	long c1, c2;
+
+	if (plen <= 16) {
+		n = 1U << (16 - plen);
+		for (i = 0; i < n; i++)
+			dir->tbl16[(key >> 16) + i] = val;
+		return 0;
+	}
+
+	c1 = fib_dir_chunk(dir, dir->tbl16[key >> 16]);
+	if (c1 < 0)
+		return c1;
+	dir->tbl16[key >> 16] = c1 | FIB_DIR_CHUNK;
+	off = ((unsigned long)c1 << FIB_DIR_CHUNK_BITS) | ((key >> 8) & 0xff);
+
+	if (plen <= 24) {
+		n = 1U << (24 - plen);
+		for (i = 0; i < n; i++)
+			dir->chunks[off + i] = val;
+		return 0;
+	}
+
+	c2 = fib_dir_chunk(dir, dir->chunks[off]);
+	if (c2 < 0)
+		return c2;
+	dir->chunks[off] = c2 | FIB_DIR_CHUNK;
+	off = ((unsigned long)c2 << FIB_DIR_CHUNK_BITS) | (key & 0xff);
+
+	n = 1U << (KEYLENGTH - plen);
+	for (i = 0; i < n; i++)
+		dir->chunks[off + i] = val;
+	return 0;
+}
+
+/* Caller must hold RTNL */
+static int fib_dir_build(struct trie *t)
+{
+	unsigned int count[KEYLENGTH + 1] = {}, start[KEYLENGTH + 1];
+	unsigned int nleaves = 0, nprefixes = 0, i, plen;
+	struct key_vector *l, *tp = t->kv;
+	struct fib_dir_prefix *prefixes;
+	struct fib_alias *fa;
+	struct fib_dir *dir, *old;
+	t_key key = 0;
+	int err = -ENOMEM;
+
+	while ((l = leaf_walk_rcu(&tp, key)) != NULL) {
+		int last = -1;
+
+		/* aliases are sorted by suffix length, count each once */
+		nleaves++;
+		hlist_for_each_entry(fa, &l->leaf, fa_list) {
+			if (fa->fa_slen == last)
+				continue;
+			last = fa->fa_slen;
+			count[KEYLENGTH - fa->fa_slen]++;
+			nprefixes++;
+		}
+
+		key = l->key + 1;
+		if (key < l->key)
+			break;
+	}
+
+	/* small tables stay cache resident, the trie is good enough */
+	if (nleaves < FIB_DIR_MIN_LEAVES)
+		return 0;
+
+	dir = kvzalloc(sizeof(*dir), GFP_KERNEL);
+	if (!dir)
+		return -ENOMEM;
+	dir->max_chunks = 64;
+	dir->chunks = kvmalloc_array(dir->max_chunks << FIB_DIR_CHUNK_BITS,
+				     sizeof(u32), GFP_KERNEL);
+	dir->leaves = kvmalloc_array(nleaves, sizeof(*dir->leaves), GFP_KERNEL);
+	prefixes = kvmalloc_array(nprefixes, sizeof(*prefixes), GFP_KERNEL);
+	if (!dir->chunks || !dir->leaves || !prefixes)
+		goto out;
+
+	/* sort by prefix length so longer prefixes overwrite shorter ones */
+	for (i = 0, plen = 0; plen <= KEYLENGTH; plen++) {
+		start[plen] = i;
+		i += count[plen];
+	}
+
+	tp = t->kv;
+	key = 0;
+	i = 0;
+	while ((l = leaf_walk_rcu(&tp, key)) != NULL) {
+		int last = -1;
+
+		dir->leaves[i++] = l;
+		hlist_for_each_entry(fa, &l->leaf, fa_list) {
+			if (fa->fa_slen == last)
+				continue;
+			last = fa->fa_slen;
+			plen = KEYLENGTH - fa->fa_slen;
+			prefixes[start[plen]].key = l->key;
+			prefixes[start[plen]++].leaf = i;
+		}
+
+		key = l->key + 1;
+		if (key < l->key)
+			break;
+	}
+
+	for (i = 0, plen = 0; plen <= KEYLENGTH; plen++) {
+		unsigned int end = i + count[plen];
+
+		for (; i < end; i++) {
+			err = fib_dir_insert(dir, prefixes[i].key, plen,
+					     prefixes[i].leaf);
+			if (err)
+				goto out;
+		}
+	}
+
+	old = rtnl_dereference(t->dir);
+	rcu_assign_pointer(t->dir, dir);
+	if (old)
+		call_rcu(&old->rcu, __fib_dir_free_rcu);
+	dir = NULL;
+	err = 0;
+out:
+	kvfree(prefixes);
+	if (dir)
+		fib_dir_free(dir);
+	return err;
+}
+
+static void fib_dir_work(struct work_struct *work)
+{
+	struct trie *t = container_of(to_delayed_work(work), struct trie,
+				      dir_work);
+
+	/* fib_dir_release() cancels us with RTNL held */
+	if (!rtnl_trylock()) {
+		queue_delayed_work(system_unbound_wq, &t->dir_work, 1);
+		return;
+	}
+
+	if (!rtnl_dereference(t->dir))
+		fib_dir_build(t);
+
+	rtnl_unlock();
+}
+#endif
+
 static void fib_trie_free(struct fib_table *tb)
 {
 	struct trie *t = (struct trie *)tb->tb_data;
@@ -1892,6 +2203,9 @@ static void fib_trie_free(struct fib_table *tb)
 
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	free_percpu(t->stats);
+#endif
+#ifdef CONFIG_IP_FIB_DIR
+	fib_dir_release(t);
 #endif
 	kfree(tb);
 }
@@ -2262,6 +2576,10 @@ static void __trie_free_rcu(struct rcu_head *head)
 
 void fib_free_table(struct fib_table *tb)
 {
+#ifdef CONFIG_IP_FIB_DIR
+	if (tb->tb_data == tb->__data)
+		fib_dir_release((struct trie *)tb->tb_data);
+#endif
 	call_rcu(&tb->rcu, __trie_free_rcu);
 }
 
@@ -2430,6 +2748,9 @@ struct fib_table *fib_trie_table(u32 id, struct fib_table *alias)
 	t = (struct trie *) tb->tb_data;
 	t->kv[0].pos = KEYLENGTH;
 	t->kv[0].slen = KEYLENGTH;
+#ifdef CONFIG_IP_FIB_DIR
+	INIT_DELAYED_WORK(&t->dir_work, fib_dir_work);
+#endif
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	t->stats = alloc_percpu(struct trie_use_stats);
 	if (!t->stats) {
@@ -332,6 +332,7 @@ inet_csk_find_open_port(const struct sock *sk, struct inet_bind_bucket **tb_ret,
 	struct inet_bind_bucket *tb;
 	u32 remaining, offset;
 	bool relax = false;
+	int scanned = 0;
 
 	l3mdev = inet_sk_bound_l3mdev(sk);
 ports_exhausted:
@@ -366,6 +367,7 @@ inet_csk_find_open_port(const struct sock *sk, struct inet_bind_bucket **tb_ret,
 			port -= remaining;
 		if (inet_is_local_reserved_port(net, port))
 			continue;
+		scanned++;
 		head = &hinfo->bhash[inet_bhashfn(net, port,
 						  hinfo->bhash_size)];
 		spin_lock_bh(&head->lock);
@@ -407,8 +409,11 @@ inet_csk_find_open_port(const struct sock *sk, struct inet_bind_bucket **tb_ret,
 		relax = true;
 		goto ports_exhausted;
 	}
+	NET_ADD_STATS(net, LINUX_MIB_LOCALPORTSCAN, scanned);
 	return NULL;
 success:
+	__NET_INC_STATS(net, LINUX_MIB_LOCALPORTALLOC);
+	__NET_ADD_STATS(net, LINUX_MIB_LOCALPORTSCAN, scanned);
 	*port_ret = port;
 	*tb_ret = tb;
 	*tb2_ret = tb2;
@@ -997,6 +997,48 @@ EXPORT_SYMBOL_GPL(inet_bhash2_reset_saddr);
 #define INET_TABLE_PERTURB_SIZE (1 << CONFIG_INET_TABLE_PERTURB_ORDER)
 static u32 *table_perturb;
 
+/* Lockless hint that @lport can not be used by @sk because an established
+ * socket already owns the resulting 4-tuple. This lets connect() skip ports
+ * in use towards the same destination without taking the bind and ehash
+ * bucket locks. The walk may race with socket reuse, so a stale answer is
+ * possible either way; the caller re-checks under the locks and a false
+ * positive only costs trying the next port.
+ */
+static bool inet_ehash_port_busy(struct inet_hashinfo *hinfo,
+				 const struct sock *sk, u16 lport)
+{
+	const struct inet_sock *inet = inet_sk(sk);
+	__be32 daddr = inet->inet_rcv_saddr;
+	__be32 saddr = inet->inet_daddr;
+	int dif = sk->sk_bound_dev_if;
+	struct net *net = sock_net(sk);
+	int sdif = l3mdev_master_ifindex_by_index(net, dif);
+	INET_ADDR_COOKIE(acookie, saddr, daddr);
+	const __portpair ports = INET_COMBINED_PORTS(inet->inet_dport, lport);
+	unsigned int hash = inet_ehashfn(net, daddr, lport,
+					 saddr, inet->inet_dport);
+	struct inet_ehash_bucket *head = inet_ehash_bucket(hinfo, hash);
+	const struct hlist_nulls_node *node;
+	struct sock *sk2;
+	bool busy = false;
+
+	if (sk->sk_family != AF_INET)
+		return false;
+
+	rcu_read_lock();
+	sk_nulls_for_each_rcu(sk2, node, &head->chain) {
+		if (sk2->sk_hash != hash)
+			continue;
+		if (inet_match(net, sk2, acookie, ports, dif, sdif)) {
+			busy = READ_ONCE(sk2->sk_state) != TCP_TIME_WAIT;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return busy;
+}
+
 int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		struct sock *sk, u64 port_offset,
 		int (*check_established)(struct inet_timewait_death_row *,
@@ -1010,8 +1052,9 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 	struct inet_bind2_bucket *tb2;
 	struct inet_bind_bucket *tb;
 	bool tb_created = false;
-	u32 remaining, offset;
+	u32 remaining, offset, slice;
 	int ret, i, low, high;
+	int scanned = 0;
 	int l3mdev;
 	u32 index;
 
@@ -1035,6 +1078,12 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 	index = port_offset & (INET_TABLE_PERTURB_SIZE - 1);
 
 	offset = READ_ONCE(table_perturb[index]) + (port_offset >> 32);
+	/* Concurrent connects to the same destination share the perturb slot,
+	 * so they would all start at the same port and fight over the same
+	 * bucket locks. Give each CPU its own slice of the range to start in.
+	 */
+	slice = remaining / nr_cpu_ids;
+	offset += slice * raw_smp_processor_id();
 	offset %= remaining;
 
 	/* In first pass we try ports of @low parity.
@@ -1048,6 +1097,9 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 			port -= remaining;
 		if (inet_is_local_reserved_port(net, port))
 			continue;
+		scanned++;
+		if (inet_ehash_port_busy(hinfo, sk, port))
+			continue;
 		head = &hinfo->bhash[inet_bhashfn(net, port,
 						  hinfo->bhash_size)];
 		spin_lock_bh(&head->lock);
@@ -1087,9 +1139,13 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 	if ((offset & 1) && remaining > 1)
 		goto other_parity_scan;
 
+	NET_ADD_STATS(net, LINUX_MIB_LOCALPORTSCAN, scanned);
 	return -EADDRNOTAVAIL;
 
 ok:
+	__NET_INC_STATS(net, LINUX_MIB_LOCALPORTALLOC);
+	__NET_ADD_STATS(net, LINUX_MIB_LOCALPORTSCAN, scanned);
+
 	/* Find the corresponding tb2 bucket since we need to
 	 * add the socket to the bhash2 table as well
 	 */
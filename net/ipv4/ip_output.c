@@ -1308,6 +1308,7 @@ static int ip_setup_cork(struct sock *sk, struct inet_cork *cork,
 		return -ENETUNREACH;
 
 	cork->gso_size = ipc->gso_size;
+	cork->gso_txtime_delta = ipc->gso_txtime_delta;
 
 	cork->dst = &rt->dst;
 	/* We stole this route, caller should not release it. */
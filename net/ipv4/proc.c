@@ -298,6 +298,8 @@ static const struct snmp_mib snmp4_net_list[] = {
 	SNMP_MIB_ITEM("TCPMigrateReqSuccess", LINUX_MIB_TCPMIGRATEREQSUCCESS),
 	SNMP_MIB_ITEM("TCPMigrateReqFailure", LINUX_MIB_TCPMIGRATEREQFAILURE),
 	SNMP_MIB_ITEM("TCPPLBRehash", LINUX_MIB_TCPPLBREHASH),
+	SNMP_MIB_ITEM("LocalPortAlloc", LINUX_MIB_LOCALPORTALLOC),
+	SNMP_MIB_ITEM("LocalPortScan", LINUX_MIB_LOCALPORTSCAN),
 	SNMP_MIB_SENTINEL
 };
 
@@ -1783,9 +1783,15 @@ static skb_frag_t *skb_advance_to_frag(struct sk_buff *skb, u32 offset_skb,
 	return frag;
 }
 
+/*
+ * Frags built from large folios (e.g. high order page_pool pages) span
+ * several pages; they can be mapped one page at a time as long as they
+ * start and end on a page boundary.
+ */
 static bool can_map_frag(const skb_frag_t *frag)
 {
-	return skb_frag_size(frag) == PAGE_SIZE && !skb_frag_off(frag);
+	return skb_frag_size(frag) && PAGE_ALIGNED(skb_frag_size(frag)) &&
+	       PAGE_ALIGNED(skb_frag_off(frag));
 }
 
 static int find_next_mappable_frag(const skb_frag_t *frag,
@@ -2077,6 +2083,7 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	const skb_frag_t *frags = NULL;
 	unsigned int pages_to_map = 0;
 	struct vm_area_struct *vma;
+	u32 frag_off = 0;
 	struct sk_buff *skb = NULL;
 	u32 seq = tp->copied_seq;
 	u32 total_bytes_to_map;
@@ -2146,22 +2153,34 @@ static int tcp_zerocopy_receive(struct sock *sk,
 			}
 			zc->recv_skip_hint = skb->len - offset;
 			frags = skb_advance_to_frag(skb, offset, &offset_frag);
-			if (!frags || offset_frag)
+			if (!frags)
 				break;
+			/* may resume within a multi-page frag */
+			if (offset_frag &&
+			    (!can_map_frag(frags) || !PAGE_ALIGNED(offset_frag)))
+				break;
+			frag_off = offset_frag;
 		}
 
-		mappable_offset = find_next_mappable_frag(frags,
-							  zc->recv_skip_hint);
-		if (mappable_offset) {
-			zc->recv_skip_hint = mappable_offset;
-			break;
+		if (!frag_off) {
+			mappable_offset = find_next_mappable_frag(frags,
+								  zc->recv_skip_hint);
+			if (mappable_offset) {
+				zc->recv_skip_hint = mappable_offset;
+				break;
+			}
 		}
-		page = skb_frag_page(frags);
+		page = nth_page(skb_frag_page(frags),
+				(skb_frag_off(frags) + frag_off) >> PAGE_SHIFT);
 		prefetchw(page);
 		pages[pages_to_map++] = page;
 		length += PAGE_SIZE;
 		zc->recv_skip_hint -= PAGE_SIZE;
-		frags++;
+		frag_off += PAGE_SIZE;
+		if (frag_off == skb_frag_size(frags)) {
+			frag_off = 0;
+			frags++;
+		}
 		if (pages_to_map == TCP_ZEROCOPY_PAGE_BATCH_SIZE ||
 		    zc->recv_skip_hint < PAGE_SIZE) {
 			/* Either full batch, or we're about to go to next skb
@@ -0,0 +1,1523 @@
+/* BBR (Bottleneck Bandwidth and RTT) congestion control, version 3
+ *
+ * BBRv3 keeps the model-based core of BBR (see tcp_bbr.c): it estimates the
+ * bottleneck bandwidth and the two-way propagation delay from the ACK stream
+ * and paces at roughly the estimated bandwidth. On top of that it treats
+ * packet loss and ECN marks as explicit signals of the volume of data the
+ * path can hold:
+ *
+ *   inflight_hi: long-term upper bound on inflight, set when a bandwidth
+ *                probe drives the loss rate above bbr_loss_thresh (2%) or
+ *                the CE mark rate above bbr_ecn_thresh (50%), and grown
+ *                slowly while probing finds that more is safe.
+ *   bw_lo, inflight_lo: short-term lower bounds, cut by a multiplicative
+ *                factor each round trip with loss or ECN marks, and reset
+ *                whenever we start probing for bandwidth again.
+ *
+ * The PROBE_BW state is organized as a cycle of four phases:
+ *
+ *   DOWN:   pace below bw (0.9x) to drain any queue built while probing,
+ *   CRUISE: pace at bw, keeping inflight a bit below inflight_hi,
+ *   REFILL: pace at bw for one round with the lower bounds lifted,
+ *   UP:     pace above bw (1.25x) and grow inflight_hi to look for more bw.
+ *
+ * The time between bandwidth probes is randomized between 2 and 3 seconds,
+ * and is capped by the number of round trips a Reno flow would take to
+ * grow its cwnd by one BDP, so BBRv3 and loss-based flows share a
+ * bottleneck on similar time scales.
+ *
+ * Differences from the reference algorithm: this stack does not record the
+ * inflight at transmit time or the number of lost packets per rate sample,
+ * so loss rates are measured per packet-timed round trip from tp->lost and
+ * compared against the inflight before the ACK, and the CE mark rate is
+ * taken from the rate sample's delivery interval.
+ *
+ * BBRv3 is described in:
+ *   "BBRv3: Algorithm Bug Fixes and Public Internet Deployment",
+ *   Neal Cardwell et al., IETF 117, July 2023.
+ *
+ * NOTE: Like BBR, BBRv3 should be used with the fq qdisc ("man tc-fq") with
+ * pacing enabled, otherwise TCP stack falls back to an internal pacing using
+ * one high resolution timer per TCP socket and may use more resources.
+ */
+#include <linux/module.h>
+#include <net/tcp.h>
+#include <linux/inet_diag.h>
+#include <linux/inet.h>
+#include <linux/random.h>
+
+/* Scale factor for rate in pkt/uSec unit to avoid truncation in bandwidth
+ * estimation. The rate unit ~= (1500 bytes / 1 usec / 2^24) ~= 715 bps.
+ */
+#define BW_SCALE 24
+#define BW_UNIT (1 << BW_SCALE)
+
+#define BBR_SCALE 8	/* scaling factor for fractions in BBR (e.g. gains) */
+#define BBR_UNIT (1 << BBR_SCALE)
+
+/* BBR has the following modes for deciding how fast to send: */
+enum bbr_mode {
+	BBR_STARTUP,	/* ramp up sending rate rapidly to fill pipe */
+	BBR_DRAIN,	/* drain any queue created during startup */
+	BBR_PROBE_BW,	/* discover, share bw: pace around estimated bw */
+	BBR_PROBE_RTT,	/* cut inflight to min to probe min_rtt */
+};
+
+/* Phases of the PROBE_BW gain cycle, used as cycle_idx: */
+enum bbr_pacing_gain_phase {
+	BBR_BW_PROBE_UP		= 0,	/* push up inflight to probe for bw */
+	BBR_BW_PROBE_DOWN	= 1,	/* drain excess inflight from queue */
+	BBR_BW_PROBE_CRUISE	= 2,	/* use pipe, w/ headroom in queue */
+	BBR_BW_PROBE_REFILL	= 3,	/* refill the pipe again to 100% */
+};
+
+/* Which part of a bw probe the ACKs we are receiving belong to: */
+enum bbr_ack_phase {
+	BBR_ACKS_INIT,		 /* not probing; not getting probe feedback */
+	BBR_ACKS_REFILLING,	 /* sending at est. bw to fill pipe */
+	BBR_ACKS_PROBE_STARTING, /* inflight rising to probe bw */
+	BBR_ACKS_PROBE_STOPPING, /* stopped probing; still getting feedback */
+};
+
+/* BBRv3 congestion control block */
+struct bbr {
+	u32	min_rtt_us;	        /* min RTT in min_rtt_win_sec window */
+	u32	min_rtt_stamp;	        /* timestamp of min_rtt_us */
+	u32	probe_rtt_done_stamp;   /* end time for BBR_PROBE_RTT mode */
+	u32	probe_rtt_min_us;	/* min RTT in probe_rtt_win_ms window */
+	u32	probe_rtt_min_stamp;	/* timestamp of probe_rtt_min_us */
+	u32     next_rtt_delivered; /* scb->tx.delivered at end of round */
+	u64	cycle_mstamp;	     /* time of this cycle phase start */
+	u32     mode:2,		     /* current bbr_mode in state machine */
+		prev_ca_state:3,     /* CA state on previous ACK */
+		packet_conservation:1,  /* use packet conservation? */
+		round_start:1,	     /* start of packet-timed tx->ack round? */
+		idle_restart:1,	     /* restarting after idle? */
+		probe_rtt_round_done:1,  /* a BBR_PROBE_RTT round at 4 pkts? */
+		loss_in_round:1,     /* saw packet loss in this round? */
+		ecn_in_round:1,	     /* saw ECN marks in this round? */
+		full_bw_reached:1,   /* reached full bw in Startup? */
+		full_bw_cnt:2,	/* number of rounds without large bw gains */
+		cycle_idx:2,	/* current bbr_pacing_gain_phase */
+		ack_phase:2,	/* current bbr_ack_phase */
+		has_seen_rtt:1, /* have we seen an RTT sample yet? */
+		bw_probe_samples:1,	/* rate samples reflect bw probing? */
+		prev_probe_too_high:1,	/* did last probe hit loss/ECN limit? */
+		stopped_risky_probe:1,	/* last probe stopped at inflight_hi? */
+		rounds_since_probe:8,	/* packet-timed rounds since probed bw */
+		unused:2;
+	u32	pacing_gain:10,	/* current gain for setting pacing rate */
+		cwnd_gain:10,	/* current gain for setting cwnd */
+		ecn_alpha:9,	/* EWMA of CE mark ratio, BBR_UNIT == 1.0 */
+		loss_events_in_round:3;	/* ACKs with losses in this round */
+	u32	prior_cwnd;	/* prior cwnd upon entering loss recovery */
+	u32	full_bw;	/* recent bw, to estimate if pipe is full */
+
+	/* For tracking ACK aggregation: */
+	u64	ack_epoch_mstamp;	/* start of ACK sampling epoch */
+	u16	extra_acked[2];		/* max excess data ACKed in epoch */
+	u32	ack_epoch_acked:20,	/* packets (S)ACKed in sampling epoch */
+		extra_acked_win_rtts:5,	/* age of extra_acked, in round trips */
+		extra_acked_win_idx:1,	/* current index in extra_acked array */
+		bw_probe_up_rounds:5,	/* cwnd-limited rounds in PROBE_UP */
+		unused_c:1;
+
+	/* Bandwidth and inflight model: */
+	u32	bw_hi[2];	/* max bw in this and the previous probe cycle */
+	u32	bw_lo;		/* lower bound on bw, or ~0U if unset */
+	u32	inflight_lo;	/* lower bound on inflight, or ~0U if unset */
+	u32	inflight_hi;	/* upper bound on inflight, or ~0U if unset */
+	u32	bw_probe_up_cnt;  /* packets delivered per inflight_hi incr */
+	u32	bw_probe_up_acks; /* packets (S)ACKed since inflight_hi incr */
+	u32	probe_wait_us;	  /* PROBE_DOWN+CRUISE duration (usecs) */
+	u32	round_lost;	  /* tp->lost at start of this round */
+};
+
+/* Window length of min_rtt filter (in sec): */
+static const u32 bbr_min_rtt_win_sec = 10;
+/* Window length of probe_rtt_min_us filter (in ms), and the interval at
+ * which we enter PROBE_RTT if the min_rtt has not been refreshed:
+ */
+static const u32 bbr_probe_rtt_win_ms = 5000;
+/* Minimum time (in ms) spent at the reduced inflight of BBR_PROBE_RTT: */
+static const u32 bbr_probe_rtt_mode_ms = 200;
+/* Skip TSO below the following bandwidth (bits/sec): */
+static const int bbr_min_tso_rate = 1200000;
+
+/* Pace at ~1% below estimated bw, on average, to reduce queue at bottleneck. */
+static const int bbr_pacing_margin_percent = 1;
+
+/* The pacing gain in STARTUP. 2.77 is the smallest gain that still doubles
+ * the delivery rate each round when paced with the 1% pacing margin.
+ */
+static const int bbr_startup_pacing_gain = BBR_UNIT * 277 / 100 + 1;
+/* The cwnd gain in STARTUP and DRAIN: */
+static const int bbr_startup_cwnd_gain = BBR_UNIT * 2;
+/* The pacing gain in DRAIN, to drain the STARTUP queue in about a round: */
+static const int bbr_drain_gain = BBR_UNIT * 35 / 100;
+/* The gain for deriving steady-state cwnd tolerates delayed/stretched ACKs: */
+static const int bbr_cwnd_gain = BBR_UNIT * 2;
+/* Extra cwnd gain in PROBE_UP, so that cwnd does not limit the probe: */
+static const int bbr_bw_probe_cwnd_gain = BBR_UNIT / 4;
+/* The pacing_gain values for the PROBE_BW phases: */
+static const int bbr_pacing_gain[] = {
+	[BBR_BW_PROBE_UP]	= BBR_UNIT * 5 / 4,
+	[BBR_BW_PROBE_DOWN]	= BBR_UNIT * 90 / 100,
+	[BBR_BW_PROBE_CRUISE]	= BBR_UNIT,
+	[BBR_BW_PROBE_REFILL]	= BBR_UNIT,
+};
+/* The fraction of a BDP kept in flight during BBR_PROBE_RTT: */
+static const int bbr_probe_rtt_cwnd_gain = BBR_UNIT / 2;
+
+/* Try to keep at least this many packets in flight, if things go smoothly. */
+static const u32 bbr_cwnd_min_target = 4;
+
+/* To estimate if BBR_STARTUP mode (i.e. high_gain) has filled pipe... */
+/* If bw has increased significantly (1.25x), there may be more bw available: */
+static const u32 bbr_full_bw_thresh = BBR_UNIT * 5 / 4;
+/* But after 3 rounds w/o significant bw growth, estimate pipe is full: */
+static const u32 bbr_full_bw_cnt = 3;
+/* Exit STARTUP if a round had this many lossy ACKs at a high loss rate: */
+static const u32 bbr_full_loss_cnt = 6;
+
+/* Loss rate (lost/inflight) above which inflight is considered too high: */
+static const u32 bbr_loss_thresh = BBR_UNIT * 2 / 100;
+/* Multiplicative decrease applied to the model upon loss: */
+static const u32 bbr_beta = BBR_UNIT * 30 / 100;
+/* Leave this fraction of inflight_hi unused when cruising, so that other
+ * flows can grab some bandwidth without causing loss:
+ */
+static const u32 bbr_inflight_headroom = BBR_UNIT * 15 / 100;
+
+/* CE mark rate above which inflight is considered too high: */
+static const u32 bbr_ecn_thresh = BBR_UNIT / 2;
+/* Scale of the inflight_lo cut relative to ecn_alpha: */
+static const u32 bbr_ecn_factor = BBR_UNIT / 3;
+/* EWMA gain for updating ecn_alpha once per round: */
+static const u32 bbr_ecn_alpha_gain = BBR_UNIT / 16;
+/* Initial ecn_alpha; assume heavy marking until we learn otherwise: */
+static const u32 bbr_ecn_alpha_init = BBR_UNIT;
+/* Only use ECN if the min_rtt is below this, to skip non-datacenter paths: */
+static const u32 bbr_ecn_max_rtt_us = 5000;
+
+/* Maximum packet-timed rounds to wait before probing for bw: */
+static const u32 bbr_bw_probe_max_rounds = 63;
+/* Max random packet-timed rounds to wait before probing for bw: */
+static const u32 bbr_bw_probe_rand_rounds = 2;
+/* Use BBR-native probe time scale starting at this many usec: */
+static const u32 bbr_bw_probe_base_us = 2 * USEC_PER_SEC;
+/* Use BBR-native probes spread over this many usec: */
+static const u32 bbr_bw_probe_rand_us = 1 * USEC_PER_SEC;
+
+/* Gain factor for adding extra_acked to target cwnd: */
+static const int bbr_extra_acked_gain = BBR_UNIT;
+/* Window length of extra_acked window. */
+static const u32 bbr_extra_acked_win_rtts = 5;
+/* Max allowed val for ack_epoch_acked, after which sampling epoch is reset */
+static const u32 bbr_ack_epoch_acked_reset_thresh = 1U << 20;
+/* Time period for clamping cwnd increment due to ack aggregation */
+static const u32 bbr_extra_acked_max_us = 100 * 1000;
+
+static void bbr_check_probe_rtt_done(struct sock *sk);
+static void bbr_start_bw_probe_down(struct sock *sk);
+
+/* Do we estimate that STARTUP filled the pipe? */
+static bool bbr_full_bw_reached(const struct sock *sk)
+{
+	const struct bbr *bbr = inet_csk_ca(sk);
+
+	return bbr->full_bw_reached;
+}
+
+/* Return the max recent bandwidth sample, in pkts/uS << BW_SCALE. */
+static u32 bbr_max_bw(const struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	return max(bbr->bw_hi[0], bbr->bw_hi[1]);
+}
+
+/* Return the estimated bandwidth of the path, in pkts/uS << BW_SCALE. */
+static u32 bbr_bw(const struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	return min(bbr_max_bw(sk), bbr->bw_lo);
+}
+
+/* Return maximum extra acked in past k-2k round trips,
+ * where k = bbr_extra_acked_win_rtts.
+ */
+static u16 bbr_extra_acked(const struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	return max(bbr->extra_acked[0], bbr->extra_acked[1]);
+}
+
+/* Is ECN usable as a congestion signal on this connection? */
+static bool bbr_ecn_ok(const struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct bbr *bbr = inet_csk_ca(sk);
+
+	return (tp->ecn_flags & TCP_ECN_OK) &&
+	       bbr->min_rtt_us <= bbr_ecn_max_rtt_us;
+}
+
+/* Are we sending faster than the bw estimate to look for more bandwidth? */
+static bool bbr_is_probing_bandwidth(const struct sock *sk)
+{
+	const struct bbr *bbr = inet_csk_ca(sk);
+
+	return bbr->mode == BBR_STARTUP ||
+	       (bbr->mode == BBR_PROBE_BW &&
+		(bbr->cycle_idx == BBR_BW_PROBE_REFILL ||
+		 bbr->cycle_idx == BBR_BW_PROBE_UP));
+}
+
+/* Return rate in bytes per second, optionally with a gain.
+ * The order here is chosen carefully to avoid overflow of u64. This should
+ * work for input rates of up to 2.9Tbit/sec and gain of 2.89x.
+ */
+static u64 bbr_rate_bytes_per_sec(struct sock *sk, u64 rate, int gain)
+{
+	unsigned int mss = tcp_sk(sk)->mss_cache;
+
+	rate *= mss;
+	rate *= gain;
+	rate >>= BBR_SCALE;
+	rate *= USEC_PER_SEC / 100 * (100 - bbr_pacing_margin_percent);
+	return rate >> BW_SCALE;
+}
+
+/* Convert a BBR bw and gain factor to a pacing rate in bytes per second. */
+static unsigned long bbr_bw_to_pacing_rate(struct sock *sk, u32 bw, int gain)
+{
+	u64 rate = bw;
+
+	rate = bbr_rate_bytes_per_sec(sk, rate, gain);
+	rate = min_t(u64, rate, sk->sk_max_pacing_rate);
+	return rate;
+}
+
+/* Initialize pacing rate to: startup_pacing_gain * init_cwnd / RTT. */
+static void bbr_init_pacing_rate_from_rtt(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u64 bw;
+	u32 rtt_us;
+
+	if (tp->srtt_us) {		/* any RTT sample yet? */
+		rtt_us = max(tp->srtt_us >> 3, 1U);
+		bbr->has_seen_rtt = 1;
+	} else {			 /* no RTT sample yet */
+		rtt_us = USEC_PER_MSEC;	 /* use nominal default RTT */
+	}
+	bw = (u64)tcp_snd_cwnd(tp) * BW_UNIT;
+	do_div(bw, rtt_us);
+	sk->sk_pacing_rate = bbr_bw_to_pacing_rate(sk, bw,
+						   bbr_startup_pacing_gain);
+}
+
+/* Pace using current bw estimate and a gain factor. */
+static void bbr_set_pacing_rate(struct sock *sk, u32 bw, int gain)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	unsigned long rate = bbr_bw_to_pacing_rate(sk, bw, gain);
+
+	if (unlikely(!bbr->has_seen_rtt && tp->srtt_us))
+		bbr_init_pacing_rate_from_rtt(sk);
+	if (bbr_full_bw_reached(sk) || rate > sk->sk_pacing_rate)
+		sk->sk_pacing_rate = rate;
+}
+
+/* override sysctl_tcp_min_tso_segs */
+static u32 bbr_min_tso_segs(struct sock *sk)
+{
+	return sk->sk_pacing_rate < (bbr_min_tso_rate >> 3) ? 1 : 2;
+}
+
+static u32 bbr_tso_segs_goal(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 segs, bytes;
+
+	/* Sort of tcp_tso_autosize() but ignoring
+	 * driver provided sk_gso_max_size.
+	 */
+	bytes = min_t(unsigned long,
+		      sk->sk_pacing_rate >> READ_ONCE(sk->sk_pacing_shift),
+		      GSO_LEGACY_MAX_SIZE - 1 - MAX_TCP_HEADER);
+	segs = max_t(u32, bytes / tp->mss_cache, bbr_min_tso_segs(sk));
+
+	return min(segs, 0x7FU);
+}
+
+/* Save "last known good" cwnd so we can restore it after losses or PROBE_RTT */
+static void bbr_save_cwnd(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->prev_ca_state < TCP_CA_Recovery && bbr->mode != BBR_PROBE_RTT)
+		bbr->prior_cwnd = tcp_snd_cwnd(tp);  /* this cwnd is good enough */
+	else  /* loss recovery or BBR_PROBE_RTT have temporarily cut cwnd */
+		bbr->prior_cwnd = max(bbr->prior_cwnd, tcp_snd_cwnd(tp));
+}
+
+static void bbr_cwnd_event(struct sock *sk, enum tcp_ca_event event)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (event == CA_EVENT_TX_START && tp->app_limited) {
+		bbr->idle_restart = 1;
+		bbr->ack_epoch_mstamp = tp->tcp_mstamp;
+		bbr->ack_epoch_acked = 0;
+		/* Avoid pointless buffer overflows: pace at est. bw if we don't
+		 * need more speed (we're restarting from idle and app-limited).
+		 */
+		if (bbr->mode == BBR_PROBE_BW)
+			bbr_set_pacing_rate(sk, bbr_bw(sk), BBR_UNIT);
+		else if (bbr->mode == BBR_PROBE_RTT)
+			bbr_check_probe_rtt_done(sk);
+	}
+}
+
+/* Calculate bdp based on min RTT and the estimated bottleneck bandwidth:
+ *
+ * bdp = ceil(bw * min_rtt * gain)
+ */
+static u32 bbr_bdp(struct sock *sk, u32 bw, int gain)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 bdp;
+	u64 w;
+
+	/* If we've never had a valid RTT sample, cap cwnd at the initial
+	 * default, as in BBR.
+	 */
+	if (unlikely(bbr->min_rtt_us == ~0U))	 /* no valid RTT samples yet? */
+		return TCP_INIT_CWND;  /* be safe: cap at default initial cwnd*/
+
+	w = (u64)bw * bbr->min_rtt_us;
+
+	/* Apply a gain to the given value, remove the BW_SCALE shift, and
+	 * round the value up to avoid a negative feedback loop.
+	 */
+	bdp = (((w * gain) >> BBR_SCALE) + BW_UNIT - 1) / BW_UNIT;
+
+	return bdp;
+}
+
+/* Budget enough cwnd to fit full-sized skbs in-flight on both end hosts, see
+ * the comment in tcp_bbr.c.
+ */
+static u32 bbr_quantization_budget(struct sock *sk, u32 cwnd)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	/* Allow enough full-sized skbs in flight to utilize end systems. */
+	cwnd += 3 * bbr_tso_segs_goal(sk);
+
+	/* Reduce delayed ACKs by rounding up cwnd to the next even number. */
+	cwnd = (cwnd + 1) & ~1U;
+
+	/* Ensure gain cycling gets inflight above BDP even for small BDPs. */
+	if (bbr->mode == BBR_PROBE_BW && bbr->cycle_idx == BBR_BW_PROBE_UP)
+		cwnd += 2;
+
+	return cwnd;
+}
+
+/* Find inflight based on min RTT and the estimated bottleneck bandwidth. */
+static u32 bbr_inflight(struct sock *sk, u32 bw, int gain)
+{
+	u32 inflight;
+
+	inflight = bbr_bdp(sk, bw, gain);
+	inflight = bbr_quantization_budget(sk, inflight);
+
+	return inflight;
+}
+
+/* The volume of data we try to keep in flight in steady state. */
+static u32 bbr_target_inflight(struct sock *sk)
+{
+	u32 bdp = bbr_inflight(sk, bbr_bw(sk), BBR_UNIT);
+
+	return min(bdp, tcp_snd_cwnd(tcp_sk(sk)));
+}
+
+/* inflight_hi, less some headroom for other flows, for cruising. */
+static u32 bbr_inflight_with_headroom(const struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 headroom;
+
+	if (bbr->inflight_hi == ~0U)
+		return ~0U;
+
+	headroom = ((u64)bbr->inflight_hi * bbr_inflight_headroom) >> BBR_SCALE;
+	headroom = max(headroom, 1U);
+	return max_t(s32, bbr->inflight_hi - headroom, bbr_cwnd_min_target);
+}
+
+/* Estimate the packets of ours in the network at the next skb's earliest
+ * departure time; see the comment in tcp_bbr.c.
+ */
+static u32 bbr_packets_in_net_at_edt(struct sock *sk, u32 inflight_now)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u64 now_ns, edt_ns, interval_us;
+	u32 interval_delivered, inflight_at_edt;
+
+	now_ns = tp->tcp_clock_cache;
+	edt_ns = max(tp->tcp_wstamp_ns, now_ns);
+	interval_us = div_u64(edt_ns - now_ns, NSEC_PER_USEC);
+	interval_delivered = (u64)bbr_bw(sk) * interval_us >> BW_SCALE;
+	inflight_at_edt = inflight_now;
+	if (bbr->pacing_gain > BBR_UNIT)              /* increasing inflight */
+		inflight_at_edt += bbr_tso_segs_goal(sk);  /* include EDT skb */
+	if (interval_delivered >= inflight_at_edt)
+		return 0;
+	return inflight_at_edt - interval_delivered;
+}
+
+/* Find the cwnd increment based on estimate of ack aggregation */
+static u32 bbr_ack_aggregation_cwnd(struct sock *sk)
+{
+	u32 max_aggr_cwnd, aggr_cwnd = 0;
+
+	if (bbr_extra_acked_gain && bbr_full_bw_reached(sk)) {
+		max_aggr_cwnd = ((u64)bbr_bw(sk) * bbr_extra_acked_max_us)
+				/ BW_UNIT;
+		aggr_cwnd = (bbr_extra_acked_gain * bbr_extra_acked(sk))
+			     >> BBR_SCALE;
+		aggr_cwnd = min(aggr_cwnd, max_aggr_cwnd);
+	}
+
+	return aggr_cwnd;
+}
+
+/* In the first round of recovery follow packet conservation, then slow-start
+ * back up; after recovery or upon undo restore the cwnd we had before.
+ */
+static bool bbr_set_cwnd_to_recover_or_restore(
+	struct sock *sk, const struct rate_sample *rs, u32 acked, u32 *new_cwnd)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u8 prev_state = bbr->prev_ca_state, state = inet_csk(sk)->icsk_ca_state;
+	u32 cwnd = tcp_snd_cwnd(tp);
+
+	if (rs->losses > 0)
+		cwnd = max_t(s32, cwnd - rs->losses, 1);
+
+	if (state == TCP_CA_Recovery && prev_state != TCP_CA_Recovery) {
+		/* Starting 1st round of Recovery, so do packet conservation. */
+		bbr->packet_conservation = 1;
+		/* Cut unused cwnd from app behavior, TSQ, or TSO deferral: */
+		cwnd = tcp_packets_in_flight(tp) + acked;
+	} else if (prev_state >= TCP_CA_Recovery && state < TCP_CA_Recovery) {
+		/* Exiting loss recovery; restore cwnd saved before recovery. */
+		cwnd = max(cwnd, bbr->prior_cwnd);
+		bbr->packet_conservation = 0;
+	}
+	bbr->prev_ca_state = state;
+
+	if (bbr->packet_conservation) {
+		*new_cwnd = max(cwnd, tcp_packets_in_flight(tp) + acked);
+		return true;	/* yes, using packet conservation */
+	}
+	*new_cwnd = cwnd;
+	return false;
+}
+
+/* The cwnd used in BBR_PROBE_RTT: a fraction of the estimated BDP. */
+static u32 bbr_probe_rtt_cwnd(struct sock *sk)
+{
+	return max_t(u32, bbr_cwnd_min_target,
+		     bbr_bdp(sk, bbr_bw(sk), bbr_probe_rtt_cwnd_gain));
+}
+
+/* Slow-start up toward target cwnd (if bw estimate is growing, or packet loss
+ * has drawn us down below target), or snap down to target if we're above it.
+ */
+static void bbr_set_cwnd(struct sock *sk, const struct rate_sample *rs,
+			 u32 acked, u32 bw, int gain)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 cwnd = tcp_snd_cwnd(tp), target_cwnd = 0;
+
+	if (!acked)
+		goto done;  /* no packet fully ACKed; just apply caps */
+
+	if (bbr_set_cwnd_to_recover_or_restore(sk, rs, acked, &cwnd))
+		goto done;
+
+	target_cwnd = bbr_bdp(sk, bw, gain);
+
+	/* Increment the cwnd to account for excess ACKed data that seems
+	 * due to aggregation (of data and/or ACKs) visible in the ACK stream.
+	 */
+	target_cwnd += bbr_ack_aggregation_cwnd(sk);
+	target_cwnd = bbr_quantization_budget(sk, target_cwnd);
+
+	/* If we're below target cwnd, slow start cwnd toward target cwnd. */
+	if (bbr_full_bw_reached(sk))  /* only cut cwnd if we filled the pipe */
+		cwnd = min(cwnd + acked, target_cwnd);
+	else if (cwnd < target_cwnd || tp->delivered < TCP_INIT_CWND)
+		cwnd = cwnd + acked;
+	cwnd = max(cwnd, bbr_cwnd_min_target);
+
+done:
+	tcp_snd_cwnd_set(tp, min(cwnd, tp->snd_cwnd_clamp));	/* apply global cap */
+	if (bbr->mode == BBR_PROBE_RTT)  /* drain queue, refresh min_rtt */
+		tcp_snd_cwnd_set(tp, min(tcp_snd_cwnd(tp),
+					 bbr_probe_rtt_cwnd(sk)));
+}
+
+/* Apply the loss/ECN bounds of the model to cwnd. While probing for bw we
+ * may go up to inflight_hi; otherwise we leave headroom below it.
+ */
+static void bbr_bound_cwnd_for_inflight_model(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 cap;
+
+	if (!bbr->has_seen_rtt)
+		return;
+
+	if (bbr->mode == BBR_PROBE_BW &&
+	    bbr->cycle_idx != BBR_BW_PROBE_CRUISE)
+		cap = bbr->inflight_hi;
+	else if (bbr->mode == BBR_PROBE_RTT || bbr->mode == BBR_PROBE_BW)
+		cap = bbr_inflight_with_headroom(sk);
+	else
+		cap = ~0U;
+	cap = min(cap, bbr->inflight_lo);
+	cap = max(cap, bbr_cwnd_min_target);
+	tcp_snd_cwnd_set(tp, min(cap, tcp_snd_cwnd(tp)));
+}
+
+/* Lift the short-term bounds; we are about to probe for more bandwidth. */
+static void bbr_reset_lower_bounds(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->bw_lo = ~0U;
+	bbr->inflight_lo = ~0U;
+}
+
+/* Start a new packet-timed round and its loss accounting. */
+static void bbr_start_round(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->next_rtt_delivered = tp->delivered;
+	bbr->round_lost = tp->lost;
+}
+
+static void bbr_reset_congestion_signals(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->loss_in_round = 0;
+	bbr->ecn_in_round = 0;
+	bbr->loss_events_in_round = 0;
+	bbr->round_lost = tcp_sk(sk)->lost;
+}
+
+/* Is the loss or CE mark rate high enough that we should consider the
+ * current inflight level to be above what the path can hold? The loss rate
+ * is the number of packets lost in this round relative to the inflight
+ * before this ACK.
+ */
+static bool bbr_is_inflight_too_high(const struct sock *sk,
+				     const struct rate_sample *rs)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct bbr *bbr = inet_csk_ca(sk);
+	u32 lost = tp->lost - bbr->round_lost;
+
+	if (lost && rs->prior_in_flight &&
+	    (u64)lost * BBR_UNIT > (u64)bbr_loss_thresh * rs->prior_in_flight)
+		return true;
+
+	if (rs->delivered_ce > 0 && rs->delivered > 0 && bbr_ecn_ok(sk) &&
+	    (u64)rs->delivered_ce * BBR_UNIT >
+	    (u64)bbr_ecn_thresh * rs->delivered)
+		return true;
+
+	return false;
+}
+
+/* Pick the time until the next bw probe, in usecs and in rounds. */
+static void bbr_pick_probe_wait(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	/* Decide the random round-trip bound for wait until probe: */
+	bbr->rounds_since_probe =
+		get_random_u32_below(bbr_bw_probe_rand_rounds);
+	/* Decide the random wall clock bound for wait until probe: */
+	bbr->probe_wait_us = bbr_bw_probe_base_us +
+			     get_random_u32_below(bbr_bw_probe_rand_us);
+}
+
+/* Forget the bw samples of the cycle before last. */
+static void bbr_advance_max_bw_filter(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (!bbr->bw_hi[1])
+		return;  /* no samples in this cycle; keep what we have */
+	bbr->bw_hi[0] = bbr->bw_hi[1];
+	bbr->bw_hi[1] = 0;
+}
+
+/* Grow inflight_hi faster the longer the probe lasts: 1, 2, 4, ... packets
+ * per round, limited to one increment per ACKed packet.
+ */
+static void bbr_raise_inflight_hi_slope(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 growth_this_round, cnt;
+
+	growth_this_round = 1U << bbr->bw_probe_up_rounds;
+	bbr->bw_probe_up_rounds = min(bbr->bw_probe_up_rounds + 1, 30);
+	cnt = tcp_snd_cwnd(tp) / growth_this_round;
+	cnt = max(cnt, 1U);
+	bbr->bw_probe_up_cnt = cnt;
+}
+
+/* In PROBE_UP, raise inflight_hi while cwnd-limited by it and no loss/ECN. */
+static void bbr_probe_inflight_hi_upward(struct sock *sk,
+					 const struct rate_sample *rs)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 delta;
+
+	if (!tp->is_cwnd_limited || tcp_snd_cwnd(tp) < bbr->inflight_hi)
+		return;  /* not fully using inflight_hi, so don't grow it */
+
+	/* For each bw_probe_up_cnt packets ACKed, increase inflight_hi by 1. */
+	bbr->bw_probe_up_acks += rs->acked_sacked;
+	if (bbr->bw_probe_up_acks >= bbr->bw_probe_up_cnt) {
+		delta = bbr->bw_probe_up_acks / bbr->bw_probe_up_cnt;
+		bbr->bw_probe_up_acks -= delta * bbr->bw_probe_up_cnt;
+		bbr->inflight_hi += delta;
+	}
+
+	if (bbr->round_start)
+		bbr_raise_inflight_hi_slope(sk);
+}
+
+/* A bw probe pushed the loss or ECN rate too high: remember the inflight
+ * that was too much, and stop probing.
+ */
+static void bbr_handle_inflight_too_high(struct sock *sk,
+					 const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 target;
+
+	bbr->prev_probe_too_high = 1;
+	bbr->bw_probe_samples = 0;  /* only react once per probe */
+	/* If we are app-limited then we are not robustly probing the max
+	 * volume of inflight data we think might be safe, so don't cut it.
+	 */
+	if (!rs->is_app_limited) {
+		target = ((u64)bbr_target_inflight(sk) *
+			  (BBR_UNIT - bbr_beta)) >> BBR_SCALE;
+		bbr->inflight_hi = max(rs->prior_in_flight, target);
+	}
+	if (bbr->mode == BBR_PROBE_BW && bbr->cycle_idx == BBR_BW_PROBE_UP)
+		bbr_start_bw_probe_down(sk);
+}
+
+static void bbr_start_bw_probe_up(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->ack_phase = BBR_ACKS_PROBE_STARTING;
+	bbr_start_round(sk);
+	bbr->cycle_mstamp = tp->tcp_mstamp;
+	bbr->cycle_idx = BBR_BW_PROBE_UP;
+	bbr_raise_inflight_hi_slope(sk);
+}
+
+/* Refill the pipe for a round at the estimated bw before probing up, so
+ * that the probe starts from a full pipe.
+ */
+static void bbr_start_bw_probe_refill(struct sock *sk, u32 bw_probe_up_rounds)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr_reset_lower_bounds(sk);
+	bbr->bw_probe_up_rounds = bw_probe_up_rounds;
+	bbr->bw_probe_up_acks = 0;
+	bbr->stopped_risky_probe = 0;
+	bbr->ack_phase = BBR_ACKS_REFILLING;
+	bbr_start_round(sk);
+	bbr->cycle_idx = BBR_BW_PROBE_REFILL;
+}
+
+static void bbr_start_bw_probe_down(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr_reset_congestion_signals(sk);
+	bbr->bw_probe_up_cnt = ~0U;	/* not growing inflight_hi any more */
+	bbr_pick_probe_wait(sk);
+	bbr->cycle_mstamp = tp->tcp_mstamp;	/* start wall clock */
+	bbr->ack_phase = BBR_ACKS_PROBE_STOPPING;
+	bbr_start_round(sk);
+	bbr->cycle_idx = BBR_BW_PROBE_DOWN;
+}
+
+static void bbr_start_bw_probe_cruise(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->inflight_lo != ~0U)
+		bbr->inflight_lo = min(bbr->inflight_lo, bbr->inflight_hi);
+	bbr->cycle_idx = BBR_BW_PROBE_CRUISE;
+}
+
+/* Adjust inflight_hi based on the loss/ECN signals of this ACK. Returns true
+ * if we decided on a state transition.
+ */
+static bool bbr_adapt_upper_bounds(struct sock *sk,
+				   const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->ack_phase == BBR_ACKS_PROBE_STOPPING && bbr->round_start) {
+		/* End of samples from bw probing phase. */
+		bbr->bw_probe_samples = 0;
+		bbr->ack_phase = BBR_ACKS_INIT;
+		/* Our current bw sample is our best recent chance at finding
+		 * the highest available bw, so now is the time to forget the
+		 * samples from the previous cycle.
+		 */
+		if (bbr->mode == BBR_PROBE_BW && !rs->is_app_limited)
+			bbr_advance_max_bw_filter(sk);
+		/* If we probed all the way up to inflight_hi without hitting
+		 * the loss/ECN limit, probe again right away, this time
+		 * accelerating beyond inflight_hi.
+		 */
+		if (bbr->mode == BBR_PROBE_BW &&
+		    bbr->stopped_risky_probe && !bbr->prev_probe_too_high) {
+			bbr_start_bw_probe_refill(sk, 0);
+			return true;
+		}
+	}
+
+	if (bbr_is_inflight_too_high(sk, rs)) {
+		if (bbr->bw_probe_samples)  /* sample is from bw probing? */
+			bbr_handle_inflight_too_high(sk, rs);
+	} else {
+		if (bbr->inflight_hi == ~0U)
+			return false;  /* no excess queue signals yet */
+
+		/* To be resilient to random loss, raise inflight_hi if we
+		 * observe in any phase that a higher level is safe.
+		 */
+		if (rs->prior_in_flight > bbr->inflight_hi)
+			bbr->inflight_hi = rs->prior_in_flight;
+
+		if (bbr->mode == BBR_PROBE_BW &&
+		    bbr->cycle_idx == BBR_BW_PROBE_UP)
+			bbr_probe_inflight_hi_upward(sk, rs);
+	}
+	return false;
+}
+
+/* Has the given amount of time elapsed since we entered the current phase? */
+static bool bbr_has_elapsed_in_phase(const struct sock *sk, u32 interval_us)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct bbr *bbr = inet_csk_ca(sk);
+
+	return tcp_stamp_us_delta(tp->tcp_mstamp,
+				  bbr->cycle_mstamp + interval_us) > 0;
+}
+
+/* A Reno flow would take about one round per packet of BDP to regain its
+ * cwnd after a loss; probe at least that often so we share fairly with it.
+ */
+static bool bbr_is_reno_coexistence_probe_time(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 rounds;
+
+	rounds = min(bbr_bw_probe_max_rounds, bbr_target_inflight(sk));
+	return bbr->rounds_since_probe >= rounds;
+}
+
+/* Is it time to probe for bw? If so, start refilling the pipe. */
+static bool bbr_check_time_to_probe_bw(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr_has_elapsed_in_phase(sk, bbr->probe_wait_us) ||
+	    bbr_is_reno_coexistence_probe_time(sk)) {
+		bbr_start_bw_probe_refill(sk, 0);
+		return true;
+	}
+	return false;
+}
+
+/* Is it time to transition from PROBE_DOWN to PROBE_CRUISE? */
+static bool bbr_check_time_to_cruise(struct sock *sk, u32 inflight, u32 bw)
+{
+	/* Always need to pull inflight down to leave headroom in queue. */
+	if (inflight > bbr_inflight_with_headroom(sk))
+		return false;
+
+	return inflight <= bbr_inflight(sk, bw, BBR_UNIT);
+}
+
+/* PROBE_BW state machine: cruise, refill, probe up, probe down. */
+static void bbr_update_cycle_phase(struct sock *sk,
+				   const struct rate_sample *rs)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	bool is_risky = false, is_queuing = false;
+	u32 inflight, bw;
+
+	if (!bbr_full_bw_reached(sk))
+		return;
+
+	/* In DRAIN, PROBE_BW, or PROBE_RTT, adjust upper bounds. */
+	if (bbr_adapt_upper_bounds(sk, rs))
+		return;		/* already decided state transition */
+
+	if (bbr->mode != BBR_PROBE_BW)
+		return;
+
+	inflight = bbr_packets_in_net_at_edt(sk, rs->prior_in_flight);
+	bw = bbr_max_bw(sk);
+
+	switch (bbr->cycle_idx) {
+	/* First we spend most of our time cruising with a pacing_gain of 1.0,
+	 * which paces at the estimated bw, to try to fully use the pipe
+	 * without building queue. If we encounter loss/ECN marks, we adapt
+	 * by slowing down.
+	 */
+	case BBR_BW_PROBE_CRUISE:
+		if (bbr_check_time_to_probe_bw(sk))
+			return;		/* already decided state transition */
+		break;
+
+	/* After cruising, when it's time to probe, we first "refill": we send
+	 * at the estimated bw to fill the pipe, before probing higher and
+	 * knowingly risking overflowing the bottleneck buffer (causing loss).
+	 */
+	case BBR_BW_PROBE_REFILL:
+		if (bbr->round_start) {
+			/* After one full round trip of sending in REFILL, we
+			 * start to see bw samples reflecting our REFILL, which
+			 * may be putting too much data in flight.
+			 */
+			bbr->bw_probe_samples = 1;
+			bbr_start_bw_probe_up(sk);
+		}
+		break;
+
+	/* After we refill the pipe, we probe by using a pacing_gain > 1.0, to
+	 * probe for bw. If we have not seen loss/ECN, we try to raise inflight
+	 * to at least pacing_gain*BDP; note that this may take more than
+	 * min_rtt if min_rtt is small (e.g. on a LAN).
+	 */
+	case BBR_BW_PROBE_UP:
+		if (bbr->prev_probe_too_high &&
+		    inflight >= bbr->inflight_hi) {
+			bbr->stopped_risky_probe = 1;
+			is_risky = true;
+		} else if (tcp_stamp_us_delta(tp->tcp_mstamp,
+					      bbr->cycle_mstamp) >
+			   bbr->min_rtt_us &&
+			   inflight >= bbr_inflight(sk, bw,
+						    bbr->pacing_gain)) {
+			is_queuing = true;
+		}
+		if (is_risky || is_queuing) {
+			bbr->prev_probe_too_high = 0;  /* no loss/ECN (yet) */
+			bbr_start_bw_probe_down(sk);  /* restart w/ down */
+		}
+		break;
+
+	/* After probing in PROBE_UP, we have usually accumulated some data in
+	 * the bottleneck buffer (if bw probing didn't find more bw). We next
+	 * enter PROBE_DOWN to try to drain any excess data from the queue. To
+	 * do this, we use a pacing_gain < 1.0. We hold this pacing gain until
+	 * our inflight is less than that target cruising point, which is the
+	 * minimum of (a) the amount needed to leave headroom, and (b) the
+	 * estimated BDP. Once inflight falls to match the target, we estimate
+	 * the queue is drained; persisting would underutilize the pipe.
+	 */
+	case BBR_BW_PROBE_DOWN:
+		if (bbr_check_time_to_probe_bw(sk))
+			return;		/* already decided state transition */
+		if (bbr_check_time_to_cruise(sk, inflight, bw))
+			bbr_start_bw_probe_cruise(sk);
+		break;
+	}
+}
+
+/* Cut the short-term bounds upon a round with loss or ECN marks, unless we
+ * are deliberately probing for bandwidth. bw and inflight are the delivery
+ * rate and volume of the latest rate sample, which roughly spans a round.
+ */
+static void bbr_adapt_lower_bounds(struct sock *sk, u32 bw, u32 inflight)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 reduction;
+
+	if (bbr_is_probing_bandwidth(sk))
+		return;
+
+	if (bbr->ecn_in_round && bbr_ecn_ok(sk)) {
+		if (bbr->inflight_lo == ~0U)
+			bbr->inflight_lo = tcp_snd_cwnd(tp);
+		reduction = (bbr->ecn_alpha * bbr_ecn_factor) >> BBR_SCALE;
+		bbr->inflight_lo = ((u64)bbr->inflight_lo *
+				    (BBR_UNIT - reduction)) >> BBR_SCALE;
+	}
+
+	if (bbr->loss_in_round) {
+		if (bbr->bw_lo == ~0U)
+			bbr->bw_lo = bbr_max_bw(sk);
+		if (bbr->inflight_lo == ~0U)
+			bbr->inflight_lo = tcp_snd_cwnd(tp);
+		bbr->bw_lo = max_t(u32, bw, ((u64)bbr->bw_lo *
+				   (BBR_UNIT - bbr_beta)) >> BBR_SCALE);
+		bbr->inflight_lo = max_t(u32, inflight,
+					 ((u64)bbr->inflight_lo *
+					  (BBR_UNIT - bbr_beta)) >> BBR_SCALE);
+	}
+}
+
+/* Update ecn_alpha, an EWMA of the fraction of packets that were CE marked. */
+static void bbr_update_ecn_alpha(struct sock *sk, const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 alpha, ce_ratio;
+
+	if (rs->delivered <= 0 || rs->delivered_ce < 0 || !bbr_ecn_ok(sk))
+		return;
+
+	ce_ratio = min_t(u32, BBR_UNIT,
+			 ((u64)rs->delivered_ce << BBR_SCALE) / rs->delivered);
+	alpha = ((BBR_UNIT - bbr_ecn_alpha_gain) * bbr->ecn_alpha) >> BBR_SCALE;
+	alpha += (bbr_ecn_alpha_gain * ce_ratio) >> BBR_SCALE;
+	bbr->ecn_alpha = min_t(u32, alpha, BBR_UNIT);
+}
+
+/* Exit STARTUP if a round saw several lossy ACKs and a loss or CE mark rate
+ * above the threshold, since the queue is then likely already full. The
+ * inflight we reached is a useful upper bound for the path.
+ */
+static void bbr_check_loss_too_high_in_startup(struct sock *sk,
+					       const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr_full_bw_reached(sk))
+		return;
+
+	if ((bbr->loss_events_in_round >= bbr_full_loss_cnt ||
+	     (bbr->ecn_in_round && bbr_ecn_ok(sk))) &&
+	    bbr_is_inflight_too_high(sk, rs)) {
+		bbr->inflight_hi = max(bbr_inflight(sk, bbr_max_bw(sk),
+						    BBR_UNIT),
+				       rs->prior_in_flight);
+		bbr->full_bw_reached = 1;
+	}
+}
+
+/* Accumulate the loss/ECN signals of this round, and react to them at the
+ * end of each round.
+ */
+static void bbr_update_congestion_signals(struct sock *sk,
+					  const struct rate_sample *rs,
+					  u32 bw)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (rs->losses > 0) {
+		bbr->loss_in_round = 1;
+		if (bbr->loss_events_in_round < 7)
+			bbr->loss_events_in_round++;
+	}
+	if (rs->delivered_ce > 0 && bbr_ecn_ok(sk))
+		bbr->ecn_in_round = 1;
+
+	if (!bbr->round_start)
+		return;		/* wait until end of round trip */
+
+	bbr_update_ecn_alpha(sk, rs);
+	bbr_check_loss_too_high_in_startup(sk, rs);
+	if (rs->delivered > 0)
+		bbr_adapt_lower_bounds(sk, bw, rs->delivered);
+
+	bbr_reset_congestion_signals(sk);
+}
+
+/* Estimate the bandwidth based on how fast packets are delivered. Returns the
+ * bw of this sample, or 0 if it is not valid.
+ */
+static u32 bbr_update_bw(struct sock *sk, const struct rate_sample *rs)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u64 bw;
+
+	bbr->round_start = 0;
+	if (rs->delivered < 0 || rs->interval_us <= 0)
+		return 0; /* Not a valid observation */
+
+	/* See if we've reached the next RTT */
+	if (!before(rs->prior_delivered, bbr->next_rtt_delivered)) {
+		bbr->next_rtt_delivered = tp->delivered;
+		bbr->round_start = 1;
+		bbr->packet_conservation = 0;
+		if (bbr->rounds_since_probe < 0xFF)
+			bbr->rounds_since_probe++;
+	}
+
+	/* Divide delivered by the interval to find a (lower bound) bottleneck
+	 * bandwidth sample.
+	 */
+	bw = div64_long((u64)rs->delivered * BW_UNIT, rs->interval_us);
+	bw = min_t(u64, bw, ~0U);
+
+	/* Filter out app-limited samples unless they describe the path bw at
+	 * least as well as our bw model; see tcp_bbr.c.
+	 */
+	if (!rs->is_app_limited || bw >= bbr_max_bw(sk))
+		bbr->bw_hi[1] = max_t(u32, bw, bbr->bw_hi[1]);
+
+	return bw;
+}
+
+/* Estimates the windowed max degree of ack aggregation, to provision extra
+ * in-flight data to keep sending during inter-ACK silences; see tcp_bbr.c.
+ */
+static void bbr_update_ack_aggregation(struct sock *sk,
+				       const struct rate_sample *rs)
+{
+	u32 epoch_us, expected_acked, extra_acked;
+	struct bbr *bbr = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (!bbr_extra_acked_gain || rs->acked_sacked <= 0 ||
+	    rs->delivered < 0 || rs->interval_us <= 0)
+		return;
+
+	if (bbr->round_start) {
+		bbr->extra_acked_win_rtts = min(0x1F,
+						bbr->extra_acked_win_rtts + 1);
+		if (bbr->extra_acked_win_rtts >= bbr_extra_acked_win_rtts) {
+			bbr->extra_acked_win_rtts = 0;
+			bbr->extra_acked_win_idx = bbr->extra_acked_win_idx ?
+						   0 : 1;
+			bbr->extra_acked[bbr->extra_acked_win_idx] = 0;
+		}
+	}
+
+	/* Compute how many packets we expected to be delivered over epoch. */
+	epoch_us = tcp_stamp_us_delta(tp->delivered_mstamp,
+				      bbr->ack_epoch_mstamp);
+	expected_acked = ((u64)bbr_bw(sk) * epoch_us) / BW_UNIT;
+
+	/* Reset the aggregation epoch if ACK rate is below expected rate or
+	 * significantly large no. of ack received since epoch (potentially
+	 * quite old epoch).
+	 */
+	if (bbr->ack_epoch_acked <= expected_acked ||
+	    (bbr->ack_epoch_acked + rs->acked_sacked >=
+	     bbr_ack_epoch_acked_reset_thresh)) {
+		bbr->ack_epoch_acked = 0;
+		bbr->ack_epoch_mstamp = tp->delivered_mstamp;
+		expected_acked = 0;
+	}
+
+	/* Compute excess data delivered, beyond what was expected. */
+	bbr->ack_epoch_acked = min_t(u32, 0xFFFFF,
+				     bbr->ack_epoch_acked + rs->acked_sacked);
+	extra_acked = bbr->ack_epoch_acked - expected_acked;
+	extra_acked = min(extra_acked, tcp_snd_cwnd(tp));
+	if (extra_acked > bbr->extra_acked[bbr->extra_acked_win_idx])
+		bbr->extra_acked[bbr->extra_acked_win_idx] = extra_acked;
+}
+
+/* Estimate when the pipe is full, using the change in delivery rate, as in
+ * BBR: the estimated bw hasn't grown by 25% after 3 non-app-limited rounds.
+ */
+static void bbr_check_full_bw_reached(struct sock *sk,
+				      const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 bw_thresh;
+
+	if (bbr_full_bw_reached(sk) || !bbr->round_start || rs->is_app_limited)
+		return;
+
+	bw_thresh = (u64)bbr->full_bw * bbr_full_bw_thresh >> BBR_SCALE;
+	if (bbr_max_bw(sk) >= bw_thresh) {
+		bbr->full_bw = bbr_max_bw(sk);
+		bbr->full_bw_cnt = 0;
+		return;
+	}
+	++bbr->full_bw_cnt;
+	bbr->full_bw_reached = bbr->full_bw_cnt >= bbr_full_bw_cnt;
+}
+
+/* If pipe is probably full, drain the queue and then enter steady-state. */
+static void bbr_check_drain(struct sock *sk, const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->mode == BBR_STARTUP && bbr_full_bw_reached(sk)) {
+		bbr->mode = BBR_DRAIN;	/* drain queue we created */
+		tcp_sk(sk)->snd_ssthresh =
+				bbr_inflight(sk, bbr_max_bw(sk), BBR_UNIT);
+		bbr_reset_congestion_signals(sk);
+	}	/* fall through to check if in-flight is already small: */
+	if (bbr->mode == BBR_DRAIN &&
+	    bbr_packets_in_net_at_edt(sk, tcp_packets_in_flight(tcp_sk(sk))) <=
+	    bbr_inflight(sk, bbr_max_bw(sk), BBR_UNIT)) {
+		bbr->mode = BBR_PROBE_BW;  /* we estimate queue is drained */
+		bbr_start_bw_probe_down(sk);
+	}
+}
+
+/* Leave PROBE_RTT: resume probing bw where we were, or STARTUP if we never
+ * filled the pipe.
+ */
+static void bbr_exit_probe_rtt(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr_reset_lower_bounds(sk);
+	if (bbr_full_bw_reached(sk)) {
+		bbr->mode = BBR_PROBE_BW;
+		/* Since we are exiting PROBE_RTT, we know inflight is below
+		 * our estimated BDP, so it is reasonable to cruise.
+		 */
+		bbr_start_bw_probe_down(sk);
+		bbr_start_bw_probe_cruise(sk);
+	} else {
+		bbr->mode = BBR_STARTUP;
+	}
+}
+
+static void bbr_check_probe_rtt_done(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (!(bbr->probe_rtt_done_stamp &&
+	      after(tcp_jiffies32, bbr->probe_rtt_done_stamp)))
+		return;
+
+	bbr->probe_rtt_min_stamp = tcp_jiffies32;  /* schedule next PROBE_RTT */
+	tcp_snd_cwnd_set(tp, max(tcp_snd_cwnd(tp), bbr->prior_cwnd));
+	bbr_exit_probe_rtt(sk);
+}
+
+/* Track the min RTT, and periodically enter PROBE_RTT to refresh it. BBRv3
+ * keeps a 5 second probe_rtt_min_us filter that is fed into the 10 second
+ * min_rtt filter, and enters PROBE_RTT when the former expires. In PROBE_RTT
+ * the cwnd is cut to half the BDP instead of 4 packets, which keeps most of
+ * the throughput while still draining the queue.
+ */
+static void bbr_update_min_rtt(struct sock *sk, const struct rate_sample *rs)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	bool probe_rtt_expired, min_rtt_expired;
+
+	/* Track min RTT in probe_rtt_win_ms time window: */
+	probe_rtt_expired = after(tcp_jiffies32,
+				  bbr->probe_rtt_min_stamp +
+				  msecs_to_jiffies(bbr_probe_rtt_win_ms));
+	if (rs->rtt_us >= 0 &&
+	    (rs->rtt_us < bbr->probe_rtt_min_us ||
+	     (probe_rtt_expired && !rs->is_ack_delayed))) {
+		bbr->probe_rtt_min_us = rs->rtt_us;
+		bbr->probe_rtt_min_stamp = tcp_jiffies32;
+	}
+	/* Track min RTT seen in the min_rtt_win_sec filter window: */
+	min_rtt_expired = after(tcp_jiffies32,
+				bbr->min_rtt_stamp + bbr_min_rtt_win_sec * HZ);
+	if (bbr->probe_rtt_min_us <= bbr->min_rtt_us || min_rtt_expired) {
+		bbr->min_rtt_us = bbr->probe_rtt_min_us;
+		bbr->min_rtt_stamp = bbr->probe_rtt_min_stamp;
+	}
+
+	if (bbr_probe_rtt_mode_ms > 0 && probe_rtt_expired &&
+	    !bbr->idle_restart && bbr->mode != BBR_PROBE_RTT) {
+		bbr->mode = BBR_PROBE_RTT;  /* dip, drain queue */
+		bbr_save_cwnd(sk);  /* note cwnd so we can restore it */
+		bbr->probe_rtt_done_stamp = 0;
+		bbr->ack_phase = BBR_ACKS_PROBE_STOPPING;
+		bbr_start_round(sk);
+	}
+
+	if (bbr->mode == BBR_PROBE_RTT) {
+		/* Ignore low rate samples during this mode. */
+		tp->app_limited =
+			(tp->delivered + tcp_packets_in_flight(tp)) ? : 1;
+		/* Maintain reduced inflight for max(200 ms, 1 round). */
+		if (!bbr->probe_rtt_done_stamp &&
+		    tcp_packets_in_flight(tp) <= bbr_probe_rtt_cwnd(sk)) {
+			bbr->probe_rtt_done_stamp = tcp_jiffies32 +
+				msecs_to_jiffies(bbr_probe_rtt_mode_ms);
+			bbr->probe_rtt_round_done = 0;
+			bbr_start_round(sk);
+		} else if (bbr->probe_rtt_done_stamp) {
+			if (bbr->round_start)
+				bbr->probe_rtt_round_done = 1;
+			if (bbr->probe_rtt_round_done)
+				bbr_check_probe_rtt_done(sk);
+		}
+	}
+	/* Restart after idle ends only once we process a new S/ACK for data */
+	if (rs->delivered > 0)
+		bbr->idle_restart = 0;
+}
+
+static void bbr_update_gains(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	switch (bbr->mode) {
+	case BBR_STARTUP:
+		bbr->pacing_gain = bbr_startup_pacing_gain;
+		bbr->cwnd_gain	 = bbr_startup_cwnd_gain;
+		break;
+	case BBR_DRAIN:
+		bbr->pacing_gain = bbr_drain_gain;	/* slow, to drain */
+		bbr->cwnd_gain	 = bbr_startup_cwnd_gain;  /* keep cwnd */
+		break;
+	case BBR_PROBE_BW:
+		bbr->pacing_gain = bbr_pacing_gain[bbr->cycle_idx];
+		bbr->cwnd_gain	 = bbr_cwnd_gain;
+		if (bbr->cycle_idx == BBR_BW_PROBE_UP)
+			bbr->cwnd_gain += bbr_bw_probe_cwnd_gain;
+		break;
+	case BBR_PROBE_RTT:
+		bbr->pacing_gain = BBR_UNIT;
+		bbr->cwnd_gain	 = BBR_UNIT;
+		break;
+	default:
+		WARN_ONCE(1, "BBR bad mode: %u\n", bbr->mode);
+		break;
+	}
+}
+
+static void bbr_update_model(struct sock *sk, const struct rate_sample *rs)
+{
+	u32 bw;
+
+	bw = bbr_update_bw(sk, rs);
+	bbr_update_congestion_signals(sk, rs, bw);
+	bbr_update_ack_aggregation(sk, rs);
+	bbr_check_full_bw_reached(sk, rs);
+	bbr_check_drain(sk, rs);
+	bbr_update_cycle_phase(sk, rs);
+	bbr_update_min_rtt(sk, rs);
+	bbr_update_gains(sk);
+}
+
+static void bbr_main(struct sock *sk, const struct rate_sample *rs)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 bw;
+
+	bbr_update_model(sk, rs);
+
+	bw = bbr_bw(sk);
+	bbr_set_pacing_rate(sk, bw, bbr->pacing_gain);
+	bbr_set_cwnd(sk, rs, rs->acked_sacked, bw, bbr->cwnd_gain);
+	bbr_bound_cwnd_for_inflight_model(sk);
+}
+
+static void bbr_init(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->prior_cwnd = 0;
+	tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+	bbr->prev_ca_state = TCP_CA_Open;
+	bbr->packet_conservation = 0;
+
+	bbr->probe_rtt_done_stamp = 0;
+	bbr->probe_rtt_round_done = 0;
+	bbr->probe_rtt_min_us = tcp_min_rtt(tp);
+	bbr->probe_rtt_min_stamp = tcp_jiffies32;
+	bbr->min_rtt_us = tcp_min_rtt(tp);
+	bbr->min_rtt_stamp = tcp_jiffies32;
+
+	bbr->bw_hi[0] = 0;
+	bbr->bw_hi[1] = 0;
+	bbr->inflight_hi = ~0U;
+	bbr_reset_lower_bounds(sk);
+
+	bbr->has_seen_rtt = 0;
+	bbr_init_pacing_rate_from_rtt(sk);
+
+	bbr->round_start = 0;
+	bbr_start_round(sk);
+	bbr_reset_congestion_signals(sk);
+	bbr->idle_restart = 0;
+	bbr->full_bw_reached = 0;
+	bbr->full_bw = 0;
+	bbr->full_bw_cnt = 0;
+	bbr->cycle_mstamp = 0;
+	bbr->cycle_idx = BBR_BW_PROBE_CRUISE;
+	bbr->ack_phase = BBR_ACKS_INIT;
+	bbr->bw_probe_samples = 0;
+	bbr->prev_probe_too_high = 0;
+	bbr->stopped_risky_probe = 0;
+	bbr->bw_probe_up_rounds = 0;
+	bbr->bw_probe_up_acks = 0;
+	bbr->bw_probe_up_cnt = ~0U;
+	bbr_pick_probe_wait(sk);
+	bbr->ecn_alpha = bbr_ecn_alpha_init;
+	bbr->mode = BBR_STARTUP;
+
+	bbr->ack_epoch_mstamp = tp->tcp_mstamp;
+	bbr->ack_epoch_acked = 0;
+	bbr->extra_acked_win_rtts = 0;
+	bbr->extra_acked_win_idx = 0;
+	bbr->extra_acked[0] = 0;
+	bbr->extra_acked[1] = 0;
+
+	cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
+}
+
+static u32 bbr_sndbuf_expand(struct sock *sk)
+{
+	/* Provision 3 * cwnd since BBR may slow-start even during recovery. */
+	return 3;
+}
+
+/* The loss that reduced our bounds turned out to be spurious; reset full
+ * pipe detection and lift the short-term bounds, which are re-learned within
+ * a round if the congestion was real.
+ */
+static u32 bbr_undo_cwnd(struct sock *sk)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->full_bw = 0;   /* spurious slow-down; reset full pipe detection */
+	bbr->full_bw_cnt = 0;
+	bbr->loss_in_round = 0;
+	bbr_reset_lower_bounds(sk);
+	return tcp_snd_cwnd(tcp_sk(sk));
+}
+
+/* Entering loss recovery, so save cwnd for when we exit or undo recovery. */
+static u32 bbr_ssthresh(struct sock *sk)
+{
+	bbr_save_cwnd(sk);
+	return tcp_sk(sk)->snd_ssthresh;
+}
+
+static size_t bbr_get_info(struct sock *sk, u32 ext, int *attr,
+			   union tcp_cc_info *info)
+{
+	if (ext & (1 << (INET_DIAG_BBRINFO - 1)) ||
+	    ext & (1 << (INET_DIAG_VEGASINFO - 1))) {
+		struct tcp_sock *tp = tcp_sk(sk);
+		struct bbr *bbr = inet_csk_ca(sk);
+		u64 bw = bbr_bw(sk);
+
+		bw = bw * tp->mss_cache * USEC_PER_SEC >> BW_SCALE;
+		memset(&info->bbr, 0, sizeof(info->bbr));
+		info->bbr.bbr_bw_lo		= (u32)bw;
+		info->bbr.bbr_bw_hi		= (u32)(bw >> 32);
+		info->bbr.bbr_min_rtt		= bbr->min_rtt_us;
+		info->bbr.bbr_pacing_gain	= bbr->pacing_gain;
+		info->bbr.bbr_cwnd_gain		= bbr->cwnd_gain;
+		*attr = INET_DIAG_BBRINFO;
+		return sizeof(info->bbr);
+	}
+	return 0;
+}
+
+static void bbr_set_state(struct sock *sk, u8 new_state)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (new_state == TCP_CA_Loss) {
+		bbr->prev_ca_state = TCP_CA_Loss;
+		bbr->full_bw = 0;
+		/* An RTO is a strong loss signal: treat it like the end of a
+		 * round with loss, using the cwnd we had before the RTO.
+		 */
+		if (!bbr_is_probing_bandwidth(sk) && bbr->inflight_lo == ~0U)
+			bbr->inflight_lo = max(tcp_snd_cwnd(tp), bbr->prior_cwnd);
+		bbr->round_start = 1;
+		bbr->loss_in_round = 1;
+		bbr_adapt_lower_bounds(sk, 0, 0);
+		bbr_reset_congestion_signals(sk);
+	}
+}
+
+static struct tcp_congestion_ops tcp_bbr3_cong_ops __read_mostly = {
+	.flags		= TCP_CONG_NON_RESTRICTED,
+	.name		= "bbr3",
+	.owner		= THIS_MODULE,
+	.init		= bbr_init,
+	.cong_control	= bbr_main,
+	.sndbuf_expand	= bbr_sndbuf_expand,
+	.undo_cwnd	= bbr_undo_cwnd,
+	.cwnd_event	= bbr_cwnd_event,
+	.ssthresh	= bbr_ssthresh,
+	.min_tso_segs	= bbr_min_tso_segs,
+	.get_info	= bbr_get_info,
+	.set_state	= bbr_set_state,
+};
+
+static int __init bbr_register(void)
+{
+	BUILD_BUG_ON(sizeof(struct bbr) > ICSK_CA_PRIV_SIZE);
+	return tcp_register_congestion_control(&tcp_bbr3_cong_ops);
+}
+
+static void __exit bbr_unregister(void)
+{
+	tcp_unregister_congestion_control(&tcp_bbr3_cong_ops);
+}
+
+module_init(bbr_register);
+module_exit(bbr_unregister);
+
+MODULE_AUTHOR("Van Jacobson <vanj@google.com>");
+MODULE_AUTHOR("Neal Cardwell <ncardwell@google.com>");
+MODULE_AUTHOR("Yuchung Cheng <ycheng@google.com>");
+MODULE_AUTHOR("Soheil Hassas Yeganeh <soheil@google.com>");
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("TCP BBRv3 (Bottleneck Bandwidth and RTT, with loss and ECN bounds)");
@@ -883,6 +883,27 @@ void udp_set_csum(bool nocheck, struct sk_buff *skb,
 }
 EXPORT_SYMBOL(udp_set_csum);
 
+/* Send a GSO packet as segments with spaced departure times. */
+static int udp_send_skb_txtime(struct net *net, struct sk_buff *skb, u32 delta)
+{
+	struct sk_buff *segs, *seg, *next;
+	int err = 0, ret;
+
+	segs = udp_gso_segment_txtime(skb, htons(ETH_P_IP), delta);
+	if (IS_ERR(segs)) {
+		kfree_skb(skb);
+		return PTR_ERR(segs);
+	}
+
+	skb_list_walk_safe(segs, seg, next) {
+		skb_mark_not_on_list(seg);
+		ret = ip_send_skb(net, seg);
+		if (ret && !err)
+			err = ret;
+	}
+	return err;
+}
+
 static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4,
 			struct inet_cork *cork)
 {
@@ -960,7 +981,11 @@ static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4,
 		uh->check = CSUM_MANGLED_0;
 
 send:
-	err = ip_send_skb(sock_net(sk), skb);
+	if (skb_is_gso(skb) && cork->gso_txtime_delta && skb->tstamp)
+		err = udp_send_skb_txtime(sock_net(sk), skb,
+					  cork->gso_txtime_delta);
+	else
+		err = ip_send_skb(sock_net(sk), skb);
 	if (err) {
 		if (err == -ENOBUFS &&
 		    !inet_test_bit(RECVERR, sk)) {
@@ -998,7 +1023,8 @@ int udp_push_pending_frames(struct sock *sk)
 }
 EXPORT_SYMBOL(udp_push_pending_frames);
 
-static int __udp_cmsg_send(struct cmsghdr *cmsg, u16 *gso_size)
+static int __udp_cmsg_send(struct cmsghdr *cmsg, u16 *gso_size,
+			   u32 *gso_txtime_delta)
 {
 	switch (cmsg->cmsg_type) {
 	case UDP_SEGMENT:
@@ -1006,12 +1032,18 @@ static int __udp_cmsg_send(struct cmsghdr *cmsg, u16 *gso_size)
 			return -EINVAL;
 		*gso_size = *(__u16 *)CMSG_DATA(cmsg);
 		return 0;
+	case UDP_SEGMENT_TXTIME:
+		if (cmsg->cmsg_len != CMSG_LEN(sizeof(__u32)))
+			return -EINVAL;
+		*gso_txtime_delta = *(__u32 *)CMSG_DATA(cmsg);
+		return 0;
 	default:
 		return -EINVAL;
 	}
 }
 
-int udp_cmsg_send(struct sock *sk, struct msghdr *msg, u16 *gso_size)
+int udp_cmsg_send(struct sock *sk, struct msghdr *msg, u16 *gso_size,
+		  u32 *gso_txtime_delta)
 {
 	struct cmsghdr *cmsg;
 	bool need_ip = false;
@@ -1026,7 +1058,7 @@ int udp_cmsg_send(struct sock *sk, struct msghdr *msg, u16 *gso_size)
 			continue;
 		}
 
-		err = __udp_cmsg_send(cmsg, gso_size);
+		err = __udp_cmsg_send(cmsg, gso_size, gso_txtime_delta);
 		if (err)
 			return err;
 	}
@@ -1114,9 +1146,11 @@ int udp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 
 	ipcm_init_sk(&ipc, inet);
 	ipc.gso_size = READ_ONCE(up->gso_size);
+	ipc.gso_txtime_delta = READ_ONCE(up->gso_txtime_delta);
 
 	if (msg->msg_controllen) {
-		err = udp_cmsg_send(sk, msg, &ipc.gso_size);
+		err = udp_cmsg_send(sk, msg, &ipc.gso_size,
+				    &ipc.gso_txtime_delta);
 		if (err > 0)
 			err = ip_cmsg_send(sk, msg, &ipc,
 					   sk->sk_family == AF_INET6);
@@ -2707,6 +2741,12 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		WRITE_ONCE(up->gso_size, val);
 		break;
 
+	case UDP_SEGMENT_TXTIME:
+		if (val < 0)
+			return -EINVAL;
+		WRITE_ONCE(up->gso_txtime_delta, val);
+		break;
+
 	case UDP_GRO:
 		lock_sock(sk);
 
@@ -2802,6 +2842,10 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = READ_ONCE(up->gso_size);
 		break;
 
+	case UDP_SEGMENT_TXTIME:
+		val = READ_ONCE(up->gso_txtime_delta);
+		break;
+
 	case UDP_GRO:
 		val = up->gro_enabled;
 		break;
@@ -373,6 +373,42 @@ struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
 }
 EXPORT_SYMBOL_GPL(__udp_gso_segment);
 
+/**
+ * udp_gso_segment_txtime - segment a UDP GSO packet with paced departures
+ * @gso_skb: UDP GSO packet built by the local stack, with network header
+ * @protocol: ETH_P_IP or ETH_P_IPV6, in network byte order
+ * @delta: gap between the departure times of consecutive segments, in ns
+ *
+ * Segments @gso_skb before it is handed to the qdisc layer and gives the
+ * n-th segment a departure time of gso_skb->tstamp + n * @delta, so that an
+ * EDT qdisc such as fq, or a NIC with launch time offload, paces segments
+ * instead of sending the whole burst at line rate. Checksum offload is kept;
+ * validate_xmit_skb() falls back to software if the device lacks it.
+ *
+ * Consumes @gso_skb on success, and returns the list of segments.
+ */
+struct sk_buff *udp_gso_segment_txtime(struct sk_buff *gso_skb,
+				       __be16 protocol, u32 delta)
+{
+	struct sk_buff *segs, *seg;
+	u64 tstamp = gso_skb->tstamp;
+
+	gso_skb->protocol = protocol;
+	segs = skb_gso_segment(gso_skb, NETIF_F_HW_CSUM);
+	if (IS_ERR(segs))
+		return segs;
+	if (!segs)
+		return gso_skb;
+
+	for (seg = segs; seg; seg = seg->next) {
+		seg->tstamp = tstamp;
+		tstamp += delta;
+	}
+	consume_skb(gso_skb);
+	return segs;
+}
+EXPORT_SYMBOL_GPL(udp_gso_segment_txtime);
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -1447,6 +1447,7 @@ static int ip6_setup_cork(struct sock *sk, struct inet_cork_full *cork,
 	}
 	cork->base.fragsize = mtu;
 	cork->base.gso_size = ipc6->gso_size;
+	cork->base.gso_txtime_delta = ipc6->gso_txtime_delta;
 	cork->base.tx_flags = 0;
 	cork->base.mark = ipc6->sockc.mark;
 	sock_tx_timestamp(sk, ipc6->sockc.tsflags, &cork->base.tx_flags);
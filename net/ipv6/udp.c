@@ -1208,6 +1208,27 @@ static void udp6_hwcsum_outgoing(struct sock *sk, struct sk_buff *skb,
  *	Sending
  */
 
+/* Send a GSO packet as segments with spaced departure times. */
+static int udp_v6_send_skb_txtime(struct sk_buff *skb, u32 delta)
+{
+	struct sk_buff *segs, *seg, *next;
+	int err = 0, ret;
+
+	segs = udp_gso_segment_txtime(skb, htons(ETH_P_IPV6), delta);
+	if (IS_ERR(segs)) {
+		kfree_skb(skb);
+		return PTR_ERR(segs);
+	}
+
+	skb_list_walk_safe(segs, seg, next) {
+		skb_mark_not_on_list(seg);
+		ret = ip6_send_skb(seg);
+		if (ret && !err)
+			err = ret;
+	}
+	return err;
+}
+
 static int udp_v6_send_skb(struct sk_buff *skb, struct flowi6 *fl6,
 			   struct inet_cork *cork)
 {
@@ -1279,7 +1300,10 @@ static int udp_v6_send_skb(struct sk_buff *skb, struct flowi6 *fl6,
 		uh->check = CSUM_MANGLED_0;
 
 send:
-	err = ip6_send_skb(skb);
+	if (skb_is_gso(skb) && cork->gso_txtime_delta && skb->tstamp)
+		err = udp_v6_send_skb_txtime(skb, cork->gso_txtime_delta);
+	else
+		err = ip6_send_skb(skb);
 	if (err) {
 		if (err == -ENOBUFS && !inet6_sk(sk)->recverr) {
 			UDP6_INC_STATS(sock_net(sk),
@@ -1339,6 +1363,7 @@ int udpv6_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 
 	ipcm6_init(&ipc6);
 	ipc6.gso_size = READ_ONCE(up->gso_size);
+	ipc6.gso_txtime_delta = READ_ONCE(up->gso_txtime_delta);
 	ipc6.sockc.tsflags = READ_ONCE(sk->sk_tsflags);
 	ipc6.sockc.mark = READ_ONCE(sk->sk_mark);
 
@@ -1472,7 +1497,8 @@ int udpv6_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 		opt->tot_len = sizeof(*opt);
 		ipc6.opt = opt;
 
-		err = udp_cmsg_send(sk, msg, &ipc6.gso_size);
+		err = udp_cmsg_send(sk, msg, &ipc6.gso_size,
+				    &ipc6.gso_txtime_delta);
 		if (err > 0)
 			err = ip6_datagram_send_ctl(sock_net(sk), sk, msg, fl6,
 						    &ipc6);
@@ -153,6 +153,7 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	bool unaligned_chunks = mr->flags & XDP_UMEM_UNALIGNED_CHUNK_FLAG;
 	u32 chunk_size = mr->chunk_size, headroom = mr->headroom;
 	u64 addr = mr->addr, size = mr->len;
+	u32 tx_metadata_len = 0;
 	u32 chunks_rem, npgs_rem;
 	u64 chunks, npgs;
 	int err;
@@ -167,9 +168,16 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 		return -EINVAL;
 	}
 
-	if (mr->flags & ~XDP_UMEM_UNALIGNED_CHUNK_FLAG)
+	if (mr->flags & ~(XDP_UMEM_UNALIGNED_CHUNK_FLAG | XDP_UMEM_TX_SW_CSUM |
+			  XDP_UMEM_TX_METADATA_LEN))
 		return -EINVAL;
 
+	if (mr->flags & XDP_UMEM_TX_METADATA_LEN) {
+		tx_metadata_len = mr->tx_metadata_len;
+		if (tx_metadata_len >= 256 || tx_metadata_len % 8)
+			return -EINVAL;
+	}
+
 	if (!unaligned_chunks && !is_power_of_2(chunk_size))
 		return -EINVAL;
 
@@ -207,6 +215,7 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	umem->pgs = NULL;
 	umem->user = NULL;
 	umem->flags = mr->flags;
+	umem->tx_metadata_len = tx_metadata_len;
 
 	INIT_LIST_HEAD(&umem->xsk_dma_list);
 	refcount_set(&umem->users, 1);
@@ -624,11 +624,52 @@ static struct sk_buff *xsk_build_skb_zerocopy(struct xdp_sock *xs,
 	return skb;
 }
 
+/*
+ * Apply the TX metadata of the first frame of a packet to its skb, which is
+ * what drivers without AF_XDP metadata hooks see in copy mode.
+ */
+static int xsk_skb_metadata(struct sk_buff *skb, struct xdp_desc *desc,
+			    struct xsk_buff_pool *pool)
+{
+	struct xsk_tx_metadata *meta;
+
+	if (unlikely(!pool->tx_metadata_len))
+		return -EINVAL;
+
+	meta = xsk_buff_raw_get_data(pool, desc->addr) - pool->tx_metadata_len;
+	if (unlikely(!xsk_buff_valid_tx_metadata(meta)))
+		return -EINVAL;
+
+	if (meta->flags & XDP_TXMD_FLAGS_CHECKSUM) {
+		if (unlikely(meta->request.csum_start +
+			     meta->request.csum_offset +
+			     sizeof(__sum16) > desc->len))
+			return -EINVAL;
+
+		skb->csum_start = skb_headroom(skb) + meta->request.csum_start;
+		skb->csum_offset = meta->request.csum_offset;
+		skb->ip_summed = CHECKSUM_PARTIAL;
+
+		if (unlikely(pool->tx_sw_csum)) {
+			int err = skb_checksum_help(skb);
+
+			if (err)
+				return err;
+		}
+	}
+
+	if (meta->flags & XDP_TXMD_FLAGS_LAUNCH_TIME)
+		skb->skb_mstamp_ns = meta->request.launch_time;
+
+	return 0;
+}
+
 static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 				     struct xdp_desc *desc)
 {
 	struct net_device *dev = xs->dev;
 	struct sk_buff *skb = xs->skb;
+	bool first_frag = !skb;
 	int err;
 
 	if (dev->priv_flags & IFF_TX_SKB_NO_LINEAR) {
@@ -683,6 +724,15 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 		}
 	}
 
+	if (first_frag && desc->options & XDP_TX_METADATA) {
+		err = xsk_skb_metadata(skb, desc, xs->pool);
+		if (unlikely(err)) {
+			kfree_skb(skb);
+			err = -EINVAL;
+			goto free_err;
+		}
+	}
+
 	skb->dev = dev;
 	skb->priority = xs->sk.sk_priority;
 	skb->mark = READ_ONCE(xs->sk.sk_mark);
@@ -697,6 +747,11 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 		xsk_set_destructor_arg(xs->skb);
 		xsk_drop_skb(xs->skb);
 		xskq_cons_release(xs->tx);
+	} else if (err == -EINVAL) {
+		/* Bad metadata, drop the first frame like an invalid desc */
+		xsk_cq_cancel_locked(xs, 1);
+		xs->tx->invalid_descs++;
+		xskq_cons_release(xs->tx);
 	} else {
 		/* Let application retry */
 		xsk_cq_cancel_locked(xs, 1);
@@ -742,7 +797,7 @@ static int __xsk_generic_xmit(struct sock *sk)
 		skb = xsk_build_skb(xs, &desc);
 		if (IS_ERR(skb)) {
 			err = PTR_ERR(skb);
-			if (err != -EOVERFLOW)
+			if (err != -EOVERFLOW && err != -EINVAL)
 				goto out;
 			err = 0;
 			continue;
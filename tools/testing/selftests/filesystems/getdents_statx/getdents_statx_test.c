@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * getdents_statx(): directory entries along with the statx() attributes of
+ * each entry.
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/stat.h>
+
+#include "../../kselftest_harness.h"
+
+#define BUF_SIZE	65536
+
+static int sys_getdents_statx(int fd, void *dirent, unsigned int count,
+			      unsigned int flags, unsigned int mask)
+{
+#ifdef __NR_getdents_statx
+	return syscall(__NR_getdents_statx, fd, dirent, count, flags, mask);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+FIXTURE(getdents_statx) {
+	char dir[64];
+	int dfd;
+	char *buf;
+};
+
+FIXTURE_SETUP(getdents_statx)
+{
+	int fd;
+
+	self->dfd = -1;
+	self->buf = NULL;
+
+	/* bad flags tell whether the system call exists at all */
+	if (sys_getdents_statx(-1, NULL, 0, ~0U, 0) < 0 && errno == ENOSYS)
+		SKIP(return, "getdents_statx() not supported");
+
+	strcpy(self->dir, "/tmp/getdents_statx.XXXXXX");
+	ASSERT_NE(mkdtemp(self->dir), NULL);
+	self->dfd = open(self->dir, O_RDONLY | O_DIRECTORY);
+	ASSERT_GE(self->dfd, 0);
+
+	fd = openat(self->dfd, "file", O_WRONLY | O_CREAT, 0644);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(write(fd, "getdents_statx", 14), 14);
+	close(fd);
+	ASSERT_EQ(mkdirat(self->dfd, "dir", 0755), 0);
+	ASSERT_EQ(symlinkat("file", self->dfd, "link"), 0);
+
+	self->buf = malloc(BUF_SIZE);
+	ASSERT_NE(self->buf, NULL);
+}
+
+FIXTURE_TEARDOWN(getdents_statx)
+{
+	if (self->dfd >= 0) {
+		unlinkat(self->dfd, "link", 0);
+		unlinkat(self->dfd, "dir", AT_REMOVEDIR);
+		unlinkat(self->dfd, "file", 0);
+		close(self->dfd);
+		rmdir(self->dir);
+	}
+	free(self->buf);
+}
+
+static int expected_type(const char *name)
+{
+	if (!strcmp(name, "file"))
+		return DT_REG;
+	if (!strcmp(name, "link"))
+		return DT_LNK;
+	return DT_DIR;
+}
+
+/*
+ * Check one record against statx() of the same entry, returns the bit of
+ * the entry in the set of names seen.
+ */
+static int check_dirent(struct __test_metadata *_metadata, int dfd,
+			struct statx_dirent *d)
+{
+	static const char * const names[] = { ".", "..", "file", "dir", "link" };
+	struct statx stx;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(names); i++)
+		if (!strcmp(d->d_name, names[i]))
+			break;
+	EXPECT_LT(i, ARRAY_SIZE(names))
+		TH_LOG("unexpected entry %s", d->d_name);
+	if (i == ARRAY_SIZE(names))
+		return 0;
+
+	EXPECT_EQ(d->d_reclen % 8, 0);
+	if (d->d_type != DT_UNKNOWN)
+		EXPECT_EQ(d->d_type, expected_type(d->d_name));
+
+	/* the parent may be on another mount, it is never filled in */
+	if (!strcmp(d->d_name, "..")) {
+		EXPECT_EQ(d->d_stx.stx_mask, 0);
+		return 1 << i;
+	}
+
+	ASSERT_EQ(statx(dfd, d->d_name, AT_SYMLINK_NOFOLLOW,
+			STATX_BASIC_STATS, &stx), 0);
+	EXPECT_EQ(d->d_stx.stx_mask & STATX_BASIC_STATS,
+		  stx.stx_mask & STATX_BASIC_STATS);
+	EXPECT_EQ(d->d_ino, stx.stx_ino);
+	EXPECT_EQ(d->d_stx.stx_ino, stx.stx_ino);
+	EXPECT_EQ(d->d_stx.stx_mode, stx.stx_mode);
+	EXPECT_EQ(d->d_stx.stx_nlink, stx.stx_nlink);
+	EXPECT_EQ(d->d_stx.stx_uid, stx.stx_uid);
+	EXPECT_EQ(d->d_stx.stx_size, stx.stx_size);
+	return 1 << i;
+}
+
+/* Read the whole directory @count bytes at a time, returns the names seen */
+static int read_dir(struct __test_metadata *_metadata,
+		    FIXTURE_DATA(getdents_statx) *self, unsigned int count,
+		    int *max_per_call)
+{
+	struct statx_dirent *d;
+	int seen = 0, nr, pos, ret;
+
+	*max_per_call = 0;
+	while ((ret = sys_getdents_statx(self->dfd, self->buf, count, 0,
+					 STATX_BASIC_STATS)) > 0) {
+		for (pos = 0, nr = 0; pos < ret; pos += d->d_reclen, nr++) {
+			d = (void *)(self->buf + pos);
+			seen |= check_dirent(_metadata, self->dfd, d);
+		}
+		EXPECT_EQ(pos, ret);
+		if (nr > *max_per_call)
+			*max_per_call = nr;
+	}
+	EXPECT_EQ(ret, 0);
+	return seen;
+}
+
+TEST_F(getdents_statx, read)
+{
+	int max;
+
+	EXPECT_EQ(read_dir(_metadata, self, BUF_SIZE, &max), 0x1f);
+	EXPECT_EQ(max, 5);
+	/* at the end of the directory */
+	EXPECT_EQ(sys_getdents_statx(self->dfd, self->buf, BUF_SIZE, 0,
+				     STATX_BASIC_STATS), 0);
+
+	/* and from the start again */
+	ASSERT_EQ(lseek(self->dfd, 0, SEEK_SET), 0);
+	EXPECT_EQ(read_dir(_metadata, self, BUF_SIZE, &max), 0x1f);
+}
+
+TEST_F(getdents_statx, one_at_a_time)
+{
+	int max;
+
+	/* room for exactly one record with a short name */
+	EXPECT_EQ(read_dir(_metadata, self, sizeof(struct statx_dirent) + 8,
+			   &max), 0x1f);
+	EXPECT_EQ(max, 1);
+}
+
+TEST_F(getdents_statx, errors)
+{
+	int fd;
+
+	EXPECT_EQ(sys_getdents_statx(self->dfd, self->buf, BUF_SIZE, 0x1,
+				     STATX_BASIC_STATS), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(sys_getdents_statx(self->dfd, self->buf, BUF_SIZE,
+				     AT_STATX_FORCE_SYNC | AT_STATX_DONT_SYNC,
+				     STATX_BASIC_STATS), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(sys_getdents_statx(self->dfd, self->buf, BUF_SIZE, 0,
+				     STATX__RESERVED), -1);
+	EXPECT_EQ(errno, EINVAL);
+
+	/* too small for any record */
+	EXPECT_EQ(sys_getdents_statx(self->dfd, self->buf, 8, 0,
+				     STATX_BASIC_STATS), -1);
+	EXPECT_EQ(errno, EINVAL);
+
+	EXPECT_EQ(sys_getdents_statx(-1, self->buf, BUF_SIZE, 0,
+				     STATX_BASIC_STATS), -1);
+	EXPECT_EQ(errno, EBADF);
+	EXPECT_EQ(sys_getdents_statx(self->dfd, (void *)1, BUF_SIZE, 0,
+				     STATX_BASIC_STATS), -1);
+	EXPECT_EQ(errno, EFAULT);
+
+	fd = openat(self->dfd, "file", O_RDONLY);
+	ASSERT_GE(fd, 0);
+	EXPECT_EQ(sys_getdents_statx(fd, self->buf, BUF_SIZE, 0,
+				     STATX_BASIC_STATS), -1);
+	EXPECT_EQ(errno, ENOTDIR);
+	close(fd);
+}
+
+TEST_HARNESS_MAIN
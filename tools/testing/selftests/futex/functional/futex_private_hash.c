@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * PR_FUTEX_HASH: a process private hash for the private futexes of a
+ * process, set up while the process is still single threaded.
+ */
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "kselftest_harness.h"
+
+#ifndef PR_FUTEX_HASH
+#define PR_FUTEX_HASH			78
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+#endif
+
+static int hash_set(unsigned long slots)
+{
+	return prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, slots, 0, 0);
+}
+
+static int hash_get(void)
+{
+	return prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 0, 0, 0);
+}
+
+static int futex(uint32_t *uaddr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+/* Wait on @uaddr, which stays 0, until woken */
+static int wait_one(uint32_t *uaddr, int op)
+{
+	int ret;
+
+	do {
+		ret = futex(uaddr, op, 0);
+	} while (ret && errno == EINTR);
+	return ret;
+}
+
+/* Wake @uaddr until a waiter was queued and woken */
+static int wake_one(uint32_t *uaddr, int op)
+{
+	int i, ret;
+
+	for (i = 0; i < 1000; i++) {
+		ret = futex(uaddr, op, 1);
+		if (ret)
+			return ret;
+		usleep(1000);
+	}
+	return 0;
+}
+
+FIXTURE(futex_hash) {
+	uint32_t futex;
+};
+
+FIXTURE_SETUP(futex_hash)
+{
+	int ret = hash_get();
+
+	if (ret < 0 && errno == EINVAL)
+		SKIP(return, "kernel built without CONFIG_FUTEX_PRIVATE_HASH");
+	/* the hash isn't inherited from the harness */
+	ASSERT_EQ(ret, 0);
+	self->futex = 0;
+}
+
+FIXTURE_TEARDOWN(futex_hash)
+{
+}
+
+TEST_F(futex_hash, set)
+{
+	/* rounded up to the minimum size */
+	ASSERT_EQ(hash_set(4), 0);
+	EXPECT_EQ(hash_get(), 16);
+
+	/* the hash can only be set up once */
+	EXPECT_EQ(hash_set(64), -1);
+	EXPECT_EQ(errno, EBUSY);
+	EXPECT_EQ(hash_get(), 16);
+}
+
+TEST_F(futex_hash, set_default)
+{
+	int slots;
+
+	/* sized from the number of CPUs */
+	ASSERT_EQ(hash_set(0), 0);
+	slots = hash_get();
+	EXPECT_GE(slots, 16);
+	EXPECT_LE(slots, 1 << 16);
+	EXPECT_EQ(slots & (slots - 1), 0);
+}
+
+TEST_F(futex_hash, bad_args)
+{
+	EXPECT_EQ(hash_set(3), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(hash_set(1 << 17), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, 16, 1, 0), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, 16, 0, 1), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 1, 0, 0), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(prctl(PR_FUTEX_HASH, 3, 0, 0, 0), -1);
+	EXPECT_EQ(errno, EINVAL);
+
+	/* none of these set up a hash */
+	EXPECT_EQ(hash_get(), 0);
+}
+
+static void *waiter(void *arg)
+{
+	wait_one(arg, FUTEX_WAIT_PRIVATE);
+	return NULL;
+}
+
+TEST_F(futex_hash, threaded)
+{
+	pthread_t thread;
+
+	/* a waiter may be queued on the global hash already */
+	ASSERT_EQ(pthread_create(&thread, NULL, waiter, &self->futex), 0);
+	EXPECT_EQ(hash_set(16), -1);
+	EXPECT_EQ(errno, EBUSY);
+	EXPECT_EQ(hash_get(), 0);
+
+	EXPECT_EQ(wake_one(&self->futex, FUTEX_WAKE_PRIVATE), 1);
+	ASSERT_EQ(pthread_join(thread, NULL), 0);
+}
+
+TEST_F(futex_hash, private_futex)
+{
+	pthread_t thread;
+
+	ASSERT_EQ(hash_set(16), 0);
+	ASSERT_EQ(pthread_create(&thread, NULL, waiter, &self->futex), 0);
+	EXPECT_EQ(wake_one(&self->futex, FUTEX_WAKE_PRIVATE), 1);
+	ASSERT_EQ(pthread_join(thread, NULL), 0);
+}
+
+TEST_F(futex_hash, fork)
+{
+	int status;
+	pid_t pid;
+
+	ASSERT_EQ(hash_set(16), 0);
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (!pid)
+		_exit(hash_get() != 0);
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST_F(futex_hash, shared_futex)
+{
+	uint32_t *uaddr;
+	int status;
+	pid_t pid;
+
+	uaddr = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(uaddr, MAP_FAILED);
+	*uaddr = 0;
+
+	/* shared futexes still hash globally, the child has no private hash */
+	ASSERT_EQ(hash_set(16), 0);
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (!pid)
+		_exit(wait_one(uaddr, FUTEX_WAIT) != 0);
+	EXPECT_EQ(wake_one(uaddr, FUTEX_WAKE), 1);
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+	munmap(uaddr, getpagesize());
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io_uring commands on block devices: discard, write zeroes and zone
+ * management without blocking a thread per request. The tests run on a loop
+ * device backed by a temporary file.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/loop.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define DEV_SIZE	(1 << 20)
+#define BLK		4096
+
+FIXTURE(block_cmd) {
+	struct ring ring;
+	char path[32];
+	int fd;
+};
+
+FIXTURE_SETUP(block_cmd)
+{
+	char backing[] = "/tmp/block_cmd.XXXXXX";
+	struct loop_config cfg = {};
+	int ctl, nr, bfd;
+
+	self->fd = -1;
+	if (geteuid())
+		SKIP(return, "needs root to set up a loop device");
+	ctl = open("/dev/loop-control", O_RDWR);
+	if (ctl < 0)
+		SKIP(return, "no /dev/loop-control");
+	nr = ioctl(ctl, LOOP_CTL_GET_FREE);
+	close(ctl);
+	ASSERT_GE(nr, 0);
+
+	bfd = mkstemp(backing);
+	ASSERT_GE(bfd, 0);
+	unlink(backing);
+	ASSERT_EQ(ftruncate(bfd, DEV_SIZE), 0);
+
+	snprintf(self->path, sizeof(self->path), "/dev/loop%d", nr);
+	self->fd = open(self->path, O_RDWR);
+	ASSERT_GE(self->fd, 0);
+	cfg.fd = bfd;
+	cfg.info.lo_flags = LO_FLAGS_AUTOCLEAR;
+	ASSERT_EQ(ioctl(self->fd, LOOP_CONFIGURE, &cfg), 0);
+	close(bfd);
+
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+}
+
+FIXTURE_TEARDOWN(block_cmd)
+{
+	ring_exit(&self->ring);
+	ioctl(self->fd, LOOP_CLR_FD);
+	close(self->fd);
+}
+
+static struct io_uring_sqe *prep_cmd(struct ring *r, int fd, __u32 cmd_op,
+				     __u64 start, __u64 len)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(r);
+
+	sqe->opcode = IORING_OP_URING_CMD;
+	sqe->fd = fd;
+	sqe->cmd_op = cmd_op;
+	sqe->addr = start;
+	sqe->addr3 = len;
+	return sqe;
+}
+
+static int block_cmd(struct ring *r, int fd, __u32 cmd_op, __u64 start,
+		     __u64 len)
+{
+	prep_cmd(r, fd, cmd_op, start, len);
+	return ring_submit_one(r, NULL);
+}
+
+static int memchk(const char *buf, char c, size_t len)
+{
+	while (len--)
+		if (*buf++ != c)
+			return -1;
+	return 0;
+}
+
+TEST_F(block_cmd, write_zeroes)
+{
+	char buf[3 * BLK];
+	int ret;
+
+	memset(buf, 0xaa, sizeof(buf));
+	ASSERT_EQ(pwrite(self->fd, buf, sizeof(buf), 0), sizeof(buf));
+	ASSERT_EQ(fsync(self->fd), 0);
+
+	ret = block_cmd(&self->ring, self->fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			BLK, BLK);
+	if (ret == -EOPNOTSUPP)
+		SKIP(return, "block device io_uring commands not supported");
+	ASSERT_EQ(ret, 0);
+
+	/* the cached pages of the range have been dropped */
+	ASSERT_EQ(pread(self->fd, buf, sizeof(buf), 0), sizeof(buf));
+	EXPECT_EQ(memchk(buf, 0xaa, BLK), 0);
+	EXPECT_EQ(memchk(buf + BLK, 0, BLK), 0);
+	EXPECT_EQ(memchk(buf + 2 * BLK, 0xaa, BLK), 0);
+}
+
+TEST_F(block_cmd, discard)
+{
+	char buf[BLK];
+	int ret;
+
+	memset(buf, 0xaa, sizeof(buf));
+	ASSERT_EQ(pwrite(self->fd, buf, sizeof(buf), 0), sizeof(buf));
+	ASSERT_EQ(fsync(self->fd), 0);
+
+	ret = block_cmd(&self->ring, self->fd, BLOCK_URING_CMD_DISCARD, 0,
+			DEV_SIZE);
+	if (ret == -EOPNOTSUPP)
+		SKIP(return, "discard not supported");
+	EXPECT_EQ(ret, 0);
+}
+
+TEST_F(block_cmd, many)
+{
+	struct io_uring_cqe *cqe;
+	int i;
+
+	/* the commands complete asynchronously, queue several at once */
+	for (i = 0; i < 8; i++)
+		prep_cmd(&self->ring, self->fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			 i * BLK, BLK)->user_data = i;
+	ASSERT_EQ(ring_submit_and_wait(&self->ring, 8), 8);
+	for (i = 0; i < 8; i++) {
+		ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+		EXPECT_EQ(cqe->res, 0);
+		ring_cqe_seen(&self->ring);
+	}
+}
+
+TEST_F(block_cmd, bad_range)
+{
+	int fd = self->fd;
+
+	/* not sector aligned */
+	EXPECT_EQ(block_cmd(&self->ring, fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			    100, BLK), -EINVAL);
+	EXPECT_EQ(block_cmd(&self->ring, fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			    0, BLK + 1), -EINVAL);
+	/* empty */
+	EXPECT_EQ(block_cmd(&self->ring, fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			    0, 0), -EINVAL);
+	/* past the end of the device */
+	EXPECT_EQ(block_cmd(&self->ring, fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			    DEV_SIZE - BLK, 2 * BLK), -EINVAL);
+	/* wrapping around */
+	EXPECT_EQ(block_cmd(&self->ring, fd, BLOCK_URING_CMD_DISCARD,
+			    BLK, UINT64_MAX - BLK + 1), -EINVAL);
+}
+
+TEST_F(block_cmd, bad_cmd)
+{
+	struct io_uring_sqe *sqe;
+
+	EXPECT_EQ(block_cmd(&self->ring, self->fd, _IO(0x12, 0x7f), 0, BLK),
+		  -EINVAL);
+
+	/* fields the commands don't use must be clear */
+	sqe = prep_cmd(&self->ring, self->fd, BLOCK_URING_CMD_WRITE_ZEROES,
+		       0, BLK);
+	sqe->len = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(block_cmd, not_zoned)
+{
+	EXPECT_EQ(block_cmd(&self->ring, self->fd, BLOCK_URING_CMD_ZONE_RESET,
+			    0, DEV_SIZE), -EOPNOTSUPP);
+	EXPECT_EQ(block_cmd(&self->ring, self->fd, BLOCK_URING_CMD_ZONE_FINISH,
+			    0, DEV_SIZE), -EOPNOTSUPP);
+}
+
+TEST_F(block_cmd, read_only)
+{
+	int fd = open(self->path, O_RDONLY);
+
+	ASSERT_GE(fd, 0);
+	EXPECT_EQ(block_cmd(&self->ring, fd, BLOCK_URING_CMD_WRITE_ZEROES,
+			    0, BLK), -EBADF);
+	close(fd);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_REGISTER_CLONE_BUFFERS and IORING_REGISTER_CLONE_FILES: a ring gets
+ * its own copy of the registered buffer or file table of another ring.
+ */
+#define _GNU_SOURCE
+#include <sys/wait.h>
+#include <linux/uio.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+FIXTURE(clone_rsrc) {
+	struct ring src;
+	struct ring dst;
+	int pipe[2];
+	char buf[64];
+};
+
+FIXTURE_SETUP(clone_rsrc)
+{
+	struct io_uring_clone_rsrc clone = {};
+	int ret;
+
+	ASSERT_EQ(ring_init_simple(&self->src, 8), 0);
+	ASSERT_EQ(ring_init_simple(&self->dst, 8), 0);
+	ASSERT_EQ(pipe(self->pipe), 0);
+
+	/* the source has no buffers yet */
+	clone.src_fd = self->src.fd;
+	ret = ring_register(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+			    &clone, 1);
+	if (ret == -EINVAL)
+		SKIP(return, "IORING_REGISTER_CLONE_BUFFERS not supported");
+	ASSERT_EQ(ret, -ENXIO);
+}
+
+FIXTURE_TEARDOWN(clone_rsrc)
+{
+	close(self->pipe[0]);
+	close(self->pipe[1]);
+	ring_exit(&self->dst);
+	ring_exit(&self->src);
+}
+
+static int register_buffer(FIXTURE_DATA(clone_rsrc) *self)
+{
+	struct iovec iov = {
+		.iov_base = self->buf,
+		.iov_len = sizeof(self->buf),
+	};
+
+	return ring_register(&self->src, IORING_REGISTER_BUFFERS, &iov, 1);
+}
+
+static int clone_rsrc(struct ring *r, unsigned int op, unsigned int src_fd,
+		      unsigned int flags)
+{
+	struct io_uring_clone_rsrc clone = {
+		.src_fd = src_fd,
+		.flags = flags,
+	};
+
+	return ring_register(r, op, &clone, 1);
+}
+
+/* Write @str to the pipe and read it back with a fixed buffer on @r */
+static int read_fixed(FIXTURE_DATA(clone_rsrc) *self, struct ring *r,
+		      const char *str)
+{
+	struct io_uring_sqe *sqe;
+	int len = strlen(str);
+
+	if (write(self->pipe[1], str, len) != len)
+		return -errno;
+	memset(self->buf, 0, sizeof(self->buf));
+	sqe = ring_get_sqe(r);
+	ring_prep_rw(sqe, IORING_OP_READ_FIXED, self->pipe[0], self->buf,
+		     sizeof(self->buf), -1ULL);
+	sqe->buf_index = 0;
+	return ring_submit_one(r, NULL);
+}
+
+/* Same, but the pipe is read through fixed file 0 of @r */
+static int read_fixed_file(FIXTURE_DATA(clone_rsrc) *self, struct ring *r,
+			   const char *str)
+{
+	struct io_uring_sqe *sqe;
+	int len = strlen(str);
+
+	if (write(self->pipe[1], str, len) != len)
+		return -errno;
+	memset(self->buf, 0, sizeof(self->buf));
+	sqe = ring_get_sqe(r);
+	ring_prep_rw(sqe, IORING_OP_READ, 0, self->buf, sizeof(self->buf),
+		     -1ULL);
+	sqe->flags = IOSQE_FIXED_FILE;
+	return ring_submit_one(r, NULL);
+}
+
+TEST_F(clone_rsrc, buffers)
+{
+	ASSERT_EQ(register_buffer(self), 0);
+	ASSERT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+			     self->src.fd, 0), 0);
+
+	ASSERT_EQ(read_fixed(self, &self->dst, "clone"), 5);
+	EXPECT_STREQ(self->buf, "clone");
+	ASSERT_EQ(read_fixed(self, &self->src, "source"), 6);
+	EXPECT_STREQ(self->buf, "source");
+
+	/* the clone keeps the buffer after the source drops it */
+	ASSERT_EQ(ring_register(&self->src, IORING_UNREGISTER_BUFFERS, NULL, 0),
+		  0);
+	ASSERT_EQ(read_fixed(self, &self->dst, "after"), 5);
+	EXPECT_STREQ(self->buf, "after");
+	EXPECT_EQ(ring_register(&self->dst, IORING_UNREGISTER_BUFFERS, NULL, 0),
+		  0);
+}
+
+TEST_F(clone_rsrc, files)
+{
+	int fd = self->pipe[0];
+
+	ASSERT_EQ(ring_register(&self->src, IORING_REGISTER_FILES, &fd, 1), 0);
+	ASSERT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_FILES,
+			     self->src.fd, 0), 0);
+	ASSERT_EQ(ring_register(&self->src, IORING_UNREGISTER_FILES, NULL, 0),
+		  0);
+
+	ASSERT_EQ(read_fixed_file(self, &self->dst, "files"), 5);
+	EXPECT_STREQ(self->buf, "files");
+	/* the tables are independent */
+	EXPECT_EQ(read_fixed_file(self, &self->src, "x"), -EBADF);
+}
+
+TEST_F(clone_rsrc, registered_ring)
+{
+	struct io_uring_rsrc_update upd = {
+		.offset = -1U,
+		.data = self->src.fd,
+	};
+
+	ASSERT_EQ(register_buffer(self), 0);
+	ASSERT_EQ(ring_register(&self->dst, IORING_REGISTER_RING_FDS, &upd, 1),
+		  1);
+
+	/* an unused slot, and one past the end of the table */
+	EXPECT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+			     (upd.offset + 1) % 16,
+			     IORING_REGISTER_SRC_REGISTERED), -EBADF);
+	EXPECT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_BUFFERS, 1024,
+			     IORING_REGISTER_SRC_REGISTERED), -EINVAL);
+
+	ASSERT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+			     upd.offset, IORING_REGISTER_SRC_REGISTERED), 0);
+	ASSERT_EQ(read_fixed(self, &self->dst, "registered"), 10);
+	EXPECT_STREQ(self->buf, "registered");
+}
+
+TEST_F(clone_rsrc, bad_source)
+{
+	struct io_uring_clone_rsrc clone = { .src_fd = self->src.fd };
+	int fd = self->pipe[0];
+
+	/* the source has no table */
+	EXPECT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_FILES,
+			     self->src.fd, 0), -ENXIO);
+	/* not a ring */
+	EXPECT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_FILES,
+			     self->pipe[0], 0), -EOPNOTSUPP);
+	EXPECT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_FILES, -1, 0),
+		  -EBADF);
+
+	/* the target already has a table */
+	ASSERT_EQ(ring_register(&self->src, IORING_REGISTER_FILES, &fd, 1), 0);
+	ASSERT_EQ(ring_register(&self->dst, IORING_REGISTER_FILES, &fd, 1), 0);
+	EXPECT_EQ(clone_rsrc(&self->dst, IORING_REGISTER_CLONE_FILES,
+			     self->src.fd, 0), -EBUSY);
+
+	clone.flags = 2;
+	EXPECT_EQ(ring_register(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+				&clone, 1), -EINVAL);
+	clone.flags = 0;
+	clone.pad[5] = 1;
+	EXPECT_EQ(ring_register(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+				&clone, 1), -EINVAL);
+	clone.pad[5] = 0;
+	EXPECT_EQ(ring_register(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+				&clone, 2), -EINVAL);
+	EXPECT_EQ(ring_register(&self->dst, IORING_REGISTER_CLONE_BUFFERS,
+				NULL, 1), -EINVAL);
+}
+
+TEST_F(clone_rsrc, other_mm)
+{
+	struct ring ring;
+	int status;
+	pid_t pid;
+
+	ASSERT_EQ(register_buffer(self), 0);
+
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (!pid) {
+		/* buffers are accounted to the mm of the ring */
+		if (ring_init_simple(&ring, 8))
+			_exit(1);
+		_exit(clone_rsrc(&ring, IORING_REGISTER_CLONE_BUFFERS,
+				 self->src.fd, 0) != -EPERM);
+	}
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_OP_EPOLL_WAIT: harvest the events of an epoll instance, completing
+ * once at least one is ready.
+ */
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define NR_EVENTS	4
+
+FIXTURE(epoll_wait) {
+	struct ring ring;
+	struct epoll_event events[NR_EVENTS];
+	int epfd;
+	int pipe[2];
+};
+
+FIXTURE_SETUP(epoll_wait)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.u64 = 0x1234,
+	};
+
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	if (!ring_opcode_supported(&self->ring, IORING_OP_EPOLL_WAIT))
+		SKIP(return, "IORING_OP_EPOLL_WAIT not supported");
+
+	ASSERT_EQ(pipe(self->pipe), 0);
+	self->epfd = epoll_create1(0);
+	ASSERT_GE(self->epfd, 0);
+	ASSERT_EQ(epoll_ctl(self->epfd, EPOLL_CTL_ADD, self->pipe[0], &ev), 0);
+}
+
+FIXTURE_TEARDOWN(epoll_wait)
+{
+	close(self->epfd);
+	close(self->pipe[0]);
+	close(self->pipe[1]);
+	ring_exit(&self->ring);
+}
+
+static struct io_uring_sqe *prep_epoll_wait(FIXTURE_DATA(epoll_wait) *self,
+					    int epfd, int maxevents)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	memset(self->events, 0, sizeof(self->events));
+	ring_prep_rw(sqe, IORING_OP_EPOLL_WAIT, epfd, self->events, maxevents,
+		     0);
+	return sqe;
+}
+
+TEST_F(epoll_wait, ready)
+{
+	ASSERT_EQ(write(self->pipe[1], "x", 1), 1);
+	prep_epoll_wait(self, self->epfd, NR_EVENTS);
+	ASSERT_EQ(ring_submit_one(&self->ring, NULL), 1);
+	EXPECT_EQ(self->events[0].events, EPOLLIN);
+	EXPECT_EQ(self->events[0].data.u64, 0x1234);
+}
+
+TEST_F(epoll_wait, pending)
+{
+	struct io_uring_cqe *cqe;
+
+	prep_epoll_wait(self, self->epfd, NR_EVENTS);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	usleep(100000);
+	EXPECT_EQ(ring_peek_cqe(&self->ring, &cqe), -EAGAIN);
+
+	ASSERT_EQ(write(self->pipe[1], "x", 1), 1);
+	ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+	EXPECT_EQ(cqe->res, 1);
+	ring_cqe_seen(&self->ring);
+	EXPECT_EQ(self->events[0].events, EPOLLIN);
+	EXPECT_EQ(self->events[0].data.u64, 0x1234);
+}
+
+TEST_F(epoll_wait, errors)
+{
+	struct io_uring_sqe *sqe;
+
+	prep_epoll_wait(self, self->epfd, 0);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	prep_epoll_wait(self, self->epfd, -1);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	/* not an epoll instance */
+	prep_epoll_wait(self, self->pipe[0], NR_EVENTS);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	prep_epoll_wait(self, -1, NR_EVENTS);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EBADF);
+
+	/* unused fields must be clear */
+	sqe = prep_epoll_wait(self, self->epfd, NR_EVENTS);
+	sqe->off = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	sqe = prep_epoll_wait(self, self->epfd, NR_EVENTS);
+	sqe->rw_flags = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_HARNESS_MAIN
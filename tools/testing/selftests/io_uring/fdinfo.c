@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Information io_uring reports in /proc/<pid>/fdinfo/<ring fd>.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define NR_NOPS		4096
+#define SQ_IDLE_MS	100
+
+/* Read the fdinfo of @fd into @buf, returns 0 or a negative error code */
+static int fdinfo_read(int fd, char *buf, size_t size)
+{
+	char path[64];
+	size_t len;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	len = fread(buf, 1, size - 1, f);
+	fclose(f);
+	buf[len] = '\0';
+	return 0;
+}
+
+/* Value of the "@key:\t<number>" line of the fdinfo of @fd */
+static int fdinfo_get(int fd, const char *key, long long *val)
+{
+	char buf[16384], match[64], *p;
+	int ret;
+
+	ret = fdinfo_read(fd, buf, sizeof(buf));
+	if (ret)
+		return ret;
+	snprintf(match, sizeof(match), "\n%s:\t", key);
+	p = strstr(buf, match);
+	if (!p)
+		return -ENOENT;
+	*val = strtoll(p + strlen(match), NULL, 10);
+	return 0;
+}
+
+static int submit_nops(struct ring *r, unsigned int nr)
+{
+	struct io_uring_cqe *cqe;
+	unsigned int i, done = 0;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		struct io_uring_sqe *sqe = ring_get_sqe(r);
+
+		if (!sqe) {
+			ret = ring_submit(r);
+			if (ret < 0)
+				return ret;
+			/* reap what completed so far to make room */
+			do {
+				ret = ring_wait_cqe(r, &cqe);
+				if (ret)
+					return ret;
+				if (cqe->res)
+					return cqe->res;
+				ring_cqe_seen(r);
+				done++;
+			} while (!ring_peek_cqe(r, &cqe));
+			sqe = ring_get_sqe(r);
+			if (!sqe)
+				return -EBUSY;
+		}
+		sqe->opcode = IORING_OP_NOP;
+	}
+	ret = ring_submit(r);
+	if (ret < 0)
+		return ret;
+	while (done < nr) {
+		ret = ring_wait_cqe(r, &cqe);
+		if (ret)
+			return ret;
+		if (cqe->res)
+			return cqe->res;
+		ring_cqe_seen(r);
+		done++;
+	}
+	return 0;
+}
+
+static int sqpoll_init(struct ring *r, int attach_fd)
+{
+	struct io_uring_params p = {
+		.flags = IORING_SETUP_SQPOLL,
+		.sq_thread_idle = SQ_IDLE_MS,
+	};
+
+	if (attach_fd >= 0) {
+		p.flags |= IORING_SETUP_ATTACH_WQ;
+		p.wq_fd = attach_fd;
+	}
+	return ring_init(r, 32, &p);
+}
+
+TEST(sq_work_time)
+{
+	long long pid, work;
+	struct ring ring;
+
+	ASSERT_EQ(ring_init_simple(&ring, 8), 0);
+	ASSERT_EQ(fdinfo_get(ring.fd, "SqThread", &pid), 0);
+	EXPECT_EQ(pid, -1);
+	/* no SQ thread ever worked on this ring */
+	ASSERT_EQ(fdinfo_get(ring.fd, "SqWorkTime", &work), 0)
+		TH_LOG("no SqWorkTime in fdinfo");
+	EXPECT_EQ(work, 0);
+	ring_exit(&ring);
+
+	ASSERT_EQ(sqpoll_init(&ring, -1), 0);
+	ASSERT_EQ(submit_nops(&ring, NR_NOPS), 0);
+	/* the SQ thread is only reported while it sleeps */
+	usleep(3 * SQ_IDLE_MS * 1000);
+	ASSERT_EQ(fdinfo_get(ring.fd, "SqThread", &pid), 0);
+	EXPECT_GT(pid, 0);
+	ASSERT_EQ(fdinfo_get(ring.fd, "SqWorkTime", &work), 0);
+	EXPECT_GT(work, 0);
+	ring_exit(&ring);
+}
+
+TEST(sq_work_time_shared)
+{
+	long long pid[2], work[2];
+	struct ring ring[2];
+	int i;
+
+	/* two rings served by the same SQ thread */
+	ASSERT_EQ(sqpoll_init(&ring[0], -1), 0);
+	ASSERT_EQ(sqpoll_init(&ring[1], ring[0].fd), 0);
+
+	for (i = 0; i < 2; i++)
+		ASSERT_EQ(submit_nops(&ring[i], NR_NOPS), 0);
+	usleep(3 * SQ_IDLE_MS * 1000);
+
+	/* the time is accounted to each ring separately */
+	for (i = 0; i < 2; i++) {
+		ASSERT_EQ(fdinfo_get(ring[i].fd, "SqThread", &pid[i]), 0);
+		ASSERT_EQ(fdinfo_get(ring[i].fd, "SqWorkTime", &work[i]), 0);
+		EXPECT_GT(work[i], 0);
+	}
+	EXPECT_GT(pid[0], 0);
+	EXPECT_EQ(pid[0], pid[1]);
+
+	ring_exit(&ring[1]);
+	ring_exit(&ring[0]);
+}
+
+/* Whether the fdinfo of @fd contains @str */
+static int fdinfo_has(int fd, const char *str)
+{
+	char buf[16384];
+
+	if (fdinfo_read(fd, buf, sizeof(buf)))
+		return -1;
+	return !!strstr(buf, str);
+}
+
+TEST(stats)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	struct ring ring;
+	int fds[2], ret;
+	char c;
+
+	ASSERT_EQ(ring_init_simple(&ring, 8), 0);
+	ret = ring_register(&ring, IORING_REGISTER_STATS, NULL, 0);
+	if (ret == -EINVAL)
+		SKIP(return, "IORING_REGISTER_STATS not supported");
+	ASSERT_EQ(ret, 0);
+	EXPECT_EQ(fdinfo_has(ring.fd, "\nOpStats:\n"), 1);
+	/* nothing completed yet */
+	EXPECT_EQ(fdinfo_has(ring.fd, "NOP/"), 0);
+
+	ASSERT_EQ(submit_nops(&ring, 16), 0);
+	EXPECT_EQ(fdinfo_has(ring.fd, "  NOP/inline: nr=16 "), 1);
+
+	sqe = ring_get_sqe(&ring);
+	sqe->opcode = IORING_OP_NOP;
+	sqe->flags = IOSQE_ASYNC;
+	ASSERT_EQ(ring_submit_one(&ring, NULL), 0);
+	EXPECT_EQ(fdinfo_has(ring.fd, "  NOP/iowq: nr=1 "), 1);
+
+	/* a read of an empty pipe waits for the pipe to become readable */
+	ASSERT_EQ(pipe(fds), 0);
+	ring_prep_rw(ring_get_sqe(&ring), IORING_OP_READ, fds[0], &c, 1, -1ULL);
+	ASSERT_EQ(ring_submit(&ring), 1);
+	ASSERT_EQ(write(fds[1], "x", 1), 1);
+	ASSERT_EQ(ring_wait_cqe(&ring, &cqe), 0);
+	EXPECT_EQ(cqe->res, 1);
+	ring_cqe_seen(&ring);
+	EXPECT_EQ(fdinfo_has(ring.fd, "  READ/poll: nr=1 "), 1);
+	EXPECT_EQ(fdinfo_has(ring.fd, "\nTaskWorkRuns:\t"), 1);
+	close(fds[0]);
+	close(fds[1]);
+
+	ASSERT_EQ(ring_register(&ring, IORING_UNREGISTER_STATS, NULL, 0), 0);
+	EXPECT_EQ(fdinfo_has(ring.fd, "OpStats:"), 0);
+	EXPECT_EQ(fdinfo_has(ring.fd, "TaskWorkRuns:"), 0);
+
+	/* registering again starts from scratch */
+	ASSERT_EQ(ring_register(&ring, IORING_REGISTER_STATS, NULL, 0), 0);
+	EXPECT_EQ(fdinfo_has(ring.fd, "NOP/"), 0);
+	ring_exit(&ring);
+}
+
+TEST(stats_errors)
+{
+	struct ring ring;
+	int ret;
+
+	ASSERT_EQ(ring_init_simple(&ring, 8), 0);
+	ret = ring_register(&ring, IORING_REGISTER_STATS, NULL, 0);
+	if (ret == -EINVAL)
+		SKIP(return, "IORING_REGISTER_STATS not supported");
+	ASSERT_EQ(ret, 0);
+	EXPECT_EQ(ring_register(&ring, IORING_REGISTER_STATS, NULL, 0), -EBUSY);
+	EXPECT_EQ(ring_register(&ring, IORING_UNREGISTER_STATS, &ring, 0),
+		  -EINVAL);
+	EXPECT_EQ(ring_register(&ring, IORING_UNREGISTER_STATS, NULL, 1),
+		  -EINVAL);
+	ASSERT_EQ(ring_register(&ring, IORING_UNREGISTER_STATS, NULL, 0), 0);
+	EXPECT_EQ(ring_register(&ring, IORING_UNREGISTER_STATS, NULL, 0),
+		  -ENXIO);
+
+	/* both take no argument */
+	EXPECT_EQ(ring_register(&ring, IORING_REGISTER_STATS, &ring, 0),
+		  -EINVAL);
+	EXPECT_EQ(ring_register(&ring, IORING_REGISTER_STATS, NULL, 1),
+		  -EINVAL);
+	ring_exit(&ring);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_OP_FUTEX_WAIT, IORING_OP_FUTEX_WAKE and IORING_OP_FUTEX_WAITV. The
+ * waits are asynchronous, so a single thread can both wait and wake.
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <linux/futex.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define FUTEX_FLAGS	(FUTEX_32 | FUTEX_PRIVATE_FLAG)
+
+FIXTURE(futex) {
+	struct ring ring;
+	uint32_t futex[2];
+};
+
+FIXTURE_SETUP(futex)
+{
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	if (!ring_opcode_supported(&self->ring, IORING_OP_FUTEX_WAIT))
+		SKIP(return, "io_uring futex operations not supported");
+}
+
+FIXTURE_TEARDOWN(futex)
+{
+	ring_exit(&self->ring);
+}
+
+static void prep_futex(struct io_uring_sqe *sqe, int op, uint32_t *futex,
+		       uint64_t val, uint64_t mask, __u64 user_data)
+{
+	sqe->opcode = op;
+	sqe->fd = FUTEX_FLAGS;
+	sqe->addr = (unsigned long)futex;
+	sqe->addr2 = val;
+	sqe->addr3 = mask;
+	sqe->user_data = user_data;
+}
+
+/* Wait for the CQE of @user_data, returns its result */
+static int wait_cqe_data(struct ring *r, __u64 user_data)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	ret = ring_wait_cqe(r, &cqe);
+	if (ret)
+		return ret;
+	if (cqe->user_data != user_data) {
+		ring_cqe_seen(r);
+		return -ENOMSG;
+	}
+	ret = cqe->res;
+	ring_cqe_seen(r);
+	return ret;
+}
+
+TEST_F(futex, wake_none)
+{
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAKE,
+		   &self->futex[0], 1, FUTEX_BITSET_MATCH_ANY, 1);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), 0);
+}
+
+TEST_F(futex, wait_wake)
+{
+	struct io_uring_cqe *cqe;
+
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAIT,
+		   &self->futex[0], 0, 0x1, 1);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	ASSERT_EQ(ring_peek_cqe(&self->ring, &cqe), -EAGAIN);
+
+	/* a mask that doesn't match the waiter doesn't wake it */
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAKE,
+		   &self->futex[0], 1, 0x2, 2);
+	ASSERT_EQ(ring_submit_and_wait(&self->ring, 1), 1);
+	ASSERT_EQ(wait_cqe_data(&self->ring, 2), 0);
+	ASSERT_EQ(ring_peek_cqe(&self->ring, &cqe), -EAGAIN);
+
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAKE,
+		   &self->futex[0], 1, FUTEX_BITSET_MATCH_ANY, 3);
+	ASSERT_EQ(ring_submit_and_wait(&self->ring, 2), 1);
+	/* the wake completes inline, the waiter through task_work */
+	EXPECT_EQ(wait_cqe_data(&self->ring, 3), 1);
+	EXPECT_EQ(wait_cqe_data(&self->ring, 1), 0);
+}
+
+TEST_F(futex, wait_value_changed)
+{
+	self->futex[0] = 1;
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAIT,
+		   &self->futex[0], 0, FUTEX_BITSET_MATCH_ANY, 1);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EAGAIN);
+}
+
+TEST_F(futex, waitv)
+{
+	struct futex_waitv waitv[2] = {
+		{
+			.val = 0,
+			.uaddr = (unsigned long)&self->futex[0],
+			.flags = FUTEX_FLAGS,
+		}, {
+			.val = 0,
+			.uaddr = (unsigned long)&self->futex[1],
+			.flags = FUTEX_FLAGS,
+		},
+	};
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+
+	sqe = ring_get_sqe(&self->ring);
+	sqe->opcode = IORING_OP_FUTEX_WAITV;
+	sqe->addr = (unsigned long)waitv;
+	sqe->len = 2;
+	sqe->user_data = 1;
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	ASSERT_EQ(ring_peek_cqe(&self->ring, &cqe), -EAGAIN);
+
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAKE,
+		   &self->futex[1], 1, FUTEX_BITSET_MATCH_ANY, 2);
+	ASSERT_EQ(ring_submit_and_wait(&self->ring, 2), 1);
+	EXPECT_EQ(wait_cqe_data(&self->ring, 2), 1);
+	/* the result is the index of the futex that was woken */
+	EXPECT_EQ(wait_cqe_data(&self->ring, 1), 1);
+}
+
+TEST_F(futex, bad_flags)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	prep_futex(sqe, IORING_OP_FUTEX_WAKE, &self->futex[0], 1,
+		   FUTEX_BITSET_MATCH_ANY, 1);
+	/* only 32-bit futexes are supported */
+	sqe->fd = FUTEX_PRIVATE_FLAG;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+
+	sqe = ring_get_sqe(&self->ring);
+	prep_futex(sqe, IORING_OP_FUTEX_WAKE, &self->futex[0], 1,
+		   FUTEX_BITSET_MATCH_ANY, 1);
+	sqe->futex_flags = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(futex, bad_value)
+{
+	/* values and masks are 32 bits wide */
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAIT,
+		   &self->futex[0], 1ULL << 32, FUTEX_BITSET_MATCH_ANY, 1);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(futex, wait_no_mask)
+{
+	prep_futex(ring_get_sqe(&self->ring), IORING_OP_FUTEX_WAIT,
+		   &self->futex[0], 0, 0, 1);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(futex, waitv_empty)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+	struct futex_waitv waitv = {};
+
+	sqe->opcode = IORING_OP_FUTEX_WAITV;
+	sqe->addr = (unsigned long)&waitv;
+	sqe->len = 0;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * CPU placement of io-wq workers: a worker runs on the NUMA node of the task
+ * that queued the work, unless the io-wq affinity doesn't cover that node.
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+/* Parse a sysfs CPU list like "0-3,8" */
+static int read_cpulist(const char *path, cpu_set_t *set)
+{
+	unsigned int first, last;
+	char buf[4096], *p;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (!p)
+		return -EIO;
+
+	CPU_ZERO(set);
+	while (*p && *p != '\n') {
+		if (sscanf(p, "%u-%u", &first, &last) != 2) {
+			if (sscanf(p, "%u", &first) != 1)
+				return -EINVAL;
+			last = first;
+		}
+		for (; first <= last; first++)
+			CPU_SET(first, set);
+		p += strcspn(p, ",\n");
+		if (*p == ',')
+			p++;
+	}
+	return 0;
+}
+
+/* Returns the number of nodes with CPUs and the CPUs of the node of @cpu */
+static int cpu_node(int cpu, cpu_set_t *node_cpus)
+{
+	char path[64];
+	cpu_set_t set;
+	int node, nr = 0;
+
+	CPU_ZERO(node_cpus);
+	for (node = 0; node < 1024; node++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", node);
+		if (read_cpulist(path, &set) || !CPU_COUNT(&set))
+			continue;
+		nr++;
+		if (CPU_ISSET(cpu, &set))
+			*node_cpus = set;
+	}
+	return nr;
+}
+
+/* Wait for an io-wq worker of this process to show up and return its TID */
+static pid_t find_worker(void)
+{
+	char comm[32], name[32], path[64];
+	struct dirent *de;
+	int tries, tid;
+	FILE *f;
+	DIR *d;
+
+	snprintf(name, sizeof(name), "iou-wrk-%d\n", getpid());
+	for (tries = 0; tries < 100; tries++) {
+		d = opendir("/proc/self/task");
+		if (!d)
+			return -1;
+		while ((de = readdir(d))) {
+			tid = atoi(de->d_name);
+			if (tid <= 0)
+				continue;
+			snprintf(path, sizeof(path), "/proc/self/task/%d/comm",
+				 tid);
+			f = fopen(path, "r");
+			if (!f)
+				continue;
+			if (fgets(comm, sizeof(comm), f) && !strcmp(comm, name)) {
+				fclose(f);
+				closedir(d);
+				return tid;
+			}
+			fclose(f);
+		}
+		closedir(d);
+		usleep(10000);
+	}
+	return -1;
+}
+
+FIXTURE(iowq_affinity) {
+	struct ring ring;
+	int pipe[2];
+	int cpu;
+	char buf[8];
+};
+
+FIXTURE_SETUP(iowq_affinity)
+{
+	cpu_set_t set;
+
+	/* stay on one CPU so that the node of the submitter is known */
+	self->cpu = sched_getcpu();
+	ASSERT_GE(self->cpu, 0);
+	CPU_ZERO(&set);
+	CPU_SET(self->cpu, &set);
+	ASSERT_EQ(sched_setaffinity(0, sizeof(set), &set), 0);
+
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	ASSERT_EQ(pipe(self->pipe), 0);
+}
+
+FIXTURE_TEARDOWN(iowq_affinity)
+{
+	close(self->pipe[0]);
+	close(self->pipe[1]);
+	ring_exit(&self->ring);
+}
+
+/* Queue a read of the pipe to io-wq, it blocks there until the pipe is written */
+static void queue_blocking_read(FIXTURE_DATA(iowq_affinity) *self)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	ring_prep_rw(sqe, IORING_OP_READ, self->pipe[0], self->buf,
+		     sizeof(self->buf), -1ULL);
+	sqe->flags = IOSQE_ASYNC;
+}
+
+static int complete_read(FIXTURE_DATA(iowq_affinity) *self)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	if (write(self->pipe[1], "x", 1) != 1)
+		return -errno;
+	ret = ring_wait_cqe(&self->ring, &cqe);
+	if (ret)
+		return ret;
+	ret = cqe->res;
+	ring_cqe_seen(&self->ring);
+	return ret;
+}
+
+TEST_F(iowq_affinity, node_local)
+{
+	cpu_set_t node_cpus, worker_cpus;
+	pid_t tid;
+	int cpu;
+
+	if (cpu_node(self->cpu, &node_cpus) < 2)
+		SKIP(return, "needs more than one NUMA node with CPUs");
+
+	queue_blocking_read(self);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	tid = find_worker();
+	ASSERT_GT(tid, 0);
+	ASSERT_EQ(sched_getaffinity(tid, sizeof(worker_cpus), &worker_cpus), 0);
+
+	/* the worker is bound to the node of the submitter */
+	EXPECT_TRUE(CPU_ISSET(self->cpu, &worker_cpus));
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &worker_cpus))
+			EXPECT_TRUE(CPU_ISSET(cpu, &node_cpus))
+				TH_LOG("worker allowed on CPU %d of another node", cpu);
+
+	EXPECT_EQ(complete_read(self), 1);
+}
+
+TEST_F(iowq_affinity, restricted)
+{
+	cpu_set_t set, worker_cpus;
+	pid_t tid;
+
+	/* the affinity can only be set once the task has an io-wq */
+	ring_get_sqe(&self->ring)->opcode = IORING_OP_NOP;
+	ASSERT_EQ(ring_submit_one(&self->ring, NULL), 0);
+
+	/*
+	 * A single CPU doesn't cover its node unless the node only has that
+	 * one, the worker must not be bound to the node then.
+	 */
+	CPU_ZERO(&set);
+	CPU_SET(self->cpu, &set);
+	ASSERT_EQ(ring_register(&self->ring, IORING_REGISTER_IOWQ_AFF, &set,
+				sizeof(set)), 0);
+
+	queue_blocking_read(self);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	tid = find_worker();
+	ASSERT_GT(tid, 0);
+	ASSERT_EQ(sched_getaffinity(tid, sizeof(worker_cpus), &worker_cpus), 0);
+	EXPECT_TRUE(CPU_EQUAL(&set, &worker_cpus));
+
+	EXPECT_EQ(complete_read(self), 1);
+}
+
+TEST_HARNESS_MAIN
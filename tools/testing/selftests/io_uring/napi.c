@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_REGISTER_NAPI and IORING_UNREGISTER_NAPI: both return the previous
+ * busy poll settings of the ring in the passed structure.
+ */
+#define _GNU_SOURCE
+#include <sys/socket.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+FIXTURE(napi) {
+	struct ring ring;
+};
+
+FIXTURE_SETUP(napi)
+{
+	struct io_uring_napi napi = {};
+	int ret;
+
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	ret = ring_register(&self->ring, IORING_UNREGISTER_NAPI, &napi, 1);
+	if (ret == -EOPNOTSUPP)
+		SKIP(return, "kernel built without CONFIG_NET_RX_BUSY_POLL");
+	if (ret == -EINVAL)
+		SKIP(return, "IORING_REGISTER_NAPI not supported");
+	ASSERT_EQ(ret, 0);
+}
+
+FIXTURE_TEARDOWN(napi)
+{
+	ring_exit(&self->ring);
+}
+
+TEST_F(napi, register)
+{
+	struct io_uring_napi napi = {
+		.busy_poll_to = 100,
+		.prefer_busy_poll = 1,
+	};
+
+	ASSERT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 1), 0);
+	EXPECT_EQ(napi.busy_poll_to, 0);
+	EXPECT_EQ(napi.prefer_busy_poll, 0);
+
+	/* registering again replaces the settings */
+	napi.busy_poll_to = 200;
+	napi.prefer_busy_poll = 0;
+	ASSERT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 1), 0);
+	EXPECT_EQ(napi.busy_poll_to, 100);
+	EXPECT_EQ(napi.prefer_busy_poll, 1);
+
+	memset(&napi, 0, sizeof(napi));
+	ASSERT_EQ(ring_register(&self->ring, IORING_UNREGISTER_NAPI, &napi, 1), 0);
+	EXPECT_EQ(napi.busy_poll_to, 200);
+	EXPECT_EQ(napi.prefer_busy_poll, 0);
+
+	ASSERT_EQ(ring_register(&self->ring, IORING_UNREGISTER_NAPI, &napi, 1), 0);
+	EXPECT_EQ(napi.busy_poll_to, 0);
+}
+
+TEST_F(napi, unregister_no_arg)
+{
+	struct io_uring_napi napi = { .busy_poll_to = 100 };
+
+	ASSERT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 1), 0);
+	EXPECT_EQ(ring_register(&self->ring, IORING_UNREGISTER_NAPI, NULL, 1), 0);
+}
+
+TEST_F(napi, recv)
+{
+	struct io_uring_napi napi = { .busy_poll_to = 50 };
+	struct io_uring_cqe *cqe;
+	char buf[8];
+	int sv[2];
+
+	ASSERT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 1), 0);
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+	/* waiting with busy polling enabled still sees the completion */
+	ring_prep_rw(ring_get_sqe(&self->ring), IORING_OP_RECV, sv[0], buf,
+		     sizeof(buf), 0);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	ASSERT_EQ(send(sv[1], "napi", 4, 0), 4);
+	ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+	EXPECT_EQ(cqe->res, 4);
+	ring_cqe_seen(&self->ring);
+
+	close(sv[0]);
+	close(sv[1]);
+}
+
+TEST_F(napi, reserved)
+{
+	struct io_uring_napi napi = { .busy_poll_to = 100 };
+
+	napi.pad[1] = 1;
+	EXPECT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 1),
+		  -EINVAL);
+	napi.pad[1] = 0;
+	napi.resv = 1;
+	EXPECT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 1),
+		  -EINVAL);
+
+	/* nothing was changed */
+	EXPECT_EQ(ring_register(&self->ring, IORING_UNREGISTER_NAPI, &napi, 1), 0);
+	EXPECT_EQ(napi.busy_poll_to, 0);
+}
+
+TEST_F(napi, bad_args)
+{
+	struct io_uring_napi napi = {};
+
+	EXPECT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, NULL, 1),
+		  -EINVAL);
+	EXPECT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI, &napi, 2),
+		  -EINVAL);
+	EXPECT_EQ(ring_register(&self->ring, IORING_UNREGISTER_NAPI, &napi, 0),
+		  -EINVAL);
+	EXPECT_EQ(ring_register(&self->ring, IORING_REGISTER_NAPI,
+				(void *)-1UL, 1), -EFAULT);
+}
+
+TEST_HARNESS_MAIN
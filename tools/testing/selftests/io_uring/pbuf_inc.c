@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IOU_PBUF_RING_INC: buffers of a provided buffer ring are consumed
+ * incrementally, each transfer only uses up the part of the buffer it needs.
+ */
+#define _GNU_SOURCE
+#include <sys/socket.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define BGID		1
+#define NR_BUFS		2
+#define BUF_SIZE	64
+
+FIXTURE(pbuf_inc) {
+	struct ring ring;
+	struct io_uring_buf_ring *br;
+	char bufs[NR_BUFS][BUF_SIZE];
+	int sv[2];
+};
+
+FIXTURE_SETUP(pbuf_inc)
+{
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, self->sv), 0);
+}
+
+FIXTURE_TEARDOWN(pbuf_inc)
+{
+	close(self->sv[0]);
+	close(self->sv[1]);
+	ring_exit(&self->ring);
+}
+
+static int setup_bufs(FIXTURE_DATA(pbuf_inc) *self, unsigned int flags)
+{
+	int ret, i;
+
+	self->br = ring_setup_buf_ring(&self->ring, NR_BUFS, BGID, flags, &ret);
+	if (!self->br)
+		return ret;
+	for (i = 0; i < NR_BUFS; i++)
+		ring_buf_ring_add(self->br, NR_BUFS, self->bufs[i], BUF_SIZE,
+				  i, i);
+	ring_buf_ring_advance(self->br, NR_BUFS);
+	return 0;
+}
+
+/* Send @len bytes of @c and receive them into a provided buffer */
+static int send_recv(FIXTURE_DATA(pbuf_inc) *self, char c, size_t len,
+		     unsigned int *cflags)
+{
+	struct io_uring_sqe *sqe;
+	char data[BUF_SIZE];
+
+	memset(data, c, len);
+	if (send(self->sv[1], data, len, 0) != len)
+		return -errno;
+
+	sqe = ring_get_sqe(&self->ring);
+	ring_prep_rw(sqe, IORING_OP_RECV, self->sv[0], NULL, 0, 0);
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BGID;
+	return ring_submit_one(&self->ring, cflags);
+}
+
+static int memchk(const char *buf, char c, size_t len)
+{
+	while (len--)
+		if (*buf++ != c)
+			return -1;
+	return 0;
+}
+
+TEST_F(pbuf_inc, incremental)
+{
+	unsigned int cflags;
+	int ret;
+
+	ret = setup_bufs(self, IOU_PBUF_RING_INC);
+	if (ret == -EINVAL)
+		SKIP(return, "IOU_PBUF_RING_INC not supported");
+	ASSERT_EQ(ret, 0);
+
+	/* the first two receives share buffer 0 */
+	ASSERT_EQ(send_recv(self, 'a', 10, &cflags), 10);
+	ASSERT_TRUE(cflags & IORING_CQE_F_BUFFER);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 0);
+	EXPECT_TRUE(cflags & IORING_CQE_F_BUF_MORE);
+	EXPECT_EQ(memchk(self->bufs[0], 'a', 10), 0);
+
+	ASSERT_EQ(send_recv(self, 'b', 20, &cflags), 20);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 0);
+	EXPECT_TRUE(cflags & IORING_CQE_F_BUF_MORE);
+	/* the data follows on directly */
+	EXPECT_EQ(memchk(self->bufs[0] + 10, 'b', 20), 0);
+
+	/* this one uses up the rest of buffer 0 */
+	ASSERT_EQ(send_recv(self, 'c', BUF_SIZE - 30, &cflags), BUF_SIZE - 30);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 0);
+	EXPECT_FALSE(cflags & IORING_CQE_F_BUF_MORE);
+	EXPECT_EQ(memchk(self->bufs[0] + 30, 'c', BUF_SIZE - 30), 0);
+
+	ASSERT_EQ(send_recv(self, 'd', 1, &cflags), 1);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 1);
+	EXPECT_TRUE(cflags & IORING_CQE_F_BUF_MORE);
+	EXPECT_EQ(self->bufs[1][0], 'd');
+}
+
+TEST_F(pbuf_inc, whole_buffers)
+{
+	unsigned int cflags;
+
+	ASSERT_EQ(setup_bufs(self, 0), 0);
+
+	/* without IOU_PBUF_RING_INC every receive retires its buffer */
+	ASSERT_EQ(send_recv(self, 'a', 10, &cflags), 10);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 0);
+	EXPECT_FALSE(cflags & IORING_CQE_F_BUF_MORE);
+
+	ASSERT_EQ(send_recv(self, 'b', 10, &cflags), 10);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 1);
+	EXPECT_FALSE(cflags & IORING_CQE_F_BUF_MORE);
+
+	EXPECT_EQ(send_recv(self, 'c', 10, &cflags), -ENOBUFS);
+}
+
+TEST_F(pbuf_inc, bad_flags)
+{
+	EXPECT_EQ(setup_bufs(self, 1U << 7), -EINVAL);
+}
+
+TEST_HARNESS_MAIN
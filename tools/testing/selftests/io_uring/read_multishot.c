@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_OP_READ_MULTISHOT: one request keeps reading from a pollable file
+ * into provided buffers, posting a CQE with IORING_CQE_F_MORE for each one.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define BGID		1
+#define NR_BUFS		4
+#define BUF_SIZE	32
+
+FIXTURE(read_multishot) {
+	struct ring ring;
+	struct io_uring_buf_ring *br;
+	char bufs[NR_BUFS][BUF_SIZE];
+	int pipe[2];
+};
+
+FIXTURE_SETUP(read_multishot)
+{
+	int ret, i;
+
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	if (!ring_opcode_supported(&self->ring, IORING_OP_READ_MULTISHOT))
+		SKIP(return, "IORING_OP_READ_MULTISHOT not supported");
+
+	self->br = ring_setup_buf_ring(&self->ring, NR_BUFS, BGID, 0, &ret);
+	ASSERT_NE(self->br, NULL) TH_LOG("buffer ring: %s", strerror(-ret));
+	for (i = 0; i < NR_BUFS; i++)
+		ring_buf_ring_add(self->br, NR_BUFS, self->bufs[i], BUF_SIZE,
+				  i, i);
+	ring_buf_ring_advance(self->br, NR_BUFS);
+
+	ASSERT_EQ(pipe(self->pipe), 0);
+}
+
+FIXTURE_TEARDOWN(read_multishot)
+{
+	close(self->pipe[0]);
+	if (self->pipe[1] >= 0)
+		close(self->pipe[1]);
+	ring_exit(&self->ring);
+}
+
+static void prep_read_multishot(struct io_uring_sqe *sqe, int fd)
+{
+	ring_prep_rw(sqe, IORING_OP_READ_MULTISHOT, fd, NULL, 0, -1ULL);
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BGID;
+}
+
+TEST_F(read_multishot, reads)
+{
+	static const char * const msgs[] = { "hello", "multishot", "world!" };
+	struct io_uring_cqe *cqe;
+	unsigned int i, bid;
+
+	prep_read_multishot(ring_get_sqe(&self->ring), self->pipe[0]);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+
+	/* nothing to read yet, the request is armed */
+	ASSERT_EQ(ring_peek_cqe(&self->ring, &cqe), -EAGAIN);
+
+	for (i = 0; i < 3; i++) {
+		size_t len = strlen(msgs[i]);
+
+		ASSERT_EQ(write(self->pipe[1], msgs[i], len), len);
+		ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+		ASSERT_EQ(cqe->res, len);
+		ASSERT_TRUE(cqe->flags & IORING_CQE_F_MORE);
+		ASSERT_TRUE(cqe->flags & IORING_CQE_F_BUFFER);
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		/* every completion consumes the next buffer of the ring */
+		EXPECT_EQ(bid, i);
+		EXPECT_EQ(memcmp(self->bufs[bid], msgs[i], len), 0);
+		ring_cqe_seen(&self->ring);
+	}
+
+	/* EOF terminates the request */
+	close(self->pipe[1]);
+	self->pipe[1] = -1;
+	ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+	EXPECT_EQ(cqe->res, 0);
+	EXPECT_FALSE(cqe->flags & IORING_CQE_F_MORE);
+	ring_cqe_seen(&self->ring);
+}
+
+TEST_F(read_multishot, out_of_buffers)
+{
+	struct io_uring_cqe *cqe;
+	char c = 'x';
+	int i;
+
+	prep_read_multishot(ring_get_sqe(&self->ring), self->pipe[0]);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+
+	for (i = 0; i < NR_BUFS; i++) {
+		ASSERT_EQ(write(self->pipe[1], &c, 1), 1);
+		ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+		ASSERT_EQ(cqe->res, 1);
+		ASSERT_TRUE(cqe->flags & IORING_CQE_F_MORE);
+		ring_cqe_seen(&self->ring);
+	}
+
+	/* the buffer ring is empty, the request ends with -ENOBUFS */
+	ASSERT_EQ(write(self->pipe[1], &c, 1), 1);
+	ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+	EXPECT_EQ(cqe->res, -ENOBUFS);
+	EXPECT_FALSE(cqe->flags & IORING_CQE_F_MORE);
+	ring_cqe_seen(&self->ring);
+}
+
+TEST_F(read_multishot, no_buffer_select)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	ring_prep_rw(sqe, IORING_OP_READ_MULTISHOT, self->pipe[0], NULL, 0,
+		     -1ULL);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(read_multishot, length_given)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	prep_read_multishot(sqe, self->pipe[0]);
+	sqe->len = BUF_SIZE;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(read_multishot, not_pollable)
+{
+	struct io_uring_sqe *sqe;
+	int fd;
+
+	/* shmem files can't be polled */
+	fd = memfd_create("read_multishot", 0);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(write(fd, "data", 4), 4);
+
+	sqe = ring_get_sqe(&self->ring);
+	prep_read_multishot(sqe, fd);
+	sqe->off = 0;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EBADFD);
+	close(fd);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_RECVSEND_BUNDLE: a recv spreads the data over several consecutive
+ * buffers of a provided buffer ring and posts a single CQE for them.
+ */
+#define _GNU_SOURCE
+#include <sys/socket.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+#define BGID		1
+#define NR_BUFS		8
+#define BUF_SIZE	16
+
+FIXTURE(recv_bundle) {
+	struct ring ring;
+	struct io_uring_buf_ring *br;
+	char bufs[NR_BUFS][BUF_SIZE];
+	int sv[2];
+};
+
+FIXTURE_SETUP(recv_bundle)
+{
+	int ret, i;
+
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	self->br = ring_setup_buf_ring(&self->ring, NR_BUFS, BGID, 0, &ret);
+	ASSERT_NE(self->br, NULL) TH_LOG("buffer ring: %s", strerror(-ret));
+	for (i = 0; i < NR_BUFS; i++)
+		ring_buf_ring_add(self->br, NR_BUFS, self->bufs[i], BUF_SIZE,
+				  i, i);
+	ring_buf_ring_advance(self->br, NR_BUFS);
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, self->sv), 0);
+}
+
+FIXTURE_TEARDOWN(recv_bundle)
+{
+	close(self->sv[0]);
+	close(self->sv[1]);
+	ring_exit(&self->ring);
+}
+
+static void prep_recv_bundle(struct io_uring_sqe *sqe, int fd)
+{
+	ring_prep_rw(sqe, IORING_OP_RECV, fd, NULL, 0, 0);
+	sqe->ioprio = IORING_RECVSEND_BUNDLE;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BGID;
+}
+
+TEST_F(recv_bundle, recv)
+{
+	char data[3 * BUF_SIZE - 8], received[sizeof(data)];
+	unsigned int cflags, bid, i;
+	int ret;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+	ASSERT_EQ(send(self->sv[1], data, sizeof(data), 0), sizeof(data));
+
+	prep_recv_bundle(ring_get_sqe(&self->ring), self->sv[0]);
+	ret = ring_submit_one(&self->ring, &cflags);
+	if (ret == -EINVAL)
+		SKIP(return, "IORING_RECVSEND_BUNDLE not supported");
+	ASSERT_EQ(ret, sizeof(data));
+	ASSERT_TRUE(cflags & IORING_CQE_F_BUFFER);
+	bid = cflags >> IORING_CQE_BUFFER_SHIFT;
+	ASSERT_EQ(bid, 0);
+
+	/* the data continues in the buffers following the first one */
+	for (i = 0; i < sizeof(data); i += BUF_SIZE)
+		memcpy(received + i, self->bufs[bid + i / BUF_SIZE],
+		       sizeof(data) - i < BUF_SIZE ? sizeof(data) - i : BUF_SIZE);
+	EXPECT_EQ(memcmp(received, data, sizeof(data)), 0);
+
+	/* only the three buffers the data reached were consumed */
+	ASSERT_EQ(send(self->sv[1], data, 1, 0), 1);
+	prep_recv_bundle(ring_get_sqe(&self->ring), self->sv[0]);
+	ASSERT_EQ(ring_submit_one(&self->ring, &cflags), 1);
+	EXPECT_EQ(cflags >> IORING_CQE_BUFFER_SHIFT, 3);
+}
+
+TEST_F(recv_bundle, no_buffers)
+{
+	struct io_uring_sqe *sqe;
+
+	ASSERT_EQ(send(self->sv[1], "x", 1, 0), 1);
+	sqe = ring_get_sqe(&self->ring);
+	prep_recv_bundle(sqe, self->sv[0]);
+	/* a group that doesn't exist */
+	sqe->buf_group = BGID + 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -ENOBUFS);
+}
+
+TEST_F(recv_bundle, no_buffer_select)
+{
+	struct io_uring_sqe *sqe;
+	char buf[BUF_SIZE];
+
+	ASSERT_EQ(send(self->sv[1], "x", 1, 0), 1);
+	sqe = ring_get_sqe(&self->ring);
+	ring_prep_rw(sqe, IORING_OP_RECV, self->sv[0], buf, sizeof(buf), 0);
+	sqe->ioprio = IORING_RECVSEND_BUNDLE;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(recv_bundle, waitall)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	prep_recv_bundle(sqe, self->sv[0]);
+	sqe->msg_flags = MSG_WAITALL;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(recv_bundle, recvmsg)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+	struct msghdr msg = {};
+
+	prep_recv_bundle(sqe, self->sv[0]);
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->addr = (unsigned long)&msg;
+	sqe->len = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_F(recv_bundle, legacy_buffers)
+{
+	struct io_uring_sqe *sqe;
+	char buf[BUF_SIZE];
+
+	/* a group of buffers provided with IORING_OP_PROVIDE_BUFFERS */
+	sqe = ring_get_sqe(&self->ring);
+	ring_prep_rw(sqe, IORING_OP_PROVIDE_BUFFERS, 1, buf, sizeof(buf), 0);
+	sqe->buf_group = BGID + 1;
+	ASSERT_EQ(ring_submit_one(&self->ring, NULL), 0);
+
+	ASSERT_EQ(send(self->sv[1], "x", 1, 0), 1);
+	sqe = ring_get_sqe(&self->ring);
+	prep_recv_bundle(sqe, self->sv[0]);
+	sqe->buf_group = BGID + 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_HARNESS_MAIN
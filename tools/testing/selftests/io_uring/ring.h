@@ -0,0 +1,341 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Minimal io_uring ring handling on top of the raw system calls, so that the
+ * tests only depend on the installed kernel headers and not on liburing.
+ * Like liburing, the helpers return 0 or a negative error code.
+ */
+#ifndef __SELFTESTS_IO_URING_RING_H
+#define __SELFTESTS_IO_URING_RING_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct ring {
+	int fd;
+	unsigned int flags;
+
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_flags;
+	unsigned int *sq_array;
+	unsigned int sq_entries;
+	/* SQEs handed out by ring_get_sqe(), not necessarily submitted yet */
+	unsigned int sqe_tail;
+	struct io_uring_sqe *sqes;
+
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+};
+
+static inline int sys_io_uring_setup(unsigned int entries,
+				     struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned int to_submit,
+				     unsigned int min_complete,
+				     unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned int opcode,
+					void *arg, unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* io_uring_register() returning 0 or a negative error code */
+static inline int ring_register(struct ring *r, unsigned int opcode,
+				void *arg, unsigned int nr_args)
+{
+	int ret = sys_io_uring_register(r->fd, opcode, arg, nr_args);
+
+	return ret < 0 ? -errno : ret;
+}
+
+static inline void ring_exit(struct ring *r)
+{
+	if (r->sqes)
+		munmap(r->sqes, r->sqes_size);
+	if (r->cq_ptr && r->cq_ptr != r->sq_ptr)
+		munmap(r->cq_ptr, r->cq_size);
+	if (r->sq_ptr)
+		munmap(r->sq_ptr, r->sq_size);
+	close(r->fd);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+static inline int ring_init(struct ring *r, unsigned int entries,
+			    struct io_uring_params *p)
+{
+	int ret;
+
+	memset(r, 0, sizeof(*r));
+	r->fd = sys_io_uring_setup(entries, p);
+	if (r->fd < 0)
+		return -errno;
+	r->flags = p->flags;
+
+	r->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	r->cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_size > r->sq_size)
+			r->sq_size = r->cq_size;
+		r->cq_size = r->sq_size;
+	}
+
+	r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ptr == MAP_FAILED) {
+		r->sq_ptr = NULL;
+		goto err;
+	}
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ptr = r->sq_ptr;
+	} else {
+		r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE, r->fd,
+				 IORING_OFF_CQ_RING);
+		if (r->cq_ptr == MAP_FAILED) {
+			r->cq_ptr = NULL;
+			goto err;
+		}
+	}
+
+	r->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		goto err;
+	}
+
+	r->sq_head = r->sq_ptr + p->sq_off.head;
+	r->sq_tail = r->sq_ptr + p->sq_off.tail;
+	r->sq_mask = r->sq_ptr + p->sq_off.ring_mask;
+	r->sq_flags = r->sq_ptr + p->sq_off.flags;
+	r->sq_array = r->sq_ptr + p->sq_off.array;
+	r->sq_entries = p->sq_entries;
+	r->sqe_tail = *r->sq_tail;
+
+	r->cq_head = r->cq_ptr + p->cq_off.head;
+	r->cq_tail = r->cq_ptr + p->cq_off.tail;
+	r->cq_mask = r->cq_ptr + p->cq_off.ring_mask;
+	r->cqes = r->cq_ptr + p->cq_off.cqes;
+	return 0;
+err:
+	ret = -errno;
+	ring_exit(r);
+	return ret;
+}
+
+/* Set up a ring of @entries with default parameters */
+static inline int ring_init_simple(struct ring *r, unsigned int entries)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	return ring_init(r, entries, &p);
+}
+
+static inline bool ring_opcode_supported(struct ring *r, int op)
+{
+	struct io_uring_probe *probe;
+	bool ret = false;
+	size_t len;
+
+	len = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+	probe = calloc(1, len);
+	if (!probe)
+		return false;
+	if (!ring_register(r, IORING_REGISTER_PROBE, probe, 256))
+		ret = op <= probe->last_op &&
+		      (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	return ret;
+}
+
+/* Returns a zeroed SQE, or NULL if the SQ ring is full */
+static inline struct io_uring_sqe *ring_get_sqe(struct ring *r)
+{
+	unsigned int head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (r->sqe_tail - head >= r->sq_entries)
+		return NULL;
+	sqe = &r->sqes[r->sqe_tail & *r->sq_mask];
+	r->sqe_tail++;
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+static inline void ring_prep_rw(struct io_uring_sqe *sqe, int op, int fd,
+				const void *addr, unsigned int len,
+				__u64 off)
+{
+	sqe->opcode = op;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)addr;
+	sqe->len = len;
+	sqe->off = off;
+}
+
+/*
+ * Make the SQEs handed out so far visible to the kernel, submit them and wait
+ * for at least @wait_nr completions. Returns the number of SQEs submitted.
+ */
+static inline int ring_submit_and_wait(struct ring *r, unsigned int wait_nr)
+{
+	unsigned int tail = *r->sq_tail, submit = r->sqe_tail - tail;
+	unsigned int flags = 0;
+	int ret;
+
+	for (; tail != r->sqe_tail; tail++)
+		r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+	__atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+	if (wait_nr)
+		flags |= IORING_ENTER_GETEVENTS;
+	if (r->flags & IORING_SETUP_SQPOLL) {
+		/* the SQ thread picks the entries up by itself */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(r->sq_flags, __ATOMIC_RELAXED) &
+		    IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		else if (!wait_nr)
+			return submit;
+		ret = sys_io_uring_enter(r->fd, 0, wait_nr, flags);
+		return ret < 0 ? -errno : (int)submit;
+	}
+
+	ret = sys_io_uring_enter(r->fd, submit, wait_nr, flags);
+	return ret < 0 ? -errno : ret;
+}
+
+static inline int ring_submit(struct ring *r)
+{
+	return ring_submit_and_wait(r, 0);
+}
+
+/* Returns -EAGAIN if no completion is pending */
+static inline int ring_peek_cqe(struct ring *r, struct io_uring_cqe **cqe)
+{
+	unsigned int head = *r->cq_head;
+
+	if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+		return -EAGAIN;
+	*cqe = &r->cqes[head & *r->cq_mask];
+	return 0;
+}
+
+static inline int ring_wait_cqe(struct ring *r, struct io_uring_cqe **cqe)
+{
+	*cqe = NULL;
+	while (ring_peek_cqe(r, cqe)) {
+		if (sys_io_uring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+		    errno != EINTR)
+			return -errno;
+	}
+	return 0;
+}
+
+static inline void ring_cqe_seen(struct ring *r)
+{
+	__atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Submit a single SQE and return the result of its completion. The CQE flags
+ * are stored in @cflags if it is not NULL.
+ */
+static inline int ring_submit_one(struct ring *r, unsigned int *cflags)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	ret = ring_submit_and_wait(r, 1);
+	if (ret < 0)
+		return ret;
+	ret = ring_wait_cqe(r, &cqe);
+	if (ret)
+		return ret;
+	ret = cqe->res;
+	if (cflags)
+		*cflags = cqe->flags;
+	ring_cqe_seen(r);
+	return ret;
+}
+
+/* Register a ring of provided buffers allocated by the application */
+static inline struct io_uring_buf_ring *
+ring_setup_buf_ring(struct ring *r, unsigned int entries, int bgid,
+		    unsigned int flags, int *err)
+{
+	size_t size = entries * sizeof(struct io_uring_buf);
+	struct io_uring_buf_reg reg;
+	struct io_uring_buf_ring *br;
+	int ret;
+
+	br = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (br == MAP_FAILED) {
+		*err = -errno;
+		return NULL;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)br;
+	reg.ring_entries = entries;
+	reg.bgid = bgid;
+	reg.flags = flags;
+	ret = ring_register(r, IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret) {
+		munmap(br, size);
+		*err = ret;
+		return NULL;
+	}
+	*err = 0;
+	return br;
+}
+
+/* Fill in entry @offset past the tail, published by ring_buf_ring_advance() */
+static inline void ring_buf_ring_add(struct io_uring_buf_ring *br,
+				     unsigned int entries, void *addr,
+				     unsigned int len, unsigned short bid,
+				     unsigned int offset)
+{
+	struct io_uring_buf *buf;
+
+	buf = &br->bufs[(br->tail + offset) & (entries - 1)];
+	buf->addr = (unsigned long)addr;
+	buf->len = len;
+	buf->bid = bid;
+}
+
+static inline void ring_buf_ring_advance(struct io_uring_buf_ring *br,
+					 unsigned int count)
+{
+	__atomic_store_n(&br->tail, br->tail + count, __ATOMIC_RELEASE);
+}
+
+#endif /* __SELFTESTS_IO_URING_RING_H */
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_OP_WAITID: waitid(2) without blocking the submitting task.
+ */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "../kselftest_harness.h"
+#include "ring.h"
+
+FIXTURE(waitid) {
+	struct ring ring;
+	siginfo_t info;
+};
+
+FIXTURE_SETUP(waitid)
+{
+	ASSERT_EQ(ring_init_simple(&self->ring, 8), 0);
+	if (!ring_opcode_supported(&self->ring, IORING_OP_WAITID))
+		SKIP(return, "IORING_OP_WAITID not supported");
+}
+
+FIXTURE_TEARDOWN(waitid)
+{
+	ring_exit(&self->ring);
+}
+
+static struct io_uring_sqe *prep_waitid(FIXTURE_DATA(waitid) *self,
+					idtype_t which, pid_t pid, int options)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(&self->ring);
+
+	memset(&self->info, 0, sizeof(self->info));
+	sqe->opcode = IORING_OP_WAITID;
+	sqe->len = which;
+	sqe->fd = pid;
+	sqe->file_index = options;
+	sqe->addr2 = (unsigned long)&self->info;
+	return sqe;
+}
+
+/* Fork a child that exits with status 7, after reading a byte from @fd */
+static pid_t fork_child(int fd)
+{
+	pid_t pid = fork();
+	char c;
+
+	if (!pid) {
+		if (fd >= 0)
+			read(fd, &c, 1);
+		_exit(7);
+	}
+	return pid;
+}
+
+TEST_F(waitid, exited)
+{
+	pid_t pid;
+
+	pid = fork_child(-1);
+	ASSERT_GT(pid, 0);
+	/* the child may or may not have exited by the time this is issued */
+	prep_waitid(self, P_PID, pid, WEXITED);
+	ASSERT_EQ(ring_submit_one(&self->ring, NULL), 0);
+	EXPECT_EQ(self->info.si_signo, SIGCHLD);
+	EXPECT_EQ(self->info.si_code, CLD_EXITED);
+	EXPECT_EQ(self->info.si_pid, pid);
+	EXPECT_EQ(self->info.si_status, 7);
+	/* and it was reaped */
+	EXPECT_EQ(waitpid(pid, NULL, WNOHANG), -1);
+}
+
+TEST_F(waitid, pending)
+{
+	struct io_uring_cqe *cqe;
+	int fds[2];
+	pid_t pid;
+
+	ASSERT_EQ(pipe(fds), 0);
+	pid = fork_child(fds[0]);
+	ASSERT_GT(pid, 0);
+
+	prep_waitid(self, P_PID, pid, WEXITED);
+	ASSERT_EQ(ring_submit(&self->ring), 1);
+	usleep(100000);
+	EXPECT_EQ(ring_peek_cqe(&self->ring, &cqe), -EAGAIN);
+
+	/* let the child exit */
+	ASSERT_EQ(write(fds[1], "x", 1), 1);
+	ASSERT_EQ(ring_wait_cqe(&self->ring, &cqe), 0);
+	EXPECT_EQ(cqe->res, 0);
+	ring_cqe_seen(&self->ring);
+	EXPECT_EQ(self->info.si_pid, pid);
+	EXPECT_EQ(self->info.si_status, 7);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST_F(waitid, nohang)
+{
+	int fds[2];
+	pid_t pid;
+
+	ASSERT_EQ(pipe(fds), 0);
+	pid = fork_child(fds[0]);
+	ASSERT_GT(pid, 0);
+
+	/* nothing to report yet */
+	prep_waitid(self, P_PID, pid, WEXITED | WNOHANG);
+	self->info.si_signo = -1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), 0);
+	EXPECT_EQ(self->info.si_signo, 0);
+
+	ASSERT_EQ(write(fds[1], "x", 1), 1);
+	ASSERT_EQ(waitpid(pid, NULL, 0), pid);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST_F(waitid, errors)
+{
+	struct io_uring_sqe *sqe;
+
+	prep_waitid(self, P_ALL, 0, WEXITED);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -ECHILD);
+
+	/* no child state to wait for, unknown options and ID types */
+	prep_waitid(self, P_ALL, 0, 0);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	prep_waitid(self, P_ALL, 0, WEXITED | 0x10000000);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	prep_waitid(self, 42, 0, WEXITED);
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+
+	/* unused fields must be clear */
+	sqe = prep_waitid(self, P_ALL, 0, WEXITED);
+	sqe->addr = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+	sqe = prep_waitid(self, P_ALL, 0, WEXITED);
+	sqe->addr3 = 1;
+	EXPECT_EQ(ring_submit_one(&self->ring, NULL), -EINVAL);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Memory mapping of the per CPU ring buffers through trace_pipe_raw: a meta
+ * page followed by the sub-buffers, read-only, and TRACE_MMAP_IOCTL_GET_READER
+ * to move the reader forward.
+ */
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/trace_mmap.h>
+
+#include "../kselftest_harness.h"
+
+#define INSTANCE	"map_test"
+
+static const char *tracefs_root(void)
+{
+	static const char * const roots[] = {
+		"/sys/kernel/tracing",
+		"/sys/kernel/debug/tracing",
+	};
+	char path[64];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(roots); i++) {
+		snprintf(path, sizeof(path), "%s/trace", roots[i]);
+		if (!access(path, F_OK))
+			return roots[i];
+	}
+	return NULL;
+}
+
+/* Write @str to @file of the instance, returns 0 or a negative error code */
+static int write_file(const char *dir, const char *file, const char *str)
+{
+	char path[256];
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, str, strlen(str)) < 0)
+		ret = -errno;
+	close(fd);
+	return ret;
+}
+
+static long read_file_long(const char *dir, const char *file)
+{
+	char path[256], buf[32];
+	int fd, len;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len < 0)
+		return -errno;
+	buf[len] = '\0';
+	return strtol(buf, NULL, 10);
+}
+
+FIXTURE(map) {
+	char dir[128];
+	struct trace_buffer_meta *meta;
+	size_t map_len;
+	long page_size;
+	int fd;
+};
+
+FIXTURE_SETUP(map)
+{
+	struct trace_buffer_meta *meta;
+	const char *root;
+	char path[256];
+	cpu_set_t set;
+
+	self->fd = -1;
+	self->meta = NULL;
+	self->page_size = sysconf(_SC_PAGESIZE);
+
+	if (geteuid())
+		SKIP(return, "needs root");
+	root = tracefs_root();
+	if (!root)
+		SKIP(return, "tracefs not mounted");
+
+	snprintf(self->dir, sizeof(self->dir), "%s/instances/" INSTANCE, root);
+	rmdir(self->dir);
+	ASSERT_EQ(mkdir(self->dir, 0755), 0);
+
+	/* events written from here go to the buffer of CPU 0 */
+	CPU_ZERO(&set);
+	CPU_SET(0, &set);
+	ASSERT_EQ(sched_setaffinity(0, sizeof(set), &set), 0);
+
+	snprintf(path, sizeof(path), "%s/per_cpu/cpu0/trace_pipe_raw",
+		 self->dir);
+	self->fd = open(path, O_RDONLY | O_NONBLOCK);
+	ASSERT_GE(self->fd, 0);
+
+	/* the meta page tells the size of the whole mapping */
+	meta = mmap(NULL, self->page_size, PROT_READ, MAP_SHARED, self->fd, 0);
+	if (meta == MAP_FAILED && errno == ENODEV) {
+		close(self->fd);
+		rmdir(self->dir);
+		SKIP(return, "trace_pipe_raw cannot be mapped");
+	}
+	ASSERT_NE(meta, MAP_FAILED);
+	self->map_len = meta->meta_page_size +
+			(size_t)meta->nr_subbufs * meta->subbuf_size;
+	munmap(meta, self->page_size);
+
+	self->meta = mmap(NULL, self->map_len, PROT_READ, MAP_SHARED,
+			  self->fd, 0);
+	ASSERT_NE(self->meta, MAP_FAILED);
+}
+
+FIXTURE_TEARDOWN(map)
+{
+	if (self->meta && self->meta != MAP_FAILED)
+		munmap(self->meta, self->map_len);
+	if (self->fd >= 0)
+		close(self->fd);
+	rmdir(self->dir);
+}
+
+static void *subbuf(FIXTURE_DATA(map) *self, unsigned int id)
+{
+	return (char *)self->meta + self->meta->meta_page_size +
+	       (size_t)id * self->meta->subbuf_size;
+}
+
+TEST_F(map, meta_page)
+{
+	struct trace_buffer_meta *meta = self->meta;
+
+	EXPECT_EQ(meta->meta_page_size, self->page_size);
+	EXPECT_EQ(meta->meta_struct_len, sizeof(*meta));
+	EXPECT_EQ(meta->subbuf_size, self->page_size);
+	/* at least one sub-buffer in the ring besides the reader */
+	EXPECT_GE(meta->nr_subbufs, 2);
+	EXPECT_LT(meta->reader.id, meta->nr_subbufs);
+	EXPECT_EQ(meta->flags, 0);
+	EXPECT_EQ(meta->entries, 0);
+	EXPECT_EQ(meta->overrun, 0);
+}
+
+TEST_F(map, get_reader)
+{
+	const char *msg = "map_test marker";
+
+	/* nothing to read */
+	EXPECT_EQ(ioctl(self->fd, TRACE_MMAP_IOCTL_GET_READER), 0);
+	EXPECT_EQ(self->meta->entries, 0);
+
+	ASSERT_EQ(write_file(self->dir, "trace_marker", msg), 0);
+	ASSERT_EQ(ioctl(self->fd, TRACE_MMAP_IOCTL_GET_READER), 0);
+	EXPECT_EQ(self->meta->entries, 1);
+	ASSERT_LT(self->meta->reader.id, self->meta->nr_subbufs);
+
+	/* the event is read straight from the reader sub-buffer */
+	EXPECT_NE(memmem(subbuf(self, self->meta->reader.id),
+			 self->meta->subbuf_size, msg, strlen(msg)), NULL);
+
+	/* and accounted as read on the next call */
+	ASSERT_EQ(ioctl(self->fd, TRACE_MMAP_IOCTL_GET_READER), 0);
+	EXPECT_EQ(self->meta->read, 1);
+}
+
+TEST_F(map, bad_mmap)
+{
+	size_t nr_pages = self->map_len / self->page_size;
+	void *p;
+
+	/* the mapping is read-only and shared */
+	p = mmap(NULL, self->page_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		 self->fd, 0);
+	EXPECT_EQ(p, MAP_FAILED);
+	EXPECT_EQ(errno, EPERM);
+	p = mmap(NULL, self->page_size, PROT_READ, MAP_PRIVATE, self->fd, 0);
+	EXPECT_EQ(p, MAP_FAILED);
+	EXPECT_EQ(errno, EPERM);
+	EXPECT_EQ(mprotect(self->meta, self->page_size,
+			   PROT_READ | PROT_WRITE), -1);
+
+	/* larger than the buffer, or starting past its end */
+	p = mmap(NULL, self->map_len + self->page_size, PROT_READ, MAP_SHARED,
+		 self->fd, 0);
+	EXPECT_EQ(p, MAP_FAILED);
+	EXPECT_EQ(errno, EINVAL);
+	p = mmap(NULL, self->page_size, PROT_READ, MAP_SHARED, self->fd,
+		 nr_pages * self->page_size);
+	EXPECT_EQ(p, MAP_FAILED);
+	EXPECT_EQ(errno, EINVAL);
+
+	/* a mapping of the sub-buffers only is fine */
+	p = mmap(NULL, self->page_size, PROT_READ, MAP_SHARED, self->fd,
+		 self->page_size);
+	ASSERT_NE(p, MAP_FAILED);
+	munmap(p, self->page_size);
+}
+
+TEST_F(map, not_mapped)
+{
+	char path[256];
+	int fd;
+
+	/* only the buffer of the instance is mapped, not the top level one */
+	snprintf(path, sizeof(path), "%s/../../per_cpu/cpu0/trace_pipe_raw",
+		 self->dir);
+	fd = open(path, O_RDONLY | O_NONBLOCK);
+	ASSERT_GE(fd, 0);
+	EXPECT_EQ(ioctl(fd, TRACE_MMAP_IOCTL_GET_READER), -1);
+	EXPECT_EQ(errno, ENODEV);
+	close(fd);
+}
+
+TEST_F(map, resize)
+{
+	long size = read_file_long(self->dir, "buffer_size_kb");
+	char buf[32];
+
+	ASSERT_GT(size, 0);
+	snprintf(buf, sizeof(buf), "%ld", size * 2);
+	EXPECT_EQ(write_file(self->dir, "buffer_size_kb", buf), -EBUSY);
+
+	/* fine again once unmapped */
+	munmap(self->meta, self->map_len);
+	self->meta = NULL;
+	EXPECT_EQ(write_file(self->dir, "buffer_size_kb", buf), 0);
+}
+
+TEST_F(map, snapshot)
+{
+	char path[256];
+	void *p;
+
+	snprintf(path, sizeof(path), "%s/snapshot", self->dir);
+	if (access(path, F_OK))
+		SKIP(return, "kernel built without CONFIG_TRACER_SNAPSHOT");
+
+	/* a snapshot would swap the mapped buffer */
+	EXPECT_EQ(write_file(self->dir, "snapshot", "1"), -EBUSY);
+
+	munmap(self->meta, self->map_len);
+	self->meta = NULL;
+	ASSERT_EQ(write_file(self->dir, "snapshot", "1"), 0);
+	p = mmap(NULL, self->page_size, PROT_READ, MAP_SHARED, self->fd, 0);
+	EXPECT_EQ(p, MAP_FAILED);
+	EXPECT_EQ(errno, EBUSY);
+	EXPECT_EQ(write_file(self->dir, "snapshot", "0"), 0);
+}
+
+TEST_HARNESS_MAIN